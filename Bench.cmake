@@ -0,0 +1,14 @@
+add_executable(bladebit_bench
+    bench/KernelBench.cpp
+    cuda/harvesting/CudaThresherDummy.cpp
+    metal/harvesting/MetalThresherDummy.cpp
+    cuda/CudaFxOffloadDummy.cpp
+    cuda/CudaParkDecoderDummy.cpp
+    cuda/CudaProofValidatorDummy.cpp
+)
+
+target_link_libraries(bladebit_bench PRIVATE bladebit_core)
+
+set_target_properties(bladebit_bench PROPERTIES 
+    EXCLUDE_FROM_ALL ON
+)
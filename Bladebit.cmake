@@ -20,11 +20,20 @@ target_link_libraries(bladebit_core PUBLIC
     $<$<PLATFORM_ID:Linux>:
         ${NUMA_LIBRARY}
     >
+
+    $<$<PLATFORM_ID:Windows>:
+        ws2_32
+    >
 )
 
 add_executable(bladebit
     src/main.cpp
-    cuda/harvesting/CudaThresherDummy.cpp)
+    cuda/harvesting/CudaThresherDummy.cpp
+    metal/harvesting/MetalThresherDummy.cpp
+    cuda/CudaFxOffloadDummy.cpp
+    cuda/CudaParkDecoderDummy.cpp
+    cuda/CudaProofValidatorDummy.cpp
+    cuda/GpuBenchmarkDummy.cpp)
 
 target_link_libraries(bladebit PRIVATE bladebit_core)
 
@@ -38,6 +47,8 @@ set(src_uint128
 
 set(src_chacha8
     src/pos/chacha8.cpp
+    src/pos/chacha8_simd.cpp
+    src/pos/chacha8_impl.h
     src/pos/chacha8.h
 )
 
@@ -64,6 +75,7 @@ set(src_blake3
     src/b3/blake3.h
     src/b3/blake3_impl.h
     src/b3/blake3_portable.c
+    src/b3/blake3_short.c
     
     $<${is_x86}:
 
@@ -78,6 +90,10 @@ set(src_blake3
             src/b3/blake3_sse41_x86-64_unix.S
         >
     >
+
+    $<${is_arm}:
+        src/b3/blake3_neon.c
+    >
 )
 
 set(src_bech32
@@ -138,6 +154,8 @@ set(src_bladebit
     src/algorithm/YSort.cpp
     src/algorithm/YSort.h
     src/algorithm/RadixSort.h
+    src/algorithm/StreamingScatter.h
+    src/algorithm/KeyGather.h
 
     src/io/BucketStream.cpp
     src/io/BucketStream.h
@@ -148,7 +166,13 @@ set(src_bladebit
     src/io/IOUtil.cpp
     src/io/IOUtil.h
     src/io/IStream.h
+    src/io/MappedFileStream.cpp
+    src/io/MappedFileStream.h
     src/io/MemoryStream.h
+    src/io/NetStream.cpp
+    src/io/NetStream.h
+    src/io/PrefetchStream.cpp
+    src/io/PrefetchStream.h
 
     src/plotdisk/BlockWriter.h
     src/plotdisk/DiskFp.h
@@ -184,9 +208,16 @@ set(src_bladebit
     src/plotdisk/DiskPlotPhase2.cpp
     src/plotdisk/DiskPlotPhase3.cpp
     src/plotdisk/DiskPlotter.h
+    src/plotdisk/GpuFxOffload.h
     src/plotdisk/DiskPlotter.cpp
     src/plotdisk/DiskBufferQueue.cpp
     src/plotdisk/DiskBufferQueue.h
+    src/plotdisk/IOController.cpp
+    src/plotdisk/IOController.h
+    src/plotdisk/DiskPlotTuner.cpp
+    src/plotdisk/DiskPlotTuner.h
+    src/plotdisk/DiskPlotCheckpoint.cpp
+    src/plotdisk/DiskPlotCheckpoint.h
     src/plotdisk/BitBucketWriter.h
 
     
@@ -199,6 +230,8 @@ set(src_bladebit
     src/plotmem/ParkWriter.h
     src/plotmem/DbgHelper.h
     src/plotmem/LPGen.h
+    src/plotmem/LPGen.cpp
+    src/plotmem/MemNuma.h
     src/plotmem/MemPhase1.cpp
     src/plotmem/MemPhase2.cpp
     src/plotmem/MemPhase3.cpp
@@ -218,17 +251,36 @@ set(src_bladebit
     src/plotting/Compression.cpp
     src/plotting/Compression.h
     src/plotting/FSETableGenerator.cpp
+    src/plotting/GpuParkDecoder.h
     src/plotting/GlobalPlotConfig.h
     src/plotting/IPlotter.h
     src/plotting/PlotHeader.h
     src/plotting/PlotTools.cpp
     src/plotting/PlotTools.h
+    src/plotting/ProofBits.h
+    src/plotting/PlotBenchmark.cpp
+    src/plotting/PlotBenchmark.h
+    src/plotting/PlotIdManifest.cpp
+    src/plotting/PlotIdManifest.h
     src/plotting/PlotValidation.h
     src/plotting/PlotWriter.cpp
     src/plotting/PlotWriter.h
+    src/plotting/PlotMover.cpp
+    src/plotting/PlotMover.h
+    src/plotting/PlotCheckQueue.cpp
+    src/plotting/PlotCheckQueue.h
+    src/plotting/ParkCoding.h
+    src/plotting/ParkCoding.cpp
+    src/plotting/RANSCoding.h
     src/plotting/Tables.h
     src/plotting/BufferChain.h
     src/plotting/BufferChain.cpp
+    src/plotting/MemoryPlanner.h
+    src/plotting/MemoryPlanner.cpp
+    src/plotting/IOStats.h
+    src/plotting/IOStats.cpp
+    src/plotting/HarvestYield.cpp
+    src/plotting/HarvestYield.h
     
     src/plotting/f1/F1Gen.h
     src/plotting/f1/F1Gen.cpp
@@ -239,7 +291,11 @@ set(src_bladebit
     src/plotting/matching/GroupScan.h
     src/plotting/WorkHeap.h
 
+    src/threading/AddressWait.cpp
+    src/threading/AddressWait.h
     src/threading/AutoResetSignal.h
+    src/threading/AsyncExecutor.cpp
+    src/threading/AsyncExecutor.h
     src/threading/Semaphore.cpp
     src/threading/Semaphore.h
     src/threading/Fence.cpp
@@ -247,19 +303,33 @@ set(src_bladebit
     src/threading/GenJob.h
     src/threading/MTJob.h
     src/threading/MonoJob.h
+    src/threading/Task.h
     src/threading/Thread.h
+    src/threading/ThreadAffinity.cpp
+    src/threading/ThreadAffinity.h
     src/threading/ThreadPool.cpp
     src/threading/ThreadPool.h
+    src/threading/TreeBarrier.cpp
+    src/threading/TreeBarrier.h
+    src/threading/WorkStealingRanges.cpp
+    src/threading/WorkStealingRanges.h
     src/threading/AutoResetSignal.cpp
 
     # src/tools/FSETableGenerator.cpp
     src/tools/MemTester.cpp
     src/tools/IOTester.cpp
+    src/tools/GpuBenchmark.h
     src/tools/PlotComparer.cpp
     src/tools/PlotFile.cpp
     src/tools/PlotReader.cpp
     src/tools/PlotReader.h
+    src/tools/PlotIndexCache.cpp
+    src/tools/PlotIndexCache.h
+    src/tools/PlotReadScheduler.cpp
+    src/tools/PlotReadScheduler.h
     src/tools/PlotValidator.cpp
+    src/tools/ValidationJournal.cpp
+    src/tools/ValidationJournal.h
     src/tools/PlotChecker.cpp
 
     src/util/Array.h
@@ -271,14 +341,23 @@ set(src_bladebit
     src/util/jobs/MemJobs.h
     src/util/jobs/SortKeyJob.h
     src/util/BitView.h
+    src/util/BitUnpack.cpp
+    src/util/BitUnpack.h
     src/util/CliParser.cpp
     src/util/KeyTools.cpp
     src/util/KeyTools.h
+    src/util/LatencyHistogram.h
     src/util/Log.h
     src/util/CliParser.h
     src/util/Log.cpp
+    src/util/PageWarmer.cpp
+    src/util/PageWarmer.h
+    src/util/PerfCounters.cpp
+    src/util/PerfCounters.h
     src/util/Span.h
     src/util/StackAllocator.h
+    src/util/Trace.cpp
+    src/util/Trace.h
     src/util/Util.cpp
     src/util/Util.h
     src/util/VirtualAllocator.h
@@ -287,10 +366,19 @@ set(src_bladebit
     src/commands/CmdPlotCheck.cpp
     src/commands/CmdSimulator.cpp
     src/commands/CmdCheckCUDA.cpp
+    src/commands/CmdGenIds.cpp
+    src/commands/CmdRecompress.cpp
+    src/commands/CmdReceive.cpp
+    src/commands/CmdReplay.cpp
 
     src/harvesting/GreenReaper.cpp
     src/harvesting/GreenReaper.h
     src/harvesting/GreenReaperInternal.h
+    src/harvesting/HarvestTrace.cpp
+    src/harvesting/HarvestTrace.h
+    src/harvesting/PlotIndexer.cpp
+    src/harvesting/PlotIndexer.h
+    src/harvesting/PlotLookup.cpp
     src/harvesting/Thresher.h
 
     src/plotting/DiskQueue.h
@@ -303,6 +391,7 @@ set(src_bladebit
     src/plotting/DiskBufferBase.cpp
 
     src/util/MPMCQueue.h
+    src/util/BoundedMPMCQueue.h
     src/util/CommandQueue.h
 )
 
@@ -19,16 +19,30 @@ add_executable(bladebit_cuda
     cuda/CudaFx.h
     cuda/FxCuda.cu
     cuda/CudaUtil.h
+    cuda/GpuRuntime.h
+    cuda/GpuCub.h
     cuda/CudaPlotUtil.cu
+    cuda/CudaSort.h
+    cuda/CudaSort.cu
+    cuda/CudaPack.h
+    cuda/CudaPack.cu
     cuda/GpuStreams.h
     cuda/GpuStreams.cu
     cuda/GpuDownloadStream.cu
     cuda/GpuQueue.h
     cuda/GpuQueue.cu
+    cuda/GpuDirectStorage.cu
+    cuda/CudaFxOffload.cu
+    cuda/CudaParkDecoder.cu
+    cuda/CudaProofValidator.cu
+    cuda/CudaTuning.h
+    cuda/CudaTuning.cu
+    cuda/GpuBenchmark.cu
 
     # Harvester
     cuda/harvesting/CudaThresher.cu
     cuda/harvesting/CudaThresherFactory.cu
+    metal/harvesting/MetalThresherDummy.cpp
 )
 
 target_include_directories(bladebit_cuda PRIVATE src cuda SYSTEM cuda)
@@ -36,6 +50,9 @@ target_include_directories(bladebit_cuda PRIVATE src cuda SYSTEM cuda)
 target_compile_definitions(bladebit_cuda PUBLIC
     BB_CUDA_ENABLED=1
     THRUST_IGNORE_CUB_VERSION_CHECK=1
+    BBCU_BUCKET_COUNT=${BB_CUDA_BUCKET_COUNT}u
+    $<$<BOOL:${BB_ENABLE_HIP}>:BB_HIP_ENABLED=1>
+    $<$<AND:$<BOOL:${BB_CUDA_USE_CUFILE}>,$<NOT:$<BOOL:${BB_ENABLE_HIP}>>>:BB_CUDA_USE_CUFILE=1>
 )
 
 target_compile_options(bladebit_cuda PRIVATE
@@ -49,14 +66,26 @@ target_compile_options(bladebit_cuda PRIVATE
     >
  )
 
-target_link_options(bladebit_cuda PRIVATE $<DEVICE_LINK: ${cuda_archs}>)
+if(BB_ENABLE_HIP)
+    target_link_libraries(bladebit_cuda PRIVATE bladebit_core hip::host hip::hipcub)
 
-target_link_libraries(bladebit_cuda PRIVATE bladebit_core CUDA::cudart_static)# CUDA::cuda_driver)
+    set_target_properties(bladebit_cuda PROPERTIES
+        MSVC_RUNTIME_LIBRARY MultiThreaded$<$<CONFIG:Debug>:Debug>
+    )
+else()
+    target_link_options(bladebit_cuda PRIVATE $<DEVICE_LINK: ${cuda_archs}>)
 
-set_target_properties(bladebit_cuda PROPERTIES
-    MSVC_RUNTIME_LIBRARY MultiThreaded$<$<CONFIG:Debug>:Debug>
-    CUDA_RUNTIME_LIBRARY Static
-    CUDA_SEPARABLE_COMPILATION ON
-    CUDA_RESOLVE_DEVICE_SYMBOLS ON
-    CUDA_ARCHITECTURES OFF
-)
+    target_link_libraries(bladebit_cuda PRIVATE bladebit_core CUDA::cudart_static)# CUDA::cuda_driver)
+
+    if(BB_CUDA_USE_CUFILE)
+        target_link_libraries(bladebit_cuda PRIVATE CUDA::cuFile)
+    endif()
+
+    set_target_properties(bladebit_cuda PROPERTIES
+        MSVC_RUNTIME_LIBRARY MultiThreaded$<$<CONFIG:Debug>:Debug>
+        CUDA_RUNTIME_LIBRARY Static
+        CUDA_SEPARABLE_COMPILATION ON
+        CUDA_RESOLVE_DEVICE_SYMBOLS ON
+        CUDA_ARCHITECTURES OFF
+    )
+endif()
@@ -23,6 +23,11 @@ target_compile_definitions(bladebit_config INTERFACE
         _CRT_SECURE_NO_WARNINGS=1
         _HAS_EXCEPTIONS=0
     >
+
+    # NEON is part of the AArch64 baseline, so BLAKE3 uses it unconditionally
+    $<${is_arm}:
+        BLAKE3_USE_NEON=1
+    >
 )
 
 target_compile_options(bladebit_config INTERFACE
@@ -124,6 +129,7 @@ set_property(DIRECTORY . PROPERTY CUDA_RESOLVE_DEVICE_SYMBOLS ON)
 
 set(preinclude_pch
     $<${is_cuda}:--pre-include pch.h>
+    $<${is_hip}:--include=pch.h>
     $<${is_c_cpp}:
         $<$<CXX_COMPILER_ID:GNU,Clang,AppleClang>:--include=pch.h>
     >
@@ -164,7 +170,19 @@ set(cuda_archs
 
             # Lovelace
             -gencode=arch=compute_89,code=sm_89         # NVIDIA GeForce RTX 4090, RTX 4080, RTX 6000, Tesla L40
-            -gencode=arch=compute_89,code=compute_89    # Future proofing
+
+            # Hopper
+            -gencode=arch=compute_90,code=sm_90         # H100, GH200
+
+            # Blackwell, CUDA 12.8+
+            $<$<VERSION_GREATER_EQUAL:${CMAKE_CUDA_COMPILER_VERSION},12.8>:
+                -gencode=arch=compute_100,code=sm_100   # B200, GB200
+                -gencode=arch=compute_120,code=sm_120   # GeForce RTX 5000 series, RTX PRO 6000
+            >
+
+            # Future proofing. Devices without SASS above JIT this on first use, which can take minutes.
+            $<$<VERSION_GREATER_EQUAL:${CMAKE_CUDA_COMPILER_VERSION},12.8>:-gencode=arch=compute_120,code=compute_120>
+            $<$<VERSION_LESS:${CMAKE_CUDA_COMPILER_VERSION},12.8>:-gencode=arch=compute_90,code=compute_90>
         >
     >
 
@@ -1,3 +1,8 @@
+# The Metal thresher is written in Objective-C++
+if(APPLE)
+    enable_language(OBJCXX)
+endif()
+
 if(NOT ${BB_HARVESTER_STATIC})
     add_library(bladebit_harvester SHARED src/harvesting/HarvesterDummy.cpp)
 else()
@@ -19,6 +24,8 @@ target_sources(bladebit_harvester PRIVATE
     src/pch.cpp
 
     src/pos/chacha8.cpp
+    src/pos/chacha8_simd.cpp
+    src/pos/chacha8_impl.h
     src/pos/chacha8.h
 
     src/fse/bitstream.h
@@ -41,6 +48,7 @@ target_sources(bladebit_harvester PRIVATE
     src/b3/blake3.h
     src/b3/blake3_impl.h
     src/b3/blake3_portable.c
+    src/b3/blake3_short.c
 
     $<${is_x86}:
         $<$<PLATFORM_ID:Windows>:
@@ -54,24 +62,49 @@ target_sources(bladebit_harvester PRIVATE
             src/b3/blake3_sse41_x86-64_unix.S
         >
     >
+
+    $<${is_arm}:
+        src/b3/blake3_neon.c
+    >
     
 
     src/util/Log.cpp
     src/util/Util.cpp
+    src/util/BitUnpack.cpp
+    src/SysHost.cpp
+    src/util/Trace.cpp
+    src/util/PerfCounters.cpp
+    src/plotting/HarvestYield.cpp
     src/PlotContext.cpp
     src/io/HybridStream.cpp
+    src/threading/AddressWait.cpp
     src/threading/AutoResetSignal.cpp
     src/threading/Fence.cpp
     src/threading/Semaphore.cpp
+    src/threading/ThreadAffinity.cpp
     src/threading/ThreadPool.cpp
+    src/threading/TreeBarrier.cpp
+    src/threading/WorkStealingRanges.cpp
     src/plotting/FSETableGenerator.cpp
     src/plotting/PlotWriter.cpp
+    src/plotting/PlotMover.cpp
     src/plotting/Compression.cpp
+    src/plotting/ParkCoding.cpp
     src/plotting/matching/GroupScan.cpp
     src/plotdisk/DiskBufferQueue.cpp
+    src/plotdisk/IOController.cpp
+    src/plotting/IOStats.cpp
     src/plotting/WorkHeap.cpp
     src/plotdisk/jobs/IOJob.cpp
     src/harvesting/GreenReaper.cpp
+    src/harvesting/HarvestTrace.cpp
+    src/harvesting/PlotIndexer.cpp
+    src/harvesting/PlotLookup.cpp
+    src/plotting/PlotValidation.cpp
+    src/tools/PlotFile.cpp
+    src/tools/PlotReader.cpp
+    src/tools/PlotIndexCache.cpp
+    src/tools/PlotReadScheduler.cpp
 
     src/bech32/segwit_addr.c
 
@@ -82,6 +115,7 @@ target_sources(bladebit_harvester PRIVATE
         cuda/CudaF1.cu
         cuda/CudaMatch.cu
         cuda/CudaPlotUtil.cu
+        cuda/CudaSort.cu
         cuda/GpuQueue.cu
 
         # TODO: Does this have to be here?
@@ -97,6 +131,14 @@ target_sources(bladebit_harvester PRIVATE
         cuda/harvesting/CudaThresherDummy.cpp
     >
 
+    $<$<PLATFORM_ID:Darwin>:
+        metal/harvesting/MetalThresher.mm
+    >
+
+    $<$<NOT:$<PLATFORM_ID:Darwin>>:
+        metal/harvesting/MetalThresherDummy.cpp
+    >
+
     $<$<PLATFORM_ID:Windows>:
         src/platform/win32/SysHost_Win32.cpp
         src/platform/win32/FileStream_Win32.cpp
@@ -132,6 +174,7 @@ target_compile_definitions(bladebit_harvester
 
     $<${have_cuda}:
         BB_CUDA_ENABLED=1
+        $<$<BOOL:${BB_ENABLE_HIP}>:BB_HIP_ENABLED=1>
     >
 
     PUBLIC
@@ -146,7 +189,7 @@ target_compile_options(bladebit_harvester PRIVATE
     ${cuda_archs}
 )
 
-if(have_cuda)
+if(have_cuda AND NOT BB_ENABLE_HIP)
     target_link_options(bladebit_harvester PUBLIC $<DEVICE_LINK: ${cuda_archs}>)
 endif()
 
@@ -155,10 +198,17 @@ target_link_libraries(bladebit_harvester
         bladebit_config
     PUBLIC 
         Threads::Threads
-        $<${have_cuda}:CUDA::cudart_static>
+        $<$<AND:${have_cuda},$<NOT:$<BOOL:${BB_ENABLE_HIP}>>>:CUDA::cudart_static>
+        $<$<AND:${have_cuda},$<BOOL:${BB_ENABLE_HIP}>>:hip::host>
+        $<$<AND:${have_cuda},$<BOOL:${BB_ENABLE_HIP}>>:hip::hipcub>
 )
 
-if(CUDAToolkit_FOUND)
+if(BB_ENABLE_HIP)
+    set_target_properties(bladebit_harvester PROPERTIES
+        EXCLUDE_FROM_ALL ON
+        MSVC_RUNTIME_LIBRARY MultiThreaded$<$<CONFIG:Debug>:Debug>
+    )
+elseif(CUDAToolkit_FOUND)
     set_target_properties(bladebit_harvester PROPERTIES 
         EXCLUDE_FROM_ALL ON
         MSVC_RUNTIME_LIBRARY MultiThreaded$<$<CONFIG:Debug>:Debug>
@@ -169,6 +219,11 @@ if(CUDAToolkit_FOUND)
     )
 endif()
 
+if(APPLE)
+    set_source_files_properties(metal/harvesting/MetalThresher.mm PROPERTIES COMPILE_FLAGS -fobjc-arc)
+    target_link_libraries(bladebit_harvester PRIVATE "-framework Metal" "-framework Foundation")
+endif()
+
  # Disable blake3 conversion loss of data warnings
  if("${CMAKE_CXX_COMPILER_ID}" MATCHES "MSVC")
     set_source_files_properties( 
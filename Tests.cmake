@@ -2,8 +2,22 @@ include(cmake_modules/FindCatch2.cmake)
 
 add_executable(tests ${src_bladebit}
     cuda/harvesting/CudaThresherDummy.cpp
+    metal/harvesting/MetalThresherDummy.cpp
+    cuda/CudaFxOffloadDummy.cpp
+    cuda/CudaParkDecoderDummy.cpp
+    cuda/CudaProofValidatorDummy.cpp
     tests/TestUtil.h
     tests/TestDiskQueue.cpp
+    tests/TestBoundedPairDeltas.cpp
+    tests/TestRANSCoding.cpp
+    tests/TestChaCha8.cpp
+    tests/TestBlake3Short.cpp
+    tests/TestWorkStealingRanges.cpp
+    tests/TestMPMCQueue.cpp
+    tests/TestPairsToLinePoints.cpp
+    tests/TestGreenReaperV1.cpp
+    tests/TestRemotePath.cpp
+    tests/TestRadixSortHybrid.cpp
 )
 
 target_compile_definitions(tests PRIVATE
@@ -0,0 +1,586 @@
+#include "threading/ThreadPool.h"
+#include "algorithm/RadixSort.h"
+#include "algorithm/YSort.h"
+#include "plotting/matching/GroupScan.h"
+#include "plotting/TableWriter.h"
+#include "plotmem/MemPhase1.h"
+#include "plotmem/ParkWriter.h"
+#include "plotdisk/FpFxGen.h"
+#include "util/CliParser.h"
+#include "util/Log.h"
+#include "SysHost.h"
+#include "ChiaConsts.h"
+#include <vector>
+#include <string>
+#include <random>
+#include <algorithm>
+
+///
+/// Micro-benchmarks for the plotting kernels.
+/// Every kernel runs on the same deterministic, plot-like input across a sweep of
+/// thread counts, so that results are comparable between CPUs, compilers and flags.
+///
+
+static const char* USAGE = R"(bladebit_bench [OPTIONS] [<kernel> ...]
+
+Runs micro-benchmarks of the plotting kernels and reports their throughput
+in entries per second for each thread count.
+If no kernels are given, all of them are run.
+
+[OPTIONS]
+ -t, --threads <list> : Comma-separated thread counts to sweep (ex: 1,4,16).
+                        Default: Powers of 2 up to the logical CPU count, and the CPU count itself.
+
+ -n, --entries <n>    : Run each kernel on 2^n entries. Valid values: 16-32. Default: 22.
+
+ -i, --iterations <n> : Timed runs for each kernel and thread count. The fastest is reported.
+                        Default: 3.
+
+ --json <path>        : Also write the results as json to this file.
+
+ --list               : List the available kernels and exit.
+
+ -h, --help           : Print this help message and exit.
+)";
+
+namespace {
+
+    constexpr uint32 F1_ENTRIES_PER_BLOCK = kF1BlockSizeBits / 32;
+
+    struct BenchData
+    {
+        uint32  entryBits  = 22;
+        uint64  entryCount = 0;
+
+        // Inputs
+        uint64* f1Y        = nullptr;   // Unsorted F1 y values
+        uint64* matchY     = nullptr;   // Sorted y values with the same kBC group density as a k32 table
+        uint32* groups     = nullptr;   // kBC group boundaries of matchY
+        uint64  groupCount = 0;
+        Pair*   pairs      = nullptr;   // Matches of matchY
+        uint64  pairCount  = 0;
+        uint64  maxPairs   = 0;
+        Meta4*  metaIn     = nullptr;
+        uint64* linePoints = nullptr;   // Sorted line points with the same delta distribution as a k32 table
+        uint32* f7         = nullptr;   // Sorted f7 values with the same delta distribution as a k32 table
+
+        // Working buffers
+        uint64* y          = nullptr;
+        uint64* yTmp       = nullptr;
+        uint32* key        = nullptr;
+        uint32* keyTmp     = nullptr;
+        uint32* x          = nullptr;
+        byte*   blocks     = nullptr;
+        uint32* groupsTmp  = nullptr;
+        Pair*   pairsTmp   = nullptr;
+        Meta4*  metaOut    = nullptr;
+        uint64* lpWork     = nullptr;
+        uint32* f7Work     = nullptr;
+        byte*   parkBuffer = nullptr;
+    };
+
+    struct Kernel
+    {
+        const char* name;
+        const char* desc;
+        void   (*prepare)( BenchData& d );                                      // Untimed. Restores any inputs the kernel overwrites.
+        uint64 (*run)    ( BenchData& d, ThreadPool& pool, uint32 threadCount ); // Returns the number of entries processed.
+    };
+
+    struct BenchResult
+    {
+        const char* kernel;
+        uint32      threadCount;
+        uint64      entries;
+        double      seconds;
+    };
+}
+
+//-----------------------------------------------------------
+static uint64 RunF1( BenchData& d, ThreadPool& pool, const uint32 threadCount )
+{
+    // Chacha key for table 1 of a fixed plot id
+    byte key[32] = { 1 };
+    for( uint32 i = 1; i < sizeof( key ); i++ )
+        key[i] = (byte)( i * 7 );
+
+    const uint64 totalBlocks     = d.entryCount / F1_ENTRIES_PER_BLOCK;
+    const uint64 blocksPerThread = totalBlocks / threadCount;
+
+    F1GenJob jobs[MAX_THREADS];
+
+    for( uint32 i = 0; i < threadCount; i++ )
+    {
+        const uint64 blockOffset = blocksPerThread * i;
+        const uint64 blockCount  = i == threadCount-1 ? totalBlocks - blockOffset : blocksPerThread;
+        const uint64 offset      = blockOffset * F1_ENTRIES_PER_BLOCK;
+
+        F1GenJob& job = jobs[i];
+        job.key        = key;
+        job.blockCount = (uint32)blockCount;
+        job.entryCount = (uint32)( blockCount * F1_ENTRIES_PER_BLOCK );
+        job.x          = (uint32)offset;
+        job.blocks     = d.blocks + offset * sizeof( uint32 );
+        job.yBuffer    = d.y      + offset;
+        job.xBuffer    = d.x      + offset;
+    }
+
+    pool.RunJob( F1JobThread, jobs, threadCount );
+
+    return d.entryCount;
+}
+
+//-----------------------------------------------------------
+static void PrepareSort( BenchData& d )
+{
+    bbmemcpy_t( d.y, d.f1Y, d.entryCount );
+}
+
+//-----------------------------------------------------------
+static void PrepareSortWithKey( BenchData& d )
+{
+    bbmemcpy_t( d.y, d.f1Y, d.entryCount );
+
+    for( uint64 i = 0; i < d.entryCount; i++ )
+        d.key[i] = (uint32)i;
+}
+
+//-----------------------------------------------------------
+static uint64 RunRadixSort( BenchData& d, ThreadPool& pool, const uint32 threadCount )
+{
+    RadixSort256::Sort<MAX_THREADS>( pool, threadCount, d.y, d.yTmp, d.entryCount );
+    return d.entryCount;
+}
+
+//-----------------------------------------------------------
+static uint64 RunRadixSortWithKey( BenchData& d, ThreadPool& pool, const uint32 threadCount )
+{
+    RadixSort256::SortWithKey<MAX_THREADS>( pool, threadCount, d.y, d.yTmp, d.key, d.keyTmp, d.entryCount );
+    return d.entryCount;
+}
+
+//-----------------------------------------------------------
+static uint64 RunRadixSortHybrid( BenchData& d, ThreadPool& pool, const uint32 threadCount )
+{
+    RadixSort256::SortHybrid<MAX_THREADS>( pool, threadCount, d.y, d.yTmp, d.entryCount );
+    return d.entryCount;
+}
+
+//-----------------------------------------------------------
+static uint64 RunRadixSortWithKeyHybrid( BenchData& d, ThreadPool& pool, const uint32 threadCount )
+{
+    RadixSort256::SortWithKeyHybrid<MAX_THREADS>( pool, threadCount, d.y, d.yTmp, d.key, d.keyTmp, d.entryCount );
+    return d.entryCount;
+}
+
+//-----------------------------------------------------------
+static uint64 RunYSort( BenchData& d, ThreadPool& pool, const uint32 threadCount )
+{
+    // YSorter always uses all of the pool's threads
+    ASSERT( pool.ThreadCount() == threadCount );
+    (void)threadCount;
+
+    YSorter sorter( pool );
+    sorter.Sort( d.entryCount, d.y, d.yTmp, d.key, d.keyTmp );
+    return d.entryCount;
+}
+
+//-----------------------------------------------------------
+static uint64 RunScan( BenchData& d, ThreadPool& pool, const uint32 threadCount )
+{
+    d.groupCount = ScanBCGroupMT32( pool, threadCount, d.matchY, (uint32)d.entryCount,
+                                    d.groupsTmp, d.groups, (uint32)d.entryCount );
+    return d.entryCount;
+}
+
+//-----------------------------------------------------------
+static uint64 RunMatch( BenchData& d, ThreadPool& pool, uint32 threadCount )
+{
+    // Split the groups across threads. Each thread's last L group pairs
+    // with the first group of the next thread, like the scan jobs of phase 1.
+    threadCount = (uint32)std::min( (uint64)threadCount, d.groupCount );
+
+    const uint64 groupsPerThread   = d.groupCount / threadCount;
+    const uint64 maxPairsPerThread = d.maxPairs   / threadCount;
+
+    kBCJob jobs[MAX_THREADS];
+
+    for( uint32 i = 0; i < threadCount; i++ )
+    {
+        const uint64 groupOffset = groupsPerThread * i;
+
+        kBCJob& job = jobs[i];
+        job.yBuffer         = d.matchY;
+        job.startIndex      = d.groups[groupOffset];
+        job.groupBoundaries = d.groups + groupOffset + 1;
+        job.groupCount      = i == threadCount-1 ? d.groupCount - groupOffset : groupsPerThread;
+        job.pairs           = d.pairsTmp + maxPairsPerThread * i;
+        job.maxCount        = maxPairsPerThread;
+        job.pairCount       = 0;
+        job.copyDst         = nullptr;
+    }
+
+    pool.RunJob( FpPairThread, jobs, threadCount );
+
+    // Copy the pairs to a contiguous buffer, as phase 1 does
+    uint64 pairCount = 0;
+    for( uint32 i = 0; i < threadCount; i++ )
+    {
+        jobs[i].copyDst = d.pairs + pairCount;
+        pairCount += jobs[i].pairCount;
+    }
+
+    pool.RunJob( (JobFunc)[]( void* pdata ) {
+
+        auto* job = (kBCJob*)pdata;
+        memcpy( job->copyDst, job->pairs, job->pairCount * sizeof( Pair ) );
+
+    }, jobs, threadCount, sizeof( kBCJob ) );
+
+    d.pairCount = pairCount;
+    return d.entryCount;
+}
+
+//-----------------------------------------------------------
+template<TableId table>
+static uint64 RunFx( BenchData& d, ThreadPool& pool, const uint32 threadCount )
+{
+    using Fx = FpFxGen<table>;
+
+    Fx fx( pool, threadCount );
+    fx.ComputeFxMT( (int64)d.pairCount, d.pairs, d.matchY,
+                    (const typename Fx::TMetaIn*)d.metaIn,
+                    (typename Fx::TYOut*)d.yTmp,
+                    (typename Fx::TMetaOut*)d.metaOut );
+
+    return d.pairCount;
+}
+
+//-----------------------------------------------------------
+static void PrepareParks( BenchData& d )
+{
+    // Parks are written in-place over the line points
+    bbmemcpy_t( d.lpWork, d.linePoints, d.entryCount );
+}
+
+//-----------------------------------------------------------
+static uint64 RunParks( BenchData& d, ThreadPool& pool, const uint32 threadCount )
+{
+    // WriteParks always uses all of the pool's threads
+    ASSERT( pool.ThreadCount() == threadCount );
+    (void)threadCount;
+
+    WriteParks<MAX_THREADS>( pool, d.entryCount, d.lpWork, d.parkBuffer, TableId::Table1 );
+    return d.entryCount;
+}
+
+//-----------------------------------------------------------
+static void PrepareC3( BenchData& d )
+{
+    bbmemcpy_t( d.f7Work, d.f7, d.entryCount );
+}
+
+//-----------------------------------------------------------
+static uint64 RunC3( BenchData& d, ThreadPool& pool, const uint32 threadCount )
+{
+    TableWriter::WriteC3Parallel<MAX_THREADS>( pool, threadCount, d.entryCount, d.f7Work, d.parkBuffer );
+    return d.entryCount;
+}
+
+//-----------------------------------------------------------
+static void PrepareNone( BenchData& d ) { (void)d; }
+
+static const Kernel KERNELS[] = {
+    { "f1"            , "chacha8 F1 generation"                         , PrepareNone       , RunF1                       },
+    { "radix-sort"    , "RadixSort256::Sort on 64-bit y values"         , PrepareSort       , RunRadixSort                },
+    { "radix-sort-key", "RadixSort256::SortWithKey with a 32-bit key"   , PrepareSortWithKey, RunRadixSortWithKey         },
+    { "hybrid-sort"   , "RadixSort256::SortHybrid on 64-bit y values"   , PrepareSort       , RunRadixSortHybrid          },
+    { "hybrid-key"    , "RadixSort256::SortWithKeyHybrid"               , PrepareSortWithKey, RunRadixSortWithKeyHybrid   },
+    { "ysort"         , "YSorter::Sort with a 32-bit key"               , PrepareSortWithKey, RunYSort                    },
+    { "scan"          , "ScanBCGroupMT32 kBC group scan"                , PrepareNone       , RunScan                     },
+    { "match"         , "Phase 1 kBC group matching (FpPairThread)"     , PrepareNone       , RunMatch                    },
+    { "fx2"           , "ComputeFx for table 2 (entries are pairs)"     , PrepareNone       , RunFx<TableId::Table2>      },
+    { "fx3"           , "ComputeFx for table 3 (entries are pairs)"     , PrepareNone       , RunFx<TableId::Table3>      },
+    { "fx4"           , "ComputeFx for table 4 (entries are pairs)"     , PrepareNone       , RunFx<TableId::Table4>      },
+    { "fx5"           , "ComputeFx for table 5 (entries are pairs)"     , PrepareNone       , RunFx<TableId::Table5>      },
+    { "fx6"           , "ComputeFx for table 6 (entries are pairs)"     , PrepareNone       , RunFx<TableId::Table6>      },
+    { "fx7"           , "ComputeFx for table 7 (entries are pairs)"     , PrepareNone       , RunFx<TableId::Table7>      },
+    { "parks"         , "WriteParks of table 1 line points"             , PrepareParks      , RunParks                    },
+    { "c3"            , "WriteC3Parallel of f7 values"                  , PrepareC3         , RunC3                       },
+};
+
+//-----------------------------------------------------------
+static void AllocBenchData( BenchData& d )
+{
+    const uint64 n = d.entryCount;
+
+    // Matching yields about 1 pair per entry. Leave room for the variance.
+    d.maxPairs = n + n / 4;
+
+    d.f1Y        = bbcvirtallocbounded<uint64>( n );
+    d.matchY     = bbcvirtallocbounded<uint64>( n );
+    d.groups     = bbcvirtallocbounded<uint32>( n );
+    d.pairs      = bbcvirtallocbounded<Pair>  ( d.maxPairs );
+    d.metaIn     = bbcvirtallocbounded<Meta4> ( n );
+    d.linePoints = bbcvirtallocbounded<uint64>( n );
+    d.f7         = bbcvirtallocbounded<uint32>( n );
+
+    d.y          = bbcvirtallocbounded<uint64>( n );
+    d.yTmp       = bbcvirtallocbounded<uint64>( d.maxPairs );
+    d.key        = bbcvirtallocbounded<uint32>( n );
+    d.keyTmp     = bbcvirtallocbounded<uint32>( n );
+    d.x          = bbcvirtallocbounded<uint32>( n );
+    d.blocks     = bbcvirtallocbounded<byte>  ( n * sizeof( uint32 ) );
+    d.groupsTmp  = bbcvirtallocbounded<uint32>( n );
+    d.pairsTmp   = bbcvirtallocbounded<Pair>  ( d.maxPairs );
+    d.metaOut    = bbcvirtallocbounded<Meta4> ( d.maxPairs );
+    d.lpWork     = bbcvirtallocbounded<uint64>( n );
+    d.f7Work     = bbcvirtallocbounded<uint32>( n );
+
+    // Line point parks are larger than the C3 parks
+    const uint64 parkCount = CDiv( n, kEntriesPerPark );
+    d.parkBuffer = bbcvirtallocbounded<byte>( ( parkCount + 1 ) * CalculateParkSize( TableId::Table1 ) );
+}
+
+///
+/// Generates the benchmark inputs. Values are scaled so that the
+/// density of the kBC groups and the deltas between line points and f7s
+/// match those of a k32 plot, regardless of the entry count.
+//-----------------------------------------------------------
+static void GenerateInputs( BenchData& d, ThreadPool& pool )
+{
+    const uint64 n         = d.entryCount;
+    const uint32 threads   = pool.ThreadCount();
+    const uint32 yBits     = _K + kExtraBits;
+    const uint32 sizeBits  = d.entryBits;
+
+    Log::Line( "Generating inputs for 2^%u entries...", sizeBits );
+    const auto timer = TimerBegin();
+
+    RunF1( d, pool, threads );
+    bbmemcpy_t( d.f1Y, d.y, n );
+
+    // A k32 table has 2^32 y values in a 2^38 range
+    for( uint64 i = 0; i < n; i++ )
+    {
+        d.matchY[i] = d.f1Y[i] >> ( _K - sizeBits );
+        d.f7[i]     = (uint32)( d.f1Y[i] >> ( yBits - sizeBits ) );
+    }
+
+    RadixSort256::Sort<MAX_THREADS>( pool, d.matchY, d.yTmp, n );
+    RadixSort256::Sort<MAX_THREADS>( pool, d.f7    , d.keyTmp, n );
+
+    // Line points of a k32 table are in a 2^63 range
+    std::mt19937_64 rng( 0x5EED );
+    const uint64 lpRange = n << ( _K - 1 );
+
+    for( uint64 i = 0; i < n; i++ )
+        d.linePoints[i] = rng() % lpRange;
+
+    RadixSort256::Sort<MAX_THREADS>( pool, d.linePoints, d.lpWork, n );
+
+    uint64* meta = (uint64*)d.metaIn;
+    for( uint64 i = 0; i < n * sizeof( Meta4 ) / sizeof( uint64 ); i++ )
+        meta[i] = rng();
+
+    RunScan ( d, pool, threads );
+    RunMatch( d, pool, threads );
+
+    FatalIf( d.groupCount < 1 || d.pairCount < 1, "Failed to generate matches for the benchmark inputs." );
+
+    Log::Line( "Generated inputs in %.2lf seconds: %llu kBC groups, %llu pairs.",
+        TimerEnd( timer ), (llu)d.groupCount, (llu)d.pairCount );
+}
+
+//-----------------------------------------------------------
+static void ParseThreadList( const char* list, std::vector<uint32>& threads )
+{
+    std::string str( list );
+    size_t      start = 0;
+
+    while( start <= str.size() )
+    {
+        size_t end = str.find( ',', start );
+        if( end == std::string::npos )
+            end = str.size();
+
+        const std::string item = str.substr( start, end - start );
+
+        char* endPtr = nullptr;
+        const unsigned long count = strtoul( item.c_str(), &endPtr, 10 );
+
+        FatalIf( item.empty() || *endPtr != '\0' || count < 1 || count > MAX_THREADS,
+            "Invalid thread count '%s'. Thread counts must be between 1 and %u.", item.c_str(), (uint32)MAX_THREADS );
+
+        threads.push_back( (uint32)count );
+        start = end + 1;
+    }
+}
+
+//-----------------------------------------------------------
+static const Kernel* FindKernel( const char* name )
+{
+    for( auto& k : KERNELS )
+        if( strcmp( k.name, name ) == 0 )
+            return &k;
+
+    return nullptr;
+}
+
+//-----------------------------------------------------------
+static bool WriteJson( const char* path, const BenchData& d, const uint32 iterations, const std::vector<BenchResult>& results )
+{
+    FILE* file = fopen( path, "w" );
+    if( !file )
+        return false;
+
+    fprintf( file, "{\n" );
+    fprintf( file, "  \"entries_log2\": %u,\n", d.entryBits );
+    fprintf( file, "  \"iterations\": %u,\n", iterations );
+    fprintf( file, "  \"logical_cpus\": %u,\n", SysHost::GetLogicalCPUCount() );
+    fprintf( file, "  \"results\": [\n" );
+
+    for( size_t i = 0; i < results.size(); i++ )
+    {
+        const auto& r = results[i];
+
+        fprintf( file, "    { \"kernel\": \"%s\", \"threads\": %u, \"entries\": %llu, \"seconds\": %.6lf, \"entries_per_second\": %.1lf }%s\n",
+            r.kernel, r.threadCount, (llu)r.entries, r.seconds, r.entries / r.seconds,
+            i + 1 < results.size() ? "," : "" );
+    }
+
+    fprintf( file, "  ]\n}\n" );
+
+    const bool ok = fflush( file ) == 0 && !ferror( file );
+    fclose( file );
+    return ok;
+}
+
+//-----------------------------------------------------------
+int main( int argc, const char* argv[] )
+{
+    CliParser cli( argc-1, argv+1 );
+
+    BenchData                  d;
+    uint32                     iterations = 3;
+    const char*                jsonPath   = nullptr;
+    const char*                threadList = nullptr;
+    std::vector<const Kernel*> kernels;
+
+    while( cli.HasArgs() )
+    {
+        if( cli.ReadU32( d.entryBits, "-n", "--entries" ) )
+            continue;
+        else if( cli.ReadU32( iterations, "-i", "--iterations" ) )
+            continue;
+        else if( cli.ReadStr( threadList, "-t", "--threads" ) )
+            continue;
+        else if( cli.ReadStr( jsonPath, "--json" ) )
+            continue;
+        else if( cli.ArgConsume( "--list" ) )
+        {
+            for( auto& k : KERNELS )
+                Log::Line( " %-16s %s", k.name, k.desc );
+            return 0;
+        }
+        else if( cli.ArgConsume( "-h", "--help" ) )
+        {
+            Log::Line( USAGE );
+            return 0;
+        }
+        else if( cli.Arg()[0] == '-' )
+        {
+            Fatal( "Unexpected option '%s'.", cli.Arg() );
+        }
+        else
+        {
+            const char*   name   = cli.ArgConsume();
+            const Kernel* kernel = FindKernel( name );
+            FatalIf( !kernel, "Unknown kernel '%s'. Use --list to see the available kernels.", name );
+
+            kernels.push_back( kernel );
+        }
+    }
+
+    FatalIf( d.entryBits < 16 || d.entryBits > 32, "Invalid entry count 2^%u. Valid values are 16-32.", d.entryBits );
+    FatalIf( iterations < 1, "Invalid iteration count." );
+
+    if( kernels.empty() )
+    {
+        for( auto& k : KERNELS )
+            kernels.push_back( &k );
+    }
+
+    std::vector<uint32> threadCounts;
+    const uint32 cpuCount = std::min( SysHost::GetLogicalCPUCount(), (uint)MAX_THREADS );
+
+    if( threadList )
+        ParseThreadList( threadList, threadCounts );
+    else
+    {
+        for( uint32 t = 1; t < cpuCount; t *= 2 )
+            threadCounts.push_back( t );
+        threadCounts.push_back( cpuCount );
+    }
+
+    d.entryCount = 1ull << d.entryBits;
+
+    LoadLTargets();
+    AllocBenchData( d );
+
+    {
+        ThreadPool pool( *std::max_element( threadCounts.begin(), threadCounts.end() ) );
+        GenerateInputs( d, pool );
+    }
+
+    Log::Line( "" );
+    Log::Line( "%-16s %8s %14s %12s %16s %8s", "Kernel", "Threads", "Entries", "Seconds", "M entries/s", "Speedup" );
+
+    std::vector<BenchResult> results;
+
+    for( const Kernel* kernel : kernels )
+    {
+        double baseRate = 0;
+
+        for( const uint32 threadCount : threadCounts )
+        {
+            // A pool per thread count, so that the kernels which always use
+            // all of the pool's threads scale with the sweep too.
+            ThreadPool pool( threadCount );
+
+            BenchResult r = { kernel->name, threadCount, 0, 0 };
+
+            for( uint32 i = 0; i < iterations; i++ )
+            {
+                kernel->prepare( d );
+
+                const auto   timer   = TimerBegin();
+                const uint64 entries = kernel->run( d, pool, threadCount );
+                const double elapsed = TicksToSeconds( TimerEndTicks( timer ) );
+
+                if( i == 0 || elapsed < r.seconds )
+                {
+                    r.seconds = elapsed;
+                    r.entries = entries;
+                }
+            }
+
+            const double rate = r.entries / r.seconds;
+            if( baseRate == 0 )
+                baseRate = rate;
+
+            Log::Line( "%-16s %8u %14llu %12.6lf %16.2lf %7.2lfx",
+                r.kernel, r.threadCount, (llu)r.entries, r.seconds, rate / 1000000.0, rate / baseRate );
+
+            results.push_back( r );
+        }
+    }
+
+    if( jsonPath )
+    {
+        FatalIf( !WriteJson( jsonPath, d, iterations, results ), "Failed to write benchmark results to '%s'.", jsonPath );
+        Log::Line( "\nWrote results to '%s'.", jsonPath );
+    }
+
+    return 0;
+}
@@ -1,6 +1,7 @@
 #include "CudaF1.h"
 #include "CudaUtil.h"
 #include "ChiaConsts.h"
+#include "CudaTuning.h"
 
 /// #NOTE: Code duplicated from chacha8.cu for now.
 /// #TODO: Refactor and consolidate
@@ -27,23 +28,23 @@
     b = ROTATE(XOR(b, c), 7)
 
 
-// 128 threads per cuda block, each thread will do one chacha block
-#define CHACHA_BLOCKS_PER_CUDA_BLOCK 128ull
-
 //-----------------------------------------------------------
 __global__ void chacha8_get_keystream_cuda_k32( 
     const CudaPlotInfo info,
     const uint32_t* input,
     const uint64_t  chachaBlockBase,
+    const uint32    chachaBlockCount,
     uint64*         outY, 
     uint32*         outX )
 {
-    extern __shared__ uint32 sharedBucketCounts[];
-
     const uint32 id  = threadIdx.x;
     const uint32 gid = blockIdx.x * blockDim.x + id;
 
-    const uint64_t chachaBlock = chachaBlockBase + blockIdx.x * CHACHA_BLOCKS_PER_CUDA_BLOCK + id;
+    // Each thread does one chacha block, the block size comes from the device's launch profile
+    if( gid >= chachaBlockCount )
+        return;
+
+    const uint64_t chachaBlock = chachaBlockBase + gid;
 
 
     uint32_t x0, x1, x2, x3, x4, x5, x6, x7, x8, x9, x10, x11, x12, x13, x14, x15;
@@ -161,15 +162,91 @@ void CudaGenF1K32(
           uint32* devOutX,
     cudaStream_t  stream )
 {
-    const uint32 cuThreads = CHACHA_BLOCKS_PER_CUDA_BLOCK;
+    const uint32 cuThreads = CudaTuning::Profile().f1Threads;
     const uint32 cuBlocks  = CDiv( chachaBlockCount, cuThreads );
         
     chacha8_get_keystream_cuda_k32<<<cuBlocks, cuThreads, 0, stream>>>(
         info,
         devChaChhaInput,
         chachaBlockBase,
+        chachaBlockCount,
         devOutY,
         devOutX
     );
 }
 
+
+//-----------------------------------------------------------
+__global__ void chacha8_get_f1_for_xs_cuda_k32(
+    const uint32_t* input,
+    const uint64*   xs,
+    const uint32    xCount,
+    uint64*         outY,
+    uint32*         outX )
+{
+    const uint32 gid = blockIdx.x * blockDim.x + threadIdx.x;
+    if( gid >= xCount )
+        return;
+
+    // With k32, each x's y is exactly one word of its chacha block
+    const uint32   xo          = (uint32)xs[gid];
+    const uint64_t chachaBlock = xo / 16;
+
+    uint32_t j[16];
+    uint32_t s[16];
+
+    #pragma unroll
+    for( int i = 0; i < 16; i++ )
+        j[i] = input[i];
+
+    j[12] = (uint32_t)chachaBlock;
+    j[13] = (uint32_t)(chachaBlock >> 32);
+
+    #pragma unroll
+    for( int i = 0; i < 16; i++ )
+        s[i] = j[i];
+
+    #pragma unroll
+    for( int i = 8; i > 0; i -= 2 )
+    {
+        QUARTERROUND( s[0], s[4], s[8] , s[12] );
+        QUARTERROUND( s[1], s[5], s[9] , s[13] );
+        QUARTERROUND( s[2], s[6], s[10], s[14] );
+        QUARTERROUND( s[3], s[7], s[11], s[15] );
+        QUARTERROUND( s[0], s[5], s[10], s[15] );
+        QUARTERROUND( s[1], s[6], s[11], s[12] );
+        QUARTERROUND( s[2], s[7], s[8] , s[13] );
+        QUARTERROUND( s[3], s[4], s[9] , s[14] );
+    }
+
+    // Select the x's word without indexing the registers dynamically
+    uint32 word = 0;
+
+    #pragma unroll
+    for( int i = 0; i < 16; i++ )
+        word = ( (xo & 15) == (uint32)i ) ? PLUS( s[i], j[i] ) : word;
+
+    outY[gid] = (((uint64)CuBSwap32( word )) << kExtraBits) | (xo >> (32 - kExtraBits));
+    outX[gid] = xo;
+}
+
+//-----------------------------------------------------------
+void CudaGenF1ForXsK32(
+    const uint32* devChaChaInput,
+    const uint64* devXs,
+    const uint32  xCount,
+          uint64* devOutY,
+          uint32* devOutX,
+    cudaStream_t  stream )
+{
+    const uint32 cuThreads = CudaTuning::Profile().f1Threads;
+    const uint32 cuBlocks  = CDiv( xCount, cuThreads );
+
+    chacha8_get_f1_for_xs_cuda_k32<<<cuBlocks, cuThreads, 0, stream>>>(
+        devChaChaInput,
+        devXs,
+        xCount,
+        devOutY,
+        devOutX
+    );
+}
@@ -1,6 +1,6 @@
 #pragma once
 
-#include <cuda_runtime.h>
+#include "GpuRuntime.h"
 
 struct CudaPlotInfo;
 
@@ -12,3 +12,13 @@ void CudaGenF1K32(
           uint64* devOutY,
           uint32* devOutX,
     cudaStream_t  stream );
+
+/// Generates the f1 values of arbitrary k32 x's, such as those of full proofs,
+/// by computing the chacha block of each x in its own thread.
+void CudaGenF1ForXsK32(
+    const uint32* devChaChaInput,
+    const uint64* devXs,
+    const uint32  xCount,
+          uint64* devOutY,
+          uint32* devOutX,
+    cudaStream_t  stream );
@@ -16,7 +16,8 @@ typedef struct { size_t v; } unalignArch;
 __pragma( pack( pop ) )
 #endif
 
-__constant__ unsigned CUDA_FSE_BIT_mask[32];
+// Internal to each translation unit including us, only the encoder uses it
+static __constant__ unsigned CUDA_FSE_BIT_mask[32];
 
 #define CU_FSE_PREFIX(name) FSE_error_##name
 #define CU_FSE_ERROR(name) ((size_t)-CU_FSE_PREFIX(name))
@@ -156,17 +157,18 @@ __device__ size_t CUDA_FSE_compress_usingCTable(
 
     #define FSE_FLUSHBITS(s)  CUDA_BIT_flushBitsFast(s)
 
-    // if (srcSize & 1) 
+    if constexpr ( EntryCount & 1 )
     {
         CUDA_FSE_initCState2(&CState1, ct, *--ip);
         CUDA_FSE_initCState2(&CState2, ct, *--ip);
         CUDA_FSE_encodeSymbol(&bitC, &CState1, *--ip);
         FSE_FLUSHBITS(&bitC);
     } 
-    // else {
-    //     CUDA_FSE_initCState2(&CState2, ct, *--ip);
-    //     CUDA_FSE_initCState2(&CState1, ct, *--ip);
-    // }
+    else
+    {
+        CUDA_FSE_initCState2(&CState2, ct, *--ip);
+        CUDA_FSE_initCState2(&CState1, ct, *--ip);
+    }
 
     /* join to mod 4 */
     srcSize -= 2;
@@ -176,10 +178,15 @@ __device__ size_t CUDA_FSE_compress_usingCTable(
         FSE_FLUSHBITS(&bitC);
     }
 
+    // Symbols left for the loop, after the initial states and the join to mod 4
+    constexpr int32 initCount = ( EntryCount & 1 ) ? 3 : 2;
+    constexpr int32 joinCount = ( ( EntryCount - 2 ) & 2 ) ? 2 : 0;
+    static_assert( ( EntryCount - initCount - joinCount ) % 4 == 0 );
+
     /* 2 or 4 encoding per loop */
     // while ( ip>istart ) 
     #pragma unroll
-    for( int32 i = 0; i < EntryCount / 4; i ++ )
+    for( int32 i = 0; i < ( EntryCount - initCount - joinCount ) / 4; i ++ )
     {
         CUDA_FSE_encodeSymbol(&bitC, &CState2, *--ip);
 
@@ -202,3 +209,190 @@ __device__ size_t CUDA_FSE_compress_usingCTable(
     #undef FSE_FLUSHBITS
     return CUDA_BIT_closeCStream(&bitC);
 }
+
+
+///
+/// Decoding
+/// Device port of FSE_decompress_usingDTable(), for a 64-bit bit container.
+/// The DTable may be in any memory space, the park decoder keeps it in shared memory.
+///
+__device__ __forceinline__ size_t CUDA_MEM_readLEST( const void* ptr ) { return (size_t)((const unalign64*)ptr)->v; }
+
+__device__ __forceinline__ unsigned CUDA_BIT_highbit32( U32 val ) { return 31 - __clz( (int)val ); }
+
+__device__ __forceinline__ size_t CUDA_BIT_initDStream( BIT_DStream_t* bitD, const void* srcBuffer, size_t srcSize )
+{
+    if( srcSize < 1 ) { *bitD = {}; return CU_FSE_ERROR(srcSize_wrong); }
+
+    const byte* src = (const byte*)srcBuffer;
+
+    bitD->start    = (const char*)srcBuffer;
+    bitD->limitPtr = bitD->start + sizeof(bitD->bitContainer);
+
+    const byte lastByte = src[srcSize-1];
+    if( lastByte == 0 )
+        return CU_FSE_ERROR(corruption_detected);   /* endMark not present */
+
+    if( srcSize >= sizeof(bitD->bitContainer) )
+    {
+        bitD->ptr          = (const char*)srcBuffer + srcSize - sizeof(bitD->bitContainer);
+        bitD->bitContainer = CUDA_MEM_readLEST( bitD->ptr );
+        bitD->bitsConsumed = 8 - CUDA_BIT_highbit32( lastByte );
+    }
+    else
+    {
+        bitD->ptr          = bitD->start;
+        bitD->bitContainer = 0;
+
+        for( size_t i = 0; i < srcSize; i++ )
+            bitD->bitContainer |= (size_t)src[i] << ( i * 8 );
+
+        bitD->bitsConsumed  = 8 - CUDA_BIT_highbit32( lastByte );
+        bitD->bitsConsumed += (U32)(sizeof(bitD->bitContainer) - srcSize)*8;
+    }
+
+    return srcSize;
+}
+
+__device__ __forceinline__ size_t CUDA_BIT_lookBits( const BIT_DStream_t* bitD, U32 nbBits )
+{
+    U32 const regMask = sizeof(bitD->bitContainer)*8 - 1;
+    return ((bitD->bitContainer << (bitD->bitsConsumed & regMask)) >> 1) >> ((regMask-nbBits) & regMask);
+}
+
+__device__ __forceinline__ size_t CUDA_BIT_lookBitsFast( const BIT_DStream_t* bitD, U32 nbBits )
+{
+    U32 const regMask = sizeof(bitD->bitContainer)*8 - 1;
+    CUDA_ASSERT( nbBits >= 1 );
+    return (bitD->bitContainer << (bitD->bitsConsumed & regMask)) >> (((regMask+1)-nbBits) & regMask);
+}
+
+__device__ __forceinline__ size_t CUDA_BIT_readBits( BIT_DStream_t* bitD, U32 nbBits )
+{
+    size_t const value = CUDA_BIT_lookBits( bitD, nbBits );
+    bitD->bitsConsumed += nbBits;
+    return value;
+}
+
+__device__ __forceinline__ size_t CUDA_BIT_readBitsFast( BIT_DStream_t* bitD, U32 nbBits )
+{
+    size_t const value = CUDA_BIT_lookBitsFast( bitD, nbBits );
+    bitD->bitsConsumed += nbBits;
+    return value;
+}
+
+__device__ __forceinline__ BIT_DStream_status CUDA_BIT_reloadDStream( BIT_DStream_t* bitD )
+{
+    if( bitD->bitsConsumed > (sizeof(bitD->bitContainer)*8) )  /* overflow detected, like end of stream */
+        return BIT_DStream_overflow;
+
+    if( bitD->ptr >= bitD->limitPtr )
+    {
+        bitD->ptr -= bitD->bitsConsumed >> 3;
+        bitD->bitsConsumed &= 7;
+        bitD->bitContainer = CUDA_MEM_readLEST( bitD->ptr );
+        return BIT_DStream_unfinished;
+    }
+
+    if( bitD->ptr == bitD->start )
+    {
+        if( bitD->bitsConsumed < sizeof(bitD->bitContainer)*8 ) return BIT_DStream_endOfBuffer;
+        return BIT_DStream_completed;
+    }
+
+    /* start < ptr < limitPtr */
+    U32 nbBytes = bitD->bitsConsumed >> 3;
+    BIT_DStream_status result = BIT_DStream_unfinished;
+    if( bitD->ptr - nbBytes < bitD->start )
+    {
+        nbBytes = (U32)(bitD->ptr - bitD->start);  /* ptr > start */
+        result  = BIT_DStream_endOfBuffer;
+    }
+    bitD->ptr          -= nbBytes;
+    bitD->bitsConsumed -= nbBytes*8;
+    bitD->bitContainer  = CUDA_MEM_readLEST( bitD->ptr );
+    return result;
+}
+
+__device__ __forceinline__ void CUDA_FSE_initDState( FSE_DState_t* DStatePtr, BIT_DStream_t* bitD, const FSE_DTable* dt )
+{
+    const FSE_DTableHeader* const DTableH = (const FSE_DTableHeader*)dt;
+    DStatePtr->state = CUDA_BIT_readBits( bitD, DTableH->tableLog );
+    CUDA_BIT_reloadDStream( bitD );
+    DStatePtr->table = dt + 1;
+}
+
+template<bool Fast>
+__device__ __forceinline__ BYTE CUDA_FSE_decodeSymbol( FSE_DState_t* DStatePtr, BIT_DStream_t* bitD )
+{
+    FSE_decode_t const DInfo = ((const FSE_decode_t*)(DStatePtr->table))[DStatePtr->state];
+    U32 const nbBits = DInfo.nbBits;
+    size_t const lowBits = Fast ? CUDA_BIT_readBitsFast( bitD, nbBits ) : CUDA_BIT_readBits( bitD, nbBits );
+
+    DStatePtr->state = DInfo.newState + lowBits;
+    return DInfo.symbol;
+}
+
+// Returns the number of symbols decoded, or an FSE error code
+template<bool Fast>
+__device__ size_t CUDA_FSE_decompress_usingDTable(
+          void* dst, size_t maxDstSize,
+    const void* cSrc, size_t cSrcSize,
+    const FSE_DTable* dt )
+{
+    BYTE* const ostart = (BYTE*)dst;
+    BYTE* op = ostart;
+    BYTE* const omax = op + maxDstSize;
+    BYTE* const olimit = omax-3;
+
+    BIT_DStream_t bitD;
+    FSE_DState_t state1;
+    FSE_DState_t state2;
+
+    /* Init */
+    {
+        const size_t initErr = CUDA_BIT_initDStream( &bitD, cSrc, cSrcSize );
+        if( CUDA_FSE_isError( initErr ) )
+            return initErr;
+    }
+
+    CUDA_FSE_initDState( &state1, &bitD, dt );
+    CUDA_FSE_initDState( &state2, &bitD, dt );
+
+    #define FSE_GETSYMBOL(statePtr) CUDA_FSE_decodeSymbol<Fast>( statePtr, &bitD )
+
+    /* 4 symbols per loop. With a 64-bit container, a reload is only required once per loop. */
+    static_assert( FSE_MAX_TABLELOG*4+7 <= sizeof(bitD.bitContainer)*8 );
+
+    for( ; (CUDA_BIT_reloadDStream( &bitD )==BIT_DStream_unfinished) & (op<olimit) ; op+=4 )
+    {
+        op[0] = FSE_GETSYMBOL( &state1 );
+        op[1] = FSE_GETSYMBOL( &state2 );
+        op[2] = FSE_GETSYMBOL( &state1 );
+        op[3] = FSE_GETSYMBOL( &state2 );
+    }
+
+    /* tail */
+    /* note : BIT_reloadDStream(&bitD) >= FSE_DStream_partiallyFilled; Ends at exactly BIT_DStream_completed */
+    for( ;; )
+    {
+        if( op > (omax-2) ) return CU_FSE_ERROR(dstSize_tooSmall);
+        *op++ = FSE_GETSYMBOL( &state1 );
+        if( CUDA_BIT_reloadDStream( &bitD )==BIT_DStream_overflow )
+        {
+            *op++ = FSE_GETSYMBOL( &state2 );
+            break;
+        }
+
+        if( op > (omax-2) ) return CU_FSE_ERROR(dstSize_tooSmall);
+        *op++ = FSE_GETSYMBOL( &state2 );
+        if( CUDA_BIT_reloadDStream( &bitD )==BIT_DStream_overflow )
+        {
+            *op++ = FSE_GETSYMBOL( &state1 );
+            break;
+        }
+    }
+
+    #undef FSE_GETSYMBOL
+    return (size_t)(op-ostart);
+}
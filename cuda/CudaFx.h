@@ -1,5 +1,5 @@
 #pragma once
-#include <cuda_runtime.h>
+#include "GpuRuntime.h"
 #include "plotting/Tables.h"
 
 struct Pair;
@@ -11,4 +11,21 @@ void CudaFxHarvestK32(
     const Pair*   devPairsIn, 
     const uint64* devYIn,
     const void*   devMetaIn,
-    cudaStream_t  stream );
\ No newline at end of file
+    cudaStream_t  stream );
+
+/// Generates fx for all groups of tables 3 to 6 at once, from the output of CudaHarvestMatchK32Groups(),
+/// where R group i was matched from L groups i*2 and i*2+1. The output of R group i is stored
+/// compacted from index i * matchStride * 2, and its end index is written to devGroupEnd[i].
+void CudaFxHarvestK32Groups(
+    TableId       table,
+    uint64*       devYOut, 
+    void*         devMetaOut,
+    Pair*         devPairsOut,
+    uint32*       devGroupEnd,
+    uint32        groupCount,
+    uint32        matchStride,
+    const uint32* devMatchCounts,
+    const Pair*   devMatchesIn,
+    const uint64* devYIn,
+    const void*   devMetaIn,
+    cudaStream_t  stream );
@@ -0,0 +1,163 @@
+#include "pch.h"
+#include "plotdisk/GpuFxOffload.h"
+#include "CudaFx.h"
+#include "CudaUtil.h"
+#include "util/Log.h"
+
+//-----------------------------------------------------------
+__global__ void ExpandBucketYKernel( uint64* yOut, const uint32* yIn, const uint64 yMask, const uint32 entryCount )
+{
+    const uint32 gid = (uint32)(blockIdx.x * blockDim.x + threadIdx.x);
+
+    if( gid < entryCount )
+        yOut[gid] = yMask | (uint64)yIn[gid];
+}
+
+class CudaFxOffload : public IGpuFxOffload
+{
+public:
+    //-----------------------------------------------------------
+    ~CudaFxOffload() override
+    {
+        if( _stream )
+            cudaStreamDestroy( _stream );
+
+        CudaSafeFree( _devYIn    );
+        CudaSafeFree( _devY      );
+        CudaSafeFree( _devMetaIn );
+        CudaSafeFree( _devPairs  );
+        CudaSafeFree( _devYOut   );
+        CudaSafeFree( _devMetaOut );
+        CudaSafeFreeHost( _hostYOut    );
+        CudaSafeFreeHost( _hostMetaOut );
+    }
+
+    //-----------------------------------------------------------
+    bool Init( const int deviceId, const uint32 maxEntries )
+    {
+        _deviceId   = deviceId;
+        _maxEntries = maxEntries;
+
+        const size_t maxMetaSize = sizeof( K32Meta4 );
+
+        #define CU_INIT( expr ) if( ( cErr = (expr) ) != cudaSuccess ) goto FAIL
+
+        cudaError_t cErr;
+        CU_INIT( cudaSetDevice( deviceId ) );
+        CU_INIT( cudaStreamCreateWithFlags( &_stream, cudaStreamNonBlocking ) );
+
+        CU_INIT( CudaCallocT( _devYIn    , maxEntries ) );
+        CU_INIT( CudaCallocT( _devY      , maxEntries ) );
+        CU_INIT( CudaCallocT( _devMetaIn , maxEntries * maxMetaSize ) );
+        CU_INIT( CudaCallocT( _devPairs  , maxEntries ) );
+        CU_INIT( CudaCallocT( _devYOut   , maxEntries ) );
+        CU_INIT( CudaCallocT( _devMetaOut, maxEntries * maxMetaSize ) );
+
+        CU_INIT( cudaMallocHost( (void**)&_hostYOut   , maxEntries * sizeof( uint64 ) ) );
+        CU_INIT( cudaMallocHost( (void**)&_hostMetaOut, maxEntries * maxMetaSize ) );
+
+        #undef CU_INIT
+        return true;
+
+    FAIL:
+        Log::Line( "Failed to initialize the GPU fx offload on device %d with CUDA error '%s': %s",
+                   deviceId, cudaGetErrorName( cErr ), cudaGetErrorString( cErr ) );
+        return false;
+    }
+
+    //-----------------------------------------------------------
+    bool GenFx( const TableId rTable, const uint64 yMask, const uint32 entryCount, const uint32* yIn,
+                const void* metaIn, const size_t metaInSize, const size_t metaOutSize,
+                const Span<Pair>* pairSlices, const uint32 sliceCount, const uint32 matchCount ) override
+    {
+        ASSERT( entryCount <= _maxEntries );
+        ASSERT( matchCount <= _maxEntries );
+
+        if( matchCount == 0 )
+            return true;
+
+        // The plotter's threads call us from a lock block, so the device may have been changed in between
+        cudaError_t cErr = cudaSetDevice( _deviceId );
+
+        if( cErr == cudaSuccess )
+            cErr = cudaMemcpyAsync( _devYIn, yIn, entryCount * sizeof( uint32 ), cudaMemcpyHostToDevice, _stream );
+        if( cErr == cudaSuccess )
+            cErr = cudaMemcpyAsync( _devMetaIn, metaIn, entryCount * metaInSize, cudaMemcpyHostToDevice, _stream );
+
+        // Gather the matches of all threads
+        for( uint32 i = 0, offset = 0; i < sliceCount && offset < matchCount && cErr == cudaSuccess; i++ )
+        {
+            const uint32 count = std::min( (uint32)pairSlices[i].Length(), matchCount - offset );
+
+            if( count > 0 )
+                cErr = cudaMemcpyAsync( _devPairs + offset, pairSlices[i].Ptr(), count * sizeof( Pair ), cudaMemcpyHostToDevice, _stream );
+
+            offset += count;
+        }
+
+        if( cErr != cudaSuccess )
+            return Fail( cErr );
+
+        const uint32 kthreads = 256;
+        ExpandBucketYKernel<<<CDiv( entryCount, kthreads ), kthreads, 0, _stream>>>( _devY, _devYIn, yMask, entryCount );
+
+        CudaFxHarvestK32( rTable, _devYOut, rTable < TableId::Table7 ? _devMetaOut : nullptr,
+                          matchCount, _devPairs, _devY, _devMetaIn, _stream );
+
+        cErr = cudaMemcpyAsync( _hostYOut, _devYOut, matchCount * sizeof( uint64 ), cudaMemcpyDeviceToHost, _stream );
+
+        if( cErr == cudaSuccess && rTable < TableId::Table7 )
+            cErr = cudaMemcpyAsync( _hostMetaOut, _devMetaOut, matchCount * metaOutSize, cudaMemcpyDeviceToHost, _stream );
+
+        if( cErr == cudaSuccess )
+            cErr = cudaStreamSynchronize( _stream );
+
+        return cErr == cudaSuccess ? true : Fail( cErr );
+    }
+
+    //-----------------------------------------------------------
+    const uint64* OutY()    const override { return _hostYOut; }
+    const void*   OutMeta() const override { return _hostMetaOut; }
+
+private:
+    //-----------------------------------------------------------
+    bool Fail( const cudaError_t cErr )
+    {
+        Log::Line( "GPU fx offload failed with CUDA error '%s': %s", cudaGetErrorName( cErr ), cudaGetErrorString( cErr ) );
+        return false;
+    }
+
+private:
+    int          _deviceId    = 0;
+    uint32       _maxEntries  = 0;
+    cudaStream_t _stream      = nullptr;
+
+    uint32*      _devYIn      = nullptr;
+    uint64*      _devY        = nullptr;
+    byte*        _devMetaIn   = nullptr;
+    Pair*        _devPairs    = nullptr;
+    uint64*      _devYOut     = nullptr;
+    byte*        _devMetaOut  = nullptr;
+
+    uint64*      _hostYOut    = nullptr;
+    byte*        _hostMetaOut = nullptr;
+};
+
+/// Declared in GpuFxOffload.h
+//-----------------------------------------------------------
+IGpuFxOffload* CudaFxOffloadFactory::Create( const uint32 deviceIndex, const uint32 maxEntries )
+{
+    int deviceCount = 0;
+    if( cudaGetDeviceCount( &deviceCount ) != cudaSuccess || (int)deviceIndex >= deviceCount )
+        return nullptr;
+
+    auto* offload = new CudaFxOffload();
+
+    if( !offload->Init( (int)deviceIndex, maxEntries ) )
+    {
+        delete offload;
+        return nullptr;
+    }
+
+    return offload;
+}
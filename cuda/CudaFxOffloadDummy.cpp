@@ -0,0 +1,7 @@
+#include "plotdisk/GpuFxOffload.h"
+
+/// Dummy function for when CUDA is not available
+IGpuFxOffload* CudaFxOffloadFactory::Create( const uint32 deviceIndex, const uint32 maxEntries )
+{
+    return nullptr;
+}
@@ -233,16 +233,17 @@ __global__ void MatchCudaK32Bucket( const uint64 bucketMask, const uint32 entryC
 /// vs the way is imlpemented in plotting where the group
 /// sizes are exploited.
 //-----------------------------------------------------------
-__global__ void HarvestMatchK32Kernel(
+__device__ __forceinline__ void HarvestMatchK32Block(
           Pair*   gOutMatches,
           uint32* gOutMatchCount,
+    const uint32  maxMatches,
     const uint64* yEntries,
     const uint32  entryCount,
-    const uint32  matchOffset
+    const uint32  matchOffset,
+    const uint32  yIdx
 )
 {
     const uint32 id   = threadIdx.x;
-    const uint32 yIdx = blockIdx.x;
     const uint32 gid  = yIdx + id;
 
     CUDA_ASSERT( id < 64 );
@@ -350,7 +351,47 @@ __global__ void HarvestMatchK32Kernel(
     const uint32 out = sharedMatchCount + offset;
 
     for( uint32 i = 0; i < matchCount; i++ )
-        gOutMatches[out+i] = matches[i];
+    {
+        if( out+i < maxMatches )
+            gOutMatches[out+i] = matches[i];
+    }
+}
+
+//-----------------------------------------------------------
+__global__ void HarvestMatchK32Kernel(
+          Pair*   gOutMatches,
+          uint32* gOutMatchCount,
+    const uint64* yEntries,
+    const uint32  entryCount,
+    const uint32  matchOffset
+)
+{
+    HarvestMatchK32Block( gOutMatches, gOutMatchCount, 0xFFFFFFFF, yEntries, entryCount, matchOffset, blockIdx.x );
+}
+
+/// Same as HarvestMatchK32Kernel, but matches all groups of a table at once,
+/// where blockIdx.y is the group. The group bounds are read from device memory,
+/// so blocks past the end of their group simply exit.
+/// The matches of each group are stored in their own slot of matchStride entries.
+//-----------------------------------------------------------
+__global__ void HarvestMatchK32GroupsKernel(
+          Pair*   gOutMatches,
+          uint32* gOutMatchCounts,
+    const uint32  matchStride,
+    const uint64* yEntries,
+    const uint32* gGroupBegin,
+    const uint32* gGroupEnd
+)
+{
+    const uint32 group      = blockIdx.y;
+    const uint32 begin      = gGroupBegin[group];
+    const uint32 entryCount = gGroupEnd[group] - begin;
+
+    if( blockIdx.x + 1 >= entryCount )
+        return;
+
+    HarvestMatchK32Block( gOutMatches + (size_t)group * matchStride, gOutMatchCounts + group, matchStride,
+                          yEntries + begin, entryCount, begin, blockIdx.x );
 }
 
 //-----------------------------------------------------------
@@ -581,16 +622,37 @@ cudaError CudaHarvestMatchK32(
 
 
 //-----------------------------------------------------------
-void CudaMatchBucketizedK32( 
+cudaError CudaHarvestMatchK32Groups(
+    Pair*         devOutPairs,
+    uint32*       devMatchCounts,
+    const uint32  matchStride,
+    const uint64* devYEntries,
+    const uint32* devGroupBegin,
+    const uint32* devGroupEnd,
+    const uint32  groupCount,
+    const uint32  maxGroupEntries,
+    cudaStream_t  stream )
+{
+    cudaError cErr = cudaMemsetAsync( devMatchCounts, 0, sizeof( uint32 ) * groupCount, stream );
+    if( cErr != cudaSuccess || maxGroupEntries < 2 )
+        return cErr;
+
+    const dim3 kblocks( maxGroupEntries-1, groupCount );
+
+    HarvestMatchK32GroupsKernel<<<kblocks, 64, 0, stream>>>(
+        devOutPairs, devMatchCounts, matchStride, devYEntries, devGroupBegin, devGroupEnd );
+
+    return cudaSuccess;
+}
+
+//-----------------------------------------------------------
+static void LaunchMatchBucketK32( 
     CudaK32PlotContext& cx,
     const uint32*       devY,
-    cudaStream_t        stream,
-    cudaEvent_t         event )
+    const uint32        entryCount,
+    const uint64        bucketMask,
+    cudaStream_t        stream )
 {
-    const TableId inTable    = cx.table - 1;
-    const uint32  entryCount = cx.bucketCounts[(int)inTable][cx.bucket];
-    const uint64  bucketMask = BBC_BUCKET_MASK( cx.bucket );
-
     constexpr uint32 kscanblocks = CuCDiv( BBCU_BUCKET_ALLOC_ENTRY_COUNT, BBCU_SCAN_GROUP_THREADS );
 
     uint32* tmpGroupCounts = (uint32*)cx.devMatches;
@@ -621,6 +683,128 @@ void CudaMatchBucketizedK32(
     MatchCudaK32Bucket<<<BBCU_MAX_GROUP_COUNT, BBCU_THREADS_PER_MATCH_GROUP, 0, stream>>>( bucketMask, entryCount, cx.devGroupCount, devY, cx.devGroupBoundaries, cx.devMatchCount, cx.devMatches );
 }
 
+#if BBCU_USE_MATCH_GRAPH
+
+///
+/// The match sequence is the same for every bucket, except for the entry count and bucket mask.
+/// It is captured into a graph once per input buffer, and then for each bucket only the
+/// arguments of the kernels consuming those values are patched before launching it.
+///
+struct CudaK32MatchGraph
+{
+    cudaGraph_t     graph            = nullptr;
+    cudaGraphExec_t exec             = nullptr;
+    cudaGraphNode_t firstAndLastNode = nullptr;
+    cudaGraphNode_t scanNode         = nullptr;
+    cudaGraphNode_t matchNode        = nullptr;
+    const uint32*   devY             = nullptr;   // Input the graph was captured with
+};
+
+//-----------------------------------------------------------
+static void CaptureMatchGraph( CudaK32PlotContext& cx, CudaK32MatchGraph& g, const uint32* devY, cudaStream_t stream )
+{
+    if( g.exec )
+    {
+        CudaErrCheck( cudaGraphExecDestroy( g.exec ) );
+        CudaErrCheck( cudaGraphDestroy( g.graph ) );
+        g = {};
+    }
+
+    // Capture with placeholder values, they get replaced before each launch
+    CudaErrCheck( cudaStreamBeginCapture( stream, cudaStreamCaptureModeThreadLocal ) );
+    LaunchMatchBucketK32( cx, devY, 0, 0, stream );
+    CudaErrCheck( cudaStreamEndCapture( stream, &g.graph ) );
+
+    size_t nodeCount = 0;
+    CudaErrCheck( cudaGraphGetNodes( g.graph, nullptr, &nodeCount ) );
+
+    cudaGraphNode_t nodes[64];
+    FatalIf( nodeCount > sizeof( nodes ) / sizeof( nodes[0] ), "Unexpected match graph node count %llu.", (llu)nodeCount );
+    CudaErrCheck( cudaGraphGetNodes( g.graph, nodes, &nodeCount ) );
+
+    for( size_t i = 0; i < nodeCount; i++ )
+    {
+        cudaGraphNodeType type;
+        CudaErrCheck( cudaGraphNodeGetType( nodes[i], &type ) );
+        if( type != cudaGraphNodeTypeKernel )
+            continue;
+
+        cudaKernelNodeParams params = {};
+        CudaErrCheck( cudaGraphKernelNodeGetParams( nodes[i], &params ) );
+
+        if( params.func == (void*)CudaSetFirstAndLastGroup )
+            g.firstAndLastNode = nodes[i];
+        else if( params.func == (void*)ScanGroupsCudaK32Bucket )
+            g.scanNode = nodes[i];
+        else if( params.func == (void*)MatchCudaK32Bucket )
+            g.matchNode = nodes[i];
+    }
+
+    FatalIf( !g.firstAndLastNode || !g.scanNode || !g.matchNode, "Failed to find match kernels in captured graph." );
+
+    #if CUDART_VERSION >= 12000
+        CudaErrCheck( cudaGraphInstantiate( &g.exec, g.graph, 0 ) );
+    #else
+        CudaErrCheck( cudaGraphInstantiate( &g.exec, g.graph, nullptr, nullptr, 0 ) );
+    #endif
+
+    g.devY = devY;
+}
+
+//-----------------------------------------------------------
+static void SetMatchGraphKernelArgs( CudaK32MatchGraph& g, cudaGraphNode_t node, void** args )
+{
+    cudaKernelNodeParams params = {};
+    CudaErrCheck( cudaGraphKernelNodeGetParams( node, &params ) );
+
+    params.kernelParams = args;
+    params.extra        = nullptr;
+    CudaErrCheck( cudaGraphExecKernelNodeSetParams( g.exec, node, &params ) );
+}
+
+#endif // BBCU_USE_MATCH_GRAPH
+
+//-----------------------------------------------------------
+void CudaMatchBucketizedK32( 
+    CudaK32PlotContext& cx,
+    const uint32*       devY,
+    cudaStream_t        stream,
+    cudaEvent_t         event )
+{
+    const TableId inTable    = cx.table - 1;
+    const uint32  entryCount = cx.bucketCounts[(int)inTable][cx.bucket];
+    const uint64  bucketMask = BBC_BUCKET_MASK( cx.bucket );
+
+#if BBCU_USE_MATCH_GRAPH
+    if( cx.matchGraph == nullptr )
+        cx.matchGraph = new CudaK32MatchGraph{};
+
+    auto& g = *cx.matchGraph;
+    if( g.devY != devY )
+        CaptureMatchGraph( cx, g, devY, stream );
+
+    uint32*       tmpGroupCounts = (uint32*)cx.devMatches;
+    uint32*       scanGroups     = tmpGroupCounts + 2;
+    const uint32* groupCount     = cx.devGroupCount;
+    const uint32* groupBounds    = cx.devGroupBoundaries;
+    Pair*         matches        = cx.devMatches;
+    uint32        ecount         = entryCount;
+    uint64        mask           = bucketMask;
+
+    void* firstAndLastArgs[] = { &tmpGroupCounts, &ecount };
+    void* scanArgs[]         = { (void*)&devY, &scanGroups, &cx.devGroupCount, &ecount, &mask };
+    void* matchArgs[]        = { &mask, &ecount, (void*)&groupCount, (void*)&devY, (void*)&groupBounds, &cx.devMatchCount, &matches };
+
+    SetMatchGraphKernelArgs( g, g.firstAndLastNode, firstAndLastArgs );
+    SetMatchGraphKernelArgs( g, g.scanNode        , scanArgs         );
+    SetMatchGraphKernelArgs( g, g.matchNode       , matchArgs        );
+
+    CudaErrCheck( cudaGraphLaunch( g.exec, stream ) );
+#else
+    LaunchMatchBucketK32( cx, devY, entryCount, bucketMask, stream );
+#endif
+}
+
 //-----------------------------------------------------------
 // cudaError CudaHarvestMatchK32WithGroupScan(
 //     Pair*         devOutPairs,
@@ -1,5 +1,5 @@
 #pragma once
-#include <cuda_runtime.h>
+#include "GpuRuntime.h"
 
 /// Unbucketized CUDA-based matching function for k32 compressed plots.
 /// This method is meant to only be used with compressed plots.
@@ -12,6 +12,21 @@ cudaError CudaHarvestMatchK32(
     const uint32  matchOffset,
     cudaStream_t  stream );
 
+/// Matches all groups of a compressed k32 table in a single launch, without the host
+/// needing to know the group sizes. Each group's y entries lie in [devGroupBegin[i], devGroupEnd[i]),
+/// and its matches are stored at devOutPairs + i * matchStride, with their count in devMatchCounts[i].
+/// Matches past matchStride are dropped, but still counted, so that the caller can detect it.
+cudaError CudaHarvestMatchK32Groups(
+    struct Pair*  devOutPairs,
+    uint32*       devMatchCounts,
+    const uint32  matchStride,
+    const uint64* devYEntries,
+    const uint32* devGroupBegin,
+    const uint32* devGroupEnd,
+    const uint32  groupCount,
+    const uint32  maxGroupEntries,
+    cudaStream_t  stream );
+
 /// Unbucketized CUDA-based matching function, specifically for k32.
 /// The matches are deterministic. That is, you will always get the 
 /// same matches given the same input, though the order of the 
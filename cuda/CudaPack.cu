@@ -0,0 +1,81 @@
+#include "CudaUtil.h"
+#include "CudaPlotConfig.h"
+#include "CudaPack.h"
+
+#define BBCU_UNPACK_THREADS     256
+#define BBCU_UNPACK_MAX_BLOCKS  1024
+
+//-----------------------------------------------------------
+template<typename T, bool Gather>
+__global__ void CudaUnpackSlicesKernel( const uint64* packed, const uint32* sliceCounts, const uint32 countStride, const uint32 bitCount,
+                                        const uint32 entryCount, T* out, const uint32* gatherIdx, const T orMask )
+{
+    __shared__ uint32 entryOffsets[BBCU_BUCKET_COUNT+1];
+    __shared__ uint32 wordOffsets [BBCU_BUCKET_COUNT];
+
+    const uint32 id = threadIdx.x;
+
+    if( id == 0 )
+    {
+        uint32 entries = 0;
+        uint32 words   = 0;
+
+        for( uint32 i = 0; i < BBCU_BUCKET_COUNT; i++ )
+        {
+            const uint32 count = sliceCounts[i * countStride];
+
+            entryOffsets[i] = entries;
+            wordOffsets [i] = words;
+
+            entries += count;
+            words   += CudaPackedSliceWordCount( count, bitCount );
+        }
+
+        entryOffsets[BBCU_BUCKET_COUNT] = entries;
+    }
+    __syncthreads();
+
+    for( uint32 i = blockIdx.x * blockDim.x + id; i < entryCount; i += gridDim.x * blockDim.x )
+    {
+        uint32 entry = i;
+        if constexpr ( Gather )
+            entry = gatherIdx[i];
+
+        CUDA_ASSERT( entry < entryOffsets[BBCU_BUCKET_COUNT] );
+
+        // Find the slice this entry belongs to
+        uint32 lo = 0, hi = BBCU_BUCKET_COUNT;
+        while( hi - lo > 1 )
+        {
+            const uint32 mid = ( lo + hi ) >> 1;
+
+            if( entryOffsets[mid] <= entry )
+                lo = mid;
+            else
+                hi = mid;
+        }
+
+        out[i] = (T)CudaPackedSliceRead( packed + wordOffsets[lo], entry - entryOffsets[lo], bitCount ) | orMask;
+    }
+}
+
+//-----------------------------------------------------------
+template<typename T>
+void CudaUnpackSlices( const uint64* devPacked, const uint32* devSliceCounts, const uint32 countStride, const uint32 bitCount,
+                       const uint32 entryCount, T* devOut, cudaStream_t stream, const uint32* devGatherIdx, const T orMask )
+{
+    ASSERT( bitCount > 0 && bitCount < 64 );
+
+    if( entryCount < 1 )
+        return;
+
+    const uint32 blocks = std::min( CDiv( entryCount, BBCU_UNPACK_THREADS ), (uint32)BBCU_UNPACK_MAX_BLOCKS );
+
+    if( devGatherIdx )
+        CudaUnpackSlicesKernel<T, true><<<blocks, BBCU_UNPACK_THREADS, 0, stream>>>( devPacked, devSliceCounts, countStride, bitCount, entryCount, devOut, devGatherIdx, orMask );
+    else
+        CudaUnpackSlicesKernel<T, false><<<blocks, BBCU_UNPACK_THREADS, 0, stream>>>( devPacked, devSliceCounts, countStride, bitCount, entryCount, devOut, nullptr, orMask );
+}
+
+template void CudaUnpackSlices<uint16>( const uint64*, const uint32*, uint32, uint32, uint32, uint16*, cudaStream_t, const uint32*, uint16 );
+template void CudaUnpackSlices<uint32>( const uint64*, const uint32*, uint32, uint32, uint32, uint32*, cudaStream_t, const uint32*, uint32 );
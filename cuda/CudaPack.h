@@ -0,0 +1,57 @@
+#pragma once
+#include "GpuRuntime.h"
+
+/// Fixed bit-width packing of bucket slices.
+/// Each slice is packed independently, as a little-endian bit stream of 64-bit words,
+/// so that slices can still be transferred and compacted on a per-slice basis.
+
+// Matching limits groups to BBCU_THREADS_PER_MATCH_GROUP (352) entries,
+// so the R pair delta is always below 704.
+#define BBCU_PACKED_PAIR_R_BITS     10u
+
+// Table 7 y's bucket bits are implied by the bucket they are stored in.
+#define BBCU_PACKED_Y_T7_BITS       (BBC_BUCKET_SHIFT_T7)
+
+/// Number of 64-bit words required to pack entryCount entries of bitCount bits.
+__host__ __device__ inline uint32 CudaPackedSliceWordCount( const uint32 entryCount, const uint32 bitCount )
+{
+    return (uint32)( ( (uint64)entryCount * bitCount + 63 ) / 64 );
+}
+
+/// Writes an entry to a packed slice. The slice must be zeroed beforehand.
+/// Entries may be written in any order and concurrently.
+__device__ inline void CudaPackedSliceWrite( uint64* slice, const uint32 index, const uint32 bitCount, const uint64 value )
+{
+    const uint64 bit   = (uint64)index * bitCount;
+    const uint64 word  = bit >> 6;
+    const uint32 shift = (uint32)( bit & 63 );
+
+    atomicOr( (unsigned long long*)&slice[word], (unsigned long long)( value << shift ) );
+
+    if( shift + bitCount > 64 )
+        atomicOr( (unsigned long long*)&slice[word+1], (unsigned long long)( value >> ( 64 - shift ) ) );
+}
+
+/// Reads an entry from a packed slice.
+__device__ inline uint64 CudaPackedSliceRead( const uint64* slice, const uint32 index, const uint32 bitCount )
+{
+    const uint64 bit   = (uint64)index * bitCount;
+    const uint64 word  = bit >> 6;
+    const uint32 shift = (uint32)( bit & 63 );
+
+    uint64 value = slice[word] >> shift;
+
+    if( shift + bitCount > 64 )
+        value |= slice[word+1] << ( 64 - shift );
+
+    return value & ( ( 1ull << bitCount ) - 1 );
+}
+
+/// Unpacks a bucket made of BBCU_BUCKET_COUNT packed slices, uploaded back-to-back (compacted).
+/// The slice entry counts are read from devSliceCounts[slice * countStride].
+/// If devGatherIdx is given, devOut[i] is the entry at devGatherIdx[i], so that unpacking
+/// and sorting by a key happen in the same pass. orMask is or'ed onto every unpacked entry.
+template<typename T>
+void CudaUnpackSlices( const uint64* devPacked, const uint32* devSliceCounts, uint32 countStride, uint32 bitCount,
+                       uint32 entryCount, T* devOut, cudaStream_t stream,
+                       const uint32* devGatherIdx = nullptr, T orMask = 0 );
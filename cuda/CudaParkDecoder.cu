@@ -0,0 +1,207 @@
+#include "pch.h"
+#include "plotting/GpuParkDecoder.h"
+#include "CudaFSE.cuh"
+#include "CudaUtil.h"
+#include "util/Log.h"
+
+static constexpr uint32 DTableMaxSize = (uint32)FSE_DTABLE_SIZE( FSE_MAX_TABLELOG );
+
+//-----------------------------------------------------------
+__global__ void CudaDecodeParkDeltas( const uint32 parkCount, const FSE_DTable* gDTable, const uint32 dTableWords,
+                                      const byte* sections, const uint32 sectionStride, const uint16* sectionSizes,
+                                      byte* deltas, uint64* deltaCounts )
+{
+    extern __shared__ uint32 sDTable[];
+
+    // All the parks of the batch share the table's DTable
+    for( uint32 i = threadIdx.x; i < dTableWords; i += blockDim.x )
+        sDTable[i] = gDTable[i];
+
+    __syncthreads();
+
+    const uint32 park = blockIdx.x * blockDim.x + threadIdx.x;
+    if( park >= parkCount )
+        return;
+
+    const FSE_DTable* dt      = (const FSE_DTable*)sDTable;
+    const byte*       src     = sections + (size_t)park * sectionStride;
+    const size_t      srcSize = sectionSizes[park];
+          byte*       dst     = deltas + (size_t)park * IGpuParkDecoder::MaxDeltasPerPark;
+
+    deltaCounts[park] = ((const FSE_DTableHeader*)dt)->fastMode ?
+        CUDA_FSE_decompress_usingDTable<true> ( dst, IGpuParkDecoder::MaxDeltasPerPark, src, srcSize, dt ) :
+        CUDA_FSE_decompress_usingDTable<false>( dst, IGpuParkDecoder::MaxDeltasPerPark, src, srcSize, dt );
+}
+
+class CudaParkDecoder : public IGpuParkDecoder
+{
+public:
+    //-----------------------------------------------------------
+    ~CudaParkDecoder() override
+    {
+        if( _stream )
+            cudaStreamDestroy( _stream );
+
+        CudaSafeFree( _devDTable );
+        CudaSafeFree( _devSections );
+        CudaSafeFree( _devSectionSizes );
+        CudaSafeFree( _devDeltas );
+        CudaSafeFree( _devDeltaCounts );
+        CudaSafeFreeHost( _hostSections );
+        CudaSafeFreeHost( _hostSectionSizes );
+        CudaSafeFreeHost( _hostDeltas );
+        CudaSafeFreeHost( _hostDeltaCounts );
+    }
+
+    //-----------------------------------------------------------
+    bool Init( const int deviceId, const uint32 maxParks, const uint32 maxSectionSize )
+    {
+        _deviceId       = deviceId;
+        _maxParks       = maxParks;
+        _maxSectionSize = maxSectionSize;
+
+        const size_t sectionsSize = (size_t)maxParks * maxSectionSize;
+        const size_t deltasSize   = (size_t)maxParks * MaxDeltasPerPark;
+
+        #define CU_INIT( expr ) if( ( cErr = (expr) ) != cudaSuccess ) goto FAIL
+
+        cudaError_t cErr;
+        CU_INIT( cudaSetDevice( deviceId ) );
+        CU_INIT( cudaStreamCreateWithFlags( &_stream, cudaStreamNonBlocking ) );
+
+        // The largest DTables don't fit in the default 48KiB of shared memory
+        CU_INIT( cudaFuncSetAttribute( CudaDecodeParkDeltas, cudaFuncAttributeMaxDynamicSharedMemorySize, (int)DTableMaxSize ) );
+
+        CU_INIT( CudaCallocT( _devDTable      , DTableMaxSize / sizeof( FSE_DTable ) ) );
+        CU_INIT( CudaCallocT( _devSections    , sectionsSize ) );
+        CU_INIT( CudaCallocT( _devSectionSizes, maxParks ) );
+        CU_INIT( CudaCallocT( _devDeltas      , deltasSize ) );
+        CU_INIT( CudaCallocT( _devDeltaCounts , maxParks ) );
+
+        CU_INIT( cudaMallocHost( (void**)&_hostSections    , sectionsSize ) );
+        CU_INIT( cudaMallocHost( (void**)&_hostSectionSizes, maxParks * sizeof( uint16 ) ) );
+        CU_INIT( cudaMallocHost( (void**)&_hostDeltas      , deltasSize ) );
+        CU_INIT( cudaMallocHost( (void**)&_hostDeltaCounts , maxParks * sizeof( uint64 ) ) );
+
+        #undef CU_INIT
+        return true;
+
+    FAIL:
+        Log::Line( "Failed to initialize the GPU park decoder on device %d with CUDA error '%s': %s",
+                   deviceId, cudaGetErrorName( cErr ), cudaGetErrorString( cErr ) );
+        return false;
+    }
+
+    //-----------------------------------------------------------
+    uint32  MaxParks()       const override { return _maxParks; }
+    uint32  MaxSectionSize() const override { return _maxSectionSize; }
+    byte*   Sections()             override { return _hostSections; }
+    uint16* SectionSizes()         override { return _hostSectionSizes; }
+
+    //-----------------------------------------------------------
+    bool Decode( const FSE_DTable* dTable, const uint32 parkCount ) override
+    {
+        ASSERT( dTable );
+        ASSERT( parkCount <= _maxParks );
+
+        if( parkCount == 0 )
+            return true;
+
+        const uint32 tableLog = ((const FSE_DTableHeader*)dTable)->tableLog;
+        if( tableLog > FSE_MAX_TABLELOG )
+        {
+            Log::Line( "GPU park decoder: Unsupported FSE table log %u.", tableLog );
+            return false;
+        }
+
+        // Sizes past the stride would read other parks' sections, mark them as corrupt instead
+        for( uint32 i = 0; i < parkCount; i++ )
+        {
+            if( _hostSectionSizes[i] > _maxSectionSize )
+                _hostSectionSizes[i] = 0;
+        }
+
+        cudaError_t cErr = cudaSetDevice( _deviceId );
+
+        // The DTables are cached for the lifetime of the process, so a table is only uploaded when it changes
+        const uint32 dTableWords = (uint32)FSE_DTABLE_SIZE_U32( tableLog );
+
+        if( cErr == cudaSuccess && dTable != _dTable )
+        {
+            cErr = cudaMemcpyAsync( _devDTable, dTable, dTableWords * sizeof( FSE_DTable ), cudaMemcpyHostToDevice, _stream );
+            _dTable = cErr == cudaSuccess ? dTable : nullptr;
+        }
+
+        if( cErr == cudaSuccess )
+            cErr = cudaMemcpyAsync( _devSections, _hostSections, (size_t)parkCount * _maxSectionSize, cudaMemcpyHostToDevice, _stream );
+        if( cErr == cudaSuccess )
+            cErr = cudaMemcpyAsync( _devSectionSizes, _hostSectionSizes, parkCount * sizeof( uint16 ), cudaMemcpyHostToDevice, _stream );
+
+        if( cErr != cudaSuccess )
+            return Fail( cErr );
+
+        const uint32 kThreads = 256;
+        CudaDecodeParkDeltas<<<CDiv( parkCount, kThreads ), kThreads, dTableWords * sizeof( FSE_DTable ), _stream>>>(
+            parkCount, _devDTable, dTableWords, _devSections, _maxSectionSize, _devSectionSizes, _devDeltas, _devDeltaCounts );
+
+        cErr = cudaGetLastError();
+
+        if( cErr == cudaSuccess )
+            cErr = cudaMemcpyAsync( _hostDeltaCounts, _devDeltaCounts, parkCount * sizeof( uint64 ), cudaMemcpyDeviceToHost, _stream );
+        if( cErr == cudaSuccess )
+            cErr = cudaMemcpyAsync( _hostDeltas, _devDeltas, (size_t)parkCount * MaxDeltasPerPark, cudaMemcpyDeviceToHost, _stream );
+        if( cErr == cudaSuccess )
+            cErr = cudaStreamSynchronize( _stream );
+
+        return cErr == cudaSuccess ? true : Fail( cErr );
+    }
+
+    //-----------------------------------------------------------
+    const byte*   Deltas()      const override { return _hostDeltas; }
+    const uint64* DeltaCounts() const override { return _hostDeltaCounts; }
+
+private:
+    //-----------------------------------------------------------
+    bool Fail( const cudaError_t cErr )
+    {
+        Log::Line( "GPU park decoding failed with CUDA error '%s': %s", cudaGetErrorName( cErr ), cudaGetErrorString( cErr ) );
+        return false;
+    }
+
+private:
+    int               _deviceId        = 0;
+    uint32            _maxParks        = 0;
+    uint32            _maxSectionSize  = 0;
+    cudaStream_t      _stream          = nullptr;
+    const FSE_DTable* _dTable          = nullptr;  // Host DTable currently on the device
+
+    FSE_DTable*       _devDTable       = nullptr;
+    byte*             _devSections     = nullptr;
+    uint16*           _devSectionSizes = nullptr;
+    byte*             _devDeltas       = nullptr;
+    uint64*           _devDeltaCounts  = nullptr;
+
+    byte*             _hostSections     = nullptr;
+    uint16*           _hostSectionSizes = nullptr;
+    byte*             _hostDeltas       = nullptr;
+    uint64*           _hostDeltaCounts  = nullptr;
+};
+
+/// Declared in GpuParkDecoder.h
+//-----------------------------------------------------------
+IGpuParkDecoder* CudaParkDecoderFactory::Create( const uint32 deviceIndex, const uint32 maxParks, const uint32 maxSectionSize )
+{
+    int deviceCount = 0;
+    if( cudaGetDeviceCount( &deviceCount ) != cudaSuccess || (int)deviceIndex >= deviceCount )
+        return nullptr;
+
+    auto* decoder = new CudaParkDecoder();
+
+    if( !decoder->Init( (int)deviceIndex, maxParks, maxSectionSize ) )
+    {
+        delete decoder;
+        return nullptr;
+    }
+
+    return decoder;
+}
@@ -0,0 +1,7 @@
+#include "plotting/GpuParkDecoder.h"
+
+/// Dummy function for when CUDA is not available
+IGpuParkDecoder* CudaParkDecoderFactory::Create( const uint32 deviceIndex, const uint32 maxParks, const uint32 maxSectionSize )
+{
+    return nullptr;
+}
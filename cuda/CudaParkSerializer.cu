@@ -1,5 +1,7 @@
 #include "CudaParkSerializer.h"
 #include "CudaFSE.cuh"
+#include "plotting/ParkCoding.h"
+#include "CudaTuning.h"
 
 
 //-----------------------------------------------------------
@@ -28,18 +30,36 @@ void InitFSEBitMask( CudaK32PlotContext& cx )
 //-----------------------------------------------------------
 void CompressToParkInGPU( const uint32 parkCount, const size_t parkSize, 
     uint64* devLinePoints, byte* devParkBuffer, const size_t parkBufferSize, 
-    const uint32 stubBitSize, const FSE_CTable* devCTable, uint32* devParkOverrunCount, cudaStream_t stream )
+    const uint32 stubBitSize, const FSE_CTable* devCTable, uint32* devParkOverrunCount,
+    const ParkDeltaCoding deltaCoding, const RANSEncTable* devRANSTable, cudaStream_t stream )
 {
-    const uint32 kThreadCount = 256;
+    const uint32 kThreadCount = CudaTuning::Profile().parkThreads;
     const uint32 kBlocks      = CDivT( parkCount, kThreadCount );
-    CudaCompressToPark<<<kBlocks, kThreadCount, 0, stream>>>( parkCount, parkSize, devLinePoints, devParkBuffer, parkBufferSize, stubBitSize, devCTable, devParkOverrunCount );
+    CudaCompressToPark<<<kBlocks, kThreadCount, 0, stream>>>( parkCount, parkSize, devLinePoints, devParkBuffer, parkBufferSize, stubBitSize, devCTable, devParkOverrunCount,
+                                                              deltaCoding, devRANSTable );
+}
+
+// Compresses one of the interleaved delta streams, and writes its size to sizeWriter as LE.
+// Returns the end of the stream.
+//-----------------------------------------------------------
+template<int32 EntryCount>
+__device__ __forceinline__ byte* CudaCompressDeltaStream( byte* sizeWriter, byte* streamWriter, const byte* deltas, const FSE_CTable* cTable )
+{
+    const size_t size = CUDA_FSE_compress_usingCTable<EntryCount>( streamWriter, EntryCount * 8, deltas, EntryCount, cTable );
+    CUDA_ASSERT( size > 0 );
+
+    sizeWriter[0] = (byte)( size );
+    sizeWriter[1] = (byte)( size >> 8 );
+
+    return streamWriter + size;
 }
 
 //-----------------------------------------------------------
 __global__ void CudaCompressToPark( 
     const uint32 parkCount, const size_t parkSize, 
     uint64* linePoints, byte* parkBuffer, const size_t parkBufferSize,
-    const uint32 stubBitSize, const FSE_CTable* cTable, uint32* gParkOverrunCount )
+    const uint32 stubBitSize, const FSE_CTable* cTable, uint32* gParkOverrunCount,
+    const ParkDeltaCoding deltaCoding, const RANSEncTable* ransTable )
 {
     const uint32 id  = threadIdx.x;
     const uint32 gid = blockIdx.x * blockDim.x + id;
@@ -136,9 +156,49 @@ __global__ void CudaCompressToPark(
         deltaBytesWriter += 2;
 
         // CUDA_ASSERT( smallDeltas[0] == 3 );
-        size_t deltasSize = CUDA_FSE_compress_usingCTable<kEntriesPerPark-1>(
+        size_t deltasSize = 0;
+
+        if( deltaCoding == ParkDeltaCoding::InterleavedFSE )
+        {
+            // Same layout as CompressInterleavedDeltas. Parks here are always full.
+            constexpr int32 lastStreamEntries = (int32)( kEntriesPerPark - 1 - ( ParkDeltaStreamCount - 1 ) * ParkDeltaStreamEntries );
+            static_assert( ParkDeltaStreamCount == 4 && lastStreamEntries > 2 );
+
+            byte* streamWriter = deltaBytesWriter + ParkDeltaStreamCount * sizeof( uint16 );
+
+            streamWriter = CudaCompressDeltaStream<ParkDeltaStreamEntries>( deltaBytesWriter + 0, streamWriter, smallDeltas + ParkDeltaStreamEntries * 0, cTable );
+            streamWriter = CudaCompressDeltaStream<ParkDeltaStreamEntries>( deltaBytesWriter + 2, streamWriter, smallDeltas + ParkDeltaStreamEntries * 1, cTable );
+            streamWriter = CudaCompressDeltaStream<ParkDeltaStreamEntries>( deltaBytesWriter + 4, streamWriter, smallDeltas + ParkDeltaStreamEntries * 2, cTable );
+            streamWriter = CudaCompressDeltaStream<lastStreamEntries>     ( deltaBytesWriter + 6, streamWriter, smallDeltas + ParkDeltaStreamEntries * 3, cTable );
+
+            deltasSize = (size_t)( streamWriter - deltaBytesWriter );
+        }
+        else if( deltaCoding == ParkDeltaCoding::RANS )
+        {
+            uint16 words[kEntriesPerPark];
+            deltasSize = RANSEncode( deltaBytesWriter, smallDeltas, kEntriesPerPark-1, *ransTable, words );
+
+            // Same fallback as CompressParkDeltas, for parks that the rANS stream doesn't fit in
+            if( deltasSize == 0 || (size_t)( ( deltaBytesWriter + deltasSize ) - parkBuffer ) > parkSize )
+            {
+                deltasSize = CUDA_FSE_compress_usingCTable<kEntriesPerPark-1>(
+                                deltaBytesWriter + 2, (kEntriesPerPark-1) * 8,
+                                smallDeltas, kEntriesPerPark-1, cTable );
+
+                if( deltasSize != 0 )
+                {
+                    deltaBytesWriter[0] = (byte)( RANSFSEFallback );
+                    deltaBytesWriter[1] = (byte)( RANSFSEFallback >> 8 );
+                    deltasSize += 2;
+                }
+            }
+        }
+        else
+        {
+            deltasSize = CUDA_FSE_compress_usingCTable<kEntriesPerPark-1>(
                                 deltaBytesWriter, (kEntriesPerPark-1) * 8,
                                 smallDeltas, kEntriesPerPark-1, cTable );
+        }
 
         if( deltasSize == 0 )
         {
@@ -1,5 +1,6 @@
 #pragma once
 #include "CudaPlotContext.h"
+#include "plotting/RANSCoding.h"
 
 typedef unsigned FSE_CTable;
 
@@ -11,10 +12,13 @@ void CompressC3ParksInGPU( const uint32 parkCount, uint32* devF7, byte* devParkB
 void SerializePark7InGPU( const uint32 parkCount, const uint32* indices, uint64* fieldWriter,
                           const size_t parkFieldCount, cudaStream_t stream );
 
+// devRANSTable is only used by ParkDeltaCoding::RANS
 void CompressToParkInGPU( const uint32 parkCount, const size_t parkSize, 
     uint64* devLinePoints, byte* devParkBuffer, size_t parkBufferSize, 
-    const uint32 stubBitSize, const FSE_CTable* devCTable, uint32* devParkOverrunCount, cudaStream_t stream );
+    const uint32 stubBitSize, const FSE_CTable* devCTable, uint32* devParkOverrunCount,
+    ParkDeltaCoding deltaCoding, const RANSEncTable* devRANSTable, cudaStream_t stream );
 
 __global__ void CudaCompressToPark( const uint32 parkCount, const size_t parkSize, 
     uint64* linePoints, byte* parkBuffer, size_t parkBufferSize, 
-    const uint32 stubBitSize, const FSE_CTable* cTable, uint32* gParkOverrunCount );
+    const uint32 stubBitSize, const FSE_CTable* cTable, uint32* gParkOverrunCount,
+    ParkDeltaCoding deltaCoding, const RANSEncTable* ransTable );
@@ -4,8 +4,37 @@
 #define BBCU_GPU_BUFFER_MAX_COUNT     4
 #define BBCU_DEFAULT_GPU_BUFFER_COUNT 2
 
-#define BBCU_K                          (32u)
-#define BBCU_BUCKET_COUNT               (128u)
+// Host<->device links measured slower than this (e.g. x4/x8 risers) get deeper phase 1 transfer buffering,
+// so that bucket transfers can queue up behind the kernels instead of stalling them.
+#define BBCU_LOW_TRANSFER_BANDWIDTH         (8.0 * 1000 * 1000 * 1000)  // Bytes per second
+#define BBCU_LOW_BANDWIDTH_GPU_BUFFER_COUNT 3
+
+// Replay the per-bucket match kernels from a captured CUDA graph instead of launching them one by one
+// Graph capture is CUDA-only for now
+#ifndef BBCU_USE_MATCH_GRAPH
+    #if BB_HIP_ENABLED
+        #define BBCU_USE_MATCH_GRAPH 0
+    #else
+        #define BBCU_USE_MATCH_GRAPH 1
+    #endif
+#endif
+
+// All k-dependent sizes below derive from BBCU_K. The pipeline itself stores x's, y's,
+// pairs and line point inputs as 32-bit values, so larger k's need those widened first.
+#ifndef BBCU_K
+    #define BBCU_K                      (32u)
+#endif
+#if BBCU_K != 32
+    #error "The CUDA plotter currently only supports k32."
+#endif
+// Set with -DBB_CUDA_BUCKET_COUNT. More buckets make each bucket, and so the device buffers, smaller,
+// for GPUs with less memory, at the cost of more kernel launches and transfers per table.
+#ifndef BBCU_BUCKET_COUNT
+    #define BBCU_BUCKET_COUNT           (128u)
+#endif
+#if BBCU_BUCKET_COUNT != 128 && BBCU_BUCKET_COUNT != 256 && BBCU_BUCKET_COUNT != 512
+    #error "BBCU_BUCKET_COUNT must be 128, 256 or 512."
+#endif
 #define BBC_Y_BITS                      (BBCU_K+kExtraBits)
 #define BBC_Y_BITS_T7                   (BBCU_K)
 #define BBC_BUCKET_BITS                 (CuBBLog2( BBCU_BUCKET_COUNT ))
@@ -16,7 +45,7 @@
 #define BBC_BUCKET_MASK( bucket )       ( ((uint64)bucket) << BBC_BUCKET_SHIFT )
 
 
-#define BBCU_TABLE_ENTRY_COUNT          (1ull<<32)
+#define BBCU_TABLE_ENTRY_COUNT          (1ull<<BBCU_K)
 #define BBCU_BUCKET_ENTRY_COUNT         (BBCU_TABLE_ENTRY_COUNT/BBCU_BUCKET_COUNT)
 //#define BBCU_XTRA_ENTRIES_PER_SLICE     (1024u*64u)
 #define BBCU_XTRA_ENTRIES_PER_SLICE     (4096+1024)
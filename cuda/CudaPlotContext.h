@@ -17,16 +17,20 @@
 #include "plotting/DiskBuffer.h"
 #include "plotting/DiskBucketBuffer.h"
 #include <filesystem>
+#include <deque>
 
-#include "cub/device/device_radix_sort.cuh"
-// #include <cub/device/device_radix_sort.cuh>
+#include "GpuCub.h"
 
 // Fix for cooperative_groups.h on windows
 #ifdef __LITTLE_ENDIAN__
     #undef __LITTLE_ENDIAN__
     #define __LITTLE_ENDIAN__ 1 
 #endif
-#include <cooperative_groups.h>
+#if BB_HIP_ENABLED
+    #include <hip/hip_cooperative_groups.h>
+#else
+    #include <cooperative_groups.h>
+#endif
 using namespace cooperative_groups;
 
 #if _DEBUG
@@ -34,6 +38,9 @@ using namespace cooperative_groups;
 #endif
 
 
+// Extra space left past each host park buffer, so that its start can be shifted for the plot writer (see CudaK32PlotAlignParksForWrite)
+static constexpr size_t BBCU_PARK_WRITE_SLACK = 4096;
+
 struct CudaK32ParkContext
 {
     Span<byte>        table7Memory;             // Memory buffer reserved for finalizing table7 and writing C parks
@@ -57,6 +64,7 @@ struct CudaK32HybridMode
 
     DiskQueue*  temp1Queue;  // Tables Queue
     DiskQueue*  temp2Queue;  // Metadata Queue (could be the same as temp1Queue)
+    bool        gpuDirectStorage; // GPUDirect Storage driver is open and should be used for bucketed disk buffers
 
     DiskBucketBuffer* metaBuffer;   // Enabled in < 128G mode
     DiskBucketBuffer* yBuffer;      // Enabled in < 128G mode
@@ -87,7 +95,6 @@ struct CudaK32Phase2
     GpuDownloadBuffer outMarks;
 
     uint64            pairsLoadOffset;
-    byte*             devMarkingTable;          // bytefield marking table
     const uint64*     devRMarks[6];             // Right table's marks as a bitfield
     uint32*           devPrunedCount;
 
@@ -161,6 +168,14 @@ struct CudaK32Phase3
         GpuDownloadBuffer parksOut;     // Output P7 parks on the last table
         uint32*           devLTable[2]; // Unpacked L table bucket
 
+        // Line point buckets kept on the device for step 3, instead of round-tripping through the host.
+        // Allocated from device memory left unused by the larger phases.
+        uint64*           devResidentLinePoints;
+        uint32*           devResidentIndices;
+        uint32*           devResidentCounts;
+        uint32            residentBucketCapacity;
+        uint32            residentBucketCount;  // Resident buckets for the current table: Buckets [0, residentBucketCount)
+
         uint32 prunedBucketSlices[BBCU_BUCKET_COUNT][BBCU_BUCKET_COUNT];
     } step2;
 
@@ -180,6 +195,7 @@ struct CudaK32Phase3
         uint64*           devDeltaLinePoints;
         uint32*           devIndices;
         FSE_CTable*       devCTable;
+        RANSEncTable*     devRANSTable;
         uint32*           devParkOverrunCount;
 
         std::atomic<uint32> parkBucket;
@@ -221,6 +237,8 @@ struct CudaK32PlotContext
 
     int32           cudaDevice        = -1;
     cudaDeviceProp* cudaDevProps      = nullptr;
+    GpuTransferBandwidth transferBandwidth = {};               // Host<->device bandwidth, measured at init
+    uint32          p1BufferCount     = BBCU_DEFAULT_GPU_BUFFER_COUNT;  // GPU buffers per phase 1 transfer stream
     bool            downloadDirect    = false;
     TableId         firstStoredTable  = TableId::Table2;    // First non-dropped table that has back pointers
     ThreadPool*     threadPool        = nullptr;
@@ -232,10 +250,21 @@ struct CudaK32PlotContext
 
     uint32       bucketCounts[7][BBCU_BUCKET_COUNT]  = {};
     uint32       bucketSlices[2][BBCU_BUCKET_COUNT][BBCU_BUCKET_COUNT] = {};
+
+    // Packed slice sizes, in 64-bit words, of the input table's R pairs and table 7 y's (see CudaPack.h).
+    // Indexed the same as bucketSlices.
+    uint32       packedPairsRSliceWords[BBCU_BUCKET_COUNT][BBCU_BUCKET_COUNT] = {};
+    uint32       packedYT7SliceWords   [BBCU_BUCKET_COUNT][BBCU_BUCKET_COUNT] = {};
+    size_t       packedPairsRSliceStride = 0;                // Device/host slice stride, in bytes, of packed R pairs
+    size_t       packedYT7SliceStride    = 0;                // Device/host slice stride, in bytes, of packed table 7 y's
     uint64       tableEntryCounts[7]  = {};
 
     PlotRequest  plotRequest;
     PlotWriter*  plotWriter           = nullptr;
+    PlotWriter*  prevPlotWriter       = nullptr;    // Previous plot, still being flushed to disk
+    PlotWriteStaging*        plotStaging = nullptr;         // Set with --output-buffer
+    std::deque<PlotWriter*>  backgroundPlotWriters;         // Staged plots still being flushed to disk, oldest first
+    uint32                   maxBackgroundPlotWriters = 0;
     Fence*       plotFence            = nullptr;
     Fence*       parkFence            = nullptr;
 
@@ -245,17 +274,22 @@ struct CudaK32PlotContext
     size_t devAllocSize               = 0;
     size_t hostTableAllocSize         = 0;
     size_t hostTempAllocSize          = 0;
+    size_t hostParksAllocSize         = 0;
 
     void* pinnedBuffer                = nullptr;
     void* deviceBuffer                = nullptr;
     void* hostBufferTemp              = nullptr;
     void* hostBufferTables            = nullptr;
+    void* hostBufferParks             = nullptr;
+
+    Thread* parksPinThread            = nullptr;    // Pins hostBufferParks in the background during the first plot
 
     // Device stuff
     cudaStream_t computeStream        = nullptr;
     cudaStream_t computeStreamB       = nullptr;
     cudaStream_t computeStreamC       = nullptr;
     cudaStream_t computeStreamD       = nullptr;
+    cudaStream_t prefetchStream       = nullptr;    // Managed host table prefetches (--managed-memory)
     cudaEvent_t  computeEventA        = nullptr;
     cudaEvent_t  computeEventB        = nullptr;
     cudaEvent_t  computeEventC        = nullptr;
@@ -291,6 +325,7 @@ struct CudaK32PlotContext
     };
     uint32*      devBucketCounts      = nullptr;
     uint32*      devSliceCounts       = nullptr;
+    uint32*      devInSliceCounts     = nullptr;    // Slice counts of the input table, for unpacking packed slices
     uint32*      devSortKey           = nullptr;
     uint32*      devChaChaInput       = nullptr;
     
@@ -299,6 +334,9 @@ struct CudaK32PlotContext
     uint32*      devMatchCount        = nullptr;
     uint32*      devGroupCount        = nullptr;
 
+    // Captured bucket match sequence, re-launched per bucket with updated kernel arguments (see CudaMatch.cu)
+    struct CudaK32MatchGraph* matchGraph = nullptr;
+
 
     /// Host stuff
 
@@ -330,6 +368,7 @@ struct CudaK32PlotContext
     // Used when '--check' is enabled
     struct GreenReaperContext* grCheckContext = nullptr;
     class  PlotChecker*        plotChecker    = nullptr;
+    class  PlotCheckQueue*     plotCheckQueue = nullptr;    // Runs plotChecker in the background
 
     struct
     {
@@ -340,6 +379,10 @@ struct CudaK32PlotContext
         Duration fxTime       = Duration::zero();
 
     } timings;
+
+    // Bracket each Phase 1 bucket's work on the compute stream while benchmarking
+    cudaEvent_t benchBucketEvents[BBCU_BUCKET_COUNT*2] = {};
+    bool        benchEventsCreated = false;
 };
 
 #if _DEBUG
@@ -379,6 +422,11 @@ void CudaK32ApplyPairOffset(
 ///
 /// Phase 2
 ///
+void CudaK32PlotEnableGpuDirectStorage( CudaK32PlotContext& cx, DiskBucketBuffer* buffer );
+
+// With --managed-memory, starts migrating a table's host back pointers to host RAM ahead of their use
+void CudaK32PlotPrefetchHostTable( CudaK32PlotContext& cx, TableId table );
+
 void CudaK32PlotPhase2( CudaK32PlotContext& cx );
 void CudaK32PlotPhase2AllocateBuffers( CudaK32PlotContext& cx, CudaK32AllocContext& acx );
 
@@ -404,6 +452,15 @@ inline uint32 CudaK32PlotGetInputIndex( CudaK32PlotContext& cx )
     return ((uint32)cx.table-1) & 1;
 }
 
+//-----------------------------------------------------------
+// When only table 1 is dropped, table 2's pairs are its inlined x's, and its metadata
+// is those same x's (x_l << 32 | x_r). So it can be regenerated from the pairs
+// instead of being stored and uploaded again for table 3.
+inline bool CudaK32PlotIsMetaRecomputed( const CudaK32PlotContext& cx, const TableId table )
+{
+    return cx.cfg.recomputeMeta && table == TableId::Table2 && cx.gCfg->numDroppedTables == 1;
+}
+
 //-----------------------------------------------------------
 inline uint32 CudaK32PlotGetOutputIndex( CudaK32PlotContext& cx )
 {
@@ -416,6 +473,19 @@ inline bool CudaK32PlotIsOutputVertical( CudaK32PlotContext& cx )
     return CudaK32PlotGetOutputIndex( cx ) == 0;
 }
 
+//-----------------------------------------------------------
+// Shifts the start of a host park buffer, by less than BBCU_PARK_WRITE_SLACK, so that it is aligned
+// like the parks' location in the plot file. The plot writer then writes them straight from the
+// pinned buffer, instead of copying them first. tableOffset is the parks' offset from the start of the
+// table, which itself starts at tableBlockOffset, as given by PlotWriter::NextWriteBlockOffset after BeginTable.
+inline byte* CudaK32PlotAlignParksForWrite( CudaK32PlotContext& cx, byte* buffer, const size_t tableBlockOffset, const uint64 tableOffset )
+{
+    if( cx.plotWriter->BlockSize() > BBCU_PARK_WRITE_SLACK )
+        return buffer;
+
+    return cx.plotWriter->AlignToBlockOffset<byte>( buffer, tableBlockOffset + (size_t)tableOffset );
+}
+
 //-----------------------------------------------------------
 inline size_t GetMarkingTableBitFieldSize()
 {
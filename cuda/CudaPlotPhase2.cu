@@ -28,72 +28,70 @@ inline size_t GetMarkingTableByteSize()
     return 1ull << BBCU_K;
 }
 
-template<bool useRMarks>
-__global__ void CudaMarkTables( const uint32 entryCount, const uint32* lPairs, const uint16* rPairs,
-                                byte* marks, const uint64* rTableMarks, const uint32 rOffset )
+// Sets the bit at index on the bitfield. Lanes of a warp marking the same 64-bit word
+// combine their bits first, so that only one atomic is issued per word.
+// Since the pairs are sorted, neighbouring lanes tend to mark neighbouring entries.
+// All lanes of the warp must call this, invalid lanes pass valid = false.
+__device__ __forceinline__ void CudaMarkBit( uint64* bitfield, const uint32 index, const bool valid )
 {
-    const uint32 gid = blockIdx.x * blockDim.x + threadIdx.x;
+    const uint32 word = index >> 6;
+    const uint64 bit  = 1ull << ( index & 63 );
 
-    // Each thread handles 1 entry
-    if( gid >= entryCount )
+#if !BB_HIP_ENABLED && __CUDA_ARCH__ >= 700
+    const uint32 active = __ballot_sync( BBCU_WARP_MASK_ALL, valid );
+    if( !valid )
         return;
 
-    if constexpr ( useRMarks )
-    {
-        if( !CuBitFieldGet( rTableMarks, rOffset + gid ) )
-            return;
-    }
+    const uint32 lane  = threadIdx.x & 31;
+    const uint32 peers = __match_any_sync( active, word );
 
-    const uint32 l = lPairs[gid];
-    const uint32 r = l + rPairs[gid];
+    unsigned long long bits = 0;
+    for( uint32 m = peers; m != 0; m &= m - 1 )
+        bits |= __shfl_sync( peers, (unsigned long long)bit, __ffs( m ) - 1 );
 
-    marks[l] = 1;
-    marks[r] = 1;
+    if( lane == (uint32)__ffs( peers ) - 1 )
+        atomicOr( (unsigned long long*)&bitfield[word], bits );
+#else
+    if( valid )
+        atomicOr( (unsigned long long*)&bitfield[word], (unsigned long long)bit );
+#endif
 }
 
-
-__global__ void CudaBytefieldToBitfield( const byte* bytefield, uint64* bitfield
-#if DBG_BBCU_P2_COUNT_PRUNED_ENTRIES
-    , uint32* gPrunedCount
-#endif
- )
+template<bool useRMarks>
+__global__ void CudaMarkTables( const uint32 entryCount, const uint32* lPairs, const uint16* rPairs,
+                                uint64* marks, const uint64* rTableMarks, const uint32 rOffset )
 {
     const uint32 gid = blockIdx.x * blockDim.x + threadIdx.x;
-    CUDA_ASSERT( gid < 67108864 );
 
-    // if( gid >= fieldCount )
-    //     return;
+    // Each thread handles 1 entry. Out of range threads don't return,
+    // as the whole warp takes part in the marking.
+    bool valid = gid < entryCount;
 
-    // Each thread reads a full 64-bit field, so 64 bytes
-    bytefield += gid * 64ull;
+    if constexpr ( useRMarks )
+        valid = valid && CuBitFieldGet( rTableMarks, rOffset + gid );
 
-    // Convert 64 bytes to a 64-bit field
-    uint64 bits = (uint64)bytefield[0];
-    
-    #pragma unroll
-    for( int32 i = 1; i < 64; i++ )
-        bits |= (((uint64)bytefield[i]) << i);
+    uint32 l = 0, r = 0;
+    if( valid )
+    {
+        l = lPairs[gid];
+        r = l + rPairs[gid];
+    }
 
-    CUDA_ASSERT( (uintptr_t)bitfield / 8 * 8 == (uintptr_t)bitfield );
-    bitfield[gid] = bits;
+    CudaMarkBit( marks, l, valid );
+    CudaMarkBit( marks, r, valid );
+}
 
 #if DBG_BBCU_P2_COUNT_PRUNED_ENTRIES
-    
-    uint32 markCount = 0;
+__global__ void CudaCountMarks( const uint64* bitfield, uint32* gPrunedCount )
+{
+    const uint32 gid = blockIdx.x * blockDim.x + threadIdx.x;
+    CUDA_ASSERT( gid < 67108864 );
 
-    #pragma unroll
-    for( uint32 i = 0; i < 64; i++ )
-    {
-        // if( (bits & (1ull << i)) != 0 )
-        //     markCount++;
-        if( bytefield[i] == 1 )
-            markCount++;
-    }
+    const uint32 markCount = (uint32)__popcll( bitfield[gid] );
 
     __shared__ uint32 sharedMarkCount;
     thread_block block = this_thread_block();
 
-    // #TODO: Use warp-aware reduction via CUB
     block.sync();
     if( block.thread_rank() == 0 )
         sharedMarkCount = 0;
@@ -104,30 +102,18 @@ __global__ void CudaBytefieldToBitfield( const byte* bytefield, uint64* bitfield
 
     if( block.thread_rank() == 0 )
         atomicAdd( gPrunedCount, sharedMarkCount );
-#endif
 }
 
-static void BytefieldToBitfield( CudaK32PlotContext& cx, const byte* bytefield, uint64* bitfield, cudaStream_t stream )
+static void DbgCountMarks( CudaK32PlotContext& cx, const uint64* bitfield, cudaStream_t stream )
 {
-    const uint64 tableEntryCount    = 1ull << BBCU_K;
-    const uint32 fieldCount         = (uint32)( tableEntryCount / 64 );
-    
-    const uint32 blockThreadCount   = 256;
-    const uint32 blockCount         = CDivT( fieldCount, blockThreadCount );
-
-    ASSERT( (uint64)blockCount * blockThreadCount * 64 == tableEntryCount );
-
-    #if DBG_BBCU_P2_COUNT_PRUNED_ENTRIES
-        #define G_PRUNED_COUNTS ,cx.phase2->devPrunedCount
-        CudaErrCheck( cudaMemsetAsync( cx.phase2->devPrunedCount, 0, sizeof( uint32 ), stream ) );
-    #else
-        #define G_PRUNED_COUNTS 
-    #endif
-    
-    ASSERT_DOES_NOT_OVERLAP2( bitfield, bytefield, GetMarkingTableBitFieldSize(), GetMarkingTableByteSize() );
+    const uint32 fieldCount       = (uint32)( ( 1ull << BBCU_K ) / 64 );
+    const uint32 blockThreadCount = 256;
+    const uint32 blockCount       = CDivT( fieldCount, blockThreadCount );
 
-    CudaBytefieldToBitfield<<<blockCount, blockThreadCount, 0, stream>>>( bytefield, bitfield G_PRUNED_COUNTS );
+    CudaErrCheck( cudaMemsetAsync( cx.phase2->devPrunedCount, 0, sizeof( uint32 ), stream ) );
+    CudaCountMarks<<<blockCount, blockThreadCount, 0, stream>>>( bitfield, cx.phase2->devPrunedCount );
 }
+#endif
 
 void LoadPairs( CudaK32PlotContext& cx, CudaK32Phase2& p2, const TableId rTable, const uint32 bucket )
 {
@@ -164,8 +150,6 @@ void MarkTable( CudaK32PlotContext& cx, CudaK32Phase2& p2 )
     const TableId lTable = cx.table;
     const TableId rTable = lTable + 1;
 
-    byte* devLMarks = p2.devMarkingTable;
-
     if( cx.cfg.hybrid128Mode )
     {
         cx.diskContext->tablesL[(int)rTable]->Swap();
@@ -175,8 +159,13 @@ void MarkTable( CudaK32PlotContext& cx, CudaK32Phase2& p2 )
         p2.pairsRIn.AssignDiskBuffer( cx.diskContext->tablesR[(int)rTable] );
     }
 
+    // Mark directly into the bitfield we download. The buffers alternate between tables,
+    // so this is never the buffer holding the R table's marks.
+    uint64* bitfield = (uint64*)p2.outMarks.LockDeviceBuffer( cx.computeStream );
+    ASSERT( rTable == TableId::Table7 || bitfield != p2.devRMarks[(int)rTable] );
+
     // Zero-out marks
-    CudaErrCheck( cudaMemsetAsync( devLMarks, 0, GetMarkingTableByteSize(), cx.computeStream ) );
+    CudaErrCheck( cudaMemsetAsync( bitfield, 0, GetMarkingTableBitFieldSize(), cx.computeStream ) );
 
     // Load first bucket's worth of pairs
     LoadPairs( cx, p2, rTable, 0 );
@@ -200,9 +189,9 @@ void MarkTable( CudaK32PlotContext& cx, CudaK32Phase2& p2 )
         const uint32 blockCount = (uint32)CDiv( entryCount, MARK_TABLE_BLOCK_THREADS );
 
         if( rTable == TableId::Table7 )
-            CudaMarkTables<false><<<blockCount, MARK_TABLE_BLOCK_THREADS, 0, cx.computeStream>>>( entryCount, devLPairs, devRPairs, devLMarks, nullptr, 0 );
+            CudaMarkTables<false><<<blockCount, MARK_TABLE_BLOCK_THREADS, 0, cx.computeStream>>>( entryCount, devLPairs, devRPairs, bitfield, nullptr, 0 );
         else
-            CudaMarkTables<true ><<<blockCount, MARK_TABLE_BLOCK_THREADS, 0, cx.computeStream>>>( entryCount, devLPairs, devRPairs, devLMarks, p2.devRMarks[(int)rTable], rTableGlobalIndexOffset );
+            CudaMarkTables<true ><<<blockCount, MARK_TABLE_BLOCK_THREADS, 0, cx.computeStream>>>( entryCount, devLPairs, devRPairs, bitfield, p2.devRMarks[(int)rTable], rTableGlobalIndexOffset );
 
         p2.pairsLIn.ReleaseDeviceBuffer( cx.computeStream );
         p2.pairsRIn.ReleaseDeviceBuffer( cx.computeStream );
@@ -210,10 +199,9 @@ void MarkTable( CudaK32PlotContext& cx, CudaK32Phase2& p2 )
         rTableGlobalIndexOffset += entryCount;
     }
 
-    // Convert the bytefield marking table to a bitfield
-    uint64* bitfield = (uint64*)p2.outMarks.LockDeviceBuffer( cx.computeStream );
-
-    BytefieldToBitfield( cx, devLMarks, bitfield, cx.computeStream );
+#if DBG_BBCU_P2_COUNT_PRUNED_ENTRIES
+    DbgCountMarks( cx, bitfield, cx.computeStream );
+#endif
 
     // Download bitfield marks
     // uint64* hostBitField = p2.hostBitFieldAllocator->AllocT<uint64>( GetMarkingTableBitFieldSize() );
@@ -365,6 +353,8 @@ void CudaK32PlotPhase2( CudaK32PlotContext& cx )
 #endif
     // CudaK32PlotAllocateBuffersTest( cx );
 
+    CudaK32PlotPrefetchHostTable( cx, startRTable );
+
     for( TableId rTable = startRTable; rTable >= endRTable; rTable-- )
     {
     #if BBCU_DBG_SKIP_PHASE_1
@@ -376,9 +366,13 @@ void CudaK32PlotPhase2( CudaK32PlotContext& cx )
         cx.table           = rTable-1;
         p2.pairsLoadOffset = 0;
 
+        // Page in the next table's pairs while this one is marked
+        CudaK32PlotPrefetchHostTable( cx, rTable-1 );
+
+        // outMarks is not reset between tables, as the next table
+        // reads these marks while marking into the other buffer
         MarkTable( cx, p2 );
         p2.outMarks.WaitForCompletion();
-        p2.outMarks.Reset();
         p2.pairsLIn.Reset();
         p2.pairsRIn.Reset();
 
@@ -424,12 +418,10 @@ void CudaK32PlotPhase2AllocateBuffers( CudaK32PlotContext& cx, CudaK32AllocConte
 
     CudaK32Phase2& p2 = *cx.phase2;
 
-    const size_t markingTableByteSize     = GetMarkingTableByteSize();
     const size_t markingTableBitFieldSize = GetMarkingTableBitFieldSize();
 
     // Device buffers
     p2.devPrunedCount  = acx.devAllocator->CAlloc<uint32>( 1, acx.alignment );
-    p2.devMarkingTable = acx.devAllocator->AllocT<byte>( markingTableByteSize, acx.alignment );
 
     // Upload/Download streams
     p2.pairsLIn = cx.gpuUploadStream[0]->CreateUploadBufferT<uint32>( desc, acx.dryRun );
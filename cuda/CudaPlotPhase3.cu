@@ -38,8 +38,8 @@ __global__ void CudaConvertInlinedXsToLinePoints(
     __shared__ uint32 sharedBuckets[BBCU_BUCKET_COUNT];
 
     CUDA_ASSERT( gridDim.x >= BBCU_BUCKET_COUNT );
-    if( id < BBCU_BUCKET_COUNT )
-        sharedBuckets[id] = 0;
+    for( uint32 b = id; b < BBCU_BUCKET_COUNT; b += blockDim.x )
+        sharedBuckets[b] = 0;
 
     __syncthreads();
 
@@ -63,8 +63,8 @@ __global__ void CudaConvertInlinedXsToLinePoints(
     __syncthreads();
 
     // Global offset
-    if( id < BBCU_BUCKET_COUNT )
-        sharedBuckets[id] = atomicAdd( &gBucketCounts[id], sharedBuckets[id] );
+    for( uint32 b = id; b < BBCU_BUCKET_COUNT; b += blockDim.x )
+        sharedBuckets[b] = atomicAdd( &gBucketCounts[b], sharedBuckets[b] );
     __syncthreads();
 
     if( isPruned )
@@ -137,8 +137,8 @@ __global__ void PruneAndWriteRMap(
     __shared__ uint32 sharedBuckets[BBCU_BUCKET_COUNT];
 
     CUDA_ASSERT( gridDim.x >= BBCU_BUCKET_COUNT );
-    if( id < BBCU_BUCKET_COUNT )
-        sharedBuckets[id] = 0;
+    for( uint32 b = id; b < BBCU_BUCKET_COUNT; b += blockDim.x )
+        sharedBuckets[b] = 0;
 
     __syncthreads();
 
@@ -169,8 +169,8 @@ __global__ void PruneAndWriteRMap(
 
     // Global offset
     __syncthreads();
-    if( id < BBCU_BUCKET_COUNT )
-        sharedBuckets[id] = atomicAdd( &gBucketCounts[id], sharedBuckets[id] );
+    for( uint32 b = id; b < BBCU_BUCKET_COUNT; b += blockDim.x )
+        sharedBuckets[b] = atomicAdd( &gBucketCounts[b], sharedBuckets[b] );
     __syncthreads();
 
     if( isPruned )
@@ -294,6 +294,9 @@ void CudaK32PlotPhase3( CudaK32PlotContext& cx )
 
         cx.table = rTable;
 
+        // Page in the next table's pairs while this one is compressed
+        CudaK32PlotPrefetchHostTable( cx, rTable+1 );
+
         #if BBCU_DBG_SKIP_PHASE_2
             if( rTable < TableId::Table7 )
                 DbgLoadTablePairs( cx, rTable+1, false );
@@ -524,6 +527,9 @@ void CompressInlinedTable( CudaK32PlotContext& cx )
     CudaErrCheck( cudaMemcpyAsync( (void*)tx.devRMarks, cx.hostMarkingTables[(int)rTable],
                 GetMarkingTableBitFieldSize(), cudaMemcpyHostToDevice, p3.xTable.xIn.GetQueue()->GetStream() ) );
 
+    // Line points from the inlined table are all downloaded
+    s2.residentBucketCount = 0;
+
     // Load initial bucket
     LoadBucket( cx, 0 );
 
@@ -638,6 +644,7 @@ void CudaK32PlotPhase3AllocateBuffers( CudaK32PlotContext& cx, CudaK32AllocConte
     // Shared allocations
     p3.devBucketCounts     = acx.devAllocator->CAlloc<uint32>( BBCU_BUCKET_COUNT, acx.alignment );
     p3.devPrunedEntryCount = acx.devAllocator->CAlloc<uint32>( 1, acx.alignment );
+    p3.step2.devResidentCounts = acx.devAllocator->CAlloc<uint32>( BBCU_BUCKET_COUNT, acx.alignment );
 
     // Host allocations
     if( !cx.cfg.hybrid16Mode )
@@ -656,6 +663,7 @@ void CudaK32PlotPhase3AllocateBuffers( CudaK32PlotContext& cx, CudaK32AllocConte
         cx.diskContext->phase3.rMapBuffer = DiskBucketBuffer::Create( *cx.diskContext->temp2Queue, CudaK32HybridMode::P3_RMAP_DISK_BUFFER_FILE_NAME.data(), 
                                             BBCU_BUCKET_COUNT, RMAP_SLICE_SIZE, FileMode::OpenOrCreate, FileAccess::ReadWrite, TMP2_QUEUE_FILE_FLAGS );
         FatalIf( !cx.diskContext->phase3.rMapBuffer, "Failed to create R Map disk buffer." );
+        CudaK32PlotEnableGpuDirectStorage( cx, cx.diskContext->phase3.rMapBuffer );
 
         cx.diskContext->phase3.indexBuffer = DiskBucketBuffer::Create( *cx.diskContext->temp2Queue, CudaK32HybridMode::P3_INDEX_DISK_BUFFER_FILE_NAME.data(), 
                                             BBCU_BUCKET_COUNT, INDEX_SLICE_SIZE, FileMode::OpenOrCreate, FileAccess::ReadWrite, TMP2_QUEUE_FILE_FLAGS );
@@ -664,6 +672,7 @@ void CudaK32PlotPhase3AllocateBuffers( CudaK32PlotContext& cx, CudaK32AllocConte
         cx.diskContext->phase3.lpAndLMapBuffer = DiskBucketBuffer::Create( *cx.diskContext->temp2Queue, CudaK32HybridMode::P3_LP_AND_LMAP_DISK_BUFFER_FILE_NAME.data(), 
                                             BBCU_BUCKET_COUNT, RMAP_SLICE_SIZE, FileMode::OpenOrCreate, FileAccess::ReadWrite, TMP2_QUEUE_FILE_FLAGS );
         FatalIf( !cx.diskContext->phase3.lpAndLMapBuffer, "Failed to create LP/LMap disk buffer." );
+        CudaK32PlotEnableGpuDirectStorage( cx, cx.diskContext->phase3.lpAndLMapBuffer );
     }
 
     #if _DEBUG
@@ -718,19 +727,52 @@ void CudaK32PlotPhase3AllocateBuffers( CudaK32PlotContext& cx, CudaK32AllocConte
         const size_t devMarker = devAllocator   ->Size();
         const size_t pinMarker = pinnedAllocator->Size();
 
+        size_t devStepsSize = 0;
+
         AllocXTableStep( cx, acx );
+        devStepsSize = std::max( devStepsSize, devAllocator->Size() );
         devAllocator   ->PopToMarker( devMarker );
         pinnedAllocator->PopToMarker( pinMarker );
 
         CudaK32PlotAllocateBuffersStep1( cx, acx );
+        devStepsSize = std::max( devStepsSize, devAllocator->Size() );
         devAllocator   ->PopToMarker( devMarker );
         pinnedAllocator->PopToMarker( pinMarker );
 
         CudaK32PlotAllocateBuffersStep2( cx, acx );
+        devStepsSize = std::max( devStepsSize, devAllocator->Size() );
         devAllocator   ->PopToMarker( devMarker );
         pinnedAllocator->PopToMarker( pinMarker );
 
         CudaK32PlotAllocateBuffersStep3( cx, acx );
+        devStepsSize = std::max( devStepsSize, devAllocator->Size() );
+
+        // The device buffer is sized for the largest phase, so phase 3 normally leaves some of it unused.
+        // Use it to keep as many of step 2's line point buckets as we can on the device, above all step buffers.
+        auto& s2 = p3.step2;
+        s2.residentBucketCapacity = 0;
+
+        if( !cx.cfg.hybrid16Mode )
+        {
+            const size_t lpBucketSize    = RoundUpToNextBoundaryT( sizeof( uint64 ) * P3_PRUNED_BUCKET_MAX, acx.alignment );
+            const size_t indexBucketSize = RoundUpToNextBoundaryT( sizeof( uint32 ) * P3_PRUNED_BUCKET_MAX, acx.alignment );
+
+            const size_t stepsEnd  = RoundUpToNextBoundaryT( devStepsSize, acx.alignment );
+            const size_t available = devAllocator->Capacity() > stepsEnd + acx.alignment ? devAllocator->Capacity() - stepsEnd - acx.alignment : 0;
+
+            s2.residentBucketCapacity = (uint32)std::min( available / ( lpBucketSize + indexBucketSize ), (size_t)BBCU_BUCKET_COUNT );
+        }
+
+        if( s2.residentBucketCapacity > 0 )
+        {
+            if( devAllocator->Size() < devStepsSize )
+                devAllocator->Alloc( devStepsSize - devAllocator->Size(), 1 );
+
+            s2.devResidentLinePoints = devAllocator->AllocT<uint64>( sizeof( uint64 ) * P3_PRUNED_BUCKET_MAX * s2.residentBucketCapacity, acx.alignment );
+            s2.devResidentIndices    = devAllocator->AllocT<uint32>( sizeof( uint32 ) * P3_PRUNED_BUCKET_MAX * s2.residentBucketCapacity, acx.alignment );
+        }
+
+        Log::Line( "Phase 3 line point buckets kept on the GPU: %u / %u", s2.residentBucketCapacity, BBCU_BUCKET_COUNT );
     }
 }
 
@@ -907,6 +949,7 @@ void CudaK32PlotAllocateBuffersStep3( CudaK32PlotContext& cx, CudaK32AllocContex
     s3.devIndices         = acx.devAllocator->CAlloc<uint32>( BBCU_BUCKET_ALLOC_ENTRY_COUNT, alignment );
 
     s3.devCTable           = acx.devAllocator->AllocT<FSE_CTable>( P3_MAX_CTABLE_SIZE, alignment );
+    s3.devRANSTable        = acx.devAllocator->CAlloc<RANSEncTable>( 1, alignment );
     s3.devParkOverrunCount = acx.devAllocator->CAlloc<uint32>( 1 );
 
     if( !acx.dryRun && cx.cfg.hybrid16Mode )
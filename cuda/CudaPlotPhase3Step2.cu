@@ -51,16 +51,19 @@ static void UnpackLMap( CudaK32PlotContext& cx, const uint32 entryCount, const L
 template<bool isCompressed=false>
 __global__ static void CudaConvertRMapToLinePoints( 
     const uint64 entryCount, const uint32 rOffset, const uint32 lTableOffset,
-    const uint32* lTable, const RMap* rmap, uint64* outLPs, uint32* outIndices, uint32* gBucketCounts, const uint32 lpShift = 0 )
+    const uint32* lTable, const RMap* rmap, uint64* outLPs, uint32* outIndices, uint32* gBucketCounts,
+    const uint32 residentBucketCount, uint64* residentLPs, uint32* residentIndices, uint32* gResidentCounts,
+    const uint32 lpShift = 0 )
 {
     const uint32 id  = threadIdx.x;
     const uint32 gid = blockIdx.x * blockDim.x + id;
 
     __shared__ uint32 sharedBuckets[BBCU_BUCKET_COUNT];
+    __shared__ uint32 sharedResidentOffsets[BBCU_BUCKET_COUNT];
 
     CUDA_ASSERT( gridDim.x >= BBCU_BUCKET_COUNT );
-    if( id < BBCU_BUCKET_COUNT )
-        sharedBuckets[id] = 0;
+    for( uint32 b = id; b < BBCU_BUCKET_COUNT; b += blockDim.x )
+        sharedBuckets[b] = 0;
 
     __syncthreads();
 
@@ -103,17 +106,34 @@ __global__ static void CudaConvertRMapToLinePoints(
     __syncthreads();
 
     // Global offset
-    if( id < BBCU_BUCKET_COUNT )
+    for( uint32 b = id; b < BBCU_BUCKET_COUNT; b += blockDim.x )
     {
-        sharedBuckets[id] = atomicAdd( &gBucketCounts[id], sharedBuckets[id] );
-        CUDA_ASSERT( sharedBuckets[id] <= P3_PRUNED_SLICE_MAX );
+        const uint32 count = sharedBuckets[b];
+
+        sharedBuckets[b] = atomicAdd( &gBucketCounts[b], count );
+        CUDA_ASSERT( sharedBuckets[b] <= P3_PRUNED_SLICE_MAX );
+
+        if( b < residentBucketCount )
+            sharedResidentOffsets[b] = atomicAdd( &gResidentCounts[b], count );
     }
     __syncthreads();
 
     if( gid >= entryCount )
         return;
 
-    const uint32 dst = bucket * P3_PRUNED_SLICE_MAX + sharedBuckets[bucket] + offset;
+    // Resident buckets are written contiguously, as step 3 expects them after upload
+    if( bucket < residentBucketCount )
+    {
+        const uint32 residentDst = sharedResidentOffsets[bucket] + offset;
+        CUDA_ASSERT( residentDst < P3_PRUNED_BUCKET_MAX );
+
+        residentLPs    [(size_t)bucket * P3_PRUNED_BUCKET_MAX + residentDst] = lp;
+        residentIndices[(size_t)bucket * P3_PRUNED_BUCKET_MAX + residentDst] = rIndex;
+        return;
+    }
+
+    // The remaining buckets are shifted down so that only their slices are downloaded
+    const uint32 dst = (bucket - residentBucketCount) * P3_PRUNED_SLICE_MAX + sharedBuckets[bucket] + offset;
     CUDA_ASSERT( dst < P3_PRUNED_BUCKET_MAX );
 
     outLPs    [dst] = lp;
@@ -134,7 +154,8 @@ static void ConvertRMapToLinePoints( CudaK32PlotContext& cx, const uint32 entryC
     const uint32 lTableOffset = cx.bucket * BBCU_BUCKET_ENTRY_COUNT;
     
     uint32* devSliceCounts = cx.devSliceCounts + cx.bucket * BBCU_BUCKET_COUNT;
-    #define Rmap2LPParams entryCount, rOffset, lTableOffset, lTable, rMap, outLPs, outIndices, devSliceCounts
+    #define Rmap2LPParams entryCount, rOffset, lTableOffset, lTable, rMap, outLPs, outIndices, devSliceCounts, \
+                          s2.residentBucketCount, s2.devResidentLinePoints, s2.devResidentIndices, s2.devResidentCounts
 
     const bool isCompressed = rTable - 1 <= (TableId)cx.gCfg->numDroppedTables;
 
@@ -266,6 +287,13 @@ void CudaK32PlotPhase3Step2( CudaK32PlotContext& cx )
     // Clear pruned entry count
     CudaErrCheck( cudaMemsetAsync( p3.devPrunedEntryCount, 0, sizeof( uint32 ), cx.computeStream ) );
 
+    // The first buckets of line points stay on the device for step 3, if there's space for them
+    s2.residentBucketCount = s2.residentBucketCapacity;
+    const uint32 downloadBucketCount = BBCU_BUCKET_COUNT - s2.residentBucketCount;
+
+    if( s2.residentBucketCount > 0 )
+        CudaErrCheck( cudaMemsetAsync( s2.devResidentCounts, 0, sizeof( uint32 ) * BBCU_BUCKET_COUNT, cx.computeStream ) );
+
     // Unpack the first map beforehand
     UnpackLBucket( cx, 0 );
 
@@ -310,16 +338,27 @@ void CudaK32PlotPhase3Step2( CudaK32PlotContext& cx )
         const uint32 rEntryCount = p3.prunedBucketCounts[(int)rTable][bucket];
 
 
-        uint64* devOutLPs     = (uint64*)s2.lpOut   .LockDeviceBuffer( cx.computeStream );
-        uint32* devOutIndices = (uint32*)s2.indexOut.LockDeviceBuffer( cx.computeStream );
+        uint64* devOutLPs     = nullptr;
+        uint32* devOutIndices = nullptr;
+
+        if( downloadBucketCount > 0 )
+        {
+            devOutLPs     = (uint64*)s2.lpOut   .LockDeviceBuffer( cx.computeStream );
+            devOutIndices = (uint32*)s2.indexOut.LockDeviceBuffer( cx.computeStream );
+        }
 
         ConvertRMapToLinePoints( cx, rEntryCount, rTableOffset, devLTable, rMap, devOutLPs, devOutIndices, cx.computeStream );
         s2.rMapIn.ReleaseDeviceBuffer( cx.computeStream );
         rTableOffset += rEntryCount;
 
-        // Horizontal download (write 1 row)
-        s2.lpOut   .Download2DT<uint64>( p3.hostLinePoints + (size_t)bucket * P3_PRUNED_BUCKET_MAX  , P3_PRUNED_SLICE_MAX, BBCU_BUCKET_COUNT, P3_PRUNED_SLICE_MAX  , P3_PRUNED_SLICE_MAX, cx.computeStream );
-        s2.indexOut.Download2DT<uint32>( p3.hostIndices    + (size_t)bucket * P3_PRUNED_BUCKET_MAX*3, P3_PRUNED_SLICE_MAX, BBCU_BUCKET_COUNT, P3_PRUNED_SLICE_MAX*3, P3_PRUNED_SLICE_MAX, cx.computeStream );
+        // Horizontal download (write 1 row), skipping the resident buckets' slices
+        if( downloadBucketCount > 0 )
+        {
+            const size_t residentSlices = s2.residentBucketCount * (size_t)P3_PRUNED_SLICE_MAX;
+
+            s2.lpOut   .Download2DT<uint64>( p3.hostLinePoints + (size_t)bucket * P3_PRUNED_BUCKET_MAX   + residentSlices  , P3_PRUNED_SLICE_MAX, downloadBucketCount, P3_PRUNED_SLICE_MAX  , P3_PRUNED_SLICE_MAX, cx.computeStream );
+            s2.indexOut.Download2DT<uint32>( p3.hostIndices    + (size_t)bucket * P3_PRUNED_BUCKET_MAX*3 + residentSlices*3, P3_PRUNED_SLICE_MAX, downloadBucketCount, P3_PRUNED_SLICE_MAX*3, P3_PRUNED_SLICE_MAX, cx.computeStream );
+        }
     }
 
     #if _DEBUG
@@ -436,8 +475,16 @@ void WritePark7( CudaK32PlotContext& cx )
     const uint64 tableEntryCount = cx.tableEntryCounts[(int)cx.table];
     const size_t totalParkCount  = CDiv( (size_t)tableEntryCount, kEntriesPerPark );
 
-    byte*   hostParks           = cx.useParkContext ? nullptr : hostAllocator.AllocT<byte>( totalParkCount * parkSize );
+    byte*   hostParks           = cx.useParkContext ? nullptr : hostAllocator.AllocT<byte>( totalParkCount * parkSize + BBCU_PARK_WRITE_SLACK );
     byte*   hostParksWriter     = cx.useParkContext ? nullptr : hostParks;
+
+    // Lay out the parks so that they can be written to the plot file without being copied
+    const size_t tableBlockOffset = cx.plotWriter->NextWriteBlockOffset();
+    uint64       tableParksSize   = 0;
+
+    if( hostParksWriter )
+        hostParksWriter = CudaK32PlotAlignParksForWrite( cx, hostParksWriter, tableBlockOffset, 0 );
+
     uint32* hostLastParkEntries = cx.useParkContext ? (uint32*)cx.parkContext->hostRetainedLinePoints : 
                                                       hostAllocator.CAlloc<uint32>( kEntriesPerPark );
 
@@ -491,10 +538,11 @@ void WritePark7( CudaK32PlotContext& cx )
 
         if( cx.useParkContext )
         {
-            ASSERT( downloadSize <= cx.parkContext->parkBufferChain->BufferSize() );
+            ASSERT( downloadSize + BBCU_PARK_WRITE_SLACK <= cx.parkContext->parkBufferChain->BufferSize() );
 
             // Override the park buffer to be used when using a park context
-            hostParksWriter = cx.parkContext->parkBufferChain->PeekBuffer( bucket );
+            hostParksWriter = CudaK32PlotAlignParksForWrite( cx, cx.parkContext->parkBufferChain->PeekBuffer( bucket ),
+                                                             tableBlockOffset, tableParksSize );
 
             // Wait for the next park buffer to be available
             parkDownloader.HostCallback([&cx]{
@@ -519,6 +567,7 @@ void WritePark7( CudaK32PlotContext& cx )
             }, &cx, cx.computeStream );
 
         hostParksWriter += downloadSize;
+        tableParksSize  += downloadSize;
         if( cx.useParkContext )
             hostParksWriter = nullptr;
     }
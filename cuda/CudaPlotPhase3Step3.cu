@@ -32,6 +32,10 @@ void CudaK32PlotPhase3Step3( CudaK32PlotContext& cx )
         if( entryCount < 1 )
             return;
 
+        // Already on the device
+        if( bucket < s2.residentBucketCount )
+            return;
+
         // Vertical input layout of data: Start at row 0, column according to the current bucket
         const uint64* linePoints = p3.hostLinePoints + (size_t)bucket * P3_PRUNED_SLICE_MAX;
         const uint32* indices    = p3.hostIndices    + (size_t)bucket * P3_PRUNED_SLICE_MAX * 3; // This buffer is shared with RMap ((uint32)*3) (which we're about to write to),
@@ -64,6 +68,15 @@ void CudaK32PlotPhase3Step3( CudaK32PlotContext& cx )
     CudaErrCheck( cudaMemcpyAsync( s3.devCTable, hostCTable, cTableSize, cudaMemcpyHostToDevice, 
                     s3.lpIn.GetQueue()->GetStream() ) );
 
+    const RANSEncTable* hostRANSTable = nullptr;
+    if( cx.gCfg->parkDeltaCoding == ParkDeltaCoding::RANS )
+    {
+        hostRANSTable = CreateRANSEncTable( !isCompressed ? kRValues[(int)lTable] : cx.gCfg->compressionInfo.ansRValue );
+
+        CudaErrCheck( cudaMemcpyAsync( s3.devRANSTable, hostRANSTable, sizeof( RANSEncTable ), cudaMemcpyHostToDevice, 
+                        s3.lpIn.GetQueue()->GetStream() ) );
+    }
+
     // Load initial bucket
     LoadBucket( cx, 0 );
 
@@ -103,6 +116,13 @@ void CudaK32PlotPhase3Step3( CudaK32PlotContext& cx )
         cx.parkContext->parkBufferChain->Reset();
     }
 
+    // Lay out the parks so that they can be written to the plot file without being copied
+    const size_t tableBlockOffset = cx.plotWriter->NextWriteBlockOffset();
+    uint64       tableParksSize   = 0;
+
+    if( !cx.useParkContext )
+        hostParksWriter = CudaK32PlotAlignParksForWrite( cx, hostParksWriter, tableBlockOffset, 0 );
+
     // if( !isCompressed && lTable == TableId::Table1 )
     //     hostParksWriter = (byte*)cx.hostBackPointers[(int)TableId::Table2].left;
 
@@ -137,9 +157,22 @@ void CudaK32PlotPhase3Step3( CudaK32PlotContext& cx )
         if( bucket + 1 < BBCU_BUCKET_COUNT )
             LoadBucket( cx, bucket + 1 );
 
-        // Wait for upload to finish
-        uint64* unsortedLinePoints = (uint64*)s3.lpIn   .GetUploadedDeviceBuffer( sortAndMapStream );
-        uint32* unsortedIndices    = (uint32*)s3.indexIn.GetUploadedDeviceBuffer( sortAndMapStream );
+        // Wait for upload to finish, unless step 2 left this bucket on the device
+        const bool isResident = bucket < p3.step2.residentBucketCount;
+
+        uint64* unsortedLinePoints;
+        uint32* unsortedIndices;
+
+        if( isResident )
+        {
+            unsortedLinePoints = p3.step2.devResidentLinePoints + (size_t)bucket * P3_PRUNED_BUCKET_MAX;
+            unsortedIndices    = p3.step2.devResidentIndices    + (size_t)bucket * P3_PRUNED_BUCKET_MAX;
+        }
+        else
+        {
+            unsortedLinePoints = (uint64*)s3.lpIn   .GetUploadedDeviceBuffer( sortAndMapStream );
+            unsortedIndices    = (uint32*)s3.indexIn.GetUploadedDeviceBuffer( sortAndMapStream );
+        }
 
         // Sort line points
         #if _DEBUG
@@ -163,8 +196,13 @@ void CudaK32PlotPhase3Step3( CudaK32PlotContext& cx )
 
         CudaErrCheck( cudaEventRecord( cx.computeEventB, sortAndMapStream ) );
 
-        s3.lpIn   .ReleaseDeviceBuffer( sortAndMapStream ); unsortedLinePoints = nullptr;
-        s3.indexIn.ReleaseDeviceBuffer( sortAndMapStream ); unsortedIndices    = nullptr;
+        if( !isResident )
+        {
+            s3.lpIn   .ReleaseDeviceBuffer( sortAndMapStream );
+            s3.indexIn.ReleaseDeviceBuffer( sortAndMapStream );
+        }
+        unsortedLinePoints = nullptr;
+        unsortedIndices    = nullptr;
 
         ///
         /// Map
@@ -199,7 +237,8 @@ void CudaK32PlotPhase3Step3( CudaK32PlotContext& cx )
 
         // Compress line point parks
         byte* devParks = (byte*)s3.parksOut.LockDeviceBuffer( lpStream );
-        CompressToParkInGPU( parkCount, hostParkSize, s3.devDeltaLinePoints, devParks, DEV_MAX_PARK_SIZE, stubBitSize, s3.devCTable, s3.devParkOverrunCount, lpStream );
+        CompressToParkInGPU( parkCount, hostParkSize, s3.devDeltaLinePoints, devParks, DEV_MAX_PARK_SIZE, stubBitSize, s3.devCTable, s3.devParkOverrunCount,
+                             cx.gCfg->parkDeltaCoding, s3.devRANSTable, lpStream );
 
         // Retain any entries that did not maked it into parks for the next bucket to process
         retainedLPCount = totalEntryCount - (parkCount * kEntriesPerPark);
@@ -233,10 +272,11 @@ void CudaK32PlotPhase3Step3( CudaK32PlotContext& cx )
         // Download parks
         if( cx.useParkContext )
         {
-            ASSERT( hostParkSize * parkCount <= cx.parkContext->parkBufferChain->BufferSize() );
+            ASSERT( hostParkSize * parkCount + BBCU_PARK_WRITE_SLACK <= cx.parkContext->parkBufferChain->BufferSize() );
 
             // Override the park buffer to be used when using a park context
-            hostParksWriter = cx.parkContext->parkBufferChain->PeekBuffer( bucket );
+            hostParksWriter = CudaK32PlotAlignParksForWrite( cx, cx.parkContext->parkBufferChain->PeekBuffer( bucket ),
+                                                             tableBlockOffset, tableParksSize );
 
             // Wait for the next park buffer to be available
             s3.parksOut.HostCallback([&cx]{
@@ -264,6 +304,7 @@ void CudaK32PlotPhase3Step3( CudaK32PlotContext& cx )
             }, &cx, lpStream, cx.downloadDirect );
 
         hostParksWriter += hostParkSize * parkCount;
+        tableParksSize  += hostParkSize * parkCount;
     
         if( cx.useParkContext )
             hostParksWriter = nullptr;
@@ -294,7 +335,8 @@ void CudaK32PlotPhase3Step3( CudaK32PlotContext& cx )
         uint64 lastParkEntries[kEntriesPerPark];
         bbmemcpy_t( lastParkEntries, hostRetainedEntries, retainedLPCount );
 
-        WritePark( hostParkSize, retainedLPCount, lastParkEntries, hostParksWriter, stubBitSize, hostCTable );
+        WritePark( hostParkSize, retainedLPCount, lastParkEntries, hostParksWriter, stubBitSize, hostCTable,
+                   cx.gCfg->parkDeltaCoding, hostRANSTable );
         cx.plotWriter->WriteTableData( hostParksWriter, hostParkSize );
 
         if( cx.useParkContext )
@@ -344,8 +386,8 @@ __global__ void CudaGenerateLMap( const uint32 entryCount, const uint32 finalOff
     const uint32 gid = blockIdx.x * blockDim.x + id;
 
     __shared__ uint32 sharedBucketCounts[BBCU_BUCKET_COUNT];
-    if( id < BBCU_BUCKET_COUNT )
-        sharedBucketCounts[id] = 0;
+    for( uint32 b = id; b < BBCU_BUCKET_COUNT; b += blockDim.x )
+        sharedBucketCounts[b] = 0;
 
     __syncthreads();
 
@@ -364,8 +406,8 @@ __global__ void CudaGenerateLMap( const uint32 entryCount, const uint32 finalOff
     __syncthreads();
 
     // Global offset
-    if( id < BBCU_BUCKET_COUNT )
-        sharedBucketCounts[id] = atomicAdd( &gBucketCounts[id], sharedBucketCounts[id] );
+    for( uint32 b = id; b < BBCU_BUCKET_COUNT; b += blockDim.x )
+        sharedBucketCounts[b] = atomicAdd( &gBucketCounts[b], sharedBucketCounts[b] );
 
     __syncthreads();
     
@@ -6,12 +6,19 @@
 #include "util/jobs/MemJobs.h"
 #include "util/StackAllocator.h"
 #include "CudaParkSerializer.h"
+#include "CudaSort.h"
+#include "CudaPack.h"
+#include "CudaTuning.h"
 #include "plotting/CTables.h"
 #include "plotting/TableWriter.h"
 #include "plotting/PlotTools.h"
+#include "plotting/MemoryPlanner.h"
+#include "plotting/PlotBenchmark.h"
+#include "plotting/HarvestYield.h"
 #include "util/VirtualAllocator.h"
 #include "harvesting/GreenReaper.h"
 #include "tools/PlotChecker.h"
+#include "plotting/PlotCheckQueue.h"
 
 
 // TEST/DEBUG
@@ -26,21 +33,49 @@
     static void DbgPruneTable( CudaK32PlotContext& cx, const TableId rTable );
 #endif
 
+// A plot context of its own, running one plot at a time on its thread (--pipelines)
+struct CudaK32Pipeline
+{
+    CudaK32PlotContext* cx     = nullptr;
+    Thread*             thread = nullptr;
+
+    // Copy of the request being plotted
+    PlotRequest         req;
+    byte                plotId[BB_PLOT_ID_LEN];
+    byte                memo  [BB_PLOT_MEMO_MAX_SIZE];
+    std::string         outDir;
+    std::string         plotFileName;
+    std::string         plotOutPath;
+};
+
 static void InitContext( CudaK32PlotConfig& cfg, CudaK32PlotContext*& outContext );
+static void RunPlot( CudaK32PlotContext& cx, const PlotRequest& req );
+static void PipelineThreadMain( CudaK32Pipeline* pipe );
+static void FinishPlots( CudaK32PlotContext& cx );
 static void CudaInit( CudaK32PlotContext& cx );
+static void ParseDeviceList( CudaK32PlotConfig& cfg, const char* list );
+static void SelectHybridModeForBudget( CudaK32PlotConfig& cfg );
 
 void GenF1Cuda( CudaK32PlotContext& cx );
 
 static void MakePlot( CudaK32PlotContext& cx );
+static void FinishPreviousPlot( CudaK32PlotContext& cx );
+static void FinishPlotWriter( CudaK32PlotContext& cx, PlotWriter* writer );
+static void RetireBackgroundPlotWriters( CudaK32PlotContext& cx, uint32 maxWriters );
 static void FpTable( CudaK32PlotContext& cx );
 static void FpTableBucket( CudaK32PlotContext& cx, const uint32 bucket );
 static void UploadBucketForTable( CudaK32PlotContext& cx, const uint64 bucket );
 static void FinalizeTable7( CudaK32PlotContext& cx );
+static void PreparePackedSlices( CudaK32PlotContext& cx );
 static void InlineTable( CudaK32PlotContext& cx, const uint32* devInX, cudaStream_t stream );
+static void RecomputeMetaFromInlinedPairs( uint32 entryCount, const Pair* devPairs, K32Meta2* devMetaOut, cudaStream_t stream );
 
 static void AllocBuffers( CudaK32PlotContext& cx );
 static void AllocateP1Buffers( CudaK32PlotContext& cx, CudaK32AllocContext& acx );
 static void AllocateParkSerializationBuffers( CudaK32PlotContext& cx, IAllocator& pinnedAllocator, bool dryRun );
+static void* AllocPinnedHost( CudaK32PlotContext& cx, size_t size, bool hugePages = false );
+static void PinParkBuffersThread( CudaK32PlotContext* cx );
+static void WaitForParkBuffers( CudaK32PlotContext& cx );
 
 template<typename T>
 static void UploadBucketToGpu( CudaK32PlotContext& context, TableId table, const uint32* hostPtr, T* devPtr, uint64 bucket, uint64 stride );
@@ -60,6 +95,9 @@ GPU-based (CUDA) plotter
  -h, --help           : Shows this help message and exits.
  -d, --device         : Select the CUDA device index. (default=0)
 
+ --devices <a,b>      : Use device <a> for plotting and device <b> for plot checks (see --check).
+                         Checks then run alongside the next plot on a different GPU.
+
  -l, --list           : List availabe CUDA devices, showing their indices.
 
  --json               : Show output in json format. This is only valid for certain parameters:
@@ -71,13 +109,46 @@ GPU-based (CUDA) plotter
  --disk-16            : (experimental) Enable hybrid disk plotting for 16G system RAM. 
                          Requires a --temp1 and --temp2 to be set.
 
+ --memory <size>      : Pick the plotting mode from the host RAM available to the plotter.
+                         Uses the in-RAM mode with 256G or more, --disk-128 with 128G or more,
+                         and --disk-16 otherwise. Ignored if --disk-128 or --disk-16 is given.
+                         Example: --memory 96G
+
+ --managed-memory     : Allocate the host tables as CUDA managed (unified) memory, and let the driver
+                         page them, instead of offloading them to temp disks with --disk-128.
+                         The tables are prefetched to host RAM ahead of each table being processed.
+                         Requires a device with concurrent managed access.
+                         Not supported with the hybrid disk modes. --memory will not select them.
+
  -t1, --temp1         : Temporary directory 1. Used for longer-lived, sequential writes.
 
  -t2, --temp2         : Temporary directory 2. Used for temporary, shorted-lived read and writes.
                          NOTE: If only one of -t1 or -t2 is specified, both will be
                                set to the same directory.
 
+ --gds                : Use GPUDirect Storage (cuFile) in hybrid modes, so that temp2 buckets are
+                         transferred between the GPU and the disk without host bounce buffers.
+                         Requires a build with BB_CUDA_USE_CUFILE and a GDS-capable system.
+                         Falls back to host buffers if unavailable.
+
+ --recompute-meta     : Regenerate table 2's metadata on the GPU from its inlined x's, instead of
+                         transferring it to the host (or temp2) and back. Only applies to
+                         compression levels where only table 1 is dropped (C1-C8).
+                         Enabled automatically on slow host links.
+
+ --pipelines <n>      : Make <n> (1 or 2) plots concurrently on the device, each with its own streams
+                         and buffers, so that one plot's transfers overlap the other's kernels.
+                         For large GPUs. Needs the GPU and host memory of <n> plotters,
+                         and is not supported with the hybrid disk modes.
+
+ --output-buffer <n>  : Copy the plot data to up to <n> bytes of host memory (ex: 16G) as it is
+                         written. Plots then finish writing in the background while the next
+                         plots are created, up to one plot per output directory at a time,
+                         and each new plot is sent to the least busy output directory.
+
  --check <n>          : Perform a plot check for <n> proofs on the newly created plot.
+                         Plots are checked in the background while the next plot is created,
+                         and only renamed to .plot once they pass.
 
  --check-threshold <f>: Proof threshold rate below which the plots that don't pass
                          the check will be deleted.
@@ -101,13 +172,19 @@ void CudaK32Plotter::ParseCLI( const GlobalPlotConfig& gCfg, CliParser& cli )
     CudaK32PlotConfig& cfg = _cfg;
     cfg.gCfg = &gCfg;
 
-    bool listDevices = false;
-    bool json        = false;
+    bool        listDevices = false;
+    bool        json        = false;
+    const char* devicesList = nullptr;
 
     while( cli.HasArgs() )
     {
         if( cli.ReadU32( cfg.deviceIndex, "-d", "--device" ) )
             continue;
+        if( cli.ReadStr( devicesList, "--devices" ) )
+        {
+            ParseDeviceList( cfg, devicesList );
+            continue;
+        }
         if( cli.ReadSwitch( cfg.hybrid128Mode, "--disk-128" ) )
             continue;
         if( cli.ReadSwitch( cfg.hybrid16Mode, "--disk-16" ) )
@@ -115,6 +192,10 @@ void CudaK32Plotter::ParseCLI( const GlobalPlotConfig& gCfg, CliParser& cli )
             cfg.hybrid128Mode = true;
             continue;
         }
+        if( cli.ReadSize( cfg.hostMemoryBudget, "--memory" ) )
+            continue;
+        if( cli.ReadSwitch( cfg.managedMemory, "--managed-memory" ) )
+            continue;
         if( cli.ReadStr( cfg.temp1Path, "-t1", "--temp1" ) )
         {
             if( !cfg.temp2Path )
@@ -131,6 +212,14 @@ void CudaK32Plotter::ParseCLI( const GlobalPlotConfig& gCfg, CliParser& cli )
             continue;
         if( cli.ReadUnswitch( cfg.temp2DirectIO, "--no-t2-direct" ) )
             continue;
+        if( cli.ReadSwitch( cfg.gpuDirectStorage, "--gds" ) )
+            continue;
+        if( cli.ReadSwitch( cfg.recomputeMeta, "--recompute-meta" ) )
+            continue;
+        if( cli.ReadSize( cfg.outputBufferSize, "--output-buffer" ) )
+            continue;
+        if( cli.ReadU32( cfg.pipelineCount, "--pipelines" ) )
+            continue;
 
         if( cli.ReadU64( cfg.plotCheckCount, "--check" ) )
             continue;
@@ -155,6 +244,45 @@ void CudaK32Plotter::ParseCLI( const GlobalPlotConfig& gCfg, CliParser& cli )
     if( listDevices )
         ListCudaDevices( json );
 
+    if( !cfg.hasCheckDevice )
+        cfg.checkDeviceIndex = cfg.deviceIndex;
+    else if( cfg.plotCheckCount == 0 )
+        Log::Line( "Warning: --devices was given a plot check device, but --check was not specified." );
+
+    if( cfg.hostMemoryBudget == 0 )
+        cfg.hostMemoryBudget = gCfg.maxMemory;
+
+    FatalIf( cfg.pipelineCount < 1 || cfg.pipelineCount > 2, "--pipelines must be 1 or 2." );
+
+    // Each pipeline gets an equal share of the budget
+    if( cfg.pipelineCount > 1 )
+    {
+        FatalIf( cfg.hybrid128Mode, "--pipelines is not supported with the hybrid disk modes." );
+        FatalIf( gCfg.bench, "--pipelines is not supported with bench, as plot timings would overlap." );
+        cfg.hostMemoryBudget /= cfg.pipelineCount;
+    }
+
+    FatalIf( cfg.managedMemory && cfg.hybrid128Mode, "--managed-memory is not supported with the hybrid disk modes." );
+
+    // Managed host tables are paged by the driver, instead of offloaded to disk
+    if( cfg.hostMemoryBudget > 0 && !cfg.hybrid128Mode && !cfg.managedMemory )
+        SelectHybridModeForBudget( cfg );
+
+    FatalIf( cfg.pipelineCount > 1 && cfg.hybrid128Mode,
+        "The host memory budget requires a hybrid disk mode, which --pipelines does not support." );
+
+    if( cfg.hybrid128Mode && !cfg.temp1Path )
+    {
+        Log::Error( "Error: Hybrid disk plotting requires --temp1 and/or --temp2." );
+        Exit( -1 );
+    }
+
+    if( cfg.gpuDirectStorage && !cfg.hybrid128Mode )
+    {
+        Log::Line( "Warning: --gds only applies to hybrid disk modes. Ignoring it." );
+        cfg.gpuDirectStorage = false;
+    }
+
     if( cfg.hybrid128Mode && gCfg.compressionLevel <= 0 )
     {
         Log::Error( "Error: Cannot plot classic (uncompressed) plots in 128G or 64G mode." );
@@ -180,6 +308,56 @@ void CudaK32Plotter::ParseCLI( const GlobalPlotConfig& gCfg, CliParser& cli )
     }
 }
 
+//-----------------------------------------------------------
+void SelectHybridModeForBudget( CudaK32PlotConfig& cfg )
+{
+    // Rough host RAM needed by each layout. The actual requirement is
+    // printed when allocating buffers, and checked against the budget there.
+    constexpr size_t fullRAMRequired   = 256ull GB;
+    constexpr size_t hybrid128Required = 128ull GB;
+
+    const size_t budget = cfg.hostMemoryBudget;
+
+    if( budget >= fullRAMRequired )
+        return;
+
+    cfg.hybrid128Mode = true;
+    cfg.hybrid16Mode  = budget < hybrid128Required;
+
+    Log::Line( "Selected %s mode for a host memory budget of %.2lf GiB.", 
+        cfg.hybrid16Mode ? "--disk-16" : "--disk-128", (double)budget BtoGB );
+}
+
+//-----------------------------------------------------------
+void ParseDeviceList( CudaK32PlotConfig& cfg, const char* list )
+{
+    uint32 devices[2]  = {};
+    uint32 deviceCount = 0;
+
+    const char* c = list;
+    for( ;; )
+    {
+        char* end = nullptr;
+        const unsigned long index = strtoul( c, &end, 10 );
+        FatalIf( end == c || index > 0xFFFF, "Invalid --devices value '%s'. Expected a comma-separated list of device indices.", list );
+        FatalIf( deviceCount >= 2, "--devices accepts at most 2 devices: one for plotting and one for plot checks." );
+
+        devices[deviceCount++] = (uint32)index;
+
+        if( *end == 0 )
+            break;
+        FatalIf( *end != ',', "Invalid --devices value '%s'. Expected a comma-separated list of device indices.", list );
+        c = end + 1;
+    }
+
+    cfg.deviceIndex = devices[0];
+    if( deviceCount > 1 )
+    {
+        cfg.checkDeviceIndex = devices[1];
+        cfg.hasCheckDevice   = true;
+    }
+}
+
 //-----------------------------------------------------------
 void CudaK32Plotter::Init()
 {
@@ -187,6 +365,18 @@ void CudaK32Plotter::Init()
         return;
 
     InitContext( _cfg, _cx );
+
+    if( _cfg.pipelineCount > 1 )
+    {
+        _pipelines = new CudaK32Pipeline[_cfg.pipelineCount]{};
+        _pipelines[0].cx = _cx;
+
+        for( uint32 i = 1; i < _cfg.pipelineCount; i++ )
+        {
+            Log::Line( "Creating plot pipeline %u...", i+1 );
+            InitContext( _cfg, _pipelines[i].cx );
+        }
+    }
 }
 
 //-----------------------------------------------------------
@@ -221,6 +411,9 @@ void InitContext( CudaK32PlotConfig& cfg, CudaK32PlotContext*& outContext )
     CudaErrCheck( cudaStreamCreateWithFlags( &cx.computeStreamC, cudaStreamNonBlocking ) );
     CudaErrCheck( cudaStreamCreateWithFlags( &cx.computeStreamD, cudaStreamNonBlocking ) );
 
+    if( cfg.managedMemory )
+        CudaErrCheck( cudaStreamCreateWithFlags( &cx.prefetchStream, cudaStreamNonBlocking ) );
+
     cudaEventCreateWithFlags( &cx.computeEventA, cudaEventDisableTiming );
     cudaEventCreateWithFlags( &cx.computeEventB, cudaEventDisableTiming );
     cudaEventCreateWithFlags( &cx.computeEventC, cudaEventDisableTiming );
@@ -231,7 +424,8 @@ void InitContext( CudaK32PlotConfig& cfg, CudaK32PlotContext*& outContext )
         cx.gpuUploadStream  [i] = new GpuQueue( GpuQueue::Uploader   );
     }
 
-    cx.threadPool = new ThreadPool( SysHost::GetLogicalCPUCount() );
+    // Stay within the global thread count, on this plotter's own CPUs when running with 'multi'
+    cx.threadPool = new ThreadPool( cx.gCfg->threadCount, ThreadPool::Mode::Fixed, cx.gCfg->disableCpuAffinity, cx.gCfg->cpuOffset );
     cx.plotFence  = new Fence();
     cx.parkFence  = new Fence();
 
@@ -252,7 +446,9 @@ void InitContext( CudaK32PlotConfig& cfg, CudaK32PlotContext*& outContext )
     {
         cx.parkContext    = new CudaK32ParkContext{};
 
-        if( cx.cfg.hybrid16Mode )
+        // In hybrid modes, stream P3 parks through the park buffer chain straight into the plot writer,
+        // instead of staging a whole table's parks in host table memory first.
+        if( cx.cfg.hybrid128Mode )
             cx.useParkContext = true;
     }
 
@@ -269,11 +465,43 @@ void InitContext( CudaK32PlotConfig& cfg, CudaK32PlotContext*& outContext )
             cx.diskContext->temp2Queue = cx.diskContext->temp1Queue;
         else
             cx.diskContext->temp2Queue = new DiskQueue( cx.cfg.temp2Path );
+
+        if( cx.cfg.gpuDirectStorage )
+        {
+            cx.diskContext->gpuDirectStorage = GpuQueue::InitGpuDirectStorage();
+            Log::Line( "GPUDirect Storage %s.", cx.diskContext->gpuDirectStorage ? "enabled" : "unavailable, using host buffers" );
+        }
     }
 
     cx.phase2 = new CudaK32Phase2{};
     cx.phase3 = new CudaK32Phase3{};
 
+    // On slow host links, transfers fall behind the kernels, so queue up more phase 1 buckets.
+    // In 16G mode they are all disk-backed and double-buffered by their disk buffers,
+    // and GPUDirect Storage requires double-buffering. AllocBuffers() falls back to it if this doesn't fit in memory.
+    {
+        const double bandwidth = std::min( cx.transferBandwidth.h2d, cx.transferBandwidth.d2h );
+        const bool   gds       = cx.diskContext && cx.diskContext->gpuDirectStorage;
+
+        if( bandwidth > 0 && bandwidth < BBCU_LOW_TRANSFER_BANDWIDTH && !gds && !cx.cfg.hybrid16Mode )
+        {
+            cx.p1BufferCount = BBCU_LOW_BANDWIDTH_GPU_BUFFER_COUNT;
+            Log::Line( "Low host transfer bandwidth, using %u phase 1 transfer buffers.", cx.p1BufferCount );
+        }
+
+        // Recomputing table 2's meta is a trivial kernel, versus a round-trip of the whole table's meta
+        if( bandwidth > 0 && bandwidth < BBCU_LOW_TRANSFER_BANDWIDTH )
+            cx.cfg.recomputeMeta = true;
+    }
+
+    if( cx.cfg.recomputeMeta )
+    {
+        if( CudaK32PlotIsMetaRecomputed( cx, TableId::Table2 ) )
+            Log::Line( "Table 2 metadata will be recomputed on the GPU." );
+        else
+            cx.cfg.recomputeMeta = false;
+    }
+
     // #TODO: Support non-warm starting
     Log::Line( "Allocating buffers (this may take a few seconds)..." );
     AllocBuffers( cx );
@@ -290,7 +518,7 @@ void InitContext( CudaK32PlotConfig& cfg, CudaK32PlotContext*& outContext )
             grCfg.apiVersion     = GR_API_VERSION;
             grCfg.threadCount    = 1;
             grCfg.gpuRequest     = GRGpuRequestKind_ExactDevice;
-            grCfg.gpuDeviceIndex = cfg.deviceIndex;
+            grCfg.gpuDeviceIndex = cfg.checkDeviceIndex;
 
             auto grResult = grCreateContext( &cx.grCheckContext, &grCfg, sizeof( grCfg ) );
             FatalIf( grResult != GRResult_OK, "Failed to create decompression context for plot check with error '%s' (%d).",
@@ -299,12 +527,15 @@ void InitContext( CudaK32PlotConfig& cfg, CudaK32PlotContext*& outContext )
             grResult = grPreallocateForCompressionLevel( cx.grCheckContext, BBCU_K, cfg.gCfg->compressionLevel );
             FatalIf( grResult != GRResult_OK, "Failed to preallocate memory for decompression context with error '%s' (%d).",
                     grResultToString( grResult ), (int)grResult );
+
+            // Creating the context selects the check device on this thread, restore ours
+            CudaErrCheck( cudaSetDevice( cx.cudaDevice ) );
         }
 
         PlotCheckerConfig checkerCfg{};
         checkerCfg.proofCount         = cfg.plotCheckCount;
         checkerCfg.noGpu              = false;
-        checkerCfg.gpuIndex           = cfg.deviceIndex;
+        checkerCfg.gpuIndex           = cfg.checkDeviceIndex;
         checkerCfg.threadCount        = 1;
         checkerCfg.disableCpuAffinity = false;
         checkerCfg.silent             = false;
@@ -314,6 +545,18 @@ void InitContext( CudaK32PlotConfig& cfg, CudaK32PlotContext*& outContext )
         checkerCfg.grContext          = cx.grCheckContext;
 
         cx.plotChecker = PlotChecker::Create( checkerCfg );
+
+        // Check plots on a background thread while the next plot is made
+        cx.plotCheckQueue = new PlotCheckQueue( *cx.plotChecker );
+    }
+
+    if( cfg.outputBufferSize > 0 )
+    {
+        if( !cx.gCfg->benchmarkMode )
+        {
+            cx.plotStaging              = new PlotWriteStaging( cfg.outputBufferSize );
+            cx.maxBackgroundPlotWriters = std::max( 1u, cx.gCfg->outputFolderCount );
+        }
     }
 }
 
@@ -329,6 +572,9 @@ void CudaInit( CudaK32PlotContext& cx )
     FatalIf( cx.cfg.deviceIndex >= deviceCount, "CUDA device %u is out of range out of %d CUDA devices", 
             cx.cfg.deviceIndex, deviceCount );
     
+    FatalIf( cx.cfg.checkDeviceIndex >= deviceCount, "CUDA plot check device %u is out of range out of %d CUDA devices", 
+            cx.cfg.checkDeviceIndex, deviceCount );
+
     CudaFatalCheckMsg( cudaSetDevice( (int)cx.cfg.deviceIndex ), "Failed to set cuda device at index %u", cx.cfg.deviceIndex );
     cx.cudaDevice = (int32)cx.cfg.deviceIndex;
 
@@ -338,6 +584,19 @@ void CudaInit( CudaK32PlotContext& cx )
 
     Log::Line( "Selected cuda device %u : %s", cx.cudaDevice, cudaDevProps->name );
 
+    FatalIf( cx.cfg.managedMemory && !cudaDevProps->concurrentManagedAccess,
+        "--managed-memory requires a device and OS with concurrent managed memory access." );
+
+    if( CudaTuning::LoadProfile( cx.cudaDevice ) )
+        Log::Line( "Loaded tuned launch profile '%s'", CudaTuning::ProfilePath( cx.cudaDevice ).c_str() );
+
+    if( cx.cfg.checkDeviceIndex != cx.cfg.deviceIndex )
+    {
+        cudaDeviceProp checkDevProps = {};
+        CudaErrCheck( cudaGetDeviceProperties( &checkDevProps, (int)cx.cfg.checkDeviceIndex ) );
+        Log::Line( "Plot check cuda device %u : %s", cx.cfg.checkDeviceIndex, checkDevProps.name );
+    }
+
     // Get info & limites
     size_t stack = 0, memFree = 0, memTotal = 0;
     cudaMemGetInfo( &memFree, &memTotal );
@@ -354,6 +613,16 @@ void CudaInit( CudaK32PlotContext& cx )
     Log::Line( " Memory:" );
     Log::Line( "  Total                    : %.2lf GB", (double)memTotal BtoGB );
     Log::Line( "  Free                     : %.2lf GB", (double)memFree  BtoGB );
+
+    // Measure the host link, to size the transfer pipeline for it (see InitContext())
+    if( GpuQueue::MeasureTransferBandwidth( cx.transferBandwidth ) )
+    {
+        Log::Line( " Transfer bandwidth:" );
+        Log::Line( "  Host to device           : %.2lf GB/s", BtoGBSiF( cx.transferBandwidth.h2d ) );
+        Log::Line( "  Device to host           : %.2lf GB/s", BtoGBSiF( cx.transferBandwidth.d2h ) );
+    }
+    else
+        Log::Line( " Transfer bandwidth        : unavailable" );
     Log::Line( "" );
 
     // Ensure we have the correct capabilities    
@@ -433,21 +702,103 @@ void CudaK32Plotter::Run( const PlotRequest& req )
     if( _cx == nullptr )
         Init();
 
-    auto&       cx  = *_cx;
-    const auto& cfg = _cfg;
+    if( _pipelines )
+        RunPipelined( req );
+    else
+        RunPlot( *_cx, req );
+}
+
+//-----------------------------------------------------------
+void CudaK32Plotter::RunPipelined( const PlotRequest& req )
+{
+    // Hand the plot to the pipelines in turn, waiting only for the one whose turn it is.
+    // The request's buffers belong to the caller, so they are copied.
+    CudaK32Pipeline& pipe = _pipelines[_nextPipeline];
+    _nextPipeline = ( _nextPipeline + 1 ) % _cfg.pipelineCount;
+
+    if( pipe.thread )
+    {
+        pipe.thread->WaitForExit();
+        delete pipe.thread;
+        pipe.thread = nullptr;
+    }
+
+    memcpy( pipe.plotId, req.plotId, sizeof( pipe.plotId ) );
+    memcpy( pipe.memo  , req.memo  , req.memoSize );
+    pipe.outDir       = req.outDir;
+    pipe.plotFileName = req.plotFileName;
+    pipe.plotOutPath  = req.plotOutPath;
+
+    pipe.req              = req;
+    pipe.req.plotId       = pipe.plotId;
+    pipe.req.memo         = pipe.memo;
+    pipe.req.outDir       = pipe.outDir.c_str();
+    pipe.req.plotFileName = pipe.plotFileName.c_str();
+    pipe.req.plotOutPath  = pipe.plotOutPath.c_str();
+
+    // Only the last plot of the run finishes off the pipelines, below
+    pipe.req.IsFinalPlot = false;
+
+    // Plotting runs deep on the stack, give it as much as the main thread
+    pipe.thread = new Thread( 8 MiB );
+    pipe.thread->Run( PipelineThreadMain, &pipe );
+
+    if( !req.IsFinalPlot )
+        return;
+
+    for( uint32 i = 0; i < _cfg.pipelineCount; i++ )
+    {
+        CudaK32Pipeline& p = _pipelines[i];
+
+        if( p.thread )
+        {
+            p.thread->WaitForExit();
+            delete p.thread;
+            p.thread = nullptr;
+        }
+
+        FinishPlots( *p.cx );
+    }
+
+    _nextPipeline = 0;
+}
+
+//-----------------------------------------------------------
+void PipelineThreadMain( CudaK32Pipeline* pipe )
+{
+    CudaErrCheck( cudaSetDevice( pipe->cx->cudaDevice ) );
+    RunPlot( *pipe->cx, pipe->req );
+}
+
+//-----------------------------------------------------------
+void RunPlot( CudaK32PlotContext& cx, const PlotRequest& req )
+{
+    const auto& cfg = cx.cfg;
 
     // Only start profiling from here (don't profile allocations)
     CudaErrCheck( cudaProfilerStart() );
 
+    // If the C tables were kept in the phase 1 host buffers, we can't start
+    // the next plot until the previous one has been completely written.
+    if( cx.parkContext == nullptr )
+        FinishPreviousPlot( cx );
+
+    // Staged plots don't hold our buffers, only wait for a writer slot
+    if( cx.plotStaging )
+        RetireBackgroundPlotWriters( cx, cx.maxBackgroundPlotWriters - 1 );
+
     ASSERT( cx.plotWriter == nullptr );
     cx.plotWriter = new PlotWriter( !cfg.gCfg->disableOutputDirectIO );
     if( cx.gCfg->benchmarkMode )
         cx.plotWriter->EnableDummyMode();
     if( cx.plotChecker )
-        cx.plotWriter->EnablePlotChecking( *cx.plotChecker );
+        cx.plotWriter->EnablePlotChecking( *cx.plotChecker, cx.plotCheckQueue );
+    if( cx.plotStaging )
+        cx.plotWriter->EnableStaging( *cx.plotStaging );
 
-    FatalIf( !cx.plotWriter->BeginPlot( cfg.gCfg->compressionLevel > 0 ? PlotVersion::v2_0 : PlotVersion::v1_0, 
-            req.outDir, req.plotFileName, req.plotId, req.memo, req.memoSize, cfg.gCfg->compressionLevel ), 
+    FatalIf( !cx.plotWriter->BeginPlot( cfg.gCfg->compressionLevel > 0 || cfg.gCfg->parkDeltaCoding != ParkDeltaCoding::FSE || cfg.gCfg->alignedParks ? PlotVersion::v2_0 : PlotVersion::v1_0, 
+            req.outDir, req.plotFileName, req.plotId, req.memo, req.memoSize, cfg.gCfg->compressionLevel,
+            GetParkDeltaCodingFlags( cfg.gCfg->parkDeltaCoding ) | ( cfg.gCfg->alignedParks ? PlotFlags::AlignedParks : PlotFlags::None ) ), 
         "Failed to open plot file with error: %d", cx.plotWriter->GetError() );
 
     cx.plotRequest = req;
@@ -455,30 +806,28 @@ void CudaK32Plotter::Run( const PlotRequest& req )
 
     cx.plotWriter->EndPlot( true );
 
-    // Ensure the last plot has ended
-    // #TODO: Move it elsewhere, using different buffers for parks
-    //        so that we can continue writing to disk until we get to
-    //        actually writing the next plot in table 7 finalization.
+    // Let the plot file finish writing in the background while the next plot
+    // starts phase 1. It is waited on once phase 1 of the next plot completes.
+    if( cx.plotStaging )
     {
-        const auto pltoCompleteTimer = TimerBegin();
-        cx.plotWriter->WaitForPlotToComplete();
-        const double plotIOTime = TimerEnd( pltoCompleteTimer );
-        Log::Line( "Completed writing plot in %.2lf seconds", plotIOTime );
-
-        if( !cx.plotChecker || !cx.plotChecker->LastPlotDeleted() )
-        {
-            cx.plotWriter->DumpTables();
-            Log::NewLine();
-        }
+        cx.backgroundPlotWriters.push_back( cx.plotWriter );
+        cx.plotWriter = nullptr;
+    }
+    else
+    {
+        ASSERT( cx.prevPlotWriter == nullptr );
+        cx.prevPlotWriter = cx.plotWriter;
+        cx.plotWriter     = nullptr;
     }
-    
-    delete cx.plotWriter;
-    cx.plotWriter = nullptr;
 
+    // Ensure the last plot has ended
+    if( cx.plotRequest.IsFinalPlot )
+        FinishPlots( cx );
 
     // Delete any temporary files
     #if !(DBG_BBCU_KEEP_TEMP_FILES)
-        if( cx.plotRequest.IsFinalPlot && cx.cfg.hybrid128Mode )
+        // When serving plot requests, the buffers are kept for the next request
+        if( cx.plotRequest.IsFinalPlot && cx.cfg.hybrid128Mode && !cx.gCfg->servePath )
         {
             if( cx.diskContext->yBuffer )    delete cx.diskContext->yBuffer;
             if( cx.diskContext->metaBuffer ) delete cx.diskContext->metaBuffer;
@@ -494,6 +843,70 @@ void CudaK32Plotter::Run( const PlotRequest& req )
     #endif
 }
 
+//-----------------------------------------------------------
+void FinishPlots( CudaK32PlotContext& cx )
+{
+    FinishPreviousPlot( cx );
+    RetireBackgroundPlotWriters( cx, 0 );
+
+    if( cx.plotCheckQueue )
+    {
+        const auto checkTimer = TimerBegin();
+        cx.plotCheckQueue->WaitForChecks();
+        Log::Line( "Completed checking plots in %.2lf seconds.", TimerEnd( checkTimer ) );
+    }
+}
+
+//-----------------------------------------------------------
+void FinishPreviousPlot( CudaK32PlotContext& cx )
+{
+    if( cx.prevPlotWriter == nullptr )
+        return;
+
+    FinishPlotWriter( cx, cx.prevPlotWriter );
+    cx.prevPlotWriter = nullptr;
+}
+
+//-----------------------------------------------------------
+void FinishPlotWriter( CudaK32PlotContext& cx, PlotWriter* writer )
+{
+    const auto plotCompleteTimer = TimerBegin();
+    writer->WaitForPlotToComplete();
+    const double plotIOTime = TimerEnd( plotCompleteTimer );
+    Log::Line( "Completed writing plot in %.2lf seconds", plotIOTime );
+
+    // Plots are checked in the background, so this one may still be deleted if it fails its check
+    writer->DumpTables();
+    Log::NewLine();
+
+    delete writer;
+}
+
+//-----------------------------------------------------------
+void RetireBackgroundPlotWriters( CudaK32PlotContext& cx, const uint32 maxWriters )
+{
+    auto& writers = cx.backgroundPlotWriters;
+
+    // Collect the plots that have already finished, in any order
+    for( auto it = writers.begin(); it != writers.end(); )
+    {
+        if( (*it)->IsPlotComplete() )
+        {
+            FinishPlotWriter( cx, *it );
+            it = writers.erase( it );
+        }
+        else
+            it++;
+    }
+
+    // Then wait on the oldest ones until under the limit
+    while( writers.size() > maxWriters )
+    {
+        FinishPlotWriter( cx, writers.front() );
+        writers.pop_front();
+    }
+}
+
 //-----------------------------------------------------------
 void MakePlot( CudaK32PlotContext& cx )
 {
@@ -536,6 +949,7 @@ void MakePlot( CudaK32PlotContext& cx )
 
         const auto elapsed = TimerEnd( timer );
         Log::Line( "Finished F1 in %.2lf seconds.", elapsed );
+        PlotBenchmark::RecordTable( 1, TableId::Table1, elapsed );
     }
 
     /// Forward-propagate the rest of the tables
@@ -549,21 +963,29 @@ void MakePlot( CudaK32PlotContext& cx )
 
     const auto p1Elapsed = TimerEnd( p1Timer );
     Log::Line( "Completed Phase 1 in %.2lf seconds", p1Elapsed );
+    PlotBenchmark::RecordPhase( 1, p1Elapsed );
     #endif
 
+    // The previous plot's parks may still be flushing from the park buffers, which Phase 3 re-uses
+    FinishPreviousPlot( cx );
+
     // Prune
     #if !BBCU_DBG_SKIP_PHASE_2
     const auto p2Timer = TimerBegin();
     CudaK32PlotPhase2( cx );
     const auto p2Elapsed = TimerEnd( p2Timer );
     Log::Line( "Completed Phase 2 in %.2lf seconds", p2Elapsed );
+    PlotBenchmark::RecordPhase( 2, p2Elapsed );
     #endif
 
     // Compress & write plot tables
+    WaitForParkBuffers( cx );
+
     const auto p3Timer = TimerBegin();
     CudaK32PlotPhase3( cx );
     const auto p3Elapsed = TimerEnd( p3Timer );
     Log::Line( "Completed Phase 3 in %.2lf seconds", p3Elapsed );
+    PlotBenchmark::RecordPhase( 3, p3Elapsed );
 
     auto plotElapsed = TimerEnd( plotTimer );
     Log::Line( "Completed Plot 1 in %.2lf seconds ( %.2lf minutes )", plotElapsed, plotElapsed / 60.0 );
@@ -598,11 +1020,22 @@ void FpTable( CudaK32PlotContext& cx )
     CudaErrCheck( cudaMemsetAsync( cx.devSliceCounts, 0, sizeof( uint32 ) * BBCU_BUCKET_COUNT * BBCU_BUCKET_COUNT, cx.computeStream ) );
 
     // Load initial buckets
+    PreparePackedSlices( cx );
     UploadBucketForTable( cx, 0 );
 
+    if( PlotBenchmark::IsEnabled() && !cx.benchEventsCreated )
+    {
+        for( uint32 i = 0; i < BBCU_BUCKET_COUNT*2; i++ )
+            CudaErrCheck( cudaEventCreate( &cx.benchBucketEvents[i] ) );
+
+        cx.benchEventsCreated = true;
+    }
+
     const auto timer = TimerBegin();
     for( uint32 bucket = 0; bucket < BBCU_BUCKET_COUNT; bucket++ )
     {
+        // --yield-to-harvest: Hold off on launching the next bucket while a local harvester is busy
+        HarvestYield::Yield();
         FpTableBucket( cx, bucket );
     }
 
@@ -690,6 +1123,20 @@ void FpTable( CudaK32PlotContext& cx )
     const auto elapsed = TimerEnd( timer );
     Log::Line( "Table %u completed in %.2lf seconds with %llu entries.", 
                (uint32)cx.table+1, elapsed, cx.tableEntryCounts[(int)cx.table] );
+    PlotBenchmark::RecordTable( 1, cx.table, elapsed );
+
+    if( PlotBenchmark::IsEnabled() )
+    {
+        double gpuSeconds = 0;
+        for( uint32 bucket = 0; bucket < BBCU_BUCKET_COUNT; bucket++ )
+        {
+            float ms = 0;
+            CudaErrCheck( cudaEventElapsedTime( &ms, cx.benchBucketEvents[bucket*2], cx.benchBucketEvents[bucket*2+1] ) );
+            gpuSeconds += ms / 1000.0;
+        }
+
+        PlotBenchmark::RecordTableGpuTime( 1, cx.table, gpuSeconds );
+    }
 
     /// DEBUG
     #if DBG_BBCU_P1_WRITE_PAIRS
@@ -729,17 +1176,18 @@ void FpTableBucket( CudaK32PlotContext& cx, const uint32 bucket )
     cudaStream_t metaStream  = cx.computeStream;//B;
     cudaStream_t pairsStream = cx.computeStream;//C;
 
-    uint32* sortKeyIn  = (uint32*)cx.devMatches;
+    // A null sort key input makes the sort generate it
+    uint32* sortKeyIn  = nullptr;
     uint32* sortKeyOut = cx.devSortKey;
-    if( cx.table > TableId::Table2 )
-    {
-        // Generate a sorting key
-        CudaK32PlotGenSortKey( entryCount, sortKeyIn, mainStream );
-    }
- 
+
     uint32* devYUnsorted    = (uint32*)cx.yIn.GetUploadedDeviceBuffer( mainStream );
     uint32* devMetaUnsorted = nullptr;
 
+    // Measured from when the bucket's y values are on the device
+    const bool benchmarking = PlotBenchmark::IsEnabled();
+    if( benchmarking )
+        CudaErrCheck( cudaEventRecord( cx.benchBucketEvents[bucket*2], mainStream ) );
+
     uint32* devYSorted      = cx.devYWork;
     uint32* devMetaSorted   = cx.devMetaWork;
 
@@ -750,12 +1198,12 @@ void FpTableBucket( CudaK32PlotContext& cx, const uint32 bucket )
         sortKeyOut      = devMetaSorted;
     }
 
-    // Sort y w/ key
-    CudaErrCheck( cub::DeviceRadixSort::SortPairs<uint32, uint32>( 
+    // Sort y w/ key. The bucket bits are the same for all entries, so only the bits below them are sorted.
+    CudaErrCheck( CudaRadixSortPairs<uint32>(
         cx.devSortTmp, cx.devSortTmpAllocSize, 
         devYUnsorted,  devYSorted, 
         sortKeyIn,     sortKeyOut, 
-        entryCount, 0, 32, mainStream ) );
+        entryCount, 0, BBC_BUCKET_SHIFT, mainStream ) );
 
     CudaErrCheck( cudaEventRecord( cx.computeEventC, mainStream ) );
     CudaErrCheck( cudaEventRecord( cx.computeEventA, mainStream ) );
@@ -782,6 +1230,13 @@ void FpTableBucket( CudaK32PlotContext& cx, const uint32 bucket )
             CudaK32PlotSortByKey( entryCount, sortKeyOut, pairsIn, sortedPairs, pairsStream );
             cx.xPairsIn.ReleaseDeviceBuffer( pairsStream );
 
+            // The sorted x pairs are also the sorted metadata
+            if( CudaK32PlotIsMetaRecomputed( cx, inTable ) )
+            {
+                RecomputeMetaFromInlinedPairs( entryCount, sortedPairs, (K32Meta2*)devMetaSorted, pairsStream );
+                CudaErrCheck( cudaEventRecord( cx.computeEventB, pairsStream ) );
+            }
+
             Pair* hostPairs = ((Pair*)cx.hostBackPointers[(int)inTable].left) + cx.prevTablePairOffset;
 
             // Write sorted pairs back to host
@@ -805,9 +1260,11 @@ void FpTableBucket( CudaK32PlotContext& cx, const uint32 bucket )
 
             // if( !isOutputCompressed )
             {
-                uint16* pairsRIn     = (uint16*)cx.pairsRIn       .GetUploadedDeviceBuffer( pairsStream );
+                // Unpack directly in sorted order
+                uint64* pairsRIn     = (uint64*)cx.pairsRIn       .GetUploadedDeviceBuffer( pairsStream );
                 uint16* sortedPairsR = (uint16*)cx.sortedPairsROut.LockDeviceBuffer( pairsStream );
-                CudaK32PlotSortByKey( entryCount, sortKeyOut, pairsRIn, sortedPairsR, pairsStream );
+                CudaUnpackSlices<uint16>( pairsRIn, cx.devInSliceCounts + bucket, BBCU_BUCKET_COUNT, BBCU_PACKED_PAIR_R_BITS,
+                                          entryCount, sortedPairsR, pairsStream, sortKeyOut );
                 cx.pairsRIn.ReleaseDeviceBuffer( pairsStream );
                 // hostPairsR      = cx.hostTableSortedR + cx.prevTablePairOffset; 
 
@@ -841,7 +1298,7 @@ void FpTableBucket( CudaK32PlotContext& cx, const uint32 bucket )
     }
 
     // Upload and sort metadata
-    if( cx.table > TableId::Table2 )
+    if( cx.table > TableId::Table2 && !CudaK32PlotIsMetaRecomputed( cx, inTable ) )
     {
         const uint32 metaMultiplier = GetTableMetaMultiplier( cx.table - 1 );
 
@@ -868,6 +1325,9 @@ void FpTableBucket( CudaK32PlotContext& cx, const uint32 bucket )
     // Compute Fx
     GenFx( cx, devYSorted, devMetaSorted, mainStream );
 
+    if( benchmarking )
+        CudaErrCheck( cudaEventRecord( cx.benchBucketEvents[bucket*2+1], mainStream ) );
+
     CudaK32PlotDownloadBucket( cx );
 
     cx.prevTablePairOffset += entryCount;
@@ -884,6 +1344,7 @@ void FinalizeTable7( CudaK32PlotContext& cx )
     cx.prevTablePairOffset = 0;
 
     // Upload initial bucket
+    PreparePackedSlices( cx );
     UploadBucketForTable( cx, 0 );
 
 
@@ -914,6 +1375,7 @@ void FinalizeTable7( CudaK32PlotContext& cx )
     // Reset park buffer chain, if we're using it
     if( cx.parkContext )
     {
+        WaitForParkBuffers( cx );
         cx.parkContext->parkBufferChain->Reset();
         parkDownloader.AssignDiskBuffer( nullptr ); // We want direct downloads to the park buffers, which are pinned already
     }
@@ -931,7 +1393,7 @@ void FinalizeTable7( CudaK32PlotContext& cx )
     uint32* hostC2Buffer        = hostAlloc.CAlloc<uint32>( c2TotalEntries );
     uint32* hostLastParkEntries = hostAlloc.CAlloc<uint32>( kCheckpoint1Interval );
     byte*   hostLastParkBuffer  = (byte*)hostAlloc.CAlloc<uint32>( kCheckpoint1Interval );
-    byte*   hostCompressedParks = cx.parkContext ? nullptr : hostAlloc.AllocT<byte>( totalParkSize );
+    byte*   hostCompressedParks = cx.parkContext ? nullptr : hostAlloc.AllocT<byte>( totalParkSize + BBCU_PARK_WRITE_SLACK );
 
     byte*   hostParkWriter      = hostCompressedParks;
     uint32* hostC1Writer        = hostC1Buffer;
@@ -963,11 +1425,17 @@ void FinalizeTable7( CudaK32PlotContext& cx )
     cx.plotWriter->ReserveTableSize( PlotTable::C2, c2TableSizeBytes );
     cx.plotWriter->BeginTable( PlotTable::C3 );
 
+    // Lay out the parks so that they can be written to the plot file without being copied
+    const size_t c3BlockOffset = cx.plotWriter->NextWriteBlockOffset();
+    uint64       c3ParksSize   = 0;
+
+    if( hostParkWriter )
+        hostParkWriter = CudaK32PlotAlignParksForWrite( cx, hostParkWriter, c3BlockOffset, 0 );
+
     // Save a buffer with space before the start of it for us to copy retained entries for the next park.
     uint32  retainedC3EntryCount = 0;
     uint32* devYSorted           = cx.devYWork + kCheckpoint1Interval;
 
-    uint32* sortKeyIn  = (uint32*)cx.devMatches;
     uint32* sortKeyOut = cx.devSortKey;
 
     // Compress parks
@@ -983,20 +1451,26 @@ void FinalizeTable7( CudaK32PlotContext& cx )
         ASSERT( entryCount > kCheckpoint1Interval );
 
 
-        // Generate a sorting key
-        CudaK32PlotGenSortKey( entryCount, sortKeyIn, mainStream );
+        // Unpack y, restoring its bucket bits (devXInlineInput is unused while finalizing table 7)
+        uint32* devYUnsorted = cx.devXInlineInput;
+        {
+            const uint64* devYPacked = (uint64*)cx.yIn.GetUploadedDeviceBuffer( mainStream );
+
+            CudaUnpackSlices<uint32>( devYPacked, cx.devInSliceCounts + bucket, BBCU_BUCKET_COUNT, BBCU_PACKED_Y_T7_BITS,
+                                      entryCount, devYUnsorted, mainStream, nullptr, bucket << BBC_BUCKET_SHIFT_T7 );
 
-        // Sort y w/ key
-        uint32* devYUnsorted = (uint32*)cx.yIn.GetUploadedDeviceBuffer( mainStream );
+            cx.yIn.ReleaseDeviceBuffer( mainStream );
+        }
 
-        CudaErrCheck( cub::DeviceRadixSort::SortPairs<uint32, uint32>( 
+        // Sort y w/ a generated key, on the bits below the bucket bits
+        CudaErrCheck( CudaRadixSortPairs<uint32>(
             cx.devSortTmp, cx.devSortTmpAllocSize, 
             devYUnsorted, devYSorted,
-            sortKeyIn, sortKeyOut, 
-            entryCount, 0, 32, mainStream ) );
+            nullptr, sortKeyOut, 
+            entryCount, 0, BBC_BUCKET_SHIFT_T7, mainStream ) );
 
         CudaErrCheck( cudaEventRecord( cx.computeEventA, mainStream ) );
-        cx.yIn.ReleaseDeviceBuffer( mainStream ); devYUnsorted = nullptr;
+        devYUnsorted = nullptr;
 
         // Sort pairs
         {
@@ -1008,8 +1482,9 @@ void FinalizeTable7( CudaK32PlotContext& cx )
             cx.pairsLIn.ReleaseDeviceBuffer( pairsStream );
 
             uint16* sortedPairsR = (uint16*)cx.sortedPairsROut.LockDeviceBuffer( pairsStream );
-            uint16* pairsRIn     = (uint16*)cx.pairsRIn.GetUploadedDeviceBuffer( pairsStream );
-            CudaK32PlotSortByKey( entryCount, sortKeyOut, pairsRIn, sortedPairsR, pairsStream );
+            uint64* pairsRIn     = (uint64*)cx.pairsRIn.GetUploadedDeviceBuffer( pairsStream );
+            CudaUnpackSlices<uint16>( pairsRIn, cx.devInSliceCounts + bucket, BBCU_BUCKET_COUNT, BBCU_PACKED_PAIR_R_BITS,
+                                      entryCount, sortedPairsR, pairsStream, sortKeyOut );
             cx.pairsRIn.ReleaseDeviceBuffer( pairsStream );
 
 
@@ -1074,10 +1549,11 @@ void FinalizeTable7( CudaK32PlotContext& cx )
 
         if( cx.parkContext )
         {
-            ASSERT( parkDownloadSize <= cx.parkContext->parkBufferChain->BufferSize() );
+            ASSERT( parkDownloadSize + BBCU_PARK_WRITE_SLACK <= cx.parkContext->parkBufferChain->BufferSize() );
 
             // Override the park buffer to be used when using a park context
-            hostParkWriter = cx.parkContext->parkBufferChain->PeekBuffer( bucket );
+            hostParkWriter = CudaK32PlotAlignParksForWrite( cx, cx.parkContext->parkBufferChain->PeekBuffer( bucket ),
+                                                            c3BlockOffset, c3ParksSize );
 
             // Wait for the next park buffer to be available to be used for download
             parkDownloader.HostCallback([&cx]{
@@ -1104,6 +1580,7 @@ void FinalizeTable7( CudaK32PlotContext& cx )
 
             }, &cx, mainStream, directOverride );
         hostParkWriter += parkDownloadSize;
+        c3ParksSize    += parkDownloadSize;
 
         if( cx.parkContext )
             hostParkWriter = nullptr;
@@ -1198,6 +1675,19 @@ __global__ void CudaInlineTable( const uint32* entryCount, const uint32* inX, co
     inlinedPairs[gid] = inlined;
 }
 
+//-----------------------------------------------------------
+__global__ void CudaInlinedPairsToMeta( const uint32 entryCount, const Pair* pairs, K32Meta2* outMeta )
+{
+    const uint32 gid = blockIdx.x * blockDim.x + threadIdx.x;
+
+    if( gid >= entryCount )
+        return;
+
+    const Pair pair = pairs[gid];
+
+    outMeta[gid] = (K32Meta2)pair.left << 32 | pair.right;
+}
+
 //-----------------------------------------------------------
 template<bool UseLP>
 __global__ void CudaCompressTable( const uint32* entryCount, const uint32* inLEntries, const Pair* matches, uint32* outREntries, const uint32 bitShift )
@@ -1245,6 +1735,16 @@ void InlineTable( CudaK32PlotContext& cx, const uint32* devInX, cudaStream_t str
     }
 }
 
+//-----------------------------------------------------------
+void RecomputeMetaFromInlinedPairs( const uint32 entryCount, const Pair* devPairs, K32Meta2* devMetaOut, cudaStream_t stream )
+{
+    const uint32 kthreads = 256;
+    const uint32 kblocks  = CDiv( entryCount, (int)kthreads );
+
+    if( kblocks )
+        CudaInlinedPairsToMeta<<<kblocks, kthreads, 0, stream>>>( entryCount, devPairs, devMetaOut );
+}
+
 //-----------------------------------------------------------
 void CudaK32PlotDownloadBucket( CudaK32PlotContext& cx )
 {
@@ -1267,10 +1767,17 @@ void CudaK32PlotDownloadBucket( CudaK32PlotContext& cx )
     const size_t dstStride    = writeVertical ? BBCU_BUCKET_ALLOC_ENTRY_COUNT : BBCU_MAX_SLICE_ENTRY_COUNT;
     const size_t srcStride    = BBCU_MAX_SLICE_ENTRY_COUNT;
 
-    cx.yOut.Download2DT<uint32>( hostY + startOffset, width, height, dstStride, srcStride, cx.computeStream );
+    if( cx.table == TableId::Table7 )
+    {
+        // Packed y's
+        const size_t packedStride = cx.packedYT7SliceStride;
+        cx.yOut.Download2D( hostY + startOffset, packedStride, height, dstStride * sizeof( uint32 ), packedStride, cx.computeStream );
+    }
+    else
+        cx.yOut.Download2DT<uint32>( hostY + startOffset, width, height, dstStride, srcStride, cx.computeStream );
 
     // Metadata
-    if( metaMultiplier > 0 )
+    if( metaMultiplier > 0 && !CudaK32PlotIsMetaRecomputed( cx, cx.table ) )
     {
         const size_t metaSizeMultiplier = metaMultiplier == 3 ? 4 : metaMultiplier;
         const size_t metaSize           = sizeof( uint32 ) * metaSizeMultiplier;
@@ -1294,11 +1801,37 @@ void CudaK32PlotDownloadBucket( CudaK32PlotContext& cx )
             cx.pairsLOut.Download2DT<uint32>( hostPairsL + startOffset, width, height, dstStride, srcStride, cx.computeStream );
 
             if( !downloadCompressed )
-                cx.pairsROut.Download2DT<uint16>( hostPairsR + startOffset, width, height, dstStride, srcStride, cx.computeStream );
+            {
+                // Packed R pairs
+                const size_t packedStride = cx.packedPairsRSliceStride;
+                cx.pairsROut.Download2D( hostPairsR + startOffset, packedStride, height, dstStride * sizeof( uint16 ), packedStride, cx.computeStream );
+            }
         }
     }
 }
 
+//-----------------------------------------------------------
+void PreparePackedSlices( CudaK32PlotContext& cx )
+{
+    const uint32 inIdx = CudaK32PlotGetInputIndex( cx );
+
+    // Packed slices are uploaded compacted, by their size in words
+    for( uint32 slice = 0; slice < BBCU_BUCKET_COUNT; slice++ )
+    {
+        for( uint32 bucket = 0; bucket < BBCU_BUCKET_COUNT; bucket++ )
+        {
+            const uint32 count = cx.bucketSlices[inIdx][slice][bucket];
+
+            cx.packedPairsRSliceWords[slice][bucket] = CudaPackedSliceWordCount( count, BBCU_PACKED_PAIR_R_BITS );
+            cx.packedYT7SliceWords   [slice][bucket] = CudaPackedSliceWordCount( count, BBCU_PACKED_Y_T7_BITS );
+        }
+    }
+
+    // The device needs the entry counts to locate entries within the packed slices
+    CudaErrCheck( cudaMemcpyAsync( cx.devInSliceCounts, cx.bucketSlices[inIdx], sizeof( uint32 ) * BBCU_BUCKET_COUNT * BBCU_BUCKET_COUNT,
+                                   cudaMemcpyHostToDevice, cx.computeStream ) );
+}
+
 //-----------------------------------------------------------
 void UploadBucketForTable( CudaK32PlotContext& cx, const uint64 bucket )
 {
@@ -1338,7 +1871,13 @@ void UploadBucketForTable( CudaK32PlotContext& cx, const uint64 bucket )
 
     const uint32* counts = &cx.bucketSlices[inIdx][0][bucket];
 
-    cx.yIn.UploadArrayT<uint32>( hostY + offset, BBCU_BUCKET_COUNT, stride, BBCU_BUCKET_COUNT, counts, cx.computeStream );
+    if( inTable == TableId::Table7 )
+    {
+        cx.yIn.UploadArray( hostY + offset, BBCU_BUCKET_COUNT, sizeof( uint64 ), stride * sizeof( uint32 ),
+                            BBCU_BUCKET_COUNT, &cx.packedYT7SliceWords[0][bucket], cx.computeStream );
+    }
+    else
+        cx.yIn.UploadArrayT<uint32>( hostY + offset, BBCU_BUCKET_COUNT, stride, BBCU_BUCKET_COUNT, counts, cx.computeStream );
 
     // Upload pairs, also
     if( cx.table > TableId::Table2 )
@@ -1352,12 +1891,15 @@ void UploadBucketForTable( CudaK32PlotContext& cx, const uint64 bucket )
             cx.pairsLIn.UploadArrayT<uint32>( hostPairsL + offset, BBCU_BUCKET_COUNT, stride, BBCU_BUCKET_COUNT, counts, pairsStream );
 
             if( !uploadCompressed )
-                cx.pairsRIn.UploadArrayT<uint16>( hostPairsR + offset, BBCU_BUCKET_COUNT, stride, BBCU_BUCKET_COUNT, counts, pairsStream );
+            {
+                cx.pairsRIn.UploadArray( hostPairsR + offset, BBCU_BUCKET_COUNT, sizeof( uint64 ), stride * sizeof( uint16 ),
+                                         BBCU_BUCKET_COUNT, &cx.packedPairsRSliceWords[0][bucket], pairsStream );
+            }
         }
     }
 
     // Meta
-    if( metaMultiplier > 0 )
+    if( metaMultiplier > 0 && !CudaK32PlotIsMetaRecomputed( cx, inTable ) )
     {
         const size_t metaSizeMultiplier = metaMultiplier == 3 ? 4 : metaMultiplier;
         const size_t metaSize           = sizeof( uint32 ) * metaSizeMultiplier;
@@ -1392,7 +1934,14 @@ void AllocBuffers( CudaK32PlotContext& cx )
     size_t parksPinnedSize = 0;
 
     // Gather the size needed first
+    for( ;; )
     {
+        cx.pinnedAllocSize    = 0;
+        cx.hostTableAllocSize = 0;
+        cx.hostTempAllocSize  = 0;
+        cx.devAllocSize       = 0;
+        parksPinnedSize       = 0;
+
         CudaK32AllocContext acx = {};
 
         acx.alignment = alignment;
@@ -1445,6 +1994,21 @@ void AllocBuffers( CudaK32PlotContext& cx )
             AllocateParkSerializationBuffers( cx, *acx.pinnedAllocator, acx.dryRun );
             parksPinnedSize = pinnedAllocator.Size();
         }
+
+        if( cx.p1BufferCount <= BBCU_DEFAULT_GPU_BUFFER_COUNT )
+            break;
+
+        // Fall back to double-buffering if the extra transfer buffers don't fit
+        size_t memFree = 0, memTotal = 0;
+        CudaErrCheck( cudaMemGetInfo( &memFree, &memTotal ) );
+
+        const size_t hostSize = cx.hostTableAllocSize + cx.pinnedAllocSize + cx.hostTempAllocSize + parksPinnedSize;
+
+        if( cx.devAllocSize <= memFree && ( cx.cfg.hostMemoryBudget == 0 || hostSize <= cx.cfg.hostMemoryBudget ) )
+            break;
+
+        Log::Line( "Not enough memory for %u phase 1 transfer buffers, using %u.", cx.p1BufferCount, (uint32)BBCU_DEFAULT_GPU_BUFFER_COUNT );
+        cx.p1BufferCount = BBCU_DEFAULT_GPU_BUFFER_COUNT;
     }
 
 
@@ -1465,15 +2029,38 @@ void AllocBuffers( CudaK32PlotContext& cx )
     Log::Line( "GPU RAM required          : %-12llu bytes ( %-9.2lf MiB or %-6.2lf GiB )", cx.devAllocSize,
                    (double)cx.devAllocSize BtoMB, (double)cx.devAllocSize BtoGB );
 
+    // Host tables are pinned too when downloading to them directly, unless they are managed (see below)
+    const bool hostTablesPinned = cx.downloadDirect && !cx.cfg.managedMemory;
+    MemoryPlanner::ReportPeak( *cx.gCfg, totalHostSize, hostTablesPinned ? totalHostSize : totalPinnedSize );
+
+    if( cx.cfg.hostMemoryBudget > 0 && totalHostSize > cx.cfg.hostMemoryBudget )
+    {
+        Log::Line( "Warning: The required host RAM ( %.2lf GiB ) exceeds the --memory budget ( %.2lf GiB ).",
+            (double)totalHostSize BtoGB, (double)cx.cfg.hostMemoryBudget BtoGB );
+    }
+
     // Now actually allocate the buffers
     Log::Line( "Allocating buffers..." );
-    CudaErrCheck( cudaMallocHost( &cx.pinnedBuffer, cx.pinnedAllocSize, cudaHostAllocDefault ) );
+    const auto allocTimer = TimerBegin();
 
+    cx.pinnedBuffer = AllocPinnedHost( cx, cx.pinnedAllocSize );
+
+    bool allocateHostTablesPinned = false;
+    if( cx.cfg.managedMemory )
+    {
+        // Keep the tables in host RAM, mapped by the device, and let the driver page them as needed.
+        // The device then writes to them directly, like to pinned tables, without pinning them.
+        CudaErrCheck( cudaMallocManaged( &cx.hostBufferTables, cx.hostTableAllocSize, cudaMemAttachGlobal ) );
+        CudaErrCheck( cudaMemAdvise( cx.hostBufferTables, cx.hostTableAllocSize, cudaMemAdviseSetPreferredLocation, cudaCpuDeviceId ) );
+        CudaErrCheck( cudaMemAdvise( cx.hostBufferTables, cx.hostTableAllocSize, cudaMemAdviseSetAccessedBy, cx.cudaDevice ) );
+    }
+    else
+    {
     #if _DEBUG
         cx.hostBufferTables = bbvirtallocboundednuma<byte>( cx.hostTableAllocSize );
     #else
 
-        bool allocateHostTablesPinned = cx.downloadDirect;
+        allocateHostTablesPinned = cx.downloadDirect;
         #if _WIN32
             // On windows we always force the use of intermediate buffers, so we allocate on the host
             allocateHostTablesPinned = false;
@@ -1481,31 +2068,48 @@ void AllocBuffers( CudaK32PlotContext& cx )
 
         // Log::Line( "Table pairs allocated as pinned: %s", allocateHostTablesPinned ? "true" : "false" );
         if( allocateHostTablesPinned )
-            CudaErrCheck( cudaMallocHost( &cx.hostBufferTables, cx.hostTableAllocSize, cudaHostAllocDefault ) );
+            cx.hostBufferTables = AllocPinnedHost( cx, cx.hostTableAllocSize, cx.gCfg->hugePages );
         else
             cx.hostBufferTables = bbvirtallocboundednuma<byte>( cx.hostTableAllocSize );
     #endif
+    }
 
     cx.hostBufferTemp = nullptr;
+    bool allocateHostTempPinned = true;
     #if _DEBUG || _WIN32
+        allocateHostTempPinned = false;
         if( cx.hostTempAllocSize )
             cx.hostBufferTemp = bbvirtallocboundednuma<byte>( cx.hostTempAllocSize );
     #endif
 
-    if( cx.hostBufferTemp == nullptr && cx.hostTempAllocSize )
-        CudaErrCheck( cudaMallocHost( &cx.hostBufferTemp, cx.hostTempAllocSize, cudaHostAllocDefault ) );
+    if( allocateHostTempPinned && cx.hostTempAllocSize )
+        cx.hostBufferTemp = AllocPinnedHost( cx, cx.hostTempAllocSize );
+
+    {
+        size_t memFree = 0, memTotal = 0;
+        CudaErrCheck( cudaMemGetInfo( &memFree, &memTotal ) );
+
+        if( cx.devAllocSize > memFree )
+        {
+            Log::Error( "Error: The device has %.2lf GiB of free memory, but %.2lf GiB are required with %u buckets.",
+                (double)memFree BtoGB, (double)cx.devAllocSize BtoGB, BBCU_BUCKET_COUNT );
+
+            #if BBCU_BUCKET_COUNT < 512
+                Log::Error( "Build with -DBB_CUDA_BUCKET_COUNT=%u to plot with about half the GPU memory, at reduced speed.", BBCU_BUCKET_COUNT * 2 );
+            #endif
+            Exit( 1 );
+        }
+    }
 
     CudaErrCheck( cudaMalloc( &cx.deviceBuffer, cx.devAllocSize ) );
 
-    // Warm start
-    if( true )// cx.gCfg->warmStart )
-    {
-        FaultMemoryPages::RunJob( *cx.threadPool, cx.threadPool->ThreadCount(), cx.pinnedBuffer    , cx.pinnedAllocSize    );
+    // Warm start. The pinned buffers were already faulted in when they were allocated.
+    // Managed tables are left for the driver to populate.
+    if( !allocateHostTablesPinned && !cx.cfg.managedMemory )
         FaultMemoryPages::RunJob( *cx.threadPool, cx.threadPool->ThreadCount(), cx.hostBufferTables, cx.hostTableAllocSize );
 
-        if( cx.hostTempAllocSize )
-            FaultMemoryPages::RunJob( *cx.threadPool, cx.threadPool->ThreadCount(), cx.hostBufferTemp, cx.hostTempAllocSize );
-    }
+    if( !allocateHostTempPinned && cx.hostTempAllocSize )
+        FaultMemoryPages::RunJob( *cx.threadPool, cx.threadPool->ThreadCount(), cx.hostBufferTemp, cx.hostTempAllocSize );
 
     {
         CudaK32AllocContext acx = {};
@@ -1538,13 +2142,90 @@ void AllocBuffers( CudaK32PlotContext& cx )
 
         if( allocateParkBuffers )
         {
-            // Fine to leak. App-lifetime buffer
-            void* parksBuffer = nullptr;
-            CudaErrCheck( cudaMallocHost( &parksBuffer, parksPinnedSize, cudaHostAllocDefault ) );
-            StackAllocator parkAllocator( parksBuffer, parksPinnedSize );
+            // Fine to leak. App-lifetime buffer.
+            // The park buffers are not used until the end of Phase 1, so they are pinned in the background
+            // while the first plot starts. Carving them up here does not touch their pages.
+            cx.hostParksAllocSize = parksPinnedSize;
+            cx.hostBufferParks    = SysHost::VirtualAlloc( parksPinnedSize, false );
+            FatalIf( !cx.hostBufferParks, "Failed to allocate park buffers." );
+
+            cx.parksPinThread = new Thread( 4 MiB );
+            cx.parksPinThread->Run( PinParkBuffersThread, &cx );
+
+            StackAllocator parkAllocator( cx.hostBufferParks, parksPinnedSize );
             AllocateParkSerializationBuffers( cx, parkAllocator, acx.dryRun );
         }
     }
+
+    Log::Line( "Allocated buffers in %.2lf seconds.", TimerEnd( allocTimer ) );
+}
+
+//-----------------------------------------------------------
+void* AllocPinnedHost( CudaK32PlotContext& cx, const size_t size, const bool hugePages )
+{
+    // cudaMallocHost zeroes and locks every page from the calling thread, which for hundreds of GiB
+    // takes a long time before the first kernel runs. Instead the pages are faulted in by the whole
+    // thread pool, so that registering them only has to lock pages that are already resident.
+    // This is done once per process, the buffers are re-used by every plot.
+    HugePageSize pageSize = HugePageSize::None;
+    void* buffer = hugePages ? SysHost::VirtualAllocHuge( size, true, &pageSize ) : SysHost::VirtualAlloc( size, false );
+    FatalIf( !buffer, "Failed to allocate %llu bytes of pinned host memory.", (llu)size );
+
+    if( hugePages )
+        Log::Line( "Pinned host buffer backed by %s.", HugePageSizeToString( pageSize ) );
+
+    FaultMemoryPages::RunJob( *cx.threadPool, cx.threadPool->ThreadCount(), buffer, size );
+
+    CudaErrCheck( cudaHostRegister( buffer, size, cudaHostRegisterDefault ) );
+    return buffer;
+}
+
+//-----------------------------------------------------------
+void PinParkBuffersThread( CudaK32PlotContext* cx )
+{
+    CudaErrCheck( cudaSetDevice( cx->cudaDevice ) );
+    CudaErrCheck( cudaHostRegister( cx->hostBufferParks, cx->hostParksAllocSize, cudaHostRegisterDefault ) );
+}
+
+//-----------------------------------------------------------
+void WaitForParkBuffers( CudaK32PlotContext& cx )
+{
+    if( !cx.parksPinThread )
+        return;
+
+    cx.parksPinThread->WaitForExit();
+    delete cx.parksPinThread;
+    cx.parksPinThread = nullptr;
+}
+
+//-----------------------------------------------------------
+void CudaK32PlotEnableGpuDirectStorage( CudaK32PlotContext& cx, DiskBucketBuffer* buffer )
+{
+    if( !cx.diskContext->gpuDirectStorage || !buffer || buffer->GetDeviceIO() )
+        return;
+
+    // On failure the buffer keeps going through the pinned host buffers
+    GpuQueue::EnableGpuDirectStorage( *buffer, cx.cudaDevice );
+}
+
+//-----------------------------------------------------------
+void CudaK32PlotPrefetchHostTable( CudaK32PlotContext& cx, const TableId table )
+{
+    if( !cx.cfg.managedMemory || table < cx.firstStoredTable || table > TableId::Table7 )
+        return;
+
+    const Pairs  pairs      = cx.hostBackPointers[(int)table];
+    const uint64 entryCount = cx.tableEntryCounts[(int)table];
+
+    // The first stored table has its pairs inlined into the left buffer
+    if( !pairs.right )
+    {
+        CudaErrCheck( cudaMemPrefetchAsync( pairs.left, sizeof( Pair ) * entryCount, cudaCpuDeviceId, cx.prefetchStream ) );
+        return;
+    }
+
+    CudaErrCheck( cudaMemPrefetchAsync( pairs.left , sizeof( uint32 ) * entryCount, cudaCpuDeviceId, cx.prefetchStream ) );
+    CudaErrCheck( cudaMemPrefetchAsync( pairs.right, sizeof( uint16 ) * entryCount, cudaCpuDeviceId, cx.prefetchStream ) );
 }
 
 //-----------------------------------------------------------
@@ -1576,10 +2257,12 @@ void AllocateP1Buffers( CudaK32PlotContext& cx, CudaK32AllocContext& acx )
             cx.diskContext->yBuffer = DiskBucketBuffer::Create( *cx.diskContext->temp2Queue, CudaK32HybridMode::Y_DISK_BUFFER_FILE_NAME.data(), 
                                             BBCU_BUCKET_COUNT, ySliceSize, FileMode::Create, FileAccess::ReadWrite, tmp2FileFlags );
             FatalIf( !cx.diskContext->yBuffer, "Failed to create y disk buffer." );
+            CudaK32PlotEnableGpuDirectStorage( cx, cx.diskContext->yBuffer );
 
             cx.diskContext->metaBuffer = DiskBucketBuffer::Create( *cx.diskContext->temp2Queue, CudaK32HybridMode::META_DISK_BUFFER_FILE_NAME.data(), 
                                             BBCU_BUCKET_COUNT, metaSliceSize, FileMode::Create, FileAccess::ReadWrite, tmp2FileFlags );
             FatalIf( !cx.diskContext->metaBuffer, "Failed to create metadata disk buffer." );
+            CudaK32PlotEnableGpuDirectStorage( cx, cx.diskContext->metaBuffer );
         }
 
         // Marking tables used to prune back pointers
@@ -1661,12 +2344,14 @@ void AllocateP1Buffers( CudaK32PlotContext& cx, CudaK32AllocContext& acx )
             cx.diskContext->unsortedL = DiskBucketBuffer::Create( *cx.diskContext->temp2Queue, CudaK32HybridMode::LPAIRS_DISK_BUFFER_FILE_NAME.data(), 
                                                                    BBCU_BUCKET_COUNT, xSliceSize, FileMode::OpenOrCreate, FileAccess::ReadWrite, tmp2FileFlags );
             FatalIf( !cx.diskContext->unsortedL, "Failed to create unsorted L disk buffer." );
+            CudaK32PlotEnableGpuDirectStorage( cx, cx.diskContext->unsortedL );
 
             if( cx.cfg.hybrid16Mode )
             {
                 cx.diskContext->unsortedR = DiskBucketBuffer::Create( *cx.diskContext->temp2Queue, "p1unsorted_r.tmp", 
                                                                     BBCU_BUCKET_COUNT, BBCU_MAX_SLICE_ENTRY_COUNT * sizeof( uint16 ), FileMode::OpenOrCreate, FileAccess::ReadWrite, tmp2FileFlags );
                 FatalIf( !cx.diskContext->unsortedR, "Failed to create unsorted R disk buffer." );
+                CudaK32PlotEnableGpuDirectStorage( cx, cx.diskContext->unsortedR );
             }
             else
             {
@@ -1683,7 +2368,7 @@ void AllocateP1Buffers( CudaK32PlotContext& cx, CudaK32AllocContext& acx )
         yDesc.entriesPerSlice = BBCU_MAX_SLICE_ENTRY_COUNT;
         yDesc.sliceCount      = BBCU_BUCKET_COUNT;
         yDesc.sliceAlignment  = alignment;
-        yDesc.bufferCount     = BBCU_DEFAULT_GPU_BUFFER_COUNT;
+        yDesc.bufferCount     = cx.p1BufferCount;
         yDesc.deviceAllocator = acx.devAllocator;
         yDesc.pinnedAllocator = nullptr;             // Start in direct mode (no intermediate pinined buffers)
 
@@ -1696,6 +2381,10 @@ void AllocateP1Buffers( CudaK32PlotContext& cx, CudaK32AllocContext& acx )
 
         if( cx.cfg.hybrid128Mode )
         {
+            // Disk-backed buffers are double-buffered by their disk buffer
+            descTableSortedPairs.bufferCount = BBCU_DEFAULT_GPU_BUFFER_COUNT;
+            descXPairs.bufferCount           = BBCU_DEFAULT_GPU_BUFFER_COUNT;
+
             // Temp 1 Queue
             descTableSortedPairs.pinnedAllocator = acx.pinnedAllocator;
             descTableSortedPairs.sliceAlignment  = cx.diskContext->temp1Queue->BlockSize();
@@ -1706,9 +2395,13 @@ void AllocateP1Buffers( CudaK32PlotContext& cx, CudaK32AllocContext& acx )
 
             if( cx.cfg.hybrid16Mode )
             {
+                yDesc.bufferCount     = BBCU_DEFAULT_GPU_BUFFER_COUNT;
                 yDesc.pinnedAllocator = acx.pinnedAllocator;
                 yDesc.sliceAlignment  = cx.diskContext->temp2Queue->BlockSize();
 
+                descMeta.bufferCount       = BBCU_DEFAULT_GPU_BUFFER_COUNT;
+                descTablePairs.bufferCount = BBCU_DEFAULT_GPU_BUFFER_COUNT;
+
                 descMeta.pinnedAllocator = acx.pinnedAllocator;
                 descMeta.sliceAlignment  = cx.diskContext->temp2Queue->BlockSize();
 
@@ -1728,6 +2421,12 @@ void AllocateP1Buffers( CudaK32PlotContext& cx, CudaK32AllocContext& acx )
         }
 
 
+        // Bit-packed slices (see CudaPack.h) are transferred at their own, smaller, slice stride
+        cx.packedPairsRSliceStride = RoundUpToNextBoundaryT<size_t>(
+            CudaPackedSliceWordCount( BBCU_MAX_SLICE_ENTRY_COUNT, BBCU_PACKED_PAIR_R_BITS ) * sizeof( uint64 ), descTablePairs.sliceAlignment );
+        cx.packedYT7SliceStride = RoundUpToNextBoundaryT<size_t>(
+            CudaPackedSliceWordCount( BBCU_MAX_SLICE_ENTRY_COUNT, BBCU_PACKED_Y_T7_BITS ) * sizeof( uint64 ), yDesc.sliceAlignment );
+
         ///
         /// Downloads
         ///
@@ -1788,8 +2487,7 @@ void AllocateP1Buffers( CudaK32PlotContext& cx, CudaK32AllocContext& acx )
         /// Device-only allocations
         if( acx.dryRun )
         {
-            cx.devSortTmpAllocSize = 0;
-            cub::DeviceRadixSort::SortPairs<uint32, uint32>( nullptr, cx.devSortTmpAllocSize, nullptr, nullptr, nullptr, nullptr, BBCU_BUCKET_ALLOC_ENTRY_COUNT );
+            cx.devSortTmpAllocSize = CudaRadixSortTempSize<uint32>( BBCU_BUCKET_ALLOC_ENTRY_COUNT );
         }
 
         cx.devSortTmp         = acx.devAllocator->AllocT<byte>( cx.devSortTmpAllocSize, alignment );
@@ -1807,6 +2505,7 @@ void AllocateP1Buffers( CudaK32PlotContext& cx, CudaK32AllocContext& acx )
         cx.devGroupCount      = acx.devAllocator->CAlloc<uint32>( 1 );
         cx.devBucketCounts    = acx.devAllocator->CAlloc<uint32>( BBCU_BUCKET_COUNT, alignment );
         cx.devSliceCounts     = acx.devAllocator->CAlloc<uint32>( BBCU_BUCKET_COUNT * BBCU_BUCKET_COUNT, alignment );
+        cx.devInSliceCounts   = acx.devAllocator->CAlloc<uint32>( BBCU_BUCKET_COUNT * BBCU_BUCKET_COUNT, alignment );
 
 
         /// Pinned-only allocations
@@ -1853,7 +2552,7 @@ void AllocateParkSerializationBuffers( CudaK32PlotContext& cx, IAllocator& pinne
 
     const size_t parksPerBuffer       = CDivT<size_t>( BBCU_BUCKET_ALLOC_ENTRY_COUNT, kEntriesPerPark ) + 2;
     // CDiv( BBCU_BUCKET_ALLOC_ENTRY_COUNT, kCheckpoint1Interval ) + 1; // Need an extra park for left-over entries
-    const size_t bucketParkBufferSize = parksPerBuffer * maxParkSize;
+    const size_t bucketParkBufferSize = parksPerBuffer * maxParkSize + BBCU_PARK_WRITE_SLACK;
     const size_t alignment            = 4096;
 
     // Allocate some extra space for C tables (see FinalizeTable7)
@@ -2223,7 +2922,7 @@ void DbgLoadMarks( CudaK32PlotContext& cx )
 
 void DbgPruneTable( CudaK32PlotContext& cx, const TableId rTable )
 {
-    const size_t MarkingTableSize = 1ull << 32;
+    const size_t MarkingTableSize = BBCU_TABLE_ENTRY_COUNT;
     byte* bytefield = bbvirtalloc<byte>( MarkingTableSize );
     memset( bytefield, 0, MarkingTableSize );
     
@@ -2275,7 +2974,7 @@ void DbgPruneTable( CudaK32PlotContext& cx, const TableId rTable )
 
 void DbgPruneTableBuckets( CudaK32PlotContext& cx, const TableId rTable )
 {
-    const size_t MarkingTableSize = 1ull << 32;
+    const size_t MarkingTableSize = BBCU_TABLE_ENTRY_COUNT;
     byte* bytefield = bbvirtalloc<byte>( MarkingTableSize );
     memset( bytefield, 0, MarkingTableSize );
     
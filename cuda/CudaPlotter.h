@@ -10,21 +10,32 @@ struct CudaK32PlotConfig
     const GlobalPlotConfig* gCfg        = nullptr;
 
     uint32 deviceIndex            = 0;       // Which CUDA device to use when plotting/
+    uint32 checkDeviceIndex       = 0;       // Which CUDA device to use for plot checks (set by --devices, otherwise deviceIndex)
+    bool   hasCheckDevice         = false;   // Whether a separate device was given for plot checks
     bool   disableDirectDownloads = false;   // Don't allocate host tables using pinned buffers, instead
                                              // download to intermediate pinned buffers then copy to the final host buffer.
                                              // May be necessarry on Windows because of shared memory limitations (usual 50% of system memory)
 
     bool hybrid128Mode            = false;   // Enable hybrid disk-offload w/ 128G of RAM.
     bool hybrid16Mode             = false;   // Enable hybrid disk-offload w/ 64G of RAM.
+    size_t hostMemoryBudget       = 0;       // If set (--memory), pick the hybrid mode that fits in this much host RAM
+    bool managedMemory            = false;   // Allocate the host tables as CUDA managed memory (--managed-memory),
+                                             // letting the driver page them instead of offloading them to temp disks
 
     const char* temp1Path         = nullptr; // For 128G RAM mode
     const char* temp2Path         = nullptr; // For 64G RAM mode
 
     bool temp1DirectIO            = true;    // Use direct I/O for temp1 files
     bool temp2DirectIO            = true;    // Use direct I/O for temp2 files
+    bool gpuDirectStorage         = false;   // Use GPUDirect Storage (cuFile) for the bucketed temp2 files in hybrid modes
+    bool recomputeMeta            = false;   // Regenerate table 2's metadata on the GPU instead of storing it (see CudaK32PlotIsMetaRecomputed())
+    size_t outputBufferSize       = 0;       // If set (--output-buffer), stage plot data in this much host RAM so that
+                                             // plots can be written to multiple output directories concurrently
 
     uint64 plotCheckCount         = 0;       // For performing plot check command after plotting
     double plotCheckThreshhold    = 0.6;     // Proof/check threshhold below which plots will be deleted
+
+    uint32 pipelineCount          = 1;       // Plots made concurrently on the device (--pipelines), each with its own context
 };
 
 class CudaK32Plotter : public IPlotter
@@ -37,9 +48,15 @@ public:
     virtual void Init() override;
     virtual void Run( const PlotRequest& req ) override;
 
+private:
+    void RunPipelined( const PlotRequest& req );
+
 private:
     CudaK32PlotConfig          _cfg = {};
     struct CudaK32PlotContext* _cx  = nullptr;;
+
+    struct CudaK32Pipeline*    _pipelines    = nullptr;   // With --pipelines, _cx is the first pipeline's context
+    uint32                     _nextPipeline = 0;
 };
 
 void CudaK32PlotterPrintHelp();
@@ -0,0 +1,247 @@
+#include "pch.h"
+#include "plotting/GpuProofValidator.h"
+#include "plotting/PlotTypes.h"
+#include "plotting/Tables.h"
+#include "pos/chacha8.h"
+#include "CudaF1.h"
+#include "CudaFx.h"
+#include "CudaUtil.h"
+#include "util/Log.h"
+
+static constexpr uint32 ProofXCount = BB_PLOT_PROOF_X_COUNT;
+
+//-----------------------------------------------------------
+__forceinline__ __device__ bool CudaProofFxMatch( const uint64 yL, const uint64 yR )
+{
+    const uint64 groupL = yL / kBC;
+    const uint64 groupR = yR / kBC;
+
+    if( groupR - groupL != 1 )
+        return false;
+
+    const uint16 parity = (uint16)( groupL & 1 );
+    const uint16 localL = (uint16)( yL - groupL * kBC );
+    const uint16 localR = (uint16)( yR - groupR * kBC );
+    const uint16 indJ   = localL / kC;
+
+    for( uint16 m = 0; m < kExtraBitsPow; m++ )
+    {
+        const uint16 lTarget = ((indJ + m) % kB) * kC + (((2 * m + parity) * (2 * m + parity) + localL) % kC);
+
+        if( lTarget == localR )
+            return true;
+    }
+
+    return false;
+}
+
+/// Pairs up the consecutive entries of each proof at the current table level,
+/// the one with the smallest y on the left, and flags proofs with an entry pair that doesn't match.
+//-----------------------------------------------------------
+__global__ void CudaPairProofEntries( const uint32 pairCount, const uint32 pairsPerProof,
+                                      const uint64* yIn, Pair* outPairs, bool* outInvalid )
+{
+    const uint32 gid = blockIdx.x * blockDim.x + threadIdx.x;
+    if( gid >= pairCount )
+        return;
+
+    // The entries of a proof are contiguous at every level, so pair i is made of entries i*2 and i*2+1
+    uint32 l = gid * 2;
+    uint32 r = l + 1;
+
+    if( yIn[l] > yIn[r] )
+    {
+        const uint32 t = l;
+        l = r;
+        r = t;
+    }
+
+    if( !CudaProofFxMatch( yIn[l], yIn[r] ) )
+        outInvalid[gid / pairsPerProof] = true;
+
+    outPairs[gid] = { l, r };
+}
+
+class CudaProofValidator : public IGpuProofValidator
+{
+public:
+    //-----------------------------------------------------------
+    ~CudaProofValidator() override
+    {
+        if( _stream )
+            cudaStreamDestroy( _stream );
+
+        CudaSafeFree( _devChaChaInput );
+        CudaSafeFree( _devXs );
+        CudaSafeFree( _devY[0] );
+        CudaSafeFree( _devY[1] );
+        CudaSafeFree( _devMeta[0] );
+        CudaSafeFree( _devMeta[1] );
+        CudaSafeFree( _devPairs );
+        CudaSafeFree( _devInvalid );
+        CudaSafeFreeHost( _hostXs );
+        CudaSafeFreeHost( _hostF7s );
+        CudaSafeFreeHost( _hostInvalid );
+        CudaSafeFreeHost( _hostValid );
+    }
+
+    //-----------------------------------------------------------
+    bool Init( const int deviceId, const uint32 maxProofs )
+    {
+        _deviceId  = deviceId;
+        _maxProofs = maxProofs;
+
+        const size_t maxXs       = (size_t)maxProofs * ProofXCount;
+        const size_t maxMetaSize = sizeof( K32Meta4 );
+
+        #define CU_INIT( expr ) if( ( cErr = (expr) ) != cudaSuccess ) goto FAIL
+
+        cudaError_t cErr;
+        CU_INIT( cudaSetDevice( deviceId ) );
+        CU_INIT( cudaStreamCreateWithFlags( &_stream, cudaStreamNonBlocking ) );
+
+        CU_INIT( CudaCallocT( _devChaChaInput, 16 ) );
+        CU_INIT( CudaCallocT( _devXs     , maxXs ) );
+        CU_INIT( CudaCallocT( _devY[0]   , maxXs ) );
+        CU_INIT( CudaCallocT( _devY[1]   , maxXs ) );
+        CU_INIT( CudaCallocT( _devMeta[0], maxXs * maxMetaSize ) );
+        CU_INIT( CudaCallocT( _devMeta[1], maxXs * maxMetaSize ) );
+        CU_INIT( CudaCallocT( _devPairs  , maxXs / 2 ) );
+        CU_INIT( CudaCallocT( _devInvalid, maxProofs ) );
+
+        CU_INIT( cudaMallocHost( (void**)&_hostXs     , maxXs * sizeof( uint64 ) ) );
+        CU_INIT( cudaMallocHost( (void**)&_hostF7s    , maxProofs * sizeof( uint64 ) ) );
+        CU_INIT( cudaMallocHost( (void**)&_hostInvalid, maxProofs * sizeof( bool ) ) );
+        CU_INIT( cudaMallocHost( (void**)&_hostValid  , maxProofs * sizeof( bool ) ) );
+
+        #undef CU_INIT
+        return true;
+
+    FAIL:
+        Log::Line( "Failed to initialize the GPU proof validator on device %d with CUDA error '%s': %s",
+                   deviceId, cudaGetErrorName( cErr ), cudaGetErrorString( cErr ) );
+        return false;
+    }
+
+    //-----------------------------------------------------------
+    uint32  MaxProofs() const override { return _maxProofs; }
+    uint64* ProofXs()         override { return _hostXs; }
+
+    //-----------------------------------------------------------
+    bool Validate( const byte plotId[BB_PLOT_ID_LEN], const uint32 proofCount ) override
+    {
+        ASSERT( proofCount <= _maxProofs );
+
+        if( proofCount == 0 )
+            return true;
+
+        // Prepare ChaCha key
+        byte key[32] = { 1 };
+        memcpy( key + 1, plotId, 31 );
+
+        chacha8_ctx chacha;
+        chacha8_keysetup( &chacha, key, 256, NULL );
+
+        const uint32 xCount = proofCount * ProofXCount;
+
+        cudaError_t cErr = cudaSetDevice( _deviceId );
+
+        if( cErr == cudaSuccess )
+            cErr = cudaMemcpyAsync( _devChaChaInput, chacha.input, 64, cudaMemcpyHostToDevice, _stream );
+        if( cErr == cudaSuccess )
+            cErr = cudaMemcpyAsync( _devXs, _hostXs, xCount * sizeof( uint64 ), cudaMemcpyHostToDevice, _stream );
+        if( cErr == cudaSuccess )
+            cErr = cudaMemsetAsync( _devInvalid, 0, proofCount * sizeof( bool ), _stream );
+
+        if( cErr != cudaSuccess )
+            return Fail( cErr );
+
+        CudaGenF1ForXsK32( _devChaChaInput, _devXs, xCount, _devY[0], (uint32*)_devMeta[0], _stream );
+
+        // Forward propagate the f1 values to f7, a whole table level for all proofs at once
+        const uint32 kthreads = 256;
+
+        uint32 src           = 0;
+        uint32 pairsPerProof = ProofXCount / 2;
+
+        for( TableId table = TableId::Table2; table <= TableId::Table7; table++, pairsPerProof >>= 1 )
+        {
+            const uint32 dst       = src ^ 1;
+            const uint32 pairCount = proofCount * pairsPerProof;
+
+            CudaPairProofEntries<<<CDiv( pairCount, kthreads ), kthreads, 0, _stream>>>(
+                pairCount, pairsPerProof, _devY[src], _devPairs, _devInvalid );
+
+            CudaFxHarvestK32( table, _devY[dst], table < TableId::Table7 ? _devMeta[dst] : nullptr,
+                              pairCount, _devPairs, _devY[src], _devMeta[src], _stream );
+
+            src = dst;
+        }
+
+        // Table 7 left one entry per proof: its f7
+        cErr = cudaGetLastError();
+
+        if( cErr == cudaSuccess )
+            cErr = cudaMemcpyAsync( _hostF7s, _devY[src], proofCount * sizeof( uint64 ), cudaMemcpyDeviceToHost, _stream );
+        if( cErr == cudaSuccess )
+            cErr = cudaMemcpyAsync( _hostInvalid, _devInvalid, proofCount * sizeof( bool ), cudaMemcpyDeviceToHost, _stream );
+        if( cErr == cudaSuccess )
+            cErr = cudaStreamSynchronize( _stream );
+
+        if( cErr != cudaSuccess )
+            return Fail( cErr );
+
+        for( uint32 i = 0; i < proofCount; i++ )
+            _hostValid[i] = !_hostInvalid[i];
+
+        return true;
+    }
+
+    //-----------------------------------------------------------
+    const uint64* F7s()   const override { return _hostF7s; }
+    const bool*   Valid() const override { return _hostValid; }
+
+private:
+    //-----------------------------------------------------------
+    bool Fail( const cudaError_t cErr )
+    {
+        Log::Line( "GPU proof validation failed with CUDA error '%s': %s", cudaGetErrorName( cErr ), cudaGetErrorString( cErr ) );
+        return false;
+    }
+
+private:
+    int          _deviceId       = 0;
+    uint32       _maxProofs      = 0;
+    cudaStream_t _stream         = nullptr;
+
+    uint32*      _devChaChaInput = nullptr;
+    uint64*      _devXs          = nullptr;
+    uint64*      _devY   [2]     = {};      // Double-buffered across table levels
+    byte*        _devMeta[2]     = {};
+    Pair*        _devPairs       = nullptr;
+    bool*        _devInvalid     = nullptr;
+
+    uint64*      _hostXs         = nullptr;
+    uint64*      _hostF7s        = nullptr;
+    bool*        _hostInvalid    = nullptr;
+    bool*        _hostValid      = nullptr;
+};
+
+/// Declared in GpuProofValidator.h
+//-----------------------------------------------------------
+IGpuProofValidator* CudaProofValidatorFactory::Create( const uint32 deviceIndex, const uint32 maxProofs )
+{
+    int deviceCount = 0;
+    if( cudaGetDeviceCount( &deviceCount ) != cudaSuccess || (int)deviceIndex >= deviceCount )
+        return nullptr;
+
+    auto* validator = new CudaProofValidator();
+
+    if( !validator->Init( (int)deviceIndex, maxProofs ) )
+    {
+        delete validator;
+        return nullptr;
+    }
+
+    return validator;
+}
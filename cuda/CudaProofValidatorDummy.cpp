@@ -0,0 +1,7 @@
+#include "plotting/GpuProofValidator.h"
+
+/// Dummy function for when CUDA is not available
+IGpuProofValidator* CudaProofValidatorFactory::Create( const uint32 deviceIndex, const uint32 maxProofs )
+{
+    return nullptr;
+}
@@ -0,0 +1,382 @@
+#include "CudaUtil.h"
+#include "CudaSort.h"
+#include "plotting/Tables.h"
+
+// Digits are up to 11 bits wide, so that a bucket-local 31-bit y sorts in 3 passes,
+// and a full k32 y (38 bits) sorts in 4. A full-width 32 or 64-bit sort with 8-bit digits takes 4 and 8.
+#define BBCU_SORT_MAX_RADIX_BITS  11
+#define BBCU_SORT_MAX_RADIX       (1u << BBCU_SORT_MAX_RADIX_BITS)
+#define BBCU_SORT_THREADS         256
+#define BBCU_SORT_WARPS           (BBCU_SORT_THREADS / 32)
+#define BBCU_SORT_WARP_ENTRIES    2048  // Contiguous entries ranked by each warp of a tile
+#define BBCU_SORT_TILE_ENTRIES    (BBCU_SORT_WARPS * BBCU_SORT_WARP_ENTRIES)
+
+// Per-warp digit counts and offsets within a tile are kept as uint16, so that they fit in shared memory
+static_assert( BBCU_SORT_TILE_ENTRIES <= 0xFFFF );
+static_assert( BBCU_SORT_MAX_RADIX % BBCU_SORT_THREADS == 0 );
+
+struct RadixSortTmp
+{
+    void*   keys;           // Alternate key buffer
+    uint32* vals;           // Alternate value buffer
+    uint32* tileCounts;     // Per-digit, per-tile counts, digit-major
+    uint32* digitTotals;
+    size_t  size;
+};
+
+//-----------------------------------------------------------
+template<typename TKey>
+static RadixSortTmp GetRadixSortTmp( void* devTmp, const uint32 entryCount )
+{
+    const size_t tileCount = CDiv( (size_t)entryCount, BBCU_SORT_TILE_ENTRIES );
+    const size_t alignment = 256;
+
+    byte* ptr = (byte*)devTmp;
+
+    RadixSortTmp tmp;
+    tmp.keys        = ptr; ptr += RoundUpToNextBoundaryT<size_t>( entryCount * sizeof( TKey ), alignment );
+    tmp.vals        = (uint32*)ptr; ptr += RoundUpToNextBoundaryT<size_t>( entryCount * sizeof( uint32 ), alignment );
+    tmp.tileCounts  = (uint32*)ptr; ptr += RoundUpToNextBoundaryT<size_t>( tileCount * BBCU_SORT_MAX_RADIX * sizeof( uint32 ), alignment );
+    tmp.digitTotals = (uint32*)ptr; ptr += BBCU_SORT_MAX_RADIX * sizeof( uint32 );
+    tmp.size        = (size_t)( ptr - (byte*)devTmp );
+
+    return tmp;
+}
+
+//-----------------------------------------------------------
+template<typename TKey>
+__device__ inline uint32 RadixDigit( const TKey key, const uint32 shift, const uint32 mask )
+{
+    return (uint32)( key >> shift ) & mask;
+}
+
+//-----------------------------------------------------------
+// Inclusive sum of v across the block, which must be BBCU_SORT_THREADS wide.
+// Must be called by all threads of the block.
+__device__ inline uint32 BlockInclusiveSum( uint32 v, uint32* sharedWarpSums, uint32& outTotal )
+{
+    const uint32 lane = threadIdx.x & 31;
+    const uint32 warp = threadIdx.x >> 5;
+
+    #pragma unroll
+    for( uint32 i = 1; i < 32; i <<= 1 )
+    {
+        const uint32 n = __shfl_up_sync( BBCU_WARP_MASK_ALL, v, i );
+        if( lane >= i )
+            v += n;
+    }
+
+    if( lane == 31 )
+        sharedWarpSums[warp] = v;
+    __syncthreads();
+
+    uint32 warpPrefix = 0;
+    uint32 total      = 0;
+
+    #pragma unroll
+    for( uint32 w = 0; w < BBCU_SORT_WARPS; w++ )
+    {
+        const uint32 sum = sharedWarpSums[w];
+        if( w < warp )
+            warpPrefix += sum;
+        total += sum;
+    }
+    __syncthreads();
+
+    outTotal = total;
+    return warpPrefix + v;
+}
+
+//-----------------------------------------------------------
+// Returns the mask of active lanes in the warp that hold the same digit as this lane.
+// Must be called by all lanes of the warp.
+__device__ inline uint32 WarpDigitPeers( const uint32 digit, const uint32 digitBits, const uint32 activeMask )
+{
+    uint32 peers = activeMask;
+
+    for( uint32 b = 0; b < digitBits; b++ )
+    {
+        const bool   set  = ( digit >> b ) & 1;
+        const uint32 bits = __ballot_sync( BBCU_WARP_MASK_ALL, set );
+
+        peers &= set ? bits : ~bits;
+    }
+
+    return peers;
+}
+
+//-----------------------------------------------------------
+template<typename TKey>
+__global__ void RadixSortCountKernel( const uint32 entryCount, const uint32 shift, const uint32 digitBits,
+                                      const TKey* keys, uint32* gTileCounts )
+{
+    __shared__ uint32 sharedCounts[BBCU_SORT_MAX_RADIX];
+
+    const uint32 radix = 1u << digitBits;
+    const uint32 mask  = radix - 1;
+
+    for( uint32 d = threadIdx.x; d < radix; d += blockDim.x )
+        sharedCounts[d] = 0;
+    __syncthreads();
+
+    const uint32 tileStart = blockIdx.x * BBCU_SORT_TILE_ENTRIES;
+    const uint32 tileEnd   = (uint32)min( (uint64)entryCount, (uint64)tileStart + BBCU_SORT_TILE_ENTRIES );
+
+    for( uint32 i = tileStart + threadIdx.x; i < tileEnd; i += blockDim.x )
+        atomicAdd( &sharedCounts[RadixDigit( keys[i], shift, mask )], 1 );
+    __syncthreads();
+
+    // Digit-major, so that an exclusive sum per digit gives each tile's offset within the digit
+    for( uint32 d = threadIdx.x; d < radix; d += blockDim.x )
+        gTileCounts[d * gridDim.x + blockIdx.x] = sharedCounts[d];
+}
+
+//-----------------------------------------------------------
+// One block per digit. Turns the digit's tile counts into exclusive offsets, in place.
+__global__ void RadixSortScanKernel( const uint32 tileCount, uint32* gTileCounts, uint32* gDigitTotals )
+{
+    __shared__ uint32 sharedWarpSums[BBCU_SORT_WARPS];
+
+    uint32* counts = gTileCounts + blockIdx.x * tileCount;
+    uint32  carry  = 0;
+
+    for( uint32 start = 0; start < tileCount; start += blockDim.x )
+    {
+        const uint32 i = start + threadIdx.x;
+        const uint32 v = i < tileCount ? counts[i] : 0;
+
+        uint32 total;
+        const uint32 inclusive = BlockInclusiveSum( v, sharedWarpSums, total );
+
+        if( i < tileCount )
+            counts[i] = carry + inclusive - v;
+
+        carry += total;
+    }
+
+    if( threadIdx.x == 0 )
+        gDigitTotals[blockIdx.x] = carry;
+}
+
+//-----------------------------------------------------------
+// Each warp ranks its contiguous segment of the tile in order, 32 entries at a time,
+// which keeps the sort stable without a block-wide local sort.
+template<typename TKey, typename TGather, bool IdentityVals>
+__global__ void RadixSortScatterKernel( const uint32 entryCount, const uint32 shift, const uint32 digitBits,
+                                        const uint32* gTileOffsets, const uint32* gDigitTotals,
+                                        const TKey* keysIn, TKey* keysOut, const uint32* valsIn, uint32* valsOut,
+                                        const TGather* gatherIn, TGather* gatherOut )
+{
+    __shared__ uint32 sharedDigitStart  [BBCU_SORT_MAX_RADIX];
+    __shared__ uint16 sharedWarpOffsets [BBCU_SORT_WARPS][BBCU_SORT_MAX_RADIX];
+    __shared__ uint32 sharedWarpSums    [BBCU_SORT_WARPS];
+
+    const uint32 radix      = 1u << digitBits;
+    const uint32 mask       = radix - 1;
+    const uint32 lane       = threadIdx.x & 31;
+    const uint32 warp       = threadIdx.x >> 5;
+    const uint32 lanesBelow = ( 1u << lane ) - 1;
+
+    const uint64 segStart = (uint64)blockIdx.x * BBCU_SORT_TILE_ENTRIES + warp * BBCU_SORT_WARP_ENTRIES;
+    const uint32 segEnd   = (uint32)min( (uint64)entryCount, segStart + BBCU_SORT_WARP_ENTRIES );
+
+    for( uint32 d = threadIdx.x; d < radix; d += blockDim.x )
+    {
+        #pragma unroll
+        for( uint32 w = 0; w < BBCU_SORT_WARPS; w++ )
+            sharedWarpOffsets[w][d] = 0;
+    }
+    __syncthreads();
+
+    // Count the digits of each warp's segment. Lanes holding the same digit are counted at once by the lowest of them.
+    for( uint32 i = (uint32)segStart; i < segEnd; i += 32 )
+    {
+        const uint32 idx    = i + lane;
+        const bool   valid  = idx < segEnd;
+        const uint32 digit  = valid ? RadixDigit( keysIn[idx], shift, mask ) : 0;
+        const uint32 active = __ballot_sync( BBCU_WARP_MASK_ALL, valid );
+        const uint32 peers  = WarpDigitPeers( digit, digitBits, active );
+
+        if( valid && ( peers & lanesBelow ) == 0 )
+            sharedWarpOffsets[warp][digit] += (uint16)__popc( peers );
+        __syncwarp();
+    }
+    __syncthreads();
+
+    // Start of each digit in the output for this tile: the total of all lower digits,
+    // plus the count of this digit in the preceding tiles
+    {
+        constexpr uint32 DigitsPerThread = BBCU_SORT_MAX_RADIX / BBCU_SORT_THREADS;
+        const     uint32 firstDigit      = threadIdx.x * DigitsPerThread;
+
+        uint32 sum = 0;
+        for( uint32 j = 0; j < DigitsPerThread; j++ )
+        {
+            const uint32 d = firstDigit + j;
+            if( d < radix )
+                sum += gDigitTotals[d];
+        }
+
+        uint32 total;
+        uint32 start = BlockInclusiveSum( sum, sharedWarpSums, total ) - sum;
+
+        for( uint32 j = 0; j < DigitsPerThread; j++ )
+        {
+            const uint32 d = firstDigit + j;
+            if( d >= radix )
+                break;
+
+            sharedDigitStart[d] = start + gTileOffsets[d * gridDim.x + blockIdx.x];
+            start += gDigitTotals[d];
+        }
+    }
+
+    // Warps' segments are in order, so the per-warp counts become offsets within the tile's digit
+    for( uint32 d = threadIdx.x; d < radix; d += blockDim.x )
+    {
+        uint16 offset = 0;
+
+        #pragma unroll
+        for( uint32 w = 0; w < BBCU_SORT_WARPS; w++ )
+        {
+            const uint16 count = sharedWarpOffsets[w][d];
+            sharedWarpOffsets[w][d] = offset;
+            offset += count;
+        }
+    }
+    __syncthreads();
+
+    // Scatter
+    for( uint32 i = (uint32)segStart; i < segEnd; i += 32 )
+    {
+        const uint32 idx   = i + lane;
+        const bool   valid = idx < segEnd;
+
+        TKey   key   = 0;
+        uint32 digit = 0;
+        if( valid )
+        {
+            key   = keysIn[idx];
+            digit = RadixDigit( key, shift, mask );
+        }
+
+        const uint32 active = __ballot_sync( BBCU_WARP_MASK_ALL, valid );
+        const uint32 peers  = WarpDigitPeers( digit, digitBits, active );
+
+        if( valid )
+        {
+            const uint32 dst = sharedDigitStart[digit] + sharedWarpOffsets[warp][digit] + __popc( peers & lanesBelow );
+            const uint32 val = IdentityVals ? idx : valsIn[idx];
+
+            keysOut[dst] = key;
+            valsOut[dst] = val;
+
+            if( gatherOut )
+                gatherOut[dst] = gatherIn[val];
+        }
+        __syncwarp();
+
+        if( valid && ( peers & lanesBelow ) == 0 )
+            sharedWarpOffsets[warp][digit] += (uint16)__popc( peers );
+        __syncwarp();
+    }
+}
+
+//-----------------------------------------------------------
+template<typename TKey>
+size_t CudaRadixSortTempSize( const uint32 entryCount )
+{
+    return GetRadixSortTmp<TKey>( nullptr, entryCount ).size;
+}
+
+//-----------------------------------------------------------
+template<typename TKey, typename TGather>
+cudaError CudaRadixSortPairs(
+    void*          devTmp,
+    const size_t   tmpSize,
+    const TKey*    devKeysIn,
+    TKey*          devKeysOut,
+    const uint32*  devValsIn,
+    uint32*        devValsOut,
+    const uint32   entryCount,
+    const uint32   beginBit,
+    const uint32   endBit,
+    cudaStream_t   stream,
+    const TGather* devGatherIn,
+    TGather*       devGatherOut )
+{
+    ASSERT( beginBit < endBit && endBit <= sizeof( TKey ) * 8 );
+    ASSERT( !devGatherIn || !devValsIn );  // The gathered input is indexed by the sort key
+    ASSERT( !devGatherIn == !devGatherOut );
+
+    if( entryCount == 0 )
+        return cudaSuccess;
+
+    const RadixSortTmp tmp = GetRadixSortTmp<TKey>( devTmp, entryCount );
+    if( tmpSize < tmp.size )
+        return cudaErrorInvalidValue;
+
+    const uint32 bitCount  = endBit - beginBit;
+    const uint32 passCount = CDiv( bitCount, BBCU_SORT_MAX_RADIX_BITS );
+    const uint32 tileCount = (uint32)CDiv( (size_t)entryCount, BBCU_SORT_TILE_ENTRIES );
+
+    const TKey*   keysIn = devKeysIn;
+    const uint32* valsIn = devValsIn;
+    uint32        shift  = beginBit;
+
+    for( uint32 pass = 0; pass < passCount; pass++ )
+    {
+        // Spread the bits evenly, as narrower digits rank faster
+        const uint32 digitBits = bitCount / passCount + ( pass < bitCount % passCount ? 1 : 0 );
+        const bool   isLast    = pass + 1 == passCount;
+
+        // Alternate buffers so that the last pass lands in the output
+        const bool toOutput = ( passCount - 1 - pass ) % 2 == 0;
+
+        TKey*   keysOut = toOutput ? devKeysOut : (TKey*)tmp.keys;
+        uint32* valsOut = toOutput ? devValsOut : tmp.vals;
+
+        const TGather* gatherIn  = isLast ? devGatherIn  : nullptr;
+              TGather* gatherOut = isLast ? devGatherOut : nullptr;
+
+        RadixSortCountKernel<TKey><<<tileCount, BBCU_SORT_THREADS, 0, stream>>>(
+            entryCount, shift, digitBits, keysIn, tmp.tileCounts );
+
+        RadixSortScanKernel<<<1u << digitBits, BBCU_SORT_THREADS, 0, stream>>>(
+            tileCount, tmp.tileCounts, tmp.digitTotals );
+
+        if( valsIn == nullptr )
+        {
+            RadixSortScatterKernel<TKey, TGather, true><<<tileCount, BBCU_SORT_THREADS, 0, stream>>>(
+                entryCount, shift, digitBits, tmp.tileCounts, tmp.digitTotals,
+                keysIn, keysOut, valsIn, valsOut, gatherIn, gatherOut );
+        }
+        else
+        {
+            RadixSortScatterKernel<TKey, TGather, false><<<tileCount, BBCU_SORT_THREADS, 0, stream>>>(
+                entryCount, shift, digitBits, tmp.tileCounts, tmp.digitTotals,
+                keysIn, keysOut, valsIn, valsOut, gatherIn, gatherOut );
+        }
+
+        keysIn = keysOut;
+        valsIn = valsOut;
+        shift += digitBits;
+    }
+
+    return cudaGetLastError();
+}
+
+#define BBCU_SORT_PAIRS_INSTANTIATE( TKey, TGather ) \
+    template cudaError CudaRadixSortPairs<TKey, TGather>( void*, size_t, const TKey*, TKey*, const uint32*, uint32*, \
+                                                          uint32, uint32, uint32, cudaStream_t, const TGather*, TGather* );
+
+template size_t CudaRadixSortTempSize<uint32>( uint32 entryCount );
+template size_t CudaRadixSortTempSize<uint64>( uint32 entryCount );
+
+BBCU_SORT_PAIRS_INSTANTIATE( uint32, uint32   )
+BBCU_SORT_PAIRS_INSTANTIATE( uint64, uint32   )
+BBCU_SORT_PAIRS_INSTANTIATE( uint64, K32Meta2 )
+BBCU_SORT_PAIRS_INSTANTIATE( uint64, K32Meta3 )
+BBCU_SORT_PAIRS_INSTANTIATE( uint64, K32Meta4 )
+
+#undef BBCU_SORT_PAIRS_INSTANTIATE
@@ -0,0 +1,31 @@
+#pragma once
+#include "GpuRuntime.h"
+
+/// Returns the temporary device buffer size, in bytes, required by CudaRadixSortPairs()
+/// to sort up to entryCount entries of TKey.
+template<typename TKey>
+size_t CudaRadixSortTempSize( uint32 entryCount );
+
+/// Stable LSD radix sort of keys with uint32 values, which only sorts key bits [beginBit, endBit).
+/// Knowing the actual bit width of y (k + kExtraBits, minus any bucket bits) lets this
+/// use fewer, wider digit passes than a full-width 32 or 64-bit key sort.
+///
+/// If devValsIn is null, the values are the entries' input index (the sort key),
+/// so that no separate sort key needs to be generated. In that case, devGatherIn, if given,
+/// is permuted into devGatherOut in the same last pass, instead of in a separate launch.
+///
+/// The input buffers are not modified.
+template<typename TKey, typename TGather = uint32>
+cudaError CudaRadixSortPairs(
+    void*          devTmp,
+    size_t         tmpSize,
+    const TKey*    devKeysIn,
+    TKey*          devKeysOut,
+    const uint32*  devValsIn,
+    uint32*        devValsOut,
+    uint32         entryCount,
+    uint32         beginBit,
+    uint32         endBit,
+    cudaStream_t   stream,
+    const TGather* devGatherIn  = nullptr,
+    TGather*       devGatherOut = nullptr );
@@ -0,0 +1,150 @@
+#include "pch.h"
+#include "CudaTuning.h"
+#include "util/Log.h"
+#include <filesystem>
+#include <mutex>
+
+static constexpr int MAX_TUNED_DEVICES = 64;
+
+static CudaLaunchProfile _profiles[MAX_TUNED_DEVICES];
+static bool              _loaded  [MAX_TUNED_DEVICES] = {};
+static std::mutex        _loadLock;
+
+static bool IsValidThreadCount( uint32 threads );
+
+//-----------------------------------------------------------
+const CudaLaunchProfile& CudaTuning::Profile()
+{
+    static const CudaLaunchProfile defaultProfile;
+
+    int device = 0;
+    if( cudaGetDevice( &device ) != cudaSuccess || device < 0 || device >= MAX_TUNED_DEVICES )
+        return defaultProfile;
+
+    return _profiles[device];
+}
+
+//-----------------------------------------------------------
+void CudaTuning::SetProfile( const int deviceIndex, const CudaLaunchProfile& profile )
+{
+    if( deviceIndex < 0 || deviceIndex >= MAX_TUNED_DEVICES )
+        return;
+
+    std::lock_guard<std::mutex> lock( _loadLock );
+    _profiles[deviceIndex] = profile;
+    _loaded  [deviceIndex] = true;
+}
+
+//-----------------------------------------------------------
+std::string CudaTuning::ProfilePath( const int deviceIndex )
+{
+    cudaDeviceProp props = {};
+    if( cudaGetDeviceProperties( &props, deviceIndex ) != cudaSuccess )
+        return "";
+
+    #if PLATFORM_IS_WINDOWS
+        const char* home = getenv( "USERPROFILE" );
+    #else
+        const char* home = getenv( "HOME" );
+    #endif
+
+    if( !home || !*home )
+        return "";
+
+    // Cards of the same model share a profile
+    std::string name = props.name;
+    for( char& c : name )
+    {
+        if( !isalnum( (unsigned char)c ) )
+            c = '_';
+    }
+
+    name += "_sm" + std::to_string( props.major ) + std::to_string( props.minor ) + ".tune";
+
+    return std::filesystem::path( home ).append( ".bladebit" ).append( "cuda" ).append( name ).string();
+}
+
+//-----------------------------------------------------------
+bool CudaTuning::LoadProfile( const int deviceIndex )
+{
+    if( deviceIndex < 0 || deviceIndex >= MAX_TUNED_DEVICES )
+        return false;
+
+    std::lock_guard<std::mutex> lock( _loadLock );
+
+    if( _loaded[deviceIndex] )
+        return false;
+
+    _loaded[deviceIndex] = true;
+
+    const std::string path = ProfilePath( deviceIndex );
+    if( path.empty() )
+        return false;
+
+    FILE* file = fopen( path.c_str(), "r" );
+    if( !file )
+        return false;
+
+    CudaLaunchProfile profile;
+
+    char   key[64];
+    uint32 value;
+    bool   valid = true;
+
+    while( valid && fscanf( file, "%63s %u", key, &value ) == 2 )
+    {
+        valid = IsValidThreadCount( value );
+
+        if( strcmp( key, "f1_threads" ) == 0 )
+            profile.f1Threads = value;
+        else if( strcmp( key, "fx_threads" ) == 0 )
+            profile.fxThreads = value;
+        else if( strcmp( key, "park_threads" ) == 0 )
+            profile.parkThreads = value;
+    }
+
+    fclose( file );
+
+    if( !valid )
+    {
+        Log::Error( "Warning: Ignoring invalid CUDA tuning profile '%s'.", path.c_str() );
+        return false;
+    }
+
+    _profiles[deviceIndex] = profile;
+    return true;
+}
+
+//-----------------------------------------------------------
+bool CudaTuning::SaveProfile( const int deviceIndex, const CudaLaunchProfile& profile )
+{
+    const std::string path = ProfilePath( deviceIndex );
+    if( path.empty() )
+        return false;
+
+    std::error_code err;
+    std::filesystem::create_directories( std::filesystem::path( path ).parent_path(), err );
+    if( err )
+        return false;
+
+    FILE* file = fopen( path.c_str(), "w" );
+    if( !file )
+        return false;
+
+    const bool written = fprintf( file, "f1_threads %u\nfx_threads %u\npark_threads %u\n",
+                                  profile.f1Threads, profile.fxThreads, profile.parkThreads ) > 0;
+
+    return fclose( file ) == 0 && written;
+}
+
+//-----------------------------------------------------------
+bool IsValidThreadCount( const uint32 threads )
+{
+    for( const uint32 t : CudaTuning::CandidateThreads )
+    {
+        if( t == threads )
+            return true;
+    }
+
+    return false;
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include "GpuRuntime.h"
+#include <string>
+
+///
+/// Block sizes of the kernels whose results don't depend on their launch configuration.
+/// The defaults are the values they were originally tuned with. 'cudacheck --tune' times
+/// the candidates of each kernel on a device and saves the fastest in a per-device profile,
+/// which the plotter and the harvester load when they select their device.
+///
+struct CudaLaunchProfile
+{
+    uint32 f1Threads   = 128;   // CudaGenF1K32, CudaGenF1ForXsK32
+    uint32 fxThreads   = 256;   // GenFxCuda, CudaFxHarvestK32, CudaFxHarvestK32Groups
+    uint32 parkThreads = 256;   // CompressToParkInGPU
+};
+
+namespace CudaTuning
+{
+    static constexpr uint32 CandidateThreads[] = { 64, 128, 256, 512, 1024 };
+
+    /// Profile of the current device.
+    const CudaLaunchProfile& Profile();
+
+    /// Replaces the profile of a device, for the rest of the process.
+    void SetProfile( int deviceIndex, const CudaLaunchProfile& profile );
+
+    /// Loads the saved profile of a device, if there is one, so that the
+    /// kernels launched on it from then on use it. Only the first call per device reads the file.
+    /// Returns true if a saved profile was loaded.
+    bool LoadProfile( int deviceIndex );
+
+    bool SaveProfile( int deviceIndex, const CudaLaunchProfile& profile );
+
+    /// Profiles are kept per device model, under ~/.bladebit/cuda
+    std::string ProfilePath( int deviceIndex );
+}
@@ -14,10 +14,7 @@
     #endif
 #endif
 
-#include <cuda_runtime.h>
-#include <cuda.h>
-#include <device_launch_parameters.h>
-#include <cuda_profiler_api.h>
+#include "GpuRuntime.h"
 
 #define CuBSwap16( x ) ( ((x) >> 8) | ((x) << 8) )
 
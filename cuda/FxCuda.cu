@@ -1,7 +1,7 @@
 #include "CudaPlotContext.h"
 #include "CudaFx.h"
-
-#define CU_FX_THREADS_PER_BLOCK 256
+#include "CudaPack.h"
+#include "CudaTuning.h"
 
 #define B3Round( intputByteSize ) \
     uint32 state[16] = {                      \
@@ -128,21 +128,15 @@ enum class FxVariant
 
 //-----------------------------------------------------------
 template<TableId rTable>
-__global__ void HarvestFxK32Kernel( 
+__device__ __forceinline__ void HarvestFxK32Entry( 
     uint64*       yOut, 
     void*         metaOutVoid,
-    const uint32  matchCount, 
-    const Pair*   pairsIn, 
+    const uint32  dstIdx,
+    const Pair    pair, 
     const uint64* yIn,
     const void*   metaInVoid
 )
 {
-    const uint32 id  = threadIdx.x;
-    const uint32 gid = (uint32)(blockIdx.x * blockDim.x + id);
-
-    if( gid >= matchCount )
-        return;
-
     using TMetaIn  = typename K32MetaType<rTable>::In;
     using TMetaOut = typename K32MetaType<rTable>::Out;
 
@@ -175,8 +169,6 @@ __global__ void HarvestFxK32Kernel(
         uint64 input [8];
         uint64 output[4];
 
-        const Pair pair = pairsIn[gid];
-        
         // CUDA_ASSERT( pair.left  < entryCount );
         // CUDA_ASSERT( pair.right < entryCount );
 
@@ -303,17 +295,74 @@ __global__ void HarvestFxK32Kernel(
     }
 
     // OK to store the value now
-    yOut[gid] = oy;
+    yOut[dstIdx] = oy;
 
     if constexpr ( MetaOutMulti > 0 )
-        metaOut[gid] = ometa;
+        metaOut[dstIdx] = ometa;
+}
+
+//-----------------------------------------------------------
+template<TableId rTable>
+__global__ void HarvestFxK32Kernel( 
+    uint64*       yOut, 
+    void*         metaOutVoid,
+    const uint32  matchCount, 
+    const Pair*   pairsIn, 
+    const uint64* yIn,
+    const void*   metaInVoid
+)
+{
+    const uint32 gid = (uint32)(blockIdx.x * blockDim.x + threadIdx.x);
+
+    if( gid >= matchCount )
+        return;
+
+    HarvestFxK32Entry<rTable>( yOut, metaOutVoid, gid, pairsIn[gid], yIn, metaInVoid );
+}
+
+/// Generates fx for all groups of a table at once, where blockIdx.y is the R group.
+/// Each R group's matches were made by 2 L groups, each in its own slot of matchStride entries.
+/// They are compacted into the R group's slot of matchStride*2 entries, with the matches
+/// of the first L group first, and the group's end index is stored in gOutGroupEnd.
+//-----------------------------------------------------------
+template<TableId rTable>
+__global__ void HarvestFxK32GroupsKernel( 
+    uint64*       yOut, 
+    void*         metaOutVoid,
+    Pair*         pairsOut,
+    uint32*       gOutGroupEnd,
+    const uint32  matchStride,
+    const uint32* gMatchCounts,
+    const Pair*   matchesIn, 
+    const uint64* yIn,
+    const void*   metaInVoid
+)
+{
+    const uint32 rGroup = blockIdx.y;
+    const uint32 gid    = (uint32)(blockIdx.x * blockDim.x + threadIdx.x);
+    const uint32 begin  = rGroup * matchStride * 2;
+
+    // Overflown matches were dropped
+    const uint32 count0 = min( gMatchCounts[rGroup*2  ], matchStride );
+    const uint32 count1 = min( gMatchCounts[rGroup*2+1], matchStride );
+
+    if( gid == 0 )
+        gOutGroupEnd[rGroup] = begin + count0 + count1;
+
+    if( gid >= count0 + count1 )
+        return;
+
+    const Pair pair = gid < count0 ? matchesIn[begin + gid] : matchesIn[begin + matchStride + gid - count0];
+
+    pairsOut[begin + gid] = pair;
+    HarvestFxK32Entry<rTable>( yOut, metaOutVoid, begin + gid, pair, yIn, metaInVoid );
 }
 
 //-----------------------------------------------------------
 template<FxVariant Variant, TableId rTable>
 __global__ void GenFxCuda( const uint32* pMatchCount, const uint64 bucketMask, const Pair* pairs, const uint32* yIn, const void* metaInVoid,
-                           uint32* yOut, void* metaOutVoid, const uint32 pairsOffset, uint32* pairsOutL, uint16* pairsOutR, uint32* globalBucketCounts,
-                           const Pair* inlinedXPairs
+                           uint32* yOut, void* metaOutVoid, const uint32 pairsOffset, uint32* pairsOutL, uint64* pairsOutR, uint32* globalBucketCounts,
+                           const Pair* inlinedXPairs, const uint32 packedRSliceWords, const uint32 packedYSliceWords
 #if _DEBUG
 , const uint32 entryCount
 #endif
@@ -345,10 +394,9 @@ __global__ void GenFxCuda( const uint32* pMatchCount, const uint64 bucketMask, c
     const TMetaIn*  metaIn  = (TMetaIn*)metaInVoid;
           TMetaOut* metaOut = (TMetaOut*)metaOutVoid;
 
-    CUDA_ASSERT( BBCU_BUCKET_COUNT <= CU_FX_THREADS_PER_BLOCK );
     __shared__ uint32 sharedBucketCounts[BBCU_BUCKET_COUNT];
-    if( id < BBCU_BUCKET_COUNT )
-        sharedBucketCounts[id] = 0;
+    for( uint32 b = id; b < BBCU_BUCKET_COUNT; b += blockDim.x )
+        sharedBucketCounts[b] = 0;
 
     __syncthreads();
 
@@ -496,15 +544,15 @@ __global__ void GenFxCuda( const uint32* pMatchCount, const uint64 bucketMask, c
         
         // Record local offset to the shared bucket count
         offset = atomicAdd( &sharedBucketCounts[bucket], 1 );
-        CUDA_ASSERT( offset < CU_FX_THREADS_PER_BLOCK );
+        CUDA_ASSERT( offset < blockDim.x );
     }
 
     // Store this block's bucket offset into the global bucket counts,
     // and get our global offset for that particular bucket
     __syncthreads();
 
-    if( id < BBCU_BUCKET_COUNT )
-        sharedBucketCounts[id] = atomicAdd( &globalBucketCounts[id], sharedBucketCounts[id] );
+    for( uint32 b = id; b < BBCU_BUCKET_COUNT; b += blockDim.x )
+        sharedBucketCounts[b] = atomicAdd( &globalBucketCounts[b], sharedBucketCounts[b] );
 
     __syncthreads();
 
@@ -531,12 +579,21 @@ __global__ void GenFxCuda( const uint32* pMatchCount, const uint64 bucketMask, c
 #endif
 
     // OK to store the value now
-    yOut[dstY] = (uint32)oy & yMask;
+    if constexpr ( MetaOutMulti == 0 )
+    {
+        // Table 7 y's are packed without their bucket bits
+        CudaPackedSliceWrite( (uint64*)yOut + bucket * packedYSliceWords, offsetInSlice, BBCU_PACKED_Y_T7_BITS,
+                              oy & ( ( 1ull << BBCU_PACKED_Y_T7_BITS ) - 1 ) );
+    }
+    else
+        yOut[dstY] = (uint32)oy & yMask;
 
     if constexpr ( Variant == FxVariant::Regular )
     {
         pairsOutL[dstY] = pairsOffset + pair.left;
-        pairsOutR[dstY] = (uint16)(pair.right - pair.left);
+
+        CUDA_ASSERT( pair.right - pair.left < ( 1u << BBCU_PACKED_PAIR_R_BITS ) );
+        CudaPackedSliceWrite( pairsOutR + bucket * packedRSliceWords, offsetInSlice, BBCU_PACKED_PAIR_R_BITS, pair.right - pair.left );
     }
     else if constexpr( Variant == FxVariant::InlineTable1 )
     {
@@ -550,14 +607,19 @@ __global__ void GenFxCuda( const uint32* pMatchCount, const uint64 bucketMask, c
     }
 
     if constexpr ( MetaOutMulti > 0 )
-        metaOut[dstY] = ometa;
+    {
+        // Inlined x pairs may have their metadata recomputed from the pairs instead
+        if( Variant != FxVariant::InlineTable1 || metaOut )
+            metaOut[dstY] = ometa;
+    }
 }
 
 //-----------------------------------------------------------
 template<FxVariant Variant>
 inline void GenFxForTable( CudaK32PlotContext& cx, const uint32* devYIn, const uint32* devMetaIn, cudaStream_t stream )
 {
-    const uint32 cudaBlockCount = CDiv( BBCU_BUCKET_ALLOC_ENTRY_COUNT, CU_FX_THREADS_PER_BLOCK );
+    const uint32 kthreads       = CudaTuning::Profile().fxThreads;
+    const uint32 cudaBlockCount = CDiv( BBCU_BUCKET_ALLOC_ENTRY_COUNT, kthreads );
     const uint64 bucketMask     = BBC_BUCKET_MASK( cx.bucket );
 
     const bool isCompressed = (uint32)cx.table <= cx.gCfg->numDroppedTables;
@@ -574,7 +636,7 @@ inline void GenFxForTable( CudaK32PlotContext& cx, const uint32* devYIn, const u
     uint32* devYOut      = (uint32*)cx.yOut.LockDeviceBuffer( stream );
 
     uint32* devPairsLOut = nullptr;
-    uint16* devPairsROut = nullptr;
+    uint64* devPairsROut = nullptr;
 
     if( isPairs )
     {
@@ -586,25 +648,34 @@ inline void GenFxForTable( CudaK32PlotContext& cx, const uint32* devYIn, const u
         devPairsLOut = (uint32*)cx.pairsLOut.LockDeviceBuffer( stream );
 
         if( !isCompressed )
-            devPairsROut = (uint16*)cx.pairsROut.LockDeviceBuffer( stream );
+        {
+            // R pairs are bit-packed, so their slices must start zeroed
+            devPairsROut = (uint64*)cx.pairsROut.LockDeviceBuffer( stream );
+            CudaErrCheck( cudaMemsetAsync( devPairsROut, 0, cx.packedPairsRSliceStride * BBCU_BUCKET_COUNT, stream ) );
+        }
     }
 
-    void* devMetaOut = cx.table < TableId::Table7 ? cx.metaOut.LockDeviceBuffer( stream ) : nullptr;
+    if( cx.table == TableId::Table7 )
+        CudaErrCheck( cudaMemsetAsync( devYOut, 0, cx.packedYT7SliceStride * BBCU_BUCKET_COUNT, stream ) );
+
+    const bool storeMeta  = cx.table < TableId::Table7 && !CudaK32PlotIsMetaRecomputed( cx, cx.table );
+    void*      devMetaOut = storeMeta ? cx.metaOut.LockDeviceBuffer( stream ) : nullptr;
 
     uint32* devBucketCounts = cx.devSliceCounts + cx.bucket * BBCU_BUCKET_COUNT;
 
     #define FX_CUDA_ARGS cx.devMatchCount, bucketMask, cx.devMatches, devYIn, devMetaIn, \
          devYOut, devMetaOut, cx.prevTablePairOffset, devPairsLOut, devPairsROut, \
-         devBucketCounts, cx.devInlinedXs DBG_FX_INPUT_ENTRY_COUNT
+         devBucketCounts, cx.devInlinedXs, (uint32)( cx.packedPairsRSliceStride / sizeof( uint64 ) ), \
+         (uint32)( cx.packedYT7SliceStride / sizeof( uint64 ) ) DBG_FX_INPUT_ENTRY_COUNT
 // return;
     switch( cx.table )
     {
-        case TableId::Table2: GenFxCuda<Variant, TableId::Table2><<<cudaBlockCount, CU_FX_THREADS_PER_BLOCK, 0, stream>>>( FX_CUDA_ARGS ); break;
-        case TableId::Table3: GenFxCuda<Variant, TableId::Table3><<<cudaBlockCount, CU_FX_THREADS_PER_BLOCK, 0, stream>>>( FX_CUDA_ARGS ); break;
-        case TableId::Table4: GenFxCuda<Variant, TableId::Table4><<<cudaBlockCount, CU_FX_THREADS_PER_BLOCK, 0, stream>>>( FX_CUDA_ARGS ); break;
-        case TableId::Table5: GenFxCuda<Variant, TableId::Table5><<<cudaBlockCount, CU_FX_THREADS_PER_BLOCK, 0, stream>>>( FX_CUDA_ARGS ); break;
-        case TableId::Table6: GenFxCuda<Variant, TableId::Table6><<<cudaBlockCount, CU_FX_THREADS_PER_BLOCK, 0, stream>>>( FX_CUDA_ARGS ); break;
-        case TableId::Table7: GenFxCuda<Variant, TableId::Table7><<<cudaBlockCount, CU_FX_THREADS_PER_BLOCK, 0, stream>>>( FX_CUDA_ARGS ); break;
+        case TableId::Table2: GenFxCuda<Variant, TableId::Table2><<<cudaBlockCount, kthreads, 0, stream>>>( FX_CUDA_ARGS ); break;
+        case TableId::Table3: GenFxCuda<Variant, TableId::Table3><<<cudaBlockCount, kthreads, 0, stream>>>( FX_CUDA_ARGS ); break;
+        case TableId::Table4: GenFxCuda<Variant, TableId::Table4><<<cudaBlockCount, kthreads, 0, stream>>>( FX_CUDA_ARGS ); break;
+        case TableId::Table5: GenFxCuda<Variant, TableId::Table5><<<cudaBlockCount, kthreads, 0, stream>>>( FX_CUDA_ARGS ); break;
+        case TableId::Table6: GenFxCuda<Variant, TableId::Table6><<<cudaBlockCount, kthreads, 0, stream>>>( FX_CUDA_ARGS ); break;
+        case TableId::Table7: GenFxCuda<Variant, TableId::Table7><<<cudaBlockCount, kthreads, 0, stream>>>( FX_CUDA_ARGS ); break;
     }
 
     #undef FX_CUDA_ARGS
@@ -647,7 +718,7 @@ void CudaFxHarvestK32(
     ASSERT( devPairsIn );
     ASSERT( matchCount );
 
-    const uint32 kthreads = 256;
+    const uint32 kthreads = CudaTuning::Profile().fxThreads;
     const uint32 kblocks  = CDiv( matchCount, kthreads );
 
     #define KERN_ARGS devYOut, devMetaOut, matchCount, devPairsIn, devYIn, devMetaIn
@@ -678,4 +749,54 @@ void CudaFxHarvestK32(
             Panic( "Unexpected table.");
             break;
     }
-}
\ No newline at end of file
+}
+
+//-----------------------------------------------------------
+void CudaFxHarvestK32Groups(
+    const TableId table,
+    uint64*       devYOut, 
+    void*         devMetaOut,
+    Pair*         devPairsOut,
+    uint32*       devGroupEnd,
+    const uint32  groupCount,
+    const uint32  matchStride,
+    const uint32* devMatchCounts,
+    const Pair*   devMatchesIn,
+    const uint64* devYIn,
+    const void*   devMetaIn,
+    cudaStream_t  stream )
+{
+    ASSERT( devYIn );
+    ASSERT( devMetaIn );
+    ASSERT( devYOut );
+    ASSERT( devMetaOut );
+    ASSERT( devPairsOut );
+    ASSERT( groupCount );
+
+    const uint32 kthreads = CudaTuning::Profile().fxThreads;
+    const dim3   kblocks( CDiv( matchStride * 2, kthreads ), groupCount );
+
+    #define KERN_ARGS devYOut, devMetaOut, devPairsOut, devGroupEnd, matchStride, devMatchCounts, devMatchesIn, devYIn, devMetaIn
+
+    switch( table )
+    {
+        case TableId::Table3:
+            HarvestFxK32GroupsKernel<TableId::Table3><<<kblocks, kthreads, 0, stream>>>( KERN_ARGS );
+            break;
+        case TableId::Table4:
+            HarvestFxK32GroupsKernel<TableId::Table4><<<kblocks, kthreads, 0, stream>>>( KERN_ARGS );
+            break;
+        case TableId::Table5:
+            HarvestFxK32GroupsKernel<TableId::Table5><<<kblocks, kthreads, 0, stream>>>( KERN_ARGS );
+            break;
+        case TableId::Table6:
+            HarvestFxK32GroupsKernel<TableId::Table6><<<kblocks, kthreads, 0, stream>>>( KERN_ARGS );
+            break;
+    
+        default:
+            Panic( "Unexpected table.");
+            break;
+    }
+
+    #undef KERN_ARGS
+}
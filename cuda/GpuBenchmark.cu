@@ -0,0 +1,454 @@
+#include "pch.h"
+#include "tools/GpuBenchmark.h"
+#include "pos/chacha8.h"
+#include "plotting/CTables.h"
+#include "plotting/PlotTypes.h"
+#include "CudaF1.h"
+#include "CudaFx.h"
+#include "CudaMatch.h"
+#include "CudaSort.h"
+#include "CudaUtil.h"
+#include "CudaParkSerializer.h"
+#include "CudaTuning.h"
+#include "GpuQueue.h"
+#include "ChiaConsts.h"
+#include "util/Log.h"
+
+//-----------------------------------------------------------
+__global__ void MaskBenchYKernel( uint64* y, const uint64 yMask, const uint32 entryCount )
+{
+    const uint32 gid = (uint32)(blockIdx.x * blockDim.x + threadIdx.x);
+
+    if( gid < entryCount )
+        y[gid] &= yMask;
+}
+
+namespace {
+
+// Large enough to fill any current device, small enough to fit on 8GB ones.
+// The y's are cut down to BENCH_Y_BITS, so that they are as dense as those of a full k32 table.
+static constexpr uint32 BENCH_ENTRY_COUNT      = 1u << 24;
+static constexpr uint32 BENCH_Y_BITS           = 24 + kExtraBits;
+static constexpr uint32 BENCH_PARK_COUNT       = 4096;
+static constexpr uint32 BENCH_PASS_COUNT       = 3;
+static constexpr size_t BENCH_PARK_BUFFER_SIZE = CDiv( CalculateParkSize( TableId::Table1 ), sizeof( uint64 ) ) * sizeof( uint64 );
+
+// Rough bytes moved each way over PCIe per entry and table by the in-memory k32 plotter
+// (y, metadata, pairs and maps), from its phase 1 and phase 3 buffer sizes.
+static constexpr double PLOT_H2D_BYTES_PER_ENTRY = 40.0;
+static constexpr double PLOT_D2H_BYTES_PER_ENTRY = 40.0;
+
+class CudaBenchmark
+{
+public:
+    //-----------------------------------------------------------
+    ~CudaBenchmark()
+    {
+        if( _start  ) cudaEventDestroy( _start );
+        if( _end    ) cudaEventDestroy( _end );
+        if( _stream ) cudaStreamDestroy( _stream );
+
+        CudaSafeFree( _devChaChaInput );
+        CudaSafeFree( _devYF1    );
+        CudaSafeFree( _devXF1    );
+        CudaSafeFree( _devY      );
+        CudaSafeFree( _devX      );
+        CudaSafeFree( _devSortTmp );
+        CudaSafeFree( _devPairs  );
+        CudaSafeFree( _devMatchCount );
+        CudaSafeFree( _devYOut   );
+        CudaSafeFree( _devMetaOut );
+        CudaSafeFree( _devLinePoints );
+        CudaSafeFree( _devParks  );
+        CudaSafeFree( _devCTable );
+        CudaSafeFree( _devParkOverrunCount );
+        CudaSafeFreeHost( _hostLinePoints );
+    }
+
+    //-----------------------------------------------------------
+    bool Init( const int deviceId )
+    {
+        _deviceId    = deviceId;
+        _sortTmpSize = CudaRadixSortTempSize<uint64>( BENCH_ENTRY_COUNT );
+
+        const size_t lpCount = (size_t)BENCH_PARK_COUNT * kEntriesPerPark;
+
+        #define CU_INIT( expr ) if( ( cErr = (expr) ) != cudaSuccess ) goto FAIL
+
+        cudaError_t cErr;
+        CU_INIT( cudaSetDevice( deviceId ) );
+        CU_INIT( cudaStreamCreateWithFlags( &_stream, cudaStreamNonBlocking ) );
+        CU_INIT( cudaEventCreate( &_start ) );
+        CU_INIT( cudaEventCreate( &_end ) );
+
+        CU_INIT( CudaCallocT( _devChaChaInput, 16 ) );
+        CU_INIT( CudaCallocT( _devYF1    , BENCH_ENTRY_COUNT ) );
+        CU_INIT( CudaCallocT( _devXF1    , BENCH_ENTRY_COUNT ) );
+        CU_INIT( CudaCallocT( _devY      , BENCH_ENTRY_COUNT ) );
+        CU_INIT( CudaCallocT( _devX      , BENCH_ENTRY_COUNT ) );
+        CU_INIT( CudaCallocT( _devSortTmp, _sortTmpSize ) );
+        CU_INIT( CudaCallocT( _devPairs  , BENCH_ENTRY_COUNT ) );
+        CU_INIT( CudaCallocT( _devMatchCount, 1 ) );
+        CU_INIT( CudaCallocT( _devYOut   , BENCH_ENTRY_COUNT ) );
+        CU_INIT( CudaCallocT( _devMetaOut, BENCH_ENTRY_COUNT ) );
+        CU_INIT( CudaCallocT( _devLinePoints, lpCount ) );
+        CU_INIT( CudaCallocT( _devParks  , BENCH_PARK_COUNT * BENCH_PARK_BUFFER_SIZE ) );
+        CU_INIT( CudaCallocT( _devCTable , sizeof( CTable_0 ) ) );
+        CU_INIT( CudaCallocT( _devParkOverrunCount, 1 ) );
+
+        CU_INIT( cudaMallocHost( (void**)&_hostLinePoints, lpCount * sizeof( uint64 ) ) );
+
+        #undef CU_INIT
+        return true;
+
+    FAIL:
+        Log::Line( "Failed to initialize the benchmark on device %d with CUDA error '%s': %s",
+                   deviceId, cudaGetErrorName( cErr ), cudaGetErrorString( cErr ) );
+        return false;
+    }
+
+    //-----------------------------------------------------------
+    bool Run( GpuBenchResult& r )
+    {
+        r = {};
+
+        if( !UploadChaChaInput() )
+            return false;
+
+        // F1
+        if( !Time( r.f1, BENCH_ENTRY_COUNT, [&]() { return LaunchF1(); } ) )
+            return false;
+
+        uint32 matchCount = 0;
+        if( !SortAndMatch( r.sort, r.match, matchCount ) )
+            return false;
+
+        // Table 2 fx
+        if( !Time( r.fx, matchCount, [&]() { return LaunchFx( matchCount ); } ) )
+            return false;
+
+        // Table 1 parks, from synthetic line point deltas
+        if( !UploadParkInput() )
+            return false;
+
+        if( !Time( r.park, (uint64)BENCH_PARK_COUNT * kEntriesPerPark, [&]() { return LaunchParks(); } ) )
+            return false;
+
+        GpuTransferBandwidth bw = {};
+        if( !GpuQueue::MeasureTransferBandwidth( bw ) )
+        {
+            Log::Line( "Failed to measure transfer bandwidth." );
+            return false;
+        }
+
+        r.h2d = bw.h2d;
+        r.d2h = bw.d2h;
+
+        // Phase 1 generates table 1 and runs sort, match and fx for the 6 other tables.
+        // Phase 3 sorts the line points of 6 tables and compresses them into parks.
+        // Transfers run on their own streams, so only the slower of the two counts.
+        const double n = (double)( 1ull << 32 );
+
+        const double computeSeconds = n / r.f1 +
+                                      6.0 * n * ( 1.0 / r.sort + 1.0 / r.match + 1.0 / r.fx ) +
+                                      6.0 * n * ( 1.0 / r.sort + 1.0 / r.park );
+
+        const double transferSeconds = 7.0 * n * ( PLOT_H2D_BYTES_PER_ENTRY / r.h2d + PLOT_D2H_BYTES_PER_ENTRY / r.d2h );
+
+        r.plotSeconds = std::max( computeSeconds, transferSeconds );
+        return true;
+    }
+
+    //-----------------------------------------------------------
+    bool Tune( CudaLaunchProfile& outProfile )
+    {
+        CudaLaunchProfile profile;
+
+        if( !UploadChaChaInput() )
+            return false;
+
+        if( !TuneThreads( profile, profile.f1Threads, BENCH_ENTRY_COUNT, [&]() { return LaunchF1(); } ) )
+            return false;
+
+        // The fx kernels hash the matches of the sorted table 1
+        double sortRate, matchRate;
+        uint32 matchCount = 0;
+
+        if( !SortAndMatch( sortRate, matchRate, matchCount ) )
+            return false;
+
+        if( !TuneThreads( profile, profile.fxThreads, matchCount, [&]() { return LaunchFx( matchCount ); } ) )
+            return false;
+
+        if( !UploadParkInput() )
+            return false;
+
+        if( !TuneThreads( profile, profile.parkThreads, (uint64)BENCH_PARK_COUNT * kEntriesPerPark, [&]() { return LaunchParks(); } ) )
+            return false;
+
+        outProfile = profile;
+        return true;
+    }
+
+private:
+    //-----------------------------------------------------------
+    bool UploadChaChaInput()
+    {
+        // Same seed setup as the harvester, with a fixed plot id
+        byte plotId[BB_PLOT_ID_LEN];
+        memset( plotId, 0xB1, sizeof( plotId ) );
+
+        byte key[32] = { 1 };
+        memcpy( key + 1, plotId, 32 - 1 );
+
+        chacha8_ctx chacha;
+        chacha8_keysetup( &chacha, key, 256, nullptr );
+
+        const cudaError_t cErr = cudaMemcpyAsync( _devChaChaInput, chacha.input, 64, cudaMemcpyHostToDevice, _stream );
+        return cErr == cudaSuccess ? true : Fail( cErr );
+    }
+
+    //-----------------------------------------------------------
+    cudaError_t LaunchF1()
+    {
+        CudaPlotInfo info = {};
+        info.k = 32;
+
+        const uint32 chachaBlockCount = BENCH_ENTRY_COUNT / ( kF1BlockSize / sizeof( uint32 ) );
+
+        CudaGenF1K32( info, _devChaChaInput, 0, chachaBlockCount, _devYF1, _devXF1, _stream );
+        return cudaPeekAtLastError();
+    }
+
+    //-----------------------------------------------------------
+    cudaError_t LaunchFx( const uint32 matchCount )
+    {
+        CudaFxHarvestK32( TableId::Table2, _devYOut, _devMetaOut, matchCount, _devPairs, _devY, _devX, _stream );
+        return cudaPeekAtLastError();
+    }
+
+    //-----------------------------------------------------------
+    cudaError_t LaunchParks()
+    {
+        const uint32 stubBitSize = 32 - kStubMinusBits;
+
+        CompressToParkInGPU( BENCH_PARK_COUNT, CalculateParkSize( TableId::Table1 ), _devLinePoints, _devParks,
+                             BENCH_PARK_BUFFER_SIZE, stubBitSize, (const FSE_CTable*)_devCTable, _devParkOverrunCount,
+                             ParkDeltaCoding::FSE, nullptr, _stream );
+        return cudaPeekAtLastError();
+    }
+
+    /// Sorts the F1 output on y and matches it, timing both
+    //-----------------------------------------------------------
+    bool SortAndMatch( double& outSortRate, double& outMatchRate, uint32& outMatchCount )
+    {
+        const uint32 kthreads = 256;
+        MaskBenchYKernel<<<CDiv( BENCH_ENTRY_COUNT, kthreads ), kthreads, 0, _stream>>>( _devYF1, ( 1ull << BENCH_Y_BITS ) - 1, BENCH_ENTRY_COUNT );
+
+        // Sort on y, carrying x
+        if( !Time( outSortRate, BENCH_ENTRY_COUNT, [&]() {
+                return CudaRadixSortPairs<uint64>( _devSortTmp, _sortTmpSize, _devYF1, _devY, _devXF1, _devX,
+                                                   BENCH_ENTRY_COUNT, 0, BENCH_Y_BITS, _stream );
+            }) )
+            return false;
+
+        // Match the sorted table 1
+        if( !Time( outMatchRate, BENCH_ENTRY_COUNT, [&]() {
+                return CudaHarvestMatchK32( _devPairs, _devMatchCount, BENCH_ENTRY_COUNT,
+                                            _devY, BENCH_ENTRY_COUNT, 0, _stream );
+            }) )
+            return false;
+
+        uint32 matchCount = 0;
+        cudaError_t cErr = cudaMemcpyAsync( &matchCount, _devMatchCount, sizeof( uint32 ), cudaMemcpyDeviceToHost, _stream );
+        if( cErr == cudaSuccess )
+            cErr = cudaStreamSynchronize( _stream );
+        if( cErr != cudaSuccess )
+            return Fail( cErr );
+
+        matchCount = std::min( matchCount, BENCH_ENTRY_COUNT );
+        if( matchCount == 0 )
+        {
+            Log::Line( "The benchmark found no matches." );
+            return false;
+        }
+
+        outMatchCount = matchCount;
+        return true;
+    }
+
+    /// Times a kernel with each candidate block size, and keeps the fastest in threads,
+    /// which is a field of profile. Candidates the kernel can't be launched with are skipped.
+    //-----------------------------------------------------------
+    template<typename TLaunch>
+    bool TuneThreads( CudaLaunchProfile& profile, uint32& threads, const uint64 count, TLaunch launch )
+    {
+        const uint32 defaultThreads = threads;
+
+        uint32 best     = 0;
+        double bestRate = 0;
+
+        for( const uint32 candidate : CudaTuning::CandidateThreads )
+        {
+            threads = candidate;
+            CudaTuning::SetProfile( _deviceId, profile );
+
+            // Launch configuration errors, such as too many registers for the block size, are not sticky
+            if( launch() != cudaSuccess || cudaStreamSynchronize( _stream ) != cudaSuccess )
+            {
+                cudaGetLastError();
+                continue;
+            }
+
+            double rate = 0;
+            if( !Time( rate, count, launch ) )
+                return false;
+
+            if( rate > bestRate )
+            {
+                bestRate = rate;
+                best     = candidate;
+            }
+        }
+
+        threads = best ? best : defaultThreads;
+        CudaTuning::SetProfile( _deviceId, profile );
+
+        return best != 0;
+    }
+
+    //-----------------------------------------------------------
+    template<typename TLaunch>
+    bool Time( double& outPerSecond, const uint64 count, TLaunch launch )
+    {
+        // Warm up
+        cudaError_t cErr = launch();
+
+        if( cErr == cudaSuccess )
+            cErr = cudaEventRecord( _start, _stream );
+
+        for( uint32 i = 0; i < BENCH_PASS_COUNT && cErr == cudaSuccess; i++ )
+            cErr = launch();
+
+        if( cErr == cudaSuccess )
+            cErr = cudaEventRecord( _end, _stream );
+        if( cErr == cudaSuccess )
+            cErr = cudaEventSynchronize( _end );
+
+        float elapsedMS = 0;
+        if( cErr == cudaSuccess )
+            cErr = cudaEventElapsedTime( &elapsedMS, _start, _end );
+
+        if( cErr != cudaSuccess )
+            return Fail( cErr );
+
+        outPerSecond = (double)count * BENCH_PASS_COUNT / ( std::max( elapsedMS, 0.001f ) / 1000.0 );
+        return true;
+    }
+
+    //-----------------------------------------------------------
+    bool UploadParkInput()
+    {
+        // Table 1 deltas are mostly 0 to 3 above the stub bits, with random stubs
+        const uint32 stubBitSize = 32 - kStubMinusBits;
+        const size_t lpCount     = (size_t)BENCH_PARK_COUNT * kEntriesPerPark;
+
+        uint64 state = 0x9E3779B97F4A7C15ull;
+
+        for( size_t i = 0; i < lpCount; i++ )
+        {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+
+            const uint64 stub  = state & ( ( 1ull << stubBitSize ) - 1 );
+            const uint64 delta = ( state >> 62 );
+
+            _hostLinePoints[i] = ( delta << stubBitSize ) | stub;
+        }
+
+        cudaError_t cErr = cudaMemcpyAsync( _devLinePoints, _hostLinePoints, lpCount * sizeof( uint64 ), cudaMemcpyHostToDevice, _stream );
+
+        if( cErr == cudaSuccess )
+            cErr = cudaMemcpyAsync( _devCTable, CTable_0, sizeof( CTable_0 ), cudaMemcpyHostToDevice, _stream );
+        if( cErr == cudaSuccess )
+            cErr = cudaMemsetAsync( _devParkOverrunCount, 0, sizeof( uint32 ), _stream );
+        if( cErr == cudaSuccess )
+            cErr = cudaStreamSynchronize( _stream );
+
+        return cErr == cudaSuccess ? true : Fail( cErr );
+    }
+
+    //-----------------------------------------------------------
+    bool Fail( const cudaError_t cErr )
+    {
+        Log::Line( "GPU benchmark failed with CUDA error '%s': %s", cudaGetErrorName( cErr ), cudaGetErrorString( cErr ) );
+        return false;
+    }
+
+private:
+    int          _deviceId       = 0;
+    cudaStream_t _stream         = nullptr;
+    cudaEvent_t  _start          = nullptr;
+    cudaEvent_t  _end            = nullptr;
+    size_t       _sortTmpSize    = 0;
+
+    uint32*      _devChaChaInput = nullptr;
+    uint64*      _devYF1         = nullptr;
+    uint32*      _devXF1         = nullptr;
+    uint64*      _devY           = nullptr;
+    uint32*      _devX           = nullptr;
+    byte*        _devSortTmp     = nullptr;
+    Pair*        _devPairs       = nullptr;
+    uint32*      _devMatchCount  = nullptr;
+    uint64*      _devYOut        = nullptr;
+    uint64*      _devMetaOut     = nullptr;
+    uint64*      _devLinePoints  = nullptr;
+    byte*        _devParks       = nullptr;
+    byte*        _devCTable      = nullptr;
+    uint32*      _devParkOverrunCount = nullptr;
+
+    uint64*      _hostLinePoints = nullptr;
+};
+
+} // namespace
+
+/// Declared in GpuBenchmark.h
+//-----------------------------------------------------------
+bool GpuBenchmark::Run( const int deviceIndex, GpuBenchResult& outResult )
+{
+    outResult = {};
+
+    int deviceCount = 0;
+    if( cudaGetDeviceCount( &deviceCount ) != cudaSuccess || deviceIndex < 0 || deviceIndex >= deviceCount )
+        return false;
+
+    CudaBenchmark bench;
+    return bench.Init( deviceIndex ) && bench.Run( outResult );
+}
+
+/// Declared in GpuBenchmark.h
+//-----------------------------------------------------------
+bool GpuBenchmark::Tune( const int deviceIndex, GpuTuneResult& outResult )
+{
+    outResult = {};
+
+    int deviceCount = 0;
+    if( cudaGetDeviceCount( &deviceCount ) != cudaSuccess || deviceIndex < 0 || deviceIndex >= deviceCount )
+        return false;
+
+    CudaLaunchProfile profile;
+    {
+        CudaBenchmark bench;
+        if( !bench.Init( deviceIndex ) || !bench.Tune( profile ) )
+            return false;
+    }
+
+    outResult.f1Threads   = profile.f1Threads;
+    outResult.fxThreads   = profile.fxThreads;
+    outResult.parkThreads = profile.parkThreads;
+    outResult.profilePath = CudaTuning::ProfilePath( deviceIndex );
+    outResult.saved       = CudaTuning::SaveProfile( deviceIndex, profile );
+
+    return true;
+}
@@ -0,0 +1,15 @@
+#include "tools/GpuBenchmark.h"
+
+/// Dummy function for when CUDA is not available
+bool GpuBenchmark::Run( int deviceIndex, GpuBenchResult& outResult )
+{
+    outResult = {};
+    return false;
+}
+
+/// Dummy function for when CUDA is not available
+bool GpuBenchmark::Tune( int deviceIndex, GpuTuneResult& outResult )
+{
+    outResult = {};
+    return false;
+}
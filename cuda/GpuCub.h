@@ -0,0 +1,11 @@
+#pragma once
+#include "GpuRuntime.h"
+
+/// Device-wide sort primitives. hipCUB has the same interface as cub, so HIP builds use it under the cub namespace.
+#if BB_HIP_ENABLED
+    #include <hipcub/hipcub.hpp>
+    namespace cub = hipcub;
+#else
+    #include "cub/device/device_radix_sort.cuh"
+    #include "cub/device/device_segmented_radix_sort.cuh"
+#endif
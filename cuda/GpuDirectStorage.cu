@@ -0,0 +1,126 @@
+#include "GpuQueue.h"
+#include "plotting/DiskBucketBuffer.h"
+
+#if BB_CUDA_USE_CUFILE
+    #include <cufile.h>
+#endif
+
+///
+/// GPUDirect Storage (cuFile) support for DiskBucketBuffer-backed streams
+///
+#if BB_CUDA_USE_CUFILE
+
+static bool _gdsDriverOpen = false;
+
+class GpuDirectFileIO : public IDiskBucketDeviceIO
+{
+public:
+    inline GpuDirectFileIO( CUfileHandle_t handle, const int32 cudaDevice )
+        : _handle( handle )
+        , _device( cudaDevice )
+    {}
+
+    ~GpuDirectFileIO() override
+    {
+        cuFileHandleDeregister( _handle );
+    }
+
+    bool WriteSlice( const void* src, const size_t size, const int64 fileOffset, int& error ) override
+    {
+        // cuFile uses the calling thread's current device
+        CudaErrCheck( cudaSetDevice( _device ) );
+
+        size_t written = 0;
+        while( written < size )
+        {
+            const ssize_t r = cuFileWrite( _handle, src, size - written, (off_t)(fileOffset + (int64)written), (off_t)written );
+            if( r <= 0 )
+            {
+                error = r < 0 ? (int)-r : 0;
+                return false;
+            }
+
+            written += (size_t)r;
+        }
+
+        return true;
+    }
+
+    bool ReadSlice( void* dst, const size_t size, const int64 fileOffset, int& error ) override
+    {
+        CudaErrCheck( cudaSetDevice( _device ) );
+
+        size_t read = 0;
+        while( read < size )
+        {
+            const ssize_t r = cuFileRead( _handle, dst, size - read, (off_t)(fileOffset + (int64)read), (off_t)read );
+            if( r <= 0 )
+            {
+                error = r < 0 ? (int)-r : 0;
+                return false;
+            }
+
+            read += (size_t)r;
+        }
+
+        return true;
+    }
+
+private:
+    CUfileHandle_t _handle;
+    int32          _device;
+};
+
+#endif // BB_CUDA_USE_CUFILE
+
+
+//-----------------------------------------------------------
+bool GpuQueue::InitGpuDirectStorage()
+{
+#if BB_CUDA_USE_CUFILE
+    if( _gdsDriverOpen )
+        return true;
+
+    const CUfileError_t r = cuFileDriverOpen();
+    if( r.err != CU_FILE_SUCCESS )
+    {
+        Log::Line( "Warning: Failed to open the GPUDirect Storage driver with error %d.", (int)r.err );
+        return false;
+    }
+
+    _gdsDriverOpen = true;
+    return true;
+#else
+    Log::Line( "Warning: GPUDirect Storage is unavailable in this build (requires BB_CUDA_USE_CUFILE)." );
+    return false;
+#endif
+}
+
+//-----------------------------------------------------------
+bool GpuQueue::EnableGpuDirectStorage( DiskBucketBuffer& buffer, const int32 cudaDevice )
+{
+#if BB_CUDA_USE_CUFILE
+    if( !_gdsDriverOpen )
+        return false;
+
+    CUfileDescr_t descr = {};
+    descr.handle.fd = (int)buffer.File().Id();
+    descr.type      = CU_FILE_HANDLE_TYPE_OPAQUE_FD;
+
+    CUfileHandle_t handle = {};
+    const CUfileError_t r = cuFileHandleRegister( &handle, &descr );
+    if( r.err != CU_FILE_SUCCESS )
+    {
+        Log::Line( "Warning: Failed to register '%s' with GPUDirect Storage with error %d. Using host buffers for it.",
+            buffer.Name(), (int)r.err );
+        return false;
+    }
+
+    buffer.SetDeviceIO( new GpuDirectFileIO( handle, cudaDevice ) );
+    return true;
+#else
+    (void)buffer;
+    (void)cudaDevice;
+    return false;
+#endif
+}
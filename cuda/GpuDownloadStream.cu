@@ -141,6 +141,31 @@ void GpuDownloadBuffer::PerformDownload2D( void* hostBuffer, size_t width, size_
     CudaErrCheck( cudaStreamWaitEvent( downloadStream, self->workEvent[index] ) );
 
 
+    if( self->diskDirect )
+    {
+        // The disk buffer writes straight from our device buffer (GPUDirect Storage),
+        // so the device buffer can only be re-used once the slices have been written.
+        ASSERT( devBuffer == self->diskBuffer->PeekWriteBufferForBucket( self->outgoingSequence-1 ) );
+
+        CallHostFunctionOnStream( downloadStream, [=](){
+            auto* diskBucketBuffer = static_cast<DiskBucketBuffer*>( self->diskBuffer );
+
+            (void)diskBucketBuffer->GetNextWriteBuffer();
+            diskBucketBuffer->Submit( srcStride );
+            diskBucketBuffer->WaitForLastWriteToComplete();
+        });
+
+        if( postCallback )
+        {
+            CallHostFunctionOnStream( downloadStream, [=](){
+                (*postCallback)( finalHostBuffer, totalSize, postUserData );
+            });
+        }
+
+        CudaErrCheck( cudaEventRecord( self->deviceEvents[index], downloadStream ) );
+        return;
+    }
+
     if( self->diskBuffer )
     {
         // Wait until the next disk buffer is ready for use.
@@ -375,8 +400,22 @@ void GpuDownloadBuffer::AssignDiskBuffer( DiskBufferBase* diskBuffer )
         self->diskBuffer->AssignWriteBuffers( nullBuffers );
 
     self->diskBuffer = diskBuffer;
+    self->diskDirect = false;
+
     if( self->diskBuffer )
-        self->diskBuffer->AssignWriteBuffers( self->pinnedBuffer );
+    {
+        auto* diskBucketBuffer = dynamic_cast<DiskBucketBuffer*>( self->diskBuffer );
+
+        // With GPUDirect Storage, the device buffers are written to disk directly
+        if( diskBucketBuffer && diskBucketBuffer->GetDeviceIO() )
+        {
+            PanicIf( self->bufferCount != 2, "GPUDirect Storage requires double-buffered GPU streams." );
+            self->diskDirect = true;
+            self->diskBuffer->AssignWriteBuffers( self->deviceBuffer );
+        }
+        else
+            self->diskBuffer->AssignWriteBuffers( self->pinnedBuffer );
+    }
 }
 
 DiskBufferBase* GpuDownloadBuffer::GetDiskBuffer() const
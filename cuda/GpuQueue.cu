@@ -2,6 +2,8 @@
 #include "util/IAllocator.h"
 #include "plotting/DiskBucketBuffer.h"
 #include "plotting/DiskBuffer.h"
+#include "threading/ThreadAffinity.h"
+#include "util/Trace.h"
 
 ///
 /// Shared GpuStream Inteface
@@ -274,6 +276,68 @@ size_t GpuQueue::CalculateBufferSizeFromDescriptor( const GpuStreamDescriptor& d
     return CalculateSliceSizeFromDescriptor( desc ) * desc.sliceCount;
 }
 
+bool GpuQueue::MeasureTransferBandwidth( GpuTransferBandwidth& outBandwidth, const size_t copySize )
+{
+    const uint32 passCount = 4;
+
+    outBandwidth = {};
+
+    void*        host   = nullptr;
+    void*        dev    = nullptr;
+    cudaStream_t stream = nullptr;
+    cudaEvent_t  start  = nullptr;
+    cudaEvent_t  end    = nullptr;
+
+    const auto measure = [&]( const cudaMemcpyKind kind, double& outBytesPerSec ) -> bool {
+
+        void*       dst = kind == cudaMemcpyHostToDevice ? dev  : host;
+        const void* src = kind == cudaMemcpyHostToDevice ? host : dev;
+
+        // Warm up
+        if( cudaMemcpyAsync( dst, src, copySize, kind, stream ) != cudaSuccess )
+            return false;
+
+        if( cudaEventRecord( start, stream ) != cudaSuccess )
+            return false;
+
+        for( uint32 i = 0; i < passCount; i++ )
+        {
+            if( cudaMemcpyAsync( dst, src, copySize, kind, stream ) != cudaSuccess )
+                return false;
+        }
+
+        if( cudaEventRecord( end, stream ) != cudaSuccess || cudaEventSynchronize( end ) != cudaSuccess )
+            return false;
+
+        float elapsedMS = 0;
+        if( cudaEventElapsedTime( &elapsedMS, start, end ) != cudaSuccess || elapsedMS <= 0 )
+            return false;
+
+        outBytesPerSec = (double)copySize * passCount / ( elapsedMS / 1000.0 );
+        return true;
+    };
+
+    const bool success =
+        cudaMallocHost( &host, copySize, cudaHostAllocDefault ) == cudaSuccess &&
+        cudaMalloc( &dev, copySize ) == cudaSuccess &&
+        cudaStreamCreateWithFlags( &stream, cudaStreamNonBlocking ) == cudaSuccess &&
+        cudaEventCreate( &start ) == cudaSuccess &&
+        cudaEventCreate( &end ) == cudaSuccess &&
+        measure( cudaMemcpyHostToDevice, outBandwidth.h2d ) &&
+        measure( cudaMemcpyDeviceToHost, outBandwidth.d2h );
+
+    if( end    ) cudaEventDestroy( end );
+    if( start  ) cudaEventDestroy( start );
+    if( stream ) cudaStreamDestroy( stream );
+    if( dev    ) cudaFree( dev );
+    if( host   ) cudaFreeHost( host );
+
+    if( !success )
+        outBandwidth = {};
+
+    return success;
+}
+
 void GpuQueue::CopyPendingDownloadStream( void* userData )
 {
     auto* buf = reinterpret_cast<IGpuBuffer*>( userData );
@@ -336,6 +400,8 @@ GpuQueue::Command& GpuQueue::GetCommand( CommandType type )
 void GpuQueue::QueueThreadEntryPoint( GpuQueue* self )
 {
     ASSERT( self );
+    ThreadAffinity::PinCurrentIOThread();
+    BB_TRACE_THREAD_NAME( "GPU queue" );
     self->QueueThreadMain();
     self->_waitForExitSignal.Signal();
 }
@@ -373,6 +439,8 @@ void GpuQueue::ExecuteCommand( const Command& cmd )
 
     if( cmd.type == CommandType::Copy )
     {
+        BB_TRACE_SCOPE( "GpuQueue::Copy" );
+
         auto& cpy = *cmd.copy;
 
         const bool   isSequentialCopy = cpy.dstStride == cpy.srcStride;
@@ -409,6 +477,7 @@ void GpuQueue::ExecuteCommand( const Command& cmd )
     }
     else if( cmd.type == CommandType::Callback )
     {
+        BB_TRACE_SCOPE( "GpuQueue::Callback" );
         cmd.callback.callback( cmd.callback.dstbuffer, cmd.callback.copySize, cmd.callback.userData );
     }
     // else if( cmd.type == CommandType::Sync )
@@ -4,6 +4,7 @@
 #include <functional>
 
 class DiskQueue;
+class DiskBucketBuffer;
 
 struct GpuStreamDescriptor
 {
@@ -20,6 +21,13 @@ struct GpuStreamDescriptor
     bool        directIO;           // If true, direct I/O will be used when using disk offload mode.
 };
 
+/// Measured pinned host<->device copy bandwidth, in bytes per second.
+struct GpuTransferBandwidth
+{
+    double h2d;
+    double d2h;
+};
+
 typedef std::function<void()> GpuCallbackDispath;
 
 class GpuQueue
@@ -142,6 +150,17 @@ public:
 
     inline cudaStream_t GetStream() const { return _stream; }
 
+    /// GPUDirect Storage (cuFile). When enabled on a DiskBucketBuffer, the GPU buffers
+    /// it is assigned to DMA their device buffers directly to and from its file,
+    /// instead of going through their pinned host buffers.
+    /// These return false if cuFile is unavailable (see BB_CUDA_USE_CUFILE), in which case the pinned path is used.
+    static bool InitGpuDirectStorage();
+    static bool EnableGpuDirectStorage( DiskBucketBuffer& buffer, int32 cudaDevice );
+
+    /// Measures pinned host<->device copy bandwidth on the current device, with copies of the given size.
+    /// Returns false if the measurement could not be performed.
+    static bool MeasureTransferBandwidth( GpuTransferBandwidth& outBandwidth, size_t copySize = 64ull << 20 );
+
 protected:
 
     struct IGpuBuffer* CreateGpuBuffer( size_t size, IAllocator& devAllocator, IAllocator& pinnedAllocator, size_t alignment, bool dryRun );
@@ -0,0 +1,161 @@
+#pragma once
+
+///
+/// GPU runtime portability layer.
+/// The GPU code is written against the CUDA runtime API. When building with HIP (BB_HIP_ENABLED),
+/// the subset of the API used by the plotter and the harvester is mapped to its HIP equivalent,
+/// so that the same sources build for AMD GPUs.
+///
+#if BB_HIP_ENABLED
+
+    // Enables __ballot_sync(), __shfl_up_sync(), __syncwarp(), etc.
+    #ifndef HIP_ENABLE_WARP_SYNC_BUILTINS
+        #define HIP_ENABLE_WARP_SYNC_BUILTINS 1
+    #endif
+
+    #include <hip/hip_runtime.h>
+
+    // The kernels assume 32-wide warps
+    #if defined( __HIP_DEVICE_COMPILE__ ) && defined( __AMDGCN_WAVEFRONT_SIZE ) && __AMDGCN_WAVEFRONT_SIZE != 32
+        #error "The GPU kernels require 32-wide wavefronts. Build for wave32 targets (gfx10 and up)."
+    #endif
+
+    // Warp sync builtins take a 64-bit lane mask in HIP
+    #define BBCU_WARP_MASK_ALL 0xFFFFFFFFFFFFFFFFull
+
+    /// Types
+    #define cudaError                                   hipError_t
+    #define cudaError_t                                 hipError_t
+    #define cudaStream_t                                hipStream_t
+    #define cudaEvent_t                                 hipEvent_t
+    #define cudaDeviceProp                              hipDeviceProp_t
+    #define cudaFuncAttributes                          hipFuncAttributes
+    #define cudaMemPool_t                               hipMemPool_t
+    #define cudaMemPoolProps                            hipMemPoolProps
+    #define cudaGraph_t                                 hipGraph_t
+    #define cudaGraphExec_t                             hipGraphExec_t
+    #define cudaGraphNode_t                             hipGraphNode_t
+    #define cudaGraphNodeType                           hipGraphNodeType
+    #define cudaKernelNodeParams                        hipKernelNodeParams
+    #define cudaSharedMemConfig                         hipSharedMemConfig
+    #define cudaTextureObject_t                         hipTextureObject_t
+    #define cudaTextureDesc                             hipTextureDesc
+    #define cudaResourceDesc                            hipResourceDesc
+    #define cudaChannelFormatDesc                       hipChannelFormatDesc
+    #define cudaMemcpyKind                              hipMemcpyKind
+
+    /// Errors
+    #define cudaSuccess                                 hipSuccess
+    #define cudaErrorAlreadyMapped                      hipErrorAlreadyMapped
+    #define cudaErrorInvalidConfiguration               hipErrorInvalidConfiguration
+    #define cudaErrorInvalidDevice                      hipErrorInvalidDevice
+    #define cudaErrorInvalidValue                       hipErrorInvalidValue
+    #define cudaErrorMemoryAllocation                   hipErrorOutOfMemory
+    #define cudaErrorNotReady                           hipErrorNotReady
+    #define cudaErrorNotSupported                       hipErrorNotSupported
+    #define cudaErrorUnknown                            hipErrorUnknown
+    #define cudaGetErrorName                            hipGetErrorName
+    #define cudaGetErrorString                          hipGetErrorString
+    #define cudaGetLastError                            hipGetLastError
+    #define cudaPeekAtLastError                         hipPeekAtLastError
+
+    /// Devices
+    #define cudaGetDevice                               hipGetDevice
+    #define cudaSetDevice                               hipSetDevice
+    #define cudaGetDeviceCount                          hipGetDeviceCount
+    #define cudaGetDeviceProperties                     hipGetDeviceProperties
+    #define cudaDeviceGetAttribute                      hipDeviceGetAttribute
+    #define cudaDeviceGetLimit                          hipDeviceGetLimit
+    #define cudaDeviceSynchronize                       hipDeviceSynchronize
+    #define cudaDevAttrComputeCapabilityMajor           hipDeviceAttributeComputeCapabilityMajor
+    #define cudaDevAttrComputeCapabilityMinor           hipDeviceAttributeComputeCapabilityMinor
+    #define cudaDevAttrCooperativeLaunch                hipDeviceAttributeCooperativeLaunch
+    #define cudaDevAttrMaxGridDimX                      hipDeviceAttributeMaxGridDimX
+    #define cudaDevAttrMaxSharedMemoryPerBlock          hipDeviceAttributeMaxSharedMemoryPerBlock
+    #define cudaDevAttrMemoryPoolsSupported             hipDeviceAttributeMemoryPoolsSupported
+    #define cudaDevAttrMultiProcessorCount              hipDeviceAttributeMultiprocessorCount
+    #define cudaLimitStackSize                          hipLimitStackSize
+    #define cudaSharedMemBankSizeFourByte               hipSharedMemBankSizeFourByte
+    #define cudaSharedMemBankSizeEightByte              hipSharedMemBankSizeEightByte
+    #define cudaFuncGetAttributes                       hipFuncGetAttributes
+    #define cudaOccupancyMaxActiveBlocksPerMultiprocessor hipOccupancyMaxActiveBlocksPerMultiprocessor
+    #define cudaProfilerStart                           hipProfilerStart
+
+    /// Memory
+    #define cudaMalloc                                  hipMalloc
+    #define cudaFree                                    hipFree
+    #define cudaMallocHost                              hipHostMalloc
+    #define cudaFreeHost                                hipHostFree
+    #define cudaHostAllocDefault                        hipHostMallocDefault
+    #define cudaHostRegister                            hipHostRegister
+    #define cudaHostRegisterDefault                     hipHostRegisterDefault
+    #define cudaMemGetInfo                              hipMemGetInfo
+    #define cudaMemset                                  hipMemset
+    #define cudaMemsetAsync                             hipMemsetAsync
+    #define cudaMemcpyAsync                             hipMemcpyAsync
+    #define cudaMemcpy2DAsync                           hipMemcpy2DAsync
+    #define cudaMemcpyToSymbolAsync                     hipMemcpyToSymbolAsync
+    #define cudaMemcpyHostToDevice                      hipMemcpyHostToDevice
+    #define cudaMemcpyDeviceToHost                      hipMemcpyDeviceToHost
+    #define cudaMemcpyDeviceToDevice                    hipMemcpyDeviceToDevice
+    #define cudaMemcpyHostToHost                        hipMemcpyHostToHost
+    #define cudaMemPoolCreate                           hipMemPoolCreate
+    #define cudaMemPoolDestroy                          hipMemPoolDestroy
+    #define cudaMemPoolSetAttribute                     hipMemPoolSetAttribute
+    #define cudaMemPoolAttrReleaseThreshold             hipMemPoolAttrReleaseThreshold
+    #define cudaMemAllocationTypePinned                 hipMemAllocationTypePinned
+    #define cudaMemHandleTypeNone                       hipMemHandleTypeNone
+    #define cudaMemLocationTypeDevice                   hipMemLocationTypeDevice
+    #define cudaMallocFromPoolAsync                     hipMallocFromPoolAsync
+    #define cudaFreeAsync                               hipFreeAsync
+
+    /// Streams & events
+    #define cudaStreamCreateWithFlags                   hipStreamCreateWithFlags
+    #define cudaStreamDestroy                           hipStreamDestroy
+    #define cudaStreamSynchronize                       hipStreamSynchronize
+    #define cudaStreamWaitEvent                         hipStreamWaitEvent
+    #define cudaStreamNonBlocking                       hipStreamNonBlocking
+    #define cudaStreamBeginCapture                      hipStreamBeginCapture
+    #define cudaStreamEndCapture                        hipStreamEndCapture
+    #define cudaStreamCaptureModeThreadLocal            hipStreamCaptureModeThreadLocal
+    #define cudaLaunchHostFunc                          hipLaunchHostFunc
+    #define cudaEventCreate                             hipEventCreate
+    #define cudaEventCreateWithFlags                    hipEventCreateWithFlags
+    #define cudaEventDestroy                            hipEventDestroy
+    #define cudaEventRecord                             hipEventRecord
+    #define cudaEventQuery                              hipEventQuery
+    #define cudaEventSynchronize                        hipEventSynchronize
+    #define cudaEventElapsedTime                        hipEventElapsedTime
+    #define cudaEventDisableTiming                      hipEventDisableTiming
+
+    // HIP has no legacy stream handle, the null stream has the same semantics
+    #define CU_STREAM_LEGACY                            ((hipStream_t)0)
+
+    /// Graphs
+    #define cudaGraphDestroy                            hipGraphDestroy
+    #define cudaGraphExecDestroy                        hipGraphExecDestroy
+    #define cudaGraphGetNodes                           hipGraphGetNodes
+    #define cudaGraphNodeGetType                        hipGraphNodeGetType
+    #define cudaGraphNodeTypeKernel                     hipGraphNodeTypeKernel
+    #define cudaGraphKernelNodeGetParams                hipGraphKernelNodeGetParams
+    #define cudaGraphExecKernelNodeSetParams            hipGraphExecKernelNodeSetParams
+    #define cudaGraphInstantiate                        hipGraphInstantiate
+    #define cudaGraphLaunch                             hipGraphLaunch
+
+    /// Textures
+    #define cudaCreateChannelDesc                       hipCreateChannelDesc
+    #define cudaCreateTextureObject                     hipCreateTextureObject
+    #define cudaDestroyTextureObject                    hipDestroyTextureObject
+    #define cudaResourceTypeLinear                      hipResourceTypeLinear
+    #define cudaReadModeElementType                     hipReadModeElementType
+
+#else
+
+    #include <cuda_runtime.h>
+    #include <cuda.h>
+    #include <device_launch_parameters.h>
+    #include <cuda_profiler_api.h>
+
+    #define BBCU_WARP_MASK_ALL 0xFFFFFFFFu
+
+#endif
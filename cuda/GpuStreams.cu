@@ -122,6 +122,28 @@ void GpuUploadBuffer::UploadArray( const void* hostBuffer, uint32 length, uint32
     DiskBucketBuffer* diskBuffer      = nullptr;
     size_t            totalBufferSize = 0;
 
+    if( self->diskDirect )
+    {
+        // Read from disk straight into the device buffer (GPUDirect Storage).
+        // Unlike the pinned path, this can't be preloaded before the device buffer is released.
+        diskBuffer = static_cast<DiskBucketBuffer*>( self->diskBuffer );
+        ASSERT( self->deviceBuffer[index] == diskBuffer->PeekReadBufferForBucket( self->outgoingSequence-1 ) );
+
+        CudaErrCheck( cudaStreamWaitEvent( uploadStream, self->deviceEvents[index] ) );
+
+        CallHostFunctionOnStream( uploadStream, [=](){
+
+            const uint32 nextReadBucket = diskBuffer->GetNextReadBucketId();
+            diskBuffer->OverrideReadSlices( nextReadBucket, elementSize, counts, countStride );
+            diskBuffer->ReadNextBucket();
+
+            (void)diskBuffer->GetNextReadBuffer();
+        });
+
+        CudaErrCheck( cudaEventRecord( self->readyEvents[index], uploadStream ) );
+        return;
+    }
+
     if( self->diskBuffer )
     {
         diskBuffer = dynamic_cast<DiskBucketBuffer*>( self->diskBuffer );
@@ -330,8 +352,22 @@ void GpuUploadBuffer::AssignDiskBuffer( DiskBufferBase* diskBuffer )
         self->diskBuffer->AssignReadBuffers( nullBuffers );
 
     self->diskBuffer = diskBuffer;
+    self->diskDirect = false;
+
     if( self->diskBuffer )
-        self->diskBuffer->AssignReadBuffers( self->pinnedBuffer );
+    {
+        auto* diskBucketBuffer = dynamic_cast<DiskBucketBuffer*>( self->diskBuffer );
+
+        // With GPUDirect Storage, the device buffers are read into from disk directly
+        if( diskBucketBuffer && diskBucketBuffer->GetDeviceIO() )
+        {
+            PanicIf( self->bufferCount != 2, "GPUDirect Storage requires double-buffered GPU streams." );
+            self->diskDirect = true;
+            self->diskBuffer->AssignReadBuffers( self->deviceBuffer );
+        }
+        else
+            self->diskBuffer->AssignReadBuffers( self->pinnedBuffer );
+    }
 }
 
 DiskBufferBase* GpuUploadBuffer::GetDiskBuffer() const
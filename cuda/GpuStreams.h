@@ -123,6 +123,7 @@ struct IGpuBuffer
 
     GpuQueue*       queue;      // Queue associated with this buffer
     DiskBufferBase* diskBuffer; // DiskBuffer, is any, used when using disk offload mode.
+    bool            diskDirect; // The disk buffer reads/writes the device buffers directly (GPUDirect Storage).
 };
 
 
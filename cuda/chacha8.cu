@@ -117,15 +117,8 @@ __global__ void get_keystream_gpu( const uint32_t* input, uint64_t chachaBlock,
         constexpr uint32 bucketShift = BBCU_K - BBC_BUCKET_BITS;
 
         uint32 offsets[16];
-        // #TODO: Above 128 threads we need to loop to set the others that need to be zeroed out
-        if( id < BBCU_BUCKET_COUNT )
-        {
-            sharedBucketCounts[id] = 0;
-        
-        #if BBCU_BUCKET_COUNT > 128
-            sharedBucketCounts[CHACHA_BLOCKS_PER_CUDA_BLOCK+id] = 0;
-        #endif
-        }
+        for( uint32 b = id; b < BBCU_BUCKET_COUNT; b += blockDim.x )
+            sharedBucketCounts[b] = 0;
 
         // Record local offsets to the shared bucket count
         __syncthreads();
@@ -139,15 +132,8 @@ __global__ void get_keystream_gpu( const uint32_t* input, uint64_t chachaBlock,
         // Store global bucket counts, from the block-shared count,
         // and get the block-wide offsets into the destination bucket slice
         CUDA_ASSERT( gridDim.x >= BBCU_BUCKET_COUNT );
-        if( id < BBCU_BUCKET_COUNT )
-        {
-            sharedBucketCounts[id] = atomicAdd( &gBucketCounts[id], sharedBucketCounts[id] );
-
-            #if BBCU_BUCKET_COUNT > 128
-                const uint32 id2 = CHACHA_BLOCKS_PER_CUDA_BLOCK + id;
-                sharedBucketCounts[id2] = atomicAdd( &gBucketCounts[id2], sharedBucketCounts[id2] );
-            #endif
-        }
+        for( uint32 b = id; b < BBCU_BUCKET_COUNT; b += blockDim.x )
+            sharedBucketCounts[b] = atomicAdd( &gBucketCounts[b], sharedBucketCounts[b] );
 
         __syncthreads();
 
@@ -6,12 +6,16 @@
 #include "CudaF1.h"
 #include "CudaFx.h"
 #include "CudaMatch.h"
+#include "CudaSort.h"
 #include "CudaUtil.h"
+#include "CudaTuning.h"
 #include "CudaPlotContext.h"
-#include "cub/device/device_radix_sort.cuh"
+#include "GpuCub.h"
 #include "ChiaConsts.h"
 #include "plotting/PlotTypes.h"
+#include <mutex>
 
+// Define to log recorded timings on DumpTimings()
 // #define BB_CUDA_HARVEST_USE_TIMINGS 1
 
 namespace {
@@ -25,6 +29,239 @@ namespace {
         NanoSeconds download = NanoSeconds::zero();
         NanoSeconds upload   = NanoSeconds::zero();
     };
+
+    // Group bounds of the tables of a proof during device-side forward propagation.
+    // Tables 2 to 6 are indexed starting from 0.
+    struct FpGroupBounds
+    {
+        uint32 begin     [5][16];   // First entry of each group
+        uint32 end       [5][16];   // One past the last entry of each group
+        uint32 matchCount[5][16];   // Matches made by each group of the previous table
+    };
+
+    ///
+    /// Memory shared by all the threshers of a device.
+    /// Request buffers come from a stream-ordered pool which keeps freed memory cached,
+    /// so that contexts which are not decompressing at the same time share the same VRAM.
+    /// Small pinned host buffers are sub-allocated from shared pinned blocks.
+    ///
+    class CudaThresherDevicePool
+    {
+    public:
+        static CudaThresherDevicePool* Acquire( int deviceId );
+        static void Release( CudaThresherDevicePool* pool );
+
+        // nullptr if the device does not support memory pools
+        inline cudaMemPool_t MemPool() const { return _memPool; }
+
+        cudaError_t AllocPinned( void*& outPtr, size_t size );
+        void        FreePinned( void* ptr, size_t size );
+
+    private:
+        static constexpr size_t PINNED_BLOCK_SIZE = 64 * 1024;
+        static constexpr size_t PINNED_ALIGNMENT  = 64;
+
+        int           _deviceId = 0;
+        uint32        _refCount = 0;
+        cudaMemPool_t _memPool  = nullptr;
+
+        std::mutex                           _pinnedLock;
+        std::vector<void*>                   _pinnedBlocks;
+        std::vector<std::pair<void*,size_t>> _pinnedFree;
+        byte*                                _pinnedPos  = nullptr;
+        size_t                               _pinnedLeft = 0;
+
+        static std::mutex                           _poolsLock;
+        static std::vector<CudaThresherDevicePool*> _pools;
+    };
+
+    std::mutex                           CudaThresherDevicePool::_poolsLock;
+    std::vector<CudaThresherDevicePool*> CudaThresherDevicePool::_pools;
+
+    //-----------------------------------------------------------
+    CudaThresherDevicePool* CudaThresherDevicePool::Acquire( const int deviceId )
+    {
+        std::lock_guard<std::mutex> lock( _poolsLock );
+
+        for( auto* pool : _pools )
+        {
+            if( pool->_deviceId == deviceId )
+            {
+                pool->_refCount++;
+                return pool;
+            }
+        }
+
+        cudaMemPool_t memPool = nullptr;
+
+        int poolsSupported = 0;
+        if( cudaDeviceGetAttribute( &poolsSupported, cudaDevAttrMemoryPoolsSupported, deviceId ) == cudaSuccess && poolsSupported )
+        {
+            cudaMemPoolProps props = {};
+            props.allocType     = cudaMemAllocationTypePinned;
+            props.handleTypes   = cudaMemHandleTypeNone;
+            props.location.type = cudaMemLocationTypeDevice;
+            props.location.id   = deviceId;
+
+            if( cudaMemPoolCreate( &memPool, &props ) != cudaSuccess )
+                return nullptr;
+
+            // Keep freed memory in the pool, instead of giving it back to the device on every synchronization
+            cuuint64_t releaseThreshold = UINT64_MAX;
+            if( cudaMemPoolSetAttribute( memPool, cudaMemPoolAttrReleaseThreshold, &releaseThreshold ) != cudaSuccess )
+            {
+                cudaMemPoolDestroy( memPool );
+                return nullptr;
+            }
+        }
+
+        auto* pool = new CudaThresherDevicePool();
+        pool->_deviceId = deviceId;
+        pool->_refCount = 1;
+        pool->_memPool  = memPool;
+
+        _pools.push_back( pool );
+        return pool;
+    }
+
+    //-----------------------------------------------------------
+    void CudaThresherDevicePool::Release( CudaThresherDevicePool* pool )
+    {
+        std::lock_guard<std::mutex> lock( _poolsLock );
+        ASSERT( pool->_refCount > 0 );
+
+        if( --pool->_refCount > 0 )
+            return;
+
+        _pools.erase( std::find( _pools.begin(), _pools.end(), pool ) );
+
+        if( pool->_memPool )
+            cudaMemPoolDestroy( pool->_memPool );
+
+        for( void* block : pool->_pinnedBlocks )
+            cudaFreeHost( block );
+
+        delete pool;
+    }
+
+    //-----------------------------------------------------------
+    cudaError_t CudaThresherDevicePool::AllocPinned( void*& outPtr, size_t size )
+    {
+        size = RoundUpToNextBoundary( size, PINNED_ALIGNMENT );
+
+        std::lock_guard<std::mutex> lock( _pinnedLock );
+
+        for( size_t i = 0; i < _pinnedFree.size(); i++ )
+        {
+            if( _pinnedFree[i].second == size )
+            {
+                outPtr = _pinnedFree[i].first;
+                _pinnedFree.erase( _pinnedFree.begin() + (ptrdiff_t)i );
+                return cudaSuccess;
+            }
+        }
+
+        if( _pinnedLeft < size )
+        {
+            const size_t blockSize = std::max( size, PINNED_BLOCK_SIZE );
+
+            void* block = nullptr;
+            const cudaError_t cErr = cudaMallocHost( &block, blockSize, cudaHostAllocDefault );
+            if( cErr != cudaSuccess )
+                return cErr;
+
+            _pinnedBlocks.push_back( block );
+            _pinnedPos  = (byte*)block;
+            _pinnedLeft = blockSize;
+        }
+
+        outPtr       = _pinnedPos;
+        _pinnedPos  += size;
+        _pinnedLeft -= size;
+
+        return cudaSuccess;
+    }
+
+    //-----------------------------------------------------------
+    void CudaThresherDevicePool::FreePinned( void* ptr, const size_t size )
+    {
+        if( !ptr )
+            return;
+
+        std::lock_guard<std::mutex> lock( _pinnedLock );
+        _pinnedFree.push_back( { ptr, RoundUpToNextBoundary( size, PINNED_ALIGNMENT ) } );
+    }
+}
+
+//-----------------------------------------------------------
+template<typename T>
+__global__ void SortGroupsByKeyKernel( const uint32* gGroupBegin, const uint32* gGroupEnd, const uint32* key, const T* input, T* output )
+{
+    const uint32 idx = gGroupBegin[blockIdx.y] + blockIdx.x * blockDim.x + threadIdx.x;
+    if( idx >= gGroupEnd[blockIdx.y] )
+        return;
+
+    output[idx] = input[key[idx]];
+}
+
+/// Traces back the proof x's from each of tables 3 to 6 (one per block), the same way BacktraceProof() does.
+/// The host then picks the one from the table where the proof was found.
+//-----------------------------------------------------------
+__global__ void BacktraceProofsKernel(
+          Pair*          gOutProofs,
+    const FpGroupBounds* gBounds,
+    const Pair*          unsortedPairs,
+    const Pair*          sortedPairs,
+    const uint32         tableCapacity )
+{
+    const uint32 tableStart = (uint32)TableId::Table3 + blockIdx.x;
+
+    Pair _backtrace[2][64];
+
+    Pair* backTraceIn  = _backtrace[0];
+    Pair* backTraceOut = _backtrace[1];
+
+    // Fill initial back-trace with the table's entries, in group order
+    {
+        const uint32 t          = tableStart - 1;
+        const uint32 groupCount = 32 >> tableStart;
+        const Pair*  pairs      = unsortedPairs + (size_t)t * tableCapacity;
+
+        uint32 length = 0;
+        for( uint32 g = 0; g < groupCount; g++ )
+        {
+            const uint32 end = min( gBounds->end[t][g], gBounds->begin[t][g] + tableCapacity / groupCount );
+
+            for( uint32 i = gBounds->begin[t][g]; i < end && length < 64; i++ )
+                backTraceIn[length++] = pairs[i];
+        }
+
+        for( ; length < 64; length++ )
+            backTraceIn[length] = {};
+    }
+
+    for( uint32 table = tableStart; table > (uint32)TableId::Table2; table-- )
+    {
+        const uint32 entryCount = (32 >> table)*2;
+        const Pair*  lPairs     = sortedPairs + (size_t)(table-2) * tableCapacity;
+
+        for( uint32 i = 0; i < entryCount; i++ )
+        {
+            const Pair p = backTraceIn[i];
+
+            // Only out of range if the proof is not in this table
+            const uint32 idx = i * 2;
+            backTraceOut[idx+0] = lPairs[min( p.left , tableCapacity-1 )];
+            backTraceOut[idx+1] = lPairs[min( p.right, tableCapacity-1 )];
+        }
+
+        Pair* tmp    = backTraceIn;
+        backTraceIn  = backTraceOut;
+        backTraceOut = tmp;
+    }
+
+    for( uint32 i = 0; i < GR_POST_PROOF_CMP_X_COUNT; i++ )
+        gOutProofs[blockIdx.x * GR_POST_PROOF_CMP_X_COUNT + i] = backTraceIn[i];
 }
 
 class CudaThresher : public IThresher
@@ -35,7 +272,10 @@ class CudaThresher : public IThresher
     bool      _isDecompressing = false;             // Are we currently decompressing a proof?
     TableId   _currentTable    = TableId::Table1;   // Current table being decompressed
     
-    uint32    _maxCompressionLevel = 0; // Max compression level for which we have allocated buffers
+    uint32    _maxCompressionLevel     = 0; // Compression level for which we currently hold buffers
+    uint32    _requestCompressionLevel = 0; // Compression level to hold buffers for during the current request
+
+    CudaThresherDevicePool* _pool = nullptr;
 
     size_t    _bufferCapacity = 0;
     size_t    _matchCapacity  = 0;
@@ -57,7 +297,6 @@ class CudaThresher : public IThresher
     uint32*   _devXBufferTmp    = nullptr;
 
     uint32*   _devSortKey       = nullptr;
-    uint32*   _devSortKeyTmp    = nullptr;
 
     // Fx
     Pair*     _devMatchesIn     = nullptr;
@@ -69,6 +308,27 @@ class CudaThresher : public IThresher
 
     uint32*   _devMatchCount    = nullptr;
 
+    // Device-side forward propagation of tables 3-6.
+    // Each table gets a slot of _fpTableCapacity entries, split evenly between its groups.
+    uint32         _fpTableCapacity    = 0;
+    size_t         _fpSortBufferSize   = 0;
+
+    FpGroupBounds* _hostFpBounds       = nullptr;
+    Pair*          _hostFpProofs       = nullptr;
+
+    FpGroupBounds* _devFpBounds        = nullptr;
+    Pair*          _devFpProofs        = nullptr;   // Proof candidates from each of tables 3-6
+    Pair*          _devFpPairs         = nullptr;   // Unsorted pairs, per table
+    Pair*          _devFpPairsSorted   = nullptr;   // Pairs sorted on y, per table
+    Pair*          _devFpMatches       = nullptr;   // Matches of each L group, before fx
+    uint64*        _devFpY             = nullptr;
+    uint64*        _devFpYSorted       = nullptr;
+    byte*          _devFpMeta          = nullptr;
+    byte*          _devFpMetaSorted    = nullptr;
+    uint32*        _devFpSortKey       = nullptr;
+    uint32*        _devFpSortKeyTmp    = nullptr;
+    byte*          _devFpSortTmpBuffer = nullptr;
+
     // Temporary sorted buffers
     // Pair*   _devMatchesSorted = nullptr;
     // uint64* _devYSorted       = nullptr;
@@ -86,7 +346,8 @@ class CudaThresher : public IThresher
 
     CudaPlotInfo _info;
 
-    Timings      _timings = {};
+    Timings      _timings       = {};
+    bool         _recordTimings = false;    // Record per-stage timings. Adds stream synchronization between stages.
 
 public:
     CudaThresher( const GreenReaperConfig& config, int deviceId )
@@ -105,22 +366,128 @@ public:
         if( maxCompressionLevel > 7 )
             return false;
 
-        // #NOTE: For now we always preallocate for the maximum compression level
-        maxCompressionLevel = 7;
+        if( !_pool && CreateDeviceObjects() != cudaSuccess )
+        {
+            ReleaseBuffers();
+            return false;
+        }
 
-        if( _maxCompressionLevel >= maxCompressionLevel )
-            return true;
-    
-        _info.k              = 32;
-        _info.bucketCount    = 64;                          // #TODO: Make this configurable
-        _info.yBits          = _info.k + kExtraBits;
-        _info.bucketBits     = bblog2( _info.bucketCount );
+        // Request buffers are sized for the level actually requested
+        _requestCompressionLevel = maxCompressionLevel;
+
+        if( AcquireRequestBuffers() != cudaSuccess )
+        {
+            ReleaseRequestBuffers();
+            return false;
+        }
+
+        return true;
+    }
+
+    void ReleaseBuffers() override
+    {
+        if( !_pool )
+            return;
+
+        cudaSetDevice( _deviceId );
+
+        ReleaseRequestBuffers();
+        _requestCompressionLevel = 0;
+
+        if( _computeStream )
+            cudaStreamSynchronize( _computeStream );
+
+        _pool->FreePinned( _hostMatchCount, sizeof( uint32 ) );
+        _pool->FreePinned( _hostFpBounds  , sizeof( FpGroupBounds ) );
+        _pool->FreePinned( _hostFpProofs  , sizeof( Pair ) * GR_POST_PROOF_CMP_X_COUNT * 4 );
+        _hostMatchCount = nullptr;
+        _hostFpBounds   = nullptr;
+        _hostFpProofs   = nullptr;
+
+        // CUDA objects
+        if( _computeStream  ) cudaStreamDestroy( _computeStream  ); _computeStream  = nullptr;
+        if( _uploadStream   ) cudaStreamDestroy( _uploadStream   ); _uploadStream   = nullptr;
+        if( _downloadStream ) cudaStreamDestroy( _downloadStream ); _downloadStream = nullptr;
+
+        if( _computeEvent )  cudaEventDestroy( _computeEvent );  _computeEvent  = nullptr;
+        if( _uploadEvent )   cudaEventDestroy( _uploadEvent );   _uploadEvent   = nullptr;
+        if( _downloadEvent ) cudaEventDestroy( _downloadEvent ); _downloadEvent = nullptr;
+
+        CudaThresherDevicePool::Release( _pool );
+        _pool = nullptr;
+    }
+
+    void EndRequest() override
+    {
+        // Let other threshers on this device use the memory until our next request
+        if( _pool )
+        {
+            cudaSetDevice( _deviceId );
+            ReleaseRequestBuffers();
+        }
+    }
+
+private:
+    /// Creates the objects that live as long as the thresher: streams, events and small pinned buffers.
+    cudaError_t CreateDeviceObjects()
+    {
+        cudaError_t cErr = cudaSetDevice( _deviceId );
+        if( cErr != cudaSuccess )
+            return cErr;
+
+        _pool = CudaThresherDevicePool::Acquire( _deviceId );
+        if( !_pool )
+            return cudaErrorMemoryAllocation;
+
+        _info.k           = 32;
+        _info.bucketCount = 64;                          // #TODO: Make this configurable
+        _info.yBits       = _info.k + kExtraBits;
+        _info.bucketBits  = bblog2( _info.bucketCount );
+
+        #define CuFailCheck() if( cErr != cudaSuccess ) return cErr
+
+        /// Host pinned allocations
+        cErr = _pool->AllocPinned( (void*&)_hostMatchCount, sizeof( uint32 ) ); CuFailCheck();
+        cErr = _pool->AllocPinned( (void*&)_hostFpBounds  , sizeof( FpGroupBounds ) ); CuFailCheck();
+        cErr = _pool->AllocPinned( (void*&)_hostFpProofs  , sizeof( Pair ) * GR_POST_PROOF_CMP_X_COUNT * 4 ); CuFailCheck();
+
+        // CUDA objects
+        // Non-blocking, so that the streams of the other threshers on the device can run concurrently
+        cErr = cudaStreamCreateWithFlags( &_computeStream , cudaStreamNonBlocking ); CuFailCheck();
+        cErr = cudaStreamCreateWithFlags( &_uploadStream  , cudaStreamNonBlocking ); CuFailCheck();
+        cErr = cudaStreamCreateWithFlags( &_downloadStream, cudaStreamNonBlocking ); CuFailCheck();
+
+        cErr = cudaEventCreate( &_computeEvent  ); CuFailCheck();
+        cErr = cudaEventCreate( &_uploadEvent   ); CuFailCheck();
+        cErr = cudaEventCreate( &_downloadEvent ); CuFailCheck();
+
+        #undef CuFailCheck
+        return cudaSuccess;
+    }
+
+    /// Allocates the device buffers for the current request's compression level from the device pool,
+    /// unless we already hold large enough ones. These are handed back to the pool in EndRequest().
+    cudaError_t AcquireRequestBuffers()
+    {
+        ASSERT( _pool );
+        ASSERT( _requestCompressionLevel > 0 );
+
+        cudaError_t cErr = cudaSetDevice( _deviceId );
+        if( cErr != cudaSuccess )
+            return cErr;
+
+        if( _maxCompressionLevel >= _requestCompressionLevel )
+            return cudaSuccess;
+
+        ReleaseRequestBuffers();
+
+        const uint32 k = _info.k;
 
         // #TODO: Needs to be configured per k
         //const uint64 kTableEntryCount  = 1ull << k;
         const uint32 entriesPerF1Block   = kF1BlockSizeBits / k;
 
-        const uint64 allocEntryCountBase = GetEntriesPerBucketForCompressionLevel( k, maxCompressionLevel );
+        const uint64 allocEntryCountBase = GetEntriesPerBucketForCompressionLevel( k, _requestCompressionLevel );
         const uint64 bucketCapcity       = (allocEntryCountBase / _info.bucketCount + ( 4096 )) * 2;
         const uint64 allocEntryCount     = RoundUpToNextBoundary( bucketCapcity * _info.bucketCount, entriesPerF1Block );
 
@@ -134,114 +501,147 @@ public:
 
         ASSERT( _info.sliceCapacity * _info.bucketCount == _info.bucketCapacity );
 
-
-        ////    cuda.info.sliceCapacity     = cuda.info.bucketCapacity / cuda.info.bucketCount;
-        ////    cuda.info.metaMaxSizeBytes;
-        //    // context.cuda.bufferCapacity =
-
         // Allocate CUDA buffers
-        cudaError cErr = cudaSuccess;
         {
-            #define CuFailCheck()  if( cErr != cudaSuccess ) goto FAIL
-
-            /// Host pinned allocations
-            cErr = cudaMallocHost( &_hostMatchCount, sizeof( uint32 ), cudaHostAllocDefault ); CuFailCheck();
-            // cErr = cudaMallocHost( &_hostBucketCounts, _info.bucketCount * sizeof( uint32 ), cudaHostAllocDefault ); CuFailCheck();
+            #define CuFailCheck() if( cErr != cudaSuccess ) return cErr
 
-            /// Cuda allocations
-            _sortBufferSize = 0;
-            cErr = cub::DeviceRadixSort::SortPairs<uint64, uint32>( nullptr, _sortBufferSize, nullptr, nullptr, nullptr, nullptr, allocEntryCount ); CuFailCheck();
+            _sortBufferSize = CudaRadixSortTempSize<uint64>( (uint32)allocEntryCount );
             ASSERT( _sortBufferSize );
 
-            cErr = cudaMalloc( &_devSortTmpBuffer, _sortBufferSize ); CuFailCheck();
-            // cErr = cudaMalloc( &_devBucketCounts , _info.bucketCount * sizeof( uint32 ) ); CuFailCheck();
-            cErr = CudaCallocT( _devChaChaInput, 32 ); CuFailCheck();
+            cErr = PoolAllocT( _devSortTmpBuffer, _sortBufferSize ); CuFailCheck();
+            cErr = PoolAllocT( _devChaChaInput, 32 ); CuFailCheck();
 
-            cErr = CudaCallocT( _devYBufferF1 , allocEntryCount ); CuFailCheck();
-            cErr = CudaCallocT( _devYBufferIn , allocEntryCount ); CuFailCheck();
-            cErr = CudaCallocT( _devYBufferOut, allocEntryCount ); CuFailCheck();
-            cErr = CudaCallocT( _devXBuffer   , allocEntryCount ); CuFailCheck();
-            cErr = CudaCallocT( _devXBufferTmp, allocEntryCount ); CuFailCheck();
+            cErr = PoolAllocT( _devYBufferF1 , allocEntryCount ); CuFailCheck();
+            cErr = PoolAllocT( _devYBufferIn , allocEntryCount ); CuFailCheck();
+            cErr = PoolAllocT( _devYBufferOut, allocEntryCount ); CuFailCheck();
+            cErr = PoolAllocT( _devXBuffer   , allocEntryCount ); CuFailCheck();
+            cErr = PoolAllocT( _devXBufferTmp, allocEntryCount ); CuFailCheck();
 
 
-            const uint64 maxPairsPerTable = std::max( (uint64)GR_MIN_TABLE_PAIRS, GetMaxTablePairsForCompressionLevel( k, maxCompressionLevel ) );
+            const uint64 maxPairsPerTable = std::max( (uint64)GR_MIN_TABLE_PAIRS, GetMaxTablePairsForCompressionLevel( k, _requestCompressionLevel ) );
             _matchCapacity = (size_t)maxPairsPerTable;
 
-            cErr = CudaCallocT( _devMatchCount, 1 ); CuFailCheck();
+            cErr = PoolAllocT( _devMatchCount, 1 ); CuFailCheck();
 
-            cErr = CudaCallocT( _devMatchesIn,  maxPairsPerTable ); CuFailCheck();
-            cErr = CudaCallocT( _devMatchesOut, maxPairsPerTable ); CuFailCheck();
+            cErr = PoolAllocT( _devMatchesIn,  maxPairsPerTable ); CuFailCheck();
+            cErr = PoolAllocT( _devMatchesOut, maxPairsPerTable ); CuFailCheck();
 
-            cErr = CudaCallocT( _devMetaBufferIn , maxPairsPerTable * sizeof( uint32 ) * 4 ); CuFailCheck();
-            cErr = CudaCallocT( _devMetaBufferOut, maxPairsPerTable * sizeof( uint32 ) * 4 ); CuFailCheck();
+            cErr = PoolAllocT( _devMetaBufferIn , maxPairsPerTable * sizeof( uint32 ) * 4 ); CuFailCheck();
+            cErr = PoolAllocT( _devMetaBufferOut, maxPairsPerTable * sizeof( uint32 ) * 4 ); CuFailCheck();
 
-            cErr = CudaCallocT( _devSortKey   , maxPairsPerTable ); CuFailCheck();
-            cErr = CudaCallocT( _devSortKeyTmp, maxPairsPerTable ); CuFailCheck();
-            
+            cErr = PoolAllocT( _devSortKey   , maxPairsPerTable ); CuFailCheck();
+
+            // Device-side forward propagation. Groups of tables > 2 get a fixed share of the table,
+            // so give them some headroom over the host tables, which are compacted.
+            _fpTableCapacity = (uint32)RoundUpToNextBoundary( maxPairsPerTable * 2, 64 );
 
-            // Sorted temp buffers
-            // cErr = cudaMalloc( &_devMatchesSorted, maxPairsPerTable * sizeof( Pair ) ); CuFailCheck();
-            // cErr = cudaMalloc( &_devYSorted      , maxPairsPerTable * sizeof( uint64 ) ); CuFailCheck();
-            // cErr = cudaMalloc( &_devMetaSorted   , maxPairsPerTable * sizeof( uint32 )*4 ); CuFailCheck();
+            const uint32 fpTableCount = 5;
+            const size_t fpPairCount  = (size_t)_fpTableCapacity * fpTableCount;
 
-            // CUDA objects
-            cErr = cudaStreamCreate( &_computeStream  ); CuFailCheck();
-            cErr = cudaStreamCreate( &_uploadStream   ); CuFailCheck();
-            cErr = cudaStreamCreate( &_downloadStream ); CuFailCheck();
+            _fpSortBufferSize = 0;
+            cErr = cub::DeviceSegmentedRadixSort::SortPairs<uint64, uint32>( nullptr, _fpSortBufferSize, nullptr, nullptr, nullptr, nullptr,
+                                                                             (int)_fpTableCapacity, 16, (uint32*)nullptr, (uint32*)nullptr ); CuFailCheck();
 
-            cErr = cudaEventCreate( &_computeEvent  ); CuFailCheck();
-            cErr = cudaEventCreate( &_uploadEvent   ); CuFailCheck();
-            cErr = cudaEventCreate( &_downloadEvent ); CuFailCheck();
+            cErr = PoolAllocT( _devFpBounds       , 1 ); CuFailCheck();
+            cErr = PoolAllocT( _devFpProofs       , GR_POST_PROOF_CMP_X_COUNT * 4 ); CuFailCheck();
+            cErr = PoolAllocT( _devFpPairs        , fpPairCount ); CuFailCheck();
+            cErr = PoolAllocT( _devFpPairsSorted  , fpPairCount ); CuFailCheck();
+            cErr = PoolAllocT( _devFpMatches      , _fpTableCapacity ); CuFailCheck();
+            cErr = PoolAllocT( _devFpY            , _fpTableCapacity ); CuFailCheck();
+            cErr = PoolAllocT( _devFpYSorted      , _fpTableCapacity ); CuFailCheck();
+            cErr = PoolAllocT( _devFpMeta         , _fpTableCapacity * sizeof( uint32 ) * 4 ); CuFailCheck();
+            cErr = PoolAllocT( _devFpMetaSorted   , _fpTableCapacity * sizeof( uint32 ) * 4 ); CuFailCheck();
+            cErr = PoolAllocT( _devFpSortKey      , _fpTableCapacity ); CuFailCheck();
+            cErr = PoolAllocT( _devFpSortKeyTmp   , _fpTableCapacity ); CuFailCheck();
+            cErr = PoolAllocT( _devFpSortTmpBuffer, _fpSortBufferSize ); CuFailCheck();
 
             #undef CuFailCheck
         }
 
-        //cErr = cudaMalloc( &cuda.devYBufferF1, sizeof( uint32 ) * allocEntryCount );
-        _maxCompressionLevel = maxCompressionLevel;
-        return true;
+        // The allocations are ordered on the compute stream, but the other streams use them too
+        cErr = cudaStreamSynchronize( _computeStream );
+        if( cErr != cudaSuccess )
+            return cErr;
 
-    FAIL:
-        ReleaseBuffers();
-        return false;
+        _maxCompressionLevel = _requestCompressionLevel;
+        return cudaSuccess;
     }
 
-    void ReleaseBuffers() override
+    /// Hands the device buffers back to the device pool.
+    /// The frees are ordered after all work queued so far on the compute stream,
+    /// which waits on the other streams before it uses their results.
+    void ReleaseRequestBuffers()
     {
         _bufferCapacity      = 0;
+        _matchCapacity       = 0;
+        _fpTableCapacity     = 0;
         _maxCompressionLevel = 0;
 
-        // Release all buffers
-        CudaSafeFreeHost( _hostMatchCount );
-
-        CudaSafeFree( _devSortTmpBuffer );
-        CudaSafeFree( _devChaChaInput );
+        PoolFree( _devSortTmpBuffer );
+        PoolFree( _devChaChaInput );
+
+        PoolFree( _devYBufferF1  );
+        PoolFree( _devYBufferIn  );
+        PoolFree( _devYBufferOut );
+        PoolFree( _devXBuffer    );
+        PoolFree( _devXBufferTmp );
+
+        PoolFree( _devMatchCount );
+        PoolFree( _devMatchesIn );
+        PoolFree( _devMatchesOut );
+
+        PoolFree( _devMetaBufferIn );
+        PoolFree( _devMetaBufferOut );
+
+        PoolFree( _devSortKey    );
+
+        PoolFree( _devFpBounds        );
+        PoolFree( _devFpProofs        );
+        PoolFree( _devFpPairs         );
+        PoolFree( _devFpPairsSorted   );
+        PoolFree( _devFpMatches       );
+        PoolFree( _devFpY             );
+        PoolFree( _devFpYSorted       );
+        PoolFree( _devFpMeta          );
+        PoolFree( _devFpMetaSorted    );
+        PoolFree( _devFpSortKey       );
+        PoolFree( _devFpSortKeyTmp    );
+        PoolFree( _devFpSortTmpBuffer );
+    }
 
-        CudaSafeFree( _devYBufferF1  );
-        CudaSafeFree( _devYBufferIn  );
-        CudaSafeFree( _devYBufferOut );
-        CudaSafeFree( _devXBuffer    );
-        CudaSafeFree( _devXBufferTmp );
+    template<typename T>
+    inline cudaError_t PoolAllocT( T*& ptr, const size_t count )
+    {
+        if( _pool->MemPool() )
+            return cudaMallocFromPoolAsync( (void**)&ptr, count * sizeof( T ), _pool->MemPool(), _computeStream );
 
-        CudaSafeFree( _devMatchCount );
-        CudaSafeFree( _devMatchesIn );
-        CudaSafeFree( _devMatchesOut );
+        return cudaMalloc( (void**)&ptr, count * sizeof( T ) );
+    }
 
-        CudaSafeFree( _devMetaBufferIn );
-        CudaSafeFree( _devMetaBufferOut );
+    template<typename T>
+    inline void PoolFree( T*& ptr )
+    {
+        if( !ptr )
+            return;
 
-        CudaSafeFree( _devSortKey    );
-        CudaSafeFree( _devSortKeyTmp );
+        if( _pool->MemPool() )
+            cudaFreeAsync( (void*)ptr, _computeStream );
+        else
+            cudaFree( (void*)ptr );
 
-        // CUDA objects
-        if( _computeStream ) cudaStreamDestroy( _computeStream ); _computeStream = nullptr;
-        if( _uploadStream )  cudaStreamDestroy( _uploadStream );  _uploadStream  = nullptr;
-        if( _computeStream ) cudaStreamDestroy( _computeStream ); _computeStream = nullptr;
+        ptr = nullptr;
+    }
 
-        if( _computeEvent )  cudaEventDestroy( _computeEvent );  _computeEvent  = nullptr;
-        if( _uploadEvent )   cudaEventDestroy( _uploadEvent );   _uploadEvent   = nullptr;
-        if( _downloadEvent ) cudaEventDestroy( _downloadEvent ); _downloadEvent = nullptr;
+    static ThresherResult CudaErrorResult( const cudaError_t cErr )
+    {
+        ThresherResult result{};
+        result.kind          = ThresherResultKind::Error;
+        result.error         = ThresherError::CudaError;
+        result.internalError = (i32)cErr;
+        return result;
     }
 
+public:
     ThresherResult DecompressInitialTable( 
         GreenReaperContext& cx,
         const byte   plotId[32],
@@ -255,11 +655,17 @@ public:
         // Only k32 for now
         ASSERT( x0 <= 0xFFFFFFFF );
         ASSERT( x1 <= 0xFFFFFFFF );
-        ASSERT( entryCountPerX*2 < _bufferCapacity );
 
         ThresherResult result{};
         result.kind = ThresherResultKind::Success; 
 
+        // Our buffers may have been handed back to the device pool after the previous request
+        {
+            const cudaError_t cErr = AcquireRequestBuffers();
+            if( cErr != cudaSuccess )
+                return CudaErrorResult( cErr );
+        }
+
         if( entryCountPerX*2 > _bufferCapacity )
         {
             result.kind  = ThresherResultKind::Error;
@@ -270,7 +676,8 @@ public:
         uint64    table1EntryCount = 0;
         cudaError cErr             = cudaSuccess;
 
-        // Ensure we're in a good state
+        // Ensure we're in a good state. The caller's thread may not have our device selected.
+        cErr = cudaSetDevice( _deviceId ); if( cErr != cudaSuccess ) goto FAIL;
         cErr = cudaStreamSynchronize( _computeStream ); if( cErr != cudaSuccess ) goto FAIL;
         cErr = cudaStreamSynchronize( _downloadStream ); if( cErr  != cudaSuccess ) goto FAIL;
 
@@ -312,9 +719,7 @@ public:
 
             // Setup initial data
             {
-                #if BB_CUDA_HARVEST_USE_TIMINGS
-                    const auto timer = TimerBegin();
-                #endif
+                const auto timer = TimerBegin();
 
                 uint64* f1Y = _devYBufferF1;
                 uint32* f1X = _devXBufferTmp;
@@ -342,45 +747,43 @@ public:
                 cErr = cudaStreamSynchronize( _computeStream );
                 if( cErr != cudaSuccess ) goto FAIL;
 
-                #if BB_CUDA_HARVEST_USE_TIMINGS
+                if( _recordTimings )
+                {
                     _timings.f1 += TimerEndTicks( timer );
-                #endif
+                }
             }
 
 
 
             // Sort entries on Y
             {
-                #if BB_CUDA_HARVEST_USE_TIMINGS
-                    const auto timer = TimerBegin();
-                #endif
+                const auto timer = TimerBegin();
 
                 const uint64 entriesPerChaChaBlock = kF1BlockSize / sizeof( uint32 );
                 const uint64 f1EntryCount          = f1BlocksToCompute * entriesPerChaChaBlock * f1Iterations;
                 table1EntryCount = f1EntryCount;
 
-                cErr = cub::DeviceRadixSort::SortPairs<uint64, uint32>(
+                cErr = CudaRadixSortPairs<uint64>(
                     _devSortTmpBuffer, _sortBufferSize,
                     _devYBufferF1,  _devYBufferIn,
                     _devXBufferTmp, _devXBuffer,
-                    f1EntryCount, 0, _info.k+kExtraBits,
+                    (uint32)f1EntryCount, 0, _info.k+kExtraBits,
                     _computeStream );
                 if( cErr != cudaSuccess ) goto FAIL;
 
                 cErr = cudaStreamSynchronize( _computeStream );
                 if( cErr != cudaSuccess ) goto FAIL;
 
-                #if BB_CUDA_HARVEST_USE_TIMINGS
+                if( _recordTimings )
+                {
                     _timings.sort += TimerEndTicks( timer );
-                #endif
+                }
             }
         }
 
         // Perform T2 matches
         {
-            #if BB_CUDA_HARVEST_USE_TIMINGS
-                auto timer = TimerBegin();
-            #endif
+            auto timer = TimerBegin();
 
             cErr = CudaHarvestMatchK32(
                     _devMatchesOut,
@@ -401,10 +804,11 @@ public:
 
             const uint32 matchCount = *_hostMatchCount;
 
-            #if BB_CUDA_HARVEST_USE_TIMINGS
+            if( _recordTimings )
+            {
                 _timings.match += TimerEndTicks( timer );
                 timer = TimerBegin();
-            #endif
+            }
 
             if( matchCount < 1 )
             {
@@ -423,11 +827,12 @@ public:
                 _devXBuffer,
                 _computeStream );
 
-            #if BB_CUDA_HARVEST_USE_TIMINGS
-                cErr = cudaStreamSynchronize( _computeStream );
+            if( _recordTimings )
+            {
+                cErr = cudaStreamSynchronize( _computeStream ); if( cErr != cudaSuccess ) goto FAIL;
                 _timings.fx += TimerEndTicks( timer );
                 timer = TimerBegin();
-            #endif
+            }
 
             // Inline x's into pairs
             CudaK32InlineXsIntoPairs(
@@ -437,11 +842,12 @@ public:
                 _devXBuffer,
                 _computeStream );
 
-            #if BB_CUDA_HARVEST_USE_TIMINGS
-                cErr = cudaStreamSynchronize( _computeStream );
+            if( _recordTimings )
+            {
+                cErr = cudaStreamSynchronize( _computeStream ); if( cErr != cudaSuccess ) goto FAIL;
                 _timings.inlineX += TimerEndTicks( timer );
                 timer = TimerBegin();
-            #endif
+            }
 
             // Sync download stream w/ compute stream
             // #TODO: Use pinned
@@ -468,9 +874,10 @@ public:
 
             outMatchCount = matchCount;
 
-            #if BB_CUDA_HARVEST_USE_TIMINGS
+            if( _recordTimings )
+            {
                 _timings.download += TimerEndTicks( timer );
-            #endif
+            }
 
             if( matchCount < 1 )
             {
@@ -514,21 +921,28 @@ public:
         ThresherResult result{};
         result.kind = ThresherResultKind::Success; 
 
+        {
+            const cudaError_t cErr = AcquireRequestBuffers();
+            if( cErr != cudaSuccess )
+                return CudaErrorResult( cErr );
+        }
+
         cudaError_t cErr = cudaSuccess;
 
         const size_t inMetaMultiplier = GetTableMetaMultiplier( table - 1 );
         const size_t inMetaByteSize   = CDiv( _info.k * inMetaMultiplier, 8 );
         uint32 matchCount = 0;
 
+        auto timer = TimerBegin();
+
         // Ensure we're in a good state
+        cErr = cudaSetDevice( _deviceId ); if( cErr != cudaSuccess ) goto FAIL;
         cErr = cudaStreamSynchronize( _uploadStream ); if( cErr != cudaSuccess ) goto FAIL;
         cErr = cudaStreamSynchronize( _computeStream ); if( cErr != cudaSuccess ) goto FAIL;
         cErr = cudaStreamSynchronize( _downloadStream ); if( cErr != cudaSuccess ) goto FAIL;
 
         /// Upload input data
-    #if BB_CUDA_HARVEST_USE_TIMINGS
-        auto timer = TimerBegin();
-    #endif
+        timer = TimerBegin();
 
         cErr = cudaMemcpyAsync( _devMatchesIn, inLPairs, sizeof( Pair ) * entryCount, cudaMemcpyHostToDevice, _uploadStream ); if( cErr != cudaSuccess ) goto FAIL;
         cErr = cudaMemcpyAsync( _devYBufferOut, inY, sizeof( uint64 ) * entryCount, cudaMemcpyHostToDevice, _uploadStream ); if( cErr != cudaSuccess ) goto FAIL;
@@ -541,11 +955,12 @@ public:
         cErr = cudaStreamWaitEvent( _computeStream, _uploadEvent );
         if( cErr != cudaSuccess ) goto FAIL;
 
-        #if BB_CUDA_HARVEST_USE_TIMINGS
+        if( _recordTimings )
+        {
             cErr = cudaStreamSynchronize( _computeStream ); if( cErr != cudaSuccess ) goto FAIL;
             _timings.upload += TimerEndTicks( timer );
             timer = TimerBegin();
-        #endif
+        }
 
         /// Sort on Y
         SortEntriesOnY( table-1,
@@ -558,11 +973,12 @@ public:
             entryCount,
             _computeStream );
 
-        #if BB_CUDA_HARVEST_USE_TIMINGS
+        if( _recordTimings )
+        {
             cErr = cudaStreamSynchronize( _computeStream ); if( cErr != cudaSuccess ) goto FAIL;
             _timings.sort += TimerEndTicks( timer );
             timer = TimerBegin();
-        #endif
+        }
 
         // Sync download stream w/ compute stream
         cErr = cudaEventRecord( _computeEvent, _computeStream );
@@ -597,10 +1013,11 @@ public:
         matchCount = *_hostMatchCount;
         outMatchCount = matchCount;
 
-        #if BB_CUDA_HARVEST_USE_TIMINGS
+        if( _recordTimings )
+        {
             _timings.match += TimerEndTicks( timer );
             timer = TimerBegin();
-        #endif
+        }
 
         if( matchCount < 1 )
         {
@@ -631,11 +1048,12 @@ public:
         cErr = cudaEventRecord( _computeEvent, _computeStream );    // Signal from compute stream
         if( cErr != cudaSuccess ) goto FAIL;
 
-        #if BB_CUDA_HARVEST_USE_TIMINGS
+        if( _recordTimings )
+        {
             cErr = cudaStreamSynchronize( _computeStream ); if( cErr != cudaSuccess ) goto FAIL;
             _timings.fx += TimerEndTicks( timer );
             timer = TimerBegin();
-        #endif
+        }
 
         /// Copy new, unsorted entries back to host
         {
@@ -660,9 +1078,10 @@ public:
             if( cErr != cudaSuccess ) goto FAIL;
         }
 
-        #if BB_CUDA_HARVEST_USE_TIMINGS    
+        if( _recordTimings )
+        {
             _timings.download += TimerEndTicks( timer );
-        #endif
+        }
 
         outMatchCount = matchCount;
         return result;
@@ -682,6 +1101,284 @@ public:
         return result;
     }
 
+    ThresherResult ForwardPropTables(
+        GreenReaperContext& cx,
+        const uint32    groupCount,
+        const uint32*   groupOffsets,
+        const uint32*   groupCounts,
+        const Pair*     inPairs,
+        const uint64*   inY,
+        const void*     inMeta,
+        const bool      returnSuccessOnSingleMatch,
+        uint64*         outProof ) override
+    {
+        ASSERT( groupCount == 16 );
+
+        ThresherResult result{};
+        result.kind = ThresherResultKind::Success;
+
+        {
+            const cudaError_t cErr = AcquireRequestBuffers();
+            if( cErr != cudaSuccess )
+                return CudaErrorResult( cErr );
+        }
+
+        const uint32 tableCapacity = _fpTableCapacity;
+
+        // Table 2 is uploaded compacted, as it is on the host
+        uint32 entryCount      = 0;
+        uint32 maxGroupEntries = 0;
+
+        for( uint32 i = 0; i < groupCount; i++ )
+        {
+            entryCount      = std::max( entryCount, groupOffsets[i] + groupCounts[i] );
+            maxGroupEntries = std::max( maxGroupEntries, groupCounts[i] );
+        }
+
+        if( groupCount != 16 || entryCount > tableCapacity )
+        {
+            result.kind = ThresherResultKind::Unsupported;
+            return result;
+        }
+
+        FpGroupBounds& bounds = *_hostFpBounds;
+        cudaError_t    cErr   = cudaSuccess;
+
+        auto timer = TimerBegin();
+
+        // Ensure we're in a good state
+        cErr = cudaSetDevice( _deviceId ); if( cErr != cudaSuccess ) goto FAIL;
+        cErr = cudaStreamSynchronize( _uploadStream ); if( cErr != cudaSuccess ) goto FAIL;
+        cErr = cudaStreamSynchronize( _computeStream ); if( cErr != cudaSuccess ) goto FAIL;
+        cErr = cudaStreamSynchronize( _downloadStream ); if( cErr != cudaSuccess ) goto FAIL;
+
+        {
+            // The groups of the following tables start empty, at a fixed share of the table
+            memset( &bounds, 0, sizeof( bounds ) );
+
+            for( uint32 i = 0; i < groupCount; i++ )
+            {
+                bounds.begin[0][i] = groupOffsets[i];
+                bounds.end  [0][i] = groupOffsets[i] + groupCounts[i];
+            }
+
+            for( TableId table = TableId::Table3; table <= TableId::Table6; table++ )
+            {
+                const uint32 t          = (uint32)table - 1;
+                const uint32 tGroups    = 32 >> (int)table;
+                const uint32 groupSlots = tableCapacity / tGroups;
+
+                for( uint32 i = 0; i < tGroups; i++ )
+                    bounds.begin[t][i] = bounds.end[t][i] = i * groupSlots;
+            }
+
+            /// Upload input data
+            cErr = cudaMemcpyAsync( _devFpBounds, &bounds, sizeof( bounds ), cudaMemcpyHostToDevice, _uploadStream ); if( cErr != cudaSuccess ) goto FAIL;
+            cErr = cudaMemcpyAsync( _devFpPairs, inPairs, sizeof( Pair ) * entryCount, cudaMemcpyHostToDevice, _uploadStream ); if( cErr != cudaSuccess ) goto FAIL;
+            cErr = cudaMemcpyAsync( _devFpY, inY, sizeof( uint64 ) * entryCount, cudaMemcpyHostToDevice, _uploadStream ); if( cErr != cudaSuccess ) goto FAIL;
+            cErr = cudaMemcpyAsync( _devFpMeta, inMeta, sizeof( K32Meta2 ) * entryCount, cudaMemcpyHostToDevice, _uploadStream ); if( cErr != cudaSuccess ) goto FAIL;
+
+            cErr = cudaEventRecord( _uploadEvent, _uploadStream );
+            if( cErr != cudaSuccess ) goto FAIL;
+
+            // Sync w/ upload stream
+            cErr = cudaStreamWaitEvent( _computeStream, _uploadEvent );
+            if( cErr != cudaSuccess ) goto FAIL;
+
+            // Sort values are always the entry's index
+            CudaK32PlotGenSortKey( tableCapacity, _devFpSortKeyTmp, _computeStream );
+
+            if( _recordTimings )
+            {
+                cErr = cudaStreamSynchronize( _computeStream ); if( cErr != cudaSuccess ) goto FAIL;
+                _timings.upload += TimerEndTicks( timer );
+                timer = TimerBegin();
+            }
+
+            // All group sizes stay on the device, so the whole proof is queued at once
+            for( TableId rTable = TableId::Table3; rTable <= TableId::Table6; rTable++ )
+            {
+                const TableId lTable      = rTable - 1;
+                const uint32  l           = (uint32)lTable - 1;
+                const uint32  r           = (uint32)rTable - 1;
+                const uint32  lGroups     = 32 >> (int)lTable;
+                const uint32  matchStride = tableCapacity / lGroups;   // Half of an R group's share
+                const uint32  maxLEntries = lTable == TableId::Table2 ? maxGroupEntries : tableCapacity / lGroups;
+
+                cErr = SortGroupsOnY( lTable, lGroups, maxLEntries, _computeStream );
+                if( cErr != cudaSuccess ) goto FAIL;
+
+                if( _recordTimings )
+                {
+                    cErr = cudaStreamSynchronize( _computeStream ); if( cErr != cudaSuccess ) goto FAIL;
+                    _timings.sort += TimerEndTicks( timer );
+                    timer = TimerBegin();
+                }
+
+                cErr = CudaHarvestMatchK32Groups(
+                            _devFpMatches,
+                            _devFpBounds->matchCount[r],
+                            matchStride,
+                            _devFpYSorted,
+                            _devFpBounds->begin[l],
+                            _devFpBounds->end[l],
+                            lGroups,
+                            maxLEntries,
+                            _computeStream );
+                if( cErr != cudaSuccess ) goto FAIL;
+
+                if( _recordTimings )
+                {
+                    cErr = cudaStreamSynchronize( _computeStream ); if( cErr != cudaSuccess ) goto FAIL;
+                    _timings.match += TimerEndTicks( timer );
+                    timer = TimerBegin();
+                }
+
+                CudaFxHarvestK32Groups(
+                    rTable,
+                    _devFpY,
+                    _devFpMeta,
+                    FpPairs( rTable ),
+                    _devFpBounds->end[r],
+                    lGroups / 2,
+                    matchStride,
+                    _devFpBounds->matchCount[r],
+                    _devFpMatches,
+                    _devFpYSorted,
+                    _devFpMetaSorted,
+                    _computeStream );
+
+                if( _recordTimings )
+                {
+                    cErr = cudaStreamSynchronize( _computeStream ); if( cErr != cudaSuccess ) goto FAIL;
+                    _timings.fx += TimerEndTicks( timer );
+                    timer = TimerBegin();
+                }
+            }
+
+            BacktraceProofsKernel<<<4, 1, 0, _computeStream>>>( _devFpProofs, _devFpBounds, _devFpPairs, _devFpPairsSorted, tableCapacity );
+
+            /// Copy the group counts and proof candidates back, the only sync point of the proof
+            cErr = cudaMemcpyAsync( &bounds, _devFpBounds, sizeof( bounds ), cudaMemcpyDeviceToHost, _computeStream );
+            if( cErr != cudaSuccess ) goto FAIL;
+
+            cErr = cudaMemcpyAsync( _hostFpProofs, _devFpProofs, sizeof( Pair ) * GR_POST_PROOF_CMP_X_COUNT * 4, cudaMemcpyDeviceToHost, _computeStream );
+            if( cErr != cudaSuccess ) goto FAIL;
+
+            cErr = cudaStreamSynchronize( _computeStream );
+            if( cErr != cudaSuccess ) goto FAIL;
+
+            if( _recordTimings )
+                _timings.download += TimerEndTicks( timer );
+        }
+
+        // Find the table with the proof, as ForwardPropTable() would
+        for( TableId rTable = TableId::Table3; rTable <= TableId::Table6; rTable++ )
+        {
+            const uint32 r           = (uint32)rTable - 1;
+            const uint32 lGroups     = 32 >> ((int)rTable - 1);
+            const uint32 matchStride = tableCapacity / lGroups;
+
+            uint32 tableMatchCount = 0;
+
+            for( uint32 i = 0; i < lGroups; i++ )
+            {
+                const uint32 matchCount = bounds.matchCount[r][i];
+
+                if( matchCount == 0 )
+                {
+                    result.kind = ThresherResultKind::NoMatches;
+                    return result;
+                }
+
+                // Matches were dropped
+                if( matchCount > matchStride )
+                {
+                    result.kind = ThresherResultKind::Unsupported;
+                    return result;
+                }
+
+                tableMatchCount += matchCount;
+            }
+
+            const bool isLastTable = rTable == TableId::Table6;
+
+            if( tableMatchCount == 2 || (isLastTable && returnSuccessOnSingleMatch && tableMatchCount == 1) )
+            {
+                const Pair* proof = _hostFpProofs + ((uint32)rTable - (uint32)TableId::Table3) * GR_POST_PROOF_CMP_X_COUNT;
+
+                for( uint32 i = 0; i < GR_POST_PROOF_CMP_X_COUNT; i++ )
+                {
+                    outProof[i*2+0] = proof[i].left;
+                    outProof[i*2+1] = proof[i].right;
+                }
+
+                return result;
+            }
+        }
+
+        result.kind = ThresherResultKind::NoMatches;
+        return result;
+
+    FAIL:
+// Log::Line( "ForwardPropTables() Failed with CUDA error '%s': %s", cudaGetErrorName( cErr ), cudaGetErrorString( cErr ) );
+
+        ASSERT( cErr == cudaSuccess );  // Force debugger break
+
+        result.kind          = ThresherResultKind::Error;
+        result.error         = ThresherError::CudaError;
+        result.internalError = (i32)cErr;
+
+        return result;
+    }
+
+    // Unsorted pairs of a table, during device-side forward propagation
+    inline Pair* FpPairs( const TableId table ) const
+    {
+        return _devFpPairs + (size_t)_fpTableCapacity * ((uint32)table - 1);
+    }
+
+    inline Pair* FpPairsSorted( const TableId table ) const
+    {
+        return _devFpPairsSorted + (size_t)_fpTableCapacity * ((uint32)table - 1);
+    }
+
+    /// Sorts each group of the table on y, along with its pairs and metadata,
+    /// with the group bounds read from the device.
+    cudaError_t SortGroupsOnY( const TableId table, const uint32 groupCount, const uint32 maxGroupEntries, cudaStream_t stream )
+    {
+        const uint32  t          = (uint32)table - 1;
+        const uint32* groupBegin = _devFpBounds->begin[t];
+        const uint32* groupEnd   = _devFpBounds->end[t];
+
+        // Entries between groups are left untouched
+        cudaError_t cErr = cub::DeviceSegmentedRadixSort::SortPairs<uint64, uint32>(
+                _devFpSortTmpBuffer, _fpSortBufferSize,
+                _devFpY, _devFpYSorted,
+                _devFpSortKeyTmp, _devFpSortKey,
+                (int)_fpTableCapacity, (int)groupCount,
+                groupBegin, groupEnd,
+                0, _info.k+kExtraBits,
+                stream );
+
+        if( cErr != cudaSuccess ) return cErr;
+
+        const uint32 kthreads = 256;
+        const dim3   kblocks( CDiv( std::max( maxGroupEntries, 1u ), kthreads ), groupCount );
+
+        SortGroupsByKeyKernel<<<kblocks, kthreads, 0, stream>>>( groupBegin, groupEnd, _devFpSortKey, FpPairs( table ), FpPairsSorted( table ) );
+
+        switch( GetTableMetaMultiplier( table ) )
+        {
+            case 2: SortGroupsByKeyKernel<<<kblocks, kthreads, 0, stream>>>( groupBegin, groupEnd, _devFpSortKey, (K32Meta2*)_devFpMeta, (K32Meta2*)_devFpMetaSorted ); break;
+            case 3: SortGroupsByKeyKernel<<<kblocks, kthreads, 0, stream>>>( groupBegin, groupEnd, _devFpSortKey, (K32Meta3*)_devFpMeta, (K32Meta3*)_devFpMetaSorted ); break;
+            case 4: SortGroupsByKeyKernel<<<kblocks, kthreads, 0, stream>>>( groupBegin, groupEnd, _devFpSortKey, (K32Meta4*)_devFpMeta, (K32Meta4*)_devFpMetaSorted ); break;
+            default: ASSERT( 0 ); break;
+        }
+
+        return cudaGetLastError();
+    }
+
     cudaError_t SortEntriesOnY( 
         const TableId table,
               uint64* yOut,
@@ -693,46 +1390,42 @@ public:
         const uint32  entryCount,
         cudaStream_t  stream )
     {
-        cudaError_t cErr;
-
-        uint32* sortKeyIn = _devSortKeyTmp;
-        uint32* sortKey   = _devSortKey;
-
-        // Generate sort key (for meta and pairs)
-        CudaK32PlotGenSortKey( entryCount, sortKeyIn, stream );
-
-        // Sort y, with the sort key
-        cErr = cub::DeviceRadixSort::SortPairs<uint64, uint32>(
-                _devSortTmpBuffer, _sortBufferSize,
-                yIn, yOut, 
-                sortKeyIn, sortKey, 
-                entryCount, 0, _info.k+kExtraBits,
-                stream );
+        cudaError_t cErr = cudaSuccess;
 
-        if( cErr != cudaSuccess ) return cErr;
+        uint32* sortKey = _devSortKey;
 
-        // Sort matches on key
-        CudaK32PlotSortByKey( entryCount, sortKey, pairsIn, pairsOut, stream );
-
-        // Sort meta on key
+        // Sort y with a generated sort key, permuting meta in the same pass
         const size_t metaMultiplier = GetTableMetaMultiplier( table );
-        const size_t metaByteSize   = CDiv( _info.k * metaMultiplier, 8 );
         ASSERT( metaMultiplier > 0 );
 
+        #define SortYAndMeta( TMeta ) CudaRadixSortPairs<uint64, TMeta>( \
+            _devSortTmpBuffer, _sortBufferSize, yIn, yOut, nullptr, sortKey, \
+            entryCount, 0, _info.k+kExtraBits, stream, (const TMeta*)metaIn, (TMeta*)metaOut )
+
         switch( metaMultiplier )
         {
-            case 2: CudaK32PlotSortByKey( entryCount, sortKey, (K32Meta2*)metaIn, (K32Meta2*)metaOut, stream ); break;
-            case 3: CudaK32PlotSortByKey( entryCount, sortKey, (K32Meta3*)metaIn, (K32Meta3*)metaOut, stream ); break;
-            case 4: CudaK32PlotSortByKey( entryCount, sortKey, (K32Meta4*)metaIn, (K32Meta4*)metaOut, stream ); break;
+            case 2: cErr = SortYAndMeta( K32Meta2 ); break;
+            case 3: cErr = SortYAndMeta( K32Meta3 ); break;
+            case 4: cErr = SortYAndMeta( K32Meta4 ); break;
             default: ASSERT( 0 ); break;
         }
 
-        return cErr;
+        #undef SortYAndMeta
+
+        if( cErr != cudaSuccess ) return cErr;
+
+        // Sort matches on key
+        CudaK32PlotSortByKey( entryCount, sortKey, pairsIn, pairsOut, stream );
+
+        return cudaGetLastError();
     }
 
     void DumpTimings() override
     {
         #if BB_CUDA_HARVEST_USE_TIMINGS
+            if( !_recordTimings )
+                return;
+
             auto logTiming = []( const char* title, NanoSeconds ns ) {
 
                 Log::Line( "%8s: %.3lf", title, TicksToSeconds( ns ) );
@@ -754,6 +1447,19 @@ public:
     {
         _timings = {};
     }
+
+    void SetRecordTimings( const bool enabled ) override
+    {
+        _recordTimings = enabled;
+    }
+
+    void AccumulateTimings( GRProofTimings& outTimings ) override
+    {
+        outTimings.f1ElapsedNS    += (uint64)_timings.f1.count();
+        outTimings.sortElapsedNS  += (uint64)_timings.sort.count();
+        outTimings.matchElapsedNS += (uint64)_timings.match.count();
+        outTimings.fxElapsedNS    += (uint64)( _timings.fx + _timings.inlineX ).count();
+    }
 };
 
 
@@ -794,6 +1500,9 @@ IThresher* CudaThresherFactory_Private( const GreenReaperConfig& config )
             return nullptr;
     }
 
+    // Silent, as threshers are created by the harvester
+    CudaTuning::LoadProfile( deviceId );
+
     auto* thresher = new CudaThresher( config, deviceId );
     return thresher;
 }
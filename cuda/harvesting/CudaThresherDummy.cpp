@@ -5,3 +5,8 @@ IThresher* CudaThresherFactory::Create( const struct GreenReaperConfig& config )
 {
     return nullptr;
 }
+
+uint32 CudaThresherFactory::GetDeviceCount()
+{
+    return 0;
+}
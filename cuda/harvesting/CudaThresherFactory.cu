@@ -1,11 +1,47 @@
 #include "pch.h"
 #include "harvesting/Thresher.h"
+#include "GpuRuntime.h"
+#include <mutex>
 
 /// Defined in CudaThresher.cu
 IThresher* CudaThresherFactory_Private( const struct GreenReaperConfig& config );
 
+/// Loads kernels as they are first launched, instead of all of the library's modules when CUDA
+/// is initialized, which is most of the start up time of a context. It has to be set before the
+/// process' first CUDA call, so it only has an effect if the harvester is the first to use CUDA.
+/// A CUDA_MODULE_LOADING set by the user is left as it is.
+//-----------------------------------------------------------
+static void EnableLazyModuleLoading()
+{
+#if !BB_HIP_ENABLED
+    static std::once_flag once;
+    std::call_once( once, []() {
+        #if _WIN32
+            size_t len = 0;
+            if( getenv_s( &len, nullptr, 0, "CUDA_MODULE_LOADING" ) == 0 && len == 0 )
+                _putenv_s( "CUDA_MODULE_LOADING", "LAZY" );
+        #else
+            setenv( "CUDA_MODULE_LOADING", "LAZY", 0 );
+        #endif
+    });
+#endif
+}
+
 /// Declared in Thresher.h
 IThresher* CudaThresherFactory::Create( const struct GreenReaperConfig& config )
 {
+    EnableLazyModuleLoading();
     return CudaThresherFactory_Private( config );
 }
+
+/// Declared in Thresher.h
+uint32 CudaThresherFactory::GetDeviceCount()
+{
+    EnableLazyModuleLoading();
+
+    int deviceCount = 0;
+    if( cudaGetDeviceCount( &deviceCount ) != cudaSuccess || deviceCount < 0 )
+        return 0;
+
+    return (uint32)deviceCount;
+}
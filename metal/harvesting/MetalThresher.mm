@@ -0,0 +1,883 @@
+#include "pch.h"
+#include "harvesting/Thresher.h"
+#include "harvesting/GreenReaperInternal.h"
+#include "harvesting/GreenReaper.h"
+#include "threading/ThreadPool.h"
+#include "algorithm/RadixSort.h"
+#include "plotting/PlotTypes.h"
+#include "pos/chacha8.h"
+#include "util/Util.h"
+#include "ChiaConsts.h"
+
+#import <Foundation/Foundation.h>
+#import <Metal/Metal.h>
+
+///
+/// Kernels, compiled from source when a thresher is created.
+/// The ChiaConsts.h constants they use are passed in as preprocessor macros.
+///
+static const char* MetalThresherKernelSource = R"METAL(
+#include <metal_stdlib>
+using namespace metal;
+
+struct Pair
+{
+    uint left;
+    uint right;
+};
+
+inline uint BSwap32( const uint v )
+{
+    return ( v << 24 ) | ( ( v & 0xFF00 ) << 8 ) | ( ( v >> 8 ) & 0xFF00 ) | ( v >> 24 );
+}
+
+inline ulong BSwap64( const ulong v )
+{
+    return ( (ulong)BSwap32( (uint)v ) << 32 ) | (ulong)BSwap32( (uint)( v >> 32 ) );
+}
+
+inline uint RotL32( const uint v, const uint n ) { return ( v << n ) | ( v >> ( 32 - n ) ); }
+inline uint RotR32( const uint v, const uint n ) { return ( v >> n ) | ( v << ( 32 - n ) ); }
+
+///
+/// F1
+///
+#define QUARTERROUND( a, b, c, d )           \
+    a += b; d = RotL32( d ^ a, 16 );         \
+    c += d; b = RotL32( b ^ c, 12 );         \
+    a += b; d = RotL32( d ^ a, 8 );          \
+    c += d; b = RotL32( b ^ c, 7 );
+
+/// One thread per chacha8 block, each generating the 16 y's of its block.
+kernel void F1K32(
+    constant uint*  chachaInput [[buffer(0)]],
+    device   ulong* yOut        [[buffer(1)]],
+    device   uint*  xOut        [[buffer(2)]],
+    constant uint&  blockStart  [[buffer(3)]],
+    constant uint&  blockCount  [[buffer(4)]],
+    uint            gid         [[thread_position_in_grid]] )
+{
+    if( gid >= blockCount )
+        return;
+
+    const uint block = blockStart + gid;
+
+    uint j[16];
+    for( uint i = 0; i < 16; i++ )
+        j[i] = chachaInput[i];
+
+    j[12] = block;
+    j[13] = 0;
+
+    uint x[16];
+    for( uint i = 0; i < 16; i++ )
+        x[i] = j[i];
+
+    for( uint i = 0; i < 4; i++ )
+    {
+        QUARTERROUND( x[0], x[4], x[8] , x[12] );
+        QUARTERROUND( x[1], x[5], x[9] , x[13] );
+        QUARTERROUND( x[2], x[6], x[10], x[14] );
+        QUARTERROUND( x[3], x[7], x[11], x[15] );
+        QUARTERROUND( x[0], x[5], x[10], x[15] );
+        QUARTERROUND( x[1], x[6], x[11], x[12] );
+        QUARTERROUND( x[2], x[7], x[8] , x[13] );
+        QUARTERROUND( x[3], x[4], x[9] , x[14] );
+    }
+
+    const uint xStart = block * 16;
+    const uint dst    = gid * 16;
+
+    for( uint i = 0; i < 16; i++ )
+    {
+        const uint xv = xStart + i;
+
+        yOut[dst+i] = ( (ulong)BSwap32( x[i] + j[i] ) << kExtraBits ) | (ulong)( xv >> ( 32 - kExtraBits ) );
+        xOut[dst+i] = xv;
+    }
+}
+
+///
+/// Match
+///
+
+/// One thread per L entry, which matches itself against the whole adjacent R group.
+/// Groups are small when harvesting compressed plots, so each thread simply scans them.
+kernel void MatchK32(
+    device const ulong*  yEntries   [[buffer(0)]],
+    device Pair*         outPairs   [[buffer(1)]],
+    device atomic_uint*  matchCount [[buffer(2)]],
+    constant uint&       entryCount [[buffer(3)]],
+    constant uint&       maxMatches [[buffer(4)]],
+    uint                 gid        [[thread_position_in_grid]] )
+{
+    if( gid >= entryCount )
+        return;
+
+    const ulong yL     = yEntries[gid];
+    const ulong groupL = yL / kBC;
+    const ulong groupR = groupL + 1;
+
+    // Skip the rest of our group
+    uint r = gid + 1;
+    while( r < entryCount && yEntries[r] / kBC == groupL )
+        r++;
+
+    if( r >= entryCount || yEntries[r] / kBC != groupR )
+        return;
+
+    const uint parity = (uint)( groupL & 1 );
+    const uint localL = (uint)( yL - groupL * kBC );
+    const uint indJ   = localL / kC;
+
+    uint lTargets[kExtraBitsPow];
+    for( uint m = 0; m < kExtraBitsPow; m++ )
+        lTargets[m] = ( ( indJ + m ) % kB ) * kC + ( ( ( 2 * m + parity ) * ( 2 * m + parity ) + localL ) % kC );
+
+    for( ; r < entryCount; r++ )
+    {
+        const ulong yR = yEntries[r];
+        if( yR / kBC != groupR )
+            break;
+
+        const uint localR = (uint)( yR - groupR * kBC );
+
+        for( uint m = 0; m < kExtraBitsPow; m++ )
+        {
+            if( lTargets[m] == localR )
+            {
+                const uint idx = atomic_fetch_add_explicit( matchCount, 1, memory_order_relaxed );
+                if( idx < maxMatches )
+                    outPairs[idx] = Pair{ gid, r };
+            }
+        }
+    }
+}
+
+///
+/// Fx
+///
+constant uchar B3MsgSchedule[7][16] = {
+    { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 },
+    { 2, 6, 3, 10, 7, 0, 4, 13, 1, 11, 12, 5, 9, 14, 15, 8 },
+    { 3, 4, 10, 12, 13, 2, 7, 14, 6, 5, 9, 0, 11, 15, 8, 1 },
+    { 10, 7, 12, 9, 14, 3, 13, 15, 4, 0, 11, 2, 5, 8, 1, 6 },
+    { 12, 13, 9, 11, 15, 10, 14, 8, 7, 2, 5, 3, 0, 1, 6, 4 },
+    { 9, 14, 11, 5, 8, 12, 15, 1, 13, 3, 0, 10, 2, 6, 4, 7 },
+    { 11, 15, 5, 0, 1, 9, 8, 6, 14, 10, 2, 12, 3, 4, 7, 13 },
+};
+
+inline void B3G( thread uint* s, const uint a, const uint b, const uint c, const uint d, const uint x, const uint y )
+{
+    s[a] = s[a] + s[b] + x;
+    s[d] = RotR32( s[d] ^ s[a], 16 );
+    s[c] = s[c] + s[d];
+    s[b] = RotR32( s[b] ^ s[c], 12 );
+    s[a] = s[a] + s[b] + y;
+    s[d] = RotR32( s[d] ^ s[a], 8 );
+    s[c] = s[c] + s[d];
+    s[b] = RotR32( s[b] ^ s[c], 7 );
+}
+
+/// Single-block blake3 hash of the 64-bit words of input, each one already byte-swapped.
+/// Returns the first 3 output words.
+inline void B3Hash( thread const ulong* input, const uint inputByteSize, thread ulong* out )
+{
+    uint msg[16];
+    for( uint i = 0; i < 8; i++ )
+    {
+        msg[i*2]   = (uint)input[i];
+        msg[i*2+1] = (uint)( input[i] >> 32 );
+    }
+
+    uint s[16] = {
+        0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A,
+        0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19,
+        0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A,
+        0, 0, inputByteSize, 11
+    };
+
+    for( uint r = 0; r < 7; r++ )
+    {
+        constant uchar* sc = B3MsgSchedule[r];
+
+        B3G( s, 0, 4, 8 , 12, msg[sc[0]] , msg[sc[1]]  );
+        B3G( s, 1, 5, 9 , 13, msg[sc[2]] , msg[sc[3]]  );
+        B3G( s, 2, 6, 10, 14, msg[sc[4]] , msg[sc[5]]  );
+        B3G( s, 3, 7, 11, 15, msg[sc[6]] , msg[sc[7]]  );
+        B3G( s, 0, 5, 10, 15, msg[sc[8]] , msg[sc[9]]  );
+        B3G( s, 1, 6, 11, 12, msg[sc[10]], msg[sc[11]] );
+        B3G( s, 2, 7, 8 , 13, msg[sc[12]], msg[sc[13]] );
+        B3G( s, 3, 4, 9 , 14, msg[sc[14]], msg[sc[15]] );
+    }
+
+    for( uint i = 0; i < 3; i++ )
+        out[i] = BSwap64( (ulong)( s[i*2] ^ s[i*2+8] ) | ( (ulong)( s[i*2+1] ^ s[i*2+9] ) << 32 ) );
+}
+
+/// Meta with a multiplier of 1 is 32 bits, 2 is 64 bits and 3 or 4 are 2 64-bit words.
+template<uint MetaIn, uint MetaOut>
+inline void FxK32Entry(
+    const uint          gid,
+    device const Pair*  pairs,
+    device const ulong* yIn,
+    device const ulong* metaIn,
+    device ulong*       yOut,
+    device ulong*       metaOut )
+{
+    const uint  ySize     = 32 + kExtraBits;
+    const uint  yShift    = 64 - ( 32 + ( MetaOut == 0 ? 0 : kExtraBits ) );
+    const uint  inputSize = ( ySize + 32 * MetaIn * 2 + 7 ) / 8;
+
+    const Pair  p = pairs[gid];
+    const ulong y = yIn[p.left];
+
+    ulong input[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+    ulong m0 = 0, m1 = 0;
+
+    if( MetaIn == 1 )
+    {
+        device const uint* meta = reinterpret_cast<device const uint*>( metaIn );
+
+        const ulong l = meta[p.left ];
+        const ulong r = meta[p.right];
+
+        input[0] = BSwap64( y << 26 | l >> 6 );
+        input[1] = BSwap64( l << 58 | r << 26 );
+
+        m0 = l << 32 | r;
+    }
+    else if( MetaIn == 2 )
+    {
+        const ulong l = metaIn[p.left ];
+        const ulong r = metaIn[p.right];
+
+        input[0] = BSwap64( y << 26 | l >> 38 );
+        input[1] = BSwap64( l << 26 | r >> 38 );
+        input[2] = BSwap64( r << 26 );
+
+        m0 = l;
+        m1 = r;
+    }
+    else if( MetaIn == 3 )
+    {
+        const ulong l0 = metaIn[p.left *2];
+        const ulong l1 = metaIn[p.left *2+1] & 0xFFFFFFFF;
+        const ulong r0 = metaIn[p.right*2];
+        const ulong r1 = metaIn[p.right*2+1] & 0xFFFFFFFF;
+
+        input[0] = BSwap64( y  << 26 | l0 >> 38 );
+        input[1] = BSwap64( l0 << 26 | l1 >> 6  );
+        input[2] = BSwap64( l1 << 58 | r0 >> 6  );
+        input[3] = BSwap64( r0 << 58 | r1 << 26 );
+    }
+    else
+    {
+        const ulong l0 = metaIn[p.left *2];
+        const ulong l1 = metaIn[p.left *2+1];
+        const ulong r0 = metaIn[p.right*2];
+        const ulong r1 = metaIn[p.right*2+1];
+
+        input[0] = BSwap64( y  << 26 | l0 >> 38 );
+        input[1] = BSwap64( l0 << 26 | l1 >> 38 );
+        input[2] = BSwap64( l1 << 26 | r0 >> 38 );
+        input[3] = BSwap64( r0 << 26 | r1 >> 38 );
+        input[4] = BSwap64( r1 << 26 );
+    }
+
+    ulong h[3];
+    B3Hash( input, inputSize, h );
+
+    yOut[gid] = h[0] >> yShift;
+
+    if( MetaOut == 2 && MetaIn == 3 )
+    {
+        metaOut[gid] = h[0] << ySize | h[1] >> 26;
+    }
+    else if( MetaOut == 2 )
+    {
+        metaOut[gid] = m0;
+    }
+    else if( MetaOut == 3 )
+    {
+        metaOut[gid*2]   = h[0] << ySize | h[1] >> 26;
+        metaOut[gid*2+1] = ( ( h[1] << 6 ) & 0xFFFFFFC0 ) | h[2] >> 58;
+    }
+    else if( MetaOut == 4 && MetaIn == 2 )
+    {
+        metaOut[gid*2]   = m0;
+        metaOut[gid*2+1] = m1;
+    }
+    else if( MetaOut == 4 )
+    {
+        metaOut[gid*2]   = h[0] << ySize | h[1] >> 26;
+        metaOut[gid*2+1] = h[1] << 38    | h[2] >> 26;
+    }
+}
+
+#define FX_KERNEL( name, metaInMulti, metaOutMulti )                \
+kernel void name(                                                   \
+    device const Pair*  pairs      [[buffer(0)]],                   \
+    device const ulong* yIn        [[buffer(1)]],                   \
+    device const ulong* metaIn     [[buffer(2)]],                   \
+    device ulong*       yOut       [[buffer(3)]],                   \
+    device ulong*       metaOut    [[buffer(4)]],                   \
+    constant uint&      matchCount [[buffer(5)]],                   \
+    uint                gid        [[thread_position_in_grid]] )    \
+{                                                                   \
+    if( gid < matchCount )                                          \
+        FxK32Entry<metaInMulti, metaOutMulti>( gid, pairs, yIn, metaIn, yOut, metaOut ); \
+}
+
+FX_KERNEL( FxK32T2, 1, 2 )
+FX_KERNEL( FxK32T3, 2, 4 )
+FX_KERNEL( FxK32T4, 4, 4 )
+FX_KERNEL( FxK32T5, 4, 3 )
+FX_KERNEL( FxK32T6, 3, 2 )
+FX_KERNEL( FxK32T7, 2, 0 )
+
+///
+/// Pairs
+///
+kernel void InlineXsIntoPairsK32(
+    device Pair*       pairs      [[buffer(0)]],
+    device const uint* xs         [[buffer(1)]],
+    constant uint&     entryCount [[buffer(2)]],
+    uint               gid        [[thread_position_in_grid]] )
+{
+    if( gid >= entryCount )
+        return;
+
+    const Pair p = pairs[gid];
+    pairs[gid] = Pair{ xs[p.left], xs[p.right] };
+}
+
+kernel void ApplyPairOffsetK32(
+    device Pair*   pairs      [[buffer(0)]],
+    constant uint& offset     [[buffer(1)]],
+    constant uint& entryCount [[buffer(2)]],
+    uint           gid        [[thread_position_in_grid]] )
+{
+    if( gid >= entryCount )
+        return;
+
+    pairs[gid].left  += offset;
+    pairs[gid].right += offset;
+}
+)METAL";
+
+///
+/// Decompresses on Apple Silicon GPUs. F1, matching and fx run on the GPU.
+/// The GPU shares the system memory with the CPU, so all buffers are allocated with shared storage
+/// and the CPU reads and writes them in place, with no transfers to or from device memory.
+/// Sorting on y is done on the CPU with the harvester's thread pool, in between command buffers.
+///
+class MetalThresher : public IThresher
+{
+    GreenReaperConfig           _config;
+
+    id<MTLDevice>               _device             = nil;
+    id<MTLCommandQueue>         _queue              = nil;
+
+    id<MTLComputePipelineState> _f1Pipeline         = nil;
+    id<MTLComputePipelineState> _matchPipeline      = nil;
+    id<MTLComputePipelineState> _fxPipelines[7]     = {};   // Indexed by table
+    id<MTLComputePipelineState> _inlineXsPipeline   = nil;
+    id<MTLComputePipelineState> _pairOffsetPipeline = nil;
+
+    uint32        _maxCompressionLevel = 0;     // Compression level for which we currently hold buffers
+    size_t        _bufferCapacity      = 0;
+    size_t        _matchCapacity       = 0;
+
+    id<MTLBuffer> _chachaInput = nil;
+    id<MTLBuffer> _matchCount  = nil;
+
+    // F1 output, then the group inputs. Each is sorted onto its 'Sorted' buffer.
+    id<MTLBuffer> _yIn         = nil;
+    id<MTLBuffer> _ySorted     = nil;
+    id<MTLBuffer> _xIn         = nil;
+    id<MTLBuffer> _xSorted     = nil;
+    id<MTLBuffer> _pairsIn     = nil;
+    id<MTLBuffer> _pairsSorted = nil;
+    id<MTLBuffer> _metaIn      = nil;
+    id<MTLBuffer> _metaSorted  = nil;
+
+    // Fx output
+    id<MTLBuffer> _pairsOut    = nil;
+    id<MTLBuffer> _yOut        = nil;
+    id<MTLBuffer> _metaOut     = nil;
+
+public:
+    MetalThresher( const GreenReaperConfig& config, id<MTLDevice> device )
+        : _config( config )
+        , _device( device )
+    {}
+
+    ~MetalThresher() override
+    {
+        ReleaseBuffers();
+    }
+
+    //-----------------------------------------------------------
+    bool Init()
+    {
+        @autoreleasepool
+        {
+            _queue = [_device newCommandQueue];
+            if( !_queue )
+                return false;
+
+            MTLCompileOptions* options = [MTLCompileOptions new];
+            options.preprocessorMacros = @{
+                @"kExtraBits"   : @(kExtraBits),
+                @"kExtraBitsPow": @(kExtraBitsPow),
+                @"kB"           : @(kB),
+                @"kC"           : @(kC),
+                @"kBC"          : @(kBC),
+            };
+
+            NSError* error = nil;
+            id<MTLLibrary> library = [_device newLibraryWithSource:@(MetalThresherKernelSource) options:options error:&error];
+            if( !library )
+                return false;
+
+            _f1Pipeline         = CreatePipeline( library, "F1K32" );
+            _matchPipeline      = CreatePipeline( library, "MatchK32" );
+            _inlineXsPipeline   = CreatePipeline( library, "InlineXsIntoPairsK32" );
+            _pairOffsetPipeline = CreatePipeline( library, "ApplyPairOffsetK32" );
+
+            bool ok = _f1Pipeline && _matchPipeline && _inlineXsPipeline && _pairOffsetPipeline;
+
+            for( TableId table = TableId::Table2; table <= TableId::Table7; table++ )
+            {
+                char name[16];
+                snprintf( name, sizeof( name ), "FxK32T%u", (uint32)table + 1 );
+
+                _fxPipelines[(int)table] = CreatePipeline( library, name );
+                ok = ok && _fxPipelines[(int)table];
+            }
+
+            return ok;
+        }
+    }
+
+    //-----------------------------------------------------------
+    bool AllocateBuffers( const uint k, const uint maxCompressionLevel ) override
+    {
+        // Same levels as the CUDA thresher
+        if( k != 32 || maxCompressionLevel > 7 )
+            return false;
+
+        if( _maxCompressionLevel >= maxCompressionLevel )
+            return true;
+
+        ReleaseBuffers();
+
+        const uint32 entriesPerF1Block = kF1BlockSizeBits / k;
+
+        const uint64 entriesPerBucket = GetEntriesPerBucketForCompressionLevel( k, maxCompressionLevel );
+        const uint64 maxPairs         = std::max( (uint64)GR_MIN_TABLE_PAIRS, GetMaxTablePairsForCompressionLevel( k, maxCompressionLevel ) );
+
+        _bufferCapacity = RoundUpToNextBoundary( entriesPerBucket * 2, entriesPerF1Block );
+        _matchCapacity  = (size_t)maxPairs;
+
+        // Groups are sorted through the F1 buffers as well
+        const size_t yCapacity = std::max( _bufferCapacity, _matchCapacity );
+
+        _chachaInput = CreateBuffer( 64 );
+        _matchCount  = CreateBuffer( sizeof( uint32 ) );
+        _yIn         = CreateBuffer( yCapacity * sizeof( uint64 ) );
+        _ySorted     = CreateBuffer( yCapacity * sizeof( uint64 ) );
+        _xIn         = CreateBuffer( _bufferCapacity * sizeof( uint32 ) );
+        _xSorted     = CreateBuffer( _bufferCapacity * sizeof( uint32 ) );
+        _pairsIn     = CreateBuffer( _matchCapacity * sizeof( Pair ) );
+        _pairsSorted = CreateBuffer( _matchCapacity * sizeof( Pair ) );
+        _metaIn      = CreateBuffer( _matchCapacity * sizeof( K32Meta4 ) );
+        _metaSorted  = CreateBuffer( _matchCapacity * sizeof( K32Meta4 ) );
+        _pairsOut    = CreateBuffer( _matchCapacity * sizeof( Pair ) );
+        _yOut        = CreateBuffer( _matchCapacity * sizeof( uint64 ) );
+        _metaOut     = CreateBuffer( _matchCapacity * sizeof( K32Meta4 ) );
+
+        if( !_chachaInput || !_matchCount || !_yIn || !_ySorted || !_xIn || !_xSorted || !_pairsIn || !_pairsSorted ||
+            !_metaIn || !_metaSorted || !_pairsOut || !_yOut || !_metaOut )
+        {
+            ReleaseBuffers();
+            return false;
+        }
+
+        _maxCompressionLevel = maxCompressionLevel;
+        return true;
+    }
+
+    //-----------------------------------------------------------
+    void ReleaseBuffers() override
+    {
+        _maxCompressionLevel = 0;
+        _bufferCapacity      = 0;
+        _matchCapacity       = 0;
+
+        _chachaInput = nil;
+        _matchCount  = nil;
+        _yIn         = nil;
+        _ySorted     = nil;
+        _xIn         = nil;
+        _xSorted     = nil;
+        _pairsIn     = nil;
+        _pairsSorted = nil;
+        _metaIn      = nil;
+        _metaSorted  = nil;
+        _pairsOut    = nil;
+        _yOut        = nil;
+        _metaOut     = nil;
+    }
+
+    //-----------------------------------------------------------
+    ThresherResult DecompressInitialTable(
+        GreenReaperContext& cx,
+        const byte   plotId[32],
+        const uint32 entryCountPerX,
+        Pair*        outPairs,
+        uint64*      outY,
+        void*        outMeta,
+        uint32&      outMatchCount,
+        const uint64 x0, const uint64 x1 ) override
+    {
+        // Only k32 for now
+        ASSERT( x0 <= 0xFFFFFFFF );
+        ASSERT( x1 <= 0xFFFFFFFF );
+
+        outMatchCount = 0;
+
+        const uint32 entryCount = entryCountPerX * 2;
+
+        if( entryCount > _bufferCapacity )
+            return { ThresherResultKind::Error, ThresherError::UnexpectedError, 0 };
+
+        // Generate f1 for both x ranges
+        {
+            byte key[32] = { 1 };
+            memcpy( key + 1, plotId, 32 - 1 );
+
+            chacha8_ctx chacha;
+            chacha8_keysetup( &chacha, key, 256, nullptr );
+            memcpy( _chachaInput.contents, chacha.input, 64 );
+
+            const uint32 f1EntriesPerBlock = kF1BlockSize / sizeof( uint32 );
+            const uint32 blocksPerX        = entryCountPerX / f1EntriesPerBlock;
+            const uint32 blockStarts[2]    = {
+                (uint32)( x0 * entryCountPerX / f1EntriesPerBlock ),
+                (uint32)( x1 * entryCountPerX / f1EntriesPerBlock )
+            };
+
+            const bool ok = RunCommands( [&]( id<MTLComputeCommandEncoder> encoder ) {
+
+                [encoder setComputePipelineState:_f1Pipeline];
+                [encoder setBuffer:_chachaInput offset:0 atIndex:0];
+                [encoder setBytes:&blocksPerX length:sizeof( uint32 ) atIndex:4];
+
+                for( uint32 i = 0; i < 2; i++ )
+                {
+                    [encoder setBuffer:_yIn offset:i * entryCountPerX * sizeof( uint64 ) atIndex:1];
+                    [encoder setBuffer:_xIn offset:i * entryCountPerX * sizeof( uint32 ) atIndex:2];
+                    [encoder setBytes:&blockStarts[i] length:sizeof( uint32 ) atIndex:3];
+                    Dispatch( encoder, _f1Pipeline, blocksPerX );
+                }
+            });
+
+            if( !ok )
+                return MetalErrorResult();
+        }
+
+        // Sort on y, in place on the shared buffers
+        RadixSort256::SortWithKeyHybrid<BB_MAX_JOBS, uint64, uint32, 5>( *cx.pool, 0,
+            (uint64*)_yIn.contents, (uint64*)_ySorted.contents,
+            (uint32*)_xIn.contents, (uint32*)_xSorted.contents, entryCount );
+
+        uint32 matchCount = 0;
+        if( !Match( entryCount, (uint32)_matchCapacity, matchCount ) )
+            return MetalErrorResult();
+
+        if( matchCount < 1 )
+            return { ThresherResultKind::NoMatches };
+
+        // Table 2 fx, then replace the pairs with the x's they point to
+        {
+            const bool ok = RunCommands( [&]( id<MTLComputeCommandEncoder> encoder ) {
+
+                EncodeFx( encoder, TableId::Table2, matchCount, _xSorted );
+
+                [encoder setComputePipelineState:_inlineXsPipeline];
+                [encoder setBuffer:_pairsOut offset:0 atIndex:0];
+                [encoder setBuffer:_xSorted  offset:0 atIndex:1];
+                [encoder setBytes:&matchCount length:sizeof( uint32 ) atIndex:2];
+                Dispatch( encoder, _inlineXsPipeline, matchCount );
+            });
+
+            if( !ok )
+                return MetalErrorResult();
+        }
+
+        memcpy( outPairs, _pairsOut.contents, sizeof( Pair ) * matchCount );
+        memcpy( outY    , _yOut    .contents, sizeof( uint64 ) * matchCount );
+        memcpy( outMeta , _metaOut .contents, sizeof( K32Meta2 ) * matchCount );
+
+        outMatchCount = matchCount;
+        return { ThresherResultKind::Success };
+    }
+
+    //-----------------------------------------------------------
+    ThresherResult DecompressTableGroup(
+        GreenReaperContext& cx,
+        const TableId   table,
+        uint32          entryCount,
+        uint32          matchOffset,
+        uint32          maxPairs,
+        uint32&         outMatchCount,
+        Pair*           outPairs,
+        uint64*         outY,
+        void*           outMeta,
+        Pair*           outLPairs,
+        const Pair*     inLPairs,
+        const uint64*   inY,
+        const void*     inMeta ) override
+    {
+        ASSERT( maxPairs );
+        ASSERT( table >= TableId::Table3 && table <= TableId::Table7 );
+
+        outMatchCount = 0;
+
+        if( entryCount > _matchCapacity )
+            return { ThresherResultKind::Error, ThresherError::UnexpectedError, 0 };
+
+        const size_t inMetaSize  = GetK32MetaSize( table - 1 );
+        const size_t outMetaSize = GetK32MetaSize( table );
+
+        // Sort the L entries on y
+        memcpy( _pairsIn.contents, inLPairs, sizeof( Pair ) * entryCount );
+        memcpy( _yIn    .contents, inY     , sizeof( uint64 ) * entryCount );
+        memcpy( _metaIn .contents, inMeta  , inMetaSize * entryCount );
+
+        switch( table )
+        {
+            case TableId::Table3: SortGroup<K32MetaType<TableId::Table3>::In>( cx, entryCount ); break;
+            case TableId::Table4: SortGroup<K32MetaType<TableId::Table4>::In>( cx, entryCount ); break;
+            case TableId::Table5: SortGroup<K32MetaType<TableId::Table5>::In>( cx, entryCount ); break;
+            case TableId::Table6: SortGroup<K32MetaType<TableId::Table6>::In>( cx, entryCount ); break;
+            case TableId::Table7: SortGroup<K32MetaType<TableId::Table7>::In>( cx, entryCount ); break;
+            default:
+                return { ThresherResultKind::Error, ThresherError::UnexpectedError, 0 };
+        }
+
+        memcpy( outLPairs, _pairsSorted.contents, sizeof( Pair ) * entryCount );
+
+        uint32 matchCount = 0;
+        if( !Match( entryCount, std::min( maxPairs, (uint32)_matchCapacity ), matchCount ) )
+            return MetalErrorResult();
+
+        if( matchCount < 1 )
+            return { ThresherResultKind::NoMatches };
+
+        // Fx, then make the pairs point to the L table as a whole
+        {
+            const bool ok = RunCommands( [&]( id<MTLComputeCommandEncoder> encoder ) {
+
+                EncodeFx( encoder, table, matchCount, _metaSorted );
+
+                [encoder setComputePipelineState:_pairOffsetPipeline];
+                [encoder setBuffer:_pairsOut offset:0 atIndex:0];
+                [encoder setBytes:&matchOffset length:sizeof( uint32 ) atIndex:1];
+                [encoder setBytes:&matchCount  length:sizeof( uint32 ) atIndex:2];
+                Dispatch( encoder, _pairOffsetPipeline, matchCount );
+            });
+
+            if( !ok )
+                return MetalErrorResult();
+        }
+
+        memcpy( outPairs, _pairsOut.contents, sizeof( Pair ) * matchCount );
+        memcpy( outY    , _yOut    .contents, sizeof( uint64 ) * matchCount );
+
+        if( outMetaSize )
+            memcpy( outMeta, _metaOut.contents, outMetaSize * matchCount );
+
+        outMatchCount = matchCount;
+        return { ThresherResultKind::Success };
+    }
+
+private:
+    //-----------------------------------------------------------
+    id<MTLComputePipelineState> CreatePipeline( id<MTLLibrary> library, const char* name )
+    {
+        id<MTLFunction> function = [library newFunctionWithName:@(name)];
+        if( !function )
+            return nil;
+
+        NSError* error = nil;
+        return [_device newComputePipelineStateWithFunction:function error:&error];
+    }
+
+    //-----------------------------------------------------------
+    id<MTLBuffer> CreateBuffer( const size_t size )
+    {
+        return [_device newBufferWithLength:size options:MTLResourceStorageModeShared];
+    }
+
+    /// Encodes commands into a single command buffer and waits for them to complete.
+    /// Dispatches within it run one after the other.
+    //-----------------------------------------------------------
+    template<typename TEncode>
+    bool RunCommands( const TEncode& encode )
+    {
+        @autoreleasepool
+        {
+            id<MTLCommandBuffer> commands = [_queue commandBuffer];
+            if( !commands )
+                return false;
+
+            id<MTLComputeCommandEncoder> encoder = [commands computeCommandEncoder];
+            encode( encoder );
+            [encoder endEncoding];
+
+            [commands commit];
+            [commands waitUntilCompleted];
+
+            return commands.status == MTLCommandBufferStatusCompleted;
+        }
+    }
+
+    //-----------------------------------------------------------
+    static void Dispatch( id<MTLComputeCommandEncoder> encoder, id<MTLComputePipelineState> pipeline, const uint32 threadCount )
+    {
+        if( threadCount == 0 )
+            return;
+
+        const NSUInteger groupSize = std::min<NSUInteger>( pipeline.maxTotalThreadsPerThreadgroup, 256 );
+
+        [encoder dispatchThreads:MTLSizeMake( threadCount, 1, 1 ) threadsPerThreadgroup:MTLSizeMake( groupSize, 1, 1 )];
+    }
+
+    /// Matches the sorted entries in _ySorted into _pairsOut.
+    //-----------------------------------------------------------
+    bool Match( const uint32 entryCount, const uint32 maxMatches, uint32& outMatchCount )
+    {
+        *(uint32*)_matchCount.contents = 0;
+
+        const bool ok = RunCommands( [&]( id<MTLComputeCommandEncoder> encoder ) {
+
+            [encoder setComputePipelineState:_matchPipeline];
+            [encoder setBuffer:_ySorted    offset:0 atIndex:0];
+            [encoder setBuffer:_pairsOut   offset:0 atIndex:1];
+            [encoder setBuffer:_matchCount offset:0 atIndex:2];
+            [encoder setBytes:&entryCount length:sizeof( uint32 ) atIndex:3];
+            [encoder setBytes:&maxMatches length:sizeof( uint32 ) atIndex:4];
+            Dispatch( encoder, _matchPipeline, entryCount );
+        });
+
+        outMatchCount = std::min( *(const uint32*)_matchCount.contents, maxMatches );
+        return ok;
+    }
+
+    /// Generates fx for the matches in _pairsOut, from the L entries in _ySorted and metaIn.
+    //-----------------------------------------------------------
+    void EncodeFx( id<MTLComputeCommandEncoder> encoder, const TableId table, const uint32 matchCount, id<MTLBuffer> metaIn )
+    {
+        id<MTLComputePipelineState> pipeline = _fxPipelines[(int)table];
+
+        [encoder setComputePipelineState:pipeline];
+        [encoder setBuffer:_pairsOut offset:0 atIndex:0];
+        [encoder setBuffer:_ySorted  offset:0 atIndex:1];
+        [encoder setBuffer:metaIn    offset:0 atIndex:2];
+        [encoder setBuffer:_yOut     offset:0 atIndex:3];
+        [encoder setBuffer:_metaOut  offset:0 atIndex:4];
+        [encoder setBytes:&matchCount length:sizeof( uint32 ) atIndex:5];
+        Dispatch( encoder, pipeline, matchCount );
+    }
+
+    /// Sorts the group entries in the input buffers onto the sorted buffers.
+    //-----------------------------------------------------------
+    template<typename TMeta>
+    void SortGroup( GreenReaperContext& cx, const uint32 entryCount )
+    {
+        const uint32 threadCount = std::min( cx.pool->ThreadCount(), entryCount );
+
+        RadixSort256::SortWithPayloadsHybrid<BB_MAX_JOBS, uint64, TMeta, Pair, 5>( *cx.pool, threadCount,
+            (uint64*)_yIn.contents, (uint64*)_ySorted.contents,
+            (TMeta*)_metaIn.contents, (TMeta*)_metaSorted.contents,
+            (Pair*)_pairsIn.contents, (Pair*)_pairsSorted.contents, entryCount );
+    }
+
+    /// Size of the metadata output by a table, as laid out by the harvester.
+    //-----------------------------------------------------------
+    static size_t GetK32MetaSize( const TableId table )
+    {
+        switch( table )
+        {
+            case TableId::Table1: return sizeof( K32MetaType<TableId::Table1>::Out );
+            case TableId::Table2: return sizeof( K32MetaType<TableId::Table2>::Out );
+            case TableId::Table3: return sizeof( K32MetaType<TableId::Table3>::Out );
+            case TableId::Table4: return sizeof( K32MetaType<TableId::Table4>::Out );
+            case TableId::Table5: return sizeof( K32MetaType<TableId::Table5>::Out );
+            case TableId::Table6: return sizeof( K32MetaType<TableId::Table6>::Out );
+            default: return 0;
+        }
+    }
+
+    //-----------------------------------------------------------
+    static ThresherResult MetalErrorResult()
+    {
+        return { ThresherResultKind::Error, ThresherError::MetalError, 0 };
+    }
+};
+
+//-----------------------------------------------------------
+static NSArray<id<MTLDevice>>* GetMetalDevices()
+{
+    NSArray<id<MTLDevice>>* devices = MTLCopyAllDevices();
+    if( devices.count > 0 )
+        return devices;
+
+    id<MTLDevice> device = MTLCreateSystemDefaultDevice();
+    return device ? @[ device ] : @[];
+}
+
+/// Declared in Thresher.h
+//-----------------------------------------------------------
+IThresher* MetalThresherFactory::Create( const GreenReaperConfig& config )
+{
+    ASSERT( config.gpuRequest != GRGpuRequestKind_None );
+
+    @autoreleasepool
+    {
+        NSArray<id<MTLDevice>>* devices = GetMetalDevices();
+        if( devices.count < 1 )
+            return nullptr;
+
+        NSUInteger deviceIndex = config.gpuDeviceIndex;
+        if( deviceIndex >= devices.count )
+        {
+            if( config.gpuRequest == GRGpuRequestKind_ExactDevice )
+                return nullptr;
+
+            deviceIndex = 0;
+        }
+
+        auto* thresher = new MetalThresher( config, devices[deviceIndex] );
+        if( !thresher->Init() )
+        {
+            delete thresher;
+            return nullptr;
+        }
+
+        return thresher;
+    }
+}
+
+/// Declared in Thresher.h
+//-----------------------------------------------------------
+uint32 MetalThresherFactory::GetDeviceCount()
+{
+    @autoreleasepool
+    {
+        return (uint32)GetMetalDevices().count;
+    }
+}
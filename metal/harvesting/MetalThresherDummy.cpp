@@ -0,0 +1,12 @@
+#include "harvesting/Thresher.h"
+
+/// Dummy function for when Metal is not available
+IThresher* MetalThresherFactory::Create( const struct GreenReaperConfig& config )
+{
+    return nullptr;
+}
+
+uint32 MetalThresherFactory::GetDeviceCount()
+{
+    return 0;
+}
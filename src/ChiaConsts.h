@@ -92,6 +92,7 @@ const double kRValues[7] = { 4.7, 2.75, 2.75, 2.7, 2.6, 2.45 };
 #define BB_CHIA_QUALITY_SIZE   32
 
 #define BB_CHIA_K_MAX_VALUE    50
+#define BB_CHIA_K_MIN_VALUE    18
 
 
 // Initializes L_targets table
@@ -152,7 +153,7 @@ inline constexpr size_t CalculateParkSize( TableId tableId )
 //-----------------------------------------------------------
 inline constexpr size_t CalculateParkSize( const TableId tableId, const uint32 k )
 {
-    ASSERT( k >= 20 );
+    ASSERT( k >= BB_CHIA_K_MIN_VALUE );
 
     return 
         CDiv( k * 2, 8 ) +                                         // LinePoint size
@@ -21,6 +21,16 @@ struct PlotRequest
 struct MemPlotConfig
 {
     const struct GlobalPlotConfig* gCfg;
+
+    // Partition buffers and threads per NUMA node instead of interleaving memory across nodes
+    bool numaLocal;
+
+    // Order fx only on its kBC group before matching, instead of sorting it fully
+    bool groupMatch;
+
+    // Run one plotter per NUMA node, each with node-bound buffers and threads,
+    // making a plot each concurrently
+    bool numaInstances;
 };
 
 ///
@@ -36,6 +46,9 @@ struct MemPlotContext
     const byte* plotMemo;
     uint16      plotMemoSize;
 
+    // Plot size. Buffers and tables are sized to 2^k entries.
+    uint32      k;
+
     // How many threads to use for the thread pool?
     // #TODO: Remove this, just use the thread pool's count.
     uint32      threadCount;
@@ -43,6 +56,17 @@ struct MemPlotContext
     // Thread pool to use when running jobs
     ThreadPool* threadPool;
 
+    // NUMA-local mode: One thread pool per node, with threads pinned to that node's CPUs.
+    // Buffers are split into per-node partitions, so entry i of any table buffer
+    // lives on node i / nodeEntryCount. nodeCount is 0 when not in NUMA-local mode.
+    uint32       nodeCount;
+    uint64       nodeEntryCount;    // Entries per node partition of the 8-byte y/pair buffers
+    ThreadPool** nodePools;
+
+    // Builds phase 4's tables while phase 3 writes the table 6 parks.
+    // Pinned to the upper half of the compute CPUs. Null with a single thread.
+    ThreadPool*  p4ThreadPool;
+
     ///
     /// Buffers
     ///
@@ -1 +1,139 @@
-#include "SysHost.h"
\ No newline at end of file
+#include "SysHost.h"
+
+#if defined( __x86_64__ ) || defined( _M_X64 )
+    #define SYSHOST_X86 1
+
+    #if defined( _MSC_VER ) && !defined( __clang__ )
+        #include <intrin.h>
+    #endif
+#endif
+
+static CpuFeatures _cpuLevelMask = (CpuFeatures)0xFFFFFFFF;
+
+//-----------------------------------------------------------
+static CpuFeatures DetectCpuFeatures()
+{
+    CpuFeatures features = CpuFeatures::None;
+
+#if SYSHOST_X86
+    #if defined( _MSC_VER ) && !defined( __clang__ )
+        int regs[4];
+        __cpuid( regs, 0 );
+        const int maxId = regs[0];
+
+        __cpuid( regs, 1 );
+        const uint32 ecx1 = (uint32)regs[2];
+
+        if( ( ecx1 & (1u << 20) ) && ( ecx1 & (1u << 23) ) )
+            features |= CpuFeatures::SSE42;
+
+        // The OS must save the wider registers' state
+        const bool osxsave = ( ecx1 & (1u << 27) ) != 0;
+        if( !osxsave || maxId < 7 )
+            return features;
+
+        const uint64 xcr0 = _xgetbv( 0 );
+        __cpuidex( regs, 7, 0 );
+        const uint32 ebx7 = (uint32)regs[1];
+
+        const bool ymm = ( xcr0 & 6 ) == 6;
+        const bool zmm = ( xcr0 & 0xE6 ) == 0xE6;       // With the opmask registers
+
+        if( ebx7 & (1u << 8) )
+            features |= CpuFeatures::BMI2;
+
+        if( ymm && ( ebx7 & (1u << 5) ) && ( ebx7 & (1u << 3) ) && ( ebx7 & (1u << 8) ) && ( ecx1 & (1u << 12) ) )
+            features |= CpuFeatures::AVX2;
+
+        if( zmm && ( ebx7 & (1u << 16) ) )
+        {
+            features |= CpuFeatures::AVX512F;
+
+            if( ebx7 & (1u << 31) )
+                features |= CpuFeatures::AVX512VL;
+
+            // CD, DQ and VL along with BW, for x86-64-v4
+            if( ( ebx7 & (1u << 30) ) && ( ebx7 & (1u << 28) ) && ( ebx7 & (1u << 17) ) && ( ebx7 & (1u << 31) ) )
+                features |= CpuFeatures::AVX512BW;
+        }
+    #else
+        __builtin_cpu_init();
+
+        if( __builtin_cpu_supports( "sse4.2" ) && __builtin_cpu_supports( "popcnt" ) )
+            features |= CpuFeatures::SSE42;
+
+        if( __builtin_cpu_supports( "bmi2" ) )
+            features |= CpuFeatures::BMI2;
+
+        if( __builtin_cpu_supports( "avx2" ) && __builtin_cpu_supports( "bmi" ) && __builtin_cpu_supports( "bmi2" ) && __builtin_cpu_supports( "fma" ) )
+            features |= CpuFeatures::AVX2;
+
+        if( __builtin_cpu_supports( "avx512f" ) )
+        {
+            features |= CpuFeatures::AVX512F;
+
+            if( __builtin_cpu_supports( "avx512vl" ) )
+                features |= CpuFeatures::AVX512VL;
+
+            if( __builtin_cpu_supports( "avx512bw" ) && __builtin_cpu_supports( "avx512cd" ) &&
+                __builtin_cpu_supports( "avx512dq" ) && __builtin_cpu_supports( "avx512vl" ) )
+                features |= CpuFeatures::AVX512BW;
+        }
+    #endif
+#elif defined( __aarch64__ ) || defined( _M_ARM64 )
+    // Part of the ARMv8-A baseline
+    features |= CpuFeatures::NEON;
+#endif
+
+    return features;
+}
+
+//-----------------------------------------------------------
+CpuFeatures SysHost::GetCpuFeatures()
+{
+    static const CpuFeatures detected = DetectCpuFeatures();
+    return detected & _cpuLevelMask;
+}
+
+//-----------------------------------------------------------
+void SysHost::LimitCpuLevel( const CpuLevel level )
+{
+    // NEON is not an optional extension on ARM64, so it is never capped
+    CpuFeatures mask = CpuFeatures::NEON;
+
+    if( level >= CpuLevel::V2 )
+        mask |= CpuFeatures::SSE42;
+    if( level >= CpuLevel::V3 )
+        mask |= CpuFeatures::AVX2 | CpuFeatures::BMI2;
+    if( level >= CpuLevel::V4 )
+        mask |= CpuFeatures::AVX512F | CpuFeatures::AVX512BW | CpuFeatures::AVX512VL;
+
+    _cpuLevelMask = mask;
+}
+
+//-----------------------------------------------------------
+std::string SysHost::CpuFeaturesToString( const CpuFeatures features )
+{
+    static const struct { CpuFeatures feature; const char* name; } NAMES[] = {
+        { CpuFeatures::SSE42   , "sse4.2"   },
+        { CpuFeatures::AVX2    , "avx2"     },
+        { CpuFeatures::BMI2    , "bmi2"     },
+        { CpuFeatures::AVX512F , "avx512f"  },
+        { CpuFeatures::AVX512BW, "avx512bw" },
+        { CpuFeatures::AVX512VL, "avx512vl" },
+        { CpuFeatures::NEON    , "neon"     },
+    };
+
+    std::string str;
+    for( const auto& n : NAMES )
+    {
+        if( ( features & n.feature ) != n.feature )
+            continue;
+
+        if( !str.empty() )
+            str += ' ';
+        str += n.name;
+    }
+
+    return str.empty() ? "baseline" : str;
+}
@@ -11,6 +11,44 @@ enum class VProtect : uint
 };
 ImplementFlagOps( VProtect );
 
+enum class HugePageSize : uint
+{
+    None = 0,       // Regular pages
+    Transparent,    // Regular pages, advised to be backed by transparent huge pages
+    Huge2M,         // Explicit 2MiB huge pages
+    Huge1G,         // Explicit 1GiB huge pages
+};
+
+/// Instruction set extensions that both the CPU and the OS support.
+/// Hot kernels are compiled with function-level target attributes for each extension they have a path for,
+/// and pick the widest one available at runtime through SysHost::HasCpuFeatures, so that a single
+/// binary built for the baseline target still runs its SIMD paths.
+enum class CpuFeatures : uint32
+{
+    None     = 0,
+
+    // x86-64
+    SSE42    = 1 << 0,      // With POPCNT (x86-64-v2)
+    AVX2     = 1 << 1,      // With AVX, BMI1, BMI2, FMA (x86-64-v3)
+    BMI2     = 1 << 2,
+    AVX512F  = 1 << 3,
+    AVX512BW = 1 << 4,      // With AVX512F, CD, DQ, VL (x86-64-v4)
+    AVX512VL = 1 << 5,
+
+    // ARM64
+    NEON     = 1 << 16,
+};
+ImplementFlagOps( CpuFeatures );
+
+/// x86-64 microarchitecture levels, to cap the features the kernels may use
+enum class CpuLevel : uint32
+{
+    Baseline = 0,
+    V2,
+    V3,
+    V4,
+};
+
 struct NumaInfo
 {
     uint        nodeCount;      // How many NUMA nodes in the system
@@ -22,6 +60,23 @@ struct NumaInfo
     #endif
 };
 
+struct CpuInfo
+{
+    uint32 id;                  // Logical CPU id, as passed to SetCurrentThreadAffinityCpuId()
+    uint32 package;             // Physical package (socket)
+    uint32 core;                // Physical core, unique across packages
+    uint32 l3;                  // L3 cache domain, unique across packages (a CCX on Zen parts)
+    uint32 smt;                 // Hardware thread index within its core
+};
+
+struct CpuTopology
+{
+    uint32        packageCount;
+    uint32        coreCount;
+    uint32        l3Count;
+    Span<CpuInfo> cpus;         // Online CPUs, by id
+};
+
 class SysHost
 {
 public:
@@ -29,19 +84,34 @@ public:
     // Get the system page size in bytes
     static size_t GetPageSize();
 
-    // Get total physical system ram in bytes
+    // Get total physical system ram in bytes.
+    // On Linux, this is capped by the process' cgroup memory limit, if any.
     static size_t GetTotalSystemMemory();
 
-    /// Gets the currently available (unused) system ram in bytes
+    /// Gets the currently available (unused) system ram in bytes.
+    /// On Linux, this is capped by what is left under the process' cgroup memory limit, if any.
     static size_t GetAvailableSystemMemory();
 
     /// Get the total number of logical CPUs in the system
     static uint GetLogicalCPUCount();
 
+    /// Get how many CPUs the process can keep busy: the logical CPU count, capped by
+    /// the CPUs it is allowed to run on and, on Linux, its cgroup CPU quota (rounded up).
+    /// Use this to size thread pools by default. CPU ids still range over GetLogicalCPUCount().
+    static uint GetUsableCPUCount();
+
     /// Create an allocation in the virtual memory space
     /// If initialize == true, then all pages are touched so that
     /// the pages are actually assigned.
     static void* VirtualAlloc( size_t size, bool initialize = false );
+
+    /// Same as VirtualAlloc, but attempts to back the allocation with huge pages,
+    /// to cut down on TLB misses when randomly accessing very large buffers.
+    /// If allowExplicitPages is true, 1GiB and then 2MiB pre-allocated (hugetlbfs) pages are tried first.
+    /// Otherwise, or if none are available, regular pages are advised as transparent huge pages.
+    /// Explicit pages must not be bound to NUMA nodes in ranges that are not aligned to their size.
+    /// The allocation is freed with VirtualFree.
+    static void* VirtualAllocHuge( size_t size, bool allowExplicitPages, HugePageSize* outPageSize = nullptr );
     
     static void VirtualFree( void* ptr );
 
@@ -69,6 +139,27 @@ public:
     /// Get system's NUMA info, if it has any
     static const NumaInfo* GetNUMAInfo();
 
+    /// Get which package, core and L3 domain each logical CPU belongs to.
+    /// Where the topology can't be queried, every CPU is reported as its own core, in a single L3 domain.
+    static const CpuTopology& GetCpuTopology();
+
+    /// Get the instruction set extensions the CPU and the OS support, less those above the LimitCpuLevel cap.
+    /// Detected once, on the first call.
+    static CpuFeatures GetCpuFeatures();
+
+    //-----------------------------------------------------------
+    inline static bool HasCpuFeatures( const CpuFeatures features )
+    {
+        return ( GetCpuFeatures() & features ) == features;
+    }
+
+    /// Cap the features reported to those of an x86-64 level. Kernels keep the path they selected
+    /// the first time they ran, so this must be called before any of them do.
+    static void LimitCpuLevel( CpuLevel level );
+
+    /// Space-separated names of the features reported, or "baseline" if there are none
+    static std::string CpuFeaturesToString( CpuFeatures features );
+
     /// Assign memory pages to a NUMA node
     static void NumaAssignPages( void* ptr, size_t size, uint node );
 
@@ -84,4 +175,16 @@ public:
     /// NOTE: Pages must first be faulted on linux.
     static int NumaGetNodeFromPage( void* ptr );
 
-};
\ No newline at end of file
+};
+
+//-----------------------------------------------------------
+inline const char* HugePageSizeToString( const HugePageSize pageSize )
+{
+    switch( pageSize )
+    {
+        case HugePageSize::Huge1G     : return "1GiB huge pages";
+        case HugePageSize::Huge2M     : return "2MiB huge pages";
+        case HugePageSize::Transparent: return "transparent huge pages";
+        default                       : return "regular pages";
+    }
+}
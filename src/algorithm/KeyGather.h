@@ -0,0 +1,76 @@
+#pragma once
+#include "util/Util.h"
+
+#if defined( _MSC_VER ) && !defined( __clang__ )
+    #if defined( _M_X64 ) || defined( _M_IX86 )
+        #include <xmmintrin.h>
+        #define BB_PREFETCH_READ( ptr ) _mm_prefetch( (const char*)(ptr), _MM_HINT_T0 )
+    #else
+        #define BB_PREFETCH_READ( ptr )
+    #endif
+#else
+    #define BB_PREFETCH_READ( ptr ) __builtin_prefetch( (ptr), 0, 3 )
+#endif
+
+///
+/// Permutation of entries by an index key, dst[i] = src[key[i]], as done after sorting on a sort key.
+/// The reads from src are random and nearly always miss the cache, so a plain loop
+/// only has a few misses in flight at a time. The source entries are prefetched
+/// PrefetchDistance entries ahead instead, which keeps enough of them in flight
+/// to cover the DRAM latency, but not so many that they are evicted before being used.
+/// Each call covers a single thread's range, callers split the work as usual.
+///
+struct KeyGather
+{
+    static constexpr uint64 PrefetchDistance = 32;
+
+    template<typename T, typename TKey, uint64 Distance = PrefetchDistance>
+    static void Gather( const TKey* key, const T* src, T* dst, uint64 length );
+
+    // Gathers two sets of entries on the same key in one pass, reading the key only once
+    template<typename T1, typename T2, typename TKey, uint64 Distance = PrefetchDistance>
+    static void Gather2( const TKey* key, const T1* src1, T1* dst1, const T2* src2, T2* dst2, uint64 length );
+};
+
+//-----------------------------------------------------------
+template<typename T, typename TKey, uint64 Distance>
+inline void KeyGather::Gather( const TKey* key, const T* src, T* dst, const uint64 length )
+{
+    const uint64 prefetchEnd = length > Distance ? length - Distance : 0;
+
+    uint64 i = 0;
+    for( ; i < prefetchEnd; i++ )
+    {
+        BB_PREFETCH_READ( src + key[i+Distance] );
+        dst[i] = src[key[i]];
+    }
+
+    for( ; i < length; i++ )
+        dst[i] = src[key[i]];
+}
+
+//-----------------------------------------------------------
+template<typename T1, typename T2, typename TKey, uint64 Distance>
+inline void KeyGather::Gather2( const TKey* key, const T1* src1, T1* dst1, const T2* src2, T2* dst2, const uint64 length )
+{
+    const uint64 prefetchEnd = length > Distance ? length - Distance : 0;
+
+    uint64 i = 0;
+    for( ; i < prefetchEnd; i++ )
+    {
+        const TKey ahead = key[i+Distance];
+        BB_PREFETCH_READ( src1 + ahead );
+        BB_PREFETCH_READ( src2 + ahead );
+
+        const TKey k = key[i];
+        dst1[i] = src1[k];
+        dst2[i] = src2[k];
+    }
+
+    for( ; i < length; i++ )
+    {
+        const TKey k = key[i];
+        dst1[i] = src1[k];
+        dst2[i] = src2[k];
+    }
+}
@@ -1,5 +1,7 @@
 #pragma once
 #include "threading/ThreadPool.h"
+#include "threading/MTJob.h"
+#include "algorithm/StreamingScatter.h"
 #include <cstring>
 
 class RadixSort256
@@ -27,6 +29,9 @@ class RadixSort256
         // For sort key gen jobs
         T2* keyInput;
         T2* keyTmp;
+
+        bool streaming;             // Scatter with non-temporal stores
+        uint32 iterations;          // Digit passes to perform
     };
 
     enum SortMode
@@ -49,6 +54,15 @@ public:
     template<uint32 ThreadCount, typename T1, typename TK, int MaxIter=sizeof( T1 )>
     static void SortWithKey( ThreadPool& pool, const uint32 threadCount, T1* input, T1* tmp, TK* keyInput, TK* keyTmp, uint64 length );
 
+    // Like Sort/SortWithKey, but only the digit passes over the low valueBits are performed.
+    // A valueBits of 0 finds the highest set bit with a parallel scan of the input first.
+    // Passes are skipped in pairs, so that the result lands on the same buffer as with Sort/SortWithKey.
+    template<uint32 ThreadCount, typename T1, int MaxIter=sizeof( T1 )>
+    static void SortTrimmed( ThreadPool& pool, const uint32 threadCount, T1* input, T1* tmp, uint64 length, uint32 valueBits = 0 );
+
+    template<uint32 ThreadCount, typename T1, typename TK, int MaxIter=sizeof( T1 )>
+    static void SortWithKeyTrimmed( ThreadPool& pool, const uint32 threadCount, T1* input, T1* tmp, TK* keyInput, TK* keyTmp, uint64 length, uint32 valueBits = 0 );
+
     template<uint32 ThreadCount>
     static void SortY( ThreadPool& pool, uint64* input, uint64* tmp, uint64 length );
 
@@ -58,13 +72,91 @@ public:
     template<uint32 ThreadCount>
     static void SortYWithKey( ThreadPool& pool, const uint32 threadCount, uint64* input, uint64* tmp, uint32* keyInput, uint32* keyTmp, uint64 length );
 
+    // MSD-first hybrid sort. A single global scatter on the most significant digit
+    // splits the input into L2-sized buckets, which are then LSD-sorted in cache as independent tasks.
+    // Streams through RAM twice instead of once per byte. The output is identical to Sort/SortWithKey
+    // with the same MaxIter, and lands on the same buffer. Small inputs use the regular LSD sort.
+    // A threadCount of 0 uses all of the pool's threads.
+    template<uint32 ThreadCount, typename T1, int MaxIter=sizeof( T1 )>
+    static void SortHybrid( ThreadPool& pool, const uint32 threadCount, T1* input, T1* tmp, uint64 length );
+
+    template<uint32 ThreadCount, typename T1, typename TK, int MaxIter=sizeof( T1 )>
+    static void SortWithKeyHybrid( ThreadPool& pool, const uint32 threadCount, T1* input, T1* tmp, TK* keyInput, TK* keyTmp, uint64 length );
+
+    // Hybrid sort that carries two payload arrays through its scatters along with the values,
+    // instead of generating a sort key and permuting the payloads with it in another pass.
+    // Worth it for small payloads, which cost less to move twice sequentially than to gather once.
+    // Each payload lands on its input or tmp buffer, the same as the values do.
+    // Inputs of any length take the hybrid path.
+    template<uint32 ThreadCount, typename T1, typename TP1, typename TP2, int MaxIter=sizeof( T1 )>
+    static void SortWithPayloadsHybrid( ThreadPool& pool, const uint32 threadCount, T1* input, T1* tmp,
+                                        TP1* p1Input, TP1* p1Tmp, TP2* p2Input, TP2* p2Tmp, uint64 length );
+
+    // Payload hybrid sort for 64-bit values whose bits below the MSD digit fit in 32 bits, such as 38-bit y values.
+    // The MSD bucket already implies a value's high bits, so the scatter only stores the low 32 bits
+    // of each value, in the two halves of tmp, and the buckets are sorted on those. This halves the value
+    // traffic of the scatter and of the bucket passes. Unlike the other sorts, the values always land on input,
+    // widened back to 64 bits, while the payloads land as with SortWithPayloadsHybrid.
+    // Only the low MaxIter bytes of the values are kept, any bits above them must be 0.
+    template<uint32 ThreadCount, typename T1, typename TP1, typename TP2, int MaxIter=sizeof( T1 )>
+    static void SortWithPayloadsNarrow( ThreadPool& pool, const uint32 threadCount, T1* input, T1* tmp,
+                                        TP1* p1Input, TP1* p1Tmp, TP2* p2Input, TP2* p2Tmp, uint64 length );
+
+    // NUMA-partitioned hybrid sort, for buffers whose entries [i*nodeEntryCount, (i+1)*nodeEntryCount) live on node i.
+    // Each node counts the MSD digits of its own partition of the input with its own pool.
+    // The MSD scatter is then the single cross-node exchange, in which every thread writes
+    // one sequential run per bucket. The buckets are finally LSD-sorted by the node that holds
+    // their output. pool only dispatches the nodes, it must have at least nodeCount threads.
+    // The output is identical to the hybrid sort's, and lands on the same buffer.
+    template<uint32 ThreadCount, typename T1, typename TK, int MaxIter=sizeof( T1 )>
+    static void SortWithKeyNuma( ThreadPool& pool, ThreadPool** nodePools, uint32 nodeCount, uint64 nodeEntryCount,
+                                 T1* input, T1* tmp, TK* keyInput, TK* keyTmp, uint64 length );
+
+    template<uint32 ThreadCount, typename T1, typename TP1, typename TP2, int MaxIter=sizeof( T1 )>
+    static void SortWithPayloadsNuma( ThreadPool& pool, ThreadPool** nodePools, uint32 nodeCount, uint64 nodeEntryCount,
+                                      T1* input, T1* tmp, TP1* p1Input, TP1* p1Tmp, TP2* p2Input, TP2* p2Tmp, uint64 length );
+
+    static constexpr uint64 HybridMinLength   = 1ull << 20;   // Below this, the LSD sort already mostly runs in cache
+    static constexpr size_t HybridBucketBytes = 512 * 1024;   // Target size of a bucket and its scatter destination
+    static constexpr uint32 HybridMaxMSDBits  = 16;
+    static constexpr size_t HybridMaxCounts   = 64ull MiB;    // Max size of the per-thread MSD digit counts
+
+    // Sorts at least this large scatter with non-temporal stores, as the destination won't fit in the cache anyway
+    static constexpr size_t StreamingMinBytes = 32ull MiB;
+
 private:
 
+    // TK2 is an optional second key carried along with the first, void when unused
+    template<uint32 ThreadCount, SortMode Mode, typename T1, typename TK, int MaxIter, typename TK2 = void>
+    static void DoSortHybrid( ThreadPool& pool, const uint32 desiredThreadCount, T1* input, T1* tmp, TK* keyInput, TK* keyTmp, uint64 length,
+                              TK2* key2Input = nullptr, TK2* key2Tmp = nullptr );
+
+    template<uint32 ThreadCount, SortMode Mode, typename T1, typename TK, int MaxIter, typename TK2 = void>
+    static void DoSortNuma( ThreadPool& pool, ThreadPool** nodePools, uint32 nodeCount, uint64 nodeEntryCount,
+                            T1* input, T1* tmp, TK* keyInput, TK* keyTmp, uint64 length, TK2* key2Input = nullptr, TK2* key2Tmp = nullptr );
+
+    // MSD digit size that yields buckets which fit in the L2, as much as the count buffers allow
+    static uint32 HybridMSDBits( uint32 threadCount, size_t entrySize, uint64 length, uint32 valueBits );
+
+    template<typename T1, typename TK, bool IsKeyed, typename TK2 = void>
+    static void SortBucketLSD( T1* src, T1* other, TK* keySrc, TK* keyOther, uint64 length, uint32 lsdBits, bool resultInOther,
+                               TK2* key2Src = nullptr, TK2* key2Other = nullptr );
+
     template<uint32 ThreadCount, SortMode Mode, typename T1, typename TK, int MaxIter = sizeof( T1 )>
-    static void DoSort( ThreadPool& pool, const uint32 desiredThreadCount, T1* input, T1* tmp, TK* keyInput, TK* keyTmp, uint64 length );
+    static void DoSort( ThreadPool& pool, const uint32 desiredThreadCount, T1* input, T1* tmp, TK* keyInput, TK* keyTmp, uint64 length, uint32 valueBits = 0 );
 
-    template<typename T1, typename T2, bool IsKeyed, int MaxIter = 0>
+    // Returns the index of the highest bit set in any of the entries, plus one, considering only the low maxBits
+    template<uint32 ThreadCount, typename T1>
+    static uint32 SignificantBits( ThreadPool& pool, uint32 threadCount, const T1* input, uint64 length, uint32 maxBits );
+
+    template<typename T1, typename T2, bool IsKeyed>
     static void RadixSortThread( SortJob<T1,T2>* job );
+
+    template<typename T1, typename T2, bool IsKeyed>
+    static constexpr bool CanScatterStreaming();
+
+    template<typename T1, typename T2, bool IsKeyed>
+    static void ScatterStreaming( const T1* src, const T2* keySrc, T1* dst, T2* keyDst, uint64* prefixSum, uint64 length, uint32 shift );
 };
 
 
@@ -96,6 +188,32 @@ inline void RadixSort256::SortWithKey( ThreadPool& pool, const uint32 threadCoun
     DoSort<ThreadCount, SortAndGenKey, T1, TK, MaxIter>( pool, threadCount, input, tmp, keyInput, keyTmp, length );
 }
 
+//-----------------------------------------------------------
+template<uint32 ThreadCount, typename T1, int MaxIter>
+inline void RadixSort256::SortTrimmed( ThreadPool& pool, const uint32 threadCount, T1* input, T1* tmp, uint64 length, uint32 valueBits )
+{
+    if( valueBits == 0 )
+    {
+        const uint32 scanThreads = threadCount == 0 ? pool.ThreadCount() : std::min( threadCount, pool.ThreadCount() );
+        valueBits = SignificantBits<ThreadCount, T1>( pool, scanThreads, input, length, (uint32)MaxIter * 8 );
+    }
+
+    DoSort<ThreadCount, ModeSingle, T1, void, MaxIter>( pool, threadCount, input, tmp, nullptr, nullptr, length, valueBits );
+}
+
+//-----------------------------------------------------------
+template<uint32 ThreadCount, typename T1, typename TK, int MaxIter>
+inline void RadixSort256::SortWithKeyTrimmed( ThreadPool& pool, const uint32 threadCount, T1* input, T1* tmp, TK* keyInput, TK* keyTmp, uint64 length, uint32 valueBits )
+{
+    if( valueBits == 0 )
+    {
+        const uint32 scanThreads = threadCount == 0 ? pool.ThreadCount() : std::min( threadCount, pool.ThreadCount() );
+        valueBits = SignificantBits<ThreadCount, T1>( pool, scanThreads, input, length, (uint32)MaxIter * 8 );
+    }
+
+    DoSort<ThreadCount, SortAndGenKey, T1, TK, MaxIter>( pool, threadCount, input, tmp, keyInput, keyTmp, length, valueBits );
+}
+
 //-----------------------------------------------------------
 template<uint32 ThreadCount>
 inline void RadixSort256::SortY( ThreadPool& pool, uint64* input, uint64* tmp, uint64 length )
@@ -119,7 +237,7 @@ inline void RadixSort256::SortYWithKey( ThreadPool& pool, const uint32 threadCou
 
 //-----------------------------------------------------------
 template<uint32 ThreadCount, RadixSort256::SortMode Mode, typename T1, typename TK, int MaxIter>
-void inline RadixSort256::DoSort( ThreadPool& pool, const uint32 desiredThreadCount, T1* input, T1* tmp, TK* keyInput, TK* keyTmp, uint64 length )
+void inline RadixSort256::DoSort( ThreadPool& pool, const uint32 desiredThreadCount, T1* input, T1* tmp, TK* keyInput, TK* keyTmp, uint64 length, const uint32 valueBits )
 {
     const uint32 threadCount      = desiredThreadCount == 0 ? pool.ThreadCount() : std::min( desiredThreadCount, pool.ThreadCount() );
     const uint64 entriesPerThread = length / threadCount;
@@ -136,6 +254,15 @@ void inline RadixSort256::DoSort( ThreadPool& pool, const uint32 desiredThreadCo
     std::atomic<uint> finishedCount = 0;
     std::atomic<uint> releaseLock   = 0;
     SortJob<T1, TK> jobs[ThreadCount];
+
+    const bool streaming = length * sizeof( T1 ) >= StreamingMinBytes;
+
+    // Skip the passes over digits that are zero in every entry. An even number of them
+    // is skipped, so that the result still lands on the buffer callers expect.
+    uint32 iterations = (uint32)MaxIter;
+
+    if( valueBits > 0 && valueBits < iterations * 8 )
+        iterations -= ( iterations - (uint32)CDiv( valueBits, 8 ) ) & ~1u;
     
     for( uint i = 0; i < threadCount; i++ )
     {
@@ -154,26 +281,632 @@ void inline RadixSort256::DoSort( ThreadPool& pool, const uint32 desiredThreadCo
 
         job.keyInput = keyInput;
         job.keyTmp   = keyTmp;
+
+        job.streaming  = streaming;
+        job.iterations = iterations;
     }
 
     jobs[threadCount-1].length += trailingEntries;
     
     if constexpr ( Mode == SortAndGenKey )
-        pool.RunJob( RadixSortThread<T1, TK, true, MaxIter>, jobs, threadCount );
+        pool.RunJob( RadixSortThread<T1, TK, true>, jobs, threadCount );
     else
-        pool.RunJob( RadixSortThread<T1, TK, false, MaxIter>, jobs, threadCount );
+        pool.RunJob( RadixSortThread<T1, TK, false>, jobs, threadCount );
+}
+
+//-----------------------------------------------------------
+template<uint32 ThreadCount, typename T1, int MaxIter>
+inline void RadixSort256::SortHybrid( ThreadPool& pool, const uint32 threadCount, T1* input, T1* tmp, uint64 length )
+{
+    DoSortHybrid<ThreadCount, ModeSingle, T1, void, MaxIter>( pool, threadCount, input, tmp, nullptr, nullptr, length );
+}
+
+//-----------------------------------------------------------
+template<uint32 ThreadCount, typename T1, typename TK, int MaxIter>
+inline void RadixSort256::SortWithKeyHybrid( ThreadPool& pool, const uint32 threadCount, T1* input, T1* tmp, TK* keyInput, TK* keyTmp, uint64 length )
+{
+    DoSortHybrid<ThreadCount, SortAndGenKey, T1, TK, MaxIter>( pool, threadCount, input, tmp, keyInput, keyTmp, length );
+}
+
+//-----------------------------------------------------------
+template<uint32 ThreadCount, typename T1, typename TP1, typename TP2, int MaxIter>
+inline void RadixSort256::SortWithPayloadsHybrid( ThreadPool& pool, const uint32 threadCount, T1* input, T1* tmp,
+                                                  TP1* p1Input, TP1* p1Tmp, TP2* p2Input, TP2* p2Tmp, uint64 length )
+{
+    static_assert( MaxIter >= 2, "Payloads are only carried by the hybrid path." );
+    DoSortHybrid<ThreadCount, SortAndGenKey, T1, TP1, MaxIter, TP2>( pool, threadCount, input, tmp, p1Input, p1Tmp, length, p2Input, p2Tmp );
+}
+
+//-----------------------------------------------------------
+template<uint32 ThreadCount, RadixSort256::SortMode Mode, typename T1, typename TK, int MaxIter, typename TK2>
+inline void RadixSort256::DoSortHybrid( ThreadPool& pool, const uint32 desiredThreadCount, T1* input, T1* tmp, TK* keyInput, TK* keyTmp, uint64 length,
+                                        TK2* key2Input, TK2* key2Tmp )
+{
+    static_assert( MaxIter > 0 && MaxIter <= (int)sizeof( T1 ) );
+
+    constexpr bool   IsKeyed   = Mode == SortAndGenKey;
+    constexpr bool   HasKey2   = !std::is_void_v<TK2>;
+    constexpr uint32 SortBits  = (uint32)MaxIter * 8;
+
+    static_assert( IsKeyed || !HasKey2 );
+
+    size_t entrySize = sizeof( T1 );
+    if constexpr ( IsKeyed )
+        entrySize += sizeof( TK );
+    if constexpr ( HasKey2 )
+        entrySize += sizeof( TK2 );
+
+    // The LSD sort has no second key
+    if constexpr ( !HasKey2 )
+    {
+        if( length < HybridMinLength || MaxIter < 2 )
+        {
+            DoSort<ThreadCount, Mode, T1, TK, MaxIter>( pool, desiredThreadCount, input, tmp, keyInput, keyTmp, length );
+            return;
+        }
+    }
+
+    const uint32 threadCount = desiredThreadCount == 0 ? pool.ThreadCount() : std::min( desiredThreadCount, pool.ThreadCount() );
+
+    // Only the bits that are actually in use are sorted, so that the MSD digit
+    // doesn't end up on always-zero bits and yield a few huge buckets.
+    const uint32 valueBits = SignificantBits<ThreadCount, T1>( pool, threadCount, input, length, SortBits );
+
+    const uint32 msdBits     = HybridMSDBits( threadCount, entrySize, length, valueBits );
+    const uint32 msdShift    = valueBits - msdBits;
+    const uint64 bucketCount = 1ull << msdBits;
+    const uint64 digitMask   = bucketCount - 1;
+
+    // The LSD passes start on tmp. Land on the same buffer as the LSD-only sort would.
+    const bool resultInInput = ( MaxIter & 1 ) == 0;
+
+    uint64* counts       = bbcalloc<uint64>( threadCount * bucketCount );
+    uint64* bucketStarts = bbcalloc<uint64>( bucketCount + 1 );
+
+    // Global MSD scatter into tmp
+    AnonMTJob::Run( pool, threadCount, [=]( AnonMTJob* self ) {
+
+        const uint32 id = self->JobId();
+
+        uint64 count, offset, end;
+        GetThreadOffsets( self, length, count, offset, end );
+
+        uint64* tCounts = counts + id * bucketCount;
+        memset( tCounts, 0, sizeof( uint64 ) * bucketCount );
+
+        for( uint64 i = offset; i < end; i++ )
+            tCounts[( input[i] >> msdShift ) & digitMask]++;
+
+        self->SyncThreads();
+
+        // Sum the counts of each bucket across threads
+        uint64 bCount, bOffset, bEnd;
+        GetThreadOffsets( self, bucketCount, bCount, bOffset, bEnd );
+
+        for( uint64 b = bOffset; b < bEnd; b++ )
+        {
+            uint64 total = 0;
+            for( uint32 t = 0; t < threadCount; t++ )
+                total += counts[t * bucketCount + b];
+
+            bucketStarts[b+1] = total;
+        }
+
+        if( self->BeginLockBlock() )
+        {
+            bucketStarts[0] = 0;
+            for( uint64 b = 1; b <= bucketCount; b++ )
+                bucketStarts[b] += bucketStarts[b-1];
+        }
+        self->EndLockBlock();
+
+        // Turn the counts into each thread's write offset in every bucket
+        for( uint64 b = bOffset; b < bEnd; b++ )
+        {
+            uint64 pos = bucketStarts[b];
+            for( uint32 t = 0; t < threadCount; t++ )
+            {
+                const uint64 c = counts[t * bucketCount + b];
+                counts[t * bucketCount + b] = pos;
+                pos += c;
+            }
+        }
+
+        self->SyncThreads();
+
+        // Scatter in order, so that the sort remains stable
+        for( uint64 i = offset; i < end; i++ )
+        {
+            const T1     value  = input[i];
+            const uint64 dstIdx = tCounts[( value >> msdShift ) & digitMask]++;
+
+            tmp[dstIdx] = value;
+
+            if constexpr ( IsKeyed )
+                keyTmp[dstIdx] = keyInput[i];
+
+            if constexpr ( HasKey2 )
+                key2Tmp[dstIdx] = key2Input[i];
+        }
+    });
+
+    // Sort the buckets. Their sizes vary, so let idle threads steal them.
+    const uint64 grainSize = std::max( (uint64)1, bucketCount / ( (uint64)threadCount * 16 ) );
+
+    AnonMTJob::RunRanges( pool, threadCount, bucketCount, grainSize, [=]( AnonMTJob* self, uint64 bOffset, uint64 bCount ) {
+
+        for( uint64 b = bOffset; b < bOffset + bCount; b++ )
+        {
+            const uint64 start = bucketStarts[b];
+            const uint64 count = bucketStarts[b+1] - start;
+
+            if constexpr ( HasKey2 )
+                SortBucketLSD<T1, TK, true, TK2>( tmp + start, input + start, keyTmp + start, keyInput + start, count, msdShift, resultInInput,
+                                                  key2Tmp + start, key2Input + start );
+            else if constexpr ( IsKeyed )
+                SortBucketLSD<T1, TK, true>( tmp + start, input + start, keyTmp + start, keyInput + start, count, msdShift, resultInInput );
+            else
+                SortBucketLSD<T1, TK, false>( tmp + start, input + start, nullptr, nullptr, count, msdShift, resultInInput );
+        }
+    });
+
+    free( counts );
+    free( bucketStarts );
+}
+
+//-----------------------------------------------------------
+template<uint32 ThreadCount, typename T1, typename TP1, typename TP2, int MaxIter>
+inline void RadixSort256::SortWithPayloadsNarrow( ThreadPool& pool, const uint32 desiredThreadCount, T1* input, T1* tmp,
+                                                  TP1* p1Input, TP1* p1Tmp, TP2* p2Input, TP2* p2Tmp, const uint64 length )
+{
+    static_assert( sizeof( T1 ) == sizeof( uint64 ) && MaxIter >= 2 && MaxIter <= 6, "Narrow sorts require at most 16 MSD bits above 32." );
+
+    constexpr uint32 SortBits  = (uint32)MaxIter * 8;
+    constexpr size_t EntrySize = sizeof( uint32 ) + sizeof( TP1 ) + sizeof( TP2 );
+
+    const uint32 threadCount = desiredThreadCount == 0 ? pool.ThreadCount() : std::min( desiredThreadCount, pool.ThreadCount() );
+    const uint32 valueBits   = SignificantBits<ThreadCount, T1>( pool, threadCount, input, length, SortBits );
+
+    // The MSD digit must cover every bit above the low 32
+    uint32 msdBits = HybridMSDBits( threadCount, EntrySize, length, valueBits );
+    if( valueBits > 32 )
+        msdBits = std::max( msdBits, valueBits - 32 );
+
+    const uint32 msdShift    = valueBits - msdBits;
+    const uint64 bucketCount = 1ull << msdBits;
+    const uint64 digitMask   = bucketCount - 1;
+    const uint64 lowMask     = ( 1ull << msdShift ) - 1;
+
+    // Payloads land on the same buffer as with the other sorts
+    const bool payloadsInInput = ( MaxIter & 1 ) == 0;
+
+    uint32* low    = (uint32*)tmp;
+    uint32* lowAlt = low + length;
+
+    uint64* counts       = bbcalloc<uint64>( threadCount * bucketCount );
+    uint64* bucketStarts = bbcalloc<uint64>( bucketCount + 1 );
+
+    // Global MSD scatter of the low bits into tmp
+    AnonMTJob::Run( pool, threadCount, [=]( AnonMTJob* self ) {
+
+        const uint32 id = self->JobId();
+
+        uint64 count, offset, end;
+        GetThreadOffsets( self, length, count, offset, end );
+
+        uint64* tCounts = counts + id * bucketCount;
+        memset( tCounts, 0, sizeof( uint64 ) * bucketCount );
+
+        for( uint64 i = offset; i < end; i++ )
+            tCounts[( input[i] >> msdShift ) & digitMask]++;
+
+        self->SyncThreads();
+
+        uint64 bCount, bOffset, bEnd;
+        GetThreadOffsets( self, bucketCount, bCount, bOffset, bEnd );
+
+        for( uint64 b = bOffset; b < bEnd; b++ )
+        {
+            uint64 total = 0;
+            for( uint32 t = 0; t < threadCount; t++ )
+                total += counts[t * bucketCount + b];
+
+            bucketStarts[b+1] = total;
+        }
+
+        if( self->BeginLockBlock() )
+        {
+            bucketStarts[0] = 0;
+            for( uint64 b = 1; b <= bucketCount; b++ )
+                bucketStarts[b] += bucketStarts[b-1];
+        }
+        self->EndLockBlock();
+
+        for( uint64 b = bOffset; b < bEnd; b++ )
+        {
+            uint64 pos = bucketStarts[b];
+            for( uint32 t = 0; t < threadCount; t++ )
+            {
+                const uint64 c = counts[t * bucketCount + b];
+                counts[t * bucketCount + b] = pos;
+                pos += c;
+            }
+        }
+
+        self->SyncThreads();
+
+        for( uint64 i = offset; i < end; i++ )
+        {
+            const T1     value  = input[i];
+            const uint64 dstIdx = tCounts[( value >> msdShift ) & digitMask]++;
+
+            low  [dstIdx] = (uint32)value;
+            p1Tmp[dstIdx] = p1Input[i];
+            p2Tmp[dstIdx] = p2Input[i];
+        }
+    });
+
+    // Sort the buckets on their low bits, then widen them back onto input, which is free after the scatter
+    const uint64 grainSize = std::max( (uint64)1, bucketCount / ( (uint64)threadCount * 16 ) );
+
+    AnonMTJob::RunRanges( pool, threadCount, bucketCount, grainSize, [=]( AnonMTJob* self, uint64 bOffset, uint64 bCount ) {
+
+        for( uint64 b = bOffset; b < bOffset + bCount; b++ )
+        {
+            const uint64 start = bucketStarts[b];
+            const uint64 count = bucketStarts[b+1] - start;
+
+            SortBucketLSD<uint32, TP1, true, TP2>( low + start, lowAlt + start, p1Tmp + start, p1Input + start, count, msdShift, payloadsInInput,
+                                                   p2Tmp + start, p2Input + start );
+
+            const uint32* sorted = ( payloadsInInput ? lowAlt : low ) + start;
+            const T1      high   = (T1)b << msdShift;
+            T1*           dst    = input + start;
+
+            for( uint64 i = 0; i < count; i++ )
+                dst[i] = high | ( sorted[i] & lowMask );
+        }
+    });
+
+    free( counts );
+    free( bucketStarts );
+}
+
+//-----------------------------------------------------------
+template<uint32 ThreadCount, typename T1, typename TK, int MaxIter>
+inline void RadixSort256::SortWithKeyNuma( ThreadPool& pool, ThreadPool** nodePools, const uint32 nodeCount, const uint64 nodeEntryCount,
+                                           T1* input, T1* tmp, TK* keyInput, TK* keyTmp, const uint64 length )
+{
+    DoSortNuma<ThreadCount, SortAndGenKey, T1, TK, MaxIter>( pool, nodePools, nodeCount, nodeEntryCount, input, tmp, keyInput, keyTmp, length );
+}
+
+//-----------------------------------------------------------
+template<uint32 ThreadCount, typename T1, typename TP1, typename TP2, int MaxIter>
+inline void RadixSort256::SortWithPayloadsNuma( ThreadPool& pool, ThreadPool** nodePools, const uint32 nodeCount, const uint64 nodeEntryCount,
+                                                T1* input, T1* tmp, TP1* p1Input, TP1* p1Tmp, TP2* p2Input, TP2* p2Tmp, const uint64 length )
+{
+    static_assert( MaxIter >= 2, "Payloads are only carried by the hybrid path." );
+    DoSortNuma<ThreadCount, SortAndGenKey, T1, TP1, MaxIter, TP2>( pool, nodePools, nodeCount, nodeEntryCount,
+                                                                   input, tmp, p1Input, p1Tmp, length, p2Input, p2Tmp );
+}
+
+//-----------------------------------------------------------
+template<uint32 ThreadCount, RadixSort256::SortMode Mode, typename T1, typename TK, int MaxIter, typename TK2>
+inline void RadixSort256::DoSortNuma( ThreadPool& pool, ThreadPool** nodePools, const uint32 nodeCount, const uint64 nodeEntryCount,
+                                      T1* input, T1* tmp, TK* keyInput, TK* keyTmp, const uint64 length, TK2* key2Input, TK2* key2Tmp )
+{
+    static_assert( MaxIter > 0 && MaxIter <= (int)sizeof( T1 ) );
+
+    constexpr bool   IsKeyed   = Mode == SortAndGenKey;
+    constexpr bool   HasKey2   = !std::is_void_v<TK2>;
+    constexpr uint32 SortBits  = (uint32)MaxIter * 8;
+
+    static_assert( IsKeyed || !HasKey2 );
+
+    if( nodeCount < 2 || nodeEntryCount == 0 || length < HybridMinLength || MaxIter < 2 || pool.ThreadCount() < nodeCount )
+    {
+        DoSortHybrid<ThreadCount, Mode, T1, TK, MaxIter, TK2>( pool, 0, input, tmp, keyInput, keyTmp, length, key2Input, key2Tmp );
+        return;
+    }
+
+    size_t entrySize = sizeof( T1 );
+    if constexpr ( IsKeyed )
+        entrySize += sizeof( TK );
+    if constexpr ( HasKey2 )
+        entrySize += sizeof( TK2 );
+
+    // Threads are numbered across all nodes, in node order, so that the scatter stays stable
+    uint32* nodeThreadStart = bbcalloc<uint32>( nodeCount + 1 );
+    uint64* nodeBucketStart = bbcalloc<uint64>( nodeCount + 1 );
+
+    nodeThreadStart[0] = 0;
+    for( uint32 n = 0; n < nodeCount; n++ )
+        nodeThreadStart[n+1] = nodeThreadStart[n] + nodePools[n]->ThreadCount();
+
+    const uint32 threadCount = nodeThreadStart[nodeCount];
+
+    // Runs func( self, globalThreadId, offset, end ) over each node's partition of the input, on that node's pool
+    auto runOnNodes = [&]( auto&& func ) {
+        AnonMTJob::Run( pool, nodeCount, [&]( AnonMTJob* nodeJob ) {
+
+            const uint32 node  = nodeJob->JobId();
+            const uint64 start = std::min( length, nodeEntryCount * node );
+            const uint64 end   = node == nodeCount - 1 ? length : std::min( length, start + nodeEntryCount );
+
+            ThreadPool& nodePool = *nodePools[node];
+
+            AnonMTJob::Run( nodePool, nodePool.ThreadCount(), [&]( AnonMTJob* self ) {
+
+                uint64 count, offset, tEnd;
+                GetThreadOffsets( self, end - start, count, offset, tEnd );
+
+                func( self, nodeThreadStart[node] + self->JobId(), start + offset, start + tEnd );
+            });
+        });
+    };
+
+    const uint32 valueBits   = SignificantBits<ThreadCount, T1>( pool, pool.ThreadCount(), input, length, SortBits );
+    const uint32 msdBits     = HybridMSDBits( threadCount, entrySize, length, valueBits );
+    const uint32 msdShift    = valueBits - msdBits;
+    const uint64 bucketCount = 1ull << msdBits;
+    const uint64 digitMask   = bucketCount - 1;
+
+    const bool resultInInput = ( MaxIter & 1 ) == 0;
+
+    uint64* counts       = bbcalloc<uint64>( (uint64)threadCount * bucketCount );
+    uint64* bucketStarts = bbcalloc<uint64>( bucketCount + 1 );
+
+    // Node-local MSD digit counts
+    runOnNodes( [=]( AnonMTJob* self, const uint32 tId, const uint64 offset, const uint64 end ) {
+
+        uint64* tCounts = counts + (uint64)tId * bucketCount;
+        memset( tCounts, 0, sizeof( uint64 ) * bucketCount );
+
+        for( uint64 i = offset; i < end; i++ )
+            tCounts[( input[i] >> msdShift ) & digitMask]++;
+    });
+
+    // Turn the counts into each thread's write offset in every bucket, and find the buckets of each node's output
+    AnonMTJob::Run( pool, [=]( AnonMTJob* self ) {
+
+        uint64 bCount, bOffset, bEnd;
+        GetThreadOffsets( self, bucketCount, bCount, bOffset, bEnd );
+
+        for( uint64 b = bOffset; b < bEnd; b++ )
+        {
+            uint64 total = 0;
+            for( uint32 t = 0; t < threadCount; t++ )
+                total += counts[(uint64)t * bucketCount + b];
+
+            bucketStarts[b+1] = total;
+        }
+
+        if( self->BeginLockBlock() )
+        {
+            bucketStarts[0] = 0;
+            for( uint64 b = 1; b <= bucketCount; b++ )
+                bucketStarts[b] += bucketStarts[b-1];
+
+            // A bucket is sorted by the node its first entry lands on
+            uint64 b = 0;
+            for( uint32 n = 0; n < nodeCount; n++ )
+            {
+                nodeBucketStart[n] = b;
+                while( b < bucketCount && std::min( (uint64)nodeCount - 1, bucketStarts[b] / nodeEntryCount ) == n )
+                    b++;
+            }
+            nodeBucketStart[nodeCount] = bucketCount;
+        }
+        self->EndLockBlock();
+
+        for( uint64 b = bOffset; b < bEnd; b++ )
+        {
+            uint64 pos = bucketStarts[b];
+            for( uint32 t = 0; t < threadCount; t++ )
+            {
+                const uint64 c = counts[(uint64)t * bucketCount + b];
+                counts[(uint64)t * bucketCount + b] = pos;
+                pos += c;
+            }
+        }
+    });
+
+    // The cross-node exchange: each thread reads its node-local partition in order
+    // and writes a sequential run into every bucket
+    runOnNodes( [=]( AnonMTJob* self, const uint32 tId, const uint64 offset, const uint64 end ) {
+
+        uint64* tCounts = counts + (uint64)tId * bucketCount;
+
+        for( uint64 i = offset; i < end; i++ )
+        {
+            const T1     value  = input[i];
+            const uint64 dstIdx = tCounts[( value >> msdShift ) & digitMask]++;
+
+            tmp[dstIdx] = value;
+
+            if constexpr ( IsKeyed )
+                keyTmp[dstIdx] = keyInput[i];
+
+            if constexpr ( HasKey2 )
+                key2Tmp[dstIdx] = key2Input[i];
+        }
+    });
+
+    // Node-local LSD passes over the buckets each node holds, stealing only from the same node
+    AnonMTJob::Run( pool, nodeCount, [=]( AnonMTJob* nodeJob ) {
+
+        const uint32 node        = nodeJob->JobId();
+        const uint64 firstBucket = nodeBucketStart[node];
+        const uint64 nodeBuckets = nodeBucketStart[node+1] - firstBucket;
+
+        if( nodeBuckets == 0 )
+            return;
+
+        ThreadPool&  nodePool  = *nodePools[node];
+        const uint64 grainSize = std::max( (uint64)1, nodeBuckets / ( (uint64)nodePool.ThreadCount() * 16 ) );
+
+        AnonMTJob::RunRanges( nodePool, nodePool.ThreadCount(), nodeBuckets, grainSize, [=]( AnonMTJob* self, uint64 bOffset, uint64 bCount ) {
+
+            for( uint64 b = firstBucket + bOffset; b < firstBucket + bOffset + bCount; b++ )
+            {
+                const uint64 start = bucketStarts[b];
+                const uint64 count = bucketStarts[b+1] - start;
+
+                if constexpr ( HasKey2 )
+                    SortBucketLSD<T1, TK, true, TK2>( tmp + start, input + start, keyTmp + start, keyInput + start, count, msdShift, resultInInput,
+                                                      key2Tmp + start, key2Input + start );
+                else if constexpr ( IsKeyed )
+                    SortBucketLSD<T1, TK, true>( tmp + start, input + start, keyTmp + start, keyInput + start, count, msdShift, resultInInput );
+                else
+                    SortBucketLSD<T1, TK, false>( tmp + start, input + start, nullptr, nullptr, count, msdShift, resultInInput );
+            }
+        });
+    });
+
+    free( counts );
+    free( bucketStarts );
+    free( nodeThreadStart );
+    free( nodeBucketStart );
+}
+
+//-----------------------------------------------------------
+inline uint32 RadixSort256::HybridMSDBits( const uint32 threadCount, const size_t entrySize, const uint64 length, const uint32 valueBits )
+{
+    // Pick the MSD digit size that yields buckets which fit in the L2, as much as the count buffers allow
+    const uint64 bucketTarget = std::max( (uint64)1, (uint64)( HybridBucketBytes / ( 2 * entrySize ) ) );
+
+    uint32 msdBits = 8;
+    while( msdBits < HybridMaxMSDBits && ( bucketTarget << msdBits ) < length )
+        msdBits++;
+
+    while( msdBits > 8 && (size_t)threadCount * ( 1ull << msdBits ) * sizeof( uint64 ) > HybridMaxCounts )
+        msdBits--;
+
+    return std::min( msdBits, valueBits );
+}
+
+//-----------------------------------------------------------
+template<uint32 ThreadCount, typename T1>
+inline uint32 RadixSort256::SignificantBits( ThreadPool& pool, const uint32 threadCount, const T1* input, const uint64 length, const uint32 maxBits )
+{
+    ASSERT( maxBits > 0 && maxBits <= sizeof( T1 ) * 8 );
+
+    const T1 mask = maxBits == sizeof( T1 ) * 8 ? (T1)~(T1)0 : (T1)( ( (T1)1 << maxBits ) - 1 );
+
+    T1 usedBits[ThreadCount];
+
+    AnonMTJob::Run( pool, threadCount, [=, &usedBits]( AnonMTJob* self ) {
+
+        uint64 count, offset, end;
+        GetThreadOffsets( self, length, count, offset, end );
+
+        T1 bits = 0;
+        for( uint64 i = offset; i < end; i++ )
+            bits |= input[i];
+
+        usedBits[self->JobId()] = bits & mask;
+    });
+
+    T1 allBits = 0;
+    for( uint32 i = 0; i < threadCount; i++ )
+        allBits |= usedBits[i];
+
+    uint32 valueBits = 1;
+    while( valueBits < maxBits && ( allBits >> valueBits ) != 0 )
+        valueBits++;
+
+    return valueBits;
+}
+
+///
+/// LSD-sorts a bucket on its low lsdBits, ping-ponging between src and other.
+/// Passes on bytes shared by all entries are skipped.
+///
+//-----------------------------------------------------------
+template<typename T1, typename TK, bool IsKeyed, typename TK2>
+inline void RadixSort256::SortBucketLSD( T1* src, T1* other, TK* keySrc, TK* keyOther, const uint64 length, const uint32 lsdBits, const bool resultInOther,
+                                         TK2* key2Src, TK2* key2Other )
+{
+    constexpr uint32 Radix   = 256;
+    constexpr bool   HasKey2 = !std::is_void_v<TK2>;
+
+    T1* const dstFinal = resultInOther ? other : src;
+
+    T1*  cur     = src;
+    T1*  alt     = other;
+    TK*  keyCur  = keySrc;
+    TK*  keyAlt  = keyOther;
+    TK2* key2Cur = key2Src;
+    TK2* key2Alt = key2Other;
+
+    if( length > 1 )
+    {
+        uint64 counts[Radix];
+
+        for( uint32 shift = 0; shift < lsdBits; shift += 8 )
+        {
+            memset( counts, 0, sizeof( counts ) );
+
+            for( uint64 i = 0; i < length; i++ )
+                counts[(cur[i] >> shift) & 0xFF]++;
+
+            if( counts[(cur[0] >> shift) & 0xFF] == length )
+                continue;
+
+            uint64 pos = 0;
+            for( uint32 j = 0; j < Radix; j++ )
+            {
+                const uint64 c = counts[j];
+                counts[j] = pos;
+                pos += c;
+            }
+
+            for( uint64 i = 0; i < length; i++ )
+            {
+                const T1     value  = cur[i];
+                const uint64 dstIdx = counts[(value >> shift) & 0xFF]++;
+
+                alt[dstIdx] = value;
+
+                if constexpr ( IsKeyed )
+                    keyAlt[dstIdx] = keyCur[i];
+
+                if constexpr ( HasKey2 )
+                    key2Alt[dstIdx] = key2Cur[i];
+            }
+
+            std::swap( cur, alt );
+
+            if constexpr ( IsKeyed )
+                std::swap( keyCur, keyAlt );
+
+            if constexpr ( HasKey2 )
+                std::swap( key2Cur, key2Alt );
+        }
+    }
+
+    if( cur != dstFinal )
+    {
+        memcpy( dstFinal, cur, length * sizeof( T1 ) );
+
+        if constexpr ( IsKeyed )
+            memcpy( keyAlt, keyCur, length * sizeof( TK ) );
+
+        if constexpr ( HasKey2 )
+            memcpy( key2Alt, key2Cur, length * sizeof( TK2 ) );
+    }
 }
 
 #pragma GCC diagnostic push 
 #pragma GCC diagnostic ignored "-Wunused-but-set-variable"
 
 //-----------------------------------------------------------
-template<typename T1, typename T2, bool IsKeyed, int MaxIter>
+template<typename T1, typename T2, bool IsKeyed>
 void RadixSort256::RadixSortThread( SortJob<T1, T2>* job )
 {
     constexpr uint Radix = 256;
 
-    constexpr uint32 iterations = MaxIter > 0 ? MaxIter : sizeof( T1 );
+    const     uint32 iterations = job->iterations;
     const     uint32 shiftBase  = 8;
     
     uint32 shift = 0;
@@ -292,19 +1025,37 @@ void RadixSort256::RadixSortThread( SortJob<T1, T2>* job )
         // This can cause false sharing, but given that our inputs are
         // extremely large, and the accesses are random, we don't expect
         // a lot of this to be happening.
-        for( uint64 i = length; i > 0; )
+        bool streamed = false;
+
+        if constexpr ( CanScatterStreaming<T1, T2, IsKeyed>() )
         {
-            // Read the value & prefix sum index
-            const T1 value = src[--i];
+            if( job->streaming )
+            {
+                if constexpr ( IsKeyed )
+                    ScatterStreaming<T1, T2, true>( src, keySrc, tmp, keyTmp, prefixSum, length, shift );
+                else
+                    ScatterStreaming<T1, T2, false>( src, nullptr, tmp, nullptr, prefixSum, length, shift );
 
-            const uint64 idx = (value >> shift) & 0xFF;
+                streamed = true;
+            }
+        }
 
-            // Store it at the right location by reading the count
-            const uint64 dstIdx = --prefixSum[idx];
-            tmp[dstIdx] = value;
+        if( !streamed )
+        {
+            for( uint64 i = length; i > 0; )
+            {
+                // Read the value & prefix sum index
+                const T1 value = src[--i];
 
-            if constexpr ( IsKeyed )
-                keyTmp[dstIdx] = keySrc[i];
+                const uint64 idx = (value >> shift) & 0xFF;
+
+                // Store it at the right location by reading the count
+                const uint64 dstIdx = --prefixSum[idx];
+                tmp[dstIdx] = value;
+
+                if constexpr ( IsKeyed )
+                    keyTmp[dstIdx] = keySrc[i];
+            }
         }
 
         // Swap arrays
@@ -353,4 +1104,51 @@ void RadixSort256::RadixSortThread( SortJob<T1, T2>* job )
 
 #pragma GCC diagnostic pop
 
+//-----------------------------------------------------------
+template<typename T1, typename T2, bool IsKeyed>
+constexpr bool RadixSort256::CanScatterStreaming()
+{
+    if constexpr ( IsKeyed )
+        return StreamingScatter<T1, 256>::Supported && StreamingScatter<T2, 256>::Supported;
+    else
+        return StreamingScatter<T1, 256>::Supported;
+}
+
+//-----------------------------------------------------------
+template<typename T1, typename T2, bool IsKeyed>
+inline void RadixSort256::ScatterStreaming( const T1* src, const T2* keySrc, T1* dst, T2* keyDst, uint64* prefixSum, const uint64 length, const uint32 shift )
+{
+    constexpr uint32 Radix = 256;
+
+    StreamingScatter<T1, Radix> values( dst, prefixSum );
+
+    if constexpr ( IsKeyed )
+    {
+        StreamingScatter<T2, Radix> keys( keyDst, prefixSum );
+
+        for( uint64 i = length; i > 0; )
+        {
+            const T1     value  = src[--i];
+            const uint32 digit  = (uint32)( (value >> shift) & 0xFF );
+            const uint64 dstIdx = --prefixSum[digit];
+
+            values.Write( digit, dstIdx, value );
+            keys  .Write( digit, dstIdx, keySrc[i] );
+        }
+
+        keys.Flush();
+    }
+    else
+    {
+        for( uint64 i = length; i > 0; )
+        {
+            const T1     value  = src[--i];
+            const uint32 digit  = (uint32)( (value >> shift) & 0xFF );
+            const uint64 dstIdx = --prefixSum[digit];
+
+            values.Write( digit, dstIdx, value );
+        }
+    }
 
+    values.Flush();
+}
@@ -0,0 +1,127 @@
+#pragma once
+#include "util/Util.h"
+#include <cstring>
+
+#if defined( __x86_64__ ) || defined( _M_X64 )
+    #define BB_STREAMING_STORE_SSE2 1
+    #include <emmintrin.h>
+#elif ( defined( __aarch64__ ) ) && ( defined( __GNUC__ ) || defined( __clang__ ) )
+    #define BB_STREAMING_STORE_STNP 1
+#endif
+
+///
+/// Software write-combining for the scatter step of radix sorts.
+/// Entries are staged in a cache line-sized buffer for each digit, and complete lines
+/// are written with non-temporal stores. That avoids the read-for-ownership of the destination
+/// lines and keeps the scatter from evicting the source and the counts from the cache.
+/// Lines which are only partially written, which may be shared with other threads or digits,
+/// are written with regular stores.
+///
+/// Used for scatters that walk backwards, decrementing the write offset of each digit.
+/// Flush() must be called before other threads read the destination.
+/// Lines are aligned in memory, so dst itself need not be aligned.
+///
+template<typename T, uint32 Radix>
+class StreamingScatter
+{
+public:
+    static constexpr size_t LineSize    = 64;
+    static constexpr uint32 LineEntries = (uint32)( LineSize / sizeof( T ) );
+
+    // False if T can't be packed into lines, in which case this must not be used
+    static constexpr bool   Supported   = sizeof( T ) <= LineSize && LineSize % sizeof( T ) == 0;
+
+    //-----------------------------------------------------------
+    // Takes the exclusive end offset of each digit in dst, before any entries are written
+    template<typename TIdx>
+    inline StreamingScatter( T* dst, const TIdx* digitEnds )
+        : _dst( dst )
+        , _slotOffset( (uint32)( (uintptr_t)dst / sizeof( T ) ) & ( LineEntries - 1 ) )
+    {
+        static_assert( Supported );
+
+        for( uint32 i = 0; i < Radix; i++ )
+            _top[i] = _cur[i] = (uint64)digitEnds[i];
+    }
+
+    //-----------------------------------------------------------
+    inline void Write( const uint32 digit, const uint64 dstIdx, const T value )
+    {
+        const uint32 slot = Slot( dstIdx );
+
+        _lines[digit][slot] = value;
+        _cur[digit]         = dstIdx;
+
+        if( slot == 0 )
+        {
+            const uint64 count = _top[digit] - dstIdx;
+
+            if( count == LineEntries )
+                StreamLine( _dst + dstIdx, _lines[digit] );
+            else
+                memcpy( _dst + dstIdx, _lines[digit], count * sizeof( T ) );
+
+            _top[digit] = dstIdx;
+        }
+    }
+
+    //-----------------------------------------------------------
+    // Writes the remaining partial lines and orders the streamed stores before any later stores
+    inline void Flush()
+    {
+        for( uint32 i = 0; i < Radix; i++ )
+        {
+            const uint64 cur = _cur[i];
+
+            if( cur < _top[i] )
+                memcpy( _dst + cur, &_lines[i][Slot( cur )], ( _top[i] - cur ) * sizeof( T ) );
+
+            _top[i] = cur;
+        }
+
+    #if BB_STREAMING_STORE_SSE2
+        _mm_sfence();
+    #elif BB_STREAMING_STORE_STNP
+        __asm__ volatile( "dmb ishst" ::: "memory" );
+    #endif
+    }
+
+private:
+    //-----------------------------------------------------------
+    inline uint32 Slot( const uint64 dstIdx ) const
+    {
+        return ( (uint32)dstIdx + _slotOffset ) & ( LineEntries - 1 );
+    }
+
+    //-----------------------------------------------------------
+    inline static void StreamLine( T* dst, const T* line )
+    {
+    #if BB_STREAMING_STORE_SSE2
+        const __m128i* src = (const __m128i*)line;
+              __m128i* out = (__m128i*)dst;
+
+        for( size_t i = 0; i < LineSize / 16; i++ )
+            _mm_stream_si128( out + i, _mm_load_si128( src + i ) );
+
+    #elif BB_STREAMING_STORE_STNP
+        const byte* src = (const byte*)line;
+              byte* out = (byte*)dst;
+
+        for( size_t i = 0; i < LineSize; i += 32 )
+        {
+            __asm__ volatile( "ldp q0, q1, [%1]\n\tstnp q0, q1, [%0]"
+                :: "r"( out + i ), "r"( src + i )
+                : "v0", "v1", "memory" );
+        }
+    #else
+        memcpy( dst, line, LineSize );
+    #endif
+    }
+
+private:
+    alignas( LineSize ) T _lines[Radix][LineEntries];
+    uint64                _top[Radix];           // Exclusive end of the entries buffered in each line
+    uint64                _cur[Radix];           // Last offset written for each digit
+    T*                    _dst;
+    uint32                _slotOffset;           // Slot of dst within its cache line
+};
@@ -1,11 +1,15 @@
 #include "YSort.h"
 #include "SysHost.h"
 #include "threading/ThreadPool.h"
+#include "threading/TreeBarrier.h"
 #include "util/Util.h"
 #include "util/Log.h"
 #include "Config.h"
 #include "ChiaConsts.h"
+#include "algorithm/StreamingScatter.h"
 
+// Sorts at least this large scatter the buckets with non-temporal stores (see RadixSort256)
+static constexpr uint64 StreamingMinBytes = 32ull MiB;
 
 template<typename JobT>
 struct SortYBaseJob
@@ -14,6 +18,7 @@ struct SortYBaseJob
 
     std::atomic<uint>* finishedCount;
     std::atomic<uint>* releaseLock;
+    TreeBarrier*       barrier;         // Used instead of the counters above at high thread counts
 
     // #TODO: Convert these to a pointer of pointers so that we don't have to
     //        load to iterate on the job struct itself, which is really heavy,
@@ -37,6 +42,7 @@ protected:
 struct SortYJob : SortYBaseJob<SortYJob>
 {
     uint64  length;     // Total entries length
+    bool    streaming;  // Scatter the buckets with non-temporal stores
 
     uint64* input;
     uint64* tmp;
@@ -131,6 +137,9 @@ void YSorter::DoSort( bool useSortKey, uint64 length,
     std::atomic<uint> finishedCount = 0;
     std::atomic<uint> releaseLock   = 0;
 
+    TreeBarrier barrier;
+    barrier.Init( pool, threadCount );
+
     for( uint i = 0; i < MAX_THREADS; i++ )
     {
         SortYJob& job = jobs[i];
@@ -138,12 +147,14 @@ void YSorter::DoSort( bool useSortKey, uint64 length,
         job.jobs          = jobs;
         job.finishedCount = &finishedCount;
         job.releaseLock   = &releaseLock;
+        job.barrier       = &barrier;
         job.length        = length;
         job.counts        = nullptr;
         job.pfxSum        = nullptr;
         job.id            = i;
         job.threadCount   = threadCount;
         job.length        = length;
+        job.streaming     = length * sizeof( uint64 ) >= StreamingMinBytes;
         job.input         = yBuffer;
         job.tmp           = yTmp;
         
@@ -379,26 +390,54 @@ FORCE_INLINE void SortYJob::SortBucket( const uint64 bucket, const uint offset,
     src = (uint32*)start;
     YT* dst = tmp + bucketOffset;
     
-    uint32* keyDst;
+    uint32* keyDst = nullptr;
     if constexpr ( HasSortKey )
         keyDst = sortKeyTmp + bucketOffset;
 
-    for( uint64 i = length; i > 0; )
+    if( streaming )
     {
-        YT value = src[--i];
-        const byte cIdx = (byte)( value >> shift );
+        StreamingScatter<YT, Radix> values( dst, pfxSum );
+        StreamingScatter<uint32, Radix> keys( keyDst, pfxSum );
+
+        for( uint64 i = length; i > 0; )
+        {
+            YT value = src[--i];
+            const byte cIdx = (byte)( value >> shift );
 
-        const uint32 dstIdx = --pfxSum[cIdx];
+            const uint32 dstIdx = --pfxSum[cIdx];
 
-        // Expand with bucket id
-        if constexpr ( std::is_same<YT, uint64>::value )
-            value |= bucket;
+            if constexpr ( std::is_same<YT, uint64>::value )
+                value |= bucket;
 
-        dst[dstIdx] = value;
+            values.Write( cIdx, dstIdx, value );
 
+            if constexpr ( HasSortKey )
+                keys.Write( cIdx, dstIdx, keySrc[i] );
+        }
+
+        values.Flush();
         if constexpr ( HasSortKey )
-            keyDst[dstIdx] = keySrc[i];
+            keys.Flush();
+    }
+    else
+    {
+        for( uint64 i = length; i > 0; )
+        {
+            YT value = src[--i];
+            const byte cIdx = (byte)( value >> shift );
+
+            const uint32 dstIdx = --pfxSum[cIdx];
+
+            // Expand with bucket id
+            if constexpr ( std::is_same<YT, uint64>::value )
+                value |= bucket;
+
+            dst[dstIdx] = value;
 
+            if constexpr ( HasSortKey )
+                keyDst[dstIdx] = keySrc[i];
+
+        }
     }
 
     SyncThreads();
@@ -452,6 +491,19 @@ FORCE_INLINE void SortYBaseJob<JobT>::CalculatePrefixSum( uint id, uint32* count
 template<typename JobT>
 FORCE_INLINE void SortYBaseJob<JobT>::SyncThreads()
 {
+    if( barrier->IsActive( threadCount ) )
+    {
+        if( id == 0 )
+        {
+            barrier->WaitForArrivals();
+            barrier->Release();
+        }
+        else
+            barrier->ArriveAndWait( id );
+
+        return;
+    }
+
     auto& finishedCount        = *this->finishedCount;
     auto& releaseLock          = *this->releaseLock;
     const uint threadThreshold = this->threadCount - 1;
@@ -487,6 +539,12 @@ FORCE_INLINE void SortYBaseJob<JobT>::SyncThreads()
 template<typename JobT>
 FORCE_INLINE void SortYBaseJob<JobT>::LockThreads()
 {
+    if( barrier->IsActive( threadCount ) )
+    {
+        barrier->WaitForArrivals();
+        return;
+    }
+
     auto& finishedCount        = *this->finishedCount;
     const uint threadThreshold = this->threadCount - 1;
     
@@ -498,6 +556,12 @@ FORCE_INLINE void SortYBaseJob<JobT>::LockThreads()
 template<typename JobT>
 FORCE_INLINE void SortYBaseJob<JobT>::ReleaseThreads()
 {
+    if( barrier->IsActive( threadCount ) )
+    {
+        barrier->Release();
+        return;
+    }
+
     auto& finishedCount = *this->finishedCount;
     auto& releaseLock   = *this->releaseLock;
 
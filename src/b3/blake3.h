@@ -49,6 +49,15 @@ void blake3_hasher_finalize(const blake3_hasher *self, uint8_t *out,
 void blake3_hasher_finalize_seek(const blake3_hasher *self, uint64_t seek,
                                  uint8_t *out, size_t out_len);
 
+// Bladebit extension: hashes num_inputs independent messages of input_len bytes
+// each (input_len <= BLAKE3_BLOCK_LEN) in parallel SIMD lanes. The messages sit
+// input_stride bytes apart. Each BLAKE3_OUT_LEN-byte digest is written back to
+// back into out. Messages are read in 4-byte words, so input_len rounded up to a
+// multiple of 4 bytes must be readable for each one.
+void blake3_hash_short_many(const void *inputs, size_t input_stride,
+                            size_t input_len, size_t num_inputs,
+                            uint8_t *out);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,279 @@
+// Batched hashing of short (single-block) messages.
+// This is a Bladebit addition, not part of upstream BLAKE3. It is used to compute
+// many Fx values at once: each message is hashed in its own SIMD lane.
+// blake3_hash_many cannot be used for this because it only compresses full
+// 64-byte blocks, while Fx inputs are between 13 and 37 bytes long.
+
+#include "blake3_impl.h"
+
+#define SHORT_FLAGS (CHUNK_START | CHUNK_END | ROOT)
+
+#if defined(IS_X86_64)
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#define SHORT_TARGET(x)
+#else
+#define SHORT_TARGET(x) __attribute__((target(x)))
+#endif
+
+#if !defined(BLAKE3_NO_AVX2)
+
+#define AVX2_FN static inline SHORT_TARGET("avx2")
+
+AVX2_FN __m256i rotr16_256(__m256i v) {
+  return _mm256_shuffle_epi8(
+      v, _mm256_set_epi8(13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2,
+                         13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2));
+}
+
+AVX2_FN __m256i rotr8_256(__m256i v) {
+  return _mm256_shuffle_epi8(
+      v, _mm256_set_epi8(12, 15, 14, 13, 8, 11, 10, 9, 4, 7, 6, 5, 0, 3, 2, 1,
+                         12, 15, 14, 13, 8, 11, 10, 9, 4, 7, 6, 5, 0, 3, 2, 1));
+}
+
+#define ROTR_256(v, n) \
+  _mm256_or_si256(_mm256_srli_epi32(v, n), _mm256_slli_epi32(v, 32 - (n)))
+
+#define G_256(s, a, b, c, d, x, y)                                            \
+  s[a] = _mm256_add_epi32(_mm256_add_epi32(s[a], s[b]), x);                   \
+  s[d] = rotr16_256(_mm256_xor_si256(s[d], s[a]));                            \
+  s[c] = _mm256_add_epi32(s[c], s[d]);                                        \
+  s[b] = ROTR_256(_mm256_xor_si256(s[b], s[c]), 12);                          \
+  s[a] = _mm256_add_epi32(_mm256_add_epi32(s[a], s[b]), y);                   \
+  s[d] = rotr8_256(_mm256_xor_si256(s[d], s[a]));                             \
+  s[c] = _mm256_add_epi32(s[c], s[d]);                                        \
+  s[b] = ROTR_256(_mm256_xor_si256(s[b], s[c]), 7)
+
+// Transposes 8 words x 8 lanes and writes each lane's 8 words to out + lane * 32.
+AVX2_FN void store_transposed_8x8(const __m256i a[8], uint8_t *out) {
+  const __m256i t0 = _mm256_unpacklo_epi32(a[0], a[1]);
+  const __m256i t1 = _mm256_unpackhi_epi32(a[0], a[1]);
+  const __m256i t2 = _mm256_unpacklo_epi32(a[2], a[3]);
+  const __m256i t3 = _mm256_unpackhi_epi32(a[2], a[3]);
+  const __m256i t4 = _mm256_unpacklo_epi32(a[4], a[5]);
+  const __m256i t5 = _mm256_unpackhi_epi32(a[4], a[5]);
+  const __m256i t6 = _mm256_unpacklo_epi32(a[6], a[7]);
+  const __m256i t7 = _mm256_unpackhi_epi32(a[6], a[7]);
+
+  const __m256i u0 = _mm256_unpacklo_epi64(t0, t2);
+  const __m256i u1 = _mm256_unpackhi_epi64(t0, t2);
+  const __m256i u2 = _mm256_unpacklo_epi64(t1, t3);
+  const __m256i u3 = _mm256_unpackhi_epi64(t1, t3);
+  const __m256i u4 = _mm256_unpacklo_epi64(t4, t6);
+  const __m256i u5 = _mm256_unpackhi_epi64(t4, t6);
+  const __m256i u6 = _mm256_unpacklo_epi64(t5, t7);
+  const __m256i u7 = _mm256_unpackhi_epi64(t5, t7);
+
+  _mm256_storeu_si256((__m256i *)(out + 0 * 32), _mm256_permute2x128_si256(u0, u4, 0x20));
+  _mm256_storeu_si256((__m256i *)(out + 1 * 32), _mm256_permute2x128_si256(u1, u5, 0x20));
+  _mm256_storeu_si256((__m256i *)(out + 2 * 32), _mm256_permute2x128_si256(u2, u6, 0x20));
+  _mm256_storeu_si256((__m256i *)(out + 3 * 32), _mm256_permute2x128_si256(u3, u7, 0x20));
+  _mm256_storeu_si256((__m256i *)(out + 4 * 32), _mm256_permute2x128_si256(u0, u4, 0x31));
+  _mm256_storeu_si256((__m256i *)(out + 5 * 32), _mm256_permute2x128_si256(u1, u5, 0x31));
+  _mm256_storeu_si256((__m256i *)(out + 6 * 32), _mm256_permute2x128_si256(u2, u6, 0x31));
+  _mm256_storeu_si256((__m256i *)(out + 7 * 32), _mm256_permute2x128_si256(u3, u7, 0x31));
+}
+
+// Hashes 8 messages.
+SHORT_TARGET("avx2")
+static void hash_short_8_avx2(const uint8_t *inputs, size_t input_stride,
+                              size_t input_len, uint8_t *out) {
+  const size_t full_words = input_len / 4;
+  const size_t tail_bytes = input_len % 4;
+
+  const __m256i lane_offsets = _mm256_mullo_epi32(
+      _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+      _mm256_set1_epi32((int)input_stride));
+
+  __m256i m[16];
+  size_t w = 0;
+  for (; w < full_words; w++) {
+    m[w] = _mm256_i32gather_epi32(
+        (const int *)inputs,
+        _mm256_add_epi32(lane_offsets, _mm256_set1_epi32((int)(w * 4))), 1);
+  }
+  if (tail_bytes) {
+    const __m256i word = _mm256_i32gather_epi32(
+        (const int *)inputs,
+        _mm256_add_epi32(lane_offsets, _mm256_set1_epi32((int)(w * 4))), 1);
+    m[w++] = _mm256_and_si256(
+        word, _mm256_set1_epi32((int)((1u << (tail_bytes * 8)) - 1)));
+  }
+  for (; w < 16; w++) {
+    m[w] = _mm256_setzero_si256();
+  }
+
+  __m256i s[16];
+  for (size_t i = 0; i < 8; i++) {
+    s[i] = _mm256_set1_epi32((int)IV[i]);
+  }
+  s[8]  = _mm256_set1_epi32((int)IV[0]);
+  s[9]  = _mm256_set1_epi32((int)IV[1]);
+  s[10] = _mm256_set1_epi32((int)IV[2]);
+  s[11] = _mm256_set1_epi32((int)IV[3]);
+  s[12] = _mm256_setzero_si256();
+  s[13] = _mm256_setzero_si256();
+  s[14] = _mm256_set1_epi32((int)input_len);
+  s[15] = _mm256_set1_epi32(SHORT_FLAGS);
+
+  for (size_t r = 0; r < 7; r++) {
+    const uint8_t *sched = MSG_SCHEDULE[r];
+    G_256(s, 0, 4, 8, 12, m[sched[0]], m[sched[1]]);
+    G_256(s, 1, 5, 9, 13, m[sched[2]], m[sched[3]]);
+    G_256(s, 2, 6, 10, 14, m[sched[4]], m[sched[5]]);
+    G_256(s, 3, 7, 11, 15, m[sched[6]], m[sched[7]]);
+    G_256(s, 0, 5, 10, 15, m[sched[8]], m[sched[9]]);
+    G_256(s, 1, 6, 11, 12, m[sched[10]], m[sched[11]]);
+    G_256(s, 2, 7, 8, 13, m[sched[12]], m[sched[13]]);
+    G_256(s, 3, 4, 9, 14, m[sched[14]], m[sched[15]]);
+  }
+
+  __m256i h[8];
+  for (size_t i = 0; i < 8; i++) {
+    h[i] = _mm256_xor_si256(s[i], s[i + 8]);
+  }
+
+  store_transposed_8x8(h, out);
+}
+
+#endif // !BLAKE3_NO_AVX2
+
+#if !defined(BLAKE3_NO_AVX512) && !defined(BLAKE3_NO_AVX2)
+
+// The zero-masked intrinsic forms avoid GCC's spurious maybe-uninitialized warnings
+#define ROTR_512(v, n) _mm512_maskz_ror_epi32((__mmask16)0xFFFF, v, n)
+
+#define G_512(s, a, b, c, d, x, y)                                            \
+  s[a] = _mm512_add_epi32(_mm512_add_epi32(s[a], s[b]), x);                   \
+  s[d] = ROTR_512(_mm512_xor_si512(s[d], s[a]), 16);                          \
+  s[c] = _mm512_add_epi32(s[c], s[d]);                                        \
+  s[b] = ROTR_512(_mm512_xor_si512(s[b], s[c]), 12);                          \
+  s[a] = _mm512_add_epi32(_mm512_add_epi32(s[a], s[b]), y);                   \
+  s[d] = ROTR_512(_mm512_xor_si512(s[d], s[a]), 8);                           \
+  s[c] = _mm512_add_epi32(s[c], s[d]);                                        \
+  s[b] = ROTR_512(_mm512_xor_si512(s[b], s[c]), 7)
+
+// Hashes 16 messages.
+SHORT_TARGET("avx512f")
+static void hash_short_16_avx512(const uint8_t *inputs, size_t input_stride,
+                                 size_t input_len, uint8_t *out) {
+  const size_t full_words = input_len / 4;
+  const size_t tail_bytes = input_len % 4;
+
+  const __m512i lane_offsets = _mm512_mullo_epi32(
+      _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15),
+      _mm512_set1_epi32((int)input_stride));
+
+  __m512i m[16];
+  size_t w = 0;
+  for (; w < full_words; w++) {
+    m[w] = _mm512_i32gather_epi32(
+        _mm512_add_epi32(lane_offsets, _mm512_set1_epi32((int)(w * 4))),
+        (const void *)inputs, 1);
+  }
+  if (tail_bytes) {
+    const __m512i word = _mm512_i32gather_epi32(
+        _mm512_add_epi32(lane_offsets, _mm512_set1_epi32((int)(w * 4))),
+        (const void *)inputs, 1);
+    m[w++] = _mm512_and_si512(
+        word, _mm512_set1_epi32((int)((1u << (tail_bytes * 8)) - 1)));
+  }
+  for (; w < 16; w++) {
+    m[w] = _mm512_setzero_si512();
+  }
+
+  __m512i s[16];
+  for (size_t i = 0; i < 8; i++) {
+    s[i] = _mm512_set1_epi32((int)IV[i]);
+  }
+  s[8]  = _mm512_set1_epi32((int)IV[0]);
+  s[9]  = _mm512_set1_epi32((int)IV[1]);
+  s[10] = _mm512_set1_epi32((int)IV[2]);
+  s[11] = _mm512_set1_epi32((int)IV[3]);
+  s[12] = _mm512_setzero_si512();
+  s[13] = _mm512_setzero_si512();
+  s[14] = _mm512_set1_epi32((int)input_len);
+  s[15] = _mm512_set1_epi32(SHORT_FLAGS);
+
+  for (size_t r = 0; r < 7; r++) {
+    const uint8_t *sched = MSG_SCHEDULE[r];
+    G_512(s, 0, 4, 8, 12, m[sched[0]], m[sched[1]]);
+    G_512(s, 1, 5, 9, 13, m[sched[2]], m[sched[3]]);
+    G_512(s, 2, 6, 10, 14, m[sched[4]], m[sched[5]]);
+    G_512(s, 3, 7, 11, 15, m[sched[6]], m[sched[7]]);
+    G_512(s, 0, 5, 10, 15, m[sched[8]], m[sched[9]]);
+    G_512(s, 1, 6, 11, 12, m[sched[10]], m[sched[11]]);
+    G_512(s, 2, 7, 8, 13, m[sched[12]], m[sched[13]]);
+    G_512(s, 3, 4, 9, 14, m[sched[14]], m[sched[15]]);
+  }
+
+  // Split the lanes into two groups of 8 and reuse the AVX2 transpose
+  __m256i lo[8], hi[8];
+  for (size_t i = 0; i < 8; i++) {
+    const __m512i h = _mm512_xor_si512(s[i], s[i + 8]);
+    lo[i] = _mm512_maskz_extracti64x4_epi64((__mmask8)0xFF, h, 0);
+    hi[i] = _mm512_maskz_extracti64x4_epi64((__mmask8)0xFF, h, 1);
+  }
+
+  store_transposed_8x8(lo, out);
+  store_transposed_8x8(hi, out + 8 * BLAKE3_OUT_LEN);
+}
+
+#endif // !BLAKE3_NO_AVX512
+
+#endif // IS_X86_64
+
+static void hash_short_one(const uint8_t *input, size_t input_len,
+                           uint8_t *out) {
+  uint8_t block[BLAKE3_BLOCK_LEN] = {0};
+  memcpy(block, input, input_len);
+
+  uint32_t cv[8];
+  memcpy(cv, IV, sizeof(cv));
+
+  blake3_compress_in_place(cv, block, (uint8_t)input_len, 0, SHORT_FLAGS);
+
+  for (size_t i = 0; i < 8; i++) {
+    const uint32_t v = cv[i];
+    out[i * 4 + 0] = (uint8_t)(v >> 0);
+    out[i * 4 + 1] = (uint8_t)(v >> 8);
+    out[i * 4 + 2] = (uint8_t)(v >> 16);
+    out[i * 4 + 3] = (uint8_t)(v >> 24);
+  }
+}
+
+void blake3_hash_short_many(const void *inputs, size_t input_stride,
+                            size_t input_len, size_t num_inputs,
+                            uint8_t *out) {
+  assert(input_len <= BLAKE3_BLOCK_LEN);
+
+  const uint8_t *input = (const uint8_t *)inputs;
+
+#if defined(IS_X86_64) && !defined(BLAKE3_NO_AVX2)
+  const size_t degree = blake3_simd_degree();
+
+#if !defined(BLAKE3_NO_AVX512)
+  if (degree >= 16) {
+    for (; num_inputs >= 16; num_inputs -= 16) {
+      hash_short_16_avx512(input, input_stride, input_len, out);
+      input += 16 * input_stride;
+      out += 16 * BLAKE3_OUT_LEN;
+    }
+  }
+#endif
+  if (degree >= 8) {
+    for (; num_inputs >= 8; num_inputs -= 8) {
+      hash_short_8_avx2(input, input_stride, input_len, out);
+      input += 8 * input_stride;
+      out += 8 * BLAKE3_OUT_LEN;
+    }
+  }
+#endif
+
+  for (; num_inputs > 0; num_inputs--) {
+    hash_short_one(input, input_len, out);
+    input += input_stride;
+    out += BLAKE3_OUT_LEN;
+  }
+}
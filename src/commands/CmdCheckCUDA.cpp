@@ -1,8 +1,12 @@
 #include "util/CliParser.h"
 #include "plotting/GlobalPlotConfig.h"
+#include "harvesting/GreenReaper.h"
+#include "plotmem/LPGen.h"
+#include "tools/GpuBenchmark.h"
 
 #if BB_CUDA_ENABLED
-    #include <cuda_runtime.h>
+    #include "GpuRuntime.h"
+    #include "GpuQueue.h"
 #endif
 static const char _help[] = R"(cudacheck [OPTIONS]
 
@@ -14,8 +18,26 @@ Otherwise, the exit code is 1.
 OPTIONS:
  -h, --help       : Display this help message and exit.
  -j, --json       : Output in JSON.
+ -b, --bandwidth  : Also measure and display each device's
+                    host-to-device and device-to-host transfer bandwidth.
+ --bench          : Run short synthetic versions of the k32 plotting kernels
+                    (F1, sort, match, fx and park compression) and of the
+                    transfers on each device, then display an estimated
+                    in-memory k32 plot time and the full proofs per second
+                    the device decompresses at compression levels 1 to 9.
+                    Meant to compare devices, not to predict exact times.
+ --tune           : Time the block sizes of the F1, fx and park compression
+                    kernels on each device, and save the fastest ones as the
+                    device's launch profile, under ~/.bladebit/cuda.
+                    The plotter and the harvester load it on startup.
+                    Devices of the same model share a profile.
 )";
 
+static constexpr uint32 BENCH_MAX_C_LEVEL      = 9;
+static constexpr double BENCH_C_LEVEL_SECONDS  = 1.0;
+
+static void BenchDecompression( int deviceIndex, double proofsPerSecond[BENCH_MAX_C_LEVEL+1] );
+
 
 void CmdCheckCUDAHelp()
 {
@@ -26,7 +48,10 @@ void CmdCheckCUDAHelp()
 
 void CmdCheckCUDA( GlobalPlotConfig& gCfg, CliParser& cli )
 {
-    bool json = false;
+    bool json      = false;
+    bool bandwidth = false;
+    bool bench     = false;
+    bool tune      = false;
 
     while( cli.HasArgs() )
     {
@@ -34,6 +59,18 @@ void CmdCheckCUDA( GlobalPlotConfig& gCfg, CliParser& cli )
         {
             continue;
         }
+        if( cli.ReadSwitch( bandwidth, "-b", "--bandwidth" ) )
+        {
+            continue;
+        }
+        if( cli.ReadSwitch( bench, "--bench" ) )
+        {
+            continue;
+        }
+        if( cli.ReadSwitch( tune, "--tune" ) )
+        {
+            continue;
+        }
         if( cli.ArgConsume( "-h", "--help" ) )
         {
             CmdCheckCUDAHelp();
@@ -54,7 +91,7 @@ void CmdCheckCUDA( GlobalPlotConfig& gCfg, CliParser& cli )
 
     if( json )
     {
-        Log::Write( "{ \"enabled\": %s, \"device_count\": %d }",
+        Log::Write( "{ \"enabled\": %s, \"device_count\": %d",
             success ? "true" : "false",
             deviceCount );
     }
@@ -67,6 +104,197 @@ void CmdCheckCUDA( GlobalPlotConfig& gCfg, CliParser& cli )
 
     }
 
+    #if BB_CUDA_ENABLED
+        if( success && bandwidth )
+        {
+            if( json )
+                Log::Write( ", \"devices\": [" );
+
+            for( int i = 0; i < deviceCount; i++ )
+            {
+                cudaDeviceProp props{};
+                GpuTransferBandwidth bw{};
+
+                const bool measured = cudaSetDevice( i ) == cudaSuccess &&
+                                      cudaGetDeviceProperties( &props, i ) == cudaSuccess &&
+                                      GpuQueue::MeasureTransferBandwidth( bw );
+
+                if( json )
+                {
+                    Log::Write( "%s{ \"id\": %d, \"name\": \"%s\", \"h2d_gbps\": %.2lf, \"d2h_gbps\": %.2lf }",
+                        i > 0 ? ", " : "", i, props.name, BtoGBSiF( bw.h2d ), BtoGBSiF( bw.d2h ) );
+                }
+                else if( measured )
+                    Log::Line( "%-2d: %s : H2D %.2lf GB/s, D2H %.2lf GB/s", i, props.name, BtoGBSiF( bw.h2d ), BtoGBSiF( bw.d2h ) );
+                else
+                    Log::Line( "%-2d: %s : Failed to measure transfer bandwidth.", i, props.name );
+            }
+
+            if( json )
+                Log::Write( "]" );
+        }
+    #endif
+
+    if( success && bench )
+    {
+        if( json )
+            Log::Write( ", \"bench\": [" );
+
+        for( int i = 0; i < deviceCount; i++ )
+        {
+            GpuBenchResult r = {};
+            double proofsPerSecond[BENCH_MAX_C_LEVEL+1] = {};
+
+            const bool ran = GpuBenchmark::Run( i, r );
+            if( ran )
+                BenchDecompression( i, proofsPerSecond );
+
+            if( json )
+            {
+                Log::Write( "%s{ \"id\": %d, \"ok\": %s", i > 0 ? ", " : "", i, ran ? "true" : "false" );
+
+                if( ran )
+                {
+                    Log::Write( ", \"f1_meps\": %.1lf, \"sort_meps\": %.1lf, \"match_meps\": %.1lf, \"fx_meps\": %.1lf, \"park_meps\": %.1lf",
+                        r.f1 / 1e6, r.sort / 1e6, r.match / 1e6, r.fx / 1e6, r.park / 1e6 );
+                    Log::Write( ", \"h2d_gbps\": %.2lf, \"d2h_gbps\": %.2lf, \"plot_seconds\": %.1lf, \"proofs_per_second\": [",
+                        BtoGBSiF( r.h2d ), BtoGBSiF( r.d2h ), r.plotSeconds );
+
+                    for( uint32 c = 1; c <= BENCH_MAX_C_LEVEL; c++ )
+                        Log::Write( "%s%.2lf", c > 1 ? ", " : "", proofsPerSecond[c] );
+
+                    Log::Write( "]" );
+                }
+
+                Log::Write( " }" );
+            }
+            else if( ran )
+            {
+                Log::Line( "%-2d: F1 %.0lf M/s, sort %.0lf M/s, match %.0lf M/s, fx %.0lf M/s, parks %.0lf M/s, H2D %.2lf GB/s, D2H %.2lf GB/s",
+                    i, r.f1 / 1e6, r.sort / 1e6, r.match / 1e6, r.fx / 1e6, r.park / 1e6, BtoGBSiF( r.h2d ), BtoGBSiF( r.d2h ) );
+                Log::Line( "    Estimated k32 plot time: %.1lf seconds", r.plotSeconds );
+                Log::Write( "    Proofs/s by compression level:" );
+
+                for( uint32 c = 1; c <= BENCH_MAX_C_LEVEL; c++ )
+                    Log::Write( " C%u %.2lf", c, proofsPerSecond[c] );
+
+                Log::NewLine();
+            }
+            else
+                Log::Line( "%-2d: Failed to run the benchmark.", i );
+        }
+
+        if( json )
+            Log::Write( "]" );
+    }
+
+    if( success && tune )
+    {
+        if( json )
+            Log::Write( ", \"tune\": [" );
+
+        for( int i = 0; i < deviceCount; i++ )
+        {
+            GpuTuneResult r = {};
+            const bool ran = GpuBenchmark::Tune( i, r );
+
+            if( json )
+            {
+                Log::Write( "%s{ \"id\": %d, \"ok\": %s", i > 0 ? ", " : "", i, ran ? "true" : "false" );
+
+                if( ran )
+                {
+                    Log::Write( ", \"f1_threads\": %u, \"fx_threads\": %u, \"park_threads\": %u, \"saved\": %s",
+                        r.f1Threads, r.fxThreads, r.parkThreads, r.saved ? "true" : "false" );
+                }
+
+                Log::Write( " }" );
+            }
+            else if( ran )
+            {
+                Log::Line( "%-2d: F1 %u, fx %u, parks %u threads per block", i, r.f1Threads, r.fxThreads, r.parkThreads );
+
+                if( r.saved )
+                    Log::Line( "    Saved profile to '%s'", r.profilePath.c_str() );
+                else
+                    Log::Line( "    Failed to save profile to '%s'", r.profilePath.c_str() );
+            }
+            else
+                Log::Line( "%-2d: Failed to tune the device.", i );
+        }
+
+        if( json )
+            Log::Write( "]" );
+    }
+
+    if( json )
+        Log::Write( " }" );
+
     Log::Flush();
     Exit( deviceCount > 0 ? 0 : -1 );
 }
+
+/// Times full proof decompressions of random line points on a single device through GreenReaper.
+/// Most of them yield no proof, but they do the same F1, match and fx work as real ones.
+//-----------------------------------------------------------
+void BenchDecompression( const int deviceIndex, double proofsPerSecond[BENCH_MAX_C_LEVEL+1] )
+{
+    GreenReaperConfig cfg = {};
+    cfg.apiVersion     = GR_API_VERSION;
+    cfg.threadCount    = 1;
+    cfg.gpuRequest     = GRGpuRequestKind_ExactDevice;
+    cfg.gpuDeviceIndex = (uint32)deviceIndex;
+
+    GreenReaperContext* gr = nullptr;
+    if( grCreateContext( &gr, &cfg, sizeof( cfg ) ) != GRResult_OK || !gr )
+        return;
+
+    byte plotId[BB_PLOT_ID_LEN];
+    SysHost::Random( plotId, sizeof( plotId ) );
+
+    uint64 state = 0x9E3779B97F4A7C15ull;
+
+    for( uint32 level = 1; level <= BENCH_MAX_C_LEVEL; level++ )
+    {
+        GRCompressionInfo info = {};
+        if( grGetCompressionInfo( &info, sizeof( info ), 32, level ) != GRResult_OK ||
+            grPreallocateForCompressionLevel( gr, 32, level ) != GRResult_OK )
+            continue;
+
+        const uint64 xMask      = ( 1ull << info.entrySizeBits ) - 1;
+        const uint32 proofCount = level < 9 ? GR_POST_PROOF_X_COUNT / 2 : GR_POST_PROOF_X_COUNT / 4;
+
+        uint64 requestCount = 0;
+        double elapsed      = 0;
+
+        // The first request pays for any lazy allocations
+        for( int64 i = -1; elapsed < BENCH_C_LEVEL_SECONDS; i++ )
+        {
+            GRCompressedProofRequest req = {};
+            req.compressionLevel = level;
+            req.plotId           = plotId;
+
+            for( uint32 j = 0; j < proofCount; j++ )
+            {
+                state ^= state << 13;
+                state ^= state >> 7;
+                state ^= state << 17;
+
+                req.compressedProof[j] = SquareToLinePoint( state & xMask, ( state >> 32 ) & xMask );
+            }
+
+            const auto timer = TimerBegin();
+            grFetchProofForChallenge( gr, &req );
+
+            if( i >= 0 )
+            {
+                elapsed += TimerEnd( timer );
+                requestCount++;
+            }
+        }
+
+        proofsPerSecond[level] = requestCount / elapsed;
+    }
+
+    grDestroyContext( gr );
+}
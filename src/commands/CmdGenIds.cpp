@@ -0,0 +1,98 @@
+#include "Commands.h"
+#include "plotting/GlobalPlotConfig.h"
+#include "plotting/PlotTools.h"
+#include "plotting/PlotIdManifest.h"
+#include "threading/MTJob.h"
+
+//-----------------------------------------------------------
+void CmdGenIdsMain( GlobalPlotConfig& gCfg, CliParser& cli )
+{
+    const char* manifestPath = nullptr;
+
+    while( cli.HasArgs() )
+    {
+        if( cli.ArgConsume( "-h", "--help" ) )
+        {
+            CmdGenIdsHelp();
+            Exit( 0 );
+        }
+        else
+            break;
+    }
+
+    FatalIf( !cli.HasArgs(), "Expected a path for the plot id manifest." );
+    manifestPath = cli.Arg();
+    cli.NextArg();
+
+    FatalIf( cli.HasArgs(), "Unexpected argument '%s'.", cli.Arg() );
+    FatalIf( gCfg.plotCount < 1, "gen-ids needs a plot count greater than 0 (-n)." );
+    FatalIf( !gCfg.farmerPublicKey, "gen-ids needs a farmer public key (-f)." );
+    FatalIf( !gCfg.poolPublicKey && !gCfg.poolContractPuzzleHash, "gen-ids needs a pool public key (-p) or a pool contract address (-c)." );
+    FatalIf( gCfg.compressionLevel > 9, "Invalid compression level %u.", gCfg.compressionLevel );
+
+    const uint32 maxThreads  = SysHost::GetLogicalCPUCount();
+    const uint32 threadCount = std::min( gCfg.threadCount == 0 ? maxThreads : gCfg.threadCount, maxThreads );
+    const uint64 plotCount   = gCfg.plotCount;
+
+    Log::Line( "Generating %llu plot ids with %u threads.", (llu)plotCount, threadCount );
+
+    std::vector<PlotIdEntry> entries  ( plotCount );
+    std::vector<std::string> fileNames( plotCount );
+
+    // Key derivation is independent per plot, so threads steal chunks of plots from each other
+    const auto timer = TimerBegin();
+
+    ThreadPool pool( threadCount, ThreadPool::Mode::Fixed, true );
+
+    AnonMTJob::RunRanges( pool, threadCount, plotCount, [&]( AnonMTJob* self, const uint64 offset, const uint64 count ) {
+
+        char fileName[BB_COMPRESSED_PLOT_FILE_LEN_TMP+1];
+
+        for( uint64 i = offset; i < offset + count; i++ )
+        {
+            PlotIdEntry& e = entries[i];
+
+            PlotTools::GeneratePlotIdAndMemo( e.plotId, e.memo, e.memoSize,
+                                              *gCfg.farmerPublicKey, gCfg.poolPublicKey, gCfg.poolContractPuzzleHash );
+
+            PlotTools::GenPlotFileName( e.plotId, fileName, gCfg.compressionLevel, gCfg.k );
+
+            // The plot writer renames the .tmp file once the plot is complete
+            const size_t len = strlen( fileName ) - ( sizeof( ".tmp" ) - 1 );
+            fileNames[i].assign( fileName, len );
+        }
+    });
+
+    const double elapsed = TimerEnd( timer );
+    Log::Line( "Generated %llu plot ids in %.2lf seconds ( %.1lf ids/s ).", (llu)plotCount, elapsed, plotCount / elapsed );
+
+    FatalIf( !PlotIdManifest::Write( manifestPath, entries, fileNames, gCfg.compressionLevel ),
+        "Failed to write plot id manifest." );
+
+    Log::Line( "Wrote plot id manifest to '%s'.", manifestPath );
+}
+
+//-----------------------------------------------------------
+void CmdGenIdsHelp()
+{
+    Log::Line( R"(
+gen-ids [OPTIONS] <manifest_path>
+
+Derives the plot ids and memos of -n plots, in parallel over -t threads, and writes them
+to a manifest, along with the file name of each plot.
+Give the manifest to a plotter with the global --ids option to plot these ids, in order,
+instead of deriving a new one before each plot.
+
+Uses the global farmer and pool keys (-f, -p or -c) and compression level (-z).
+
+The manifest has one plot per line: <plot_id> <memo> <file_name>
+The file names are dated at generation time. Plotters name their plots when they create them.
+
+[OPTIONS]
+ -h, --help: Display this help message and exit.
+
+Example:
+ bladebit -n 10000 -f <farmer_key> -c <pool_contract> gen-ids ids.txt
+ bladebit -n 0 --ids ids.txt diskplot -t1 /mnt/ssd /mnt/plots
+)" );
+}
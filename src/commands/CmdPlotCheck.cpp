@@ -18,9 +18,14 @@ struct PlotCheckConfig
     bool                     hasSeed    = false;
     bool                     noGpu      = false;
     int32                    gpuIndex   = -1;
+    uint32                   parallelCount = 1;    // How many plots to keep in flight at once
+    bool                     json          = false;
+    bool                     mmap          = false;
 };
 
 void CmdPlotsCheckHelp();
+static void CheckPlotsParallel( PlotCheckConfig& cfg, PlotCheckerConfig& checkerCfg );
+static void WriteCheckResultsJson( const PlotCheckConfig& cfg, const std::vector<PlotCheckResult>& results );
 
 //-----------------------------------------------------------
 void CmdPlotsCheckMain( GlobalPlotConfig& gCfg, CliParser& cli )
@@ -42,6 +47,9 @@ void CmdPlotsCheckMain( GlobalPlotConfig& gCfg, CliParser& cli )
         else if( cli.ReadU64( cfg.proofCount, "-n", "--iterations" ) ) continue;
         else if( cli.ReadSwitch( cfg.noGpu, "-g", "--no-gpu" ) ) continue;
         else if( cli.ReadI32( cfg.gpuIndex, "-d", "--device" ) ) continue;
+        else if( cli.ReadU32( cfg.parallelCount, "-p", "--parallel" ) ) continue;
+        else if( cli.ReadSwitch( cfg.json, "-j", "--json" ) ) continue;
+        else if( cli.ReadSwitch( cfg.mmap, "--mmap" ) ) continue;
         else
             break;
     }
@@ -73,7 +81,8 @@ void CmdPlotsCheckMain( GlobalPlotConfig& gCfg, CliParser& cli )
         .gpuIndex           = cfg.gpuIndex,
         .threadCount        = gCfg.threadCount,
         .disableCpuAffinity = gCfg.disableCpuAffinity,
-        .silent             = false,
+        .silent             = cfg.json,
+        .useMmap            = cfg.mmap,
         .hasSeed            = cfg.hasSeed,
         .deletePlots        = false,
         .deleteThreshold    = 0.0
@@ -83,8 +92,27 @@ void CmdPlotsCheckMain( GlobalPlotConfig& gCfg, CliParser& cli )
     if( cfg.hasSeed )
         memcpy( checkerCfg.seed, cfg.seed, sizeof( checkerCfg.seed ) );
 
+    cfg.parallelCount = std::min( cfg.parallelCount, (uint32)cfg.plotPaths.size() );
+
+    if( cfg.parallelCount > 1 )
+    {
+        CheckPlotsParallel( cfg, checkerCfg );
+        return;
+    }
+
     ptr<PlotChecker> checker( PlotChecker::Create( checkerCfg ) );
 
+    if( cfg.json )
+    {
+        std::vector<PlotCheckResult> results( cfg.plotPaths.size() );
+
+        for( size_t i = 0; i < cfg.plotPaths.size(); i++ )
+            checker->CheckPlot( cfg.plotPaths[i], &results[i] );
+
+        WriteCheckResultsJson( cfg, results );
+        return;
+    }
+
     for( auto* plotPath : cfg.plotPaths )
     {
         PlotCheckResult result{};
@@ -102,8 +130,196 @@ void CmdPlotsCheckMain( GlobalPlotConfig& gCfg, CliParser& cli )
 
 }
 
+///
+/// Keeps up to parallelCount plots in flight, each on its own checker thread.
+/// All checkers share a single decompression context, so that its thread pool and
+/// GPU buffers are allocated once. Decompression requests from different plots
+/// interleave on it, while file reads and proof validation for the other plots
+/// proceed concurrently.
 //-----------------------------------------------------------
-void CmdPlotsCheckHelp()
+void CheckPlotsParallel( PlotCheckConfig& cfg, PlotCheckerConfig& checkerCfg )
+{
+    const uint32 threadCount = checkerCfg.threadCount == 0 ? SysHost::GetUsableCPUCount() :
+                                    std::min( (uint32)MAX_THREADS, std::min( checkerCfg.threadCount, SysHost::GetLogicalCPUCount() ) );
+
+    GreenReaperConfig grCfg = {};
+    grCfg.apiVersion         = GR_API_VERSION;
+    grCfg.threadCount        = threadCount;
+    grCfg.disableCpuAffinity = checkerCfg.disableCpuAffinity ? GR_TRUE : GR_FALSE;
+    grCfg.gpuRequest         = cfg.noGpu ? GRGpuRequestKind_None :
+                                 cfg.gpuIndex >= 0 ? GRGpuRequestKind_ExactDevice : GRGpuRequestKind_FirstAvailable;
+    grCfg.gpuDeviceIndex     = cfg.gpuIndex < 0 ? 0 : (uint32)cfg.gpuIndex;
+
+    GreenReaperContext* grContext = nullptr;
+    {
+        const GRResult r = grCreateContext( &grContext, &grCfg, sizeof( grCfg ) );
+        FatalIf( r != GRResult_OK, "Failed to create decompression context with error %d.", (int)r );
+    }
+
+    if( !cfg.json )
+    {
+        if( !cfg.noGpu )
+            Log::Line( grHasGpuDecompressor( grContext ) ? "Using GPU for decompression." : "No GPU was selected for decompression." );
+
+        Log::Line( "Checking %llu plots, %u at a time.", (llu)cfg.plotPaths.size(), cfg.parallelCount );
+        Log::NewLine();
+    }
+
+    std::mutex grLock;
+    std::mutex logLock;
+
+    checkerCfg.silent        = true;
+    checkerCfg.grContext     = grContext;
+    checkerCfg.grContextLock = &grLock;
+
+    std::atomic<uint64> nextPlot   = 0;
+    std::atomic<uint64> errorCount = 0;
+
+    const uint64 plotCount = cfg.plotPaths.size();
+
+    std::vector<PlotCheckResult> results( cfg.json ? plotCount : 0 );
+
+    ThreadPool pool( cfg.parallelCount, ThreadPool::Mode::Fixed, true );
+
+    AnonMTJob::Run( pool, [&]( AnonMTJob* self ) {
+
+        ptr<PlotChecker> checker( PlotChecker::Create( checkerCfg ) );
+
+        for( uint64 i = nextPlot++; i < plotCount; i = nextPlot++ )
+        {
+            const char* plotPath = cfg.plotPaths[i];
+
+            if( cfg.json )
+            {
+                checker->CheckPlot( plotPath, &results[i] );
+                continue;
+            }
+
+            PlotCheckResult result{};
+            checker->CheckPlot( plotPath, &result );
+
+            std::lock_guard<std::mutex> lock( logLock );
+
+            if( !result.error.empty() )
+            {
+                errorCount++;
+                Log::Error( "[%llu/%llu] %s: %s", (llu)i+1, (llu)plotCount, plotPath, result.error.c_str() );
+                continue;
+            }
+
+            Log::Line( "[%llu/%llu] %s: %llu / %llu ( %.3lf%% ) proofs, %llu fetch failures, %llu validation failures.",
+                (llu)i+1, (llu)plotCount, plotPath,
+                (llu)result.proofCount, (llu)result.checkCount, result.proofCount / (double)result.checkCount * 100.0,
+                (llu)result.proofFetchFailCount, (llu)result.proofValidationFailCount );
+        }
+    });
+
+    grDestroyContext( grContext );
+
+    if( cfg.json )
+    {
+        WriteCheckResultsJson( cfg, results );
+        return;
+    }
+
+    Log::NewLine();
+    FatalIf( errorCount > 0, "Failed to check %llu / %llu plots.", (llu)errorCount.load(), (llu)plotCount );
+}
+
+///
+/// Writes one entry per plot, followed by a summary with the proof fetch latencies
+/// of all plots merged per compression level and device.
+/// Exits with an error code if any plot could not be checked.
+//-----------------------------------------------------------
+void WriteCheckResultsJson( const PlotCheckConfig& cfg, const std::vector<PlotCheckResult>& results )
 {
+    struct Summary
+    {
+        uint32           compressionLevel;
+        bool             usedGpu;
+        uint64           plotCount;
+        LatencyHistogram proofTimes;
+    };
+
+    std::vector<Summary> summaries;
+    uint64               errorCount = 0;
+
+    Log::Line( R"({"plots": [)" );
+
+    for( size_t i = 0; i < results.size(); i++ )
+    {
+        const PlotCheckResult& r = results[i];
+
+        Log::Write( R"(  {"path": )" );
+        LogWriteJsonStr( cfg.plotPaths[i] );
+
+        if( !r.error.empty() )
+        {
+            errorCount++;
+            Log::Write( R"(, "error": )" );
+            LogWriteJsonStr( r.error.c_str() );
+        }
+        else
+        {
+            const std::string seedHex = BytesToHexStdString( r.seedUsed, sizeof( r.seedUsed ) );
 
+            Log::Write( R"(, "k": %u, "compression_level": %u, "device": "%s", "seed": "%s", )",
+                r.k, r.compressionLevel, r.usedGpu ? "cuda" : "cpu", seedHex.c_str() );
+            Log::Write( R"("proofs_requested": %llu, "proofs_found": %llu, "fetch_failures": %llu, "validation_failures": %llu, "proofs": )",
+                (llu)r.checkCount, (llu)r.proofCount, (llu)r.proofFetchFailCount, (llu)r.proofValidationFailCount );
+            r.proofTimes.WriteJson();
+
+            auto it = std::find_if( summaries.begin(), summaries.end(), [&]( const Summary& s ) {
+                return s.compressionLevel == r.compressionLevel && s.usedGpu == r.usedGpu;
+            });
+
+            if( it == summaries.end() )
+            {
+                summaries.push_back( { r.compressionLevel, r.usedGpu, 0, {} } );
+                it = summaries.end() - 1;
+            }
+
+            it->plotCount++;
+            it->proofTimes.Merge( r.proofTimes );
+        }
+
+        Log::Line( i + 1 < results.size() ? "}," : "}" );
+    }
+
+    Log::Line( R"(], "summary": [)" );
+
+    for( size_t i = 0; i < summaries.size(); i++ )
+    {
+        const Summary& s = summaries[i];
+
+        Log::Write( R"(  {"compression_level": %u, "device": "%s", "plots": %llu, "proofs": )",
+            s.compressionLevel, s.usedGpu ? "cuda" : "cpu", (llu)s.plotCount );
+        s.proofTimes.WriteJson();
+        Log::Line( i + 1 < summaries.size() ? "}," : "}" );
+    }
+
+    Log::Line( R"(], "errors": %llu})", (llu)errorCount );
+    Log::Flush();
+
+    if( errorCount > 0 )
+        Exit( 1 );
 }
+
+static const char _help[] = R"(check [OPTIONS] <plot_file_path> [<plot_file_path> ...]
+OPTIONS:
+ -h, --help               : Display this help message and exit.
+ -n, --iterations <count> : How many random proofs to check per plot (default = 100)
+ -s, --seed <hex>         : 64 char hex string to use as a random seed for the proofs.
+ -p, --parallel <count>   : How many plots to check at a time, sharing a single decompression context. (default = 1)
+ -g, --no-gpu             : Don't use CUDA for decompression.
+ -d, --device <index>     : Cuda device index.
+ -j, --json               : Output the results in json, with a proof fetch latency histogram
+                            for each plot, and merged per compression level and device.
+ --mmap                   : Map plot files into memory instead of reading them.
+)";
+
+//-----------------------------------------------------------
+void CmdPlotsCheckHelp()
+{
+    printf( "%s", _help );
+}
\ No newline at end of file
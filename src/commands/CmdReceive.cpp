@@ -0,0 +1,316 @@
+#include "Commands.h"
+#include "io/NetStream.h"
+#include "io/FileStream.h"
+#include "threading/Thread.h"
+
+struct ReceiveConnection
+{
+    intptr_t    socket;
+    std::string rootDir;
+    std::string token;      // Shared token the sender must authenticate with, if not empty
+    Thread*     thread = nullptr;
+};
+
+static void ReceiveConnectionThread( ReceiveConnection* conn );
+static bool TokensMatch( const std::string& expected, const byte* token, size_t size );
+
+//-----------------------------------------------------------
+void CmdReceiveMain( GlobalPlotConfig& gCfg, CliParser& cli )
+{
+    uint32      port        = 0;
+    const char* bindAddress = "127.0.0.1";
+    const char* token       = nullptr;
+
+    while( cli.HasArgs() )
+    {
+        if( cli.ArgConsume( "-h", "--help" ) )
+        {
+            CmdReceiveHelp();
+            Exit( 0 );
+        }
+        else if( cli.ReadU32( port, "-p", "--port" ) )
+            continue;
+        else if( cli.ReadStr( bindAddress, "-b", "--bind" ) )
+            continue;
+        else if( cli.ReadStr( token, "-t", "--token" ) )
+            continue;
+        else
+            break;
+    }
+
+    FatalIf( port == 0 || port > 0xFFFF, "A valid port must be given with --port." );
+    FatalIf( token && ( !*token || strlen( token ) > NetStream::MAX_TOKEN_SIZE || strchr( token, '/' ) ),
+             "Invalid --token. It must have 1 to %llu characters and no '/'.", (llu)NetStream::MAX_TOKEN_SIZE );
+    FatalIf( !cli.HasArgs(), "Expected a root directory for the received plots." );
+
+    std::string rootDir = cli.Arg();
+    cli.NextArg();
+    FatalIf( cli.HasArgs(), "Unexpected argument '%s'.", cli.Arg() );
+
+    if( rootDir.back() != '/' && rootDir.back() != '\\' )
+        rootDir += '/';
+
+    int32 err = 0;
+    const intptr_t listenSocket = NetStream::Listen( bindAddress, (uint16)port, err );
+    FatalIf( listenSocket == NetStream::InvalidSocket, "Failed to listen on %s port %u with error: %d.", bindAddress, port, err );
+
+    Log::Line( "Receiving plots into '%s' on %s port %u.", rootDir.c_str(), bindAddress, port );
+    if( !token )
+        Log::Line( "Warning: No --token given. Anyone who can connect to the port can write plot files." );
+
+    std::vector<ReceiveConnection*> connections;
+
+    for( ;; )
+    {
+        const intptr_t sock = NetStream::Accept( listenSocket );
+        if( sock == NetStream::InvalidSocket )
+        {
+            Log::Line( "Warning: Failed to accept a connection with error: %d.", NetStream::LastError() );
+            continue;
+        }
+
+        // Reap the connections that have completed
+        for( size_t i = 0; i < connections.size(); )
+        {
+            if( connections[i]->thread->HasExited() )
+            {
+                delete connections[i]->thread;
+                delete connections[i];
+                connections[i] = connections.back();
+                connections.pop_back();
+            }
+            else
+                i++;
+        }
+
+        auto* conn = new ReceiveConnection();
+        conn->socket  = sock;
+        conn->rootDir = rootDir;
+        conn->token   = token ? token : "";
+        conn->thread  = new Thread( 4 MiB );
+        connections.push_back( conn );
+
+        conn->thread->Run( ReceiveConnectionThread, conn );
+    }
+}
+
+//-----------------------------------------------------------
+void ReceiveConnectionThread( ReceiveConnection* conn )
+{
+    const intptr_t sock = conn->socket;
+
+    FileStream        file;
+    std::string       tmpPath;
+    std::vector<byte> buffer;
+    int32             error    = 0;    // First error on the file, reported on the next reply
+    bool              finished = false;
+    bool              authed   = conn->token.empty();
+
+    auto reply = [&]( const int32 err, const uint64 size = 0 ) {
+        const NetStream::Reply r = { err, 0, size };
+        return NetStream::SendAll( sock, &r, sizeof( r ) );
+    };
+
+    auto setError = [&]( const int32 err ) {
+        if( error == 0 )
+            error = err != 0 ? err : -1;
+    };
+
+    auto seek = [&]( const uint64 offset ) {
+        if( !file.Seek( (int64)offset, SeekOrigin::Begin ) )
+            setError( file.GetError() );
+        return error == 0;
+    };
+
+    NetStream::Message msg;
+
+    while( !finished && NetStream::RecvAll( sock, &msg, sizeof( msg ) ) )
+    {
+        const bool isAuth = msg.type == NetStream::MessageType::Auth;
+
+        if( msg.magic != NetStream::MAGIC || authed == !isAuth ||
+            ( !isAuth && msg.type != NetStream::MessageType::Open && !file.IsOpen() ) )
+        {
+            Log::Line( "Warning: Received an invalid message. Dropping the connection." );
+            break;
+        }
+
+        // Payloads are received in full even after an error, to stay in sync with the sender
+        const bool hasPayload = isAuth || msg.type == NetStream::MessageType::Open || msg.type == NetStream::MessageType::Write;
+        const bool isRead     = msg.type == NetStream::MessageType::Read;
+
+        if( hasPayload || isRead )
+        {
+            // Reject sizes the sender would never use before allocating anything for them
+            const uint64 maxSize = isAuth ? NetStream::MAX_TOKEN_SIZE : NetStream::MAX_MESSAGE_SIZE;
+
+            if( msg.size > maxSize )
+            {
+                Log::Line( "Warning: Received an invalid message size. Dropping the connection." );
+                break;
+            }
+
+            if( buffer.size() < msg.size )
+                buffer.resize( (size_t)msg.size );
+        }
+
+        if( hasPayload && !NetStream::RecvAll( sock, buffer.data(), (size_t)msg.size ) )
+            break;
+
+        bool ok = true;
+
+        switch( msg.type )
+        {
+            case NetStream::MessageType::Auth:
+                authed = TokensMatch( conn->token, buffer.data(), (size_t)msg.size );
+                if( !authed )
+                {
+                    Log::Line( "Warning: Received an invalid token. Dropping the connection." );
+                    ok = false;
+                }
+            break;
+
+            case NetStream::MessageType::Open:
+            {
+                const std::string path( (const char*)buffer.data(), (size_t)msg.size );
+
+                if( file.IsOpen() || !NetStream::IsValidRemotePath( path ) )
+                {
+                    Log::Line( "Warning: Refusing to create plot file '%s'.", path.c_str() );
+                    reply( -1 );
+                    ok = false;
+                    break;
+                }
+
+                tmpPath = conn->rootDir + path;
+
+                if( !file.Open( tmpPath.c_str(), FileMode::Create, FileAccess::ReadWrite, FileFlags::LargeFile ) )
+                {
+                    const int32 openErr = file.GetError();
+                    Log::Line( "Warning: Failed to create plot file '%s' with error: %d.", tmpPath.c_str(), openErr );
+                    reply( openErr != 0 ? openErr : -1 );
+                    ok = false;
+                    break;
+                }
+
+                Log::Line( "Receiving %s", tmpPath.c_str() );
+                error = 0;
+                ok    = reply( 0 );
+            }
+            break;
+
+            case NetStream::MessageType::Write:
+                if( error == 0 && seek( msg.offset ) && file.Write( buffer.data(), (size_t)msg.size ) != (ssize_t)msg.size )
+                    setError( file.GetError() );
+            break;
+
+            case NetStream::MessageType::Read:
+            {
+                ssize_t read = -1;
+                if( error == 0 && seek( msg.offset ) )
+                {
+                    read = file.Read( buffer.data(), (size_t)msg.size );
+                    if( read < 0 )
+                        setError( file.GetError() );
+                }
+
+                ok = reply( error, read > 0 ? (uint64)read : 0 ) &&
+                     ( read <= 0 || NetStream::SendAll( sock, buffer.data(), (size_t)read ) );
+            }
+            break;
+
+            case NetStream::MessageType::Truncate:
+                if( error == 0 && !file.Truncate( (ssize_t)msg.offset ) )
+                    setError( file.GetError() );
+            break;
+
+            case NetStream::MessageType::Flush:
+                if( error == 0 && !file.Flush() )
+                    setError( file.GetError() );
+
+                ok = reply( error );
+            break;
+
+            case NetStream::MessageType::Finish:
+            {
+                file.Close();
+
+                const std::string finalPath = tmpPath.substr( 0, tmpPath.size() - 4 );
+
+                if( error != 0 )
+                    Log::Line( "Warning: Plot %s failed with error: %d.", tmpPath.c_str(), error );
+                else if( msg.offset == 1 )
+                {
+                    int32 moveErr = 0;
+                    if( FileStream::Move( tmpPath.c_str(), finalPath.c_str(), &moveErr ) )
+                        Log::Line( "%s -> %s", tmpPath.c_str(), finalPath.c_str() );
+                    else
+                        setError( moveErr );
+                }
+
+                ok       = reply( error );
+                finished = true;
+            }
+            break;
+
+            default:
+                Log::Line( "Warning: Received an unknown message. Dropping the connection." );
+                ok = false;
+            break;
+        }
+
+        if( !ok )
+            break;
+    }
+
+    if( file.IsOpen() )
+    {
+        Log::Line( "Warning: Connection lost before plot %s was completed.", tmpPath.c_str() );
+        file.Close();
+    }
+
+    NetStream::CloseSocket( sock );
+}
+
+/// Compares in constant time for a given token size, so the token can't be guessed a character at a time
+//-----------------------------------------------------------
+bool TokensMatch( const std::string& expected, const byte* token, const size_t size )
+{
+    if( size != expected.size() )
+        return false;
+
+    byte diff = 0;
+    for( size_t i = 0; i < size; i++ )
+        diff |= (byte)expected[i] ^ token[i];
+
+    return diff == 0;
+}
+
+//-----------------------------------------------------------
+void CmdReceiveHelp()
+{
+    Log::Line( R"(
+receive [OPTIONS] <root_dir>
+
+Receives plots streamed by plotters over TCP and writes them under <root_dir>.
+Run it on the harvester, and give plotters an output directory of the form
+tcp://[<token>@]<host>:<port>/[<dir>/], where <dir> is relative to <root_dir> and must exist.
+By default only connections from the local machine are accepted. To receive from
+other machines, bind to another address with --bind and require a --token.
+Plots are written as they are created, without an intermediate copy on the plotter,
+and are renamed from their .tmp name once the plotter has completed them.
+Each connection writes one plot at a time, any number of plotters may connect.
+
+[OPTIONS]
+ -p, --port <port>    : Port to listen on. *REQUIRED*
+ -b, --bind <address> : Address to listen on. Defaults to 127.0.0.1.
+                        Use 0.0.0.0 or :: to listen on all interfaces.
+ -t, --token <token>  : Shared token plotters must send before writing plots,
+                        given as tcp://<token>@<host>:<port>/ in their output directory.
+ -h, --help           : Display this help message and exit.
+
+Example:
+ bladebit receive -p 9700 -b 0.0.0.0 -t s3cr3t /mnt/farm
+ bladebit -f ... -c ... ramplot tcp://s3cr3t@harvester:9700/disk1
+)" );
+}
@@ -0,0 +1,421 @@
+#include "Commands.h"
+#include "plotting/GlobalPlotConfig.h"
+#include "plotting/PlotTools.h"
+#include "plotting/PlotWriter.h"
+#include "plotting/Compression.h"
+#include "plotmem/LPGen.h"
+#include "plotmem/ParkWriter.h"
+#include "plotmem/MemPhase4.h"
+#include "tools/PlotReader.h"
+#include "algorithm/RadixSort.h"
+#include "threading/MTJob.h"
+#include "threading/Fence.h"
+
+// Park data compressed before it is submitted to the plot writer
+static constexpr size_t PARK_CHUNK_SIZE = 64 MiB;
+
+struct RecompressContext
+{
+    ThreadPool*       pool        = nullptr;
+    uint32            threadCount = 0;
+    MemoryPlot*       plot        = nullptr;
+    PlotWriter*       writer      = nullptr;
+    Fence             writeFence;
+
+    uint32            level       = 0;
+    CompressionInfo   info        = {};
+    const FSE_CTable* cTable      = nullptr;
+    ParkDeltaCoding   deltaCoding = ParkDeltaCoding::FSE;
+    bool              tunedDeltas = false;
+
+    // Entries of the table being converted, indexed by their position in the source plot
+    uint64*           lps         = nullptr;
+    uint64*           lpsTmp      = nullptr;
+    uint32*           map         = nullptr;
+    uint32*           mapTmp      = nullptr;
+
+    // Value of each entry of the previous table, indexed by its position in the source plot:
+    // The truncated x pair for table 1, and the entry's new position for the other tables.
+    uint32*           lTable      = nullptr;
+};
+
+static uint64 RecompressTable( RecompressContext& cx, TableId table );
+static void   WriteTableParks( RecompressContext& cx, TableId table, uint64 entryCount );
+static void   RecompressP7( RecompressContext& cx, uint64 entryCount );
+static void   CopyTable( RecompressContext& cx, PlotTable table );
+
+//-----------------------------------------------------------
+void CmdRecompressMain( GlobalPlotConfig& gCfg, CliParser& cli )
+{
+    while( cli.HasArgs() )
+    {
+        if( cli.ArgConsume( "-h", "--help" ) )
+        {
+            CmdRecompressHelp();
+            Exit( 0 );
+        }
+        else
+            break;
+    }
+
+    FatalIf( !cli.HasArgs(), "Expected a path to a plot file." );
+    const char* plotPath = cli.Arg();
+    cli.NextArg();
+
+    FatalIf( !cli.HasArgs(), "Expected an output directory." );
+    std::string outDir = cli.Arg();
+    cli.NextArg();
+
+    FatalIf( cli.HasArgs(), "Unexpected argument '%s'.", cli.Arg() );
+    FatalIf( gCfg.compressionLevel < 1 || gCfg.compressionLevel > 7,
+        "recompress needs a target compression level between 1 and 7 (-z)." );
+
+    {
+        const char endChar = outDir.back();
+        if( endChar != '/' && endChar != '\\' )
+            outDir += '/';
+    }
+
+    MemoryPlot plot;
+    FatalIf( !plot.Open( plotPath ), "Failed to open plot file '%s' with error %d.", plotPath, plot.GetError() );
+    FatalIf( plot.K() != 32, "Only k32 plots can be recompressed." );
+    FatalIf( plot.CompressionLevel() != 0, "Plot '%s' is already compressed (C%u).", plotPath, plot.CompressionLevel() );
+
+    // The table sizes of aligned plots include the padding of their last page,
+    // which is not worth supporting for sources written by this plotter.
+    FatalIf( plot.HasAlignedParks(), "Plots with aligned parks can't be recompressed." );
+
+    const uint32 maxThreads  = SysHost::GetLogicalCPUCount();
+    const uint32 threadCount = std::min( { gCfg.threadCount == 0 ? maxThreads : gCfg.threadCount, maxThreads, (uint32)MAX_THREADS } );
+
+    ThreadPool pool( threadCount, ThreadPool::Mode::Fixed, true );
+
+    RecompressContext cx;
+    cx.pool        = &pool;
+    cx.threadCount = threadCount;
+    cx.plot        = &plot;
+    cx.level       = gCfg.compressionLevel;
+    cx.info        = GetCompressionInfoForLevel( cx.level );
+    cx.cTable      = CreateCompressionCTable( cx.level );
+    cx.deltaCoding = gCfg.parkDeltaCoding;
+    cx.tunedDeltas = gCfg.tunedDeltas;
+
+    // Table 1 holds the most entries, as every table after it was pruned against it
+    uint64 maxEntries = 0;
+    {
+        PlotReader reader( plot );
+
+        for( PlotTable t = PlotTable::Table1; t <= PlotTable::Table6; t++ )
+            maxEntries = std::max( maxEntries, (uint64)reader.GetTableParkCount( t ) * kEntriesPerPark );
+    }
+
+    Log::Line( "Recompressing '%s' to C%u with %u threads.", plotPath, cx.level, threadCount );
+    Log::Line( "Allocating %.2lf GiB for up to %llu entries per table.",
+        (double)( maxEntries * ( sizeof( uint64 ) * 2 + sizeof( uint32 ) * 3 ) ) BtoGB, (llu)maxEntries );
+
+    cx.lps    = bbcvirtallocboundednuma<uint64>( maxEntries );
+    cx.lpsTmp = bbcvirtallocboundednuma<uint64>( maxEntries );
+    cx.map    = bbcvirtallocboundednuma<uint32>( maxEntries );
+    cx.mapTmp = bbcvirtallocboundednuma<uint32>( maxEntries );
+    cx.lTable = bbcvirtallocboundednuma<uint32>( maxEntries );
+
+    char plotFileName[BB_COMPRESSED_PLOT_FILE_LEN_TMP+1] = {};
+    PlotTools::GenPlotFileName( plot.PlotId(), plotFileName, cx.level );
+
+    PlotWriter writer;
+    cx.writer = &writer;
+
+    FatalIf( !writer.BeginPlot( PlotVersion::v2_0, outDir.c_str(), plotFileName, plot.PlotId(), plot.PlotMemo(), (uint16)plot.PlotMemoSize(),
+              cx.level, GetParkDeltaCodingFlags( gCfg.parkDeltaCoding ) | ( gCfg.alignedParks ? PlotFlags::AlignedParks : PlotFlags::None ) |
+                        ( gCfg.tunedDeltas ? PlotFlags::TunedDeltas : PlotFlags::None ) ),
+            "Failed to open plot file with error: %d", writer.GetError() );
+
+    const auto timer = TimerBegin();
+
+    // Table 1 is dropped, its x pairs are inlined into table 2
+    writer.ReserveTableSize( PlotTable::Table1, 0 );
+
+    uint64 entryCount = 0;
+    for( TableId table = TableId::Table1; table <= TableId::Table6; table++ )
+        entryCount = RecompressTable( cx, table );
+
+    // Table 7 and the checkpoint tables are unchanged, only the indices of P7 are remapped
+    RecompressP7( cx, entryCount );
+    CopyTable( cx, PlotTable::C1 );
+    CopyTable( cx, PlotTable::C2 );
+    CopyTable( cx, PlotTable::C3 );
+
+    writer.EndPlot( true );
+    writer.WaitForPlotToComplete();
+
+    const double elapsed = TimerEnd( timer );
+    Log::Line( "Recompressed plot in %.2lf seconds: %s%s", elapsed, outDir.c_str(), plotFileName );
+    Log::Line( "Read %.2lf GiB, wrote %.2lf GiB.", (double)plot.PlotSize() BtoGB,
+        (double)( writer.GetTableSizes()[(int)PlotTable::C3] + writer.GetTablePointers()[(int)PlotTable::C3] ) BtoGB );
+
+    bbvirtfreebounded( cx.lps    );
+    bbvirtfreebounded( cx.lpsTmp );
+    bbvirtfreebounded( cx.map    );
+    bbvirtfreebounded( cx.mapTmp );
+    bbvirtfreebounded( cx.lTable );
+}
+
+//-----------------------------------------------------------
+template<typename F>
+static uint64 ReadParks( RecompressContext& cx, const TableId table, F func )
+{
+    const uint64 parkCount = PlotReader( *cx.plot ).GetTableParkCount( (PlotTable)table );
+
+    std::atomic<uint64> entryCount = 0;
+
+    AnonMTJob::Run( *cx.pool, cx.threadCount, [&]( AnonMTJob* self ) {
+
+        MemoryPlot plot( *cx.plot );
+        PlotReader reader( plot );
+
+        uint64 count, offset, end;
+        GetThreadOffsets( self, parkCount, count, offset, end );
+
+        uint128 linePoints[kEntriesPerPark];
+        uint64  threadEntries = 0;
+
+        for( uint64 i = offset; i < end; i++ )
+        {
+            uint64 parkEntryCount = 0;
+
+            if( !reader.ReadLPPark( table, i, linePoints, parkEntryCount ) )
+            {
+                // There may be empty space after the last park
+                FatalIf( !self->IsLastThread(), "Failed to read table %u park %llu.", table+1, (llu)i );
+                break;
+            }
+
+            func( i * kEntriesPerPark, linePoints, parkEntryCount );
+            threadEntries += parkEntryCount;
+
+            // Only the last park may be partially filled
+            if( parkEntryCount < kEntriesPerPark )
+            {
+                FatalIf( !self->IsLastThread(), "Table %u park %llu is not full and it is not the last park.", table+1, (llu)i );
+                break;
+            }
+        }
+
+        entryCount += threadEntries;
+    });
+
+    return entryCount;
+}
+
+//-----------------------------------------------------------
+static uint64 RecompressTable( RecompressContext& cx, const TableId table )
+{
+    auto timer = TimerBegin();
+
+    uint64 entryCount;
+
+    if( table == TableId::Table1 )
+    {
+        // Truncate the x pairs of table 2 the same way the plotter does when it drops table 1
+        const uint32 entryBits = cx.info.entrySizeBits;
+        const uint32 shift     = 32 - entryBits;
+        uint32*      x12s      = cx.lTable;
+
+        entryCount = ReadParks( cx, table, [=]( const uint64 offset, const uint128* linePoints, const uint64 count ) {
+
+            for( uint64 i = 0; i < count; i++ )
+            {
+                const BackPtr xs = LinePointToSquare64( (uint64)linePoints[i] );
+
+                x12s[offset+i] = (uint32)SquareToLinePoint( (uint32)xs.x >> shift, (uint32)xs.y >> shift );
+                ASSERT( !( x12s[offset+i] & ( 1ul << ( entryBits*2-1 ) ) ) );
+            }
+        });
+
+        Log::Line( "  Truncated %llu table 1 x pairs to %u bits in %.2lf seconds.", (llu)entryCount, entryBits, TimerEnd( timer ) );
+        return entryCount;
+    }
+
+    // Re-point the back pointers at the new values and positions of the previous table
+    const uint32* lTable = cx.lTable;
+    uint64*       lps    = cx.lps;
+    uint32*       map    = cx.map;
+
+    entryCount = ReadParks( cx, table, [=]( const uint64 offset, const uint128* linePoints, const uint64 count ) {
+
+        for( uint64 i = 0; i < count; i++ )
+        {
+            const BackPtr bp = LinePointToSquare64( (uint64)linePoints[i] );
+
+            lps[offset+i] = SquareToLinePoint( lTable[bp.x], lTable[bp.y] );
+            map[offset+i] = (uint32)( offset + i );
+        }
+    });
+
+    // The previous table's parks must be written before its park buffer is re-used for sorting
+    cx.writer->SignalFence( cx.writeFence );
+    cx.writeFence.Wait();
+
+    // Table 2's line points are made of truncated x pairs, of less than entryBits*2-1 bits each,
+    // so their high bytes need not be sorted. The other tables point at full 32-bit positions.
+    const uint32 lpBits = table == TableId::Table2 ? cx.info.entrySizeBits * 4 - 3 : 64;
+
+    RadixSort256::SortWithKeyTrimmed<MAX_THREADS>( *cx.pool, 0, cx.lps, cx.lpsTmp, cx.map, cx.mapTmp, entryCount, lpBits );
+
+    // Build the lookup of the entries' new positions for the next table
+    {
+        const uint32* sortedMap = cx.map;
+        uint32*       lookup    = cx.mapTmp;
+
+        AnonMTJob::RunRanges( *cx.pool, cx.threadCount, entryCount, [=]( AnonMTJob* self, const uint64 offset, const uint64 count ) {
+
+            for( uint64 i = offset; i < offset + count; i++ )
+                lookup[sortedMap[i]] = (uint32)i;
+        });
+
+        std::swap( cx.lTable, cx.mapTmp );
+    }
+
+    WriteTableParks( cx, table, entryCount );
+
+    Log::Line( "  Recompressed table %u with %llu entries in %.2lf seconds.", table+1, (llu)entryCount, TimerEnd( timer ) );
+    return entryCount;
+}
+
+//-----------------------------------------------------------
+static void WriteTableParks( RecompressContext& cx, const TableId table, const uint64 entryCount )
+{
+    size_t            parkSize    = CalculateParkSize( table );
+    uint64            stubBitSize = (_K - kStubMinusBits);
+    const FSE_CTable* cTable      = CTables[(int)table];
+    double            rValue      = kRValues[(int)table];
+
+    // Table 2 holds the inlined x pairs of table 1
+    if( table == TableId::Table2 )
+    {
+        parkSize    = cx.info.tableParkSize;
+        stubBitSize = cx.info.stubSizeBits;
+        cTable      = cx.cTable;
+        rValue      = cx.info.ansRValue;
+    }
+
+    if( cx.tunedDeltas )
+    {
+        const double tunedRValue = TuneParkDeltaRValue( cx.lps, entryCount, stubBitSize, rValue );
+
+        if( tunedRValue != rValue )
+        {
+            rValue = tunedRValue;
+            cTable = CreateTunedCTable( rValue );
+            cx.writer->SetDeltaRValue( (PlotTable)table, rValue );
+        }
+    }
+
+    const RANSEncTable* ransTable = cx.deltaCoding == ParkDeltaCoding::RANS ? CreateRANSEncTable( rValue ) : nullptr;
+
+    // The sort's tmp buffer is free until the next table is sorted
+    byte* parkBuffer = (byte*)cx.lpsTmp;
+
+    const uint64 parksPerChunk   = std::max( (uint64)( PARK_CHUNK_SIZE / parkSize ), (uint64)cx.threadCount );
+    const uint64 entriesPerChunk = parksPerChunk * kEntriesPerPark;
+
+    cx.writer->BeginTable( (PlotTable)table );
+
+    for( uint64 entryOffset = 0; entryOffset < entryCount; entryOffset += entriesPerChunk )
+    {
+        const uint64 chunkEntries = std::min( entriesPerChunk, entryCount - entryOffset );
+        byte*        chunkBuffer  = parkBuffer + entryOffset / kEntriesPerPark * parkSize;
+
+        const size_t chunkSize = WriteParks<MAX_THREADS>( *cx.pool, chunkEntries, cx.lps + entryOffset, chunkBuffer,
+                                                          parkSize, stubBitSize, cTable, cx.deltaCoding, ransTable );
+
+        cx.writer->WriteTableData( chunkBuffer, chunkSize );
+    }
+
+    cx.writer->EndTable();
+}
+
+//-----------------------------------------------------------
+static void RecompressP7( RecompressContext& cx, const uint64 entryCount )
+{
+    auto timer = TimerBegin();
+
+    const uint64  parkCount = CDiv( entryCount, kEntriesPerPark );
+    const uint32* lookup    = cx.lTable;
+    uint32*       indices   = cx.map;
+
+    AnonMTJob::Run( *cx.pool, cx.threadCount, [&]( AnonMTJob* self ) {
+
+        MemoryPlot plot( *cx.plot );
+        PlotReader reader( plot );
+
+        uint64 count, offset, end;
+        GetThreadOffsets( self, parkCount, count, offset, end );
+
+        uint64 p7Entries[kEntriesPerPark];
+
+        for( uint64 i = offset; i < end; i++ )
+        {
+            FatalIf( !reader.ReadP7Entries( i, p7Entries ), "Failed to read P7 park %llu.", (llu)i );
+
+            const uint64 parkEntries = std::min( (uint64)kEntriesPerPark, entryCount - i * kEntriesPerPark );
+
+            for( uint64 e = 0; e < parkEntries; e++ )
+                indices[i * kEntriesPerPark + e] = lookup[p7Entries[e]];
+        }
+    });
+
+    // Table 6's parks may still be in flight from the sort's tmp buffer
+    cx.writer->SignalFence( cx.writeFence );
+    cx.writeFence.Wait();
+
+    byte* p7Buffer = (byte*)cx.lpsTmp;
+
+    const size_t sizeWritten = WriteP7Parallel<MAX_THREADS>( *cx.pool, entryCount, indices, p7Buffer );
+
+    cx.writer->BeginTable( PlotTable::Table7 );
+    cx.writer->WriteTableData( p7Buffer, sizeWritten );
+    cx.writer->EndTable();
+
+    Log::Line( "  Remapped %llu P7 entries in %.2lf seconds.", (llu)entryCount, TimerEnd( timer ) );
+}
+
+//-----------------------------------------------------------
+static void CopyTable( RecompressContext& cx, const PlotTable table )
+{
+    // The plot is mapped for as long as the command runs, so its tables are written in-place
+    const byte*  src  = cx.plot->MappedData() + cx.plot->TableAddress( table );
+    const size_t size = cx.plot->TableSize( table );
+
+    cx.writer->BeginTable( table );
+    cx.writer->WriteTableData( src, size );
+    cx.writer->EndTable();
+}
+
+//-----------------------------------------------------------
+void CmdRecompressHelp()
+{
+    Log::Line( R"(
+recompress [OPTIONS] <plot_path> <out_dir>
+
+Converts an uncompressed k32 plot to a compressed plot of the level given with the global -z option (1 to 7),
+without plotting it again.
+
+The x pairs of table 1 are truncated and inlined into table 2, as the plotter does when it drops table 1.
+Tables 2 to 6 are re-sorted on their new line points and their back pointers are remapped.
+Table 7 keeps its f7 order, so P7 is only remapped and the C1, C2 and C3 tables are copied as they are.
+The new plot keeps the plot id and memo of the source plot.
+
+The source plot is mapped and read through once, and the tables are converted in RAM:
+about 28 bytes per entry of table 1, or about 100 GiB for a k32 plot.
+The park delta coding and alignment of the new plot are taken from the global options.
+
+Plots that are already compressed, or that have aligned parks, can't be recompressed.
+
+[OPTIONS]
+ -h, --help: Display this help message and exit.
+
+Example:
+ bladebit -t 32 -z 5 recompress /mnt/plots/plot-k32-2023-01-01-00-00-<id>.plot /mnt/plots-c5
+)" );
+}
@@ -0,0 +1,337 @@
+#include "Commands.h"
+#include "harvesting/GreenReaper.h"
+#include "harvesting/HarvestTrace.h"
+#include "util/LatencyHistogram.h"
+#include <algorithm>
+#include <mutex>
+#include <thread>
+
+struct ReplayConfig
+{
+    GlobalPlotConfig* gCfg            = nullptr;
+    const char*       tracePath       = nullptr;
+    float64           speed           = 1.0;    // 0 replays as fast as possible
+    uint32            inFlight        = 1;      // Requests in flight when replaying as fast as possible
+    bool              noCuda          = false;
+    bool              allDevices      = false;
+    int32             cudaDevice      = 0;
+    uint32            hybridDepth     = 0;
+    uint32            gpuSlots        = 0;
+    uint32            table1CacheSize = 0;
+    bool              json            = false;
+};
+
+// Indexed by HarvestTraceKind
+static constexpr uint32 KIND_COUNT    = 2;
+static constexpr uint32 RESULT_COUNT  = (uint32)GRResult_Expired + 1;
+static const char*      KIND_NAMES[]  = { "qualities", "proofs" };
+
+struct ReplayStats
+{
+    std::mutex       lock;
+    LatencyHistogram latency       [KIND_COUNT];
+    LatencyHistogram recordedLatency[KIND_COUNT];
+    uint64           results       [KIND_COUNT][RESULT_COUNT] = {};
+    uint64           mismatched    [KIND_COUNT] = {};   // Results other than the one in the trace
+};
+
+struct ReplayRequest
+{
+    GRCompressedProofRequest              proof;
+    GRCompressedQualitiesRequest          qualities;
+    const HarvestTraceEntry*              entry;
+    ReplayStats*                          stats;
+    std::chrono::steady_clock::time_point startTime;
+};
+
+static GreenReaperContext* CreateReplayContext( const ReplayConfig& cfg, uint32 maxCompressionLevel );
+static void OnRequestCompleted( GRAsyncRequest* request, GRResult result, void* userData );
+static void PrintReport( const ReplayConfig& cfg, const ReplayStats& stats, uint64 requestCount, double recordedSecs, double elapsedSecs, bool usedGpu );
+
+//-----------------------------------------------------------
+void CmdReplayMain( GlobalPlotConfig& gCfg, CliParser& cli )
+{
+    ReplayConfig cfg = {};
+    cfg.gCfg = &gCfg;
+
+    while( cli.HasArgs() )
+    {
+        if( cli.ArgConsume( "-h", "--help" ) )
+        {
+            CmdReplayHelp();
+            Exit( 0 );
+        }
+        else if( cli.ReadF64( cfg.speed, "-s", "--speed" ) ) continue;
+        else if( cli.ReadU32( cfg.inFlight, "-p", "--in-flight" ) ) continue;
+        else if( cli.ReadSwitch( cfg.noCuda, "--no-cuda" ) ) continue;
+        else if( cli.ReadSwitch( cfg.allDevices, "--all-devices" ) ) continue;
+        else if( cli.ReadI32( cfg.cudaDevice, "-d", "--device" ) ) continue;
+        else if( cli.ReadU32( cfg.hybridDepth, "--hybrid" ) ) continue;
+        else if( cli.ReadU32( cfg.gpuSlots, "--gpu-slots" ) ) continue;
+        else if( cli.ReadU32( cfg.table1CacheSize, "--t1-cache" ) ) continue;
+        else if( cli.ReadSwitch( cfg.json, "--json" ) ) continue;
+        else
+            break;
+    }
+
+    FatalIf( !cli.HasArgs(), "Expected a path to a harvester trace file." );
+    cfg.tracePath = cli.Arg();
+    cli.NextArg();
+    FatalIf( cli.HasArgs(), "Unexpected argument '%s'.", cli.Arg() );
+
+    FatalIf( cfg.speed < 0.0, "Invalid replay speed of %lf.", cfg.speed );
+    FatalIf( cfg.inFlight < 1, "Invalid in-flight request count of %u.", cfg.inFlight );
+    FatalIf( cfg.noCuda && ( cfg.allDevices || cfg.hybridDepth > 0 || cfg.gpuSlots > 0 ),
+        "--all-devices, --hybrid and --gpu-slots can't be used with --no-cuda." );
+
+    HarvestTraceHeader             header = {};
+    std::vector<HarvestTraceEntry> entries;
+    FatalIf( !HarvestTrace::Load( cfg.tracePath, header, entries ), "Failed to load harvester trace file '%s'.", cfg.tracePath );
+    FatalIf( entries.empty(), "The trace '%s' holds no requests.", cfg.tracePath );
+
+    // Records are written as requests complete, replay them in the order they started
+    std::stable_sort( entries.begin(), entries.end(), []( const HarvestTraceEntry& a, const HarvestTraceEntry& b ) {
+        return a.record.timestampNS < b.record.timestampNS;
+    });
+
+    ReplayStats* stats = new ReplayStats();
+
+    uint32 maxCompressionLevel = 0;
+    for( const HarvestTraceEntry& e : entries )
+    {
+        maxCompressionLevel = std::max( maxCompressionLevel, (uint32)e.record.compressionLevel );
+        stats->recordedLatency[e.record.kind].Record( e.record.latencyNS );
+    }
+
+    const uint64 firstTimestamp = entries.front().record.timestampNS;
+    const double recordedSecs   = (double)( entries.back().record.timestampNS - firstTimestamp ) / 1e9;
+
+    if( !cfg.json )
+    {
+        Log::Line( "Replaying %llu requests recorded over %.2lf seconds from '%s'.",
+            (llu)entries.size(), recordedSecs, cfg.tracePath );
+        if( cfg.speed > 0.0 )
+            Log::Line( " Speed              : %.2lfx", cfg.speed );
+        else
+            Log::Line( " Requests in flight : %u, as fast as possible", cfg.inFlight );
+    }
+
+    GreenReaperContext* context = CreateReplayContext( cfg, maxCompressionLevel );
+    const bool          usedGpu = grHasGpuDecompressor( context ) == GR_TRUE;
+
+    std::vector<ReplayRequest>   requests( entries.size() );
+    std::vector<GRAsyncRequest*> handles ( entries.size(), nullptr );
+    uint64 waited = 0;
+
+    const auto replayStart = TimerBegin();
+
+    for( uint64 i = 0; i < entries.size(); i++ )
+    {
+        const HarvestTraceEntry& e = entries[i];
+        ReplayRequest&           r = requests[i];
+
+        r.entry = &e;
+        r.stats = stats;
+
+        if( cfg.speed > 0.0 )
+        {
+            // Latency is measured from when the request was due, so that falling behind shows up in it
+            r.startTime = replayStart + std::chrono::nanoseconds( (uint64)( (double)( e.record.timestampNS - firstTimestamp ) / cfg.speed ) );
+            std::this_thread::sleep_until( r.startTime );
+        }
+        else
+        {
+            if( i >= cfg.inFlight )
+            {
+                grWaitForRequest( handles[waited] );
+                grReleaseRequest( handles[waited++] );
+            }
+
+            r.startTime = TimerBegin();
+        }
+
+        GRResult submitResult;
+
+        if( e.record.kind == (uint8)HarvestTraceKind::Proof )
+        {
+            r.proof = {};
+            r.proof.plotId           = e.record.plotId;
+            r.proof.compressionLevel = e.record.compressionLevel;
+            memcpy( r.proof.compressedProof, e.compressedProof, sizeof( e.compressedProof ) );
+
+            submitResult = grSubmitProofForChallenge( context, &r.proof, OnRequestCompleted, &r, &handles[i] );
+        }
+        else
+        {
+            r.qualities = {};
+            r.qualities.plotId           = e.record.plotId;
+            r.qualities.challenge        = e.qualities.challenge;
+            r.qualities.compressionLevel = e.record.compressionLevel;
+            memcpy( r.qualities.xLinePoints, e.qualities.xLinePoints, sizeof( r.qualities.xLinePoints ) );
+
+            submitResult = grSubmitQualitiesXPair( context, &r.qualities, OnRequestCompleted, &r, &handles[i] );
+        }
+
+        FatalIf( submitResult != GRResult_OK, "Failed to submit request %llu with error: %s.", (llu)i, grResultToString( submitResult ) );
+    }
+
+    for( ; waited < handles.size(); waited++ )
+    {
+        grWaitForRequest( handles[waited] );
+        grReleaseRequest( handles[waited] );
+    }
+
+    const double elapsedSecs = TimerEnd( replayStart );
+
+    grDestroyContext( context );
+
+    PrintReport( cfg, *stats, entries.size(), recordedSecs, elapsedSecs, usedGpu );
+    delete stats;
+}
+
+//-----------------------------------------------------------
+GreenReaperContext* CreateReplayContext( const ReplayConfig& cfg, const uint32 maxCompressionLevel )
+{
+    GreenReaperConfig grCfg = {};
+    grCfg.apiVersion         = GR_API_VERSION;
+    grCfg.threadCount        = std::min( cfg.gCfg->threadCount == 0 ? 8 : cfg.gCfg->threadCount, SysHost::GetLogicalCPUCount() );
+    grCfg.disableCpuAffinity = cfg.gCfg->disableCpuAffinity;
+    grCfg.gpuRequest         = cfg.noCuda     ? GRGpuRequestKind_None :
+                               cfg.allDevices ? GRGpuRequestKind_AllDevices : GRGpuRequestKind_FirstAvailable;
+    grCfg.gpuDeviceIndex     = (uint32)cfg.cudaDevice;
+    grCfg.hybridQueueDepth   = cfg.hybridDepth;
+    grCfg.gpuSlotsPerDevice  = cfg.gpuSlots;
+    grCfg.table1CacheSize    = cfg.table1CacheSize;
+
+    GreenReaperContext* context = nullptr;
+    const auto result = grCreateContext( &context, &grCfg, sizeof( GreenReaperConfig ) );
+    FatalIf( !context, "Failed to create decompression context with error: %s.", grResultToString( result ) );
+
+    // Don't count buffer allocations in the first requests' latencies
+    if( maxCompressionLevel >= 1 && maxCompressionLevel <= 9 )
+    {
+        const auto r = grPreallocateForCompressionLevel( context, 32, maxCompressionLevel );
+        FatalIf( r != GRResult_OK, "Failed to allocate decompression buffers with error: %s.", grResultToString( r ) );
+    }
+
+    return context;
+}
+
+//-----------------------------------------------------------
+void OnRequestCompleted( GRAsyncRequest* request, const GRResult result, void* userData )
+{
+    const auto endTime = TimerBegin();
+
+    ReplayRequest& r    = *(ReplayRequest*)userData;
+    const uint32   kind = r.entry->record.kind;
+
+    std::lock_guard<std::mutex> lock( r.stats->lock );
+
+    r.stats->latency[kind].Record( (uint64)TicksToNanoSeconds( endTime - r.startTime ) );
+
+    if( (uint32)result < RESULT_COUNT )
+        r.stats->results[kind][result]++;
+
+    if( (uint8)result != r.entry->record.result )
+        r.stats->mismatched[kind]++;
+}
+
+//-----------------------------------------------------------
+static void PrintLatencyLine( const char* name, const LatencyHistogram& h )
+{
+    Log::Line( "  %-9s: min %8.2lf  p50 %8.2lf  p90 %8.2lf  p99 %8.2lf  max %8.2lf  mean %8.2lf", name,
+        (double)h.Min() / 1e6, (double)h.ValueAtPercentile( 50 ) / 1e6, (double)h.ValueAtPercentile( 90 ) / 1e6,
+        (double)h.ValueAtPercentile( 99 ) / 1e6, (double)h.Max() / 1e6, (double)h.Mean() / 1e6 );
+}
+
+//-----------------------------------------------------------
+void PrintReport( const ReplayConfig& cfg, const ReplayStats& stats, const uint64 requestCount,
+                  const double recordedSecs, const double elapsedSecs, const bool usedGpu )
+{
+    if( cfg.json )
+    {
+        Log::Write( R"({"requests": %llu, "recorded_secs": %.4lf, "elapsed_secs": %.4lf, "speed": %.4lf, "decompressor": "%s")",
+            (llu)requestCount, recordedSecs, elapsedSecs, cfg.speed, usedGpu ? "gpu" : "cpu" );
+
+        for( uint32 kind = 0; kind < KIND_COUNT; kind++ )
+        {
+            Log::Write( R"(, "%s": {"count": %llu, "mismatched": %llu, "results": {)",
+                KIND_NAMES[kind], (llu)stats.latency[kind].Count(), (llu)stats.mismatched[kind] );
+
+            bool first = true;
+            for( uint32 r = 0; r < RESULT_COUNT; r++ )
+            {
+                if( !stats.results[kind][r] )
+                    continue;
+
+                Log::Write( first ? R"("%s": %llu)" : R"(, "%s": %llu)", grResultToString( (GRResult)r ), (llu)stats.results[kind][r] );
+                first = false;
+            }
+
+            Log::Write( R"(}, "latency": )" );
+            stats.latency[kind].WriteJson();
+            Log::Write( R"(, "recorded_latency": )" );
+            stats.recordedLatency[kind].WriteJson();
+            Log::Write( "}" );
+        }
+
+        Log::Line( "}" );
+        return;
+    }
+
+    Log::Line( "" );
+    Log::Line( "Replayed %llu requests in %.2lf seconds (%.2lf requests/s) on the %s.",
+        (llu)requestCount, elapsedSecs, (double)requestCount / elapsedSecs, usedGpu ? "GPU" : "CPU" );
+
+    for( uint32 kind = 0; kind < KIND_COUNT; kind++ )
+    {
+        if( stats.latency[kind].Count() == 0 )
+            continue;
+
+        Log::Line( "" );
+        Log::Line( " %s: %llu requests, %llu with a different result than recorded",
+            kind == (uint32)HarvestTraceKind::Proof ? "Full proofs" : "Qualities",
+            (llu)stats.latency[kind].Count(), (llu)stats.mismatched[kind] );
+
+        for( uint32 r = 0; r < RESULT_COUNT; r++ )
+        {
+            if( stats.results[kind][r] )
+                Log::Line( "  %-22s: %llu", grResultToString( (GRResult)r ), (llu)stats.results[kind][r] );
+        }
+
+        Log::Line( "  Latency (ms):" );
+        PrintLatencyLine( "Replayed", stats.latency[kind] );
+        PrintLatencyLine( "Recorded", stats.recordedLatency[kind] );
+    }
+}
+
+
+static const char _help[] = R"(replay [OPTIONS] <trace_file>
+Replays a harvester request trace, recorded with grBeginTrace() in the harvester library,
+through a decompression context and reports the latency distribution of qualities and full proof requests,
+along with the latencies recorded in the trace.
+
+Requests are submitted asynchronously, at the time they were made in the trace, scaled by --speed.
+Their latency is measured from that time, so it includes the time spent waiting behind earlier requests.
+
+OPTIONS:
+ -h, --help             : Display this help message and exit.
+ -s, --speed <x>        : Replay at <x> times the recorded request rate. (default = 1)
+                          0 replays as fast as possible, keeping --in-flight requests in flight.
+ -p, --in-flight <count>: Requests in flight when replaying with --speed 0. (default = 1)
+ --no-cuda              : Don't use CUDA for decompression.
+ -d, --device <index>   : Cuda device index. (default = 0)
+ --all-devices          : Use all available GPUs.
+ --hybrid <depth>       : Also decompress on the CPU whenever the GPU has <depth> requests in flight.
+ --gpu-slots <count>    : Requests each GPU decompresses concurrently.
+ --t1-cache <count>     : Table 1 x-bucket results to keep cached for proof fetches following a qualities fetch.
+ --json                 : Output the report in json, with latency histograms.
+
+The number of CPU decompression threads is set with the global -t option. (default = 8)
+)";
+
+//-----------------------------------------------------------
+void CmdReplayHelp()
+{
+    Log::Write( _help );
+}
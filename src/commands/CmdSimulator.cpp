@@ -1,13 +1,18 @@
 #include "Commands.h"
 #include "plotting/GlobalPlotConfig.h"
 #include "tools/PlotReader.h"
+#include "tools/PlotIndexCache.h"
 #include "threading/MTJob.h"
 #include "harvesting/GreenReaper.h"
 #include "plotting/f1/F1Gen.h"
+#include "util/LatencyHistogram.h"
+#include <random>
 
 static constexpr double SECS_PER_DAY       = 24 * 60 * 60;
 static constexpr double CHALLENGE_INTERVAL = 9.375;
 static constexpr uint32 CHALLENGES_PER_DAY = (uint32)(SECS_PER_DAY / CHALLENGE_INTERVAL);
+static constexpr double FULL_PROOF_TIME_LIMIT = 30.0;
+static constexpr double DEFAULT_DISK_SIZE     = 18e12;   // Farm size per disk when none is given in schedule mode
 
 enum class SubCommand
 {
@@ -29,6 +34,19 @@ struct Config
     double      powerSimSeconds = -1;
     bool        noCuda          = false;
     int32       cudaDevice      = 0;
+    bool        json            = false;        // Output the report as json
+    size_t      indexCacheSize  = 0;            // Keep decoded C1 tables resident, up to this many bytes
+    uint32      hotC3Parks      = 0;            // Decoded C3 parks kept per plot in the index cache
+
+    // Schedule simulation: Replay signage points against a farm spread over diskCount disks
+    uint64      scheduleSPCount = 0;
+    uint32      diskCount       = 1;
+    double      diskSeekMs      = 10.0;         // Average random access latency per read
+    double      diskMBps        = 200.0;        // Sequential read throughput per disk
+
+    // Capacity search: Grow the simulated farm until the p99 signage point lookup time goes over maxLookupTime
+    bool        findMax         = false;
+    std::vector<const char*> plotPaths;         // One search per plot, so per compression level
 
     // Internally set
     double      partialRatio  = 0;
@@ -36,6 +54,10 @@ struct Config
 
     // Set by the simulation job
     size_t      jobsMemoryUsed = 0;
+    bool        usedGpu        = false;
+
+    // Decompression contexts created up front, one per job, and reused between runs. Created by each job if not set.
+    GreenReaperContext** contexts = nullptr;
 };
 
 struct JobStats
@@ -47,6 +69,19 @@ struct JobStats
     std::atomic<uint64> totalFullProofTimeNano  = 0;                                  // 
     std::atomic<uint64> maxFetchTimeNano        = 0;                                  // Largest amount of time spent fetching from plots (includes both qualities and full proof)
     std::atomic<uint64> minFPFetchTimeNano      = std::numeric_limits<uint64>::max(); // Smallest amount of time spent fetching from plots (includes both qualities and full proof)
+
+    // Measured decompression costs, used to replay the schedule simulation
+    std::mutex          sampleLock;
+    std::vector<uint64> qualitySamplesNano;                                           // Time for all qualities of one plot lookup
+    std::vector<uint64> fullProofSamplesNano;                                         // Time for a single full proof
+
+    LatencyHistogram    qualityHistogram;                                             // Qualities time per plot lookup
+    LatencyHistogram    fullProofHistogram;                                           // Time per full proof
+
+    // Capacity search
+    LatencyHistogram    spHistogram;                                                  // Time until all contexts are done with a signage point
+    uint64              spOverLimit     = 0;
+    bool                abortTrial      = false;                                      // Enough signage points went over the limit for the p99 to be over it
 };
 
 struct SimulatorJob : MTJob<SimulatorJob>
@@ -55,6 +90,7 @@ struct SimulatorJob : MTJob<SimulatorJob>
     Span<FilePlot> plots;
     JobStats*      stats;
     uint32         decompressorThreadCount;
+    uint64         spElapsedNano;           // Capacity search: This job's time for the last signage point
 
     virtual void Run() override;
 
@@ -62,8 +98,10 @@ struct SimulatorJob : MTJob<SimulatorJob>
 };
 
 
-static size_t CalculatePlotSizeBytes( const uint32 k, const uint32 compressionLevel );
 static void DumpCompressedPlotCapacity( const Config& cfg, const uint32 k, const uint32 compressionLevel, const double fetchAverageSecs );
+static void RunScheduleSimulation( const Config& cfg, const uint32 k, const uint32 compressionLevel, const JobStats& stats );
+static void RunFindMax( Config& cfg, uint32 decompressorThreadCount );
+static GreenReaperContext* CreateSimulatorContext( const Config& cfg, uint32 threadCount, uint32 cpuOffset, bool useGpu );
 
 void CmdSimulateMain( GlobalPlotConfig& gCfg, CliParser& cli )
 {
@@ -92,7 +130,15 @@ void CmdSimulateMain( GlobalPlotConfig& gCfg, CliParser& cli )
         else if( cli.ReadSize( cfg.farmSize, "-s", "--size" ) ) continue;
         else if( cli.ReadHexStrAsBytes( cfg.randomSeed, sizeof( cfg.randomSeed ), "--seed" ) ) continue;
         else if( cli.ReadSwitch( cfg.noCuda, "--no-cuda" ) ) continue;
+        else if( cli.ReadSwitch( cfg.json, "--json" ) ) continue;
         else if( cli.ReadI32( cfg.cudaDevice, "-d", "--device" ) ) continue;
+        else if( cli.ReadU64( cfg.scheduleSPCount, "--schedule" ) ) continue;
+        else if( cli.ReadU32( cfg.diskCount, "--disks" ) ) continue;
+        else if( cli.ReadF64( cfg.diskSeekMs, "--seek" ) ) continue;
+        else if( cli.ReadF64( cfg.diskMBps, "--disk-mbps" ) ) continue;
+        else if( cli.ReadSize( cfg.indexCacheSize, "--index-cache" ) ) continue;
+        else if( cli.ReadU32( cfg.hotC3Parks, "--hot-c3" ) ) continue;
+        else if( cli.ReadSwitch( cfg.findMax, "--find-max" ) ) continue;
         else
             break;
     }
@@ -102,6 +148,15 @@ void CmdSimulateMain( GlobalPlotConfig& gCfg, CliParser& cli )
         cfg.plotPath = cli.Arg();
         cli.NextArg();
 
+        cfg.plotPaths.push_back( cfg.plotPath );
+
+        // The capacity search takes one plot per compression level to search
+        while( cfg.findMax && cli.HasArgs() )
+        {
+            cfg.plotPaths.push_back( cli.Arg() );
+            cli.NextArg();
+        }
+
         if( cli.HasArgs() )
         {
             Fatal( "Unexpected argument '%s'.", cli.Arg() );
@@ -115,13 +170,30 @@ void CmdSimulateMain( GlobalPlotConfig& gCfg, CliParser& cli )
     FatalIf( cfg.parallelCount * (uint64)gCfg.threadCount > MAX_THREADS, 
         "Too many thread combination (%llu) between -t and -p", cfg.parallelCount * (llu)gCfg.threadCount );
 
-    const bool powerMode = cfg.powerSimSeconds > 0.0;
+    const bool powerMode    = cfg.powerSimSeconds > 0.0;
+    const bool scheduleMode = cfg.scheduleSPCount > 0;
+
+    FatalIf( powerMode && scheduleMode, "--power and --schedule can't be used together." );
+    FatalIf( cfg.diskCount < 1, "Invalid disk count of %u.", cfg.diskCount );
+    FatalIf( cfg.diskSeekMs < 0.0 || cfg.diskMBps <= 0.0, "Invalid disk latency model." );
+    FatalIf( cfg.hotC3Parks > 0 && cfg.indexCacheSize == 0, "--hot-c3 requires --index-cache." );
+    FatalIf( cfg.findMax && ( powerMode || scheduleMode ), "--find-max can't be used with --power or --schedule." );
+
+    if( cfg.indexCacheSize > 0 )
+        PlotIndexCache::Configure( cfg.indexCacheSize, cfg.hotC3Parks );
+
+    if( cfg.findMax )
+    {
+        RunFindMax( cfg, std::min( gCfg.threadCount == 0 ? 8 : gCfg.threadCount, SysHost::GetLogicalCPUCount() ) );
+        Exit( 0 );
+    }
 
     // Lower the parallel count until all instances have at least 1 lookup
     if( !powerMode && cfg.parallelCount > cfg.fetchCount )
     {
-        Log::Line( "Warning: Limiting parallel context count to %u, as it must be <= than the fetch count of %llu",
-            cfg.parallelCount, (llu)cfg.fetchCount );
+        if( !cfg.json )
+            Log::Line( "Warning: Limiting parallel context count to %u, as it must be <= than the fetch count of %llu",
+                cfg.parallelCount, (llu)cfg.fetchCount );
         cfg.parallelCount = (uint32)cfg.fetchCount;
     }
 
@@ -129,7 +201,8 @@ void CmdSimulateMain( GlobalPlotConfig& gCfg, CliParser& cli )
     if( !cfg.noCuda && cfg.parallelCount > 1 )
     {
         cfg.parallelCount = 1;
-        Log::Line( "Warning: Limiting the number of parallel contexts to 1 for CUDA harvester simulation." );
+        if( !cfg.json )
+            Log::Line( "Warning: Limiting the number of parallel contexts to 1 for CUDA harvester simulation." );
     }
 
 
@@ -150,20 +223,31 @@ void CmdSimulateMain( GlobalPlotConfig& gCfg, CliParser& cli )
             // Set a default farm size when at least 1 plot per context passes the filter
             const size_t plotSize = CalculatePlotSizeBytes( plot->K(), compressionLevel );
             cfg.farmSize = (uint64)cfg.parallelCount * plotSize * cfg.filterBits;
-            Log::Line( "Setting default farm size to %llu TB (use --size <size> to set a farm size manually).",
-                (llu)BtoTBSi( cfg.farmSize ) );
+            if( !cfg.json )
+                Log::Line( "Setting default farm size to %llu TB (use --size <size> to set a farm size manually).",
+                    (llu)BtoTBSi( cfg.farmSize ) );
         }
         
         // Adjust fetch count given the simulation time
         cfg.fetchCount = std::max( (uint64)1, (uint64)(cfg.powerSimSeconds / CHALLENGE_INTERVAL ) ) * cfg.parallelCount;
     }
+    else if( scheduleMode && cfg.farmSize == 0 )
+    {
+        cfg.farmSize = (size_t)(cfg.diskCount * DEFAULT_DISK_SIZE);
+        if( !cfg.json )
+            Log::Line( "Setting default farm size to %llu TB for %u disks (use --size <size> to set a farm size manually).",
+                (llu)BtoTBSi( cfg.farmSize ), cfg.diskCount );
+    }
 
 
 
-    Log::Line( "[Simulator for harvester farm capacity for K%2u C%u plots]", plot->K(), compressionLevel );
-    Log::Line( " Random seed: 0x%s", BytesToHexStdString( cfg.randomSeed, sizeof( cfg.randomSeed ) ).c_str() );
-    Log::Line( " Simulating..." );
-    Log::NewLine();
+    if( !cfg.json )
+    {
+        Log::Line( "[Simulator for harvester farm capacity for K%2u C%u plots]", plot->K(), compressionLevel );
+        Log::Line( " Random seed: 0x%s", BytesToHexStdString( cfg.randomSeed, sizeof( cfg.randomSeed ) ).c_str() );
+        Log::Line( " Simulating..." );
+        Log::NewLine();
+    }
 
 
     ThreadPool pool( cfg.parallelCount, ThreadPool::Mode::Fixed, true );
@@ -184,6 +268,34 @@ void CmdSimulateMain( GlobalPlotConfig& gCfg, CliParser& cli )
             stats.minFPFetchTimeNano = 0;
     }
 
+    if( scheduleMode )
+    {
+        RunScheduleSimulation( cfg, plot->K(), compressionLevel, stats );
+        Log::NewLine();
+        Exit( 0 );
+    }
+
+    if( cfg.json )
+    {
+        const size_t plotSize          = CalculatePlotSizeBytes( plot->K(), compressionLevel );
+        const uint64 fetchAverageNano  = stats.qualityHistogram.Mean();
+        const uint64 maxPlotCount      = fetchAverageNano == 0 ? 0 :
+                                            (uint64)(cfg.maxLookupTime / NanoSecondsToSeconds( fetchAverageNano ) * cfg.filterBits);
+
+        Log::Write( R"({"k": %u, "compression_level": %u, "device": "%s", "contexts": %u, "threads_per_context": %u, )",
+            plot->K(), compressionLevel, cfg.usedGpu ? "cuda" : "cpu", cfg.parallelCount, gCfg.threadCount );
+        Log::Write( R"("memory_bytes": %llu, "challenges": %llu, "proofs": %llu, "fetches": %llu, "full_proofs": %llu, "filter_bits": %u, )",
+            (llu)( cfg.jobsMemoryUsed * cfg.parallelCount ), (llu)cfg.fetchCount, (llu)stats.nTotalProofs.load(),
+            (llu)stats.nActualFetches.load(), (llu)stats.nActualFullProofFetches.load(), cfg.filterBits );
+        Log::Write( R"("max_lookup_seconds": %.3lf, "max_plot_count": %llu, "max_farm_bytes": %llu, "qualities": )",
+            cfg.maxLookupTime, (llu)maxPlotCount, (llu)( maxPlotCount * plotSize ) );
+        stats.qualityHistogram.WriteJson();
+        Log::Write( R"(, "full_proofs_latency": )" );
+        stats.fullProofHistogram.WriteJson();
+        Log::Line( "}" );
+        Exit( 0 );
+    }
+
     // Report
     {
         const uint64 actualFetchCount        = stats.nActualFetches;
@@ -240,75 +352,396 @@ void DumpCompressedPlotCapacity( const Config& cfg, const uint32 k, const uint32
     Log::Line( " C%-10u | %-10llu | %-10llu | %-10.2lf ", compressionLevel, plotCount, farmSizeTB, farmSizePB );
 }
 
-size_t CalculatePlotSizeBytes( const uint32 k, const uint32 compressionLevel )
+///
+/// Replays cfg.scheduleSPCount signage points against a farm of cfg.farmSize
+/// spread evenly over cfg.diskCount disks.
+/// For each signage point, the number of plots passing the filter is drawn from a
+/// Poisson distribution. Each passing plot queues its park reads on its disk, then
+/// queues its decompression on the first free decompression context, using the
+/// decompression costs measured on the real plot. Resources are reserved first-come,
+/// first-served, so lookups from busy signage points queue up behind each other.
+///
+/// Each read is modeled as one seek plus a park-sized transfer. Lookups are dependent
+/// chains of reads, walking C3 and P7, then one park per stored table for qualities,
+/// and the rest of the proof tree for a full proof.
+//-----------------------------------------------------------
+void RunScheduleSimulation( const Config& cfg, const uint32 k, const uint32 compressionLevel, const JobStats& stats )
 {
-    ASSERT( compressionLevel > 0 );
-
-    auto info = GetCompressionInfoForLevel( compressionLevel );
+    FatalIf( stats.qualitySamplesNano.empty(), "No lookup cost samples were taken." );
+
+    const size_t plotSize       = CalculatePlotSizeBytes( k, compressionLevel );
+    const uint64 farmPlotCount  = (uint64)cfg.farmSize / plotSize;
+    const double plotsPerSP     = farmPlotCount / (double)cfg.filterBits;
+    const double partialChance  = plotsPerSP <= 0.0 ? 0.0 : std::min( 1.0, cfg.partials / ( CHALLENGES_PER_DAY * plotsPerSP ) );
+
+    // Table 1 is always dropped, table 2 is dropped as well from C9 and up
+    const uint32 storedTables   = compressionLevel >= 9 ? 4 : 5;
+    const uint32 qualityReads   = 2 + storedTables;
+    const uint32 fullProofReads = ( ( 1u << storedTables ) - 1 ) - storedTables;
+
+    const double readBytes      = (double)GetCompressionInfoForLevel( compressionLevel ).tableParkSize;
+    const double readSecs       = cfg.diskSeekMs / 1000.0 + readBytes / ( cfg.diskMBps * 1000000.0 );
+
+    // Seed from the random seed so that runs are reproducible
+    uint64 seed = 0;
+    memcpy( &seed, cfg.randomSeed, sizeof( seed ) );
+    std::mt19937_64 rng( seed );
+
+    std::poisson_distribution<uint64>      passDist( plotsPerSP );
+    std::uniform_int_distribution<uint32>  diskDist( 0, cfg.diskCount - 1 );
+    std::uniform_int_distribution<size_t>  qualityDist( 0, stats.qualitySamplesNano.size() - 1 );
+    std::uniform_int_distribution<size_t>  fullProofDist( 0, std::max( (size_t)1, stats.fullProofSamplesNano.size() ) - 1 );
+    std::bernoulli_distribution            partialDist( partialChance );
+
+    std::vector<double> diskFreeTime( cfg.diskCount, 0.0 );
+    std::vector<double> decompressorFreeTime( cfg.parallelCount, 0.0 );
+    std::vector<double> diskBusySecs( cfg.diskCount, 0.0 );
+    double              decompressorBusySecs = 0.0;
+
+    std::vector<double> lookupTimes;
+    std::vector<double> fullProofTimes;
+    LatencyHistogram    lookupHistogram;
+    LatencyHistogram    fullProofHistogram;
+
+    // Reserve time on the first free decompression context
+    auto Decompress = [&]( const double readyTime, const double cost ) {
+        auto it = std::min_element( decompressorFreeTime.begin(), decompressorFreeTime.end() );
+
+        const double end = std::max( readyTime, *it ) + cost;
+        *it = end;
+        decompressorBusySecs += cost;
+        return end;
+    };
 
-    const uint64 tableEntryCount      = 1ull << k;
-    const double tablePrunedFactors[] = { 0.798, 0.801, 0.807, 0.823, 0.865, 1, 1 };
+    // Reserve time for a chain of reads on a disk
+    auto Read = [&]( const uint32 disk, const double readyTime, const uint32 readCount ) {
+        const double cost = readCount * readSecs;
+        const double end  = std::max( readyTime, diskFreeTime[disk] ) + cost;
 
-    const size_t parkSizes[] = {
-        0, // Table 1 is dropped
-        compressionLevel >= 9 ? 0 : info.tableParkSize,
-        compressionLevel >= 9 ? info.tableParkSize : CalculateParkSize( TableId::Table3 ),
-        CalculateParkSize( TableId::Table4 ),
-        CalculateParkSize( TableId::Table5 ),
-        CalculateParkSize( TableId::Table6 ),
-        CalculatePark7Size( k )
+        diskFreeTime[disk] = end;
+        diskBusySecs[disk] += cost;
+        return end;
     };
 
-    size_t tableSizes[7] = {};
-    for( uint32 table = (uint32)TableId::Table2; table <= (uint32)TableId::Table7; table++ )
+    for( uint64 sp = 0; sp < cfg.scheduleSPCount; sp++ )
     {
-        const uint64 prunedEntryCount = (uint64)(tableEntryCount * tablePrunedFactors[table]);
-        const uint64 parkCount        = CDiv( prunedEntryCount, kEntriesPerPark );
+        const double spTime     = sp * CHALLENGE_INTERVAL;
+        const uint64 passCount  = passDist( rng );
+
+        for( uint64 p = 0; p < passCount; p++ )
+        {
+            const uint32 disk        = diskDist( rng );
+            const double readEnd     = Read( disk, spTime, qualityReads );
+            const double qualityEnd  = Decompress( readEnd, NanoSecondsToSeconds( stats.qualitySamplesNano[qualityDist( rng )] ) );
+
+            lookupTimes.push_back( qualityEnd - spTime );
+            lookupHistogram.Record( (uint64)( ( qualityEnd - spTime ) * 1e9 ) );
+
+            if( !stats.fullProofSamplesNano.empty() && partialDist( rng ) )
+            {
+                const double fpReadEnd = Read( disk, qualityEnd, fullProofReads );
+                const double fpEnd     = Decompress( fpReadEnd, NanoSecondsToSeconds( stats.fullProofSamplesNano[fullProofDist( rng )] ) );
+
+                fullProofTimes.push_back( fpEnd - spTime );
+                fullProofHistogram.Record( (uint64)( ( fpEnd - spTime ) * 1e9 ) );
+            }
+        }
+    }
+
+    const double simulatedSecs = std::max( cfg.scheduleSPCount * CHALLENGE_INTERVAL,
+                                    std::max( *std::max_element( diskFreeTime.begin(), diskFreeTime.end() ),
+                                              *std::max_element( decompressorFreeTime.begin(), decompressorFreeTime.end() ) ) );
+
+    auto Percentile = []( std::vector<double>& times, const double p ) {
+        if( times.empty() )
+            return 0.0;
+
+        const size_t i = std::min( times.size() - 1, (size_t)( p * times.size() ) );
+        std::nth_element( times.begin(), times.begin() + (ptrdiff_t)i, times.end() );
+        return times[i];
+    };
+
+    auto CountOver = []( const std::vector<double>& times, const double limit ) {
+        return (uint64)std::count_if( times.begin(), times.end(), [=]( double t ) { return t > limit; } );
+    };
 
-        tableSizes[table] = parkCount * parkSizes[table];
+    const uint64 lookupsOver    = CountOver( lookupTimes, cfg.maxLookupTime );
+    const uint64 fullProofsOver = CountOver( fullProofTimes, FULL_PROOF_TIME_LIMIT );
+    const double maxDiskBusy    = *std::max_element( diskBusySecs.begin(), diskBusySecs.end() );
+
+    if( cfg.json )
+    {
+        Log::Write( R"({"k": %u, "compression_level": %u, "device": "%s", "contexts": %u, "signage_points": %llu, )",
+            k, compressionLevel, cfg.usedGpu ? "cuda" : "cpu", cfg.parallelCount, (llu)cfg.scheduleSPCount );
+        Log::Write( R"("farm_bytes": %llu, "plots": %llu, "disks": %u, "plots_per_sp": %.3lf, "read_seconds": %.6lf, )",
+            (llu)cfg.farmSize, (llu)farmPlotCount, cfg.diskCount, plotsPerSP, readSecs );
+        Log::Write( R"("lookup_limit_seconds": %.3lf, "lookups_over_limit": %llu, "full_proof_limit_seconds": %.3lf, "full_proofs_over_limit": %llu, )",
+            cfg.maxLookupTime, (llu)lookupsOver, FULL_PROOF_TIME_LIMIT, (llu)fullProofsOver );
+        Log::Write( R"("decompressor_utilization": %.4lf, "busiest_disk_utilization": %.4lf, "lookups": )",
+            decompressorBusySecs / ( simulatedSecs * cfg.parallelCount ), maxDiskBusy / simulatedSecs );
+        lookupHistogram.WriteJson();
+        Log::Write( R"(, "full_proofs": )" );
+        fullProofHistogram.WriteJson();
+        Log::Write( R"(, "measured_qualities": )" );
+        stats.qualityHistogram.WriteJson();
+        Log::Write( R"(, "measured_full_proofs": )" );
+        stats.fullProofHistogram.WriteJson();
+        Log::Line( "}" );
+        return;
     }
 
-    const size_t c1EntrySize = RoundUpToNextBoundary( k, 8 );
-    const size_t c3ParkCount = CDiv( tableEntryCount, kCheckpoint1Interval );
-    const size_t c3Size      = c3ParkCount * CalculateC3Size(); 
-    const size_t c1Size      = c1EntrySize * ( tableEntryCount / kCheckpoint1Interval ) + c1EntrySize;
-    const size_t c2Size      = c1EntrySize * ( tableEntryCount / (kCheckpoint1Interval * kCheckpoint2Interval) ) + c1EntrySize;
-
-    const size_t plotSize = c3Size + c1Size + c2Size +
-        tableSizes[0] +
-        tableSizes[1] +
-        tableSizes[2] +
-        tableSizes[3] +
-        tableSizes[4] +
-        tableSizes[5] +
-        tableSizes[6];
-    
-    return plotSize;
+    Log::Line( "[Farm schedule simulation]" );
+    Log::Line( " Signage points                : %llu ( %.1lf hours )", (llu)cfg.scheduleSPCount, cfg.scheduleSPCount * CHALLENGE_INTERVAL / 3600.0 );
+    Log::Line( " Farm size                     : %llu TB, %llu plots on %u disks", (llu)BtoTBSi( cfg.farmSize ), (llu)farmPlotCount, cfg.diskCount );
+    Log::Line( " Plots passing filter per SP   : %.2lf", plotsPerSP );
+    Log::Line( " Decompression contexts        : %u", cfg.parallelCount );
+    Log::Line( " Cost samples (quality / proof): %llu / %llu", (llu)stats.qualitySamplesNano.size(), (llu)stats.fullProofSamplesNano.size() );
+    Log::Line( " Disk read model               : %.2lf ms per read, %u reads per lookup, %u more per full proof",
+        readSecs * 1000.0, qualityReads, fullProofReads );
+    Log::Line( " Plot lookups                  : %llu", (llu)lookupTimes.size() );
+    Log::Line( " Lookup time p50 / p99 / max   : %.3lf / %.3lf / %.3lf seconds",
+        Percentile( lookupTimes, 0.5 ), Percentile( lookupTimes, 0.99 ), Percentile( lookupTimes, 1.0 ) );
+    Log::Line( " Lookups over %.1lfs            : %llu ( %.3lf%% )", cfg.maxLookupTime,
+        (llu)lookupsOver, lookupTimes.empty() ? 0.0 : lookupsOver / (double)lookupTimes.size() * 100.0 );
+    Log::Line( " Full proofs                   : %llu", (llu)fullProofTimes.size() );
+    Log::Line( " Full proof p50 / p99 / max    : %.3lf / %.3lf / %.3lf seconds",
+        Percentile( fullProofTimes, 0.5 ), Percentile( fullProofTimes, 0.99 ), Percentile( fullProofTimes, 1.0 ) );
+    Log::Line( " Full proofs over %.0lfs          : %llu ( %.3lf%% )", FULL_PROOF_TIME_LIMIT,
+        (llu)fullProofsOver, fullProofTimes.empty() ? 0.0 : fullProofsOver / (double)fullProofTimes.size() * 100.0 );
+    Log::Line( " Decompressor utilization      : %.2lf%%", decompressorBusySecs / ( simulatedSecs * cfg.parallelCount ) * 100.0 );
+    Log::Line( " Busiest disk utilization      : %.2lf%%", maxDiskBusy / simulatedSecs * 100.0 );
+    Log::NewLine();
+
+    if( lookupsOver > 0 || fullProofsOver > 0 )
+        Log::Line( "*** Warning *** : Some lookups went over the time limit. This farm needs more decompression capacity or disks." );
 }
 
+//-----------------------------------------------------------
+GreenReaperContext* CreateSimulatorContext( const Config& cfg, const uint32 threadCount, const uint32 cpuOffset, const bool useGpu )
+{
+    GreenReaperConfig grCfg = {};
+    grCfg.apiVersion         = GR_API_VERSION;
+    grCfg.threadCount        = threadCount;
+    grCfg.cpuOffset          = cpuOffset;
+    grCfg.disableCpuAffinity = cfg.gCfg->disableCpuAffinity;
+    grCfg.gpuRequest         = useGpu ? GRGpuRequestKind_FirstAvailable : GRGpuRequestKind_None;
+    grCfg.gpuDeviceIndex     = cfg.cudaDevice;
+
+    GreenReaperContext* grContext = nullptr;
+    const auto result = grCreateContext( &grContext, &grCfg, sizeof( GreenReaperConfig ) );
+    FatalIf( !grContext, "Failed to create decompression context with error %d.", (int)result );
+
+    return grContext;
+}
+
+///
+/// Capacity search (--find-max).
+/// For each plot given, so for each compression level, and for each decompressor configuration
+/// (the GPU unless --no-cuda, then 1, 2, 4... up to -p CPU contexts), runs -n signage points against
+/// farms of growing size. The number of plots passing the filter per signage point is doubled until
+/// the p99 signage point lookup time goes over the -l limit, then bisected between the largest farm
+/// that stayed under it and the smallest that didn't, to within 2%.
+/// A signage point's lookup time is the time until every context is done with its share of the plots.
+/// The decompression contexts are created once per configuration and reused for every run.
+///
+//-----------------------------------------------------------
+void RunFindMax( Config& cfg, const uint32 decompressorThreadCount )
+{
+    struct Result
+    {
+        uint32      k;
+        uint32      compressionLevel;
+        const char* device;
+        uint32      contextCount;
+        uint64      plotsPerSP;     // Largest that kept the p99 under the limit, 0 if none did
+        uint64      p99Nano;
+    };
+
+    const uint32 maxContexts = std::max( 1u, cfg.parallelCount );
+    const uint64 spCount     = cfg.fetchCount;
+
+    std::vector<Result> results;
+
+    if( !cfg.json )
+    {
+        Log::Line( "[Farm capacity search, p99 lookup time under %.2lf seconds, %llu signage points per run]",
+            cfg.maxLookupTime, (llu)spCount );
+        Log::Line( " Random seed: 0x%s", BytesToHexStdString( cfg.randomSeed, sizeof( cfg.randomSeed ) ).c_str() );
+        Log::NewLine();
+    }
+
+    for( const char* plotPath : cfg.plotPaths )
+    {
+        FilePlot* plots = new FilePlot[maxContexts];
+        for( uint32 i = 0; i < maxContexts; i++ )
+        {
+            if( !plots[i].Open( plotPath ) )
+                Fatal( "Failed to open plot file at '%s' with error %d.", plotPath, plots[i].GetError() );
+        }
+
+        const uint32 k                = plots[0].K();
+        const uint32 compressionLevel = plots[0].CompressionLevel();
+        FatalIf( compressionLevel < 1, "The plot %s is not compressed.", plotPath );
+
+        const size_t plotSize = CalculatePlotSizeBytes( k, compressionLevel );
+
+        // ( GPU, context count )
+        std::vector<std::pair<bool, uint32>> configs;
+        if( !cfg.noCuda )
+            configs.push_back( { true, 1 } );
+
+        for( uint32 p = 1; p < maxContexts; p *= 2 )
+            configs.push_back( { false, p } );
+        configs.push_back( { false, maxContexts } );
+
+        for( const auto& [useGpu, contextCount] : configs )
+        {
+            GreenReaperContext** contexts = new GreenReaperContext*[contextCount];
+            for( uint32 i = 0; i < contextCount; i++ )
+                contexts[i] = CreateSimulatorContext( cfg, decompressorThreadCount, decompressorThreadCount * i, useGpu );
 
+            const char* device = useGpu ? "cuda" : "cpu";
+
+            if( useGpu && !(bool)grHasGpuDecompressor( contexts[0] ) )
+            {
+                if( !cfg.json )
+                    Log::Line( "Warning: No GPU device decompressor available, skipping the GPU search." );
+            }
+            else
+            {
+                ThreadPool pool( contextCount, ThreadPool::Mode::Fixed, true );
+
+                cfg.contexts      = contexts;
+                cfg.parallelCount = contextCount;
+                cfg.fetchCount    = spCount * contextCount;     // Every job runs every signage point
+
+                auto Trial = [&]( const uint64 plotsPerSP ) {
+
+                    cfg.farmSize = (size_t)( plotsPerSP * cfg.filterBits * plotSize );
+
+                    JobStats stats = {};
+
+                    SimulatorJob job = {};
+                    job.cfg                     = &cfg;
+                    job.plots                   = Span<FilePlot>( plots, contextCount );
+                    job.stats                   = &stats;
+                    job.decompressorThreadCount = decompressorThreadCount;
+
+                    MTJobRunner<SimulatorJob>::RunFromInstance( pool, contextCount, job );
+
+                    const uint64 p99 = stats.abortTrial ? std::numeric_limits<uint64>::max() : stats.spHistogram.ValueAtPercentile( 99.0 );
+
+                    if( !cfg.json )
+                    {
+                        if( stats.abortTrial )
+                            Log::Line( " C%u %-4s x%-3u: %8llu plots / SP ( %8llu TB ): over 1%% of signage points over the limit",
+                                compressionLevel, device, contextCount, (llu)plotsPerSP, (llu)BtoTBSi( cfg.farmSize ) );
+                        else
+                            Log::Line( " C%u %-4s x%-3u: %8llu plots / SP ( %8llu TB ): p99 %.3lf seconds",
+                                compressionLevel, device, contextCount, (llu)plotsPerSP, (llu)BtoTBSi( cfg.farmSize ), NanoSecondsToSeconds( p99 ) );
+                    }
+
+                    return p99;
+                };
+
+                auto UnderLimit = [&]( const uint64 p99 ) {
+                    return p99 != std::numeric_limits<uint64>::max() && NanoSecondsToSeconds( p99 ) <= cfg.maxLookupTime;
+                };
+
+                uint64 lo = 0, loP99 = 0;
+                uint64 hi = 1;
+
+                for( ;; )
+                {
+                    const uint64 p99 = Trial( hi );
+                    if( !UnderLimit( p99 ) )
+                        break;
+
+                    lo    = hi;
+                    loP99 = p99;
+                    hi   *= 2;
+                }
+
+                while( hi - lo > std::max( (uint64)1, lo / 50 ) )
+                {
+                    const uint64 mid = lo + ( hi - lo ) / 2;
+                    const uint64 p99 = Trial( mid );
+
+                    if( UnderLimit( p99 ) )
+                    {
+                        lo    = mid;
+                        loP99 = p99;
+                    }
+                    else
+                        hi = mid;
+                }
+
+                results.push_back( { k, compressionLevel, device, contextCount, lo, loP99 } );
+
+                cfg.contexts = nullptr;
+            }
+
+            for( uint32 i = 0; i < contextCount; i++ )
+                grDestroyContext( contexts[i] );
+            delete[] contexts;
+        }
+
+        delete[] plots;
+    }
+
+    if( cfg.json )
+    {
+        Log::Write( "[" );
+        for( size_t i = 0; i < results.size(); i++ )
+        {
+            const Result& r = results[i];
+            const uint64  plotCount = r.plotsPerSP * cfg.filterBits;
+
+            Log::Write( R"(%s{"k": %u, "compression_level": %u, "device": "%s", "contexts": %u, "threads_per_context": %u, )",
+                i > 0 ? ", " : "", r.k, r.compressionLevel, r.device, r.contextCount, decompressorThreadCount );
+            Log::Write( R"("lookup_limit_seconds": %.3lf, "max_plots_per_sp": %llu, "max_plot_count": %llu, "max_farm_bytes": %llu, "p99_seconds": %.3lf})",
+                cfg.maxLookupTime, (llu)r.plotsPerSP, (llu)plotCount,
+                (llu)( plotCount * CalculatePlotSizeBytes( r.k, r.compressionLevel ) ), NanoSecondsToSeconds( r.p99Nano ) );
+        }
+        Log::Line( "]" );
+        return;
+    }
+
+    Log::NewLine();
+    Log::Line( " %-11s | %-6s | %-8s | %-7s | %-10s | %-10s | %-10s | %-10s", 
+        "compression", "device", "contexts", "threads", "plots / SP", "plot count", "size TB", "p99 secs" );
+    Log::Line( "-----------------------------------------------------------------------------------------------" );
+
+    for( const Result& r : results )
+    {
+        const uint64 plotCount = r.plotsPerSP * cfg.filterBits;
+
+        Log::Line( " C%-10u | %-6s | %-8u | %-7u | %-10llu | %-10llu | %-10llu | %-10.3lf",
+            r.compressionLevel, r.device, r.contextCount, decompressorThreadCount, (llu)r.plotsPerSP, (llu)plotCount,
+            (llu)BtoTBSi( plotCount * CalculatePlotSizeBytes( r.k, r.compressionLevel ) ), NanoSecondsToSeconds( r.p99Nano ) );
+    }
+    Log::NewLine();
+}
+
+//-----------------------------------------------------------
 void SimulatorJob::Run()
 {
     FilePlot& plot = plots[JobId()];
 
     PlotReader reader( plot );
 
+    if( cfg->contexts )
+        reader.AssignDecompressionContext( cfg->contexts[JobId()] );
+    else
     {
-        GreenReaperConfig grCfg = {};
-        grCfg.apiVersion         = GR_API_VERSION;
-        grCfg.threadCount        = decompressorThreadCount;
-        grCfg.cpuOffset          = decompressorThreadCount * JobId();
-        grCfg.disableCpuAffinity = cfg->gCfg->disableCpuAffinity;
-        grCfg.gpuRequest         = cfg->noCuda ? GRGpuRequestKind_None : GRGpuRequestKind_FirstAvailable;
-        grCfg.gpuDeviceIndex     = cfg->cudaDevice;
-
-        GreenReaperContext* grContext = nullptr;
-        const auto result = grCreateContext( &grContext, &grCfg, sizeof( GreenReaperConfig ) );
-        FatalIf( !grContext, "Failed to create decompression context with error %d.", (int)result );
-
-        if( grCfg.gpuRequest != GRGpuRequestKind_None && !(bool)grHasGpuDecompressor( grContext ) )
+        GreenReaperContext* grContext = CreateSimulatorContext( *cfg, decompressorThreadCount, decompressorThreadCount * JobId(), !cfg->noCuda );
+
+        if( !cfg->noCuda && !(bool)grHasGpuDecompressor( grContext ) && !cfg->json )
             Log::Line( "Warning: No GPU device decompressor selected. Falling back to CPU-based simulation." );
 
+        if( IsControlThread() )
+            cfg->usedGpu = (bool)grHasGpuDecompressor( grContext );
+
         reader.AssignDecompressionContext( grContext );
     }
     // reader.ConfigDecompressor( decompressorThreadCount, cfg->gCfg->disableCpuAffinity, decompressorThreadCount * JobId() );
@@ -341,7 +774,8 @@ void SimulatorJob::RunFarm( PlotReader& reader, const uint64 challengeCount, con
     // In power simulation mode, determine how many plots we've got per challenge, if any,
     // based on the specified farm size.
     const bool powerSimMode = cfg->powerSimSeconds > 0.0;
-    if( powerSimMode )
+    const bool findMaxMode  = cfg->findMax;
+    if( powerSimMode || findMaxMode )
     {
         const size_t plotSize               = CalculatePlotSizeBytes( k, reader.PlotFile().CompressionLevel() );
         const uint64 farmPlotCount          = (uint64)cfg->farmSize / plotSize;
@@ -350,7 +784,8 @@ void SimulatorJob::RunFarm( PlotReader& reader, const uint64 challengeCount, con
         uint64 _;
         GetFairThreadOffsets( this, totalPlotsPerChallenge, plotsPerChallenge, _, _ );
 
-        if( plotsPerChallenge < 1 )
+        // When searching for capacity, jobs without plots still take part in timing each signage point
+        if( plotsPerChallenge < 1 && !findMaxMode )
             return;
     }
 
@@ -379,6 +814,12 @@ void SimulatorJob::RunFarm( PlotReader& reader, const uint64 challengeCount, con
     const uint64 f7Mask = (1ull << k) - 1;
           uint64 prevF7 = (uint64)_jobId & f7Mask;
 
+    const bool          sampleCosts = cfg->scheduleSPCount > 0;
+    std::vector<uint64> qualitySamples;
+    std::vector<uint64> fullProofSamples;
+    LatencyHistogram    qualityHistogram;
+    LatencyHistogram    fullProofHistogram;
+
     for( uint64 n = 0; n < challengeCount; n++ )
     {
         // How many plots are we simulating for this challenge?
@@ -405,10 +846,14 @@ void SimulatorJob::RunFarm( PlotReader& reader, const uint64 challengeCount, con
                   uint64 p7IndexBase = 0;
             const uint64 matchCount  = reader.GetP7IndicesForF7( f7, p7IndexBase );
 
-            const bool fetchFullProof = --nextPartial <= 0;
+            // When sampling for the schedule simulation, every proof is fetched so that
+            // we get a full proof cost sample for each of them.
+            const bool fetchFullProof = --nextPartial <= 0 || sampleCosts;
             if( fetchFullProof )
                 nextPartial = partialInterval;
 
+            uint64 fullProofNano = 0;
+
             uint32 nFetchedFromMatches           = 0;
             uint64 nFullProofsFetchedFromMatches = 0;
 
@@ -427,9 +872,20 @@ void SimulatorJob::RunFarm( PlotReader& reader, const uint64 challengeCount, con
 
                     if( fetchFullProof )
                     {
+                        const auto fpTimer = TimerBegin();
                         rP = reader.FetchProof( p7Entry, fullProofXs );
+
+                        const auto fpElapsedNano = (uint64)TicksToNanoSeconds( TimerEndTicks( fpTimer ) );
+                        fullProofNano += fpElapsedNano;
+
                         if( rP == ProofFetchResult::OK )
+                        {
                             nFullProofsFetchedFromMatches++;
+                            fullProofHistogram.Record( fpElapsedNano );
+
+                            if( sampleCosts )
+                                fullProofSamples.push_back( fpElapsedNano );
+                        }
                     }
                 }
 
@@ -444,9 +900,14 @@ void SimulatorJob::RunFarm( PlotReader& reader, const uint64 challengeCount, con
 
             const auto fetchElapsedNano = (uint64)TicksToNanoSeconds( TimerEndTicks( fetchTimer ) );
 
+            if( sampleCosts )
+                qualitySamples.push_back( fetchElapsedNano - fullProofNano );
+
             nTotalProofs += nFetchedFromMatches;
             if( nFetchedFromMatches > 0 )
             {
+                qualityHistogram.Record( fetchElapsedNano - fullProofNano );
+
                 nTotalFetches++;
                 totalFetchTimeNano += fetchElapsedNano;
 
@@ -462,6 +923,32 @@ void SimulatorJob::RunFarm( PlotReader& reader, const uint64 challengeCount, con
             }
         }
 
+        // The signage point is done once every context is done with its plots
+        if( findMaxMode )
+        {
+            spElapsedNano = (uint64)TicksToNanoSeconds( TimerEndTicks( challengeStartTime ) );
+
+            if( LockThreads() )
+            {
+                uint64 spNano = 0;
+                for( uint32 i = 0; i < JobCount(); i++ )
+                    spNano = std::max( spNano, GetJob( i ).spElapsedNano );
+
+                stats->spHistogram.Record( spNano );
+
+                // Stop once more than 1% went over, the p99 can't get back under the limit
+                if( NanoSecondsToSeconds( spNano ) > cfg->maxLookupTime )
+                    stats->abortTrial = ++stats->spOverLimit * 100 > challengeCount;
+
+                ReleaseThreads();
+            }
+            else
+                WaitForRelease();
+
+            if( stats->abortTrial )
+                break;
+        }
+
         if( powerSimMode )
         {
             // End power simulation?
@@ -487,6 +974,14 @@ void SimulatorJob::RunFarm( PlotReader& reader, const uint64 challengeCount, con
         }
     }
 
+    {
+        std::lock_guard<std::mutex> lock( stats->sampleLock );
+        stats->qualityHistogram  .Merge( qualityHistogram );
+        stats->fullProofHistogram.Merge( fullProofHistogram );
+        stats->qualitySamplesNano  .insert( stats->qualitySamplesNano  .end(), qualitySamples  .begin(), qualitySamples  .end() );
+        stats->fullProofSamplesNano.insert( stats->fullProofSamplesNano.end(), fullProofSamples.begin(), fullProofSamples.end() );
+    }
+
     stats->nTotalProofs            += nTotalProofs;
     stats->nActualFetches          += nTotalFetches;
     stats->nActualFullProofFetches += nFullProofsFetches;
@@ -523,6 +1018,20 @@ OPTIONS:
  --seed <hex>             : 64 char hex string to use as a random seed for challenges.
  --no-cuda                : Don't use CUDA for decompression.
  -d, --device <index>     : Cuda device index. (default = 0)
+ --schedule <count>       : Replay <count> signage points against a farm of `--size` bytes (default = 18TB per disk),
+                            using the lookup costs measured on the plot. Reports p50/p99 lookup times
+                            against the `--lookup` and 30 second full proof limits.
+ --disks <count>          : Number of disks the farm is spread across in `--schedule` mode. (default = 1)
+ --seek <ms>              : Average random read latency per disk in `--schedule` mode. (default = 10)
+ --disk-mbps <MB/s>       : Read throughput per disk in `--schedule` mode. (default = 200)
+ --json                   : Output the report in json, with latency histograms for qualities and full proofs.
+ --index-cache <size>     : Keep the plot's decoded C1 table in memory, up to <size> bytes, so that lookups
+                            go straight to the C3 park without reading C2 and C1.
+ --hot-c3 <count>         : With `--index-cache`, also keep the last <count> decoded C3 parks in memory.
+ --find-max               : Search for the largest farm that keeps the p99 signage point lookup time under `--lookup`.
+                            Runs -n signage points per farm size, growing the farm, on the GPU (unless `--no-cuda`)
+                            and on 1, 2, 4... up to `-p` CPU contexts, reusing the contexts between runs.
+                            More than one plot may be given, one per compression level to search.
 )";
 
 void CmdSimulateHelp()
@@ -9,5 +9,17 @@ void CmdSimulateMain( GlobalPlotConfig& gCfg, CliParser& cli );
 void CmdPlotsCheckHelp();
 void CmdPlotsCheckMain( GlobalPlotConfig& gCfg, CliParser& cli );
 
+void CmdGenIdsHelp();
+void CmdGenIdsMain( GlobalPlotConfig& gCfg, CliParser& cli );
+
+void CmdRecompressHelp();
+void CmdRecompressMain( GlobalPlotConfig& gCfg, CliParser& cli );
+
+void CmdReceiveHelp();
+void CmdReceiveMain( GlobalPlotConfig& gCfg, CliParser& cli );
+
+void CmdReplayHelp();
+void CmdReplayMain( GlobalPlotConfig& gCfg, CliParser& cli );
+
 void CmdCheckCUDA( GlobalPlotConfig& gCfg, CliParser& cli );
 void CmdCheckCUDAHelp();
@@ -1,9 +1,14 @@
 #include "GreenReaper.h"
 #include "GreenReaperInternal.h"
 #include "harvesting/Thresher.h"
+#include "harvesting/HarvestTrace.h"
 #include "threading/ThreadPool.h"
 #include "threading/GenJob.h"
+#include "threading/Thread.h"
+#include "threading/Fence.h"
+#include "threading/Semaphore.h"
 #include "plotting/Tables.h"
+#include "plotting/HarvestYield.h"
 #include "tools/PlotReader.h"
 #include "plotmem/LPGen.h"
 #include "ChiaConsts.h"
@@ -15,6 +20,8 @@
 #include "util/VirtualAllocator.h"
 #include "plotting/matching/GroupScan.h"
 #include <mutex>
+#include <condition_variable>
+#include <vector>
 #include <algorithm>
 
 
@@ -106,10 +113,119 @@ struct ProofTable
     // }
 };
 
+// Cached results of processing a table 1 x-bucket pair (table 2 pairs w/ inlined x's, y and meta)
+struct Table1CacheEntry
+{
+    byte      plotId[BB_PLOT_ID_LEN];
+    uint32    x1, x2;
+    uint32    compressionLevel;
+    uint32    length;
+    uint32    capacity;
+    uint64    lastUse;      // 0 if the entry is unused
+    Pair*     pairs;
+    uint64*   y;
+    K32Meta2* meta;
+};
+
+struct Table1Cache
+{
+    Table1CacheEntry* entries  = nullptr;
+    uint32            capacity = 0;
+    uint64            useCount = 0;     // Monotonic counter used for LRU eviction
+    size_t            size     = 0;     // Total bytes allocated by all entries
+};
+
 // Used for qualities fetch. Line point and index.
 // Represents a line point and its original, pre-sort index.
 struct LPIndex { uint64 lp; uint32 index; };
 
+// GreenReaperConfig as given by version 1 callers
+struct GreenReaperConfigV1
+{
+    uint32_t           apiVersion;
+    uint32_t           threadCount;
+    uint32_t           cpuOffset;
+    GRBool             disableCpuAffinity;
+    GRGpuRequestKind_t gpuRequest;
+    uint32_t           gpuDeviceIndex;
+
+    uint32_t           _reserved[16];
+};
+
+// Requests as given by version 1 callers, which end before outTimings
+struct GRCompressedProofRequestV1
+{
+    union {
+        uint64_t compressedProof[GR_POST_PROOF_CMP_X_COUNT];
+        uint64_t fullProof      [GR_POST_PROOF_X_COUNT];
+    };
+
+          uint32_t  compressionLevel;
+    const uint8_t*  plotId;
+};
+
+struct GRCompressedQualitiesRequestV1
+{
+    const uint8_t*  plotId;
+    const uint8_t*  challenge;
+    uint32_t        compressionLevel;
+    GRLinePoint     xLinePoints[2];
+
+    uint64_t        x1, x2;
+};
+
+// An asynchronous request, processed by the context's request thread
+struct GRAsyncRequest
+{
+    enum Kind
+    {
+        Proof     = 0,
+        Qualities = 1,
+    };
+
+    GreenReaperContext*   cx;
+    Kind                  kind;
+    void*                 request;
+    GRCompletionCallback  callback;
+    void*                 userData;
+    std::atomic<GRResult> result   = GRResult_Pending;
+    std::atomic<uint32>   refCount = 1;     // The request thread holds one reference, the user optionally another
+    Fence                 fence;            // Signalled with 1 when completed
+
+    uint32                priority;
+    std::chrono::steady_clock::time_point deadline;     // Max if there is none
+
+    // Set when submitted while a trace is active (see grBeginTrace)
+    bool                  traced = false;
+    std::chrono::steady_clock::time_point submitTime;
+    uint64                tracedProof[GR_POST_PROOF_CMP_X_COUNT];   // The full proof overwrites the request's compressed proof
+};
+
+// CPU thread pool shared by contexts (see grCreateSharedPool)
+struct GRSharedPool
+{
+    ThreadPool* pool;
+};
+
+// Host bucket buffers detached from a context, held in the idle pool (see GreenReaperConfig::idleShrinkMS)
+struct BucketBuffers
+{
+    uint32         compressionLevel;
+    uint64         entriesPerBucket;
+    size_t         allocationSize;
+
+    Span<uint64>   yBufferF1, yBuffer, yBufferTmp;
+    Span<uint32>   xBuffer, xBufferTmp, sortKey;
+    Span<K32Meta4> metaBuffer, metaBufferTmp;
+    Span<Pair>     pairs, pairsTmp;
+    Span<uint32>   groupsBoundaries;
+    Pair*          tablePairs   [7];
+    uint64         tableCapacity[7];
+
+    std::chrono::steady_clock::time_point releaseTime;
+    uint32                                idleShrinkMS;   // Of the context that released them
+};
+
 struct GreenReaperContext
 {
     enum State
@@ -122,6 +238,7 @@ struct GreenReaperContext
 
     State          state          = None;
     ThreadPool*    pool           = nullptr;
+    bool           ownsPool       = false;  // False when using GreenReaperConfig::sharedPool
     size_t         allocationSize = 0;
 
     uint64         maxEntriesPerBucket;
@@ -149,9 +266,49 @@ struct GreenReaperContext
     Pair           backTraceTables[6][32] = {};
     LPIndex        lpTables       [6][32] = {};
 
+    GRProofTimings* timings             = nullptr;  // Timings output for the current request, if requested
+
+    Table1Cache    t1Cache;
+
     IThresher*     cudaThresher         = nullptr;
     bool           cudaRecreateThresher = false;    // In case a CUDA error occurred or the device was lost,
                                                     // we need to re-create it.
+
+    // Background GPU initialization (GreenReaperConfig::asyncGpuInit)
+    Thread*                     gpuInitThread     = nullptr;    // Joined once the thresher is adopted
+    IThresher*                  gpuInitThresher   = nullptr;    // Set by the init thread before gpuInitDone, nullptr if it failed
+    std::atomic<bool>           gpuInitDone       = false;
+    std::atomic<uint32>         gpuInitLevel      = 0;          // Preallocated compression level, the init thread reserves its GPU buffers
+
+    // Asynchronous requests
+    Thread*                     requestThread     = nullptr;    // Lazily started on the first submitted request
+    std::vector<GRAsyncRequest*> requestQueue;      // Pending requests, in submission order. Guarded by requestLock.
+    Semaphore                   requestSignal;
+    std::atomic<bool>           requestThreadExit = false;
+    std::mutex                  requestLock;
+
+    // Multi-device contexts own one child context per device and route requests to them.
+    // The parent context itself holds no buffers.
+    GreenReaperContext**        deviceContexts     = nullptr;
+    uint32                      deviceContextCount = 0;
+    GreenReaperContext*         cpuContext         = nullptr;       // Hybrid mode CPU context, one of the device contexts
+    std::atomic<uint32>         pendingRequests    = 0;         // Requests in flight, used for load balancing
+    std::mutex                  fetchLock;                      // Serializes requests routed to a device context
+
+    // Held while a request uses the bucket buffers, so that the idle thread only shrinks unused contexts
+    std::mutex                            bufferLock;
+    std::chrono::steady_clock::time_point lastUse = std::chrono::steady_clock::now();
+};
+
+/// Holds a context's bucket buffers for the duration of a request
+struct BufferUseScope
+{
+    GreenReaperContext&          cx;
+    std::lock_guard<std::mutex>  lock;
+    HarvestScope                 harvest;
+
+    inline BufferUseScope( GreenReaperContext& cx ) : cx( cx ), lock( cx.bufferLock ), harvest( cx.config.yieldPlotters != 0 ) {}
+    inline ~BufferUseScope() { cx.lastUse = std::chrono::steady_clock::now(); }
 };
 
 enum class ForwardPropResult
@@ -172,11 +329,58 @@ inline void ProofTable::GetLTableGroupEntries( GreenReaperContext& cx, const uin
     outMeta = MakeSpan( (TMeta*)cx.proofContext.metaLeft + _groups[group].offset, _groups[group].count );
 }
 
+/// Records timings for the duration of a request, if the request asked for them
+struct RequestTimingsScope
+{
+    GreenReaperContext& cx;
+    const std::chrono::steady_clock::time_point timer = TimerBegin();
+
+    inline RequestTimingsScope( GreenReaperContext& cx, GRProofTimings* outTimings )
+        : cx( cx )
+    {
+        cx.timings = outTimings;
+
+        if( outTimings )
+            *outTimings = {};
+
+        if( cx.cudaThresher )
+        {
+            cx.cudaThresher->SetRecordTimings( outTimings != nullptr );
+            cx.cudaThresher->ClearTimings();
+        }
+    }
+
+    inline ~RequestTimingsScope()
+    {
+        if( cx.timings )
+        {
+            if( cx.cudaThresher )
+                cx.cudaThresher->AccumulateTimings( *cx.timings );
+
+            cx.timings->totalElapsedNS = (uint64)TicksToNanoSeconds( TimerEndTicks( timer ) );
+        }
+
+        cx.timings = nullptr;
+
+        // Lets other contexts on the same device use the GPU memory in between requests
+        if( cx.cudaThresher )
+            cx.cudaThresher->EndRequest();
+    }
+};
+
+//-----------------------------------------------------------
+inline void RecordTiming( const GreenReaperContext& cx, uint64_t GRProofTimings::* field, const std::chrono::steady_clock::time_point timer )
+{
+    if( cx.timings )
+        cx.timings->*field += (uint64)TicksToNanoSeconds( TimerEndTicks( timer ) );
+}
+
 struct Table1BucketContext
 {
     GreenReaperContext* cx;
     const byte*    plotId;
     uint64         entriesPerBucket;
+    uint32         compressionLevel;
 
     // Mutated after each bucket to point to the next
     // free section of the buffers.
@@ -188,14 +392,53 @@ struct Table1BucketContext
 
 /// Internal functions
 static GRResult RequestSetup( GreenReaperContext* cx, const uint32 k, const uint32 compressionLevel );
+static GRResult FetchQualitiesXPair( GreenReaperContext* cx, GRCompressedQualitiesRequest* req );
+static GRResult FetchProof( GreenReaperContext* cx, GRCompressedProofRequest* req );
+static GRResult FetchQualities( GreenReaperContext* cx, GRCompressedQualitiesRequest* req );
+
+static GRResult SubmitAsyncRequest( GreenReaperContext* cx, GRAsyncRequest::Kind kind, void* req,
+                                    GRCompletionCallback callback, void* userData, GRAsyncRequest** outRequest );
+static void     RequestThreadMain( GreenReaperContext* cx );
+static GRAsyncRequest* NextAsyncRequest( GreenReaperContext& cx );
+static void     CompleteAsyncRequest( GRAsyncRequest* r, GRResult result );
+static void     ReleaseAsyncRequestRef( GRAsyncRequest* r );
+
+static GRResult CreateRoutingContext( GreenReaperContext* cx, uint32 deviceCount );
+static GreenReaperContext* AcquireDeviceContext( GreenReaperContext& cx );
+
+static IThresher* CreateGpuThresher( const GreenReaperConfig& config );
+static uint32     GetGpuDeviceCount();
+static void       StartGpuInit( GreenReaperContext& cx );
+static void       GpuInitThreadMain( GreenReaperContext* cx );
+static void       AdoptGpuThresher( GreenReaperContext& cx );
+static void       StopGpuInit( GreenReaperContext& cx );
+
+// Version 1 API entry points. req points to a version 1 request.
+static GRResult FetchProofForChallengeV1( GreenReaperContext* cx, GRCompressedProofRequest* req );
+static GRResult GetFetchQualitiesXPairV1( GreenReaperContext* cx, GRCompressedQualitiesRequest* req );
 
 static void SortQualityXs( const uint32 k, const byte plotId[BB_PLOT_ID_LEN], uint64* xs, const uint32 count );
 
 static GRResult ProcessTable1Bucket( Table1BucketContext& tcx, const uint64 x1, const uint64 x2, const uint32 groupIndex );
+static GRResult ProcessTable1BucketUncached( Table1BucketContext& tcx, const uint64 x1, const uint64 x2, const uint32 groupIndex );
 static GRResult ProcessTable1BucketCPU( Table1BucketContext& tcx, const uint64 x1, const uint64 x2, const uint32 groupIndex );
 
+static const Table1CacheEntry* Table1CacheFind( GreenReaperContext& cx, const byte* plotId, uint32 compressionLevel, uint64 x1, uint64 x2 );
+static void Table1CacheInsert( GreenReaperContext& cx, const byte* plotId, uint32 compressionLevel, uint64 x1, uint64 x2,
+                               Span<Pair> pairs, Span<uint64> y, Span<K32Meta2> meta );
+static void Table1CacheDestroy( Table1Cache& cache );
+
 static void FreeBucketBuffers( GreenReaperContext& cx );
 static bool ReserveBucketBuffers( GreenReaperContext& cx, uint32 k, uint32 compressionLevel );
+static bool ReserveThresherBuffers( GreenReaperContext& cx, uint32 k, uint32 compressionLevel );
+
+static void RegisterIdleContext( GreenReaperContext* cx );
+static void UnregisterIdleContext( GreenReaperContext* cx );
+static void IdleThreadMain();
+static BucketBuffers DetachBucketBuffers( GreenReaperContext& cx );
+static void ReleaseBucketBuffersToPool( GreenReaperContext& cx );
+static bool TakeBucketBuffersFromPool( GreenReaperContext& cx, uint32 compressionLevel );
+static void FreeBucketBufferSet( BucketBuffers& b );
 
 static void GenerateF1( GreenReaperContext& cx, const byte plotId[32], const uint64 bucketEntryCount, const uint32 x0, const uint32 x1 );
 static Span<Pair> Match( GreenReaperContext& cx, const Span<uint64> yEntries, Span<Pair> outPairs, const uint32 pairOffset  );
@@ -214,6 +457,7 @@ template<TableId rTable, typename TMetaIn, typename TMetaOut>
 static void GenerateFx( const Span<Pair> pairs, const Span<uint64> yIn, const Span<TMetaIn> metaIn, Span<uint64> yOut, Span<TMetaOut> outMeta );
 
 static bool ForwardPropTables( GreenReaperContext& cx );
+static ForwardPropResult ResolveQualityPair( GreenReaperContext& cx, TableId rTable, Pair& outT3Pair );
 static void BacktraceProof( GreenReaperContext& cx, const TableId tableStart, uint64 proof[GR_POST_PROOF_X_COUNT] );
 
 
@@ -226,6 +470,25 @@ GRResult grPopulateApi( GRApi* api, const size_t apiStructSize, const int apiVer
     if( api == nullptr )
         return GRResult_Failed;
 
+    if( apiVersion == 1 )
+    {
+        if( apiStructSize != sizeof( GRApiV1 ) )
+            return GRResult_WrongVersion;
+
+        GRApiV1* apiV1 = reinterpret_cast<GRApiV1*>( api );
+
+        apiV1->CreateContext                  = &grCreateContext;
+        apiV1->DestroyContext                 = &grDestroyContext;
+        apiV1->PreallocateForCompressionLevel = &grPreallocateForCompressionLevel;
+        apiV1->FetchProofForChallenge         = &FetchProofForChallengeV1;
+        apiV1->GetFetchQualitiesXPair         = &GetFetchQualitiesXPairV1;
+        apiV1->GetMemoryUsage                 = &grGetMemoryUsage;
+        apiV1->HasGpuDecompressor             = &grHasGpuDecompressor;
+        apiV1->GetCompressionInfo             = &grGetCompressionInfo;
+
+        return GRResult_OK;
+    }
+
     if( apiVersion != GR_API_VERSION )
         return GRResult_WrongVersion;
 
@@ -240,10 +503,109 @@ GRResult grPopulateApi( GRApi* api, const size_t apiStructSize, const int apiVer
     api->GetMemoryUsage                 = &grGetMemoryUsage;
     api->HasGpuDecompressor             = &grHasGpuDecompressor;
     api->GetCompressionInfo             = &grGetCompressionInfo;
+    api->FetchQualitiesXPairBatch       = &grFetchQualitiesXPairBatch;
+    api->SubmitProofForChallenge        = &grSubmitProofForChallenge;
+    api->SubmitQualitiesXPair           = &grSubmitQualitiesXPair;
+    api->PollRequest                    = &grPollRequest;
+    api->WaitForRequest                 = &grWaitForRequest;
+    api->ReleaseRequest                 = &grReleaseRequest;
+    api->CreatePlotIndex                = &grCreatePlotIndex;
+    api->DestroyPlotIndex               = &grDestroyPlotIndex;
+    api->GetPlotIndexCount              = &grGetPlotIndexCount;
+    api->GetPlotInfo                    = &grGetPlotInfo;
+    api->OpenPlot                       = &grOpenPlot;
+    api->ClosePlot                      = &grClosePlot;
+    api->LookupQualities                = &grLookupQualities;
+    api->ValidateFullProofs             = &grValidateFullProofs;
+    api->CreateSharedPool               = &grCreateSharedPool;
+    api->DestroySharedPool              = &grDestroySharedPool;
+    api->BeginHarvest                   = &grBeginHarvest;
+    api->EndHarvest                     = &grEndHarvest;
+    api->BeginTrace                     = &grBeginTrace;
+    api->EndTrace                       = &grEndTrace;
+    api->SetLookupBatchWindow           = &grSetLookupBatchWindow;
 
     return GRResult_OK;
 }
 
+/// CUDA devices are preferred. Metal is only available on macOS.
+//-----------------------------------------------------------
+IThresher* CreateGpuThresher( const GreenReaperConfig& config )
+{
+    IThresher* thresher = CudaThresherFactory::Create( config );
+    if( thresher == nullptr )
+        thresher = MetalThresherFactory::Create( config );
+
+    return thresher;
+}
+
+//-----------------------------------------------------------
+void StartGpuInit( GreenReaperContext& cx )
+{
+    ASSERT( !cx.gpuInitThread );
+
+    cx.gpuInitThread = new Thread();
+    cx.gpuInitThread->Run( GpuInitThreadMain, &cx );
+}
+
+/// Device context creation and module loading take seconds, so they're done off the caller's thread.
+/// The thresher is only handed to the context by AdoptGpuThresher, under the context's buffer lock.
+//-----------------------------------------------------------
+void GpuInitThreadMain( GreenReaperContext* cx )
+{
+    IThresher* thresher = CreateGpuThresher( cx->config );
+
+    // Also allocate the device buffers, if the compression level is known by now
+    const uint32 level = cx->gpuInitLevel.load( std::memory_order_relaxed );
+    if( thresher && level > 0 && !thresher->AllocateBuffers( 32, level ) )
+    {
+        delete thresher;
+        thresher = nullptr;
+    }
+
+    cx->gpuInitThresher = thresher;
+    cx->gpuInitDone.store( true, std::memory_order_release );
+}
+
+/// The caller holds the context's buffer lock
+//-----------------------------------------------------------
+void AdoptGpuThresher( GreenReaperContext& cx )
+{
+    if( !cx.gpuInitThread || !cx.gpuInitDone.load( std::memory_order_acquire ) )
+        return;
+
+    cx.gpuInitThread->WaitForExit();
+    delete cx.gpuInitThread;
+    cx.gpuInitThread = nullptr;
+
+    // If it failed, the context simply stays on the CPU
+    ASSERT( !cx.cudaThresher );
+    cx.cudaThresher    = cx.gpuInitThresher;
+    cx.gpuInitThresher = nullptr;
+}
+
+//-----------------------------------------------------------
+void StopGpuInit( GreenReaperContext& cx )
+{
+    if( !cx.gpuInitThread )
+        return;
+
+    // CUDA initialization can't be interrupted
+    cx.gpuInitThread->WaitForExit();
+    delete cx.gpuInitThread;
+    cx.gpuInitThread = nullptr;
+
+    delete cx.gpuInitThresher;
+    cx.gpuInitThresher = nullptr;
+}
+
+//-----------------------------------------------------------
+uint32 GetGpuDeviceCount()
+{
+    const uint32 cudaDeviceCount = CudaThresherFactory::GetDeviceCount();
+    return cudaDeviceCount > 0 ? cudaDeviceCount : MetalThresherFactory::GetDeviceCount();
+}
+
 //-----------------------------------------------------------
 GRResult grCreateContext( GreenReaperContext** outContext, 
                           GreenReaperConfig* config,
@@ -252,35 +614,111 @@ GRResult grCreateContext( GreenReaperContext** outContext,
     if( outContext == nullptr )
         return GRResult_Failed;
 
+    // Version 1 configs end after gpuDeviceIndex, with reserved words in place of the newer options
+    const bool isConfigV1 = config && config->apiVersion == 1 && configStructSize == sizeof( GreenReaperConfigV1 );
+
+    if( config && !isConfigV1 && (configStructSize != sizeof( GreenReaperConfig ) || config->apiVersion != GR_API_VERSION) )
+        return GRResult_WrongVersion;
+
     auto* context = new GreenReaperContext{};
     if( context == nullptr )
         return GRResult_OutOfMemory;
 
-    if( config )
+    if( isConfigV1 )
+    {
+        const GreenReaperConfigV1& cfgV1 = *reinterpret_cast<const GreenReaperConfigV1*>( config );
+
+        context->config.apiVersion         = GR_API_VERSION;
+        context->config.threadCount        = cfgV1.threadCount;
+        context->config.cpuOffset          = cfgV1.cpuOffset;
+        context->config.disableCpuAffinity = cfgV1.disableCpuAffinity;
+        context->config.gpuRequest         = cfgV1.gpuRequest;
+        context->config.gpuDeviceIndex     = cfgV1.gpuDeviceIndex;
+    }
+    else if( config )
     {
-        if( configStructSize != sizeof( GreenReaperConfig ) || config->apiVersion != GR_API_VERSION )
-            return GRResult_WrongVersion;
-
         context->config = *config;
     }
     else
     {
-        context->config.threadCount = std::min( 2u, SysHost::GetLogicalCPUCount() );
+        context->config.apiVersion  = GR_API_VERSION;
+        context->config.threadCount = std::min( 2u, SysHost::GetUsableCPUCount() );
     }
 
-    context->pool = new ThreadPool( context->config.threadCount, ThreadPool::Mode::Fixed,
-                                    (bool)config->disableCpuAffinity, 
-                                    (bool)config->disableCpuAffinity ? 0 : config->cpuOffset );
-    if( !context->pool )
+    const GreenReaperConfig& cfg = context->config;
+
+    uint32 deviceCount = 0;
+
+    if( cfg.gpuRequest == GRGpuRequestKind_AllDevices )
     {
-        grDestroyContext( context );
-        return GRResult_OutOfMemory;
+        deviceCount = GetGpuDeviceCount();
+
+        // With a single device or none at all, this behaves just like a first-available request
+        if( deviceCount <= 1 )
+        {
+            context->config.gpuRequest     = GRGpuRequestKind_FirstAvailable;
+            context->config.gpuDeviceIndex = 0;
+            deviceCount = 0;
+        }
     }
 
-    if( config->gpuRequest != GRGpuRequestKind_None )
+    if( deviceCount > 1 || (cfg.gpuRequest != GRGpuRequestKind_None && (cfg.hybridQueueDepth > 0 || cfg.gpuSlotsPerDevice > 1)) )
     {
-        context->cudaThresher = CudaThresherFactory::Create( *config );
-        if( context->cudaThresher == nullptr && config->gpuRequest == GRGpuRequestKind_ExactDevice )
+        const GRResult r = CreateRoutingContext( context, deviceCount );
+        if( r != GRResult_OK )
+        {
+            grDestroyContext( context );
+            return r;
+        }
+
+        *outContext = context;
+        return GRResult_OK;
+    }
+
+    if( cfg.table1CacheSize > 0 )
+    {
+        context->t1Cache.entries  = new Table1CacheEntry[cfg.table1CacheSize]{};
+        context->t1Cache.capacity = cfg.table1CacheSize;
+    }
+
+    if( cfg.sharedPool )
+    {
+        // Split all CPU work across the shared pool's threads
+        context->pool               = cfg.sharedPool->pool;
+        context->config.threadCount = context->pool->ThreadCount();
+    }
+    else
+    {
+        context->pool = new ThreadPool( cfg.threadCount, ThreadPool::Mode::Fixed,
+                                        (bool)cfg.disableCpuAffinity, 
+                                        (bool)cfg.disableCpuAffinity ? 0 : cfg.cpuOffset );
+        if( !context->pool )
+        {
+            grDestroyContext( context );
+            return GRResult_OutOfMemory;
+        }
+
+        context->ownsPool = true;
+    }
+
+    if( cfg.idleShrinkMS > 0 )
+        RegisterIdleContext( context );
+
+    if( cfg.gpuRequest != GRGpuRequestKind_None && cfg.asyncGpuInit )
+    {
+        // An exact device request still fails right away if there's no such device
+        if( cfg.gpuRequest == GRGpuRequestKind_ExactDevice && cfg.gpuDeviceIndex >= GetGpuDeviceCount() )
+        {
+            grDestroyContext( context );
+            return GRResult_InvalidGPU;
+        }
+
+        StartGpuInit( *context );
+    }
+    else if( cfg.gpuRequest != GRGpuRequestKind_None )
+    {
+        context->cudaThresher = CreateGpuThresher( cfg );
+        if( context->cudaThresher == nullptr && cfg.gpuRequest == GRGpuRequestKind_ExactDevice )
         {
             grDestroyContext( context );
             return GRResult_InvalidGPU;
@@ -297,14 +735,95 @@ void grDestroyContext( GreenReaperContext* context )
     if( context == nullptr )
         return;
 
+    // Stop the request thread. Requests still in the queue are completed as failed.
+    if( context->requestThread )
+    {
+        context->requestThreadExit.store( true, std::memory_order_release );
+        context->requestSignal.Release();
+        context->requestThread->WaitForExit();
+
+        delete context->requestThread;
+        context->requestThread = nullptr;
+    }
+
+    if( context->deviceContexts )
+    {
+        for( uint32 i = 0; i < context->deviceContextCount; i++ )
+            grDestroyContext( context->deviceContexts[i] );
+
+        delete[] context->deviceContexts;
+        context->deviceContexts     = nullptr;
+        context->deviceContextCount = 0;
+    }
+
+    StopGpuInit( *context );
+
+    if( context->config.idleShrinkMS > 0 )
+        UnregisterIdleContext( context );
+
     FreeBucketBuffers( *context );
 
-    if( context->pool )
+    Table1CacheDestroy( context->t1Cache );
+
+    if( context->pool && context->ownsPool )
         delete context->pool;
 
     delete context;
 }
 
+//-----------------------------------------------------------
+GRResult grCreateSharedPool( GRSharedPool** outPool, const uint32_t threadCount, const uint32_t cpuOffset, const GRBool disableCpuAffinity )
+{
+    if( outPool == nullptr || threadCount == 0 )
+        return GRResult_InvalidArg;
+
+    auto* sharedPool = new GRSharedPool{};
+    sharedPool->pool = new ThreadPool( threadCount, ThreadPool::Mode::Fixed,
+                                       (bool)disableCpuAffinity,
+                                       (bool)disableCpuAffinity ? 0 : cpuOffset );
+    sharedPool->pool->EnableSharedSubmission();
+
+    *outPool = sharedPool;
+    return GRResult_OK;
+}
+
+//-----------------------------------------------------------
+void grDestroySharedPool( GRSharedPool* pool )
+{
+    if( pool == nullptr )
+        return;
+
+    delete pool->pool;
+    delete pool;
+}
+
+//-----------------------------------------------------------
+void grBeginHarvest()
+{
+    HarvestYield::BeginHarvest();
+}
+
+//-----------------------------------------------------------
+void grEndHarvest()
+{
+    HarvestYield::EndHarvest();
+}
+
+//-----------------------------------------------------------
+GRResult grBeginTrace( const char* path )
+{
+    if( !path )
+        return GRResult_InvalidArg;
+
+    return HarvestTrace::Begin( path ) ? GRResult_OK : GRResult_Failed;
+}
+
+//-----------------------------------------------------------
+void grEndTrace()
+{
+    HarvestTrace::End();
+}
+
 //-----------------------------------------------------------
 GRResult grPreallocateForCompressionLevel( GreenReaperContext* context, const uint32_t k, const uint32_t maxCompressionLevel )
 {
@@ -314,6 +833,32 @@ GRResult grPreallocateForCompressionLevel( GreenReaperContext* context, const ui
     if( k != 32 )
         return GRResult_Failed;
 
+    if( context->deviceContexts )
+    {
+        for( uint32 i = 0; i < context->deviceContextCount; i++ )
+        {
+            GreenReaperContext& dcx = *context->deviceContexts[i];
+            std::lock_guard<std::mutex> lock( dcx.fetchLock );
+
+            const GRResult r = grPreallocateForCompressionLevel( &dcx, k, maxCompressionLevel );
+            if( r != GRResult_OK )
+                return r;
+        }
+
+        return GRResult_OK;
+    }
+
+    BufferUseScope bufferScope( *context );
+
+    // Let a GPU that is still initializing reserve its buffers as well
+    if( context->gpuInitThread )
+    {
+        uint32 level = context->gpuInitLevel.load( std::memory_order_relaxed );
+        while( level < maxCompressionLevel && !context->gpuInitLevel.compare_exchange_weak( level, maxCompressionLevel ) );
+
+        AdoptGpuThresher( *context );
+    }
+
     // Ensure our buffers have enough for the specified entry bit count
     if( !ReserveBucketBuffers( *context, k, maxCompressionLevel ) )
         return GRResult_OutOfMemory;
@@ -327,13 +872,27 @@ size_t grGetMemoryUsage( GreenReaperContext* context )
     if( !context )
         return 0;
 
-    return context->allocationSize;
+    size_t size = context->allocationSize + context->t1Cache.size;
+
+    for( uint32 i = 0; i < context->deviceContextCount; i++ )
+        size += grGetMemoryUsage( context->deviceContexts[i] );
+
+    return size;
 }
 
 //-----------------------------------------------------------
 GRBool grHasGpuDecompressor( GreenReaperContext* context )
 {
-    return (context != nullptr && context->cudaThresher != nullptr ) ? GR_TRUE : GR_FALSE;
+    if( context == nullptr )
+        return GR_FALSE;
+
+    for( uint32 i = 0; i < context->deviceContextCount; i++ )
+    {
+        if( grHasGpuDecompressor( context->deviceContexts[i] ) )
+            return GR_TRUE;
+    }
+
+    return context->cudaThresher != nullptr ? GR_TRUE : GR_FALSE;
 }
 
 //-----------------------------------------------------------
@@ -366,6 +925,92 @@ GRResult grFetchProofForChallenge( GreenReaperContext* cx, GRCompressedProofRequ
     if( !req || !req->plotId )
         return GRResult_Failed;
 
+    if( !HarvestTrace::IsActive() )
+        return FetchProof( cx, req );
+
+    uint64 compressedProof[GR_POST_PROOF_CMP_X_COUNT];
+    memcpy( compressedProof, req->compressedProof, sizeof( compressedProof ) );
+
+    const auto     startTime = TimerBegin();
+    const GRResult r         = FetchProof( cx, req );
+
+    HarvestTrace::RecordProof( startTime, req->plotId, req->compressionLevel, compressedProof, r );
+    return r;
+}
+
+//-----------------------------------------------------------
+GRResult grGetFetchQualitiesXPair( GreenReaperContext* cx, GRCompressedQualitiesRequest* req )
+{
+    if( !req || !req->plotId )
+        return GRResult_Failed;
+
+    if( !HarvestTrace::IsActive() )
+        return FetchQualities( cx, req );
+
+    const auto     startTime = TimerBegin();
+    const GRResult r         = FetchQualities( cx, req );
+
+    HarvestTrace::RecordQualities( startTime, *req, r );
+    return r;
+}
+
+//-----------------------------------------------------------
+GRResult FetchProofForChallengeV1( GreenReaperContext* cx, GRCompressedProofRequest* req )
+{
+    if( !req )
+        return GRResult_Failed;
+
+    // Only the version 1 fields may be accessed, the rest of the request keeps its defaults
+    auto* reqV1 = reinterpret_cast<GRCompressedProofRequestV1*>( req );
+
+    GRCompressedProofRequest fullReq = {};
+    memcpy( fullReq.fullProof, reqV1->fullProof, sizeof( fullReq.fullProof ) );
+    fullReq.compressionLevel = reqV1->compressionLevel;
+    fullReq.plotId           = reqV1->plotId;
+
+    const GRResult r = grFetchProofForChallenge( cx, &fullReq );
+
+    memcpy( reqV1->fullProof, fullReq.fullProof, sizeof( reqV1->fullProof ) );
+    return r;
+}
+
+//-----------------------------------------------------------
+GRResult GetFetchQualitiesXPairV1( GreenReaperContext* cx, GRCompressedQualitiesRequest* req )
+{
+    if( !req )
+        return GRResult_Failed;
+
+    auto* reqV1 = reinterpret_cast<GRCompressedQualitiesRequestV1*>( req );
+
+    GRCompressedQualitiesRequest fullReq = {};
+    fullReq.plotId           = reqV1->plotId;
+    fullReq.challenge        = reqV1->challenge;
+    fullReq.compressionLevel = reqV1->compressionLevel;
+    fullReq.xLinePoints[0]   = reqV1->xLinePoints[0];
+    fullReq.xLinePoints[1]   = reqV1->xLinePoints[1];
+
+    const GRResult r = grGetFetchQualitiesXPair( cx, &fullReq );
+
+    reqV1->x1 = fullReq.x1;
+    reqV1->x2 = fullReq.x2;
+    return r;
+}
+
+//-----------------------------------------------------------
+GRResult FetchProof( GreenReaperContext* cx, GRCompressedProofRequest* req )
+{
+    if( cx && cx->deviceContexts )
+    {
+        GreenReaperContext* dcx = AcquireDeviceContext( *cx );
+        std::lock_guard<std::mutex> lock( dcx->fetchLock );
+
+        const GRResult r = FetchProof( dcx, req );
+        dcx->pendingRequests--;
+        return r;
+    }
+
+    BufferUseScope bufferScope( *cx );
+
     const uint32 k = 32;
     {
         auto r = RequestSetup( cx, k, req->compressionLevel );
@@ -380,17 +1025,24 @@ GRResult grFetchProofForChallenge( GreenReaperContext* cx, GRCompressedProofRequ
 
     bool proofMightBeDropped = false;
 
-    if( cx->cudaThresher ) cx->cudaThresher->ClearTimings();
+    RequestTimingsScope timingsScope( *cx, req->outTimings );
 
     uint32 xGroups[GR_POST_PROOF_X_COUNT] = {};
 
     // Unpack x groups first
+    uint64  xLinePoints[numGroups];
+    BackPtr xPairs     [numGroups];
+
+    for( uint32 i = 0; i < numGroups; i++ )
+        xLinePoints[i] = (uint32)req->compressedProof[i];
+
+    LinePointsToSquares64( xLinePoints, xPairs, numGroups );
+
     if( req->compressionLevel < 9 )
     {
         for( uint32 i = 0, j = 0; i < numGroups; i++, j+=2 )
         {
-            const uint32  xLinePoint = (uint32)req->compressedProof[i];
-            const BackPtr xs         = LinePointToSquare64( xLinePoint );
+            const BackPtr xs = xPairs[i];
 
             proofMightBeDropped = proofMightBeDropped || (xs.x == 0 || xs.y == 0);
 
@@ -402,8 +1054,7 @@ GRResult grFetchProofForChallenge( GreenReaperContext* cx, GRCompressedProofRequ
     {
         for( uint32 i = 0, j = 0; i < numGroups / 2; i++, j+=4 )
         {
-            const uint32  xLinePoint = (uint32)req->compressedProof[i];
-            const BackPtr xs         = LinePointToSquare64( xLinePoint );
+            const BackPtr xs = xPairs[i];
 
             const uint32 entrybits = GetCompressionInfoForLevel( req->compressionLevel ).entrySizeBits;
             const uint32 mask      = (1u << entrybits) - 1;
@@ -418,74 +1069,213 @@ GRResult grFetchProofForChallenge( GreenReaperContext* cx, GRCompressedProofRequ
     }
 
     {
-        Table1BucketContext tcx;
-        tcx.cx               = cx;
-        tcx.plotId           = req->plotId;
-        tcx.entriesPerBucket = entriesPerBucket;
-        tcx.outY             = cx->yBufferTmp;
-        tcx.outMeta          = cx->metaBufferTmp.template As<K32Meta2>();
-        tcx.outPairs         = cx->pairs;
+        Table1BucketContext tcx;
+        tcx.cx               = cx;
+        tcx.plotId           = req->plotId;
+        tcx.entriesPerBucket = entriesPerBucket;
+        tcx.compressionLevel = req->compressionLevel;
+        tcx.outY             = cx->yBufferTmp;
+        tcx.outMeta          = cx->metaBufferTmp.template As<K32Meta2>();
+        tcx.outPairs         = cx->pairs;
+
+        for( uint32 i = 0, j = 0; i < numGroups; i++, j+= 2 )
+        {
+            const uint64 x1 = xGroups[j+0];
+            const uint64 x2 = xGroups[j+1];
+
+                  auto&  table      = cx->tables[1];
+            const uint32 groupIndex = i / 2;
+
+            if( (i % 2 ) == 0 )
+                table.BeginGroup( groupIndex );
+
+            const GRResult r = ProcessTable1Bucket( tcx, x1, x2, groupIndex );
+             if( r != GRResult_OK )
+                return proofMightBeDropped ? GRResult_NoProof : GRResult_Failed;
+        }
+    }
+
+    // #NOTE: Sanity check, but should never happen w/ our starting compression levels.
+    if( cx->tables[1]._length <= 2 )
+    {
+        Log::Line( "[GR_WARNING] Unexpected proof match on first table." );
+        return GRResult_Failed;
+    }
+
+    // Continue forward propagation to the next table
+    const uint32 table2Length = (uint32)cx->tables[1]._length;
+
+    cx->proofContext.leftLength = table2Length;
+    // cx->proofContext.rightLength = cx->tables[2]._capacity;
+
+    cx->proofContext.yLeft     = cx->yBuffer.Ptr();
+    cx->proofContext.metaLeft  = cx->metaBuffer.Ptr();
+    cx->proofContext.yRight    = cx->yBufferTmp.Ptr();
+    cx->proofContext.metaRight = cx->metaBufferTmp.Ptr();
+    cx->proofContext.proof     = req->fullProof;
+
+    SortTableAndFlipBuffers<TableId::Table2>( *cx, 32 >> (int)TableId::Table2 );
+
+    return ForwardPropTables( *cx ) ? GRResult_OK : 
+        proofMightBeDropped ? GRResult_NoProof : GRResult_Failed;
+}
+
+//-----------------------------------------------------------
+GRResult FetchQualities( GreenReaperContext* cx, GRCompressedQualitiesRequest* req )
+{
+    if( cx && cx->deviceContexts )
+    {
+        GreenReaperContext* dcx = AcquireDeviceContext( *cx );
+        std::lock_guard<std::mutex> lock( dcx->fetchLock );
+
+        const GRResult r = FetchQualities( dcx, req );
+        dcx->pendingRequests--;
+        return r;
+    }
+
+    BufferUseScope bufferScope( *cx );
+
+    const uint32 k = 32;
+    {
+        auto r = RequestSetup( cx, k, req->compressionLevel );
+        if( r != GRResult_OK )
+            return r;
+    }
+
+    return FetchQualitiesXPair( cx, req );
+}
+
+//-----------------------------------------------------------
+GRResult grFetchQualitiesXPairBatch( GreenReaperContext* cx, GRCompressedQualitiesRequest* reqs, GRResult* outResults, const uint32_t count )
+{
+    if( !cx || !reqs || !outResults )
+        return GRResult_InvalidArg;
+
+    if( count == 0 )
+        return GRResult_OK;
+
+    if( cx->deviceContexts )
+    {
+        GreenReaperContext* dcx = AcquireDeviceContext( *cx );
+        std::lock_guard<std::mutex> lock( dcx->fetchLock );
+
+        const GRResult r = grFetchQualitiesXPairBatch( dcx, reqs, outResults, count );
+        dcx->pendingRequests--;
+        return r;
+    }
+
+    const uint32 k = 32;
+
+    // Reserve buffers once for the highest compression level in the batch,
+    // so that all requests share the same F1, sort and match buffers.
+    uint32 maxCompressionLevel = 0;
+    for( uint32 i = 0; i < count; i++ )
+    {
+        const GRCompressedQualitiesRequest& req = reqs[i];
+
+        const bool isValid = req.plotId && req.challenge && req.compressionLevel >= 1 && req.compressionLevel <= 9;
+        outResults[i] = isValid ? GRResult_OK : GRResult_InvalidArg;
+
+        if( isValid )
+            maxCompressionLevel = std::max( maxCompressionLevel, req.compressionLevel );
+    }
+
+    if( maxCompressionLevel == 0 )
+        return GRResult_OK;
+
+    BufferUseScope bufferScope( *cx );
+
+    {
+        auto r = RequestSetup( cx, k, maxCompressionLevel );
+        if( r != GRResult_OK )
+            return r;
+    }
+
+    for( uint32 i = 0; i < count; i++ )
+    {
+        GRCompressedQualitiesRequest& req = reqs[i];
 
-        for( uint32 i = 0, j = 0; i < numGroups; i++, j+= 2 )
+        if( outResults[i] != GRResult_OK )
+            continue;
+
+        // The thresher may have been lost on a previous request, make sure it gets re-created
+        if( cx->cudaRecreateThresher )
         {
-            const uint64 x1 = xGroups[j+0];
-            const uint64 x2 = xGroups[j+1];
+            auto r = RequestSetup( cx, k, maxCompressionLevel );
+            if( r != GRResult_OK )
+            {
+                for( uint32 j = i; j < count; j++ )
+                    outResults[j] = r;
 
-                  auto&  table      = cx->tables[1];
-            const uint32 groupIndex = i / 2;
+                return r;
+            }
+        }
 
-            if( (i % 2 ) == 0 )
-                table.BeginGroup( groupIndex );
+        const auto startTime = TimerBegin();
+        outResults[i] = FetchQualitiesXPair( cx, &req );
 
-            const GRResult r = ProcessTable1Bucket( tcx, x1, x2, groupIndex );
-             if( r != GRResult_OK )
-                return proofMightBeDropped ? GRResult_NoProof : GRResult_Failed;
-        }
+        if( HarvestTrace::IsActive() )
+            HarvestTrace::RecordQualities( startTime, req, outResults[i] );
     }
 
-    // Test
-    if( cx->cudaThresher )
-        cx->cudaThresher->DumpTimings();
+    return GRResult_OK;
+}
 
-    // #NOTE: Sanity check, but should never happen w/ our starting compression levels.
-    if( cx->tables[1]._length <= 2 )
-    {
-        Log::Line( "[GR_WARNING] Unexpected proof match on first table." );
-        return GRResult_Failed;
-    }
+//-----------------------------------------------------------
+GRResult grSubmitProofForChallenge( GreenReaperContext* cx, GRCompressedProofRequest* req,
+                                    GRCompletionCallback callback, void* userData, GRAsyncRequest** outRequest )
+{
+    if( !req || !req->plotId )
+        return GRResult_InvalidArg;
 
-    // Continue forward propagation to the next table
-    const uint32 table2Length = (uint32)cx->tables[1]._length;
+    return SubmitAsyncRequest( cx, GRAsyncRequest::Proof, req, callback, userData, outRequest );
+}
 
-    cx->proofContext.leftLength = table2Length;
-    // cx->proofContext.rightLength = cx->tables[2]._capacity;
+//-----------------------------------------------------------
+GRResult grSubmitQualitiesXPair( GreenReaperContext* cx, GRCompressedQualitiesRequest* req,
+                                 GRCompletionCallback callback, void* userData, GRAsyncRequest** outRequest )
+{
+    if( !req || !req->plotId || !req->challenge )
+        return GRResult_InvalidArg;
 
-    cx->proofContext.yLeft     = cx->yBuffer.Ptr();
-    cx->proofContext.metaLeft  = cx->metaBuffer.Ptr();
-    cx->proofContext.yRight    = cx->yBufferTmp.Ptr();
-    cx->proofContext.metaRight = cx->metaBufferTmp.Ptr();
-    cx->proofContext.proof     = req->fullProof;
+    return SubmitAsyncRequest( cx, GRAsyncRequest::Qualities, req, callback, userData, outRequest );
+}
 
-    SortTableAndFlipBuffers<TableId::Table2>( *cx, 32 >> (int)TableId::Table2 );
+//-----------------------------------------------------------
+GRResult grPollRequest( GRAsyncRequest* request )
+{
+    if( !request )
+        return GRResult_InvalidArg;
 
-    return ForwardPropTables( *cx ) ? GRResult_OK : 
-        proofMightBeDropped ? GRResult_NoProof : GRResult_Failed;
+    return request->result.load( std::memory_order_acquire );
 }
 
 //-----------------------------------------------------------
-GRResult grGetFetchQualitiesXPair( GreenReaperContext* cx, GRCompressedQualitiesRequest* req )
+GRResult grWaitForRequest( GRAsyncRequest* request )
 {
-    if( !req || !req->plotId )
-        return GRResult_Failed;
+    if( !request )
+        return GRResult_InvalidArg;
+
+    request->fence.Wait( 1 );
+    return request->result.load( std::memory_order_acquire );
+}
 
+//-----------------------------------------------------------
+void grReleaseRequest( GRAsyncRequest* request )
+{
+    if( !request )
+        return;
+
+    request->fence.Wait( 1 );
+    ReleaseAsyncRequestRef( request );
+}
+
+//-----------------------------------------------------------
+GRResult FetchQualitiesXPair( GreenReaperContext* cx, GRCompressedQualitiesRequest* req )
+{
     const uint32 k = 32;
-    {
-        auto r = RequestSetup( cx, k, req->compressionLevel );
-        if( r != GRResult_OK )
-            return r;
-    }
 
-    if( cx->cudaThresher ) cx->cudaThresher->ClearTimings();
+    RequestTimingsScope timingsScope( *cx, req->outTimings );
 
     const uint64 entriesPerBucket = GetEntriesPerBucketForCompressionLevel( k, req->compressionLevel );
     ASSERT( entriesPerBucket <= 0xFFFFFFFF );
@@ -495,6 +1285,7 @@ GRResult grGetFetchQualitiesXPair( GreenReaperContext* cx, GRCompressedQualities
     tcx.cx               = cx;
     tcx.plotId           = req->plotId;
     tcx.entriesPerBucket = entriesPerBucket;
+    tcx.compressionLevel = req->compressionLevel;
     tcx.outY             = cx->yBufferTmp;
     tcx.outMeta          = cx->metaBufferTmp.template As<K32Meta2>();
     tcx.outPairs         = cx->pairs;
@@ -615,17 +1406,32 @@ GRResult grGetFetchQualitiesXPair( GreenReaperContext* cx, GRCompressedQualities
 
     TableId matchTable = TableId::Table3;
 
-    auto fpResult = ForwardPropTable<TableId::Table3>( *cx, numXGroups /= 2, true );
+    // The qualities only need the table 3 pair that leads to the first group's x's.
+    // Once a single one of those can still be part of the proof, the remaining tables are skipped.
+    Pair t3Pair           = {};
+    bool t3PairIsResolved = false;
+
+    auto resolveT3Pair = [&]( const ForwardPropResult r ) {
+        if( r != ForwardPropResult::Continue || proofMightBeDropped )
+            return r;
+
+        const auto resolved = ResolveQualityPair( *cx, matchTable, t3Pair );
+        t3PairIsResolved = resolved == ForwardPropResult::Success;
+
+        return resolved;
+    };
+
+    auto fpResult = resolveT3Pair( ForwardPropTable<TableId::Table3>( *cx, numXGroups /= 2, true ) );
 
     if( fpResult == ForwardPropResult::Continue )
     {
         matchTable = TableId::Table4;
-        fpResult = ForwardPropTable<TableId::Table4>( *cx, numXGroups /= 2, true );
+        fpResult = resolveT3Pair( ForwardPropTable<TableId::Table4>( *cx, numXGroups /= 2, true ) );
     }
     if( fpResult == ForwardPropResult::Continue )
     {
         matchTable = TableId::Table5;
-        fpResult = ForwardPropTable<TableId::Table5>( *cx, numXGroups /= 2, true );
+        fpResult = resolveT3Pair( ForwardPropTable<TableId::Table5>( *cx, numXGroups /= 2, true ) );
     }
     if( fpResult == ForwardPropResult::Continue )
     {
@@ -640,6 +1446,7 @@ GRResult grGetFetchQualitiesXPair( GreenReaperContext* cx, GRCompressedQualities
     // the ones that belong to the first group
     uint64 qualityXs[8] = {};
 
+    if( !t3PairIsResolved )
     {
         Pair  pairs[2][4] = {};
         Pair* pairsIn  = pairs[0];
@@ -667,9 +1474,11 @@ GRResult grGetFetchQualitiesXPair( GreenReaperContext* cx, GRCompressedQualities
         }
 
         // From table 3, only take the pair that points to the first group
-        const Pair t3Pair = pairsIn[0].left < cx->tables[1]._groups[0].count ?
-                            pairsIn[0] : pairsIn[1];
+        t3Pair = pairsIn[0].left < cx->tables[1]._groups[0].count ?
+                 pairsIn[0] : pairsIn[1];
+    }
 
+    {
         // Grab the x's from the first group only
         const Pair xPair0 = cx->tables[1]._pairs[t3Pair.left ];
         const Pair xPair1 = cx->tables[1]._pairs[t3Pair.right];
@@ -705,11 +1514,368 @@ GRResult grGetFetchQualitiesXPair( GreenReaperContext* cx, GRCompressedQualities
 ///
 /// Private Funcs
 ///
+//-----------------------------------------------------------
+GRResult SubmitAsyncRequest( GreenReaperContext* cx, const GRAsyncRequest::Kind kind, void* req,
+                             GRCompletionCallback callback, void* userData, GRAsyncRequest** outRequest )
+{
+    if( !cx )
+        return GRResult_InvalidArg;
+
+    // Multi-device contexts forward the request to the device context's own request thread
+    if( cx->deviceContexts )
+    {
+        GreenReaperContext* dcx = AcquireDeviceContext( *cx );
+
+        const GRResult r = SubmitAsyncRequest( dcx, kind, req, callback, userData, outRequest );
+        dcx->pendingRequests--;
+        return r;
+    }
+
+    std::lock_guard<std::mutex> lock( cx->requestLock );
+
+    if( !cx->requestThread )
+    {
+        cx->requestThread = new Thread();
+        cx->requestThread->Run( RequestThreadMain, cx );
+    }
+
+    auto* r = new GRAsyncRequest{};
+    r->cx       = cx;
+    r->kind     = kind;
+    r->request  = req;
+    r->callback = callback;
+    r->userData = userData;
+
+    const uint32 deadlineMS = kind == GRAsyncRequest::Proof ? ((GRCompressedProofRequest*)req)->deadlineMS
+                                                            : ((GRCompressedQualitiesRequest*)req)->deadlineMS;
+    r->priority = kind == GRAsyncRequest::Proof ? ((GRCompressedProofRequest*)req)->priority
+                                                : ((GRCompressedQualitiesRequest*)req)->priority;
+    r->deadline = deadlineMS > 0 ? std::chrono::steady_clock::now() + std::chrono::milliseconds( deadlineMS )
+                                 : std::chrono::steady_clock::time_point::max();
+
+    if( HarvestTrace::IsActive() )
+    {
+        r->traced     = true;
+        r->submitTime = TimerBegin();
+
+        if( kind == GRAsyncRequest::Proof )
+            memcpy( r->tracedProof, ((GRCompressedProofRequest*)req)->compressedProof, sizeof( r->tracedProof ) );
+    }
+
+    if( outRequest )
+    {
+        r->refCount = 2;
+        *outRequest = r;
+    }
+
+    cx->pendingRequests++;
+    cx->requestQueue.push_back( r );
+    cx->requestSignal.Release();
+
+    return GRResult_OK;
+}
+
+//-----------------------------------------------------------
+void RequestThreadMain( GreenReaperContext* cx )
+{
+    for( ;; )
+    {
+        cx->requestSignal.Wait();
+
+        if( cx->requestThreadExit.load( std::memory_order_acquire ) )
+            break;
+
+        GRAsyncRequest* r = NextAsyncRequest( *cx );
+        if( !r )
+            continue;
+
+        GRResult result;
+        {
+            std::lock_guard<std::mutex> lock( cx->fetchLock );
+
+            // Traced requests are recorded on completion instead, timed from their submission
+            if( r->kind == GRAsyncRequest::Proof )
+                result = FetchProof( cx, (GRCompressedProofRequest*)r->request );
+            else
+                result = FetchQualities( cx, (GRCompressedQualitiesRequest*)r->request );
+        }
+
+        CompleteAsyncRequest( r, result );
+    }
+
+    // Fail any requests that did not get to run
+    std::vector<GRAsyncRequest*> remaining;
+    {
+        std::lock_guard<std::mutex> lock( cx->requestLock );
+        remaining.swap( cx->requestQueue );
+    }
+
+    for( GRAsyncRequest* r : remaining )
+        CompleteAsyncRequest( r, GRResult_Failed );
+}
+
+//-----------------------------------------------------------
+GRAsyncRequest* NextAsyncRequest( GreenReaperContext& cx )
+{
+    std::vector<GRAsyncRequest*> expired;
+    GRAsyncRequest*              next = nullptr;
+    {
+        std::lock_guard<std::mutex> lock( cx.requestLock );
+
+        const auto now = std::chrono::steady_clock::now();
+        auto&      queue = cx.requestQueue;
+
+        // Drop expired requests
+        for( size_t i = 0; i < queue.size(); )
+        {
+            if( queue[i]->deadline <= now )
+            {
+                expired.push_back( queue[i] );
+                queue.erase( queue.begin() + (ptrdiff_t)i );
+            }
+            else
+                i++;
+        }
+
+        // Pick the first of the highest ranked requests
+        size_t best = queue.size();
+        for( size_t i = 0; i < queue.size(); i++ )
+        {
+            const GRAsyncRequest* r = queue[i];
+
+            if( best == queue.size() || r->priority > queue[best]->priority ||
+                ( r->priority == queue[best]->priority && r->kind == GRAsyncRequest::Proof && queue[best]->kind != GRAsyncRequest::Proof ) )
+            {
+                best = i;
+            }
+        }
+
+        if( best < queue.size() )
+        {
+            next = queue[best];
+            queue.erase( queue.begin() + (ptrdiff_t)best );
+        }
+    }
+
+    for( GRAsyncRequest* r : expired )
+        CompleteAsyncRequest( r, GRResult_Expired );
+
+    return next;
+}
+
+//-----------------------------------------------------------
+void CompleteAsyncRequest( GRAsyncRequest* r, const GRResult result )
+{
+    r->cx->pendingRequests--;
+
+    // Record before the callback, after which the request struct may be gone
+    if( r->traced )
+    {
+        if( r->kind == GRAsyncRequest::Proof )
+        {
+            auto* req = (GRCompressedProofRequest*)r->request;
+            HarvestTrace::RecordProof( r->submitTime, req->plotId, req->compressionLevel, r->tracedProof, result );
+        }
+        else
+            HarvestTrace::RecordQualities( r->submitTime, *(GRCompressedQualitiesRequest*)r->request, result );
+    }
+
+    r->result.store( result, std::memory_order_release );
+
+    // Signal before the callback, so that it can wait on or release the request itself.
+    // Our own reference keeps the request alive until the callback returns.
+    r->fence.Signal( 1 );
+
+    if( r->callback )
+        r->callback( r, result, r->userData );
+
+    ReleaseAsyncRequestRef( r );
+}
+
+//-----------------------------------------------------------
+void ReleaseAsyncRequestRef( GRAsyncRequest* r )
+{
+    if( r->refCount.fetch_sub( 1, std::memory_order_acq_rel ) == 1 )
+        delete r;
+}
+
+//-----------------------------------------------------------
+GRResult CreateRoutingContext( GreenReaperContext* cx, const uint32 deviceCount )
+{
+    const GreenReaperConfig& cfg = cx->config;
+
+    // deviceCount is 0 when a single device was requested
+    const uint32 gpuDeviceCount  = std::max( 1u, deviceCount );
+    const uint32 slotsPerDevice  = std::max( 1u, cfg.gpuSlotsPerDevice );
+    const uint32 gpuContextCount = gpuDeviceCount * slotsPerDevice;
+    const uint32 maxContexts     = gpuContextCount + 1;
+
+    // Split the CPU threads evenly across device slots.
+    // In hybrid mode the CPU context takes an equal share, from what the device slots leave over.
+    const uint32 threadShares      = gpuContextCount + ( cfg.hybridQueueDepth > 0 ? 1 : 0 );
+    const uint32 threadsPerContext = std::max( 1u, cfg.threadCount / threadShares );
+    uint32       threadsUsed       = 0;     // By the device contexts created so far
+
+    cx->deviceContexts     = new GreenReaperContext*[maxContexts]{};
+    cx->deviceContextCount = 0;
+
+    // Each slot is a context with its own thresher, so its own streams and buffers.
+    // Slots are ordered so that the least-loaded pick spreads requests across devices first.
+    for( uint32 i = 0; i < gpuContextCount; i++ )
+    {
+        const uint32 device = i % gpuDeviceCount;
+
+        GreenReaperConfig dcfg = cfg;
+        dcfg.hybridQueueDepth  = 0;
+        dcfg.gpuSlotsPerDevice = 1;
+        dcfg.threadCount       = threadsPerContext;
+        dcfg.cpuOffset         = cfg.cpuOffset + threadsUsed;
+
+        if( deviceCount > 0 )
+        {
+            dcfg.gpuRequest     = GRGpuRequestKind_ExactDevice;
+            dcfg.gpuDeviceIndex = device;
+        }
+
+        GreenReaperContext* dcx = nullptr;
+        const GRResult r = grCreateContext( &dcx, &dcfg, sizeof( dcfg ) );
+
+        // Skip unusable devices, unless an exact device was requested
+        if( r == GRResult_InvalidGPU && deviceCount > 0 )
+            continue;
+
+        if( r != GRResult_OK )
+            return r;
+
+        // A first-available request may have fallen back to the CPU, the CPU context below covers that.
+        // Contexts whose GPU is still initializing decompress on the CPU meanwhile.
+        if( !dcx->cudaThresher && !dcx->gpuInitThread )
+        {
+            grDestroyContext( dcx );
+            continue;
+        }
+
+        cx->deviceContexts[cx->deviceContextCount++] = dcx;
+        threadsUsed += threadsPerContext;
+    }
+
+    // Add a CPU context for hybrid mode, or as a fallback when no device is usable
+    if( cfg.hybridQueueDepth > 0 || cx->deviceContextCount == 0 )
+    {
+        GreenReaperConfig dcfg = cfg;
+        dcfg.gpuRequest        = GRGpuRequestKind_None;
+        dcfg.hybridQueueDepth  = 0;
+        dcfg.gpuSlotsPerDevice = 0;
+
+        // Only the threads the device contexts don't use, so that the host is not oversubscribed
+        dcfg.threadCount       = std::max( 1u, cfg.threadCount - std::min( cfg.threadCount, threadsUsed ) );
+        dcfg.cpuOffset         = cfg.cpuOffset + threadsUsed;
+
+        GreenReaperContext* dcx = nullptr;
+        const GRResult r = grCreateContext( &dcx, &dcfg, sizeof( dcfg ) );
+        if( r != GRResult_OK )
+            return r;
+
+        cx->cpuContext = dcx;
+        cx->deviceContexts[cx->deviceContextCount++] = dcx;
+    }
+
+    return GRResult_OK;
+}
+
+//-----------------------------------------------------------
+GreenReaperContext* AcquireDeviceContext( GreenReaperContext& cx )
+{
+    ASSERT( cx.deviceContextCount > 0 );
+
+    GreenReaperContext* best     = nullptr;
+    uint32              bestLoad = 0;
+
+    // Pick the least-loaded GPU context
+    for( uint32 i = 0; i < cx.deviceContextCount; i++ )
+    {
+        GreenReaperContext* dcx = cx.deviceContexts[i];
+        if( dcx == cx.cpuContext )
+            continue;
+
+        const uint32 load = dcx->pendingRequests.load( std::memory_order_relaxed );
+
+        if( !best || load < bestLoad )
+        {
+            best     = dcx;
+            bestLoad = load;
+        }
+    }
+
+    // Let the CPU take the request when the GPUs are saturated and the CPU is idle
+    if( cx.cpuContext )
+    {
+        const bool gpuSaturated = !best || bestLoad >= cx.config.hybridQueueDepth;
+
+        if( gpuSaturated && cx.cpuContext->pendingRequests.load( std::memory_order_relaxed ) == 0 )
+            best = cx.cpuContext;
+    }
+
+    if( !best )
+        best = cx.cpuContext;
+
+    // Released by the caller once the request is done, or handed off to the context's request thread
+    best->pendingRequests++;
+    return best;
+}
+
 //-----------------------------------------------------------
 GRResult ProcessTable1Bucket( Table1BucketContext& tcx, const uint64 x1, const uint64 x2, const uint32 groupIndex )
 {
     GreenReaperContext& cx = *tcx.cx;
 
+    // Re-use the results of a previous request on the same plot, if we have them
+    if( cx.t1Cache.capacity > 0 )
+    {
+        const Table1CacheEntry* entry = Table1CacheFind( cx, tcx.plotId, tcx.compressionLevel, x1, x2 );
+        
+        if( entry && entry->length <= tcx.outPairs.Length() )
+        {
+            const uint32 matchCount = entry->length;
+
+            bbmemcpy_t( tcx.outPairs.Ptr(), entry->pairs, matchCount );
+            bbmemcpy_t( tcx.outY    .Ptr(), entry->y    , matchCount );
+            bbmemcpy_t( tcx.outMeta .Ptr(), entry->meta , matchCount );
+
+            cx.tables[1].AddGroupPairs( groupIndex, matchCount );
+
+            tcx.outPairs = tcx.outPairs.Slice( matchCount );
+            tcx.outY     = tcx.outY    .Slice( matchCount );
+            tcx.outMeta  = tcx.outMeta .Slice( matchCount );
+
+            return GRResult_OK;
+        }
+
+        // Cache the results once they've been generated
+        const Span<Pair>     outPairs = tcx.outPairs;
+        const Span<uint64>   outY     = tcx.outY;
+        const Span<K32Meta2> outMeta  = tcx.outMeta;
+
+        const GRResult r = ProcessTable1BucketUncached( tcx, x1, x2, groupIndex );
+        
+        if( r == GRResult_OK )
+        {
+            const size_t matchCount = outPairs.Length() - tcx.outPairs.Length();
+            Table1CacheInsert( cx, tcx.plotId, tcx.compressionLevel, x1, x2, outPairs.SliceSize( matchCount ),
+                               outY.SliceSize( matchCount ), outMeta.SliceSize( matchCount ) );
+        }
+
+        return r;
+    }
+
+    return ProcessTable1BucketUncached( tcx, x1, x2, groupIndex );
+}
+
+//-----------------------------------------------------------
+GRResult ProcessTable1BucketUncached( Table1BucketContext& tcx, const uint64 x1, const uint64 x2, const uint32 groupIndex )
+{
+    GreenReaperContext& cx = *tcx.cx;
+
     // #TODO: Not supported proofs, these should be droped
     const bool proofMightBeDropped = x1 == 0 || x2 == 0 ;
     
@@ -777,7 +1943,9 @@ GRResult ProcessTable1BucketCPU( Table1BucketContext& tcx, const uint64 x1, cons
     auto yEntries = cx.yBuffer;
     auto xEntries = cx.xBuffer;
 
+    const auto matchTimer = TimerBegin();
     const Span<Pair> pairs = Match( cx, yEntries, tcx.outPairs, 0 );
+    RecordTiming( cx, &GRProofTimings::matchElapsedNS, matchTimer );
 // Log::Line( "[%u] CPU Pairs: %u", groupIndex, (uint)pairs.Length() );
     // Expect at least one match
     if( pairs.Length() < 1 )
@@ -787,7 +1955,9 @@ GRResult ProcessTable1BucketCPU( Table1BucketContext& tcx, const uint64 x1, cons
     table.AddGroupPairs( groupIndex, (uint32)pairs.Length() );
 
     // Perform fx for table2 pairs
+    const auto fxTimer = TimerBegin();
     GenerateFxForPairs<TableId::Table2>( cx, pairs, yEntries, xEntries, tcx.outY, tcx.outMeta );
+    RecordTiming( cx, &GRProofTimings::fxElapsedNS, fxTimer );
 
     // Inline x's into the pairs
     {
@@ -897,13 +2067,17 @@ GRResult RequestSetup( GreenReaperContext* cx, const uint32 k, const uint32 comp
     if( compressionLevel < 1 || compressionLevel > 9 )
         return GRResult_Failed;
 
+    // Start using the GPU once its background initialization completes
+    if( cx->gpuInitThread )
+        AdoptGpuThresher( *cx );
+
     // Make sure we have our CUDA decompressor working in case it was deleted after a failure
     {
         // if( cx->config.gpuRequest != GRGpuRequestKind_None )
         if( cx->cudaRecreateThresher )
         {
             ASSERT( !cx->cudaThresher );
-            cx->cudaThresher = CudaThresherFactory::Create( cx->config );
+            cx->cudaThresher = CreateGpuThresher( cx->config );
             if( !cx->cudaThresher )
                 return GRResult_Failed;
 
@@ -911,9 +2085,9 @@ GRResult RequestSetup( GreenReaperContext* cx, const uint32 k, const uint32 comp
         }
     }
 
-    const GRResult r = grPreallocateForCompressionLevel( cx, k, compressionLevel );
-    if( r != GRResult_OK )    
-        return r;
+    // The caller already holds the buffer lock
+    if( !ReserveBucketBuffers( *cx, k, compressionLevel ) )
+        return GRResult_OutOfMemory;
 
     // Always make sure this has been done
     {
@@ -923,7 +2097,7 @@ GRResult RequestSetup( GreenReaperContext* cx, const uint32 k, const uint32 comp
         _lTargetLock.unlock();
     }
 
-    return r;
+    return GRResult_OK;
 }
 
 //-----------------------------------------------------------
@@ -938,7 +2112,21 @@ bool ReserveBucketBuffers( GreenReaperContext& cx, const uint32 k, const uint32
         ASSERT( entriesPerBucket > cx.maxEntriesPerBucket );
 
         cx.maxEntriesPerBucket = 0;
-        FreeBucketBuffers( cx );
+
+        // With an idle pool, the smaller buffers may still serve another context,
+        // and a context that shrank may find buffers for this level there.
+        if( cx.config.idleShrinkMS > 0 )
+        {
+            ReleaseBucketBuffersToPool( cx );
+
+            if( cx.cudaThresher != nullptr )
+                cx.cudaThresher->ReleaseBuffers();
+
+            if( TakeBucketBuffersFromPool( cx, compressionLevel ) )
+                return ReserveThresherBuffers( cx, k, compressionLevel );
+        }
+        else
+            FreeBucketBuffers( cx );
 
         const size_t allocCount = (size_t)entriesPerBucket * 2;
 
@@ -988,6 +2176,12 @@ bool ReserveBucketBuffers( GreenReaperContext& cx, const uint32 k, const uint32
         cx.maxCompressionLevelReserved = compressionLevel;
     }
 
+    return ReserveThresherBuffers( cx, k, compressionLevel );
+}
+
+//-----------------------------------------------------------
+bool ReserveThresherBuffers( GreenReaperContext& cx, const uint32 k, const uint32 compressionLevel )
+{
     if( cx.cudaThresher != nullptr )
     {
         if( !cx.cudaThresher->AllocateBuffers( k, compressionLevel ) )
@@ -1029,6 +2223,233 @@ void FreeBucketBuffers( GreenReaperContext& cx )
 }
 
 
+///
+/// Idle shrinking (GreenReaperConfig::idleShrinkMS)
+///
+static std::mutex                        _idleLock;
+static std::condition_variable           _idleSignal;
+static std::vector<GreenReaperContext*>  _idleContexts;     // Contexts that shrink when idle
+static std::vector<BucketBuffers>        _idlePool;         // Buffers released by idle contexts
+static Thread*                           _idleThread = nullptr;
+static bool                              _idleExit   = false;
+
+static constexpr uint32 IDLE_CHECK_INTERVAL_MS = 250;
+
+//-----------------------------------------------------------
+void RegisterIdleContext( GreenReaperContext* cx )
+{
+    std::lock_guard<std::mutex> lock( _idleLock );
+
+    _idleContexts.push_back( cx );
+
+    if( _idleThread == nullptr )
+    {
+        _idleExit   = false;
+        _idleThread = new Thread( 64 KiB );
+        _idleThread->Run( []( void* ) { IdleThreadMain(); }, nullptr );
+    }
+}
+
+//-----------------------------------------------------------
+void UnregisterIdleContext( GreenReaperContext* cx )
+{
+    Thread* thread = nullptr;
+    {
+        std::lock_guard<std::mutex> lock( _idleLock );
+
+        auto it = std::find( _idleContexts.begin(), _idleContexts.end(), cx );
+        if( it == _idleContexts.end() )
+            return;
+
+        _idleContexts.erase( it );
+
+        // Nobody left to take pooled buffers, stop the thread and free them
+        if( _idleContexts.empty() )
+        {
+            for( auto& b : _idlePool )
+                FreeBucketBufferSet( b );
+            _idlePool.clear();
+
+            _idleExit   = true;
+            thread      = _idleThread;
+            _idleThread = nullptr;
+        }
+    }
+
+    if( thread )
+    {
+        _idleSignal.notify_all();
+        thread->WaitForExit();
+        delete thread;
+    }
+}
+
+//-----------------------------------------------------------
+BucketBuffers DetachBucketBuffers( GreenReaperContext& cx )
+{
+    BucketBuffers b = {};
+    b.compressionLevel = cx.maxCompressionLevelReserved;
+    b.entriesPerBucket = cx.maxEntriesPerBucket;
+    b.allocationSize   = cx.allocationSize;
+    b.yBufferF1        = cx.yBufferF1;
+    b.yBuffer          = cx.yBuffer;
+    b.yBufferTmp       = cx.yBufferTmp;
+    b.xBuffer          = cx.xBuffer;
+    b.xBufferTmp       = cx.xBufferTmp;
+    b.sortKey          = cx.sortKey;
+    b.metaBuffer       = cx.metaBuffer;
+    b.metaBufferTmp    = cx.metaBufferTmp;
+    b.pairs            = cx.pairs;
+    b.pairsTmp         = cx.pairsTmp;
+    b.groupsBoundaries = cx.groupsBoundaries;
+    b.releaseTime      = std::chrono::steady_clock::now();
+    b.idleShrinkMS     = cx.config.idleShrinkMS;
+
+    for( uint32 i = 0; i < 7; i++ )
+    {
+        b.tablePairs   [i] = cx.tables[i]._pairs;
+        b.tableCapacity[i] = cx.tables[i]._capacity;
+        cx.tables[i]       = {};
+    }
+
+    cx.yBufferF1        = {};
+    cx.yBuffer          = {};
+    cx.yBufferTmp       = {};
+    cx.xBuffer          = {};
+    cx.xBufferTmp       = {};
+    cx.sortKey          = {};
+    cx.metaBuffer       = {};
+    cx.metaBufferTmp    = {};
+    cx.pairs            = {};
+    cx.pairsTmp         = {};
+    cx.groupsBoundaries = {};
+
+    cx.allocationSize              = 0;
+    cx.maxEntriesPerBucket         = 0;
+    cx.maxCompressionLevelReserved = 0;
+
+    return b;
+}
+
+//-----------------------------------------------------------
+void ReleaseBucketBuffersToPool( GreenReaperContext& cx )
+{
+    if( cx.allocationSize == 0 )
+        return;
+
+    BucketBuffers b = DetachBucketBuffers( cx );
+
+    std::lock_guard<std::mutex> lock( _idleLock );
+    _idlePool.push_back( b );
+}
+
+//-----------------------------------------------------------
+bool TakeBucketBuffersFromPool( GreenReaperContext& cx, const uint32 compressionLevel )
+{
+    ASSERT( cx.allocationSize == 0 );
+
+    std::lock_guard<std::mutex> lock( _idleLock );
+
+    // Take the smallest set that fits
+    auto best = _idlePool.end();
+    for( auto it = _idlePool.begin(); it != _idlePool.end(); it++ )
+    {
+        if( it->compressionLevel >= compressionLevel && ( best == _idlePool.end() || it->allocationSize < best->allocationSize ) )
+            best = it;
+    }
+
+    if( best == _idlePool.end() )
+        return false;
+
+    const BucketBuffers& b = *best;
+
+    cx.yBufferF1        = b.yBufferF1;
+    cx.yBuffer          = b.yBuffer;
+    cx.yBufferTmp       = b.yBufferTmp;
+    cx.xBuffer          = b.xBuffer;
+    cx.xBufferTmp       = b.xBufferTmp;
+    cx.sortKey          = b.sortKey;
+    cx.metaBuffer       = b.metaBuffer;
+    cx.metaBufferTmp    = b.metaBufferTmp;
+    cx.pairs            = b.pairs;
+    cx.pairsTmp         = b.pairsTmp;
+    cx.groupsBoundaries = b.groupsBoundaries;
+
+    for( uint32 i = 0; i < 7; i++ )
+    {
+        cx.tables[i]           = {};
+        cx.tables[i]._pairs    = b.tablePairs[i];
+        cx.tables[i]._capacity = b.tableCapacity[i];
+    }
+
+    cx.allocationSize              = b.allocationSize;
+    cx.maxEntriesPerBucket         = b.entriesPerBucket;
+    cx.maxCompressionLevelReserved = b.compressionLevel;
+
+    _idlePool.erase( best );
+    return true;
+}
+
+//-----------------------------------------------------------
+void FreeBucketBufferSet( BucketBuffers& b )
+{
+    bbvirtfreebounded_span( b.yBufferF1 );
+    bbvirtfreebounded_span( b.yBuffer );
+    bbvirtfreebounded_span( b.yBufferTmp );
+    bbvirtfreebounded_span( b.xBuffer );
+    bbvirtfreebounded_span( b.xBufferTmp );
+    bbvirtfreebounded_span( b.sortKey );
+    bbvirtfreebounded_span( b.metaBuffer );
+    bbvirtfreebounded_span( b.metaBufferTmp );
+    bbvirtfreebounded_span( b.pairs );
+    bbvirtfreebounded_span( b.pairsTmp );
+    bbvirtfreebounded_span( b.groupsBoundaries );
+
+    for( uint32 i = 0; i < 7; i++ )
+        bbvirtfreebounded( b.tablePairs[i] );
+}
+
+//-----------------------------------------------------------
+void IdleThreadMain()
+{
+    std::unique_lock<std::mutex> lock( _idleLock );
+
+    while( !_idleExit )
+    {
+        _idleSignal.wait_for( lock, std::chrono::milliseconds( IDLE_CHECK_INTERVAL_MS ) );
+        if( _idleExit )
+            break;
+
+        const auto now = std::chrono::steady_clock::now();
+
+        for( GreenReaperContext* cx : _idleContexts )
+        {
+            // Skip contexts serving a request
+            std::unique_lock<std::mutex> bufferLock( cx->bufferLock, std::try_to_lock );
+            if( !bufferLock.owns_lock() || cx->allocationSize == 0 )
+                continue;
+
+            if( now - cx->lastUse < std::chrono::milliseconds( cx->config.idleShrinkMS ) )
+                continue;
+
+            _idlePool.push_back( DetachBucketBuffers( *cx ) );
+        }
+
+        // Free pooled buffers nobody has claimed
+        for( auto it = _idlePool.begin(); it != _idlePool.end(); )
+        {
+            if( now - it->releaseTime >= std::chrono::milliseconds( it->idleShrinkMS ) )
+            {
+                FreeBucketBufferSet( *it );
+                it = _idlePool.erase( it );
+            }
+            else
+                it++;
+        }
+    }
+}
+
+
 //-----------------------------------------------------------
 inline void FlipBuffers( GreenReaperContext& cx, const TableId rTable )
 {
@@ -1057,9 +2478,7 @@ inline void SortTableAndFlipBuffers( GreenReaperContext& cx, const uint32 groupC
         return;
     }
 
-    #if SHOW_TIMINGS
-        const auto timer = TimerBegin();
-    #endif
+    const auto timer = TimerBegin();
     using TMeta = typename K32MetaType<rTable>::Out;
 
     ProofTable& table = cx.tables[(int)rTable];
@@ -1102,14 +2521,23 @@ inline void SortTableAndFlipBuffers( GreenReaperContext& cx, const uint32 groupC
         tablePairsSorted   = tablePairsSorted  .Slice( groupLength );
 
 
+        // Small metadata is carried through the sort along with the pairs, instead of gathering both with a sort key
+        if constexpr ( sizeof( TMeta ) <= 16 )
+        {
+            RadixSort256::SortWithPayloadsHybrid<BB_MAX_JOBS, uint64, TMeta, Pair, 5>( *cx.pool, groupThreads, yUnsorted.Ptr(), ySorted.Ptr(),
+                                                                                       metaUnsorted.Ptr(), metaSorted.Ptr(),
+                                                                                       pairsUnsorted.Ptr(), pairsSorted.Ptr(), groupLength );
+            continue;
+        }
+
         auto kUnsorted = keyUnsorted.SliceSize( groupLength );
         auto kSorted   = keySorted  .SliceSize( groupLength );
 
         // #TODO: Perhaps do all groups and this in a single job (more code repetition, though)?
         SortKeyJob::GenerateKey( *cx.pool, groupThreads, keyUnsorted );
 
-        RadixSort256::SortYWithKey<BB_MAX_JOBS>( *cx.pool, groupThreads, yUnsorted.Ptr(), ySorted.Ptr(),
-                                                 kUnsorted.Ptr(), kSorted.Ptr(), groupLength );
+        RadixSort256::SortWithKeyHybrid<BB_MAX_JOBS, uint64, uint32, 5>( *cx.pool, groupThreads, yUnsorted.Ptr(), ySorted.Ptr(),
+                                                                         kUnsorted.Ptr(), kSorted.Ptr(), groupLength );
 
         SortKeyJob::SortOnKey( *cx.pool, groupThreads, kSorted, metaUnsorted , metaSorted );
         SortKeyJob::SortOnKey( *cx.pool, groupThreads, kSorted, pairsUnsorted, pairsSorted );
@@ -1118,20 +2546,130 @@ inline void SortTableAndFlipBuffers( GreenReaperContext& cx, const uint32 groupC
     cx.proofContext.leftLength  = (uint32)tableLength;
     cx.proofContext.rightLength = (uint32)cx.tables[(int)rTable+1]._capacity;
 
+    RecordTiming( cx, &GRProofTimings::sortElapsedNS, timer );
+
     #if SHOW_TIMINGS
         Log::Line( "Sort elapsed: %.3lf s", TimerEnd( timer ) );
     #endif
 }
 
+///
+/// Table 1 cache
+///
+//-----------------------------------------------------------
+inline bool Table1CacheEntryMatches( const Table1CacheEntry& e, const byte* plotId, const uint32 compressionLevel, const uint64 x1, const uint64 x2 )
+{
+    return e.lastUse != 0 && e.x1 == (uint32)x1 && e.x2 == (uint32)x2 && e.compressionLevel == compressionLevel &&
+           memcmp( e.plotId, plotId, BB_PLOT_ID_LEN ) == 0;
+}
+
+//-----------------------------------------------------------
+const Table1CacheEntry* Table1CacheFind( GreenReaperContext& cx, const byte* plotId, const uint32 compressionLevel, const uint64 x1, const uint64 x2 )
+{
+    Table1Cache& cache = cx.t1Cache;
+
+    for( uint32 i = 0; i < cache.capacity; i++ )
+    {
+        Table1CacheEntry& e = cache.entries[i];
+
+        if( Table1CacheEntryMatches( e, plotId, compressionLevel, x1, x2 ) )
+        {
+            e.lastUse = ++cache.useCount;
+            return &e;
+        }
+    }
+
+    return nullptr;
+}
+
+//-----------------------------------------------------------
+void Table1CacheInsert( GreenReaperContext& cx, const byte* plotId, const uint32 compressionLevel, const uint64 x1, const uint64 x2,
+                        const Span<Pair> pairs, const Span<uint64> y, const Span<K32Meta2> meta )
+{
+    Table1Cache& cache = cx.t1Cache;
+    ASSERT( cache.capacity > 0 );
+    ASSERT( pairs.Length() == y.Length() && pairs.Length() == meta.Length() );
+
+    // Replace the least recently used entry
+    Table1CacheEntry* entry = &cache.entries[0];
+
+    for( uint32 i = 0; i < cache.capacity; i++ )
+    {
+        Table1CacheEntry& e = cache.entries[i];
+
+        if( Table1CacheEntryMatches( e, plotId, compressionLevel, x1, x2 ) )
+        {
+            entry = &e;
+            break;
+        }
+
+        if( e.lastUse < entry->lastUse )
+            entry = &e;
+    }
+
+    const uint32 length = (uint32)pairs.Length();
+
+    if( entry->capacity < length )
+    {
+        const size_t entrySize = sizeof( Pair ) + sizeof( uint64 ) + sizeof( K32Meta2 );
+
+        free( entry->pairs );
+        free( entry->y     );
+        free( entry->meta  );
+        cache.size -= (size_t)entry->capacity * entrySize;
+
+        entry->pairs    = (Pair*)    malloc( sizeof( Pair )     * length );
+        entry->y        = (uint64*)  malloc( sizeof( uint64 )   * length );
+        entry->meta     = (K32Meta2*)malloc( sizeof( K32Meta2 ) * length );
+        entry->capacity = length;
+        entry->lastUse  = 0;
+
+        // Out of memory, simply don't cache
+        if( !entry->pairs || !entry->y || !entry->meta )
+        {
+            free( entry->pairs );
+            free( entry->y     );
+            free( entry->meta  );
+            *entry = {};
+            return;
+        }
+
+        cache.size += (size_t)length * entrySize;
+    }
+
+    memcpy( entry->plotId, plotId, BB_PLOT_ID_LEN );
+    entry->x1               = (uint32)x1;
+    entry->x2               = (uint32)x2;
+    entry->compressionLevel = compressionLevel;
+    entry->length           = length;
+    entry->lastUse          = ++cache.useCount;
+
+    bbmemcpy_t( entry->pairs, pairs.Ptr(), length );
+    bbmemcpy_t( entry->y    , y    .Ptr(), length );
+    bbmemcpy_t( entry->meta , meta .Ptr(), length );
+}
+
+//-----------------------------------------------------------
+void Table1CacheDestroy( Table1Cache& cache )
+{
+    for( uint32 i = 0; i < cache.capacity; i++ )
+    {
+        free( cache.entries[i].pairs );
+        free( cache.entries[i].y     );
+        free( cache.entries[i].meta  );
+    }
+
+    delete[] cache.entries;
+    cache = {};
+}
+
 ///
 /// F1
 ///
 //-----------------------------------------------------------
 void GenerateF1( GreenReaperContext& cx, const byte plotId[32], const uint64 bucketEntryCount, const uint32 x0, const uint32 x1 )
 {
-    #if SHOW_TIMINGS
-        const auto timer = TimerBegin();
-    #endif
+    const auto timer = TimerBegin();
 
     const uint32 k = 32;
     const uint32 f1BlocksPerBucket = (uint32)(bucketEntryCount * sizeof( uint32 ) / kF1BlockSize);
@@ -1214,10 +2752,16 @@ void GenerateF1( GreenReaperContext& cx, const byte plotId[32], const uint64 buc
     // Log::Line( "Completed F1 in %.2lf seconds.", TimerEnd( timer ) );
 
 
+    RecordTiming( cx, &GRProofTimings::f1ElapsedNS, timer );
+
     // Sort f1 on y
+    const auto sortTimer = TimerBegin();
+
     const uint64 mergedEntryCount = bucketEntryCount * 2;
-    RadixSort256::SortYWithKey<BB_MAX_JOBS>( *cx.pool, yBuffer, cx.yBuffer.Ptr(), xBuffer, cx.xBuffer.Ptr(), mergedEntryCount );
-    
+    RadixSort256::SortWithKeyHybrid<BB_MAX_JOBS, uint64, uint32, 5>( *cx.pool, 0, yBuffer, cx.yBuffer.Ptr(), xBuffer, cx.xBuffer.Ptr(), mergedEntryCount );
+
+    RecordTiming( cx, &GRProofTimings::sortElapsedNS, sortTimer );
+
     #if SHOW_TIMINGS
         Log::Line( "F1 elapsed: %.3lf s", TimerEnd( timer ) );
     #endif
@@ -1314,12 +2858,12 @@ inline uint64 ForwardPropTableGroup( GreenReaperContext& cx, const uint32 lGroup
     else
     {
         // Match
-        #if SHOW_TIMINGS
-            const auto timer = TimerBegin();
-        #endif
+        const auto timer = TimerBegin();
         
         pairs = Match( cx, yLeft, outPairs, lTable._groups[lGroup].offset );
         
+        RecordTiming( cx, &GRProofTimings::matchElapsedNS, timer );
+
         #if SHOW_TIMINGS
             Log::Line( " Match elapsed: %.3lf s", TimerEnd( timer ) );
         #endif
@@ -1336,12 +2880,12 @@ inline uint64 ForwardPropTableGroup( GreenReaperContext& cx, const uint32 lGroup
             yLeft    = MakeSpan( cx.proofContext.yLeft, cx.proofContext.leftLength );
             metaLeft = MakeSpan( (TMetaIn*)cx.proofContext.metaLeft, cx.proofContext.leftLength );
 
-            #if SHOW_TIMINGS
-                const auto timer = TimerBegin();
-            #endif
+            const auto timer = TimerBegin();
 
             GenerateFxForPairs<rTableId, TMetaIn, TMetaOut>( cx, pairs, yLeft, metaLeft, yRight, metaRight );
 
+            RecordTiming( cx, &GRProofTimings::fxElapsedNS, timer );
+
             #if SHOW_TIMINGS
                 Log::Line( " Fx elapsed: %.3lf s", TimerEnd( timer ) );
             #endif
@@ -1362,8 +2906,6 @@ ForwardPropResult ForwardPropTable( GreenReaperContext& cx, uint32 tableGroupCou
     #endif
     using TMetaOut = typename K32MetaType<rTable>::Out;
 
-    if( cx.cudaThresher ) cx.cudaThresher->ClearTimings();
-
     auto& table = cx.tables[(int)rTable];
     // ASSERT( table._length == 0 );
 
@@ -1430,56 +2972,73 @@ ForwardPropResult ForwardPropTable( GreenReaperContext& cx, uint32 tableGroupCou
 }
 
 //-----------------------------------------------------------
-bool ForwardPropCudaTables( GreenReaperContext& cx, bool returnSuccessOnSingleMatch )
+// Returns Continue if the tables must be propagated group by group instead
+ForwardPropResult ForwardPropCudaTables( GreenReaperContext& cx )
 {
     ASSERT( cx.cudaThresher );
-    return false;
-
-    // for( TableId rTableId = TableId::Table3; rTableId < TableId::Table7; rTableId++ )
-    // {
-    //     const uint32 groupCount  = 32 >> ((int)rTableId-1);
-    //     const bool   isLastTable = rTableId == TableId::Table6;
-
-    //     ProofTable& lTable = cx.tables[(int)rTableId-1];
-    //     ProofTable& rTable = cx.tables[(int)rTableId];
 
-    //     Span<Pair> outPairs = cx.pairs.SliceSize( rTable._capacity );
+    const ProofTable& table2     = cx.tables[(int)TableId::Table2];
+    const uint32      groupCount = 32 >> (int)TableId::Table2;
 
-    //     uint32 tableMatchCount = 0;
+    uint32 groupOffsets[16];
+    uint32 groupCounts [16];
 
-    //     for( uint32 lGroup = 0; lGroup < groupCount; lGroup++ )
-    //     {
-    //         const uint32 rGroup = lGroup / 2;
+    for( uint32 i = 0; i < groupCount; i++ )
+    {
+        groupOffsets[i] = table2._groups[i].offset;
+        groupCounts [i] = table2._groups[i].count;
+    }
 
-    //         if( (lGroup & 1) == 0)
-    //             rTable.BeginGroup( rGroup );
+    #if SHOW_TIMINGS
+        const auto timer = TimerBegin();
+    #endif
 
-    //         uint32 matchCount = 0;
-    //         const bool r = cx.cudaThresher->DecompressNextTableGroup(
-    //             cx,
-    //             outPairs,
-    //             matchCount,
-    //             lTable._groups[lGroup].offset
-    //         );
+    const auto r = cx.cudaThresher->ForwardPropTables(
+        cx,
+        groupCount,
+        groupOffsets,
+        groupCounts,
+        cx.pairs.Ptr(),                 // Table 2 pairs are left unsorted when using the GPU
+        cx.proofContext.yLeft,
+        cx.proofContext.metaLeft,
+        true,
+        cx.proofContext.proof );
 
-    //         if( !r || matchCount < 1 )
-    //             return false;
+    #if SHOW_TIMINGS
+        Log::Line( "CUDA FP tables: %.3lf s", TimerEnd( timer ) );
+    #endif
 
+    switch( r.kind )
+    {
+        case ThresherResultKind::Success:
+            return ForwardPropResult::Success;
 
-    //         rTable.AddGroupPairs( rGroup, matchCount );
-    //         tableMatchCount += matchCount;
+        case ThresherResultKind::Unsupported:
+            return ForwardPropResult::Continue;
 
-    //         outPairs = cx.pairs.SliceSize( rTable._capacity );
-    //     }
+        case ThresherResultKind::Error:
+            // Perhaps find a way to log this or pass the error back to the caller.
+            delete cx.cudaThresher;
+            cx.cudaThresher         = nullptr;
+            cx.cudaRecreateThresher = true;
+            return ForwardPropResult::Failed;
 
-    //     const bool hasProof = (returnSuccessOnSingleMatch && tableMatchCount == 1) || tableMatchCount == 2;
-    //     return hasProof;
-    // }
+        default:
+            return ForwardPropResult::Failed;
+    }
 }
 
 //-----------------------------------------------------------
 bool ForwardPropTables( GreenReaperContext& cx )
 {
+    // Keep all tables on the device, if the thresher supports it
+    if( cx.cudaThresher != nullptr )
+    {
+        const ForwardPropResult r = ForwardPropCudaTables( cx );
+        if( r != ForwardPropResult::Continue )
+            return r == ForwardPropResult::Success;
+    }
+
     for( TableId rTable = TableId::Table3; rTable < TableId::Table7; rTable++ )
     {
         ForwardPropResult r;
@@ -1519,6 +3078,52 @@ bool ForwardPropTables( GreenReaperContext& cx )
 }
 
 
+//-----------------------------------------------------------
+// Walks a pair down to table 3 and keeps the table 3 pair if it belongs to the first group.
+// Returns false once a second, different, first-group pair is found.
+static bool FindQualityT3Pair( const GreenReaperContext& cx, const TableId table, const Pair pair, Pair& t3Pair, bool& found )
+{
+    if( table == TableId::Table3 )
+    {
+        if( pair.left >= cx.tables[1]._groups[0].count )
+            return true;
+
+        if( found )
+            return t3Pair.left == pair.left && t3Pair.right == pair.right;
+
+        t3Pair = pair;
+        found  = true;
+        return true;
+    }
+
+    const Pair* lPairs = cx.tables[(int)table-1]._pairs;
+
+    return FindQualityT3Pair( cx, table-1, lPairs[pair.left ], t3Pair, found ) &&
+           FindQualityT3Pair( cx, table-1, lPairs[pair.right], t3Pair, found );
+}
+
+//-----------------------------------------------------------
+// Returns Success when exactly one table 3 pair of the first group still leads to the pairs of rTable,
+// Failed when none does, and Continue while the next table is needed to tell them apart.
+ForwardPropResult ResolveQualityPair( GreenReaperContext& cx, const TableId rTable, Pair& outT3Pair )
+{
+    const ProofTable& table = cx.tables[(int)rTable];
+
+    // The GPU leaves the last table's pairs in the pairs buffer
+    const Pair* pairs = cx.cudaThresher ? cx.pairs.Ptr() : table._pairs;
+
+    bool found = false;
+
+    for( uint64 i = 0; i < table._length; i++ )
+    {
+        if( !FindQualityT3Pair( cx, rTable, pairs[i], outT3Pair, found ) )
+            return ForwardPropResult::Continue;
+    }
+
+    return found ? ForwardPropResult::Success : ForwardPropResult::Failed;
+}
+
+
 ///
 /// Matching
 ///
@@ -1631,9 +3236,6 @@ uint32 MatchJob(
 
     uint32 pairCount = 0;
 
-    uint8  rMapCounts [kBC];
-    uint16 rMapIndices[kBC];
-
     uint64 groupLStart = groupBoundaries[0];
     uint64 groupL      = yEntries[groupLStart] / kBC;
 
@@ -1645,64 +3247,18 @@ uint32 MatchJob(
         if( groupR - groupL == 1 )
         {
             // Groups are adjacent, calculate matches
-            const uint16 parity           = groupL & 1;
-            const uint64 groupREnd        = groupBoundaries[i+1];
-
-            const uint64 groupLRangeStart = groupL * kBC;
-            const uint64 groupRRangeStart = groupR * kBC;
-
+            const uint64 groupREnd = groupBoundaries[i+1];
             ASSERT( groupREnd - groupRStart <= 350 );
-            ASSERT( groupLRangeStart == groupRRangeStart - kBC );
-
-            // Prepare a map of range kBC to store which indices from groupR are used
-            // For now just iterate our bGroup to find the pairs
-
-            // #NOTE: memset(0) works faster on average than keeping a separate a clearing buffer
-            memset( rMapCounts, 0, sizeof( rMapCounts ) );
 
-            for( uint64 iR = groupRStart; iR < groupREnd; iR++ )
-            {
-                uint64 localRY = yEntries[iR] - groupRRangeStart;
-                ASSERT( yEntries[iR] / kBC == groupR );
-
-                if( rMapCounts[localRY] == 0 )
-                    rMapIndices[localRY] = (uint16)( iR - groupRStart );
-
-                rMapCounts[localRY] ++;
-            }
+            pairCount += MatchBCGroupPair( yEntries.Ptr() + groupLStart, (uint32)( groupRStart - groupLStart ),
+                                           yEntries.Ptr() + groupRStart, (uint32)( groupREnd - groupRStart ),
+                                           groupL, (uint32)groupLStart + pairOffset, (uint32)groupRStart + pairOffset,
+                                           pairs.Ptr() + pairCount, maxPairs - pairCount );
 
-            // For each group L entry
-            for( uint64 iL = groupLStart; iL < groupRStart; iL++ )
+            if( pairCount == maxPairs )
             {
-                const uint64 yL     = yEntries[iL];
-                const uint64 localL = yL - groupLRangeStart;
-
-                for( int iK = 0; iK < kExtraBitsPow; iK++ )
-                {
-                    const uint16 targetR = L_targets[parity][localL][iK];
-
-                    // for( uint j = 0; j < rMapCounts[targetR]; j++ )
-                    if( rMapCounts[targetR] > 0 )
-                    {
-                        for( uint j = 0; j < rMapCounts[targetR]; j++ )
-                        {
-                            const uint64 iR = groupRStart + rMapIndices[targetR] + j;
-                            ASSERT( iL < iR );
-
-                            // Add a new pair
-                            if( pairCount >= maxPairs )
-                            {
-                                // #TODO: Set error
-                                ASSERT( 0 );
-                                return pairCount;
-                            }
-
-                            Pair& pair = pairs[pairCount++];
-                            pair.left  = (uint32)iL + pairOffset;
-                            pair.right = (uint32)iR + pairOffset;
-                        }
-                    }
-                }
+                // #TODO: Set error
+                return pairCount;
             }
         }
         // Else: Not an adjacent group, skip to next one.
@@ -1734,10 +3290,7 @@ void GenerateFxForPairs( GreenReaperContext& cx, const Span<Pair> pairs, const S
         return;
     }
 
-    AnonMTJob::Run( *cx.pool, cx.config.threadCount, [&]( AnonMTJob* self ){
-        
-        uint64 count, offset, _;
-        GetThreadOffsets( self, (uint64)pairs.Length(), count, offset, _ );
+    AnonMTJob::RunRanges( *cx.pool, threadCount, (uint64)pairs.Length(), [&]( AnonMTJob* self, uint64 offset, uint64 count ){
         
         GenerateFx<rTable, TMetaIn, TMetaOut>( pairs.Slice( offset, count ), yIn, metaIn, yOut.Slice( offset, count ), metaOut.Slice( offset, count ) );
     });
@@ -1760,107 +3313,122 @@ inline void GenerateFx( const Span<Pair> pairs, const Span<uint64> yIn, const Sp
     const size_t metaSizeLR  = metaSize * 2;
     const size_t bufferSize  = CDiv( ySize + metaSizeLR, 8 );
 
-    // Hashing
-    uint64 input [5]; // y + L + R
-    uint64 output[4]; // blake3 hashed output
+    // Hashing is done in batches so that blake3 can process multiple pairs in parallel SIMD lanes
+    static constexpr uint64 BatchSize = 64;
 
-    blake3_hasher hasher;
-    static_assert( bufferSize <= sizeof( input ), "Invalid fx input buffer size." );
+    uint64 inputs [BatchSize][5]; // y + L + R
+    uint64 outputs[BatchSize][4]; // blake3 hashed output
 
-    for( uint64 i = 0; i < pairs.Length(); i++ )
-    {
-        const Pair   pair = pairs[i];
-        const uint64 y    = yIn[pair.left];
+    static_assert( bufferSize <= sizeof( inputs[0] ), "Invalid fx input buffer size." );
 
-        const TMetaIn metaL = metaIn[pair.left ];
-        const TMetaIn metaR = metaIn[pair.right];
+    const uint64 pairCount = (uint64)pairs.Length();
 
-        TMetaOut& mOut = outMeta[i];
+    for( uint64 batchStart = 0; batchStart < pairCount; batchStart += BatchSize )
+    {
+        const uint64 batchCount = std::min( BatchSize, pairCount - batchStart );
 
-        if constexpr( MetaInMulti == 1 )
+        for( uint64 j = 0; j < batchCount; j++ )
         {
-            const uint64 l = metaL;
-            const uint64 r = metaR;
+            const uint64 i     = batchStart + j;
+            const Pair   pair  = pairs[i];
+            const uint64 y     = yIn[pair.left];
+            uint64*      input = inputs[j];
 
-            input[0] = Swap64( y << 26 | l >> 6  );
-            input[1] = Swap64( l << 58 | r << 26 );
+            const TMetaIn metaL = metaIn[pair.left ];
+            const TMetaIn metaR = metaIn[pair.right];
 
-            // Metadata is just L + R of 8 bytes
-            if constexpr( MetaOutMulti == 2 )
-                mOut = l << 32 | r;
-        }
-        else if constexpr( MetaInMulti == 2 )
-        {
-            const uint64 l = metaL;
-            const uint64 r = metaR;
+            TMetaOut& mOut = outMeta[i];
 
-            input[0] = Swap64( y << 26 | l >> 38 );
-            input[1] = Swap64( l << 26 | r >> 38 );
-            input[2] = Swap64( r << 26 );
+            if constexpr( MetaInMulti == 1 )
+            {
+                const uint64 l = metaL;
+                const uint64 r = metaR;
+
+                input[0] = Swap64( y << 26 | l >> 6  );
+                input[1] = Swap64( l << 58 | r << 26 );
 
-            // Metadata is just L + R again of 16 bytes
-            if constexpr( MetaOutMulti == 4 )
+                // Metadata is just L + R of 8 bytes
+                if constexpr( MetaOutMulti == 2 )
+                    mOut = l << 32 | r;
+            }
+            else if constexpr( MetaInMulti == 2 )
             {
-                mOut.m0 = l;
-                mOut.m1 = r;
+                const uint64 l = metaL;
+                const uint64 r = metaR;
+
+                input[0] = Swap64( y << 26 | l >> 38 );
+                input[1] = Swap64( l << 26 | r >> 38 );
+                input[2] = Swap64( r << 26 );
+
+                // Metadata is just L + R again of 16 bytes
+                if constexpr( MetaOutMulti == 4 )
+                {
+                    mOut.m0 = l;
+                    mOut.m1 = r;
+                }
             }
-        }
-        else if constexpr( MetaInMulti == 3 )
-        {
-            const uint64 l0 = metaL.m0;
-            const uint64 l1 = metaL.m1 & 0xFFFFFFFF;
-            const uint64 r0 = metaR.m0;
-            const uint64 r1 = metaR.m1 & 0xFFFFFFFF;
+            else if constexpr( MetaInMulti == 3 )
+            {
+                const uint64 l0 = metaL.m0;
+                const uint64 l1 = metaL.m1 & 0xFFFFFFFF;
+                const uint64 r0 = metaR.m0;
+                const uint64 r1 = metaR.m1 & 0xFFFFFFFF;
         
-            input[0] = Swap64( y  << 26 | l0 >> 38 );
-            input[1] = Swap64( l0 << 26 | l1 >> 6  );
-            input[2] = Swap64( l1 << 58 | r0 >> 6  );
-            input[3] = Swap64( r0 << 58 | r1 << 26 );
-        }
-        else if constexpr( MetaInMulti == 4 )
-        {
-            const auto l = metaL;
-            const auto r = metaR;
-
-            input[0] = Swap64( y    << 26 | l.m0 >> 38 );
-            input[1] = Swap64( l.m0 << 26 | l.m1 >> 38 );
-            input[2] = Swap64( l.m1 << 26 | r.m0 >> 38 );
-            input[3] = Swap64( r.m0 << 26 | r.m1 >> 38 );
-            input[4] = Swap64( r.m1 << 26 );
+                input[0] = Swap64( y  << 26 | l0 >> 38 );
+                input[1] = Swap64( l0 << 26 | l1 >> 6  );
+                input[2] = Swap64( l1 << 58 | r0 >> 6  );
+                input[3] = Swap64( r0 << 58 | r1 << 26 );
+            }
+            else if constexpr( MetaInMulti == 4 )
+            {
+                const auto l = metaL;
+                const auto r = metaR;
+
+                input[0] = Swap64( y    << 26 | l.m0 >> 38 );
+                input[1] = Swap64( l.m0 << 26 | l.m1 >> 38 );
+                input[2] = Swap64( l.m1 << 26 | r.m0 >> 38 );
+                input[3] = Swap64( r.m0 << 26 | r.m1 >> 38 );
+                input[4] = Swap64( r.m1 << 26 );
+            }
         }
 
-        // Hash the input
-        blake3_hasher_init( &hasher );
-        blake3_hasher_update( &hasher, input, bufferSize );
-        blake3_hasher_finalize( &hasher, (uint8_t*)output, sizeof( output ) );
-
-        const uint64 f = Swap64( *output ) >> yShift;
-        yOut[i] = f;
+        // Hash the whole batch
+        blake3_hash_short_many( inputs, sizeof( inputs[0] ), bufferSize, (size_t)batchCount, (uint8_t*)outputs );
 
-        if constexpr ( MetaOutMulti == 2 && MetaInMulti == 3 )
+        for( uint64 j = 0; j < batchCount; j++ )
         {
-            const uint64 h0 = Swap64( output[0] );
-            const uint64 h1 = Swap64( output[1] );
+            const uint64  i      = batchStart + j;
+            const uint64* output = outputs[j];
+            TMetaOut&     mOut   = outMeta[i];
 
-            mOut = h0 << ySize | h1 >> 26;
-        }
-        else if constexpr ( MetaOutMulti == 3 )
-        {
-            const uint64 h0 = Swap64( output[0] );
-            const uint64 h1 = Swap64( output[1] );
-            const uint64 h2 = Swap64( output[2] );
+            const uint64 f = Swap64( *output ) >> yShift;
+            yOut[i] = f;
 
-            mOut.m0 = h0 << ySize | h1 >> 26;
-            mOut.m1 = ((h1 << 6) & 0xFFFFFFC0) | h2 >> 58;
-        }
-        else if constexpr ( MetaOutMulti == 4 && MetaInMulti != 2 ) // In = 2 is calculated above with L + R
-        {
-            const uint64 h0 = Swap64( output[0] );
-            const uint64 h1 = Swap64( output[1] );
-            const uint64 h2 = Swap64( output[2] );
+            if constexpr ( MetaOutMulti == 2 && MetaInMulti == 3 )
+            {
+                const uint64 h0 = Swap64( output[0] );
+                const uint64 h1 = Swap64( output[1] );
+
+                mOut = h0 << ySize | h1 >> 26;
+            }
+            else if constexpr ( MetaOutMulti == 3 )
+            {
+                const uint64 h0 = Swap64( output[0] );
+                const uint64 h1 = Swap64( output[1] );
+                const uint64 h2 = Swap64( output[2] );
 
-            mOut.m0 = h0 << ySize | h1 >> 26;
-            mOut.m1 = h1 << 38    | h2 >> 26;
+                mOut.m0 = h0 << ySize | h1 >> 26;
+                mOut.m1 = ((h1 << 6) & 0xFFFFFFC0) | h2 >> 58;
+            }
+            else if constexpr ( MetaOutMulti == 4 && MetaInMulti != 2 ) // In = 2 is calculated above with L + R
+            {
+                const uint64 h0 = Swap64( output[0] );
+                const uint64 h1 = Swap64( output[1] );
+                const uint64 h2 = Swap64( output[2] );
+
+                mOut.m0 = h0 << ySize | h1 >> 26;
+                mOut.m1 = h1 << 38    | h2 >> 26;
+            }
         }
     }
 }
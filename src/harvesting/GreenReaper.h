@@ -21,7 +21,9 @@
 extern "C" {
 #endif
 
-#define GR_API_VERSION 1
+// Version 2 added the members after GetCompressionInfo to the API struct, and the options after
+// gpuDeviceIndex to GreenReaperConfig. Version 1 APIs and configs are still accepted.
+#define GR_API_VERSION 2
 
 #define GR_POST_PROOF_X_COUNT 64
 #define GR_POST_PROOF_CMP_X_COUNT (GR_POST_PROOF_X_COUNT/2)
@@ -31,6 +33,10 @@ typedef int32_t GRBool;
 #define GR_TRUE  1
 
 typedef struct GreenReaperContext GreenReaperContext;
+typedef struct GRAsyncRequest     GRAsyncRequest;
+typedef struct GRPlotIndex        GRPlotIndex;
+typedef struct GRPlot             GRPlot;
+typedef struct GRSharedPool       GRSharedPool;
 
 /// How to select GPU for harvesting.
 typedef enum GRGpuRequestKind
@@ -38,6 +44,8 @@ typedef enum GRGpuRequestKind
     GRGpuRequestKind_None = 0,        // Disable GPU harvesting.
     GRGpuRequestKind_FirstAvailable,  // Select the device specified, or the first available, if any. If no device is available it defaults to CPU harvesting.
     GRGpuRequestKind_ExactDevice,     // Select the specified device only. If none is available, it is an error.
+    GRGpuRequestKind_AllDevices,      // Use all available devices, routing each request to the least-loaded one.
+                                      // If no device is available it defaults to CPU harvesting.
 } GRGpuRequestKind;
 
 typedef uint32_t GRGpuRequestKind_t;
@@ -50,8 +58,28 @@ typedef struct GreenReaperConfig
     GRBool             disableCpuAffinity;
     GRGpuRequestKind_t gpuRequest;         // What kind of GPU to select for harvesting.
     uint32_t           gpuDeviceIndex;     // Which device index to use (0 by default)
-
-    uint32_t           _reserved[16];      // Reserved for future use
+    uint32_t           hybridQueueDepth;   // If > 0 and a GPU is used, a CPU decompressor is also created and takes
+                                           // requests whenever the GPU has at least this many requests in flight.
+    uint32_t           table1CacheSize;    // If > 0, the number of table 1 x-bucket results to keep in an LRU cache,
+                                           // so that a proof fetch following a qualities fetch on the same plot 
+                                           // does not have to regenerate F1 and its matches.
+    uint32_t           gpuSlotsPerDevice;  // If > 1, how many requests each GPU decompresses concurrently,
+                                           // each with its own streams and buffers. Helps fill large GPUs at low compression levels.
+    uint32_t           idleShrinkMS;       // If > 0, a context that has not served a request for this many milliseconds
+                                           // gives its host buffers to a process-wide pool, from which any context regrows them,
+                                           // sized for the compression level it is actually asked for.
+                                           // Pooled buffers are freed once they have been idle for as long.
+    GRSharedPool*      sharedPool;         // If set, CPU decompression runs on this pool (see grCreateSharedPool)
+                                           // instead of a pool of threadCount threads owned by the context.
+
+    GRBool             yieldPlotters;      // If true, requests mark themselves in shared memory while they run, so that
+                                           // plotters on the same machine started with --yield-to-harvest hold off meanwhile.
+    GRBool             asyncGpuInit;       // If true, the GPU decompressor and its buffers are created on a background thread,
+                                           // so that grCreateContext returns right away. Until it is ready, requests are
+                                           // decompressed on the CPU, and grHasGpuDecompressor returns false.
+                                           // Requests, and grPreallocateForCompressionLevel, switch to the GPU once it is.
+
+    uint32_t           _reserved[8];       // Reserved for future use
 } GreenReaperConfig;
 
 typedef enum GRResult
@@ -63,6 +91,8 @@ typedef enum GRResult
     GRResult_WrongVersion  = 4,
     GRResult_InvalidGPU    = 5,  // Invalid or missing GPU selection. (When GRGpuRequestKind_ExactDevice is used.)
     GRResult_InvalidArg    = 6,  // An invalid argument was passed.
+    GRResult_Pending       = 7,  // An asynchronous request has not yet completed.
+    GRResult_Expired       = 8,  // An asynchronous request did not start before its deadline.
 
 } GRResult;
 
@@ -75,14 +105,14 @@ typedef struct GRCompressionInfo
 } GRCompressionInfo;
 
 // Timings expressed in nanoseconds
-// typedef struct GRProofTimings
-// {
-//     uint64_t totalElapsedNS;
-//     uint64_t f1ElapsedNS;
-//     uint64_t sortElapsedNS;
-//     uint64_t matchElapsedNS;
-//     uint64_t fxElapsedNS;
-// };
+typedef struct GRProofTimings
+{
+    uint64_t totalElapsedNS;
+    uint64_t f1ElapsedNS;
+    uint64_t sortElapsedNS;
+    uint64_t matchElapsedNS;
+    uint64_t fxElapsedNS;
+} GRProofTimings;
 
 typedef struct GRCompressedProofRequest
 {
@@ -96,8 +126,12 @@ typedef struct GRCompressedProofRequest
 
     // Pass a pointer to a timings struct if 
     // you'd like detailed timings output
-    // GRProofTimings* outTimings;
-          
+          GRProofTimings* outTimings;
+
+    // Asynchronous requests only, see grSubmitProofForChallenge
+          uint32_t  priority;
+          uint32_t  deadlineMS;
+
 } GRCompressedProofRequest;
 
 typedef struct GRLinePoint
@@ -117,8 +151,46 @@ typedef struct GRCompressedQualitiesRequest
     // Output
     uint64_t        x1, x2;             // Output x qualities
 
+    // Optional, pass a pointer to a timings struct if
+    // you'd like detailed timings output
+    GRProofTimings* outTimings;
+
+    // Asynchronous requests only, see grSubmitProofForChallenge
+    uint32_t        priority;
+    uint32_t        deadlineMS;
+
 } GRCompressedQualitiesRequest;
 
+/// Metadata of an indexed plot. Pointers remain valid until the index is destroyed.
+typedef struct GRPlotInfo
+{
+    const char*     path;
+    const uint8_t*  plotId;             // 32 bytes
+    const uint8_t*  memo;
+    uint32_t        memoLength;
+    uint32_t        k;
+    uint32_t        version;            // 0 for v1 plots, 2 for v2 plots
+    uint32_t        flags;              // Plot flags, v2 only
+    uint32_t        compressionLevel;
+    uint64_t        fileSize;
+    uint64_t        tableAddresses[10]; // Byte offsets of tables 1-7, C1, C2 and C3
+    uint64_t        tableSizes[10];     // v2 only
+    const uint64_t* c2Entries;          // Decoded C2 table
+    uint64_t        c2Count;
+} GRPlotInfo;
+
+/// A quality found by grLookupQualities
+typedef struct GRQualityXs
+{
+    uint64_t p7Entry;   // Table 6 index of the match, from which its full proof is fetched
+    uint64_t x1, x2;    // Quality x's
+} GRQualityXs;
+
+/// Invoked from the context's request thread once an asynchronous request completes.
+/// The request is already complete by then, so the callback may call grWaitForRequest or grReleaseRequest on it.
+/// Other threads waiting on the request may resume before the callback runs.
+typedef void (*GRCompletionCallback)( GRAsyncRequest* request, GRResult result, void* userData );
+
 typedef struct GRApiV1
 {
     GRResult (*CreateContext)( GreenReaperContext** outContext, GreenReaperConfig* config, size_t configStructSize );
@@ -132,7 +204,41 @@ typedef struct GRApiV1
 
 } GRApiV1;
 
-typedef GRApiV1 GRApi;
+typedef struct GRApiV2
+{
+    GRResult (*CreateContext)( GreenReaperContext** outContext, GreenReaperConfig* config, size_t configStructSize );
+    void     (*DestroyContext)( GreenReaperContext* context );
+    GRResult (*PreallocateForCompressionLevel)( GreenReaperContext* context, uint32_t k, uint32_t maxCompressionLevel );
+    GRResult (*FetchProofForChallenge)( GreenReaperContext* context, GRCompressedProofRequest* req );
+    GRResult (*GetFetchQualitiesXPair)( GreenReaperContext* context, GRCompressedQualitiesRequest* req );
+    size_t   (*GetMemoryUsage)( GreenReaperContext* context );
+    GRBool   (*HasGpuDecompressor)( GreenReaperContext* context );
+    GRResult (*GetCompressionInfo)( GRCompressionInfo* outInfo, size_t infoStructSize, uint32_t k, uint32_t compressionLevel );
+    GRResult (*FetchQualitiesXPairBatch)( GreenReaperContext* context, GRCompressedQualitiesRequest* reqs, GRResult* outResults, uint32_t count );
+    GRResult (*SubmitProofForChallenge)( GreenReaperContext* context, GRCompressedProofRequest* req, GRCompletionCallback callback, void* userData, GRAsyncRequest** outRequest );
+    GRResult (*SubmitQualitiesXPair)( GreenReaperContext* context, GRCompressedQualitiesRequest* req, GRCompletionCallback callback, void* userData, GRAsyncRequest** outRequest );
+    GRResult (*PollRequest)( GRAsyncRequest* request );
+    GRResult (*WaitForRequest)( GRAsyncRequest* request );
+    void     (*ReleaseRequest)( GRAsyncRequest* request );
+    GRResult (*CreatePlotIndex)( GRPlotIndex** outIndex, const char* const* plotDirs, uint32_t dirCount, const char* indexFilePath, uint32_t threadCount );
+    void     (*DestroyPlotIndex)( GRPlotIndex* index );
+    uint64_t (*GetPlotIndexCount)( GRPlotIndex* index );
+    GRResult (*GetPlotInfo)( GRPlotIndex* index, uint64_t plotIdx, GRPlotInfo* outInfo, size_t infoStructSize );
+    GRResult (*OpenPlot)( GRPlot** outPlot, const char* path, GreenReaperContext* context );
+    void     (*ClosePlot)( GRPlot* plot );
+    GRResult (*LookupQualities)( GRPlot* plot, const uint8_t* challenge, GRQualityXs* outQualities, uint32_t maxCount, uint32_t* outCount );
+    GRResult (*ValidateFullProofs)( uint32_t k, const uint8_t plotId[32], uint32_t proofCount, const uint64_t* proofXs, uint64_t* outF7s, GRBool* outValid );
+    GRResult (*CreateSharedPool)( GRSharedPool** outPool, uint32_t threadCount, uint32_t cpuOffset, GRBool disableCpuAffinity );
+    void     (*DestroySharedPool)( GRSharedPool* pool );
+    void     (*BeginHarvest)( void );
+    void     (*EndHarvest)( void );
+    GRResult (*BeginTrace)( const char* path );
+    void     (*EndTrace)( void );
+    void     (*SetLookupBatchWindow)( uint32_t windowMicroseconds );
+
+} GRApiV2;
+
+typedef GRApiV2 GRApi;
 
 
 ///
@@ -140,7 +246,7 @@ typedef GRApiV1 GRApi;
 ///
 
 /// Populate an API object with all the current API's functions.
-/// A single API version is ever supported per binary.
+/// For apiVersion 1, api must point to a GRApiV1, which gets the version 1 functions only.
 GR_API GRResult grPopulateApi( GRApi* api, size_t apiStructSize, int apiVersion );
 
 /// Create a decompression context
@@ -149,6 +255,27 @@ GR_API GRResult grCreateContext( GreenReaperContext** outContext, GreenReaperCon
 /// Destroy decompression context
 GR_API void grDestroyContext( GreenReaperContext* context );
 
+/// Create a CPU thread pool that several contexts can share, through GreenReaperConfig::sharedPool,
+/// so that all of them together only ever use threadCount threads.
+/// The contexts take turns running their table steps on it, in the order they were submitted.
+GR_API GRResult grCreateSharedPool( GRSharedPool** outPool, uint32_t threadCount, uint32_t cpuOffset, GRBool disableCpuAffinity );
+
+/// Destroy a shared pool. All contexts using it must have been destroyed first.
+GR_API void grDestroySharedPool( GRSharedPool* pool );
+
+/// Mark the span of a whole signage point (ex. from the plot filter to the last proof fetch) as a harvest,
+/// so that plotters on the same machine started with --yield-to-harvest hold off until grEndHarvest.
+/// Calls may be nested and made from any thread. Marks older than 30 seconds are ignored by plotters.
+GR_API void grBeginHarvest( void );
+GR_API void grEndHarvest( void );
+
+/// Record every qualities and full proof request made on any context of the process to a compact binary trace file:
+/// the plot id, compression level and line points of the request, when it started, its latency and its result.
+/// Asynchronous requests are timed from their submission. The trace can be replayed with 'bladebit replay'.
+/// Starting a trace ends the current one, if any. Returns GRResult_Failed if the file could not be created.
+GR_API GRResult grBeginTrace( const char* path );
+GR_API void grEndTrace( void );
+
 /// Preallocate context's in-memory buffers to support a maximum compression level
 GR_API GRResult grPreallocateForCompressionLevel( GreenReaperContext* context, uint32_t k, uint32_t maxCompressionLevel );
 
@@ -158,9 +285,83 @@ GR_API GRResult grFetchProofForChallenge( GreenReaperContext* context, GRCompres
 /// Request plot qualities for a challenge
 GR_API GRResult grGetFetchQualitiesXPair( GreenReaperContext* context, GRCompressedQualitiesRequest* req );
 
+/// Request plot qualities for multiple requests at once, sharing the context's buffers across all of them.
+/// The result of each request is written to the corresponding entry in outResults.
+/// Returns GRResult_OK if the batch was processed, even if individual requests failed.
+GR_API GRResult grFetchQualitiesXPairBatch( GreenReaperContext* context, GRCompressedQualitiesRequest* reqs, GRResult* outResults, uint32_t count );
+
+/// Asynchronous requests.
+/// Requests are queued on the context's request thread. The next one to run is the queued request
+/// with the highest priority; at equal priority full proofs run before qualities, then in submission order.
+/// A request with a deadlineMS that has not started within that many milliseconds of its submission
+/// is completed with GRResult_Expired instead.
+/// The request struct must remain valid until the request completes.
+/// If outRequest is NULL, the request is released automatically after completion,
+/// otherwise the caller must release it with grReleaseRequest.
+/// Synchronous calls must not be made on a context while it has asynchronous requests in flight.
+GR_API GRResult grSubmitProofForChallenge( GreenReaperContext* context, GRCompressedProofRequest* req,
+                                           GRCompletionCallback callback, void* userData, GRAsyncRequest** outRequest );
+
+GR_API GRResult grSubmitQualitiesXPair( GreenReaperContext* context, GRCompressedQualitiesRequest* req,
+                                        GRCompletionCallback callback, void* userData, GRAsyncRequest** outRequest );
+
+/// Returns GRResult_Pending if the request has not yet completed, otherwise the result of the request.
+GR_API GRResult grPollRequest( GRAsyncRequest* request );
+
+/// Blocks until the request completes and returns its result.
+GR_API GRResult grWaitForRequest( GRAsyncRequest* request );
+
+/// Release a completed request. Releasing a pending request waits for it to complete first.
+GR_API void grReleaseRequest( GRAsyncRequest* request );
+
+/// Plot index.
+/// Scans the .plot files in plotDirs in parallel and keeps their header, table pointers and C2 entries in memory.
+/// If indexFilePath is not NULL, plots whose size and modification time match the ones stored in that file
+/// are not opened again, and the file is rewritten with the result of the scan.
+/// Plots that can't be read are left out. threadCount may be 0 to use all logical CPUs.
+GR_API GRResult grCreatePlotIndex( GRPlotIndex** outIndex, const char* const* plotDirs, uint32_t dirCount,
+                                   const char* indexFilePath, uint32_t threadCount );
+
+GR_API void grDestroyPlotIndex( GRPlotIndex* index );
+
+GR_API uint64_t grGetPlotIndexCount( GRPlotIndex* index );
+
+GR_API GRResult grGetPlotInfo( GRPlotIndex* index, uint64_t plotIdx, GRPlotInfo* outInfo, size_t infoStructSize );
+
+/// Plot lookups.
+/// Opens a plot to look up its qualities. context decompresses the x's of compressed plots and must outlive the plot.
+/// It may be NULL, in which case the plot creates its own context when needed.
+/// A plot must not be used by more than one thread at a time.
+GR_API GRResult grOpenPlot( GRPlot** outPlot, const char* path, GreenReaperContext* context );
+
+GR_API void grClosePlot( GRPlot* plot );
+
+/// Look up the quality x's of a 32-byte challenge: finds the challenge's f7 through the C1, C2 and C3 tables,
+/// then walks all the matches down to their x's together, reading the parks each table needs in one batch.
+/// Up to maxCount qualities are written to outQualities, outCount receives how many were written.
+/// Matches dropped by compression are skipped.
+/// The quality string is the hash of the challenge and the x's, as computed by the caller.
+GR_API GRResult grLookupQualities( GRPlot* plot, const uint8_t* challenge, GRQualityXs* outQualities,
+                                   uint32_t maxCount, uint32_t* outCount );
+
+/// Batch the reads of lookups made concurrently, from different threads, on plots that share a disk.
+/// A lookup's read waits up to windowMicroseconds for reads of the other plots on the same device,
+/// then all of them are ordered by offset, reads of adjacent pages are merged, and they are issued as one batch.
+/// This trades up to a window of latency for fewer and shorter seeks, which helps mostly on spinning disks.
+/// 0 disables batching, which is the default. Only applies to plots opened after this call.
+GR_API void grSetLookupBatchWindow( uint32_t windowMicroseconds );
+
+/// Validate proofCount full proofs of 64 x's each, laid out one after the other in proofXs.
+/// The x's may be in either plot or proof order. outValid receives whether each proof matches
+/// through all 7 tables and outF7s the f7 of every valid proof, which the caller checks against the challenge.
+/// The proofs are validated together, generating their f1 values and each table's hashes in batches.
+GR_API GRResult grValidateFullProofs( uint32_t k, const uint8_t plotId[32], uint32_t proofCount,
+                                      const uint64_t* proofXs, uint64_t* outF7s, GRBool* outValid );
+
 GR_API size_t grGetMemoryUsage( GreenReaperContext* context );
 
 /// Returns true if the context has a Gpu-based decompressor created.
+/// With GreenReaperConfig::asyncGpuInit, this is only the case once a request has started using it.
 GR_API GRBool grHasGpuDecompressor( GreenReaperContext* context );
 
 GR_API GRResult grGetCompressionInfo( GRCompressionInfo* outInfo, size_t infoStructSize, uint32_t k, uint32_t compressionLevel );
@@ -176,6 +377,8 @@ inline const char* grResultToString( const GRResult r )
         case GRResult_WrongVersion : return "GRResult_WrongVersion";
         case GRResult_InvalidGPU   : return "GRResult_InvalidGPU";
         case GRResult_InvalidArg   : return "GRResult_InvalidArg";
+        case GRResult_Pending      : return "GRResult_Pending";
+        case GRResult_Expired      : return "GRResult_Expired";
     }
 
     return "Unknown";
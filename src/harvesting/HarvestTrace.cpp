@@ -0,0 +1,187 @@
+#include "HarvestTrace.h"
+#include "io/FileStream.h"
+#include "plotdisk/jobs/IOJob.h"
+#include "util/Log.h"
+#include <mutex>
+
+// Records are buffered and written out once this many bytes are pending
+static constexpr size_t FLUSH_SIZE = 256 * 1024;
+
+static std::mutex                            _lock;
+static FileStream                            _file;
+static std::vector<byte>                     _buffer;
+static std::chrono::steady_clock::time_point _startTime;
+static bool                                  _writeFailed = false;
+
+//-----------------------------------------------------------
+static void FlushBuffer()
+{
+    if( _buffer.empty() )
+        return;
+
+    if( !_writeFailed && _file.Write( _buffer.data(), _buffer.size() ) != (ssize_t)_buffer.size() )
+    {
+        // Keep serving requests, but stop tracing them
+        Log::Error( "Warning: Failed to write to the harvester trace file with error %d. Tracing stopped.", _file.GetError() );
+        _writeFailed = true;
+    }
+
+    _buffer.clear();
+}
+
+//-----------------------------------------------------------
+static void AppendRecord( const std::chrono::steady_clock::time_point startTime, const byte* plotId, const HarvestTraceKind kind,
+                          const uint32 compressionLevel, const GRResult result, const void* payload, const size_t payloadSize )
+{
+    const auto endTime = TimerBegin();
+
+    HarvestTraceRecord record = {};
+    record.latencyNS        = (uint64)TicksToNanoSeconds( endTime - startTime );
+    record.kind             = (uint8)kind;
+    record.compressionLevel = (uint8)compressionLevel;
+    record.result           = (uint8)result;
+    memcpy( record.plotId, plotId, sizeof( record.plotId ) );
+
+    std::lock_guard<std::mutex> lock( _lock );
+
+    if( !HarvestTrace::IsActive() || _writeFailed )
+        return;
+
+    // The request may have started before the trace did
+    record.timestampNS = startTime > _startTime ? (uint64)TicksToNanoSeconds( startTime - _startTime ) : 0;
+
+    const size_t offset = _buffer.size();
+    _buffer.resize( offset + sizeof( record ) + payloadSize );
+    memcpy( _buffer.data() + offset, &record, sizeof( record ) );
+    memcpy( _buffer.data() + offset + sizeof( record ), payload, payloadSize );
+
+    if( _buffer.size() >= FLUSH_SIZE )
+        FlushBuffer();
+}
+
+//-----------------------------------------------------------
+bool HarvestTrace::Begin( const char* path )
+{
+    End();
+
+    std::lock_guard<std::mutex> lock( _lock );
+
+    if( !_file.Open( path, FileMode::Create, FileAccess::Write ) )
+        return false;
+
+    HarvestTraceHeader header = {};
+    header.magic       = MAGIC;
+    header.version     = VERSION;
+    header.startTimeMS = (uint64)std::chrono::duration_cast<std::chrono::milliseconds>(
+                            std::chrono::system_clock::now().time_since_epoch() ).count();
+
+    if( _file.Write( &header, sizeof( header ) ) != (ssize_t)sizeof( header ) )
+    {
+        _file.Close();
+        return false;
+    }
+
+    _buffer.reserve( FLUSH_SIZE + sizeof( HarvestTraceEntry ) );
+    _startTime   = TimerBegin();
+    _writeFailed = false;
+    _active.store( true, std::memory_order_release );
+
+    return true;
+}
+
+//-----------------------------------------------------------
+void HarvestTrace::End()
+{
+    std::lock_guard<std::mutex> lock( _lock );
+
+    if( !_active.load( std::memory_order_relaxed ) )
+        return;
+
+    _active.store( false, std::memory_order_release );
+
+    FlushBuffer();
+    _file.Close();
+
+    _buffer.clear();
+    _buffer.shrink_to_fit();
+}
+
+//-----------------------------------------------------------
+void HarvestTrace::RecordQualities( const std::chrono::steady_clock::time_point startTime,
+                                    const GRCompressedQualitiesRequest& req, const GRResult result )
+{
+    HarvestTraceQualities payload = {};
+    if( req.challenge )
+        memcpy( payload.challenge, req.challenge, sizeof( payload.challenge ) );
+    memcpy( payload.xLinePoints, req.xLinePoints, sizeof( payload.xLinePoints ) );
+
+    AppendRecord( startTime, req.plotId, HarvestTraceKind::Qualities, req.compressionLevel, result, &payload, sizeof( payload ) );
+}
+
+//-----------------------------------------------------------
+void HarvestTrace::RecordProof( const std::chrono::steady_clock::time_point startTime, const byte* plotId, const uint32 compressionLevel,
+                                const uint64 compressedProof[GR_POST_PROOF_CMP_X_COUNT], const GRResult result )
+{
+    AppendRecord( startTime, plotId, HarvestTraceKind::Proof, compressionLevel, result,
+                  compressedProof, sizeof( uint64 ) * GR_POST_PROOF_CMP_X_COUNT );
+}
+
+//-----------------------------------------------------------
+bool HarvestTrace::Load( const char* path, HarvestTraceHeader& outHeader, std::vector<HarvestTraceEntry>& outEntries )
+{
+    outEntries.clear();
+
+    FileStream file;
+    if( !file.Open( path, FileMode::Open, FileAccess::Read ) )
+        return false;
+
+    const ssize_t size = file.Size();
+    if( size < (ssize_t)sizeof( HarvestTraceHeader ) )
+        return false;
+
+    std::vector<byte> buf( (size_t)size );
+
+    int error = 0;
+    if( !IOJob::ReadFromFileUnaligned( file, buf.data(), buf.size(), error ) )
+        return false;
+
+    memcpy( &outHeader, buf.data(), sizeof( outHeader ) );
+    if( outHeader.magic != MAGIC || outHeader.version != VERSION )
+        return false;
+
+    const byte* data = buf.data() + sizeof( HarvestTraceHeader );
+    const byte* end  = buf.data() + buf.size();
+
+    while( (size_t)( end - data ) >= sizeof( HarvestTraceRecord ) )
+    {
+        HarvestTraceEntry entry = {};
+        memcpy( &entry.record, data, sizeof( entry.record ) );
+
+        size_t payloadSize;
+        void*  payload;
+
+        if( entry.record.kind == (uint8)HarvestTraceKind::Qualities )
+        {
+            payloadSize = sizeof( entry.qualities );
+            payload     = &entry.qualities;
+        }
+        else if( entry.record.kind == (uint8)HarvestTraceKind::Proof )
+        {
+            payloadSize = sizeof( entry.compressedProof );
+            payload     = entry.compressedProof;
+        }
+        else
+            return false;
+
+        data += sizeof( entry.record );
+        if( (size_t)( end - data ) < payloadSize )
+            break;
+
+        memcpy( payload, data, payloadSize );
+        data += payloadSize;
+
+        outEntries.push_back( entry );
+    }
+
+    return true;
+}
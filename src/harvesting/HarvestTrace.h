@@ -0,0 +1,78 @@
+#pragma once
+#include "harvesting/GreenReaper.h"
+#include <atomic>
+#include <vector>
+
+///
+/// Harvester request traces (see grBeginTrace).
+/// A trace file is a HarvestTraceHeader followed by one record per completed request,
+/// each a HarvestTraceRecord followed by the request's input:
+///  Qualities : The 32-byte challenge and the 2 line points with compressed x's.
+///  Proof     : The GR_POST_PROOF_CMP_X_COUNT compressed line points.
+/// Records are in completion order, and all values are little-endian.
+///
+struct HarvestTraceHeader
+{
+    uint32 magic;
+    uint32 version;
+    uint64 startTimeMS;         // Unix time at which the trace began
+};
+
+enum class HarvestTraceKind : uint8
+{
+    Qualities = 0,
+    Proof     = 1,
+};
+
+struct HarvestTraceRecord
+{
+    uint64 timestampNS;         // When the request started, since the trace began
+    uint64 latencyNS;           // Until it completed. Includes the time queued for asynchronous requests.
+    byte   plotId[32];
+    uint8  kind;                // HarvestTraceKind
+    uint8  compressionLevel;
+    uint8  result;              // GRResult
+    uint8  _reserved[5];
+};
+static_assert( sizeof( HarvestTraceRecord ) == 56 );
+
+struct HarvestTraceQualities
+{
+    byte        challenge[32];
+    GRLinePoint xLinePoints[2];
+};
+
+/// A record loaded with its input
+struct HarvestTraceEntry
+{
+    HarvestTraceRecord record;
+
+    union {
+        HarvestTraceQualities qualities;
+        uint64                compressedProof[GR_POST_PROOF_CMP_X_COUNT];
+    };
+};
+
+class HarvestTrace
+{
+public:
+    static constexpr uint32 MAGIC   = 0x52544842;    // 'BHTR'
+    static constexpr uint32 VERSION = 1;
+
+    // Ends the current trace, if any, before starting the new one
+    static bool Begin( const char* path );
+    static void End();
+
+    inline static bool IsActive() { return _active.load( std::memory_order_relaxed ); }
+
+    // Record a request that started at startTime and just completed. May be called from any thread.
+    static void RecordQualities( std::chrono::steady_clock::time_point startTime, const GRCompressedQualitiesRequest& req, GRResult result );
+    static void RecordProof( std::chrono::steady_clock::time_point startTime, const byte* plotId, uint32 compressionLevel,
+                             const uint64 compressedProof[GR_POST_PROOF_CMP_X_COUNT], GRResult result );
+
+    // Load a whole trace file. Fails on a wrong header. A record cut short at the end of the file is dropped.
+    static bool Load( const char* path, HarvestTraceHeader& outHeader, std::vector<HarvestTraceEntry>& outEntries );
+
+private:
+    inline static std::atomic<bool> _active = false;
+};
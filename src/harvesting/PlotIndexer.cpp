@@ -0,0 +1,473 @@
+#include "GreenReaper.h"
+#include "PlotIndexer.h"
+#include "tools/PlotReader.h"
+#include "threading/ThreadPool.h"
+#include "threading/MTJob.h"
+#include "plotdisk/jobs/IOJob.h"
+#include "util/BitView.h"
+#include "SysHost.h"
+#include <filesystem>
+#include <unordered_map>
+
+namespace fs = std::filesystem;
+
+static constexpr uint32 INDEX_MAGIC   = 0x49504242;     // 'BBPI'
+static constexpr uint32 INDEX_VERSION = 2;
+
+// C2 holds one entry per 10000 * 1000 f7s, so anything much larger is not a valid plot
+static constexpr size_t MAX_C2_SIZE = 1 MiB;
+
+///
+/// Opens a plot only to read its header and C2 table
+///
+class IndexedPlotFile : public IPlotFile
+{
+public:
+    inline const PlotFileHeaderV2& Header() const { return _header; }
+
+    bool Open( const char* path ) override
+    {
+        if( !_file.Open( path, FileMode::Open, FileAccess::Read, FileFlags::None ) )
+            return false;
+
+        int headerError = 0;
+        if( !ReadHeader( headerError ) )
+        {
+            _file.Close();
+            return false;
+        }
+
+        return true;
+    }
+
+    bool IsOpen() const override { return _file.IsOpen(); }
+
+    size_t PlotSize() const override
+    {
+        const ssize_t sz = ((FileStream*)&_file)->Size();
+        return sz < 0 ? 0 : (size_t)sz;
+    }
+
+    ssize_t Read( size_t size, void* buffer ) override
+    {
+        int error = 0;
+        if( !IOJob::ReadFromFileUnaligned( _file, buffer, size, error ) )
+            return -1;
+
+        _bytesRead += size;
+        return (ssize_t)size;
+    }
+
+    bool Seek( SeekOrigin origin, int64 offset ) override { return _file.Seek( offset, origin ); }
+
+    int GetError() override { return _file.GetError(); }
+
+private:
+    FileStream _file;
+};
+
+/// Same decoding as PlotReader::LoadC2Entries()
+//-----------------------------------------------------------
+static bool ReadC2Entries( IndexedPlotFile& plot, std::vector<uint64>& outC2 )
+{
+    const size_t c2Size     = plot.TableSize( PlotTable::C2 );
+    const size_t f7ByteSize = CDiv( plot.K(), 8 );
+
+    if( c2Size < f7ByteSize || c2Size > MAX_C2_SIZE || !plot.SeekToTable( PlotTable::C2 ) )
+        return false;
+
+    byte* buffer = bbvirtallocbounded<byte>( c2Size );
+
+    if( plot.Read( c2Size, buffer ) != (ssize_t)c2Size )
+    {
+        bbvirtfreebounded( buffer );
+        return false;
+    }
+
+    const uint64 c2MaxEntries = c2Size / f7ByteSize;
+    const uint32 f7BitCount   = (uint32)f7ByteSize * 8;
+
+    CPBitReader reader( buffer, c2Size * 8 );
+    outC2.resize( c2MaxEntries );
+    reader.ReadN( f7BitCount, c2MaxEntries, outC2.data() );
+
+    // Stop at the first out-of-order entry, which is padding
+    uint64 count = 1;
+    while( count < c2MaxEntries && outC2[count] >= outC2[count-1] )
+        count++;
+
+    outC2.resize( count );
+
+    bbvirtfreebounded( buffer );
+    return true;
+}
+
+//-----------------------------------------------------------
+static bool IndexPlot( GRPlotIndex::Entry& entry )
+{
+    IndexedPlotFile plot;
+    if( !plot.Open( entry.path.c_str() ) )
+        return false;
+
+    entry.version = plot.Version();
+    entry.header  = plot.Header();
+
+    if( entry.version < PlotVersion::v2_0 )
+    {
+        entry.header.flags            = PlotFlags::None;
+        entry.header.compressionLevel = 0;
+    }
+
+    entry.c2.clear();
+    return ReadC2Entries( plot, entry.c2 );
+}
+
+//-----------------------------------------------------------
+static void ListPlots( const char* dir, std::vector<GRPlotIndex::Entry>& outPlots )
+{
+    std::error_code err;
+    for( const auto& file : fs::directory_iterator( dir, err ) )
+    {
+        if( !file.is_regular_file( err ) || file.path().extension() != ".plot" )
+            continue;
+
+        GRPlotIndex::Entry entry;
+        entry.path     = file.path().string();
+        entry.fileSize = (uint64)file.file_size( err );
+        entry.mtime    = (int64)file.last_write_time( err ).time_since_epoch().count();
+
+        if( !err )
+            outPlots.push_back( std::move( entry ) );
+    }
+}
+
+///
+/// Plot Index
+///
+//-----------------------------------------------------------
+void GRPlotIndex::Scan( const char* const* dirs, const uint32 dirCount, uint32 threadCount )
+{
+    if( threadCount == 0 )
+        threadCount = SysHost::GetUsableCPUCount();
+
+    // Plot directories usually sit on separate disks, so list them in parallel too
+    std::vector<std::vector<Entry>> dirPlots( dirCount );
+
+    ThreadPool pool( std::max( 1u, threadCount ), ThreadPool::Mode::Fixed, true );
+
+    if( dirCount > 0 )
+    {
+        AnonMTJob::RunRanges( pool, std::min( pool.ThreadCount(), dirCount ), dirCount, 1,
+            [&]( AnonMTJob* self, uint64 offset, uint64 count ) {
+
+            for( uint64 i = offset; i < offset + count; i++ )
+                ListPlots( dirs[i], dirPlots[i] );
+        });
+    }
+
+    std::unordered_map<std::string, Entry*> known;
+    for( Entry& e : plots )
+        known[e.path] = &e;
+
+    std::vector<Entry>  scanned;
+    std::vector<uint64> stale;
+
+    for( auto& list : dirPlots )
+    {
+        for( Entry& e : list )
+        {
+            auto it = known.find( e.path );
+
+            if( it != known.end() && it->second->fileSize == e.fileSize && it->second->mtime == e.mtime )
+                scanned.push_back( std::move( *it->second ) );
+            else
+            {
+                stale.push_back( scanned.size() );
+                scanned.push_back( std::move( e ) );
+            }
+        }
+    }
+
+    // Only new or modified plots are opened
+    std::vector<bool> valid( stale.size(), false );
+
+    if( !stale.empty() )
+    {
+        AnonMTJob::RunRanges( pool, (uint32)std::min( (uint64)pool.ThreadCount(), (uint64)stale.size() ), stale.size(), 1,
+            [&]( AnonMTJob* self, uint64 offset, uint64 count ) {
+
+            for( uint64 i = offset; i < offset + count; i++ )
+                valid[i] = IndexPlot( scanned[stale[i]] );
+        });
+    }
+
+    // Drop plots that could not be read, they are retried on the next scan
+    plots.clear();
+    plots.reserve( scanned.size() );
+
+    for( uint64 i = 0, s = 0; i < scanned.size(); i++ )
+    {
+        if( s < stale.size() && stale[s] == i )
+        {
+            if( !valid[s++] )
+                continue;
+        }
+
+        plots.push_back( std::move( scanned[i] ) );
+    }
+}
+
+/// Index file layout, in host byte order:
+///  uint32 magic, uint32 version, uint64 plotCount
+///  Per plot:
+///   uint16 pathLength, path
+///   uint64 fileSize, int64 mtime
+///   uint32 plotVersion, uint32 flags, uint32 k, uint32 compressionLevel, uint32 memoLength
+///   id[32], memo[memoLength]
+///   uint64 tablePtrs[10], uint64 tableSizes[10]
+///   uint64 c2Count, uint64 c2[c2Count]
+//-----------------------------------------------------------
+template<typename T>
+inline static void WriteValue( std::vector<byte>& buf, const T& value )
+{
+    buf.insert( buf.end(), (const byte*)&value, (const byte*)&value + sizeof( T ) );
+}
+
+//-----------------------------------------------------------
+inline static void WriteBytes( std::vector<byte>& buf, const void* src, const size_t size )
+{
+    buf.insert( buf.end(), (const byte*)src, (const byte*)src + size );
+}
+
+//-----------------------------------------------------------
+bool GRPlotIndex::Save( const char* path ) const
+{
+    std::vector<byte> buf;
+
+    WriteValue( buf, INDEX_MAGIC );
+    WriteValue( buf, INDEX_VERSION );
+    WriteValue( buf, (uint64)plots.size() );
+
+    for( const Entry& e : plots )
+    {
+        WriteValue( buf, (uint16)e.path.size() );
+        WriteBytes( buf, e.path.data(), e.path.size() );
+        WriteValue( buf, e.fileSize );
+        WriteValue( buf, e.mtime );
+        WriteValue( buf, (uint32)e.version );
+        WriteValue( buf, (uint32)e.header.flags );
+        WriteValue( buf, (uint32)e.header.k );
+        WriteValue( buf, (uint32)e.header.compressionLevel );
+        WriteValue( buf, (uint32)e.header.memoLength );
+        WriteBytes( buf, e.header.id, sizeof( e.header.id ) );
+        WriteBytes( buf, e.header.memo, e.header.memoLength );
+        WriteBytes( buf, e.header.tablePtrs, sizeof( e.header.tablePtrs ) );
+        WriteBytes( buf, e.header.tableSizes, sizeof( e.header.tableSizes ) );
+        WriteBytes( buf, e.header.deltaRValues, sizeof( e.header.deltaRValues ) );
+        WriteValue( buf, (uint64)e.c2.size() );
+        WriteBytes( buf, e.c2.data(), e.c2.size() * sizeof( uint64 ) );
+    }
+
+    // Write to a temporary file first, so that a crash never leaves a partial index behind
+    const std::string tmpPath = std::string( path ) + ".tmp";
+
+    FileStream file;
+    if( !file.Open( tmpPath.c_str(), FileMode::Create, FileAccess::Write ) )
+        return false;
+
+    const bool written = file.Write( buf.data(), buf.size() ) == (ssize_t)buf.size();
+    file.Close();
+
+    if( !written || !FileStream::Move( tmpPath.c_str(), path ) )
+    {
+        remove( tmpPath.c_str() );
+        return false;
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------
+class IndexReader
+{
+public:
+    inline IndexReader( const byte* data, const size_t size ) : _data( data ), _end( data + size ) {}
+
+    template<typename T>
+    inline bool Read( T& value ) { return ReadBytes( &value, sizeof( T ) ); }
+
+    inline bool ReadBytes( void* dst, const size_t size )
+    {
+        if( (size_t)( _end - _data ) < size )
+            return false;
+
+        memcpy( dst, _data, size );
+        _data += size;
+        return true;
+    }
+
+private:
+    const byte* _data;
+    const byte* _end;
+};
+
+//-----------------------------------------------------------
+bool GRPlotIndex::Load( const char* path )
+{
+    plots.clear();
+
+    FileStream file;
+    if( !file.Open( path, FileMode::Open, FileAccess::Read ) )
+        return false;
+
+    const ssize_t size = file.Size();
+    if( size <= 0 )
+        return false;
+
+    std::vector<byte> buf( (size_t)size );
+
+    int error = 0;
+    if( !IOJob::ReadFromFileUnaligned( file, buf.data(), buf.size(), error ) )
+        return false;
+
+    file.Close();
+
+    IndexReader reader( buf.data(), buf.size() );
+
+    uint32 magic = 0, version = 0;
+    uint64 count = 0;
+
+    if( !reader.Read( magic ) || !reader.Read( version ) || !reader.Read( count ) ||
+        magic != INDEX_MAGIC || version != INDEX_VERSION )
+        return false;
+
+    // Each plot takes at least a few hundred bytes, so this bounds count for a corrupt file
+    plots.reserve( std::min( count, (uint64)buf.size() / sizeof( PlotFileHeaderV2 ) ) );
+
+    for( uint64 i = 0; i < count; i++ )
+    {
+        Entry  e;
+        uint16 pathLength;
+        uint32 plotVersion, flags, k, compressionLevel, memoLength;
+        uint64 c2Count;
+
+        bool ok = reader.Read( pathLength );
+        if( ok )
+        {
+            e.path.resize( pathLength );
+            ok = reader.ReadBytes( e.path.data(), pathLength );
+        }
+
+        ok = ok && reader.Read( e.fileSize ) && reader.Read( e.mtime ) &&
+             reader.Read( plotVersion ) && reader.Read( flags ) && reader.Read( k ) &&
+             reader.Read( compressionLevel ) && reader.Read( memoLength ) &&
+             memoLength <= sizeof( e.header.memo ) &&
+             reader.ReadBytes( e.header.id, sizeof( e.header.id ) ) &&
+             reader.ReadBytes( e.header.memo, memoLength ) &&
+             reader.ReadBytes( e.header.tablePtrs, sizeof( e.header.tablePtrs ) ) &&
+             reader.ReadBytes( e.header.tableSizes, sizeof( e.header.tableSizes ) ) &&
+             reader.ReadBytes( e.header.deltaRValues, sizeof( e.header.deltaRValues ) ) &&
+             reader.Read( c2Count ) && c2Count <= MAX_C2_SIZE;
+
+        if( ok )
+        {
+            e.c2.resize( c2Count );
+            ok = reader.ReadBytes( e.c2.data(), c2Count * sizeof( uint64 ) );
+        }
+
+        if( !ok )
+        {
+            plots.clear();
+            return false;
+        }
+
+        e.version                 = (PlotVersion)plotVersion;
+        e.header.flags            = (PlotFlags)flags;
+        e.header.k                = k;
+        e.header.compressionLevel = (byte)compressionLevel;
+        e.header.memoLength       = memoLength;
+
+        plots.push_back( std::move( e ) );
+    }
+
+    return true;
+}
+
+
+///
+/// API
+///
+//-----------------------------------------------------------
+GRResult grCreatePlotIndex( GRPlotIndex** outIndex, const char* const* plotDirs, const uint32_t dirCount,
+                            const char* indexFilePath, const uint32_t threadCount )
+{
+    if( outIndex == nullptr || ( dirCount > 0 && plotDirs == nullptr ) )
+        return GRResult_InvalidArg;
+
+    for( uint32 i = 0; i < dirCount; i++ )
+    {
+        if( plotDirs[i] == nullptr )
+            return GRResult_InvalidArg;
+    }
+
+    auto* index = new GRPlotIndex{};
+
+    // A missing or outdated index just means every plot gets parsed
+    if( indexFilePath )
+        index->Load( indexFilePath );
+
+    index->Scan( plotDirs, dirCount, threadCount );
+
+    if( indexFilePath && !index->Save( indexFilePath ) )
+    {
+        delete index;
+        return GRResult_Failed;
+    }
+
+    *outIndex = index;
+    return GRResult_OK;
+}
+
+//-----------------------------------------------------------
+void grDestroyPlotIndex( GRPlotIndex* index )
+{
+    delete index;
+}
+
+//-----------------------------------------------------------
+uint64_t grGetPlotIndexCount( GRPlotIndex* index )
+{
+    return index ? (uint64_t)index->plots.size() : 0;
+}
+
+//-----------------------------------------------------------
+GRResult grGetPlotInfo( GRPlotIndex* index, const uint64_t plotIdx, GRPlotInfo* outInfo, const size_t infoStructSize )
+{
+    if( index == nullptr || outInfo == nullptr )
+        return GRResult_InvalidArg;
+
+    if( infoStructSize != sizeof( GRPlotInfo ) )
+        return GRResult_WrongVersion;
+
+    if( plotIdx >= index->plots.size() )
+        return GRResult_InvalidArg;
+
+    const GRPlotIndex::Entry& e = index->plots[plotIdx];
+
+    outInfo->path             = e.path.c_str();
+    outInfo->plotId           = e.header.id;
+    outInfo->memo             = e.header.memo;
+    outInfo->memoLength       = e.header.memoLength;
+    outInfo->k                = e.header.k;
+    outInfo->version          = (uint32_t)e.version;
+    outInfo->flags            = (uint32_t)e.header.flags;
+    outInfo->compressionLevel = e.header.compressionLevel;
+    outInfo->fileSize         = e.fileSize;
+    outInfo->c2Entries        = e.c2.data();
+    outInfo->c2Count          = (uint64_t)e.c2.size();
+
+    memcpy( outInfo->tableAddresses, e.header.tablePtrs,  sizeof( outInfo->tableAddresses ) );
+    memcpy( outInfo->tableSizes,     e.header.tableSizes, sizeof( outInfo->tableSizes ) );
+
+    return GRResult_OK;
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include "plotting/PlotHeader.h"
+#include <string>
+#include <vector>
+
+///
+/// Memory-resident metadata of every plot in a set of directories (see grCreatePlotIndex).
+/// Only plots that are new or changed since the last scan are opened, the rest come
+/// from the index file, so a harvester restart does not re-parse every plot header and C2 table.
+///
+struct GRPlotIndex
+{
+    struct Entry
+    {
+        std::string         path;
+        uint64              fileSize = 0;
+        int64               mtime    = 0;       // File modification time, for invalidation
+        PlotVersion         version  = PlotVersion::v1_0;
+        PlotFileHeaderV2    header;
+        std::vector<uint64> c2;                 // Decoded C2 entries
+    };
+
+    std::vector<Entry> plots;
+
+    // Load the index file into plots. Returns false if it does not exist or is invalid.
+    bool Load( const char* path );
+
+    // Atomically replace the index file with the current plots
+    bool Save( const char* path ) const;
+
+    // Scan dirs for .plot files and refresh plots, reusing unchanged entries
+    void Scan( const char* const* dirs, uint32 dirCount, uint32 threadCount );
+};
@@ -0,0 +1,138 @@
+#include "GreenReaper.h"
+#include "tools/PlotReader.h"
+#include "tools/PlotReadScheduler.h"
+#include "plotting/PlotValidation.h"
+#include <vector>
+
+struct GRPlot
+{
+    FilePlot                    file;
+    std::unique_ptr<PlotReader> reader;
+
+    std::vector<uint64>           p7Entries;
+    std::vector<uint64>           x1s, x2s;
+    std::vector<ProofFetchResult> results;
+};
+
+//-----------------------------------------------------------
+GRResult grOpenPlot( GRPlot** outPlot, const char* path, GreenReaperContext* context )
+{
+    if( outPlot == nullptr || path == nullptr )
+        return GRResult_InvalidArg;
+
+    auto* plot = new GRPlot{};
+
+    if( !plot->file.Open( path ) )
+    {
+        delete plot;
+        return GRResult_Failed;
+    }
+
+    plot->reader = std::make_unique<PlotReader>( plot->file );
+
+    if( context )
+        plot->reader->AssignDecompressionContext( context );
+
+    *outPlot = plot;
+    return GRResult_OK;
+}
+
+//-----------------------------------------------------------
+void grClosePlot( GRPlot* plot )
+{
+    delete plot;
+}
+
+//-----------------------------------------------------------
+GRResult grLookupQualities( GRPlot* plot, const uint8_t* challenge, GRQualityXs* outQualities,
+                            const uint32_t maxCount, uint32_t* outCount )
+{
+    if( plot == nullptr || challenge == nullptr || outCount == nullptr || ( maxCount > 0 && outQualities == nullptr ) )
+        return GRResult_InvalidArg;
+
+    *outCount = 0;
+
+    PlotReader& reader = *plot->reader;
+    const uint32 k     = plot->file.K();
+
+    // The f7 is the challenge's first k bits
+    uint64 f7 = 0;
+    for( uint32 i = 0; i < 8; i++ )
+        f7 = ( f7 << 8 ) | challenge[i];
+
+    f7 >>= 64 - k;
+
+    uint64 p7IndexBase = 0;
+    const uint64 matchCount = reader.GetP7IndicesForF7( f7, p7IndexBase );
+
+    if( matchCount == 0 )
+        return GRResult_OK;
+
+    plot->p7Entries.resize( matchCount );
+    plot->x1s      .resize( matchCount );
+    plot->x2s      .resize( matchCount );
+    plot->results  .resize( matchCount );
+
+    for( uint64 i = 0; i < matchCount; i++ )
+    {
+        if( !reader.ReadP7Entry( p7IndexBase + i, plot->p7Entries[i] ) )
+            return GRResult_Failed;
+    }
+
+    reader.FetchQualityXsForP7Entries( plot->p7Entries.data(), (uint32)matchCount, challenge,
+                                       plot->x1s.data(), plot->x2s.data(), plot->results.data() );
+
+    uint32 count = 0;
+    for( uint64 i = 0; i < matchCount; i++ )
+    {
+        switch( plot->results[i] )
+        {
+            case ProofFetchResult::OK:
+                if( count < maxCount )
+                    outQualities[count] = { plot->p7Entries[i], plot->x1s[i], plot->x2s[i] };
+                count++;
+                break;
+
+            case ProofFetchResult::NoProof:
+                break;
+
+            default:
+                return GRResult_Failed;
+        }
+    }
+
+    *outCount = std::min( count, maxCount );
+    return GRResult_OK;
+}
+
+//-----------------------------------------------------------
+void grSetLookupBatchWindow( const uint32_t windowMicroseconds )
+{
+    PlotReadScheduler::Configure( windowMicroseconds );
+}
+
+//-----------------------------------------------------------
+GRResult grValidateFullProofs( const uint32_t k, const uint8_t plotId[32], const uint32_t proofCount,
+                               const uint64_t* proofXs, uint64_t* outF7s, GRBool* outValid )
+{
+    if( plotId == nullptr || ( proofCount > 0 && ( proofXs == nullptr || outF7s == nullptr || outValid == nullptr ) ) )
+        return GRResult_InvalidArg;
+
+    if( k < 18 || k > 50 )
+        return GRResult_InvalidArg;
+
+    static constexpr uint32 BATCH_SIZE = 64;
+
+    for( uint32 i = 0; i < proofCount; i += BATCH_SIZE )
+    {
+        const uint32 count = std::min( proofCount - i, BATCH_SIZE );
+
+        bool valid[BATCH_SIZE];
+        PlotValidation::ValidateFullProofs( k, plotId, count, proofXs + (size_t)i * PROOF_X_COUNT, outF7s + i, valid );
+
+        for( uint32 j = 0; j < count; j++ )
+            outValid[i+j] = valid[j] ? GR_TRUE : GR_FALSE;
+    }
+
+    return GRResult_OK;
+}
@@ -3,6 +3,7 @@
 #include "plotting/Tables.h"
 
 struct GreenReaperContext;
+struct GRProofTimings;
 struct Pair;
 
 enum class ThresherResultKind
@@ -10,6 +11,7 @@ enum class ThresherResultKind
     Success = 0,    // Successfully processed a table with matches.
     NoMatches,      // No error occurred, but no matches we obtained.
     Error,          // An error has occurred when decompressing and an error code will be set.
+    Unsupported,    // The request can't be handled by this operation. The caller should fall back to another one.
 };
 
 enum class ThresherError
@@ -17,6 +19,7 @@ enum class ThresherError
     None = 0,
     UnexpectedError,
     CudaError,
+    MetalError,
 };
 
 struct ThresherResult
@@ -37,6 +40,10 @@ public:
 
     virtual void ReleaseBuffers() = 0;
 
+    // Called once a request is done. Buffers needed only during requests may be released
+    // here, as long as AllocateBuffers() or the next operation acquires them again.
+    virtual void EndRequest() {}
+
     virtual ThresherResult DecompressInitialTable(
         GreenReaperContext& cx,
         const byte plotId[32],
@@ -62,10 +69,34 @@ public:
         const uint64*   inY,
         const void*     inMeta ) = 0;
 
+    /// Forward propagates tables 3 to 6 of a full proof without returning to the host between tables,
+    /// starting from the unsorted table 2 entries of each group. Only the group match counts and
+    /// the proof's x values are copied back. outProof must hold GR_POST_PROOF_X_COUNT entries.
+    /// Returns NoMatches if no proof was found, or Unsupported if DecompressTableGroup() must be used instead.
+    virtual ThresherResult ForwardPropTables(
+        GreenReaperContext& cx,
+        uint32          groupCount,
+        const uint32*   groupOffsets,
+        const uint32*   groupCounts,
+        const Pair*     inPairs,
+        const uint64*   inY,
+        const void*     inMeta,
+        bool            returnSuccessOnSingleMatch,
+        uint64*         outProof )
+    {
+        return { ThresherResultKind::Unsupported };
+    }
+
     // For testing
     virtual void DumpTimings() {}
 
     virtual void ClearTimings() {}
+
+    // Enable per-stage timing records. This may add synchronization points between stages.
+    virtual void SetRecordTimings( bool enabled ) {}
+
+    // Add the timings recorded since the last call to ClearTimings() to outTimings.
+    virtual void AccumulateTimings( GRProofTimings& outTimings ) {}
 };
 
 
@@ -73,5 +104,17 @@ class CudaThresherFactory
 {
 public:
     static IThresher* Create( const struct GreenReaperConfig& config );
+
+    // Returns the number of usable devices, 0 if CUDA is not available.
+    static uint32 GetDeviceCount();
 };
 
+/// Apple Silicon GPUs, through Metal. Only available on macOS.
+class MetalThresherFactory
+{
+public:
+    static IThresher* Create( const struct GreenReaperConfig& config );
+
+    // Returns the number of usable devices, 0 if Metal is not available.
+    static uint32 GetDeviceCount();
+};
@@ -1,4 +1,5 @@
 #include "BucketStream.h"
+#include "FileStream.h"
 #include "util/Util.h"
 
  //-----------------------------------------------------------
@@ -25,6 +26,12 @@
         seqSliceBuffer += numBuckets;
         intSliceBuffer += numBuckets;
     }
+
+    if( FileStream* file = dynamic_cast<FileStream*>( &baseStream ) )
+    {
+        _writeBatch = new FileIOVecBatch( *file, true  );
+        _readBatch  = new FileIOVecBatch( *file, false );
+    }
  }
 
  //-----------------------------------------------------------
@@ -34,6 +41,9 @@
      free( _interleavedSlices[0] );
      free( _sequentialSlices .Ptr() );
      free( _interleavedSlices.Ptr() );
+
+     delete _writeBatch;
+     delete _readBatch;
  }
 
  //-----------------------------------------------------------
@@ -41,26 +51,23 @@
  {
     const byte* sliceBytes = (byte*)slices;
 
-    IStream& stream = _baseStream;
-
     if( GetWriteMode() == Sequential )
     {
         // Write slices across all buckets. That is, each bucket contains its own slices
         for( uint32 bucket = 0; bucket < _numBuckets; bucket++ )
         {
             const int64 offset = (int64)( bucket * _bucketCapacity + _writeSlice * _sliceCapacity ); //bucket * (int64)_bucketCapacity + (int64)_slices[i][0].size;
-            PanicIf( !stream.Seek( offset, SeekOrigin::Begin ), "Base stream failed to seek." );
 
             const size_t size = sliceSizes[bucket];
             ASSERT( size <= _sliceCapacity );
 
-            // #TODO: Loop write, or use IOJob
-            PanicIf( stream.Write( sliceBytes, size ) != (ssize_t)size, "Failed to write slice to base stream." );
+            WriteSlice( sliceBytes, size, offset );
 
             _sequentialSlices[bucket][_writeSlice] = size;
             sliceBytes += size;
         }
 
+        FlushSlices( _writeBatch );
         _writeSlice++;
     }
     else
@@ -77,17 +84,16 @@
         for( uint32 slice = 0; slice < _numBuckets; slice++ )
         {
             const int64 offset = (int64)( bucketOffset + slice * _sliceCapacity );
-            PanicIf( !stream.Seek( offset, SeekOrigin::Begin ), "Base stream failed to seek." );
 
             const size_t size = sliceSizes[slice];
             ASSERT( size <= _sliceCapacity );
 
-            // #TODO: Loop write, or use IOJob
-            PanicIf( stream.Write( sliceBytes, size ) != (ssize_t)size, "Failed to write slice to base stream." );
+            WriteSlice( sliceBytes, size, offset );
             _interleavedSlices[_writeBucket][slice] = size;
             sliceBytes += size;
         }
 
+        FlushSlices( _writeBatch );
         _writeBucket++;
      }
  }
@@ -101,7 +107,6 @@
     // #TODO: Remove the read size... We don't need that here...
 
     byte* buffer = (byte*)readBuffer;
-    IStream& stream = _baseStream;
 
     if( GetReadMode() == Sequential )
     {
@@ -110,17 +115,14 @@
 
         for( uint32 slice = 0; slice < _numBuckets; slice++ )
         {
-            const int64 offset = (int64)(_bucketStart + slice * _sliceCapacity );
-            PanicIf( !stream.Seek( offset, SeekOrigin::Begin ), "Failed to seek for reading." );
-
-            // #TODO: Loop read, or use IOJob
-            const size_t  sliceSize = _sequentialSlices[_readBucket][slice];
-            const ssize_t sizeRead  = stream.Read( buffer, sliceSize );
-            PanicIf( sizeRead != (ssize_t)sliceSize, "Failed to read slice %u of bucket %u.", slice, (uint32)_readBucket );
+            const int64  offset    = (int64)(_bucketStart + slice * _sliceCapacity );
+            const size_t sliceSize = _sequentialSlices[_readBucket][slice];
 
+            ReadSlice( buffer, sliceSize, offset );
             buffer += sliceSize;
         }
 
+        FlushSlices( _readBatch );
         _readBucket++;
      }
     else
@@ -128,21 +130,55 @@
         // Read a whole bucket's worth of bytes by reading slices spread across all buckets
         for( uint32 bucket = 0; bucket < _numBuckets; bucket++ )
         {
-            const int64 offset = (int64)( bucket * _bucketCapacity + _readSlice * _sliceCapacity );
-            PanicIf( !_baseStream.Seek( offset, SeekOrigin::Begin ), "Failed to seek for reading." );
-
-            // #TODO: Loop read, or use IOJob
-            const size_t  sliceSize = _interleavedSlices[bucket][_readSlice];
-            const ssize_t sizeRead  = _baseStream.Read( buffer, sliceSize );
-            PanicIf( sizeRead != (ssize_t)sliceSize, "Failed to read slice %u of bucket %u.", (uint32)_readSlice, bucket );
+            const int64  offset    = (int64)( bucket * _bucketCapacity + _readSlice * _sliceCapacity );
+            const size_t sliceSize = _interleavedSlices[bucket][_readSlice];
 
+            ReadSlice( buffer, sliceSize, offset );
             buffer += sliceSize;
         }
 
+        FlushSlices( _readBatch );
         _readSlice++;
     }
  }
 
+ //-----------------------------------------------------------
+ void BucketStream::WriteSlice( const byte* buffer, const size_t size, const int64 offset )
+ {
+    if( _writeBatch )
+    {
+        PanicIf( !_writeBatch->Add( buffer, size, (uint64)offset ), "Failed to write slice to base stream with error %d.", _writeBatch->Error() );
+        return;
+    }
+
+    PanicIf( !_baseStream.Seek( offset, SeekOrigin::Begin ), "Base stream failed to seek." );
+
+    // #TODO: Loop write, or use IOJob
+    PanicIf( _baseStream.Write( buffer, size ) != (ssize_t)size, "Failed to write slice to base stream." );
+ }
+
+ //-----------------------------------------------------------
+ void BucketStream::ReadSlice( byte* buffer, const size_t size, const int64 offset )
+ {
+    if( _readBatch )
+    {
+        PanicIf( !_readBatch->Add( buffer, size, (uint64)offset ), "Failed to read slice from base stream with error %d.", _readBatch->Error() );
+        return;
+    }
+
+    PanicIf( !_baseStream.Seek( offset, SeekOrigin::Begin ), "Failed to seek for reading." );
+
+    // #TODO: Loop read, or use IOJob
+    PanicIf( _baseStream.Read( buffer, size ) != (ssize_t)size, "Failed to read slice from base stream." );
+ }
+
+ //-----------------------------------------------------------
+ void BucketStream::FlushSlices( FileIOVecBatch* batch )
+ {
+    if( batch )
+        PanicIf( !batch->Flush(), "Failed to transfer slices of base stream with error %d.", batch->Error() );
+ }
+
  //-----------------------------------------------------------
  ssize_t BucketStream::Read( void* buffer, size_t size )
  {
@@ -1,5 +1,8 @@
 #include "IStream.h"
 
+class FileStream;
+class FileIOVecBatch;
+
 class BucketStream : public IStream
 {
 public:
@@ -42,6 +45,12 @@ private:
         _writeMode = (Mode)(((uint32)_writeMode + 1) & 1); // (mode + 1) % 2
     }
 
+    // Transfer a slice at an absolute offset of the base stream.
+    // Must be followed by FlushSlices() once all of a bucket's slices have been submitted.
+    void WriteSlice( const byte* buffer, size_t size, int64 offset );
+    void ReadSlice( byte* buffer, size_t size, int64 offset );
+    void FlushSlices( FileIOVecBatch* batch );
+
     struct Slice
     {
         uint32 position;
@@ -49,6 +58,8 @@ private:
     };
 private:
     IStream&      _baseStream;          // Backing stream where we actually write data
+    FileIOVecBatch* _writeBatch = nullptr;  // If the base stream is a file, slices that are contiguous
+    FileIOVecBatch* _readBatch  = nullptr;  //  in it are transferred with a single vectored I/O call
     Span<size_t*> _sequentialSlices;    // Info about each bucket slice
     Span<size_t*> _interleavedSlices;   // Info about each bucket slice
     size_t        _sliceCapacity;       // Maximum size of a single bucket slice
@@ -26,9 +26,23 @@ enum class FileFlags : uint32
 };
 ImplementFlagOps( FileFlags );
 
+// Access pattern hints for buffered (non-direct) files
+enum class FileAdvice : uint32
+{
+    Sequential = 0,     // The whole file will be accessed sequentially, use aggressive read-ahead.
+    WillNeed,           // The given range will be read soon, start reading it into the page cache.
+};
+
+// A buffer of a scatter/gather (vectored) transfer
+struct FileIOVec
+{
+    void*  buffer;
+    size_t size;
+};
 
 class FileStream : public IStream
 {
+    friend class FileIOBatch;
 public:
     inline FileStream() {}
 
@@ -38,6 +52,7 @@ public:
         , _flags     ( other._flags )
         , _error     ( other._error )
         , _blockSize ( other._blockSize )
+        , _optimalIOSize( other._optimalIOSize )
         , _fd        ( other._fd )
     {
         other._position  = 0;
@@ -45,6 +60,7 @@ public:
         other._flags     = FileFlags::None;
         other._error     = 0;
         other._blockSize = 0;
+        other._optimalIOSize = 0;
         #if PLATFORM_IS_UNIX
             other._fd = -1;
         #else
@@ -68,17 +84,38 @@ public:
     ssize_t Read( void* buffer, size_t size ) override;
     ssize_t Write( const void* buffer, size_t size ) override;
 
+    // Positional scatter/gather I/O: transfers the buffers, in order, from/to the contiguous file range at offset.
+    // Loops until everything was transferred, or until end-of-file for reads.
+    // Does not use the file's position, and leaves it unspecified.
+    // Returns the number of bytes transferred, or -1 on error.
+    ssize_t ReadV ( const FileIOVec* vecs, uint32 count, uint64 offset );
+    ssize_t WriteV( const FileIOVec* vecs, uint32 count, uint64 offset );
+
     bool Reserve( ssize_t size );
 
+    // Give the OS an access pattern hint for this file. Only meaningful for buffered files.
+    // A length of 0 means up to the end of the file.
+    bool Advise( FileAdvice advice, size_t offset = 0, size_t length = 0 );
+
     bool Seek( int64 offset, SeekOrigin origin ) override;
 
     bool Flush() override;
 
+    // Acquire an exclusive, advisory lock on the whole file. The lock is shared
+    // between processes and is released on Unlock() or when the file is closed.
+    // If block is false, returns false immediately when another process holds the lock.
+    bool Lock( bool block = true );
+    bool Unlock();
+
     inline size_t BlockSize() const override
     {
         return _blockSize;
     }
 
+    // Preferred I/O size of the underlying device (i.e. the stripe width on RAID volumes).
+    // Always a multiple of BlockSize(). Transfers of this size avoid partial-stripe writes.
+    inline size_t OptimalIOSize() const { return _optimalIOSize; }
+
     ssize_t Size() override;
 
     bool Truncate( const ssize_t length ) override;
@@ -102,7 +139,13 @@ public:
 
     inline intptr_t Id() { return (intptr_t)_fd; }
 
+    inline size_t Position() const { return _position; }
+
     static size_t GetBlockSizeForPath( const char* pathU8 );
+    static bool   GetIOSizesForPath( const char* pathU8, size_t& outBlockSize, size_t& outOptimalIOSize );
+
+    // Identifies the device (or volume, on Windows) holding the file at path
+    static bool   GetDeviceIdForPath( const char* pathU8, uint64& outDeviceId );
 
     // Change name or location of file
     static bool   Move( const char* oldPathU8, const char* newPathU8, int32* outError = nullptr );
@@ -123,10 +166,160 @@ private:
     FileFlags  _flags         = FileFlags::None;
     int        _error         = 0;
     size_t     _blockSize     = 0;        // for O_DIRECT/FILE_FLAG_NO_BUFFERING
+    size_t     _optimalIOSize = 0;
 
     #if PLATFORM_IS_UNIX
         int    _fd            = -1;
     #elif PLATFORM_IS_WINDOWS
         HANDLE _fd            = INVALID_WIN32_HANDLE;
     #endif
-};
\ No newline at end of file
+};
+
+///
+/// Collects positional transfers to a single file, and submits runs of them
+/// that are contiguous in the file as a single ReadV()/WriteV().
+///
+class FileIOVecBatch
+{
+    static constexpr uint32 MAX_VECS = 64;
+
+public:
+    inline FileIOVecBatch( FileStream& file, const bool isWrite )
+        : _file   ( file    )
+        , _isWrite( isWrite )
+    {}
+
+    // Queues a transfer. Submits the pending run first if the transfer doesn't continue it.
+    // Returns false if a submission failed.
+    inline bool Add( const void* buffer, const size_t size, const uint64 offset )
+    {
+        if( size == 0 )
+            return true;
+
+        if( _count > 0 && ( offset != _end || _count == MAX_VECS ) && !Flush() )
+            return false;
+
+        if( _count == 0 )
+        {
+            _offset = offset;
+            _end    = offset;
+        }
+
+        _vecs[_count++] = { const_cast<void*>( buffer ), size };
+        _end  += size;
+        return true;
+    }
+
+    // Submits the pending run, if any. Returns false if the submission failed.
+    inline bool Flush()
+    {
+        if( _count == 0 )
+            return true;
+
+        const size_t  size = (size_t)( _end - _offset );
+        const ssize_t r    = _isWrite ? _file.WriteV( _vecs, _count, _offset ) : _file.ReadV( _vecs, _count, _offset );
+
+        _count = 0;
+
+        if( r != (ssize_t)size )
+        {
+            _error = r < 0 ? _file.GetError() : -1;
+            return false;
+        }
+
+        return true;
+    }
+
+    inline int Error() const { return _error; }
+
+private:
+    FileStream& _file;
+    FileIOVec   _vecs[MAX_VECS];
+    uint32      _count   = 0;
+    uint64      _offset  = 0;
+    uint64      _end     = 0;
+    int         _error   = 0;
+    bool        _isWrite;
+};
+
+// FileIOBatch is backed by io_uring on Linux and by an I/O completion port on Windows
+#if PLATFORM_IS_LINUX || PLATFORM_IS_WINDOWS
+    #define BB_HAS_FILE_IO_BATCH 1
+#endif
+
+#if BB_HAS_FILE_IO_BATCH
+
+///
+/// Batches positional reads and writes, possibly across many files, and hands
+/// them to the kernel in a single io_uring submission. Submit() blocks until
+/// every queued request has completed.
+/// Requests whose buffer falls within a region registered with RegisterBuffer()
+/// use fixed-buffer ops, so the kernel doesn't have to map those pages on each request.
+/// On Windows, requests are issued as overlapped I/O on a second handle to each file,
+/// and their completions are reaped from an I/O completion port.
+/// Not thread-safe: a batch is expected to be owned by a single I/O thread.
+///
+class FileIOBatch
+{
+public:
+    inline FileIOBatch() {}
+    ~FileIOBatch();
+
+    // Returns false if io_uring (or the completion port) is not supported or not permitted on this system.
+    bool Init( uint32 queueDepth = 64 );
+
+    inline bool IsInitialized() const { return _ring != nullptr; }
+
+    // Registers a memory region for fixed-buffer I/O, replacing any previously registered one.
+    // Fails if the region can't be pinned (ex. due to RLIMIT_MEMLOCK),
+    // in which case requests simply use regular ops. Always fails on Windows.
+    bool RegisterBuffer( void* buffer, size_t size );
+    void UnregisterBuffer();
+
+    // Queue a request at an explicit file offset.
+    // The file's position is set past the end of the request.
+    // Returns the request's index in the batch.
+    uint32 Read ( FileStream& file, void* buffer, size_t size, uint64 offset );
+    uint32 Write( FileStream& file, const void* buffer, size_t size, uint64 offset );
+
+    // Queue a request at the file's current position, advancing it.
+    uint32 Read ( FileStream& file, void* buffer, size_t size );
+    uint32 Write( FileStream& file, const void* buffer, size_t size );
+
+    // Submit all queued requests and wait for them to complete.
+    // Short transfers are re-issued for the remainder, except reads that reach end-of-file.
+    // On failure, returns false and the error of the first failed request.
+    // No new requests are issued after a failure, but the ones already issued are waited for.
+    // The batch is empty after this call, whether it succeeded or not.
+    bool Submit( int& outError );
+
+    // Bytes transferred by a request in the last submission
+    size_t BytesTransferred( uint32 request ) const;
+
+    inline uint32 Count() const { return _count; }
+
+    // Depth of the submission ring
+    uint32 QueueDepth() const;
+
+    // Limit how many requests Submit() keeps in flight at once. 0 means the full queue depth.
+    inline void   SetMaxInFlight( const uint32 maxInFlight ) { _maxInFlight = maxInFlight; }
+    inline uint32 MaxInFlight() const { return _maxInFlight; }
+
+private:
+    uint32 Enqueue( FileStream& file, void* buffer, size_t size, uint64 offset, bool isWrite );
+
+private:
+    struct Ring;
+    struct Request;
+
+    Ring*    _ring          = nullptr;
+    Request* _requests      = nullptr;
+    uint32   _count         = 0;
+    uint32   _capacity      = 0;
+    uint32   _maxInFlight   = 0;
+
+    byte*    _fixedBuffer   = nullptr;
+    size_t   _fixedSize     = 0;
+};
+
+#endif // BB_HAS_FILE_IO_BATCH
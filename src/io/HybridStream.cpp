@@ -82,6 +82,7 @@ ssize_t HybridStream::Read( void* buffer, size_t size )
 
         _position += (size_t)diskRead;
         read      += (size_t)diskRead;
+        _diskRead += (uint64)diskRead;
     }
 
     return (ssize_t)read;
@@ -130,8 +131,9 @@ ssize_t HybridStream::Write( const void* buffer, size_t size )
             return diskWritten;
         }
 
-        _position += (size_t)diskWritten;
-        written   += (size_t)diskWritten;
+        _position    += (size_t)diskWritten;
+        written      += (size_t)diskWritten;
+        _diskWritten += (uint64)diskWritten;
     }
     
     return (ssize_t)written;
@@ -32,10 +32,16 @@ public:
 
     FileStream& File() { return _file; }
 
+    // Bytes that went to or came from the backing file, rather than memory, since construction
+    inline uint64 DiskBytesRead()    const { return _diskRead; }
+    inline uint64 DiskBytesWritten() const { return _diskWritten; }
+
 private:
     FileStream _file;                       // Backing file
     byte*      _memory        = nullptr;    // Memory buffer
     size_t     _memSize       = 0;
     size_t     _position      = 0;    
     int        _error         = 0;
+    uint64     _diskRead      = 0;
+    uint64     _diskWritten   = 0;
 };
\ No newline at end of file
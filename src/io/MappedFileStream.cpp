@@ -0,0 +1,233 @@
+#include "MappedFileStream.h"
+#include "FileStream.h"
+#include "threading/MTJob.h"
+#include "util/Util.h"
+
+#if PLATFORM_IS_WINDOWS
+    #include <Windows.h>
+#else
+    #include <sys/mman.h>
+#endif
+
+//-----------------------------------------------------------
+MappedFileStream::~MappedFileStream()
+{
+    Close();
+}
+
+//-----------------------------------------------------------
+bool MappedFileStream::Open( const char* path )
+{
+    ASSERT( path );
+    if( !path || IsOpen() )
+    {
+        _error = -1;    // #TODO: Set proper user error.
+        return false;
+    }
+
+    FileStream file;
+    if( !file.Open( path, FileMode::Open, FileAccess::Read ) )
+    {
+        _error = file.GetError();
+        return false;
+    }
+
+    const ssize_t fileSize = file.Size();
+    if( fileSize <= 0 )
+    {
+        _error = fileSize < 0 ? file.GetError() : -1;   // #TODO: Set proper user error for empty files.
+        return false;
+    }
+
+    // The mapping stays valid after the file is closed
+    #if PLATFORM_IS_WINDOWS
+        HANDLE mapping = CreateFileMappingW( (HANDLE)file.Id(), nullptr, PAGE_READONLY, 0, 0, nullptr );
+        if( !mapping )
+        {
+            _error = (int)GetLastError();
+            return false;
+        }
+
+        void* bytes = MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+        if( !bytes )
+            _error = (int)GetLastError();
+
+        CloseHandle( mapping );
+
+        if( !bytes )
+            return false;
+    #else
+        void* bytes = mmap( nullptr, (size_t)fileSize, PROT_READ, MAP_SHARED, (int)file.Id(), 0 );
+        if( bytes == MAP_FAILED )
+        {
+            _error = errno;
+            return false;
+        }
+
+        // Back the mapping with huge pages where the kernel supports it for file mappings,
+        // which cuts down on TLB misses over large files. This is only a hint, so errors are ignored.
+        #ifdef MADV_HUGEPAGE
+            madvise( bytes, (size_t)fileSize, MADV_HUGEPAGE );
+        #endif
+    #endif
+
+    _bytes    = Span<byte>( (byte*)bytes, (size_t)fileSize );
+    _position = 0;
+    return true;
+}
+
+//-----------------------------------------------------------
+void MappedFileStream::Close()
+{
+    if( !_bytes.values )
+        return;
+
+    #if PLATFORM_IS_WINDOWS
+        UnmapViewOfFile( _bytes.values );
+    #else
+        munmap( _bytes.values, _bytes.length );
+    #endif
+
+    _bytes    = {};
+    _position = 0;
+}
+
+//-----------------------------------------------------------
+bool MappedFileStream::Prefetch( ThreadPool& pool, const uint32 threadCount )
+{
+    if( !IsOpen() )
+        return false;
+
+    const size_t pageSize  = SysHost::GetPageSize();
+    const uint64 pageCount = CDiv( _bytes.length, (int)pageSize );
+
+    std::atomic<int> error = 0;
+
+    AnonMTJob::RunRanges( pool, threadCount, pageCount, [&]( AnonMTJob* self, const uint64 offset, const uint64 count ) {
+
+        byte*        start = _bytes.values + offset * pageSize;
+        const size_t size  = std::min( (size_t)count * pageSize, _bytes.length - (size_t)offset * pageSize );
+
+        #ifdef MADV_POPULATE_READ
+            // Faults the whole range in with a single call
+            if( madvise( start, size, MADV_POPULATE_READ ) == 0 )
+                return;
+
+            // Older kernels don't know about it, touch the pages instead
+            if( errno != EINVAL )
+            {
+                error = errno;
+                return;
+            }
+        #endif
+
+        uint64 sum = 0;
+        for( size_t i = 0; i < size; i += pageSize )
+            sum += ((volatile byte*)start)[i];
+
+        (void)sum;
+    });
+
+    if( error != 0 )
+    {
+        _error = error;
+        return false;
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------
+ssize_t MappedFileStream::Read( void* buffer, const size_t size )
+{
+    if( size < 1 || !buffer )
+        return 0;
+
+    const size_t endPos = (size_t)_position + size;
+
+    if( endPos > _bytes.length )
+    {
+        _error = -1;    // #TODO: Set proper user error.
+        return -1;
+    }
+
+    memcpy( buffer, _bytes.values + _position, size );
+    _position = (ssize_t)endPos;
+
+    return (ssize_t)size;
+}
+
+//-----------------------------------------------------------
+ssize_t MappedFileStream::Write( const void* buffer, const size_t size )
+{
+    _error = -1;    // #TODO: Set proper user error.
+    return -1;
+}
+
+//-----------------------------------------------------------
+bool MappedFileStream::Seek( const int64 offset, const SeekOrigin origin )
+{
+    ssize_t absPosition = 0;
+
+    switch( origin )
+    {
+        case SeekOrigin::Begin:
+            absPosition = offset;
+            break;
+
+        case SeekOrigin::Current:
+            absPosition = _position + offset;
+            break;
+
+        case SeekOrigin::End:
+            absPosition = (ssize_t)_bytes.length + offset;
+            break;
+
+        default:
+            _error = -1;    // #TODO: Set proper user error.
+            return false;
+    }
+
+    if( absPosition < 0 || absPosition > (ssize_t)_bytes.length )
+    {
+        _error = -1;    // #TODO: Set proper user error.
+        return false;
+    }
+
+    _position = absPosition;
+    return true;
+}
+
+//-----------------------------------------------------------
+bool MappedFileStream::Flush()
+{
+    return true;
+}
+
+//-----------------------------------------------------------
+size_t MappedFileStream::BlockSize() const
+{
+    return SysHost::GetPageSize();
+}
+
+//-----------------------------------------------------------
+ssize_t MappedFileStream::Size()
+{
+    return (ssize_t)_bytes.length;
+}
+
+//-----------------------------------------------------------
+bool MappedFileStream::Truncate( const ssize_t length )
+{
+    _error = -1;    // #TODO: Set proper user error.
+    return false;
+}
+
+//-----------------------------------------------------------
+int MappedFileStream::GetError()
+{
+    const int err = _error;
+    _error = 0;
+
+    return err;
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include "IStream.h"
+#include "util/Span.h"
+
+class ThreadPool;
+
+// A read-only stream over a file that is mapped into memory.
+// Nothing is read on open: pages are faulted in by the OS as they are touched,
+// or ahead of time, in parallel, with Prefetch(). The mapped bytes can be used
+// directly through Data(), without copying them out.
+class MappedFileStream : public IStream
+{
+public:
+    MappedFileStream() = default;
+    ~MappedFileStream();
+
+    MappedFileStream( const MappedFileStream& ) = delete;
+    MappedFileStream& operator=( const MappedFileStream& ) = delete;
+
+    bool Open( const char* path );
+    void Close();
+
+    inline bool IsOpen() const { return _bytes.values != nullptr; }
+
+    inline const byte* Data() const { return _bytes.values; }
+
+    // Loads the whole mapping into memory by having threadCount threads fault its pages in.
+    bool Prefetch( ThreadPool& pool, uint32 threadCount );
+
+    ssize_t Read( void* buffer, size_t size ) override;
+
+    // The mapping is read-only, writes always fail
+    ssize_t Write( const void* buffer, size_t size ) override;
+
+    bool Seek( int64 offset, SeekOrigin origin ) override;
+
+    bool Flush() override;
+
+    size_t BlockSize() const override;
+
+    ssize_t Size() override;
+
+    bool Truncate( const ssize_t length ) override;
+
+    int GetError() override;
+
+private:
+    Span<byte> _bytes    = {};
+    ssize_t    _position = 0;
+    int        _error    = 0;
+};
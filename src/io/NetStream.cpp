@@ -0,0 +1,535 @@
+#include "NetStream.h"
+#include "util/Util.h"
+
+#if PLATFORM_IS_WINDOWS
+    #include <winsock2.h>
+    #include <ws2tcpip.h>
+    #include <mutex>
+
+    typedef int socklen_t;
+#else
+    #include <sys/socket.h>
+    #include <netinet/in.h>
+    #include <netinet/tcp.h>
+    #include <netdb.h>
+    #include <errno.h>
+#endif
+
+static void InitSockets();
+static bool ParseAddress( const std::string& addr, std::string& outHost, uint16& outPort, std::string& outDir );
+
+//-----------------------------------------------------------
+NetStream::~NetStream()
+{
+    Close();
+}
+
+//-----------------------------------------------------------
+bool NetStream::IsNetPath( const char* path )
+{
+    return path && strncmp( path, PATH_PREFIX, strlen( PATH_PREFIX ) ) == 0;
+}
+
+//-----------------------------------------------------------
+bool NetStream::ParsePath( const char* path, std::string& outToken, std::string& outHost, uint16& outPort, std::string& outDir )
+{
+    if( !IsNetPath( path ) )
+        return false;
+
+    std::string addr = path + strlen( PATH_PREFIX );
+
+    const size_t dirStart = std::min( addr.find( '/' ), addr.size() );
+    const size_t at       = addr.rfind( '@', dirStart );
+
+    outToken.clear();
+    if( at != std::string::npos )
+    {
+        if( at == 0 || at > MAX_TOKEN_SIZE )
+            return false;
+
+        outToken = addr.substr( 0, at );
+        addr     = addr.substr( at + 1 );
+    }
+
+    return ParseAddress( addr, outHost, outPort, outDir );
+}
+
+//-----------------------------------------------------------
+bool NetStream::IsValidRemotePath( const std::string& path )
+{
+    // A relative path under the root directory, to a .tmp plot file
+    if( path.empty() || path[0] == '/' || path[0] == '\\' || path.find( ':' ) != std::string::npos )
+        return false;
+
+    // The file is opened with the path as a C string, which would end at an embedded NUL,
+    // after the checks below were made on the whole path. No control characters in file names either.
+    for( const char c : path )
+    {
+        if( (byte)c < 0x20 || (byte)c == 0x7F )
+            return false;
+    }
+
+    if( path.size() <= 4 || path.compare( path.size() - 4, 4, ".tmp" ) != 0 )
+        return false;
+
+    size_t start = 0;
+    for( ;; )
+    {
+        const size_t end = path.find_first_of( "/\\", start );
+        if( path.compare( start, end == std::string::npos ? std::string::npos : end - start, ".." ) == 0 )
+            return false;
+
+        if( end == std::string::npos )
+            break;
+        start = end + 1;
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------
+bool ParseAddress( const std::string& addr, std::string& outHost, uint16& outPort, std::string& outDir )
+{
+    const size_t dirStart = std::min( addr.find( '/' ), addr.size() );
+    const size_t colon    = addr.rfind( ':', dirStart );
+
+    if( colon == std::string::npos || colon == 0 || colon + 1 >= dirStart )
+        return false;
+
+    const std::string portStr = addr.substr( colon + 1, dirStart - colon - 1 );
+    char* end = nullptr;
+    const unsigned long port = strtoul( portStr.c_str(), &end, 10 );
+
+    if( *end != 0 || port == 0 || port > 0xFFFF )
+        return false;
+
+    outHost = addr.substr( 0, colon );
+    outPort = (uint16)port;
+
+    // Strip the slashes around the directory
+    size_t dirBegin = dirStart;
+    size_t dirEnd   = addr.size();
+
+    while( dirBegin < dirEnd && addr[dirBegin] == '/' )
+        dirBegin++;
+    while( dirEnd > dirBegin && ( addr[dirEnd-1] == '/' || addr[dirEnd-1] == '\\' ) )
+        dirEnd--;
+
+    outDir = addr.substr( dirBegin, dirEnd - dirBegin );
+    return true;
+}
+
+//-----------------------------------------------------------
+bool NetStream::Open( const char* path, const char* fileName )
+{
+    ASSERT( !IsOpen() );
+
+    std::string token, host, dir;
+    uint16      port = 0;
+
+    if( !ParsePath( path, token, host, port, dir ) )
+    {
+        _error = -1;
+        return false;
+    }
+
+    int32 err = 0;
+    _socket = Connect( host.c_str(), port, err );
+
+    if( _socket == InvalidSocket )
+    {
+        _error = err;
+        return false;
+    }
+
+    const std::string filePath = dir.empty() ? std::string( fileName ) : dir + '/' + fileName;
+
+    // The receiver drops the connection on a wrong token, which fails the Open reply
+    const bool authOk = token.empty() || SendMessage( MessageType::Auth, 0, token.size(), token.c_str() );
+
+    Reply reply = {};
+    if( !authOk || !SendMessage( MessageType::Open, 0, filePath.size(), filePath.c_str() ) || !ReceiveReply( reply ) || reply.error != 0 )
+    {
+        if( _error == 0 )
+            _error = reply.error;
+
+        CloseSocket( _socket );
+        _socket = InvalidSocket;
+        return false;
+    }
+
+    _position = 0;
+    _size     = 0;
+    return true;
+}
+
+//-----------------------------------------------------------
+bool NetStream::Finish( const bool rename )
+{
+    ASSERT( IsOpen() );
+
+    Reply reply = {};
+    const bool r = SendMessage( MessageType::Finish, rename ? 1 : 0, 0 ) && ReceiveReply( reply ) && reply.error == 0;
+
+    if( !r && _error == 0 )
+        _error = reply.error;
+
+    Close();
+    return r;
+}
+
+//-----------------------------------------------------------
+void NetStream::Close()
+{
+    if( !IsOpen() )
+        return;
+
+    CloseSocket( _socket );
+    _socket   = InvalidSocket;
+    _position = 0;
+    _size     = 0;
+}
+
+//-----------------------------------------------------------
+ssize_t NetStream::Read( void* buffer, size_t size )
+{
+    ASSERT( IsOpen() );
+
+    byte*  dst       = (byte*)buffer;
+    size_t totalRead = 0;
+
+    while( size > 0 )
+    {
+        const size_t  chunkSize = std::min( size, MAX_MESSAGE_SIZE );
+        const ssize_t read      = ReadChunk( dst, chunkSize );
+
+        if( read < 0 )
+            return totalRead > 0 ? (ssize_t)totalRead : -1;
+
+        totalRead += (size_t)read;
+        dst       += read;
+        size      -= (size_t)read;
+
+        if( (size_t)read < chunkSize )
+            break;
+    }
+
+    return (ssize_t)totalRead;
+}
+
+//-----------------------------------------------------------
+ssize_t NetStream::ReadChunk( void* buffer, size_t size )
+{
+    Reply reply;
+    if( !SendMessage( MessageType::Read, _position, size ) || !ReceiveReply( reply ) )
+        return -1;
+
+    if( reply.error != 0 || reply.size > size )
+    {
+        _error = reply.error != 0 ? reply.error : -1;
+        return -1;
+    }
+
+    if( !RecvAll( _socket, buffer, (size_t)reply.size ) )
+    {
+        _error = LastError();
+        return -1;
+    }
+
+    _position += (size_t)reply.size;
+    return (ssize_t)reply.size;
+}
+
+//-----------------------------------------------------------
+ssize_t NetStream::Write( const void* buffer, size_t size )
+{
+    ASSERT( IsOpen() );
+
+    const byte* src     = (const byte*)buffer;
+    size_t      written = 0;
+
+    while( written < size )
+    {
+        const size_t chunkSize = std::min( size - written, MAX_MESSAGE_SIZE );
+
+        if( !SendMessage( MessageType::Write, _position, chunkSize, src + written ) )
+            return written > 0 ? (ssize_t)written : -1;
+
+        written   += chunkSize;
+        _position += chunkSize;
+        _size      = std::max( _size, _position );
+    }
+
+    return (ssize_t)size;
+}
+
+//-----------------------------------------------------------
+bool NetStream::Seek( int64 offset, SeekOrigin origin )
+{
+    if( origin == SeekOrigin::Current )
+        offset += (int64)_position;
+    else if( origin == SeekOrigin::End )
+        offset += (int64)_size;
+
+    if( offset < 0 )
+    {
+        _error = -1;
+        return false;
+    }
+
+    _position = (size_t)offset;
+    return true;
+}
+
+//-----------------------------------------------------------
+bool NetStream::Flush()
+{
+    ASSERT( IsOpen() );
+
+    Reply reply;
+    if( !SendMessage( MessageType::Flush, 0, 0 ) || !ReceiveReply( reply ) )
+        return false;
+
+    if( reply.error != 0 )
+    {
+        _error = reply.error;
+        return false;
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------
+bool NetStream::Truncate( const ssize_t length )
+{
+    ASSERT( IsOpen() );
+
+    if( length < 0 || !SendMessage( MessageType::Truncate, (uint64)length, 0 ) )
+        return false;
+
+    _size = (size_t)length;
+    return true;
+}
+
+//-----------------------------------------------------------
+bool NetStream::SendMessage( const MessageType type, const uint64 offset, const uint64 size, const void* payload )
+{
+    const Message msg = { MAGIC, type, offset, size };
+
+    const bool r = SendAll( _socket, &msg, sizeof( msg ) ) &&
+                   ( !payload || SendAll( _socket, payload, (size_t)size ) );
+
+    if( !r )
+        _error = LastError();
+
+    return r;
+}
+
+//-----------------------------------------------------------
+bool NetStream::ReceiveReply( Reply& outReply )
+{
+    outReply = {};
+
+    if( !RecvAll( _socket, &outReply, sizeof( outReply ) ) )
+    {
+        _error = LastError();
+        return false;
+    }
+
+    return true;
+}
+
+
+///
+/// Sockets
+///
+
+//-----------------------------------------------------------
+void InitSockets()
+{
+#if PLATFORM_IS_WINDOWS
+    static std::once_flag initFlag;
+    std::call_once( initFlag, []() {
+        WSADATA data;
+        FatalIf( WSAStartup( MAKEWORD( 2, 2 ), &data ) != 0, "Failed to initialize Winsock." );
+    });
+#endif
+}
+
+//-----------------------------------------------------------
+intptr_t NetStream::Connect( const char* host, const uint16 port, int32& outError )
+{
+    InitSockets();
+
+    addrinfo hints = {};
+    hints.ai_family   = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_protocol = IPPROTO_TCP;
+
+    char portStr[8];
+    snprintf( portStr, sizeof( portStr ), "%u", (uint)port );
+
+    addrinfo* addresses = nullptr;
+    const int gaiErr = getaddrinfo( host, portStr, &hints, &addresses );
+    if( gaiErr != 0 )
+    {
+        outError = gaiErr;
+        return InvalidSocket;
+    }
+
+    intptr_t sock = InvalidSocket;
+
+    for( addrinfo* a = addresses; a; a = a->ai_next )
+    {
+        sock = (intptr_t)socket( a->ai_family, a->ai_socktype, a->ai_protocol );
+        if( sock == InvalidSocket )
+            continue;
+
+        if( connect( sock, a->ai_addr, (socklen_t)a->ai_addrlen ) == 0 )
+            break;
+
+        outError = LastError();
+        CloseSocket( sock );
+        sock = InvalidSocket;
+    }
+
+    freeaddrinfo( addresses );
+
+    if( sock == InvalidSocket )
+        return InvalidSocket;
+
+    // Small messages (replies, headers) must not wait on Nagle's algorithm
+    int noDelay = 1;
+    setsockopt( sock, IPPROTO_TCP, TCP_NODELAY, (const char*)&noDelay, sizeof( noDelay ) );
+
+    return sock;
+}
+
+//-----------------------------------------------------------
+intptr_t NetStream::Listen( const char* bindAddress, const uint16 port, int32& outError )
+{
+    InitSockets();
+
+    addrinfo hints = {};
+    hints.ai_family   = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_protocol = IPPROTO_TCP;
+    hints.ai_flags    = AI_PASSIVE;
+
+    char portStr[8];
+    snprintf( portStr, sizeof( portStr ), "%u", (uint)port );
+
+    addrinfo* addresses = nullptr;
+    const int gaiErr = getaddrinfo( bindAddress, portStr, &hints, &addresses );
+    if( gaiErr != 0 )
+    {
+        outError = gaiErr;
+        return InvalidSocket;
+    }
+
+    intptr_t sock = InvalidSocket;
+
+    for( addrinfo* a = addresses; a; a = a->ai_next )
+    {
+        sock = (intptr_t)socket( a->ai_family, a->ai_socktype, a->ai_protocol );
+        if( sock == InvalidSocket )
+            continue;
+
+        int off = 0, on = 1;
+        setsockopt( sock, SOL_SOCKET, SO_REUSEADDR, (const char*)&on, sizeof( on ) );
+
+        // When bound to the IPv6 wildcard address, accept IPv4 connections as well
+        if( a->ai_family == AF_INET6 )
+            setsockopt( sock, IPPROTO_IPV6, IPV6_V6ONLY, (const char*)&off, sizeof( off ) );
+
+        if( bind( sock, a->ai_addr, (socklen_t)a->ai_addrlen ) == 0 && listen( sock, 16 ) == 0 )
+            break;
+
+        outError = LastError();
+        CloseSocket( sock );
+        sock = InvalidSocket;
+    }
+
+    freeaddrinfo( addresses );
+    return sock;
+}
+
+//-----------------------------------------------------------
+intptr_t NetStream::Accept( const intptr_t listenSocket )
+{
+    const intptr_t sock = (intptr_t)accept( listenSocket, nullptr, nullptr );
+
+    if( sock != InvalidSocket )
+    {
+        int noDelay = 1;
+        setsockopt( sock, IPPROTO_TCP, TCP_NODELAY, (const char*)&noDelay, sizeof( noDelay ) );
+    }
+
+    return sock;
+}
+
+//-----------------------------------------------------------
+bool NetStream::SendAll( const intptr_t socket, const void* data, size_t size )
+{
+    const char* src = (const char*)data;
+
+    #if PLATFORM_IS_WINDOWS
+        const int flags = 0;
+    #else
+        const int flags = MSG_NOSIGNAL;     // A closed connection is reported as an error instead
+    #endif
+
+    while( size > 0 )
+    {
+        const int     chunk = (int)std::min( size, (size_t)(1 << 30) );
+        const ssize_t sent  = (ssize_t)send( socket, src, chunk, flags );
+
+        if( sent <= 0 )
+            return false;
+
+        src  += sent;
+        size -= (size_t)sent;
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------
+bool NetStream::RecvAll( const intptr_t socket, void* data, size_t size )
+{
+    char* dst = (char*)data;
+
+    while( size > 0 )
+    {
+        const int     chunk    = (int)std::min( size, (size_t)(1 << 30) );
+        const ssize_t received = (ssize_t)recv( socket, dst, chunk, 0 );
+
+        if( received <= 0 )
+            return false;
+
+        dst  += received;
+        size -= (size_t)received;
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------
+void NetStream::CloseSocket( const intptr_t socket )
+{
+    #if PLATFORM_IS_WINDOWS
+        closesocket( (SOCKET)socket );
+    #else
+        close( (int)socket );
+    #endif
+}
+
+//-----------------------------------------------------------
+int32 NetStream::LastError()
+{
+    #if PLATFORM_IS_WINDOWS
+        return (int32)WSAGetLastError();
+    #else
+        return errno != 0 ? (int32)errno : -1;
+    #endif
+}
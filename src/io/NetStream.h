@@ -0,0 +1,117 @@
+#pragma once
+#include "IStream.h"
+#include "util/Util.h"
+#include <string>
+
+/**
+ * A plot file written over TCP to a 'bladebit receive' instance running on the harvester,
+ * given as an output directory of the form tcp://[<token>@]<host>:<port>/[<dir>/].
+ * When a token is given, it is sent ahead of the Open message for receivers that require one.
+ * Each write carries its file offset, so the plot writer can still seek back to
+ * fill in the header's table pointers, and the receiver applies it to its file as it arrives.
+ * Reads are answered by the receiver. The plot writer only issues them for the partial
+ * block it seeks into. Open, Flush and Finish wait for the receiver's reply,
+ * which also reports any earlier write that failed on its side.
+ */
+class NetStream : public IStream
+{
+public:
+    static constexpr const char* PATH_PREFIX  = "tcp://";
+    static constexpr size_t      BLOCK_SIZE   = 4096;
+    static constexpr uint32      MAGIC        = 0x4E504242;    // 'BBPN'
+    static constexpr intptr_t    InvalidSocket = -1;
+
+    // Largest payload of a single message. Larger reads and writes are split into several messages.
+    static constexpr size_t      MAX_MESSAGE_SIZE = 4 MiB;
+    static constexpr size_t      MAX_TOKEN_SIZE   = 256;
+
+    enum class MessageType : uint32
+    {
+        None = 0,
+        Open,       // Payload: the file path, relative to the receiver's root directory. Replied.
+        Write,      // Payload: size bytes to write at offset
+        Read,       // Read size bytes at offset. Replied, followed by the data.
+        Truncate,   // Set the file size to offset
+        Flush,      // Sync the file. Replied.
+        Finish,     // Close the file, removing its .tmp extension if offset is 1. Replied.
+        Auth,       // Payload: the shared token. Must be the first message when the receiver requires one.
+    };
+
+    struct Message
+    {
+        uint32      magic;
+        MessageType type;
+        uint64      offset;
+        uint64      size;
+    };
+
+    struct Reply
+    {
+        int32  error;   // 0, or the receiver's error for this message or an earlier one
+        uint32 _reserved;
+        uint64 size;    // Bytes of data following the reply
+    };
+
+    inline NetStream() {}
+    ~NetStream() override;
+
+    static bool IsNetPath( const char* path );
+
+    // Splits tcp://[<token>@]<host>:<port>/[<dir>/] into its parts. dir is returned without slashes around it.
+    static bool ParsePath( const char* path, std::string& outToken, std::string& outHost, uint16& outPort, std::string& outDir );
+
+    // Whether a path sent by a writer is a relative path to a .tmp file, which can't escape the receiver's root directory
+    static bool IsValidRemotePath( const std::string& path );
+
+    // Connects to the receiver of path and creates <dir>/<fileName> under its root directory
+    bool Open( const char* path, const char* fileName );
+
+    // Completes the remote file, renaming it to its name without the .tmp extension if rename is set,
+    // and closes the stream. Returns false if the receiver reported any error for the file.
+    bool Finish( bool rename );
+
+    void Close();
+
+    inline bool IsOpen() const { return _socket != InvalidSocket; }
+
+    ssize_t Read( void* buffer, size_t size ) override;
+
+    ssize_t Write( const void* buffer, size_t size ) override;
+
+    bool Seek( int64 offset, SeekOrigin origin ) override;
+
+    bool Flush() override;
+
+    inline size_t BlockSize() const override { return BLOCK_SIZE; }
+
+    inline ssize_t Size() override { return (ssize_t)_size; }
+
+    bool Truncate( const ssize_t length ) override;
+
+    inline int GetError() override
+    {
+        const int err = _error;
+        _error = 0;
+        return err;
+    }
+
+    // Socket helpers, also used by the receiver
+    static intptr_t Connect( const char* host, uint16 port, int32& outError );
+    static intptr_t Listen( const char* bindAddress, uint16 port, int32& outError );
+    static intptr_t Accept( intptr_t listenSocket );
+    static bool     SendAll( intptr_t socket, const void* data, size_t size );
+    static bool     RecvAll( intptr_t socket, void* data, size_t size );
+    static void     CloseSocket( intptr_t socket );
+    static int32    LastError();
+
+private:
+    bool SendMessage( MessageType type, uint64 offset, uint64 size, const void* payload = nullptr );
+    ssize_t ReadChunk( void* buffer, size_t size );
+    bool ReceiveReply( Reply& outReply );
+
+private:
+    intptr_t _socket   = InvalidSocket;
+    size_t   _position = 0;
+    size_t   _size     = 0;     // Remote file size, as written by us
+    int      _error    = 0;
+};
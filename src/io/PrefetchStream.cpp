@@ -0,0 +1,314 @@
+#include "PrefetchStream.h"
+#include "threading/Thread.h"
+#include "threading/ThreadAffinity.h"
+#include "util/Util.h"
+
+//-----------------------------------------------------------
+PrefetchStream::PrefetchStream( IStream& source, const uint32 depth, const size_t chunkSize )
+    : _source   ( source )
+    , _depth    ( std::max( depth, 1u ) )
+    , _blockSize( std::max( source.BlockSize(), (size_t)1 ) )
+{
+    // Chunks start and end at block boundaries, so that sources opened with direct I/O can be read too
+    _chunkSize = RoundUpToNextBoundaryT( std::max( chunkSize, _blockSize ), _blockSize );
+
+    _slots = new Slot[_depth];
+    for( uint32 i = 0; i < _depth; i++ )
+        _slots[i].buffer = bbvirtalloc<byte>( _chunkSize );
+}
+
+//-----------------------------------------------------------
+PrefetchStream::~PrefetchStream()
+{
+    if( _thread )
+    {
+        {
+            std::unique_lock<std::mutex> lock( _lock );
+            _exit = true;
+        }
+        _signal.notify_all();
+
+        _thread->WaitForExit();
+        delete _thread;
+    }
+
+    for( uint32 i = 0; i < _depth; i++ )
+        bbvirtfree( _slots[i].buffer );
+
+    delete[] _slots;
+}
+
+//-----------------------------------------------------------
+void PrefetchStream::Start( const uint64 offset, const uint64 length )
+{
+    std::unique_lock<std::mutex> lock( _lock );
+
+    _regionEnd = offset + length;
+    Restart( offset );
+
+    if( !_thread )
+    {
+        _thread = new Thread();
+        _thread->Run( ReaderThreadEntry, this );
+    }
+}
+
+//-----------------------------------------------------------
+void PrefetchStream::Restart( const uint64 offset )
+{
+    _generation++;
+
+    for( uint32 i = 0; i < _depth; i++ )
+        _slots[i].state = SlotState::Empty;
+
+    _position    = offset;
+    _readAddress = offset - offset % _blockSize;
+    _readSlot    = 0;
+    _consumeSlot = 0;
+    _error       = 0;
+
+    _signal.notify_all();
+}
+
+//-----------------------------------------------------------
+ssize_t PrefetchStream::Read( void* buffer, const size_t size )
+{
+    ASSERT( buffer );
+
+    std::unique_lock<std::mutex> lock( _lock );
+
+    size_t copied = 0;
+    while( copied < size )
+    {
+        Slot* slot = AcquireSlot( lock );
+        if( !slot )
+            break;
+
+        const uint64 slotEnd = slot->address + slot->size;
+
+        if( _position < slotEnd )
+        {
+            const size_t copySize = (size_t)std::min( (uint64)( size - copied ), slotEnd - _position );
+            const byte*  src      = slot->buffer + ( _position - slot->address );
+
+            // The slot is ours until we release it, so the copy doesn't need the lock
+            lock.unlock();
+            memcpy( (byte*)buffer + copied, src, copySize );
+            lock.lock();
+
+            copied    += copySize;
+            _position += copySize;
+        }
+
+        if( _position >= slotEnd )
+            ReleaseSlot();
+    }
+
+    if( _error )
+        return -1;
+
+    return (ssize_t)copied;
+}
+
+//-----------------------------------------------------------
+PrefetchStream::Slot* PrefetchStream::AcquireSlot( std::unique_lock<std::mutex>& lock )
+{
+    if( _error || _position >= _regionEnd )
+        return nullptr;
+
+    Slot& slot = _slots[_consumeSlot];
+
+    if( slot.state == SlotState::Empty )
+    {
+        const auto timer = TimerBegin();
+        _signal.wait( lock, [&]() { return slot.state != SlotState::Empty || _position >= _regionEnd; } );
+        _waitTime += TimerEndTicks( timer );
+    }
+
+    if( slot.state == SlotState::Failed )
+    {
+        _error = slot.error;
+        return nullptr;
+    }
+
+    // The source ended before the region did
+    if( _position >= _regionEnd )
+        return nullptr;
+
+    return &slot;
+}
+
+//-----------------------------------------------------------
+void PrefetchStream::ReleaseSlot()
+{
+    _slots[_consumeSlot].state = SlotState::Empty;
+    _consumeSlot = ( _consumeSlot + 1 ) % _depth;
+
+    _signal.notify_all();
+}
+
+//-----------------------------------------------------------
+ssize_t PrefetchStream::Write( const void* buffer, size_t size )
+{
+    (void)buffer;
+    (void)size;
+
+    _error = -1;
+    return -1;
+}
+
+//-----------------------------------------------------------
+bool PrefetchStream::Seek( const int64 offset, const SeekOrigin origin )
+{
+    std::unique_lock<std::mutex> lock( _lock );
+
+    int64 target;
+    switch( origin )
+    {
+        case SeekOrigin::Begin  : target = offset; break;
+        case SeekOrigin::Current: target = (int64)_position  + offset; break;
+        case SeekOrigin::End    : target = (int64)_regionEnd + offset; break;
+        default:
+            return false;
+    }
+
+    if( target < 0 )
+        return false;
+
+    if( (uint64)target < _position || (uint64)target >= _readAddress || _error )
+    {
+        Restart( (uint64)target );
+        return true;
+    }
+
+    // Already read or being read, skip the slots before it
+    for( ;; )
+    {
+        Slot* slot = AcquireSlot( lock );
+        if( !slot )
+            break;
+
+        const uint64 slotEnd = slot->address + slot->size;
+        if( (uint64)target < slotEnd )
+            break;
+
+        _position = slotEnd;
+        ReleaseSlot();
+    }
+
+    _position = (uint64)target;
+    return _error == 0;
+}
+
+//-----------------------------------------------------------
+bool PrefetchStream::Flush()
+{
+    return true;
+}
+
+//-----------------------------------------------------------
+size_t PrefetchStream::BlockSize() const
+{
+    return _blockSize;
+}
+
+//-----------------------------------------------------------
+ssize_t PrefetchStream::Size()
+{
+    return _source.Size();
+}
+
+//-----------------------------------------------------------
+bool PrefetchStream::Truncate( const ssize_t length )
+{
+    (void)length;
+    return false;
+}
+
+//-----------------------------------------------------------
+int PrefetchStream::GetError()
+{
+    return _error;
+}
+
+//-----------------------------------------------------------
+void PrefetchStream::ReaderThreadEntry( PrefetchStream* self )
+{
+    ThreadAffinity::PinCurrentIOThread();
+    self->ReaderThreadMain();
+}
+
+//-----------------------------------------------------------
+void PrefetchStream::ReaderThreadMain()
+{
+    std::unique_lock<std::mutex> lock( _lock );
+
+    for( ;; )
+    {
+        _signal.wait( lock, [this]() {
+            return _exit || ( _readAddress < _regionEnd && _slots[_readSlot].state == SlotState::Empty );
+        });
+
+        if( _exit )
+            return;
+
+        const uint64 generation = _generation;
+        const uint64 address    = _readAddress;
+        Slot&        slot       = _slots[_readSlot];
+        const size_t readSize   = (size_t)std::min( (uint64)_chunkSize,
+                                    RoundUpToNextBoundaryT( _regionEnd - address, (uint64)_blockSize ) );
+
+        _readAddress += readSize;
+        _readSlot     = ( _readSlot + 1 ) % _depth;
+
+        // A restart while we read resets the slots, but it won't hand this
+        // buffer out again until we're done with it, since we're the only reader.
+        lock.unlock();
+
+        int    error    = 0;
+        size_t sizeRead = 0;
+
+        if( !_source.Seek( (int64)address, SeekOrigin::Begin ) )
+            error = _source.GetError() ? _source.GetError() : -1;
+        else
+        {
+            while( sizeRead < readSize )
+            {
+                const ssize_t r = _source.Read( slot.buffer + sizeRead, readSize - sizeRead );
+                if( r < 0 )
+                {
+                    error = _source.GetError() ? _source.GetError() : -1;
+                    break;
+                }
+
+                if( r == 0 )
+                    break;
+
+                sizeRead += (size_t)r;
+            }
+        }
+
+        lock.lock();
+
+        if( generation != _generation )
+            continue;
+
+        if( error )
+        {
+            slot.state = SlotState::Failed;
+            slot.error = error;
+        }
+        else
+        {
+            // Reads past the end of the source come back short, the region ends there
+            if( sizeRead < readSize )
+                _regionEnd = std::min( _regionEnd, address + sizeRead );
+
+            slot.address = address;
+            slot.size    = (size_t)( std::min( address + sizeRead, _regionEnd ) - std::min( address, _regionEnd ) );
+            slot.state   = SlotState::Ready;
+        }
+
+        _signal.notify_all();
+    }
+}
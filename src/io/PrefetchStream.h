@@ -0,0 +1,101 @@
+#pragma once
+#include "IStream.h"
+#include "util/Util.h"
+#include <mutex>
+#include <condition_variable>
+
+class Thread;
+
+///
+/// Read-only stream that reads a region of another stream ahead of its consumer on a background thread.
+/// Up to 'depth' block-aligned chunks are kept in flight or ready, so that sequential scans
+/// overlap their processing with the disk instead of waiting on each Read().
+/// The source stream must not be used by anyone else while the read-ahead is running.
+///
+class PrefetchStream : public IStream
+{
+public:
+    static constexpr uint32 DefaultDepth     = 4;
+    static constexpr size_t DefaultChunkSize = 8 MiB;
+
+    PrefetchStream( IStream& source, uint32 depth = DefaultDepth, size_t chunkSize = DefaultChunkSize );
+    ~PrefetchStream();
+
+    // Starts reading [offset, offset + length) ahead from the source.
+    // Reads stop at the end of the region, or at the end of the source, whichever is first.
+    void Start( uint64 offset, uint64 length );
+
+    ssize_t Read( void* buffer, size_t size ) override;
+
+    // Not supported
+    ssize_t Write( const void* buffer, size_t size ) override;
+
+    // Seeking forward within what has been read ahead keeps the read-ahead going.
+    // Any other seek restarts it at the new position, up to the end of the region.
+    // SeekOrigin::End is relative to the end of the region.
+    bool Seek( int64 offset, SeekOrigin origin ) override;
+
+    bool Flush() override;
+
+    size_t BlockSize() const override;
+
+    ssize_t Size() override;
+
+    bool Truncate( const ssize_t length ) override;
+
+    int GetError() override;
+
+    inline uint64 Position() const { return _position; }
+
+    // Time the consumer spent waiting on reads that had not completed yet
+    inline Duration WaitTime() const { return _waitTime; }
+
+private:
+    enum class SlotState : uint32
+    {
+        Empty = 0,  // Free for the reader thread
+        Ready,      // Filled, owned by the consumer
+        Failed
+    };
+
+    struct Slot
+    {
+        byte*     buffer  = nullptr;
+        uint64    address = 0;      // Source address of buffer[0]
+        size_t    size    = 0;      // Bytes of the region in the buffer
+        SlotState state   = SlotState::Empty;
+        int       error   = 0;
+    };
+
+    static void ReaderThreadEntry( PrefetchStream* self );
+    void ReaderThreadMain();
+
+    // Must be called with the lock held
+    void Restart( uint64 offset );
+
+    // Waits for the consumer's current slot to be read. Returns null at the end of the region.
+    Slot* AcquireSlot( std::unique_lock<std::mutex>& lock );
+
+    // Must be called with the lock held
+    void ReleaseSlot();
+
+private:
+    IStream&                _source;
+    uint32                  _depth;
+    size_t                  _chunkSize;
+    size_t                  _blockSize;
+    Slot*                   _slots       = nullptr;
+    Thread*                 _thread      = nullptr;
+
+    std::mutex              _lock;
+    std::condition_variable _signal;
+    uint64                  _generation  = 0;   // Incremented on restart, so that reads in flight are discarded
+    uint64                  _regionEnd   = 0;
+    uint64                  _readAddress = 0;   // Next chunk for the reader thread
+    uint32                  _readSlot    = 0;
+    uint32                  _consumeSlot = 0;
+    uint64                  _position    = 0;   // Consumer position in the source
+    int                     _error       = 0;
+    bool                    _exit        = false;
+    Duration                _waitTime    = Duration::zero();
+};
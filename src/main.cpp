@@ -3,11 +3,24 @@
 #include "plotdisk/DiskPlotter.h"
 #include "plotmem/MemPlotter.h"
 #include "plotting/PlotTools.h"
+#include "plotting/PlotWriter.h"
+#include "plotting/PlotBenchmark.h"
+#include "plotting/PlotIdManifest.h"
+#include "plotting/IOStats.h"
+#include "util/PerfCounters.h"
+#include "plotting/HarvestYield.h"
+#include "threading/ThreadAffinity.h"
+#include "threading/Thread.h"
+#include "util/Trace.h"
 #include "commands/Commands.h"
 #include "Version.h"
+#include <mutex>
+#include <vector>
 
 #if PLATFORM_IS_UNIX
     #include <sys/resource.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
 #endif
 
 #if BB_CUDA_ENABLED
@@ -15,7 +28,42 @@
 #endif
 
 static void ParseCommandLine( GlobalPlotConfig& cfg, IPlotter*& outPlotter, int argc, const char* argv[] );
+static void ParseKeys( GlobalPlotConfig& cfg, const char* farmerPublicKey, const char* poolPublicKey, const char* poolContractAddress );
 static void PrintUsage();
+static void PlotBenchmarkPrintUsage();
+
+struct MultiInstance;
+
+// Creates cfg.plotCount plots with the current config.
+// instance is given when running as one of several plotters (see the 'multi' command).
+static void RunPlots( GlobalPlotConfig& cfg, IPlotter& plotter, bool& isFirstPlot, MultiInstance* instance = nullptr );
+
+// Creates a plotter if the current argument is a plotter command, and consumes it
+static IPlotter* ConsumePlotterCommand( const GlobalPlotConfig& cfg, CliParser& cli, bool& outIsRamplot );
+
+// Parses the remaining arguments as output directories
+static void ParseOutputFolders( GlobalPlotConfig& cfg, CliParser& cli );
+
+// Keeps the plotter resident and creates plots for requests read from cfg.servePath
+static void ServePlotRequests( GlobalPlotConfig& cfg, IPlotter& plotter );
+
+// Plot ids pre-generated with the 'gen-ids' command, given with --ids
+static PlotIdManifest* _plotIds = nullptr;
+static std::mutex      _plotIdsLock;      // Plotters running with 'multi' share the manifest
+
+// Plotters run side by side with the 'multi' command. Empty otherwise.
+static std::vector<MultiInstance*> _multiInstances;
+
+// Splits the CPU and memory budgets between the plotters given to 'multi', and initializes them
+static void ParseMultiPlotters( GlobalPlotConfig& cfg, CliParser& cli );
+
+// Runs the plotters given to 'multi' concurrently, until they have all made their plots
+static void RunMultiPlotters();
+static void OnMultiPlotDone( MultiInstance& instance );
+static void MultiPrintUsage();
+
+// Times cfg.bench->runs plots, reports them and exits. See the 'bench' command.
+static void RunBenchmark( GlobalPlotConfig& cfg, IPlotter& plotter );
 
 // See IOTester.cpp
 void IOTestMain( GlobalPlotConfig& gCfg, CliParser& cli );
@@ -40,6 +88,9 @@ int main( int argc, const char* argv[] )
     // Install a crash handler to dump our stack traces
     SysHost::InstallCrashHandler();
 
+    // Keep logging threads from blocking on stdout
+    Log::EnableAsync();
+
 #if _DEBUG
     Log::Line( "*** Warning: Debug mode is ENABLED ***" );
 #endif
@@ -49,7 +100,56 @@ int main( int argc, const char* argv[] )
     auto& cfg = *new GlobalPlotConfig{};
     ParseCommandLine( cfg, plotter, --argc, ++argv );
 
+    if( cfg.ioStatusPath && cfg.ioStatusInterval <= 0 )
+        cfg.ioStatusInterval = 5;
+
+    if( cfg.ioStatusInterval > 0 )
+        IOStats::StartStatusReport( cfg.ioStatusInterval, cfg.ioStatusPath );
+
+    if( cfg.perfCounters )
+        PerfCounters::Enable();
+
+    if( cfg.yieldToHarvestMS > 0 )
+        HarvestYield::EnableYield( cfg.yieldToHarvestMS );
 
+    if( cfg.stageDir && !cfg.benchmarkMode )
+        PlotWriter::EnableStageDir( cfg.stageDir, !cfg.disableOutputDirectIO );
+
+    if( cfg.writeManifest )
+        PlotWriter::EnableManifests();
+
+    if( cfg.plotWriteDepth > 1 )
+        PlotWriter::SetWriteQueueDepth( cfg.plotWriteDepth );
+
+    if( !_multiInstances.empty() )
+        RunMultiPlotters();
+    else if( cfg.servePath )
+        ServePlotRequests( cfg, *plotter );
+    else if( cfg.bench )
+        RunBenchmark( cfg, *plotter );
+    else
+    {
+        bool isFirstPlot = true;
+        RunPlots( cfg, *plotter, isFirstPlot );
+    }
+
+    if( plotter )
+        plotter->Finish();
+
+    PlotWriter::WaitForPlotMoves();
+
+    if( cfg.yieldToHarvestMS > 0 )
+        Log::Line( "Paused for harvesters for %.2lf seconds in total.", TicksToSeconds( HarvestYield::PausedTime() ) );
+
+    #if BB_TRACE_ON
+        if( cfg.tracePath && Tracer::WriteJson( cfg.tracePath ) )
+            Log::Line( "Wrote trace to %s.", cfg.tracePath );
+    #endif
+}
+
+//-----------------------------------------------------------
+void RunPlots( GlobalPlotConfig& cfg, IPlotter& plotter, bool& isFirstPlot, MultiInstance* instance )
+{
     const int64 plotCount = cfg.plotCount > 0 ? (int64)cfg.plotCount : std::numeric_limits<int64>::max();
     // int64 failCount = 0;
 
@@ -75,9 +175,30 @@ int main( int argc, const char* argv[] )
     // Start plotting
     for( int64 i = 0; i < plotCount; i++ )
     {
-        // Generate a plot id and memo
-        PlotTools::GeneratePlotIdAndMemo( plotId, plotMemo, plotMemoSize,
-                                          *cfg.farmerPublicKey, cfg.poolPublicKey, cfg.poolContractPuzzleHash );
+        bool noIdsLeft = false;
+
+        // Take the next plot id and memo from the manifest, or generate them
+        if( _plotIds )
+        {
+            std::lock_guard lock( _plotIdsLock );
+
+            PlotIdEntry entry;
+            if( !_plotIds->Next( entry ) )
+            {
+                Log::Line( "No unused plot ids left in '%s'.", cfg.plotIdsPath );
+                break;
+            }
+
+            memcpy( plotId, entry.plotId, sizeof( plotId ) );
+            memcpy( plotMemo, entry.memo, entry.memoSize );
+            plotMemoSize = entry.memoSize;
+            noIdsLeft    = _plotIds->RemainingCount() == 0;
+        }
+        else
+        {
+            PlotTools::GeneratePlotIdAndMemo( plotId, plotMemo, plotMemoSize,
+                                              *cfg.farmerPublicKey, cfg.poolPublicKey, cfg.poolContractPuzzleHash );
+        }
 
         // Apply debug plot id and/or memo
         if( cfg.plotIdStr )
@@ -96,16 +217,32 @@ int main( int argc, const char* argv[] )
         const char* plotFileName  = nullptr;
         const char* plotOutFolder = nullptr;
         {
-            // Select the next output folder
-            const std::string& curOutputDir = cfg.outputFolders[plotOutPathIndex++];
-            plotOutPathIndex %= cfg.outputFolderCount;
+            // Select the next output folder, in round-robin order,
+            // skipping folders that are still busy writing previous plots.
+            uint32 outFolderIdx   = plotOutPathIndex;
+            uint32 outFolderPlots = PlotWriter::GetActivePlotCount( cfg.outputFolders[outFolderIdx].c_str() );
+
+            for( uint32 i = 1; i < cfg.outputFolderCount && outFolderPlots > 0; i++ )
+            {
+                const uint32 idx   = ( plotOutPathIndex + i ) % cfg.outputFolderCount;
+                const uint32 plots = PlotWriter::GetActivePlotCount( cfg.outputFolders[idx].c_str() );
+
+                if( plots < outFolderPlots )
+                {
+                    outFolderIdx   = idx;
+                    outFolderPlots = plots;
+                }
+            }
+
+            const std::string& curOutputDir = cfg.outputFolders[outFolderIdx];
+            plotOutPathIndex = ( outFolderIdx + 1 ) % cfg.outputFolderCount;
 
             plotOutFolder = curOutputDir.data();
 
             memcpy( plotOutPath, curOutputDir.data(), curOutputDir.length() );
 
             plotFileName = plotOutPath + curOutputDir.length();
-            PlotTools::GenPlotFileName( plotId, (char*)plotFileName, cfg.compressionLevel );
+            PlotTools::GenPlotFileName( plotId, (char*)plotFileName, cfg.compressionLevel, cfg.k );
         }
 
         // Begin plot
@@ -136,13 +273,498 @@ int main( int argc, const char* argv[] )
         req.outDir       = plotOutFolder;
         req.plotFileName = plotFileName;
         req.plotOutPath  = plotOutPath;
-        req.isFirstPlot  = i == 0;
-        req.IsFinalPlot  = i == plotCount-1;
+        req.isFirstPlot  = isFirstPlot;
+        req.IsFinalPlot  = i == plotCount-1 || noIdsLeft;
+
+        plotter.Run( req );
+        isFirstPlot = false;
+
+        if( instance )
+            OnMultiPlotDone( *instance );
+    }
+
+    delete[] plotOutPath;
+}
+
+//-----------------------------------------------------------
+void RunBenchmark( GlobalPlotConfig& cfg, IPlotter& plotter )
+{
+    const uint32 runs = cfg.bench->runs;
+    cfg.plotCount = 1;
+
+    bool isFirstPlot = true;
+    for( uint32 i = 0; i < runs; i++ )
+    {
+        Log::Line( "[Benchmark run %u / %u]", i+1, runs );
+
+        PlotBenchmark::BeginRun();
+        RunPlots( cfg, plotter, isFirstPlot );
+        PlotBenchmark::EndRun();
+    }
+
+    Exit( PlotBenchmark::Report( cfg ) ? 0 : 1 );
+}
+
+//-----------------------------------------------------------
+static void SetOutputFolders( GlobalPlotConfig& cfg, const int count, const char* folders[] )
+{
+    // Replaces the folders of the previous request, whose plots have all been written by now
+    delete[] cfg.outputFolders;
+
+    cfg.outputFolderCount = (uint32)count;
+    cfg.outputFolders     = new std::string[count];
+
+    for( int i = 0; i < count; i++ )
+    {
+        std::string& outPath = cfg.outputFolders[i];
+        outPath = folders[i];
+
+        // Add trailing slash?
+        const char endChar = outPath.back();
+        if( endChar != '/' && endChar != '\\' )
+            outPath += '/';
+    }
+
+    cfg.outputFolder = cfg.outputFolders[0].c_str();
+}
+
+/// A request is a single line with the same syntax as the global options:
+///  [-f <farmer_key>] [-p <pool_key> | -c <pool_contract>] [-n <count>] [-z <level>] [<out_dirs>]
+/// Anything not specified is kept from the previous request, or from the command line.
+//-----------------------------------------------------------
+static bool ParsePlotRequest( GlobalPlotConfig& cfg, const int argc, const char* argv[],
+                              bls::G1Element& farmerKey, bls::G1Element& poolKey, PuzzleHash& poolContract )
+{
+    const char* farmerKeyStr    = nullptr;
+    const char* poolKeyStr      = nullptr;
+    const char* poolContractStr = nullptr;
+    uint32      plotCount       = 1;
+    uint32      compression     = cfg.compressionLevel;
+
+    int i = 0;
+    for( ; i < argc; i++ )
+    {
+        const char* arg      = argv[i];
+        const bool  hasValue = i + 1 < argc;
+
+        if( ( !strcmp( arg, "-f" ) || !strcmp( arg, "--farmer-key" ) ) && hasValue )
+            farmerKeyStr = argv[++i];
+        else if( ( !strcmp( arg, "-p" ) || !strcmp( arg, "--pool-key" ) ) && hasValue )
+            poolKeyStr = argv[++i];
+        else if( ( !strcmp( arg, "-c" ) || !strcmp( arg, "--pool-contract" ) ) && hasValue )
+            poolContractStr = argv[++i];
+        else if( ( !strcmp( arg, "-n" ) || !strcmp( arg, "--count" ) ) && hasValue && IsNumber( argv[i+1] ) )
+            plotCount = (uint32)strtoul( argv[++i], nullptr, 10 );
+        else if( ( !strcmp( arg, "-z" ) || !strcmp( arg, "--compress" ) ) && hasValue && IsNumber( argv[i+1] ) )
+            compression = (uint32)strtoul( argv[++i], nullptr, 10 );
+        else if( arg[0] == '-' )
+        {
+            Log::Error( "Invalid plot request argument '%s'.", arg );
+            return false;
+        }
+        else
+            break;  // Output directories
+    }
+
+    if( plotCount < 1 )
+    {
+        Log::Error( "A plot request must create at least 1 plot." );
+        return false;
+    }
+
+    // The plotter's buffers and compression tables are set up for the level it was started with
+    if( compression != cfg.compressionLevel )
+    {
+        Log::Error( "Plot requests can't change the compression level (%u). Restart bladebit to change it.", cfg.compressionLevel );
+        return false;
+    }
+
+    if( poolKeyStr && poolContractStr )
+    {
+        Log::Error( "Specify only one of a pool public key or a pool contract address." );
+        return false;
+    }
+
+    // Validate everything before changing the config, so that a bad request leaves it untouched
+    bls::G1Element newFarmerKey, newPoolKey;
+    PuzzleHash     newPoolContract;
+
+    if( farmerKeyStr && !KeyTools::HexPKeyToG1Element( farmerKeyStr, newFarmerKey ) )
+    {
+        Log::Error( "Invalid farmer public key '%s'.", farmerKeyStr );
+        return false;
+    }
+
+    if( poolKeyStr && !KeyTools::HexPKeyToG1Element( poolKeyStr, newPoolKey ) )
+    {
+        Log::Error( "Invalid pool public key '%s'.", poolKeyStr );
+        return false;
+    }
+
+    if( poolContractStr && !PuzzleHash::FromAddress( newPoolContract, poolContractStr ) )
+    {
+        Log::Error( "Invalid pool contract address '%s'.", poolContractStr );
+        return false;
+    }
+
+    if( farmerKeyStr )
+    {
+        farmerKey = newFarmerKey;
+        cfg.farmerPublicKey = &farmerKey;
+    }
+
+    if( poolKeyStr )
+    {
+        poolKey = newPoolKey;
+        cfg.poolPublicKey          = &poolKey;
+        cfg.poolContractPuzzleHash = nullptr;
+    }
+    else if( poolContractStr )
+    {
+        poolContract = newPoolContract;
+        cfg.poolContractPuzzleHash = &poolContract;
+        cfg.poolPublicKey          = nullptr;
+    }
+
+    if( i < argc )
+        SetOutputFolders( cfg, argc - i, argv + i );
 
-        plotter->Run( req );
+    cfg.plotCount = plotCount;
+    return true;
+}
+
+//-----------------------------------------------------------
+void ServePlotRequests( GlobalPlotConfig& cfg, IPlotter& plotter )
+{
+    const bool useStdin = !strcmp( cfg.servePath, "-" );
+
+    #if PLATFORM_IS_UNIX
+        // Create the named pipe if it does not exist yet
+        if( !useStdin && access( cfg.servePath, F_OK ) != 0 )
+        {
+            FatalIf( mkfifo( cfg.servePath, 0600 ) != 0,
+                "Failed to create plot request pipe '%s' with error %d.", cfg.servePath, errno );
+        }
+    #endif
+
+    // Storage for keys given by requests
+    bls::G1Element farmerKey, poolKey;
+    PuzzleHash     poolContract;
+
+    const int MAX_TOKENS = 64;
+    const char* tokens[MAX_TOKENS];
+    char        line[8192];
+
+    bool isFirstPlot = true;
+
+    for( ;; )
+    {
+        Log::Line( "Waiting for plot requests on %s.", useStdin ? "stdin" : cfg.servePath );
+        Log::Flush();
+
+        // Opening a named pipe blocks until a client opens it for writing.
+        // Once all clients close it, we get EOF and re-open it to wait for the next one.
+        FILE* pipe = useStdin ? stdin : fopen( cfg.servePath, "r" );
+        FatalIf( !pipe, "Failed to open plot request pipe '%s' with error %d.", cfg.servePath, errno );
+
+        while( fgets( line, sizeof( line ), pipe ) )
+        {
+            int  tokenCount    = 0;
+            bool tooManyTokens = false;
+
+            for( char* token = strtok( line, " \t\r\n" ); token; token = strtok( nullptr, " \t\r\n" ) )
+            {
+                if( tokenCount == MAX_TOKENS )
+                {
+                    tooManyTokens = true;
+                    break;
+                }
+
+                tokens[tokenCount++] = token;
+            }
+
+            if( tokenCount == 0 || tokens[0][0] == '#' )
+                continue;
+
+            // Don't plot to a truncated list of output folders
+            if( tooManyTokens )
+            {
+                Log::Error( "Invalid plot request: It has more than %d arguments.", MAX_TOKENS );
+                Log::Flush();
+                continue;
+            }
+
+            if( !strcmp( tokens[0], "quit" ) || !strcmp( tokens[0], "exit" ) )
+            {
+                Log::Line( "Received quit request." );
+                if( !useStdin )
+                    fclose( pipe );
+                return;
+            }
+
+            if( !ParsePlotRequest( cfg, tokenCount, tokens, farmerKey, poolKey, poolContract ) )
+            {
+                Log::Flush();
+                continue;
+            }
+
+            Log::Line( "Received request for %u plot(s).", cfg.plotCount );
+            RunPlots( cfg, plotter, isFirstPlot );
+
+            Log::Line( "Completed plot request." );
+            Log::Flush();
+        }
+
+        if( useStdin )
+            return;
+
+        fclose( pipe );
     }
 }
 
+
+///
+/// Multi-plotter mode
+///
+struct MultiInstance
+{
+    uint32                   index       = 0;
+    const char*              name        = nullptr;     // Plotter command
+    IPlotter*                plotter     = nullptr;
+    bool                     isRamplot   = false;
+    GlobalPlotConfig         cfg         = {};          // The global config, with this plotter's share of the budgets
+    std::vector<const char*> args;                      // This plotter's arguments, up to the next '+'
+    size_t                   argOffset   = 0;           // First plotter-specific argument
+    uint32                   threadCount = 0;           // Budgets given to this plotter. 0 = an even share of what is left
+    size_t                   maxMemory   = 0;
+    uint64                   plotsDone   = 0;           // Guarded by _multiLock
+    Thread*                  thread      = nullptr;
+};
+
+static std::mutex                            _multiLock;
+static std::chrono::steady_clock::time_point _multiStartTime;
+
+//-----------------------------------------------------------
+void ParseMultiPlotters( GlobalPlotConfig& cfg, CliParser& cli )
+{
+    FatalIf( cfg.plotIdStr, "--plot-id can't be used with multi, the plotters would make the same plot." );
+
+    // Output directories shared by the plotters that don't list their own
+    std::vector<const char*> sharedOutDirs;
+
+    while( cli.HasArgs() && cli.ArgConsume( "-o", "--out" ) )
+    {
+        FatalIf( !cli.HasArgs(), "Expected an output directory after -o." );
+        sharedOutDirs.push_back( cli.ArgConsume() );
+    }
+
+    // Split the plotters' arguments on '+'
+    while( cli.HasArgs() )
+    {
+        auto* instance  = new MultiInstance();
+        instance->index = (uint32)_multiInstances.size();
+
+        while( cli.HasArgs() && strcmp( cli.Arg(), "+" ) != 0 )
+            instance->args.push_back( cli.ArgConsume() );
+
+        if( cli.HasArgs() )
+            cli.NextArg();
+
+        FatalIf( instance->args.empty(), "multi: Plotter %u has no arguments.", instance->index + 1 );
+        _multiInstances.push_back( instance );
+    }
+
+    FatalIf( _multiInstances.empty(), "multi needs at least one plotter. See 'bladebit help multi'." );
+
+    // Read each plotter's budgets and create it
+    uint32 explicitThreads = 0, implicitThreadCount = 0;
+    size_t explicitMemory  = 0, implicitMemoryCount = 0;
+
+    for( auto* instance : _multiInstances )
+    {
+        instance->cfg = cfg;
+        instance->cfg.outputFolders = nullptr;  // Each plotter owns its own output folders
+
+        CliParser icli( (int)instance->args.size(), instance->args.data() );
+
+        while( icli.HasArgs() )
+        {
+            if( icli.ReadU32( instance->threadCount, "-t", "--threads" ) )
+                continue;
+            else if( icli.ReadSize( instance->maxMemory, "--max-memory" ) )
+                continue;
+            else if( icli.ReadU32( instance->cfg.plotCount, "-n", "--count" ) )
+                continue;
+            else
+                break;
+        }
+
+        instance->name    = icli.HasArgs() ? icli.Arg() : "";
+        instance->plotter = icli.HasArgs() ? ConsumePlotterCommand( cfg, icli, instance->isRamplot ) : nullptr;
+        FatalIf( !instance->plotter, "multi: Expected a plotter command (ramplot, diskplot or cudaplot) for plotter %u, but got '%s'.",
+                 instance->index + 1, instance->name );
+
+        instance->argOffset = instance->args.size() - (size_t)icli.RemainingArgCount();
+
+        FatalIf( cfg.k != 32 && !instance->isRamplot, "Only ramplot supports k sizes other than 32." );
+
+        if( instance->cfg.tunedDeltas && !instance->isRamplot )
+        {
+            Log::Line( "Warning: --tuned-deltas is only supported by ramplot. Ignoring it for %s.", instance->name );
+            instance->cfg.tunedDeltas = false;
+        }
+
+        if( instance->threadCount > 0 )
+            explicitThreads += instance->threadCount;
+        else
+            implicitThreadCount++;
+
+        if( instance->maxMemory > 0 )
+            explicitMemory += instance->maxMemory;
+        else
+            implicitMemoryCount++;
+    }
+
+    // Split the budgets: plotters without their own share what the others left evenly.
+    // Each plotter's compute threads are pinned to their own range of CPUs.
+    const uint32 threadBudget = cfg.threadCount;
+    const size_t memoryBudget = cfg.maxMemory > 0 ? cfg.maxMemory : SysHost::GetTotalSystemMemory();
+
+    FatalIf( explicitThreads + implicitThreadCount > threadBudget,
+        "multi: The plotters need %u threads, but only %u are available. Lower their -t, or raise the global -t.",
+        explicitThreads + implicitThreadCount, threadBudget );
+
+    FatalIf( explicitMemory > memoryBudget || ( implicitMemoryCount > 0 && explicitMemory == memoryBudget ),
+        "multi: The plotters' --max-memory ( %.2lf GiB ) leaves nothing of the %.2lf GiB memory budget for the others.",
+        (double)explicitMemory BtoGB, (double)memoryBudget BtoGB );
+
+    const uint32 threadsLeft = threadBudget - explicitThreads;
+    const size_t memoryLeft  = memoryBudget - explicitMemory;
+
+    uint32 cpuOffset      = 0;
+    uint32 implicitIndex  = 0;
+
+    for( auto* instance : _multiInstances )
+    {
+        auto& icfg = instance->cfg;
+
+        if( instance->threadCount == 0 )
+        {
+            // Hand out the remainder to the first plotters
+            instance->threadCount = threadsLeft / implicitThreadCount + ( implicitIndex < threadsLeft % implicitThreadCount ? 1 : 0 );
+            implicitIndex++;
+        }
+
+        icfg.threadCount = instance->threadCount;
+        icfg.cpuOffset   = cpuOffset;
+        icfg.maxMemory   = instance->maxMemory > 0 ? instance->maxMemory : memoryLeft / implicitMemoryCount;
+
+        cpuOffset += icfg.threadCount;
+    }
+
+    Log::Line( "" );
+    Log::Line( "[Multi-plotter Config]" );
+    Log::Line( " Thread budget         : %u", threadBudget );
+    Log::Line( " Memory budget         : %.2lf GiB", (double)memoryBudget BtoGB );
+
+    for( auto* instance : _multiInstances )
+    {
+        const auto& icfg = instance->cfg;
+
+        Log::Line( " [%u] %-8s : %u threads, %.2lf GiB, %s plots", instance->index + 1, instance->name,
+                   icfg.threadCount, (double)icfg.maxMemory BtoGB,
+                   icfg.plotCount == 0 ? "unlimited" : std::to_string( icfg.plotCount ).c_str() );
+    }
+
+    // Parse the plotters' own options and initialize them one at a time
+    for( auto* instance : _multiInstances )
+    {
+        auto& icfg = instance->cfg;
+
+        Log::Line( "" );
+        Log::Line( "[%u] %s", instance->index + 1, instance->name );
+
+        CliParser icli( (int)( instance->args.size() - instance->argOffset ), instance->args.data() + instance->argOffset );
+        instance->plotter->ParseCLI( icfg, icli );
+
+        if( icli.HasArgs() )
+            ParseOutputFolders( icfg, icli );
+        else
+        {
+            FatalIf( sharedOutDirs.empty(), "multi: %s (plotter %u) has no output directories, and no shared ones were given with -o.",
+                     instance->name, instance->index + 1 );
+
+            SetOutputFolders( icfg, (int)sharedOutDirs.size(), sharedOutDirs.data() );
+        }
+
+        Log::Flush();
+        instance->plotter->Init();
+    }
+
+    Log::Line( "" );
+}
+
+//-----------------------------------------------------------
+static void MultiPlotterThreadMain( MultiInstance* instance )
+{
+    bool isFirstPlot = true;
+    RunPlots( instance->cfg, *instance->plotter, isFirstPlot, instance );
+
+    instance->plotter->Finish();
+}
+
+//-----------------------------------------------------------
+void RunMultiPlotters()
+{
+    _multiStartTime = TimerBegin();
+
+    for( auto* instance : _multiInstances )
+    {
+        instance->thread = new Thread( 8 MiB );
+        instance->thread->Run( MultiPlotterThreadMain, instance );
+    }
+
+    for( auto* instance : _multiInstances )
+        instance->thread->WaitForExit();
+
+    const float64 elapsed = TimerEnd( _multiStartTime );
+    const float64 days    = elapsed / ( 24.0 * 60.0 * 60.0 );
+
+    uint64 totalPlots = 0;
+
+    Log::Line( "" );
+    Log::Line( "[Multi-plotter Summary]" );
+
+    for( auto* instance : _multiInstances )
+    {
+        totalPlots += instance->plotsDone;
+
+        Log::Line( " [%u] %-8s : %llu plot(s), %.2lf plots/day", instance->index + 1, instance->name,
+                   (llu)instance->plotsDone, days > 0 ? instance->plotsDone / days : 0.0 );
+    }
+
+    Log::Line( " Combined     : %llu plot(s) in %.2lf hours, %.2lf plots/day", (llu)totalPlots, elapsed / 3600.0,
+               days > 0 ? totalPlots / days : 0.0 );
+}
+
+//-----------------------------------------------------------
+void OnMultiPlotDone( MultiInstance& instance )
+{
+    std::lock_guard lock( _multiLock );
+
+    instance.plotsDone++;
+
+    uint64 totalPlots = 0;
+    for( auto* i : _multiInstances )
+        totalPlots += i->plotsDone;
+
+    const float64 days = TimerEnd( _multiStartTime ) / ( 24.0 * 60.0 * 60.0 );
+
+    Log::Line( "[multi] %s (plotter %u) finished plot %llu. Combined: %llu plot(s), %.2lf plots/day.",
+               instance.name, instance.index + 1, (llu)instance.plotsDone, (llu)totalPlots,
+               days > 0 ? totalPlots / days : 0.0 );
+}
+
 //-----------------------------------------------------------
 void ParseCommandLine( GlobalPlotConfig& cfg, IPlotter*& outPlotter, int argc, const char* argv[] )
 {
@@ -154,6 +776,8 @@ void ParseCommandLine( GlobalPlotConfig& cfg, IPlotter*& outPlotter, int argc, c
 
     outPlotter        = nullptr;
     IPlotter* plotter = nullptr;
+    bool      ramplot = false;
+    bool      multi   = false;
 
     while( cli.HasArgs() )
     {
@@ -161,6 +785,8 @@ void ParseCommandLine( GlobalPlotConfig& cfg, IPlotter*& outPlotter, int argc, c
             continue;
         else if( cli.ReadU32( cfg.plotCount, "-n", "--count" ) )
             continue;
+        else if( cli.ReadU32( cfg.k, "-k", "--size" ) )
+            continue;
         else if( cli.ReadStr( farmerPublicKey, "-f", "--farmer-key" ) )
             continue;
         else if( cli.ReadStr( poolPublicKey, "-p", "--pool-key" ) )
@@ -171,6 +797,8 @@ void ParseCommandLine( GlobalPlotConfig& cfg, IPlotter*& outPlotter, int argc, c
             continue;
         else if( cli.ReadStr( cfg.plotIdStr, "-i", "--plot-id" ) )
             continue;
+        else if( cli.ReadStr( cfg.plotIdsPath, "--ids" ) )
+            continue;
         else if( cli.ArgConsume( "-z", "--compress" ) )
         {
             cfg.compressionLevel = 1;   // Default to lowest compression
@@ -183,6 +811,12 @@ void ParseCommandLine( GlobalPlotConfig& cfg, IPlotter*& outPlotter, int argc, c
         }
         else if( cli.ReadSwitch( cfg.disableOutputDirectIO, "--no-direct-io" ) )
             continue;
+        else if( cli.ReadSwitch( cfg.writeManifest, "--manifest" ) )
+            continue;
+        else if( cli.ReadStr( cfg.stageDir, "--stage-dir" ) )
+            continue;
+        else if( cli.ReadU32( cfg.plotWriteDepth, "--plot-write-depth" ) )
+            continue;
         else if( cli.ReadStr( cfg.plotMemoStr, "--memo" ) )
             continue;
         else if( cli.ReadSwitch( cfg.showMemo, "--show-memo" ) )
@@ -191,6 +825,62 @@ void ParseCommandLine( GlobalPlotConfig& cfg, IPlotter*& outPlotter, int argc, c
             continue;
         else if( cli.ReadSwitch( cfg.disableCpuAffinity, "--no-cpu-affinity" ) )
             continue;
+        else if( cli.ArgConsume( "--cpu-level" ) )
+        {
+            const char* level = cli.ArgConsume();
+
+            if( strcmp( level, "baseline" ) == 0 )
+                SysHost::LimitCpuLevel( CpuLevel::Baseline );
+            else if( strcmp( level, "v2" ) == 0 )
+                SysHost::LimitCpuLevel( CpuLevel::V2 );
+            else if( strcmp( level, "v3" ) == 0 )
+                SysHost::LimitCpuLevel( CpuLevel::V3 );
+            else if( strcmp( level, "v4" ) == 0 )
+                SysHost::LimitCpuLevel( CpuLevel::V4 );
+            else
+                Fatal( "Invalid --cpu-level '%s'. Expected baseline, v2, v3 or v4.", level );
+
+            continue;
+        }
+        else if( cli.ReadU32( cfg.ioCoreCount, "--io-cores" ) )
+            continue;
+        else if( cli.ReadSwitch( cfg.hugePages, "--huge-pages" ) )
+            continue;
+        else if( cli.ArgConsume( "--interleaved-deltas" ) )
+        {
+            cfg.parkDeltaCoding = ParkDeltaCoding::InterleavedFSE;
+            continue;
+        }
+        else if( cli.ArgConsume( "--rans-deltas" ) )
+        {
+            cfg.parkDeltaCoding = ParkDeltaCoding::RANS;
+            continue;
+        }
+        else if( cli.ReadSwitch( cfg.alignedParks, "--aligned-parks" ) )
+            continue;
+        else if( cli.ReadSwitch( cfg.tunedDeltas, "--tuned-deltas" ) )
+            continue;
+        else if( cli.ReadStr( cfg.servePath, "--serve" ) )
+            continue;
+        else if( cli.ReadSize( cfg.maxMemory, "--max-memory" ) )
+            continue;
+        else if( cli.ReadSize( cfg.maxPinnedMemory, "--max-pinned" ) )
+            continue;
+        else if( cli.ReadF64( cfg.ioStatusInterval, "--io-status" ) )
+            continue;
+        else if( cli.ReadStr( cfg.ioStatusPath, "--io-status-file" ) )
+            continue;
+        else if( cli.ReadSwitch( cfg.perfCounters, "--perf-counters" ) )
+            continue;
+        else if( cli.ReadU32( cfg.yieldToHarvestMS, "--yield-to-harvest" ) )
+            continue;
+        else if( cli.ReadStr( cfg.tracePath, "--trace" ) )
+        {
+            #if !BB_TRACE_ON
+                Log::Line( "Warning: --trace is ignored. Build with -DENABLE_TRACE=ON to enable tracing." );
+            #endif
+            continue;
+        }
         else if( cli.ReadSwitch( cfg.verbose, "-v", "--verbose" ) )
         {
             Log::SetVerbose( true );
@@ -199,7 +889,7 @@ void ParseCommandLine( GlobalPlotConfig& cfg, IPlotter*& outPlotter, int argc, c
         {
             // #TODO: We should move the required part to the memplot command
             // #TODO: Get this value from Memplotter
-            const size_t requiredMem  = 416ull GB;
+            const size_t requiredMem  = 416ull GB >> ( 32 - std::min( cfg.k, 32u ) );    // Scales with -k, when given before
             const size_t availableMem = SysHost::GetAvailableSystemMemory();
             const size_t totalMem     = SysHost::GetTotalSystemMemory();
 
@@ -212,7 +902,7 @@ void ParseCommandLine( GlobalPlotConfig& cfg, IPlotter*& outPlotter, int argc, c
         else if( cli.ArgConsume( "--memory-json" ) )
         {
             // #TODO: Get this value from Memplotter
-            const size_t requiredMem  = 416ull GB;
+            const size_t requiredMem  = 416ull GB >> ( 32 - std::min( cfg.k, 32u ) );    // Scales with -k, when given before
             const size_t availableMem = SysHost::GetAvailableSystemMemory();
             const size_t totalMem     = SysHost::GetTotalSystemMemory();
 
@@ -245,46 +935,44 @@ void ParseCommandLine( GlobalPlotConfig& cfg, IPlotter*& outPlotter, int argc, c
 
 
         // Commands
-        else if( cli.ArgConsume( "diskplot" ) )
+        else if( cli.ArgConsume( "bench" ) )
         {
-            // #TODO: Remove when fixed
-            FatalIf( cfg.compressionLevel > 0, "diskplot is currently disabled for compressed plotting due to a bug." );
+            FatalIf( cfg.bench, "bench was specified more than once." );
+            FatalIf( cfg.servePath, "bench can't be used with --serve." );
 
-            plotter = new DiskPlotter();
-            
-            // Increase the file size limit on linux
-            #if PLATFORM_IS_UNIX
-                struct rlimit limit;
-                getrlimit( RLIMIT_NOFILE, &limit );
+            auto& bench = *( cfg.bench = new PlotBenchmarkConfig{} );
 
-                if( limit.rlim_cur < limit.rlim_max )
-                {
-                    Log::Line( "Increasing the file limit from %u to %u", limit.rlim_cur, limit.rlim_max );
-
-                    limit.rlim_cur = limit.rlim_max;
-                    if( setrlimit( RLIMIT_NOFILE, &limit ) != 0 )
-                    {
-                        const int err = errno;
-                        Log::Line( "*** Warning: Failed to increase file limit to with error %d (0x%02x). Plotting may fail ***", err, err );
-                    }
-                }
-            #endif
-            break;
-        }
-        else if( cli.ArgConsume( "ramplot" ) )
-        {
-            FatalIf( cfg.compressionLevel > 7, "ramplot currently does not support compression levels greater than 7" );
+            while( cli.HasArgs() )
+            {
+                if( cli.ReadU32( bench.runs, "--runs" ) )
+                    continue;
+                else if( cli.ReadStr( bench.jsonPath, "--json" ) )
+                    continue;
+                else if( cli.ReadStr( bench.baselinePath, "--baseline" ) )
+                    continue;
+                else if( cli.ReadF64( bench.tolerance, "--tolerance" ) )
+                    continue;
+                else
+                    break;
+            }
 
-            plotter = new MemPlotter();
-            break;
+            FatalIf( bench.runs < 1, "bench needs at least 1 run." );
+            FatalIf( bench.tolerance < 0, "Invalid benchmark tolerance %.2lf.", bench.tolerance );
+            FatalIf( !cli.HasArgs() || !( cli.ArgMatch( "ramplot" ) || cli.ArgMatch( "diskplot" ) || cli.ArgMatch( "cudaplot" ) ),
+                "bench must be followed by a plotter command: ramplot, diskplot or cudaplot." );
+
+            bench.plotterName = cli.Arg();
+            continue;
         }
-    #if BB_CUDA_ENABLED
-        else if( cli.ArgConsume( "cudaplot" ) )
+        else if( ( plotter = ConsumePlotterCommand( cfg, cli, ramplot ) ) != nullptr )
+            break;
+        else if( cli.ArgConsume( "multi" ) )
         {
-            plotter = new CudaK32Plotter();
+            FatalIf( cfg.bench, "multi can't be used with bench." );
+            FatalIf( cfg.servePath, "multi can't be used with --serve." );
+            multi = true;
             break;
         }
-    #endif
         else if( cli.ArgConsume( "iotest" ) )
         {
             IOTestMain( cfg, cli );
@@ -310,11 +998,32 @@ void ParseCommandLine( GlobalPlotConfig& cfg, IPlotter*& outPlotter, int argc, c
             CmdSimulateMain( cfg, cli );
             Exit( 0 );
         }
+        else if( cli.ArgConsume( "gen-ids" ) )
+        {
+            ParseKeys( cfg, farmerPublicKey, poolPublicKey, poolContractAddress );
+            CmdGenIdsMain( cfg, cli );
+            Exit( 0 );
+        }
         else if( cli.ArgConsume( "check" ) )
         {
             CmdPlotsCheckMain( cfg, cli );
             Exit( 0 );
         }
+        else if( cli.ArgConsume( "recompress" ) )
+        {
+            CmdRecompressMain( cfg, cli );
+            Exit( 0 );
+        }
+        else if( cli.ArgConsume( "receive" ) )
+        {
+            CmdReceiveMain( cfg, cli );
+            Exit( 0 );
+        }
+        else if( cli.ArgConsume( "replay" ) )
+        {
+            CmdReplayMain( cfg, cli );
+            Exit( 0 );
+        }
         else if( cli.ArgConsume( "cudacheck" ) )
         {
             CmdCheckCUDA( cfg, cli );
@@ -326,8 +1035,10 @@ void ParseCommandLine( GlobalPlotConfig& cfg, IPlotter*& outPlotter, int argc, c
             {
                 if( cli.ArgMatch( "diskplot" ) )
                     DiskPlotter::PrintUsage();
+                else if( cli.ArgMatch( "multi" ) )
+                    MultiPrintUsage();
                 else if( cli.ArgMatch( "ramplot" ) )
-                    Log::Line( "bladebit -f ... -p/c ... ramplot <out_dirs>" );
+                    Log::Line( "bladebit -f ... -p/c ... ramplot [--numa-local | --numa-instances] [--group-match] <out_dirs>" );
             #if BB_CUDA_ENABLED
                 else if( cli.ArgMatch( "cudaplot" ) )
                     CudaK32PlotterPrintHelp();
@@ -344,8 +1055,18 @@ void ParseCommandLine( GlobalPlotConfig& cfg, IPlotter*& outPlotter, int argc, c
                     CmdSimulateHelp();
                 else if( cli.ArgMatch( "check" ) )
                     CmdPlotsCheckHelp();
+                else if( cli.ArgMatch( "gen-ids" ) )
+                    CmdGenIdsHelp();
+                else if( cli.ArgMatch( "recompress" ) )
+                    CmdRecompressHelp();
+                else if( cli.ArgMatch( "receive" ) )
+                    CmdReceiveHelp();
+                else if( cli.ArgMatch( "replay" ) )
+                    CmdReplayHelp();
                 else if( cli.ArgMatch( "cudacheck" ) )
                     CmdCheckCUDAHelp();
+                else if( cli.ArgMatch( "bench" ) )
+                    PlotBenchmarkPrintUsage();
                 else
                     Fatal( "Unknown command '%s'.", cli.Arg() );
 
@@ -369,28 +1090,39 @@ void ParseCommandLine( GlobalPlotConfig& cfg, IPlotter*& outPlotter, int argc, c
     ///
     /// Validate global config
     ///
-    FatalIf( farmerPublicKey == nullptr, "A farmer public key must be specified." );
-    FatalIf( !KeyTools::HexPKeyToG1Element( farmerPublicKey, *(cfg.farmerPublicKey = new bls::G1Element()) ),
-        "Invalid farmer public key '%s'", farmerPublicKey );
+    ParseKeys( cfg, farmerPublicKey, poolPublicKey, poolContractAddress );
 
-    if( poolContractAddress )
-    {
-        cfg.poolContractPuzzleHash = new PuzzleHash();
-        FatalIf( !PuzzleHash::FromAddress( *cfg.poolContractPuzzleHash, poolContractAddress ),
-            "Invalid pool contract puzzle hash '%s'", poolContractAddress );
-    }
-    else if( poolPublicKey )
+    if( cfg.plotIdsPath )
     {
-        cfg.poolPublicKey = new bls::G1Element();
-        FatalIf( !KeyTools::HexPKeyToG1Element( poolPublicKey, *cfg.poolPublicKey ),
-                 "Invalid pool public key '%s'", poolPublicKey );
+        FatalIf( cfg.bench, "--ids can't be used with bench." );
+
+        _plotIds = new PlotIdManifest();
+        FatalIf( !_plotIds->Load( cfg.plotIdsPath ), "Failed to load plot id manifest '%s'.", cfg.plotIdsPath );
+        FatalIf( _plotIds->RemainingCount() == 0, "Plot id manifest '%s' has no unused plot ids.", cfg.plotIdsPath );
     }
-    else
-        Fatal( "Error: Either a pool public key or a pool contract address must be specified." );
+
+    if( cfg.bench )
+        PlotBenchmark::ApplyDefaults( cfg );
 
 
     // FatalIf( cfg.compressionLevel > 7, "Invalid compression level. Please specify a compression level between 0 and 7 (inclusive)." );
     FatalIf( cfg.compressionLevel > 9, "Invalid compression level. Please specify a compression level between 0 and 9 (inclusive)." );
+
+    FatalIf( cfg.k < BB_CHIA_K_MIN_VALUE || cfg.k > 32, "Invalid k size %u. Please specify a k between %u and 32 (inclusive).", cfg.k, BB_CHIA_K_MIN_VALUE );
+    if( cfg.k != 32 )
+    {
+        // Small plots are for testing and benchmarking. The GPU and disk plotters, and the compressed formats, are k32-only.
+        FatalIf( plotter && !ramplot, "Only ramplot supports k sizes other than 32." );
+        FatalIf( cfg.compressionLevel > 0, "Compressed plots are only supported for k=32." );
+    }
+
+    // The other plotters code their parks a bucket at a time, before the whole table is known
+    if( cfg.tunedDeltas && plotter && !ramplot )
+    {
+        Log::Line( "Warning: --tuned-deltas is only supported by ramplot. Ignoring it." );
+        cfg.tunedDeltas = false;
+    }
+
     // If making compressed plots, get thr compression CTable, etc.
     if( cfg.compressionLevel > 0 )
     {
@@ -408,9 +1140,24 @@ void ParseCommandLine( GlobalPlotConfig& cfg, IPlotter*& outPlotter, int argc, c
         cfg.compressionInfo = GetCompressionInfoForLevel( cfg.compressionLevel );
     }
 
-    const uint maxThreads = SysHost::GetLogicalCPUCount();
+    FatalIf( cfg.plotWriteDepth < 1 || cfg.plotWriteDepth > 64, "--plot-write-depth must be between 1 and 64." );
+
+    const uint maxThreads    = SysHost::GetLogicalCPUCount();
+    const uint usableThreads = SysHost::GetUsableCPUCount();
+
+    // Reserve cores for I/O threads before any thread pool is created
+    uint32 ioCpuCount = 0;
+    if( cfg.ioCoreCount > 0 )
+    {
+        if( cfg.disableCpuAffinity )
+            Log::Line( "Warning: --io-cores has no effect with --no-cpu-affinity." );
+        else
+            ioCpuCount = ThreadAffinity::ReserveIOCores( cfg.ioCoreCount );
+    }
+
+    // By default, stay within the CPUs and CPU quota the process was given (ex. by a container)
     if( cfg.threadCount == 0 )
-        cfg.threadCount = maxThreads;
+        cfg.threadCount = usableThreads > ioCpuCount ? usableThreads - ioCpuCount : 1;
     else if( cfg.threadCount > maxThreads )
     {
         Log::Write( "Warning: Lowering thread count from %u to %u, the native maximum.",
@@ -443,7 +1190,7 @@ void ParseCommandLine( GlobalPlotConfig& cfg, IPlotter*& outPlotter, int argc, c
             len -= 2;
         }
         
-        if( len/2 != (48 + 48 + 32) && len != (32 + 48 + 32) )
+        if( len/2 != (48 + 48 + 32) && len/2 != (32 + 48 + 32) )
             Fatal( "Invalid plot memo." );
     }
 
@@ -458,7 +1205,9 @@ void ParseCommandLine( GlobalPlotConfig& cfg, IPlotter*& outPlotter, int argc, c
     Log::Line( "" );
 
     Log::Line( "[Global Plotting Config]" );
-    if( cfg.plotCount == 0 )
+    if( cfg.servePath )
+        Log::Line( " Will create plots on request from %s.", strcmp( cfg.servePath, "-" ) ? cfg.servePath : "stdin" );
+    else if( cfg.plotCount == 0 )
         Log::Line( " Will create plots indefinitely." );
     else
         Log::Line( " Will create %u plots.", cfg.plotCount );
@@ -467,23 +1216,59 @@ void ParseCommandLine( GlobalPlotConfig& cfg, IPlotter*& outPlotter, int argc, c
     Log::Line( " Warm start enabled    : %s", cfg.warmStart ? "true" : "false" );
     Log::Line( " NUMA disabled         : %s", cfg.disableNuma ? "true" : "false" );
     Log::Line( " CPU affinity disabled : %s", cfg.disableCpuAffinity ? "true" : "false" );
-
-    Log::Line( " Farmer public key     : %s", farmerPublicKey );
+    {
+        const CpuTopology& topology = SysHost::GetCpuTopology();
+        Log::Line( " CPU topology          : %u package(s), %u L3 domain(s), %u cores, %u threads",
+            topology.packageCount, topology.l3Count, topology.coreCount, (uint32)topology.cpus.Length() );
+    }
+    Log::Line( " CPU features          : %s", SysHost::CpuFeaturesToString( SysHost::GetCpuFeatures() ).c_str() );
+    if( ThreadAffinity::IOCpuCount() > 0 )
+        Log::Line( " I/O threads CPUs      : %u", ThreadAffinity::IOCpuCount() );
+    Log::Line( " Huge pages            : %s", cfg.hugePages ? "true" : "false" );
+    if( cfg.plotWriteDepth > 1 )
+        Log::Line( " Plot write depth      : %u", cfg.plotWriteDepth );
+    if( cfg.maxMemory > 0 )
+        Log::Line( " Max memory            : %.2lf GiB", (double)cfg.maxMemory BtoGB );
+    if( cfg.maxPinnedMemory > 0 )
+        Log::Line( " Max pinned memory     : %.2lf GiB", (double)cfg.maxPinnedMemory BtoGB );
+
+    if( cfg.plotIdsPath )
+        Log::Line( " Plot id manifest      : %s ( %llu unused ids )", cfg.plotIdsPath, (llu)_plotIds->RemainingCount() );
+    else
+        Log::Line( " Farmer public key     : %s", farmerPublicKey ? farmerPublicKey : "benchmark default" );
 
     if( poolContractAddress )
         Log::Line( " Pool contract address : %s", poolContractAddress );
-    else if( cfg.poolPublicKey )
+    else if( poolPublicKey )
         Log::Line( " Pool public key       : %s", poolPublicKey   );
+    else if( cfg.poolPublicKey )
+        Log::Line( " Pool public key       : benchmark default" );
 
     // Log::Line( " Compression           : %s", cfg.compressionLevel > 0 ? "enabled" : "disabled" );
+    if( cfg.k != 32 )
+        Log::Line( " K size                : %u", cfg.k );
     if( cfg.compressionLevel > 0 )
         Log::Line( " Compression Level     : %u", cfg.compressionLevel );
+    if( cfg.parkDeltaCoding != ParkDeltaCoding::FSE )
+        Log::Line( " Park delta coding     : %s", cfg.parkDeltaCoding == ParkDeltaCoding::RANS ? "rANS" : "interleaved FSE" );
+    if( cfg.alignedParks )
+        Log::Line( " Aligned parks         : true" );
+    if( cfg.tunedDeltas )
+        Log::Line( " Tuned park deltas     : true" );
 
     Log::Line( " Benchmark mode        : %s", cfg.benchmarkMode ? "enabled" : "disabled" );
+    if( cfg.bench )
+        Log::Line( " Benchmark runs        : %u", cfg.bench->runs );
     // Log::Line( " Output path           : %s", cfg.outputFolder );
     // Log::Line( "" );
 
 
+    if( multi )
+    {
+        ParseMultiPlotters( cfg, cli );
+        return;
+    }
+
     FatalIf( plotter == nullptr, "No plotter type chosen." );
 
     // #TODO: Remove when C8 compression values added.
@@ -493,6 +1278,64 @@ void ParseCommandLine( GlobalPlotConfig& cfg, IPlotter*& outPlotter, int argc, c
     plotter->ParseCLI( cfg, cli );
 
     // Parse remaining args as output directories
+    ParseOutputFolders( cfg, cli );
+
+    Log::Line( "" );
+    Log::Flush();
+
+    // Initialize plotter
+    plotter->Init();
+
+    Log::Line( "" );
+
+    outPlotter = plotter;
+}
+
+//-----------------------------------------------------------
+IPlotter* ConsumePlotterCommand( const GlobalPlotConfig& cfg, CliParser& cli, bool& outIsRamplot )
+{
+    outIsRamplot = false;
+
+    if( cli.ArgConsume( "diskplot" ) )
+    {
+        FatalIf( cfg.compressionLevel > 7, "diskplot currently does not support compression levels greater than 7" );
+
+        // Increase the file size limit on linux
+        #if PLATFORM_IS_UNIX
+            struct rlimit limit;
+            getrlimit( RLIMIT_NOFILE, &limit );
+
+            if( limit.rlim_cur < limit.rlim_max )
+            {
+                Log::Line( "Increasing the file limit from %u to %u", limit.rlim_cur, limit.rlim_max );
+
+                limit.rlim_cur = limit.rlim_max;
+                if( setrlimit( RLIMIT_NOFILE, &limit ) != 0 )
+                {
+                    const int err = errno;
+                    Log::Line( "*** Warning: Failed to increase file limit to with error %d (0x%02x). Plotting may fail ***", err, err );
+                }
+            }
+        #endif
+
+        return new DiskPlotter();
+    }
+    else if( cli.ArgConsume( "ramplot" ) )
+    {
+        outIsRamplot = true;
+        return new MemPlotter();
+    }
+#if BB_CUDA_ENABLED
+    else if( cli.ArgConsume( "cudaplot" ) )
+        return new CudaK32Plotter();
+#endif
+
+    return nullptr;
+}
+
+//-----------------------------------------------------------
+void ParseOutputFolders( GlobalPlotConfig& cfg, CliParser& cli )
+{
     cfg.outputFolderCount = (uint32)cli.RemainingArgCount();
     FatalIf( cfg.outputFolderCount < 1, "At least one output folder must be specified." );
 
@@ -515,16 +1358,36 @@ void ParseCommandLine( GlobalPlotConfig& cfg, IPlotter*& outPlotter, int argc, c
     }
 
     cfg.outputFolder = cfg.outputFolders[0].c_str();
+}
 
-    Log::Line( "" );
-    Log::Flush();
-
-    // Initialize plotter
-    plotter->Init();
+//-----------------------------------------------------------
+void ParseKeys( GlobalPlotConfig& cfg, const char* farmerPublicKey, const char* poolPublicKey, const char* poolContractAddress )
+{
+    // Benchmarks use fixed keys, unless given.
+    // Plot id manifests already hold the keys in their memos.
+    const bool keysOptional = cfg.bench || cfg.plotIdsPath;
 
-    Log::Line( "" );
+    if( !keysOptional || farmerPublicKey )
+    {
+        FatalIf( farmerPublicKey == nullptr, "A farmer public key must be specified." );
+        FatalIf( !KeyTools::HexPKeyToG1Element( farmerPublicKey, *(cfg.farmerPublicKey = new bls::G1Element()) ),
+            "Invalid farmer public key '%s'", farmerPublicKey );
+    }
 
-    outPlotter = plotter;
+    if( poolContractAddress )
+    {
+        cfg.poolContractPuzzleHash = new PuzzleHash();
+        FatalIf( !PuzzleHash::FromAddress( *cfg.poolContractPuzzleHash, poolContractAddress ),
+            "Invalid pool contract puzzle hash '%s'", poolContractAddress );
+    }
+    else if( poolPublicKey )
+    {
+        cfg.poolPublicKey = new bls::G1Element();
+        FatalIf( !KeyTools::HexPKeyToG1Element( poolPublicKey, *cfg.poolPublicKey ),
+                 "Invalid pool public key '%s'", poolPublicKey );
+    }
+    else if( !keysOptional )
+        Fatal( "Error: Either a pool public key or a pool contract address must be specified." );
 }
 
 
@@ -535,11 +1398,17 @@ R"(
  cudaplot   : Create a plot by using the a CUDA-capable GPU.
  diskplot   : Create a plot by making use of a disk.
  ramplot    : Create a plot completely in-ram.
+ bench      : Time deterministic runs of a plotter and compare them to a baseline.
+ multi      : Run several plotters at once, sharing the thread and memory budgets.
  iotest     : Perform a write and read test on a specified disk.
  memtest    : Perform a memory (RAM) copy test.
  validate   : Validates all entries in a plot to ensure they all evaluate to a valid proof.
  simulate   : Simulation tool useful for compressed plot capacity.
  check      : Check and validate random proofs in a plot.
+ gen-ids    : Derive plot ids and memos in bulk and write them to a manifest.
+ recompress : Convert an uncompressed plot to a compressed plot without plotting it again.
+ receive    : Receive plots streamed over the network by plotters, on a harvester.
+ replay     : Replay a harvester request trace and report its decompression latencies.
  help       : Output this help message, or help for a specific command, if specified.
 
 [GLOBAL_OPTIONS]:
@@ -550,6 +1419,10 @@ R"(
 
  -n, --count          : Number of plots to create. Default = 1.
 
+ -k, --size           : Plot k size, from 18 to 32. Default = 32.
+                        Sizes below 32 are only supported by ramplot, without compression.
+                        They make small plots in seconds, for tests and benchmarks. Chia only farms k32 and up.
+
  -f, --farmer-key     : Farmer public key, specified in hexadecimal format.
                         *REQUIRED*
 
@@ -571,13 +1444,34 @@ R"(
                         Enable this if writing to a storage destination 
                         that does not support direct I/O.
 
+ --stage-dir <path>   : Write plots to this (fast) directory first, then move them to
+                        their output directory in the background, one plot at a time
+                        per output directory. Plots are removed from <path> once moved.
+
+ --plot-write-depth <n>: Keep up to n 32 MiB writes to the plot file in flight at once
+                        (up to 64), instead of one. Helps when the output is an SMR HDD
+                        or a network share. Aligned table data is written without a copy.
+                        Linux and Windows only. Default: 1.
+
+ --manifest           : Write a <plot>.b3 manifest next to each plot, with the offset, size
+                        and BLAKE3 digest of each of its tables, one table per line.
+                        Tables are hashed as they are written, so the plot is never read back.
+                        Audit tools can check for bit-rot by hashing the table ranges in
+                        parallel and comparing them with the manifest.
+
  --benchmark          : Enables benchmark mode. This is meant to test plotting without
                         actually writing a final plot to disk.
 
- -w, --warm-start     : Touch all pages of buffer allocations before starting to plot.
+ -w, --warm-start     : Touch all pages of buffer allocations with low priority background threads,
+                        in the order the plotter first uses them, while the first plot starts right away.
 
  -i, --plot-id        : Specify a plot id for debugging.
 
+ --ids <manifest>     : Take the plot ids and memos from a manifest written by the gen-ids command,
+                        instead of deriving them before each plot. The keys are then optional.
+                        Used ids are appended to <manifest>.used and skipped on later runs.
+                        Plotting stops early once the manifest runs out of ids.
+
  --memo               : Specify a plot memo for debugging.
 
  --show-memo          : Output the memo of the next plot the be plotted.
@@ -593,6 +1487,81 @@ R"(
                         instances of Bladebit as you can manually
                         assign thread affinity yourself when launching Bladebit.
 
+ --cpu-level <level>  : Limit the SIMD kernels to those of an x86-64 level:
+                        baseline, v2, v3 (AVX2) or v4 (AVX-512).
+                        The widest level the CPU supports is used by default.
+
+ --io-cores <n>       : Reserve n physical cores for the I/O, plot writer and GPU feeder threads.
+                        Compute threads are pinned one per core, filling an L3 domain (CCX) at a time
+                        before using SMT siblings, and stay off the reserved cores.
+                        When -t is not given, the thread count excludes the reserved CPUs.
+
+ --huge-pages         : Back the large plotting buffers with huge pages to reduce TLB misses.
+                        Pre-allocated 1GiB or 2MiB pages (hugetlbfs) are used when available,
+                        otherwise transparent huge pages are requested (Linux only).
+                        The page size obtained for the buffers is printed.
+
+ --interleaved-deltas : Split the deltas of each line point park into interleaved streams,
+                        which are decoded in parallel, making proof lookups faster.
+                        *These plots can only be farmed by harvesters that support the format,
+                        they are marked with a plot header flag.*
+
+ --rans-deltas        : Code the deltas of each line point park with 32 interleaved rANS states,
+                        which are decoded with SIMD, instead of FSE.
+                        Same caveat as --interleaved-deltas. The last one given is used.
+
+ --aligned-parks      : Start each table on a 4 KiB page and pad the parks in page-sized groups,
+                        so that no park spans more pages than its size requires.
+                        Harvesters then read parks with direct I/O, without read amplification
+                        or going through the page cache.
+                        Plots are slightly larger. Same caveat as --interleaved-deltas.
+
+ --tuned-deltas       : Code the deltas of each line point table with a table fitted to that table's
+                        deltas, stored in the plot header, instead of a fixed one.
+                        Only supported by ramplot and recompress. Same caveat as --interleaved-deltas.
+
+ --serve <path>       : Keep the plotter and its buffers resident, and create plots
+                        for requests read from the named pipe at <path> (created if needed),
+                        or from stdin if <path> is '-'. Plotting starts only on request.
+                        Each line is a request with the same syntax as the global options:
+                         [-f <key>] [-p <key> | -c <address>] [-n <count>] [<out_dirs>]
+                        Unspecified values are kept from the previous request or the command line.
+                        -n defaults to 1. The compression level can't be changed by a request.
+                        Send 'quit' to exit.
+
+ --max-memory <size>  : Host memory budget for the plotter, ex: 96G.
+                        Each plotter picks its layout to fit it
+                        (diskplot: bucket count and cache size, cudaplot: hybrid mode)
+                        and exits early if it can't. The predicted peak is printed.
+
+ --max-pinned <size>  : Page-locked (pinned) memory budget, for cudaplot.
+
+ --io-status <sec>    : Write a json line with the temp file I/O status every <sec> seconds
+                        (diskplot and cudaplot in disk hybrid mode). For each file:
+                        bytes and operations read and written, throughput since the last
+                        report and latency percentiles, plus the queue depth and the time
+                        spent blocked waiting for I/O buffers.
+
+ --io-status-file <path>: Replace the file at <path> with the latest I/O status instead
+                        of writing it to stdout. Reports every 5 seconds if --io-status is not given.
+
+ --perf-counters      : Log hardware performance counters (Linux only): cycles, instructions,
+                        last level cache misses and branch misses of the plotting threads,
+                        and DRAM traffic where the memory controller counters are available,
+                        after each phase and table, and per thread pool job type after each plot.
+                        May need a lower /proc/sys/kernel/perf_event_paranoid.
+
+ --yield-to-harvest <ms>: Share the machine with a harvester: while a harvester on this machine
+                        is looking up or decompressing proofs, hold off on new thread pool jobs
+                        and GPU buckets, for up to <ms> milliseconds at a time. The harvester
+                        signals through shared memory, see GreenReaperConfig::yieldPlotters
+                        and grBeginHarvest() in the harvester library. Ex: 2000
+
+ --trace <path>       : Write a timeline of thread pool jobs, job thread syncs, disk queue,
+                        GPU queue and plot writer commands to <path> when bladebit exits.
+                        Open it in chrome://tracing or ui.perfetto.dev.
+                        Only available in builds configured with -DENABLE_TRACE=ON.
+
  --memory             : Display system memory available, in bytes, and the 
                         required memory to run Bladebit, in bytes.
 
@@ -611,10 +1580,81 @@ bladebit -t 24 -f <farmer_pub_key> -c <contract_address> diskplot -t1 /my/tempor
 
 # With fine-grained control over threads per phase/section (see bladebit -h diskplot):
 bladebit -t 30 -f <farmer_pub_key> -c <contract_address> diskplot --f1-threads 16 --c-threads 16 --p2-threads 8 -t1 /my/temporary/plot/dir /my/output/dir
+
+# Stream the plots straight to a harvester running 'bladebit receive -p 9700 -b 0.0.0.0 -t s3cr3t /mnt/farm' (see bladebit help receive):
+bladebit -t 24 -f <farmer_pub_key> -c <contract_address> diskplot -t1 /my/temporary/plot/dir tcp://s3cr3t@harvester:9700/disk1
 )";
 
 //-----------------------------------------------------------
 void PrintUsage()
 {
     Log::Line( USAGE );
+}
+
+//-----------------------------------------------------------
+static const char* BENCH_USAGE = "bench [OPTIONS] <ramplot|diskplot|cudaplot> [PLOTTER_OPTIONS] <out_dirs>\n"
+R"(
+Creates plots with a fixed plot id, memo and keys, so that every run, and every build,
+plots the exact same tables. Records the wall time of each phase and table,
+the CPU utilization of each phase, I/O wait times, the peak resident memory and,
+for cudaplot, the fraction of each Phase 1 table's time the GPU spent computing.
+The results are written as json, with the median of each metric over all runs in "summary".
+
+-f, -p, -c and -i may still be given to override the fixed keys and plot id.
+Use the global --benchmark option to skip writing the plots to disk.
+
+[OPTIONS]
+ --runs <n>          : Number of plots to time. Default = 1.
+
+ --json <path>       : Write the results to this file, instead of stdout.
+
+ --baseline <path>   : Compare against the json results of a previous benchmark.
+                       Exits with an error code if a phase or table got slower,
+                       or the peak memory grew, by more than the tolerance.
+
+ --tolerance <pct>   : Allowed slowdown over the baseline, in percent. Default = 5.
+
+[EXAMPLES]
+bladebit -t 32 bench --runs 3 --json ramplot-1.json ramplot /my/output/dir
+
+bladebit -t 32 --benchmark bench --baseline ramplot-1.json ramplot /my/output/dir
+)";
+
+//-----------------------------------------------------------
+void PlotBenchmarkPrintUsage()
+{
+    Log::Line( BENCH_USAGE );
+}
+
+//-----------------------------------------------------------
+static const char* MULTI_USAGE = "multi [-o <out_dir> ...] <plotter> [+ <plotter> ...]\n"
+R"(
+Runs several plotters side by side in one process, for example cudaplot on the GPU
+and diskplot on the cores it leaves idle. Each plotter is given as:
+
+ [-t <threads>] [--max-memory <size>] [-n <count>] <ramplot|diskplot|cudaplot> [PLOTTER_OPTIONS] [<out_dirs>]
+
+The global -t and --max-memory (or the system memory) are the shared budgets.
+Plotters given no -t or --max-memory split what the others leave evenly.
+Each plotter's compute threads are pinned to their own CPUs, so they don't compete for cores.
+-n defaults to the global -n. Plot ids from --ids are shared by all plotters.
+
+Plotters that list no output directories use the ones given with -o. When plotters share
+a directory, each plot goes to the shared directory with the fewest plots being written.
+
+After every plot, and at the end, the combined plots/day of all plotters is reported.
+
+[OPTIONS]
+ -o, --out <dir>  : Output directory for the plotters that don't list their own. Can be repeated.
+
+[EXAMPLES]
+bladebit -t 32 -f ... -c ... multi -o /mnt/dst1 -o /mnt/dst2 -t 8 cudaplot + diskplot -t1 /mnt/tmp
+
+bladebit -f ... -c ... multi -n 10 -t 4 --max-memory 64G cudaplot /mnt/dst1 + -n 2 ramplot /mnt/dst2
+)";
+
+//-----------------------------------------------------------
+void MultiPrintUsage()
+{
+    Log::Line( MULTI_USAGE );
 }
\ No newline at end of file
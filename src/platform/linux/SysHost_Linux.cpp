@@ -7,6 +7,10 @@
 #include <atomic>
 #include <errno.h>
 #include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <sched.h>
+#include <limits>
 #include <mutex>
 
 #if !defined(BB_IS_HARVESTER)
@@ -22,8 +26,22 @@
     #include "util/Log.h"
 // #endif
 
+// Older headers may not define the explicit huge page size flags
+#ifndef MAP_HUGE_SHIFT
+    #define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MAP_HUGE_2MB
+    #define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+#ifndef MAP_HUGE_1GB
+    #define MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#endif
+
 std::atomic<bool> _crashed = false;
 
+static uint GetCgroupCpuLimit();
+static bool GetCgroupMemoryLimit( uint64& outLimit, uint64& outFree );
+
 
 //-----------------------------------------------------------
 size_t SysHost::GetPageSize()
@@ -35,14 +53,26 @@ size_t SysHost::GetPageSize()
 size_t SysHost::GetTotalSystemMemory()
 {
     const size_t pageSize = GetPageSize();
-    return (size_t)get_phys_pages() * pageSize;
+    const size_t total    = (size_t)get_phys_pages() * pageSize;
+
+    uint64 limit, free;
+    if( GetCgroupMemoryLimit( limit, free ) )
+        return (size_t)std::min( (uint64)total, limit );
+
+    return total;
 }
 
 //-----------------------------------------------------------
 size_t SysHost::GetAvailableSystemMemory()
 {
-    const size_t pageSize = GetPageSize();
-    return (size_t)get_avphys_pages() * pageSize;
+    const size_t pageSize  = GetPageSize();
+    const size_t available = (size_t)get_avphys_pages() * pageSize;
+
+    uint64 limit, free;
+    if( GetCgroupMemoryLimit( limit, free ) )
+        return (size_t)std::min( (uint64)available, free );
+
+    return available;
 }
 
 //-----------------------------------------------------------
@@ -51,6 +81,30 @@ size_t SysHost::GetAvailableSystemMemory()
     return (uint)get_nprocs();
  }
 
+//-----------------------------------------------------------
+uint SysHost::GetUsableCPUCount()
+{
+    static const uint usableCount = []() {
+
+        uint count = GetLogicalCPUCount();
+
+        // The affinity mask holds the cpuset the process was started in
+        cpu_set_t cpus;
+        CPU_ZERO( &cpus );
+
+        if( sched_getaffinity( 0, sizeof( cpus ), &cpus ) == 0 )
+            count = std::min( count, (uint)CPU_COUNT( &cpus ) );
+
+        const uint quota = GetCgroupCpuLimit();
+        if( quota > 0 )
+            count = std::min( count, quota );
+
+        return std::max( 1u, count );
+    }();
+
+    return usableCount;
+}
+
 //-----------------------------------------------------------
 void* SysHost::VirtualAlloc( size_t size, bool initialize )
 {
@@ -99,6 +153,114 @@ void* SysHost::VirtualAlloc( size_t size, bool initialize )
     return ((byte*)ptr)+pageSize;
 }
 
+//-----------------------------------------------------------
+static bool IsTransparentHugePagesEnabled()
+{
+    // Contains "always [madvise] never", with the active mode in brackets
+    FILE* file = fopen( "/sys/kernel/mm/transparent_hugepage/enabled", "r" );
+    if( !file )
+        return false;
+
+    char mode[128] = {};
+    const bool read = fgets( mode, sizeof( mode ), file ) != nullptr;
+    fclose( file );
+
+    return read && strstr( mode, "[never]" ) == nullptr;
+}
+
+//-----------------------------------------------------------
+void* SysHost::VirtualAllocHuge( size_t size, bool allowExplicitPages, HugePageSize* outPageSize )
+{
+    const size_t pageSize = GetPageSize();
+    const size_t hugeSize = 2ull MB;
+
+    // Add one page to store our size, as in VirtualAlloc
+    const size_t allocSize = RoundUpToNextBoundaryT( size, pageSize ) + pageSize;
+
+    HugePageSize dummy;
+    if( !outPageSize )
+        outPageSize = &dummy;
+
+    if( allowExplicitPages )
+    {
+        struct
+        {
+            HugePageSize type;
+            size_t       size;
+            int          flags;
+        }
+        explicitPages[2] = {
+            { HugePageSize::Huge1G, 1ull GB, MAP_HUGE_1GB },
+            { HugePageSize::Huge2M, 2ull MB, MAP_HUGE_2MB },
+        };
+
+        for( auto& pages : explicitPages )
+        {
+            // Don't waste most of a huge page on a small allocation
+            if( allocSize < pages.size )
+                continue;
+
+            const size_t mapSize = RoundUpToNextBoundaryT( allocSize, pages.size );
+
+            // Pages are reserved up-front, so if this succeeds we actually got them.
+            void* ptr = mmap( NULL, mapSize,
+                PROT_READ | PROT_WRITE,
+                MAP_ANONYMOUS | MAP_PRIVATE | MAP_HUGETLB | pages.flags,
+                -1, 0
+            );
+
+            if( ptr != MAP_FAILED )
+            {
+                *((size_t*)ptr) = mapSize;
+                *outPageSize = pages.type;
+                return ((byte*)ptr)+pageSize;
+            }
+        }
+    }
+
+    // Fallback to regular pages. Align the mapping to 2MiB,
+    // so that all of it can be backed by transparent huge pages.
+    const size_t mapSize = RoundUpToNextBoundaryT( allocSize, hugeSize );
+
+    byte* rawPtr = (byte*)mmap( NULL, mapSize + hugeSize,
+        PROT_READ | PROT_WRITE,
+        MAP_ANONYMOUS | MAP_PRIVATE,
+        -1, 0
+    );
+
+    if( rawPtr == MAP_FAILED )
+    {
+        #if _DEBUG
+            const int err = errno;
+            Log::Line( "Error: mmap() returned %d (0x%x).", err, err );
+            ASSERT( 0 );
+        #endif
+
+        return nullptr;
+    }
+
+    // Give back the unaligned head and tail
+    byte* ptr = (byte*)RoundUpToNextBoundaryT( (uintptr_t)rawPtr, (uintptr_t)hugeSize );
+
+    if( ptr > rawPtr )
+        munmap( rawPtr, (size_t)(ptr - rawPtr) );
+
+    const size_t tailSize = (size_t)( ( rawPtr + mapSize + hugeSize ) - ( ptr + mapSize ) );
+    if( tailSize )
+        munmap( ptr + mapSize, tailSize );
+
+    *outPageSize = HugePageSize::None;
+
+    #if defined( MADV_HUGEPAGE )
+        if( madvise( ptr, mapSize, MADV_HUGEPAGE ) == 0 && IsTransparentHugePagesEnabled() )
+            *outPageSize = HugePageSize::Transparent;
+    #endif
+
+    *((size_t*)ptr) = mapSize;
+
+    return ptr+pageSize;
+}
+
 //-----------------------------------------------------------
 void SysHost::VirtualFree( void* ptr )
 {
@@ -208,6 +370,8 @@ void CrashHandler( int signal )
     const size_t MAX_POINTERS = 256;
     void* stackTrace[256] = { 0 };
 
+    Log::FlushOnCrash();
+
     fprintf( stderr, "*** Crashed! ***\n" );
     fflush( stderr );
 
@@ -294,6 +458,340 @@ void SysHost::Random( byte* buffer, size_t size )
     #endif
 }
 
+///
+/// Container limits
+///
+struct CgroupPaths
+{
+    std::string v2;                 // Path in the unified (v2) hierarchy
+    std::string cpuV1;              // Path in the v1 cpu controller hierarchy
+    std::string memoryV1;           // Path in the v1 memory controller hierarchy
+    bool        hasV2       = false;
+    bool        hasCpuV1    = false;
+    bool        hasMemoryV1 = false;
+};
+
+//-----------------------------------------------------------
+static const CgroupPaths& GetCgroupPaths()
+{
+    static const CgroupPaths cgroupPaths = []() {
+
+        CgroupPaths paths;
+
+        FILE* f = fopen( "/proc/self/cgroup", "r" );
+        if( !f )
+            return paths;
+
+        // Each line is "<hierarchy id>:<controller list>:<path>"
+        char line[1024];
+        while( fgets( line, sizeof( line ), f ) )
+        {
+            char* controllers = strchr( line, ':' );
+            if( !controllers )
+                continue;
+
+            controllers++;
+
+            char* path = strchr( controllers, ':' );
+            if( !path )
+                continue;
+
+            *path++ = 0;
+            path[strcspn( path, "\n" )] = 0;
+
+            // The v2 hierarchy has no controller list
+            if( *controllers == 0 )
+            {
+                paths.v2    = path;
+                paths.hasV2 = true;
+                continue;
+            }
+
+            char* save = nullptr;
+            for( char* c = strtok_r( controllers, ",", &save ); c; c = strtok_r( nullptr, ",", &save ) )
+            {
+                if( strcmp( c, "cpu" ) == 0 )
+                {
+                    paths.cpuV1    = path;
+                    paths.hasCpuV1 = true;
+                }
+                else if( strcmp( c, "memory" ) == 0 )
+                {
+                    paths.memoryV1    = path;
+                    paths.hasMemoryV1 = true;
+                }
+            }
+        }
+
+        fclose( f );
+        return paths;
+    }();
+
+    return cgroupPaths;
+}
+
+//-----------------------------------------------------------
+// Calls func with the directory of the process' cgroup and of each of its parents, up to the mount's root.
+// A container usually only sees its own cgroup, mounted as the root, so paths missing under the mount are skipped.
+template<typename TFunc>
+static void ForEachCgroupDir( const char* mount, std::string path, TFunc func )
+{
+    for( ;; )
+    {
+        func( std::string( mount ) + path + "/" );
+
+        const size_t slash = path.find_last_of( '/' );
+        if( slash == std::string::npos || path.length() <= 1 )
+            break;
+
+        path.resize( slash );
+    }
+}
+
+//-----------------------------------------------------------
+static int ScanCgroupFile( const std::string& dir, const char* file, const char* format, ... )
+{
+    FILE* f = fopen( ( dir + file ).c_str(), "r" );
+    if( !f )
+        return 0;
+
+    va_list args;
+    va_start( args, format );
+    const int count = vfscanf( f, format, args );
+    va_end( args );
+
+    fclose( f );
+    return count;
+}
+
+//-----------------------------------------------------------
+static uint64 ReadCgroupStat( const std::string& dir, const char* key )
+{
+    FILE* f = fopen( ( dir + "memory.stat" ).c_str(), "r" );
+    if( !f )
+        return 0;
+
+    char               name[64];
+    unsigned long long value  = 0;
+    uint64             result = 0;
+
+    while( fscanf( f, "%63s %llu", name, &value ) == 2 )
+    {
+        if( strcmp( name, key ) == 0 )
+        {
+            result = (uint64)value;
+            break;
+        }
+    }
+
+    fclose( f );
+    return result;
+}
+
+//-----------------------------------------------------------
+// Returns the CPU count allowed by the tightest cgroup CPU quota, rounded up, or 0 if there is no quota
+uint GetCgroupCpuLimit()
+{
+    const CgroupPaths& cgroup = GetCgroupPaths();
+
+    uint limit = 0;
+
+    auto applyQuota = [&]( const uint64 quota, const uint64 period ) {
+        if( quota == 0 || period == 0 )
+            return;
+
+        const uint cpus = (uint)std::max<uint64>( 1, CDivT( quota, period ) );
+        limit = limit == 0 ? cpus : std::min( limit, cpus );
+    };
+
+    if( cgroup.hasV2 )
+    {
+        ForEachCgroupDir( "/sys/fs/cgroup", cgroup.v2, [&]( const std::string& dir ) {
+            char               quota[32];
+            unsigned long long period = 0;
+
+            // "max <period>" when there is no quota
+            if( ScanCgroupFile( dir, "cpu.max", "%31s %llu", quota, &period ) == 2 && strcmp( quota, "max" ) != 0 )
+                applyQuota( strtoull( quota, nullptr, 10 ), period );
+        });
+    }
+
+    if( cgroup.hasCpuV1 )
+    {
+        ForEachCgroupDir( "/sys/fs/cgroup/cpu", cgroup.cpuV1, [&]( const std::string& dir ) {
+            long long          quota  = -1;
+            unsigned long long period = 0;
+
+            // A quota of -1 means there is none
+            if( ScanCgroupFile( dir, "cpu.cfs_quota_us" , "%lld", &quota  ) == 1 && quota > 0 &&
+                ScanCgroupFile( dir, "cpu.cfs_period_us", "%llu", &period ) == 1 )
+                applyQuota( (uint64)quota, period );
+        });
+    }
+
+    return limit;
+}
+
+//-----------------------------------------------------------
+// Gets the tightest cgroup memory limit, and how much of it is left before it is hit.
+// Returns false if the process has no memory limit.
+bool GetCgroupMemoryLimit( uint64& outLimit, uint64& outFree )
+{
+    const CgroupPaths& cgroup = GetCgroupPaths();
+
+    outLimit = std::numeric_limits<uint64>::max();
+    outFree  = std::numeric_limits<uint64>::max();
+
+    auto applyLimit = [&]( const uint64 limit, const uint64 usage, const uint64 inactiveFile ) {
+
+        // Inactive page cache is reclaimed before the limit is enforced
+        const uint64 used = usage - std::min( usage, inactiveFile );
+
+        outLimit = std::min( outLimit, limit );
+        outFree  = std::min( outFree , limit - std::min( limit, used ) );
+    };
+
+    if( cgroup.hasV2 )
+    {
+        ForEachCgroupDir( "/sys/fs/cgroup", cgroup.v2, [&]( const std::string& dir ) {
+            unsigned long long limit = 0, usage = 0;
+
+            // Fails to parse "max" when there is no limit
+            if( ScanCgroupFile( dir, "memory.max", "%llu", &limit ) != 1 )
+                return;
+
+            ScanCgroupFile( dir, "memory.current", "%llu", &usage );
+            applyLimit( limit, usage, ReadCgroupStat( dir, "inactive_file" ) );
+        });
+    }
+
+    if( cgroup.hasMemoryV1 )
+    {
+        ForEachCgroupDir( "/sys/fs/cgroup/memory", cgroup.memoryV1, [&]( const std::string& dir ) {
+            unsigned long long limit = 0, usage = 0;
+
+            // No limit is reported as a near-max, page-aligned value, which the physical memory caps
+            if( ScanCgroupFile( dir, "memory.limit_in_bytes", "%llu", &limit ) != 1 )
+                return;
+
+            ScanCgroupFile( dir, "memory.usage_in_bytes", "%llu", &usage );
+            applyLimit( limit, usage, ReadCgroupStat( dir, "total_inactive_file" ) );
+        });
+    }
+
+    return outLimit != std::numeric_limits<uint64>::max();
+}
+
+//-----------------------------------------------------------
+static bool ReadCpuSysFsU32( const uint32 cpuId, const char* file, uint32& outValue )
+{
+    char path[128];
+    snprintf( path, sizeof( path ), "/sys/devices/system/cpu/cpu%u/%s", cpuId, file );
+
+    FILE* f = fopen( path, "r" );
+    if( !f )
+        return false;
+
+    // For cpu lists (ex. "0-7,64-71") this reads the first CPU
+    unsigned int value = 0;
+    const bool read = fscanf( f, "%u", &value ) == 1;
+    fclose( f );
+
+    if( read )
+        outValue = (uint32)value;
+
+    return read;
+}
+
+//-----------------------------------------------------------
+static uint32 DenseIndex( std::vector<uint64>& keys, const uint64 key )
+{
+    for( size_t i = 0; i < keys.size(); i++ )
+    {
+        if( keys[i] == key )
+            return (uint32)i;
+    }
+
+    keys.push_back( key );
+    return (uint32)keys.size() - 1;
+}
+
+//-----------------------------------------------------------
+static CpuTopology* CreateCpuTopology()
+{
+    const uint32 maxCpuId = (uint32)get_nprocs_conf();
+
+    CpuInfo* cpus     = bbcalloc<CpuInfo>( maxCpuId );
+    uint32   cpuCount = 0;
+
+    std::vector<uint64> packages, cores, l3s;
+    std::vector<uint32> coreThreads;
+
+    for( uint32 id = 0; id < maxCpuId; id++ )
+    {
+        // The boot CPU usually can't be taken offline, and has no 'online' file
+        uint32 online = 1;
+        ReadCpuSysFsU32( id, "online", online );
+
+        if( !online )
+            continue;
+
+        uint32 package = 0, coreId = id, l3Id = 0;
+
+        if( !ReadCpuSysFsU32( id, "topology/physical_package_id", package ) )
+            continue;
+
+        ReadCpuSysFsU32( id, "topology/core_id", coreId );
+
+        // Older kernels don't expose cache ids, use the first CPU sharing the cache instead.
+        // Without an L3 (or on most ARM parts), the whole package is one domain.
+        if( !ReadCpuSysFsU32( id, "cache/index3/id", l3Id ) )
+            ReadCpuSysFsU32( id, "cache/index3/shared_cpu_list", l3Id );
+
+        CpuInfo& cpu = cpus[cpuCount++];
+        cpu.id      = id;
+        cpu.package = DenseIndex( packages, package );
+        cpu.core    = DenseIndex( cores   , ( (uint64)package << 32 ) | coreId );
+        cpu.l3      = DenseIndex( l3s     , ( (uint64)package << 32 ) | l3Id   );
+
+        if( cpu.core >= coreThreads.size() )
+            coreThreads.push_back( 0 );
+
+        cpu.smt = coreThreads[cpu.core]++;
+    }
+
+    auto* topology = new CpuTopology();
+
+    if( cpuCount == 0 )
+    {
+        // No sysfs: every CPU is a core of its own
+        cpuCount = std::min( SysHost::GetLogicalCPUCount(), maxCpuId );
+
+        for( uint32 i = 0; i < cpuCount; i++ )
+            cpus[i] = { i, 0, i, 0, 0 };
+
+        topology->packageCount = 1;
+        topology->coreCount    = cpuCount;
+        topology->l3Count      = 1;
+    }
+    else
+    {
+        topology->packageCount = (uint32)packages.size();
+        topology->coreCount    = (uint32)cores.size();
+        topology->l3Count      = (uint32)l3s.size();
+    }
+
+    topology->cpus = Span<CpuInfo>( cpus, cpuCount );
+    return topology;
+}
+
+//-----------------------------------------------------------
+const CpuTopology& SysHost::GetCpuTopology()
+{
+    static const CpuTopology* topology = CreateCpuTopology();
+    return *topology;
+}
+
 // #NOTE: This is not thread-safe
 //-----------------------------------------------------------
 const NumaInfo* SysHost::GetNUMAInfo()
@@ -67,6 +67,12 @@ uint SysHost::GetLogicalCPUCount()
     return (uint)info.avail_cpus;
 }
 
+//-----------------------------------------------------------
+uint SysHost::GetUsableCPUCount()
+{
+    return GetLogicalCPUCount();
+}
+
 //-----------------------------------------------------------
 void* SysHost::VirtualAlloc( size_t size, bool initialize )
 {
@@ -151,6 +157,18 @@ void* SysHost::VirtualAlloc( size_t size, bool initialize )
 //    return ptr;
 }
 
+//-----------------------------------------------------------
+void* SysHost::VirtualAllocHuge( size_t size, bool allowExplicitPages, HugePageSize* outPageSize )
+{
+    // #TODO: Support large pages here too. For now, fallback to regular pages.
+    (void)allowExplicitPages;
+
+    if( outPageSize )
+        *outPageSize = HugePageSize::None;
+
+    return VirtualAlloc( size, false );
+}
+
 //-----------------------------------------------------------
 void SysHost::VirtualFree( void* ptr )
 {
@@ -244,6 +262,29 @@ void SysHost::Random( byte* buffer, size_t size )
 }
 
 
+//-----------------------------------------------------------
+const CpuTopology& SysHost::GetCpuTopology()
+{
+    // Thread affinity is not supported on macOS, so the topology is of no use: report every CPU as its own core
+    static const CpuTopology* topology = []() {
+
+        const uint32 cpuCount = GetLogicalCPUCount();
+        CpuInfo*     cpus     = bbcalloc<CpuInfo>( cpuCount );
+
+        for( uint32 i = 0; i < cpuCount; i++ )
+            cpus[i] = { i, 0, i, 0, 0 };
+
+        auto* t = new CpuTopology();
+        t->packageCount = 1;
+        t->coreCount    = cpuCount;
+        t->l3Count      = 1;
+        t->cpus         = Span<CpuInfo>( cpus, cpuCount );
+        return t;
+    }();
+
+    return *topology;
+}
+
 ///
 /// NUMA (no support on macOS)
 ///
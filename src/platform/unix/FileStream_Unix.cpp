@@ -3,8 +3,79 @@
 #include "util/Log.h"
 
 #include <sys/stat.h>
+#include <sys/file.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <sys/uio.h>
+#include <climits>
+
+#if PLATFORM_IS_LINUX
+    #include <linux/io_uring.h>
+    #include <sys/mman.h>
+    #include <sys/syscall.h>
+    #include <sys/sysmacros.h>
+#endif
+
+#if PLATFORM_IS_LINUX
+//----------------------------------------------------------
+static size_t ReadBlockQueueAttribute( const dev_t dev, const char* attribute )
+{
+    // Partitions don't have a queue of their own, their parent device does
+    const char* queueDirs[] = { "queue", "../queue" };
+
+    for( const char* queueDir : queueDirs )
+    {
+        char path[256];
+        snprintf( path, sizeof( path ), "/sys/dev/block/%u:%u/%s/%s", major( dev ), minor( dev ), queueDir, attribute );
+
+        FILE* f = fopen( path, "r" );
+        if( !f )
+            continue;
+
+        unsigned long long value = 0;
+        const bool read = fscanf( f, "%llu", &value ) == 1;
+        fclose( f );
+
+        if( read )
+            return (size_t)value;
+    }
+
+    return 0;
+}
+
+//----------------------------------------------------------
+// st_blksize is only the file system's preferred I/O size. On RAID/LVM volumes it is
+// often the full stripe width (e.g. 512 KiB or more), which is far larger than what
+// O_DIRECT actually requires and bloats every block-aligned buffer in the plotter.
+// So the direct I/O alignment is taken from the device instead, and the stripe-sized
+// value is kept separately as the optimal I/O size.
+static void GetDeviceIOSizes( const int fd, const struct stat& fs, size_t& outBlockSize, size_t& outOptimalIOSize )
+{
+    size_t blockSize = 0;
+
+    #ifdef STATX_DIOALIGN
+    {
+        struct statx sx = {};
+        if( statx( fd, "", AT_EMPTY_PATH, STATX_DIOALIGN, &sx ) == 0 && ( sx.stx_mask & STATX_DIOALIGN ) )
+            blockSize = (size_t)sx.stx_dio_offset_align;
+    }
+    #endif
+
+    // Still prefer the physical sector size to avoid read-modify-write cycles on 4K-native drives
+    blockSize = std::max( blockSize, ReadBlockQueueAttribute( fs.st_dev, "physical_block_size" ) );
+
+    size_t optimalIOSize = ReadBlockQueueAttribute( fs.st_dev, "optimal_io_size" );
+    if( optimalIOSize == 0 )
+        optimalIOSize = (size_t)fs.st_blksize;
+
+    // Not backed by a block device we can query (tmpfs, network file systems, etc.)
+    if( blockSize == 0 || ( blockSize & ( blockSize - 1 ) ) != 0 )
+        blockSize = (size_t)fs.st_blksize;
+
+    outBlockSize     = blockSize;
+    outOptimalIOSize = RoundUpToNextBoundaryT( std::max( optimalIOSize, blockSize ), blockSize );
+}
+#endif
 
 //----------------------------------------------------------
 bool FileStream::Open( const char* path, FileMode mode, FileAccess access, FileFlags flags )
@@ -64,14 +135,20 @@ bool FileStream::Open( const char* path, FileStream& file, FileMode mode, FileAc
     #endif
 
     // Get the block size (useful when using O_DIRECT)
-    int blockSize = 0;
+    size_t blockSize     = 0;
+    size_t optimalIOSize = 0;
     {
         struct stat fs;
         int r = fstat( fd, &fs );
 
         if( r == 0 )
         {
-            blockSize = (size_t)fs.st_blksize;
+            #if PLATFORM_IS_LINUX
+                GetDeviceIOSizes( fd, fs, blockSize, optimalIOSize );
+            #else
+                blockSize     = (size_t)fs.st_blksize;
+                optimalIOSize = blockSize;
+            #endif
         }
         else
         {
@@ -85,7 +162,8 @@ bool FileStream::Open( const char* path, FileStream& file, FileMode mode, FileAc
     }
     
     file._fd            = fd;
-    file._blockSize     = (size_t)blockSize;
+    file._blockSize     = blockSize;
+    file._optimalIOSize = optimalIOSize;
     file._position      = 0;
     file._access        = access;
     file._flags         = flags;
@@ -114,6 +192,7 @@ void FileStream::Close()
     _access        = FileAccess::None;
     _error         = 0;
     _blockSize     = 0;
+    _optimalIOSize = 0;
 }
 
 //-----------------------------------------------------------
@@ -230,11 +309,115 @@ ssize_t FileStream::Write( const void* buffer, size_t size )
     return written;
 }
 
+//----------------------------------------------------------
+template<bool IsWrite>
+static ssize_t TransferV( const int fd, const FileIOVec* vecs, const uint32 count, const uint64 offset, int& error )
+{
+    // Cap each call like Write() does, and to the max vector count
+    const size_t MAX_CALL_SIZE = 0x7ffff000;
+    const uint32 MAX_CALL_VECS = std::min( (uint32)IOV_MAX, 64u );
+
+    iovec  iov[64];
+    size_t total     = 0;
+    uint32 vec       = 0;
+    size_t vecOffset = 0;   // Bytes already transferred of vecs[vec]
+
+    while( vec < count )
+    {
+        uint32 iovCount = 0;
+        size_t callSize = 0;
+
+        for( uint32 i = vec; i < count && iovCount < MAX_CALL_VECS && callSize < MAX_CALL_SIZE; i++ )
+        {
+            const size_t skip = i == vec ? vecOffset : 0;
+            const size_t size = std::min( vecs[i].size - skip, MAX_CALL_SIZE - callSize );
+
+            iov[iovCount].iov_base = (byte*)vecs[i].buffer + skip;
+            iov[iovCount].iov_len  = size;
+            iovCount++;
+            callSize += size;
+        }
+
+        const off_t   pos = (off_t)( offset + total );
+        const ssize_t r   = IsWrite ? pwritev( fd, iov, (int)iovCount, pos ) : preadv( fd, iov, (int)iovCount, pos );
+
+        if( r < 0 )
+        {
+            if( errno == EINTR )
+                continue;
+
+            error = errno;
+            return -1;
+        }
+
+        if( r == 0 )
+        {
+            // End-of-file, or only empty vectors were left
+            if( callSize > 0 )
+                break;
+
+            vec += iovCount;
+            continue;
+        }
+
+        total += (size_t)r;
+
+        // Advance past what was transferred
+        size_t transferred = (size_t)r;
+        while( transferred > 0 )
+        {
+            const size_t remainder = vecs[vec].size - vecOffset;
+
+            if( transferred < remainder )
+            {
+                vecOffset += transferred;
+                break;
+            }
+
+            transferred -= remainder;
+            vecOffset    = 0;
+            vec++;
+        }
+    }
+
+    return (ssize_t)total;
+}
+
+//----------------------------------------------------------
+ssize_t FileStream::ReadV( const FileIOVec* vecs, const uint32 count, const uint64 offset )
+{
+    ASSERT( vecs || count == 0 );
+
+    if( !IsFlagSet( _access, FileAccess::Read ) || _fd < 0 )
+    {
+        _error = -1;
+        return -1;
+    }
+
+    return TransferV<false>( _fd, vecs, count, offset, _error );
+}
+
+//----------------------------------------------------------
+ssize_t FileStream::WriteV( const FileIOVec* vecs, const uint32 count, const uint64 offset )
+{
+    ASSERT( vecs || count == 0 );
+
+    if( !IsFlagSet( _access, FileAccess::Write ) || _fd < 0 )
+    {
+        _error = -1;
+        return -1;
+    }
+
+    return TransferV<true>( _fd, vecs, count, offset, _error );
+}
+
 //----------------------------------------------------------
 bool FileStream::Reserve( ssize_t size )
 {
     #if PLATFORM_IS_LINUX
-        int r = posix_fallocate( _fd, 0, (off_t)size );
+        // Not posix_fallocate(), which falls back to writing the whole range
+        // on file systems that don't support allocating extents.
+        int r = fallocate( _fd, 0, 0, (off_t)size );
         if( r != 0 )
         {
             _error = errno;
@@ -249,6 +432,43 @@ bool FileStream::Reserve( ssize_t size )
     return true;
 }
 
+//----------------------------------------------------------
+bool FileStream::Advise( const FileAdvice advice, const size_t offset, const size_t length )
+{
+    if( !IsOpen() )
+        return false;
+
+    #if PLATFORM_IS_LINUX
+        const int r = posix_fadvise( _fd, (off_t)offset, (off_t)length,
+                                     advice == FileAdvice::Sequential ? POSIX_FADV_SEQUENTIAL : POSIX_FADV_WILLNEED );
+        if( r != 0 )
+        {
+            _error = r;
+            return false;
+        }
+    #elif PLATFORM_IS_MACOS
+        int r;
+        if( advice == FileAdvice::Sequential )
+            r = fcntl( _fd, F_RDAHEAD, 1 );
+        else
+        {
+            struct radvisory ra;
+            ra.ra_offset = (off_t)offset;
+            ra.ra_count  = (int)std::min( length == 0 ? (size_t)0x7FFFFFFF : length, (size_t)0x7FFFFFFF );
+
+            r = fcntl( _fd, F_RDADVISE, &ra );
+        }
+
+        if( r == -1 )
+        {
+            _error = errno;
+            return false;
+        }
+    #endif
+
+    return true;
+}
+
 //----------------------------------------------------------
 bool FileStream::Seek( int64 offset, SeekOrigin origin )
 {
@@ -292,6 +512,41 @@ bool FileStream::Flush()
     return true;
 }
 
+//-----------------------------------------------------------
+bool FileStream::Lock( const bool block )
+{
+    if( !IsOpen() )
+        return false;
+
+    int r;
+    do {
+        r = flock( _fd, LOCK_EX | ( block ? 0 : LOCK_NB ) );
+    } while( r == -1 && errno == EINTR );
+
+    if( r )
+    {
+        _error = errno;
+        return false;
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------
+bool FileStream::Unlock()
+{
+    if( !IsOpen() )
+        return false;
+
+    if( flock( _fd, LOCK_UN ) )
+    {
+        _error = errno;
+        return false;
+    }
+
+    return true;
+}
+
 //-----------------------------------------------------------
 bool FileStream::IsOpen() const
 {
@@ -315,14 +570,40 @@ bool FileStream::Exists( const char* path )
 //-----------------------------------------------------------
 size_t FileStream::GetBlockSizeForPath( const char* pathU8 )
 {
+    size_t blockSize, optimalIOSize;
+    if( !GetIOSizesForPath( pathU8, blockSize, optimalIOSize ) )
+        return 0;
+
+    return blockSize;
+}
+
+//-----------------------------------------------------------
+bool FileStream::GetIOSizesForPath( const char* pathU8, size_t& outBlockSize, size_t& outOptimalIOSize )
+{
+    outBlockSize     = 0;
+    outOptimalIOSize = 0;
+
     FileStream file;
     if( !file.Open( pathU8, FileMode::Open, FileAccess::Read ) )
     {
-        Log::Error( "GetBlockSizeForPath() failed with error %d.", (int32)file.GetError() );
-        return 0;
+        Log::Error( "GetIOSizesForPath() failed with error %d.", (int32)file.GetError() );
+        return false;
     }
     
-    return file.BlockSize();
+    outBlockSize     = file.BlockSize();
+    outOptimalIOSize = file.OptimalIOSize();
+    return true;
+}
+
+//-----------------------------------------------------------
+bool FileStream::GetDeviceIdForPath( const char* pathU8, uint64& outDeviceId )
+{
+    struct stat fs;
+    if( stat( pathU8, &fs ) != 0 )
+        return false;
+
+    outDeviceId = (uint64)fs.st_dev;
+    return true;
 }
 
 //-----------------------------------------------------------
@@ -336,3 +617,448 @@ bool FileStream::Move( const char* oldPathU8, const char* newPathU8, int32* outE
     return moved;
 }
 
+
+#if PLATFORM_IS_LINUX
+
+///
+/// FileIOBatch
+///
+
+// The kernel caps each registered buffer at 1GiB, so larger regions
+// are registered as consecutive 1GiB buffers.
+static constexpr size_t IO_URING_MAX_FIXED_BUFFER_BITS = 30;
+static constexpr size_t IO_URING_MAX_FIXED_BUFFER      = 1ull << IO_URING_MAX_FIXED_BUFFER_BITS;
+
+struct FileIOBatch::Ring
+{
+    int             fd;
+    uint32          entries;
+
+    void*           sqMap;
+    size_t          sqMapSize;
+    void*           cqMap;
+    size_t          cqMapSize;
+    io_uring_sqe*   sqes;
+
+    uint32*         sqHead;
+    uint32*         sqTail;
+    uint32          sqMask;
+    uint32*         sqArray;
+
+    uint32*         cqHead;
+    uint32*         cqTail;
+    uint32          cqMask;
+    io_uring_cqe*   cqes;
+};
+
+struct FileIOBatch::Request
+{
+    FileStream* file;
+    byte*       buffer;
+    size_t      size;           // Bytes left to transfer
+    size_t      transferred;
+    uint64      offset;
+    bool        isWrite;
+    iovec       iov;
+};
+
+//-----------------------------------------------------------
+static inline int IOUringSetup( uint32 entries, io_uring_params* params )
+{
+    return (int)syscall( __NR_io_uring_setup, entries, params );
+}
+
+//-----------------------------------------------------------
+static inline int IOUringEnter( int fd, uint32 toSubmit, uint32 minComplete, uint32 flags )
+{
+    return (int)syscall( __NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0 );
+}
+
+//-----------------------------------------------------------
+static inline int IOUringRegister( int fd, uint32 opcode, const void* arg, uint32 argCount )
+{
+    return (int)syscall( __NR_io_uring_register, fd, opcode, arg, argCount );
+}
+
+//-----------------------------------------------------------
+FileIOBatch::~FileIOBatch()
+{
+    if( _ring )
+    {
+        UnregisterBuffer();
+
+        munmap( _ring->sqes, _ring->entries * sizeof( io_uring_sqe ) );
+        if( _ring->cqMap != _ring->sqMap )
+            munmap( _ring->cqMap, _ring->cqMapSize );
+        munmap( _ring->sqMap, _ring->sqMapSize );
+        close( _ring->fd );
+
+        delete _ring;
+        _ring = nullptr;
+    }
+
+    free( _requests );
+    _requests = nullptr;
+}
+
+//-----------------------------------------------------------
+uint32 FileIOBatch::QueueDepth() const
+{
+    return _ring ? _ring->entries : 0;
+}
+
+//-----------------------------------------------------------
+bool FileIOBatch::Init( const uint32 queueDepth )
+{
+    ASSERT( !_ring );
+    ASSERT( queueDepth );
+
+    io_uring_params params = {};
+
+    const int fd = IOUringSetup( queueDepth, &params );
+    if( fd < 0 )
+        return false;
+
+    Ring ring = {};
+    ring.fd      = fd;
+    ring.entries = params.sq_entries;
+
+    ring.sqMapSize = params.sq_off.array + params.sq_entries * sizeof( uint32 );
+    ring.cqMapSize = params.cq_off.cqes  + params.cq_entries * sizeof( io_uring_cqe );
+
+    const bool singleMap = ( params.features & IORING_FEAT_SINGLE_MMAP ) != 0;
+    if( singleMap )
+        ring.sqMapSize = ring.cqMapSize = std::max( ring.sqMapSize, ring.cqMapSize );
+
+    ring.sqMap = mmap( nullptr, ring.sqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING );
+    if( ring.sqMap == MAP_FAILED )
+    {
+        close( fd );
+        return false;
+    }
+
+    if( singleMap )
+        ring.cqMap = ring.sqMap;
+    else
+    {
+        ring.cqMap = mmap( nullptr, ring.cqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING );
+        if( ring.cqMap == MAP_FAILED )
+        {
+            munmap( ring.sqMap, ring.sqMapSize );
+            close( fd );
+            return false;
+        }
+    }
+
+    ring.sqes = (io_uring_sqe*)mmap( nullptr, params.sq_entries * sizeof( io_uring_sqe ), PROT_READ | PROT_WRITE, 
+                                     MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES );
+    if( ring.sqes == MAP_FAILED )
+    {
+        if( !singleMap )
+            munmap( ring.cqMap, ring.cqMapSize );
+        munmap( ring.sqMap, ring.sqMapSize );
+        close( fd );
+        return false;
+    }
+
+    byte* sq = (byte*)ring.sqMap;
+    byte* cq = (byte*)ring.cqMap;
+
+    ring.sqHead  = (uint32*)( sq + params.sq_off.head );
+    ring.sqTail  = (uint32*)( sq + params.sq_off.tail );
+    ring.sqMask  = *(uint32*)( sq + params.sq_off.ring_mask );
+    ring.sqArray = (uint32*)( sq + params.sq_off.array );
+
+    ring.cqHead  = (uint32*)( cq + params.cq_off.head );
+    ring.cqTail  = (uint32*)( cq + params.cq_off.tail );
+    ring.cqMask  = *(uint32*)( cq + params.cq_off.ring_mask );
+    ring.cqes    = (io_uring_cqe*)( cq + params.cq_off.cqes );
+
+    _ring = new Ring( ring );
+    return true;
+}
+
+//-----------------------------------------------------------
+bool FileIOBatch::RegisterBuffer( void* buffer, const size_t size )
+{
+    ASSERT( _ring );
+    ASSERT( buffer && size );
+
+    UnregisterBuffer();
+
+    const uint32 bufferCount = (uint32)CDiv( size, IO_URING_MAX_FIXED_BUFFER );
+    iovec*       iovecs      = bbcalloc<iovec>( bufferCount );
+
+    for( uint32 i = 0; i < bufferCount; i++ )
+    {
+        const size_t offset = IO_URING_MAX_FIXED_BUFFER * i;
+
+        iovecs[i].iov_base = (byte*)buffer + offset;
+        iovecs[i].iov_len  = std::min( IO_URING_MAX_FIXED_BUFFER, size - offset );
+    }
+
+    const int r = IOUringRegister( _ring->fd, IORING_REGISTER_BUFFERS, iovecs, bufferCount );
+    free( iovecs );
+
+    if( r < 0 )
+        return false;
+
+    _fixedBuffer = (byte*)buffer;
+    _fixedSize   = size;
+    return true;
+}
+
+//-----------------------------------------------------------
+void FileIOBatch::UnregisterBuffer()
+{
+    if( !_fixedBuffer )
+        return;
+
+    IOUringRegister( _ring->fd, IORING_UNREGISTER_BUFFERS, nullptr, 0 );
+    _fixedBuffer = nullptr;
+    _fixedSize   = 0;
+}
+
+//-----------------------------------------------------------
+uint32 FileIOBatch::Read( FileStream& file, void* buffer, const size_t size, const uint64 offset )
+{
+    return Enqueue( file, buffer, size, offset, false );
+}
+
+//-----------------------------------------------------------
+uint32 FileIOBatch::Write( FileStream& file, const void* buffer, const size_t size, const uint64 offset )
+{
+    return Enqueue( file, (void*)buffer, size, offset, true );
+}
+
+//-----------------------------------------------------------
+uint32 FileIOBatch::Read( FileStream& file, void* buffer, const size_t size )
+{
+    return Enqueue( file, buffer, size, file._position, false );
+}
+
+//-----------------------------------------------------------
+uint32 FileIOBatch::Write( FileStream& file, const void* buffer, const size_t size )
+{
+    return Enqueue( file, (void*)buffer, size, file._position, true );
+}
+
+//-----------------------------------------------------------
+uint32 FileIOBatch::Enqueue( FileStream& file, void* buffer, const size_t size, const uint64 offset, const bool isWrite )
+{
+    ASSERT( _ring );
+    ASSERT( buffer );
+    ASSERT( file.IsOpen() );
+
+    if( _count == _capacity )
+    {
+        _capacity = std::max( 64u, _capacity * 2 );
+        _requests = bbcrealloc<Request>( _requests, _capacity );
+    }
+
+    Request& req = _requests[_count];
+    req.file        = &file;
+    req.buffer      = (byte*)buffer;
+    req.size        = size;
+    req.transferred = 0;
+    req.offset      = offset;
+    req.isWrite     = isWrite;
+
+    // The file position is only synced with the kernel's once the batch is submitted
+    file._position = (size_t)( offset + size );
+
+    return _count++;
+}
+
+//-----------------------------------------------------------
+bool FileIOBatch::Submit( int& outError )
+{
+    ASSERT( _ring );
+
+    outError = 0;
+
+    Ring&        ring        = *_ring;
+    const uint32 count       = _count;
+    const uint32 maxInFlight = _maxInFlight ? std::min( _maxInFlight, ring.entries ) : ring.entries;
+    uint32       next        = 0;      // Next request that has not been submitted yet
+    uint32       inFlight    = 0;
+
+    // Requests that completed a partial transfer, and need to be re-issued for the remainder
+    uint32* resubmit      = (uint32*)alloca( ring.entries * sizeof( uint32 ) );
+    uint32  resubmitCount = 0;
+    
+    auto prepare = [&]( Request& req, const uint32 index, io_uring_sqe& sqe ) {
+
+        // Cap to the Linux read()/write() maximum, the rest will be re-issued
+        const size_t ioSize = std::min( req.size, (size_t)0x7ffff000 );
+
+        memset( &sqe, 0, sizeof( sqe ) );
+        sqe.fd        = (int)req.file->_fd;
+        sqe.off       = req.offset;
+        sqe.user_data = index;
+
+        const bool isFixed = req.buffer >= _fixedBuffer && req.buffer + ioSize <= _fixedBuffer + _fixedSize &&
+            ( (size_t)( req.buffer - _fixedBuffer ) >> IO_URING_MAX_FIXED_BUFFER_BITS ) ==
+            ( (size_t)( req.buffer + ioSize - 1 - _fixedBuffer ) >> IO_URING_MAX_FIXED_BUFFER_BITS );
+
+        if( isFixed )
+        {
+            sqe.opcode    = req.isWrite ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+            sqe.addr      = (uint64)(uintptr_t)req.buffer;
+            sqe.len       = (uint32)ioSize;
+            sqe.buf_index = (uint16)( (size_t)( req.buffer - _fixedBuffer ) >> IO_URING_MAX_FIXED_BUFFER_BITS );
+        }
+        else
+        {
+            req.iov.iov_base = req.buffer;
+            req.iov.iov_len  = ioSize;
+
+            sqe.opcode    = req.isWrite ? IORING_OP_WRITEV : IORING_OP_READV;
+            sqe.addr      = (uint64)(uintptr_t)&req.iov;
+            sqe.len       = 1;
+        }
+    };
+
+    while( next < count || resubmitCount || inFlight )
+    {
+        // Fill the submission queue.
+        // inFlight counts every entry placed in the ring that has not completed yet.
+        {
+            uint32 tail = *ring.sqTail;
+
+            while( inFlight < maxInFlight )
+            {
+                uint32 index;
+                if( resubmitCount )
+                    index = resubmit[--resubmitCount];
+                else if( next < count )
+                    index = next++;
+                else
+                    break;
+
+                Request& req = _requests[index];
+
+                if( req.size == 0 )
+                    continue;
+
+                const uint32 slot = tail & ring.sqMask;
+                prepare( req, index, ring.sqes[slot] );
+                ring.sqArray[slot] = slot;
+
+                tail++;
+                inFlight++;
+            }
+
+            __atomic_store_n( ring.sqTail, tail, __ATOMIC_RELEASE );
+        }
+
+        if( inFlight == 0 )
+            continue;
+
+        // Submit whatever the kernel has not consumed yet, and wait for at least one completion
+        const uint32 toSubmit = *ring.sqTail - __atomic_load_n( ring.sqHead, __ATOMIC_ACQUIRE );
+
+        const int r = IOUringEnter( ring.fd, toSubmit, 1, IORING_ENTER_GETEVENTS );
+        if( r < 0 )
+        {
+            if( errno == EINTR || errno == EAGAIN || errno == EBUSY )
+                continue;
+
+            if( outError == 0 )
+                outError = errno;
+
+            // Can't even wait on the ring, nothing more can be reaped
+            if( toSubmit == 0 )
+                break;
+
+            // Withdraw the entries the kernel has not consumed (it only does so in io_uring_enter),
+            // but keep reaping the ones it has, as they still reference the request buffers.
+            const uint32 sqHead = __atomic_load_n( ring.sqHead, __ATOMIC_ACQUIRE );
+
+            inFlight -= *ring.sqTail - sqHead;
+            __atomic_store_n( ring.sqTail, sqHead, __ATOMIC_RELEASE );
+
+            next          = count;
+            resubmitCount = 0;
+            continue;
+        }
+
+        // Reap completions
+        uint32       head = *ring.cqHead;
+        const uint32 tail = __atomic_load_n( ring.cqTail, __ATOMIC_ACQUIRE );
+
+        for( ; head != tail; head++ )
+        {
+            const io_uring_cqe& cqe   = ring.cqes[head & ring.cqMask];
+            const uint32        index = (uint32)cqe.user_data;
+            Request&            req   = _requests[index];
+            
+            inFlight--;
+
+            if( cqe.res < 0 )
+            {
+                if( cqe.res == -EINTR || cqe.res == -EAGAIN )
+                    resubmit[resubmitCount++] = index;
+                else if( outError == 0 )
+                    outError = -cqe.res;
+
+                continue;
+            }
+
+            // End of file reached
+            if( cqe.res == 0 )
+            {
+                if( req.isWrite && outError == 0 )
+                    outError = EIO;
+
+                req.size = 0;
+                continue;
+            }
+
+            const size_t transferred = (size_t)cqe.res;
+            ASSERT( transferred <= req.size );
+
+            req.buffer      += transferred;
+            req.offset      += transferred;
+            req.size        -= transferred;
+            req.transferred += transferred;
+
+            if( req.size && outError == 0 )
+                resubmit[resubmitCount++] = index;
+        }
+
+        __atomic_store_n( ring.cqHead, head, __ATOMIC_RELEASE );
+
+        // Stop issuing new requests after an error, but let the in-flight ones complete
+        if( outError )
+        {
+            next          = count;
+            resubmitCount = 0;
+        }
+    }
+
+    // Sync file positions with the kernel, since subsequent
+    // regular reads and writes use the file's implicit offset.
+    for( uint32 i = 0; i < count; i++ )
+    {
+        FileStream& file = *_requests[i].file;
+
+        if( i > 0 && _requests[i-1].file == &file )
+            continue;
+
+        if( lseek( file._fd, (off_t)file._position, SEEK_SET ) == -1 && outError == 0 )
+            outError = errno;
+    }
+
+    _count = 0;
+    return outError == 0;
+}
+
+//-----------------------------------------------------------
+size_t FileIOBatch::BytesTransferred( const uint32 request ) const
+{
+    ASSERT( request < _capacity );
+    return _requests[request].transferred;
+}
+
+#endif // PLATFORM_IS_LINUX
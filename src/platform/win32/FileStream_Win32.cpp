@@ -3,6 +3,7 @@
 #include "util/Log.h"
 #include <Windows.h>
 #include <stringapiset.h>
+#include <vector>
 //#include <winioctl.h>
 //#include <shlwapi.h>
 //#pragma comment( lib, "Shlwapi.lib" )
@@ -73,6 +74,7 @@ bool FileStream::Open( const char* path, FileStream& file, FileMode mode, FileAc
 
         file._fd            = fd;
         file._blockSize     = blockSize;
+        file._optimalIOSize = blockSize;
         file._position      = 0;
         file._access        = access;
         file._flags         = flags;
@@ -113,6 +115,7 @@ void FileStream::Close()
     _access        = FileAccess::None;
     _error         = 0;
     _blockSize     = 0;
+    _optimalIOSize = 0;
 }
 
 //-----------------------------------------------------------
@@ -205,13 +208,98 @@ ssize_t FileStream::Write( const void* buffer, size_t size )
     return bytesWritten;
 }
 
+//----------------------------------------------------------
+// #NOTE: WriteFileGather()/ReadFileScatter() require page-sized buffers and an overlapped handle,
+//        so the buffers are transferred one at a time, each at its own offset.
+template<bool IsWrite>
+static ssize_t TransferV( HANDLE fd, const FileIOVec* vecs, const uint32 count, const uint64 offset, int& error )
+{
+    const DWORD MAX_CALL_SIZE = 0x7ffff000;
+
+    uint64 position = offset;
+
+    for( uint32 i = 0; i < count; i++ )
+    {
+        byte*  buffer = (byte*)vecs[i].buffer;
+        size_t size   = vecs[i].size;
+
+        while( size > 0 )
+        {
+            OVERLAPPED ov = {};
+            ov.Offset     = (DWORD)( position & 0xFFFFFFFFull );
+            ov.OffsetHigh = (DWORD)( position >> 32 );
+
+            const DWORD callSize    = (DWORD)std::min( size, (size_t)MAX_CALL_SIZE );
+            DWORD       transferred = 0;
+
+            const BOOL r = IsWrite ? ::WriteFile( fd, buffer, callSize, &transferred, &ov ) :
+                                     ::ReadFile ( fd, buffer, callSize, &transferred, &ov );
+            if( !r )
+            {
+                const DWORD err = ::GetLastError();
+                if( !IsWrite && err == ERROR_HANDLE_EOF )
+                    return (ssize_t)( position - offset );
+
+                error = (int)err;
+                return -1;
+            }
+
+            if( transferred == 0 )
+                return (ssize_t)( position - offset );
+
+            buffer   += transferred;
+            size     -= transferred;
+            position += transferred;
+        }
+    }
+
+    return (ssize_t)( position - offset );
+}
+
+//----------------------------------------------------------
+ssize_t FileStream::ReadV( const FileIOVec* vecs, const uint32 count, const uint64 offset )
+{
+    ASSERT( vecs || count == 0 );
+
+    if( !IsFlagSet( _access, FileAccess::Read ) || !HasValidFD() )
+        return -1;
+
+    return TransferV<false>( _fd, vecs, count, offset, _error );
+}
+
+//----------------------------------------------------------
+ssize_t FileStream::WriteV( const FileIOVec* vecs, const uint32 count, const uint64 offset )
+{
+    ASSERT( vecs || count == 0 );
+
+    if( !IsFlagSet( _access, FileAccess::Write ) || !HasValidFD() )
+        return -1;
+
+    return TransferV<true>( _fd, vecs, count, offset, _error );
+}
+
 //----------------------------------------------------------
 bool FileStream::Reserve( ssize_t size )
 {
-    // #TODO: Use SetFileValidData()?
-    // #See: https://docs.microsoft.com/en-us/windows/win32/api/fileapi/nf-fileapi-setfilevaliddata
-    
-    return false;
+    // Allocates the clusters without changing the file size.
+    // (SetFileValidData() would require SE_MANAGE_VOLUME_NAME and expose stale disk contents.)
+    FILE_ALLOCATION_INFO info = {};
+    info.AllocationSize.QuadPart = (LONGLONG)size;
+
+    if( !::SetFileInformationByHandle( _fd, FileAllocationInfo, &info, sizeof( info ) ) )
+    {
+        _error = ::GetLastError();
+        return false;
+    }
+
+    return true;
+}
+
+//----------------------------------------------------------
+bool FileStream::Advise( const FileAdvice advice, const size_t offset, const size_t length )
+{
+    // #TODO: Use FILE_FLAG_SEQUENTIAL_SCAN on open and PrefetchVirtualMemory()?
+    return IsOpen();
 }
 
 //----------------------------------------------------------
@@ -256,6 +344,40 @@ bool FileStream::Flush()
     return (bool)r;
 }
 
+//-----------------------------------------------------------
+bool FileStream::Lock( const bool block )
+{
+    if( !HasValidFD() )
+        return false;
+
+    OVERLAPPED overlapped = {};
+    const DWORD flags = LOCKFILE_EXCLUSIVE_LOCK | ( block ? 0 : LOCKFILE_FAIL_IMMEDIATELY );
+
+    if( !LockFileEx( _fd, flags, 0, MAXDWORD, MAXDWORD, &overlapped ) )
+    {
+        _error = GetLastError();
+        return false;
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------
+bool FileStream::Unlock()
+{
+    if( !HasValidFD() )
+        return false;
+
+    OVERLAPPED overlapped = {};
+    if( !UnlockFileEx( _fd, 0, MAXDWORD, MAXDWORD, &overlapped ) )
+    {
+        _error = GetLastError();
+        return false;
+    }
+
+    return true;
+}
+
 //-----------------------------------------------------------
 bool FileStream::IsOpen() const
 {
@@ -376,6 +498,15 @@ wchar_t* Utf8ToUtf16( const char* utf8Str, wchar_t* stackBuffer16, const size_t
     return str16;
 }
 
+//-----------------------------------------------------------
+bool FileStream::GetIOSizesForPath( const char* pathU8, size_t& outBlockSize, size_t& outOptimalIOSize )
+{
+    outBlockSize     = GetBlockSizeForPath( pathU8 );
+    outOptimalIOSize = outBlockSize;
+
+    return outBlockSize != 0;
+}
+
 //-----------------------------------------------------------
 size_t FileStream::GetBlockSizeForPath( const char* pathU8 )
 {
@@ -448,6 +579,37 @@ size_t FileStream::GetBlockSizeForPath( const char* pathU8 )
 //    return bytesPerSector * sectorsPerCluster;
 }
 
+//-----------------------------------------------------------
+bool FileStream::GetDeviceIdForPath( const char* pathU8, uint64& outDeviceId )
+{
+    wchar_t path16Stack[BUF16_STACK_LEN];
+
+    wchar_t* path16 = Utf8ToUtf16( pathU8, path16Stack, BUF16_STACK_LEN );
+    if( !path16 )
+        return false;
+
+    HANDLE fd = CreateFile( path16, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+                            OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, NULL );
+
+    bool found = false;
+    if( fd != INVALID_HANDLE_VALUE )
+    {
+        BY_HANDLE_FILE_INFORMATION info;
+        if( ::GetFileInformationByHandle( fd, &info ) )
+        {
+            outDeviceId = (uint64)info.dwVolumeSerialNumber;
+            found       = true;
+        }
+
+        ::CloseHandle( fd );
+    }
+
+    if( path16 != path16Stack )
+        free( path16 );
+
+    return found;
+}
+
 //-----------------------------------------------------------
 bool FileStream::Move( const char* oldPathU8, const char* newPathU8, int32* outError )
 {
@@ -552,4 +714,367 @@ bool GetFileClusterSize( HANDLE hFile, size_t& outClusterSize )
     //CloseHandle( hDevice );
 
     //return (bool)r;
-}
\ No newline at end of file
+}
+
+///
+/// FileIOBatch
+///
+struct FileIOBatch::Ring
+{
+    HANDLE              port;
+    uint32              entries;
+    std::vector<uint32> resubmit;   // Requests that completed a partial transfer
+
+    // Overlapped handles reopened from the files of the current submission, as { file handle, overlapped handle }
+    std::vector<std::pair<HANDLE, HANDLE>> handles;
+};
+
+struct FileIOBatch::Request
+{
+    OVERLAPPED  ov;             // Completions are mapped back to their request through it
+    FileStream* file;
+    HANDLE      handle;         // Overlapped handle the request is issued on
+    byte*       buffer;
+    size_t      size;           // Bytes left to transfer
+    size_t      transferred;
+    uint64      offset;
+    bool        isWrite;
+};
+
+//-----------------------------------------------------------
+static void CloseOverlappedHandles( std::vector<std::pair<HANDLE, HANDLE>>& handles )
+{
+    for( auto& h : handles )
+        ::CloseHandle( h.second );
+
+    handles.clear();
+}
+
+//-----------------------------------------------------------
+FileIOBatch::~FileIOBatch()
+{
+    if( _ring )
+    {
+        CloseOverlappedHandles( _ring->handles );
+        ::CloseHandle( _ring->port );
+
+        delete _ring;
+        _ring = nullptr;
+    }
+
+    free( _requests );
+    _requests = nullptr;
+}
+
+//-----------------------------------------------------------
+uint32 FileIOBatch::QueueDepth() const
+{
+    return _ring ? _ring->entries : 0;
+}
+
+//-----------------------------------------------------------
+bool FileIOBatch::Init( const uint32 queueDepth )
+{
+    ASSERT( !_ring );
+    ASSERT( queueDepth );
+
+    // Only this batch's thread ever waits on the port
+    HANDLE port = ::CreateIoCompletionPort( INVALID_HANDLE_VALUE, NULL, 0, 1 );
+    if( !port )
+        return false;
+
+    _ring = new Ring();
+    _ring->port    = port;
+    _ring->entries = queueDepth;
+    _ring->resubmit.resize( queueDepth );
+
+    return true;
+}
+
+//-----------------------------------------------------------
+bool FileIOBatch::RegisterBuffer( void* buffer, const size_t size )
+{
+    // Windows has no equivalent for files, requests always map their buffers
+    return false;
+}
+
+//-----------------------------------------------------------
+void FileIOBatch::UnregisterBuffer()
+{
+}
+
+//-----------------------------------------------------------
+uint32 FileIOBatch::Read( FileStream& file, void* buffer, const size_t size, const uint64 offset )
+{
+    return Enqueue( file, buffer, size, offset, false );
+}
+
+//-----------------------------------------------------------
+uint32 FileIOBatch::Write( FileStream& file, const void* buffer, const size_t size, const uint64 offset )
+{
+    return Enqueue( file, (void*)buffer, size, offset, true );
+}
+
+//-----------------------------------------------------------
+uint32 FileIOBatch::Read( FileStream& file, void* buffer, const size_t size )
+{
+    return Enqueue( file, buffer, size, file._position, false );
+}
+
+//-----------------------------------------------------------
+uint32 FileIOBatch::Write( FileStream& file, const void* buffer, const size_t size )
+{
+    return Enqueue( file, (void*)buffer, size, file._position, true );
+}
+
+//-----------------------------------------------------------
+uint32 FileIOBatch::Enqueue( FileStream& file, void* buffer, const size_t size, const uint64 offset, const bool isWrite )
+{
+    ASSERT( _ring );
+    ASSERT( buffer );
+    ASSERT( file.IsOpen() );
+
+    if( _count == _capacity )
+    {
+        _capacity = std::max( 64u, _capacity * 2 );
+        _requests = bbcrealloc<Request>( _requests, _capacity );
+    }
+
+    Request& req = _requests[_count];
+    memset( &req.ov, 0, sizeof( req.ov ) );
+    req.file        = &file;
+    req.handle      = INVALID_HANDLE_VALUE;
+    req.buffer      = (byte*)buffer;
+    req.size        = size;
+    req.transferred = 0;
+    req.offset      = offset;
+    req.isWrite     = isWrite;
+
+    // The file position is only synced with the file's handle once the batch is submitted
+    file._position = (size_t)( offset + size );
+
+    return _count++;
+}
+
+//-----------------------------------------------------------
+bool FileIOBatch::Submit( int& outError )
+{
+    ASSERT( _ring );
+
+    outError = 0;
+
+    Ring&        ring        = *_ring;
+    const uint32 count       = _count;
+    const uint32 maxInFlight = _maxInFlight ? std::min( _maxInFlight, ring.entries ) : ring.entries;
+    uint32       next        = 0;      // Next request that has not been issued yet
+    uint32       inFlight    = 0;
+
+    uint32* resubmit      = ring.resubmit.data();
+    uint32  resubmitCount = 0;
+
+    // The files are opened for synchronous I/O, so each one is reopened as overlapped,
+    // with the same access and buffering, and associated with the completion port.
+    // The handles only live for this submission, since the files may be closed and their handles reused after it.
+    for( uint32 i = 0; i < count && outError == 0; i++ )
+    {
+        Request&    req  = _requests[i];
+        FileStream& file = *req.file;
+
+        for( auto& h : ring.handles )
+        {
+            if( h.first == file._fd )
+            {
+                req.handle = h.second;
+                break;
+            }
+        }
+
+        if( req.handle != INVALID_HANDLE_VALUE )
+            continue;
+
+        DWORD access = 0;
+        if( IsFlagSet( file._access, FileAccess::Read ) )
+            access |= GENERIC_READ;
+        if( IsFlagSet( file._access, FileAccess::Write ) )
+            access |= GENERIC_WRITE;
+
+        DWORD flags = FILE_FLAG_OVERLAPPED;
+        if( IsFlagSet( file._flags, FileFlags::NoBuffering ) )
+            flags |= FILE_FLAG_NO_BUFFERING | FILE_FLAG_WRITE_THROUGH;
+
+        HANDLE handle = ::ReOpenFile( file._fd, access, FILE_SHARE_READ | FILE_SHARE_WRITE, flags );
+        if( handle == INVALID_HANDLE_VALUE )
+        {
+            outError = (int)::GetLastError();
+            break;
+        }
+
+        if( !::CreateIoCompletionPort( handle, ring.port, 0, 0 ) )
+        {
+            outError = (int)::GetLastError();
+            ::CloseHandle( handle );
+            break;
+        }
+
+        ring.handles.push_back( { file._fd, handle } );
+        req.handle = handle;
+    }
+
+    if( outError )
+        next = count;
+
+    // Returns false if the request was not issued, in which case no completion will be posted for it
+    auto issue = [&]( Request& req ) {
+
+        // Cap to what a single call can transfer, the rest will be re-issued
+        const DWORD ioSize = (DWORD)std::min( req.size, (size_t)0x7ffff000 );
+
+        memset( &req.ov, 0, sizeof( req.ov ) );
+        req.ov.Offset     = (DWORD)( req.offset & 0xFFFFFFFFull );
+        req.ov.OffsetHigh = (DWORD)( req.offset >> 32 );
+
+        // Requests that complete right away still post their completion to the port
+        const BOOL r = req.isWrite ? ::WriteFile( req.handle, req.buffer, ioSize, NULL, &req.ov ) :
+                                     ::ReadFile ( req.handle, req.buffer, ioSize, NULL, &req.ov );
+        if( r )
+            return true;
+
+        const DWORD err = ::GetLastError();
+        if( err == ERROR_IO_PENDING )
+            return true;
+
+        // End of file reached
+        if( !req.isWrite && err == ERROR_HANDLE_EOF )
+            req.size = 0;
+        else if( outError == 0 )
+            outError = (int)err;
+
+        return false;
+    };
+
+    const ULONG      MAX_REAP = 64;
+    OVERLAPPED_ENTRY completions[MAX_REAP];
+
+    while( next < count || resubmitCount || inFlight )
+    {
+        // Keep up to maxInFlight requests outstanding
+        while( inFlight < maxInFlight && outError == 0 )
+        {
+            uint32 index;
+            if( resubmitCount )
+                index = resubmit[--resubmitCount];
+            else if( next < count )
+                index = next++;
+            else
+                break;
+
+            Request& req = _requests[index];
+
+            if( req.size == 0 )
+                continue;
+
+            if( issue( req ) )
+                inFlight++;
+        }
+
+        // Stop issuing new requests after an error, but let the in-flight ones complete
+        if( outError )
+        {
+            next          = count;
+            resubmitCount = 0;
+        }
+
+        if( inFlight == 0 )
+            continue;
+
+        // Wait for at least one completion
+        ULONG reaped = 0;
+        if( !::GetQueuedCompletionStatusEx( ring.port, completions, std::min( MAX_REAP, (ULONG)inFlight ), &reaped, INFINITE, FALSE ) )
+        {
+            // The port is unusable, bail out
+            if( outError == 0 )
+                outError = (int)::GetLastError();
+
+            // Don't return while requests are still writing to, or reading from, the caller's buffers
+            for( auto& h : ring.handles )
+                ::CancelIoEx( h.second, NULL );
+
+            for( uint32 i = 0; i < count; i++ )
+            {
+                DWORD transferred;
+                if( _requests[i].handle != INVALID_HANDLE_VALUE )
+                    ::GetOverlappedResult( _requests[i].handle, &_requests[i].ov, &transferred, TRUE );
+            }
+            break;
+        }
+
+        for( ULONG i = 0; i < reaped; i++ )
+        {
+            Request&     req   = *CONTAINING_RECORD( completions[i].lpOverlapped, Request, ov );
+            const uint32 index = (uint32)( &req - _requests );
+
+            inFlight--;
+
+            DWORD transferred = 0;
+            if( !::GetOverlappedResult( req.handle, &req.ov, &transferred, FALSE ) )
+            {
+                const DWORD err = ::GetLastError();
+
+                if( !req.isWrite && err == ERROR_HANDLE_EOF )
+                    req.size = 0;
+                else if( outError == 0 )
+                    outError = (int)err;
+
+                continue;
+            }
+
+            // End of file reached
+            if( transferred == 0 )
+            {
+                if( req.isWrite && outError == 0 )
+                    outError = ERROR_WRITE_FAULT;
+
+                req.size = 0;
+                continue;
+            }
+
+            ASSERT( transferred <= req.size );
+
+            req.buffer      += transferred;
+            req.offset      += transferred;
+            req.size        -= transferred;
+            req.transferred += transferred;
+
+            if( req.size && outError == 0 )
+                resubmit[resubmitCount++] = index;
+        }
+    }
+
+    CloseOverlappedHandles( ring.handles );
+
+    // Sync file positions with their handles, since subsequent
+    // regular reads and writes use the handle's implicit offset.
+    for( uint32 i = 0; i < count; i++ )
+    {
+        FileStream& file = *_requests[i].file;
+
+        if( i > 0 && _requests[i-1].file == &file )
+            continue;
+
+        LARGE_INTEGER position;
+        position.QuadPart = (LONGLONG)file._position;
+
+        if( !::SetFilePointerEx( file._fd, position, NULL, FILE_BEGIN ) && outError == 0 )
+            outError = (int)::GetLastError();
+    }
+
+    _count = 0;
+    return outError == 0;
+}
+
+//-----------------------------------------------------------
+size_t FileIOBatch::BytesTransferred( const uint32 request ) const
+{
+    ASSERT( request < _capacity );
+    return _requests[request].transferred;
+}
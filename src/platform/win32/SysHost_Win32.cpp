@@ -111,6 +111,12 @@ uint SysHost::GetLogicalCPUCount()
     return (uint)GetActiveProcessorCount( ALL_PROCESSOR_GROUPS );
 }
 
+//-----------------------------------------------------------
+uint SysHost::GetUsableCPUCount()
+{
+    return GetLogicalCPUCount();
+}
+
 //-----------------------------------------------------------
 void* SysHost::VirtualAlloc( size_t size, bool initialize )
 {
@@ -165,6 +171,18 @@ void* SysHost::VirtualAlloc( size_t size, bool initialize )
     return ptr;
 }
 
+//-----------------------------------------------------------
+void* SysHost::VirtualAllocHuge( size_t size, bool allowExplicitPages, HugePageSize* outPageSize )
+{
+    // #TODO: Support large pages here too. For now, fallback to regular pages.
+    (void)allowExplicitPages;
+
+    if( outPageSize )
+        *outPageSize = HugePageSize::None;
+
+    return VirtualAlloc( size, false );
+}
+
 //-----------------------------------------------------------
 void SysHost::VirtualFree( void* ptr )
 {
@@ -380,6 +398,114 @@ void SysHost::Random( byte* buffer, size_t size )
 // #SEE: https://docs.microsoft.com/en-us/windows/win32/procthread/numa-support
 // #SEE: https://docs.microsoft.com/en-us/windows/win32/procthread/processor-groups
 // #NOTE: This is not thread-safe on the first time is called
+//-----------------------------------------------------------
+static CpuTopology* CreateCpuTopology()
+{
+    const uint32 cpuCount   = (uint32)GetActiveProcessorCount( ALL_PROCESSOR_GROUPS );
+    const WORD   groupCount = GetActiveProcessorGroupCount();
+
+    // First CPU id of each processor group, numbered the way SetCurrentThreadAffinityCpuId() expects them
+    std::vector<uint32> groupBase( (size_t)groupCount + 1, 0 );
+    for( WORD g = 0; g < groupCount; g++ )
+        groupBase[g+1] = groupBase[g] + (uint32)GetActiveProcessorCount( g );
+
+    // Defaults, in case a relationship is not reported: every CPU is a core of its own
+    CpuInfo* cpus = bbcalloc<CpuInfo>( cpuCount );
+    for( uint32 i = 0; i < cpuCount; i++ )
+        cpus[i] = { i, 0, i, 0, 0 };
+
+    auto* topology = new CpuTopology();
+    topology->packageCount = 1;
+    topology->coreCount    = cpuCount;
+    topology->l3Count      = 1;
+    topology->cpus         = Span<CpuInfo>( cpus, cpuCount );
+
+    DWORD length = 0;
+    GetLogicalProcessorInformationEx( RelationAll, nullptr, &length );
+
+    auto* info = (SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*)malloc( length );
+    if( !info || !GetLogicalProcessorInformationEx( RelationAll, info, &length ) )
+    {
+        const DWORD err = GetLastError();
+        Log::Error( "Warning: Failed to get the CPU topology with error %d (0x%x).", err, err );
+        free( info );
+        return topology;
+    }
+
+    auto forEachCpu = [&]( const GROUP_AFFINITY& mask, auto func ) {
+        for( uint32 bit = 0; bit < 64; bit++ )
+        {
+            const uint32 id = groupBase[mask.Group] + bit;
+
+            if( ( ( (uint64)mask.Mask >> bit ) & 1 ) && id < cpuCount )
+                func( cpus[id] );
+        }
+    };
+
+    uint32 packageCount = 0, coreCount = 0, l3Count = 0;
+
+    for( const byte* cur = (byte*)info, *end = cur + length; cur < end; )
+    {
+        const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX& rel = *(const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*)cur;
+        cur += rel.Size;
+
+        switch( rel.Relationship )
+        {
+            case RelationProcessorPackage:
+                for( WORD g = 0; g < rel.Processor.GroupCount; g++ )
+                    forEachCpu( rel.Processor.GroupMask[g], [&]( CpuInfo& cpu ) { cpu.package = packageCount; } );
+
+                packageCount++;
+                break;
+
+            case RelationProcessorCore:
+            {
+                // A core never spans processor groups
+                uint32 smt = 0;
+                forEachCpu( rel.Processor.GroupMask[0], [&]( CpuInfo& cpu ) { cpu.core = coreCount; cpu.smt = smt++; } );
+
+                coreCount++;
+            }
+            break;
+
+            case RelationCache:
+                if( rel.Cache.Level == 3 )
+                {
+                    forEachCpu( rel.Cache.GroupMask, [&]( CpuInfo& cpu ) { cpu.l3 = l3Count; } );
+                    l3Count++;
+                }
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    free( info );
+
+    // Without an L3, each package is a single domain
+    if( l3Count == 0 )
+    {
+        for( uint32 i = 0; i < cpuCount; i++ )
+            cpus[i].l3 = cpus[i].package;
+
+        l3Count = std::max( packageCount, 1u );
+    }
+
+    if( packageCount ) topology->packageCount = packageCount;
+    if( coreCount    ) topology->coreCount    = coreCount;
+    topology->l3Count = l3Count;
+
+    return topology;
+}
+
+//-----------------------------------------------------------
+const CpuTopology& SysHost::GetCpuTopology()
+{
+    static const CpuTopology* topology = CreateCpuTopology();
+    return *topology;
+}
+
 //-----------------------------------------------------------
 const NumaInfo* SysHost::GetNUMAInfo()
 {
@@ -51,18 +51,26 @@ public:
     //-----------------------------------------------------------
     inline void BeginWriteBuckets( const uint64 bucketBitSizes[_numBuckets] )
     {
-        const size_t fsBlockSize     = _queue->BlockSize( _fileId );
-        const size_t fsBlockSizeBits = fsBlockSize * 8;
-        ASSERT( fsBlockSize > 0 );
+        const size_t allocSize     = GetBufferSize( bucketBitSizes );
+        byte*        bucketBuffers = _queue->GetBuffer( allocSize, _queue->BlockSize( _fileId ), true );
 
-        size_t allocSize = 0;
+        BeginWriteBuckets( bucketBitSizes, bucketBuffers );
+    }
 
-        for( uint32 i = 0; i < _numBuckets; i++ )
-            allocSize += CDivT( (size_t)bucketBitSizes[i] + (size_t)_remainderBitCount[i], fsBlockSizeBits ) * fsBlockSizeBits / 8;
+    // Size of the buffer needed to write buckets of the given bit sizes,
+    // including any left-over bits, with each bucket rounded up to the block size.
+    //-----------------------------------------------------------
+    inline size_t GetBufferSize( const uint64 bucketBitSizes[_numBuckets] ) const
+    {
+        const size_t fsBlockSizeBits = _queue->BlockSize( _fileId ) * 8;
+        ASSERT( fsBlockSizeBits > 0 );
 
-        byte* bucketBuffers = _queue->GetBuffer( allocSize, fsBlockSize, true );
+        size_t size = 0;
 
-        BeginWriteBuckets( bucketBitSizes, bucketBuffers );
+        for( uint32 i = 0; i < _numBuckets; i++ )
+            size += CDivT( (size_t)bucketBitSizes[i] + (size_t)_remainderBitCount[i], fsBlockSizeBits ) * fsBlockSizeBits / 8;
+
+        return size;
     }
 
     //-----------------------------------------------------------
@@ -0,0 +1,73 @@
+#pragma once
+#include "plotting/PlotTypes.h"
+#include "util/BitView.h"
+
+///
+/// Bounded k32 plots store the pairs of a bucket as ( right - left | left - prevLeft ),
+/// where prevLeft is the left entry of the preceding pair in the bucket (0 for the first one).
+/// The left deltas are packed with a bit size chosen per bucket from the bucket's largest delta.
+///
+namespace BoundedPairDeltas
+{
+    /// Largest left delta of the pairs, the first one taken relative to prevLeft
+    //-----------------------------------------------------------
+    inline uint32 GetMaxLeftDelta( const Pair* pairs, const size_t count, const uint32 prevLeft )
+    {
+        if( count == 0 )
+            return 0;
+
+        uint32 maxDelta = pairs[0].left - prevLeft;
+
+        // Branchless, so that the compiler can vectorize it
+        for( size_t i = 1; i < count; i++ )
+        {
+            const uint32 d = pairs[i].left - pairs[i-1].left;
+            maxDelta = d > maxDelta ? d : maxDelta;
+        }
+
+        return maxDelta;
+    }
+
+    //-----------------------------------------------------------
+    inline uint32 GetLeftBits( const uint32 maxLeftDelta )
+    {
+        return bblog2( maxLeftDelta ) + 1;
+    }
+
+    //-----------------------------------------------------------
+    inline void Pack( BitWriter& writer, const Pair* pairs, const size_t count, uint32 prevLeft,
+                      const uint32 leftBits, const uint32 rightBits )
+    {
+        const uint32 bitSize = leftBits + rightBits;
+
+        for( size_t i = 0; i < count; i++ )
+        {
+            const Pair pair = pairs[i];
+            ASSERT( pair.left >= prevLeft );
+            ASSERT( pair.left - prevLeft < ( 1ull << leftBits ) );
+            ASSERT( pair.right - pair.left < ( 1ull << rightBits ) );
+
+            writer.Write( ( (uint64)(pair.right - pair.left) << leftBits ) | ( pair.left - prevLeft ), bitSize );
+            prevLeft = pair.left;
+        }
+    }
+
+    /// Decodes pairs with their entries relative to the left entry of the pair preceding the first one.
+    /// Returns the left of the last pair decoded, which is the sum of all the left deltas read.
+    //-----------------------------------------------------------
+    inline uint32 Unpack( BitReader& reader, Pair* pairs, const size_t count,
+                          const uint32 leftBits, const uint32 rightBits )
+    {
+        uint32 left = 0;
+
+        for( size_t i = 0; i < count; i++ )
+        {
+            left += (uint32)reader.ReadBits64( leftBits );
+
+            pairs[i].left  = left;
+            pairs[i].right = left + (uint32)reader.ReadBits64( rightBits );
+        }
+
+        return left;
+    }
+}
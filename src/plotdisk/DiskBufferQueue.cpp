@@ -5,6 +5,8 @@
 #include "jobs/IOJob.h"
 #include "util/Util.h"
 #include "util/Log.h"
+#include "threading/ThreadAffinity.h"
+#include "util/Trace.h"
 
 
 #define NULL_BUFFER -1
@@ -17,16 +19,21 @@
     #define CheckPathSeparator( x ) ((x) == '/')
 #endif
 
+// Accounting stage of the command being executed by the current command thread
+static thread_local uint32 _cmdIOStage = 0;
+
 //-----------------------------------------------------------
 DiskBufferQueue::DiskBufferQueue( 
     const char* workDir1, const char* workDir2, const char* plotDir, byte* workBuffer, 
     size_t workBufferSize, uint ioThreadCount,
-    int32 threadBindId
+    int32 threadBindId, const char* tmpFilePrefix
 )
     : _workDir1      ( workDir1 )
     , _workDir2      ( workDir2 )
     , _plotDir       ( plotDir  )
+    , _tmpFilePrefix ( tmpFilePrefix ? tmpFilePrefix : "" )
     , _workHeap      ( workBufferSize, workBuffer )
+    , _ioStats       ( "diskplot" )
     // , _threadPool    ( ioThreadCount, ThreadPool::Mode::Fixed, true )
     , _dispatchThread()
     , _deleterThread ()
@@ -53,18 +60,47 @@ DiskBufferQueue::DiskBufferQueue(
     if( !CheckPathSeparator( _plotDir.back() ) )
         _plotDir += PATH_SEPA_STR;
 
-    const size_t workDirLen = std::max( _workDir1.length(), _workDir2.length() );
+    _workDirs[0].push_back( _workDir1 );
+    _workDirs[1].push_back( _workDir2 );
 
-    const size_t PLOT_FILE_LEN = sizeof( "/plot-k32-2021-08-05-18-55-77a011fc20f0003c3adcc739b615041ae56351a22b690fd854ccb6726e5f43b7.plot.tmp" );
+    AllocPathBuffers();
+
+    // When temp2 is a different directory (likely a different device), its file sets
+    // get their own command thread, so that its I/O does not wait behind temp1's.
+    _useTmp2Queue = _workDir1 != _workDir2;
 
-    _filePathBuffer    = bbmalloc<char>( workDirLen + PLOT_FILE_LEN );  // Should be enough for all our file names
-    _delFilePathBuffer = bbmalloc<char>( workDirLen + PLOT_FILE_LEN );
+    if( _useTmp2Queue )
+        Log::Line( "Using a separate I/O thread for temp2." );
+
+    #if BB_HAS_FILE_IO_BATCH
+        // Submit all bucket slices of a command at once when io_uring (or, on Windows, overlapped I/O) is available.
+        // Registering the heap is best-effort, as it requires pinning it.
+        const uint32 batchCount = _useTmp2Queue ? 2 : 1;
+
+        for( uint32 i = 0; i < batchCount; i++ )
+        {
+            if( _ioBatch[i].Init( BB_DP_MAX_BUCKET_COUNT ) )
+            {
+                const bool registered = workBuffer && _ioBatch[i].RegisterBuffer( workBuffer, workBufferSize );
+
+                if( i == 0 )
+                #if PLATFORM_IS_WINDOWS
+                    Log::Line( "Using overlapped I/O for work file I/O." );
+                #else
+                    Log::Line( "Using io_uring for work file I/O%s.", registered ? " with registered buffers" : "" );
+                #endif
+            }
+        }
+    #endif
 
     // Initialize file deleter thread
     _deleterThread.Run( DeleterThreadMain, this );
 
-    // Initialize I/O thread
+    // Initialize I/O threads
     _dispatchThread.Run( CommandThreadMain, this );
+
+    if( _useTmp2Queue )
+        _tmp2Thread.Run( Tmp2ThreadMain, this );
 }
 
 //-----------------------------------------------------------
@@ -74,11 +110,67 @@ DiskBufferQueue::~DiskBufferQueue()
     _deleteSignal.Signal();
     _deleterThread.WaitForExit();
 
+    if( _useTmp2Queue )
+    {
+        _tmp2Exit.store( true, std::memory_order_release );
+        _tmp2ReadySignal.Signal();
+        _tmp2Thread.WaitForExit();
+    }
+
     // #TODO: Wait for command thread
     // #TODO: Delete our file sets
 
     free( _filePathBuffer    );
     free( _delFilePathBuffer );
+
+    for( IOController* controller : _ioController )
+        delete controller;
+}
+
+//-----------------------------------------------------------
+void DiskBufferQueue::EnableAdaptiveIO()
+{
+    #if BB_HAS_FILE_IO_BATCH
+        const char* names[2] = { _useTmp2Queue ? "Temp1" : "Temp", "Temp2" };
+
+        for( uint32 i = 0; i < 2; i++ )
+        {
+            if( !_ioBatch[i].IsInitialized() || _ioController[i] )
+                continue;
+
+            _ioController[i] = new IOController( names[i], _ioBatch[i].QueueDepth() );
+            _ioBatch[i].SetMaxInFlight( _ioController[i]->QueueDepth() );
+        }
+
+        if( !_ioController[0] )
+            Log::Line( "Warning: Adaptive I/O requires batched I/O, which is not available. Ignoring it." );
+    #else
+        Log::Line( "Warning: Adaptive I/O is only supported on Linux and Windows. Ignoring it." );
+    #endif
+
+    _adaptBufferWaitTime = _ioBufferWaitTime;
+    _adaptTime           = TimerBegin();
+}
+
+//-----------------------------------------------------------
+void DiskBufferQueue::AdaptIO( const uint32 phase )
+{
+    if( !_ioController[0] )
+        return;
+
+    const double elapsed = TimerEnd( _adaptTime );
+    const double waited  = TicksToSeconds( _ioBufferWaitTime - _adaptBufferWaitTime );
+
+    _adaptBufferWaitTime = _ioBufferWaitTime;
+    _adaptTime           = TimerBegin();
+
+    const double waitFraction = elapsed > 0 ? std::min( 1.0, waited / elapsed ) : 0.0;
+
+    for( IOController* controller : _ioController )
+    {
+        if( controller )
+            controller->Update( phase, waitFraction );
+    }
 }
 
 //-----------------------------------------------------------
@@ -88,10 +180,58 @@ size_t DiskBufferQueue::BlockSize( FileId fileId ) const
     return _files[(int)fileId].files[0]->BlockSize();
 }
 
+//-----------------------------------------------------------
+void DiskBufferQueue::AllocPathBuffers()
+{
+    size_t workDirLen = _plotDir.length();
+
+    for( const auto& workDirs : _workDirs )
+        for( const std::string& workDir : workDirs )
+            workDirLen = std::max( workDirLen, workDir.length() );
+
+    const size_t PLOT_FILE_LEN = sizeof( "/plot-k32-2021-08-05-18-55-77a011fc20f0003c3adcc739b615041ae56351a22b690fd854ccb6726e5f43b7.plot.tmp" );
+
+    const size_t pathBufferSize = workDirLen + _tmpFilePrefix.length() + PLOT_FILE_LEN;  // Should be enough for all our file names
+
+    free( _filePathBuffer    );
+    free( _delFilePathBuffer );
+
+    _filePathBuffer    = bbmalloc<char>( pathBufferSize );
+    _delFilePathBuffer = bbmalloc<char>( pathBufferSize );
+}
+
+//-----------------------------------------------------------
+void DiskBufferQueue::AddWorkDir( const bool tmp2, const char* dir )
+{
+    ASSERT( dir );
+    FatalIf( !*dir, "Working directory path is empty." );
+
+    std::string workDir = dir;
+    if( !CheckPathSeparator( workDir.back() ) )
+        workDir += PATH_SEPA_STR;
+
+    _workDirs[tmp2 ? 1 : 0].push_back( workDir );
+
+    AllocPathBuffers();
+}
+
 //-----------------------------------------------------------
 void DiskBufferQueue::ResetHeap( const size_t heapSize, void* heapBuffer )
 {
     _workHeap.ResetHeap( heapSize, heapBuffer );
+
+    #if BB_HAS_FILE_IO_BATCH
+        for( FileIOBatch& batch : _ioBatch )
+        {
+            if( !batch.IsInitialized() )
+                continue;
+
+            if( heapBuffer )
+                batch.RegisterBuffer( heapBuffer, heapSize );
+            else
+                batch.UnregisterBuffer();
+        }
+    #endif
 }
 
 //-----------------------------------------------------------
@@ -106,12 +246,9 @@ bool DiskBufferQueue::InitFileSet( FileId fileId, const char* name, uint bucketC
     const bool isPlotFile = fileId == FileId::PLOT;
     const bool useTmp2    = IsFlagSet( options, FileSetOptions::UseTemp2 );
 
-    const std::string& wokrDir = isPlotFile ? _plotDir :
-                                    useTmp2 ? _workDir2 : _workDir1;
-    memcpy( _filePathBuffer, wokrDir.c_str(), wokrDir.length() );
-
     const char* pathBuffer = _filePathBuffer;
-          char* baseName   = _filePathBuffer + wokrDir.length();
+
+    ASSERT( !( IsFlagSet( options, FileSetOptions::DirectIO ) && IsFlagSet( options, FileSetOptions::PageCache ) ) );
 
     FileFlags flags = FileFlags::LargeFile;
     if( IsFlagSet( options, FileSetOptions::DirectIO ) )
@@ -128,6 +265,7 @@ bool DiskBufferQueue::InitFileSet( FileId fileId, const char* name, uint bucketC
         fileSet.files.length = bucketCount;
         fileSet.blockBuffer  = nullptr;
         fileSet.options      = options;
+        fileSet.statsId      = _ioStats.AddFile( name );
 
         memset( fileSet.files.values, 0, sizeof( uintptr_t ) * bucketCount );
 
@@ -147,6 +285,18 @@ bool DiskBufferQueue::InitFileSet( FileId fileId, const char* name, uint bucketC
             fileSet.maxSliceSize = optsData->maxSliceSize;
             ASSERT( fileSet.maxSliceSize );
         }
+
+        if( IsFlagSet( options, FileSetOptions::Resident ) && optsData->residentSize > 0 )
+        {
+            // Alternating buckets are read while the next ones are written, so their memory can't be recycled per pass
+            ASSERT( IsFlagSet( options, FileSetOptions::Interleaved ) && !IsFlagSet( options, FileSetOptions::Alternating ) );
+            ASSERT( optsData->residentBuffer );
+
+            fileSet.resident.SetTo( (byte*)optsData->residentBuffer, optsData->residentSize );
+            fileSet.residentBuckets.SetTo( new byte*[bucketCount]{}, bucketCount );
+        }
+        else
+            UnSetFlag( fileSet.options, FileSetOptions::Resident );
     }
 
     const bool isCachable = IsFlagSet( options, FileSetOptions::Cachable ) && optsData->cacheSize > 0;
@@ -179,14 +329,19 @@ bool DiskBufferQueue::InitFileSet( FileId fileId, const char* name, uint bucketC
         #if _DEBUG && ( BB_DP_DBG_READ_EXISTING_F1 || BB_DP_DBG_SKIP_PHASE_1 || BB_DP_P1_SKIP_TO_TABLE || BB_DP_DBG_SKIP_TO_C_TABLES )
             !isPlotFile ? FileMode::OpenOrCreate : FileMode::Create;
         #else
-            FileMode::Create;
+            ( _openExistingFiles || _reuseTempFiles ) && !isPlotFile ? FileMode::OpenOrCreate : FileMode::Create;
         #endif
 
         if( !isPlotFile )
-            sprintf( baseName, "%s_%u.tmp", name, i );
+        {
+            const std::string& workDir = GetWorkDir( useTmp2, i );
+            memcpy( _filePathBuffer, workDir.c_str(), workDir.length() );
+            sprintf( _filePathBuffer + workDir.length(), "%s%s_%u.tmp", _tmpFilePrefix.c_str(), name, i );
+        }
         else
         {
-            sprintf( baseName, "%s", name );
+            memcpy( _filePathBuffer, _plotDir.c_str(), _plotDir.length() );
+            sprintf( _filePathBuffer + _plotDir.length(), "%s", name );
 
             _plotFullName = pathBuffer;
             _plotFullName.erase( _plotFullName.length() - 4 );
@@ -215,6 +370,10 @@ bool DiskBufferQueue::InitFileSet( FileId fileId, const char* name, uint bucketC
             
             Fatal( "Failed to open temp work file @ %s with error: %d.", pathBuffer, file->GetError() );
         }
+
+        // Read-ahead is only a hint, so we don't fail if it's not supported
+        if( IsFlagSet( options, FileSetOptions::PageCache ) && !isCachable )
+            static_cast<FileStream*>( file )->Advise( FileAdvice::Sequential );
         
         // Always align for now.
         if( i == 0 && !fileSet.blockBuffer )//&& IsFlagSet( options, FileSetOptions::DirectIO ) )
@@ -461,27 +620,61 @@ void DiskBufferQueue::WaitForFence( Fence& fence )
     cmd->fence.value  = -1;
 }
 
+//-----------------------------------------------------------
+void DiskBufferQueue::SignalAsync( AsyncSignal& signal )
+{
+    Command* cmd = GetCommandObject( Command::SignalAsync );
+    cmd->asyncSignal.signal = &signal;
+}
+
 //-----------------------------------------------------------
 void DiskBufferQueue::DeleteFile( FileId id, uint bucket )
 {
     // Log::Line( "DeleteFile( %u : %u )", id, bucket );
-    // #TODO: See DeleteBucket
     Command* cmd = GetCommandObject( Command::DeleteFile );
     cmd->deleteFile.fileId = id;
     cmd->deleteFile.bucket = bucket;
+
+    _deletesIssued++;
 }
 
 //-----------------------------------------------------------
 void DiskBufferQueue::DeleteBucket( FileId id )
 {
     // Log::Line( "DeleteBucket( %u )", id );
-    // #TODO: This command must be run in another helper thread in order
-    //        to not block while the kernel buffers are being
-    //        cleared (when not using direct IO). Otherwise
-    //        other commands will get blocked while a command
-    //        we don't care about is executing.
+    // This is run in the deleter thread in order to not block
+    // while the kernel buffers are being cleared (when not using direct IO).
+    // Otherwise other commands would get blocked while a command
+    // we don't care about is executing.
     Command* cmd = GetCommandObject( Command::DeleteBucket );
     cmd->deleteFile.fileId = id;
+
+    _deletesIssued++;
+}
+
+//-----------------------------------------------------------
+void DiskBufferQueue::WaitForPendingDeletes()
+{
+    _deleteFence.Wait( _deletesIssued );
+}
+
+//-----------------------------------------------------------
+void DiskBufferQueue::DeletePooledFiles()
+{
+    if( !_reuseTempFiles )
+        return;
+
+    // The deleter thread is idle once the pending deletes are done
+    WaitForPendingDeletes();
+    _reuseTempFiles = false;
+
+    for( uint32 i = 0; i < (uint32)FileId::_COUNT; i++ )
+    {
+        const FileId fileId = (FileId)i;
+
+        if( fileId != FileId::PLOT && _files[i].name )
+            DeleteBucketNow( fileId );
+    }
 }
 
 //-----------------------------------------------------------
@@ -540,7 +733,10 @@ DiskBufferQueue::Command* DiskBufferQueue::GetCommandObject( Command::CommandTyp
     }
 
     ZeroMem( cmd );
-    cmd->type = type;
+    cmd->type    = type;
+    cmd->ioStage = _ioStage.load( std::memory_order_relaxed );
+
+    _ioStats.AddPending( 1 );
 
     #if DBG_LOG_ENABLE
         Log::Debug( "[DiskBufferQueue] > Snd: %s (%d)", DbgGetCommandName( type ), type );
@@ -559,6 +755,10 @@ void DiskBufferQueue::CommandThreadMain( DiskBufferQueue* self )
         ASSERT( threadBindId < SysHost::GetLogicalCPUCount() );
         SysHost::SetCurrentThreadAffinityCpuId( threadBindId );
     }
+    else
+        ThreadAffinity::PinCurrentIOThread();
+
+    BB_TRACE_THREAD_NAME( "Disk queue" );
     self->CommandMain();
 }
 
@@ -602,9 +802,146 @@ void DiskBufferQueue::CommandMain()
             _cmdConsumedSignal.Signal();
 
             for( int i = 0; i < cmdCount; i++ )
+            {
+                Command& cmd = commands[i];
+
+                if( _useTmp2Queue )
+                {
+                    if( IsTmp2Command( cmd ) )
+                    {
+                        ForwardToTmp2( cmd );
+                        continue;
+                    }
+
+                    // Anything else may depend on temp2 commands that were issued before it
+                    // (ex. a fence or a buffer release), so let the temp2 thread catch up first.
+                    if( cmd.type != Command::WaitForFence )
+                        WaitForTmp2();
+                }
+
+                ExecuteCommand( cmd );
+                _ioStats.AddPending( -1 );
+            }
+
+            if( _useTmp2Queue )
+                CommitTmp2Commands();
+        }
+    }
+}
+
+//-----------------------------------------------------------
+void DiskBufferQueue::Tmp2ThreadMain( DiskBufferQueue* self )
+{
+    ThreadAffinity::PinCurrentIOThread();
+    BB_TRACE_THREAD_NAME( "Disk queue temp2" );
+    self->Tmp2Main();
+}
+
+//-----------------------------------------------------------
+void DiskBufferQueue::Tmp2Main()
+{
+    const int CMD_BUF_SIZE = 64;
+    Command commands[CMD_BUF_SIZE];
+
+    for( ;; )
+    {
+        _tmp2ReadySignal.Wait();
+
+        int cmdCount;
+        while( ( ( cmdCount = _tmp2Commands.Dequeue( commands, CMD_BUF_SIZE ) ) ) )
+        {
+            _tmp2ConsumedSignal.Signal();
+
+            for( int i = 0; i < cmdCount; i++ )
+            {
                 ExecuteCommand( commands[i] );
+                _ioStats.AddPending( -1 );
+            }
+
+            _tmp2Completed.fetch_add( (uint64)cmdCount, std::memory_order_release );
+            _tmp2CompletedSignal.Signal();
         }
+
+        if( _tmp2Exit.load( std::memory_order_acquire ) )
+            return;
+    }
+}
+
+//-----------------------------------------------------------
+bool DiskBufferQueue::IsTmp2Command( const Command& cmd ) const
+{
+    FileId fileId;
+
+    switch( cmd.type )
+    {
+        case Command::WriteFile:
+        case Command::ReadFile:
+            fileId = cmd.file.fileId;
+            break;
+
+        case Command::WriteBuckets:
+        case Command::WriteBucketElements:
+            fileId = cmd.buckets.fileId;
+            break;
+
+        case Command::ReadBucket:
+            fileId = cmd.readBucket.fileId;
+            break;
+
+        case Command::SeekFile:
+        case Command::SeekBucket:
+            fileId = cmd.seek.fileId;
+            break;
+
+        case Command::TruncateBucket:
+            fileId = cmd.truncateBucket.fileId;
+            break;
+
+        // Deletes stay in the main thread, as it is the only producer for the deleter queue
+        default:
+            return false;
     }
+
+    return IsFlagSet( _files[(int)fileId].options, FileSetOptions::UseTemp2 );
+}
+
+//-----------------------------------------------------------
+void DiskBufferQueue::ForwardToTmp2( const Command& cmd )
+{
+    Command* dst;
+    while( !_tmp2Commands.Write( dst ) )
+    {
+        // Let the temp2 thread see what we have so far, and wait for it to free up some space
+        CommitTmp2Commands();
+        _tmp2ConsumedSignal.Wait();
+    }
+
+    *dst = cmd;
+    _tmp2Forwarded++;
+    _tmp2Pending++;
+}
+
+//-----------------------------------------------------------
+void DiskBufferQueue::CommitTmp2Commands()
+{
+    if( _tmp2Pending == 0 )
+        return;
+
+    _tmp2Commands.Commit();
+    _tmp2Pending = 0;
+    _tmp2ReadySignal.Signal();
+}
+
+//-----------------------------------------------------------
+void DiskBufferQueue::WaitForTmp2()
+{
+    if( _tmp2Completed.load( std::memory_order_acquire ) >= _tmp2Forwarded )
+        return;
+
+    CommitTmp2Commands();
+
+    while( _tmp2Completed.load( std::memory_order_acquire ) < _tmp2Forwarded )
+        _tmp2CompletedSignal.Wait();
 }
 
 //-----------------------------------------------------------
@@ -614,6 +951,9 @@ void DiskBufferQueue::ExecuteCommand( Command& cmd )
     //    Log::Debug( "[DiskBufferQueue] ^ Cmd Execute: %s (%d)", DbgGetCommandName( cmd.type ), cmd.type );
     //#endif
 
+    BB_TRACE_SCOPE( DbgGetCommandName( cmd.type ) );
+    _cmdIOStage = cmd.ioStage;
+
     switch( cmd.type )
     {
         case Command::WriteBuckets:
@@ -698,6 +1038,14 @@ void DiskBufferQueue::ExecuteCommand( Command& cmd )
             cmd.fence.signal->Wait();
         break;
 
+        case Command::SignalAsync:
+            #if DBG_LOG_ENABLE
+                Log::Debug( "[DiskBufferQueue] ^ Cmd SignalAsync" );
+            #endif
+            ASSERT( cmd.asyncSignal.signal );
+            cmd.asyncSignal.signal->Signal();
+        break;
+
         case Command::DeleteFile:
             #if DBG_LOG_ENABLE
                 Log::Debug( "[DiskBufferQueue] ^ Cmd DeleteFile" );
@@ -789,6 +1137,63 @@ void DiskBufferQueue::CmdWriteBuckets( const Command& cmd, const size_t elementS
             // #NOTE: We can avoid this on interleaved writes if we add that said offset to the prefix um offset.
             const uint64 maxSliceSize = fileSet.maxSliceSize;
 
+        #if BB_HAS_FILE_IO_BATCH
+            if( CanBatchIO( fileSet ) )
+            {
+                FileIOBatch& ioBatch = IOBatch( fileSet );
+
+                for( uint slice = 0; slice < bucketCount; slice++ )
+                {
+                    ASSERT( sizes[slice] <= maxSliceSize / elementSize );
+
+                    const size_t sliceWriteSize = sizes[slice] * elementSize;
+                    const uint32 fileBucketIdx  = interleaved ? fileSet.writeBucket : slice;
+                    const uint32 sliceSeekIdx   = interleaved ? slice : fileSet.writeBucket;
+
+                    ioBatch.Write( *static_cast<FileStream*>( fileSet.files[fileBucketIdx] ), buffer, sliceWriteSize, sliceSeekIdx * maxSliceSize );
+                    buffer += sliceWriteSize;
+                }
+
+                SubmitIOBatch( fileSet, writeSize, true );
+            }
+            else
+        #endif
+            if( interleaved && !IsFlagSet( fileSet.options, FileSetOptions::Cachable ) )
+            {
+                // All slices go to the same file: write them at their slice boundary with positional,
+                // vectored writes, so that slices that are contiguous in the file share a single call.
+                const uint32 fileBucketIdx = fileSet.writeBucket;
+                const auto   timer         = TimerBegin();
+
+                FileIOVecBatch ioBatch( *static_cast<FileStream*>( fileSet.files[fileBucketIdx] ), true );
+
+                for( uint slice = 0; slice < bucketCount; slice++ )
+                {
+                    ASSERT( sizes[slice] <= maxSliceSize / elementSize );
+
+                    const size_t sliceWriteSize = sizes[slice] * elementSize;
+
+                    FatalIf( !ioBatch.Add( buffer, sliceWriteSize, slice * maxSliceSize ),
+                        "Failed to write to '%s.%u' work file with error %d (0x%x).", fileSet.name, fileBucketIdx, ioBatch.Error(), ioBatch.Error() );
+
+                    buffer += sliceWriteSize;
+                }
+
+                FatalIf( !ioBatch.Flush(),
+                    "Failed to write to '%s.%u' work file with error %d (0x%x).", fileSet.name, fileBucketIdx, ioBatch.Error(), ioBatch.Error() );
+
+                const Duration elapsed = TimerEndTicks( timer );
+                _ioStats.RecordWrite( fileSet.statsId, writeSize, elapsed );
+                AccountIO( fileSet, writeSize, true );
+
+                #if _DEBUG || BB_IO_METRICS_ON
+                    IOMetric& metrics = _writeMetrics[CmdThreadIdx( fileSet )];
+                    metrics.size += writeSize;
+                    metrics.count++;
+                    metrics.time += elapsed;
+                #endif
+            }
+            else
             for( uint slice = 0; slice < bucketCount; slice++ )
             {
                 ASSERT( sizes[slice] <= maxSliceSize / elementSize );
@@ -806,14 +1211,14 @@ void DiskBufferQueue::CmdWriteBuckets( const Command& cmd, const size_t elementS
                         "Failed to seek file %s.%u.tmp to slice boundary.", fileSet.name, fileBucketIdx );
                 }
 
-                WriteToFile( file, sliceWriteSize, buffer, (byte*)fileSet.blockBuffer, fileSet.name, fileBucketIdx );
+                WriteToFile( file, sliceWriteSize, buffer, (byte*)fileSet.blockBuffer, fileSet, fileBucketIdx );
 
                 buffer += sliceWriteSize;
             }
         }
-        else
+        else if( !WriteResidentBucket( fileSet, buffer, sizes, sliceSizes, elementSize ) )
         {
-            WriteToFile( *fileSet.files[fileSet.writeBucket], writeSize, buffer, (byte*)fileSet.blockBuffer, fileSet.name, fileSet.writeBucket );
+            WriteToFile( *fileSet.files[fileSet.writeBucket], writeSize, buffer, (byte*)fileSet.blockBuffer, fileSet, fileSet.writeBucket );
         }
 
         if( ++fileSet.writeBucket >= bucketCount )
@@ -825,6 +1230,26 @@ void DiskBufferQueue::CmdWriteBuckets( const Command& cmd, const size_t elementS
             std::swap( fileSet.writeSliceSizes, fileSet.readSliceSizes );
         }
     }
+#if BB_HAS_FILE_IO_BATCH
+    else if( CanBatchIO( fileSet ) )
+    {
+        FileIOBatch& ioBatch   = IOBatch( fileSet );
+        size_t       writeSize = 0;
+
+        for( uint i = 0; i < bucketCount; i++ )
+        {
+            const size_t bufferSize = sizes[i] * elementSize;
+            ASSERT( bufferSize == bufferSize / blockSize * blockSize );
+
+            ioBatch.Write( *static_cast<FileStream*>( fileSet.files[i] ), buffer, bufferSize );
+
+            buffer    += bufferSize;
+            writeSize += bufferSize;
+        }
+
+        SubmitIOBatch( fileSet, writeSize, true );
+    }
+#endif
     else
     {
         for( uint i = 0; i < bucketCount; i++ )
@@ -833,7 +1258,7 @@ void DiskBufferQueue::CmdWriteBuckets( const Command& cmd, const size_t elementS
 
             // Only write up-to the block-aligned boundary. The caller is in charge of handling unlaigned data.
             ASSERT( bufferSize == bufferSize / blockSize * blockSize );
-            WriteToFile( *fileSet.files[i], bufferSize, buffer, (byte*)fileSet.blockBuffer, fileSet.name, i );
+            WriteToFile( *fileSet.files[i], bufferSize, buffer, (byte*)fileSet.blockBuffer, fileSet, i );
 
             // ASSERT( IsFlagSet( fileBuckets.files[i].GetFileAccess(), FileAccess::ReadWrite ) );
             buffer += bufferSize;
@@ -841,11 +1266,60 @@ void DiskBufferQueue::CmdWriteBuckets( const Command& cmd, const size_t elementS
     }
 }
 
+//-----------------------------------------------------------
+bool DiskBufferQueue::WriteResidentBucket( FileSet& fileSet, const byte* buffer, const uint* writeSizes, const uint32* sliceSizes, const size_t elementSize )
+{
+    if( !IsFlagSet( fileSet.options, FileSetOptions::Resident ) )
+        return false;
+
+    const uint32 bucketCount = (uint32)fileSet.files.Length();
+
+    // The previous pass' buckets have all been read once we start writing over them
+    if( fileSet.writeBucket == 0 )
+    {
+        fileSet.residentUsed = 0;
+        memset( fileSet.residentBuckets.Ptr(), 0, sizeof( byte* ) * bucketCount );
+    }
+
+    size_t dataSize = 0;
+    for( uint32 i = 0; i < bucketCount; i++ )
+        dataSize += sliceSizes[i] * elementSize;
+
+    if( dataSize > fileSet.resident.Length() - fileSet.residentUsed )
+        return false;
+
+    // Slices are stored back-to-back, without their block-alignment padding
+    byte* dst = fileSet.resident.Ptr() + fileSet.residentUsed;
+    fileSet.residentBuckets[fileSet.writeBucket] = dst;
+    fileSet.residentUsed += dataSize;
+
+    for( uint32 i = 0; i < bucketCount; i++ )
+    {
+        const size_t sliceSize = sliceSizes[i] * elementSize;
+
+        memcpy( dst, buffer, sliceSize );
+        dst    += sliceSize;
+        buffer += writeSizes[i] * elementSize;
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------
+inline size_t DiskBufferQueue::ResidentSliceOffset( const FileSet& fileSet, const uint32 bucket, const uint32 slice ) const
+{
+    size_t offset = 0;
+    for( uint32 i = 0; i < slice; i++ )
+        offset += fileSet.readSliceSizes[bucket][i];
+
+    return offset;
+}
+
 //-----------------------------------------------------------
 void DiskBufferQueue::CndWriteFile( const Command& cmd )
 {
     FileSet& fileBuckets = _files[(int)cmd.file.fileId];
-    WriteToFile( *fileBuckets.files[cmd.file.bucket], cmd.file.size, cmd.file.buffer, (byte*)fileBuckets.blockBuffer, fileBuckets.name, cmd.file.bucket );
+    WriteToFile( *fileBuckets.files[cmd.file.bucket], cmd.file.size, cmd.file.buffer, (byte*)fileBuckets.blockBuffer, fileBuckets, cmd.file.bucket );
 }
 
 //-----------------------------------------------------------
@@ -894,6 +1368,46 @@ void DiskBufferQueue::CmdReadBucket( const Command& cmd )
 
     const uint64 maxSliceSize = fileSet.maxSliceSize;
 
+    // Buckets kept in memory when written. Alternating sets are never resident, so the slice index is the bucket's.
+    byte* const* resident = IsFlagSet( fileSet.options, FileSetOptions::Resident ) ? fileSet.residentBuckets.Ptr() : nullptr;
+
+#if BB_HAS_FILE_IO_BATCH
+    // Slices can only be read concurrently if they are all block-aligned,
+    // otherwise each read overwrites the tail of the previous one.
+    bool batchRead = CanBatchIO( fileSet );
+
+    for( uint32 slice = 0; slice < bucketCount && batchRead; slice++ )
+        batchRead = sliceSizes[slice][fileSet.readBucket] % blockSize == 0;
+
+    if( batchRead )
+    {
+        FileIOBatch& ioBatch  = IOBatch( fileSet );
+        size_t       readSize = 0;
+
+        for( uint32 slice = 0; slice < bucketCount; slice++ )
+        {
+            const size_t      sliceSize     = sliceSizes[slice][fileSet.readBucket];
+            const uint32      fileBucketIdx = alternatingNonInterleaved ? fileSet.readBucket : slice;
+                  FileStream& stream        = *static_cast<FileStream*>( fileSet.files[fileBucketIdx] );
+
+            if( resident && resident[slice] )
+                memcpy( readBuffer.Ptr() + readSize, resident[slice] + ResidentSliceOffset( fileSet, slice, fileSet.readBucket ), sliceSize );
+            else if( alternating )
+            {
+                const uint32 sliceOffsetIdx = alternatingNonInterleaved ? slice : fileSet.readBucket;
+                ioBatch.Read( stream, readBuffer.Ptr() + readSize, sliceSize, sliceOffsetIdx * maxSliceSize );
+            }
+            else
+                ioBatch.Read( stream, readBuffer.Ptr() + readSize, sliceSize );
+
+            readSize += sliceSize;
+        }
+
+        if( ioBatch.Count() )
+            SubmitIOBatch( fileSet, readSize, false );
+    }
+    else
+#endif
     for( uint32 slice = 0; slice < bucketCount; slice++ )
     {
         const size_t   sliceSize     = sliceSizes[slice][fileSet.readBucket];
@@ -903,6 +1417,24 @@ void DiskBufferQueue::CmdReadBucket( const Command& cmd )
         const uint32   fileBucketIdx = alternatingNonInterleaved ? fileSet.readBucket : slice;
               IStream& stream        = *fileSet.files[fileBucketIdx];
 
+        if( resident && resident[slice] )
+        {
+            // Append it after the partial block we're holding, which is still in place, and keep
+            // the buffer block-aligned for the following reads, just like a file read would.
+            const size_t dataSize = tempBlock.Length() + sliceSize;
+            const size_t fullSize = dataSize / blockSize * blockSize;
+
+            memcpy( readBuffer.Ptr() + tempBlock.Length(), resident[slice] + ResidentSliceOffset( fileSet, slice, fileSet.readBucket ), sliceSize );
+
+            readBuffer = readBuffer.Slice( fullSize );
+            tempBlock  = blockBuffer.Slice( 0, dataSize - fullSize );
+
+            if( tempBlock.Length() )
+                readBuffer.CopyTo( tempBlock, tempBlock.Length() );
+
+            continue;
+        }
+
         // When alternating, we need to seek to the start of the slice boundary
         if( alternating )
         {
@@ -913,7 +1445,7 @@ void DiskBufferQueue::CmdReadBucket( const Command& cmd )
                 "Failed to seek while reading alternating bucket %s.%u.tmp.", fileSet.name, fileBucketIdx );
         }
 
-        ReadFromFile( stream, alignedSize, readBuffer.Ptr(), nullptr, blockSize, directIO, fileSet.name, fileBucketIdx );
+        ReadFromFile( stream, alignedSize, readBuffer.Ptr(), nullptr, blockSize, directIO, fileSet, fileBucketIdx );
 
         // Replace the temp block we just overwrote, if we have one
         if( tempBlock.Length() )
@@ -945,11 +1477,39 @@ void DiskBufferQueue::CmdReadBucket( const Command& cmd )
 
     fileSet.readBucket = (fileSet.readBucket + 1) % fileSet.files.Length();
 
+    if( IsFlagSet( fileSet.options, FileSetOptions::PageCache ) && fileSet.readBucket > 0 )
+        PrefetchNextBucket( fileSet );
+
     // Revert buffer length from bytes to element size
     auto userBuffer = const_cast<Span<byte>*>( cmd.readBucket.buffer );
     userBuffer->length = elementCount / elementSize;
 }
 
+//-----------------------------------------------------------
+void DiskBufferQueue::PrefetchNextBucket( FileSet& fileSet )
+{
+    // HybridStreams serve part of the file from memory, so there's nothing to prefetch for those
+    if( IsFlagSet( fileSet.options, FileSetOptions::Cachable ) )
+        return;
+
+    // We don't know here which way an alternating bucket will be read, so only prefetch interleaved reads
+    if( IsFlagSet( fileSet.options, FileSetOptions::Alternating ) )
+        return;
+
+    const uint32 bucketCount = (uint32)fileSet.files.Length();
+    const uint32 bucket      = fileSet.readBucket;
+    const size_t blockSize   = fileSet.files[0]->BlockSize();
+
+    for( uint32 slice = 0; slice < bucketCount; slice++ )
+    {
+        FileStream&  stream    = *static_cast<FileStream*>( fileSet.files[slice] );
+        const size_t sliceSize = RoundUpToNextBoundaryT( fileSet.readSliceSizes[slice][bucket], blockSize );
+
+        if( sliceSize )
+            stream.Advise( FileAdvice::WillNeed, stream.Position(), sliceSize );
+    }
+}
+
 //-----------------------------------------------------------
 void DiskBufferQueue::CmdReadFile( const Command& cmd )
 {
@@ -957,7 +1517,7 @@ void DiskBufferQueue::CmdReadFile( const Command& cmd )
     const bool   directIO  = IsFlagSet( fileSet.options, FileSetOptions::DirectIO );
     const size_t blockSize = fileSet.files[0]->BlockSize();
 
-    ReadFromFile( *fileSet.files[cmd.file.bucket], cmd.file.size, cmd.file.buffer, (byte*)fileSet.blockBuffer, blockSize, directIO, fileSet.name, cmd.file.bucket );
+    ReadFromFile( *fileSet.files[cmd.file.bucket], cmd.file.size, cmd.file.buffer, (byte*)fileSet.blockBuffer, blockSize, directIO, fileSet, cmd.file.bucket );
 }
 
 //-----------------------------------------------------------
@@ -983,15 +1543,99 @@ void DiskBufferQueue::CmdSeekBucket( const Command& cmd )
 }
 
 //-----------------------------------------------------------
-inline void DiskBufferQueue::WriteToFile( IStream& file, size_t size, const byte* buffer, byte* blockBuffer, const char* fileName, uint bucket )
+inline bool DiskBufferQueue::CanBatchIO( const FileSet& fileSet )
+{
+    #if BB_HAS_FILE_IO_BATCH
+        // HybridStreams serve part of the file from memory, so they have to go through the stream interface
+        return IOBatch( fileSet ).IsInitialized() && !IsFlagSet( fileSet.options, FileSetOptions::Cachable );
+    #else
+        return false;
+    #endif
+}
+
+//-----------------------------------------------------------
+inline void DiskBufferQueue::SubmitIOBatch( const FileSet& fileSet, const size_t totalSize, const bool isWrite )
+{
+    #if BB_HAS_FILE_IO_BATCH
+        #if _DEBUG || BB_IO_METRICS_ON
+            IOMetric& metrics = ( isWrite ? _writeMetrics : _readMetrics )[CmdThreadIdx( fileSet )];
+            metrics.size += totalSize;
+            metrics.count++;
+        #endif
+        const auto timer = TimerBegin();
+
+        FileIOBatch&  batch      = IOBatch( fileSet );
+        IOController* controller = _ioController[&batch - _ioBatch];
+
+        if( controller )
+            batch.SetMaxInFlight( controller->QueueDepth() );
+
+        int err = 0;
+        FatalIf( !batch.Submit( err ), "Failed to %s '%s' work files with error %d (0x%x).", 
+            isWrite ? "write to" : "read from", fileSet.name, err, err );
+
+        const Duration elapsed = TimerEndTicks( timer );
+        if( controller )
+            controller->RecordSubmit( totalSize, elapsed );
+
+        if( isWrite )
+            _ioStats.RecordWrite( fileSet.statsId, totalSize, elapsed );
+        else
+            _ioStats.RecordRead( fileSet.statsId, totalSize, elapsed );
+
+        AccountIO( fileSet, totalSize, isWrite );
+
+        #if _DEBUG || BB_IO_METRICS_ON
+            metrics.time += elapsed;
+        #endif
+    #else
+        Panic( "Unexpected." );
+    #endif
+}
+
+//-----------------------------------------------------------
+inline void DiskBufferQueue::AccountIO( const FileSet& fileSet, const size_t diskSize, const bool isWrite )
+{
+    const size_t fileIdx = (size_t)( &fileSet - _files );
+    ASSERT( fileIdx < (size_t)FileId::_COUNT );
+
+    const uint32 phase = _cmdIOStage / (uint32)TableId::_Count;
+    const uint32 table = _cmdIOStage % (uint32)TableId::_Count;
+
+    auto& counters = isWrite ? _ioAccounting.written : _ioAccounting.read;
+    counters[fileIdx][phase][table].fetch_add( diskSize, std::memory_order_relaxed );
+}
+
+//-----------------------------------------------------------
+void DiskBufferQueue::ResetIOAccounting()
+{
+    for( uint32 f = 0; f < (uint32)FileId::_COUNT; f++ )
+    for( uint32 p = 0; p < TempIOAccounting::PHASE_COUNT; p++ )
+    for( uint32 t = 0; t < (uint32)TableId::_Count; t++ )
+    {
+        _ioAccounting.read   [f][p][t].store( 0, std::memory_order_relaxed );
+        _ioAccounting.written[f][p][t].store( 0, std::memory_order_relaxed );
+    }
+}
+
+//-----------------------------------------------------------
+inline void DiskBufferQueue::WriteToFile( IStream& file, size_t size, const byte* buffer, byte* blockBuffer, const FileSet& fileSet, uint bucket )
 {
+    const char*  fileName  = fileSet.name;
+    const size_t totalSize = size;
+
+    // Only the part of a HybridStream write that spills past its memory reaches the disk
+    const HybridStream* hybrid      = IsFlagSet( fileSet.options, FileSetOptions::Cachable ) ? static_cast<HybridStream*>( &file ) : nullptr;
+    const uint64        diskWritten = hybrid ? hybrid->DiskBytesWritten() : 0;
+
     // if( !_useDirectIO )
     // {
         #if _DEBUG || BB_IO_METRICS_ON
-            _writeMetrics.size += size;
-            _writeMetrics.count++;
-            const auto timer = TimerBegin();
+            IOMetric& metrics = _writeMetrics[CmdThreadIdx( fileSet )];
+            metrics.size += size;
+            metrics.count++;
         #endif
+        const auto timer = TimerBegin();
 
         while( size )
         {
@@ -1007,8 +1651,12 @@ inline void DiskBufferQueue::WriteToFile( IStream& file, size_t size, const byte
             buffer += sizeWritten;
         }
 
+        const Duration elapsed = TimerEndTicks( timer );
+        _ioStats.RecordWrite( fileSet.statsId, totalSize, elapsed );
+        AccountIO( fileSet, hybrid ? (size_t)( hybrid->DiskBytesWritten() - diskWritten ) : totalSize, true );
+
         #if _DEBUG || BB_IO_METRICS_ON
-            _writeMetrics.time += TimerEndTicks( timer );
+            metrics.time += elapsed;
         #endif
     // }
     // else
@@ -1053,13 +1701,20 @@ inline void DiskBufferQueue::WriteToFile( IStream& file, size_t size, const byte
 }
 
 //-----------------------------------------------------------
-inline void DiskBufferQueue::ReadFromFile( IStream& file, size_t size, byte* buffer, byte* blockBuffer, const size_t blockSize, const bool directIO, const char* fileName, const uint bucket )
+inline void DiskBufferQueue::ReadFromFile( IStream& file, size_t size, byte* buffer, byte* blockBuffer, const size_t blockSize, const bool directIO, const FileSet& fileSet, const uint bucket )
 {
+    const char*  fileName  = fileSet.name;
+    const size_t totalSize = size;
+
+    const HybridStream* hybrid   = IsFlagSet( fileSet.options, FileSetOptions::Cachable ) ? static_cast<HybridStream*>( &file ) : nullptr;
+    const uint64        diskRead = hybrid ? hybrid->DiskBytesRead() : 0;
+
     #if _DEBUG || BB_IO_METRICS_ON
-        _readMetrics.size += size;
-        _readMetrics.count++;
-        const auto timer = TimerBegin();
+        IOMetric& metrics = _readMetrics[CmdThreadIdx( fileSet )];
+        metrics.size += size;
+        metrics.count++;
     #endif
+    const auto timer = TimerBegin();
 
     if( !directIO )
     {
@@ -1108,8 +1763,12 @@ inline void DiskBufferQueue::ReadFromFile( IStream& file, size_t size, byte* buf
     //     }
     }
 
+    const Duration elapsed = TimerEndTicks( timer );
+    _ioStats.RecordRead( fileSet.statsId, totalSize, elapsed );
+    AccountIO( fileSet, hybrid ? (size_t)( hybrid->DiskBytesRead() - diskRead ) : totalSize, false );
+
     #if _DEBUG || BB_IO_METRICS_ON
-        _readMetrics.time += TimerEndTicks( timer );
+        metrics.time += elapsed;
     #endif
 
 //     if( remainder )
@@ -1123,27 +1782,25 @@ inline void DiskBufferQueue::ReadFromFile( IStream& file, size_t size, byte* buf
 //----------------------------------------------------------
 void DiskBufferQueue::CmdDeleteFile( const Command& cmd )
 {
-    DeleteFileNow( cmd.deleteFile.fileId, cmd.deleteFile.bucket );
+    // All commands issued before this one have completed by now, and no later
+    // command touches a file set that is being deleted, so it is safe to do it in the background.
+    FileDeleteCommand delCmd;
+    delCmd.fileId = cmd.deleteFile.fileId;
+    delCmd.bucket = (int64)cmd.deleteFile.bucket;
+    while( !_deleteQueue.Enqueue( delCmd ) );
 
-    // FileDeleteCommand delCmd;
-    // delCmd.fileId = cmd.deleteFile.fileId;
-    // delCmd.bucket = (int64)cmd.deleteFile.bucket;
-    // while( !_deleteQueue.Enqueue( delCmd ) );
-
-    // _deleteSignal.Signal();
+    _deleteSignal.Signal();
 }
 
 //----------------------------------------------------------
 void DiskBufferQueue::CmdDeleteBucket( const Command& cmd )
 {
-    DeleteBucketNow( cmd.deleteFile.fileId );
-
-    // FileDeleteCommand delCmd;
-    // delCmd.fileId = cmd.deleteFile.fileId;
-    // delCmd.bucket = -1;
-    // while( !_deleteQueue.Enqueue( delCmd ) );
+    FileDeleteCommand delCmd;
+    delCmd.fileId = cmd.deleteFile.fileId;
+    delCmd.bucket = -1;
+    while( !_deleteQueue.Enqueue( delCmd ) );
     
-    // _deleteSignal.Signal();
+    _deleteSignal.Signal();
 }
 
 //-----------------------------------------------------------
@@ -1193,6 +1850,9 @@ inline const char* DiskBufferQueue::DbgGetCommandName( Command::CommandType type
         case DiskBufferQueue::Command::WaitForFence:
             return "WaitForFence";
 
+        case DiskBufferQueue::Command::SignalAsync:
+            return "SignalAsync";
+
         case DiskBufferQueue::Command::DeleteFile:
             return "DeleteFile";
 
@@ -1287,6 +1947,7 @@ void DiskBufferQueue::CmdDbgReadSliceSizes( const Command& cmd )
 //-----------------------------------------------------------
 void DiskBufferQueue::DeleterThreadMain( DiskBufferQueue* self )
 {
+    ThreadAffinity::PinCurrentIOThread();
     self->DeleterMain();
 }
 
@@ -1296,6 +1957,8 @@ void DiskBufferQueue::DeleterMain()
     const int BUFFER_SIZE = 1024;
     FileDeleteCommand commands[BUFFER_SIZE];
 
+    uint32 deletesCompleted = 0;
+
     for( ;; )
     {
         _deleteSignal.Wait();
@@ -1321,6 +1984,8 @@ void DiskBufferQueue::DeleterMain()
                     DeleteBucketNow( cmd.fileId );
                 else
                     DeleteFileNow( cmd.fileId, (uint32)cmd.bucket );
+
+                _deleteFence.Signal( ++deletesCompleted );
             }
         }
     }
@@ -1352,15 +2017,19 @@ void DiskBufferQueue::DeleteFileNow( const FileId fileId, const uint32 bucket )
 
     CloseFileNow( fileId, bucket );
 
+    // Pooled for the next plot
+    if( _reuseTempFiles )
+        return;
+
     const bool useTmp2 = IsFlagSet( fileSet.options, FileSetOptions::UseTemp2 );
 
-    const std::string& wokrDir  = useTmp2 ? _workDir2 : _workDir1;
+    const std::string& wokrDir  = GetWorkDir( useTmp2, bucket );
                  char* filePath = _delFilePathBuffer;
 
     memcpy( filePath, wokrDir.c_str(), wokrDir.length() );
     char* baseName = filePath + wokrDir.length();
     
-    sprintf( baseName, "%s_%u.tmp", fileSet.name, bucket );
+    sprintf( baseName, "%s%s_%u.tmp", _tmpFilePrefix.c_str(), fileSet.name, bucket );
     
     const int r = remove( filePath );
 
@@ -1375,17 +2044,19 @@ void DiskBufferQueue::DeleteBucketNow( const FileId fileId )
 
     const bool useTmp2 = IsFlagSet( fileSet.options, FileSetOptions::UseTemp2 );
 
-    const std::string& wokrDir  = useTmp2 ? _workDir2 : _workDir1;
-                 char* filePath = _delFilePathBuffer;
-
-    memcpy( filePath, wokrDir.c_str(), wokrDir.length() );
-    char* baseName = filePath + wokrDir.length();
+    char* filePath = _delFilePathBuffer;
 
     for( size_t i = 0; i < fileSet.files.length; i++ )
     {
         CloseFileNow( fileId, (uint32)i );
 
-        sprintf( baseName, "%s_%u.tmp", fileSet.name, (uint)i );
+        if( _reuseTempFiles )
+            continue;
+
+        const std::string& wokrDir = GetWorkDir( useTmp2, (uint32)i );
+        memcpy( filePath, wokrDir.c_str(), wokrDir.length() );
+
+        sprintf( filePath + wokrDir.length(), "%s%s_%u.tmp", _tmpFilePrefix.c_str(), fileSet.name, (uint)i );
     
         const int r = remove( filePath );
 
@@ -1,12 +1,16 @@
 #pragma once
 
 #include "io/IStream.h"
+#include "io/FileStream.h"
 #include "threading/Fence.h"
+#include "threading/AsyncExecutor.h"
 #include "threading/ThreadPool.h"
 #include "threading/MTJob.h"
 #include "plotting/WorkHeap.h"
 #include "plotting/Tables.h"
 #include "plotting/PlotWriter.h"
+#include "plotting/IOStats.h"
+#include "IOController.h"
 #include "FileId.h"
 
 class Thread;
@@ -28,6 +32,13 @@ enum FileSetOptions
                             // This can be very memory-costly on file systems with large block sizes
                             // as interleaved buckets will need many block buffers.
                             // This must be used with DirectIO.
+
+    PageCache   = 1 << 6,   // Buffered I/O that relies on the OS page cache. Files are opened with sequential read-ahead
+                            // and each bucket read asks the OS to start reading in the next bucket.
+                            // This can't be used with DirectIO.
+
+    Resident    = 1 << 7,   // Keep written buckets in a memory region while they fit, and serve their slices
+                            // from it when reading, instead of the files. Only for interleaved, non-alternating file sets.
 };
 ImplementFlagOps( FileSetOptions );
 
@@ -39,6 +50,10 @@ struct FileSetInitData
 
     // For alternating mode
     uint64 maxSliceSize = 0;        // Maximum size (in bytes) of a bucket slice
+
+    // Resident
+    void*  residentBuffer   = nullptr;  // Memory holding written buckets in place of their files
+    size_t residentSize     = 0;        // Resident memory size in bytes
 };
 
 struct FileSet
@@ -54,6 +69,23 @@ struct FileSet
     uint32             writeBucket  = 0;
     FileSetOptions     options      = FileSetOptions::None;
 
+    // For FileSetOptions::Resident. Residency is recycled when the next write pass starts,
+    // since the buckets of the last one have all been read by then.
+    Span<byte>         resident;
+    size_t             residentUsed = 0;
+    Span<byte*>        residentBuckets;                      // Memory holding each bucket's slices, or null if it was written to its file
+
+    uint32             statsId      = 0;                     // File id in the queue's IOStats
+};
+
+/// Bytes that reached the disks, per file set, phase and table.
+/// What a file set's cache or resident memory absorbed is not counted, as it never touched a disk.
+struct TempIOAccounting
+{
+    static constexpr uint32 PHASE_COUNT = 4;    // Phase 0 holds the I/O issued outside of phases 1-3
+
+    std::atomic<uint64> read   [(uint)FileId::_COUNT][PHASE_COUNT][(uint)TableId::_Count];
+    std::atomic<uint64> written[(uint)FileId::_COUNT][PHASE_COUNT][(uint)TableId::_Count];
 };
 
 class DiskBufferQueue
@@ -77,6 +109,7 @@ class DiskBufferQueue
             ReleaseBuffer,
             SignalFence,
             WaitForFence,
+            SignalAsync,
             TruncateBucket,
 
             PlotWriterCommand,      // Wraps a PlotWriter command and dispatches it in our thread
@@ -87,6 +120,7 @@ class DiskBufferQueue
         };
 
         CommandType type;
+        uint32      ioStage;    // Phase and table the command's I/O is accounted to
 
         union
         {
@@ -135,6 +169,11 @@ class DiskBufferQueue
                 int64  value;
             } fence;
 
+            struct
+            {
+                AsyncSignal* signal;
+            } asyncSignal;
+
             struct
             {
                 FileId fileId;
@@ -182,7 +221,7 @@ public:
 public:
     DiskBufferQueue( const char* workDir1, const char* workDir2, const char* plotDir,
                      byte* workBuffer, size_t workBufferSize, uint ioThreadCount,
-                     int32 threadBindId = -1 );
+                     int32 threadBindId = -1, const char* tmpFilePrefix = nullptr );
 
     ~DiskBufferQueue();
 
@@ -192,6 +231,25 @@ public:
 
     void SetTransform( FileId fileId, IIOTransform& transform );
 
+    // While set, InitFileSet() opens the temp files left on disk by a previous run instead of truncating them,
+    // so that an interrupted plot can be resumed from a checkpoint.
+    inline void SetOpenExistingFiles( const bool enabled ) { _openExistingFiles = enabled; }
+
+    // While set, deleting a temp file only closes it. The file stays on disk with its extents, and the next plot's
+    // InitFileSet() overwrites it in place instead of re-creating it, which saves the create/delete and re-allocation
+    // of every bucket file per plot. DeletePooledFiles() removes them for good.
+    inline void SetReuseTempFiles( const bool enabled ) { _reuseTempFiles = enabled; }
+
+    // Waits for pending deletes, then deletes the temp files kept by SetReuseTempFiles()
+    void DeletePooledFiles();
+
+    inline const char* TmpFilePrefix() const { return _tmpFilePrefix.c_str(); }
+
+    // Adds a directory to stripe the temp1 (or temp2) bucket files across, like software RAID 0.
+    // Bucket i's files go to directory i % count, so that every pass over the buckets spreads its I/O over all of them.
+    // Must be called before any temp file set is initialized.
+    void AddWorkDir( bool tmp2, const char* dir );
+
     void OpenPlotFile( const char* fileName, const byte* plotId, const byte* plotMemo, uint16 plotMemoSize );
 
 /// Commands
@@ -223,6 +281,12 @@ public:
 
     void DeleteBucket( FileId id );
 
+    // Deletions run in the background on the deleter thread, so that the
+    // commands after them don't wait for the kernel to drop the files.
+    // Blocks until all the deletions issued so far have completed.
+    // The delete commands must have been committed before calling this.
+    void WaitForPendingDeletes();
+
     void TruncateBucket( FileId id, const ssize_t position );
 
     // Add a memory fence into the command stream.
@@ -237,6 +301,10 @@ public:
     // Instructs the command dispatch thread to wait until the specified fence has been signalled
     void WaitForFence( Fence& fence );
 
+    // Same as SignalFence, but the signal resumes the coroutine awaiting it on its executor,
+    // instead of waking a blocked thread. The signal must have been Reset() beforehand.
+    void SignalAsync( AsyncSignal& signal );
+
     void CommitCommands();
 
 // Helpers
@@ -245,12 +313,17 @@ public:
     // This assumes a single consumer.
     inline byte* GetBuffer( size_t size, bool blockUntilFreeBuffer = true )
     { 
-        return _workHeap.Alloc( size, 1 /*_blockSize*/, blockUntilFreeBuffer, &_ioBufferWaitTime ); 
+        return GetBuffer( size, 1 /*_blockSize*/, blockUntilFreeBuffer );
     }
 
     inline byte* GetBuffer( const size_t size, const size_t alignment, bool blockUntilFreeBuffer = true )
     { 
-        return _workHeap.Alloc( size, alignment, blockUntilFreeBuffer, &_ioBufferWaitTime ); 
+        Duration waitTime = Duration::zero();
+        byte*    buffer   = _workHeap.Alloc( size, alignment, blockUntilFreeBuffer, &waitTime );
+
+        _ioBufferWaitTime += waitTime;
+        _ioStats.AddBufferWait( waitTime );
+        return buffer;
     }
 
     #if _DEBUG || BB_TEST_MODE
@@ -281,28 +354,53 @@ public:
 
     inline uint64 PlotTablePointersAddress() const { return _plotTablesPointers; }
 
+    // Tune the queue depth of batched (io_uring or overlapped) work file I/O at table boundaries, see IOController.
+    // Must be called before any I/O commands are issued.
+    void EnableAdaptiveIO();
+
+    // Called by the user thread once a table of the given phase has completed
+    void AdaptIO( uint32 phase );
+
     inline double IOBufferWaitTime() const { return TicksToSeconds( _ioBufferWaitTime ); }
     inline void ResetIOBufferWaitCounter() { _ioBufferWaitTime = Duration::zero(); }
+    inline void ResetHeapStats() { _workHeap.ResetStats(); }
+
+    // Account the I/O of the commands issued from now on to the given phase (1-3, or 0 for none) and table
+    inline void SetIOAccountingStage( const uint32 phase, const TableId table )
+    {
+        ASSERT( phase < TempIOAccounting::PHASE_COUNT );
+        _ioStage.store( phase * (uint32)TableId::_Count + (uint32)table, std::memory_order_relaxed );
+    }
+
+    // Must only be called while the queue is idle
+    void ResetIOAccounting();
+
+    inline const TempIOAccounting& IOAccounting() const { return _ioAccounting; }
+
+    inline const char* FileSetName( const FileId fileId ) const { return _files[(int)fileId].name; }
 
 
     #if _DEBUG || BB_IO_METRICS_ON
     //-----------------------------------------------------------
-    inline const IOMetric& GetReadMetrics() const { return _readMetrics; }
-    inline const IOMetric& GetWriteMetrics() const { return _writeMetrics;}
+    // Each command thread records its own metrics, so only read them while the queue is idle (ex. after a fence).
+    inline IOMetric GetReadMetrics()  const { return SumMetrics( _readMetrics  ); }
+    inline IOMetric GetWriteMetrics() const { return SumMetrics( _writeMetrics ); }
 
     //-----------------------------------------------------------
     inline double GetAverageReadThroughput() const
     {
-        const double elapsed    = TicksToSeconds( _readMetrics.time ) / (double)_readMetrics.count; 
-        const double throughput = (double)_readMetrics.size / (double)_readMetrics.count / elapsed;
+        const IOMetric reads      = GetReadMetrics();
+        const double   elapsed    = TicksToSeconds( reads.time ) / (double)reads.count; 
+        const double   throughput = (double)reads.size / (double)reads.count / elapsed;
         return throughput;
     }
 
     //-----------------------------------------------------------
     inline double GetAverageWriteThroughput() const
     {
-        const double elapsed    = TicksToSeconds( _writeMetrics.time ) / (double)_writeMetrics.count; 
-        const double throughput = (double)_writeMetrics.size / (double)_writeMetrics.count / elapsed;
+        const IOMetric writes     = GetWriteMetrics();
+        const double   elapsed    = TicksToSeconds( writes.time ) / (double)writes.count; 
+        const double   throughput = (double)writes.size / (double)writes.count / elapsed;
         return throughput;
     }
 
@@ -371,14 +469,23 @@ public:
     //-----------------------------------------------------------
     inline void ClearReadMetrics()
     {
-        _readMetrics = {};
+        _readMetrics[0] = _readMetrics[1] = {};
     }
 
     //-----------------------------------------------------------
     inline void ClearWriteMetrics()
     {
-        _writeMetrics = {};
+        _writeMetrics[0] = _writeMetrics[1] = {};
+    }
+
+private:
+    //-----------------------------------------------------------
+    inline static IOMetric SumMetrics( const IOMetric metrics[2] )
+    {
+        return { metrics[0].size + metrics[1].size, metrics[0].time + metrics[1].time, metrics[0].count + metrics[1].count };
     }
+
+public:
     #else
     inline void DumpWriteMetrics( const TableId table ) {}
     inline void DumpReadMetrics( const TableId table  ) {}
@@ -405,14 +512,63 @@ private:
     void CmdReadFile( const Command& cmd );
     void CmdSeekBucket( const Command& cmd );
 
-    void WriteToFile( IStream& file, size_t size, const byte* buffer, byte* blockBuffer, const char* fileName, uint bucket );
-    void ReadFromFile( IStream& file, size_t size, byte* buffer, byte* blockBuffer, const size_t blockSize, const bool directIO, const char* fileName, const uint bucket );
+    // Keeps the bucket being written in memory, if there's room left for it
+    bool WriteResidentBucket( FileSet& fileSet, const byte* buffer, const uint* writeSizes, const uint32* sliceSizes, const size_t elementSize );
+
+    // Offset of a slice within its resident bucket
+    size_t ResidentSliceOffset( const FileSet& fileSet, const uint32 bucket, const uint32 slice ) const;
+
+    // Hint the OS to start reading the file set's next bucket into the page cache
+    void PrefetchNextBucket( FileSet& fileSet );
+
+    // Temp2 command thread
+    static void Tmp2ThreadMain( DiskBufferQueue* self );
+    void Tmp2Main();
+
+    bool IsTmp2Command( const Command& cmd ) const;
+    void ForwardToTmp2( const Command& cmd );
+    void CommitTmp2Commands();
+
+    // Block until all commands forwarded to the temp2 thread have completed
+    void WaitForTmp2();
+
+    // Whether the file set's bucket slices can be read and written in a single I/O batch
+    bool CanBatchIO( const FileSet& fileSet );
+
+    // Index of the command thread which executes the file set's I/O: 1 for the temp2 thread, otherwise 0
+    inline uint32 CmdThreadIdx( const FileSet& fileSet ) const
+    {
+        return _useTmp2Queue && IsFlagSet( fileSet.options, FileSetOptions::UseTemp2 ) ? 1 : 0;
+    }
+
+#if BB_HAS_FILE_IO_BATCH
+    // Each command thread has its own batch
+    inline FileIOBatch& IOBatch( const FileSet& fileSet )
+    {
+        return _ioBatch[CmdThreadIdx( fileSet )];
+    }
+#endif
+    void SubmitIOBatch( const FileSet& fileSet, size_t totalSize, bool isWrite );
+
+    void AccountIO( const FileSet& fileSet, size_t diskSize, bool isWrite );
+
+    void WriteToFile( IStream& file, size_t size, const byte* buffer, byte* blockBuffer, const FileSet& fileSet, uint bucket );
+    void ReadFromFile( IStream& file, size_t size, byte* buffer, byte* blockBuffer, const size_t blockSize, const bool directIO, const FileSet& fileSet, const uint bucket );
 
     void CmdDeleteFile( const Command& cmd );
     void CmdDeleteBucket( const Command& cmd );
 
     void CmdTruncateBucket( const Command& cmd );
 
+    // Directory holding a bucket's temp files
+    inline const std::string& GetWorkDir( const bool useTmp2, const uint32 bucket ) const
+    {
+        const auto& workDirs = _workDirs[useTmp2 ? 1 : 0];
+        return workDirs[bucket % workDirs.size()];
+    }
+
+    void AllocPathBuffers();
+
     void CloseFileNow( const FileId fileId, const uint32 bucket );
     void DeleteFileNow( const FileId fileId, const uint32 bucket );
     void DeleteBucketNow( const FileId fileId );
@@ -430,8 +586,12 @@ private:
 private:
     std::string      _workDir1;     // Temporary 1 directory in which we will store our long-lived temporary files
     std::string      _workDir2;     // Temporary 2 directory in which we will store our short-live, high-req I/O temporary files
+    std::vector<std::string> _workDirs[2];  // Temp1 and temp2 directories the bucket files are striped across. The first is _workDir1/_workDir2
     std::string      _plotDir;      // Temporary plot directory
     std::string      _plotFullName; // Full path of the plot file without '.tmp'
+    std::string      _tmpFilePrefix;// Prepended to all temp file names, so that concurrent plotters can share temp directories
+    bool             _openExistingFiles = false;
+    bool             _reuseTempFiles    = false;
 
     WorkHeap         _workHeap;     // Reserved memory for performing plot work and I/O // #TODO: Remove this
     
@@ -449,6 +609,10 @@ private:
 
     Duration         _ioBufferWaitTime = Duration::zero();  // Total time spent waiting for IO buffers.
 
+    IOStats          _ioStats;                              // Always-on metrics, per file set, for --io-status
+    TempIOAccounting _ioAccounting;                         // Disk bytes per file set, phase and table, for the end-of-plot report
+    std::atomic<uint32> _ioStage = 0;                       // Stage given to new commands, see SetIOAccountingStage()
+
     // I/O thread stuff
     Thread            _dispatchThread;
     
@@ -456,6 +620,25 @@ private:
 
     // ThreadPool        _threadPool;
 
+    // Temp2 command thread. The main command thread forwards temp2 file set commands to it.
+    bool              _useTmp2Queue = false;
+    SPCQueue<Command, BB_DISK_QUEUE_MAX_CMDS> _tmp2Commands;
+    AutoResetSignal   _tmp2ReadySignal;
+    AutoResetSignal   _tmp2ConsumedSignal;
+    AutoResetSignal   _tmp2CompletedSignal;
+    uint64            _tmp2Forwarded = 0;               // Only accessed by the main command thread
+    uint32            _tmp2Pending   = 0;               // Forwarded, but not yet committed
+    std::atomic<uint64> _tmp2Completed = 0;
+    std::atomic<bool> _tmp2Exit      = false;
+    Thread            _tmp2Thread;                      // Declared after its signals, so that it is torn down before them
+
+#if BB_HAS_FILE_IO_BATCH
+    FileIOBatch       _ioBatch[2];                      // One per command thread
+#endif
+    IOController*     _ioController[2]     = {};        // Adaptive queue depth per command thread, if enabled
+    Duration          _adaptBufferWaitTime = Duration::zero();  // _ioBufferWaitTime at the last AdaptIO()
+    TimePoint         _adaptTime;
+
     AutoResetSignal   _cmdReadySignal;
     AutoResetSignal   _cmdConsumedSignal;
 
@@ -465,11 +648,13 @@ private:
     GrowableSPCQueue<FileDeleteCommand> _deleteQueue;   // block other commands when the kernel is clearing cached IO buffers for the files.
     char*             _delFilePathBuffer = nullptr;     // For deleting file sets
     bool              _deleterExit       = false;
+    Fence             _deleteFence;                     // Signalled by the deleter thread with the count of completed deletions
+    uint32            _deletesIssued     = 0;           // Deletions requested by the user thread
     int32             _threadBindId;
 
 #if _DEBUG || BB_IO_METRICS_ON
-    IOMetric _readMetrics  = {};
-    IOMetric _writeMetrics = {};
+    IOMetric _readMetrics [2] = {};                     // One per command thread, see CmdThreadIdx()
+    IOMetric _writeMetrics[2] = {};
 #endif
 };
 
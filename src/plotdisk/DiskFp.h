@@ -40,7 +40,7 @@ public:
     using EntryOut = FpEntry<table>;
     using TMetaIn  = typename TableMetaType<table>::MetaIn;
     using TMetaOut = typename TableMetaType<table>::MetaOut;
-    using TYOut    = typename FpFxGen<table>::TYOut;
+    using TYOut    = typename FpFxGen<table, _k>::TYOut;
     using TAddress = uint64;
 
 public:
@@ -175,24 +175,27 @@ public:
         const size_t pairBits        = _k + 1 - bucketBits + 9;         // Entries stored in table file (tmp1)
         const size_t mapBits         = _k + 1 - bucketBits + _k + 1;    // Entries stored in map file (tmp1)
 
-        // Because bitwriter needs each slice buffer to be rounded up
-        // to block-size, we need to account for that here when allocating.
-        const size_t entrySliceAlloc = (size_t)RoundUpToNextBoundaryT( CDiv( (uint128)maxSliceEntries * entrySizeBits, 8 ), (uint128)fxBlockSize   );
-        const size_t mapSliceAslloc  = (size_t)RoundUpToNextBoundaryT( CDiv( (uint128)maxSliceEntries * mapBits      , 8 ), (uint128)pairBlockSize );
-        
-        const size_t genEntriesPerBucket  = (size_t)( CDivT( maxEntries, (size_t)_numBuckets ) * BB_DP_XTRA_ENTRIES_PER_BUCKET );
-        const size_t perBucketEntriesSize = RoundUpToNextBoundaryT( CDiv( entrySizeBits * genEntriesPerBucket, 8 ), fxBlockSize ) + 
-                                            RoundUpToNextBoundaryT( CDiv( entrySizeBits * BB_DP_CROSS_BUCKET_MAX_ENTRIES, 8 ), fxBlockSize );
+        // Read buffers hold a whole bucket, so they must fit the working buffers' capacity.
+        const size_t fxReadSize = RoundUpToNextBoundaryT( CDiv( maxEntries * entrySizeBits, 8 ), fxBlockSize ) + fxBlockSize;
+
+        // Write buffers only need to fit the entries a bucket is predicted to generate, as the
+        // bit writer packs its slices contiguously. Each slice is rounded up to the block size,
+        // and it may carry up to a block of left-over bits from the previous bucket.
+        const size_t predictedEntries = info::PredictedBucketEntries;
 
-        const size_t fxWriteSize   = entrySliceAlloc * _numBuckets; //(size_t)_numBuckets * perBucketEntriesSize;
+        const size_t fxWriteSize   = RoundUpToNextBoundaryT( CDiv( predictedEntries * entrySizeBits, 8 ), fxBlockSize ) + fxBlockSize * _numBuckets * 2;
         const size_t pairWriteSize = CDiv( ( maxEntriesX ) * pairBits, 8 ); 
-        const size_t mapWriteSize  = mapSliceAslloc * _numBuckets;   //CDiv( ( maxEntriesX ) * mapBits , 8 ); // #TODO: Might need the cross bucket entries added here too... But maybe the multiplier covers it
+        const size_t mapWriteSize  = RoundUpToNextBoundaryT( CDiv( predictedEntries * mapBits, 8 ), pairBlockSize ) + pairBlockSize * MapBucketCount * 2;
+
+        // Slice-sized buffers, as they were before prediction
+        ASSERT( fxWriteSize  <= (size_t)RoundUpToNextBoundaryT( CDiv( (uint128)maxSliceEntries * entrySizeBits, 8 ), (uint128)fxBlockSize   ) * _numBuckets );
+        ASSERT( mapWriteSize <= (size_t)RoundUpToNextBoundaryT( CDiv( (uint128)maxSliceEntries * mapBits      , 8 ), (uint128)pairBlockSize ) * _numBuckets );
 
-        // #TODO: These need to have buffers rounded-up to block size per bucket I think...
-        //         So we need to have this divided into bucket slices, then each sice rounded-up
-        //         to the block size, finally, the sum of that is the allocation size.
-        _fxRead [0]   = alloc.Alloc( fxWriteSize, fxBlockSize );
-        _fxRead [1]   = alloc.Alloc( fxWriteSize, fxBlockSize );
+        _fxWriteSize  = fxWriteSize;
+        _mapWriteSize = mapWriteSize;
+
+        _fxRead [0]   = alloc.Alloc( fxReadSize , fxBlockSize );
+        _fxRead [1]   = alloc.Alloc( fxReadSize , fxBlockSize );
         _fxWrite[0]   = alloc.Alloc( fxWriteSize, fxBlockSize );
         _fxWrite[1]   = alloc.Alloc( fxWriteSize, fxBlockSize );
 
@@ -434,13 +437,21 @@ public:
                 for( uint32 i = 0; i < numBuckets; i++ )
                     bitCounts[i] = (uint64)totalCounts[i] * bitSize;
 
-                byte* writeBuffer = GetMapWriteBuffer( bucket );
+                // Spill over to the IO heap if the bucket has more entries than predicted
+                _mapWriteSpilled = bitWriter.GetBufferSize( bitCounts ) > _mapWriteSize;
 
-                // Wait for the buffer to be available first
-                if( bucket > 1 )
-                    _mapWriteFence.Wait( bucket - 2, _ioWaitTime );
+                if( _mapWriteSpilled )
+                    bitWriter.BeginWriteBuckets( bitCounts );
+                else
+                {
+                    byte* writeBuffer = GetMapWriteBuffer( bucket );
+
+                    // Wait for the buffer to be available first
+                    if( bucket > 1 )
+                        _mapWriteFence.Wait( bucket - 2, _ioWaitTime );
 
-                bitWriter.BeginWriteBuckets( bitCounts, writeBuffer );
+                    bitWriter.BeginWriteBuckets( bitCounts, writeBuffer );
+                }
 
                 self->ReleaseThreads();
             }
@@ -504,7 +515,11 @@ public:
                         writer.Write( *mapToWrite++, bitSize );
                 }
 
-                bitWriter.Submit();
+                if( _mapWriteSpilled )
+                    bitWriter.SubmitAndRelease();
+                else
+                    bitWriter.Submit();
+
                 _ioQueue.SignalFence( _mapWriteFence, bucket );
                 _ioQueue.CommitCommands();
             }
@@ -530,7 +545,7 @@ public:
         if( !info.matchCount )
             return;
 
-        FpFxGen<table>::ComputeFx( (int64)info.matchCount, info.pair, info.y, (TMetaIn*)info.meta, outY, outMeta, 0 );
+        FpFxGen<table, _k>::ComputeFx( (int64)info.matchCount, info.pair, info.y, (TMetaIn*)info.meta, outY, outMeta, 0 );
         
         const uint32 matchOffset = (uint32)info.matchOffset[0]; // Grab the previous bucket's offset and apply it
         const Pair * srcPairs    = info.pair;
@@ -549,7 +564,7 @@ public:
                 const Pair* pairs, const uint64* inY, const TMetaIn* inMeta, 
                 TYOut* outY, TMetaOut* outMeta )
     {
-        FpFxGen<table> fx( _pool, _threadCount );
+        FpFxGen<table, _k> fx( _pool, _threadCount );
         fx.ComputeFxMT( entryCount, pairs, inY, inMeta, outY, outMeta );
     }
 
@@ -664,13 +679,21 @@ public:
                 for( uint32 i = 0; i < _numBuckets; i++ )
                     totalBitCounts[i] = totalCounts[i] * entrySizeBits;
                 
-                byte* writeBuffer = GetWriteBuffer( bucket );
+                // Spill over to the IO heap if the bucket generated more entries than predicted
+                _fxWriteSpilled = bitWriter.GetBufferSize( totalBitCounts ) > _fxWriteSize;
+
+                if( _fxWriteSpilled )
+                    bitWriter.BeginWriteBuckets( totalBitCounts );
+                else
+                {
+                    byte* writeBuffer = GetWriteBuffer( bucket );
                 
-                // Wait for the buffer to be available first
-                if( bucket > 1 )
-                    _writeFence.Wait( bucket - 2, _ioWaitTime );
+                    // Wait for the buffer to be available first
+                    if( bucket > 1 )
+                        _writeFence.Wait( bucket - 2, _ioWaitTime );
 
-                bitWriter.BeginWriteBuckets( totalBitCounts, writeBuffer );
+                    bitWriter.BeginWriteBuckets( totalBitCounts, writeBuffer );
+                }
 
                 _sharedTotalBitCounts = totalBitCounts;
 
@@ -707,7 +730,12 @@ public:
             if( self->IsControlThread() )
             {
                 self->LockThreads();
-                bitWriter.Submit();
+
+                if( _fxWriteSpilled )
+                    bitWriter.SubmitAndRelease();
+                else
+                    bitWriter.Submit();
+
                 _ioQueue.SignalFence( _writeFence, bucket );
                 _ioQueue.CommitCommands();
                 self->ReleaseThreads();
@@ -1171,6 +1199,9 @@ public:
         const int32  loadTable     = IsT7Out ? (int)table : (int)table-1;
 
         const uint64 inBucketLength  = _context.bucketCounts[loadTable][bucket];
+        FatalIf( inBucketLength > (uint64)MaxBucketEntries, "Bucket %u of table %d has %llu entries, more than the %llu it can hold.",
+                 bucket, loadTable+1, (llu)inBucketLength, (llu)MaxBucketEntries );
+
         const size_t bucketSizeBytes = CDiv( entrySizeBits * (uint64)inBucketLength, 64 ) * 64 / 8;
 
         byte* readBuffer = GetReadBufferForBucket( bucket );
@@ -1236,6 +1267,11 @@ private:
     void*   _pairWrite[2] = { 0 };
     void*   _mapWrite [2] = { 0 };
 
+    size_t  _fxWriteSize     = 0;
+    size_t  _mapWriteSize    = 0;
+    bool    _fxWriteSpilled  = false;   // Set when a bucket's writes didn't fit and were given a buffer from the IO heap
+    bool    _mapWriteSpilled = false;
+
     uint32  _threadCount;
     uint64* _sharedTotalBitCounts = nullptr;  // Total bucket bit sizes when writing Fx across all threads
 
@@ -1,8 +1,10 @@
 #pragma once
 #include "plotdisk/DiskPlotInfo.h"
 #include "plotdisk/DiskPlotContext.h"
+#include "plotdisk/BoundedPairDeltas.h"
 #include "util/StackAllocator.h"
 #include "util/BitView.h"
+#include "util/BitUnpack.h"
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wreorder"
@@ -115,31 +117,16 @@ struct DiskMapReader
                 // Unpack the whole bucket into it's destination indices
                 if( _bucketsUnpacked <= bucketsRead )
                 {
-                    #if _DEBUG
-                        const uint64 virtBucketLength = GetVirtualBucketLength( _bucketsUnpacked );
-                    #endif
-
                     const uint64 bucketLength = _bucketLengths[_bucketsUnpacked];
                     
                     int64 count, offset, end;
                     GetThreadOffsets( self, (int64)bucketLength, count, offset, end );
                     ASSERT( count > 0 );
 
+                    // Each entry is ( destination index | final index ), write the final index straight to its destination
                     TMap* unpackedMap = _unpackdMaps[_bucketsUnpacked & 1];
-                    BitReader reader( (uint64*)GetBucketBuffer( _bucketsUnpacked ), _mapBits * bucketLength, offset * _mapBits );
-
-                    const uint32 idxShift     = _finalIdxBits;
-                    const uint64 finalIdxMask = ( 1ull << idxShift ) - 1;
-
-                    for( int64 i = offset; i < end; i++ )
-                    {
-                        const uint64 packedMap = reader.ReadBits64( (uint32)_mapBits );
-                        const uint64 map       = packedMap & finalIdxMask;
-                        const uint64 dstIdx    = packedMap >> idxShift;
-
-                        ASSERT( dstIdx < virtBucketLength );
-                        unpackedMap[dstIdx] = (TMap)map;
-                    }
+                    UnpackMapScatter( (uint64*)GetBucketBuffer( _bucketsUnpacked ), (uint64)offset * _mapBits, (uint64)count,
+                                      _mapBits, _finalIdxBits, unpackedMap );
 
                     if( self->IsControlThread() )
                     {
@@ -288,7 +275,7 @@ struct DiskPairAndMapReader
         for( uint32 i = 0; i < _numBuckets; i++ )
         {
             const size_t bucketLength           = _context->ptrTableBucketCounts[(int)_table][i];
-            const size_t bucketBitSize          = bucketLength * _pairBits - prevOverflowBits;
+            const size_t bucketBitSize          = bucketLength * ( GetLeftBits( i ) + _rBits ) - prevOverflowBits;
             const size_t bucketByteSize         = CDiv( bucketBitSize, 8 );
             const size_t bucketBlockAlignedSize = CDivT( bucketByteSize, blockSize ) * blockSize;
 
@@ -368,7 +355,12 @@ struct DiskPairAndMapReader
 
         const size_t fullBitSize = _pairBucketLoadSize[bucket] * 8 + blockBitSize - startBit;
         
-        const int64 bucketLength = (int64)_context->ptrTableBucketCounts[(int)_table][bucket];
+        const int64  bucketLength = (int64)_context->ptrTableBucketCounts[(int)_table][bucket];
+        const uint32 lBits        = GetLeftBits( bucket );
+        const uint32 pairBits     = lBits + _rBits;
+
+        uint32  threadLefts[BB_DP_MAX_JOBS];
+        uint32* lefts = threadLefts;
 
         AnonMTJob::Run( *_context->threadPool, _threadCount, [=]( AnonMTJob* self ) {
             
@@ -377,16 +369,39 @@ struct DiskPairAndMapReader
             int64 count, offset, end;
             GetThreadOffsets( self, bucketLength, count, offset, end );
 
-            const size_t bitOffset = startBit + (size_t)offset * _pairBits;
+            const size_t bitOffset = startBit + (size_t)offset * pairBits;
             BitReader reader( (uint64*)pairBuffer, fullBitSize, bitOffset );
 
-            for( int64 i = offset; i < end; i++ )
+            if constexpr ( _bounded )
             {
-                Pair pair;
-                pair.left  = (uint32)reader.ReadBits64( _lBits );
-                pair.right = pair.left +  (uint32)reader.ReadBits64( _rBits );
+                // Lefts are stored as deltas to the previous pair's, so decode them
+                // relative to our first pair, then add the sum of the previous threads' deltas.
+                lefts[self->JobId()] = BoundedPairDeltas::Unpack( reader, pairs + offset, (size_t)count, lBits, _rBits );
+                self->SyncThreads();
+
+                uint32 leftBase = 0;
+                for( uint32 i = 0; i < self->JobId(); i++ )
+                    leftBase += lefts[i];
+
+                if( leftBase > 0 )
+                {
+                    for( int64 i = offset; i < end; i++ )
+                    {
+                        pairs[i].left  += leftBase;
+                        pairs[i].right += leftBase;
+                    }
+                }
+            }
+            else
+            {
+                for( int64 i = offset; i < end; i++ )
+                {
+                    Pair pair;
+                    pair.left  = (uint32)reader.ReadBits64( lBits );
+                    pair.right = pair.left +  (uint32)reader.ReadBits64( _rBits );
 
-                pairs[i] = pair;
+                    pairs[i] = pair;
+                }
             }
         });
 
@@ -398,6 +413,16 @@ struct DiskPairAndMapReader
     }
 
 private:
+    /// Bounded pairs store their lefts as deltas with a per-bucket bit size
+    //-----------------------------------------------------------
+    inline uint32 GetLeftBits( const uint32 bucket ) const
+    {
+        if constexpr ( _bounded )
+            return _context->ptrTableBucketLeftBits[(int)_table][bucket];
+        else
+            return _lBits;
+    }
+
     //-----------------------------------------------------------
     inline void Allocate( IAllocator& allocator, const size_t blockSize )
     {
@@ -425,6 +450,126 @@ private:
     bool             _noMap;
 };
 
+/// Reads the back pointers and map of a table that Phase 2 compacted (--p2-compact).
+/// Only the marked entries of the table are stored, in the same order, each bucket
+/// block-aligned, as <left: k+1 bits><right - left: 9 bits><map: k+1 bits> entries.
+/// Lefts keep their bucket-local coordinates, so they are used just like those of DiskPairAndMapReader.
+template<uint32 _numBuckets>
+struct DiskCompactedPairAndMapReader
+{
+    static constexpr uint32 _k        = _K;
+    static constexpr uint32 _lBits    = _k + 1;
+    static constexpr uint32 _rBits    = 9;
+    static constexpr uint32 _mapBits  = _k + 1;
+    static constexpr uint32 EntryBits = _lBits + _rBits + _mapBits;
+
+    //-----------------------------------------------------------
+    DiskCompactedPairAndMapReader() {}
+
+    //-----------------------------------------------------------
+    DiskCompactedPairAndMapReader( DiskPlotContext& context, const uint32 threadCount, Fence& fence, 
+                                   const TableId table, IAllocator& allocator, const uint64 maxBucketEntries )
+        : _context    ( &context )
+        , _fence      ( &fence   )
+        , _threadCount( threadCount )
+        , _table      ( table )
+        , _fileId     ( TableIdToCompactedFileId( table ) )
+    {
+        Allocate( allocator, context.ioQueue->BlockSize( _fileId ), maxBucketEntries );
+    }
+
+    // Allocation size-check dummy
+    //-----------------------------------------------------------
+    DiskCompactedPairAndMapReader( IAllocator& allocator, const size_t blockSize, const uint64 maxBucketEntries )
+    {
+        Allocate( allocator, blockSize, maxBucketEntries );
+    }
+
+    /// Size of a compacted bucket in the file
+    //-----------------------------------------------------------
+    inline static size_t BucketSize( const uint64 entryCount, const size_t blockSize )
+    {
+        return CDivT( (size_t)entryCount * EntryBits, blockSize * 8 ) * blockSize;
+    }
+
+    /// Packs an entry in the compacted format
+    //-----------------------------------------------------------
+    inline static void WriteEntry( BitWriter& writer, const Pair pair, const uint64 map )
+    {
+        ASSERT( pair.right - pair.left < ( 1u << _rBits ) );
+
+        writer.Write( pair.left, _lBits );
+        writer.Write( pair.right - pair.left, _rBits );
+        writer.Write( map, _mapBits );
+    }
+
+    //-----------------------------------------------------------
+    void LoadNextBucket()
+    {
+        if( _bucketsLoaded >= _numBuckets )
+            return;
+
+        DiskBufferQueue& ioQueue = *_context->ioQueue;
+
+        const uint32 bucket   = _bucketsLoaded++;
+        const size_t loadSize = BucketSize( _context->compactedBucketCounts[(int)_table][bucket], ioQueue.BlockSize( _fileId ) );
+
+        if( loadSize > 0 )
+            ioQueue.ReadFile( _fileId, 0, _buffers[bucket & 1], loadSize );
+
+        ioQueue.SignalFence( *_fence, bucket+1 );
+        ioQueue.CommitCommands();
+    }
+
+    //-----------------------------------------------------------
+    uint64 UnpackBucket( const uint32 bucket, Pair* outPairs, uint64* outMap, Duration& ioWait )
+    {
+        _fence->Wait( bucket + 1, ioWait );
+
+        const int64   bucketLength = (int64)_context->compactedBucketCounts[(int)_table][bucket];
+        const uint64* fields       = _buffers[bucket & 1];
+
+        AnonMTJob::Run( *_context->threadPool, _threadCount, [=]( AnonMTJob* self ) {
+
+            int64 count, offset, end;
+            GetThreadOffsets( self, bucketLength, count, offset, end );
+
+            BitReader reader( fields, (size_t)bucketLength * EntryBits, (uint64)offset * EntryBits );
+
+            for( int64 i = offset; i < end; i++ )
+            {
+                Pair pair;
+                pair.left  = (uint32)reader.ReadBits64( _lBits );
+                pair.right = pair.left + (uint32)reader.ReadBits64( _rBits );
+
+                outPairs[i] = pair;
+                outMap  [i] = reader.ReadBits64( _mapBits );
+            }
+        });
+
+        return (uint64)bucketLength;
+    }
+
+private:
+    //-----------------------------------------------------------
+    inline void Allocate( IAllocator& allocator, const size_t blockSize, const uint64 maxBucketEntries )
+    {
+        const size_t bufferSize = BucketSize( maxBucketEntries, blockSize );
+
+        _buffers[0] = allocator.AllocT<uint64>( bufferSize, blockSize );
+        _buffers[1] = allocator.AllocT<uint64>( bufferSize, blockSize );
+    }
+
+private:
+    DiskPlotContext* _context       = nullptr;
+    Fence*           _fence         = nullptr;
+    uint64*          _buffers[2]    = { nullptr };
+    uint32           _bucketsLoaded = 0;
+    uint32           _threadCount   = 0;
+    TableId          _table         = (TableId)0;
+    FileId           _fileId        = FileId::None;
+};
+
 
 /// Reads T-sized elements with fs block size alignment.
 /// Utility class used to hide block alignment stuff from the user.
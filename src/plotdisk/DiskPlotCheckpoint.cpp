@@ -0,0 +1,200 @@
+#include "DiskPlotCheckpoint.h"
+#include "io/FileStream.h"
+#include "util/Log.h"
+#include "util/Util.h"
+
+//-----------------------------------------------------------
+static void CopyStr( char* dst, const size_t dstSize, const char* src )
+{
+    FatalIf( strlen( src ) >= dstSize, "Checkpoint: Path '%s' is too long.", src );
+    strcpy( dst, src );
+}
+
+//-----------------------------------------------------------
+void DiskPlotCheckpoint::Save( DiskPlotContext& cx, const Stage stage, const TableId p3Table,
+                               const FileId p3MapReadId, const uint64* p3LMapBucketCounts )
+{
+    const char* path = cx.cfg->checkpointPath;
+    if( !path )
+        return;
+
+    ASSERT( stage != Stage::Phase3Table || ( p3MapReadId != FileId::None && p3LMapBucketCounts ) );
+
+    const auto timer = TimerBegin();
+
+    // The checkpoint may only refer to temp files whose writes have completed
+    {
+        Fence fence;
+        cx.ioQueue->SignalFence( fence, 1 );
+        cx.ioQueue->CommitCommands();
+        fence.Wait( 1 );
+    }
+
+    auto& gCfg = *cx.cfg->globalCfg;
+    auto& req  = cx.plotRequest;
+
+    // Too big for the stack
+    DiskPlotCheckpoint* cp = new DiskPlotCheckpoint();
+    ZeroMem( cp );
+
+    Fence writerFence;
+    cx.plotWriter->SaveState( cp->writer, writerFence );
+
+    cp->magic            = MAGIC;
+    cp->version          = VERSION;
+    cp->size             = (uint32)sizeof( DiskPlotCheckpoint );
+    cp->stage            = stage;
+    cp->p3Table          = p3Table;
+    cp->k                = _K;
+    cp->numBuckets       = cx.numBuckets;
+    cp->bounded          = cx.cfg->bounded ? 1 : 0;
+    cp->compressionLevel = gCfg.compressionLevel;
+    cp->parkDeltaCoding  = (uint32)gCfg.parkDeltaCoding;
+    cp->alignedParks     = gCfg.alignedParks ? 1 : 0;
+    cp->p2Compact        = cx.cfg->p2Compact ? 1 : 0;
+
+    CopyStr( cp->tmpPath      , sizeof( cp->tmpPath       ), cx.tmpPath  );
+    CopyStr( cp->tmpPath2     , sizeof( cp->tmpPath2      ), cx.tmpPath2 );
+    CopyStr( cp->tmpFilePrefix, sizeof( cp->tmpFilePrefix ), cx.ioQueue->TmpFilePrefix() );
+    CopyStr( cp->plotFileName , sizeof( cp->plotFileName  ), req.plotFileName );
+    CopyStr( cp->outDir       , sizeof( cp->outDir        ), req.outDir );
+
+    ASSERT( req.memoSize <= sizeof( cp->plotMemo ) );
+    memcpy( cp->plotId  , req.plotId, sizeof( cp->plotId ) );
+    memcpy( cp->plotMemo, req.memo  , req.memoSize );
+    cp->plotMemoSize = req.memoSize;
+
+    static_assert( sizeof( cp->bucketCounts ) == sizeof( cx.bucketCounts ) );
+    memcpy( cp->bucketCounts          , cx.bucketCounts          , sizeof( cp->bucketCounts           ) );
+    memcpy( cp->entryCounts           , cx.entryCounts           , sizeof( cp->entryCounts            ) );
+    memcpy( cp->ptrTableBucketCounts  , cx.ptrTableBucketCounts  , sizeof( cp->ptrTableBucketCounts   ) );
+    memcpy( cp->ptrTableBucketLeftBits, cx.ptrTableBucketLeftBits, sizeof( cp->ptrTableBucketLeftBits ) );
+    memcpy( cp->compactedTables       , cx.compactedTables       , sizeof( cp->compactedTables        ) );
+    memcpy( cp->compactedBucketCounts , cx.compactedBucketCounts , sizeof( cp->compactedBucketCounts  ) );
+    memcpy( cp->plotTablePointers     , cx.plotTablePointers     , sizeof( cp->plotTablePointers      ) );
+    memcpy( cp->plotTableSizes        , cx.plotTableSizes        , sizeof( cp->plotTableSizes         ) );
+
+    cp->p3MapReadId = p3MapReadId;
+    if( p3LMapBucketCounts )
+        memcpy( cp->p3LMapBucketCounts, p3LMapBucketCounts, sizeof( uint64 ) * ( cx.numBuckets+1 ) );
+
+    writerFence.Wait( 1 );
+
+    // Write a new file and swap it in, so that there's always a complete checkpoint on disk
+    const std::string tmpPath = std::string( path ) + ".new";
+
+    FileStream file;
+    FatalIf( !file.Open( tmpPath.c_str(), FileMode::Create, FileAccess::Write ),
+        "Failed to open checkpoint file '%s' with error: %d.", tmpPath.c_str(), file.GetError() );
+
+    FatalIf( file.Write( cp, sizeof( DiskPlotCheckpoint ) ) != (ssize_t)sizeof( DiskPlotCheckpoint ) || !file.Flush(),
+        "Failed to write checkpoint file '%s' with error: %d.", tmpPath.c_str(), file.GetError() );
+
+    file.Close();
+    delete cp;
+
+    #if PLATFORM_IS_WINDOWS
+        remove( path );     // MoveFile won't replace it
+    #endif
+
+    int32 err = 0;
+    FatalIf( !FileStream::Move( tmpPath.c_str(), path, &err ),
+        "Failed to move checkpoint file '%s' to '%s' with error: %d.", tmpPath.c_str(), path, err );
+
+    if( stage == Stage::Phase3Table )
+        Log::Line( "Saved checkpoint after Phase 3 table %u in %.2lf seconds.", (uint)p3Table+1, TimerEnd( timer ) );
+    else
+        Log::Line( "Saved checkpoint after %s in %.2lf seconds.", StageName( stage ), TimerEnd( timer ) );
+}
+
+//-----------------------------------------------------------
+bool DiskPlotCheckpoint::Load( const char* path, DiskPlotCheckpoint& outCheckpoint )
+{
+    if( !FileStream::Exists( path ) )
+        return false;
+
+    FileStream file;
+    FatalIf( !file.Open( path, FileMode::Open, FileAccess::Read ),
+        "Failed to open checkpoint file '%s' with error: %d.", path, file.GetError() );
+
+    FatalIf( file.Read( &outCheckpoint, sizeof( DiskPlotCheckpoint ) ) != (ssize_t)sizeof( DiskPlotCheckpoint ),
+        "Failed to read checkpoint file '%s'. It may have been written by a different version of bladebit.", path );
+
+    FatalIf( outCheckpoint.magic != MAGIC || outCheckpoint.version != VERSION || outCheckpoint.size != sizeof( DiskPlotCheckpoint ),
+        "Invalid checkpoint file '%s'. It may have been written by a different version of bladebit.", path );
+
+    FatalIf( outCheckpoint.stage < Stage::Phase1 || outCheckpoint.stage > Stage::Phase3Table,
+        "Invalid checkpoint file '%s'.", path );
+
+    // Terminate all strings, in case the file was corrupted
+    outCheckpoint.tmpPath      [sizeof( outCheckpoint.tmpPath       )-1] = 0;
+    outCheckpoint.tmpPath2     [sizeof( outCheckpoint.tmpPath2      )-1] = 0;
+    outCheckpoint.tmpFilePrefix[sizeof( outCheckpoint.tmpFilePrefix )-1] = 0;
+    outCheckpoint.plotFileName [sizeof( outCheckpoint.plotFileName  )-1] = 0;
+    outCheckpoint.outDir       [sizeof( outCheckpoint.outDir        )-1] = 0;
+
+    return true;
+}
+
+//-----------------------------------------------------------
+void DiskPlotCheckpoint::Delete( const char* path )
+{
+    if( path && FileStream::Exists( path ) && remove( path ) != 0 )
+        Log::Line( "Warning: Failed to delete checkpoint file '%s'.", path );
+}
+
+//-----------------------------------------------------------
+void DiskPlotCheckpoint::Validate( const DiskPlotConfig& cfg ) const
+{
+    const GlobalPlotConfig& gCfg = *cfg.globalCfg;
+
+    FatalIf( k != _K, "The checkpoint is for a k%u plot.", k );
+    FatalIf( numBuckets != cfg.numBuckets, "The checkpoint was written with %u buckets. Pass -b %u to resume it.", numBuckets, numBuckets );
+    FatalIf( ( bounded != 0 ) != cfg.bounded, "The checkpoint was written %s --unbounded.", bounded ? "without" : "with" );
+    FatalIf( compressionLevel != gCfg.compressionLevel,
+        "The checkpoint was written with compression level %u. Pass --compress %u to resume it.", compressionLevel, compressionLevel );
+    FatalIf( parkDeltaCoding != (uint32)gCfg.parkDeltaCoding || ( alignedParks != 0 ) != gCfg.alignedParks,
+        "The checkpoint was written with a different park layout. Pass the same park options to resume it." );
+    FatalIf( stage >= Stage::Phase2 && ( p2Compact != 0 ) != cfg.p2Compact,
+        "The checkpoint was written %s --p2-compact.", p2Compact ? "with" : "without" );
+    FatalIf( strcmp( tmpPath, cfg.tmpPath ) != 0 || strcmp( tmpPath2, cfg.tmpPath2 ) != 0,
+        "The checkpoint was written with temp directories '%s' and '%s'.", tmpPath, tmpPath2 );
+
+    FatalIf( stage == Stage::Phase3Table && cfg.cacheSize > 0,
+        "The checkpoint was written in Phase 3, which can't be resumed with a cache." );
+}
+
+//-----------------------------------------------------------
+void DiskPlotCheckpoint::Restore( DiskPlotContext& cx ) const
+{
+    memcpy( cx.bucketCounts          , bucketCounts          , sizeof( bucketCounts           ) );
+    memcpy( cx.entryCounts           , entryCounts           , sizeof( entryCounts            ) );
+    memcpy( cx.ptrTableBucketCounts  , ptrTableBucketCounts  , sizeof( ptrTableBucketCounts   ) );
+    memcpy( cx.ptrTableBucketLeftBits, ptrTableBucketLeftBits, sizeof( ptrTableBucketLeftBits ) );
+    memcpy( cx.compactedTables       , compactedTables       , sizeof( compactedTables        ) );
+    memcpy( cx.compactedBucketCounts , compactedBucketCounts , sizeof( compactedBucketCounts  ) );
+    memcpy( cx.plotTablePointers     , plotTablePointers     , sizeof( plotTablePointers      ) );
+    memcpy( cx.plotTableSizes        , plotTableSizes        , sizeof( plotTableSizes         ) );
+}
+
+//-----------------------------------------------------------
+void DiskPlotCheckpoint::GetPlotRequest( PlotRequest& req ) const
+{
+    req.plotId       = plotId;
+    req.memo         = plotMemo;
+    req.memoSize     = plotMemoSize;
+    req.plotFileName = plotFileName;
+    req.outDir       = outDir;
+}
+
+//-----------------------------------------------------------
+const char* DiskPlotCheckpoint::StageName( const Stage stage )
+{
+    switch( stage )
+    {
+        case Stage::Phase1     : return "Phase 1";
+        case Stage::Phase2     : return "Phase 2";
+        case Stage::Phase3Table: return "Phase 3";
+        default                : return "none";
+    }
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include "DiskPlotContext.h"
+#include "FileId.h"
+
+/**
+ * Progress of a diskplot run (--checkpoint <file>), saved at the end of Phases 1 and 2 and after each Phase 3 table.
+ * It holds everything the remaining phases read from the context, which temp files hold the Phase 3 map,
+ * where the plot writer stood, and the plot's identity, so that an interrupted plot can be resumed
+ * from its temp files and its partial plot file.
+ * Phase 3 tables are only checkpointed when no cache is used, since the map then lives partly in memory.
+ */
+struct DiskPlotCheckpoint
+{
+    enum class Stage : uint32
+    {
+        None = 0,
+        Phase1,         // Phase 1 completed
+        Phase2,         // Phase 2 completed
+        Phase3Table,    // Phase 3 completed up to, and including, p3Table
+    };
+
+    static constexpr uint32 MAGIC   = 0x50434242;   // 'BBCP'
+    static constexpr uint32 VERSION = 2;
+
+    uint32          magic;
+    uint32          version;
+    uint32          size;                           // sizeof( DiskPlotCheckpoint ) when saved
+    Stage           stage;
+    TableId         p3Table;                        // Last table compressed in Phase 3
+
+    // Settings that must match to resume
+    uint32          k;
+    uint32          numBuckets;
+    uint32          bounded;
+    uint32          compressionLevel;
+    uint32          parkDeltaCoding;
+    uint32          alignedParks;
+    uint32          p2Compact;
+    char            tmpPath [1024];
+    char            tmpPath2[1024];
+    char            tmpFilePrefix[16];
+
+    // Plot identity
+    byte            plotId  [BB_PLOT_ID_LEN];
+    byte            plotMemo[BB_PLOT_MEMO_MAX_SIZE];
+    uint16          plotMemoSize;
+    char            plotFileName[BB_PLOT_FILE_LEN_TMP+1];
+    char            outDir  [1024];
+
+    // Context state
+    uint32          bucketCounts          [(uint)TableId::_Count][BB_DP_MAX_BUCKET_COUNT+1];
+    uint64          entryCounts           [(uint)TableId::_Count];
+    uint32          ptrTableBucketCounts  [(uint)TableId::_Count][BB_DP_MAX_BUCKET_COUNT];
+    uint8           ptrTableBucketLeftBits[(uint)TableId::_Count][BB_DP_MAX_BUCKET_COUNT];
+    bool            compactedTables       [(uint)TableId::_Count];
+    uint32          compactedBucketCounts [(uint)TableId::_Count][BB_DP_MAX_BUCKET_COUNT];
+    uint64          plotTablePointers[10];
+    uint64          plotTableSizes   [10];
+
+    // Phase 3 state
+    FileId          p3MapReadId;                    // LP_MAP set holding p3Table's reverse map, the L table of the next table
+    uint64          p3LMapBucketCounts[BB_DP_MAX_BUCKET_COUNT+1];
+
+    PlotWriterState writer;
+
+    // Writes out all pending plot data and saves the context's progress to the checkpoint file, if there is one.
+    // The Phase 3 state is only given for Stage::Phase3Table.
+    static void Save( DiskPlotContext& cx, Stage stage, TableId p3Table = TableId::Table1,
+                      FileId p3MapReadId = FileId::None, const uint64* p3LMapBucketCounts = nullptr );
+
+    // Returns false if the file does not exist. Fails if it exists but is not a valid checkpoint.
+    static bool Load( const char* path, DiskPlotCheckpoint& outCheckpoint );
+
+    static void Delete( const char* path );
+
+    // Fails if the checkpoint was written with settings that the configured run can't resume from
+    void Validate( const DiskPlotConfig& cfg ) const;
+
+    // Sets the context state saved with the checkpoint
+    void Restore( DiskPlotContext& cx ) const;
+
+    // Points the request at the plot being resumed
+    void GetPlotRequest( PlotRequest& req ) const;
+
+    static const char* StageName( Stage stage );
+};
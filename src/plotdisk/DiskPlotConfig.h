@@ -12,6 +12,12 @@
 #define BB_DP_XTRA_ENTRIES_PER_BUCKET   1.1
 #define BB_DP_ENTRY_SLICE_MULTIPLIER    1.025
 
+// Bucket write buffers are sized for the predicted entry count of a bucket instead of a worst case.
+// y is uniformly distributed, so a bucket expected to hold n entries deviates from n by about sqrt(n).
+// Predictions are this many standard deviations above the mean. Writes that still don't fit spill
+// over to a buffer from the IO queue's heap.
+#define BB_DP_ENTRY_PREDICTION_SIGMAS   16
+
 
 #define BB_DP_MAX_BC_GROUP_PER_BUCKET 300000        // There's around 284,190 groups per bucket (of bucket size 64)
 #define BB_DP_MAX_BC_GROUP_PER_K_32   (BB_DP_MAX_BC_GROUP_PER_BUCKET * 64ull)
@@ -30,6 +36,10 @@
 // we can save 1 iteration when sorting it.
 #define BB_DPP3_LP_BUCKET_COUNT 256
 
+// Most LP bucket reads Phase 3 keeps in flight while converting line points to parks.
+// Two always are, any more only if the heap has room for their read buffers.
+#define BB_DPP3_MAX_READS_IN_FLIGHT 4
+
 
 /// 
 /// DEBUG
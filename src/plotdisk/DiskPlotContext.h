@@ -10,21 +10,42 @@
 #include "plotting/PlotWriter.h"
 #include "PlotContext.h"
 
+class IGpuFxOffload;
+
 struct DiskPlotConfig
 {
     const GlobalPlotConfig* globalCfg          = nullptr;
     const char*       tmpPath                  = nullptr;
     const char*       tmpPath2                 = nullptr;
+    std::vector<const char*> tmpStripePaths;            // Further temp1 directories, from repeating -t1. Bucket files are striped across them
+    std::vector<const char*> tmpStripePaths2;           // Further temp2 directories, from repeating -t2
     size_t            expectedTmpDirBlockSize  = 0;
     uint32            numBuckets               = 256;
     uint32            ioThreadCount            = 0;
     uint32            ioBufferCount            = 0;
     size_t            cacheSize                = 0;
+    size_t            residentSize             = 0;
+    size_t            marksSize                = 0;
 
     bool              bounded                  = true;  // Do not overflow entries
     bool              alternateBuckets         = false; // Alternate bucket writing method between interleaved and not
     bool              noTmp1DirectIO           = false; // Disable direct I/O on tmp 1
     bool              noTmp2DirectIO           = false; // Disable direct I/O on tmp 1
+    bool              tmp1PageCache            = false; // Use buffered, page cache-backed I/O with read-ahead on tmp 1 (implies noTmp1DirectIO)
+    bool              tmp2PageCache            = false; // Use buffered, page cache-backed I/O with read-ahead on tmp 2 (implies noTmp2DirectIO)
+    bool              staggerPhase1            = false; // Wait for other plotters sharing temp1 to finish Phase 1 before starting ours
+    bool              reuseTmpFiles            = false; // Keep the temp files, and their extents, across plots instead of deleting and re-creating them
+    bool              tmp2InMemory             = false; // Temp2 given as mem:<size>. Its file sets live in the cache and spill to temp1
+    bool              adaptiveIO               = false; // Tune the I/O queue depth at table boundaries
+    bool              p3Pipeline               = false; // Overlap each Phase 3 table's last plot writes with the next table's first step
+    bool              gpuFx                    = false; // Generate Phase 1 fx on a CUDA device
+    bool              f1XOnly                  = false; // F1 writes only x, table 2 recomputes y from it
+    bool              p2Compact                = false; // Phase 2 rewrites the marked entries of tables 3-6, which Phase 3 reads instead
+    uint32            gpuFxDevice              = 0;
+    const char*       autoTuneProfile          = nullptr; // Tune per-phase thread counts across plots, persisted to this file
+    size_t            tmpWriteBudget           = 0;       // Bytes per plot we'd like to write to the temp disks at most. Favors in-memory temp I/O
+    const char*       ioReportPath             = nullptr; // Append each plot's temp I/O accounting to this file as a json line
+    const char*       checkpointPath           = nullptr; // Save progress to this file at phase and Phase 3 table boundaries, and resume from it
 
     uint32            f1ThreadCount            = 0;
     uint32            fpThreadCount            = 0;
@@ -42,10 +63,13 @@ struct DiskPlotContext
     
     size_t       tmp1BlockSize;
     size_t       tmp2BlockSize;
+    size_t       tmp1OptimalIOSize;         // Preferred transfer size of the tmp devices (stripe width on RAID)
+    size_t       tmp2OptimalIOSize;
 
     ThreadPool*      threadPool;
     DiskBufferQueue* ioQueue;
     PlotWriter*      plotWriter;
+    IGpuFxOffload*   gpuFx;             // Set if Phase 1 fx is generated on a GPU
     PlotRequest      plotRequest;
     FencePool*       fencePool;
 
@@ -55,6 +79,12 @@ struct DiskPlotContext
     size_t       cacheSize;             // Size of memory cache to reserve for IO (region in file that never gets written to disk).
     byte*        cache;
 
+    size_t       residentSize;          // Size of memory in which Phase 1 holds written y and meta buckets until they're read back.
+    byte*        resident;
+
+    size_t       marksSize;             // Size of memory in which Phase 2 holds the marking tables that Phase 3 reads back.
+    byte*        marks;
+
     uint32       numBuckets;            // Divide entries into this many buckets
     
 
@@ -79,6 +109,21 @@ struct DiskPlotContext
     // including the cross-bucket entries.
     uint32       ptrTableBucketCounts[(uint)TableId::_Count][BB_DP_MAX_BUCKET_COUNT];
 
+    // The bounded plotter stores the left back pointers as deltas to the previous
+    // entry's, packed using the smallest bit size that fits the whole bucket.
+    // This holds that bit size for each bucket.
+    uint8        ptrTableBucketLeftBits[(uint)TableId::_Count][BB_DP_MAX_BUCKET_COUNT];
+
+    // With --p2-compact, Phase 2 rewrites the back pointers and map of the tables it marked
+    // with only their marked entries, bucket by bucket, so that Phase 3 reads those instead.
+    // This holds which tables were compacted, and how many entries each of their buckets kept.
+    bool         compactedTables      [(uint)TableId::_Count];
+    uint32       compactedBucketCounts[(uint)TableId::_Count][BB_DP_MAX_BUCKET_COUNT];
+
+    // Marking tables Phase 2 kept in the marks memory instead of writing them to their file,
+    // or null for those that did not fit and were written out.
+    uint64*      residentMarks[(uint)TableId::_Count];
+
     // Pointers to tables in the plot file (byte offset to where it starts in the plot file)
     // Where:
     //  0-6 = Parked tables 1-7
@@ -639,7 +639,8 @@ void Debug::WriteTableCounts( const DiskPlotContext& cx )
 
     if( backPtrBucketCounts.Open( BB_DP_DBG_TEST_DIR BB_DP_DBG_PTR_BUCKET_COUNT_FNAME, FileMode::Create, FileAccess::Write ) )
     {
-        if( backPtrBucketCounts.Write( cx.ptrTableBucketCounts, sizeof( cx.ptrTableBucketCounts ) ) != sizeof( cx.ptrTableBucketCounts ) )
+        if( backPtrBucketCounts.Write( cx.ptrTableBucketCounts, sizeof( cx.ptrTableBucketCounts ) ) != sizeof( cx.ptrTableBucketCounts ) ||
+            backPtrBucketCounts.Write( cx.ptrTableBucketLeftBits, sizeof( cx.ptrTableBucketLeftBits ) ) != sizeof( cx.ptrTableBucketLeftBits ) )
             Log::Error( "Failed to write to back pointer bucket counts file." );
     }
     else
@@ -683,7 +684,8 @@ bool Debug::ReadTableCounts( DiskPlotContext& cx )
 
         if( backPtrBucketCounts.Open( BB_DP_DBG_TEST_DIR BB_DP_DBG_PTR_BUCKET_COUNT_FNAME, FileMode::Open, FileAccess::Read ) )
         {
-            if( backPtrBucketCounts.Read( cx.ptrTableBucketCounts, sizeof( cx.ptrTableBucketCounts ) ) != sizeof( cx.ptrTableBucketCounts ) )
+            if( backPtrBucketCounts.Read( cx.ptrTableBucketCounts, sizeof( cx.ptrTableBucketCounts ) ) != sizeof( cx.ptrTableBucketCounts ) ||
+                backPtrBucketCounts.Read( cx.ptrTableBucketLeftBits, sizeof( cx.ptrTableBucketLeftBits ) ) != sizeof( cx.ptrTableBucketLeftBits ) )
             {
                 Fatal( "Failed to read from pointer bucket counts file." );
             }
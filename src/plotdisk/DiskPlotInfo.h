@@ -45,6 +45,10 @@ struct DiskPlotInfo
     static constexpr int64  MaxBucketSliceEntries  = (int64)bbconst_ceil( CDiv( CDiv( KEntryCount, (int) _numBuckets ), (int)_numBuckets ) * BB_DP_XTRA_ENTRIES_PER_BUCKET );
     static constexpr int64  MaxBucketEntries       = MaxBucketSliceEntries * _numBuckets;   //(int64)bbconst_ceil( ( static_cast<int64>( (1ull << _k) / _numBuckets ) * BB_DP_XTRA_ENTRIES_PER_BUCKET ) );
 
+    // Entries a bucket is expected to generate, including its cross-bucket matches. See BB_DP_ENTRY_PREDICTION_SIGMAS.
+    static constexpr int64  PredictedBucketEntries = KEntryCount / _numBuckets + BB_DP_ENTRY_PREDICTION_SIGMAS * (int64)bbconst_isqrt( KEntryCount / _numBuckets )
+                                                   + BB_DP_CROSS_BUCKET_MAX_ENTRIES;
+
     // Size of data outputted/generated by this table
     static constexpr uint32 MetaMultiplier         = static_cast<uint32>( TableMetaOut<table>::Multiplier );
 
@@ -4,6 +4,9 @@
 #include "plotdisk/DiskPlotInfo.h"
 #include "util/StackAllocator.h"
 #include "DiskPlotInfo.h"
+#include "plotting/PlotBenchmark.h"
+#include "util/PerfCounters.h"
+#include "util/jobs/MemJobs.h"
 
 // #DEBUG
 #include "jobs/IOJob.h"
@@ -22,16 +25,7 @@ DiskPlotPhase2::DiskPlotPhase2( DiskPlotContext& context )
 {
     DiskBufferQueue& ioQueue = *context.ioQueue;
 
-    const FileSetOptions tmp1Opts = context.cfg->noTmp1DirectIO ? FileSetOptions::None : FileSetOptions::DirectIO;
-
-    // #TODO: Give the cache to the marks? Probably not needed for sucha small write...
-    //        Then we would need to re-distribute the cache on Phase 3.
-    // #TODO: We need to specify the temporary file location
-    ioQueue.InitFileSet( FileId::MARKED_ENTRIES_2, "table_2_marks", 1, tmp1Opts, nullptr );
-    ioQueue.InitFileSet( FileId::MARKED_ENTRIES_3, "table_3_marks", 1, tmp1Opts, nullptr );
-    ioQueue.InitFileSet( FileId::MARKED_ENTRIES_4, "table_4_marks", 1, tmp1Opts, nullptr );
-    ioQueue.InitFileSet( FileId::MARKED_ENTRIES_5, "table_5_marks", 1, tmp1Opts, nullptr );
-    ioQueue.InitFileSet( FileId::MARKED_ENTRIES_6, "table_6_marks", 1, tmp1Opts, nullptr );
+    InitMarkFiles( context );
 
     ioQueue.SeekFile( FileId::T1, 0, 0, SeekOrigin::Begin );
     ioQueue.SeekFile( FileId::T2, 0, 0, SeekOrigin::Begin );
@@ -54,6 +48,32 @@ DiskPlotPhase2::DiskPlotPhase2( DiskPlotContext& context )
 //-----------------------------------------------------------
 DiskPlotPhase2::~DiskPlotPhase2() {}
 
+//-----------------------------------------------------------
+void DiskPlotPhase2::InitMarkFiles( DiskPlotContext& context )
+{
+    DiskBufferQueue& ioQueue = *context.ioQueue;
+
+    const FileSetOptions tmp1Opts = !context.cfg->noTmp1DirectIO ? FileSetOptions::DirectIO  :
+                                     context.cfg->tmp1PageCache  ? FileSetOptions::PageCache : FileSetOptions::None;
+
+    // #TODO: Give the cache to the marks? Probably not needed for sucha small write...
+    //        Then we would need to re-distribute the cache on Phase 3.
+    // #TODO: We need to specify the temporary file location
+    ioQueue.InitFileSet( FileId::MARKED_ENTRIES_2, "table_2_marks", 1, tmp1Opts, nullptr );
+    ioQueue.InitFileSet( FileId::MARKED_ENTRIES_3, "table_3_marks", 1, tmp1Opts, nullptr );
+    ioQueue.InitFileSet( FileId::MARKED_ENTRIES_4, "table_4_marks", 1, tmp1Opts, nullptr );
+    ioQueue.InitFileSet( FileId::MARKED_ENTRIES_5, "table_5_marks", 1, tmp1Opts, nullptr );
+    ioQueue.InitFileSet( FileId::MARKED_ENTRIES_6, "table_6_marks", 1, tmp1Opts, nullptr );
+
+    if( context.cfg->p2Compact )
+    {
+        ioQueue.InitFileSet( FileId::COMPACTED_3, "table_3_compacted", 1, tmp1Opts, nullptr );
+        ioQueue.InitFileSet( FileId::COMPACTED_4, "table_4_compacted", 1, tmp1Opts, nullptr );
+        ioQueue.InitFileSet( FileId::COMPACTED_5, "table_5_compacted", 1, tmp1Opts, nullptr );
+        ioQueue.InitFileSet( FileId::COMPACTED_6, "table_6_compacted", 1, tmp1Opts, nullptr );
+    }
+}
+
 //-----------------------------------------------------------
 void DiskPlotPhase2::Run()
 {
@@ -132,9 +152,18 @@ void DiskPlotPhase2::RunWithBuckets()
 
     const TableId endTable = _context.cfg->globalCfg->compressionLevel > 0 ? TableId::Table3 : TableId::Table2;
 
+    // Tables read here, other than table 7, can be compacted once their marks are complete
+    for( TableId table = endTable+1; table < TableId::Table7; table++ )
+        context.compactedTables[(int)table] = context.cfg->p2Compact;
+
+    // Marking tables are kept in the marks memory while they fit, and written to their file otherwise
+    memset( context.residentMarks, 0, sizeof( context.residentMarks ) );
+    size_t marksUsed = 0;
+
     for( TableId table = TableId::Table7; table > endTable; table = table-1 )
     {
         readFence.Reset( 0 );
+        context.ioQueue->SetIOAccountingStage( 2, table );
 
         const auto timer = TimerBegin();
         
@@ -391,8 +420,23 @@ void DiskPlotPhase2::RunWithBuckets()
         if( table < TableId::Table7 )
             bitFieldFence.Wait( _ioTableWaitTime );
 
-        // Submit l marking table for writing
-        queue.WriteFile( lTableFileId, 0, lMarkingTable, _markingTableSize );
+        // Submit l marking table for writing. Phase 3 doesn't read the marks of compacted tables.
+        if( !context.compactedTables[(int)table-1] )
+        {
+            const size_t marksSize = CDivT( context.entryCounts[(int)table-1], (uint64)64 ) * sizeof( uint64 );
+
+            if( marksSize <= context.marksSize - marksUsed )
+            {
+                uint64* residentMarks = (uint64*)( context.marks + marksUsed );
+                MemCpyMT::Copy( residentMarks, lMarkingTable, marksSize, *context.threadPool, context.p2ThreadCount );
+
+                context.residentMarks[(int)table-1] = residentMarks;
+                marksUsed += marksSize;
+            }
+            else
+                queue.WriteFile( lTableFileId, 0, lMarkingTable, _markingTableSize );
+        }
+
         queue.SignalFence( bitFieldFence );
         queue.CommitCommands();
 
@@ -405,6 +449,11 @@ void DiskPlotPhase2::RunWithBuckets()
         Log::Line( "Table %d I/O wait time: %.2lf seconds.", table, TicksToSeconds( _ioTableWaitTime ) );
         p2WaitTime += _ioTableWaitTime;
 
+        context.p2TableWaitTime[(int)table] = _ioTableWaitTime;
+        PlotBenchmark::RecordTable( 2, table, elapsed, TicksToSeconds( _ioTableWaitTime ) );
+        PerfCounters::RecordTable( 2, table, elapsed );
+        context.ioQueue->AdaptIO( 2 );
+
         allocator.PopToMarker( stackMarker );
         ASSERT( allocator.Size() == stackMarker );
 
@@ -517,10 +566,99 @@ void DiskPlotPhase2::MarkTableBuckets( DiskPairAndMapReader<_numBuckets, _bounde
 
         });
 
+        // The marks of our table are complete, so this bucket can be compacted while it's loaded
+        if constexpr ( rTable < TableId::Table7 )
+        {
+            if( _context.compactedTables[(int)rTable] )
+                CompactTableBucket<_numBuckets>( rTable, bucket, pairs, map, rTableMarks );
+        }
+
         lTableOffset += _context.bucketCounts[(int)rTable-1][bucket];
     }
 }
 
+/// Writes the marked entries of an R table bucket to the table's compacted file
+//-----------------------------------------------------------
+template<uint32 _numBuckets>
+void DiskPlotPhase2::CompactTableBucket( const TableId rTable, const uint32 bucket, const Pair* pairs, const uint64* map, const BitField rTableMarks )
+{
+    using Reader = DiskCompactedPairAndMapReader<_numBuckets>;
+
+    DiskBufferQueue& ioQueue = *_context.ioQueue;
+
+    const FileId fileId     = TableIdToCompactedFileId( rTable );
+    const size_t blockSize  = ioQueue.BlockSize( fileId );
+    const int64  entryCount = (int64)_context.ptrTableBucketCounts[(int)rTable][bucket];
+
+    int64   markedCounts[BB_DP_MAX_JOBS];
+    int64   markedTotal = 0;
+    uint64* buffer      = nullptr;
+
+    AnonMTJob::Run( *_context.threadPool, _context.p2ThreadCount, [&]( AnonMTJob* self ) {
+
+        int64 count, offset, end;
+        GetThreadOffsets( self, entryCount, count, offset, end );
+
+        int64 markedCount = 0;
+        for( int64 i = offset; i < end; i++ )
+        {
+            if( rTableMarks.Get( map[i] ) )
+                markedCount++;
+        }
+
+        markedCounts[self->JobId()] = markedCount;
+
+        if( self->IsControlThread() )
+        {
+            self->LockThreads();
+
+            for( uint32 i = 0; i < self->JobCount(); i++ )
+                markedTotal += markedCounts[i];
+
+            _context.compactedBucketCounts[(int)rTable][bucket] = (uint32)markedTotal;
+
+            buffer = (uint64*)ioQueue.GetBuffer( std::max( Reader::BucketSize( (uint64)markedTotal, blockSize ), blockSize ), blockSize, true );
+
+            self->ReleaseThreads();
+        }
+        else
+            self->WaitForRelease();
+
+        int64 dstOffset = 0;
+        for( uint32 i = 0; i < self->JobId(); i++ )
+            dstOffset += markedCounts[i];
+
+        BitWriter writer( buffer, (uint64)markedTotal * Reader::EntryBits, (uint64)dstOffset * Reader::EntryBits );
+
+        // Pack a couple of entries first, so that no two threads write to the same field at the same time
+        int64 i = offset;
+        for( int64 packed = 0; i < end && packed < 2; i++ )
+        {
+            if( rTableMarks.Get( map[i] ) )
+            {
+                Reader::WriteEntry( writer, pairs[i], map[i] );
+                packed++;
+            }
+        }
+
+        self->SyncThreads();
+
+        for( ; i < end; i++ )
+        {
+            if( rTableMarks.Get( map[i] ) )
+                Reader::WriteEntry( writer, pairs[i], map[i] );
+        }
+    });
+
+    const size_t writeSize = Reader::BucketSize( (uint64)markedTotal, blockSize );
+
+    if( writeSize > 0 )
+        ioQueue.WriteFile( fileId, 0, buffer, writeSize );
+
+    ioQueue.ReleaseBuffer( buffer );
+    ioQueue.CommitCommands();
+}
+
 //-----------------------------------------------------------
 template<TableId table>
 inline void MarkTableEntries( int64 i, const int64 entryCount, BitField lTable, const BitField rTable,
@@ -12,6 +12,9 @@ public:
 
     void Run();
 
+    // Opens the marked entries files, which Phase 3 reads
+    static void InitMarkFiles( DiskPlotContext& context );
+
 private:
     template<uint32 _numBuckets, bool _bounded>
     void RunWithBuckets();
@@ -22,6 +25,9 @@ private:
     template<TableId table, uint32 _numBuckets, bool _bounded>
     void    MarkTableBuckets( DiskPairAndMapReader<_numBuckets, _bounded> reader, Pair* pairs, uint64* map, BitField lTableMarks, const BitField rTableMarks );
 
+    template<uint32 _numBuckets>
+    void    CompactTableBucket( TableId rTable, uint32 bucket, const Pair* pairs, const uint64* map, const BitField rTableMarks );
+
 private:
     DiskPlotContext& _context;
     Fence*           _bucketReadFence;
@@ -1,5 +1,7 @@
 #include "DiskPlotPhase3.h"
+#include "DiskPlotCheckpoint.h"
 #include "util/BitField.h"
+#include "util/BitUnpack.h"
 #include "plotdisk/BitBucketWriter.h"
 #include "plotdisk/MapWriter.h"
 #include "plotmem/LPGen.h"
@@ -7,6 +9,8 @@
 #include "plotting/TableWriter.h"
 #include "plotmem/ParkWriter.h"
 #include "plotting/Compression.h"
+#include "plotting/PlotBenchmark.h"
+#include "util/PerfCounters.h"
 
 #if _DEBUG
     #include "DiskPlotDebug.h"
@@ -136,6 +140,7 @@ public:
     static constexpr uint32 _entrySizeBits = _lpBits + _idxBits; // LP, origin index
 
     using PMReader = DiskPairAndMapReader<_numBuckets, _bounded>;
+    using CPReader = DiskCompactedPairAndMapReader<_numBuckets>;
     using L1Reader = SingleFileMapReader<_numBuckets, P3_EXTRA_L_ENTRIES_TO_LOAD, uint32>;
     using LNReader = DiskMapReader<uint32, _numBuckets, _k>;
 
@@ -152,10 +157,11 @@ public:
     {}
 
     //-----------------------------------------------------------
-    P3StepOne( DiskPlotContext& context, const FileId mapReadId, Fence& readFence, Fence& writeFence )
+    P3StepOne( DiskPlotContext& context, const size_t heapSize, const FileId mapReadId, Fence& readFence, Fence& writeFence )
         : _context    ( context )
         , _ioQueue    ( *context.ioQueue )
         , _threadCount( context.p3ThreadCount )
+        , _heapSize   ( heapSize )
         , _mapReadId  ( mapReadId  )
         , _readFence  ( readFence  )
         , _writeFence ( writeFence )
@@ -165,15 +171,18 @@ public:
 
         _isCompressedTable        = context.cfg->globalCfg->compressionLevel > 0 && rTable-1 <= (TableId)context.cfg->globalCfg->numDroppedTables;
         _lpBitsSavedByCompression = _isCompressedTable ? 63 - ( ( _context.cfg->globalCfg->compressedEntryBits * 2 - 1) * 2 - 1 ) : 0;
+        _isCompactedTable         = context.compactedTables[(int)rTable];
     }
 
     //-----------------------------------------------------------
     inline Duration GetIOWaitTime() const { return _ioWaitTime; }
 
+    // A compacted R table is read instead of the full table and its marks
     //-----------------------------------------------------------
-    void Allocate( const bool dryRun, IAllocator& allocator, const size_t tmp1BlockSize, const size_t tmp2BlockSize, const uint64* inLMapBucketCounts,
+    void Allocate( const bool dryRun, const bool compacted, IAllocator& allocator, const size_t tmp1BlockSize, const size_t tmp2BlockSize, const uint64* inLMapBucketCounts,
         void*&                  rMarks,
         PMReader&               rTableReader,
+        CPReader&               rCompactedReader,
         IP3LMapReader<uint32>*& lReader,
         L1Reader&               lTable1Reader,
         LNReader&               lTableNReader,
@@ -184,14 +193,24 @@ public:
     {
         const TableId lTable           = rTable - 1;
         const uint64  maxBucketEntries = (uint64)( ( (1ull << _k) / _numBuckets ) * P3_BUCKET_MULTIPLER );
-        const size_t  rMarksSize       =  RoundUpToNextBoundary( maxBucketEntries * _numBuckets  / 8, (int)tmp1BlockSize );
+        const size_t  rMarksSize       =  RoundUpToNextBoundaryT( (size_t)maxBucketEntries * _numBuckets / 8, tmp1BlockSize );
         //RoundUpToNextBoundary( _context.entryCounts[(int)rTable] / 8, (int)context.tmp1BlockSize );
 
         const bool isCompressedTable2 = dryRun ? false : _isCompressedTable;
 
-        rMarks       = allocator.Alloc( rMarksSize, tmp1BlockSize );
-        rTableReader = dryRun ? PMReader( allocator, tmp1BlockSize )
-                              : PMReader( _context, _threadCount, _readFence, rTable, allocator, false );
+        rMarks = nullptr;
+
+        if( compacted )
+        {
+            rCompactedReader = dryRun ? CPReader( allocator, tmp1BlockSize, maxBucketEntries )
+                                      : CPReader( _context, _threadCount, _readFence, rTable, allocator, maxBucketEntries );
+        }
+        else
+        {
+            rMarks       = allocator.Alloc( rMarksSize, tmp1BlockSize );
+            rTableReader = dryRun ? PMReader( allocator, tmp1BlockSize )
+                                  : PMReader( _context, _threadCount, _readFence, rTable, allocator, false );
+        }
 
         lReader        = nullptr;
         lTableNEntries = nullptr;
@@ -246,13 +265,14 @@ public:
         #endif
 
         const TableId lTable     = rTable - 1;
-        const size_t  rMarksSize = RoundUpToNextBoundary( context.entryCounts[(int)rTable] / 8, (int)context.tmp1BlockSize );
+        const size_t  rMarksSize = RoundUpToNextBoundaryT( (size_t)context.entryCounts[(int)rTable] / 8, context.tmp1BlockSize );
 
         // Allocate buffers
-        StackAllocator allocator( context.heapBuffer, context.heapSize );
+        StackAllocator allocator( context.heapBuffer, _heapSize );
 
         void*                  rMarks;
         PMReader               rTableReader;
+        CPReader               rCompactedReader;
         IP3LMapReader<uint32>* lReader;
         L1Reader               lTable1Reader;
         LNReader               lTableNReader;
@@ -260,9 +280,10 @@ public:
         Pair*                  pairs;
         uint64*                map;
 
-        Allocate( false, allocator, context.tmp1BlockSize, context.tmp2BlockSize, inLMapBucketCounts,
+        Allocate( false, _isCompactedTable, allocator, context.tmp1BlockSize, context.tmp2BlockSize, inLMapBucketCounts,
             rMarks,
             rTableReader,
+            rCompactedReader,
             lReader,
             lTable1Reader,
             lTableNReader,
@@ -292,13 +313,21 @@ public:
             else
                 lTableNReader.LoadNextEntries( GetLLoadCount( bucket ) );
 
-            rTableReader.LoadNextBucket();
+            if( _isCompactedTable )
+                rCompactedReader.LoadNextBucket();
+            else
+                rTableReader.LoadNextBucket();
         };
 
 
-        // Load initial bucket and the whole marking table
-        if( rTable < TableId::Table7 )
-            ioQueue.ReadFile( FileId::MARKED_ENTRIES_2 + (FileId)rTable - 1, 0, rMarks, rMarksSize );
+        // Load initial bucket and the whole marking table, unless Phase 2 kept it in memory
+        if( rTable < TableId::Table7 && !_isCompactedTable )
+        {
+            if( context.residentMarks[(int)rTable] )
+                rMarks = context.residentMarks[(int)rTable];
+            else
+                ioQueue.ReadFile( FileId::MARKED_ENTRIES_2 + (FileId)rTable - 1, 0, rMarks, rMarksSize );
+        }
 
         LoadBucket( 0 );
 
@@ -311,7 +340,8 @@ public:
                 LoadBucket( bucket + 1 );
 
             // Wait for and unpack our current bucket
-            const uint64 bucketLength = rTableReader.UnpackBucket( bucket, pairs, map, _ioWaitTime );   // This will wait on the read fence
+            const uint64 bucketLength = _isCompactedTable ? rCompactedReader.UnpackBucket( bucket, pairs, map, _ioWaitTime )
+                                                          : rTableReader    .UnpackBucket( bucket, pairs, map, _ioWaitTime );   // This will wait on the read fence
 
             uint32* lEntries;
 
@@ -358,6 +388,7 @@ public:
     {
         void*                  rMarks;
         PMReader               rTableReader;
+        CPReader               rCompactedReader;
         IP3LMapReader<uint32>* lReader;
         L1Reader               lTable1Reader;
         LNReader               lTableNReader;
@@ -365,20 +396,28 @@ public:
         Pair*                  pairs;
         uint64*                map;
 
-        DummyAllocator allocator;
-        
-        P3StepOne<rTable, _numBuckets, _bounded> instance;
-        instance.Allocate( true, allocator, tmp1BlockSize, tmp2BlockSize, nullptr,
-            rMarks,
-            rTableReader,
-            lReader,
-            lTable1Reader,
-            lTableNReader,
-            lTableNEntries,
-            pairs,
-            map );
+        size_t requiredSize = 0;
 
-        return allocator.Size();
+        for( const bool compacted : { false, true } )
+        {
+            DummyAllocator allocator;
+            
+            P3StepOne<rTable, _numBuckets, _bounded> instance;
+            instance.Allocate( true, compacted, allocator, tmp1BlockSize, tmp2BlockSize, nullptr,
+                rMarks,
+                rTableReader,
+                rCompactedReader,
+                lReader,
+                lTable1Reader,
+                lTableNReader,
+                lTableNEntries,
+                pairs,
+                map );
+
+            requiredSize = std::max( requiredSize, allocator.Size() );
+        }
+
+        return requiredSize;
     }
 
 private:
@@ -405,11 +444,14 @@ private:
             const uint64*  rMap          = rightMap;
             const BitField markedEntries = rightMarkedEntries;
 
+            // Compacted tables only hold marked entries
+            const bool isPruned = rTable == TableId::Table7 || _isCompactedTable;
+
             // First, scan our entries in order to prune them
             int64  prunedLength     = 0;
             int64* allPrunedLengths = (int64*)_prunedEntryCount;
 
-            if constexpr ( rTable < TableId::Table7 )
+            if( !isPruned )
             {
                 for( int64 i = offset; i < end; i++ )
                 {
@@ -450,11 +492,8 @@ private:
             {
                 const uint64 mapIdx = rMap[i];
 
-                if constexpr ( rTable < TableId::Table7 )
-                {
-                    if( !markedEntries.Get( mapIdx ) )
-                        continue;
-                }
+                if( !isPruned && !markedEntries.Get( mapIdx ) )
+                    continue;
 
             #if _DEBUG
                 secondPassPruneCount ++;
@@ -475,30 +514,9 @@ private:
             ASSERT( (uintptr_t)outLinePoints == (uintptr_t)outPairsStart);
             {
                 const uint32* lTable = lMap;
-                
-                for( int64 i = 0; i < prunedLength; i++ )
-                {
-                    Pair p = outPairsStart[i];
 
-                    const uint64 x = lTable[p.left ];
-                    const uint64 y = lTable[p.right];
-
-                    ASSERT( x || y );
-                    outLinePoints[i] = SquareToLinePoint( x, y );
-// #if _DEBUG
-//         if( x == y )
-//         {
-//             std::atomic<uint64>& sameLP = *const_cast<std::atomic<uint64>*>( numSameLP );
-//             sameLP++;
-//         }
-//         else
-//         {
-//             const BackPtr deconverted = LinePointToSquare64( outLinePoints[i] ) ;
-//             ASSERT( ( deconverted.x == x && deconverted.y == y ) || 
-//                     ( deconverted.y == x && deconverted.y == x ) );
-//         }
-// #endif
-                }
+                // Converted in-place
+                PairsToLinePoints( outPairsStart, lTable, outLinePoints, (uint64)prunedLength );
             }
         });
 
@@ -664,6 +682,7 @@ private:
     DiskPlotContext& _context;
     DiskBufferQueue& _ioQueue;
     uint32           _threadCount;
+    size_t           _heapSize   = 0;
     FileId           _mapReadId;
     Fence&           _readFence;
     Fence&           _writeFence;
@@ -679,6 +698,7 @@ private:
     uint64           _prunedEntryCount         = 0;
     uint32           _lpBitsSavedByCompression = 0;
     bool             _isCompressedTable        = false;
+    bool             _isCompactedTable         = false;   // Only the R table's marked entries are read
 };
 
 template<TableId rTable, uint32 _numBuckets>
@@ -701,7 +721,6 @@ public:
     P3StepTwo()
         : _context     ( *(DiskPlotContext*)nullptr )
         , _ioQueue     ( *(DiskBufferQueue*)nullptr )
-        , _readFence   ( *(Fence*)nullptr )
         , _writeFence  ( *(Fence*)nullptr )
         , _lpWriteFence( *(Fence*)nullptr )
         , _readId      ( (FileId)0 )
@@ -709,17 +728,21 @@ public:
     {}
 
     //-----------------------------------------------------------
-    P3StepTwo( DiskPlotContext& context, Fence& readFence, Fence& writeFence, Fence& lpWriteFence, const FileId readId, const FileId writeId )
+    // If parkFence is given, the park buffers are allocated past heapSize and the final parks are
+    // not waited on. parkFence is signalled with 1 once they have been written.
+    //-----------------------------------------------------------
+    P3StepTwo( DiskPlotContext& context, const size_t heapSize, Fence& writeFence, Fence& lpWriteFence, Fence* parkFence,
+               const FileId readId, const FileId writeId )
         : _context     ( context )
         , _ioQueue     ( *context.ioQueue )
         , _threadCount ( context.p3ThreadCount )
-        , _readFence   ( readFence  )
+        , _heapSize    ( heapSize )
         , _writeFence  ( writeFence )
         , _lpWriteFence( lpWriteFence )
+        , _parkFence   ( parkFence )
         , _readId      ( readId  )
         , _writeId     ( writeId )
     {
-        _readFence   .Reset();
         _writeFence  .Reset();
         _lpWriteFence.Reset();
 
@@ -736,30 +759,45 @@ public:
     {
         DummyAllocator allocator;
         S2MapWriter    mapWriter;
-        byte*          readBuffers[2];
+        byte*          readBuffers[BB_DPP3_MAX_READS_IN_FLIGHT];
+        uint32         readDepth;
         uint64*        linePoints;
         uint64*        tmpLinePoints;
         uint64*        indices;
         uint64*        tmpIndices;
 
         P3StepTwo<rTable, _numBuckets> instance;
-        instance.Allocate( true, allocator, tmp1BlockSize, tmp2BlockSize,
-                           mapWriter, readBuffers, linePoints, tmpLinePoints, indices, tmpIndices );
+        instance.Allocate( true, allocator, allocator, tmp1BlockSize, tmp2BlockSize,
+                           mapWriter, readBuffers, readDepth, linePoints, tmpLinePoints, indices, tmpIndices );
 
         return allocator.Size();
     }
 
+    // Size of the park buffers alone, which are placed at the end of the heap when pipelining tables
     //-----------------------------------------------------------
-    inline void Allocate( bool dryRun, IAllocator& allocator, const size_t tmp1BlockSize, const size_t tmp2BlockSize, 
-                          S2MapWriter& outMapWriter, byte* readBuffers[2], uint64*& linePoints, uint64*& tmpLinePoints, uint64*& indices, uint64*& tmpIndices )
+    inline static size_t GetRequiredParkHeapSize( const size_t parkSize )
+    {
+        DummyAllocator allocator;
+
+        P3StepTwo<rTable, _numBuckets> instance;
+        instance.AllocateParks( allocator, parkSize );
+
+        return allocator.Size();
+    }
+
+    //-----------------------------------------------------------
+    inline void Allocate( bool dryRun, IAllocator& allocator, IAllocator& parkAllocator, const size_t tmp1BlockSize, const size_t tmp2BlockSize, 
+                          S2MapWriter& outMapWriter, byte* readBuffers[BB_DPP3_MAX_READS_IN_FLIGHT], uint32& readDepth,
+                          uint64*& linePoints, uint64*& tmpLinePoints, uint64*& indices, uint64*& tmpIndices )
     {
         const TableId lTable           = rTable - 1;
         const uint64  maxBucketEntries = (uint64)( ( (1ull << _k) / _numBuckets ) * P3_BUCKET_MULTIPLER );
 
-        const size_t readBufferSize = RoundUpToNextBoundary( CDiv( maxBucketEntries * _entrySizeBits, 8 ), (int)tmp2BlockSize );
+        const size_t readBufferSize = GetReadBufferSize( tmp2BlockSize );
 
         readBuffers[0] = allocator.AllocT<byte>( readBufferSize, tmp2BlockSize );
-        readBuffers[1] = allocator.AllocT<byte>( readBufferSize, tmp2BlockSize ),
+        readBuffers[1] = allocator.AllocT<byte>( readBufferSize, tmp2BlockSize );
+        readDepth      = 2;
 
         linePoints    = allocator.CAlloc<uint64>( maxBucketEntries + kEntriesPerPark ); // Need to add kEntriesPerPark so we can copy
         tmpLinePoints = allocator.CAlloc<uint64>( maxBucketEntries + kEntriesPerPark ); //  the park overflows from the previous bucket.
@@ -771,10 +809,25 @@ public:
         else
             outMapWriter = S2MapWriter( _ioQueue, _writeId, allocator, maxBucketEntries, tmp2BlockSize, _writeFence, _ioWaitTime );
 
-        const size_t parkSize = CalculateParkSize( lTable );
+        _lpLeftOverBuffer = allocator.CAlloc<uint64>( kEntriesPerPark );
+
+        AllocateParks( parkAllocator, CalculateParkSize( lTable ) );
+    }
+
+    //-----------------------------------------------------------
+    inline static size_t GetReadBufferSize( const size_t tmp2BlockSize )
+    {
+        const uint64 maxBucketEntries = (uint64)( ( (1ull << _k) / _numBuckets ) * P3_BUCKET_MULTIPLER );
+
+        return RoundUpToNextBoundary( CDiv( maxBucketEntries * _entrySizeBits, 8 ), (int)tmp2BlockSize );
+    }
+
+    //-----------------------------------------------------------
+    inline void AllocateParks( IAllocator& allocator, const size_t parkSize )
+    {
+        const uint64 maxBucketEntries = (uint64)( ( (1ull << _k) / _numBuckets ) * P3_BUCKET_MULTIPLER );
 
         _maxParkCount     = maxBucketEntries / kEntriesPerPark;
-        _lpLeftOverBuffer = allocator.CAlloc<uint64>( kEntriesPerPark );
         _parkBuffers[0]   = allocator.AllocT<byte>( parkSize * _maxParkCount );
         _parkBuffers[1]   = allocator.AllocT<byte>( parkSize * _maxParkCount );
         _finalPark        = allocator.AllocT<byte>( parkSize );
@@ -788,63 +841,103 @@ public:
         _ioQueue.SeekBucket( FileId::LP, 0, SeekOrigin::Begin );
         _ioQueue.CommitCommands();
 
-        // const TableId lTable           = rTable - 1;
-        const uint64  maxBucketEntries = (uint64)( ( (1ull << _k) / _numBuckets ) * P3_BUCKET_MULTIPLER );
-
         // Allocate buffers and needed structures
         S2MapWriter mapWriter;
-        byte*       readBuffers[2];
+        byte*       readBuffers[BB_DPP3_MAX_READS_IN_FLIGHT];
+        uint32      readDepth;
         uint64*     linePoints;
         uint64*     tmpLinePoints;
         uint64*     indices;
         uint64*     tmpIndices;
         
-        StackAllocator allocator( _context.heapBuffer, _context.heapSize );
-        Allocate( false, allocator, _context.tmp1BlockSize, _context.tmp2BlockSize, 
-                  mapWriter, readBuffers, linePoints, tmpLinePoints, indices, tmpIndices );
-        
-        Log::Line( "Step 2 using %.2lf / %.2lf GiB.", (double)allocator.Size() BtoGB, (double)allocator.Capacity() BtoGB );
+        StackAllocator allocator    ( _context.heapBuffer, _heapSize );
+        StackAllocator parkAllocator( _context.heapBuffer + _heapSize, _context.heapSize - _heapSize );
+
+        Allocate( false, allocator, _parkFence ? (IAllocator&)parkAllocator : (IAllocator&)allocator,
+                  _context.tmp1BlockSize, _context.tmp2BlockSize,
+                  mapWriter, readBuffers, readDepth, linePoints, tmpLinePoints, indices, tmpIndices );
+
+        // Only double-buffering the reads is required, but read further ahead if the heap has room for it
+        const size_t readBufferSize = GetReadBufferSize( _context.tmp2BlockSize );
 
+        while( readDepth < BB_DPP3_MAX_READS_IN_FLIGHT && allocator.Capacity() - allocator.Size() >= readBufferSize + _context.tmp2BlockSize )
+            readBuffers[readDepth++] = allocator.AllocT<byte>( readBufferSize, _context.tmp2BlockSize );
 
-        // Start processing buckets
-        auto LoadBucket = [=]( uint32 bucket ) {
-            const size_t readSize = RoundUpToNextBoundary( CDiv( inLPBucketCounts[bucket] * _entrySizeBits, 8 ), (int)_context.tmp2BlockSize );
+        Log::Line( "Step 2 using %.2lf / %.2lf GiB, with %u bucket reads in flight.",
+                   (double)allocator.Size() BtoGB, (double)allocator.Capacity() BtoGB, readDepth );
+
+        AsyncExecutor executor;
+        Task<>        task = ConvertBuckets( executor, inLPBucketCounts, outLMapBucketCounts, mapWriter, readBuffers, readDepth,
+                                             linePoints, tmpLinePoints, indices, tmpIndices );
+        executor.Run( task, _ioWaitTime );
+
+        _context.plotWriter->EndTable();   
+    }
+
+private:
+
+    // Converts the line points of each bucket to parks, and writes the reverse map.
+    // Bucket reads are issued as soon as a read buffer is unpacked, so that
+    // up to readDepth of them are in flight while we sort and write the current one.
+    //-----------------------------------------------------------
+    Task<> ConvertBuckets( AsyncExecutor& executor, const uint64* inLPBucketCounts, uint64* outLMapBucketCounts,
+                           S2MapWriter& mapWriter, byte** readBuffers, const uint32 readDepth,
+                           uint64* linePoints, uint64* tmpLinePoints, uint64* indices, uint64* tmpIndices )
+    {
+        // Buckets are processed up to the first empty one
+        const uint32 endBucket = rTable == TableId::Table7 ? _numBuckets : _numBuckets-1;
+
+        uint32 bucketCount = 0;
+        while( bucketCount <= endBucket && inLPBucketCounts[bucketCount] > 0 )
+            bucketCount++;
+
+        AsyncSignal readSignals[BB_DPP3_MAX_READS_IN_FLIGHT];
+        uint32      nextLoad = 0;
+
+        // Issue reads for every bucket up to readDepth past the first one whose buffer is still in use
+        auto LoadBuckets = [&]( const uint32 firstBusyBucket ) {
+
+            const uint32 loadEnd = std::min( firstBusyBucket + readDepth, bucketCount );
+
+            for( ; nextLoad < loadEnd; nextLoad++ )
+            {
+                const size_t readSize = RoundUpToNextBoundary( CDiv( inLPBucketCounts[nextLoad] * _entrySizeBits, 8 ), (int)_context.tmp2BlockSize );
+
+                AsyncSignal& signal = readSignals[nextLoad % readDepth];
+                signal.Reset( executor );
+
+                _ioQueue.ReadFile( FileId::LP, nextLoad, readBuffers[nextLoad % readDepth], readSize );
+                _ioQueue.SignalAsync( signal );
+            }
 
-            _ioQueue.ReadFile( FileId::LP, bucket, readBuffers[bucket & 1], readSize );
-            _ioQueue.SignalFence( _readFence, bucket + 1 );
             _ioQueue.CommitCommands();
         };
 
-        LoadBucket( 0 );
+        LoadBuckets( 0 );
 
         uint64 mapOffset = 0;
 
-        const uint32 endBucket = rTable == TableId::Table7 ? _numBuckets : _numBuckets-1;
-        for( uint32 bucket = 0; bucket <= endBucket; bucket++ )
+        for( uint32 bucket = 0; bucket < bucketCount; bucket++ )
         {
-            const bool isLastBucket     = bucket == endBucket;
-            const bool nextBucketEmpty  = !isLastBucket && inLPBucketCounts[bucket+1] == 0;
-            const bool hasNextBucket    = !isLastBucket && !nextBucketEmpty;
-
-            const int64 entryCount = (int64)inLPBucketCounts[bucket]; 
-            if( entryCount < 1 )
-                break;
+            const bool  hasNextBucket = bucket + 1 < bucketCount;
+            const int64 entryCount    = (int64)inLPBucketCounts[bucket]; 
 
             ASSERT( (uint64)entryCount <= maxBucketEntries );
 
-            if( hasNextBucket )
-                LoadBucket( bucket + 1 );
-
-            _readFence.Wait( bucket + 1, _ioWaitTime );
+            AsyncSignal& readSignal = readSignals[bucket % readDepth];
+            co_await readSignal;
 
 
             uint64* unpackedLinePoints    = linePoints    + kEntriesPerPark;
             uint64* unpackedTmpLinePoints = tmpLinePoints + kEntriesPerPark;
 
             // Unpack bucket
-            const byte* packedEntries = readBuffers[bucket & 1];
+            const byte* packedEntries = readBuffers[bucket % readDepth];
             UnpackEntries( bucket, entryCount, packedEntries, unpackedLinePoints, indices );
 
+            // Its read buffer is free now
+            LoadBuckets( bucket + 1 );
+
             // Sort on LP
             EntrySort::SortEntries<_numBuckets, _lpBits>( *_context.threadPool, _threadCount, entryCount, unpackedLinePoints, unpackedTmpLinePoints, indices, tmpIndices );
 
@@ -906,16 +999,17 @@ public:
 
         mapWriter.SubmitFinalBits();
         
-        // Wait for all writes to finish
-        _ioQueue.SignalFence( _lpWriteFence, _numBuckets + 5 );
+        // Wait for all map writes to finish. The plot writer may still be signalling
+        // _lpWriteFence if we are pipelining, so wait on the I/O queue itself.
+        AsyncSignal mapWritesSignal;
+        mapWritesSignal.Reset( executor );
+
+        _ioQueue.SignalAsync( mapWritesSignal );
         _ioQueue.CommitCommands();
-        _lpWriteFence.Wait( _numBuckets + 5 );
 
-        _context.plotWriter->EndTable();   
+        co_await mapWritesSignal;
     }
 
-private:
-
     //-----------------------------------------------------------
     void UnpackEntries( const uint32 bucket, const int64 entryCount, const byte* packedEntries, uint64* outLinePoints, uint64* outIndices )
     {
@@ -925,23 +1019,15 @@ private:
             int64 count, offset, end;
             GetThreadOffsets( self, entryCount, count, offset, end );
 
-            BitReader reader( (uint64*)packedEntries, _entrySizeBits * (uint64)entryCount, (uint64)offset * _entrySizeBits );
-
-            uint64* linePoints = outLinePoints;
-            uint64* indices    = outIndices;
-            ASSERT( indices + entryCount )
-
             const uint64 bucketMask = ((uint64)bucket) << (_lpBits - _lpBitsSavedByCompression);
-            for( int64 i = offset; i < end; i++ )
-            {
-                const uint64 lp  = reader.ReadBits64( _lpBits  ) | bucketMask;
-                const uint64 idx = reader.ReadBits64( _idxBits );
 
-                ASSERT( idx < (1ull << _K) + ((1ull << _K) / _numBuckets) );
+            UnpackBitPairs( (const uint64*)packedEntries, (uint64)offset * _entrySizeBits, (uint64)count,
+                            _lpBits, _idxBits, bucketMask, outLinePoints + offset, outIndices + offset );
 
-                linePoints[i] = lp;
-                indices   [i] = idx;
-            }
+            #if _DEBUG
+                for( int64 i = offset; i < end; i++ )
+                    ASSERT( outIndices[i] < (1ull << _K) + ((1ull << _K) / _numBuckets) );
+            #endif
         });
     }
 
@@ -977,7 +1063,11 @@ private:
         size_t            _parkSize    = 0;
         uint32            _stubBitSize = 0;
         const FSE_CTable* _cTable      = nullptr;
-        GetParkSerializationData( _parkSize, _stubBitSize, _cTable );
+        double            _rValue      = 0;
+        GetParkSerializationData( _parkSize, _stubBitSize, _cTable, _rValue );
+
+        const ParkDeltaCoding _deltaCoding = _context.cfg->globalCfg->parkDeltaCoding;
+        const RANSEncTable*   _ransTable   = _deltaCoding == ParkDeltaCoding::RANS ? CreateRANSEncTable( _rValue ) : nullptr;
 
         /// Encode into parks
         byte* parkBuffer = GetLPWriteBuffer( bucket );
@@ -999,6 +1089,8 @@ private:
             const auto  parkSize    = _parkSize;
             const auto  stubBitSize = _stubBitSize;
             const auto* cTable      = _cTable;
+            const auto  deltaCoding = _deltaCoding;
+            const auto* ransTable   = _ransTable;
 
             uint64 count, offset, end;
             GetThreadOffsets( self, parkCount, count, offset, end );
@@ -1009,7 +1101,7 @@ private:
             for( uint64 i = 0; i < count; i++ )
             {
                 // #NOTE: This functions mutates inLinePoints
-                WritePark( parkSize, kEntriesPerPark, (uint64*)parkLinePoints, parkWriteBuffer, stubBitSize, cTable );
+                WritePark( parkSize, kEntriesPerPark, (uint64*)parkLinePoints, parkWriteBuffer, stubBitSize, cTable, deltaCoding, ransTable );
                 parkLinePoints  += kEntriesPerPark;
                 parkWriteBuffer += parkSize;
             }
@@ -1032,7 +1124,8 @@ private:
             if( overflowEntries )
             {
                 // #NOTE: This functions mutates inLinePoints
-                WritePark( _parkSize, overflowEntries, lpOverflowStart, _finalPark, _stubBitSize, _cTable );
+                WritePark( _parkSize, overflowEntries, lpOverflowStart, _finalPark, _stubBitSize, _cTable,
+                           _deltaCoding, _ransTable );
 
                 _context.plotTableSizes[(int)lTable] += _parkSize;
                 // ioQueue.WriteFile( FileId::PLOT, 0, _finalPark, _parkSize );
@@ -1040,6 +1133,13 @@ private:
                 ioQueue.CommitCommands();
             }
 
+            // Let the next table's first step start while our last parks are written
+            if( _parkFence )
+            {
+                _context.plotWriter->SignalFence( *_parkFence, 1 );
+                return;
+            }
+
             _context.plotWriter->SignalFence( _lpWriteFence, 0x1FFFFFFF );
             _lpWriteFence.Wait( 0x1FFFFFFF );
             return;
@@ -1056,7 +1156,7 @@ private:
     }
 
     //-----------------------------------------------------------
-    void GetParkSerializationData( size_t& outParkSize, uint32& outStubBitSize, const FSE_CTable*& outCtable ) const
+    void GetParkSerializationData( size_t& outParkSize, uint32& outStubBitSize, const FSE_CTable*& outCtable, double& outRValue ) const
     {
         // Calculate the park size dynamically based on table 1's park and delta size, but with modified stub sizes
         if( _isCompressedTable )
@@ -1067,6 +1167,7 @@ private:
             outParkSize    = info.tableParkSize;
             outStubBitSize = info.stubSizeBits;
             outCtable      = _context.cfg->globalCfg->ctable;
+            outRValue      = info.ansRValue;
         }
         else
         {
@@ -1075,6 +1176,7 @@ private:
             outStubBitSize = _k - kStubMinusBits;
             outParkSize    = CalculateParkSize( lTable );
             outCtable      = CTables[(int)lTable];
+            outRValue      = kRValues[(int)lTable];
         }
     }
 
@@ -1082,9 +1184,10 @@ private:
     DiskPlotContext& _context;
     DiskBufferQueue& _ioQueue;
     uint32           _threadCount;
-    Fence&           _readFence;
+    size_t           _heapSize   = 0;
     Fence&           _writeFence;
     Fence&           _lpWriteFence;
+    Fence*           _parkFence  = nullptr;
     Duration         _ioWaitTime = Duration::zero();
     FileId           _readId;
     FileId           _writeId;
@@ -1099,10 +1202,13 @@ private:
 
 
 //-----------------------------------------------------------                        
-DiskPlotPhase3::DiskPlotPhase3( DiskPlotContext& context )
+DiskPlotPhase3::DiskPlotPhase3( DiskPlotContext& context, const DiskPlotCheckpoint* resumeFrom )
     : _context( context )
     , _ioQueue( *context.ioQueue )
-{}
+    , _resume ( resumeFrom )
+{
+    ASSERT( !resumeFrom || resumeFrom->stage == DiskPlotCheckpoint::Stage::Phase3Table );
+}
 
 //-----------------------------------------------------------
 DiskPlotPhase3::~DiskPlotPhase3() {}
@@ -1132,6 +1238,13 @@ void DiskPlotPhase3::Run()
     ioQueue.SeekFile( FileId::MARKED_ENTRIES_4, 0, 0, SeekOrigin::Begin );
     ioQueue.SeekFile( FileId::MARKED_ENTRIES_5, 0, 0, SeekOrigin::Begin );
     ioQueue.SeekFile( FileId::MARKED_ENTRIES_6, 0, 0, SeekOrigin::Begin );
+
+    for( TableId table = TableId::Table3; table < TableId::Table7; table++ )
+    {
+        if( _context.compactedTables[(int)table] )
+            ioQueue.SeekFile( TableIdToCompactedFileId( table ), 0, 0, SeekOrigin::Begin );
+    }
+
     ioQueue.CommitCommands();
 
     // Use up any cache for our line points and map
@@ -1147,6 +1260,8 @@ void DiskPlotPhase3::Run()
 
     if( !_context.cfg->noTmp2DirectIO )
         opts |= FileSetOptions::DirectIO;
+    else if( _context.cfg->tmp2PageCache )
+        opts |= FileSetOptions::PageCache;
 
     if( _context.cache )
         opts |= FileSetOptions::Cachable;
@@ -1276,6 +1391,38 @@ void DiskPlotPhase3::RunBuckets()
         #endif
     }
 
+    if( _resume )
+    {
+        // Continue with the table after the checkpointed one. The files of the tables already compressed
+        // have been opened again (or re-created, if they had been deleted), so delete them as ProcessTable does.
+        const TableId firstTable = startTable;
+        startTable = _resume->p3Table + 1;
+
+        _mapReadId  = _resume->p3MapReadId;
+        _mapWriteId = _mapReadId == FileId::LP_MAP_0 ? FileId::LP_MAP_1 : FileId::LP_MAP_0;
+        memcpy( _lMapPrunedBucketCounts, _resume->p3LMapBucketCounts, sizeof( uint64 ) * (_numBuckets+1) );
+
+        #if !BB_DP_DBG_P3_KEEP_FILES
+            for( TableId rTable = firstTable; rTable < startTable; rTable++ )
+            {
+                if( rTable == TableId::Table2 )
+                    _ioQueue.DeleteFile( FileId::T1, 0 );
+
+                _ioQueue.DeleteFile( FileId::T1 + (FileId)rTable, 0 );
+                _ioQueue.DeleteBucket( FileId::MAP2 + (FileId)rTable-1 );
+
+                if( rTable < TableId::Table7 )
+                    _ioQueue.DeleteFile( FileId::MARKED_ENTRIES_2 + (FileId)rTable-1, 0 );
+
+                if( _context.compactedTables[(int)rTable] )
+                    _ioQueue.DeleteFile( TableIdToCompactedFileId( rTable ), 0 );
+            }
+            _ioQueue.CommitCommands();
+        #endif
+
+        Log::Line( "Resuming Phase 3 at table %u.", (uint)startTable+1 );
+    }
+
 #if _DEBUG && defined( BB_DP_DBG_P3_SKIP_TO_TABLE )
     startTable = BB_DP_DBG_P3_START_TABLE;
 
@@ -1288,11 +1435,21 @@ void DiskPlotPhase3::RunBuckets()
     _context.plotTablePointers[(int)startTable-1] = _ioQueue.PlotTablePointersAddress();
 #endif
 
+    if( _context.cfg->p3Pipeline )
+    {
+        if( _context.cfg->bounded )
+            InitPipeline<_numBuckets, true>();
+        else
+            InitPipeline<_numBuckets, false>();
+    }
+
     for( TableId rTable = startTable; rTable <= TableId::Table7; rTable++ )
     {
         Log::Line( "Compressing tables %u and %u.", rTable, rTable+1 );
         const auto timer = TimerBegin();
 
+        _context.ioQueue->SetIOAccountingStage( 3, rTable );
+
         if( _context.cfg->bounded )
         {
             switch( rTable )
@@ -1327,6 +1484,10 @@ void DiskPlotPhase3::RunBuckets()
         const double elapsed = TimerEnd( timer );
         Log::Line( "Finished compressing tables %u and %u in %.2lf seconds.", rTable, rTable+1, elapsed );
 
+        _context.p3TableWaitTime[(int)rTable] = _ioWaitTime;
+        PlotBenchmark::RecordTable( 3, rTable, elapsed, TicksToSeconds( _ioWaitTime ) );
+        PerfCounters::RecordTable( 3, rTable, elapsed );
+
         std::swap( _mapReadId, _mapWriteId );
 
         _ioQueue.SeekBucket( _mapReadId , 0, SeekOrigin::Begin );
@@ -1335,6 +1496,14 @@ void DiskPlotPhase3::RunBuckets()
 
         // Set the table offset for the next table
         _context.plotTablePointers[(int)rTable] = _context.plotTablePointers[(int)rTable-1] + _context.plotTableSizes[(int)rTable-1];
+
+        // With a cache, part of the map we just wrote is only in memory, so it can't be resumed from
+        if( _context.cfg->checkpointPath && !_context.cache )
+        {
+            // The table's last parks must be in the plot file
+            WaitForParkWrites();
+            DiskPlotCheckpoint::Save( _context, DiskPlotCheckpoint::Stage::Phase3Table, rTable, _mapReadId, _lMapPrunedBucketCounts );
+        }
     }
 
     // Finish up with table 7 which needs to be sorted on f7. We use its map for that
@@ -1342,6 +1511,7 @@ void DiskPlotPhase3::RunBuckets()
         Log::Line( "Writing P7 parks." );
         const auto timer = TimerBegin();
         WritePark7<_numBuckets>( _lMapPrunedBucketCounts );
+        WaitForParkWrites();
         const double elapsed = TimerEnd( timer );
         Log::Line( "Finished writing P7 parks in %.2lf seconds.", elapsed );
         Log::Line( "P7 I/O wait time: %.2lf seconds", TicksToSeconds( _ioWaitTime ) );
@@ -1350,6 +1520,49 @@ void DiskPlotPhase3::RunBuckets()
     }
 }
 
+//-----------------------------------------------------------
+template<uint32 _numBuckets, bool _bounded>
+void DiskPlotPhase3::InitPipeline()
+{
+    // Step 2 writes a table's final parks to the plot asynchronously, so that the next table's step 1
+    // runs while they are written. Their buffers are moved to the end of the heap, out of step 1's way.
+    size_t maxParkSize = 0;
+    for( TableId table = TableId::Table1; table <= TableId::Table6; table++ )
+        maxParkSize = std::max( maxParkSize, CalculateParkSize( table ) );
+
+    if( _context.cfg->globalCfg->compressionLevel > 0 )
+        maxParkSize = std::max( maxParkSize, GetCompressionInfoForLevel( _context.cfg->globalCfg->compressionLevel ).tableParkSize );
+
+    const size_t parkHeapSize = RoundUpToNextBoundaryT( P3StepTwo<TableId::Table2, _numBuckets>::GetRequiredParkHeapSize( maxParkSize ), (size_t)4096 );
+
+    const size_t t1BlockSize = _context.tmp1BlockSize;
+    const size_t t2BlockSize = _context.tmp2BlockSize;
+
+    const size_t s1Size = std::max( P3StepOne<TableId::Table2, _numBuckets, _bounded>::GetRequiredHeapSize( t1BlockSize, t2BlockSize ),
+                                    P3StepOne<TableId::Table3, _numBuckets, _bounded>::GetRequiredHeapSize( t1BlockSize, t2BlockSize ) );
+    const size_t s2Size = P3StepTwo<TableId::Table2, _numBuckets>::GetRequiredHeapSize( t1BlockSize, t2BlockSize );
+
+    if( std::max( s1Size, s2Size ) + parkHeapSize > _context.heapSize )
+    {
+        Log::Line( "Warning: Not enough heap for the Phase 3 pipeline ( %.2lf MiB needed ). Tables will be compressed in sequence.",
+                   (double)parkHeapSize BtoMB );
+        return;
+    }
+
+    _parkHeapSize = parkHeapSize;
+}
+
+//-----------------------------------------------------------
+void DiskPlotPhase3::WaitForParkWrites()
+{
+    if( !_parkWritesPending )
+        return;
+
+    _parkFence.Wait( 1, _ioWaitTime );
+    _parkFence.Reset();
+    _parkWritesPending = false;
+}
+
 //-----------------------------------------------------------
 template<TableId rTable, uint32 _numBuckets, bool _bounded>
 void DiskPlotPhase3::ProcessTable()
@@ -1362,7 +1575,7 @@ void DiskPlotPhase3::ProcessTable()
     {
         memset( _lpPrunedBucketCounts, 0, sizeof( uint64 ) * (_numBuckets+1) );
 
-        P3StepOne<rTable, _numBuckets, _bounded> stepOne( _context, _mapReadId, _readFence, _writeFence );
+        P3StepOne<rTable, _numBuckets, _bounded> stepOne( _context, _context.heapSize - _parkHeapSize, _mapReadId, _readFence, _writeFence );
         prunedEntryCount = stepOne.Run( _lMapPrunedBucketCounts, _lpPrunedBucketCounts );
 
         _ioWaitTime = stepOne.GetIOWaitTime();
@@ -1380,6 +1593,9 @@ void DiskPlotPhase3::ProcessTable()
 
         if( rTable < TableId::Table7 )
             _ioQueue.DeleteFile( FileId::MARKED_ENTRIES_2 + (FileId)rTable-1, 0 );
+
+        if( _context.compactedTables[(int)rTable] )
+            _ioQueue.DeleteFile( TableIdToCompactedFileId( rTable ), 0 );
     #endif
 
     _ioQueue.CommitCommands();
@@ -1396,10 +1612,17 @@ void DiskPlotPhase3::ProcessTable()
     {
         memset( _lMapPrunedBucketCounts, 0, sizeof( uint64 ) * (_numBuckets+1) );
 
-        P3StepTwo<rTable, _numBuckets> stepTwo( _context, _readFence, _writeFence, _plotFence, _mapReadId, _mapWriteId );
+        // The previous table's last parks must be written before we reuse their buffers
+        WaitForParkWrites();
+
+        const bool pipelined = _parkHeapSize > 0;
+
+        P3StepTwo<rTable, _numBuckets> stepTwo( _context, _context.heapSize - _parkHeapSize, _writeFence, _plotFence,
+                                                pipelined ? &_parkFence : nullptr, _mapReadId, _mapWriteId );
         stepTwo.Run( _lpPrunedBucketCounts, _lMapPrunedBucketCounts );
 
         _ioWaitTime += stepTwo.GetIOWaitTime();
+        _parkWritesPending = pipelined;
     }
 
     Log::Line( "Table %u now has %llu / %llu ( %.2lf%% ) entries.", 
@@ -1407,6 +1630,7 @@ void DiskPlotPhase3::ProcessTable()
         prunedEntryCount / (double)_context.entryCounts[(int)rTable] * 100 );
 
     Log::Line( "Table %u I/O wait time: %.2lf seconds.", rTable, TicksToSeconds( _ioWaitTime ) );
+    _context.ioQueue->AdaptIO( 3 );
 
 #if _DEBUG
     SavePrunedBucketCount( rTable, _lMapPrunedBucketCounts, false );
@@ -1436,9 +1660,29 @@ void DiskPlotPhase3::WritePark7( const uint64 inMapBucketCounts[_numBuckets+1] )
     // #TODO: We don't need these alignments anymore
     // const size_t plotBlockSize    = ioQueue.BlockSize( FileId::PLOT );
     const size_t plotBlockSize    = _context.plotWriter->BlockSize();
+
+    // Table 6's last parks may still be being written from the end of the heap (see InitPipeline).
+    // The plot writer queues P7 behind them anyway, so encode it in the rest of the heap meanwhile, if it fits.
+    size_t heapSize = context.heapSize;
+
+    if( _parkWritesPending )
+    {
+        DummyAllocator dryRun;
+        DiskMapReader<uint64, _numBuckets, _K+1> dryRunReader( dryRun, ioQueue.BlockSize( _mapReadId ) );
+        dryRun.CAlloc<uint64>( maxBucketEntries + kEntriesPerPark );
+        dryRun.AllocT<byte>( parkSize * maxParkCount, plotBlockSize );
+        dryRun.AllocT<byte>( parkSize * maxParkCount, plotBlockSize );
+        dryRun.AllocT<byte>( parkSize );
+
+        if( dryRun.Size() <= context.heapSize - _parkHeapSize )
+            heapSize -= _parkHeapSize;
+        else
+            WaitForParkWrites();
+    }
+
     _context.plotWriter->BeginTable( PlotTable::Table7 );
 
-    StackAllocator allocator( context.heapBuffer, context.heapSize );
+    StackAllocator allocator( context.heapBuffer, heapSize );
 
     DiskMapReader<uint64, _numBuckets, _K+1> mapReader( context, context.p3ThreadCount, TableId::Table7, _mapReadId, allocator, inMapBucketCounts );
 
@@ -1680,11 +1924,7 @@ void UnpackPark7( const byte* srcBits, uint64* dstEntries )
 
     const uint32 bitsPerEntry = _k + 1;
     CPBitReader reader( (byte*)srcBits, CalculatePark7Size( _k ) * 8, 0  );
-
-    for( int32 i = 0; i < kEntriesPerPark; i++ )
-    {
-        dstEntries[i] = reader.Read64( bitsPerEntry );
-    }
+    reader.ReadN( bitsPerEntry, kEntriesPerPark, dstEntries );
 
     // BitReader reader( srcBits, CalculatePark7Size( _k ) * bitsPerEntry, 0  );
     
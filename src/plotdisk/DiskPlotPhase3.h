@@ -4,10 +4,13 @@
 #include "plotdisk/BitBucketWriter.h"
 #include "plotdisk/DiskPairReader.h"
 
+struct DiskPlotCheckpoint;
+
 class DiskPlotPhase3
 {
 public:
-    DiskPlotPhase3( DiskPlotContext& context );
+    // If resumeFrom is given, continues after the last table recorded by that Phase 3 checkpoint
+    DiskPlotPhase3( DiskPlotContext& context, const DiskPlotCheckpoint* resumeFrom = nullptr );
     ~DiskPlotPhase3();
 
     void Run();
@@ -21,6 +24,11 @@ private:
     template<TableId rTable, uint32 _numBuckets, bool _bounded>
     void ProcessTable();
 
+    template<uint32 _numBuckets, bool _bounded>
+    void InitPipeline();
+
+    void WaitForParkWrites();
+
     template<TableId rTable>
     void ConvertToLinePoints( 
         const uint32 bucket, const int64 bucketLength, const uint32* leftEntries, 
@@ -73,11 +81,16 @@ private:
 private:
     DiskPlotContext& _context;
     DiskBufferQueue& _ioQueue;
+    const DiskPlotCheckpoint* _resume;
 
     Fence _readFence;
     Fence _writeFence;
     Fence _stepFence;
     Fence _plotFence;
+    Fence _parkFence;                   // Signalled by the plot writer once a table's last parks are written
+
+    size_t _parkHeapSize      = 0;      // Heap reserved for step 2's park buffers when pipelining tables, 0 otherwise
+    bool   _parkWritesPending = false;
 
     Duration _ioWaitTime  = Duration::zero();
     
@@ -0,0 +1,145 @@
+#include "DiskPlotTuner.h"
+#include "DiskPlotContext.h"
+#include "util/Log.h"
+
+static constexpr double MIN_GAIN      = 0.02;   // Phase time improvement required to keep a lower thread count
+static constexpr double IO_BOUND_WAIT = 0.10;   // I/O wait fraction above which a phase is considered I/O-bound
+static constexpr uint32 MIN_THREADS   = 2;
+
+static const char* PHASE_NAMES[DiskPlotTuner::PhaseCount] = { "fp", "p2", "p3" };
+
+//-----------------------------------------------------------
+DiskPlotTuner::DiskPlotTuner( const char* profilePath, const uint32 maxThreads[PhaseCount], const bool tuned[PhaseCount] )
+    : _profilePath( profilePath )
+{
+    for( uint32 i = 0; i < PhaseCount; i++ )
+    {
+        _maxThreads[i]      = maxThreads[i];
+        _phases[i].threads  = maxThreads[i];
+        _phases[i].tuned    = tuned[i];
+        _phases[i].settled  = !tuned[i];
+    }
+
+    if( Load() )
+        Log::Line( "Loaded thread profile from %s.", _profilePath );
+}
+
+//-----------------------------------------------------------
+void DiskPlotTuner::Apply( DiskPlotContext& cx ) const
+{
+    cx.fpThreadCount = _phases[FP].threads;
+    cx.p2ThreadCount = _phases[P2].threads;
+    cx.p3ThreadCount = _phases[P3].threads;
+}
+
+//-----------------------------------------------------------
+void DiskPlotTuner::Record( const Phase phase, const double elapsedSeconds, const double ioWaitSeconds )
+{
+    ASSERT( phase < PhaseCount );
+    _phases[phase].elapsed = elapsedSeconds;
+    _phases[phase].ioWait  = ioWaitSeconds;
+}
+
+//-----------------------------------------------------------
+void DiskPlotTuner::Update()
+{
+    for( uint32 i = 0; i < PhaseCount; i++ )
+    {
+        PhaseState& ps = _phases[i];
+
+        if( ps.settled || ps.elapsed <= 0 )
+            continue;
+
+        const uint32 threads = ps.threads;
+        const bool   ioBound = ps.ioWait / ps.elapsed > IO_BOUND_WAIT;
+
+        if( ps.bestThreads == 0 || ps.elapsed < ps.bestTime * ( 1.0 - MIN_GAIN ) )
+        {
+            ps.bestThreads = threads;
+            ps.bestTime    = ps.elapsed;
+        }
+        else if( threads == ps.bestThreads )
+        {
+            // Plots differ slightly in time, so keep the baseline current
+            ps.bestTime = ps.elapsed;
+        }
+        else
+            ps.settled = true;  // Fewer threads did not help
+
+        // The compute threads are mostly idle when waiting on I/O, so try freeing up some cores
+        const uint32 nextThreads = std::max( ps.bestThreads * 3 / 4, MIN_THREADS );
+
+        if( !ps.settled && ioBound && nextThreads < ps.bestThreads )
+            ps.threads = nextThreads;
+        else
+        {
+            ps.threads = ps.bestThreads;
+            ps.settled = true;
+        }
+
+        Log::Line( "Auto-tune %s: %.2lf seconds, %.1lf%% I/O wait with %u threads. Next plot uses %u threads%s.",
+            PHASE_NAMES[i], ps.elapsed, ps.ioWait / ps.elapsed * 100.0, threads, ps.threads, ps.settled ? " (settled)" : "" );
+
+        ps.elapsed = 0;
+        ps.ioWait  = 0;
+    }
+
+    Save();
+}
+
+//-----------------------------------------------------------
+bool DiskPlotTuner::Load()
+{
+    FILE* file = fopen( _profilePath, "r" );
+    if( !file )
+        return false;
+
+    bool loaded = false;
+
+    char   name[8];
+    uint32 threads, bestThreads, settled;
+    double bestTime;
+
+    while( fscanf( file, "%7s %u %u %lf %u", name, &threads, &bestThreads, &bestTime, &settled ) == 5 )
+    {
+        for( uint32 i = 0; i < PhaseCount; i++ )
+        {
+            PhaseState& ps = _phases[i];
+
+            // Phases given explicitly on the command line, or profiles made for a larger thread count, don't apply
+            if( strcmp( name, PHASE_NAMES[i] ) != 0 || !ps.tuned ||
+                threads == 0 || threads > _maxThreads[i] || bestThreads > _maxThreads[i] )
+                continue;
+
+            ps.threads     = threads;
+            ps.bestThreads = bestThreads;
+            ps.bestTime    = bestTime;
+            ps.settled     = settled != 0;
+            loaded         = true;
+        }
+    }
+
+    fclose( file );
+    return loaded;
+}
+
+//-----------------------------------------------------------
+void DiskPlotTuner::Save() const
+{
+    FILE* file = fopen( _profilePath, "w" );
+    if( !file )
+    {
+        Log::Line( "Warning: Failed to write thread profile to %s.", _profilePath );
+        return;
+    }
+
+    // <phase> <next thread count> <best thread count> <best phase time> <settled>
+    for( uint32 i = 0; i < PhaseCount; i++ )
+    {
+        const PhaseState& ps = _phases[i];
+        if( ps.tuned )
+            fprintf( file, "%s %u %u %.3lf %u\n", PHASE_NAMES[i], ps.threads, ps.bestThreads, ps.bestTime, ps.settled ? 1u : 0u );
+    }
+
+    fclose( file );
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+struct DiskPlotContext;
+
+/**
+ * Picks the forward propagation, Phase 2 and Phase 3 thread counts across plots (--auto-tune <file>).
+ * After each plot, the plotter records how long each phase took and how much of it was spent waiting on I/O.
+ * A phase that was I/O-bound tries fewer threads on the next plot: the count keeps dropping while the
+ * phase gets faster, and reverts to the best one seen otherwise. Phases that are CPU-bound keep all threads.
+ * The counts are saved to a profile file after every plot, so later runs on the same machine start from them.
+ */
+class DiskPlotTuner
+{
+public:
+    enum Phase : uint32
+    {
+        FP = 0,     // Phase 1 forward propagation (tables 2-7)
+        P2,
+        P3,
+        PhaseCount
+    };
+
+    // maxThreads holds the configured thread count of each phase, which is never exceeded.
+    // Phases with tuned[phase] == false (given explicitly on the command line) are left alone.
+    DiskPlotTuner( const char* profilePath, const uint32 maxThreads[PhaseCount], const bool tuned[PhaseCount] );
+
+    // Set the tuned thread counts to use for the next plot
+    void Apply( DiskPlotContext& cx ) const;
+
+    // Called after a plot completed, with the phase's duration and the portion of it spent waiting on I/O
+    void Record( Phase phase, double elapsedSeconds, double ioWaitSeconds );
+
+    // Pick the next thread counts and persist them to the profile file
+    void Update();
+
+private:
+    bool Load();
+    void Save() const;
+
+private:
+    struct PhaseState
+    {
+        uint32 threads     = 0;     // Thread count for the next plot
+        uint32 bestThreads = 0;     // 0 until the phase has a sample
+        double bestTime    = 0;
+        double elapsed     = 0;     // Last recorded sample
+        double ioWait      = 0;
+        bool   tuned       = true;
+        bool   settled     = false;
+    };
+
+    const char* _profilePath;
+    uint32      _maxThreads[PhaseCount];
+    PhaseState  _phases[PhaseCount];
+};
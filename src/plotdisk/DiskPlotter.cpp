@@ -2,12 +2,17 @@
 #include "util/Log.h"
 #include "util/Util.h"
 #include "util/CliParser.h"
-#include "util/jobs/MemJobs.h"
+#include "util/PageWarmer.h"
 #include "io/FileStream.h"
+#include "plotting/MemoryPlanner.h"
+#include "plotting/PlotBenchmark.h"
+#include "util/PerfCounters.h"
+#include "plotting/PlotTools.h"
 
 #include "DiskFp.h"
 #include "DiskPlotPhase2.h"
 #include "DiskPlotPhase3.h"
+#include "GpuFxOffload.h"
 #include "SysHost.h"
 
 #include "k32/DiskPlotBounded.h"
@@ -15,6 +20,16 @@
 
 size_t ValidateTmpPathAndGetBlockSize( DiskPlotter::Config& cfg );
 
+// Cache size above which Phase 1's high-frequency I/O is completely in memory, in fully interleaved mode
+static constexpr size_t BB_DP_INTERLEAVED_CACHE_SIZE = 192ull GB;
+
+// Memory left to the OS when sizing the cache for --tmp-write-budget
+static constexpr size_t BB_DP_WRITE_BUDGET_RESERVED_MEMORY = 4ull GB;
+
+// Size of a k32 marking table, and of the marks memory that holds all of those Phase 2 writes (tables 2 to 6)
+static constexpr size_t BB_DP_MARKING_TABLE_SIZE = ( 1ull << 32 ) / 8;
+static constexpr size_t BB_DP_MARKS_MEMORY_SIZE  = BB_DP_MARKING_TABLE_SIZE * 5;
+
 
 //-----------------------------------------------------------
 DiskPlotter::DiskPlotter() {}
@@ -34,11 +49,32 @@ void DiskPlotter::Init()
     
     auto& gCfg = *cfg.globalCfg;
 
-    FatalIf( !GetTmpPathsBlockSizes( cfg.tmpPath, cfg.tmpPath2, _cx.tmp1BlockSize, _cx.tmp2BlockSize ),
+    FatalIf( !FileStream::GetIOSizesForPath( cfg.tmpPath , _cx.tmp1BlockSize, _cx.tmp1OptimalIOSize ) ||
+             !FileStream::GetIOSizesForPath( cfg.tmpPath2, _cx.tmp2BlockSize, _cx.tmp2OptimalIOSize ),
         "Failed to obtain temp paths block size from t1: '%s' or t2: '%s'.", cfg.tmpPath, cfg.tmpPath2 );
 
+    // Bucket slices are aligned to their temp's block size, whichever directory holds them
+    auto checkStripeBlockSize = []( const std::vector<const char*>& paths, const size_t blockSize ) {
+        for( const char* path : paths )
+        {
+            size_t stripeBlockSize = 0, stripeOptimalIOSize = 0;
+            FatalIf( !FileStream::GetIOSizesForPath( path, stripeBlockSize, stripeOptimalIOSize ),
+                "Failed to obtain temp path block size from '%s'.", path );
+            FatalIf( stripeBlockSize != blockSize,
+                "Temp path '%s' has a block size of %llu, but the temp paths striped with it have %llu.",
+                path, (llu)stripeBlockSize, (llu)blockSize );
+        }
+    };
+    checkStripeBlockSize( cfg.tmpStripePaths , _cx.tmp1BlockSize );
+    checkStripeBlockSize( cfg.tmpStripePaths2, _cx.tmp2BlockSize );
+
     FatalIf( _cx.tmp1BlockSize < 8 || _cx.tmp2BlockSize < 8,"File system block size is too small.." );
 
+    // Bucket slices, map buffers and mark bitfields are all padded to the block size
+    FatalIf( !IsPowerOf2( _cx.tmp1BlockSize ) || !IsPowerOf2( _cx.tmp2BlockSize ),
+        "Unsupported temp path block size (t1: %llu, t2: %llu). Block sizes must be a power of 2.",
+        (llu)_cx.tmp1BlockSize, (llu)_cx.tmp2BlockSize );
+
     const uint  sysLogicalCoreCount = SysHost::GetLogicalCPUCount();
     const auto* numa                = SysHost::GetNUMAInfo();
 
@@ -60,10 +96,61 @@ void DiskPlotter::Init()
     _cx.numBuckets          = cfg.numBuckets;
     _cx.heapSize            = heapSize;
     _cx.cacheSize           = cfg.cacheSize;
+    _cx.residentSize        = cfg.residentSize;
+    _cx.marksSize           = cfg.marksSize;
+
+    // The heap is sized for the configured thread counts above, which the tuner never exceeds
+    if( cfg.autoTuneProfile )
+    {
+        const uint32 maxThreads[DiskPlotTuner::PhaseCount] = { _cx.fpThreadCount, _cx.p2ThreadCount, _cx.p3ThreadCount };
+        const bool   tuned     [DiskPlotTuner::PhaseCount] = { cfg.fpThreadCount == 0, cfg.p2ThreadCount == 0, cfg.p3ThreadCount == 0 };
+
+        _tuner = new DiskPlotTuner( cfg.autoTuneProfile, maxThreads, tuned );
+        _tuner->Apply( _cx );
+    }
+
+    if( cfg.checkpointPath )
+    {
+        _resume = new DiskPlotCheckpoint();
+
+        if( DiskPlotCheckpoint::Load( cfg.checkpointPath, *_resume ) )
+            _resume->Validate( cfg );
+        else
+        {
+            delete _resume;
+            _resume = nullptr;
+        }
+    }
+
+    // Tag our temp files so that multiple plotter instances can share the same temp directories
+    #if _DEBUG && ( BB_DP_DBG_READ_EXISTING_F1 || BB_DP_DBG_SKIP_PHASE_1 || BB_DP_P1_SKIP_TO_TABLE || BB_DP_DBG_SKIP_TO_C_TABLES )
+        _tmpFilePrefix[0] = 0;  // Debug runs re-open the files from previous runs
+    #else
+    if( _resume )
+        memcpy( _tmpFilePrefix, _resume->tmpFilePrefix, sizeof( _tmpFilePrefix ) );    // Pick up the interrupted plot's files
+    else
+    {
+        uint32 tag = 0;
+        SysHost::Random( (byte*)&tag, sizeof( tag ) );
+        snprintf( _tmpFilePrefix, sizeof( _tmpFilePrefix ), "bb%08x_", tag );
+    }
+    #endif
+
+    if( cfg.gpuFx )
+    {
+        const uint32 maxBucketEntries = (uint32)( ( 1ull << _K ) / cfg.numBuckets * BB_DP_XTRA_ENTRIES_PER_BUCKET );
+
+        _cx.gpuFx = CudaFxOffloadFactory::Create( cfg.gpuFxDevice, maxBucketEntries );
+
+        if( !_cx.gpuFx )
+            Log::Line( "Warning: Could not use CUDA device %u for fx generation. It will run on the CPU.", cfg.gpuFxDevice );
+    }
 
     Log::Line( "[Bladebit Disk Plotter]" );
     Log::Line( " Heap size      : %.2lf GiB ( %.2lf MiB )", (double)_cx.heapSize BtoGB, (double)_cx.heapSize BtoMB );
     Log::Line( " Cache size     : %.2lf GiB ( %.2lf MiB )", (double)_cx.cacheSize BtoGB, (double)_cx.cacheSize BtoMB );
+    Log::Line( " Resident size  : %.2lf GiB ( %.2lf MiB )", (double)_cx.residentSize BtoGB, (double)_cx.residentSize BtoMB );
+    Log::Line( " Marks size     : %.2lf GiB ( %.2lf MiB )", (double)_cx.marksSize BtoGB, (double)_cx.marksSize BtoMB );
     Log::Line( " Bucket count   : %u"       , _cx.numBuckets    );
     Log::Line( " Alternating I/O: %s"       , cfg.alternateBuckets ? "true" : "false" );
     Log::Line( " F1  threads    : %u"       , _cx.f1ThreadCount );
@@ -72,17 +159,59 @@ void DiskPlotter::Init()
     Log::Line( " P2  threads    : %u"       , _cx.p2ThreadCount );
     Log::Line( " P3  threads    : %u"       , _cx.p3ThreadCount );
     Log::Line( " I/O threads    : %u"       , _cx.ioThreadCount );
-    Log::Line( " Temp1 block sz : %u"       , _cx.tmp1BlockSize );
-    Log::Line( " Temp2 block sz : %u"       , _cx.tmp2BlockSize );
+    Log::Line( " Temp1 block sz : %llu (optimal I/O %llu)", (llu)_cx.tmp1BlockSize, (llu)_cx.tmp1OptimalIOSize );
+    Log::Line( " Temp2 block sz : %llu (optimal I/O %llu)", (llu)_cx.tmp2BlockSize, (llu)_cx.tmp2OptimalIOSize );
     Log::Line( " Temp1 path     : %s"       , _cx.tmpPath       );
-    Log::Line( " Temp2 path     : %s"       , _cx.tmpPath2      );
+    for( const char* path : cfg.tmpStripePaths )
+        Log::Line( "                  %s"       , path              );
+    if( cfg.tmp2InMemory )
+        Log::Line( " Temp2 path     : memory, spills to temp1" );
+    else
+    {
+        Log::Line( " Temp2 path     : %s"       , _cx.tmpPath2      );
+        if( _cx.tmpPath2 != _cx.tmpPath )
+        {
+            for( const char* path : cfg.tmpStripePaths2 )
+                Log::Line( "                  %s"   , path              );
+        }
+    }
+    Log::Line( " Temp1 I/O      : %s"       , cfg.tmp1PageCache ? "page cache" : cfg.noTmp1DirectIO ? "buffered" : "direct" );
+    Log::Line( " Temp2 I/O      : %s"       , cfg.tmp2PageCache ? "page cache" : cfg.noTmp2DirectIO ? "buffered" : "direct" );
+    Log::Line( " Temp file tag  : %s"       , _tmpFilePrefix[0] ? _tmpFilePrefix : "none" );
+    Log::Line( " Stagger P1     : %s"       , cfg.staggerPhase1 ? "true" : "false" );
+    Log::Line( " Reuse temp     : %s"       , cfg.reuseTmpFiles ? "true" : "false" );
+    Log::Line( " Adaptive I/O   : %s"       , cfg.adaptiveIO ? "true" : "false" );
+    Log::Line( " F1 x only      : %s"       , cfg.f1XOnly ? "true" : "false" );
+    Log::Line( " P2 compaction  : %s"       , cfg.p2Compact ? "true" : "false" );
+    Log::Line( " Auto-tune      : %s"       , cfg.autoTuneProfile ? cfg.autoTuneProfile : "false" );
+    Log::Line( " Checkpoint     : %s%s"     , cfg.checkpointPath ? cfg.checkpointPath : "false", _resume ? " (resuming)" : "" );
+    if( _cx.gpuFx )
+        Log::Line( " GPU fx         : device %u", cfg.gpuFxDevice );
+    else
+        Log::Line( " GPU fx         : false" );
 
 #if BB_IO_METRICS_ON
     Log::Line( " I/O metrices enabled." );
 #endif
 
+    Log::NewLine();
+    MemoryPlanner::ReportPeak( gCfg, _cx.heapSize + _cx.cacheSize + _cx.residentSize + _cx.marksSize );
+
     Log::Line( " Allocating memory" );
-    _cx.heapBuffer = bbvirtalloc<byte>( _cx.heapSize );
+
+    // Explicit huge pages can't be interleaved across NUMA nodes at page granularity
+    const bool allowExplicitHugePages = !( numa && !gCfg.disableNuma );
+
+    if( gCfg.hugePages )
+    {
+        HugePageSize pageSize;
+        _cx.heapBuffer = (byte*)SysHost::VirtualAllocHuge( _cx.heapSize, allowExplicitHugePages, &pageSize );
+        FatalIf( !_cx.heapBuffer, "Failed to allocate the heap." );
+        Log::Line( "  Heap backed by %s.", HugePageSizeToString( pageSize ) );
+    }
+    else
+        _cx.heapBuffer = bbvirtalloc<byte>( _cx.heapSize );
+
     if( numa && !gCfg.disableNuma )
     {
         if( !SysHost::NumaSetMemoryInterleavedMode( _cx.heapBuffer, _cx.heapSize  ) )
@@ -103,7 +232,16 @@ void DiskPlotter::Init()
             _cx.cacheSize = alignedCacheSize;
         }
 
-        _cx.cache = bbvirtalloc<byte>( _cx.cacheSize );
+        if( gCfg.hugePages )
+        {
+            HugePageSize pageSize;
+            _cx.cache = (byte*)SysHost::VirtualAllocHuge( _cx.cacheSize, allowExplicitHugePages, &pageSize );
+            FatalIf( !_cx.cache, "Failed to allocate the cache." );
+            Log::Line( "  Cache backed by %s.", HugePageSizeToString( pageSize ) );
+        }
+        else
+            _cx.cache = bbvirtalloc<byte>( _cx.cacheSize );
+
         if( numa && !gCfg.disableNuma )
         {
             if( !SysHost::NumaSetMemoryInterleavedMode( _cx.cache, _cx.cacheSize  ) )
@@ -111,53 +249,108 @@ void DiskPlotter::Init()
         }
     }
 
+    if( _cx.residentSize )
+    {
+        _cx.resident = bbvirtalloc<byte>( _cx.residentSize );
+
+        if( numa && !gCfg.disableNuma )
+        {
+            if( !SysHost::NumaSetMemoryInterleavedMode( _cx.resident, _cx.residentSize ) )
+                Log::Error( "WARNING: Failed to bind NUMA memory on the resident buckets." );
+        }
+    }
+
+    if( _cx.marksSize )
+    {
+        _cx.marks = bbvirtalloc<byte>( _cx.marksSize );
+
+        if( numa && !gCfg.disableNuma )
+        {
+            if( !SysHost::NumaSetMemoryInterleavedMode( _cx.marks, _cx.marksSize ) )
+                Log::Error( "WARNING: Failed to bind NUMA memory on the marks." );
+        }
+    }
+
     // Initialize our Thread Pool and IO Queue
     const int32 ioThreadId = -1;    // Force unpinned IO thread for now. We should bind it to the last used thread, of the max threads used...
-    _cx.threadPool = new ThreadPool( sysLogicalCoreCount, ThreadPool::Mode::Fixed, gCfg.disableCpuAffinity );
-    _cx.ioQueue    = new DiskBufferQueue( _cx.tmpPath, _cx.tmpPath2, gCfg.outputFolder, _cx.heapBuffer, _cx.heapSize, _cx.ioThreadCount, ioThreadId );
+    _cx.threadPool = new ThreadPool( sysLogicalCoreCount, ThreadPool::Mode::Fixed, gCfg.disableCpuAffinity, gCfg.cpuOffset );
+    _cx.ioQueue    = new DiskBufferQueue( _cx.tmpPath, _cx.tmpPath2, gCfg.outputFolder, _cx.heapBuffer, _cx.heapSize, _cx.ioThreadCount, ioThreadId, _tmpFilePrefix );
     _cx.fencePool  = new FencePool( 8 );
     _cx.plotWriter = new PlotWriter( *_cx.ioQueue );
 
-    if( cfg.globalCfg->warmStart )
-    {
-        Log::Line( "Warm start: Pre-faulting memory pages..." );
-
-        const uint32 threadCount = cfg.globalCfg->threadCount == 0 ? sysLogicalCoreCount :
-                                    std::min( cfg.globalCfg->threadCount, sysLogicalCoreCount );
+    for( const char* path : cfg.tmpStripePaths )
+        _cx.ioQueue->AddWorkDir( false, path );
+    for( const char* path : cfg.tmpStripePaths2 )
+        _cx.ioQueue->AddWorkDir( true, path );
 
-        FaultMemoryPages::RunJob( *_cx.threadPool, threadCount, _cx.heapBuffer, _cx.heapSize );
+    if( cfg.adaptiveIO )
+        _cx.ioQueue->EnableAdaptiveIO();
 
-        if( _cx.cacheSize )
-            FaultMemoryPages::RunJob( *_cx.threadPool, threadCount, _cx.cache, _cx.cacheSize );
+    if( cfg.reuseTmpFiles )
+        _cx.ioQueue->SetReuseTempFiles( true );
 
-        Log::Line( "Memory initialized." );
+    // Fault the pages in the background while plotting.
+    // Phase 1 starts on the heap, then the cache and resident buckets fill up as buckets are written.
+    if( cfg.globalCfg->warmStart )
+    {
+        Log::Line( "Warm start: Pre-faulting memory pages in the background." );
+
+        _pageWarmer = new PageWarmer();
+        _pageWarmer->Add( _cx.heapBuffer, _cx.heapSize     );
+        _pageWarmer->Add( _cx.cache     , _cx.cacheSize    );
+        _pageWarmer->Add( _cx.resident  , _cx.residentSize );
+        _pageWarmer->Add( _cx.marks     , _cx.marksSize    );
+        _pageWarmer->Start();
     }
 }
 
 //-----------------------------------------------------------
-void DiskPlotter::Run( const PlotRequest& req )
+void DiskPlotter::Run( const PlotRequest& request )
 {
     auto& gCfg = *_cfg.globalCfg;
 
+    // Only the first plot is resumed, the interrupted one takes the place of the requested plot
+    PlotRequest req = request;
+    if( _resume )
+        _resume->GetPlotRequest( req );
+
+    using Stage = DiskPlotCheckpoint::Stage;
+    const Stage resumeStage = _resume ? _resume->stage : Stage::None;
+
     // Reset state
     memset( _cx.plotTablePointers   , 0, sizeof( _cx.plotTablePointers ) );
     memset( _cx.plotTableSizes      , 0, sizeof( _cx.plotTableSizes ) );
     memset( _cx.bucketCounts        , 0, sizeof( _cx.bucketCounts ) );
     memset( _cx.entryCounts         , 0, sizeof( _cx.entryCounts ) );
     memset( _cx.ptrTableBucketCounts, 0, sizeof( _cx.ptrTableBucketCounts ) );
+    memset( _cx.ptrTableBucketLeftBits, 0, sizeof( _cx.ptrTableBucketLeftBits ) );
+    memset( _cx.compactedTables     , 0, sizeof( _cx.compactedTables ) );
+    memset( _cx.compactedBucketCounts, 0, sizeof( _cx.compactedBucketCounts ) );
     memset( _cx.bucketSlices        , 0, sizeof( _cx.bucketSlices ) );
     memset( _cx.p1TableWaitTime     , 0, sizeof( _cx.p1TableWaitTime ) );
+    memset( _cx.p2TableWaitTime     , 0, sizeof( _cx.p2TableWaitTime ) );
+    memset( _cx.p3TableWaitTime     , 0, sizeof( _cx.p3TableWaitTime ) );
 
     _cx.ioWaitTime      = Duration::zero();
     _cx.cTableWaitTime  = Duration::zero();
     _cx.p7WaitTime      = Duration::zero();
 
+    _cx.ioQueue->ResetHeapStats();
+    _cx.ioQueue->ResetIOAccounting();
+    _cx.ioQueue->SetIOAccountingStage( 1, TableId::Table1 );
+
     _cx.plotRequest = req;
     
 
-    FatalIf( !_cx.plotWriter->BeginPlot( gCfg.compressionLevel > 0 ? PlotVersion::v2_0 : PlotVersion::v1_0, 
-                req.outDir, req.plotFileName, req.plotId, req.memo, req.memoSize, gCfg.compressionLevel ),
-        "Failed to open plot file with error: %d", _cx.plotWriter->GetError() );
+    if( _resume )
+        ResumeFromCheckpoint( req );
+    else
+    {
+        FatalIf( !_cx.plotWriter->BeginPlot( gCfg.compressionLevel > 0 || gCfg.parkDeltaCoding != ParkDeltaCoding::FSE || gCfg.alignedParks ? PlotVersion::v2_0 : PlotVersion::v1_0, 
+                    req.outDir, req.plotFileName, req.plotId, req.memo, req.memoSize, gCfg.compressionLevel,
+                    GetParkDeltaCodingFlags( gCfg.parkDeltaCoding ) | ( gCfg.alignedParks ? PlotFlags::AlignedParks : PlotFlags::None ) ),
+            "Failed to open plot file with error: %d", _cx.plotWriter->GetError() );
+    }
 
     #if ( _DEBUG && ( BB_DP_DBG_SKIP_PHASE_1 || BB_DP_P1_SKIP_TO_TABLE || BB_DP_DBG_SKIP_TO_C_TABLES ) )
         BB_DP_DBG_ReadTableCounts( _cx );
@@ -166,7 +359,12 @@ void DiskPlotter::Run( const PlotRequest& req )
     Log::Line( "Started plot." );
     auto plotTimer = TimerBegin();
 
+    if( resumeStage < Stage::Phase1 )
     {
+        FileStream p1Lock;
+        if( _cfg.staggerPhase1 )
+            AcquirePhase1Lock( p1Lock );
+
         Log::Line( "Running Phase 1" );
         const auto timer = TimerBegin();
 
@@ -183,8 +381,25 @@ void DiskPlotter::Run( const PlotRequest& req )
 
         const double elapsed = TimerEnd( timer );
         Log::Line( "Finished Phase 1 in %.2lf seconds ( %.1lf minutes ).", elapsed, elapsed / 60 );
+        PlotBenchmark::RecordPhase( 1, elapsed );
+        PerfCounters::RecordPhase( 1, elapsed );
+
+        if( _tuner )
+        {
+            Duration fpWait = Duration::zero();
+            for( TableId table = TableId::Table2; table <= TableId::Table7; table++ )
+                fpWait += _cx.p1TableWaitTime[(int)table];
+
+            _tuner->Record( DiskPlotTuner::FP, elapsed, TicksToSeconds( fpWait ) );
+        }
+
+        // Let the next plotter start its Phase 1 while we run Phases 2 and 3
+        p1Lock.Close();
+
+        DiskPlotCheckpoint::Save( _cx, Stage::Phase1 );
     }
 
+    if( resumeStage < Stage::Phase2 )
     {
         Log::Line( "Running Phase 2" );
         const auto timer = TimerBegin();
@@ -196,21 +411,56 @@ void DiskPlotter::Run( const PlotRequest& req )
 
         const double elapsed = TimerEnd( timer );
         Log::Line( "Finished Phase 2 in %.2lf seconds ( %.1lf minutes ).", elapsed, elapsed / 60 );
+        PlotBenchmark::RecordPhase( 2, elapsed );
+        PerfCounters::RecordPhase( 2, elapsed );
+
+        if( _tuner )
+        {
+            Duration p2Wait = Duration::zero();
+            for( TableId table = TableId::Table1; table <= TableId::Table7; table++ )
+                p2Wait += _cx.p2TableWaitTime[(int)table];
+
+            _tuner->Record( DiskPlotTuner::P2, elapsed, TicksToSeconds( p2Wait ) );
+        }
+
+        DiskPlotCheckpoint::Save( _cx, Stage::Phase2 );
     }
 
+    // Phase 3 only picks up its map files when resuming one of its tables
+    _cx.ioQueue->SetOpenExistingFiles( resumeStage == Stage::Phase3Table );
+
     {
         Log::Line( "Running Phase 3" );
         const auto timer = TimerBegin();
 
         {
-            DiskPlotPhase3 phase3( _cx );
+            DiskPlotPhase3 phase3( _cx, resumeStage == Stage::Phase3Table ? _resume : nullptr );
             phase3.Run();
         }
 
         const double elapsed = TimerEnd( timer );
         Log::Line( "Finished Phase 3 in %.2lf seconds ( %.1lf minutes ).", elapsed, elapsed / 60 );
+        PlotBenchmark::RecordPhase( 3, elapsed );
+        PerfCounters::RecordPhase( 3, elapsed );
+
+        if( _tuner )
+        {
+            Duration p3Wait = Duration::zero();
+            for( TableId table = TableId::Table1; table <= TableId::Table7; table++ )
+                p3Wait += _cx.p3TableWaitTime[(int)table];
+
+            _tuner->Record( DiskPlotTuner::P3, elapsed, TicksToSeconds( p3Wait ) );
+        }
     }
+    _cx.ioQueue->SetIOAccountingStage( 0, TableId::Table1 );
+
     Log::Line("Total plot I/O wait time: %.2lf seconds.", TicksToSeconds( _cx.ioWaitTime ) );
+    {
+        const WorkHeap::Stats heapStats = _cx.ioQueue->Heap().GetStats();
+        Log::Line( "Work heap: %llu allocations, %llu from size classes, %llu waited ( %.2lf seconds ), %.1lf%% fragmented.",
+            heapStats.allocCount, heapStats.classHitCount, heapStats.waitCount, TicksToSeconds( heapStats.waitTime ),
+            heapStats.fragmentation * 100.0 );
+    }
 
 
     {
@@ -222,7 +472,21 @@ void DiskPlotter::Run( const PlotRequest& req )
         auto& plotWriter = *_cx.plotWriter;
         plotWriter.EndPlot( true );
         plotWriter.WaitForPlotToComplete();
-        
+
+        // Temporary files are deleted in the background, so make sure
+        // they are gone before the next plot re-creates them, or before we exit.
+        _cx.ioQueue->WaitForPendingDeletes();
+
+        // The plot is complete, there's nothing left to resume
+        _cx.ioQueue->SetOpenExistingFiles( false );
+        DiskPlotCheckpoint::Delete( _cfg.checkpointPath );
+
+        if( _resume )
+        {
+            delete _resume;
+            _resume = nullptr;
+        }
+
         const double elapsed = TimerEnd( timer );
         Log::Line( "Completed pending writes in %.2lf seconds.", elapsed );
         Log::Line( "Finished writing plot %s.", req.plotFileName );
@@ -231,7 +495,175 @@ void DiskPlotter::Run( const PlotRequest& req )
 
         double plotElapsed = TimerEnd( plotTimer );
         Log::Line( "Finished plotting in %.2lf seconds ( %.1lf minutes ).", plotElapsed, plotElapsed / 60 );
+        PerfCounters::LogJobRuns();
+    }
+
+    ReportTempIO( req );
+
+    if( _tuner )
+    {
+        _tuner->Update();
+        _tuner->Apply( _cx );
+    }
+}
+
+//-----------------------------------------------------------
+void DiskPlotter::Finish()
+{
+    // Remove the temp files kept across plots
+    if( _cx.ioQueue )
+        _cx.ioQueue->DeletePooledFiles();
+}
+
+//-----------------------------------------------------------
+void DiskPlotter::ResumeFromCheckpoint( const PlotRequest& req )
+{
+    ASSERT( _resume );
+    const DiskPlotCheckpoint& cp = *_resume;
+
+    char plotIdStr[BB_PLOT_ID_HEX_LEN+1];
+    PlotTools::PlotIdToString( cp.plotId, plotIdStr );
+
+    if( cp.stage == DiskPlotCheckpoint::Stage::Phase3Table )
+        Log::Line( "Resuming plot %s after Phase 3 table %u, from checkpoint %s.", plotIdStr, (uint)cp.p3Table+1, _cfg.checkpointPath );
+    else
+        Log::Line( "Resuming plot %s after %s, from checkpoint %s.", plotIdStr, DiskPlotCheckpoint::StageName( cp.stage ), _cfg.checkpointPath );
+
+    cp.Restore( _cx );
+
+    FatalIf( !_cx.plotWriter->ResumePlot( req.outDir, req.plotFileName, cp.writer ),
+        "Failed to re-open plot file %s with error: %d", req.plotFileName, _cx.plotWriter->GetError() );
+
+    // Open the temp files left by the interrupted run, instead of truncating them
+    _cx.ioQueue->SetOpenExistingFiles( true );
+
+    K32BoundedPhase1::InitTableFiles( _cx );
+
+    if( cp.stage >= DiskPlotCheckpoint::Stage::Phase2 )
+        DiskPlotPhase2::InitMarkFiles( _cx );
+    else
+        _cx.ioQueue->SetOpenExistingFiles( false );     // Phase 2 re-creates its files
+}
+
+//-----------------------------------------------------------
+void DiskPlotter::ReportTempIO( const PlotRequest& req )
+{
+    const DiskBufferQueue&  ioQueue = *_cx.ioQueue;
+    const TempIOAccounting& io      = ioQueue.IOAccounting();
+
+    const uint32 phaseCount = TempIOAccounting::PHASE_COUNT;
+    const uint32 tableCount = (uint32)TableId::_Count;
+
+    uint64 stageRead   [phaseCount][tableCount] = {};
+    uint64 stageWritten[phaseCount][tableCount] = {};
+    uint64 totalRead    = 0;
+    uint64 totalWritten = 0;
+
+    Log::Line( "Temp disk I/O ( not counting what the cache and resident memory absorbed ):" );
+
+    std::string json;
+    json.reserve( 16 * 1024 );
+    json += R"({"plot": ")";
+    json += req.plotFileName;
+    json += R"(", "file_sets": [)";
+
+    bool firstFileSet = true;
+    for( uint32 f = 0; f < (uint32)FileId::_COUNT; f++ )
+    {
+        // The plot file is not temporary
+        const char* name = ioQueue.FileSetName( (FileId)f );
+        if( !name || (FileId)f == FileId::PLOT )
+            continue;
+
+        uint64 fileRead = 0, fileWritten = 0;
+        std::string stages;
+
+        for( uint32 p = 0; p < phaseCount; p++ )
+        for( uint32 t = 0; t < tableCount; t++ )
+        {
+            const uint64 read    = io.read   [f][p][t].load( std::memory_order_relaxed );
+            const uint64 written = io.written[f][p][t].load( std::memory_order_relaxed );
+
+            if( read == 0 && written == 0 )
+                continue;
+
+            stageRead   [p][t] += read;
+            stageWritten[p][t] += written;
+            fileRead           += read;
+            fileWritten        += written;
+
+            char buffer[128];
+            snprintf( buffer, sizeof( buffer ), R"(%s{"phase": %u, "table": %u, "read": %llu, "written": %llu})",
+                stages.empty() ? "" : ", ", p, t+1, (llu)read, (llu)written );
+            stages += buffer;
+        }
+
+        if( fileRead == 0 && fileWritten == 0 )
+            continue;
+
+        totalRead    += fileRead;
+        totalWritten += fileWritten;
+
+        Log::Line( "  %-16s: read %8.2lf GiB, written %8.2lf GiB", name, (double)fileRead BtoGB, (double)fileWritten BtoGB );
+
+        char buffer[256];
+        snprintf( buffer, sizeof( buffer ), R"(%s{"name": "%s", "read": %llu, "written": %llu, "stages": [)",
+            firstFileSet ? "" : ", ", name, (llu)fileRead, (llu)fileWritten );
+        json += buffer;
+        json += stages;
+        json += "]}";
+        firstFileSet = false;
+    }
+
+    for( uint32 p = 0; p < phaseCount; p++ )
+    {
+        for( uint32 t = 0; t < tableCount; t++ )
+        {
+            if( stageRead[p][t] == 0 && stageWritten[p][t] == 0 )
+                continue;
+
+            if( p == 0 )
+                Log::Line( "  Outside phases  : read %8.2lf GiB, written %8.2lf GiB",
+                    (double)stageRead[p][t] BtoGB, (double)stageWritten[p][t] BtoGB );
+            else
+                Log::Line( "  Phase %u table %u : read %8.2lf GiB, written %8.2lf GiB",
+                    p, t+1, (double)stageRead[p][t] BtoGB, (double)stageWritten[p][t] BtoGB );
+        }
     }
+
+    Log::Line( "  Total           : read %8.2lf GiB, written %8.2lf GiB", (double)totalRead BtoGB, (double)totalWritten BtoGB );
+
+    if( _cfg.tmpWriteBudget > 0 && totalWritten > _cfg.tmpWriteBudget )
+    {
+        Log::Line( "Warning: The plot wrote %.2lf GiB to the temp disks, over the --tmp-write-budget of %.2lf GiB.",
+            (double)totalWritten BtoGB, (double)_cfg.tmpWriteBudget BtoGB );
+        Log::Line( "         A larger --cache, --resident or --max-memory keeps more temp I/O in memory." );
+    }
+
+    if( _cfg.ioReportPath )
+    {
+        char buffer[128];
+        snprintf( buffer, sizeof( buffer ), R"(], "read": %llu, "written": %llu, "write_budget": %llu})" "\n",
+            (llu)totalRead, (llu)totalWritten, (llu)_cfg.tmpWriteBudget );
+        json += buffer;
+
+        FILE* file = fopen( _cfg.ioReportPath, "a" );
+
+        if( !file || fwrite( json.data(), 1, json.size(), file ) != json.size() )
+            Log::Line( "Warning: Failed to write the temp I/O report to '%s'.", _cfg.ioReportPath );
+
+        if( file )
+            fclose( file );
+    }
+}
+
+// -t2 mem:<size> keeps temp2 in memory instead of on a RAM disk
+static constexpr const char TMP2_MEMORY_PREFIX[] = "mem:";
+
+//-----------------------------------------------------------
+static bool IsTmp2InMemory( const char* tmpPath2 )
+{
+    return tmpPath2 && strncmp( tmpPath2, TMP2_MEMORY_PREFIX, sizeof( TMP2_MEMORY_PREFIX ) - 1 ) == 0;
 }
 
 //-----------------------------------------------------------
@@ -240,24 +672,90 @@ void DiskPlotter::ParseCLI( const GlobalPlotConfig& gCfg, CliParser& cli  )
     Config& cfg = _cfg;
     cfg.globalCfg = &gCfg;
 
+    bool bucketsGiven = false;
+    bool cacheGiven   = false;
+    bool marksGiven   = false;
+    bool noAlternate  = false;
+
+    const char* tmpPath = nullptr;
+
     while( cli.HasArgs() )
     {
         if( cli.ReadU32( cfg.numBuckets,  "-b", "--buckets" ) ) 
+        {
+            bucketsGiven = true;
             continue;
+        }
         if( cli.ReadUnswitch( cfg.bounded, "--unbounded" ) )
             continue;
         if( cli.ReadSwitch( cfg.alternateBuckets, "-a", "--alternate" ) )
             continue;
-        if( cli.ReadStr( cfg.tmpPath, "-t1", "--temp1" ) )
+        if( cli.ReadSwitch( noAlternate, "--no-alternate" ) )
+            continue;
+        if( cli.ReadStr( tmpPath, "-t1", "--temp1" ) )
+        {
+            // Repeating a temp dir stripes its bucket files across all of them
+            if( cfg.tmpPath )
+                cfg.tmpStripePaths.push_back( tmpPath );
+            else
+                cfg.tmpPath = tmpPath;
             continue;
-        if( cli.ReadStr( cfg.tmpPath2, "-t2", "--temp2" ) )
+        }
+        if( cli.ReadStr( tmpPath, "-t2", "--temp2" ) )
+        {
+            if( cfg.tmpPath2 )
+                cfg.tmpStripePaths2.push_back( tmpPath );
+            else
+                cfg.tmpPath2 = tmpPath;
             continue;
+        }
         if( cli.ReadSwitch( cfg.noTmp1DirectIO, "--no-t1-direct" ) )
             continue;
         if( cli.ReadSwitch( cfg.noTmp2DirectIO, "--no-t2-direct" ) )
             continue;
+        if( cli.ReadSwitch( cfg.tmp1PageCache, "--t1-cached" ) )
+            continue;
+        if( cli.ReadSwitch( cfg.tmp2PageCache, "--t2-cached" ) )
+            continue;
+        if( cli.ReadSwitch( cfg.staggerPhase1, "--stagger" ) )
+            continue;
+        if( cli.ReadSwitch( cfg.reuseTmpFiles, "--reuse-temp-files" ) )
+            continue;
+        if( cli.ReadSwitch( cfg.adaptiveIO, "--adaptive-io" ) )
+            continue;
+        if( cli.ReadSwitch( cfg.p3Pipeline, "--p3-pipeline" ) )
+            continue;
+        if( cli.ReadSwitch( cfg.f1XOnly, "--f1-x-only" ) )
+            continue;
+        if( cli.ReadSwitch( cfg.p2Compact, "--p2-compact" ) )
+            continue;
+        if( cli.ReadSwitch( cfg.gpuFx, "--gpu-fx" ) )
+            continue;
+        if( cli.ReadU32( cfg.gpuFxDevice, "--gpu-fx-device" ) )
+        {
+            cfg.gpuFx = true;
+            continue;
+        }
+        if( cli.ReadStr( cfg.autoTuneProfile, "--auto-tune" ) )
+            continue;
+        if( cli.ReadSize( cfg.tmpWriteBudget, "--tmp-write-budget" ) )
+            continue;
+        if( cli.ReadStr( cfg.ioReportPath, "--io-report" ) )
+            continue;
+        if( cli.ReadStr( cfg.checkpointPath, "--checkpoint" ) )
+            continue;
         if( cli.ReadSize( cfg.cacheSize, "--cache" ) )
+        {
+            cacheGiven = true;
             continue;
+        }
+        if( cli.ReadSize( cfg.residentSize, "--resident" ) )
+            continue;
+        if( cli.ReadSize( cfg.marksSize, "--marks-memory" ) )
+        {
+            marksGiven = true;
+            continue;
+        }
         if( cli.ReadU32( cfg.f1ThreadCount, "--f1-threads" ) )
             continue;
         if( cli.ReadU32( cfg.fpThreadCount, "--fp-threads" ) )
@@ -278,7 +776,7 @@ void DiskPlotter::ParseCLI( const GlobalPlotConfig& gCfg, CliParser& cli  )
             const uint32 threadCount = bbclamp<uint32>( cfg.globalCfg->threadCount, 1u, SysHost::GetLogicalCPUCount() );
 
             size_t heapSize = 0;
-            cfg.tmpPath2 = cfg.tmpPath2 ? cfg.tmpPath2 : cfg.tmpPath;
+            cfg.tmpPath2 = cfg.tmpPath2 && !IsTmp2InMemory( cfg.tmpPath2 ) ? cfg.tmpPath2 : cfg.tmpPath;
             heapSize = GetRequiredSizeForBuckets( cfg.bounded, cfg.numBuckets, cfg.tmpPath2, cfg.tmpPath, threadCount );
             
             Log::Line( "Buckets: %u | Heap Sizes: %.2lf GiB", cfg.numBuckets, (double)heapSize BtoGB );
@@ -309,9 +807,41 @@ void DiskPlotter::ParseCLI( const GlobalPlotConfig& gCfg, CliParser& cli  )
     /// Validate some parameters
     ///
     FatalIf( cfg.tmpPath == nullptr, "At least 1 temporary path (--temp) must be specified." );
+
+    // An in-memory temp2 is the cache: temp2 file sets are served from it by HybridStreams,
+    // and whatever does not fit spills to files in temp1.
+    if( IsTmp2InMemory( cfg.tmpPath2 ) )
+    {
+        const char* sizeText = cfg.tmpPath2 + sizeof( TMP2_MEMORY_PREFIX ) - 1;
+
+        size_t memSize = 0;
+        FatalIf( !cli.ReadSize( sizeText, memSize, "--temp2" ) || memSize == 0, "Invalid temp2 memory size '%s'.", sizeText );
+        FatalIf( cacheGiven && cfg.cacheSize != memSize, "--cache can't be combined with an in-memory temp2. Use -t2 %s<size> only.", TMP2_MEMORY_PREFIX );
+
+        FatalIf( !cfg.tmpStripePaths2.empty(), "An in-memory temp2 can't be striped across other temp2 directories." );
+
+        cfg.cacheSize    = memSize;
+        cfg.tmpPath2     = cfg.tmpPath;
+        cfg.tmp2InMemory = true;
+        cacheGiven       = true;
+    }
+
     if( cfg.tmpPath2 == nullptr )
         cfg.tmpPath2 = cfg.tmpPath;
 
+    // Temp2 files that live in temp1 are striped like temp1's
+    if( cfg.tmpPath2 == cfg.tmpPath )
+        cfg.tmpStripePaths2 = cfg.tmpStripePaths;
+
+    for( const char* path : cfg.tmpStripePaths2 )
+        FatalIf( IsTmp2InMemory( path ), "An in-memory temp2 can't be striped across other temp2 directories." );
+
+    // Page cache I/O is buffered I/O
+    if( cfg.tmp1PageCache )
+        cfg.noTmp1DirectIO = true;
+    if( cfg.tmp2PageCache )
+        cfg.noTmp2DirectIO = true;
+
     FatalIf( cfg.numBuckets < BB_DP_MIN_BUCKET_COUNT || cfg.numBuckets > BB_DP_MAX_BUCKET_COUNT,
         "Buckets must be between %u and %u, inclusive.", (uint)BB_DP_MIN_BUCKET_COUNT, (uint)BB_DP_MAX_BUCKET_COUNT );
 
@@ -342,6 +872,155 @@ void DiskPlotter::ParseCLI( const GlobalPlotConfig& gCfg, CliParser& cli  )
     validateThreads( cfg.cThreadCount  );
     validateThreads( cfg.p2ThreadCount );
     validateThreads( cfg.p3ThreadCount );
+
+    // A resumed Phase 3 reads the marking tables back from their files
+    if( cfg.checkpointPath && cfg.marksSize > 0 )
+    {
+        Log::Line( "Warning: --marks-memory is not supported with --checkpoint, ignoring it." );
+        cfg.marksSize = 0;
+    }
+
+    const bool planMarks = !marksGiven && !cfg.checkpointPath;
+
+    if( MemoryPlanner::HasBudget( *cfg.globalCfg ) )
+        FitToMemoryBudget( cfg, bucketsGiven, cacheGiven, planMarks );
+    else if( cfg.tmpWriteBudget > 0 && !cacheGiven )
+    {
+        // Temp writes are mostly Phase 1's temp2 files, which the cache keeps in memory,
+        // so give it whatever the heap and Phase 2's marking tables leave of the available memory.
+        const size_t heapSize  = GetRequiredSizeForBuckets( cfg.bounded, cfg.numBuckets, cfg.tmpPath, cfg.tmpPath2, cfg.fpThreadCount );
+        const size_t available = SysHost::GetAvailableSystemMemory();
+              size_t used      = heapSize + cfg.residentSize + BB_DP_WRITE_BUDGET_RESERVED_MEMORY;
+
+        if( planMarks )
+        {
+            const size_t marksSize = available > used ? std::min( available - used, BB_DP_MARKS_MEMORY_SIZE ) : 0;
+            cfg.marksSize = marksSize / BB_DP_MARKING_TABLE_SIZE * BB_DP_MARKING_TABLE_SIZE;
+        }
+        used += cfg.marksSize;
+
+        const size_t cacheSize = available > used ? std::min( available - used, BB_DP_INTERLEAVED_CACHE_SIZE ) : 0;
+
+        cfg.cacheSize = cacheSize / ( 1ull GB ) * ( 1ull GB );
+        Log::Line( "Using a %.2lf GiB cache and %.2lf GiB of marks memory to reduce temp disk writes for --tmp-write-budget.",
+            (double)cfg.cacheSize BtoGB, (double)cfg.marksSize BtoGB );
+    }
+
+    FatalIf( cfg.alternateBuckets && noAlternate, "--alternate and --no-alternate are mutually exclusive." );
+
+    // A cache that can't hold all of Phase 1's temp2 files in interleaved mode
+    // covers twice as much of them when alternating, so prefer that mode.
+    if( cfg.cacheSize > 0 && cfg.cacheSize < BB_DP_INTERLEAVED_CACHE_SIZE && !cfg.alternateBuckets && !noAlternate )
+    {
+        cfg.alternateBuckets = true;
+        Log::Line( "Cache is smaller than %.0lf GiB, enabling alternating bucket I/O ( use --no-alternate to disable ).",
+            (double)BB_DP_INTERLEAVED_CACHE_SIZE BtoGB );
+    }
+
+    // Alternating buckets are read back while the next ones are being written
+    if( cfg.alternateBuckets && cfg.residentSize > 0 )
+    {
+        Log::Line( "Warning: --resident is not supported with alternating bucket I/O, ignoring it." );
+        cfg.residentSize = 0;
+    }
+
+    if( cfg.alternateBuckets && cfg.cacheSize > 0 )
+    {
+        const size_t tmp2BlockSize   = FileStream::GetBlockSizeForPath( cfg.tmpPath2 );
+        const size_t alternatingSize = tmp2BlockSize ? GetAlternatingCacheSize( cfg.numBuckets, tmp2BlockSize ) : 0;
+
+        if( alternatingSize )
+        {
+            // Don't hold on to more than alternating mode can use, unless the user asked for it
+            if( !cacheGiven && cfg.cacheSize > alternatingSize )
+                cfg.cacheSize = alternatingSize;
+            else if( cfg.cacheSize < alternatingSize )
+                Log::Line( "Note: Phase 1 needs a %.2lf GiB cache in alternating mode to be completely in-memory.", (double)alternatingSize BtoGB );
+        }
+    }
+}
+
+//-----------------------------------------------------------
+size_t DiskPlotter::GetAlternatingCacheSize( const uint32 numBuckets, const size_t tmp2BlockSize )
+{
+    // Mirrors the slice sizes K32BoundedPhase1 uses for its alternating file sets
+    const uint64 bucketEntries = ( 1ull << 32 ) / numBuckets;
+    const uint64 sliceEntries  = bucketEntries / numBuckets;
+    const uint64 ysPerBlock    = tmp2BlockSize / sizeof( uint32 );
+    const uint64 metasPerBlock = tmp2BlockSize / ( sizeof( uint32 ) * 4 );
+
+    const uint64 sliceSizeY    = RoundUpToNextBoundaryT( (uint64)( sliceEntries * BB_DP_ENTRY_SLICE_MULTIPLIER ), ysPerBlock    ) * sizeof( uint32 );
+    const uint64 sliceSizeMeta = RoundUpToNextBoundaryT( (uint64)( sliceEntries * BB_DP_ENTRY_SLICE_MULTIPLIER ), metasPerBlock ) * sizeof( uint32 ) * 4;
+
+    // The cache is split into 6 equal parts, 1 for y, 1 for index and 4 for meta,
+    // and each bucket loses up to a block of its share to alignment.
+    const uint64 partSize = std::max( sliceSizeY, CDiv( sliceSizeMeta, 4 ) ) * numBuckets * numBuckets + (uint64)numBuckets * tmp2BlockSize;
+
+    return (size_t)RoundUpToNextBoundaryT( partSize * 6, (uint64)( 1ull GB ) );
+}
+
+//-----------------------------------------------------------
+void DiskPlotter::FitToMemoryBudget( Config& cfg, const bool bucketsGiven, const bool cacheGiven, const bool planMarks )
+{
+    const GlobalPlotConfig& gCfg = *cfg.globalCfg;
+
+    size_t heapSize = GetRequiredSizeForBuckets( cfg.bounded, cfg.numBuckets, cfg.tmpPath, cfg.tmpPath2, cfg.fpThreadCount );
+
+    // More buckets means smaller buckets, and so a smaller heap
+    if( !bucketsGiven )
+    {
+        while( !MemoryPlanner::Fits( gCfg, heapSize ) && cfg.numBuckets < BB_DP_MAX_BUCKET_COUNT / 2 )
+        {
+            cfg.numBuckets *= 2;
+            heapSize = GetRequiredSizeForBuckets( cfg.bounded, cfg.numBuckets, cfg.tmpPath, cfg.tmpPath2, cfg.fpThreadCount );
+        }
+    }
+
+    FatalIf( !MemoryPlanner::Fits( gCfg, heapSize ), "The diskplot heap for %u buckets ( %.2lf GiB ) does not fit in --max-memory ( %.2lf GiB ).",
+        cfg.numBuckets, (double)heapSize BtoGB, (double)gCfg.maxMemory BtoGB );
+
+    // Keep as many of Phase 2's marking tables in memory as fit, as they are otherwise written to and read back from temp1
+    if( planMarks )
+    {
+        const size_t marksSize = std::min( MemoryPlanner::Remaining( gCfg, heapSize + cfg.residentSize ), BB_DP_MARKS_MEMORY_SIZE );
+        cfg.marksSize = marksSize / BB_DP_MARKING_TABLE_SIZE * BB_DP_MARKING_TABLE_SIZE;
+    }
+
+    // Give whatever is left to the cache
+    if( !cacheGiven )
+    {
+        const size_t cacheSize = std::min( MemoryPlanner::Remaining( gCfg, heapSize + cfg.residentSize + cfg.marksSize ), BB_DP_INTERLEAVED_CACHE_SIZE );
+        cfg.cacheSize = cacheSize / ( 1ull GB ) * ( 1ull GB );
+    }
+
+    Log::Line( "Fitted diskplot to --max-memory: %u buckets, %.2lf GiB heap, %.2lf GiB marks, %.2lf GiB cache.",
+        cfg.numBuckets, (double)heapSize BtoGB, (double)cfg.marksSize BtoGB, (double)cfg.cacheSize BtoGB );
+}
+
+//-----------------------------------------------------------
+void DiskPlotter::AcquirePhase1Lock( FileStream& lockFile )
+{
+    std::string path = _cx.tmpPath;
+    if( path.back() != '/' 
+    #ifdef _WIN32
+        && path.back() != '\\'
+    #endif
+    )
+        path += '/';
+
+    path += "bladebit_phase1.lock";
+
+    FatalIf( !lockFile.Open( path.c_str(), FileMode::OpenOrCreate, FileAccess::ReadWrite ),
+        "Failed to open phase 1 lock file '%s' with error %d.", path.c_str(), lockFile.GetError() );
+
+    if( lockFile.Lock( false ) )
+        return;
+
+    Log::Line( "Waiting for another plotter to finish Phase 1..." );
+    const auto timer = TimerBegin();
+
+    FatalIf( !lockFile.Lock( true ), "Failed to lock '%s' with error %d.", path.c_str(), lockFile.GetError() );
+    Log::Line( "Waited %.2lf seconds for Phase 1 lock.", TimerEnd( timer ) );
 }
 
 //-----------------------------------------------------------
@@ -445,19 +1124,81 @@ Creates plots by making use of a disk to temporarily store and read values.
                       1024 is not available for plots of k < 33.
  
  -a, --alternate    : Halves the temp2 cache size requirements by alternating bucket writing methods
-                      between tables.
+                      between tables. This is enabled automatically when --cache is less than 192GiB.
+
+ --no-alternate     : Don't enable --alternate automatically for smaller caches.
 
  -t1, --temp1 <dir> : The temporary directory to use when plotting.
+                      Repeat it to stripe the bucket files across several directories,
+                      ideally one per disk, as software RAID 0 would.
+                      The directories must have the same block size.
                       *REQUIRED*
 
  -t2, --temp2 <dir> : Specify a secondary temporary directory, which will be used for data
                       that needs to be read/written from constantly.
                       If nothing is specified, --temp will be used instead.
+                      Pass mem:<size> (ex. -t2 mem:110G) to keep temp2 in memory instead of
+                      on a RAM disk. Anything that does not fit in <size> spills to temp1.
+                      This replaces --cache.
+                      Repeat it to stripe temp2's bucket files, like --temp1.
 
  --no-t1-direct     : Disable direct I/O on the temp 1 directory.
 
  --no-t2-direct     : Disable direct I/O on the temp 2 directory.
 
+ --t1-cached        : Use buffered I/O on the temp 1 directory and let the OS page cache
+                      absorb it, with read-ahead hints for sequential reads.
+                      Good for slow temp disks on hosts with plenty of RAM. Implies --no-t1-direct.
+
+ --t2-cached        : Same as --t1-cached, but for the temp 2 directory. Implies --no-t2-direct.
+
+ --stagger          : Coordinate with other diskplot instances that share the same temp 1 directory,
+                      so that only one of them runs Phase 1 at a time. Phase 1 is the most
+                      CPU and I/O intensive phase, so concurrent plotters end up staggered,
+                      running their Phase 1 while the others run Phases 2 and 3.
+                      Each plotter's temp files are tagged, so instances can always share temp directories.
+
+ --reuse-temp-files : Keep the temp files between consecutive plots, instead of deleting them as they are
+                      consumed and re-creating them for the next plot. The next plot overwrites them in place,
+                      on the extents already allocated, which avoids the file system work of creating,
+                      growing and deleting every bucket file, and their fragmentation.
+                      Temp space usage stays at its peak until the last plot is done.
+
+ --adaptive-io      : Tune how many work file requests are kept in flight at once (the I/O batch queue depth)
+                      at every table boundary, separately for each phase and temp directory.
+                      The depth is raised while it improves disk throughput and the plotter is waiting
+                      on I/O, and lowered otherwise. Linux only.
+
+ --p3-pipeline      : In Phase 3, start reading the pairs of the next table while the
+                      last parks of the current table are still being written to the plot.
+                      A table's map is only complete once all of its buckets are sorted,
+                      so this is as far as adjacent tables can overlap. Reserves extra heap
+                      for the park buffers and falls back to the sequential order if it does not fit.
+
+ --f1-x-only        : F1 writes only x to the temp buckets, and table 2 recomputes each entry's y
+                      from its x with chacha8 as it reads the bucket back, instead of writing and
+                      reading a y file for table 1. Saves 16GiB of temp writes and reads per plot,
+                      at the cost of up to one chacha8 block per entry in table 2.
+                      Useful when temp I/O is the bottleneck and there are spare CPU cycles.
+
+ --p2-compact       : As Phase 2 marks the entries of tables 3 to 6 that the plot keeps, it rewrites
+                      the back pointers and map of each of those tables with only its marked entries.
+                      Phase 3 then reads these instead of the full tables and their marking tables,
+                      which is 20-30% fewer entries and a denser encoding. Costs the writes of the
+                      compacted tables, and their temp1 space until Phase 3 deletes them.
+
+ --gpu-fx           : Generate the y and metadata of matched entries in Phase 1 on a CUDA device,
+                      using the same kernels as the GPU harvester. Sorting and matching stay on the CPU.
+                      Requires the bladebit_cuda build. Falls back to the CPU if no device is available.
+
+ --gpu-fx-device <n>: Index of the CUDA device to use with --gpu-fx. Implies --gpu-fx. Default: 0.
+
+ --auto-tune <file> : Tune the forward propagation, Phase 2 and Phase 3 thread counts across plots.
+                      A phase that spent much of its time waiting on I/O tries fewer threads
+                      on the next plot, as long as that makes it faster. The chosen counts are
+                      saved to <file> and reused by later runs. Phases given explicitly with
+                      --fp-threads, --p2-threads or --p3-threads are not tuned.
+
  -s, --sizes        : Output the memory requirements for a specific bucket count.
                       To change the bucket count from the default, pass a value to -b
                       before using this argument. You may also pass a value to --temp and --temp2
@@ -466,7 +1207,18 @@ Creates plots by making use of a disk to temporarily store and read values.
  --cache <n>        : Size of cache to reserve for I/O. This is memory
                       reserved for files that incur frequent I/O.
                       You need about 192GiB(+|-) for high-frequency I/O Phase 1 calculations
-                      to be completely in-memory.
+                      to be completely in-memory, or about 99GiB with --alternate.
+
+ --resident <n>     : Size of memory in which to hold the y and meta buckets written by F1,
+                      and by tables 3, 5 and 7, until the next table reads them back.
+                      The buckets that fit are never written to or read from temp2,
+                      saving a full write and read of them. Ignored with --alternate.
+
+ --marks-memory <n> : Size of memory in which Phase 2 holds the marking tables of tables 2 to 6
+                      until Phase 3 reads them back, instead of writing them to temp1.
+                      Tables that don't fit are written to temp1 as usual. About 2.5GiB holds
+                      all of them. Sized automatically with --max-memory or --tmp-write-budget.
+                      Ignored with --checkpoint.
 
  --f1-threads <n>   : Override the thread count for F1 generation.
 
@@ -480,6 +1232,22 @@ Creates plots by making use of a disk to temporarily store and read values.
 
 --p3-threads <n>    : Override the thread count for Phase 3.
 
+--tmp-write-budget <n>: Bytes each plot should write to the temp disks at most, to save SSD endurance.
+                      Unless --cache or --max-memory is given, the cache is sized to all the memory
+                      that the heap leaves available, so that most temp2 I/O stays in memory.
+                      A warning is logged after every plot that goes over the budget.
+
+--io-report <file>  : Append the bytes each plot read from and wrote to the temp disks,
+                      per file set, phase and table, to <file> as one json object per line.
+                      A summary is always logged at the end of each plot.
+
+--checkpoint <file> : Save the plot's progress to <file> at the end of Phases 1 and 2 and after
+                      each Phase 3 table. If <file> exists when the plotter starts, the interrupted plot
+                      is resumed from it, with its temp files and its partial plot file, before any new plot.
+                      The plotter must be given the same temp directories, bucket count and plot options.
+                      Phase 3 tables are not checkpointed when using a cache. The file is deleted once
+                      the plot completes. Use one file per plotter instance.
+
 -h, --help          : Print this help text and exit.
 
 
@@ -1,9 +1,13 @@
 #pragma once
 
 #include "DiskPlotContext.h"
+#include "DiskPlotTuner.h"
+#include "DiskPlotCheckpoint.h"
 #include "plotting/GlobalPlotConfig.h"
 #include "plotting/IPlotter.h"
 
+class PageWarmer;
+
 class DiskPlotter : public IPlotter
 {
 public:
@@ -23,16 +27,37 @@ public:
     void ParseCLI( const GlobalPlotConfig& gCfg, CliParser& cli ) override;
     void Init()  override;
     void Run( const PlotRequest& req ) override;
+    void Finish() override;
 
 
     static bool   GetTmpPathsBlockSizes( const char* tmpPath1, const char* tmpPath2, size_t& tmpPath1Size, size_t& tmpPath2Size );
     static size_t GetRequiredSizeForBuckets( const bool bounded, const uint32 numBuckets, const char* tmpPath1, const char* tmpPath2, const uint32 threadCount );
     static size_t GetRequiredSizeForBuckets( const bool bounded, const uint32 numBuckets, const size_t fxBlockSize, const size_t pairsBlockSize, const uint32 threadCount );
 
+    // Cache size needed for Phase 1's temp2 files to be completely in-memory in alternating mode
+    static size_t GetAlternatingCacheSize( uint32 numBuckets, size_t tmp2BlockSize );
+
     static void PrintUsage();
 
 private:
-    DiskPlotContext   _cx  = {};
-    Config            _cfg = {};
+    // Blocks until we are the only plotter running Phase 1 on our temp1 directory
+    void AcquirePhase1Lock( FileStream& lockFile );
+
+    // Pick the bucket count, marks memory and cache size from --max-memory, unless given explicitly
+    static void FitToMemoryBudget( Config& cfg, bool bucketsGiven, bool cacheGiven, bool planMarks );
+
+    // Log the bytes the plot read from and wrote to the temp disks, and append them to --io-report
+    void ReportTempIO( const PlotRequest& req );
+
+    // Re-open the temp files and plot file of the plot being resumed from _resume
+    void ResumeFromCheckpoint( const PlotRequest& req );
+
+private:
+    DiskPlotContext     _cx  = {};
+    Config              _cfg = {};
+    char                _tmpFilePrefix[16] = {};
+    DiskPlotTuner*      _tuner  = nullptr;
+    DiskPlotCheckpoint* _resume = nullptr;      // Checkpoint that the first plot resumes from
+    PageWarmer*         _pageWarmer = nullptr;  // --warm-start
 };
 
@@ -39,6 +39,12 @@ enum class FileId
     MARKED_ENTRIES_5,
     MARKED_ENTRIES_6,
 
+    // Marked back pointers and map of the tables compacted at the end of Phase 2
+    COMPACTED_3,
+    COMPACTED_4,
+    COMPACTED_5,
+    COMPACTED_6,
+
     // Line points
     LP,
     LP_MAP_0,
@@ -132,3 +138,22 @@ inline FileId TableIdToMarkedEntriesFileId( const TableId table )
     ASSERT( 0 );
     return FileId::None;
 }
+
+//-----------------------------------------------------------
+inline FileId TableIdToCompactedFileId( const TableId table )
+{
+    switch( table )
+    {
+        case TableId::Table3: return FileId::COMPACTED_3;
+        case TableId::Table4: return FileId::COMPACTED_4;
+        case TableId::Table5: return FileId::COMPACTED_5;
+        case TableId::Table6: return FileId::COMPACTED_6;
+
+        default:
+            ASSERT( 0 );
+            break;
+    }
+    
+    ASSERT( 0 );
+    return FileId::None;
+}
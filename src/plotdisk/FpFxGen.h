@@ -4,24 +4,28 @@
 #include "plotdisk/DiskPlotInfo.h"
 #include "b3/blake3.h"
 
-template<TableId table>
+// y is k + kExtraBits wide, except for table 7 where it is k bits wide
+template<TableId table, uint32 _kSize = _K>
 struct FpYType { using Type = uint64; };
 
-template<>
-struct FpYType<TableId::Table7> { using Type = uint32; };
+template<uint32 _kSize>
+struct FpYType<TableId::Table7, _kSize> { using Type = std::conditional_t<( _kSize <= 32 ), uint32, uint64>; };
 
 
-template<TableId table>
+// k is a template parameter so that all bit widths and shifts are compile-time constants.
+// Only k32 metadata packing is implemented: larger k would need wider metadata types (2k > 64 bits for table 3).
+template<TableId table, uint32 _kSize = _K>
 struct FpFxGen
 {
     using TMetaIn  = typename TableMetaType<table>::MetaIn;
     using TMetaOut = typename TableMetaType<table>::MetaOut;
-    using TYOut    = typename FpYType<table>::Type;
+    using TYOut    = typename FpYType<table, _kSize>::Type;
 
     static constexpr size_t MetaInMulti  = TableMetaIn<table>::Multiplier;
     static constexpr size_t MetaOutMulti = TableMetaOut<table>::Multiplier;
 
-    static constexpr uint32 _k = _K;
+    static constexpr uint32 _k = _kSize;
+    static_assert( _k == 32, "Only k32 is supported by the CPU fx kernel." );
 
     //-----------------------------------------------------------
     inline FpFxGen( ThreadPool& pool, const uint32 threadCount )
@@ -33,12 +37,9 @@ struct FpFxGen
     inline void ComputeFxMT( const int64 entryCount, const Pair* pairs, const uint64* yIn, const TMetaIn* metaIn,
                              TYOut* yOut, TMetaOut* metaOut )
     {
-        AnonMTJob::Run( _pool, _threadCount, [=]( AnonMTJob* self ) {
-            
-            int64 count, offset, end;
-            GetThreadOffsets( self, entryCount, count, offset, end );
+        AnonMTJob::RunRanges( _pool, _threadCount, (uint64)entryCount, [=]( AnonMTJob* self, uint64 offset, uint64 count ) {
 
-            ComputeFx( count, pairs+offset, yIn, metaIn, yOut+offset, metaOut+offset, self->_jobId );
+            ComputeFx( (int64)count, pairs+offset, yIn, metaIn, yOut+offset, metaOut+offset, self->_jobId );
         });
     }
 
@@ -58,126 +59,139 @@ struct FpFxGen
 
         const size_t bufferSize  = CDiv( ySize + metaSizeLR, 8 );
 
-        // Hashing
-        uint64 input [5]; // y + L + R
-        uint64 output[4]; // blake3 hashed output
+        // Hashing is done in batches so that blake3 can process multiple pairs in parallel SIMD lanes
+        static constexpr int64 BatchSize = 64;
 
-        blake3_hasher hasher;
+        uint64 inputs [BatchSize][5]; // y + L + R
+        uint64 outputs[BatchSize][4]; // blake3 hashed output
 
-        static_assert( bufferSize <= sizeof( input ), "Invalid fx input buffer size." );
+        static_assert( bufferSize <= sizeof( inputs[0] ), "Invalid fx input buffer size." );
 
         #if _DEBUG
             uint64 prevY    = yIn[pairs[0].left];
             uint64 prevLeft = 0;
         #endif
 
-        for( int64 i = 0; i < entryCount; i++ )
+        for( int64 batchStart = 0; batchStart < entryCount; batchStart += BatchSize )
         {
-            const auto& pair = pairs[i];
-            const uint32 left  = pair.left;
-            const uint32 right = pair.right;
-            ASSERT( left < right );
+            const int64 batchCount = std::min( BatchSize, entryCount - batchStart );
 
-            const uint64 y = yIn[left];
+            for( int64 j = 0; j < batchCount; j++ )
+            {
+                const int64  i     = batchStart + j;
+                const auto&  pair  = pairs[i];
+                uint64*      input = inputs[j];
 
-            #if _DEBUG
-                ASSERT( y >= prevY );
-                ASSERT( left >= prevLeft );
-                prevY    = y;
-                prevLeft = left;
-            #endif
+                const uint32 left  = pair.left;
+                const uint32 right = pair.right;
+                ASSERT( left < right );
 
-            // Extract metadata
-            auto& mOut = metaOut[i];
+                const uint64 y = yIn[left];
 
-            if constexpr( MetaInMulti == 1 )
-            {
-                const uint64 l = metaIn[left ];
-                const uint64 r = metaIn[right];
+                #if _DEBUG
+                    ASSERT( y >= prevY );
+                    ASSERT( left >= prevLeft );
+                    prevY    = y;
+                    prevLeft = left;
+                #endif
 
-                input[0] = Swap64( y << 26 | l >> 6  );
-                input[1] = Swap64( l << 58 | r << 26 );
+                // Extract metadata
+                auto& mOut = metaOut[i];
 
-                // Metadata is just L + R of 8 bytes
-                if constexpr( MetaOutMulti == 2 )
-                    mOut = l << 32 | r;
-            }
-            else if constexpr( MetaInMulti == 2 )
-            {
-                const uint64 l = metaIn[left ];
-                const uint64 r = metaIn[right];
+                if constexpr( MetaInMulti == 1 )
+                {
+                    const uint64 l = metaIn[left ];
+                    const uint64 r = metaIn[right];
 
-                input[0] = Swap64( y << 26 | l >> 38 );
-                input[1] = Swap64( l << 26 | r >> 38 );
-                input[2] = Swap64( r << 26 );
+                    input[0] = Swap64( y << 26 | l >> 6  );
+                    input[1] = Swap64( l << 58 | r << 26 );
 
-                // Metadata is just L + R again of 16 bytes
-                if constexpr( MetaOutMulti == 4 )
+                    // Metadata is just L + R of 8 bytes
+                    if constexpr( MetaOutMulti == 2 )
+                        mOut = l << 32 | r;
+                }
+                else if constexpr( MetaInMulti == 2 )
                 {
-                    mOut.m0 = l;
-                    mOut.m1 = r;
+                    const uint64 l = metaIn[left ];
+                    const uint64 r = metaIn[right];
+
+                    input[0] = Swap64( y << 26 | l >> 38 );
+                    input[1] = Swap64( l << 26 | r >> 38 );
+                    input[2] = Swap64( r << 26 );
+
+                    // Metadata is just L + R again of 16 bytes
+                    if constexpr( MetaOutMulti == 4 )
+                    {
+                        mOut.m0 = l;
+                        mOut.m1 = r;
+                    }
                 }
-            }
-            else if constexpr( MetaInMulti == 3 )
-            {
-                const uint64 l0 = metaIn[left ].m0;
-                const uint64 l1 = metaIn[left ].m1 & 0xFFFFFFFF;
-                const uint64 r0 = metaIn[right].m0;
-                const uint64 r1 = metaIn[right].m1 & 0xFFFFFFFF;
+                else if constexpr( MetaInMulti == 3 )
+                {
+                    const uint64 l0 = metaIn[left ].m0;
+                    const uint64 l1 = metaIn[left ].m1 & 0xFFFFFFFF;
+                    const uint64 r0 = metaIn[right].m0;
+                    const uint64 r1 = metaIn[right].m1 & 0xFFFFFFFF;
             
-                input[0] = Swap64( y  << 26 | l0 >> 38 );
-                input[1] = Swap64( l0 << 26 | l1 >> 6  );
-                input[2] = Swap64( l1 << 58 | r0 >> 6  );
-                input[3] = Swap64( r0 << 58 | r1 << 26 );
-            }
-            else if constexpr( MetaInMulti == 4 )
-            {
-                // const uint64 l0 = metaInA[left ];
-                // const uint64 l1 = metaInB[left ];
-                // const uint64 r0 = metaInA[right];
-                // const uint64 r1 = metaInB[right];
-                const Meta4 l = metaIn[left];
-                const Meta4 r = metaIn[right];
-
-                input[0] = Swap64( y    << 26 | l.m0 >> 38 );
-                input[1] = Swap64( l.m0 << 26 | l.m1 >> 38 );
-                input[2] = Swap64( l.m1 << 26 | r.m0 >> 38 );
-                input[3] = Swap64( r.m0 << 26 | r.m1 >> 38 );
-                input[4] = Swap64( r.m1 << 26 );
+                    input[0] = Swap64( y  << 26 | l0 >> 38 );
+                    input[1] = Swap64( l0 << 26 | l1 >> 6  );
+                    input[2] = Swap64( l1 << 58 | r0 >> 6  );
+                    input[3] = Swap64( r0 << 58 | r1 << 26 );
+                }
+                else if constexpr( MetaInMulti == 4 )
+                {
+                    // const uint64 l0 = metaInA[left ];
+                    // const uint64 l1 = metaInB[left ];
+                    // const uint64 r0 = metaInA[right];
+                    // const uint64 r1 = metaInB[right];
+                    const Meta4 l = metaIn[left];
+                    const Meta4 r = metaIn[right];
+
+                    input[0] = Swap64( y    << 26 | l.m0 >> 38 );
+                    input[1] = Swap64( l.m0 << 26 | l.m1 >> 38 );
+                    input[2] = Swap64( l.m1 << 26 | r.m0 >> 38 );
+                    input[3] = Swap64( r.m0 << 26 | r.m1 >> 38 );
+                    input[4] = Swap64( r.m1 << 26 );
+                }
             }
 
-            // Hash the input
-            blake3_hasher_init( &hasher );
-            blake3_hasher_update( &hasher, input, bufferSize );
-            blake3_hasher_finalize( &hasher, (uint8_t*)output, sizeof( output ) );
-
-            const uint64 f = Swap64( *output ) >> yShift;
-            yOut[i] = (TYOut)f;
+            // Hash the whole batch
+            blake3_hash_short_many( inputs, sizeof( inputs[0] ), bufferSize, (size_t)batchCount, (uint8_t*)outputs );
 
-            if constexpr ( MetaOutMulti == 2 && MetaInMulti == 3 )
+            for( int64 j = 0; j < batchCount; j++ )
             {
-                const uint64 h0 = Swap64( output[0] );
-                const uint64 h1 = Swap64( output[1] );
+                const int64   i      = batchStart + j;
+                const uint64* output = outputs[j];
+                auto&         mOut   = metaOut[i];
 
-                mOut = h0 << ySize | h1 >> 26;
-            }
-            else if constexpr ( MetaOutMulti == 3 )
-            {
-                const uint64 h0 = Swap64( output[0] );
-                const uint64 h1 = Swap64( output[1] );
-                const uint64 h2 = Swap64( output[2] );
+                const uint64 f = Swap64( *output ) >> yShift;
+                yOut[i] = (TYOut)f;
 
-                mOut.m0 = h0 << ySize | h1 >> 26;
-                mOut.m1 = ((h1 << 6) & 0xFFFFFFC0) | h2 >> 58;
-            }
-            else if constexpr ( MetaOutMulti == 4 && MetaInMulti != 2 ) // In = 2 is calculated above with L + R
-            {
-                const uint64 h0 = Swap64( output[0] );
-                const uint64 h1 = Swap64( output[1] );
-                const uint64 h2 = Swap64( output[2] );
+                if constexpr ( MetaOutMulti == 2 && MetaInMulti == 3 )
+                {
+                    const uint64 h0 = Swap64( output[0] );
+                    const uint64 h1 = Swap64( output[1] );
 
-                mOut.m0 = h0 << ySize | h1 >> 26;
-                mOut.m1 = h1 << 38    | h2 >> 26;
+                    mOut = h0 << ySize | h1 >> 26;
+                }
+                else if constexpr ( MetaOutMulti == 3 )
+                {
+                    const uint64 h0 = Swap64( output[0] );
+                    const uint64 h1 = Swap64( output[1] );
+                    const uint64 h2 = Swap64( output[2] );
+
+                    mOut.m0 = h0 << ySize | h1 >> 26;
+                    mOut.m1 = ((h1 << 6) & 0xFFFFFFC0) | h2 >> 58;
+                }
+                else if constexpr ( MetaOutMulti == 4 && MetaInMulti != 2 ) // In = 2 is calculated above with L + R
+                {
+                    const uint64 h0 = Swap64( output[0] );
+                    const uint64 h1 = Swap64( output[1] );
+                    const uint64 h2 = Swap64( output[2] );
+
+                    mOut.m0 = h0 << ySize | h1 >> 26;
+                    mOut.m1 = h1 << 38    | h2 >> 26;
+                }
             }
         }
     }
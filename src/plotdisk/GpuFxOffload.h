@@ -0,0 +1,35 @@
+#pragma once
+#include "plotting/PlotTypes.h"
+#include "plotting/Tables.h"
+#include "util/Span.h"
+
+///
+/// Generates the fx of diskplot buckets on a GPU, using the k32 harvester fx kernels.
+/// Sorting and matching stay on the CPU, as the pairs must be written in a deterministic order.
+///
+class IGpuFxOffload
+{
+public:
+    inline virtual ~IGpuFxOffload() {}
+
+    /// Generates the y and metadata of a bucket's matches.
+    /// yIn holds the y-sorted entries of the bucket, without the bucket bits, which are given in yMask.
+    /// metaIn holds their y-sorted metadata, of metaInSize bytes each.
+    /// The matches are given as consecutive slices, from which the first matchCount are used.
+    /// Returns false on a device error.
+    virtual bool GenFx( TableId rTable, uint64 yMask, uint32 entryCount, const uint32* yIn,
+                        const void* metaIn, size_t metaInSize, size_t metaOutSize,
+                        const Span<Pair>* pairSlices, uint32 sliceCount, uint32 matchCount ) = 0;
+
+    /// Output of the last GenFx() call, in match order. Table 7 has no metadata output.
+    virtual const uint64* OutY()    const = 0;
+    virtual const void*   OutMeta() const = 0;
+};
+
+class CudaFxOffloadFactory
+{
+public:
+    /// Returns nullptr if CUDA is not available or the device could not be initialized.
+    /// maxEntries is the largest entry or match count of a bucket.
+    static IGpuFxOffload* Create( uint32 deviceIndex, uint32 maxEntries );
+};
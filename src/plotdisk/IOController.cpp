@@ -0,0 +1,83 @@
+#include "IOController.h"
+#include "util/Log.h"
+#include "util/Util.h"
+
+static constexpr uint32 MIN_QUEUE_DEPTH     = 4;
+static constexpr uint32 INITIAL_QUEUE_DEPTH = 32;
+static constexpr double MIN_GAIN            = 0.05;    // Throughput improvement required to keep a new depth
+static constexpr double IO_BOUND_WAIT       = 0.02;    // Buffer wait fraction above which a table is considered I/O-bound
+
+//-----------------------------------------------------------
+IOController::IOController( const char* name, const uint32 maxDepth )
+    : _name    ( name )
+    , _maxDepth( std::max( maxDepth, MIN_QUEUE_DEPTH ) )
+    , _depth   ( std::min( INITIAL_QUEUE_DEPTH, _maxDepth ) )
+{}
+
+//-----------------------------------------------------------
+void IOController::Update( const uint32 phase, const double bufferWaitFraction )
+{
+    const uint64 bytes   = _bytes  .exchange( 0, std::memory_order_relaxed );
+    const uint64 busyNs  = _busyNs .exchange( 0, std::memory_order_relaxed );
+    const uint64 submits = _submits.exchange( 0, std::memory_order_relaxed );
+
+    // Nothing went through batched I/O in this table
+    if( submits == 0 || busyNs == 0 )
+        return;
+
+    ASSERT( phase < MAX_PHASES );
+    PhaseState& ps = _phases[std::min( phase, MAX_PHASES-1 )];
+
+    const uint32 depth      = _depth.load( std::memory_order_relaxed );
+    const double throughput = (double)bytes / ( (double)busyNs / 1e9 );
+    const bool   ioBound    = bufferWaitFraction > IO_BOUND_WAIT;
+
+    if( ps.bestDepth == 0 )
+    {
+        ps.bestDepth      = depth;
+        ps.bestThroughput = throughput;
+        ps.direction      = 1;
+    }
+    else if( throughput > ps.bestThroughput * ( 1.0 + MIN_GAIN ) )
+    {
+        ps.bestDepth      = depth;
+        ps.bestThroughput = throughput;
+    }
+    else if( depth == ps.bestDepth )
+    {
+        // Tables differ in size, so keep the baseline current
+        ps.bestThroughput = throughput;
+    }
+    else if( !ps.reversed )
+    {
+        ps.direction = -ps.direction;
+        ps.reversed  = true;
+    }
+    else
+        ps.settled = true;
+
+    uint32 nextDepth = ps.bestDepth;
+
+    // There's no point in queueing more requests when the producers are not waiting on I/O
+    if( !ps.settled && ( ioBound || ps.direction < 0 ) )
+    {
+        nextDepth = ps.direction > 0 ? std::min( ps.bestDepth * 2, _maxDepth )
+                                     : std::max( ps.bestDepth / 2, MIN_QUEUE_DEPTH );
+
+        if( nextDepth == ps.bestDepth )
+        {
+            if( ps.reversed )
+                ps.settled = true;
+            else
+            {
+                ps.direction = -ps.direction;
+                ps.reversed  = true;
+            }
+        }
+    }
+
+    _depth.store( nextDepth, std::memory_order_relaxed );
+
+    Log::Line( " %s I/O: %.2lf MiB/s, %.2lf ms per batch, %.1lf%% buffer wait. Queue depth %u -> %u.",
+        _name, throughput BtoMB, (double)busyNs / (double)submits / 1e6, bufferWaitFraction * 100.0, depth, nextDepth );
+}
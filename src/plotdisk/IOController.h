@@ -0,0 +1,51 @@
+#pragma once
+#include <atomic>
+
+/**
+ * Tunes how many requests an I/O command thread keeps in flight per batch submission (its queue depth).
+ * The I/O thread records every batch it submits, and the plotter calls Update() at each table boundary.
+ * Phase 1 is write-heavy and Phase 3 read-heavy, so each phase climbs to its own best depth:
+ * the depth is doubled or halved while device throughput keeps improving, and reverts to the best one seen otherwise.
+ * The depth is only grown while the producers are actually blocked waiting for I/O buffers.
+ */
+class IOController
+{
+public:
+    static constexpr uint32 MAX_PHASES = 4;
+
+    IOController( const char* name, uint32 maxDepth );
+
+    // Called by the I/O thread, after a batch was submitted
+    inline void RecordSubmit( const size_t bytes, const Duration elapsed )
+    {
+        _bytes  .fetch_add( bytes, std::memory_order_relaxed );
+        _busyNs .fetch_add( (uint64)TicksToNanoSeconds( elapsed ), std::memory_order_relaxed );
+        _submits.fetch_add( 1, std::memory_order_relaxed );
+    }
+
+    // Maximum requests to keep in flight. Read by the I/O thread before each submission.
+    inline uint32 QueueDepth() const { return _depth.load( std::memory_order_relaxed ); }
+
+    // Called by the user thread once a table has completed.
+    // bufferWaitFraction is the fraction of the table's time the producers spent blocked on I/O buffers.
+    void Update( uint32 phase, double bufferWaitFraction );
+
+private:
+    struct PhaseState
+    {
+        uint32 bestDepth      = 0;      // 0 until the phase has a sample
+        double bestThroughput = 0;
+        int32  direction      = 0;      // +1 growing, -1 shrinking
+        bool   reversed       = false;
+        bool   settled        = false;
+    };
+
+    const char*         _name;
+    uint32              _maxDepth;
+    std::atomic<uint32> _depth;
+    PhaseState          _phases[MAX_PHASES];
+
+    std::atomic<uint64> _bytes   = 0;
+    std::atomic<uint64> _busyNs  = 0;
+    std::atomic<uint64> _submits = 0;
+};
@@ -7,6 +7,8 @@
 #include "plotdisk/DiskBufferQueue.h"
 #include "CTableWriterBounded.h"
 #include "plotting/PlotTools.h"
+#include "plotting/PlotBenchmark.h"
+#include "util/PerfCounters.h"
 
 #include "F1Bounded.inl"
 #include "FxBounded.inl"
@@ -21,24 +23,7 @@ K32BoundedPhase1::K32BoundedPhase1( DiskPlotContext& context )
 
     // Open files
     // Temp1
-    {
-        const FileSetOptions tmp1Options = context.cfg->noTmp1DirectIO ? FileSetOptions::None : FileSetOptions::DirectIO;
-
-        _ioQueue.InitFileSet( FileId::T1, "t1", 1, tmp1Options, nullptr );  // X (sorted on Y)
-        _ioQueue.InitFileSet( FileId::T2, "t2", 1, tmp1Options, nullptr );  // Back pointers
-        _ioQueue.InitFileSet( FileId::T3, "t3", 1, tmp1Options, nullptr );
-        _ioQueue.InitFileSet( FileId::T4, "t4", 1, tmp1Options, nullptr );
-        _ioQueue.InitFileSet( FileId::T5, "t5", 1, tmp1Options, nullptr );
-        _ioQueue.InitFileSet( FileId::T6, "t6", 1, tmp1Options, nullptr );
-        _ioQueue.InitFileSet( FileId::T7, "t7", 1, tmp1Options, nullptr );
-
-        _ioQueue.InitFileSet( FileId::MAP2, "map2", numBuckets, tmp1Options, nullptr );
-        _ioQueue.InitFileSet( FileId::MAP3, "map3", numBuckets, tmp1Options, nullptr );
-        _ioQueue.InitFileSet( FileId::MAP4, "map4", numBuckets, tmp1Options, nullptr );
-        _ioQueue.InitFileSet( FileId::MAP5, "map5", numBuckets, tmp1Options, nullptr );
-        _ioQueue.InitFileSet( FileId::MAP6, "map6", numBuckets, tmp1Options, nullptr );
-        _ioQueue.InitFileSet( FileId::MAP7, "map7", numBuckets, tmp1Options, nullptr );
-    }
+    InitTableFiles( context );
 
     // Temp2
     {
@@ -47,6 +32,8 @@ K32BoundedPhase1::K32BoundedPhase1( DiskPlotContext& context )
         
         if( !context.cfg->noTmp2DirectIO )
             opts |= FileSetOptions::DirectIO;
+        else if( context.cfg->tmp2PageCache )
+            opts |= FileSetOptions::PageCache;
 
         opts |= FileSetOptions::UseTemp2;
 
@@ -105,13 +92,26 @@ K32BoundedPhase1::K32BoundedPhase1( DiskPlotContext& context )
         }
         else
         {
-            InitCachableFileSet( FileId::FX0   , "y0"    , numBuckets, opts, data );
+            // Only the y and meta files written by F1 and the odd tables are resident.
+            // F1's y and x buckets are the same size, so the memory is split evenly between them.
+            const size_t residentSize = context.resident ? context.residentSize / 2 : 0;
+
+            data.residentBuffer = context.resident;
+            data.residentSize   = residentSize;
+            InitCachableFileSet( FileId::FX0   , "y0"    , numBuckets, opts | FileSetOptions::Resident, data );
+
+            data.residentSize = 0;
             InitCachableFileSet( FileId::FX1   , "y1"    , numBuckets, opts, data );
             InitCachableFileSet( FileId::INDEX0, "index0", numBuckets, opts, data );
             InitCachableFileSet( FileId::INDEX1, "index1", numBuckets, opts, data );
 
             data.cacheSize = metaCacheSize;
-            InitCachableFileSet( FileId::META0, "meta0", numBuckets, opts, data );
+
+            data.residentBuffer = context.resident + residentSize;
+            data.residentSize   = residentSize;
+            InitCachableFileSet( FileId::META0, "meta0", numBuckets, opts | FileSetOptions::Resident, data );
+
+            data.residentSize = 0;
             InitCachableFileSet( FileId::META1, "meta1", numBuckets, opts, data );
         }
     }
@@ -121,6 +121,31 @@ K32BoundedPhase1::K32BoundedPhase1( DiskPlotContext& context )
 K32BoundedPhase1::~K32BoundedPhase1()
 {}
 
+//-----------------------------------------------------------
+void K32BoundedPhase1::InitTableFiles( DiskPlotContext& context )
+{
+    DiskBufferQueue& ioQueue    = *context.ioQueue;
+    const uint32     numBuckets = context.numBuckets;
+
+    const FileSetOptions tmp1Options = !context.cfg->noTmp1DirectIO ? FileSetOptions::DirectIO  :
+                                        context.cfg->tmp1PageCache  ? FileSetOptions::PageCache : FileSetOptions::None;
+
+    ioQueue.InitFileSet( FileId::T1, "t1", 1, tmp1Options, nullptr );  // X (sorted on Y)
+    ioQueue.InitFileSet( FileId::T2, "t2", 1, tmp1Options, nullptr );  // Back pointers
+    ioQueue.InitFileSet( FileId::T3, "t3", 1, tmp1Options, nullptr );
+    ioQueue.InitFileSet( FileId::T4, "t4", 1, tmp1Options, nullptr );
+    ioQueue.InitFileSet( FileId::T5, "t5", 1, tmp1Options, nullptr );
+    ioQueue.InitFileSet( FileId::T6, "t6", 1, tmp1Options, nullptr );
+    ioQueue.InitFileSet( FileId::T7, "t7", 1, tmp1Options, nullptr );
+
+    ioQueue.InitFileSet( FileId::MAP2, "map2", numBuckets, tmp1Options, nullptr );
+    ioQueue.InitFileSet( FileId::MAP3, "map3", numBuckets, tmp1Options, nullptr );
+    ioQueue.InitFileSet( FileId::MAP4, "map4", numBuckets, tmp1Options, nullptr );
+    ioQueue.InitFileSet( FileId::MAP5, "map5", numBuckets, tmp1Options, nullptr );
+    ioQueue.InitFileSet( FileId::MAP6, "map6", numBuckets, tmp1Options, nullptr );
+    ioQueue.InitFileSet( FileId::MAP7, "map7", numBuckets, tmp1Options, nullptr );
+}
+
 //-----------------------------------------------------------
 size_t K32BoundedPhase1::GetRequiredSize( const uint32 numBuckets, const size_t t1BlockSize, const size_t t2BlockSize, const uint32 threadCount )
 {
@@ -133,10 +158,10 @@ size_t K32BoundedPhase1::GetRequiredSize( const uint32 numBuckets, const size_t
 
     switch( numBuckets )
     {
-        case 64 : DiskPlotFxBounded<TableId::Table4,64 >::GetRequiredHeapSize( allocator, t1BlockSize, t2BlockSize, threadCount ); break;
-        case 128: DiskPlotFxBounded<TableId::Table4,128>::GetRequiredHeapSize( allocator, t1BlockSize, t2BlockSize, threadCount ); break;
-        case 256: DiskPlotFxBounded<TableId::Table4,256>::GetRequiredHeapSize( allocator, t1BlockSize, t2BlockSize, threadCount ); break;
-        case 512: DiskPlotFxBounded<TableId::Table4,512>::GetRequiredHeapSize( allocator, t1BlockSize, t2BlockSize, threadCount ); break;
+        case 64 : DiskPlotFxBounded<TableId::Table3,64 >::GetRequiredHeapSize( allocator, t1BlockSize, t2BlockSize, threadCount ); break;
+        case 128: DiskPlotFxBounded<TableId::Table3,128>::GetRequiredHeapSize( allocator, t1BlockSize, t2BlockSize, threadCount ); break;
+        case 256: DiskPlotFxBounded<TableId::Table3,256>::GetRequiredHeapSize( allocator, t1BlockSize, t2BlockSize, threadCount ); break;
+        case 512: DiskPlotFxBounded<TableId::Table3,512>::GetRequiredHeapSize( allocator, t1BlockSize, t2BlockSize, threadCount ); break;
 
         default:
             Panic( "Invalid bucket count %u.", numBuckets );
@@ -213,6 +238,8 @@ void K32BoundedPhase1::RunWithBuckets()
 #if !( defined( _DEBUG ) && defined( BB_DP_DBG_SKIP_TO_C_TABLES ) )
     for( TableId table = startTable; table <= TableId::Table7; table++ )
     {
+        _ioQueue.SetIOAccountingStage( 1, table );
+
         switch( table )
         {
             case TableId::Table2: RunFx<TableId::Table2, _numBuckets>(); break;
@@ -294,7 +321,10 @@ void K32BoundedPhase1::RunF1()
     Log::Line( "Table 1 I/O wait time: %.2lf seconds.", _context.p1TableWaitTime[(int)TableId::Table1] );
     
     _context.ioWaitTime += _context.p1TableWaitTime[(int)TableId::Table1];
+    PlotBenchmark::RecordTable( 1, TableId::Table1, elapsed, TicksToSeconds( _context.p1TableWaitTime[(int)TableId::Table1] ) );
+    PerfCounters::RecordTable( 1, TableId::Table1, elapsed );
     _context.ioQueue->DumpWriteMetrics( TableId::Table1 );
+    _context.ioQueue->AdaptIO( 1 );
 }
 
 //-----------------------------------------------------------
@@ -332,12 +362,16 @@ void K32BoundedPhase1::RunFx()
         #endif
     );
 
-    Log::Line( "Completed table %u in %.2lf seconds with %.llu entries.", table+1, TimerEnd( timer ), _context.entryCounts[(int)table] );
+    const double elapsed = TimerEnd( timer );
+    Log::Line( "Completed table %u in %.2lf seconds with %.llu entries.", table+1, elapsed, _context.entryCounts[(int)table] );
     Log::Line( "Table %u I/O wait time: %.2lf seconds.",  table+1, TicksToSeconds( fx._tableIOWait ) );
     
     _context.ioQueue->DumpDiskMetrics( table );
+    _context.ioQueue->AdaptIO( 1 );
     _context.p1TableWaitTime[(int)table] = fx._tableIOWait;
     _context.ioWaitTime += fx._tableIOWait;
+    PlotBenchmark::RecordTable( 1, table, elapsed, TicksToSeconds( fx._tableIOWait ) );
+    PerfCounters::RecordTable( 1, table, elapsed );
 
     #if _DEBUG
     {
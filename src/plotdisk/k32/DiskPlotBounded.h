@@ -15,6 +15,9 @@ public:
 
     static size_t GetRequiredSize( const uint32 numBuckets, const size_t t1BlockSize, const size_t t2BlockSize, const uint32 threadCount );
 
+    // Opens the temp1 back pointer and map files, which Phases 2 and 3 read
+    static void InitTableFiles( DiskPlotContext& context );
+
 private:
 
     template<uint32 _numBuckets>
@@ -58,8 +58,14 @@ public:
 
         _blockBuffer = allocator.CAllocSpan<uint32>( blockBufferSize );
 
-        _yEntries[0] = allocator.CAllocSpan<uint32>( entriesPerBucketAligned, context.tmp2BlockSize );
-        _yEntries[1] = allocator.CAllocSpan<uint32>( entriesPerBucketAligned, context.tmp2BlockSize );
+        // With --f1-x-only, table 2 computes y from x, so we don't write it
+        _xOnly = context.cfg && context.cfg->f1XOnly;
+
+        if( !_xOnly )
+        {
+            _yEntries[0] = allocator.CAllocSpan<uint32>( entriesPerBucketAligned, context.tmp2BlockSize );
+            _yEntries[1] = allocator.CAllocSpan<uint32>( entriesPerBucketAligned, context.tmp2BlockSize );
+        }
         _xEntries[0] = allocator.CAllocSpan<uint32>( entriesPerBucketAligned, context.tmp2BlockSize );
         _xEntries[1] = allocator.CAllocSpan<uint32>( entriesPerBucketAligned, context.tmp2BlockSize );
 
@@ -119,7 +125,8 @@ public:
         _context.fencePool->RestoreAllFences();
 
         #if ( _DEBUG && BB_DP_DBG_VALIDATE_F1 )
-            DbgValidateF1( _context );
+            if( !_xOnly )
+                DbgValidateF1( _context );
         #endif
     }
 
@@ -156,21 +163,35 @@ private:
         const uint32 yBits = _k + kExtraBits - bucketBits;
         const uint32 yMask = (uint32)(( 1ull << yBits ) - 1);
 
-        for( uint32 i = 0; i < entryCount; i++ )
+        if( _xOnly )
         {
-                  uint32 y   = Swap32( blocks[i] );
-            const uint32 dst = --pfxSum[y >> bucketBitShift];
-            const uint32 x   = xStart + i;
-            ASSERT( dst < _maxEntriesPerIOBucket );
+            for( uint32 i = 0; i < entryCount; i++ )
+            {
+                const uint32 dst = --pfxSum[Swap32( blocks[i] ) >> bucketBitShift];
+                ASSERT( dst < _maxEntriesPerIOBucket );
 
-            yEntries[dst] = ( ( (uint64)y << kExtraBits ) | ( x >> kMinusKExtraBits ) ) & yMask;
-            xEntries[dst] = x;
+                xEntries[dst] = xStart + i;
+            }
+        }
+        else
+        {
+            for( uint32 i = 0; i < entryCount; i++ )
+            {
+                      uint32 y   = Swap32( blocks[i] );
+                const uint32 dst = --pfxSum[y >> bucketBitShift];
+                const uint32 x   = xStart + i;
+                ASSERT( dst < _maxEntriesPerIOBucket );
+
+                yEntries[dst] = ( ( (uint64)y << kExtraBits ) | ( x >> kMinusKExtraBits ) ) & yMask;
+                xEntries[dst] = x;
+            }
         }
 
         // Write to disk (and synchronize threads)
         if( self->BeginLockBlock() )
         {
-            _ioQueue.WriteBucketElementsT( FileId::FX0  , true, yEntries.Ptr(), alignedElementCounts.Ptr(), elementCounts.Ptr() );
+            if( !_xOnly )
+                _ioQueue.WriteBucketElementsT( FileId::FX0, true, yEntries.Ptr(), alignedElementCounts.Ptr(), elementCounts.Ptr() );
             _ioQueue.WriteBucketElementsT( FileId::META0, true, xEntries.Ptr(), alignedElementCounts.Ptr(), elementCounts.Ptr() );
             _ioQueue.SignalFence( _writeFence, bucket+2 );
             _ioQueue.CommitCommands();
@@ -224,6 +245,7 @@ private:
     uint32       _alignedElementCounts[2][_numBuckets] = {};
     
     Span<Span<uint32>> _offsets;
+    bool               _xOnly = false;
 
 #if _DEBUG
     uint32 _maxEntriesPerIOBucket;
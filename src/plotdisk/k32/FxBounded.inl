@@ -5,10 +5,13 @@
 #include "plotdisk/BitBucketWriter.h"
 #include "plotdisk/MapWriter.h"
 #include "plotdisk/BlockWriter.h"
+#include "plotdisk/BoundedPairDeltas.h"
 #include "plotmem/LPGen.h"
 #include "util/StackAllocator.h"
 #include "FpMatchBounded.inl"
+#include "plotdisk/GpuFxOffload.h"
 #include "b3/blake3.h"
+#include "pos/chacha8.h"
 
 #if _DEBUG
     #include "algorithm/RadixSort.h"
@@ -69,6 +72,7 @@ public:
         , _fxWriteFence  ( context.fencePool ? context.fencePool->RequireFence() : *(Fence*)nullptr )
         , _pairWriteFence( context.fencePool ? context.fencePool->RequireFence() : *(Fence*)nullptr )
         , _mapWriteFence ( context.fencePool ? context.fencePool->RequireFence() : *(Fence*)nullptr )
+        , _xWriteFence   ( context.fencePool ? context.fencePool->RequireFence() : *(Fence*)nullptr )
     #if BB_DP_FP_MATCH_X_BUCKET
 
     #endif
@@ -98,7 +102,14 @@ public:
             }
 
             _compressPlot = context.cfg->globalCfg->compressionLevel > 0;
+            _f1XOnly      = rTable == TableId::Table2 && context.cfg->f1XOnly;
+
+            #if BB_DP_FP_MATCH_X_BUCKET
+                FatalIf( _f1XOnly, "--f1-x-only is not supported with cross-bucket matching." );
+            #endif
         }
+
+        _gpuFx = context.gpuFx;
     }
 
     //-----------------------------------------------------------
@@ -111,7 +122,10 @@ public:
     {
         DiskPlotContext cx = {};
 
-        DiskPlotFxBounded<TableId::Table4, _numBuckets> instance( cx );
+        // Table 3 has the same buffers as table 4, plus the x writer when compressing,
+        // so it gives us the largest heap requirement across tables.
+        DiskPlotFxBounded<TableId::Table3, _numBuckets> instance( cx );
+        instance._compressPlot = true;
         instance.AllocateBuffers( allocator, t1BlockSize, t2BlockSize, threadCount, true );
     }
 
@@ -189,12 +203,16 @@ public:
         
         if constexpr ( rTable == TableId::Table2 )
         {
-            const FileId xFileId = _compressPlot ? FileId::T2 : FileId::T1;
-
-            _xWriter = BlockWriter<uint32>( allocator, xFileId, _mapWriteFence, t1BlockSize, entriesPerBucket );
+            // Compressed plots drop table 1, so x is not written
+            if( !_compressPlot )
+                _xWriter = BlockWriter<uint32>( allocator, FileId::T1, _xWriteFence, t1BlockSize, entriesPerBucket );
         }
         else
         {
+            // Compressed table 2 is written as x line points while sorting it for table 3
+            if( rTable == TableId::Table3 && _compressPlot )
+                _xWriter = BlockWriter<uint32>( allocator, FileId::T2, _xWriteFence, t1BlockSize, entriesPerBucket );
+
             _mapWriteBuffer = allocator.CAllocSpan<uint64>  ( entriesPerBucket, t1BlockSize );
             ASSERT( (uintptr_t)_mapWriteBuffer.Ptr() / t1BlockSize * t1BlockSize == (uintptr_t)_mapWriteBuffer.Ptr() );
 
@@ -315,6 +333,8 @@ public:
         }
         #endif
 
+        if( _f1XOnly )
+            Log::Line( " F1 y         : Completed in %.2lf seconds.", TicksToSeconds( _f1Time    ) );
         Log::Line( " Sorting      : Completed in %.2lf seconds.", TicksToSeconds( _sortTime  ) );
         Log::Line( " Distribution : Completed in %.2lf seconds.", TicksToSeconds( _distributeTime ) );
         Log::Line( " Matching     : Completed in %.2lf seconds.", TicksToSeconds( _matchTime ) );
@@ -360,7 +380,11 @@ private:
         for( uint32 bucket = 0; bucket < _numBuckets; bucket++ )
         {
             ReadNextBucket( self, bucket + 1 ); // Read next bucket in background
-            WaitForFence( self, _yReadFence, bucket );
+
+            if( _f1XOnly )
+                GenerateYFromX( self, bucket );
+            else
+                WaitForFence( self, _yReadFence, bucket );
 
             Span<uint32> yInput     = _y[bucket];
             const uint32 entryCount = (uint32)yInput.Length();
@@ -450,21 +474,18 @@ private:
 
             if constexpr ( rTable == TableId::Table2 )
             {
-                // #TODO: Simplify this, allowing BlockWriter to let the user specify a buffer, like in BitWriter
-                // Get and set shared x buffer for other threads
-                if( self->BeginLockBlock() )
+                if( !_compressPlot )
                 {
-                    const uint64 xBufferLength = _compressPlot ? totalMatches : entryCount;
+                    // #TODO: Simplify this, allowing BlockWriter to let the user specify a buffer, like in BitWriter
+                    // Get and set shared x buffer for other threads
+                    if( self->BeginLockBlock() )
+                        _xWriteBuffer = Span<uint32>( _xWriter.GetNextBuffer( _tableIOWait ), entryCount );
+                    self->EndLockBlock();
 
-                    _xWriteBuffer = Span<uint32>( _xWriter.GetNextBuffer( _tableIOWait ), xBufferLength );
+                    // Grab shared buffer
+                    xWriteBuffer = _xWriteBuffer;
+                    metaIn       = xWriteBuffer;
                 }
-                self->EndLockBlock();
-
-                xWriteBuffer = _xWriteBuffer;
-                
-                // Grab shared buffer
-                if( !_compressPlot )
-                    metaIn = xWriteBuffer;
             }
 
             SortOnYKey( self, sortKey, metaUnsorted, metaIn );
@@ -476,21 +497,27 @@ private:
             // On Table 2, metadata is our x values, which have to be saved as table 1
             if constexpr ( rTable == TableId::Table2 )
             {
-                if( _compressPlot )
-                    CompressTable1( self, matchOffset, matches, metaIn, xWriteBuffer );
-                
                 // Write (sorted-on-y) x back to disk
-                if( self->BeginLockBlock() )
+                if( !_compressPlot )
                 {
-                    #if DBG_VALIDATE_TABLES
-                        _dbgPlot.WriteYX( bucket, yInput, metaIn );
-                    #endif
+                    if( self->BeginLockBlock() )
+                    {
+                        #if DBG_VALIDATE_TABLES
+                            _dbgPlot.WriteYX( bucket, yInput, metaIn );
+                        #endif
 
-                    _xWriter.SubmitBuffer( _ioQueue, xWriteBuffer.Length() );
-                    if( bucket == _numBuckets - 1 )
-                        _xWriter.SubmitFinalBlock( _ioQueue );
+                        _xWriter.SubmitBuffer( _ioQueue, xWriteBuffer.Length() );
+                        if( bucket == _numBuckets - 1 )
+                            _xWriter.SubmitFinalBlock( _ioQueue );
+                    }
+                    self->EndLockBlock();
                 }
-                self->EndLockBlock();
+            }
+            else if constexpr ( rTable == TableId::Table3 )
+            {
+                // On Table 3, metadata is table 2's x pairs
+                if( _compressPlot )
+                    CompressTable2( self, bucket, metaIn );
             }
 
             /// Gen fx & write
@@ -508,7 +535,10 @@ private:
                         GenCrossBucketFx( self, bucket-1 );
                 #endif
 
-                GenFx( self, bucket, matches, yInput, metaIn, yOut, metaOut );
+                if( _gpuFx )
+                    GenFxOnGpu( self, bucket, totalMatches, matchOffset, yInput, metaIn, yOut, metaOut );
+                else
+                    GenFx( self, bucket, matches, yInput, metaIn, yOut, metaOut );
                 self->SyncThreads();
 
                 if( self->IsControlThread() )
@@ -547,48 +577,44 @@ private:
         }
     }
 
+    /// Compressed plots store table 2 as line points of its (truncated) x pairs, in place of table 1.
+    /// Table 3's pairs point to table 2 by its y-sorted order, which the table 2 pairs do not have,
+    /// so we build the line points here, from table 2's y-sorted metadata, which is just x1 and x2.
     //-----------------------------------------------------------
-    void CompressTable1( Job* self, const uint64 matchOffset, const Span<Pair> pairs, const Span<uint32> inXEntries, Span<uint32> outXEntries )
+    void CompressTable2( Job* self, const uint32 bucket, const Span<K32Meta2> metaIn )
     {
-#if _DEBUG
-        uint64 numRepeated = 0;
-#endif
+        if( self->BeginLockBlock() )
+            _xWriteBuffer = Span<uint32>( _xWriter.GetNextBuffer( _tableIOWait ), metaIn.Length() );
+        self->EndLockBlock();
+
         const uint32 entryBits = _context.cfg->globalCfg->compressedEntryBits;
         const uint32 shift     = 32 - entryBits;
 
-        for( uint64 i = 0; i < pairs.Length(); i++ )
-        {
-            const Pair p = pairs[i];
+        uint32 count, offset, _;
+        GetThreadOffsets( self, (uint32)metaIn.Length(), count, offset, _ );
 
-            const uint32 x1 = inXEntries[p.left ] >> shift;
-            const uint32 x2 = inXEntries[p.right] >> shift;
+        Span<uint32> outXEntries = _xWriteBuffer;
+
+        for( uint32 i = offset; i < offset + count; i++ )
+        {
+            const uint32 x1 = (uint32)( metaIn[i] >> 32 ) >> shift;
+            const uint32 x2 = (uint32)( metaIn[i]       ) >> shift;
 
-            // Convert to linepoint            
+            // Convert to linepoint
             const uint32 x12 = (uint32)SquareToLinePoint( x2, x1 );
             ASSERT( !(x12 & 1ul << 31 ) );
             ASSERT( !(x12 & (1ul << (entryBits*2-1)) ) );
 
-// #if _DEBUG
-//             const BackPtr deconverted = LinePointToSquare64( x12 ) ;
-
-//             if( x1 == x2 )
-//                 numRepeated ++;
-//             else
-//             {
-//                 ASSERT( ( deconverted.x == x1 && deconverted.y == x2 ) || 
-//                         ( deconverted.x == x2 && deconverted.y == x1 ) );
-//             }
-// #endif
-            // const uint32 x12 = (x2 & 0xFFFF0000) | ( x1 >> 16 );
-            // const uint32 x12 = (x2 << shift) | x1;
-            outXEntries[matchOffset+i] = x12;
+            outXEntries[i] = x12;
         }
 
-// #if _DEBUG
-//         Log::WriteLine( "[%u] %llu / %llu : %.2lf", self->JobId(), 
-//             numRepeated, pairs.Length(),
-//              numRepeated / (double)pairs.Length() );
-// #endif
+        if( self->BeginLockBlock() )
+        {
+            _xWriter.SubmitBuffer( _ioQueue, metaIn.Length() );
+            if( bucket == _numBuckets - 1 )
+                _xWriter.SubmitFinalBlock( _ioQueue );
+        }
+        self->EndLockBlock();
     }
 
     //-----------------------------------------------------------
@@ -714,6 +740,10 @@ private:
     }
     
 #if BB_DP_FP_MATCH_X_BUCKET
+    // Cross-bucket pairs are written ahead of the bucket's own pairs, but their lefts are neither chained to
+    // the previous bucket's last pair nor accounted for in the bucket's left delta bit size.
+    #error "BB_DP_FP_MATCH_X_BUCKET is not supported with delta-encoded pair lefts."
+
     //-----------------------------------------------------------
     void SaveCrossBucketMetadata( Job* self, const uint32 bucket, const Span<TMetaIn> metaIn )
     {
@@ -739,11 +769,11 @@ private:
             pairs[i].AddOffset( offset );
 
         // Bit-serialize
-        uint64 bitBucketSizes = pairs.Length() * _pairBitSize;
+        uint64 bitBucketSizes = pairs.Length() * ( _pairLeftBits + _pairsRightBits );
         _pairBitWriter.BeginWriteBuckets( &bitBucketSizes, _crossBucketWriteBuffer );
 
         BitWriter writer = _pairBitWriter.GetWriter( 0, 0 );
-        PackPairs( self, pairs, writer );
+        PackPairs( self, pairs, writer, pairs[0].left );
 
         // #TODO: Keep a different buffer? But for now, we have to remove the offsets, as we
         //        still have to perform cross-bucket fx with them
@@ -822,7 +852,12 @@ private:
                      const Span<Pair> matches, const uint64 dstOffset )
     {
         ASSERT( dstOffset + matches.length <= totalMatchCount );
-        
+
+        // Left entries are sorted within a bucket, so we store them as deltas to the previous pair's,
+        // which need a lot less bits than the full bucket-local index.
+        const uint32 prevLeft = GetPrevPairLeft( self );
+        _pairMaxLeftDelta[self->JobId()] = GetMaxLeftDelta( matches, prevLeft );
+
         if( self->BeginLockBlock() )
         {
             // Wait for our write buffer to be ready to use again
@@ -835,19 +870,27 @@ private:
                 #endif
             }
 
+            uint32 maxLeftDelta = 0;
+            for( uint32 i = 0; i < self->JobCount(); i++ )
+                maxLeftDelta = std::max( maxLeftDelta, _pairMaxLeftDelta[i] );
+
+            _pairLeftBits = BoundedPairDeltas::GetLeftBits( maxLeftDelta );
+            ASSERT( _pairLeftBits <= _pairsLeftBits );
+
+            _context.ptrTableBucketLeftBits[(int)rTable][bucket] = (uint8)_pairLeftBits;
+
             // Ready the bit-writer for serialization
-            uint64 bitBucketSizes = (uint64)totalMatchCount * _pairBitSize;
+            uint64 bitBucketSizes = (uint64)totalMatchCount * ( _pairLeftBits + _pairsRightBits );
             _pairBitWriter.BeginWriteBuckets( &bitBucketSizes, _pairsWriteBuffer );
         }
         self->EndLockBlock();
 
-        // #NOTE: For now we write compressed as in standard FP.        
-        BitWriter writer = _pairBitWriter.GetWriter( 0, dstOffset * _pairBitSize );
+        BitWriter writer = _pairBitWriter.GetWriter( 0, dstOffset * ( _pairLeftBits + _pairsRightBits ) );
 
         ASSERT( matches.Length() > 2 );
-        PackPairs( self, matches.SliceSize( 2 ), writer );
+        PackPairs( self, matches.SliceSize( 2 ), writer, prevLeft );
         self->SyncThreads();
-        PackPairs( self, matches.Slice( 2 ), writer );
+        PackPairs( self, matches.Slice( 2 ), writer, matches[1].left );
 
         // Write to disk
         if( self->BeginLockBlock() )
@@ -864,23 +907,31 @@ private:
     }
 
     //-----------------------------------------------------------
-    void PackPairs( Job* self, const Span<Pair> pairs, BitWriter& writer )
+    void PackPairs( Job* self, const Span<Pair> pairs, BitWriter& writer, uint32 prevLeft )
     {
         self;
+        BoundedPairDeltas::Pack( writer, pairs.Ptr(), pairs.Length(), prevLeft, _pairLeftBits, _pairsRightBits );
+    }
 
-        const uint32 shift = _pairsLeftBits;
-        const uint64 mask  = ( 1ull << shift ) - 1;
-
-        const Pair* pair = pairs.Ptr();
-        const Pair* end  = pair + pairs.Length();
-
-        while( pair < end )
+    /// Returns the left entry of the pair that precedes this thread's first pair in the bucket
+    //-----------------------------------------------------------
+    uint32 GetPrevPairLeft( Job* self ) const
+    {
+        for( int32 i = (int32)self->JobId() - 1; i >= 0; i-- )
         {
-            ASSERT( pair->right - pair->left < _pairsMaxDelta );
+            const Span<Pair> pairs = _pairs[i];
 
-            writer.Write( ( (uint64)(pair->right - pair->left) << shift ) | ( pair->left & mask ), _pairBitSize );
-            pair++;
+            if( pairs.Length() > 0 )
+                return pairs[pairs.Length()-1].left;
         }
+
+        return 0;
+    }
+
+    //-----------------------------------------------------------
+    static uint32 GetMaxLeftDelta( const Span<Pair> pairs, const uint32 prevLeft )
+    {
+        return BoundedPairDeltas::GetMaxLeftDelta( pairs.Ptr(), pairs.Length(), prevLeft );
     }
 
     //-----------------------------------------------------------
@@ -1104,123 +1155,171 @@ private:
         // const uint32 id         = self->JobId();
         const uint32 matchCount = (uint32)pairs.Length();
 
-        // Hashing
-        uint64 input [5]; // y + L + R
-        uint64 output[4]; // blake3 hashed output
+        // Hashing is done in batches so that blake3 can process multiple pairs in parallel SIMD lanes
+        static constexpr int64 BatchSize = 64;
 
-        blake3_hasher hasher;
+        uint64 inputs [BatchSize][5]; // y + L + R
+        uint64 outputs[BatchSize][4]; // blake3 hashed output
 
-        static_assert( bufferSize <= sizeof( input ), "Invalid fx input buffer size." );
+        static_assert( bufferSize <= sizeof( inputs[0] ), "Invalid fx input buffer size." );
 
         #if _DEBUG
             uint64 prevY    = yIn[pairs[0].left];
             uint64 prevLeft = 0;
         #endif
 
-        for( int64 i = 0; i < matchCount; i++ )
+        for( int64 batchStart = 0; batchStart < matchCount; batchStart += BatchSize )
         {
-            const auto& pair = pairs[i];
-            const uint32 left  = pair.left;
-            const uint32 right = pair.right;
-            ASSERT( left < right );
+            const int64 batchCount = std::min( BatchSize, (int64)matchCount - batchStart );
 
-            const uint64 y = yMask | (uint64)yIn[left];
+            for( int64 j = 0; j < batchCount; j++ )
+            {
+                const int64  i     = batchStart + j;
+                const auto&  pair  = pairs[i];
+                uint64*      input = inputs[j];
 
-            #if _DEBUG
-                ASSERT( y >= prevY );
-                ASSERT( left >= prevLeft );
-                prevY    = y;
-                prevLeft = left;
-            #endif
+                const uint32 left  = pair.left;
+                const uint32 right = pair.right;
+                ASSERT( left < right );
 
-            // Extract metadata
-            auto& mOut = metaOut[i];
+                const uint64 y = yMask | (uint64)yIn[left];
 
-            if constexpr( MetaInMulti == 1 )
-            {
-                const uint64 l = metaIn[left ];
-                const uint64 r = metaIn[right];
+                #if _DEBUG
+                    ASSERT( y >= prevY );
+                    ASSERT( left >= prevLeft );
+                    prevY    = y;
+                    prevLeft = left;
+                #endif
 
-                input[0] = Swap64( y << 26 | l >> 6  );
-                input[1] = Swap64( l << 58 | r << 26 );
+                // Extract metadata
+                auto& mOut = metaOut[i];
 
-                // Metadata is just L + R of 8 bytes
-                if constexpr( MetaOutMulti == 2 )
-                    mOut = l << 32 | r;
-            }
-            else if constexpr( MetaInMulti == 2 )
-            {
-                const uint64 l = metaIn[left ];
-                const uint64 r = metaIn[right];
+                if constexpr( MetaInMulti == 1 )
+                {
+                    const uint64 l = metaIn[left ];
+                    const uint64 r = metaIn[right];
 
-                input[0] = Swap64( y << 26 | l >> 38 );
-                input[1] = Swap64( l << 26 | r >> 38 );
-                input[2] = Swap64( r << 26 );
+                    input[0] = Swap64( y << 26 | l >> 6  );
+                    input[1] = Swap64( l << 58 | r << 26 );
 
-                // Metadata is just L + R again of 16 bytes
-                if constexpr( MetaOutMulti == 4 )
+                    // Metadata is just L + R of 8 bytes
+                    if constexpr( MetaOutMulti == 2 )
+                        mOut = l << 32 | r;
+                }
+                else if constexpr( MetaInMulti == 2 )
                 {
-                    mOut.m0 = l;
-                    mOut.m1 = r;
+                    const uint64 l = metaIn[left ];
+                    const uint64 r = metaIn[right];
+
+                    input[0] = Swap64( y << 26 | l >> 38 );
+                    input[1] = Swap64( l << 26 | r >> 38 );
+                    input[2] = Swap64( r << 26 );
+
+                    // Metadata is just L + R again of 16 bytes
+                    if constexpr( MetaOutMulti == 4 )
+                    {
+                        mOut.m0 = l;
+                        mOut.m1 = r;
+                    }
                 }
-            }
-            else if constexpr( MetaInMulti == 3 )
-            {
-                const uint64 l0 = metaIn[left ].m0;
-                const uint64 l1 = metaIn[left ].m1 & 0xFFFFFFFF;
-                const uint64 r0 = metaIn[right].m0;
-                const uint64 r1 = metaIn[right].m1 & 0xFFFFFFFF;
+                else if constexpr( MetaInMulti == 3 )
+                {
+                    const uint64 l0 = metaIn[left ].m0;
+                    const uint64 l1 = metaIn[left ].m1 & 0xFFFFFFFF;
+                    const uint64 r0 = metaIn[right].m0;
+                    const uint64 r1 = metaIn[right].m1 & 0xFFFFFFFF;
             
-                input[0] = Swap64( y  << 26 | l0 >> 38 );
-                input[1] = Swap64( l0 << 26 | l1 >> 6  );
-                input[2] = Swap64( l1 << 58 | r0 >> 6  );
-                input[3] = Swap64( r0 << 58 | r1 << 26 );
+                    input[0] = Swap64( y  << 26 | l0 >> 38 );
+                    input[1] = Swap64( l0 << 26 | l1 >> 6  );
+                    input[2] = Swap64( l1 << 58 | r0 >> 6  );
+                    input[3] = Swap64( r0 << 58 | r1 << 26 );
+                }
+                else if constexpr( MetaInMulti == 4 )
+                {
+                    const K32Meta4 l = metaIn[left];
+                    const K32Meta4 r = metaIn[right];
+
+                    input[0] = Swap64( y    << 26 | l.m0 >> 38 );
+                    input[1] = Swap64( l.m0 << 26 | l.m1 >> 38 );
+                    input[2] = Swap64( l.m1 << 26 | r.m0 >> 38 );
+                    input[3] = Swap64( r.m0 << 26 | r.m1 >> 38 );
+                    input[4] = Swap64( r.m1 << 26 );
+                }
             }
-            else if constexpr( MetaInMulti == 4 )
+
+            // Hash the whole batch
+            blake3_hash_short_many( inputs, sizeof( inputs[0] ), bufferSize, (size_t)batchCount, (uint8_t*)outputs );
+
+            for( int64 j = 0; j < batchCount; j++ )
             {
-                const K32Meta4 l = metaIn[left];
-                const K32Meta4 r = metaIn[right];
-
-                input[0] = Swap64( y    << 26 | l.m0 >> 38 );
-                input[1] = Swap64( l.m0 << 26 | l.m1 >> 38 );
-                input[2] = Swap64( l.m1 << 26 | r.m0 >> 38 );
-                input[3] = Swap64( r.m0 << 26 | r.m1 >> 38 );
-                input[4] = Swap64( r.m1 << 26 );
-            }
+                const int64   i      = batchStart + j;
+                const uint64* output = outputs[j];
+                auto&         mOut   = metaOut[i];
 
-            // Hash the input
-            blake3_hasher_init( &hasher );
-            blake3_hasher_update( &hasher, input, bufferSize );
-            blake3_hasher_finalize( &hasher, (uint8_t*)output, sizeof( output ) );
+                const uint64 f = Swap64( *output ) >> yShift;
+                yOut[i] = (TYOut)f;
 
-            const uint64 f = Swap64( *output ) >> yShift;
-            yOut[i] = (TYOut)f;
+                if constexpr ( MetaOutMulti == 2 && MetaInMulti == 3 )
+                {
+                    const uint64 h0 = Swap64( output[0] );
+                    const uint64 h1 = Swap64( output[1] );
 
-            if constexpr ( MetaOutMulti == 2 && MetaInMulti == 3 )
-            {
-                const uint64 h0 = Swap64( output[0] );
-                const uint64 h1 = Swap64( output[1] );
+                    mOut = h0 << ySize | h1 >> 26;
+                }
+                else if constexpr ( MetaOutMulti == 3 )
+                {
+                    const uint64 h0 = Swap64( output[0] );
+                    const uint64 h1 = Swap64( output[1] );
+                    const uint64 h2 = Swap64( output[2] );
 
-                mOut = h0 << ySize | h1 >> 26;
-            }
-            else if constexpr ( MetaOutMulti == 3 )
-            {
-                const uint64 h0 = Swap64( output[0] );
-                const uint64 h1 = Swap64( output[1] );
-                const uint64 h2 = Swap64( output[2] );
+                    mOut.m0 = h0 << ySize | h1 >> 26;
+                    mOut.m1 = ((h1 << 6) & 0xFFFFFFC0) | h2 >> 58;
+                }
+                else if constexpr ( MetaOutMulti == 4 && MetaInMulti != 2 ) // In = 2 is calculated above with L + R
+                {
+                    const uint64 h0 = Swap64( output[0] );
+                    const uint64 h1 = Swap64( output[1] );
+                    const uint64 h2 = Swap64( output[2] );
 
-                mOut.m0 = h0 << ySize | h1 >> 26;
-                mOut.m1 = ((h1 << 6) & 0xFFFFFFC0) | h2 >> 58;
+                    mOut.m0 = h0 << ySize | h1 >> 26;
+                    mOut.m1 = h1 << 38    | h2 >> 26;
+                }
             }
-            else if constexpr ( MetaOutMulti == 4 && MetaInMulti != 2 ) // In = 2 is calculated above with L + R
-            {
-                const uint64 h0 = Swap64( output[0] );
-                const uint64 h1 = Swap64( output[1] );
-                const uint64 h2 = Swap64( output[2] );
+        }
+    }
 
-                mOut.m0 = h0 << ySize | h1 >> 26;
-                mOut.m1 = h1 << 38    | h2 >> 26;
-            }
+    /// Same as GenFx(), but all of the bucket's matches are hashed at once on the GPU.
+    /// Each thread then copies out its own matches.
+    //-----------------------------------------------------------
+    void GenFxOnGpu( Job* self,
+                     const uint32        bucket,
+                     const uint32        matchCount,
+                     const uint32        matchOffset,
+                     const Span<uint32>  yIn,
+                     const Span<TMetaIn> metaIn,
+                     Span<TYOut>         yOut,
+                     Span<TMetaOut>      metaOut )
+    {
+        if( self->BeginLockBlock() )
+        {
+            const uint64 yMask = ((uint64)bucket) << ( _k + kExtraBits - _bucketBits );
+
+            _gpuFxFailed = !_gpuFx->GenFx( rTable, yMask, (uint32)yIn.Length(), yIn.Ptr(), metaIn.Ptr(), sizeof( TMetaIn ), sizeof( TMetaOut ),
+                                           _pairs, self->JobCount(), matchCount );
+        }
+        self->EndLockBlock();
+
+        FatalIf( _gpuFxFailed, "GPU fx generation failed for table %u bucket %u.", (uint)rTable, bucket );
+
+        const uint64* gpuY = _gpuFx->OutY() + matchOffset;
+
+        for( size_t i = 0; i < yOut.Length(); i++ )
+            yOut[i] = (TYOut)gpuY[i];
+
+        if constexpr ( rTable < TableId::Table7 )
+        {
+            const TMetaOut* gpuMeta = (const TMetaOut*)_gpuFx->OutMeta() + matchOffset;
+            memcpy( metaOut.Ptr(), gpuMeta, metaOut.Length() * sizeof( TMetaOut ) );
         }
     }
 
@@ -1235,8 +1334,11 @@ private:
 
         const bool interleaved = !_interleaved; // If the rTable is interleaved, then the L table is not interleaved and vice-versa.
 
-        _ioQueue.ReadBucketElementsT( _yId[0], interleaved, _y[bucket] );
-        _ioQueue.SignalFence( _yReadFence, bucket + 1 );
+        if( !_f1XOnly )
+        {
+            _ioQueue.ReadBucketElementsT( _yId[0], interleaved, _y[bucket] );
+            _ioQueue.SignalFence( _yReadFence, bucket + 1 );
+        }
 
         if constexpr ( rTable > TableId::Table2 )
         {
@@ -1250,6 +1352,61 @@ private:
         _ioQueue.CommitCommands();
     }
 
+    //-----------------------------------------------------------
+    // With --f1-x-only, F1 only wrote x, bucketed on y. We compute each entry's bucket-local y
+    // from its x the same way F1 does. The x of a bucket are spread across all the chacha blocks,
+    // so a block is only reused by consecutive x that happen to share it.
+    void GenerateYFromX( Job* self, const uint32 bucket )
+    {
+        WaitForFence( self, _metaReadFence, bucket );
+
+        Span<uint32> xInput = _meta[bucket].template As<uint32>();
+
+        if( self->BeginLockBlock() )
+            _y[bucket] = _yBuffers[bucket & 1].SliceSize( xInput.Length() );
+        self->EndLockBlock();
+
+        TimePoint timer;
+        if( self->IsControlThread() )
+            timer = TimerBegin();
+
+        byte key[BB_PLOT_ID_LEN] = { 1 };
+        memcpy( key + 1, _context.plotRequest.plotId, BB_PLOT_ID_LEN-1 );
+
+        chacha8_ctx chacha;
+        chacha8_keysetup( &chacha, key, 256, nullptr );
+
+        uint64 count, offset, end;
+        GetThreadOffsets( self, (uint64)xInput.Length(), count, offset, end );
+
+        const uint32 entriesPerBlock  = kF1BlockSize / sizeof( uint32 );
+        const uint32 kMinusKExtraBits = _k - kExtraBits;
+        const uint32 yMask            = (uint32)(( 1ull << ( _k + kExtraBits - _bucketBits ) ) - 1);
+
+        const uint32* xs = xInput.Ptr();
+              uint32* ys = _y[bucket].Ptr();
+
+        uint32 block[entriesPerBlock];
+        uint32 blockIdx = 0xFFFFFFFF;   // Blocks only go up to 2^28
+
+        for( uint64 i = offset; i < end; i++ )
+        {
+            const uint32 x = xs[i];
+
+            if( x / entriesPerBlock != blockIdx )
+            {
+                blockIdx = x / entriesPerBlock;
+                chacha8_get_keystream( &chacha, blockIdx, 1, (byte*)block );
+            }
+
+            const uint32 y = Swap32( block[x % entriesPerBlock] );
+            ys[i] = (uint32)( ( ( (uint64)y << kExtraBits ) | ( x >> kMinusKExtraBits ) ) & yMask );
+        }
+
+        if( self->IsControlThread() )
+            _f1Time += TimerEndTicks( timer );
+    }
+
     //-----------------------------------------------------------
     void WaitForFence( Job* self, Fence& fence, const uint32 bucket )
     {
@@ -1340,6 +1497,8 @@ private:
     FileId              _idxId [2];
     FileId              _metaId[2];
     BitBucketWriter<1>  _pairBitWriter;
+    uint32              _pairLeftBits = _pairsLeftBits;         // Bit size of the left deltas of the current bucket
+    uint32              _pairMaxLeftDelta[BB_DP_MAX_JOBS];
 
     // Read buffers
     Span<uint32>        _yBuffers    [2];
@@ -1357,12 +1516,13 @@ private:
     Span<TMetaOut>      _metaWriteBuffer;
     Span<uint64>        _mapWriteBuffer;
     byte*               _pairsWriteBuffer;
-    BlockWriter<uint32> _xWriter;               // Used for Table2  (there's no map, but just x.)
+    BlockWriter<uint32> _xWriter;               // Used for Table2  (there's no map, but just x.), or Table3 for compressed x line points
     Span<uint32>        _xWriteBuffer;          // Set by the control thread for other threads to use
 
     // Writers for when using alternating mode, for non-interleaved writes
     bool                _interleaved  = true;
     bool                _compressPlot = false;
+    bool                _f1XOnly      = false;   // Table 2 computes y from x, as F1 did not write it
 
     // Working buffers
     Span<uint64>        _yTmp;
@@ -1373,6 +1533,9 @@ private:
     // Working views
     Span<Pair>          _pairs[BB_DP_MAX_JOBS];    // Pairs buffer divided per thread
 
+    IGpuFxOffload*      _gpuFx       = nullptr;
+    bool                _gpuFxFailed = false;
+
     // Matching
     FxMatcherBounded _matcher;
 
@@ -1395,6 +1558,7 @@ private:
     Fence& _fxWriteFence;
     Fence& _pairWriteFence;
     Fence& _mapWriteFence;
+    Fence& _xWriteFence;
 
     #if BB_DP_FP_MATCH_X_BUCKET
         Span<K32CrossBucketEntries> _crossBucketEntriesIn;
@@ -1410,6 +1574,7 @@ public:
     Duration _distributeTime = Duration::zero();
     Duration _matchTime      = Duration::zero();
     Duration _fxTime         = Duration::zero();
+    Duration _f1Time         = Duration::zero();
 };
 
 
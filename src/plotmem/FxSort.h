@@ -2,7 +2,9 @@
 
 #include "algorithm/RadixSort.h"
 #include "algorithm/YSort.h"
+#include "algorithm/KeyGather.h"
 #include "threading/ThreadPool.h"
+#include "threading/MTJob.h"
 #include "ChiaConsts.h"
 #include "PlotContext.h"
 
@@ -42,11 +44,169 @@ inline void SortFx(
     // Generate a sort key
     GenSortKey<MAX_JOBS>( pool, length, sortKey );
 
-    YSorter sorter( pool );
-    sorter.Sort( length, yBuffer, yTmp, sortKey, sortKeyTmp );
+    // Sorts on 5 bytes, like YSorter, which lands the result on yTmp and sortKeyTmp
+    RadixSort256::SortWithKeyHybrid<(uint32)MAX_JOBS, uint64, uint32, 5>( pool, 0, yBuffer, yTmp, sortKey, sortKeyTmp, length );
 }
 
 
+//-----------------------------------------------------------
+// Orders y only on its kBC group (y / kBC), which is all that matching needs, keeping the entries
+// of each group in their original order. A global counting scatter on the upper bits of the group
+// splits y into L2-sized buckets, which then take a single counting pass in cache on the remaining bits.
+// Only the ~25 bits of the group are ordered, in 2 passes, where SortFx sorts on 5 bytes.
+// The sort key is generated during the scatter. Unlike SortFx, the results land back
+// on yBuffer and sortKey. The groups must be paired with FpPairGroupedThread.
+template<size_t MAX_JOBS>
+inline void SortFxOnGroups(
+    ThreadPool&   pool,    uint64  length,
+    uint64*       yBuffer, uint64* yTmp,
+    uint32*       sortKey, uint32* sortKeyTmp, const uint32 k = _K )
+{
+    const     uint64 MaxGroups     = ( ( 1ull << ( k + kExtraBits ) ) + kBC - 1 ) / kBC;
+    constexpr uint64 BucketEntries = RadixSort256::HybridBucketBytes / ( 2 * ( sizeof( uint64 ) + sizeof( uint32 ) ) );
+
+    const uint32 threadCount = pool.ThreadCount();
+    ASSERT( MAX_JOBS >= threadCount );
+
+    // With fewer entries than groups, counting on the groups costs more than sorting
+    if( length < MaxGroups )
+    {
+        SortFx<MAX_JOBS>( pool, length, yBuffer, yTmp, sortKeyTmp, sortKey );
+        bbmemcpy_t( yBuffer, yTmp, length );
+        return;
+    }
+
+    uint32 groupBits = 1;
+    while( ( ( MaxGroups - 1 ) >> groupBits ) != 0 )
+        groupBits++;
+
+    // Size the buckets by whole groups, so that a bucket fits in the L2,
+    // while keeping the count of MSD digits as low as the hybrid radix sort does.
+    const uint64 entriesPerGroup = length / MaxGroups;
+
+    uint32 lowBits = 0;
+    while( lowBits < groupBits && ( entriesPerGroup << ( lowBits + 1 ) ) <= BucketEntries )
+        lowBits++;
+
+    lowBits = std::max( lowBits, groupBits - std::min( groupBits, RadixSort256::HybridMaxMSDBits ) );
+
+    while( lowBits < groupBits && (size_t)threadCount * ( 1ull << ( groupBits - lowBits ) ) * sizeof( uint64 ) > RadixSort256::HybridMaxCounts )
+        lowBits++;
+
+    const uint64 bucketCount = 1ull << ( groupBits - lowBits );
+    const uint64 lowCount    = 1ull << lowBits;
+    const uint64 lowMask     = lowCount - 1;
+
+    uint64* counts       = bbcalloc<uint64>( threadCount * bucketCount );
+    uint64* bucketStarts = bbcalloc<uint64>( bucketCount + 1 );
+
+    // Global scatter on the upper bits of the group into tmp
+    AnonMTJob::Run( pool, threadCount, [=]( AnonMTJob* self ) {
+
+        const uint32 id = self->JobId();
+
+        uint64 count, offset, end;
+        GetThreadOffsets( self, length, count, offset, end );
+
+        uint64* tCounts = counts + id * bucketCount;
+        memset( tCounts, 0, sizeof( uint64 ) * bucketCount );
+
+        for( uint64 i = offset; i < end; i++ )
+        {
+            ASSERT( yBuffer[i] / kBC < MaxGroups );
+            tCounts[( yBuffer[i] / kBC ) >> lowBits]++;
+        }
+
+        self->SyncThreads();
+
+        // Sum the counts of each bucket across threads
+        uint64 bCount, bOffset, bEnd;
+        GetThreadOffsets( self, bucketCount, bCount, bOffset, bEnd );
+
+        for( uint64 b = bOffset; b < bEnd; b++ )
+        {
+            uint64 total = 0;
+            for( uint32 t = 0; t < threadCount; t++ )
+                total += counts[t * bucketCount + b];
+
+            bucketStarts[b+1] = total;
+        }
+
+        if( self->BeginLockBlock() )
+        {
+            bucketStarts[0] = 0;
+            for( uint64 b = 1; b <= bucketCount; b++ )
+                bucketStarts[b] += bucketStarts[b-1];
+        }
+        self->EndLockBlock();
+
+        // Turn the counts into each thread's write offset in every bucket
+        for( uint64 b = bOffset; b < bEnd; b++ )
+        {
+            uint64 pos = bucketStarts[b];
+            for( uint32 t = 0; t < threadCount; t++ )
+            {
+                const uint64 c = counts[t * bucketCount + b];
+                counts[t * bucketCount + b] = pos;
+                pos += c;
+            }
+        }
+
+        self->SyncThreads();
+
+        // Scatter in order, so that the groups keep their original order
+        for( uint64 i = offset; i < end; i++ )
+        {
+            const uint64 y      = yBuffer[i];
+            const uint64 dstIdx = tCounts[( y / kBC ) >> lowBits]++;
+
+            yTmp      [dstIdx] = y;
+            sortKeyTmp[dstIdx] = (uint32)i;
+        }
+    });
+
+    // Count each bucket on the rest of the group bits, in cache, back onto the input buffers
+    const uint64 grainSize = std::max( (uint64)1, bucketCount / ( (uint64)threadCount * 16 ) );
+
+    AnonMTJob::RunRanges( pool, threadCount, bucketCount, grainSize, [=]( AnonMTJob* self, uint64 bOffset, uint64 bCount ) {
+
+        uint64* groupOffsets = bbcalloc<uint64>( lowCount );
+
+        for( uint64 b = bOffset; b < bOffset + bCount; b++ )
+        {
+            const uint64 start = bucketStarts[b];
+            const uint64 end   = bucketStarts[b+1];
+
+            memset( groupOffsets, 0, sizeof( uint64 ) * lowCount );
+
+            for( uint64 i = start; i < end; i++ )
+                groupOffsets[( yTmp[i] / kBC ) & lowMask]++;
+
+            uint64 pos = start;
+            for( uint64 g = 0; g < lowCount; g++ )
+            {
+                const uint64 c = groupOffsets[g];
+                groupOffsets[g] = pos;
+                pos += c;
+            }
+
+            for( uint64 i = start; i < end; i++ )
+            {
+                const uint64 y      = yTmp[i];
+                const uint64 dstIdx = groupOffsets[( y / kBC ) & lowMask]++;
+
+                yBuffer[dstIdx] = y;
+                sortKey[dstIdx] = sortKeyTmp[i];
+            }
+        }
+
+        free( groupOffsets );
+    });
+
+    free( counts );
+    free( bucketStarts );
+}
+
 //-----------------------------------------------------------
 template<typename TMeta, size_t MAX_JOBS>
 inline void MapFxWithSortKey(
@@ -89,19 +249,14 @@ void MapFxThread( MapFxJob<TMeta>* job )
 
     const uint32* sortKey = job->sortKey + offset;
 
-    // Map metadata
+    // Map metadata and pairs together
     const TMeta* metaSrc  = job->metaSrc;
     TMeta*       metaDst  = job->metaDst + offset;
 
-    for( uint64 i = 0; i < length; i++ )
-        metaDst[i] = metaSrc[sortKey[i]];
-
-    // Map pairs
     const Pair*  pairSrc  = job->pairSrc;
     Pair*        pairDst  = job->pairDst + offset;
 
-    for( uint64 i = 0; i < length; i++ )
-        pairDst[i] = pairSrc[sortKey[i]];
+    KeyGather::Gather2( sortKey, metaSrc, metaDst, pairSrc, pairDst, length );
 }
 
 
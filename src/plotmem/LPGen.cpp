@@ -0,0 +1,102 @@
+#include "LPGen.h"
+#include "algorithm/KeyGather.h"
+#include "SysHost.h"
+
+///
+/// Batched back pointer -> line point conversion.
+/// The AVX2 kernel is compiled with a function-level target attribute,
+/// and is only called after checking CPU support at runtime.
+///
+
+#if defined( __x86_64__ ) || defined( _M_X64 )
+    #define LPGEN_X86 1
+    #include <immintrin.h>
+
+    #if defined( _MSC_VER ) && !defined( __clang__ )
+        #include <intrin.h>
+        #define LPGEN_TARGET( x )
+    #else
+        #define LPGEN_TARGET( x ) __attribute__((target( x )))
+    #endif
+#endif
+
+#if LPGEN_X86
+
+//-----------------------------------------------------------
+static bool LPGenHasAVX2()
+{
+    return SysHost::HasCpuFeatures( CpuFeatures::AVX2 );
+}
+
+/// Converts 4 pairs per iteration.
+/// With x = max( l, r ) and y = min( l, r ), a line point is x * (x-1) / 2 + y.
+/// x and y are 32-bit, so x * (x-1) fits in 64 bits and we can halve it after multiplying.
+//-----------------------------------------------------------
+LPGEN_TARGET( "avx2" )
+static uint64 PairsToLinePointsAVX2( const Pair* pairs, const uint32* lTable, uint64* outLinePoints, const uint64 count )
+{
+    const uint64  simdCount = count / 4 * 4;
+    const __m256i one       = _mm256_set1_epi32( 1 );
+    const __m256i lowMask   = _mm256_set1_epi64x( 0xFFFFFFFFull );
+
+    // The lTable reads are random, prefetch them ahead, as KeyGather does
+    constexpr uint64 distance = KeyGather::PrefetchDistance;
+
+    for( uint64 i = 0; i < simdCount; i += 4 )
+    {
+        if( i + distance + 4 <= count )
+        {
+            for( uint64 j = i + distance; j < i + distance + 4; j++ )
+            {
+                BB_PREFETCH_READ( lTable + pairs[j].left  );
+                BB_PREFETCH_READ( lTable + pairs[j].right );
+            }
+        }
+
+        // Load 4 pairs at a time (left and right are interleaved).
+        // Indices can be >= 2^31, so we have to gather with zero-extended 64-bit indices.
+        const __m256i idx = _mm256_loadu_si256( (const __m256i*)( pairs + i ) );
+
+        const __m256i idxLo = _mm256_cvtepu32_epi64( _mm256_castsi256_si128( idx ) );
+        const __m256i idxHi = _mm256_cvtepu32_epi64( _mm256_extracti128_si256( idx, 1 ) );
+
+        const __m128i valLo = _mm256_i64gather_epi32( (const int*)lTable, idxLo, 4 );
+        const __m128i valHi = _mm256_i64gather_epi32( (const int*)lTable, idxHi, 4 );
+
+        // Each 64-bit lane holds one pair's ( lTable[left], lTable[right] )
+        const __m256i val     = _mm256_set_m128i( valHi, valLo );
+        const __m256i swapped = _mm256_shuffle_epi32( val, _MM_SHUFFLE( 2, 3, 0, 1 ) );
+
+        // Only the low 32 bits of each 64-bit lane are used from here on
+        const __m256i x = _mm256_max_epu32( val, swapped );
+        const __m256i y = _mm256_and_si256( _mm256_min_epu32( val, swapped ), lowMask );
+
+        const __m256i xEnc = _mm256_srli_epi64( _mm256_mul_epu32( x, _mm256_sub_epi32( x, one ) ), 1 );
+
+        // Loading is done before storing, so it's safe for outLinePoints to alias pairs
+        _mm256_storeu_si256( (__m256i*)( outLinePoints + i ), _mm256_add_epi64( xEnc, y ) );
+    }
+
+    return simdCount;
+}
+
+#endif // LPGEN_X86
+
+//-----------------------------------------------------------
+void PairsToLinePoints( const Pair* pairs, const uint32* lTable, uint64* outLinePoints, const uint64 count )
+{
+    uint64 i = 0;
+
+#if LPGEN_X86
+    static const bool hasAVX2 = LPGenHasAVX2();
+
+    if( hasAVX2 )
+        i = PairsToLinePointsAVX2( pairs, lTable, outLinePoints, count );
+#endif
+
+    for( ; i < count; i++ )
+    {
+        const Pair p = pairs[i];
+        outLinePoints[i] = SquareToLinePoint( lTable[p.left], lTable[p.right] );
+    }
+}
@@ -1,5 +1,6 @@
 #pragma once
 #include <atomic>
+#include <cmath>
 #include "PlotContext.h"
 
 ///
@@ -45,14 +46,23 @@ void PruneAndMapThread( LPJob* job );
 void ConverToLinePointThread( LPJob* job );
 void WriteLookupTableThread( LPJob* job );
 
+// Converts each pair into the line point of the lTable entries it points to.
+// Uses AVX2 when the CPU supports it. outLinePoints may alias pairs.
+void PairsToLinePoints( const Pair* pairs, const uint32* lTable, uint64* outLinePoints, uint64 count );
+
 // Calculates x * (x-1) / 2. Division is done before multiplication.
 inline uint64 GetXEnc( uint64 x );
 inline uint64 SquareToLinePoint( uint64 x, uint64 y );
 inline uint128 GetXEnc128( uint64 x );
 
+inline uint64 LinePointSqrtEstimate( double index );
+inline uint64 LinePointCorrectX( uint64 x, uint128 index );
 inline BackPtr LinePointToSquare( uint128 index );
 inline BackPtr LinePointToSquare64( uint64 index );
 
+// Inverts count line points of up to 64 bits at once.
+inline void LinePointsToSquares64( const uint64* linePoints, BackPtr* outPtrs, uint64 count );
+
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wattributes"
@@ -88,7 +98,14 @@ FORCE_INLINE uint128 GetXEnc128( uint64 x )
     else
         b >>= 1; // b /= 2;
 
+#if defined( _MSC_VER ) && !defined( __SIZEOF_INT128__ )
+    // The emulated uint128 multiplication is a long multiplication
+    uint64 hi;
+    const uint64 lo = _umul128( a, b, &hi );
+    const uint128 r( hi, lo );
+#else
     const uint128 r = (uint128)a * b;
+#endif
     // ASSERT( r >= a && r >= b );
 
     return r;
@@ -123,34 +140,61 @@ inline uint128 SquareToLinePoint128( const uint64 x, const uint64 y )
     return GetXEnc128( x ) + y;
 }
 
+/// Line points are inverted by solving x*(x-1)/2 <= index for the largest x. The double precision square root
+/// lands within a step of it for the line points of any k up to 50, and is then corrected with exact integer math,
+/// instead of searching for each bit of x in turn.
+//-----------------------------------------------------------
+FORCE_INLINE uint64 LinePointSqrtEstimate( const double index )
+{
+    const double x = ( 1.0 + std::sqrt( 1.0 + 8.0 * index ) ) * 0.5;
+
+    // Beyond any valid line point
+    if( x >= 18446744073709551615.0 )
+        return 0xFFFFFFFFFFFFFFFFull;
+
+    return std::max( (uint64)x, (uint64)1 );
+}
+
+//-----------------------------------------------------------
+FORCE_INLINE uint64 LinePointCorrectX( uint64 x, const uint128 index )
+{
+    while( x > 1 && GetXEnc128( x ) > index )
+        x--;
+
+    while( x < 0xFFFFFFFFFFFFFFFFull && GetXEnc128( x + 1 ) <= index )
+        x++;
+
+    return x;
+}
+
+//-----------------------------------------------------------
 FORCE_INLINE BackPtr LinePointToSquare( uint128 index )
 {
-    // Performs a square root, without the use of doubles, 
-    // to use the precision of the uint128_t.
-    uint64 x = 0;
-    for( int i = 63; i >= 0; i-- ) 
-    {
-        uint64 new_x = x + ((uint64)1 << i);
-        if( GetXEnc128( new_x ) <= index )
-            x = new_x;
-    }
+    const double indexF = (double)(uint64)( index >> 64 ) * 18446744073709551616.0 + (double)(uint64)index;
+    const uint64 x      = LinePointCorrectX( LinePointSqrtEstimate( indexF ), index );
 
-    return { x, (uint64)(uint64_t)( index - GetXEnc128( x ) ) };
+    return { x, (uint64)( index - GetXEnc128( x ) ) };
 }
 
+//-----------------------------------------------------------
 FORCE_INLINE BackPtr LinePointToSquare64( uint64 index )
 {
-    // Performs a square root, without the use of doubles, 
-    // to use the precision of the uint128_t.
-    uint64 x = 0;
-    for( int i = 63; i >= 0; i-- ) 
+    const uint64 x = LinePointCorrectX( LinePointSqrtEstimate( (double)index ), index );
+    return { x, ( index - GetXEnc( x ) ) };
+}
+
+/// The estimates don't depend on each other, so that they are computed first, several at a time.
+//-----------------------------------------------------------
+inline void LinePointsToSquares64( const uint64* linePoints, BackPtr* outPtrs, const uint64 count )
+{
+    for( uint64 i = 0; i < count; i++ )
+        outPtrs[i].x = LinePointSqrtEstimate( (double)linePoints[i] );
+
+    for( uint64 i = 0; i < count; i++ )
     {
-        uint64 new_x = x + ((uint64)1 << i);
-        if( GetXEnc( new_x ) <= index )
-            x = new_x;
+        const uint64 x = LinePointCorrectX( outPtrs[i].x, linePoints[i] );
+        outPtrs[i] = { x, linePoints[i] - GetXEnc( x ) };
     }
-
-    return { x, ( index - GetXEnc( x ) ) };
 }
 
 #pragma GCC diagnostic pop
@@ -0,0 +1,40 @@
+#pragma once
+#include "PlotContext.h"
+#include "threading/MTJob.h"
+#include "threading/ThreadPool.h"
+
+//-----------------------------------------------------------
+// Runs func( self, offset, count ) over the entries [0, totalCount).
+// In NUMA-local mode the range is split at the node partition boundaries and each
+// node's slice is processed by that node's pool, so threads only touch (and steal)
+// entries whose output lives on their own node.
+// Otherwise this is AnonMTJob::RunRanges on the main thread pool.
+//-----------------------------------------------------------
+template<typename TJob>
+inline void RunNodeLocalRanges( MemPlotContext& cx, const uint64 totalCount, TJob&& func )
+{
+    if( cx.nodeCount == 0 )
+    {
+        AnonMTJob::RunRanges( *cx.threadPool, cx.threadCount, totalCount, func );
+        return;
+    }
+
+    ASSERT( cx.nodeCount <= cx.threadCount );
+
+    // One thread of the main pool dispatches each node and waits on that node's pool
+    AnonMTJob::Run( *cx.threadPool, cx.nodeCount, [&]( AnonMTJob* self ) {
+
+        const uint32 node  = self->JobId();
+        const uint64 start = std::min( totalCount, cx.nodeEntryCount * node );
+        const uint64 end   = node == cx.nodeCount - 1 ? totalCount : std::min( totalCount, start + cx.nodeEntryCount );
+
+        if( start >= end )
+            return;
+
+        ThreadPool& pool = *cx.nodePools[node];
+
+        AnonMTJob::RunRanges( pool, pool.ThreadCount(), end - start, [&]( AnonMTJob* nodeJob, uint64 offset, uint64 count ) {
+            func( nodeJob, start + offset, count );
+        });
+    });
+}
@@ -7,7 +7,13 @@
 #include "algorithm/YSort.h"
 #include "SysHost.h"
 #include "plotting/GlobalPlotConfig.h"
+#include "plotting/PlotBenchmark.h"
+#include "util/PerfCounters.h"
+#include "plotting/matching/GroupScan.h"
 #include "plotmem/LPGen.h"
+#include "plotmem/MemNuma.h"
+#include "util/jobs/MemJobs.h"
+#include "util/BitView.h"
 #include <cmath>
 
 #include "DbgHelper.h"
@@ -28,46 +34,6 @@
 ///
 /// Internal data
 ///
-struct F1GenJob
-{
-    // uint node;
-    // uint threadCount;
-    // uint cpuId;
-    // uint startPage;
-    // uint pageCount;
-    
-    const byte* key;
-
-    uint32  blockCount;
-    uint32  entryCount;
-    uint32  x;
-    byte*   blocks;
-    uint64* yBuffer;
-    uint32* xBuffer;
-};
-
-struct kBCJob
-{
-    const uint64* yBuffer;
-    uint64        maxCount;         // Max group count for scan job, pair count for pair job.
-    uint64        groupCount;
-    uint32*       groupBoundaries;
-    uint64        startIndex;
-
-    // For scan job
-    uint64 endIndex;
-
-    // For scan job
-    uint64 pairCount;        // Group count for scan job, pair count for pair job.
-    Pair*  pairs;
-    Pair*  copyDst;          // For second pass
-
-#if DEBUG
-    uint32 jobIdx;
-#endif
-};
-
-
 template<typename TYOut, typename TMetaIn, typename TMetaOut>
 struct FpFxJob
 {
@@ -77,20 +43,25 @@ struct FpFxJob
     const Pair*    lrPairs;
     TMetaOut*      outMetaBuffer;
     TYOut*         outYBuffer;
+    uint32         k;
 };
 
 /// Internal Funcs forwards-declares
-void F1JobThread( F1GenJob* job );
 void F1NumaJobThread( F1GenJob* job );
 
-void FpScanThread( kBCJob* job );
-void FpPairThread( kBCJob* job );
+static void GenF1ForK( MemPlotContext& cx, const byte key[32], byte* blocks, uint64* yBuffer, uint32* xBuffer );
 
 template<typename TYOut, typename TMetaIn, typename TMetaOut>
 void ComputeFxJob( FpFxJob<TYOut, TMetaIn, TMetaOut>* job );
 
+template<typename TYOut, typename TMetaIn, typename TMetaOut>
+void ComputeFxJobForK( FpFxJob<TYOut, TMetaIn, TMetaOut>* job );
+
+template<size_t metaKMultiplierIn, size_t metaKMultiplierOut>
+FORCE_INLINE void ComputeFxInput( uint64 y, const uint64* metaData, uint64* input, uint64* metaOut );
+
 template<size_t metaKMultiplierIn, size_t metaKMultiplierOut, uint ShiftBits>
-FORCE_INLINE uint64 ComputeFx( uint64 y, uint64* metaData, uint64* metaOut );
+FORCE_INLINE uint64 ComputeFxOutput( const uint64* output, uint64* metaOut );
 
 
 
@@ -164,7 +135,7 @@ uint64 MemPhase1::GenerateF1()
     ///
     /// Prepare jobs
     ///
-    const uint   k                  = _K;
+    const uint   k                  = cx.k;
     const size_t CHACHA_BLOCK_SIZE  = kF1BlockSizeBits / 8;
     const uint   numThreads         = cx.threadCount;
 
@@ -191,6 +162,19 @@ uint64 MemPhase1::GenerateF1()
     // const NumaInfo* numa = SysHost::GetNUMAInfo();
 
     // Gen all raw f1 values
+    if( k != _K )
+    {
+        Log::Line( "Generating F1..." );
+        auto timeStart = TimerBegin();
+
+        GenF1ForK( cx, key, blocks, yTmp, xTmp );
+
+        double elapsed = TimerEnd( timeStart );
+        Log::Line( "Finished F1 generation in %.2lf seconds.", elapsed );
+        PlotBenchmark::RecordTable( 1, TableId::Table1, elapsed );
+        PerfCounters::RecordTable( 1, TableId::Table1, elapsed );
+    }
+    else
     {
         // Prepare jobs
         F1GenJob jobs[MAX_THREADS];
@@ -257,16 +241,24 @@ uint64 MemPhase1::GenerateF1()
 
         double elapsed = TimerEnd( timeStart );
         Log::Line( "Finished F1 generation in %.2lf seconds.", elapsed );
+        PlotBenchmark::RecordTable( 1, TableId::Table1, elapsed );
+        PerfCounters::RecordTable( 1, TableId::Table1, elapsed );
     }
 
     Log::Line( "Sorting F1..." );
     auto timeStart = TimerBegin();
 
-    YSorter sorter( *cx.threadPool );
-    sorter.Sort( totalEntries, yTmp, yBuffer, xTmp, xBuffer );
+    // In NUMA-local mode the sorted y lands on its node partitions, so it is sorted node by node
+    if( cx.nodeCount )
+        RadixSort256::SortWithKeyNuma<MAX_THREADS, uint64, uint32, 5>( *cx.threadPool, cx.nodePools, cx.nodeCount, cx.nodeEntryCount,
+                                                                      yTmp, yBuffer, xTmp, xBuffer, totalEntries );
+    else
+        RadixSort256::SortWithKeyHybrid<MAX_THREADS, uint64, uint32, 5>( *cx.threadPool, 0, yTmp, yBuffer, xTmp, xBuffer, totalEntries );
 
     double elapsed = TimerEnd( timeStart );
     Log::Line( "Finished F1 sort in %.2lf seconds.", elapsed );
+    PlotBenchmark::RecordTable( 1, TableId::Table1, elapsed );
+    PerfCounters::RecordTable( 1, TableId::Table1, elapsed );
 
 
     #if DBG_VERIFY_SORT_F1
@@ -341,9 +333,19 @@ uint64 MemPhase1::FpComputeTable( uint64 entryCount,
 
 
 //-----------------------------------------------------------
-static void InlineTable2( MemPlotContext& cx, const uint64 pairCount, const Pair* pairs )
+// Inlines the entries of a dropped table into the table that references it.
+// Table 2 takes the truncated x's of its pairs, which GenerateF1 left in t3LRBuffer.
+// With 2 dropped tables, table 2's entries are the packed x pairs, and table 3's entries
+// are line points of those. The last inlined table always ends up in t1XBuffer,
+// which phase 3 then uses as its first L table.
+static void InlineTable( MemPlotContext& cx, const TableId tableId, const uint64 pairCount, const Pair* pairs )
 {
-    const uint32 threadCount = cx.threadCount;
+    const uint32 threadCount      = cx.threadCount;
+    const uint32 numDroppedTables = cx.cfg.gCfg->numDroppedTables;
+
+    ASSERT( tableId >= TableId::Table2 && (uint32)tableId <= numDroppedTables );
+
+    const bool isFinalTable = (uint32)tableId == numDroppedTables;
 
     struct Job
     {
@@ -352,8 +354,21 @@ static void InlineTable2( MemPlotContext& cx, const uint64 pairCount, const Pair
         MemPlotContext* cx;
         uint64          pairCount;
         const Pair*     pairs;
+        const uint32*   srcTable;
+        uint32*         dstTable;
+        uint32          inBits;       // Significant bits of each source entry, after the shift
+        uint32          shift;
+        bool            toLinePoint;
     };
 
+    const uint32 entryBits = cx.cfg.gCfg->compressedEntryBits;
+
+    const uint32* srcTable = tableId == TableId::Table2 ? (uint32*)cx.t3LRBuffer : cx.t1XBuffer;
+
+    // Table 2's pairs are not used again once inlined, so when table 2's packed
+    // x's are still being read from t1XBuffer we write to its pair buffer instead.
+    uint32* dstTable = tableId == TableId::Table2 ? cx.t1XBuffer : (uint32*)cx.t2LRBuffer;
+
     Job jobs[MAX_THREADS];
 
     for( uint32 i = 0; i < threadCount; i++ )
@@ -364,18 +379,21 @@ static void InlineTable2( MemPlotContext& cx, const uint64 pairCount, const Pair
         job.cx          = &cx;
         job.pairCount   = pairCount;
         job.pairs       = pairs;
+        job.srcTable    = srcTable;
+        job.dstTable    = dstTable;
+        job.inBits      = tableId == TableId::Table2 ? entryBits : entryBits * 2;
+        job.shift       = tableId == TableId::Table2 ? 32 - entryBits : 0;
+        job.toLinePoint = isFinalTable;
     }
 
     cx.threadPool->RunJob<Job>( []( Job* self ) {
         
-        const auto&  cx          = *self->cx;
         const uint32 id          = self->id;
         const uint32 threadCount = self->jobCount;
         const uint64 pairCount   = self->pairCount;
         const Pair*  pairs       = self->pairs;
-
-        const uint32 entryBits = cx.cfg.gCfg->compressedEntryBits;
-        const uint32 shift     = 32 - entryBits;
+        const uint32 inBits      = self->inBits;
+        const uint32 shift       = self->shift;
         
               int64 count  = (int64)(pairCount / threadCount);
         const int64 offset = count * (int64)id;
@@ -385,25 +403,43 @@ static void InlineTable2( MemPlotContext& cx, const uint64 pairCount, const Pair
 
         const int64 end = offset + count;
 
-        const uint32* srcTable = (uint32*)cx.t3LRBuffer;
-              uint32* dstTable = cx.t1XBuffer;
+        const uint32* srcTable = self->srcTable;
+              uint32* dstTable = self->dstTable;
 
-        for( int64 i = offset; i < end; i++ )
+        if( self->toLinePoint )
         {
-            const Pair p = pairs[i];
+            for( int64 i = offset; i < end; i++ )
+            {
+                const Pair p = pairs[i];
 
-            const uint32 x1 = srcTable[p.left ] >> shift;
-            const uint32 x2 = srcTable[p.right] >> shift;
+                const uint32 x1 = srcTable[p.left ] >> shift;
+                const uint32 x2 = srcTable[p.right] >> shift;
 
-            // Convert to linepoint
-            const uint32 x12 = (uint32)SquareToLinePoint( x2, x1 );
-            ASSERT( !(x12 & 1ul << 31 ) );
-            ASSERT( !(x12 & (1ul << (entryBits*2-1)) ) );
+                // Convert to linepoint
+                const uint32 x12 = (uint32)SquareToLinePoint( x2, x1 );
+                ASSERT( !(x12 & 1ul << 31 ) );
+                ASSERT( !(x12 & (1ul << (inBits*2-1)) ) );
 
-            dstTable[i] = x12;
+                dstTable[i] = x12;
+            }
+        }
+        else
+        {
+            for( int64 i = offset; i < end; i++ )
+            {
+                const Pair p = pairs[i];
+
+                const uint32 x1 = srcTable[p.left ] >> shift;
+                const uint32 x2 = srcTable[p.right] >> shift;
+
+                dstTable[i] = ( x2 << inBits ) | x1;
+            }
         }
 
     }, jobs, threadCount );
+
+    if( dstTable != cx.t1XBuffer )
+        MemCpyMT::Copy( cx.t1XBuffer, dstTable, (size_t)pairCount * sizeof( uint32 ), *cx.threadPool, threadCount );
 }
 
 //-----------------------------------------------------------
@@ -492,25 +528,68 @@ uint64 MemPhase1::FpComputeSingleTable(
 
         // Use table 7's buffers as a temporary buffer
         uint32* sortKey    = cx.t7YBuffer;
-        uint32* sortKeyTmp = (uint32*)( metaBuffer.write + ENTRIES_PER_TABLE ); // Use the output metabuffer for now as 
+        uint32* sortKeyTmp = (uint32*)( metaBuffer.write + ( 1ull << cx.k ) );  // Use the output metabuffer for now as 
                                                                                 // the temporary sortkey buffer.
-        SortFx<MAX_THREADS>(
-            *cx.threadPool,        pairCount,
-            (uint64*)yBuffer.read, yBuffer.write,
-            sortKeyTmp,            sortKey
-        );
-        yBuffer.Swap();
+
+        // Small metadata is carried through the sort along with the pairs, which costs less
+        // than gathering both with a sort key afterwards. Like SortFx, this sorts on 5 bytes,
+        // which lands the metadata and the pairs on their tmp buffers.
+        constexpr bool smallMeta     = sizeof( TMetaOut ) <= 16;
+        const     bool carryPayloads = smallMeta && !cx.cfg.groupMatch;
+
+        if( carryPayloads && cx.nodeCount )
+        {
+            RadixSort256::SortWithPayloadsNuma<MAX_THREADS, uint64, TMetaOut, Pair, 5>( *cx.threadPool,
+                cx.nodePools,               cx.nodeCount, cx.nodeEntryCount,
+                (uint64*)yBuffer.read,      yBuffer.write,
+                (TMetaOut*)metaBuffer.read, (TMetaOut*)metaBuffer.write,
+                unsortedPairBuffer,         pairBuffer,
+                pairCount );
+
+            yBuffer.Swap();
+        }
+        else if( carryPayloads )
+        {
+            // y is sorted as its low 32 bits within buckets of its high bits, and lands back on the read buffer
+            RadixSort256::SortWithPayloadsNarrow<MAX_THREADS, uint64, TMetaOut, Pair, 5>( *cx.threadPool, 0,
+                (uint64*)yBuffer.read,      yBuffer.write,
+                (TMetaOut*)metaBuffer.read, (TMetaOut*)metaBuffer.write,
+                unsortedPairBuffer,         pairBuffer,   // Lands on the final pair buffer
+                pairCount );
+        }
+        else if( cx.cfg.groupMatch )
+        {
+            // Only ordered on the kBC groups, which lands back on the read buffers
+            SortFxOnGroups<MAX_THREADS>(
+                *cx.threadPool,        pairCount,
+                (uint64*)yBuffer.read, yBuffer.write,
+                sortKey,               sortKeyTmp,
+                cx.k
+            );
+        }
+        else
+        {
+            SortFx<MAX_THREADS>(
+                *cx.threadPool,        pairCount,
+                (uint64*)yBuffer.read, yBuffer.write,
+                sortKeyTmp,            sortKey
+            );
+            yBuffer.Swap();
+        }
 
         // DbgVerifyPairsKBCGroups( pairCount, yBuffer.write, unsortedPairBuffer );
 
-        MapFxWithSortKey<TMetaOut, MAX_THREADS>(
-            *cx.threadPool, pairCount, sortKey,
-            (TMetaOut*)metaBuffer.read, (TMetaOut*)metaBuffer.write,
-            unsortedPairBuffer,         pairBuffer   // Write to the final pair buffer
-        );
+        if( !carryPayloads )
+        {
+            MapFxWithSortKey<TMetaOut, MAX_THREADS>(
+                *cx.threadPool, pairCount, sortKey,
+                (TMetaOut*)metaBuffer.read, (TMetaOut*)metaBuffer.write,
+                unsortedPairBuffer,         pairBuffer   // Write to the final pair buffer
+            );
+        }
 
-        if( tableId == TableId::Table2 && isCompressed )
-            InlineTable2( cx, pairCount, pairBuffer );
+        if( isCompressed && (uint32)tableId <= cx.cfg.gCfg->numDroppedTables )
+            InlineTable( cx, tableId, pairCount, pairBuffer );
 
         // DbgVerifyPairsKBCGroups( pairCount, yBuffer.write, pairBuffer );
 
@@ -523,7 +602,7 @@ uint64 MemPhase1::FpComputeSingleTable(
 
         #if DBG_VERIFY_SORT_FX
             Log::Line( "  Verifying that fx (y) is sorted..." );
-            if( !DbgVerifySortedY( pairCount, (uint64*)yBuffer.read ) )
+            if( !cx.cfg.groupMatch && !DbgVerifySortedY( pairCount, (uint64*)yBuffer.read ) )
             {
                 Log::Line( "  Failed." );
                 exit( 1 );
@@ -548,6 +627,8 @@ uint64 MemPhase1::FpComputeSingleTable(
 
     double tableElapsed = TimerEnd( tableTimer );
     Log::Line( "Finished forward propagating table %d in %.2lf seconds.", (int)tableId+1, tableElapsed );
+    PlotBenchmark::RecordTable( 1, tableId, tableElapsed );
+    PerfCounters::RecordTable( 1, tableId, tableElapsed );
 
     return pairCount;
 }
@@ -584,6 +665,44 @@ void F1JobThread( F1GenJob* job )
         xBuffer[i] = (uint32)( x + i );
 }
 
+//-----------------------------------------------------------
+// F1 for k values other than 32, where the y's don't line up with the chacha words.
+// The whole keystream is generated first, then each y is read from it as a k-bit big-endian value.
+static void GenF1ForK( MemPlotContext& cx, const byte key[32], byte* blocks, uint64* yBuffer, uint32* xBuffer )
+{
+    const uint32 k          = cx.k;
+    const uint64 entryCount = 1ull << k;
+    const uint64 blockCount = CDiv( entryCount * k, kF1BlockSizeBits );
+
+    ASSERT( k >= BB_CHIA_K_MIN_VALUE && k < _K );
+
+    AnonMTJob::Run( *cx.threadPool, cx.threadCount, [=]( AnonMTJob* self ) {
+
+        uint64 count, offset, end;
+        GetThreadOffsets( self, blockCount, count, offset, end );
+
+        chacha8_ctx chacha;
+        ZeroMem( &chacha );
+
+        chacha8_keysetup( &chacha, key, 256, NULL );
+        chacha8_get_keystream( &chacha, offset, (uint32)count, blocks + offset * kF1BlockSize );
+
+        self->SyncThreads();
+
+        GetThreadOffsets( self, entryCount, count, offset, end );
+
+        CPBitReader reader( blocks, blockCount * kF1BlockSizeBits );
+
+        for( uint64 x = offset; x < end; x++ )
+        {
+            const uint64 y = reader.Read64At( x * k, k );
+
+            yBuffer[x] = ( y << kExtraBits ) | ( x >> ( k - kExtraBits ) );
+            xBuffer[x] = (uint32)x;
+        }
+    });
+}
+
 //-----------------------------------------------------------
 uint64 MemPhase1::FpScan( const uint64 entryCount, const uint64* yBuffer, uint32* groupBoundaries, kBCJob jobs[MAX_THREADS] )
 {
@@ -625,7 +744,7 @@ uint64 MemPhase1::FpScan( const uint64 entryCount, const uint64* yBuffer, uint32
         uint64 targetGroup;
 
         // If we are already at the start of a group, just use this index
-        if( groupLocalIdx == 0 )
+        if( groupLocalIdx == 0 && yBuffer[idx-1] / kBC != curGroup )
         {
             job.startIndex = idx;
         }
@@ -788,35 +907,10 @@ void FpScanThread( kBCJob* job )
 {
     const uint64 maxGroups  = job->maxCount;
 
-    uint32* groupBoundaries = job->groupBoundaries;
-    uint64  groupCount      = 0;
-
-    const uint64* yBuffer = job->yBuffer;
-    const uint64  start   = job->startIndex;
-    const uint64  end     = job->endIndex;
-
-    uint64 lastGroup = yBuffer[start] / kBC;
-
-    for( uint64 i = start+1; i < end; i++ )
-    {
-        uint64 group = yBuffer[i] / kBC;
-        if( group != lastGroup )
-        {
-            ASSERT( group > lastGroup );
-
-            groupBoundaries[groupCount++] = (uint32)i;
-            lastGroup = group;
+    ASSERT( maxGroups <= 0xFFFFFFFF );
 
-            if( groupCount == maxGroups )
-            {
-                ASSERT( 0 );    // We ought to always have enough space
-                                // So this should be an error
-                break;
-            }
-        }
-    }
-
-    job->groupCount = groupCount;
+    job->groupCount = ScanBCGroupThread32( job->yBuffer, job->startIndex, job->endIndex,
+                                           job->groupBoundaries, (uint32)std::min( maxGroups, (uint64)0xFFFFFFFF ) );
 }
 
 // Create pairs from y values
@@ -850,7 +944,10 @@ uint64 MemPhase1::FpPair( const uint64* yBuffer, kBCJob jobs[MAX_THREADS],
         // job.jobIdx          = (uint32)i;
     }
 
-    cx.threadPool->RunJob( FpPairThread, jobs, threadCount );
+    if( cx.cfg.groupMatch )
+        cx.threadPool->RunJob( FpPairGroupedThread, jobs, threadCount );
+    else
+        cx.threadPool->RunJob( FpPairThread, jobs, threadCount );
 
     // Count the total pairs and copy the pair buffers
     // to the actual destination pair buffer.
@@ -868,15 +965,17 @@ uint64 MemPhase1::FpPair( const uint64* yBuffer, kBCJob jobs[MAX_THREADS],
     }
 
     // Sometimes we get more pairs than we support, so cap it.
-    if( pairCount > ENTRIES_PER_TABLE )
+    const uint64 maxEntries = 1ull << cx.k;
+
+    if( pairCount > maxEntries )
     {
-        const uint64 overflowEntries = pairCount - ENTRIES_PER_TABLE;
+        const uint64 overflowEntries = pairCount - maxEntries;
 
         auto& lastJob = jobs[threadCount-1];
         ASSERT( lastJob.pairCount >= overflowEntries );
         lastJob.pairCount -= overflowEntries;
        
-        pairCount = ENTRIES_PER_TABLE;
+        pairCount = maxEntries;
     }
 
     cx.threadPool->RunJob( (JobFunc)[]( void* pdata ) {
@@ -890,7 +989,7 @@ uint64 MemPhase1::FpPair( const uint64* yBuffer, kBCJob jobs[MAX_THREADS],
     Log::Line( "  Finished pairing L/R groups in %.4lf seconds. Created %llu pairs.", elapsed, pairCount );
     Log::Line( "  Average of %.4lf pairs per group.", pairCount / (float64)groupCount );
 
-    ASSERT( pairCount <= ENTRIES_PER_TABLE );
+    ASSERT( pairCount <= maxEntries );
 
     #if DBG_TEST_PAIRS
         DbgTestPairs( pairCount, outPairBuffer, yBuffer );
@@ -910,9 +1009,6 @@ void FpPairThread( kBCJob* job )
     Pair*  pairs     = job->pairs;
     uint64 pairCount = 0;
 
-    uint8  rMapCounts [kBC];
-    uint16 rMapIndices[kBC];
-
     uint64 groupLStart = job->startIndex;
     uint64 groupL      = yBuffer[groupLStart] / kBC;
 
@@ -924,65 +1020,110 @@ void FpPairThread( kBCJob* job )
         if( groupR - groupL == 1 )
         {
             // Groups are adjacent, calculate matches
+            const uint64 groupREnd = groupBoundaries[i+1];
+            ASSERT( groupREnd - groupRStart <= 350 );
+
+            pairCount += MatchBCGroupPair( yBuffer + groupLStart, (uint32)( groupRStart - groupLStart ),
+                                           yBuffer + groupRStart, (uint32)( groupREnd - groupRStart ),
+                                           groupL, (uint32)groupLStart, (uint32)groupRStart,
+                                           pairs + pairCount, (uint32)std::min( maxPairs - pairCount, (uint64)0xFFFFFFFF ) );
+
+            ASSERT( pairCount <= maxPairs );
+            if( pairCount == maxPairs )
+                goto RETURN;
+        }
+        // Else: Not an adjacent group, skip to next one.
+
+        // Go to next group
+        groupL      = groupR;
+        groupLStart = groupRStart;
+    }
+
+RETURN:
+    job->pairCount = pairCount;
+}
+
+//-----------------------------------------------------------
+void FpPairGroupedThread( kBCJob* job )
+{
+    const uint64  maxPairs        = job->maxCount;
+    const uint32  groupCount      = (uint32)job->groupCount;
+    const uint32* groupBoundaries = job->groupBoundaries;
+    const uint64* yBuffer         = job->yBuffer;
+
+    Pair*  pairs     = job->pairs;
+    uint64 pairCount = 0;
+
+    // Entries with the same y are not contiguous within a group,
+    // so chain them through their index from the group start, plus 1, in index order.
+    uint16 rMapHeads[kBC];
+    uint16 rMapNext [kBC];
+
+    memset( rMapHeads, 0, sizeof( rMapHeads ) );
+
+    uint64 groupLStart = job->startIndex;
+    uint64 groupL      = yBuffer[groupLStart] / kBC;
+
+    for( uint32 i = 0; i < groupCount; i++ )
+    {
+        const uint64 groupRStart = groupBoundaries[i];
+        const uint64 groupR      = yBuffer[groupRStart] / kBC;
+
+        if( groupR - groupL == 1 )
+        {
             const uint16 parity           = groupL & 1;
             const uint64 groupREnd        = groupBoundaries[i+1];
 
             const uint64 groupLRangeStart = groupL * kBC;
             const uint64 groupRRangeStart = groupR * kBC;
-            
+
             ASSERT( groupREnd - groupRStart <= 350 );
             ASSERT( groupLRangeStart == groupRRangeStart - kBC );
 
-            // Prepare a map of range kBC to store which indices from groupR are used
-            // For now just iterate our bGroup to find the pairs
-           
-            // #NOTE: memset(0) works faster on average than keeping a separate a clearing buffer
-            memset( rMapCounts, 0, sizeof( rMapCounts ) );
-
-            for( uint64 iR = groupRStart; iR < groupREnd; iR++ )
+            // Push backwards, so that each chain walks forward
+            for( uint64 iR = groupREnd; iR > groupRStart; )
             {
-                uint64 localRY = yBuffer[iR] - groupRRangeStart;
+                iR--;
+                const uint64 localRY = yBuffer[iR] - groupRRangeStart;
                 ASSERT( yBuffer[iR] / kBC == groupR );
 
-                if( rMapCounts[localRY] == 0 )
-                    rMapIndices[localRY] = (uint16)( iR - groupRStart );
+                const uint16 rIdx = (uint16)( iR - groupRStart );
 
-                rMapCounts[localRY] ++;
+                rMapNext [rIdx]    = rMapHeads[localRY];
+                rMapHeads[localRY] = rIdx + 1;
             }
 
-            // For each group L entry
             for( uint64 iL = groupLStart; iL < groupRStart; iL++ )
             {
                 const uint64 yL     = yBuffer[iL];
                 const uint64 localL = yL - groupLRangeStart;
 
-                // Iterate kExtraBitsPow = 1 << kExtraBits = 1 << 6 == 64
-                // So iterate 64 times for each L entry.
                 for( int iK = 0; iK < kExtraBitsPow; iK++ )
                 {
                     const uint64 targetR = L_targets[parity][localL][iK];
 
-                    for( uint j = 0; j < rMapCounts[targetR]; j++ )
+                    for( uint32 r = rMapHeads[targetR]; r != 0; r = rMapNext[r-1] )
                     {
-                        const uint64 iR = groupRStart + rMapIndices[targetR] + j;
+                        const uint64 iR = groupRStart + r - 1;
 
                         ASSERT( iL < iR );
 
-                        // Add a new pair
                         Pair& pair = pairs[pairCount++];
                         pair.left  = (uint32)iL;
                         pair.right = (uint32)iR;
-                        
+
                         ASSERT( pairCount <= maxPairs );
                         if( pairCount == maxPairs )
                             goto RETURN;
                     }
                 }
             }
+
+            // Clear only the entries that were used, for the next group
+            for( uint64 iR = groupRStart; iR < groupREnd; iR++ )
+                rMapHeads[yBuffer[iR] - groupRRangeStart] = 0;
         }
-        // Else: Not an adjacent group, skip to next one.
 
-        // Go to next group
         groupL      = groupR;
         groupLStart = groupRStart;
     }
@@ -1007,35 +1148,31 @@ void MemPhase1::FpComputeFx( const uint64 entryCount, const Pair* lrPairs,
     Log::Line( "  Computing Fx..." );
     auto timer = TimerBegin();
     
-    const uint   threadCount     = cx.threadCount;
-    const uint64 entriesPerThred = entryCount / threadCount;
-    const uint64 trailingEntries = entryCount - (entriesPerThred * threadCount);
-
     // Table 7 needs 32-bit y outputs, so we have to change it here
     TYOut* tYOut = (TYOut*)outYBuffer;
 
-    using Job = FpFxJob<TYOut, TMetaIn, TMetaOut>;
-    Job jobs[MAX_THREADS];
+    const uint32 k = cx.k;
 
-    for( uint i = 0; i < threadCount; i++ )
-    {
-        Job& job = jobs[i];
+    using Job = FpFxJob<TYOut, TMetaIn, TMetaOut>;
 
-        const size_t offset = entriesPerThred * i;
+    // Calculate Fx, balancing the pairs across threads with work stealing.
+    // In NUMA-local mode each node only computes the entries its partition of the output holds.
+    RunNodeLocalRanges( cx, entryCount, [=]( AnonMTJob* self, uint64 offset, uint64 count ) {
 
-        job.entryCount    = entriesPerThred;
+        Job job;
+        job.entryCount    = count;
         job.inMetaBuffer  = inMetaBuffer;             // These should NOT be offseted as we 
         job.inYBuffer     = inYBuffer;                // use them as lookup tables based on the lrPairs
         job.lrPairs       = lrPairs       + offset;
         job.outMetaBuffer = outMetaBuffer + offset;
         job.outYBuffer    = tYOut         + offset;
-    }
-
-    // Add trailing entries to the last job
-    jobs[threadCount-1].entryCount += trailingEntries;
+        job.k             = k;
 
-    // Calculate Fx
-    cx.threadPool->RunJob( ComputeFxJob<TYOut, TMetaIn, TMetaOut>, jobs, threadCount );
+        if( k == _K )
+            ComputeFxJob<TYOut, TMetaIn, TMetaOut>( &job );
+        else
+            ComputeFxJobForK<TYOut, TMetaIn, TMetaOut>( &job );
+    });
 
     auto elapsed = TimerEnd( timer );
     Log::Line( "  Finished computing Fx in %.4lf seconds.", elapsed );
@@ -1063,82 +1200,251 @@ void ComputeFxJob( FpFxJob<TYOut, TMetaIn, TMetaOut>* job )
         uint64 lastLeft = 0;
     #endif
 
+    // Fx inputs are serialized and hashed in batches so that blake3 can process multiple pairs in parallel SIMD lanes
+    constexpr uint64 BatchSize  = 64;
+    constexpr size_t bufferSize = CDiv( _K + kExtraBits + _K * metaKMultiplierIn * 2, 8 );
+
+    uint64 inputs [BatchSize][5];   // y + L + R
+    uint64 outputs[BatchSize][4];   // blake3 hashed output
+
     // Intermediate metadata holder
     uint64 lrMetadata[4];
 
-    for( uint64 i = 0; i < entryCount; i++ )
+    for( uint64 batchStart = 0; batchStart < entryCount; batchStart += BatchSize )
     {
-        const Pair& pair = lrPairs[i];
+        const uint64 batchCount = std::min( BatchSize, entryCount - batchStart );
 
-        #if _DEBUG
-            ASSERT( pair.left >= lastLeft );
-            lastLeft = pair.left;
-        #endif
-
-        // Read y
-        const uint64 y = inYBuffer[pair.left];
+        TMetaOut* metaOut = outMetaBuffer;
 
-        // Read metadata
-        if constexpr( metaKMultiplierIn == 1 )
+        for( uint64 j = 0; j < batchCount; j++ )
         {
-            uint32* meta32 = (uint32*)lrMetadata;
+            const Pair& pair = lrPairs[batchStart+j];
 
-            meta32[0] = inMetaBuffer[pair.left ];    // Metadata( l and r x's)
-            meta32[1] = inMetaBuffer[pair.right];
+            #if _DEBUG
+                ASSERT( pair.left >= lastLeft );
+                lastLeft = pair.left;
+            #endif
+
+            // Read y
+            const uint64 y = inYBuffer[pair.left];
+
+            // Read metadata
+            if constexpr( metaKMultiplierIn == 1 )
+            {
+                uint32* meta32 = (uint32*)lrMetadata;
+
+                meta32[0] = inMetaBuffer[pair.left ];    // Metadata( l and r x's)
+                meta32[1] = inMetaBuffer[pair.right];
+            }
+            else if constexpr( metaKMultiplierIn == 2 )
+            {
+                lrMetadata[0] = inMetaBuffer[pair.left ];
+                lrMetadata[1] = inMetaBuffer[pair.right];
+            }
+            else
+            {
+                // For 3 and 4 we just use 16 bytes (2 64-bit entries)
+                const Meta4* inMeta4 = static_cast<const Meta4*>( inMetaBuffer );
+                const Meta4& meta4L  = inMeta4[pair.left ];
+                const Meta4& meta4R  = inMeta4[pair.right];
+
+                lrMetadata[0] = meta4L.m0;
+                lrMetadata[1] = meta4L.m1;
+                lrMetadata[2] = meta4R.m0;
+                lrMetadata[3] = meta4R.m1;
+            }
+
+            ComputeFxInput<metaKMultiplierIn, metaKMultiplierOut>( y, lrMetadata, inputs[j], (uint64*)metaOut );
+
+            if constexpr( metaKMultiplierOut != 0 )
+                metaOut ++;
         }
-        else if constexpr( metaKMultiplierIn == 2 )
+
+        blake3_hash_short_many( inputs, sizeof( inputs[0] ), bufferSize, (size_t)batchCount, (uint8_t*)outputs );
+
+        for( uint64 j = 0; j < batchCount; j++ )
         {
-            lrMetadata[0] = inMetaBuffer[pair.left ];
-            lrMetadata[1] = inMetaBuffer[pair.right];
+            outYBuffer[batchStart+j] = (TYOut)ComputeFxOutput<metaKMultiplierIn, metaKMultiplierOut, extraBitsShift>( outputs[j], (uint64*)outMetaBuffer );
+
+            if constexpr( metaKMultiplierOut != 0 )
+                outMetaBuffer ++;
         }
+    }
+}
+
+//-----------------------------------------------------------
+// Metadata as a single right-aligned value. Meta3 and Meta4
+// hold their upper bits in m0, and their low 32 or 64 bits in m1.
+template<typename TMeta>
+inline uint128 LoadMetaForK( const TMeta& meta )
+{
+    if constexpr( std::is_same_v<TMeta, Meta3> )
+        return (uint128)meta.m0 << 32 | ( meta.m1 & 0xFFFFFFFF );
+    else if constexpr( std::is_same_v<TMeta, Meta4> )
+        return (uint128)meta.m0 << 64 | meta.m1;
+    else
+        return (uint128)meta;
+}
+
+//-----------------------------------------------------------
+template<typename TMeta>
+inline void StoreMetaForK( TMeta& meta, const uint128 value )
+{
+    if constexpr( std::is_same_v<TMeta, Meta3> )
+    {
+        meta.m0 = (uint64)( value >> 32 );
+        meta.m1 = (uint64)value & 0xFFFFFFFF;
+    }
+    else if constexpr( std::is_same_v<TMeta, Meta4> )
+    {
+        meta.m0 = (uint64)( value >> 64 );
+        meta.m1 = (uint64)value;
+    }
+    else
+        meta = (TMeta)value;
+}
+
+//-----------------------------------------------------------
+// Appends the low bitCount bits of value to a big-endian bit stream held in 64-bit fields
+inline void WriteBitsBE( uint64* fields, uint64& position, const uint128 value, const uint32 bitCount )
+{
+    uint32 remaining = bitCount;
+
+    while( remaining > 0 )
+    {
+        const uint32 bits  = std::min( remaining, 64u );
+        const uint64 v     = (uint64)( value >> ( remaining - bits ) ) & ( bits == 64 ? ~0ull : ( 1ull << bits ) - 1 );
+        const uint64 field = position >> 6;
+        const uint32 free  = 64 - (uint32)( position & 63 );
+
+        if( bits <= free )
+            fields[field] |= v << ( free - bits );
         else
         {
-            // For 3 and 4 we just use 16 bytes (2 64-bit entries)
-            const Meta4* inMeta4 = static_cast<const Meta4*>( inMetaBuffer );
-            const Meta4& meta4L  = inMeta4[pair.left ];
-            const Meta4& meta4R  = inMeta4[pair.right];
-
-            lrMetadata[0] = meta4L.m0;
-            lrMetadata[1] = meta4L.m1;
-            lrMetadata[2] = meta4R.m0;
-            lrMetadata[3] = meta4R.m1;
+            fields[field]   |= v >> ( bits - free );
+            fields[field+1] |= v << ( 64 - ( bits - free ) );
         }
 
-        TYOut f = (TYOut)ComputeFx<metaKMultiplierIn, metaKMultiplierOut, extraBitsShift>( y, lrMetadata, (uint64*)outMetaBuffer );
+        position  += bits;
+        remaining -= bits;
+    }
+}
 
-        outYBuffer[i] = f;
+//-----------------------------------------------------------
+// Reads bitCount bits at position from the hash, as big-endian 64-bit fields
+inline uint128 ReadBitsBE( const uint64 hash[4], const uint64 position, const uint32 bitCount )
+{
+    uint128 value     = 0;
+    uint64  pos       = position;
+    uint32  remaining = bitCount;
+
+    while( remaining > 0 )
+    {
+        const uint32 bits  = std::min( remaining, 64u );
+        const uint64 field = pos >> 6;
+        const uint32 shift = (uint32)( pos & 63 );
+
+        uint64 v = hash[field] << shift;
+        if( shift && field + 1 < 4 )
+            v |= hash[field+1] >> ( 64 - shift );
 
-        if constexpr( metaKMultiplierOut != 0 )
-            outMetaBuffer ++;
+        value      = value << bits | ( v >> ( 64 - bits ) );
+        pos       += bits;
+        remaining -= bits;
     }
-}
 
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wattributes"
+    return value;
+}
 
 //-----------------------------------------------------------
-template<size_t metaKMultiplierIn, size_t metaKMultiplierOut, uint ShiftBits>
-FORCE_INLINE uint64 ComputeFx( uint64 y, uint64* metaData, uint64* metaOut )
+// Same as ComputeFxJob, for k values other than 32. The inputs are serialized
+// bit by bit instead of with the fixed k32 layouts in ComputeFxInput.
+template<typename TYOut, typename TMetaIn, typename TMetaOut>
+void ComputeFxJobForK( FpFxJob<TYOut, TMetaIn, TMetaOut>* job )
 {
-    static_assert( metaKMultiplierIn != 0, "Invalid metaKMultiplier" );
+    constexpr size_t metaKMultiplierIn  = SizeForMeta<TMetaIn >::Value;
+    constexpr size_t metaKMultiplierOut = SizeForMeta<TMetaOut>::Value;
+
+    const uint32   k             = job->k;
+    const uint32   ySize         = k + kExtraBits;
+    const uint32   yOutSize      = metaKMultiplierOut == 0 ? k : ySize;     // Table 7 has no extra bits
+    const uint32   metaInSize    = k * (uint32)metaKMultiplierIn;
+    const uint32   metaOutSize   = k * (uint32)metaKMultiplierOut;
+    const size_t   bufferSize    = CDiv( ySize + metaInSize * 2, 8 );
+
+    const uint64   entryCount    = job->entryCount;
+    const Pair*    lrPairs       = job->lrPairs;
+    const TMetaIn* inMetaBuffer  = job->inMetaBuffer;
+    const uint64*  inYBuffer     = job->inYBuffer;
+    TMetaOut*      outMetaBuffer = job->outMetaBuffer;
+    TYOut*         outYBuffer    = job->outYBuffer;
+
+    ASSERT( k < _K );
+
+    constexpr uint64 BatchSize = 64;
 
-    // Helper consts
-    const uint   k           = _K;
-    const uint32 ySize       = k + kExtraBits;         // = 38
-    const uint32 yShift      = 64 - (k + ShiftBits);   // = 26 or 32
-    const size_t metaSize    = k * metaKMultiplierIn;
-    const size_t metaSizeLR  = metaSize * 2;
+    uint64  inputs [BatchSize][5];
+    uint64  outputs[BatchSize][4];
+    uint128 lrMeta [BatchSize];     // L + R, for the tables whose output metadata is just that
 
-    const size_t bufferSize  = CDiv( ySize + metaSizeLR, 8 );
+    for( uint64 batchStart = 0; batchStart < entryCount; batchStart += BatchSize )
+    {
+        const uint64 batchCount = std::min( BatchSize, entryCount - batchStart );
+
+        for( uint64 j = 0; j < batchCount; j++ )
+        {
+            const Pair&   pair = lrPairs[batchStart+j];
+            const uint128 l    = LoadMetaForK( inMetaBuffer[pair.left ] );
+            const uint128 r    = LoadMetaForK( inMetaBuffer[pair.right] );
+
+            uint64* input    = inputs[j];
+            uint64  position = 0;
+            memset( input, 0, sizeof( inputs[0] ) );
 
+            WriteBitsBE( input, position, inYBuffer[pair.left], ySize );
+            WriteBitsBE( input, position, l, metaInSize );
+            WriteBitsBE( input, position, r, metaInSize );
 
-    // Hashing input and output buffers
-    uint64 input [5];       // y + L + R
-    uint64 output[4];       // blake3 hashed output
+            for( uint32 f = 0; f < 5; f++ )
+                input[f] = Swap64( input[f] );
 
-    blake3_hasher hasher;
+            lrMeta[j] = l << metaInSize | r;
+        }
+
+        blake3_hash_short_many( inputs, sizeof( inputs[0] ), bufferSize, (size_t)batchCount, (uint8_t*)outputs );
+
+        for( uint64 j = 0; j < batchCount; j++ )
+        {
+            uint64 hash[4];
+            for( uint32 f = 0; f < 4; f++ )
+                hash[f] = Swap64( outputs[j][f] );
 
+            outYBuffer[batchStart+j] = (TYOut)( hash[0] >> ( 64 - yOutSize ) );
+
+            if constexpr( metaKMultiplierOut != 0 )
+            {
+                // Tables 2 and 3 output L + R, the others take their metadata from the hash
+                const uint128 meta = metaKMultiplierOut == metaKMultiplierIn * 2 ? lrMeta[j] :
+                                     ReadBitsBE( hash, ySize, metaOutSize );
+
+                StoreMetaForK( outMetaBuffer[batchStart+j], meta );
+            }
+        }
+    }
+}
 
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wattributes"
+
+//-----------------------------------------------------------
+// Serializes y + L + R into the blake3 input buffer. When the output metadata
+// is just L + R, it is written here as well.
+//-----------------------------------------------------------
+template<size_t metaKMultiplierIn, size_t metaKMultiplierOut>
+FORCE_INLINE void ComputeFxInput( uint64 y, const uint64* metaData, uint64* input, uint64* metaOut )
+{
+    static_assert( metaKMultiplierIn != 0, "Invalid metaKMultiplier" );
+    
     // Prepare the input buffer depending on the metadata size
     if constexpr( metaKMultiplierIn == 1 )
     {
@@ -1152,8 +1458,8 @@ FORCE_INLINE uint64 ComputeFx( uint64 y, uint64* metaData, uint64* metaOut )
          *    0        1
          */
 
-        const uint64 l = reinterpret_cast<uint32*>( metaData )[0];
-        const uint64 r = reinterpret_cast<uint32*>( metaData )[1];
+        const uint64 l = reinterpret_cast<const uint32*>( metaData )[0];
+        const uint64 r = reinterpret_cast<const uint32*>( metaData )[1];
 
         input[0] = Swap64( y << 26 | l >> 6  );
         input[1] = Swap64( l << 58 | r << 26 );
@@ -1232,12 +1538,17 @@ FORCE_INLINE uint64 ComputeFx( uint64 y, uint64* metaData, uint64* metaOut )
         input[3] = Swap64( r0 << 26 | r1 >> 38 );
         input[4] = Swap64( r1 << 26 );
     }
+}
 
-
-    // Hash the input
-    blake3_hasher_init( &hasher );
-    blake3_hasher_update( &hasher, input, bufferSize );
-    blake3_hasher_finalize( &hasher, (uint8_t*)output, sizeof( output ) );
+//-----------------------------------------------------------
+// Computes f and, for tables >= 4, the output metadata from the blake3 hash.
+//-----------------------------------------------------------
+template<size_t metaKMultiplierIn, size_t metaKMultiplierOut, uint ShiftBits>
+FORCE_INLINE uint64 ComputeFxOutput( const uint64* output, uint64* metaOut )
+{
+    const uint   k      = _K;
+    const uint32 ySize  = k + kExtraBits;         // = 38
+    const uint32 yShift = 64 - (k + ShiftBits);   // = 26 or 32
 
     uint64 f = Swap64( *output ) >> yShift;
 
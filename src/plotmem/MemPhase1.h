@@ -2,7 +2,47 @@
 #include "PlotContext.h"
 
 
-struct kBCJob;
+struct F1GenJob
+{
+    const byte* key;
+
+    uint32  blockCount;
+    uint32  entryCount;
+    uint32  x;
+    byte*   blocks;
+    uint64* yBuffer;
+    uint32* xBuffer;
+};
+
+struct kBCJob
+{
+    const uint64* yBuffer;
+    uint64        maxCount;         // Max group count for scan job, pair count for pair job.
+    uint64        groupCount;
+    uint32*       groupBoundaries;
+    uint64        startIndex;
+
+    // For scan job
+    uint64 endIndex;
+
+    // For scan job
+    uint64 pairCount;        // Group count for scan job, pair count for pair job.
+    Pair*  pairs;
+    Pair*  copyDst;          // For second pass
+
+#if DEBUG
+    uint32 jobIdx;
+#endif
+};
+
+// Per-thread phase 1 kernels. Also used by the kernel benchmarks.
+void F1JobThread ( F1GenJob* job );
+void FpScanThread( kBCJob* job );
+void FpPairThread( kBCJob* job );
+
+// Same as FpPairThread, but for y which is only ordered on its kBC group (see SortFxOnGroups).
+// Emits the same pairs, in the same order, as FpPairThread over the sorted groups would, relative to each entry's index.
+void FpPairGroupedThread( kBCJob* job );
 
 template<typename T>
 struct ReadWriteBuffer
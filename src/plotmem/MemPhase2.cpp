@@ -1,5 +1,8 @@
 #include "MemPhase2.h"
 #include "DbgHelper.h"
+#include "plotting/PlotBenchmark.h"
+#include "util/PerfCounters.h"
+#include "threading/MTJob.h"
 
 ///
 /// Job structs
@@ -11,25 +14,11 @@ struct ClearMarkingBufferJob
     size_t size;
 };
 
-struct MarkJob
-{
-    uint64      startIndex;
-    uint64      rightEntryCount;
-    const Pair* rightEntries;
-    const byte* rightMarkedEntries;  // Used in tables <= 5
-    byte*       leftMarkingBuffer;
-
-    uint64      fieldPerMarkingBuffer;
-};
-
 ///
 /// Internal Functions
 ///
 void ClearMarkedEntriesThread( ClearMarkingBufferJob* job );
 
-template<bool HasRightTableMarkingBuffer>
-void MarkEntriesThread( MarkJob* job );
-
 
 void DbgReadPhase1TableFiles( MemPlotContext& cx );
 void DbgCountMarkedEntries( MemPlotContext& cx );
@@ -79,8 +68,9 @@ void MemPhase2::Run()
         cx.t7LRBuffer
     };
 
+    // Dropped tables are inlined into the next one, so marking stops at the first stored table
     const bool isCompressed = cx.cfg.gCfg->compressionLevel > 0;
-    const uint endTable     = (uint)(isCompressed ? TableId::Table3 : TableId::Table2);
+    const uint endTable     = (uint)TableId::Table2 + (isCompressed ? cx.cfg.gCfg->numDroppedTables : 0);
 
     // #NOTE: We don't need to prune table 1. 
     //        Since it doesn't refer back to other values,
@@ -108,6 +98,8 @@ void MemPhase2::Run()
 
         double elapsed = TimerEnd( timer );
         Log::Line( "  Finished prunning table %d in %.2lf seconds.", i, elapsed );
+        PlotBenchmark::RecordTable( 2, (TableId)i, elapsed );
+        PerfCounters::RecordTable( 2, (TableId)i, elapsed );
     }
 
     // DbgCountMarkedEntries( cx );
@@ -119,7 +111,7 @@ void MemPhase2::ClearMarkingBuffers()
 {
     MemPlotContext& cx = _context;
 
-    const uint64 maxEntries    = 1ull << _K;
+    const uint64 maxEntries    = 1ull << cx.k;
     byte*        markingBuffer = (byte*)cx.yBuffer0;
 
     const size_t totalSize     = maxEntries * 5;  // We need 5 buffers, for tables 2-6 
@@ -154,74 +146,107 @@ void MemPhase2::MarkTable( const Pair* rightTable, uint64 rightEntryCount, const
 {
     MemPlotContext& cx = _context;
 
-    const uint   threadCount           = cx.threadCount;
-    const uint64 rightEntriesPerThread = rightEntryCount / threadCount;
+    // Writing the marks straight from the pairs scatters each thread's writes
+    // across the whole marking buffer, so threads keep stealing cache lines from each other.
+    // Instead, the referenced L indices are first bucketed by partition of the marking buffer,
+    // then each thread marks its own range of partitions, which fit in its cache.
+    // metaBuffer1 is not in use during this phase, so it holds the bucketed indices.
+    const uint32 threadCount    = cx.threadCount;
+    const uint64 partitionCount = std::max( ( 1ull << cx.k ) >> MarkPartitionBits, 1ull );   // Small k plots fit in a single partition
 
-    MarkJob jobs[MAX_THREADS];
+    uint64* counts           = bbcalloc<uint64>( (size_t)threadCount * partitionCount );
+    uint64* partitionOffsets = bbcalloc<uint64>( partitionCount + 1 );
+    uint32* lIndices         = (uint32*)cx.metaBuffer1;
 
-    for( uint i = 0; i < threadCount; i++ )
-    {
-        auto& job = jobs[i];
+    ASSERT( rightEntryCount * 2 * sizeof( uint32 ) <= ( 1ull << cx.k ) * sizeof( Meta4 ) );
 
-        job.startIndex         = i * rightEntriesPerThread;
-        job.rightEntryCount    = rightEntriesPerThread;
-        job.rightEntries       = rightTable;
-        job.rightMarkedEntries = rMarkedEntries;
-        job.leftMarkingBuffer  = lMarkingBuffer;
-    }
+    AnonMTJob::Run( *cx.threadPool, threadCount, [=]( AnonMTJob* self ) {
 
-    // Add trailing entries to the last job
-    jobs[threadCount-1].rightEntryCount += (rightEntryCount - ( rightEntriesPerThread  * threadCount ) );
+        uint64 count, offset, end;
+        GetThreadOffsets( self, rightEntryCount, count, offset, end );
 
-    cx.threadPool->RunJob( MarkEntriesThread<HasRightTableMarkingBuffer>, jobs, threadCount );
-}
+        uint64* tCounts = counts + (size_t)self->JobId() * partitionCount;
+        memset( tCounts, 0, sizeof( uint64 ) * partitionCount );
 
-//-----------------------------------------------------------
-void ClearMarkedEntriesThread( ClearMarkingBufferJob* job )
-{
-    memset( job->buffer, 0, job->size );
-}
+        // Count how many indices fall on each partition
+        for( uint64 i = offset; i < end; i++ )
+        {
+            if constexpr ( HasRightTableMarkingBuffer )
+            {
+                // If this entry is not marked as used 
+                // in the right marked buffer, then skip it.
+                // It did not contribute to the final f7 value,
+                // so we don't need to consider it.
+                if( !rMarkedEntries[i] )
+                    continue;
+            }
 
-//-----------------------------------------------------------
-template<bool HasRightTableMarkingBuffer>
-void MarkEntriesThread( MarkJob* job )
-{
-    const uint64 startIndex  = job->startIndex;
-    const uint64 endIndex    = startIndex + job->rightEntryCount;
+            const Pair& entry = rightTable[i];
+            ASSERT( ( entry.left >> MarkPartitionBits ) < partitionCount && ( entry.right >> MarkPartitionBits ) < partitionCount );
 
-    const Pair* rightEntries = job->rightEntries;
+            tCounts[entry.left  >> MarkPartitionBits]++;
+            tCounts[entry.right >> MarkPartitionBits]++;
+        }
 
-    const byte* rightMarkedEntries = job->rightMarkedEntries;
-    byte* markingBuffer            = job->leftMarkingBuffer;
-    
-    // #NOTE: This can easily cause false sharing.
-    //        but since the region of data is so big, the thread acount
-    //        no expected to be so great (maybe max 256?)
-    //        and the data write locations are random, I don't
-    //        think it will cause that many misses.
-    //        In practice this method has been faster than others
-    //        which take false-sharing into account.
-    //        We also only write to the location, we don't care
-    //        about reading it, so we won't have any invalid data.
-    //       This means, thought, that this might not scale linearly, though.
-
-    for( uint64 i = startIndex; i < endIndex; i++ )
-    {
-        if constexpr ( HasRightTableMarkingBuffer )
+        // Turn the counts into each thread's write offset into each partition
+        if( self->BeginLockBlock() )
         {
-            // If this entry is not marked as used 
-            // in the right marked buffer, then skip it.
-            // It did not contribute to the final f7 value,
-            // so we don't need to consider it.
-            if( !rightMarkedEntries[i] )
-                continue;
+            uint64 total = 0;
+
+            for( uint64 p = 0; p < partitionCount; p++ )
+            {
+                partitionOffsets[p] = total;
+
+                for( uint32 t = 0; t < threadCount; t++ )
+                {
+                    uint64&      c = counts[(size_t)t * partitionCount + p];
+                    const uint64 n = c;
+
+                    c      = total;
+                    total += n;
+                }
+            }
+
+            partitionOffsets[partitionCount] = total;
         }
+        self->EndLockBlock();
 
-        const Pair& entry = rightEntries[i];
+        // Bucket the indices
+        for( uint64 i = offset; i < end; i++ )
+        {
+            if constexpr ( HasRightTableMarkingBuffer )
+            {
+                if( !rMarkedEntries[i] )
+                    continue;
+            }
 
-        markingBuffer[entry.left ] = 1;
-        markingBuffer[entry.right] = 1;
-    }
+            const Pair& entry = rightTable[i];
+
+            lIndices[tCounts[entry.left  >> MarkPartitionBits]++] = entry.left;
+            lIndices[tCounts[entry.right >> MarkPartitionBits]++] = entry.right;
+        }
+
+        self->SyncThreads();
+
+        // Mark our own partitions. Their indices are contiguous.
+        uint64 pCount, pOffset, pEnd;
+        GetThreadOffsets( self, partitionCount, pCount, pOffset, pEnd );
+
+        const uint32* indices    = lIndices + partitionOffsets[pOffset];
+        const uint32* indicesEnd = lIndices + partitionOffsets[pEnd];
+
+        for( ; indices < indicesEnd; indices++ )
+            lMarkingBuffer[*indices] = 1;
+    });
+
+    free( counts );
+    free( partitionOffsets );
+}
+
+//-----------------------------------------------------------
+void ClearMarkedEntriesThread( ClearMarkingBufferJob* job )
+{
+    memset( job->buffer, 0, job->size );
 }
 
 
@@ -272,7 +297,7 @@ void DbgReadPhase1TableFiles( MemPlotContext& cx )
 //-----------------------------------------------------------
 void DbgReadWritePhase2MarkedEntries( MemPlotContext& cx, bool write )
 {
-    const uint64 maxEntries    = 1ull << _K;
+    const uint64 maxEntries    = 1ull << cx.k;
     byte*        markingBuffer = (byte*)cx.yBuffer0;
     const size_t sizePerTable  = maxEntries;
 
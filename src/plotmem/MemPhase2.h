@@ -18,6 +18,9 @@ public:
 
 private:
 
+    // Size of a marking partition, 1 MiB of the marking buffer, which a thread marks on its own
+    static constexpr uint32 MarkPartitionBits = 20;
+
     void ClearMarkingBuffers();
 
     template<bool HasRightTableMarkingBuffer>
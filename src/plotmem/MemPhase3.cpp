@@ -1,14 +1,20 @@
 #include "MemPhase3.h"
+#include "MemPhase4.h"
 #include "util/Util.h"
 #include "util/Log.h"
 #include "algorithm/RadixSort.h"
 #include "LPGen.h"
 #include "ParkWriter.h"
+#include "plotting/PlotBenchmark.h"
+#include "util/PerfCounters.h"
 #include <cmath>
 
 #include "DbgHelper.h"
 #include "SysHost.h"
 
+// Park data compressed before it is submitted to the plot writer
+static constexpr size_t PARK_CHUNK_SIZE = 64 MiB;
+
 
 //-----------------------------------------------------------
 MemPhase3::MemPhase3( MemPlotContext& context )
@@ -16,10 +22,12 @@ MemPhase3::MemPhase3( MemPlotContext& context )
 {}
 
 //-----------------------------------------------------------
-void MemPhase3::Run()
+void MemPhase3::Run( MemPhase4* phase4 )
 {
     MemPlotContext& cx = _context;
 
+    _phase4 = phase4;
+
     // These will become the park buffer once processed.
     Pair* rTables[7] = {
         nullptr,
@@ -40,12 +48,13 @@ void MemPhase3::Run()
     // Therefore after each iteration rTable will be a park buffer
     uint64* lpBuffer = cx.metaBuffer0;
 
-    const bool    isCompressed = cx.cfg.gCfg->compressionLevel > 0;
-    const TableId startTable   = isCompressed ? TableId::Table2 : TableId::Table1;
+    // Dropped tables were inlined into the first stored table in phase 1
+    const uint32  numDroppedTables = cx.cfg.gCfg->compressionLevel > 0 ? cx.cfg.gCfg->numDroppedTables : 0;
+    const TableId startTable       = TableId::Table1 + (TableId)numDroppedTables;
 
-    // Write a dummy table for table 1
-    if( isCompressed )
-        cx.plotWriter->ReserveTableSize( PlotTable::Table1, 0 );
+    // Write dummy tables for the dropped tables
+    for( uint32 i = 0; i < numDroppedTables; i++ )
+        cx.plotWriter->ReserveTableSize( (PlotTable)i, 0 );
 
     for( uint i = (uint)startTable; i < (uint)TableId::Table7; i++ )
     {
@@ -64,6 +73,8 @@ void MemPhase3::Run()
 
         double tElapsed = TimerEnd( tableTimer );
         Log::Line( "  Finished compressing tables %u and %u in %.2lf seconds", i+1, i+2, tElapsed );
+        PlotBenchmark::RecordTable( 3, (TableId)(i+1), tElapsed );
+        PerfCounters::RecordTable( 3, (TableId)(i+1), tElapsed );
         Log::Line( "  Table %d now has %llu / %llu entries ( %.2lf%% ).", 
             i+1, newCount, rTableCount, (newCount / (double)rTableCount) * 100 );
     }
@@ -175,39 +186,99 @@ uint64 MemPhase3::ProcessTable( uint32* lEntries, uint64* lpBuffer, Pair* rTable
     // #TODO: Only aligned if the user asked for it
 
 
+    if constexpr ( IsTable6 )
+    {
+        #if DBG_WRITE_SORTED_F7_TABLE
+        {
+            DbgWriteTableToFile( *cx.threadPool, DBG_TABLES_PATH "f7.tmp", newLength, cx.t7YBuffer, true );
+            DbgWriteTableToFile( *cx.threadPool, DBG_TABLES_PATH "t7indices.tmp", newLength, lEntries, true );
+        }
+        #endif
+    }
+
+    // Table 7 is final at this point, so phase 4 can build its tables on its own
+    // threads while we write table 6's parks on the rest of them.
+    // It writes to meta0 past the table 6 parks, and only touches table 7's f7 and L table.
+    Thread* p4Thread    = nullptr;
+    uint    parkThreads = 0;
+
+    if( IsTable6 && _phase4 && cx.p4ThreadPool )
+    {
+        parkThreads = cx.threadPool->ThreadCount() - cx.p4ThreadPool->ThreadCount();
+
+        p4Thread = new Thread( 4 MiB );
+        p4Thread->Run( Phase4ThreadMain, _phase4 );
+    }
+
     byte*  parkBuffer     = _context.plotWriter->BlockAlignPtr<byte>( rTable );
     // size_t sizeTableParks = WriteParks<MAX_THREADS>( *cx.threadPool, newLength, lpBuffer, parkBuffer, tableId );
 
-    size_t            parkSize    = CalculateParkSize( tableId );
-    uint64            stubBitSize = (_K - kStubMinusBits);
+    size_t            parkSize    = CalculateParkSize( tableId, cx.k );
+    uint64            stubBitSize = (cx.k - kStubMinusBits);
     const FSE_CTable* cTable      = CTables[(int)tableId];
+    double            rValue      = kRValues[(int)tableId];
 
-    if( tableId == TableId::Table2 && cx.cfg.gCfg->compressionLevel > 0 )
+    // The first stored table holds the inlined entries of the dropped tables
+    if( cx.cfg.gCfg->compressionLevel > 0 && (uint32)tableId == cx.cfg.gCfg->numDroppedTables )
     {
         parkSize    = cx.cfg.gCfg->compressionInfo.tableParkSize;
         stubBitSize = cx.cfg.gCfg->compressionInfo.stubSizeBits;
         cTable      = cx.cfg.gCfg->ctable;
+        rValue      = cx.cfg.gCfg->compressionInfo.ansRValue;
+    }
+
+    // The whole table is sorted at this point, so its parks can be coded with tables fitted to its deltas
+    if( cx.cfg.gCfg->tunedDeltas )
+    {
+        const double tunedRValue = TuneParkDeltaRValue( lpBuffer, newLength, stubBitSize, rValue );
+
+        if( tunedRValue != rValue )
+        {
+            rValue = tunedRValue;
+            cTable = CreateTunedCTable( rValue );
+            cx.plotWriter->SetDeltaRValue( (PlotTable)tableId, rValue );
+        }
     }
 
-    size_t sizeTableParks = WriteParks<MAX_THREADS>( *cx.threadPool, newLength, lpBuffer, parkBuffer, parkSize, stubBitSize, cTable );
+    const ParkDeltaCoding deltaCoding = cx.cfg.gCfg->parkDeltaCoding;
+    const RANSEncTable*   ransTable   = deltaCoding == ParkDeltaCoding::RANS ? CreateRANSEncTable( rValue ) : nullptr;
+
+    // Compress and submit the parks in chunks, so that the plot writer
+    // writes the start of the table while the rest of it is being compressed.
+    // Chunks are laid out back to back, so they are never overwritten while queued.
+    const uint64 parksPerChunk   = std::max( (uint64)( PARK_CHUNK_SIZE / parkSize ), (uint64)cx.threadPool->ThreadCount() );
+    const uint64 entriesPerChunk = parksPerChunk * kEntriesPerPark;
 
     cx.plotWriter->BeginTable( (PlotTable)tableId );
-    cx.plotWriter->WriteTableData( parkBuffer, sizeTableParks );
+
+    for( uint64 entryOffset = 0; entryOffset < newLength; entryOffset += entriesPerChunk )
+    {
+        const uint64 chunkEntries = std::min( entriesPerChunk, newLength - entryOffset );
+        byte*        chunkBuffer  = parkBuffer + entryOffset / kEntriesPerPark * parkSize;
+
+        const size_t chunkSize = WriteParks<MAX_THREADS>( *cx.threadPool, chunkEntries, lpBuffer + entryOffset, chunkBuffer,
+                                                          parkSize, stubBitSize, cTable, deltaCoding, ransTable, parkThreads, cx.k );
+
+        cx.plotWriter->WriteTableData( chunkBuffer, chunkSize );
+    }
+
     cx.plotWriter->EndTable();
 
-    if constexpr ( IsTable6 )
+    if( p4Thread )
     {
-        #if DBG_WRITE_SORTED_F7_TABLE
-        {
-            DbgWriteTableToFile( *cx.threadPool, DBG_TABLES_PATH "f7.tmp", newLength, cx.t7YBuffer, true );
-            DbgWriteTableToFile( *cx.threadPool, DBG_TABLES_PATH "t7indices.tmp", newLength, lEntries, true );
-        }
-        #endif
+        p4Thread->WaitForExit();
+        delete p4Thread;
     }
 
     return newLength;
 }
 
+//-----------------------------------------------------------
+void MemPhase3::Phase4ThreadMain( MemPhase4* phase4 )
+{
+    phase4->Build( *phase4->_context.p4ThreadPool );
+}
+
 //-----------------------------------------------------------
 template<bool PruneTable>
 void ProcessTableThread( LPJob* job )
@@ -271,8 +342,19 @@ void PruneAndMapThread( LPJob* job )
     // Scan entries
     {
         uint64 newLength = 0;
+        uint64 i         = srcOffset;
+
+        // Marks are always 0 or 1, so we can count 8 of them at a time
+        // by summing the bytes of a 64-bit word with a single multiply.
+        for( const uint64 end8 = srcOffset + length / 8 * 8; i < end8; i += 8 )
+        {
+            uint64 marks;
+            memcpy( &marks, markedEntries + i, sizeof( marks ) );
+
+            newLength += ( marks * 0x0101010101010101ull ) >> 56;
+        }
 
-        for( uint64 i = srcOffset; i < end; i++ )
+        for( ; i < end; i++ )
         {
             if( markedEntries[i] )
                 newLength ++;
@@ -330,18 +412,13 @@ void ConverToLinePointThread( LPJob* job )
     Pair*         rTable = (Pair*)(job->lpBuffer + job->offset);
     const uint32* lTable = job->lTable;
 
-    for( uint64 i = 0; i < length; i++ )
-    {
-        const Pair* rEntry = &rTable[i];
-        
-        const uint64 x = lTable[rEntry->left ];
-        const uint64 y = lTable[rEntry->right];
-        ASSERT( x || y );
+    // Converted in-place
+    PairsToLinePoints( rTable, lTable, (uint64*)rTable, length );
 
-        const uint64 lp = SquareToLinePoint( x, y );
-        ASSERT( lp );
-        *((uint64*)rEntry) = lp;//SquareToLinePoint( x, y );
-    }
+    #if _DEBUG
+        for( uint64 i = 0; i < length; i++ )
+            ASSERT( ((uint64*)rTable)[i] );
+    #endif
 }
 
 //-----------------------------------------------------------
@@ -1,6 +1,8 @@
 #pragma once
 #include "PlotContext.h"
 
+class MemPhase4;
+
 class MemPhase3
 {
     friend class MemPlotter;
@@ -8,7 +10,8 @@ public:
 
     MemPhase3( MemPlotContext& context );
 
-    void Run();
+    // If phase4 is given, it builds its tables while the table 6 parks are written
+    void Run( MemPhase4* phase4 = nullptr );
 
 private:
     template<bool IsTable6>
@@ -16,6 +19,9 @@ private:
                          Pair* rTable, const uint64 rTableCount, 
                          const byte* markedEntries, TableId tableId );
 
+    static void Phase4ThreadMain( MemPhase4* phase4 );
+
 private:
     MemPlotContext& _context;
+    MemPhase4*      _phase4 = nullptr;
 };
\ No newline at end of file
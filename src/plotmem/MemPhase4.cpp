@@ -1,6 +1,8 @@
 #include "MemPhase4.h"
 #include "plotting/CTables.h"
 #include "util/Log.h"
+#include "plotting/PlotBenchmark.h"
+#include "util/PerfCounters.h"
 
 //-----------------------------------------------------------
 MemPhase4::MemPhase4( MemPlotContext& context )
@@ -9,23 +11,44 @@ MemPhase4::MemPhase4( MemPlotContext& context )
 
 //-----------------------------------------------------------
 void MemPhase4::Run()
+{
+    MemPlotContext& cx = _context;
+
+    if( !_built )
+        Build( *cx.threadPool );
+
+    static constexpr PlotTable tables[4] = { PlotTable::Table7, PlotTable::C1, PlotTable::C2, PlotTable::C3 };
+
+    // #TODO: block-align written size
+    for( uint32 i = 0; i < 4; i++ )
+    {
+        cx.plotWriter->BeginTable( tables[i] );
+        cx.plotWriter->WriteTableData( _tableBuffers[i], _tableSizes[i] );
+        cx.plotWriter->EndTable();
+    }
+}
+
+//-----------------------------------------------------------
+void MemPhase4::Build( ThreadPool& pool )
 {
     // Use meta0 to write the final tables to disk
     MemPlotContext& cx = _context;
     
-    // The first 32 GiB of meta0 are used by phase 3 to write the table 6 park,
+    // The first half of meta0 (32 GiB at k32) is used by phase 3 to write the table 6 park,
     // so we need to offset here to write the rest.
-    cx.p4WriteBuffer = ((byte*)cx.metaBuffer0) + 32ull GB;
+    cx.p4WriteBuffer = ((byte*)cx.metaBuffer0) + ( 1ull << cx.k ) * sizeof( uint64 );
     cx.p4WriteBufferWriter = cx.p4WriteBuffer;
 
-    WriteP7();
-    WriteC1();
-    WriteC2();
-    WriteC3();
+    WriteP7( pool );
+    WriteC1( pool );
+    WriteC2( pool );
+    WriteC3( pool );
+
+    _built = true;
 }
 
 //-----------------------------------------------------------
-void MemPhase4::WriteP7()
+void MemPhase4::WriteP7( ThreadPool& pool )
 {
     // Write P7 (Table 7 park), which are indices into
     // the previous table's LinePoints (which are parked as well).
@@ -39,71 +62,67 @@ void MemPhase4::WriteP7()
     Log::Line( "  Writing P7." );
     auto timer = TimerBegin();
 
-    const size_t sizeWritten = WriteP7Parallel<MAX_THREADS>( *cx.threadPool, entryCount, lTable, p7Buffer );
+    const size_t sizeWritten = WriteP7Parallel<MAX_THREADS>( pool, entryCount, lTable, p7Buffer, cx.k );
     
     cx.p4WriteBufferWriter = ((byte*)p7Buffer) + sizeWritten;
     
-    // #TODO: block-align written size
-    cx.plotWriter->BeginTable( PlotTable::Table7 );
-    cx.plotWriter->WriteTableData( p7Buffer, sizeWritten );
-    cx.plotWriter->EndTable();
+    _tableBuffers[0] = p7Buffer;
+    _tableSizes  [0] = sizeWritten;
 
     double elapsed = TimerEnd( timer );
     Log::Line( "  Finished writing P7 in %.2lf seconds.", elapsed );
+    PlotBenchmark::RecordTable( 4, TableId::Table7, elapsed );
+    PerfCounters::RecordTable( 4, TableId::Table7, elapsed );
 }
 
 //-----------------------------------------------------------
-void MemPhase4::WriteC1()
+void MemPhase4::WriteC1( ThreadPool& pool )
 {
     MemPlotContext& cx = _context;
  
     const uint64 entryCount  = cx.entryCount[(int)TableId::Table7];
-    uint32*      writeBuffer = cx.plotWriter->BlockAlignPtr<uint32>( cx.p4WriteBufferWriter );
+    byte*        writeBuffer = cx.plotWriter->BlockAlignPtr<byte>( cx.p4WriteBufferWriter );
 
     Log::Line( "  Writing C1 table." );
     auto timer = TimerBegin();
 
     const size_t sizeWritten = WriteC12Parallel<MAX_THREADS, kCheckpoint1Interval>( 
-        *cx.threadPool, entryCount, cx.t7YBuffer, writeBuffer );
+        pool, entryCount, cx.t7YBuffer, writeBuffer, cx.k );
 
     cx.p4WriteBufferWriter = ((byte*)writeBuffer) + sizeWritten;
 
-    // #TODO: block-align written size
-    cx.plotWriter->BeginTable( PlotTable::C1 );
-    cx.plotWriter->WriteTableData( writeBuffer, sizeWritten );
-    cx.plotWriter->EndTable();
+    _tableBuffers[1] = writeBuffer;
+    _tableSizes  [1] = sizeWritten;
 
     double elapsed = TimerEnd( timer );
     Log::Line( "  Finished writing C1 table in %.2lf seconds.", elapsed );
 }
 
 //-----------------------------------------------------------
-void MemPhase4::WriteC2()
+void MemPhase4::WriteC2( ThreadPool& pool )
 {
     MemPlotContext& cx = _context;
  
     const uint64 entryCount  = cx.entryCount[(int)TableId::Table7];
-    uint32*      writeBuffer = cx.plotWriter->BlockAlignPtr<uint32>( cx.p4WriteBufferWriter );
+    byte*        writeBuffer = cx.plotWriter->BlockAlignPtr<byte>( cx.p4WriteBufferWriter );
 
     Log::Line( "  Writing C2 table." );
     auto timer = TimerBegin();
 
     const size_t sizeWritten = WriteC12Parallel<MAX_THREADS, kCheckpoint1Interval*kCheckpoint2Interval>( 
-        *cx.threadPool, entryCount, cx.t7YBuffer, writeBuffer );
+        pool, entryCount, cx.t7YBuffer, writeBuffer, cx.k );
 
     cx.p4WriteBufferWriter = ((byte*)writeBuffer) + sizeWritten;
 
-    // #TODO: block-align written size
-    cx.plotWriter->BeginTable( PlotTable::C2 );
-    cx.plotWriter->WriteTableData( writeBuffer, sizeWritten );
-    cx.plotWriter->EndTable();
+    _tableBuffers[2] = writeBuffer;
+    _tableSizes  [2] = sizeWritten;
 
     double elapsed = TimerEnd( timer );
     Log::Line( "  Finished writing C2 table in %.2lf seconds.", elapsed );
 }
 
 //-----------------------------------------------------------
-void MemPhase4::WriteC3()
+void MemPhase4::WriteC3( ThreadPool& pool )
 {
     MemPlotContext& cx = _context;
  
@@ -114,14 +133,12 @@ void MemPhase4::WriteC3()
     auto timer = TimerBegin();
 
     const size_t sizeWritten = WriteC3Parallel<MAX_THREADS>( 
-         *cx.threadPool, entryCount, cx.t7YBuffer, writeBuffer );
+         pool, entryCount, cx.t7YBuffer, writeBuffer );
 
     cx.p4WriteBufferWriter = ((byte*)writeBuffer) + sizeWritten;
 
-    // #TODO: block-align written size
-    cx.plotWriter->BeginTable( PlotTable::C3 );
-    cx.plotWriter->WriteTableData( writeBuffer, sizeWritten );
-    cx.plotWriter->EndTable();
+    _tableBuffers[3] = writeBuffer;
+    _tableSizes  [3] = sizeWritten;
 
     double elapsed = TimerEnd( timer );
     Log::Line( "  Finished writing C3 table in %.2lf seconds.", elapsed );
@@ -5,19 +5,29 @@
 class MemPhase4
 {
     friend class MemPlotter;
+    friend class MemPhase3;
 public:
     
     MemPhase4( MemPlotContext& context );
 
+    // Builds the tables, if they were not built already, and writes them to the plot
     void Run();
 
-    void WriteP7();
-    void WriteC1();
-    void WriteC2();
-    void WriteC3();
+    // Builds P7 and the C1, C2 and C3 tables into the phase 4 write buffer, without writing them to the plot.
+    // Only needs table 7's final f7 and L table, so phase 3 runs this on its own pool while it writes the table 6 parks.
+    void Build( ThreadPool& pool );
+
+    void WriteP7( ThreadPool& pool );
+    void WriteC1( ThreadPool& pool );
+    void WriteC2( ThreadPool& pool );
+    void WriteC3( ThreadPool& pool );
 
 private:
     MemPlotContext& _context;
+
+    bool            _built = false;
+    const void*     _tableBuffers[4];   // P7, C1, C2, C3
+    size_t          _tableSizes  [4];
 };
 
 struct P7Job
@@ -25,13 +35,15 @@ struct P7Job
     uint64        parkCount;
     const uint32* indices;
     byte*         parkBuffer;
+    uint32        k;
 };
 
 struct C12Job
 {
     uint64        length;
     const uint32* f7Entries;
-    uint32*       writeBuffer;
+    byte*         writeBuffer;
+    uint32        k;
 
     #if DEBUG
         uint32 jobIndex;
@@ -48,18 +60,19 @@ struct C3Job
 // P7
 template<uint MAX_JOBS>
 size_t WriteP7Parallel( ThreadPool& pool, const uint64 length, 
-                        const uint32* indices, byte* parkBuffer );
+                        const uint32* indices, byte* parkBuffer, uint32 k = _K );
 
-void WriteP7Parks( const uint64 parkCount, const uint32* indices, byte* parkBuffer );
-void WriteP7Entries( const uint64 length, const uint32* indices, byte* parkBuffer );
+void WriteP7Parks( const uint64 parkCount, const uint32* indices, byte* parkBuffer, uint32 k = _K );
+void WriteP7Entries( const uint64 length, const uint32* indices, byte* parkBuffer, uint32 k = _K );
 
 
-// C1 & C2 tables
+// C1 & C2 tables. Entries are CDiv( k, 8 ) bytes each.
+template<uint MAX_JOBS, uint CInterval>
 size_t WriteC12Parallel( ThreadPool& pool, const uint64 length, 
-                         const uint32* f7Entries, uint32* parkBuffer );
+                         const uint32* f7Entries, byte* parkBuffer, uint32 k = _K );
 
 template<uint CInterval>
-void WriteC12Entries( const uint64 length, const uint32* f7Entries, uint32* c1Buffer );
+void WriteC12Entries( const uint64 length, const uint32* f7Entries, byte* cBuffer, uint32 k );
 
 // C3 parks
 uint64 GetC3ParkCount( const uint64 length );
@@ -79,12 +92,12 @@ void WriteC3Park( const uint64 length, uint32* f7Entries, byte* parkBuffer );
 //-----------------------------------------------------------
 inline void WriteP7Thread( P7Job* job )
 {
-    WriteP7Parks( job->parkCount, job->indices, job->parkBuffer );
+    WriteP7Parks( job->parkCount, job->indices, job->parkBuffer, job->k );
 }
 
 //-----------------------------------------------------------
 template<uint MAX_JOBS>
-inline size_t WriteP7Parallel( ThreadPool& pool, const uint64 length, const uint32* indices, byte* parkBuffer )
+inline size_t WriteP7Parallel( ThreadPool& pool, const uint64 length, const uint32* indices, byte* parkBuffer, const uint32 k )
 {
     const uint32 threadCount     = std::min( pool.ThreadCount(), MAX_JOBS );
 
@@ -105,9 +118,10 @@ inline size_t WriteP7Parallel( ThreadPool& pool, const uint64 length, const uint
      *          = 67584 / 8
      *          = 8448 / 8
      *          = 1056 64-bit fields
+     *        This holds for any k, as kEntriesPerPark is a multiple of 64.
      */
-    const size_t parkSize = CDiv( (_K + 1) * kEntriesPerPark, 8 );
-    static_assert( parkSize / 8 == 1056 );
+    const size_t parkSize = CalculatePark7Size( k );
+    static_assert( CalculatePark7Size( _K ) / 8 == 1056 && kEntriesPerPark % 64 == 0 );
     
     P7Job jobs[MAX_JOBS];
 
@@ -121,6 +135,7 @@ inline size_t WriteP7Parallel( ThreadPool& pool, const uint64 length, const uint
         job.parkCount  = parksPerThread;
         job.indices    = threadIndices;
         job.parkBuffer = threadParkBuffer;
+        job.k          = k;
 
         // Assign trailing parks accross threads
         if( trailingParks )
@@ -140,33 +155,33 @@ inline size_t WriteP7Parallel( ThreadPool& pool, const uint64 length, const uint
     if( trailingEntries )
     {
         memset( threadParkBuffer, 0, parkSize );
-        WriteP7Entries( trailingEntries, threadIndices, threadParkBuffer );
+        WriteP7Entries( trailingEntries, threadIndices, threadParkBuffer, k );
     }
 
     return totalParksWritten * parkSize;
 }
 
 //-----------------------------------------------------------
-inline void WriteP7Parks( const uint64 parkCount, const uint32* indices, byte* parkBuffer )
+inline void WriteP7Parks( const uint64 parkCount, const uint32* indices, byte* parkBuffer, const uint32 k )
 {
-    const size_t parkSize = CDiv( (_K + 1) * kEntriesPerPark, 8 );
+    const size_t parkSize = CalculatePark7Size( k );
 
     for( uint64 i = 0; i < parkCount; i++ )
     {
-        WriteP7Entries( kEntriesPerPark, indices, parkBuffer );
+        WriteP7Entries( kEntriesPerPark, indices, parkBuffer, k );
         indices    += kEntriesPerPark;
         parkBuffer += parkSize;
     }
 }
 
 //-----------------------------------------------------------
-inline void WriteP7Entries( const uint64 length, const uint32* indices, byte* parkBuffer )
+inline void WriteP7Entries( const uint64 length, const uint32* indices, byte* parkBuffer, const uint32 k )
 {
     uint64* fieldWriter = (uint64*)parkBuffer;
     
     // chiapos requires this to have an extra bit for some odd reason.
     // Otherwise we could have copied the buffer as-is.
-    const uint32 bitsPerEntry = _K + 1;
+    const uint32 bitsPerEntry = k + 1;
 
     uint64 field = 0;
     uint32 bits  = 0;
@@ -223,15 +238,16 @@ inline void WriteP7Entries( const uint64 length, const uint32* indices, byte* pa
 template<uint CInterval>
 inline void WriteC12Thread( C12Job* job )
 {
-    WriteC12Entries<CInterval>( job->length, job->f7Entries, job->writeBuffer );
+    WriteC12Entries<CInterval>( job->length, job->f7Entries, job->writeBuffer, job->k );
 }
 
 //-----------------------------------------------------------
 template<uint MAX_JOBS, uint CInterval>
 inline size_t WriteC12Parallel( ThreadPool& pool, const uint64 length, 
-                                const uint32* f7Entries, uint32* parkBuffer )
+                                const uint32* f7Entries, byte* parkBuffer, const uint32 k )
 {
     const uint32 threadCount      = std::min( pool.ThreadCount(), MAX_JOBS );
+    const size_t entrySize        = CDiv( k, 8 );
 
     const uint64 parkEntries      = CDiv( length, (int) CInterval );
     const uint64 entriesPerThread = parkEntries / threadCount;
@@ -240,7 +256,7 @@ inline size_t WriteC12Parallel( ThreadPool& pool, const uint64 length,
     C12Job jobs[MAX_JOBS];
 
     const uint32* threadf7Entries = f7Entries;
-    uint32*       parkWriter      = parkBuffer;
+    byte*         parkWriter      = parkBuffer;
 
     for( uint32 i = 0; i < threadCount; i++ )
     {
@@ -249,20 +265,23 @@ inline size_t WriteC12Parallel( ThreadPool& pool, const uint64 length,
         job.length      = entriesPerThread;
         job.f7Entries   = threadf7Entries;
         job.writeBuffer = parkWriter;
+        job.k           = k;
 
         #if DEBUG
             job.jobIndex = i;
         #endif
         
         threadf7Entries += entriesPerThread * CInterval;
-        parkWriter      += entriesPerThread;
+        parkWriter      += entriesPerThread * entrySize;
     }
 
     pool.RunJob( WriteC12Thread<CInterval>, jobs, threadCount );
 
     // Write trailing entries, if any
     if( trailingEntries )
-        WriteC12Entries<CInterval>( trailingEntries, threadf7Entries, parkWriter );
+        WriteC12Entries<CInterval>( trailingEntries, threadf7Entries, parkWriter, k );
+
+    byte* lastEntry = parkWriter + trailingEntries * entrySize;
 
 
     if constexpr ( CInterval == kCheckpoint1Interval * kCheckpoint2Interval )
@@ -271,28 +290,45 @@ inline size_t WriteC12Parallel( ThreadPool& pool, const uint64 length,
         //  the C3 pointer by the C2 pointer. This does not work for us
         //  because since we do block-aligned writes we, our C2 size disk-occupied size
         //  will most likely be greater than the actual C2 size. 
-        //  To work around this, we can add a trailing entry with the maximum k32 value size.
-        //  This will force chiapos to stop at that point as the f7 is lesser than max k32 value.
-        //  #IMPORTANT: This means that we can't have any f7's that are 0xFFFFFFFF!.
-        parkWriter[trailingEntries] = 0xFFFFFFFF;
+        //  To work around this, we can add a trailing entry with the maximum k value size.
+        //  This will force chiapos to stop at that point as the f7 is lesser than max k value.
+        //  #IMPORTANT: This means that we can't have any f7's that are all 1s!.
+        memset( lastEntry, 0xFF, entrySize );
     }
     else
     {
         
         // Write an empty one at the end (compatibility with chiapos)
-        parkWriter[trailingEntries] = 0;
+        memset( lastEntry, 0, entrySize );
     }
 
-    return (parkEntries + 1) * sizeof( uint32 );
+    return (parkEntries + 1) * entrySize;
 }
 
 //-----------------------------------------------------------
 template<uint CInterval>
-inline void WriteC12Entries( const uint64 length, const uint32* f7Entries, uint32* c1Buffer )
+inline void WriteC12Entries( const uint64 length, const uint32* f7Entries, byte* cBuffer, const uint32 k )
 {
     uint64 f7Src = 0;
+
+    if( k == _K )
+    {
+        uint32* c1Buffer = (uint32*)cBuffer;
+
+        for( uint64 i = 0; i < length; i++, f7Src += CInterval )
+            c1Buffer[i] = Swap32( f7Entries[f7Src] );
+
+        return;
+    }
+
+    // Below k32, the f7s are left-aligned in their bytes
+    const size_t entrySize = CDiv( k, 8 );
+
     for( uint64 i = 0; i < length; i++, f7Src += CInterval )
-        c1Buffer[i] = Swap32( f7Entries[f7Src] );
+    {
+        const uint32 f7 = Swap32( f7Entries[f7Src] << ( 32 - k ) );
+        memcpy( cBuffer + i * entrySize, &f7, entrySize );
+    }
 }
 
 
@@ -2,17 +2,68 @@
 #include "threading/ThreadPool.h"
 #include "util/Util.h"
 #include "util/Log.h"
+#include "util/CliParser.h"
+#include "plotting/MemoryPlanner.h"
+#include "plotting/PlotBenchmark.h"
+#include "util/PerfCounters.h"
 #include "SysHost.h"
+#include "threading/Thread.h"
+#include "util/PageWarmer.h"
 
 #include "MemPhase1.h"
 #include "MemPhase2.h"
 #include "MemPhase3.h"
 #include "MemPhase4.h"
 
+// A plotter bound to a NUMA node, running one plot at a time on its thread (--numa-instances)
+struct MemPlotInstance
+{
+    MemPlotter* plotter = nullptr;
+    Thread*     thread  = nullptr;
+
+    // Copy of the request being plotted
+    PlotRequest req;
+    byte        plotId[BB_PLOT_ID_LEN];
+    byte        memo  [BB_PLOT_MEMO_MAX_SIZE];
+    std::string outDir;
+    std::string plotFileName;
+    std::string plotOutPath;
+};
+
+static void InstanceThreadMain( MemPlotInstance* instance );
+
 //----------------------------------------------------------
 void MemPlotter::ParseCLI( const GlobalPlotConfig& gCfg, CliParser& cli )
 {
     _context.cfg.gCfg = &gCfg;
+
+    while( cli.HasArgs() )
+    {
+        if( cli.ReadSwitch( _context.cfg.numaLocal, "--numa-local" ) )
+            continue;
+        else if( cli.ReadSwitch( _context.cfg.numaInstances, "--numa-instances" ) )
+            continue;
+        else if( cli.ReadSwitch( _context.cfg.groupMatch, "--group-match" ) )
+            continue;
+        else
+            break;  // Let the caller handle the output directories
+    }
+}
+
+//----------------------------------------------------------
+MemPlotter::~MemPlotter()
+{
+    auto& cx = _context;
+
+    if( cx.nodePools )
+    {
+        for( uint32 i = 0; i < cx.nodeCount; i++ )
+            delete cx.nodePools[i];
+
+        delete[] cx.nodePools;
+        cx.nodePools = nullptr;
+        cx.nodeCount = 0;
+    }
 }
 
 //----------------------------------------------------------
@@ -22,6 +73,8 @@ void MemPlotter::Init()
 
     const bool warmStart = cfg.warmStart;
 
+    _context.k = cfg.k;
+
     const NumaInfo* numa = nullptr;
     if( !cfg.disableNuma )
         numa = SysHost::GetNUMAInfo();
@@ -35,10 +88,64 @@ void MemPlotter::Init()
         //     Log::Error( "Warning: Failed to set NUMA interleaved mode." );
     }
 
-    _context.threadCount = cfg.threadCount;
-    
+    if( _context.cfg.numaInstances )
+    {
+        if( !numa )
+        {
+            Log::Line( "Warning: --numa-instances specified, but this is not a NUMA system or NUMA is disabled. Ignoring." );
+            _context.cfg.numaInstances = false;
+        }
+        else if( cfg.threadCount < numa->nodeCount )
+        {
+            Log::Line( "Warning: --numa-instances requires at least one thread per NUMA node. Ignoring." );
+            _context.cfg.numaInstances = false;
+        }
+        else
+        {
+            FatalIf( cfg.bench, "--numa-instances is not supported with bench, as plot timings would overlap." );
+
+            if( _context.cfg.numaLocal )
+            {
+                Log::Line( "Warning: --numa-local does not apply with --numa-instances. Ignoring." );
+                _context.cfg.numaLocal = false;
+            }
+
+            InitInstances( *numa );
+            return;
+        }
+    }
+
+    if( _context.cfg.numaLocal )
+    {
+        if( !numa )
+        {
+            Log::Line( "Warning: --numa-local specified, but this is not a NUMA system or NUMA is disabled. Ignoring." );
+            _context.cfg.numaLocal = false;
+        }
+        else if( cfg.threadCount < numa->nodeCount )
+        {
+            Log::Line( "Warning: --numa-local requires at least one thread per NUMA node. Ignoring." );
+            _context.cfg.numaLocal = false;
+        }
+    }
+
     // Create a thread pool
-    _context.threadPool = new ThreadPool( cfg.threadCount, ThreadPool::Mode::Fixed, cfg.disableCpuAffinity );
+    if( _numaNode >= 0 )
+        CreateInstancePools( *numa );
+    else
+    {
+        _context.threadCount = cfg.threadCount;
+        _context.threadPool  = new ThreadPool( cfg.threadCount, ThreadPool::Mode::Fixed, cfg.disableCpuAffinity, cfg.cpuOffset );
+
+        if( cfg.threadCount > 1 )
+        {
+            const uint32 p4ThreadCount = cfg.threadCount / 2;
+            _context.p4ThreadPool = new ThreadPool( p4ThreadCount, ThreadPool::Mode::Fixed, cfg.disableCpuAffinity, cfg.cpuOffset + cfg.threadCount - p4ThreadCount );
+        }
+    }
+
+    if( _context.cfg.numaLocal )
+        CreateNodePools( *numa );
 
     // Allocate buffers
     {
@@ -50,19 +157,22 @@ void MemPlotter::Init()
         // YBuffers need to round up to chacha block size, so we just add an extra block always
         const size_t chachaBlockSize  = kF1BlockSizeBits / 8;
 
-        const size_t t1XBuffer   = 16ull GB;
-        const size_t t2LRBuffer  = 32ull GB;
-        const size_t t3LRBuffer  = 32ull GB;
-        const size_t t4LRBuffer  = 32ull GB;
-        const size_t t5LRBuffer  = 32ull GB;
-        const size_t t6LRBuffer  = 32ull GB;
-        const size_t t7LRBuffer  = 32ull GB;
-        const size_t t7YBuffer   = 16ull GB;
+        // Sizes are given for k32
+        const size_t entryCount  = 1ull << _context.k;
 
-        const size_t yBuffer0    = 32ull GB + chachaBlockSize;
-        const size_t yBuffer1    = 32ull GB + chachaBlockSize;
-        const size_t metaBuffer0 = 64ull GB;
-        const size_t metaBuffer1 = 64ull GB;
+        const size_t t1XBuffer   = entryCount * sizeof( uint32 );   // 16 GiB
+        const size_t t2LRBuffer  = entryCount * sizeof( Pair );     // 32 GiB
+        const size_t t3LRBuffer  = entryCount * sizeof( Pair );
+        const size_t t4LRBuffer  = entryCount * sizeof( Pair );
+        const size_t t5LRBuffer  = entryCount * sizeof( Pair );
+        const size_t t6LRBuffer  = entryCount * sizeof( Pair );
+        const size_t t7LRBuffer  = entryCount * sizeof( Pair );
+        const size_t t7YBuffer   = entryCount * sizeof( uint32 );   // 16 GiB
+
+        const size_t yBuffer0    = entryCount * sizeof( uint64 ) + chachaBlockSize;    // 32 GiB
+        const size_t yBuffer1    = entryCount * sizeof( uint64 ) + chachaBlockSize;
+        const size_t metaBuffer0 = entryCount * sizeof( uint64 ) * 2;                  // 64 GiB
+        const size_t metaBuffer1 = entryCount * sizeof( uint64 ) * 2;
 
         const size_t reqMem = 
             t1XBuffer   +
@@ -78,26 +188,64 @@ void MemPlotter::Init()
             metaBuffer0 +
             metaBuffer1;
 
-        Log::Line( "Memory required: %llu GiB.", reqMem BtoGB );
+        if( reqMem >= 1ull GB )
+            Log::Line( "Memory required: %llu GiB.", reqMem BtoGB );
+        else
+            Log::Line( "Memory required: %llu MiB.", reqMem BtoMB );
+        MemoryPlanner::ReportPeak( cfg, reqMem );
+
         if( availMemory < reqMem  )
+        {
             Log::Line( "Warning: Not enough memory available. Buffer allocation may fail." );
+            Log::Line( "         On systems with less memory, use diskplot with an in-memory temp2 ( -t2 mem:<size> )." );
+        }
 
         Log::Line( "Allocating buffers." );
-        _context.t1XBuffer   = SafeAlloc<uint32>( t1XBuffer  , warmStart, numa );
+        _context.t1XBuffer   = SafeAlloc<uint32>( t1XBuffer  , numa );
+
+        _context.t2LRBuffer  = SafeAlloc<Pair>  ( t2LRBuffer , numa );
+        _context.t3LRBuffer  = SafeAlloc<Pair>  ( t3LRBuffer , numa );
+        _context.t4LRBuffer  = SafeAlloc<Pair>  ( t4LRBuffer , numa );
+        _context.t5LRBuffer  = SafeAlloc<Pair>  ( t5LRBuffer , numa );
+        _context.t6LRBuffer  = SafeAlloc<Pair>  ( t6LRBuffer , numa );
 
-        _context.t2LRBuffer  = SafeAlloc<Pair>  ( t2LRBuffer , warmStart, numa );
-        _context.t3LRBuffer  = SafeAlloc<Pair>  ( t3LRBuffer , warmStart, numa );
-        _context.t4LRBuffer  = SafeAlloc<Pair>  ( t4LRBuffer , warmStart, numa );
-        _context.t5LRBuffer  = SafeAlloc<Pair>  ( t5LRBuffer , warmStart, numa );
-        _context.t6LRBuffer  = SafeAlloc<Pair>  ( t6LRBuffer , warmStart, numa );
+        _context.t7YBuffer   = SafeAlloc<uint32>( t7YBuffer  , numa );
+        _context.t7LRBuffer  = SafeAlloc<Pair>  ( t7LRBuffer , numa );
 
-        _context.t7YBuffer   = SafeAlloc<uint32>( t7YBuffer  , warmStart, numa );
-        _context.t7LRBuffer  = SafeAlloc<Pair>  ( t7LRBuffer , warmStart, numa );
+        _context.yBuffer0    = SafeAlloc<uint64>( yBuffer0   , numa );
+        _context.yBuffer1    = SafeAlloc<uint64>( yBuffer1   , numa );
+        _context.metaBuffer0 = SafeAlloc<uint64>( metaBuffer0, numa );
+        _context.metaBuffer1 = SafeAlloc<uint64>( metaBuffer1, numa );
 
-        _context.yBuffer0    = SafeAlloc<uint64>( yBuffer0   , warmStart, numa );
-        _context.yBuffer1    = SafeAlloc<uint64>( yBuffer1   , warmStart, numa );
-        _context.metaBuffer0 = SafeAlloc<uint64>( metaBuffer0, warmStart, numa );
-        _context.metaBuffer1 = SafeAlloc<uint64>( metaBuffer1, warmStart, numa );
+        // Fault the pages in the background while plotting, in the order Phase 1 first touches the buffers
+        if( warmStart )
+        {
+            Log::Line( "Warm start: Pre-faulting memory pages in the background." );
+
+            _pageWarmer = new PageWarmer();
+            _pageWarmer->Add( _context.yBuffer0   , yBuffer0    );
+            _pageWarmer->Add( _context.metaBuffer1, metaBuffer1 );
+            _pageWarmer->Add( _context.t1XBuffer  , t1XBuffer   );
+            _pageWarmer->Add( _context.yBuffer1   , yBuffer1    );
+            _pageWarmer->Add( _context.metaBuffer0, metaBuffer0 );
+            _pageWarmer->Add( _context.t2LRBuffer , t2LRBuffer  );
+            _pageWarmer->Add( _context.t3LRBuffer , t3LRBuffer  );
+            _pageWarmer->Add( _context.t4LRBuffer , t4LRBuffer  );
+            _pageWarmer->Add( _context.t5LRBuffer , t5LRBuffer  );
+            _pageWarmer->Add( _context.t6LRBuffer , t6LRBuffer  );
+            _pageWarmer->Add( _context.t7LRBuffer , t7LRBuffer  );
+            _pageWarmer->Add( _context.t7YBuffer  , t7YBuffer   );
+            _pageWarmer->Start();
+        }
+
+        if( cfg.hugePages )
+        {
+            for( int i = (int)HugePageSize::Huge1G; i >= (int)HugePageSize::None; i-- )
+            {
+                if( _hugePageAllocCounts[i] )
+                    Log::Line( " %u buffer(s) backed by %s.", _hugePageAllocCounts[i], HugePageSizeToString( (HugePageSize)i ) );
+            }
+        }
 
 
         // Some table's kBC group pairings yield more values than 2^k. 
@@ -113,12 +261,22 @@ void MemPlotter::Init()
 
         _context.maxPairs     = maxPairs;
         _context.maxKBCGroups = maxKbcGroups;
+
+        // The y buffers define the node partitions for all entry-indexed work
+        if( _context.nodeCount )
+            _context.nodeEntryCount = NumaPartitionSize( yBuffer0 ) / sizeof( uint64 );
     }
 }
 
 //----------------------------------------------------------
 void MemPlotter::Run( const PlotRequest& request )
 {
+    if( _instances )
+    {
+        RunInstances( request );
+        return;
+    }
+
     auto& cx = _context;
 
     // Prepare context
@@ -145,6 +303,8 @@ void MemPlotter::Run( const PlotRequest& request )
 
         double elapsed = TimerEnd( timeStart );
         Log::Line( "Finished Phase 1 in %.2lf seconds.", elapsed );
+        PlotBenchmark::RecordPhase( 1, elapsed );
+        PerfCounters::RecordPhase( 1, elapsed );
     }
 
     {
@@ -156,32 +316,40 @@ void MemPlotter::Run( const PlotRequest& request )
 
         double elapsed = TimerEnd( timeStart );
         Log::Line( "Finished Phase 2 in %.2lf seconds.", elapsed );
+        PlotBenchmark::RecordPhase( 2, elapsed );
+        PerfCounters::RecordPhase( 2, elapsed );
     }
 
     // Start the new plot file
     if( !request.isFirstPlot )
         BeginPlotFile( request );
 
+    // Phase 4 builds its tables during phase 3's last table pass
+    MemPhase4 phase4( cx );
+
     {
         auto timeStart = TimerBegin();
         Log::Line( "Running Phase 3" );
 
         MemPhase3 phase3( cx );
-        phase3.Run();
+        phase3.Run( &phase4 );
 
         double elapsed = TimerEnd( timeStart );
         Log::Line( "Finished Phase 3 in %.2lf seconds.", elapsed );
+        PlotBenchmark::RecordPhase( 3, elapsed );
+        PerfCounters::RecordPhase( 3, elapsed );
     }
 
     {
         auto timeStart = TimerBegin();
         Log::Line( "Running Phase 4" );
 
-        MemPhase4 phase4( cx );
         phase4.Run();
 
         double elapsed = TimerEnd( timeStart );
         Log::Line( "Finished Phase 4 in %.2lf seconds.", elapsed );
+        PlotBenchmark::RecordPhase( 4, elapsed );
+        PerfCounters::RecordPhase( 4, elapsed );
     }
 
     // Wait flush writer, if this is the final plot
@@ -202,6 +370,7 @@ void MemPlotter::Run( const PlotRequest& request )
     double plotElapsed = TimerEnd( plotTimer );
     Log::Line( "Finished plotting in %.2lf seconds (%.2lf minutes).", 
         plotElapsed, plotElapsed / 60.0 );
+    PerfCounters::LogJobRuns();
 
     cx.plotCount++;
 }
@@ -220,7 +389,10 @@ void MemPlotter::BeginPlotFile( const PlotRequest& request )
         _context.plotWriter = new PlotWriter();
     
     FatalIf( !_context.plotWriter->BeginPlot( PlotVersion::v2_0, request.outDir, request.plotFileName, 
-              request.plotId, request.memo, request.memoSize, _context.cfg.gCfg->compressionLevel ),
+              request.plotId, request.memo, request.memoSize, _context.cfg.gCfg->compressionLevel,
+              GetParkDeltaCodingFlags( _context.cfg.gCfg->parkDeltaCoding ) | ( _context.cfg.gCfg->alignedParks ? PlotFlags::AlignedParks : PlotFlags::None ) |
+              ( _context.cfg.gCfg->tunedDeltas ? PlotFlags::TunedDeltas : PlotFlags::None ),
+              _context.k ),
             "Failed to open plot file with error: %d", _context.plotWriter->GetError() );
 }
 
@@ -235,98 +407,260 @@ void MemPlotter::WaitPlotWriter()
 /// Internal methods
 ///
 //-----------------------------------------------------------
-template<typename T>
-T* MemPlotter::SafeAlloc( size_t size, bool warmStart, const NumaInfo* numa )
+void MemPlotter::CreateNodePools( const NumaInfo& numa )
 {
-    #if DEBUG || BOUNDS_PROTECTION
-    
-        const size_t originalSize = size;
-        const size_t pageSize     = SysHost::GetPageSize();
-        size = pageSize * 2 + RoundUpToNextBoundary( size, (int)pageSize );
+    auto& cx = _context;
 
-    #endif
+    const uint32 nodeCount = numa.nodeCount;
 
-    T* ptr = (T*)SysHost::VirtualAlloc( size, false );
+    cx.nodeCount = nodeCount;
+    cx.nodePools = new ThreadPool*[nodeCount];
 
-    if( !ptr )
+    Log::Line( "NUMA-local mode enabled for %u nodes.", nodeCount );
+
+    // Split the threads evenly across nodes, but don't oversubscribe a node's CPUs
+    for( uint32 i = 0; i < nodeCount; i++ )
     {
-        Fatal( "Error: Failed to allocate required buffers." );
+        const Span<uint>& cpus = numa.cpuIds[i];
+
+        uint32 threadCount = cx.threadCount / nodeCount + ( i < cx.threadCount % nodeCount ? 1 : 0 );
+
+        if( cpus.Length() > 0 )
+            threadCount = std::min( threadCount, (uint32)cpus.Length() );
+
+        if( cfg().disableCpuAffinity || cpus.Length() == 0 )
+            cx.nodePools[i] = new ThreadPool( threadCount, ThreadPool::Mode::Fixed, true );
+        else
+            cx.nodePools[i] = new ThreadPool( threadCount, cpus.Ptr(), ThreadPool::Mode::Fixed );
+
+        Log::Line( " Node %u: %u threads.", i, threadCount );
     }
+}
 
-    if( numa )
+//-----------------------------------------------------------
+void MemPlotter::InitInstances( const NumaInfo& numa )
+{
+    const auto&  gCfg      = cfg();
+    const uint32 nodeCount = numa.nodeCount;
+
+    Log::Line( "NUMA instances enabled: Plotting on %u nodes concurrently.", nodeCount );
+
+    _instanceCount = nodeCount;
+    _instances     = new MemPlotInstance[nodeCount]{};
+
+    for( uint32 i = 0; i < nodeCount; i++ )
     {
-        if( !SysHost::NumaSetMemoryInterleavedMode( ptr, size ) )
-            Log::Error( "Warning: Failed to bind NUMA memory." );
+        const Span<uint>& cpus = numa.cpuIds[i];
+
+        // Split the threads evenly across nodes, but don't oversubscribe a node's CPUs
+        uint32 threadCount = gCfg.threadCount / nodeCount + ( i < gCfg.threadCount % nodeCount ? 1 : 0 );
+
+        if( cpus.Length() > 0 )
+            threadCount = std::min( threadCount, (uint32)cpus.Length() );
+
+        MemPlotter* plotter = new MemPlotter();
+        plotter->_context.cfg               = _context.cfg;
+        plotter->_context.cfg.numaInstances = false;
+        plotter->_context.threadCount       = threadCount;
+        plotter->_numaNode                  = (int32)i;
+
+        Log::Line( "" );
+        Log::Line( "[Node %u instance: %u threads]", i, threadCount );
+        plotter->Init();
+
+        _instances[i].plotter = plotter;
     }
 
-    // Protect memory boundaries
-    #if DEBUG || BOUNDS_PROTECTION
+    Log::Line( "" );
+}
+
+//-----------------------------------------------------------
+void MemPlotter::CreateInstancePools( const NumaInfo& numa )
+{
+    ASSERT( _numaNode >= 0 );
+
+    auto&             cx          = _context;
+    const Span<uint>& cpus        = numa.cpuIds[_numaNode];
+    const uint32      threadCount = cx.threadCount;
+    const bool        pinToNode   = !cfg().disableCpuAffinity && cpus.Length() >= threadCount;
+
+    if( pinToNode )
+        cx.threadPool = new ThreadPool( threadCount, cpus.Ptr(), ThreadPool::Mode::Fixed );
+    else
+        cx.threadPool = new ThreadPool( threadCount, ThreadPool::Mode::Fixed, true );
+
+    // As in the single plotter, phase 4 runs on the upper half of the compute CPUs
+    if( threadCount > 1 )
     {
-        byte* p = (byte*)ptr;
-        ptr = (T*)(p + pageSize);
+        const uint32 p4ThreadCount = threadCount / 2;
 
-        SysHost::VirtualProtect( p, pageSize, VProtect::NoAccess );
-        SysHost::VirtualProtect( p + size - pageSize, pageSize, VProtect::NoAccess );
+        if( pinToNode )
+            cx.p4ThreadPool = new ThreadPool( p4ThreadCount, cpus.Ptr() + ( threadCount - p4ThreadCount ), ThreadPool::Mode::Fixed );
+        else
+            cx.p4ThreadPool = new ThreadPool( p4ThreadCount, ThreadPool::Mode::Fixed, true );
     }
-    #endif
+}
+
+//-----------------------------------------------------------
+void MemPlotter::RunInstances( const PlotRequest& request )
+{
+    // Hand the plot to the instances in turn, waiting only for the one whose turn it is.
+    // The request's buffers belong to the caller, so they are copied.
+    MemPlotInstance& instance = _instances[_nextInstance];
+    _nextInstance = ( _nextInstance + 1 ) % _instanceCount;
+
+    if( instance.thread )
+    {
+        instance.thread->WaitForExit();
+        delete instance.thread;
+        instance.thread = nullptr;
+    }
+
+    memcpy( instance.plotId, request.plotId, sizeof( instance.plotId ) );
+    memcpy( instance.memo  , request.memo  , request.memoSize );
+    instance.outDir       = request.outDir;
+    instance.plotFileName = request.plotFileName;
+    instance.plotOutPath  = request.plotOutPath;
+
+    instance.req              = request;
+    instance.req.plotId       = instance.plotId;
+    instance.req.memo         = instance.memo;
+    instance.req.outDir       = instance.outDir.c_str();
+    instance.req.plotFileName = instance.plotFileName.c_str();
+    instance.req.plotOutPath  = instance.plotOutPath.c_str();
+    instance.req.isFirstPlot  = instance.plotter->_context.plotCount == 0;
+
+    // Only the last plot of the run waits for the instances' plot writers, below
+    instance.req.IsFinalPlot = false;
+
+    // Plotting runs deep on the stack, give it as much as the main thread
+    instance.thread = new Thread( 8 MiB );
+    instance.thread->Run( InstanceThreadMain, &instance );
 
-    // Touch pages to initialize them, if specified
-    if( warmStart )
+    if( !request.IsFinalPlot )
+        return;
+
+    for( uint32 i = 0; i < _instanceCount; i++ )
     {
-        struct InitJob
+        MemPlotInstance& inst = _instances[i];
+
+        if( inst.thread )
         {
-            byte*  pages;
-            size_t pageSize;
-            uint64 pageCount;
+            inst.thread->WaitForExit();
+            delete inst.thread;
+            inst.thread = nullptr;
+        }
+    }
 
-            inline static void Run( InitJob* job )
-            {
-                const size_t pageSize = job->pageSize;
+    auto timeStart = TimerBegin();
+    Log::Line( "Writing final plot tables to disk" );
 
-                byte*       page = job->pages;
-                const byte* end  = page + job->pageCount * pageSize;
+    for( uint32 i = 0; i < _instanceCount; i++ )
+    {
+        if( _instances[i].plotter->_context.plotWriter )
+            _instances[i].plotter->WaitPlotWriter();
+    }
 
-                do {
-                    *page = 0;
-                    page += pageSize;
-                    
-                } while ( page < end );
-            }
-        };
+    double elapsed = TimerEnd( timeStart );
+    Log::Line( "Finished writing tables to disk in %.2lf seconds.", elapsed );
+    Log::Flush();
 
-        #if DEBUG || BOUNDS_PROTECTION
-            size = originalSize;
-        #endif
+    _nextInstance = 0;
+}
 
-        InitJob jobs[MAX_THREADS];
+//-----------------------------------------------------------
+void InstanceThreadMain( MemPlotInstance* instance )
+{
+    instance->plotter->Run( instance->req );
+}
 
-        const uint   threadCount    = _context.threadPool->ThreadCount();
-        const size_t pageSize       = SysHost::GetPageSize();
-        const uint64 pageCount      = CDiv( size, (int)pageSize );
-        const uint64 pagesPerThread = pageCount / threadCount;
+//-----------------------------------------------------------
+size_t MemPlotter::NumaPartitionSize( const size_t bufferSize ) const
+{
+    ASSERT( _context.nodeCount );
+    return RoundUpToNextBoundary( CDiv( bufferSize, (int)_context.nodeCount ), (int)SysHost::GetPageSize() );
+}
 
-        uint64 numRemainderPages = pageCount - ( pagesPerThread * threadCount );
+//-----------------------------------------------------------
+template<typename T>
+T* MemPlotter::SafeAlloc( size_t size, const NumaInfo* numa )
+{
+    #if DEBUG || BOUNDS_PROTECTION
+    
+        const size_t originalSize = size;
+        const size_t pageSize     = SysHost::GetPageSize();
+        size = pageSize * 2 + RoundUpToNextBoundary( size, (int)pageSize );
+
+    #endif
 
-        byte* pages = (byte*)ptr;
-        for( uint i = 0; i < threadCount; i++ )
+    // Huge pages can't be used with guard pages
+    #if DEBUG || BOUNDS_PROTECTION
+        T* ptr = (T*)SysHost::VirtualAlloc( size, false );
+    #else
+        T* ptr;
+        if( cfg().hugePages )
         {
-            InitJob& job = jobs[i];
+            // Explicit huge pages can't be bound to NUMA nodes at page granularity
+            HugePageSize pageSize;
+            ptr = (T*)SysHost::VirtualAllocHuge( size, numa == nullptr, &pageSize );
 
-            job.pages     = pages;
-            job.pageSize  = pageSize;
-            job.pageCount = pagesPerThread;
+            _hugePageAllocCounts[(int)pageSize]++;
+        }
+        else
+            ptr = (T*)SysHost::VirtualAlloc( size, false );
+    #endif
 
-            if( numRemainderPages )
+    if( !ptr )
+    {
+        Fatal( "Error: Failed to allocate required buffers." );
+    }
+
+    if( numa && ( _context.nodeCount || _numaNode >= 0 ) )
+    {
+        #if DEBUG || BOUNDS_PROTECTION
+            byte*        buffer     = (byte*)ptr + pageSize;
+            const size_t bufferSize = originalSize;
+        #else
+            byte*        buffer     = (byte*)ptr;
+            const size_t bufferSize = size;
+        #endif
+
+        if( _numaNode >= 0 )
+        {
+            // The whole buffer belongs to the instance's node
+            SysHost::NumaAssignPages( buffer, bufferSize, (uint)_numaNode );
+        }
+        else
+        {
+            // Bind contiguous, page-aligned partitions of the buffer to each node, in order
+            const size_t partitionSize = NumaPartitionSize( bufferSize );
+
+            for( uint32 node = 0; node < _context.nodeCount; node++ )
             {
-                job.pageCount ++;
-                numRemainderPages --;
-            }
+                const size_t offset = partitionSize * node;
+                if( offset >= bufferSize )
+                    break;
 
-            pages += pageSize * job.pageCount;
+                SysHost::NumaAssignPages( buffer + offset, std::min( partitionSize, bufferSize - offset ), node );
+            }
         }
+    }
+    else if( numa )
+    {
+        if( !SysHost::NumaSetMemoryInterleavedMode( ptr, size ) )
+            Log::Error( "Warning: Failed to bind NUMA memory." );
+    }
+
+    // Protect memory boundaries
+    #if DEBUG || BOUNDS_PROTECTION
+    {
+        byte* p = (byte*)ptr;
+        ptr = (T*)(p + pageSize);
 
-        _context.threadPool->RunJob( InitJob::Run, jobs, threadCount );
+        SysHost::VirtualProtect( p, pageSize, VProtect::NoAccess );
+        SysHost::VirtualProtect( p + size - pageSize, pageSize, VProtect::NoAccess );
     }
+    #endif
 
     return ptr;
 }
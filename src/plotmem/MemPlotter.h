@@ -4,6 +4,8 @@
 #include "plotting/IPlotter.h"
 
 struct NumaInfo;
+struct MemPlotInstance;
+class PageWarmer;
 
 // This plotter performs the whole plotting process in-memory.
 class MemPlotter : public IPlotter
@@ -11,7 +13,7 @@ class MemPlotter : public IPlotter
 public:
 
     inline MemPlotter() {}
-    inline ~MemPlotter() {}
+    ~MemPlotter();
 
     void ParseCLI( const GlobalPlotConfig& gCfg, CliParser& cli ) override;
     void Init() override;
@@ -19,8 +21,20 @@ public:
 
 private:
 
+    void CreateNodePools( const NumaInfo& numa );
+
+    // --numa-instances: Create a plotter bound to each node
+    void InitInstances( const NumaInfo& numa );
+    void CreateInstancePools( const NumaInfo& numa );
+    void RunInstances( const PlotRequest& request );
+
+    // Size of each node's partition of a buffer in NUMA-local mode
+    size_t NumaPartitionSize( size_t bufferSize ) const;
+
+    inline const GlobalPlotConfig& cfg() const { return *_context.cfg.gCfg; }
+
     template<typename T>
-    T* SafeAlloc( size_t size, bool warmStart, const NumaInfo* numa );
+    T* SafeAlloc( size_t size, const NumaInfo* numa );
 
     void BeginPlotFile( const PlotRequest& request );
 
@@ -30,4 +44,12 @@ private:
 private:
 
     MemPlotContext _context = {};
+    uint32         _hugePageAllocCounts[4] = {};   // Allocations made per HugePageSize, with --huge-pages
+    PageWarmer*    _pageWarmer = nullptr;           // --warm-start
+
+    // --numa-instances: The parent plotter only hands out plots to the instances
+    MemPlotInstance* _instances     = nullptr;
+    uint32           _instanceCount = 0;
+    uint32           _nextInstance  = 0;
+    int32            _numaNode      = -1;           // Node an instance is bound to
 };
\ No newline at end of file
@@ -1,5 +1,7 @@
 #pragma once
 #include "plotting/CTables.h"
+#include "plotting/ParkCoding.h"
+#include "plotting/Compression.h"
 #include "ChiaConsts.h"
 #include "threading/ThreadPool.h"
 
@@ -11,23 +13,31 @@ struct WriteParkJob
     byte*             parkBuffer;     // Buffer into which the parks will be written
     uint64            stubBitSize;
     const FSE_CTable* cTable;
+    ParkDeltaCoding     deltaCoding;
+    const RANSEncTable* ransTable;          // Only used by ParkDeltaCoding::RANS
+    uint32              k;                  // Sets the size of the first line point
     // TableId tableId;        // What table are we writing this park to?
 };
 
-// Write parks in parallel
+// Write parks in parallel, on up to maxThreads of the pool's threads (0 for all of them)
 // Returns the total size written
 template<uint MaxJobs>
-size_t WriteParks( ThreadPool& pool, const uint64 length, uint64* linePoints, byte* parkBuffer, const size_t parkSize, const uint64 stubBitSize, const FSE_CTable* cTable );
+size_t WriteParks( ThreadPool& pool, const uint64 length, uint64* linePoints, byte* parkBuffer, const size_t parkSize, const uint64 stubBitSize, const FSE_CTable* cTable,
+                   ParkDeltaCoding deltaCoding = ParkDeltaCoding::FSE, const RANSEncTable* ransTable = nullptr, uint maxThreads = 0, uint32 k = _K );
 
 template<uint MaxJobs>
 size_t WriteParks( ThreadPool& pool, const uint64 length, uint64* linePoints, byte* parkBuffer, TableId tableId );
 
-// Write a single park.
-size_t WritePark( const size_t parkSize, const uint64 count, uint64* linePoints, byte* parkBuffer, const uint64 stubBitSize, const FSE_CTable* cTable );
+// Write a single park. Its first line point takes CDiv( 2k, 8 ) bytes.
+size_t WritePark( const size_t parkSize, const uint64 count, uint64* linePoints, byte* parkBuffer, const uint64 stubBitSize, const FSE_CTable* cTable,
+                  ParkDeltaCoding deltaCoding = ParkDeltaCoding::FSE, const RANSEncTable* ransTable = nullptr, uint32 k = _K );
 size_t WritePark( const size_t parkSize, const uint64 count, uint64* linePoints, byte* parkBuffer, TableId tableId );
 
 void WriteParkThread( WriteParkJob* job );
 
+// Fits an R value to the small deltas of a table of sorted line points (see FitParkDeltaRValue)
+double TuneParkDeltaRValue( const uint64* linePoints, uint64 length, uint64 stubBitSize, double rValue );
+
 //-----------------------------------------------------------
 template<uint MaxJobs>
 inline size_t WriteParks( ThreadPool& pool, const uint64 length, uint64* linePoints, byte* parkBuffer, TableId tableId )
@@ -41,9 +51,11 @@ inline size_t WriteParks( ThreadPool& pool, const uint64 length, uint64* linePoi
 
 //-----------------------------------------------------------
 template<uint MaxJobs>
-inline size_t WriteParks( ThreadPool& pool, const uint64 length, uint64* linePoints, byte* parkBuffer, const size_t parkSize, const uint64 stubBitSize, const FSE_CTable* cTable )
+inline size_t WriteParks( ThreadPool& pool, const uint64 length, uint64* linePoints, byte* parkBuffer, const size_t parkSize, const uint64 stubBitSize, const FSE_CTable* cTable,
+                          const ParkDeltaCoding deltaCoding, const RANSEncTable* ransTable, const uint maxThreads, const uint32 k )
 {
-    const uint   threadCount    = MaxJobs > pool.ThreadCount() ? pool.ThreadCount() : MaxJobs;
+    const uint   poolThreads    = maxThreads > 0 && maxThreads < pool.ThreadCount() ? maxThreads : pool.ThreadCount();
+    const uint   threadCount    = MaxJobs > poolThreads ? poolThreads : MaxJobs;
     const uint64 parkCount      = length / kEntriesPerPark;
     const uint64 parksPerThread = parkCount / threadCount;
 
@@ -69,6 +81,9 @@ inline size_t WriteParks( ThreadPool& pool, const uint64 length, uint64* linePoi
         job.parkBuffer  = threadParkBuffer;
         job.stubBitSize = stubBitSize;
         job.cTable      = cTable;
+        job.deltaCoding = deltaCoding;
+        job.ransTable   = ransTable;
+        job.k           = k;
         // job.tableId    = tableId;
 
         // Assign trailer parks accross threads. hehe
@@ -87,7 +102,7 @@ inline size_t WriteParks( ThreadPool& pool, const uint64 length, uint64* linePoi
 
     // Write trailing entries if any
     if( trailingEntries )
-        WritePark( parkSize, trailingEntries, threadLinePoints, threadParkBuffer, stubBitSize, cTable );
+        WritePark( parkSize, trailingEntries, threadLinePoints, threadParkBuffer, stubBitSize, cTable, deltaCoding, ransTable, k );
 
 
     const size_t sizeWritten = parkSize * ( parkCount + (trailingEntries ? 1 : 0) );
@@ -95,6 +110,32 @@ inline size_t WriteParks( ThreadPool& pool, const uint64 length, uint64* linePoi
     return sizeWritten;
 }
 
+//-----------------------------------------------------------
+inline double TuneParkDeltaRValue( const uint64* linePoints, const uint64 length, const uint64 stubBitSize, const double rValue )
+{
+    // Every park's deltas follow the same distribution, so a sample of the parks is enough
+    constexpr uint64 PARK_SAMPLE_STRIDE = 64;
+
+    const uint64 parkCount = length / kEntriesPerPark;
+    if( parkCount == 0 )
+        return rValue;
+
+    uint64 counts[256] = {};
+
+    for( uint64 park = 0; park < parkCount; park += PARK_SAMPLE_STRIDE )
+    {
+        const uint64* lps = linePoints + park * kEntriesPerPark;
+
+        for( uint64 i = 1; i < kEntriesPerPark; i++ )
+        {
+            const uint64 smallDelta = ( lps[i] - lps[i-1] ) >> stubBitSize;
+            counts[std::min( smallDelta, (uint64)255 )]++;
+        }
+    }
+
+    return FitParkDeltaRValue( counts, rValue );
+}
+
 //-----------------------------------------------------------
 inline size_t WritePark( const size_t parkSize, const uint64 count, uint64* linePoints, byte* parkBuffer, TableId tableId )
 {
@@ -106,16 +147,18 @@ inline size_t WritePark( const size_t parkSize, const uint64 count, uint64* line
 
 //-----------------------------------------------------------
 inline size_t WritePark( const size_t parkSize, const uint64 count, uint64* linePoints, byte* parkBuffer, 
-                         const uint64 stubBitSize, const FSE_CTable* cTable )
+                         const uint64 stubBitSize, const FSE_CTable* cTable, const ParkDeltaCoding deltaCoding, const RANSEncTable* ransTable,
+                         const uint32 k )
 {
     ASSERT( count <= kEntriesPerPark );
 
-    uint64* writer = (uint64*)parkBuffer;
-
-    // Write the first LinePoint as a full LinePoint
-    uint64 prevLinePoint = linePoints[0];
-
-    *writer++ = Swap64( prevLinePoint );
+    // Write the first LinePoint as a full LinePoint, left-aligned in its 2k bits
+    const size_t lpBytes       = LinePointSizeBytes( k );
+    uint64       prevLinePoint = linePoints[0];
+    {
+        const uint64 lpBE = Swap64( prevLinePoint << ( 64 - LinePointSizeBits( k ) ) );
+        memcpy( parkBuffer, &lpBE, lpBytes );
+    }
 
     // Convert to deltas
     for( uint64 i = 1; i < count; i++ )
@@ -130,64 +173,23 @@ inline size_t WritePark( const size_t parkSize, const uint64 count, uint64* line
     // const uint64 stubBitSize      = (_K - kStubMinusBits);       // For us, it is 29 bits since K = 32
     const size_t stubSectionBytes = CDiv( (kEntriesPerPark - 1) * stubBitSize, 8 );
 
-    byte* deltaBytesWriter = ((byte*)writer) + stubSectionBytes;
+    byte* stubsWriter      = parkBuffer + lpBytes;
+    byte* deltaBytesWriter = stubsWriter + stubSectionBytes;
 
     // Write stubs
     {
-        const uint64 stubMask = ((1ULL << stubBitSize) - 1);
-
-        uint64 field = 0;   // Current field to write
-        uint   bits  = 0;   // Bits occupying the current field (always shifted to the leftmost bits)
-
-        for( uint64 i = 1; i < count; i++ )
+        if( count > 1 && lpBytes == sizeof( uint64 ) )
+            PackStubs( linePoints + 1, count - 1, (uint32)stubBitSize, (uint64*)stubsWriter );
+        else if( count > 1 )
         {
-            const uint64 lpDelta = linePoints[i];
-            const uint64 stub    = lpDelta & stubMask;
+            // Below k32 the stubs don't start on a field boundary
+            ASSERT( stubBitSize <= _K - kStubMinusBits );
 
-            // Serialize into bits, one uint64 field at a time
-            // Always store it all the way to the MSbits
-            const uint freeBits = 64 - bits;
-            if( freeBits <= stubBitSize )
-            {
-                // Update the next field bits to what the stub bits that were not written into the current field
-                bits = (uint32)stubBitSize - freeBits;
-
-                // Write what we can (which may be nothing) into the free bits of the current field
-                field |= stub >> bits;
-
-                // Store field
-                *writer++ = Swap64( field );
-
-                // Write the remaining stub bits (which may be none) into the next field
-                // if( bits )
-                //     field = stub << ( 64 - bits );
-                // else
-                //     field = 0;
-
-                // #NOTE: I benchmarked both branching and non-branching
-                //        versions and they pretty much run the same in arm CPUs.
-                //        Perhaps we should go with the branching method with no undefined behavior.
-
-                // Add a mask to avoid branching here.
-                // If the bits is 0, we will shift by 64 bits, which
-                // is undefined behavior. Therefore, we mask it so that in the
-                // case that bits is 0, we will mask it out to 0.
-                const uint remainder = 64 - bits;
-                uint64 mask = ( ( 1ull << bits ) - 1 ) << (remainder & 63);
-                field = ( stub << remainder ) & mask;
-            }
-            else
-            {
-                // The stub completely fits into the current field with room to spare
-                field |= stub << (freeBits - stubBitSize);
-                bits += (uint32)stubBitSize;
-            }
+            uint64 stubFields[CDiv( (kEntriesPerPark - 1) * (_K - kStubMinusBits), 64 )];
+            PackStubs( linePoints + 1, count - 1, (uint32)stubBitSize, stubFields );
+            memcpy( stubsWriter, stubFields, CDiv( (count - 1) * (size_t)stubBitSize, 8 ) );
         }
 
-        // Write any trailing fields
-        if( bits > 0 )
-            *writer++ = Swap64( field );
-
         // Zero-out any remaining unused bytes
         const size_t stubUsedBytes  = CDiv( (count - 1) * (size_t)stubBitSize, 8 );
         const size_t remainderBytes = stubSectionBytes - stubUsedBytes;
@@ -234,11 +236,13 @@ inline size_t WritePark( const size_t parkSize, const uint64 count, uint64* line
         uint16* deltaSizeWriter = (uint16*)deltaBytesWriter;
         deltaBytesWriter += 2;
 
-        const size_t deltasSizeAvailable = parkSize - sizeof( uint64 ) - CDiv( (count - 1) * stubBitSize, 8 );
+        const size_t deltasSizeAvailable = parkSize - lpBytes - CDiv( (count - 1) * stubBitSize, 8 );
+
+        // FSE is not bounded by the space left so that it can use its fast-path instead.
+        // We let it overrun the buffer into the next one and fail if so.
+        const size_t deltasCapacity = parkSize - (size_t)( deltaBytesWriter - parkBuffer );
 
-        size_t deltasSize = FSE_compress_usingCTable( 
-                                deltaBytesWriter, (count-1) * 8,    // We don't use deltasSizeAvailable so we can use the fast-path instead. 
-                                smallDeltas, count-1, cTable );     // We let it overrun the buffer into the next one and fail if so.
+        size_t deltasSize = CompressParkDeltas( deltaCoding, deltaBytesWriter, deltasCapacity, smallDeltas, count-1, cTable, ransTable );
 
         if( deltasSize > deltasSizeAvailable )
             Fatal( "Overran park buffer: %llu / %llu", (deltaBytesWriter + deltasSize - parkBuffer), parkSize );
@@ -279,6 +283,9 @@ inline void WriteParkThread( WriteParkJob* job )
     const uint64  parkCount   = job->parkCount;
     const uint64  stubBitSize = job->stubBitSize;
     const auto*   cTable      = job->cTable;
+    const auto    deltaCoding = job->deltaCoding;
+    const auto*   ransTable   = job->ransTable;
+    const uint32  k           = job->k;
     // const TableId tableId   = job->tableId;
 
     uint64* linePoints = job->linePoints;
@@ -286,7 +293,7 @@ inline void WriteParkThread( WriteParkJob* job )
 
     for( uint64 i = 0; i < parkCount; i++ )
     {
-        WritePark( parkSize, kEntriesPerPark, linePoints, parkBuffer, stubBitSize, cTable );
+        WritePark( parkSize, kEntriesPerPark, linePoints, parkBuffer, stubBitSize, cTable, deltaCoding, ransTable, k );
         
         linePoints += kEntriesPerPark;
         parkBuffer += parkSize;
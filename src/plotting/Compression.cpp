@@ -1,56 +1,104 @@
 #include "Compression.h"
 #include "plotting/FSETableGenerator.h"
+#include "plotting/ParkCoding.h"
 #include "util/Util.h"
 #include <mutex>
 #include <algorithm>
+#include <atomic>
+#include <vector>
+#include <tuple>
+#include <limits>
+#include <cmath>
 
-// Caches for C and D tables
-static std::atomic<FSE_CTable*> _cTableCache[32] = {};
-static std::atomic<FSE_DTable*> _dTableCache[32] = {};
+///
+/// Process-wide caches for C and D tables.
+/// Tables are generated once per (level, rValue, direction), then shared
+/// by every plotter, PlotReader and harvester context in the process.
+/// They are never freed, since callers hold on to the raw pointers.
+///
+struct FSETableCacheEntry
+{
+    std::atomic<void*> table     = nullptr;
+    size_t             tableSize = 0;
+    double             rValue    = 0;
+};
+
+static constexpr uint32 FSE_TABLE_CACHE_LEVELS = 32;
+
+static FSETableCacheEntry _cTableCache[FSE_TABLE_CACHE_LEVELS];
+static FSETableCacheEntry _dTableCache[FSE_TABLE_CACHE_LEVELS];
+
+// Tables requested with an r value other than the one first cached for their level
+static std::vector<std::tuple<uint32, double, void*, size_t>> _cTableOverflow;
+static std::vector<std::tuple<uint32, double, void*, size_t>> _dTableOverflow;
 
 static std::mutex _cCacheLock;
 static std::mutex _dCacheLock;
 
+//-----------------------------------------------------------
+static void* GenFSETableForCache( const double rValue, size_t& outTableSize, const bool compress )
+{
+    return compress ? (void*)FSETableGenerator::GenCompressionTable( rValue, &outTableSize )
+                    : (void*)FSETableGenerator::GenDecompressionTable( rValue, &outTableSize );
+}
+
+//-----------------------------------------------------------
 void* CreateCompressionCTableForCLevel( size_t* outTableSize, const uint32 compressionLevel, const double rValue, const bool compress )
 {
-    if( compress )
+    FatalIf( compressionLevel >= FSE_TABLE_CACHE_LEVELS, "Invalid compression level %u.", compressionLevel );
+
+    FSETableCacheEntry& entry = compress ? _cTableCache[compressionLevel] : _dTableCache[compressionLevel];
+
+    // Fast path: Already generated for this level and r value
+    void* table = entry.table.load( std::memory_order_acquire );
+    if( table && entry.rValue == rValue )
     {
-        FSE_CTable* cTable = _cTableCache[compressionLevel].load( std::memory_order_acquire );
-        if( !cTable )
-        {
-            _cCacheLock.lock();
-            cTable = _cTableCache[compressionLevel].load( std::memory_order_acquire );
-            if( !cTable )
-            {
-                // Cache it
-                cTable = FSETableGenerator::GenCompressionTable( rValue, outTableSize );
-                _cTableCache[compressionLevel].store( cTable, std::memory_order_release );
-            }
-            _cCacheLock.unlock();
-        }
+        if( outTableSize )
+            *outTableSize = entry.tableSize;
+
+        return table;
+    }
+
+    std::lock_guard<std::mutex> lock( compress ? _cCacheLock : _dCacheLock );
+
+    table = entry.table.load( std::memory_order_acquire );
+    if( !table )
+    {
+        // Cache it
+        size_t tableSize = 0;
+        table = GenFSETableForCache( rValue, tableSize, compress );
 
-        return cTable;
+        entry.tableSize = tableSize;
+        entry.rValue    = rValue;
+        entry.table.store( table, std::memory_order_release );
     }
-    else
+    else if( entry.rValue != rValue )
     {
-        FSE_DTable* dTable = _dTableCache[compressionLevel].load( std::memory_order_acquire );
-        if( !dTable )
+        auto& overflow = compress ? _cTableOverflow : _dTableOverflow;
+
+        auto it = std::find_if( overflow.begin(), overflow.end(), [=]( auto& e ) {
+            return std::get<0>( e ) == compressionLevel && std::get<1>( e ) == rValue;
+        });
+
+        if( it == overflow.end() )
         {
-            _dCacheLock.lock();
-            dTable = _dTableCache[compressionLevel].load( std::memory_order_acquire );
-            if( !dTable )
-            {
-                // Cache it
-                dTable = FSETableGenerator::GenDecompressionTable( rValue, outTableSize );
-                _dTableCache[compressionLevel].store( dTable, std::memory_order_release );
-            }
-            _dCacheLock.unlock();
+            size_t tableSize = 0;
+            void*  newTable  = GenFSETableForCache( rValue, tableSize, compress );
+
+            overflow.push_back( { compressionLevel, rValue, newTable, tableSize } );
+            it = overflow.end() - 1;
         }
 
-        return dTable;
+        if( outTableSize )
+            *outTableSize = std::get<3>( *it );
+
+        return std::get<2>( *it );
     }
 
-    return nullptr;
+    if( outTableSize )
+        *outTableSize = entry.tableSize;
+
+    return table;
 }
 
 template<uint32 level>
@@ -143,6 +191,252 @@ uint32 GetCompressedLPBitCount( const uint32 compressionLevel )
     return lpBitSize * 2 - 1;
 }
 
+//-----------------------------------------------------------
+ParkDeltaCoding GetParkDeltaCoding( const PlotFlags flags )
+{
+    if( IsFlagSet( flags, PlotFlags::RANSDeltas ) )
+        return ParkDeltaCoding::RANS;
+
+    if( IsFlagSet( flags, PlotFlags::InterleavedDeltas ) )
+        return ParkDeltaCoding::InterleavedFSE;
+
+    return ParkDeltaCoding::FSE;
+}
+
+//-----------------------------------------------------------
+PlotFlags GetParkDeltaCodingFlags( const ParkDeltaCoding coding )
+{
+    switch( coding )
+    {
+        case ParkDeltaCoding::InterleavedFSE: return PlotFlags::InterleavedDeltas;
+        case ParkDeltaCoding::RANS          : return PlotFlags::RANSDeltas;
+        default: break;
+    }
+
+    return PlotFlags::None;
+}
+
+///
+/// The rANS tables are built from the same normalized counts as the FSE tables,
+/// and cached by R value, as there are only ever a handful of them.
+///
+static std::vector<std::pair<double, RANSEncTable*>> _ransEncTables;
+static std::vector<std::pair<double, RANSDecTable*>> _ransDecTables;
+static std::mutex                                    _ransTableLock;
+
+//-----------------------------------------------------------
+static void GenRANSTables( const double rValue, RANSEncTable* encTable, RANSDecTable* decTable )
+{
+    const std::vector<short> nCount = FSETableGenerator::CreateNormalizedCount( rValue );
+    FatalIf( nCount.size() > RANSMaxSymbols, "Invalid rANS symbol count %llu.", (llu)nCount.size() );
+
+    uint32 start = 0;
+
+    for( uint32 sym = 0; sym < (uint32)nCount.size(); sym++ )
+    {
+        const uint32 freq = nCount[sym] < 0 ? 1 : (uint32)nCount[sym];
+
+        FatalIf( start + freq > ( 1u << RANSScaleBits ), "Invalid rANS frequencies for R value %.2lf.", rValue );
+
+        if( encTable )
+        {
+            encTable->freq [sym] = freq;
+            encTable->start[sym] = start;
+        }
+
+        if( decTable )
+        {
+            for( uint32 slot = start; slot < start + freq; slot++ )
+            {
+                decTable->slots  [slot] = ( freq << 16 ) | ( slot - start );
+                decTable->symbols[slot] = (byte)sym;
+            }
+        }
+
+        start += freq;
+    }
+
+    FatalIf( start != ( 1u << RANSScaleBits ), "Invalid rANS frequencies for R value %.2lf.", rValue );
+
+    if( encTable )
+        encTable->symbolCount = (uint32)nCount.size();
+}
+
+//-----------------------------------------------------------
+template<typename T>
+static const T* FindOrCreateRANSTable( std::vector<std::pair<double, T*>>& tables, const double rValue, const bool encode )
+{
+    std::lock_guard<std::mutex> lock( _ransTableLock );
+
+    for( auto& entry : tables )
+    {
+        if( entry.first == rValue )
+            return entry.second;
+    }
+
+    T* table = new T{};
+    GenRANSTables( rValue, encode ? (RANSEncTable*)table : nullptr, encode ? nullptr : (RANSDecTable*)table );
+
+    tables.push_back( { rValue, table } );
+    return table;
+}
+
+//-----------------------------------------------------------
+const RANSEncTable* CreateRANSEncTable( const double rValue )
+{
+    return FindOrCreateRANSTable( _ransEncTables, rValue, true );
+}
+
+//-----------------------------------------------------------
+const RANSDecTable* CreateRANSDecTable( const double rValue )
+{
+    return FindOrCreateRANSTable( _ransDecTables, rValue, false );
+}
+
+//-----------------------------------------------------------
+const FSE_CTable* CreateTunedCTable( const double rValue )
+{
+    // Level 0 has no tables of its own, so its cache entries hold the tuned ones
+    return (const FSE_CTable*)CreateCompressionCTableForCLevel( nullptr, 0, rValue, true );
+}
+
+//-----------------------------------------------------------
+const FSE_DTable* CreateTunedDTable( const double rValue )
+{
+    return (const FSE_DTable*)CreateCompressionCTableForCLevel( nullptr, 0, rValue, false );
+}
+
+//-----------------------------------------------------------
+double FitParkDeltaRValue( const uint64 deltaCounts[256], const double rValue )
+{
+    // Counts may not hold symbols that the default table codes, so only R values
+    // whose tables have at least as many symbols are considered.
+    const size_t minSymbolCount = FSETableGenerator::CreateNormalizedCount( rValue ).size();
+
+    // Bits needed to code the deltas, ignoring the FSE state overhead, which is the same for all tables
+    auto codedBits = [&]( const uint32 r100 ) {
+
+        const std::vector<short> nCount = FSETableGenerator::CreateNormalizedCount( DecodeDeltaRValue( (uint16)r100 ) );
+        if( nCount.size() < minSymbolCount )
+            return std::numeric_limits<double>::max();
+
+        double bits = 0;
+        for( uint32 sym = 0; sym < 256; sym++ )
+        {
+            if( deltaCounts[sym] == 0 )
+                continue;
+
+            if( sym >= nCount.size() )
+                return std::numeric_limits<double>::max();
+
+            const double quanta = nCount[sym] < 0 ? 1.0 : (double)nCount[sym];
+            bits += (double)deltaCounts[sym] * ( 14.0 - std::log2( quanta ) );
+        }
+
+        return bits;
+    };
+
+    // Coarse scan from half to twice the default, then refine around the best one
+    const uint32 defaultR = EncodeDeltaRValue( rValue );
+    const uint32 coarse   = 25;
+
+    uint32 bestR    = defaultR;
+    double bestBits = codedBits( defaultR );
+
+    const double defaultBits = bestBits;
+
+    const uint32 minR = std::max( defaultR / 2, 1u );
+    const uint32 maxR = std::min( defaultR * 2, (uint32)0xFFFF );
+
+    for( uint32 r = minR; r <= maxR; r += coarse )
+    {
+        const double bits = codedBits( r );
+        if( bits < bestBits )
+        {
+            bestBits = bits;
+            bestR    = r;
+        }
+    }
+
+    const uint32 refineMin = bestR > coarse ? bestR - coarse : 1;
+    const uint32 refineMax = std::min( bestR + coarse, maxR );
+
+    for( uint32 r = refineMin; r <= refineMax; r++ )
+    {
+        const double bits = codedBits( r );
+        if( bits < bestBits )
+        {
+            bestBits = bits;
+            bestR    = r;
+        }
+    }
+
+    // Not worth a table of its own
+    if( bestBits > defaultBits * 0.999 )
+        return rValue;
+
+    return DecodeDeltaRValue( (uint16)bestR );
+}
+
+//-----------------------------------------------------------
+size_t CompressParkDeltas( const ParkDeltaCoding coding, byte* dst, const size_t dstCapacity, const byte* deltas, const size_t count,
+                           const FSE_CTable* cTable, const RANSEncTable* ransTable )
+{
+    ASSERT( count < kEntriesPerPark );
+
+    switch( coding )
+    {
+        case ParkDeltaCoding::InterleavedFSE:
+            return CompressInterleavedDeltas( dst, deltas, count, cTable );
+
+        case ParkDeltaCoding::RANS:
+        {
+            ASSERT( ransTable );
+            uint16 words[kEntriesPerPark];
+
+            const size_t size = RANSEncode( dst, deltas, (uint32)count, *ransTable, words );
+            if( size > 0 && size <= dstCapacity )
+                return size;
+
+            const size_t fseSize = FSE_compress_usingCTable( dst + sizeof( uint16 ), count * 8, deltas, count, cTable );
+            if( fseSize == 0 )
+                return 0;
+
+            dst[0] = (byte)( RANSFSEFallback );
+            dst[1] = (byte)( RANSFSEFallback >> 8 );
+            return sizeof( uint16 ) + fseSize;
+        }
+
+        default: break;
+    }
+
+    // We don't bound it by the park's size so that it can use the fast path
+    return FSE_compress_usingCTable( dst, count * 8, deltas, count, cTable );
+}
+
+//-----------------------------------------------------------
+size_t DecompressParkDeltas( const ParkDeltaCoding coding, byte* dst, const size_t dstCapacity, const byte* src, const size_t srcSize,
+                             const FSE_DTable* dTable, const RANSDecTable* ransTable )
+{
+    switch( coding )
+    {
+        case ParkDeltaCoding::InterleavedFSE:
+            return DecompressInterleavedDeltas( dst, dstCapacity, src, srcSize, dTable );
+
+        case ParkDeltaCoding::RANS:
+            ASSERT( ransTable );
+            if( srcSize >= sizeof( uint16 ) && ( src[0] | ( src[1] << 8 ) ) == RANSFSEFallback )
+                return FSE_decompress_usingDTable( dst, dstCapacity, src + sizeof( uint16 ), srcSize - sizeof( uint16 ), dTable );
+
+            return RANSDecode( dst, dstCapacity, src, srcSize, *ransTable );
+
+        default: break;
+    }
+
+    return FSE_decompress_usingDTable( dst, dstCapacity, src, srcSize, dTable );
+}
+
+//-----------------------------------------------------------
 size_t GetLargestCompressedParkSize()
 {
     return std::max( {
@@ -156,4 +450,56 @@ size_t GetLargestCompressedParkSize()
         GetCompressionInfoForLevel( 8 ).tableParkSize,
         GetCompressionInfoForLevel( 9 ).tableParkSize }
     );
+}
+
+//-----------------------------------------------------------
+size_t CalculatePlotSizeBytes( const uint32 k, const uint32 compressionLevel )
+{
+    const uint64 tableEntryCount      = 1ull << k;
+    const double tablePrunedFactors[] = { 0.798, 0.801, 0.807, 0.823, 0.865, 1, 1 };
+
+    size_t parkSizes[] = {
+        CalculateParkSize( TableId::Table1, k ),
+        CalculateParkSize( TableId::Table2, k ),
+        CalculateParkSize( TableId::Table3, k ),
+        CalculateParkSize( TableId::Table4, k ),
+        CalculateParkSize( TableId::Table5, k ),
+        CalculateParkSize( TableId::Table6, k ),
+        CalculatePark7Size( k )
+    };
+
+    if( compressionLevel > 0 )
+    {
+        auto info = GetCompressionInfoForLevel( compressionLevel );
+
+        parkSizes[0] = 0;   // Table 1 is dropped
+        parkSizes[1] = compressionLevel >= 9 ? 0 : info.tableParkSize;
+        parkSizes[2] = compressionLevel >= 9 ? info.tableParkSize : CalculateParkSize( TableId::Table3, k );
+    }
+
+    size_t tableSizes[7] = {};
+    for( uint32 table = (uint32)TableId::Table1; table <= (uint32)TableId::Table7; table++ )
+    {
+        const uint64 prunedEntryCount = (uint64)(tableEntryCount * tablePrunedFactors[table]);
+        const uint64 parkCount        = CDiv( prunedEntryCount, kEntriesPerPark );
+
+        tableSizes[table] = parkCount * parkSizes[table];
+    }
+
+    const size_t c1EntrySize = RoundUpToNextBoundary( k, 8 );
+    const size_t c3ParkCount = CDiv( tableEntryCount, kCheckpoint1Interval );
+    const size_t c3Size      = c3ParkCount * CalculateC3Size(); 
+    const size_t c1Size      = c1EntrySize * ( tableEntryCount / kCheckpoint1Interval ) + c1EntrySize;
+    const size_t c2Size      = c1EntrySize * ( tableEntryCount / (kCheckpoint1Interval * kCheckpoint2Interval) ) + c1EntrySize;
+
+    const size_t plotSize = c3Size + c1Size + c2Size +
+        tableSizes[0] +
+        tableSizes[1] +
+        tableSizes[2] +
+        tableSizes[3] +
+        tableSizes[4] +
+        tableSizes[5] +
+        tableSizes[6];
+    
+    return plotSize;
 }
\ No newline at end of file
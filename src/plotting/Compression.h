@@ -1,5 +1,9 @@
 #pragma once
 #include "fse/fse.h"
+#include "plotting/PlotHeader.h"
+
+struct RANSEncTable;
+struct RANSDecTable;
 
 struct CompressionInfo
 {
@@ -18,6 +22,49 @@ CompressionInfo GetCompressionInfoForLevel( const uint32_t compressionLevel );
 uint32_t        GetCompressedLPBitCount( const uint32_t compressionLevel );
 size_t          GetLargestCompressedParkSize();
 
+// Estimated size of a plot's tables, excluding its header
+size_t          CalculatePlotSizeBytes( const uint32_t k, const uint32_t compressionLevel );
+
+///
+/// Entropy coding of the small deltas of line point parks.
+/// The coding is recorded in the flags of v2 plot headers, v1 plots always use a single FSE stream.
+///
+enum class ParkDeltaCoding : uint32
+{
+    FSE = 0,            // A single FSE stream
+    InterleavedFSE,     // PlotFlags::InterleavedDeltas, see ParkCoding.h
+    RANS,               // PlotFlags::RANSDeltas, see RANSCoding.h
+};
+
+ParkDeltaCoding GetParkDeltaCoding( PlotFlags flags );
+PlotFlags       GetParkDeltaCodingFlags( ParkDeltaCoding coding );
+
+// rANS tables for the same distribution as the FSE tables of an R value.
+// Cached for the lifetime of the process, like the FSE tables.
+const RANSEncTable* CreateRANSEncTable( double rValue );
+const RANSDecTable* CreateRANSDecTable( double rValue );
+
+// FSE tables for an R value fitted to a plot's deltas (PlotFlags::TunedDeltas).
+// Cached for the lifetime of the process, like the tables of the compression levels.
+const FSE_CTable* CreateTunedCTable( double rValue );
+const FSE_DTable* CreateTunedDTable( double rValue );
+
+// Returns the R value, in steps of 0.01, whose tables code deltas with the given counts in the fewest bits,
+// or rValue if none saves more than a negligible amount over it.
+double FitParkDeltaRValue( const uint64 deltaCounts[256], double rValue );
+
+// Compresses count deltas. ransTable is only required by ParkDeltaCoding::RANS.
+// dstCapacity is the space left in the park: ParkDeltaCoding::RANS falls back to FSE for parks it doesn't fit,
+// the other codings may exceed it. Up to 8 * count + 8 bytes of dst may be written, regardless of the size returned.
+// Returns 0 if the deltas can't be compressed, in which case they must be stored raw.
+size_t CompressParkDeltas( ParkDeltaCoding coding, byte* dst, size_t dstCapacity, const byte* deltas, size_t count,
+                           const FSE_CTable* cTable, const RANSEncTable* ransTable );
+
+// Returns the number of deltas decompressed, or an error code which must be checked with FSE_isError.
+// ransTable is only required by ParkDeltaCoding::RANS.
+size_t DecompressParkDeltas( ParkDeltaCoding coding, byte* dst, size_t dstCapacity, const byte* src, size_t srcSize,
+                             const FSE_DTable* dTable, const RANSDecTable* ransTable );
+
 template<uint32_t level>
 struct CompressionLevelInfo 
 {
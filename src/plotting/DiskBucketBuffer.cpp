@@ -24,7 +24,9 @@ DiskBucketBuffer::DiskBucketBuffer( DiskQueue& queue, FileStream& stream, const
 }
 
 DiskBucketBuffer::~DiskBucketBuffer()
-{}
+{
+    delete _deviceIO;
+}
 
 DiskBucketBuffer*
 DiskBucketBuffer::Create( DiskQueue& queue, const char* fileName,
@@ -81,7 +83,7 @@ void DiskBucketBuffer::Submit( const size_t sliceStride )
     c.bucket      = bucket;
     c.vertical    = _verticalWrite;
 
-    _queue->EnqueueDispatchCommand( this, dcmd );
+    _queue->EnqueueDispatchCommand( this, dcmd, DiskQueueCommand::Write, _writeBuffers[bucket % 2], GetBucketRowStride() );
 
     // Record slice sizes (write 1 column cell per row)
     // At the end of a table a bucket row will have
@@ -107,7 +109,7 @@ void DiskBucketBuffer::ReadNextBucket()
     c.bucket   = bucket;
     c.vertical = _verticalWrite; // If the last write was NOT vertical, then the read is vertical.
 
-    _queue->EnqueueDispatchCommand( this, dcmd );
+    _queue->EnqueueDispatchCommand( this, dcmd, DiskQueueCommand::Read, _readBuffers[bucket % 2], GetBucketRowStride() );
 
     EndReadSubmission();
 }
@@ -135,6 +137,17 @@ void DiskBucketBuffer::OverrideReadSlices( const uint32 bucket, const size_t ele
     }
 }
 
+void DiskBucketBuffer::SetDeviceIO( IDiskBucketDeviceIO* deviceIO )
+{
+    if( _deviceIO == deviceIO )
+        return;
+
+    WaitForLastWriteToComplete();
+
+    delete _deviceIO;
+    _deviceIO = deviceIO;
+}
+
 
 ///
 /// These are executed from the DiskQueue thread
@@ -150,17 +163,31 @@ void DiskBucketBuffer::HandleCommand( const DiskQueueDispatchCommand& cmd )
             break;
 
         case DiskBucketBufferCommand::Write:
+        {
+            const auto timer = TimerBegin();
             CmdWriteSlices( c );
+            _queue->Stats().RecordWrite( _statsId, c.write.sliceStride * _bucketCount, TimerEndTicks( timer ) );
+        }
             break;
 
         case DiskBucketBufferCommand::Read:
+        {
+            const auto timer = TimerBegin();
             CmdReadSlices( c );
+            _queue->Stats().RecordRead( _statsId, GetSliceStride() * _bucketCount, TimerEndTicks( timer ) );
+        }
             break;
     }
 }
 
 void DiskBucketBuffer::CmdWriteSlices( const DiskBucketBufferCommand& cmd )
 {
+    if( _deviceIO )
+    {
+        CmdWriteDeviceSlices( cmd );
+        return;
+    }
+
     auto & c = cmd.write;
     int err = 0;
 
@@ -171,6 +198,51 @@ void DiskBucketBuffer::CmdWriteSlices( const DiskBucketBufferCommand& cmd )
     // Offset to the starting location
     int64 offset = (int64)(c.vertical ? _sliceCapacity * c.bucket : GetBucketRowStride() * c.bucket );
 
+    // A row of full slices is contiguous both in the buffer and in the file, so it is written at once
+    const bool writeRow = !c.vertical && srcStride == dstStride;
+
+#if BB_HAS_FILE_IO_BATCH
+    FileIOBatch& batch = _queue->_ioBatch;
+
+    if( batch.IsInitialized() )
+    {
+        if( writeRow )
+        {
+            batch.Write( _file, src, srcStride * _bucketCount, (uint64)offset );
+
+            if( !batch.Submit( err ) )
+                Fatal( "Failed to write slices on '%s/%s' with error %d.", _queue->Path(), Name(), err );
+
+            return;
+        }
+
+        for( uint32 i = 0; i < _bucketCount; i++ )
+        {
+            batch.Write( _file, src, srcStride, (uint64)offset );
+
+            offset += (int64)dstStride;
+            src    += srcStride;
+        }
+
+        if( !batch.Submit( err ) )
+            Fatal( "Failed to write slices on '%s/%s' with error %d.", _queue->Path(), Name(), err );
+
+        return;
+    }
+#endif
+
+    if( writeRow )
+    {
+        FatalIf( !_file.Seek( offset, SeekOrigin::Begin ),
+                    "Failed to seek to bucket %u start on '%s/%s' with error %d.",
+                    c.bucket, _queue->Path(), Name(), (int32)_file.GetError() );
+
+        if( !IOJob::WriteToFileUnaligned( _file, src, srcStride * _bucketCount, err ) )
+            Fatal( "Failed to write slices on '%s/%s' with error %d.", _queue->Path(), Name(), err );
+
+        return;
+    }
+
     // Seek to starting location
     for( uint32 i = 0; i < _bucketCount; i++ )
     {
@@ -192,6 +264,12 @@ void DiskBucketBuffer::CmdWriteSlices( const DiskBucketBufferCommand& cmd )
 
 void DiskBucketBuffer::CmdReadSlices( const DiskBucketBufferCommand& cmd )
 {
+    if( _deviceIO )
+    {
+        CmdReadDeviceSlices( cmd );
+        return;
+    }
+
     const auto& c = cmd.read;
 
     int err = 0;
@@ -201,6 +279,46 @@ void DiskBucketBuffer::CmdReadSlices( const DiskBucketBufferCommand& cmd )
     const size_t rowStride   = GetBucketRowStride();
     const size_t sliceStride = GetSliceStride();
 
+#if BB_HAS_FILE_IO_BATCH
+    FileIOBatch& batch = _queue->_ioBatch;
+
+    if( batch.IsInitialized() )
+    {
+        // Read all full slices in place, then compact them.
+        // A horizontal read is a whole row, which is contiguous in the file.
+        if( !c.vertical )
+            batch.Read( _file, dst, rowStride, rowStride * c.bucket );
+        else
+        {
+            for( uint32 i = 0; i < _bucketCount; i++ )
+                batch.Read( _file, dst + sliceStride * i, sliceStride, rowStride * i + sliceStride * c.bucket );
+        }
+
+        // The last slice may be cut short by the end of the file
+        if( !batch.Submit( err ) )
+            Fatal( "Failed to read slices from '%s/%s' with error %d.", _queue->Path(), Name(), err );
+
+        CompactReadSlices( dst, c.bucket );
+        return;
+    }
+#endif
+
+    if( !c.vertical )
+    {
+        if( !_file.Seek( (int64)(rowStride * c.bucket), SeekOrigin::Begin ) )
+        {
+            Fatal( "Failed to seek to bucket %u start on '%s/%s' with error %d.",
+                   c.bucket, _queue->Path(), Name(), (int32)_file.GetError() );
+        }
+
+        // Only the last row of the file can be cut short by its end
+        if( !IOJob::ReadFromFileUnaligned( _file, dst, rowStride, err ) && err != 0 )
+            Fatal( "Failed to read slices from '%s/%s' with error %d.", _queue->Path(), Name(), err );
+
+        CompactReadSlices( dst, c.bucket );
+        return;
+    }
+
     // Use the last slice as a temp buffer (to avoid the slower memmove on most copies)
     byte* tmpBuffer = dst + sliceStride * (_bucketCount-1);
 
@@ -236,3 +354,67 @@ void DiskBucketBuffer::CmdReadSlices( const DiskBucketBufferCommand& cmd )
         dst += sliceSize;
     }
 }
+
+void DiskBucketBuffer::CompactReadSlices( byte* buffer, const uint32 bucket ) const
+{
+    // Each slice's destination never overlaps a later slice, so copying in order is safe
+    const size_t sliceStride = GetSliceStride();
+
+    byte*       dst = buffer + _readSliceSizes[bucket][0];
+    const byte* src = buffer + sliceStride;
+
+    for( uint32 i = 1; i < _bucketCount; i++ )
+    {
+        const size_t sliceSize = _readSliceSizes[bucket][i];
+        memmove( dst, src, sliceSize );
+
+        dst += sliceSize;
+        src += sliceStride;
+    }
+}
+
+void DiskBucketBuffer::CmdWriteDeviceSlices( const DiskBucketBufferCommand& cmd )
+{
+    const auto& c = cmd.write;
+    int err = 0;
+
+    const byte*  src       = (byte*)_writeBuffers[c.bucket % 2];
+    const size_t srcStride = c.sliceStride;
+    const size_t dstStride = c.vertical ? GetBucketRowStride() : GetSliceStride();
+
+    int64 offset = (int64)(c.vertical ? _sliceCapacity * c.bucket : GetBucketRowStride() * c.bucket );
+
+    for( uint32 i = 0; i < _bucketCount; i++ )
+    {
+        if( !_deviceIO->WriteSlice( src, srcStride, offset, err ) )
+            Fatal( "Failed to write device slice %u on '%s/%s' with error %d.", i, _queue->Path(), Name(), err );
+
+        offset += (int64)dstStride;
+        src    += srcStride;
+    }
+}
+
+void DiskBucketBuffer::CmdReadDeviceSlices( const DiskBucketBufferCommand& cmd )
+{
+    const auto& c = cmd.read;
+    int err = 0;
+
+    byte* dst = _readBuffers[c.bucket % 2];
+
+    const size_t rowStride   = GetBucketRowStride();
+    const size_t sliceStride = GetSliceStride();
+
+    // Device memory can't be compacted from here, so read only
+    // the used part of each slice, directly into its final location.
+    for( uint32 i = 0; i < _bucketCount; i++ )
+    {
+        const size_t colOffset = c.vertical ? sliceStride * c.bucket : sliceStride * i;
+        const size_t rowOffset = c.vertical ? rowStride * i          : rowStride * c.bucket;
+        const size_t sliceSize = _readSliceSizes[c.bucket][i];
+
+        if( sliceSize > 0 && !_deviceIO->ReadSlice( dst, sliceSize, (int64)(rowOffset + colOffset), err ) )
+            Fatal( "Failed to read device slice %u from '%s/%s' with error %d.", i, _queue->Path(), Name(), err );
+
+        dst += sliceSize;
+    }
+}
@@ -1,6 +1,21 @@
 #pragma once
 #include "DiskBufferBase.h"
 
+/**
+ * Performs slice I/O for a DiskBucketBuffer whose write and read buffers
+ * are not in host memory. For example, GPU buffers read and written
+ * directly with GPUDirect Storage.
+ * Called from the DiskQueue thread.
+ */
+class IDiskBucketDeviceIO
+{
+public:
+    virtual ~IDiskBucketDeviceIO() {}
+
+    virtual bool WriteSlice( const void* src, size_t size, int64 fileOffset, int& error ) = 0;
+    virtual bool ReadSlice ( void* dst, size_t size, int64 fileOffset, int& error ) = 0;
+};
+
 /**
  * A disk-backed buffer which read/writes in buckets and slices. Where a slice is a a portion
  * of data that belongs to a bucket. The number of slices is equal to n_buckets * n_buckets.
@@ -80,15 +95,30 @@ public:
 
     void OverrideReadSlices( uint32 bucket, size_t elementSize, const uint32* sliceSizes, uint32 stride );
 
+    /**
+     * Sets an I/O override that reads and writes slices directly from and to
+     * the assigned buffers, instead of going through the file.
+     * The buffer takes ownership of it. When set, the assigned read and write buffers
+     * are expected to be addressable by the device I/O, not by the host.
+     */
+    void SetDeviceIO( IDiskBucketDeviceIO* deviceIO );
+
+    inline IDiskBucketDeviceIO* GetDeviceIO() const { return _deviceIO; }
+
 private:
     void HandleCommand( const DiskQueueDispatchCommand& cmd ) override;
     void CmdWriteSlices( const DiskBucketBufferCommand& cmd );
     void CmdReadSlices( const DiskBucketBufferCommand& cmd );
+    void CompactReadSlices( byte* buffer, uint32 bucket ) const;
+    void CmdWriteDeviceSlices( const DiskBucketBufferCommand& cmd );
+    void CmdReadDeviceSlices( const DiskBucketBufferCommand& cmd );
 
 private:
     size_t _sliceCapacity;         // Maximum size of each slice
 
     bool   _verticalWrite = false;
+
+    IDiskBucketDeviceIO* _deviceIO = nullptr;
     // size_t _writeSliceStride;      // Offset to the start of the next slices when writing
     // size_t _readSliceStride;       // Offset to the start of the next slice when reading (these are swapped between tables).
 
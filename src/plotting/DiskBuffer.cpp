@@ -55,8 +55,8 @@ void DiskBuffer::ReadNextBucket()
     auto& c = cmd.read;
     c.bucket = _nextReadBucket;
 
-    _queue->EnqueueDispatchCommand( this, dcmd );
-    _queue->SignalFence( _readFence, ++_nextReadBucket );
+    _queue->EnqueueDispatchCommand( this, dcmd, DiskQueueCommand::Read, _readBuffers[c.bucket % 2], _alignedBufferSize );
+    _queue->SignalFence( _readFence, ++_nextReadBucket, DiskQueueCommand::Read );
 }
 
 void DiskBuffer::Submit( const size_t size )
@@ -70,10 +70,10 @@ void DiskBuffer::Submit( const size_t size )
 
     auto& c = cmd.write;
     c.bucket = _nextWriteBucket;
-    _queue->EnqueueDispatchCommand( this, dcmd );
+    _queue->EnqueueDispatchCommand( this, dcmd, DiskQueueCommand::Write, _writeBuffers[c.bucket % 2], _alignedBufferSize );
 
     // Signal completion
-    _queue->SignalFence( _writeFence, ++_nextWriteBucket );
+    _queue->SignalFence( _writeFence, ++_nextWriteBucket, DiskQueueCommand::Write );
 }
 
 void DiskBuffer::HandleCommand( const DiskQueueDispatchCommand& cmd )
@@ -99,11 +99,15 @@ void DiskBuffer::CmdWrite( const DiskBufferCommand& cmd )
     const auto& c = cmd.write;
 
     // Write a full block-aligned bucket
+    const auto timer = TimerBegin();
+
     int err = 0;
     if( !IOJob::WriteToFileUnaligned( _file, _writeBuffers[c.bucket % 2], _alignedBufferSize, err ) )
     {
         Fatal( "Failed to write bucket to '%s/%s' with error %d.", _queue->Path(), Name(), err );
     }
+
+    _queue->Stats().RecordWrite( _statsId, _alignedBufferSize, TimerEndTicks( timer ) );
 }
 
 void DiskBuffer::CmdRead( const DiskBufferCommand& cmd )
@@ -111,9 +115,13 @@ void DiskBuffer::CmdRead( const DiskBufferCommand& cmd )
     const auto& c = cmd.read;
 
     // Read a full block-aligned bucket
+    const auto timer = TimerBegin();
+
     int err = 0;
     if( !IOJob::ReadFromFileUnaligned( _file, _readBuffers[c.bucket % 2], _alignedBufferSize, err ) )
     {
         Fatal( "Failed to read bucket from '%s/%s' with error %d.", _queue->Path(), Name(), err );
     }
+
+    _queue->Stats().RecordRead( _statsId, _alignedBufferSize, TimerEndTicks( timer ) );
 }
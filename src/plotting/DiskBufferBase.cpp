@@ -20,6 +20,7 @@ DiskBufferBase::DiskBufferBase( DiskQueue& queue, FileStream& stream,
     , _file       ( std::move( stream ) )
     , _name       ( name )
     , _bucketCount( bucketCount )
+    , _statsId    ( queue.Stats().AddFile( name ) )
 {}
 
 DiskBufferBase::~DiskBufferBase()
@@ -121,7 +122,11 @@ void* DiskBufferBase::GetNextWriteBuffer()
     PanicIf( !buf, "No write buffer reserved for '%s'.", _name.c_str() );
 
     if( _nextWriteLock++ >= 2 )
+    {
+        const auto timer = TimerBegin();
         WaitForWriteToComplete( _nextWriteLock-2 );
+        _queue->Stats().AddBufferWait( TimerEndTicks( timer ) );
+    }
 
     return buf;
 }
@@ -159,7 +164,10 @@ void* DiskBufferBase::GetNextReadBuffer()
     void* buf = _readBuffers[_nextReadLock % 2];
     PanicIf( !buf, "No read buffer reserved for '%s'.", _name.c_str() );
 
+    const auto timer = TimerBegin();
     WaitForReadToComplete( _nextReadLock++ );
+    _queue->Stats().AddBufferWait( TimerEndTicks( timer ) );
+
     return buf;
 }
 
@@ -188,7 +196,7 @@ uint32 DiskBufferBase::BeginWriteSubmission()
 
 void DiskBufferBase::EndWriteSubmission()
 {
-    _queue->SignalFence( _writeFence, ++_nextWriteBucket );
+    _queue->SignalFence( _writeFence, ++_nextWriteBucket, DiskQueueCommand::Write );
 }
 
 uint32 DiskBufferBase::BeginReadSubmission()
@@ -199,5 +207,5 @@ uint32 DiskBufferBase::BeginReadSubmission()
 
 void DiskBufferBase::EndReadSubmission()
 {
-    _queue->SignalFence( _readFence, ++_nextReadBucket );
+    _queue->SignalFence( _readFence, ++_nextReadBucket, DiskQueueCommand::Read );
 }
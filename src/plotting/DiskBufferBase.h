@@ -104,6 +104,7 @@ protected:
     std::string _name;
 
     uint32      _bucketCount;
+    uint32      _statsId;                   // File id in the queue's IOStats
     Fence       _writeFence;
     Fence       _readFence;
 
@@ -7,12 +7,18 @@
 DiskQueue::DiskQueue( const char* path )
     : Super()
     , _path( path )
+    , _ioStats( path )
 {
     ASSERT( path );
 
     _blockSize = FileStream::GetBlockSizeForPath( path );
     FatalIf( _blockSize < 1, "Failed to obtain file system block size for path '%s'", path );
 
+    #if BB_HAS_FILE_IO_BATCH
+        // Falls back to blocking I/O per slice if batched I/O is not available
+        _ioBatch.Init( 256 );
+    #endif
+
     StartConsumer();
 }
 
@@ -21,42 +27,116 @@ DiskQueue::~DiskQueue()
 
 void DiskQueue::ProcessCommands( const Span<DiskQueueCommand> items )
 {
+    ASSERT( items.Length() <= DiskQueueCommand::MAX_STACK_COMMANDS );
+
+    // Writes waiting behind the reads that followed them
+    uint32 deferred[DiskQueueCommand::MAX_STACK_COMMANDS];
+    uint32 deferredCount = 0;
+    size_t deferredSize  = 0;
+
+    auto flushWrites = [&]() {
+        for( uint32 i = 0; i < deferredCount; i++ )
+            ExecuteCommand( items[deferred[i]] );
+
+        deferredCount = 0;
+        deferredSize  = 0;
+    };
+
+    auto conflictsWithWrites = [&]( const DiskQueueCommand& read ) {
+        if( read.type != DiskQueueCommand::DispatchDiskBufferCommand )
+            return false;
+
+        const byte* readStart = read.dispatch.buffer;
+        const byte* readEnd   = readStart + read.dispatch.bufferSize;
+
+        for( uint32 i = 0; i < deferredCount; i++ )
+        {
+            const auto& write = items[deferred[i]];
+            if( write.type != DiskQueueCommand::DispatchDiskBufferCommand )
+                continue;
+
+            const byte* writeStart = write.dispatch.buffer;
+            const byte* writeEnd   = writeStart + write.dispatch.bufferSize;
+
+            if( write.dispatch.sender == read.dispatch.sender || ( readStart < writeEnd && writeStart < readEnd ) )
+                return true;
+        }
+
+        return false;
+    };
+
     for( uint32 item = 0; item < items.Length(); item++ )
     {
         auto& cmd = items[item];
 
-        switch( cmd.type )
+        switch( cmd.priority )
         {
-            case DiskQueueCommand::DispatchDiskBufferCommand:
-                cmd.dispatch.sender->HandleCommand( cmd.dispatch.cmd );
-                break;
+            case DiskQueueCommand::Write:
+                deferred[deferredCount++] = item;
 
-            case DiskQueueCommand::Signal:
-                cmd.signal.fence->Signal( (uint32)cmd.signal.value );
-            break;
+                if( cmd.type == DiskQueueCommand::DispatchDiskBufferCommand )
+                    deferredSize += cmd.dispatch.bufferSize;
+
+                if( deferredSize >= MAX_DEFERRED_WRITE_SIZE )
+                    flushWrites();
+                continue;
+
+            case DiskQueueCommand::Read:
+                if( deferredCount > 0 && conflictsWithWrites( cmd ) )
+                    flushWrites();
+                break;
 
             default:
-                ASSERT(0);
+                flushWrites();
                 break;
         }
+
+        ExecuteCommand( cmd );
+    }
+
+    flushWrites();
+}
+
+void DiskQueue::ExecuteCommand( DiskQueueCommand& cmd )
+{
+    switch( cmd.type )
+    {
+        case DiskQueueCommand::DispatchDiskBufferCommand:
+            cmd.dispatch.sender->HandleCommand( cmd.dispatch.cmd );
+            _ioStats.AddPending( -1 );
+            break;
+
+        case DiskQueueCommand::Signal:
+            cmd.signal.fence->Signal( (uint32)cmd.signal.value );
+        break;
+
+        default:
+            ASSERT(0);
+            break;
     }
 }
 
-void DiskQueue::EnqueueDispatchCommand( DiskBufferBase* sender, const DiskQueueDispatchCommand& cmd )
+void DiskQueue::EnqueueDispatchCommand( DiskBufferBase* sender, const DiskQueueDispatchCommand& cmd,
+                                        const DiskQueueCommand::Priority priority, const void* buffer, const size_t bufferSize )
 {
     // #TODO: Don't copy and just have them send in a DiskQueueCommand?
     DiskQueueCommand c;
     c.type                    = DiskQueueCommand::DispatchDiskBufferCommand;
-    c.dispatch.sender = sender;
-    c.dispatch.cmd    = cmd;
+    c.priority                = priority;
+    c.dispatch.sender         = sender;
+    c.dispatch.cmd            = cmd;
+    c.dispatch.buffer         = (const byte*)buffer;
+    c.dispatch.bufferSize     = bufferSize;
 
+    _ioStats.AddPending( 1 );
     this->Submit( c );
 }
 
-void DiskQueue::SignalFence( Fence& fence, uint64 value )
+void DiskQueue::SignalFence( Fence& fence, uint64 value, const DiskQueueCommand::Priority priority )
 {
     DiskQueueCommand c;
     c.type                    = DiskQueueCommand::Signal;
+    c.priority                = priority;
     c.signal.fence            = &fence;
     c.signal.value            = value;
 
@@ -3,6 +3,8 @@
 #include "threading/AutoResetSignal.h"
 #include "util/MPMCQueue.h"
 #include "util/CommandQueue.h"
+#include "io/FileStream.h"
+#include "IOStats.h"
 
 class IStream;
 class Fence;
@@ -76,13 +78,24 @@ struct DiskQueueCommand
         Signal,
     };
 
-    Type type;
+    // Order in which the queue may execute commands that were submitted together
+    enum Priority : uint8
+    {
+        Barrier = 0,    // After everything submitted before it
+        Read,           // Ahead of the writes submitted before it that it does not conflict with
+        Write,          // Deferred behind the reads submitted after it, in submission order with other writes
+    };
+
+    Type     type;
+    Priority priority;
 
     union
     {
         struct {
             DiskBufferBase* sender;
             DiskQueueDispatchCommand cmd;
+            const byte*     buffer;     // Memory read from or written to, for conflict checks
+            size_t          bufferSize;
         } dispatch;
 
         struct {
@@ -92,6 +105,11 @@ struct DiskQueueCommand
     };
 };
 
+/// Performs the I/O of the disk buffers of one temp directory, normally one device, on its own thread.
+/// Compute threads block on bucket reads, but rarely on writes, as write buffers are double-buffered.
+/// So within the commands dequeued together, reads are executed ahead of the writes submitted before them,
+/// unless they touch the same disk buffer or memory. Those writes keep their order and go out at the end of the batch,
+/// or as soon as MAX_DEFERRED_WRITE_SIZE bytes of them are pending.
 class DiskQueue : public MPCommandQueue<DiskQueueCommand, DiskQueueCommand::MAX_STACK_COMMANDS>
 {
     using Super = MPCommandQueue<DiskQueueCommand, DiskQueueCommand::MAX_STACK_COMMANDS>;
@@ -101,21 +119,32 @@ class DiskQueue : public MPCommandQueue<DiskQueueCommand, DiskQueueCommand::MAX_
     friend class DiskBucketBuffer;
 
 public:
+    static constexpr size_t MAX_DEFERRED_WRITE_SIZE = 256 MiB;
+
     DiskQueue( const char* path );
     ~DiskQueue();
 
     inline const char* Path() const { return _path.c_str(); }
     inline size_t      BlockSize() const { return _blockSize; }
+    inline IOStats&    Stats() { return _ioStats; }
 
 protected:
     void ProcessCommands( const Span<DiskQueueCommand> items ) override;
 
 private:
-    void EnqueueDispatchCommand( DiskBufferBase* sender, const DiskQueueDispatchCommand& cmd );
-    void SignalFence( Fence& fence, uint64 value );
+    void EnqueueDispatchCommand( DiskBufferBase* sender, const DiskQueueDispatchCommand& cmd,
+                                 DiskQueueCommand::Priority priority, const void* buffer, size_t bufferSize );
+    void SignalFence( Fence& fence, uint64 value, DiskQueueCommand::Priority priority = DiskQueueCommand::Barrier );
+
+    void ExecuteCommand( DiskQueueCommand& cmd );
 
 private:
     std::string _path;          // Storage directory
     size_t      _blockSize = 0; // File system block size at path
+    IOStats     _ioStats;       // Always-on metrics, per disk buffer, for --io-status
+
+#if BB_HAS_FILE_IO_BATCH
+    FileIOBatch _ioBatch;       // For submitting all slices of a bucket at once. Only used from the consumer thread.
+#endif
 };
 
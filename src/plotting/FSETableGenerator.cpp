@@ -7,12 +7,10 @@
 #include "ChiaConsts.h"
 #include "FSETableGenerator.h"
 
-static std::vector<short> CreateNormalizedCount(double R);
-
 //-----------------------------------------------------------
 void* GenFSETable( const double rValue, size_t* outTableSize, const bool compress )
 {
-    std::vector<short> nCount         = CreateNormalizedCount( rValue );
+    std::vector<short> nCount         = FSETableGenerator::CreateNormalizedCount( rValue );
     unsigned           maxSymbolValue = (unsigned)nCount.size() - 1;
     unsigned           tableLog       = 14;
 
@@ -63,7 +61,7 @@ FSE_DTable* FSETableGenerator::GenDecompressionTable( double rValue, size_t* out
 ///
 /// Taken from chiapos
 ///
-std::vector<short> CreateNormalizedCount(double R)
+std::vector<short> FSETableGenerator::CreateNormalizedCount(double R)
 {
     std::vector<double> dpdf;
     int N = 0;
@@ -1,4 +1,5 @@
 #pragma once
+#include <vector>
 
 typedef unsigned FSE_CTable;
 typedef unsigned FSE_DTable;
@@ -7,4 +8,8 @@ struct FSETableGenerator
 {
     static FSE_CTable* GenCompressionTable( const double rValue, size_t* outTableSize );
     static FSE_DTable* GenDecompressionTable( double rValue, size_t* outTableSize );
+
+    // Normalized symbol counts of the delta distribution for an R value, over 2^14 quanta.
+    // Counts of -1 are low probability symbols, which take a single quantum.
+    static std::vector<short> CreateNormalizedCount( double rValue );
 };
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "threading/ThreadPool.h"
+#include "algorithm/KeyGather.h"
 
 struct SortKeyGen
 {
@@ -133,8 +134,5 @@ inline void SortKeyGen::SortThread( SortJob<T>* job )
     const T*      src    = job->src;
     T*            dst    = job->dst + offset;
 
-    for( int64 i = 0; i < length; i++ )
-    {
-        dst[i] = src[keys[i]];
-    }
+    KeyGather::Gather( keys, src, dst, (uint64)length );
 }
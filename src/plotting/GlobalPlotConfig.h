@@ -3,6 +3,7 @@
 #include <string>
 
 struct PuzzleHash;
+struct PlotBenchmarkConfig;
 namespace bls
 {
     class G1Element;
@@ -15,6 +16,7 @@ struct GlobalPlotConfig
 
     const char* plotIdStr    = nullptr;
     const char* plotMemoStr  = nullptr;
+    const char* plotIdsPath  = nullptr;     // --ids: Take plot ids and memos from a manifest written by 'gen-ids'
     // byte*       plotId       = new byte[BB_PLOT_ID_LEN];
     // byte*       plotMemo     = new byte[BB_PLOT_MEMO_MAX_SIZE];
     // uint16      plotMemoSize = 0;
@@ -30,8 +32,27 @@ struct GlobalPlotConfig
     bool            warmStart              = false;
     bool            disableNuma            = false;
     bool            disableCpuAffinity     = false;
+    uint32          ioCoreCount            = 0;                // --io-cores: Cores reserved for I/O, plot writer and GPU feeder threads
+    uint32          cpuOffset              = 0;                // multi: Compute CPU index (see ThreadAffinity) this plotter's thread pools start at
     bool            disableOutputDirectIO  = false;            // Do not use direct I/O when writing the plot files
+    const char*     stageDir               = nullptr;          // --stage-dir: Write plots here first, then move them to the output directories
+    bool            writeManifest          = false;            // --manifest: Write a <plot>.b3 file with the BLAKE3 digest of each plot table
+    uint32          plotWriteDepth         = 1;                // --plot-write-depth: Plot file writes kept in flight at once
     bool            verbose                = false;            // Allow some verbose output
+    bool            hugePages              = false;            // --huge-pages: Back large plotting buffers with huge pages
+    ParkDeltaCoding parkDeltaCoding        = ParkDeltaCoding::FSE; // --interleaved-deltas, --rans-deltas: Entropy coding of the park deltas
+    bool            alignedParks           = false;            // --aligned-parks: Lay out tables and parks on 4 KiB pages (PlotFlags::AlignedParks)
+    bool            tunedDeltas            = false;            // --tuned-deltas: Code each table's park deltas with an R value fitted to them (PlotFlags::TunedDeltas)
+    const char*     servePath              = nullptr;          // --serve: Keep the plotter resident and read plot requests from this pipe ("-" for stdin)
+    size_t          maxMemory              = 0;                // --max-memory: Host memory budget for the plotter. 0 = unbounded
+    size_t          maxPinnedMemory        = 0;                // --max-pinned: Page-locked memory budget (cudaplot). 0 = unbounded
+    PlotBenchmarkConfig* bench             = nullptr;          // bench: Time deterministic plots and compare them to a baseline
+    float64         ioStatusInterval       = 0;                // --io-status: Seconds between I/O status reports. 0 = disabled
+    const char*     ioStatusPath           = nullptr;          // --io-status-file: Write the I/O status reports to this file instead of stdout
+    const char*     tracePath              = nullptr;          // --trace: Write a timeline of hot path zones to this file on exit (needs ENABLE_TRACE builds)
+    bool            perfCounters           = false;            // --perf-counters: Log hardware performance counters per phase, table and job type (Linux)
+    uint32          yieldToHarvestMS       = 0;                // --yield-to-harvest: Pause up to this many ms at a time while a local harvester is busy. 0 = disabled
+    uint32          k                      = 32;               // -k: Plot size. Below 32 only with ramplot, and without compression
     uint32          compressionLevel       = 0;                // 0 == no compression. 1 = 16 bits. 2 = 15 bits, ..., 6 = 11 bits
     uint32          compressedEntryBits    = 32;               // Bit size of table 1 entries. If compressed, then it is set to <= 16.
     FSE_CTable*     ctable                 = nullptr;          // Compression table if making compressed plots
@@ -0,0 +1,42 @@
+#pragma once
+#include "ChiaConsts.h"
+#include "plotting/FSETableGenerator.h"
+
+///
+/// Decodes the FSE-compressed deltas of many LP parks at once on a GPU.
+/// The parks of a batch belong to the same table, so they share its decoding table,
+/// which each thread block loads into shared memory once.
+/// Each park is decoded by a single thread, as its two FSE states depend on each other.
+///
+class IGpuParkDecoder
+{
+public:
+    static constexpr uint32 MaxDeltasPerPark = kEntriesPerPark - 1;
+
+    inline virtual ~IGpuParkDecoder() {}
+
+    virtual uint32 MaxParks()       const = 0;
+    virtual uint32 MaxSectionSize() const = 0;
+
+    /// Staging buffers for a batch. The compressed deltas of park i
+    /// go at Sections() + i * MaxSectionSize(), and their size at SectionSizes()[i].
+    virtual byte*   Sections()     = 0;
+    virtual uint16* SectionSizes() = 0;
+
+    /// Decodes the first parkCount parks staged with the table's FSE decoding table.
+    /// Returns false on a device error.
+    virtual bool Decode( const FSE_DTable* dTable, uint32 parkCount ) = 0;
+
+    /// Output of the last Decode() call. The deltas of park i are at Deltas() + i * MaxDeltasPerPark,
+    /// and their count, or an FSE error code, at DeltaCounts()[i].
+    virtual const byte*   Deltas()      const = 0;
+    virtual const uint64* DeltaCounts() const = 0;
+};
+
+class CudaParkDecoderFactory
+{
+public:
+    /// Returns nullptr if CUDA is not available or the device could not be initialized.
+    /// maxSectionSize is the largest compressed deltas section of the parks to decode.
+    static IGpuParkDecoder* Create( uint32 deviceIndex, uint32 maxParks, uint32 maxSectionSize );
+};
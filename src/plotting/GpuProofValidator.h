@@ -0,0 +1,34 @@
+#pragma once
+#include "ChiaConsts.h"
+
+///
+/// Validates batches of k32 full proofs on a GPU.
+/// The f1 of all x's of the batch are generated at once, then each table level is
+/// matched and hashed across all proofs of the batch in a single launch, up to f7.
+///
+class IGpuProofValidator
+{
+public:
+    inline virtual ~IGpuProofValidator() {}
+
+    virtual uint32 MaxProofs() const = 0;
+
+    /// Staging buffer for a batch. The BB_PLOT_PROOF_X_COUNT x's of proof i go at ProofXs() + i * BB_PLOT_PROOF_X_COUNT.
+    virtual uint64* ProofXs() = 0;
+
+    /// Validates the first proofCount proofs staged, which must belong to the same plot.
+    /// Returns false on a device error.
+    virtual bool Validate( const byte plotId[BB_PLOT_ID_LEN], uint32 proofCount ) = 0;
+
+    /// Output of the last Validate() call. Valid()[i] is set if proof i is valid,
+    /// in which case F7s()[i] holds its f7.
+    virtual const uint64* F7s()   const = 0;
+    virtual const bool*   Valid() const = 0;
+};
+
+class CudaProofValidatorFactory
+{
+public:
+    /// Returns nullptr if CUDA is not available or the device could not be initialized.
+    static IGpuProofValidator* Create( uint32 deviceIndex, uint32 maxProofs );
+};
@@ -0,0 +1,149 @@
+#include "HarvestYield.h"
+#include "threading/Thread.h"
+#include "util/Log.h"
+#include <atomic>
+#include <mutex>
+
+#if PLATFORM_IS_WINDOWS
+    #include <Windows.h>
+#else
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+// Shared by every process on the machine. A new region is zero-filled, which is its idle state.
+struct HarvestYieldRegion
+{
+    std::atomic<uint32> activeHarvests;
+    std::atomic<int64>  lastBeginMS;        // Steady clock, which is system-wide
+};
+
+static_assert( std::atomic<uint32>::is_always_lock_free && std::atomic<int64>::is_always_lock_free,
+               "Harvest yield region atomics must be lock-free to be shared across processes." );
+
+#if PLATFORM_IS_WINDOWS
+    static const wchar_t REGION_NAME[] = L"Local\\bladebit-harvest-yield";
+#else
+    static const char    REGION_NAME[] = "/bladebit-harvest-yield";
+#endif
+
+static std::once_flag       _regionOnce;
+static HarvestYieldRegion*  _region     = nullptr;
+static std::atomic<bool>    _yield      = false;
+static uint32               _maxPauseMS = HarvestYield::DefaultMaxPauseMS;
+static std::atomic<uint64>  _pausedNs   = 0;
+
+//-----------------------------------------------------------
+static int64 NowMS()
+{
+    return (int64)std::chrono::duration_cast<std::chrono::milliseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+//-----------------------------------------------------------
+static HarvestYieldRegion* OpenRegion()
+{
+    #if PLATFORM_IS_WINDOWS
+        HANDLE mapping = CreateFileMappingW( INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+                                             0, (DWORD)sizeof( HarvestYieldRegion ), REGION_NAME );
+        if( !mapping )
+            return nullptr;
+
+        // The mapping is kept open for the lifetime of the process
+        return (HarvestYieldRegion*)MapViewOfFile( mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof( HarvestYieldRegion ) );
+    #else
+        const int fd = shm_open( REGION_NAME, O_RDWR | O_CREAT, 0666 );
+        if( fd < 0 )
+            return nullptr;
+
+        // Plotters and harvesters may run as different users
+        fchmod( fd, 0666 );
+
+        struct stat st = {};
+        if( fstat( fd, &st ) != 0 || ( (size_t)st.st_size < sizeof( HarvestYieldRegion ) && ftruncate( fd, sizeof( HarvestYieldRegion ) ) != 0 ) )
+        {
+            close( fd );
+            return nullptr;
+        }
+
+        void* ptr = mmap( nullptr, sizeof( HarvestYieldRegion ), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+        close( fd );
+
+        return ptr == MAP_FAILED ? nullptr : (HarvestYieldRegion*)ptr;
+    #endif
+}
+
+//-----------------------------------------------------------
+static HarvestYieldRegion* Region()
+{
+    std::call_once( _regionOnce, []() { _region = OpenRegion(); } );
+    return _region;
+}
+
+//-----------------------------------------------------------
+void HarvestYield::BeginHarvest()
+{
+    HarvestYieldRegion* region = Region();
+    if( !region )
+        return;
+
+    region->lastBeginMS.store( NowMS(), std::memory_order_relaxed );
+    region->activeHarvests.fetch_add( 1, std::memory_order_release );
+}
+
+//-----------------------------------------------------------
+void HarvestYield::EndHarvest()
+{
+    HarvestYieldRegion* region = Region();
+    if( !region )
+        return;
+
+    // Don't underflow if another process reset or mismatched it
+    uint32 active = region->activeHarvests.load( std::memory_order_relaxed );
+    while( active > 0 && !region->activeHarvests.compare_exchange_weak( active, active - 1, std::memory_order_release, std::memory_order_relaxed ) );
+}
+
+//-----------------------------------------------------------
+bool HarvestYield::EnableYield( const uint32 maxPauseMS )
+{
+    if( !Region() )
+    {
+        Log::Error( "Warning: Failed to open the harvest yield shared memory region, --yield-to-harvest is disabled." );
+        return false;
+    }
+
+    _maxPauseMS = maxPauseMS;
+    _yield.store( true, std::memory_order_release );
+    return true;
+}
+
+//-----------------------------------------------------------
+bool HarvestYield::IsHarvesting()
+{
+    HarvestYieldRegion* region = _region;
+    if( !region || region->activeHarvests.load( std::memory_order_acquire ) == 0 )
+        return false;
+
+    return NowMS() - region->lastBeginMS.load( std::memory_order_relaxed ) < (int64)STALE_MS;
+}
+
+//-----------------------------------------------------------
+void HarvestYield::Yield()
+{
+    if( !_yield.load( std::memory_order_relaxed ) || !IsHarvesting() )
+        return;
+
+    const auto timer = TimerBegin();
+
+    while( IsHarvesting() && TimerEnd( timer ) * 1000.0 < (double)_maxPauseMS )
+        Thread::Sleep( 1 );
+
+    _pausedNs.fetch_add( (uint64)TicksToNanoSeconds( TimerEndTicks( timer ) ), std::memory_order_relaxed );
+}
+
+//-----------------------------------------------------------
+Duration HarvestYield::PausedTime()
+{
+    return std::chrono::duration_cast<Duration>( std::chrono::nanoseconds( _pausedNs.load( std::memory_order_relaxed ) ) );
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+///
+/// Lets a plotter and a harvester share a machine during signage points.
+/// Harvesters mark the time they spend looking up and decompressing proofs in a small named shared memory
+/// region (GreenReaperConfig::yieldPlotters, or grBeginHarvest/grEndHarvest around a whole signage point).
+/// Plotters started with --yield-to-harvest check it at their bucket boundaries and hold off on
+/// submitting more thread pool jobs and GPU kernels while a harvest is in progress, so that the
+/// harvester gets the CPUs and the GPU back. A plotter never pauses for longer than its maximum
+/// at a time, and marks older than STALE_MS (ex. left behind by a harvester that crashed) are ignored.
+///
+class HarvestYield
+{
+public:
+    static constexpr uint32 DefaultMaxPauseMS = 2000;
+    static constexpr uint32 STALE_MS          = 30000;
+
+    // Harvester side. Calls may be nested and made from any thread.
+    static void BeginHarvest();
+    static void EndHarvest();
+
+    // Plotter side. Returns false if the shared region could not be opened.
+    static bool EnableYield( uint32 maxPauseMS = DefaultMaxPauseMS );
+
+    static bool IsHarvesting();
+
+    // Blocks while a harvester is busy, for up to the maximum pause. Does nothing unless yielding is enabled.
+    static void Yield();
+
+    // Total time spent in Yield()
+    static Duration PausedTime();
+};
+
+/// Marks a harvest for the lifetime of the scope, if enabled
+class HarvestScope
+{
+public:
+    inline HarvestScope( const bool enabled ) : _enabled( enabled )
+    {
+        if( _enabled )
+            HarvestYield::BeginHarvest();
+    }
+
+    inline ~HarvestScope()
+    {
+        if( _enabled )
+            HarvestYield::EndHarvest();
+    }
+
+private:
+    bool _enabled;
+};
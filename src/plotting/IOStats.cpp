@@ -0,0 +1,221 @@
+#include "IOStats.h"
+#include "threading/Thread.h"
+#include "util/Log.h"
+#include <vector>
+#include <algorithm>
+#include <filesystem>
+
+struct IOStatusReportParams
+{
+    long        intervalMS;
+    std::string path;
+};
+
+// All live instances, for status reports.
+// Never destroyed, as the report thread may still be running at exit.
+static std::mutex&            _registryLock = *new std::mutex();
+static std::vector<IOStats*>& _registry     = *new std::vector<IOStats*>();
+
+//-----------------------------------------------------------
+static void AppendF( std::string& str, const char* fmt, ... )
+{
+    char buffer[256];
+
+    va_list args;
+    va_start( args, fmt );
+    const int len = vsnprintf( buffer, sizeof( buffer ), fmt, args );
+    va_end( args );
+
+    if( len > 0 )
+        str.append( buffer, std::min( (size_t)len, sizeof( buffer ) - 1 ) );
+}
+
+//-----------------------------------------------------------
+static void AppendJsonStr( std::string& str, const char* value )
+{
+    str += '"';
+
+    for( ; *value; value++ )
+    {
+        const char c = *value;
+
+        if( c == '"' || c == '\\' )
+        {
+            str += '\\';
+            str += c;
+        }
+        else if( (unsigned char)c < 0x20 )
+            AppendF( str, "\\u%04x", (unsigned)c );
+        else
+            str += c;
+    }
+
+    str += '"';
+}
+
+//-----------------------------------------------------------
+IOStats::IOStats( const char* name )
+    : _name( name ? name : "" )
+{
+    std::lock_guard<std::mutex> lock( _registryLock );
+    _registry.push_back( this );
+}
+
+//-----------------------------------------------------------
+IOStats::~IOStats()
+{
+    std::lock_guard<std::mutex> lock( _registryLock );
+    _registry.erase( std::find( _registry.begin(), _registry.end(), this ) );
+}
+
+//-----------------------------------------------------------
+uint32 IOStats::AddFile( const char* name )
+{
+    std::lock_guard<std::mutex> lock( _lock );
+
+    _files.emplace_back();
+    _files.back().name = name ? name : "";
+
+    return (uint32)_files.size() - 1;
+}
+
+//-----------------------------------------------------------
+void IOStats::RecordRead( const uint32 fileId, const size_t size, const Duration elapsed )
+{
+    Record( Read, fileId, size, elapsed );
+}
+
+//-----------------------------------------------------------
+void IOStats::RecordWrite( const uint32 fileId, const size_t size, const Duration elapsed )
+{
+    Record( Write, fileId, size, elapsed );
+}
+
+//-----------------------------------------------------------
+void IOStats::Record( const Op op, const uint32 fileId, const size_t size, const Duration elapsed )
+{
+    const uint64 ns = (uint64)TicksToNanoSeconds( elapsed );
+
+    std::lock_guard<std::mutex> lock( _lock );
+    ASSERT( fileId < _files.size() );
+
+    File& file = _files[fileId];
+    file.bytes [op] += size;
+    file.ops   [op]++;
+    file.timeNs[op] += ns;
+    file.latency[op].Record( ns );
+}
+
+//-----------------------------------------------------------
+void IOStats::AppendJson( std::string& json, const double reportElapsed )
+{
+    json += R"({"name": )";
+    AppendJsonStr( json, _name.c_str() );
+    AppendF( json, R"(, "queue_depth": %lld, "buffer_wait_s": %.3lf, "files": [)",
+        (long long)std::max( (int64)0, _pending.load( std::memory_order_relaxed ) ),
+        NanoSecondsToSeconds( (double)_bufferWaitNs.load( std::memory_order_relaxed ) ) );
+
+    std::lock_guard<std::mutex> lock( _lock );
+
+    bool firstFile = true;
+    for( File& file : _files )
+    {
+        if( file.ops[Read] == 0 && file.ops[Write] == 0 )
+            continue;
+
+        json += firstFile ? R"({"name": )" : R"(, {"name": )";
+        AppendJsonStr( json, file.name.c_str() );
+        firstFile = false;
+
+        for( uint32 op = Read; op <= Write; op++ )
+        {
+            const LatencyHistogram& latency = file.latency[op];
+            const double            rate    = reportElapsed > 0 ? (double)( file.bytes[op] - file.lastBytes[op] ) / reportElapsed : 0;
+
+            AppendF( json, R"(, "%s": {"bytes": %llu, "ops": %llu, "busy_s": %.3lf, "bytes_per_s": %.0lf, )",
+                op == Read ? "read" : "write", (llu)file.bytes[op], (llu)file.ops[op], NanoSecondsToSeconds( (double)file.timeNs[op] ), rate );
+            AppendF( json, R"("latency_ns": {"mean": %llu, "p50": %llu, "p90": %llu, "p99": %llu, "max": %llu}})",
+                (llu)latency.Mean(), (llu)latency.ValueAtPercentile( 50 ), (llu)latency.ValueAtPercentile( 90 ),
+                (llu)latency.ValueAtPercentile( 99 ), (llu)latency.Max() );
+
+            file.lastBytes[op] = file.bytes[op];
+        }
+
+        json += "}";
+    }
+
+    json += "]}";
+}
+
+//-----------------------------------------------------------
+void IOStats::StartStatusReport( const double intervalSeconds, const char* path )
+{
+    ASSERT( intervalSeconds > 0 );
+
+    auto* params = new IOStatusReportParams{};
+    params->intervalMS = std::max( 1l, (long)( intervalSeconds * 1000.0 ) );
+    params->path       = path ? path : "";
+
+    // Runs until the process exits
+    auto* thread = new Thread();
+    thread->Run( StatusReportMain, params );
+}
+
+//-----------------------------------------------------------
+void IOStats::StatusReportMain( IOStatusReportParams* params )
+{
+    const auto startTime  = TimerBegin();
+    auto       reportTime = startTime;
+
+    std::string json;
+    std::string tmpPath = params->path + ".tmp";
+
+    for( ;; )
+    {
+        Thread::Sleep( params->intervalMS );
+
+        const auto   now           = TimerBegin();
+        const double reportElapsed = TicksToSeconds( now - reportTime );
+        reportTime = now;
+
+        json.clear();
+        AppendF( json, R"({"io_status": {"time_s": %.3lf, "queues": [)", TicksToSeconds( now - startTime ) );
+        {
+            std::lock_guard<std::mutex> lock( _registryLock );
+
+            for( size_t i = 0; i < _registry.size(); i++ )
+            {
+                if( i > 0 )
+                    json += ", ";
+
+                _registry[i]->AppendJson( json, reportElapsed );
+            }
+        }
+        json += "]}}\n";
+
+        // A single write, so that the line is not split by other threads' output
+        if( params->path.empty() )
+        {
+            Log::Write( "%s", json.c_str() );
+            continue;
+        }
+
+        // Replace the file whole, so that readers never see a partial status
+        FILE* file = fopen( tmpPath.c_str(), "wb" );
+        if( !file )
+        {
+            Log::Error( "Warning: Failed to open I/O status file '%s'.", tmpPath.c_str() );
+            continue;
+        }
+
+        const bool written = fwrite( json.data(), 1, json.size(), file ) == json.size();
+        fclose( file );
+
+        std::error_code err;
+        if( written )
+            std::filesystem::rename( tmpPath, params->path, err );
+
+        if( !written || err )
+            Log::Error( "Warning: Failed to write I/O status file '%s'.", params->path.c_str() );
+    }
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include "util/LatencyHistogram.h"
+#include <mutex>
+#include <deque>
+#include <string>
+
+struct IOStatusReportParams;
+
+///
+/// Runtime I/O metrics of a disk queue, kept per file (or file set).
+/// These are always collected, and every live instance is part of
+/// the periodic --io-status report, so that saturated disks can be spotted
+/// while a plot is running.
+///
+class IOStats
+{
+public:
+    IOStats( const char* name );
+    ~IOStats();
+
+    // Returns the id to record the file's I/O with. Safe to call at any time.
+    uint32 AddFile( const char* name );
+
+    void RecordRead ( uint32 fileId, size_t size, Duration elapsed );
+    void RecordWrite( uint32 fileId, size_t size, Duration elapsed );
+
+    // Commands submitted to the queue, but not yet completed
+    inline void AddPending( const int64 count ) { _pending.fetch_add( count, std::memory_order_relaxed ); }
+
+    // Time the user spent blocked waiting for an I/O buffer to be free
+    inline void AddBufferWait( const Duration elapsed )
+    {
+        _bufferWaitNs.fetch_add( (uint64)TicksToNanoSeconds( elapsed ), std::memory_order_relaxed );
+    }
+
+    /// Starts a thread which writes the status of all live IOStats as a single json line every intervalSeconds.
+    /// If path is given, the file is replaced with the latest status each time, instead of writing to stdout.
+    static void StartStatusReport( double intervalSeconds, const char* path );
+
+private:
+    enum Op { Read = 0, Write = 1 };
+
+    struct File
+    {
+        std::string      name;
+        uint64           bytes    [2] = {};
+        uint64           ops      [2] = {};
+        uint64           timeNs   [2] = {};
+        uint64           lastBytes[2] = {};   // At the last status report, for bytes/s
+        LatencyHistogram latency  [2];        // Nanoseconds per operation
+    };
+
+    void Record( Op op, uint32 fileId, size_t size, Duration elapsed );
+    void AppendJson( std::string& json, double reportElapsed );
+
+    static void StatusReportMain( IOStatusReportParams* params );
+
+private:
+    std::string         _name;
+    std::mutex          _lock;                  // Held while recording and reporting
+    std::deque<File>    _files;                 // deque, so that added files never move
+    std::atomic<int64>  _pending      = 0;
+    std::atomic<uint64> _bufferWaitNs = 0;
+};
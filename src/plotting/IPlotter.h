@@ -10,4 +10,7 @@ public:
     virtual void ParseCLI( const GlobalPlotConfig& gCfg, CliParser& cli ) = 0;
     virtual void Init() = 0;
     virtual void Run( const PlotRequest& req ) = 0;
+
+    // Called once after the last plot
+    virtual void Finish() {}
 };
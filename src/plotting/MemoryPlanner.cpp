@@ -0,0 +1,40 @@
+#include "MemoryPlanner.h"
+#include "util/Log.h"
+#include "util/Util.h"
+
+//-----------------------------------------------------------
+bool MemoryPlanner::Fits( const GlobalPlotConfig& cfg, const size_t hostSize, const size_t pinnedSize )
+{
+    if( cfg.maxMemory > 0 && hostSize > cfg.maxMemory )
+        return false;
+    if( cfg.maxPinnedMemory > 0 && pinnedSize > cfg.maxPinnedMemory )
+        return false;
+
+    return true;
+}
+
+//-----------------------------------------------------------
+size_t MemoryPlanner::Remaining( const GlobalPlotConfig& cfg, const size_t usedSize )
+{
+    if( cfg.maxMemory == 0 )
+        return SIZE_MAX;
+
+    return usedSize < cfg.maxMemory ? cfg.maxMemory - usedSize : 0;
+}
+
+//-----------------------------------------------------------
+void MemoryPlanner::ReportPeak( const GlobalPlotConfig& cfg, const size_t hostPeak, const size_t pinnedPeak )
+{
+    if( pinnedPeak > 0 )
+        Log::Line( "Predicted peak memory: %.2lf GiB ( %.2lf GiB pinned )", (double)hostPeak BtoGB, (double)pinnedPeak BtoGB );
+    else
+        Log::Line( "Predicted peak memory: %.2lf GiB", (double)hostPeak BtoGB );
+
+    FatalIf( cfg.maxMemory > 0 && hostPeak > cfg.maxMemory,
+        "The predicted peak memory ( %.2lf GiB ) exceeds --max-memory ( %.2lf GiB ).",
+        (double)hostPeak BtoGB, (double)cfg.maxMemory BtoGB );
+
+    FatalIf( cfg.maxPinnedMemory > 0 && pinnedPeak > cfg.maxPinnedMemory,
+        "The predicted pinned memory ( %.2lf GiB ) exceeds --max-pinned ( %.2lf GiB ).",
+        (double)pinnedPeak BtoGB, (double)cfg.maxPinnedMemory BtoGB );
+}
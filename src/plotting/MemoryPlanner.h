@@ -0,0 +1,22 @@
+#pragma once
+#include "plotting/GlobalPlotConfig.h"
+
+///
+/// Shared handling of the --max-memory and --max-pinned budgets.
+/// The plotters size their own layouts (bucket counts, caches, hybrid modes)
+/// to fit the budget, then report their predicted peak through here.
+///
+struct MemoryPlanner
+{
+    inline static bool HasBudget( const GlobalPlotConfig& cfg ) { return cfg.maxMemory > 0; }
+
+    // Whether the given host and pinned sizes fit the budgets. Always true if no budget was given.
+    static bool Fits( const GlobalPlotConfig& cfg, size_t hostSize, size_t pinnedSize = 0 );
+
+    // Host memory left in the budget after usedSize, or SIZE_MAX if no budget was given.
+    static size_t Remaining( const GlobalPlotConfig& cfg, size_t usedSize );
+
+    // Log the predicted peak memory use. Exits with an error if it does not fit the budgets.
+    // pinnedPeak is the part of hostPeak that is page-locked.
+    static void ReportPeak( const GlobalPlotConfig& cfg, size_t hostPeak, size_t pinnedPeak = 0 );
+};
@@ -0,0 +1,1038 @@
+#include "ParkCoding.h"
+#include "ChiaConsts.h"
+#include "util/Util.h"
+#include "SysHost.h"
+#include <algorithm>
+#include <bit>
+
+#define FSE_STATIC_LINKING_ONLY
+#include "fse/fse.h"
+
+///
+/// Stubs are packed one output field at a time: consecutive stubs are first combined into
+/// units of at least 32 bits, so that each 64-bit field is made up of bits of at most 3 units,
+/// which are gathered and shifted into place without carrying any state from one field to the next.
+/// Unpacking loads the 8 bytes holding each stub, which requires stubs of no more than 57 bits.
+///
+/// The AVX2 and AVX-512 kernels are compiled with function-level target attributes,
+/// and are only called after checking CPU support at runtime.
+/// NEON has no gathers, so it uses the scalar loops, which are branch-free as well.
+///
+
+#if defined( __x86_64__ ) || defined( _M_X64 )
+    #define PARKCODING_X86 1
+    #include <immintrin.h>
+
+    #if defined( _MSC_VER ) && !defined( __clang__ )
+        #include <intrin.h>
+        #define PARKCODING_TARGET( x )
+    #else
+        #define PARKCODING_TARGET( x ) __attribute__((target( x )))
+    #endif
+#elif defined( __aarch64__ ) || defined( _M_ARM64 )
+    #define PARKCODING_NEON 1
+    #include <arm_neon.h>
+#endif
+
+static constexpr uint32 MaxStubBits = 57;
+
+enum class ParkCodingSimd
+{
+    None = 0,
+    AVX2,
+    AVX512
+};
+
+//-----------------------------------------------------------
+static ParkCodingSimd GetParkCodingSimd()
+{
+#if PARKCODING_X86
+    if( SysHost::HasCpuFeatures( CpuFeatures::AVX512F | CpuFeatures::AVX512BW ) )
+        return ParkCodingSimd::AVX512;
+    if( SysHost::HasCpuFeatures( CpuFeatures::AVX2 ) )
+        return ParkCodingSimd::AVX2;
+#endif
+    return ParkCodingSimd::None;
+}
+
+static ParkCodingSimd _maxSimd = ParkCodingSimd::AVX512;    // See SetParkCodingMaxSimd
+
+//-----------------------------------------------------------
+inline static ParkCodingSimd ParkCodingSimdLevel()
+{
+    static const ParkCodingSimd simd = GetParkCodingSimd();
+    return std::min( simd, _maxSimd );
+}
+
+//-----------------------------------------------------------
+void SetParkCodingMaxSimd( const uint32 level )
+{
+    _maxSimd = (ParkCodingSimd)std::min( level, (uint32)ParkCodingSimd::AVX512 );
+}
+
+//-----------------------------------------------------------
+inline static uint64 LoadBE64( const byte* src )
+{
+    uint64 v;
+    memcpy( &v, src, sizeof( v ) );
+    return Swap64( v );
+}
+
+/// Combines groups of consecutive stubs into units of unitBits = stubsPerUnit * bitSize bits, MSB-first.
+/// The last unit is padded with zero stubs, and 2 zero units are appended after it,
+/// so that fields can always read the 3 units that may overlap them.
+/// Returns the unit count, not including the padding units.
+//-----------------------------------------------------------
+static uint64 BuildStubUnits( const uint64* values, const uint64 count, const uint32 bitSize, uint64* units, uint32& outUnitBits )
+{
+    const uint32 stubsPerUnit = bitSize >= 32 ? 1 : CDiv( 32u, bitSize );
+    const uint64 mask         = ( 1ull << bitSize ) - 1;
+    const uint64 unitCount    = CDiv( count, (uint64)stubsPerUnit );
+    const uint64 fullUnits    = count / stubsPerUnit;
+
+    outUnitBits = stubsPerUnit * bitSize;
+
+    if( stubsPerUnit == 1 )
+    {
+        for( uint64 i = 0; i < count; i++ )
+            units[i] = values[i] & mask;
+    }
+    else if( stubsPerUnit == 2 )
+    {
+        for( uint64 i = 0; i < fullUnits; i++ )
+            units[i] = ( ( values[i*2] & mask ) << bitSize ) | ( values[i*2+1] & mask );
+    }
+    else
+    {
+        for( uint64 i = 0; i < fullUnits; i++ )
+        {
+            const uint64* stubs = values + i * stubsPerUnit;
+
+            uint64 unit = 0;
+            for( uint32 j = 0; j < stubsPerUnit; j++ )
+                unit = ( unit << bitSize ) | ( stubs[j] & mask );
+
+            units[i] = unit;
+        }
+    }
+
+    if( fullUnits < unitCount )
+    {
+        uint64 unit = 0;
+        for( uint64 i = fullUnits * stubsPerUnit; i < count; i++ )
+            unit = ( unit << bitSize ) | ( values[i] & mask );
+
+        units[fullUnits] = unit << ( ( unitCount * stubsPerUnit - count ) * bitSize );
+    }
+
+    units[unitCount]   = 0;
+    units[unitCount+1] = 0;
+
+    return unitCount;
+}
+
+/// Field f starts at bit 64f. With that bit in unit i at offset o, the field is made of
+/// the bits of unit i after o, then unit i+1, then the leading bits of unit i+2.
+/// i = 64f / unitBits is computed as ( 64f * unitRcp ) >> 32, with unitRcp = 2^32 / unitBits + 1,
+/// which is exact for the bit offsets of a park.
+//-----------------------------------------------------------
+static void PackFieldsScalar( const uint64* units, const uint32 unitBits, const uint64 unitRcp,
+                              uint64 fieldStart, const uint64 fieldEnd, uint64* fields )
+{
+    for( uint64 f = fieldStart; f < fieldEnd; f++ )
+    {
+        const uint64 bit = f * 64;
+        const uint64 u   = ( bit * unitRcp ) >> 32;
+        const int64  o   = (int64)( bit - u * unitBits );
+
+        const int64 s0 = 64 - (int64)unitBits + o;          // [1, 63]
+        const int64 s1 = 64 - (int64)unitBits * 2 + o;      // [-62, 63]
+        const int64 s2 = (int64)unitBits * 3 - 64 - o;      // Right shift: [1, 125]
+
+        uint64 field = units[u] << s0;
+        field |= s1 >= 0 ? units[u+1] << s1 : units[u+1] >> -s1;
+        field |= s2 < 64 ? units[u+2] >> s2 : 0;
+
+        fields[f] = Swap64( field );
+    }
+}
+
+//-----------------------------------------------------------
+inline static void UnpackStubsScalar( const byte* src, uint64 i, const uint64 count, const uint32 bitSize, uint64* stubs )
+{
+    const uint64 byteCount = CDiv( count * bitSize, 8 );
+    const uint32 rshift    = 64 - bitSize;
+
+    uint64 bit = i * bitSize;
+
+    // Whole 8-byte loads
+    for( ; i < count && ( bit >> 3 ) + 8 <= byteCount; i++, bit += bitSize )
+        stubs[i] = ( LoadBE64( src + ( bit >> 3 ) ) << ( bit & 7 ) ) >> rshift;
+
+    // The last stubs are read without going past the end of src
+    for( ; i < count; i++, bit += bitSize )
+    {
+        byte tmp[8] = {};
+        memcpy( tmp, src + ( bit >> 3 ), (size_t)( byteCount - ( bit >> 3 ) ) );
+
+        stubs[i] = ( LoadBE64( tmp ) << ( bit & 7 ) ) >> rshift;
+    }
+}
+
+#if PARKCODING_X86
+
+//-----------------------------------------------------------
+PARKCODING_TARGET( "avx2" )
+static uint64 PackFieldsAVX2( const uint64* units, const uint32 unitBits, const uint64 unitRcp, const uint64 fieldCount, uint64* fields )
+{
+    const uint64  simdCount = fieldCount / 4 * 4;
+    const __m256i rcp       = _mm256_set1_epi64x( (int64)unitRcp );
+    const __m256i vUnitBits = _mm256_set1_epi64x( unitBits );
+    const __m256i shift0    = _mm256_set1_epi64x( 64 - (int64)unitBits );
+    const __m256i shift1    = _mm256_set1_epi64x( 64 - (int64)unitBits * 2 );
+    const __m256i shift2    = _mm256_set1_epi64x( (int64)unitBits * 3 - 64 );
+    const __m256i bswap     = _mm256_setr_epi8( 7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+                                                7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8 );
+    const __m256i zero      = _mm256_setzero_si256();
+
+    __m256i bit = _mm256_setr_epi64x( 0, 64, 128, 192 );
+    const __m256i bitStep = _mm256_set1_epi64x( 256 );
+
+    for( uint64 f = 0; f < simdCount; f += 4, bit = _mm256_add_epi64( bit, bitStep ) )
+    {
+        // Bit offsets are < 2^32, so mul_epu32 sees all of their bits
+        const __m256i u = _mm256_srli_epi64( _mm256_mul_epu32( bit, rcp ), 32 );
+        const __m256i o = _mm256_sub_epi64( bit, _mm256_mul_epu32( u, vUnitBits ) );
+
+        const __m256i u0 = _mm256_i64gather_epi64( (const long long*)units    , u, 8 );
+        const __m256i u1 = _mm256_i64gather_epi64( (const long long*)units + 1, u, 8 );
+        const __m256i u2 = _mm256_i64gather_epi64( (const long long*)units + 2, u, 8 );
+
+        // Shift counts of 64 or more give 0, so negative left shifts are done as right shifts instead
+        const __m256i s1 = _mm256_add_epi64( shift1, o );
+
+        __m256i field = _mm256_sllv_epi64( u0, _mm256_add_epi64( shift0, o ) );
+        field = _mm256_or_si256( field, _mm256_sllv_epi64( u1, s1 ) );
+        field = _mm256_or_si256( field, _mm256_srlv_epi64( u1, _mm256_sub_epi64( zero, s1 ) ) );
+        field = _mm256_or_si256( field, _mm256_srlv_epi64( u2, _mm256_sub_epi64( shift2, o ) ) );
+
+        _mm256_storeu_si256( (__m256i*)( fields + f ), _mm256_shuffle_epi8( field, bswap ) );
+    }
+
+    return simdCount;
+}
+
+//-----------------------------------------------------------
+PARKCODING_TARGET( "avx2" )
+static uint64 UnpackStubsAVX2( const byte* src, const uint64 count, const uint32 bitSize, uint64* stubs )
+{
+    // Only stubs whose 8-byte load ends within the stub bytes are unpacked here
+    const uint64 byteCount = CDiv( count * bitSize, 8 );
+    if( byteCount < 8 )
+        return 0;
+
+    const uint64 simdCount = std::min( count, ( ( byteCount - 8 ) * 8 ) / bitSize + 1 ) / 4 * 4;
+
+    const __m256i bswap  = _mm256_setr_epi8( 7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+                                             7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8 );
+    const __m256i seven  = _mm256_set1_epi64x( 7 );
+    const __m256i rshift = _mm256_set1_epi64x( 64 - bitSize );
+    const __m256i step   = _mm256_set1_epi64x( (int64)bitSize * 4 );
+
+    __m256i bit = _mm256_setr_epi64x( 0, bitSize, (int64)bitSize * 2, (int64)bitSize * 3 );
+
+    for( uint64 i = 0; i < simdCount; i += 4, bit = _mm256_add_epi64( bit, step ) )
+    {
+        const __m256i v = _mm256_shuffle_epi8(
+            _mm256_i64gather_epi64( (const long long*)src, _mm256_srli_epi64( bit, 3 ), 1 ), bswap );
+
+        const __m256i stub = _mm256_srlv_epi64( _mm256_sllv_epi64( v, _mm256_and_si256( bit, seven ) ), rshift );
+        _mm256_storeu_si256( (__m256i*)( stubs + i ), stub );
+    }
+
+    return simdCount;
+}
+
+// GCC 12's AVX-512 intrinsics leave their unused pass-through operand uninitialized, which it then warns about
+#pragma GCC diagnostic push
+#if !defined( __clang__ )
+    #pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+//-----------------------------------------------------------
+PARKCODING_TARGET( "avx512f,avx512bw" )
+static uint64 UnpackStubsAVX512( const byte* src, const uint64 count, const uint32 bitSize, uint64* stubs )
+{
+    const uint64 byteCount = CDiv( count * bitSize, 8 );
+    if( byteCount < 8 )
+        return 0;
+
+    const uint64 simdCount = std::min( count, ( ( byteCount - 8 ) * 8 ) / bitSize + 1 ) / 8 * 8;
+
+    const __m512i bswap  = _mm512_set_epi64( 0x08090A0B0C0D0E0Full, 0x0001020304050607ull,
+                                             0x08090A0B0C0D0E0Full, 0x0001020304050607ull,
+                                             0x08090A0B0C0D0E0Full, 0x0001020304050607ull,
+                                             0x08090A0B0C0D0E0Full, 0x0001020304050607ull );
+    const __m512i seven  = _mm512_set1_epi64( 7 );
+    const __m512i rshift = _mm512_set1_epi64( 64 - bitSize );
+    const __m512i step   = _mm512_set1_epi64( (int64)bitSize * 8 );
+
+    const int64 w = bitSize;
+    __m512i bit = _mm512_set_epi64( w * 7, w * 6, w * 5, w * 4, w * 3, w * 2, w, 0 );
+
+    for( uint64 i = 0; i < simdCount; i += 8, bit = _mm512_add_epi64( bit, step ) )
+    {
+        const __m512i v = _mm512_shuffle_epi8(
+            _mm512_i64gather_epi64( _mm512_srli_epi64( bit, 3 ), (const void*)src, 1 ), bswap );
+
+        const __m512i stub = _mm512_srlv_epi64( _mm512_sllv_epi64( v, _mm512_and_si512( bit, seven ) ), rshift );
+        _mm512_storeu_si512( (void*)( stubs + i ), stub );
+    }
+
+    return simdCount;
+}
+
+#pragma GCC diagnostic pop
+
+#endif // PARKCODING_X86
+
+//-----------------------------------------------------------
+uint64* PackStubs( const uint64* values, const uint64 count, const uint32 bitSize, uint64* fields )
+{
+    ASSERT( count <= kEntriesPerPark );
+    ASSERT( bitSize > 0 && bitSize <= MaxStubBits );
+
+    const uint64 fieldCount = CDiv( count * bitSize, 64 );
+    if( fieldCount == 0 )
+        return fields;
+
+    uint64 units[kEntriesPerPark + 2];
+    uint32 unitBits   = 0;
+    BuildStubUnits( values, count, bitSize, units, unitBits );
+
+    const uint64 unitRcp = ( 1ull << 32 ) / unitBits + 1;
+    uint64 f = 0;
+
+#if PARKCODING_X86
+    if( ParkCodingSimdLevel() != ParkCodingSimd::None )
+        f = PackFieldsAVX2( units, unitBits, unitRcp, fieldCount, fields );
+#endif
+
+    PackFieldsScalar( units, unitBits, unitRcp, f, fieldCount, fields );
+
+    return fields + fieldCount;
+}
+
+//-----------------------------------------------------------
+void UnpackStubs( const byte* src, const uint64 count, const uint32 bitSize, uint64* stubs )
+{
+    ASSERT( bitSize > 0 && bitSize <= MaxStubBits );
+
+    uint64 i = 0;
+
+#if PARKCODING_X86
+    switch( ParkCodingSimdLevel() )
+    {
+        case ParkCodingSimd::AVX512: i = UnpackStubsAVX512( src, count, bitSize, stubs ); break;
+        case ParkCodingSimd::AVX2  : i = UnpackStubsAVX2  ( src, count, bitSize, stubs ); break;
+        default: break;
+    }
+#endif
+
+    UnpackStubsScalar( src, i, count, bitSize, stubs );
+}
+
+
+///
+/// Interleaved FSE decoding.
+/// Each stream is decoded exactly like FSE_decompress_usingDTable_generic in fse_decompress.c,
+/// 4 symbols per step while the bit stream is unfinished, then symbol by symbol until it is completed.
+/// The main loop steps both streams, then whichever stream remains finishes on its own.
+///
+struct FSEStreamState
+{
+    BIT_DStream_t bitD;
+    FSE_DState_t  state1;
+    FSE_DState_t  state2;
+    byte*         ostart;
+    byte*         op;
+    byte*         omax;
+    byte*         olimit;
+};
+
+// The main loop reloads once per 4 symbols
+static_assert( sizeof( size_t ) == 8 && FSE_MAX_TABLELOG * 4 + 7 <= 64 );
+
+//-----------------------------------------------------------
+template<bool Fast>
+inline static byte FSEDecodeSymbol( FSE_DState_t* state, BIT_DStream_t* bitD )
+{
+    return Fast ? FSE_decodeSymbolFast( state, bitD ) : FSE_decodeSymbol( state, bitD );
+}
+
+//-----------------------------------------------------------
+template<bool Fast>
+inline static bool FSEDecodeStep( FSEStreamState& s )
+{
+    if( !( ( BIT_reloadDStream( &s.bitD ) == BIT_DStream_unfinished ) & ( s.op < s.olimit ) ) )
+        return false;
+
+    s.op[0] = FSEDecodeSymbol<Fast>( &s.state1, &s.bitD );
+    s.op[1] = FSEDecodeSymbol<Fast>( &s.state2, &s.bitD );
+    s.op[2] = FSEDecodeSymbol<Fast>( &s.state1, &s.bitD );
+    s.op[3] = FSEDecodeSymbol<Fast>( &s.state2, &s.bitD );
+    s.op += 4;
+
+    return true;
+}
+
+//-----------------------------------------------------------
+template<bool Fast>
+static size_t FSEDecodeTail( FSEStreamState& s )
+{
+    for( ;; )
+    {
+        if( s.op > s.omax - 2 )
+            return (size_t)-FSE_error_dstSize_tooSmall;
+
+        *s.op++ = FSEDecodeSymbol<Fast>( &s.state1, &s.bitD );
+        if( BIT_reloadDStream( &s.bitD ) == BIT_DStream_overflow )
+        {
+            *s.op++ = FSEDecodeSymbol<Fast>( &s.state2, &s.bitD );
+            break;
+        }
+
+        if( s.op > s.omax - 2 )
+            return (size_t)-FSE_error_dstSize_tooSmall;
+
+        *s.op++ = FSEDecodeSymbol<Fast>( &s.state2, &s.bitD );
+        if( BIT_reloadDStream( &s.bitD ) == BIT_DStream_overflow )
+        {
+            *s.op++ = FSEDecodeSymbol<Fast>( &s.state1, &s.bitD );
+            break;
+        }
+    }
+
+    return (size_t)( s.op - s.ostart );
+}
+
+//-----------------------------------------------------------
+template<uint32 N, bool Fast>
+static void FSEDecompressStreams( const FSE_DTable* dTable,
+                                  byte* const dst[], const size_t dstCapacity[],
+                                  const byte* const src[], const size_t srcSize[],
+                                  size_t outSizes[] )
+{
+    FSEStreamState streams[N];
+    bool           live[N];
+    bool           valid[N];
+    bool           allLive = true;
+
+    for( uint32 i = 0; i < N; i++ )
+    {
+        FSEStreamState& s = streams[i];
+
+        s.ostart = s.op = dst[i];
+        s.omax   = s.ostart + dstCapacity[i];
+        s.olimit = s.omax - 3;
+
+        outSizes[i] = BIT_initDStream( &s.bitD, src[i], srcSize[i] );
+        valid[i]    = live[i] = !FSE_isError( outSizes[i] );
+        allLive    &= live[i];
+
+        if( live[i] )
+        {
+            FSE_initDState( &s.state1, &s.bitD, dTable );
+            FSE_initDState( &s.state2, &s.bitD, dTable );
+        }
+    }
+
+    while( allLive )
+    {
+        for( uint32 i = 0; i < N; i++ )
+        {
+            live[i]  = FSEDecodeStep<Fast>( streams[i] );
+            allLive &= live[i];
+        }
+    }
+
+    for( uint32 i = 0; i < N; i++ )
+    {
+        while( live[i] )
+            live[i] = FSEDecodeStep<Fast>( streams[i] );
+
+        if( valid[i] )
+            outSizes[i] = FSEDecodeTail<Fast>( streams[i] );
+    }
+}
+
+//-----------------------------------------------------------
+template<uint32 N>
+inline static void FSEDecompressStreams( const FSE_DTable* dTable,
+                                         byte* const dst[], const size_t dstCapacity[],
+                                         const byte* const src[], const size_t srcSize[],
+                                         size_t outSizes[] )
+{
+    const FSE_DTableHeader* header = (const FSE_DTableHeader*)(const void*)dTable;
+
+    if( header->fastMode )
+        FSEDecompressStreams<N, true>( dTable, dst, dstCapacity, src, srcSize, outSizes );
+    else
+        FSEDecompressStreams<N, false>( dTable, dst, dstCapacity, src, srcSize, outSizes );
+}
+
+//-----------------------------------------------------------
+void FSEDecompressX2( const FSE_DTable* dTable,
+                      byte* const dst[2], const size_t dstCapacity[2],
+                      const byte* const src[2], const size_t srcSize[2],
+                      size_t outSizes[2] )
+{
+    FSEDecompressStreams<2>( dTable, dst, dstCapacity, src, srcSize, outSizes );
+}
+
+//-----------------------------------------------------------
+size_t CompressInterleavedDeltas( byte* dst, const byte* deltas, const size_t count, const FSE_CTable* cTable )
+{
+    ASSERT( count <= kEntriesPerPark - 1 );
+
+    byte* writer = dst + ParkDeltaStreamCount * sizeof( uint16 );
+
+    for( uint32 i = 0; i < ParkDeltaStreamCount; i++ )
+    {
+        const size_t start       = std::min( count, (size_t)i * ParkDeltaStreamEntries );
+        const size_t streamCount = std::min( count - start, (size_t)ParkDeltaStreamEntries );
+
+        // Give it enough room to use the fast path, it writes no more than 8 bytes past the stream
+        size_t streamSize = streamCount == 0 ? 0 :
+            FSE_compress_usingCTable( writer, FSE_compressBound( streamCount ), deltas + start, streamCount, cTable );
+
+        uint16 sizeField = (uint16)streamSize;
+
+        if( streamSize == 0 && streamCount > 0 )
+        {
+            // Not compressible (or too short for FSE), store it raw
+            streamSize = streamCount;
+            sizeField  = (uint16)( streamCount | 0x8000 );
+            memcpy( writer, deltas + start, streamCount );
+        }
+
+        memcpy( dst + i * sizeof( uint16 ), &sizeField, sizeof( uint16 ) );
+        writer += streamSize;
+    }
+
+    return (size_t)( writer - dst );
+}
+
+//-----------------------------------------------------------
+size_t DecompressInterleavedDeltas( byte* dst, const size_t dstCapacity, const byte* src, const size_t srcSize, const FSE_DTable* dTable )
+{
+    if( srcSize < ParkDeltaStreamCount * sizeof( uint16 ) )
+        return (size_t)-FSE_error_srcSize_wrong;
+
+    byte*       fseDst     [ParkDeltaStreamCount];
+    size_t      fseCapacity[ParkDeltaStreamCount];
+    const byte* fseSrc     [ParkDeltaStreamCount];
+    size_t      fseSrcSize [ParkDeltaStreamCount];
+    size_t      fseOut     [ParkDeltaStreamCount];
+    uint32      fseStream  [ParkDeltaStreamCount];
+    uint32      fseCount = 0;
+
+    size_t streamCounts[ParkDeltaStreamCount] = {};
+    size_t offset = ParkDeltaStreamCount * sizeof( uint16 );
+
+    for( uint32 i = 0; i < ParkDeltaStreamCount; i++ )
+    {
+        uint16 sizeField;
+        memcpy( &sizeField, src + i * sizeof( uint16 ), sizeof( uint16 ) );
+
+        const size_t streamSize = sizeField & 0x7FFF;
+        const size_t start      = std::min( dstCapacity, (size_t)i * ParkDeltaStreamEntries );
+        const size_t capacity   = std::min( dstCapacity - start, (size_t)ParkDeltaStreamEntries );
+
+        if( offset + streamSize > srcSize )
+            return (size_t)-FSE_error_srcSize_wrong;
+
+        if( sizeField & 0x8000 )
+        {
+            if( streamSize > capacity )
+                return (size_t)-FSE_error_dstSize_tooSmall;
+
+            memcpy( dst + start, src + offset, streamSize );
+            streamCounts[i] = streamSize;
+        }
+        else if( streamSize > 0 )
+        {
+            fseDst     [fseCount] = dst + start;
+            fseCapacity[fseCount] = capacity;
+            fseSrc     [fseCount] = src + offset;
+            fseSrcSize [fseCount] = streamSize;
+            fseStream  [fseCount] = i;
+            fseCount++;
+        }
+
+        offset += streamSize;
+    }
+
+    static_assert( ParkDeltaStreamCount == 4 );
+    switch( fseCount )
+    {
+        case 4: FSEDecompressStreams<4>( dTable, fseDst, fseCapacity, fseSrc, fseSrcSize, fseOut ); break;
+        case 3: FSEDecompressStreams<3>( dTable, fseDst, fseCapacity, fseSrc, fseSrcSize, fseOut ); break;
+        case 2: FSEDecompressStreams<2>( dTable, fseDst, fseCapacity, fseSrc, fseSrcSize, fseOut ); break;
+        case 1: FSEDecompressStreams<1>( dTable, fseDst, fseCapacity, fseSrc, fseSrcSize, fseOut ); break;
+        default: break;
+    }
+
+    for( uint32 i = 0; i < fseCount; i++ )
+    {
+        if( FSE_isError( fseOut[i] ) )
+            return fseOut[i];
+
+        streamCounts[fseStream[i]] = fseOut[i];
+    }
+
+    // Streams are filled in order, so only the last non-empty one may be partial
+    size_t total = 0;
+    for( uint32 i = 0; i < ParkDeltaStreamCount; i++ )
+    {
+        if( streamCounts[i] > 0 && total != (size_t)i * ParkDeltaStreamEntries )
+            return (size_t)-FSE_error_corruption_detected;
+
+        total += streamCounts[i];
+    }
+
+    return total;
+}
+
+
+///
+/// C3 lookups.
+/// The f7 deltas are decoded C3BlockSize at a time, then summed in 16-bit lanes, which can't overflow
+/// since valid deltas are below 0xFF. Within a block, a target is located by counting the sums below
+/// and equal to its distance from the block's base f7. Decoding stops once the f7s pass the last target.
+/// SSE2 and NEON are part of the baseline of their architectures, so no runtime check is needed.
+///
+static constexpr uint32 C3BlockSize = 16;
+
+//-----------------------------------------------------------
+inline static void C3PrefixSums( const byte deltas[C3BlockSize], uint16 sums[C3BlockSize] )
+{
+#if PARKCODING_X86
+    const __m128i d    = _mm_loadu_si128( (const __m128i*)deltas );
+    const __m128i zero = _mm_setzero_si128();
+
+    __m128i lo = _mm_unpacklo_epi8( d, zero );
+    __m128i hi = _mm_unpackhi_epi8( d, zero );
+
+    lo = _mm_add_epi16( lo, _mm_slli_si128( lo, 2 ) );
+    hi = _mm_add_epi16( hi, _mm_slli_si128( hi, 2 ) );
+    lo = _mm_add_epi16( lo, _mm_slli_si128( lo, 4 ) );
+    hi = _mm_add_epi16( hi, _mm_slli_si128( hi, 4 ) );
+    lo = _mm_add_epi16( lo, _mm_slli_si128( lo, 8 ) );
+    hi = _mm_add_epi16( hi, _mm_slli_si128( hi, 8 ) );
+
+    // Carry the low half's total into the high half
+    const __m128i carry = _mm_shufflehi_epi16( lo, 0xFF );
+    hi = _mm_add_epi16( hi, _mm_unpackhi_epi64( carry, carry ) );
+
+    _mm_storeu_si128( (__m128i*)sums      , lo );
+    _mm_storeu_si128( (__m128i*)( sums+8 ), hi );
+#elif PARKCODING_NEON
+    const uint8x16_t d    = vld1q_u8( deltas );
+    const uint16x8_t zero = vdupq_n_u16( 0 );
+
+    uint16x8_t lo = vmovl_u8( vget_low_u8 ( d ) );
+    uint16x8_t hi = vmovl_u8( vget_high_u8( d ) );
+
+    lo = vaddq_u16( lo, vextq_u16( zero, lo, 7 ) );
+    hi = vaddq_u16( hi, vextq_u16( zero, hi, 7 ) );
+    lo = vaddq_u16( lo, vextq_u16( zero, lo, 6 ) );
+    hi = vaddq_u16( hi, vextq_u16( zero, hi, 6 ) );
+    lo = vaddq_u16( lo, vextq_u16( zero, lo, 4 ) );
+    hi = vaddq_u16( hi, vextq_u16( zero, hi, 4 ) );
+
+    hi = vaddq_u16( hi, vdupq_n_u16( vgetq_lane_u16( lo, 7 ) ) );
+
+    vst1q_u16( sums  , lo );
+    vst1q_u16( sums+8, hi );
+#else
+    uint16 sum = 0;
+    for( uint32 i = 0; i < C3BlockSize; i++ )
+        sums[i] = sum = (uint16)( sum + deltas[i] );
+#endif
+}
+
+/// Counts the sums below and equal to key. Sums are non-decreasing, so those are consecutive.
+//-----------------------------------------------------------
+inline static void C3CountSums( const uint16 sums[C3BlockSize], const uint16 key, uint32& outBelow, uint32& outEqual )
+{
+#if PARKCODING_X86
+    // Sums and key are < 0x8000, so signed compares work
+    const __m128i k  = _mm_set1_epi16( (short)key );
+    const __m128i lo = _mm_loadu_si128( (const __m128i*)sums );
+    const __m128i hi = _mm_loadu_si128( (const __m128i*)( sums+8 ) );
+
+    const uint32 below = (uint32)_mm_movemask_epi8( _mm_cmplt_epi16( lo, k ) ) | ( (uint32)_mm_movemask_epi8( _mm_cmplt_epi16( hi, k ) ) << 16 );
+    const uint32 equal = (uint32)_mm_movemask_epi8( _mm_cmpeq_epi16( lo, k ) ) | ( (uint32)_mm_movemask_epi8( _mm_cmpeq_epi16( hi, k ) ) << 16 );
+
+    // 2 mask bits per lane
+    outBelow = (uint32)std::popcount( below ) / 2;
+    outEqual = (uint32)std::popcount( equal ) / 2;
+#elif PARKCODING_NEON
+    const uint16x8_t k  = vdupq_n_u16( key );
+    const uint16x8_t lo = vld1q_u16( sums   );
+    const uint16x8_t hi = vld1q_u16( sums+8 );
+
+    outBelow = vaddvq_u16( vshrq_n_u16( vcltq_u16( lo, k ), 15 ) ) + vaddvq_u16( vshrq_n_u16( vcltq_u16( hi, k ), 15 ) );
+    outEqual = vaddvq_u16( vshrq_n_u16( vceqq_u16( lo, k ), 15 ) ) + vaddvq_u16( vshrq_n_u16( vceqq_u16( hi, k ), 15 ) );
+#else
+    outBelow = outEqual = 0;
+    for( uint32 i = 0; i < C3BlockSize; i++ )
+    {
+        outBelow += sums[i] <  key ? 1 : 0;
+        outEqual += sums[i] == key ? 1 : 0;
+    }
+#endif
+}
+
+//-----------------------------------------------------------
+template<bool Fast>
+static size_t FindC3ParkF7s( const FSE_DTable* dTable, const byte* src, const size_t srcSize, const uint64 c1,
+                             const uint64* targets, const uint32 targetCount, uint64* outFirst, uint64* outCounts )
+{
+    // Same capacity ReadC3Park gives FSE_decompress_usingDTable, plus room to pad the last block
+    byte deltas[kCheckpoint1Interval + C3BlockSize];
+
+    FSEStreamState s;
+    s.ostart = s.op = deltas;
+    s.omax   = deltas + kCheckpoint1Interval;
+    s.olimit = s.omax - 3;
+
+    const size_t initResult = BIT_initDStream( &s.bitD, src, srcSize );
+    if( FSE_isError( initResult ) )
+        return initResult;
+
+    FSE_initDState( &s.state1, &s.bitD, dTable );
+    FSE_initDState( &s.state2, &s.bitD, dTable );
+
+    for( uint32 i = 0; i < targetCount; i++ )
+        outFirst[i] = outCounts[i] = 0;
+
+    // c1 is the park's first f7
+    uint32 t = 0;
+    while( t < targetCount && targets[t] < c1 )
+        t++;
+
+    if( t < targetCount && targets[t] == c1 )
+        outCounts[t] = 1;
+
+    uint64 base      = c1;      // Last f7 visited
+    size_t index     = 1;       // Index of the next f7 in the park
+    bool   streamEnd = false;
+
+    while( t < targetCount )
+    {
+        byte* block = deltas + index - 1;
+
+        while( !streamEnd && s.op - block < (ptrdiff_t)C3BlockSize )
+        {
+            if( !FSEDecodeStep<Fast>( s ) )
+            {
+                const size_t size = FSEDecodeTail<Fast>( s );
+                if( FSE_isError( size ) )
+                    return size;
+
+                streamEnd = true;
+            }
+        }
+
+        const uint32 n = (uint32)std::min( s.op - block, (ptrdiff_t)C3BlockSize );
+        if( n == 0 )
+            break;
+
+        if( memchr( block, 0xFF, n ) )
+            return (size_t)-FSE_error_corruption_detected;
+
+        // Pad the last block with sums past any target
+        if( n < C3BlockSize )
+            memset( block + n, 0xFF, C3BlockSize - n );
+
+        uint16 sums[C3BlockSize];
+        C3PrefixSums( block, sums );
+
+        const uint64 last = base + sums[n-1];
+
+        while( t < targetCount && targets[t] <= last )
+        {
+            ASSERT( targets[t] >= base );
+
+            uint32 below, equal;
+            C3CountSums( sums, (uint16)( targets[t] - base ), below, equal );
+
+            if( equal && outCounts[t] == 0 )
+                outFirst[t] = index + below;
+
+            outCounts[t] += equal;
+
+            // The target's run may go on in the next block
+            if( below + equal == n )
+                break;
+
+            t++;
+        }
+
+        base   = last;
+        index += n;
+    }
+
+    return index;
+}
+
+//-----------------------------------------------------------
+size_t FindC3ParkF7s( const FSE_DTable* dTable, const byte* src, const size_t srcSize, const uint64 c1,
+                      const uint64* targets, const uint32 targetCount, uint64* outFirst, uint64* outCounts )
+{
+    const FSE_DTableHeader* header = (const FSE_DTableHeader*)(const void*)dTable;
+
+    if( header->fastMode )
+        return FindC3ParkF7s<true>( dTable, src, srcSize, c1, targets, targetCount, outFirst, outCounts );
+    else
+        return FindC3ParkF7s<false>( dTable, src, srcSize, c1, targets, targetCount, outFirst, outCounts );
+}
+
+
+///
+/// rANS decoding.
+/// Each group of RANSLaneCount symbols is decoded a vector of lanes at a time: the slot, frequency and bias
+/// of every lane are gathered from the table, then the lanes that fell below RANSStateLow read their next word,
+/// in lane order, by expanding the words at the read position into them.
+/// The vector loops stop once fewer than RANSLaneCount words remain, so that their loads stay within the stream,
+/// and the scalar loop decodes whatever is left, one symbol at a time.
+///
+
+//-----------------------------------------------------------
+inline static uint32 LoadLE32( const byte* src )
+{
+    return (uint32)src[0] | ( (uint32)src[1] << 8 ) | ( (uint32)src[2] << 16 ) | ( (uint32)src[3] << 24 );
+}
+
+//-----------------------------------------------------------
+inline static uint32 LoadLE16( const byte* src )
+{
+    return (uint32)src[0] | ( (uint32)src[1] << 8 );
+}
+
+#if PARKCODING_X86
+
+// Permutations that move the first n words of a vector into the n lanes set in a mask, in order
+struct RANSExpandLUT
+{
+    alignas( 32 ) uint32 lanes[256][8];
+
+    constexpr RANSExpandLUT() : lanes{}
+    {
+        for( uint32 mask = 0; mask < 256; mask++ )
+        {
+            uint32 n = 0;
+            for( uint32 lane = 0; lane < 8; lane++ )
+            {
+                if( mask & ( 1u << lane ) )
+                    lanes[mask][lane] = n++;
+            }
+        }
+    }
+};
+
+static constexpr RANSExpandLUT RANSExpand = RANSExpandLUT();
+
+//-----------------------------------------------------------
+PARKCODING_TARGET( "avx2,popcnt" )
+static uint32 RANSDecodeAVX2( byte* dst, const uint32 count, uint32 states[RANSLaneCount],
+                              const byte*& words, const byte* wordsEnd, const RANSDecTable& table )
+{
+    constexpr uint32 Vectors = RANSLaneCount / 8;
+
+    const __m256i slotMask = _mm256_set1_epi32( ( 1 << RANSScaleBits ) - 1 );
+    const __m256i lowMask  = _mm256_set1_epi32( 0xFFFF );
+    const __m256i byteMask = _mm256_set1_epi32( 0xFF );
+    const __m256i zero     = _mm256_setzero_si256();
+    const __m256i packPerm = _mm256_setr_epi32( 0, 4, 1, 5, 2, 6, 3, 7 );
+
+    const int* slots   = (const int*)table.slots;
+    const int* symbols = (const int*)table.symbols;
+
+    __m256i x[Vectors];
+    for( uint32 v = 0; v < Vectors; v++ )
+        x[v] = _mm256_loadu_si256( (const __m256i*)( states + v * 8 ) );
+
+    const byte* in = words;
+    uint32      i  = 0;
+
+    for( ; i + RANSLaneCount <= count && wordsEnd - in >= (ptrdiff_t)( RANSLaneCount * sizeof( uint16 ) ); i += RANSLaneCount )
+    {
+        __m256i sym[Vectors];
+
+        for( uint32 v = 0; v < Vectors; v++ )
+        {
+            const __m256i slot  = _mm256_and_si256( x[v], slotMask );
+            const __m256i entry = _mm256_i32gather_epi32( slots, slot, 4 );
+
+            sym[v] = _mm256_and_si256( _mm256_i32gather_epi32( symbols, slot, 1 ), byteMask );
+            x[v]   = _mm256_add_epi32( _mm256_mullo_epi32( _mm256_srli_epi32( entry, 16 ), _mm256_srli_epi32( x[v], RANSScaleBits ) ),
+                                       _mm256_and_si256( entry, lowMask ) );
+        }
+
+        for( uint32 v = 0; v < Vectors; v++ )
+        {
+            const __m256i renorm = _mm256_cmpeq_epi32( _mm256_srli_epi32( x[v], 16 ), zero );
+            const uint32  mask   = (uint32)_mm256_movemask_ps( _mm256_castsi256_ps( renorm ) );
+
+            const __m256i w = _mm256_permutevar8x32_epi32( _mm256_cvtepu16_epi32( _mm_loadu_si128( (const __m128i*)in ) ),
+                                                           _mm256_load_si256( (const __m256i*)RANSExpand.lanes[mask] ) );
+
+            x[v] = _mm256_blendv_epi8( x[v], _mm256_or_si256( _mm256_slli_epi32( x[v], 16 ), w ), renorm );
+            in  += _mm_popcnt_u32( mask ) * sizeof( uint16 );
+        }
+
+        // Lanes are packed per 128-bit half, then the halves are put back in order
+        const __m256i lo = _mm256_packus_epi32( sym[0], sym[1] );
+        const __m256i hi = _mm256_packus_epi32( sym[2], sym[3] );
+
+        _mm256_storeu_si256( (__m256i*)( dst + i ), _mm256_permutevar8x32_epi32( _mm256_packus_epi16( lo, hi ), packPerm ) );
+    }
+
+    for( uint32 v = 0; v < Vectors; v++ )
+        _mm256_storeu_si256( (__m256i*)( states + v * 8 ), x[v] );
+
+    words = in;
+    return i;
+}
+
+// Same GCC 12 intrinsics warning as in UnpackStubsAVX512
+#pragma GCC diagnostic push
+#if !defined( __clang__ )
+    #pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+//-----------------------------------------------------------
+PARKCODING_TARGET( "avx512f,avx512bw,popcnt" )
+static uint32 RANSDecodeAVX512( byte* dst, const uint32 count, uint32 states[RANSLaneCount],
+                                const byte*& words, const byte* wordsEnd, const RANSDecTable& table )
+{
+    constexpr uint32 Vectors = RANSLaneCount / 16;
+
+    const __m512i slotMask = _mm512_set1_epi32( ( 1 << RANSScaleBits ) - 1 );
+    const __m512i lowMask  = _mm512_set1_epi32( 0xFFFF );
+    const __m512i byteMask = _mm512_set1_epi32( 0xFF );
+    const __m512i stateLow = _mm512_set1_epi32( (int)RANSStateLow );
+
+    __m512i x[Vectors];
+    for( uint32 v = 0; v < Vectors; v++ )
+        x[v] = _mm512_loadu_si512( states + v * 16 );
+
+    const byte* in = words;
+    uint32      i  = 0;
+
+    for( ; i + RANSLaneCount <= count && wordsEnd - in >= (ptrdiff_t)( RANSLaneCount * sizeof( uint16 ) ); i += RANSLaneCount )
+    {
+        __m512i sym[Vectors];
+
+        for( uint32 v = 0; v < Vectors; v++ )
+        {
+            const __m512i slot  = _mm512_and_si512( x[v], slotMask );
+            const __m512i entry = _mm512_i32gather_epi32( slot, table.slots, 4 );
+
+            sym[v] = _mm512_and_si512( _mm512_i32gather_epi32( slot, table.symbols, 1 ), byteMask );
+            x[v]   = _mm512_add_epi32( _mm512_mullo_epi32( _mm512_srli_epi32( entry, 16 ), _mm512_srli_epi32( x[v], RANSScaleBits ) ),
+                                       _mm512_and_si512( entry, lowMask ) );
+        }
+
+        for( uint32 v = 0; v < Vectors; v++ )
+        {
+            const __mmask16 renorm = _mm512_cmplt_epu32_mask( x[v], stateLow );
+            const __m512i   w      = _mm512_maskz_expand_epi32( renorm, _mm512_cvtepu16_epi32( _mm256_loadu_si256( (const __m256i*)in ) ) );
+
+            x[v] = _mm512_mask_or_epi32( x[v], renorm, _mm512_slli_epi32( x[v], 16 ), w );
+            in  += _mm_popcnt_u32( renorm ) * sizeof( uint16 );
+        }
+
+        for( uint32 v = 0; v < Vectors; v++ )
+            _mm_storeu_si128( (__m128i*)( dst + i + v * 16 ), _mm512_cvtepi32_epi8( sym[v] ) );
+    }
+
+    for( uint32 v = 0; v < Vectors; v++ )
+        _mm512_storeu_si512( states + v * 16, x[v] );
+
+    words = in;
+    return i;
+}
+
+#pragma GCC diagnostic pop
+
+#endif // PARKCODING_X86
+
+//-----------------------------------------------------------
+size_t RANSDecode( byte* dst, const size_t dstCapacity, const byte* src, const size_t srcSize, const RANSDecTable& table )
+{
+    if( srcSize < sizeof( uint16 ) )
+        return (size_t)-FSE_error_srcSize_wrong;
+
+    const uint32 count     = LoadLE16( src );
+    const uint32 laneCount = std::min( count, RANSLaneCount );
+
+    if( count > dstCapacity )
+        return (size_t)-FSE_error_dstSize_tooSmall;
+
+    const size_t headerSize = sizeof( uint16 ) + laneCount * sizeof( uint32 );
+    if( srcSize < headerSize || ( srcSize - headerSize ) % sizeof( uint16 ) )
+        return (size_t)-FSE_error_srcSize_wrong;
+
+    alignas( 64 ) uint32 states[RANSLaneCount] = {};
+    for( uint32 lane = 0; lane < laneCount; lane++ )
+        states[lane] = LoadLE32( src + sizeof( uint16 ) + lane * sizeof( uint32 ) );
+
+    const byte* words    = src + headerSize;
+    const byte* wordsEnd = src + srcSize;
+
+    uint32 i = 0;
+
+#if PARKCODING_X86
+    switch( ParkCodingSimdLevel() )
+    {
+        case ParkCodingSimd::AVX512: i = RANSDecodeAVX512( dst, count, states, words, wordsEnd, table ); break;
+        case ParkCodingSimd::AVX2  : i = RANSDecodeAVX2  ( dst, count, states, words, wordsEnd, table ); break;
+        default: break;
+    }
+#endif
+
+    for( ; i < count; i++ )
+    {
+        uint32&      x     = states[i % RANSLaneCount];
+        const uint32 slot  = x & ( ( 1u << RANSScaleBits ) - 1 );
+        const uint32 entry = table.slots[slot];
+
+        dst[i] = table.symbols[slot];
+        x      = ( entry >> 16 ) * ( x >> RANSScaleBits ) + ( entry & 0xFFFF );
+
+        if( x < RANSStateLow )
+        {
+            if( words == wordsEnd )
+                return (size_t)-FSE_error_corruption_detected;
+
+            x = ( x << 16 ) | LoadLE16( words );
+            words += sizeof( uint16 );
+        }
+    }
+
+    // The encoder started every lane at RANSStateLow and its words must have been consumed exactly
+    if( words != wordsEnd )
+        return (size_t)-FSE_error_corruption_detected;
+
+    for( uint32 lane = 0; lane < laneCount; lane++ )
+    {
+        if( states[lane] != RANSStateLow )
+            return (size_t)-FSE_error_corruption_detected;
+    }
+
+    return count;
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include "fse/fse.h"
+#include "ChiaConsts.h"
+#include "RANSCoding.h"
+
+///
+/// Stub and delta coding helpers for line point parks.
+/// Stubs are stored as an MSB-first bit stream of fixed-width entries,
+/// written as big-endian 64-bit fields.
+///
+
+// Caps the SIMD kernels used by the functions below at level 0 (scalar only), 1 (AVX2) or 2 (AVX-512),
+// so that tests can check them against the scalar code. Not thread-safe, it must be called while nothing is being coded.
+void SetParkCodingMaxSimd( uint32 level );
+
+// Packs the low bitSize bits of each value into the stub bit stream.
+// Writes CDiv( count * bitSize, 64 ) whole fields, the unused bits of the last field are zeroed.
+// count must be <= kEntriesPerPark and bitSize must be in [1, 57].
+// Returns the end of the fields written.
+uint64* PackStubs( const uint64* values, uint64 count, uint32 bitSize, uint64* fields );
+
+// Unpacks count stubs of bitSize bits from the stub bit stream.
+// Reads no more than CDiv( count * bitSize, 8 ) bytes of src, which needs no alignment.
+// bitSize must be in [1, 57].
+void UnpackStubs( const byte* src, uint64 count, uint32 bitSize, uint64* stubs );
+
+// Decompresses two independent FSE streams which use the same table.
+// Their decoding is interleaved, so that the dependent table lookups of one stream
+// overlap with the other's. The output is the same as calling FSE_decompress_usingDTable on each stream,
+// including the error codes returned in outSizes, which must be checked with FSE_isError.
+void FSEDecompressX2( const FSE_DTable* dTable,
+                      byte* const dst[2], const size_t dstCapacity[2],
+                      const byte* const src[2], const size_t srcSize[2],
+                      size_t outSizes[2] );
+
+// Looks up sorted, unique target f7s in a C3 park, given its compressed f7 deltas and its C1 entry, which is its first f7.
+// Decoding stops as soon as the park's f7s pass the last target.
+// outFirst[i] is the index in the park of the first f7 equal to target i, and outCounts[i] how many there are, 0 if none.
+// Returns the number of f7s visited, including c1, or an error code which must be checked with FSE_isError.
+// If outFirst[i] + outCounts[i] equals it, the run of target i reached the end of the park, and may go on in the next one.
+size_t FindC3ParkF7s( const FSE_DTable* dTable, const byte* src, size_t srcSize, uint64 c1,
+                      const uint64* targets, uint32 targetCount, uint64* outFirst, uint64* outCounts );
+
+///
+/// Interleaved park deltas, used by plots with PlotFlags::InterleavedDeltas.
+/// A park's deltas are split in order into ParkDeltaStreamCount segments of ParkDeltaStreamEntries,
+/// the last ones partial or empty, each compressed as its own FSE stream, so that they can be decoded in parallel.
+/// The deltas section starts with the uint16 size of each stream, with 0x8000 set if it is stored
+/// uncompressed, followed by the streams. The park's uint16 deltas size covers both.
+///
+static constexpr uint32 ParkDeltaStreamCount   = 4;
+static constexpr uint32 ParkDeltaStreamEntries = ( kEntriesPerPark - 1 + ParkDeltaStreamCount - 1 ) / ParkDeltaStreamCount;
+
+// Returns the size written to dst. Up to 8 bytes past it may be overwritten.
+size_t CompressInterleavedDeltas( byte* dst, const byte* deltas, size_t count, const FSE_CTable* cTable );
+
+// Returns the number of deltas decoded, or an error code which must be checked with FSE_isError.
+size_t DecompressInterleavedDeltas( byte* dst, size_t dstCapacity, const byte* src, size_t srcSize, const FSE_DTable* dTable );
+
+// Decodes the symbols encoded by RANSEncode.
+// Returns the symbol count, or an error code which must be checked with FSE_isError.
+// Streams whose states don't end up where the encoder started are reported as corrupted.
+size_t RANSDecode( byte* dst, size_t dstCapacity, const byte* src, size_t srcSize, const RANSDecTable& table );
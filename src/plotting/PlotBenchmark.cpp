@@ -0,0 +1,516 @@
+#include "PlotBenchmark.h"
+#include "ChiaConsts.h"
+#include "plotting/GlobalPlotConfig.h"
+#include "util/KeyTools.h"
+#include "util/Log.h"
+#include "BLS.h"
+#include "Version.h"
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#if PLATFORM_IS_UNIX
+    #include <sys/resource.h>
+#elif PLATFORM_IS_WINDOWS
+    #include <Windows.h>
+    #include <psapi.h>
+#endif
+
+// Fixed benchmark inputs. The plot id determines every table, the rest only goes into the plot header.
+static const char BENCH_PLOT_ID[] = "b1adeb17b1adeb17b1adeb17b1adeb17b1adeb17b1adeb17b1adeb17b1adeb17";
+static const char BENCH_SEED[]    = "bladebit benchmark master seed.";
+
+namespace {
+
+    struct TableTiming
+    {
+        double elapsed  = 0;
+        double ioWait   = 0;
+        double gpuTime  = 0;
+        bool   recorded = false;
+    };
+
+    struct PhaseTiming
+    {
+        double      elapsed    = 0;
+        double      cpuSeconds = 0;
+        bool        recorded   = false;
+        TableTiming tables[(uint32)TableId::_Count];
+    };
+
+    struct RunTiming
+    {
+        double      elapsed    = 0;
+        double      cpuSeconds = 0;
+        uint64      peakRSS    = 0;
+        PhaseTiming phases[PlotBenchmark::MAX_PHASES];
+    };
+
+    typedef std::vector<std::pair<std::string, double>> Metrics;
+
+    bool                                  _inRun    = false;
+    std::vector<RunTiming>                _runs;
+    std::chrono::steady_clock::time_point _runTimer;
+    double                                _runCpuStart   = 0;
+    double                                _phaseCpuStart = 0;
+    char                                  _plotMemoStr[BB_PLOT_MEMO_MAX_SIZE*2+1];
+}
+
+/// User + kernel time of all threads in the process
+//-----------------------------------------------------------
+static double GetProcessCPUSeconds()
+{
+#if PLATFORM_IS_UNIX
+    struct rusage usage;
+    if( getrusage( RUSAGE_SELF, &usage ) != 0 )
+        return 0;
+
+    return (double)( usage.ru_utime.tv_sec  + usage.ru_stime.tv_sec ) +
+           (double)( usage.ru_utime.tv_usec + usage.ru_stime.tv_usec ) * 1e-6;
+#elif PLATFORM_IS_WINDOWS
+    FILETIME creation, exit, kernel, user;
+    if( !GetProcessTimes( GetCurrentProcess(), &creation, &exit, &kernel, &user ) )
+        return 0;
+
+    auto ToTicks = []( const FILETIME& t ) { return ( (uint64)t.dwHighDateTime << 32 ) | t.dwLowDateTime; };
+    return (double)( ToTicks( kernel ) + ToTicks( user ) ) * 1e-7;  // 100ns intervals
+#else
+    return 0;
+#endif
+}
+
+/// Peak resident memory of the process since it started, in bytes
+//-----------------------------------------------------------
+static uint64 GetPeakRSS()
+{
+#if PLATFORM_IS_UNIX
+    struct rusage usage;
+    if( getrusage( RUSAGE_SELF, &usage ) != 0 )
+        return 0;
+
+    #if PLATFORM_IS_APPLE
+        return (uint64)usage.ru_maxrss;             // Bytes on macOS
+    #else
+        return (uint64)usage.ru_maxrss * 1024ull;   // KiB on Linux
+    #endif
+#elif PLATFORM_IS_WINDOWS
+    PROCESS_MEMORY_COUNTERS counters;
+    if( !GetProcessMemoryInfo( GetCurrentProcess(), &counters, sizeof( counters ) ) )
+        return 0;
+
+    return (uint64)counters.PeakWorkingSetSize;
+#else
+    return 0;
+#endif
+}
+
+//-----------------------------------------------------------
+bool PlotBenchmark::IsEnabled()
+{
+    return _inRun;
+}
+
+//-----------------------------------------------------------
+void PlotBenchmark::ApplyDefaults( GlobalPlotConfig& cfg )
+{
+    ASSERT( cfg.bench );
+
+    if( !cfg.plotIdStr )
+        cfg.plotIdStr = BENCH_PLOT_ID;
+
+    // Derive the keys from a fixed seed, if none were given
+    bls::PrivateKey masterSk = bls::AugSchemeMPL().KeyGen( bls::Bytes( (const uint8_t*)BENCH_SEED, sizeof( BENCH_SEED ) ) );
+
+    if( !cfg.farmerPublicKey )
+        cfg.farmerPublicKey = new bls::G1Element( KeyTools::MasterSkToLocalSK( masterSk ).GetG1Element() );
+
+    if( !cfg.poolPublicKey && !cfg.poolContractPuzzleHash )
+        cfg.poolPublicKey = new bls::G1Element( masterSk.GetG1Element() );
+
+    if( !cfg.plotMemoStr )
+    {
+        // Same layout as a pool public key memo: <pool_pk><farmer_pk><master_sk>
+        std::vector<uint8_t> memo = cfg.poolContractPuzzleHash ?
+            std::vector<uint8_t>( cfg.poolContractPuzzleHash->data, cfg.poolContractPuzzleHash->data + CHIA_PUZZLE_HASH_SIZE ) :
+            cfg.poolPublicKey->Serialize();
+
+        const auto farmerPk = cfg.farmerPublicKey->Serialize();
+        const auto sk       = masterSk.Serialize();
+        memo.insert( memo.end(), farmerPk.begin(), farmerPk.end() );
+        memo.insert( memo.end(), sk.begin(), sk.end() );
+
+        size_t numEncoded = 0;
+        BytesToHexStr( memo.data(), memo.size(), _plotMemoStr, sizeof( _plotMemoStr ) - 1, numEncoded );
+        _plotMemoStr[numEncoded*2] = 0;
+
+        cfg.plotMemoStr = _plotMemoStr;
+    }
+}
+
+//-----------------------------------------------------------
+void PlotBenchmark::BeginRun()
+{
+    _runs.emplace_back();
+    _inRun = true;
+
+    _runTimer      = TimerBegin();
+    _runCpuStart   = GetProcessCPUSeconds();
+    _phaseCpuStart = _runCpuStart;
+}
+
+//-----------------------------------------------------------
+void PlotBenchmark::EndRun()
+{
+    ASSERT( _inRun );
+    auto& run = _runs.back();
+
+    run.elapsed    = TimerEnd( _runTimer );
+    run.cpuSeconds = GetProcessCPUSeconds() - _runCpuStart;
+    run.peakRSS    = GetPeakRSS();
+
+    _inRun = false;
+}
+
+//-----------------------------------------------------------
+void PlotBenchmark::RecordPhase( const uint32 phase, const double elapsed )
+{
+    if( !_inRun || phase < 1 || phase > MAX_PHASES )
+        return;
+
+    const double cpu = GetProcessCPUSeconds();
+
+    auto& p = _runs.back().phases[phase-1];
+    p.elapsed    += elapsed;
+    p.cpuSeconds += cpu - _phaseCpuStart;
+    p.recorded    = true;
+
+    _phaseCpuStart = cpu;
+}
+
+//-----------------------------------------------------------
+void PlotBenchmark::RecordTable( const uint32 phase, const TableId table, const double elapsed, const double ioWait )
+{
+    if( !_inRun || phase < 1 || phase > MAX_PHASES || table >= TableId::_Count )
+        return;
+
+    auto& t = _runs.back().phases[phase-1].tables[(uint32)table];
+    t.elapsed  += elapsed;
+    t.ioWait   += ioWait;
+    t.recorded  = true;
+}
+
+//-----------------------------------------------------------
+void PlotBenchmark::RecordTableGpuTime( const uint32 phase, const TableId table, const double gpuSeconds )
+{
+    if( !_inRun || phase < 1 || phase > MAX_PHASES || table >= TableId::_Count )
+        return;
+
+    _runs.back().phases[phase-1].tables[(uint32)table].gpuTime += gpuSeconds;
+}
+
+/// Flattens a run into named metrics, which is also how they're compared to the baseline
+//-----------------------------------------------------------
+static Metrics GetRunMetrics( const RunTiming& run, const uint32 threadCount )
+{
+    Metrics m;
+    char    name[64];
+
+    auto CpuUtilization = [=]( const double cpuSeconds, const double elapsed ) {
+        return elapsed > 0 ? cpuSeconds / ( elapsed * threadCount ) : 0.0;
+    };
+
+    double ioWait = 0;
+
+    m.push_back( { "total_seconds"  , run.elapsed } );
+    m.push_back( { "cpu_seconds"    , run.cpuSeconds } );
+    m.push_back( { "cpu_utilization", CpuUtilization( run.cpuSeconds, run.elapsed ) } );
+    m.push_back( { "peak_rss_bytes" , (double)run.peakRSS } );
+
+    for( uint32 i = 0; i < PlotBenchmark::MAX_PHASES; i++ )
+    {
+        const auto& p = run.phases[i];
+        if( !p.recorded )
+            continue;
+
+        snprintf( name, sizeof( name ), "phase%u_seconds", i+1 );
+        m.push_back( { name, p.elapsed } );
+        snprintf( name, sizeof( name ), "phase%u_cpu_utilization", i+1 );
+        m.push_back( { name, CpuUtilization( p.cpuSeconds, p.elapsed ) } );
+
+        for( uint32 t = 0; t < (uint32)TableId::_Count; t++ )
+        {
+            const auto& table = p.tables[t];
+            if( !table.recorded )
+                continue;
+
+            snprintf( name, sizeof( name ), "phase%u_table%u_seconds", i+1, t+1 );
+            m.push_back( { name, table.elapsed } );
+            snprintf( name, sizeof( name ), "phase%u_table%u_io_wait_seconds", i+1, t+1 );
+            m.push_back( { name, table.ioWait } );
+
+            if( table.gpuTime > 0 )
+            {
+                snprintf( name, sizeof( name ), "phase%u_table%u_gpu_utilization", i+1, t+1 );
+                m.push_back( { name, table.elapsed > 0 ? std::min( 1.0, table.gpuTime / table.elapsed ) : 0.0 } );
+            }
+
+            ioWait += table.ioWait;
+        }
+    }
+
+    m.push_back( { "io_wait_seconds", ioWait } );
+    return m;
+}
+
+//-----------------------------------------------------------
+static void AppendF( std::string& str, const char* format, ... )
+{
+    char buffer[256];
+
+    va_list args;
+    va_start( args, format );
+    const int count = vsnprintf( buffer, sizeof( buffer ), format, args );
+    va_end( args );
+
+    if( count > 0 )
+        str.append( buffer, std::min( (size_t)count, sizeof( buffer ) - 1 ) );
+}
+
+//-----------------------------------------------------------
+static void AppendJsonStr( std::string& str, const char* value )
+{
+    str += '"';
+    for( ; *value; value++ )
+    {
+        const char c = *value;
+
+        if( c == '"' || c == '\\' )
+        {
+            str += '\\';
+            str += c;
+        }
+        else if( (unsigned char)c < 0x20 )
+            AppendF( str, "\\u%04x", (unsigned)c );
+        else
+            str += c;
+    }
+    str += '"';
+}
+
+//-----------------------------------------------------------
+static void AppendMetrics( std::string& str, const Metrics& metrics )
+{
+    str += "{";
+    for( size_t i = 0; i < metrics.size(); i++ )
+    {
+        AppendF( str, "%s\"%s\": ", i ? ", " : "", metrics[i].first.c_str() );
+        AppendF( str, "%.6lf", metrics[i].second );
+    }
+    str += "}";
+}
+
+/// Reads the "summary" object of a previous benchmark's json output
+//-----------------------------------------------------------
+static bool ReadBaseline( const char* path, Metrics& outMetrics )
+{
+    FILE* file = fopen( path, "rb" );
+    if( !file )
+        return false;
+
+    std::string json;
+    char        buffer[4096];
+    size_t      read;
+
+    while( ( read = fread( buffer, 1, sizeof( buffer ), file ) ) > 0 )
+        json.append( buffer, read );
+
+    fclose( file );
+
+    size_t pos = json.find( "\"summary\"" );
+    if( pos == std::string::npos || ( pos = json.find( '{', pos ) ) == std::string::npos )
+        return false;
+
+    const size_t end = json.find( '}', pos );
+    if( end == std::string::npos )
+        return false;
+
+    // Flat "name": value pairs
+    for( pos++; pos < end; )
+    {
+        const size_t nameStart = json.find( '"', pos );
+        if( nameStart >= end )
+            break;
+
+        const size_t nameEnd = json.find( '"', nameStart + 1 );
+        const size_t colon   = json.find( ':', nameEnd );
+        if( nameEnd >= end || colon >= end )
+            return false;
+
+        char* valueEnd = nullptr;
+        const double value = strtod( json.c_str() + colon + 1, &valueEnd );
+        if( valueEnd == json.c_str() + colon + 1 )
+            return false;
+
+        outMetrics.push_back( { json.substr( nameStart + 1, nameEnd - nameStart - 1 ), value } );
+        pos = (size_t)( valueEnd - json.c_str() );
+    }
+
+    return true;
+}
+
+/// Wall times and memory are compared. Utilization figures and I/O waits are informational.
+//-----------------------------------------------------------
+static bool IsComparedMetric( const std::string& name )
+{
+    auto EndsWith = [&]( const char* suffix ) {
+        const size_t len = strlen( suffix );
+        return name.size() >= len && name.compare( name.size() - len, len, suffix ) == 0;
+    };
+
+    if( EndsWith( "io_wait_seconds" ) || name == "cpu_seconds" )
+        return false;
+
+    return EndsWith( "_seconds" ) || name == "peak_rss_bytes";
+}
+
+//-----------------------------------------------------------
+bool PlotBenchmark::Report( const GlobalPlotConfig& cfg )
+{
+    ASSERT( cfg.bench );
+    const auto& bench = *cfg.bench;
+
+    // The summary is the median of each metric over all runs
+    std::vector<Metrics> runMetrics;
+    for( const auto& run : _runs )
+        runMetrics.push_back( GetRunMetrics( run, cfg.threadCount ) );
+
+    Metrics summary;
+    if( !runMetrics.empty() )
+    {
+        for( size_t i = 0; i < runMetrics[0].size(); i++ )
+        {
+            std::vector<double> values;
+            for( const auto& m : runMetrics )
+            {
+                for( const auto& kv : m )
+                {
+                    if( kv.first == runMetrics[0][i].first )
+                    {
+                        values.push_back( kv.second );
+                        break;
+                    }
+                }
+            }
+
+            std::sort( values.begin(), values.end() );
+            const size_t mid    = values.size() / 2;
+            const double median = values.size() % 2 ? values[mid] : ( values[mid-1] + values[mid] ) * 0.5;
+
+            summary.push_back( { runMetrics[0][i].first, median } );
+        }
+    }
+
+    // Compare against the baseline
+    bool    passed = true;
+    Metrics baseline;
+    std::vector<std::pair<std::string, double>> regressions;   // Metric and slowdown percentage
+
+    if( bench.baselinePath )
+    {
+        FatalIf( !ReadBaseline( bench.baselinePath, baseline ), "Failed to read benchmark baseline '%s'.", bench.baselinePath );
+
+        Log::Line( "" );
+        Log::Line( "[Baseline Comparison] %s", bench.baselinePath );
+
+        for( const auto& kv : summary )
+        {
+            if( !IsComparedMetric( kv.first ) )
+                continue;
+
+            for( const auto& base : baseline )
+            {
+                // Very short timings are mostly noise
+                if( base.first != kv.first || base.second <= ( kv.first == "peak_rss_bytes" ? 0.0 : 0.1 ) )
+                    continue;
+
+                const double change = ( kv.second - base.second ) / base.second * 100.0;
+                const bool   failed = change > bench.tolerance;
+
+                if( kv.first == "peak_rss_bytes" )
+                    Log::Line( " %-36s : %10.2lf -> %10.2lf MiB ( %+.2lf%% )%s", kv.first.c_str(),
+                        base.second BtoMB, kv.second BtoMB, change, failed ? " REGRESSION" : "" );
+                else
+                    Log::Line( " %-36s : %10.2lf -> %10.2lf s   ( %+.2lf%% )%s", kv.first.c_str(),
+                        base.second, kv.second, change, failed ? " REGRESSION" : "" );
+
+                if( failed )
+                    regressions.push_back( { kv.first, change } );
+                break;
+            }
+        }
+
+        passed = regressions.empty();
+
+        if( passed )
+            Log::Line( "No regressions above %.2lf%%.", bench.tolerance );
+        else
+            Log::Line( "%llu metrics regressed by more than %.2lf%%.", (llu)regressions.size(), bench.tolerance );
+    }
+
+    // Write results
+    std::string json;
+
+    json += "{\"bench\": {\"plotter\": ";
+    AppendJsonStr( json, bench.plotterName ? bench.plotterName : "" );
+    json += ", \"version\": ";
+    AppendJsonStr( json, BLADEBIT_VERSION_STR );
+    json += ", \"git_commit\": ";
+    AppendJsonStr( json, BLADEBIT_GIT_COMMIT );
+    json += ", \"compiler\": ";
+    AppendJsonStr( json, BBGetCompilerVersion() );
+    json += ", \"plot_id\": ";
+    AppendJsonStr( json, cfg.plotIdStr ? cfg.plotIdStr : "" );
+    AppendF( json, ", \"threads\": %u, \"compression\": %u, \"runs\": %u},\n", cfg.threadCount, cfg.compressionLevel, (uint32)_runs.size() );
+
+    json += "\"runs\": [";
+    for( size_t i = 0; i < runMetrics.size(); i++ )
+    {
+        json += i ? ",\n  " : "\n  ";
+        AppendMetrics( json, runMetrics[i] );
+    }
+    json += "\n],\n\"summary\": ";
+    AppendMetrics( json, summary );
+
+    if( bench.baselinePath )
+    {
+        json += ",\n\"baseline\": {\"path\": ";
+        AppendJsonStr( json, bench.baselinePath );
+        AppendF( json, ", \"tolerance\": %.2lf, \"passed\": %s, \"regressions\": {", bench.tolerance, passed ? "true" : "false" );
+
+        for( size_t i = 0; i < regressions.size(); i++ )
+            AppendF( json, "%s\"%s\": %.2lf", i ? ", " : "", regressions[i].first.c_str(), regressions[i].second );
+
+        json += "}}";
+    }
+    json += "}\n";
+
+    if( bench.jsonPath )
+    {
+        FILE* file = fopen( bench.jsonPath, "wb" );
+        FatalIf( !file, "Failed to open benchmark output file '%s'.", bench.jsonPath );
+
+        const bool written = fwrite( json.data(), 1, json.size(), file ) == json.size();
+        fclose( file );
+        FatalIf( !written, "Failed to write benchmark output file '%s'.", bench.jsonPath );
+
+        Log::Line( "Wrote benchmark results to '%s'.", bench.jsonPath );
+    }
+    else
+    {
+        Log::Flush();
+        fputs( json.c_str(), stdout );
+        fflush( stdout );
+    }
+
+    return passed;
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include "plotting/Tables.h"
+
+struct GlobalPlotConfig;
+
+struct PlotBenchmarkConfig
+{
+    const char* plotterName  = nullptr;     // Plotter command being benchmarked (ramplot, diskplot, cudaplot)
+    const char* jsonPath     = nullptr;     // --json: Write the results here. Defaults to stdout
+    const char* baselinePath = nullptr;     // --baseline: Results of a previous run to compare against
+    double      tolerance    = 5.0;         // --tolerance: Slowdown percentage over the baseline that fails the benchmark
+    uint32      runs         = 1;           // --runs: Number of plots to time
+};
+
+///
+/// Timings collected while running the 'bench' command.
+/// The plotters report their phase and table times through here, which does nothing
+/// unless a benchmark is running. Only called from the plotter's main thread.
+///
+class PlotBenchmark
+{
+public:
+    static constexpr uint32 MAX_PHASES = 4;
+
+    static bool IsEnabled();
+
+    // Plot id, memo and keys used by every benchmark run, unless given explicitly,
+    // so that runs of different builds plot the exact same tables.
+    static void ApplyDefaults( GlobalPlotConfig& cfg );
+
+    static void BeginRun();
+    static void EndRun();
+
+    // Phases are numbered from 1. The process CPU time since the previous phase is attributed to this one.
+    static void RecordPhase( uint32 phase, double elapsed );
+
+    // ioWait is the time the table spent blocked on I/O.
+    static void RecordTable( uint32 phase, TableId table, double elapsed, double ioWait = 0.0 );
+
+    // Time the GPU spent computing the table, as measured on the device.
+    static void RecordTableGpuTime( uint32 phase, TableId table, double gpuSeconds );
+
+    // Writes the results as json and compares them against the baseline, if one was given.
+    // Returns false if any timing regressed beyond the tolerance.
+    static bool Report( const GlobalPlotConfig& cfg );
+};
@@ -0,0 +1,94 @@
+#include "PlotCheckQueue.h"
+#include "tools/PlotChecker.h"
+#include "threading/Thread.h"
+
+//-----------------------------------------------------------
+PlotCheckQueue::PlotCheckQueue( PlotChecker& checker )
+    : _checker( checker )
+{
+    _thread = new Thread( 4 MiB );
+    _thread->Run( CheckThreadEntry, this );
+}
+
+//-----------------------------------------------------------
+PlotCheckQueue::~PlotCheckQueue()
+{
+    WaitForChecks();
+
+    {
+        std::unique_lock lock( _lock );
+        _exit = true;
+    }
+    _signal.notify_all();
+
+    _thread->WaitForExit();
+    delete _thread;
+}
+
+//-----------------------------------------------------------
+void PlotCheckQueue::Submit( const char* plotPath, CheckCallback onChecked )
+{
+    ASSERT( plotPath );
+
+    {
+        std::unique_lock lock( _lock );
+        _checks.push_back( { plotPath, std::move( onChecked ) } );
+        _pending++;
+    }
+
+    _signal.notify_all();
+}
+
+//-----------------------------------------------------------
+void PlotCheckQueue::WaitForChecks()
+{
+    std::unique_lock lock( _lock );
+    _signal.wait( lock, [this]() { return _pending == 0; } );
+}
+
+//-----------------------------------------------------------
+uint32 PlotCheckQueue::GetPendingCount()
+{
+    std::unique_lock lock( _lock );
+    return _pending;
+}
+
+//-----------------------------------------------------------
+void PlotCheckQueue::CheckThreadEntry( PlotCheckQueue* self )
+{
+    self->CheckThreadMain();
+}
+
+//-----------------------------------------------------------
+void PlotCheckQueue::CheckThreadMain()
+{
+    for( ;; )
+    {
+        Check check;
+        {
+            std::unique_lock lock( _lock );
+            _signal.wait( lock, [&]() { return _exit || !_checks.empty(); } );
+
+            if( _checks.empty() )
+                return;
+
+            check = std::move( _checks.front() );
+            _checks.pop_front();
+        }
+
+        PlotCheckResult result{};
+        _checker.CheckPlot( check.plotPath.c_str(), &result );
+
+        const bool passed = result.error.empty() && !result.deleted;
+
+        if( check.onChecked )
+            check.onChecked( passed );
+
+        {
+            std::unique_lock lock( _lock );
+            ASSERT( _pending > 0 );
+            _pending--;
+        }
+        _signal.notify_all();
+    }
+}
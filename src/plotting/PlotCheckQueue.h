@@ -0,0 +1,55 @@
+#pragma once
+#include <mutex>
+#include <condition_variable>
+#include <string>
+#include <deque>
+#include <functional>
+
+class Thread;
+class PlotChecker;
+
+/**
+ * Runs plot checks (--check) on a background thread, so that plotting can continue
+ * with the next plot while the proofs of the last one are being checked.
+ * All checks go through the single thread, in submission order, so the checker,
+ * and the GreenReaper context it uses, is never used concurrently.
+ */
+class PlotCheckQueue
+{
+public:
+    // Called on the check thread with whether the plot passed. Failed plots have already been deleted by the checker.
+    using CheckCallback = std::function<void( bool passed )>;
+
+    PlotCheckQueue( PlotChecker& checker );
+
+    // Waits for all queued checks to complete
+    ~PlotCheckQueue();
+
+    // Queues a written (and closed) plot file to be checked
+    void Submit( const char* plotPath, CheckCallback onChecked );
+
+    // Blocks until all queued checks have completed
+    void WaitForChecks();
+
+    // Number of plots queued or being checked
+    uint32 GetPendingCount();
+
+private:
+    struct Check
+    {
+        std::string   plotPath;
+        CheckCallback onChecked;
+    };
+
+    static void CheckThreadEntry( PlotCheckQueue* self );
+    void CheckThreadMain();
+
+private:
+    PlotChecker&            _checker;
+    Thread*                 _thread = nullptr;
+    std::mutex              _lock;
+    std::condition_variable _signal;
+    std::deque<Check>       _checks;
+    uint32                  _pending = 0;        // Queued checks + the one running
+    bool                    _exit    = false;
+};
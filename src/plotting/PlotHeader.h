@@ -11,6 +11,10 @@ enum class PlotFlags : uint32
 {
     None       = 0,
     Compressed = 1 << 0,
+    InterleavedDeltas = 1 << 1,     // LP park deltas are split into interleaved FSE streams (see ParkCoding.h)
+    RANSDeltas        = 1 << 2,     // LP park deltas are coded with interleaved rANS states (see RANSCoding.h)
+    AlignedParks      = 1 << 3,     // Tables start on a page and no park straddles a page (see PlotParkLayout)
+    TunedDeltas       = 1 << 4,     // LP park deltas are coded with tables fitted to each table (see PlotFileHeaderV2::deltaRValues)
 
 }; ImplementFlagOps( PlotFlags );
 
@@ -31,4 +35,70 @@ struct PlotFileHeaderV2 : PlotFileHeaderV1
     PlotFlags flags             = PlotFlags::None;
     byte      compressionLevel  = 0;
     uint64    tableSizes[10]    = { 0 };
-};
\ No newline at end of file
+    uint16    deltaRValues[6]   = { 0 };    // With PlotFlags::TunedDeltas, the R value of each LP table's deltas, in hundredths, big-endian in the file.
+                                            // 0 if the table uses its default R value.
+};
+
+// R values are stored in hundredths, the precision of the default ones
+inline uint16 EncodeDeltaRValue( const double rValue ) { return (uint16)( rValue * 100.0 + 0.5 ); }
+inline double DecodeDeltaRValue( const uint16 value  ) { return (double)value / 100.0; }
+
+///
+/// Location of the parks of a table, relative to its start.
+/// Plots with PlotFlags::AlignedParks start each table on a BB_PLOT_PAGE_SIZE boundary, and lay out
+/// parks so that none spans more pages than its size requires. Parks are packed in groups, each park
+/// starting further into its first page than the previous one, and each group is padded to whole pages.
+/// A park can then be read with direct I/O without reading more than the pages it needs.
+/// Otherwise parks are packed one after the other.
+///
+static constexpr size_t BB_PLOT_PAGE_SIZE = 4096;
+
+struct PlotParkLayout
+{
+    uint64 parkSize     = 0;
+    uint64 groupParks   = 1;    // Parks per group
+    uint64 groupStride  = 0;    // Bytes from one group to the next, including its padding
+
+    inline static PlotParkLayout Create( const uint64 parkSize, const bool aligned )
+    {
+        PlotParkLayout layout;
+        layout.parkSize    = parkSize;
+        layout.groupStride = parkSize;
+
+        // Park j of a group starts j * ( parkSize % page ) bytes into a page,
+        // which must leave room for the rest of the park in its minimum number of pages.
+        const uint64 pageRemainder = parkSize % BB_PLOT_PAGE_SIZE;
+
+        if( aligned && pageRemainder > 0 )
+        {
+            layout.groupParks  = BB_PLOT_PAGE_SIZE / pageRemainder;
+            layout.groupStride = ( ( layout.groupParks * parkSize + BB_PLOT_PAGE_SIZE - 1 ) / BB_PLOT_PAGE_SIZE ) * BB_PLOT_PAGE_SIZE;
+        }
+
+        return layout;
+    }
+
+    inline uint64 ParkOffset( const uint64 parkIndex ) const
+    {
+        const uint64 group = parkIndex / groupParks;
+        return group * groupStride + ( parkIndex - group * groupParks ) * parkSize;
+    }
+
+    // Number of whole parks in a table of this size
+    inline uint64 ParkCount( const uint64 tableSize ) const
+    {
+        if( parkSize == 0 )
+            return 0;
+
+        const uint64 groups    = tableSize / groupStride;
+        const uint64 remainder = tableSize - groups * groupStride;
+
+        return groups * groupParks + std::min( remainder / parkSize, groupParks );
+    }
+
+    // Padding written after each group
+    inline uint64 GroupPadding() const { return groupStride - groupParks * parkSize; }
+
+    // Upper bound of the bytes spanned by a run of consecutive parks, per park in the run
+    inline uint64 MaxBytesPerPark() const { return parkSize + GroupPadding(); }
+};
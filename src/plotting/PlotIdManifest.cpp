@@ -0,0 +1,133 @@
+#include "PlotIdManifest.h"
+#include "plotting/PlotTools.h"
+#include "util/Log.h"
+#include "util/Util.h"
+#include <unordered_set>
+
+//-----------------------------------------------------------
+bool PlotIdManifest::Write( const char* path, const std::vector<PlotIdEntry>& entries,
+                            const std::vector<std::string>& fileNames, const uint32 compressionLevel )
+{
+    ASSERT( entries.size() == fileNames.size() );
+
+    FILE* file = fopen( path, "w" );
+    if( !file )
+    {
+        Log::Error( "Failed to open plot id manifest '%s' for writing with error %d.", path, errno );
+        return false;
+    }
+
+    fprintf( file, "# bladebit plot id manifest: %llu plots, compression level %u\n", (llu)entries.size(), compressionLevel );
+    fprintf( file, "# <plot_id> <memo> <file_name>\n" );
+
+    char idStr  [BB_PLOT_ID_HEX_LEN+1];
+    char memoStr[BB_PLOT_MEMO_MAX_SIZE*2+1];
+
+    for( size_t i = 0; i < entries.size(); i++ )
+    {
+        const PlotIdEntry& e = entries[i];
+
+        PlotTools::PlotIdToString( e.plotId, idStr );
+
+        size_t numEncoded = 0;
+        BytesToHexStr( e.memo, e.memoSize, memoStr, sizeof( memoStr ) - 1, numEncoded );
+        memoStr[numEncoded*2] = 0;
+
+        fprintf( file, "%s %s %s\n", idStr, memoStr, fileNames[i].c_str() );
+    }
+
+    const bool ok = fflush( file ) == 0 && !ferror( file );
+    fclose( file );
+
+    if( !ok )
+        Log::Error( "Failed to write plot id manifest '%s'.", path );
+
+    return ok;
+}
+
+//-----------------------------------------------------------
+bool PlotIdManifest::Load( const char* path )
+{
+    _entries.clear();
+    _next     = 0;
+    _usedPath = std::string( path ) + ".used";
+
+    // Ids that previous runs have already plotted
+    std::unordered_set<std::string> usedIds;
+    char line[1024];
+
+    if( FILE* usedFile = fopen( _usedPath.c_str(), "r" ) )
+    {
+        while( fgets( line, sizeof( line ), usedFile ) )
+        {
+            const size_t len = strcspn( line, " \t\r\n" );
+            if( len == BB_PLOT_ID_HEX_LEN )
+                usedIds.emplace( line, len );
+        }
+
+        fclose( usedFile );
+    }
+
+    FILE* file = fopen( path, "r" );
+    if( !file )
+    {
+        Log::Error( "Failed to open plot id manifest '%s' with error %d.", path, errno );
+        return false;
+    }
+
+    size_t lineNumber = 0;
+    bool   ok         = true;
+
+    while( fgets( line, sizeof( line ), file ) )
+    {
+        lineNumber++;
+
+        const char* idStr   = strtok( line, " \t\r\n" );
+        const char* memoStr = idStr ? strtok( nullptr, " \t\r\n" ) : nullptr;
+
+        if( !idStr || idStr[0] == '#' )
+            continue;
+
+        const size_t memoLen = memoStr ? strlen( memoStr ) : 0;
+
+        PlotIdEntry e = {};
+        e.memoSize = (uint16)( memoLen / 2 );
+
+        if( strlen( idStr ) != BB_PLOT_ID_HEX_LEN ||
+            ( memoLen != (48+48+32)*2 && memoLen != (32+48+32)*2 ) ||
+            !HexStrToBytesSafe( idStr, BB_PLOT_ID_HEX_LEN, e.plotId, sizeof( e.plotId ) ) ||
+            !HexStrToBytesSafe( memoStr, memoLen, e.memo, sizeof( e.memo ) ) )
+        {
+            Log::Error( "Invalid entry at line %llu of plot id manifest '%s'.", (llu)lineNumber, path );
+            ok = false;
+            break;
+        }
+
+        if( usedIds.find( idStr ) == usedIds.end() )
+            _entries.push_back( e );
+    }
+
+    fclose( file );
+    return ok;
+}
+
+//-----------------------------------------------------------
+bool PlotIdManifest::Next( PlotIdEntry& outEntry )
+{
+    if( _next >= _entries.size() )
+        return false;
+
+    outEntry = _entries[_next++];
+
+    char idStr[BB_PLOT_ID_HEX_LEN+1];
+    PlotTools::PlotIdToString( outEntry.plotId, idStr );
+
+    // Record the id before plotting it, a plot that fails half-way must not be retried with the same id
+    FILE* usedFile = fopen( _usedPath.c_str(), "a" );
+    FatalIf( !usedFile, "Failed to open '%s' with error %d.", _usedPath.c_str(), errno );
+
+    fprintf( usedFile, "%s\n", idStr );
+    FatalIf( fclose( usedFile ) != 0, "Failed to write to '%s'.", _usedPath.c_str() );
+
+    return true;
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include "ChiaConsts.h"
+#include <string>
+#include <vector>
+
+struct PlotIdEntry
+{
+    byte   plotId  [BB_PLOT_ID_LEN];
+    byte   memo    [BB_PLOT_MEMO_MAX_SIZE];
+    uint16 memoSize;
+};
+
+///
+/// Plot ids and memos derived ahead of time by the 'gen-ids' command.
+/// The manifest is a text file with one plot per line: <plot_id> <memo> <file_name>, all in hex
+/// except for the file name, which is informational only. Lines starting with '#' are comments.
+///
+/// Plotting runs given a manifest with --ids take their ids from it in order,
+/// and append each one to <manifest>.used once it is handed out, so that restarts
+/// never plot the same id twice.
+///
+class PlotIdManifest
+{
+public:
+    // Writes the header and entries to path. fileNames holds one name per entry.
+    static bool Write( const char* path, const std::vector<PlotIdEntry>& entries,
+                       const std::vector<std::string>& fileNames, uint32 compressionLevel );
+
+    // Loads the entries of path that are not listed in its .used file.
+    bool Load( const char* path );
+
+    // Hands out the next unused entry and records it as used. Returns false when none are left.
+    bool Next( PlotIdEntry& outEntry );
+
+    inline size_t RemainingCount() const { return _entries.size() - _next; }
+
+private:
+    std::string              _usedPath;
+    std::vector<PlotIdEntry> _entries;
+    size_t                   _next = 0;
+};
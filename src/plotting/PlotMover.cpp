@@ -0,0 +1,278 @@
+#include "PlotMover.h"
+#include "io/FileStream.h"
+#include "plotdisk/jobs/IOJob.h"
+#include "threading/Thread.h"
+#include "threading/ThreadAffinity.h"
+#include "util/Log.h"
+
+// Size of a single transfer. A multiple of any block size we expect to see.
+static constexpr size_t MOVE_BUFFER_SIZE = 64 MiB;
+
+// Plot manifests (see PlotWriter::EnableManifests) are a few hundred bytes
+static constexpr size_t MAX_MANIFEST_SIZE = 4 KiB;
+static constexpr char   MANIFEST_EXT[]    = ".b3";
+
+static bool CopyManifest( const std::string& srcPath, const std::string& dstPath );
+
+//-----------------------------------------------------------
+PlotMover::PlotMover( const bool useDirectIO )
+    : _directIO( useDirectIO )
+{}
+
+//-----------------------------------------------------------
+PlotMover::~PlotMover()
+{
+    WaitForMoves();
+
+    {
+        std::unique_lock lock( _lock );
+        _exit = true;
+    }
+    _signal.notify_all();
+
+    for( auto* dest : _destinations )
+    {
+        dest->thread->WaitForExit();
+        delete dest->thread;
+        delete dest;
+    }
+}
+
+//-----------------------------------------------------------
+void PlotMover::Move( const char* stagedPlotPath, const char* destDir )
+{
+    ASSERT( stagedPlotPath && destDir );
+
+    {
+        std::unique_lock lock( _lock );
+
+        Destination* dest = nullptr;
+        for( auto* d : _destinations )
+        {
+            if( d->dir == destDir )
+            {
+                dest = d;
+                break;
+            }
+        }
+
+        if( !dest )
+        {
+            dest = new Destination();
+            dest->mover  = this;
+            dest->dir    = destDir;
+            dest->thread = new Thread( 4 MiB );
+            _destinations.push_back( dest );
+
+            dest->thread->Run( MoverThreadEntry, dest );
+        }
+
+        dest->plots.push_back( stagedPlotPath );
+        dest->pending++;
+    }
+
+    _signal.notify_all();
+}
+
+//-----------------------------------------------------------
+void PlotMover::WaitForMoves()
+{
+    std::unique_lock lock( _lock );
+
+    _signal.wait( lock, [this]() {
+        for( auto* dest : _destinations )
+        {
+            if( dest->pending > 0 )
+                return false;
+        }
+        return true;
+    });
+}
+
+//-----------------------------------------------------------
+uint32 PlotMover::GetPendingCount( const char* destDir )
+{
+    std::unique_lock lock( _lock );
+
+    for( auto* dest : _destinations )
+    {
+        if( dest->dir == destDir )
+            return dest->pending;
+    }
+
+    return 0;
+}
+
+//-----------------------------------------------------------
+void PlotMover::MoverThreadEntry( Destination* dest )
+{
+    ThreadAffinity::PinCurrentIOThread();
+    dest->mover->MoverThreadMain( *dest );
+}
+
+//-----------------------------------------------------------
+void PlotMover::MoverThreadMain( Destination& dest )
+{
+    for( ;; )
+    {
+        std::string stagedPath;
+        {
+            std::unique_lock lock( _lock );
+            _signal.wait( lock, [&]() { return _exit || !dest.plots.empty(); } );
+
+            if( dest.plots.empty() )
+                return;
+
+            stagedPath = std::move( dest.plots.front() );
+            dest.plots.pop_front();
+        }
+
+        MovePlot( stagedPath, dest.dir );
+
+        {
+            std::unique_lock lock( _lock );
+            ASSERT( dest.pending > 0 );
+            dest.pending--;
+        }
+        _signal.notify_all();
+    }
+}
+
+//-----------------------------------------------------------
+bool PlotMover::MovePlot( const std::string& stagedPath, const std::string& destDir )
+{
+    const size_t nameStart = stagedPath.find_last_of( "/\\" );
+    const char*  fileName  = stagedPath.c_str() + ( nameStart == std::string::npos ? 0 : nameStart + 1 );
+
+    std::string dstPath = destDir;
+    if( !dstPath.empty() && dstPath.back() != '/' && dstPath.back() != '\\' )
+        dstPath += '/';
+    dstPath += fileName;
+
+    // Copy to a temporary name, so that a partially moved plot is never farmed
+    const std::string tmpPath = dstPath + ".tmp";
+
+    const auto timer = TimerBegin();
+
+    int32 error = 0;
+    if( !CopyPlot( stagedPath.c_str(), tmpPath.c_str(), error ) )
+    {
+        Log::Line( "[PlotMover] Error: Failed to copy plot %s to %s with error %d. The plot was left in the staging directory.",
+            stagedPath.c_str(), tmpPath.c_str(), error );
+        remove( tmpPath.c_str() );
+        return false;
+    }
+
+    // The manifest lands before the plot appears under its final name
+    const std::string stagedManifestPath = stagedPath + MANIFEST_EXT;
+    const bool        movedManifest      = CopyManifest( stagedManifestPath, dstPath + MANIFEST_EXT );
+
+    if( !FileStream::Move( tmpPath.c_str(), dstPath.c_str(), &error ) )
+    {
+        Log::Line( "[PlotMover] Error: Failed to rename %s to %s with error %d. Please rename manually.",
+            tmpPath.c_str(), dstPath.c_str(), error );
+        return false;
+    }
+
+    // Reclaim the staging space
+    if( remove( stagedPath.c_str() ) != 0 )
+        Log::Line( "[PlotMover] Warning: Failed to delete staged plot %s.", stagedPath.c_str() );
+
+    if( movedManifest )
+        remove( stagedManifestPath.c_str() );
+
+    Log::Line( "Moved plot %s -> %s in %.2lf seconds", stagedPath.c_str(), dstPath.c_str(), TimerEnd( timer ) );
+    return true;
+}
+
+//-----------------------------------------------------------
+bool PlotMover::CopyPlot( const char* srcPath, const char* dstPath, int32& error )
+{
+    const FileFlags flags = FileFlags::LargeFile | ( _directIO ? FileFlags::NoBuffering : FileFlags::None );
+
+    FileStream src, dst;
+    if( !src.Open( srcPath, FileMode::Open, FileAccess::Read, flags ) )
+    {
+        error = src.GetError();
+        return false;
+    }
+
+    if( !dst.Open( dstPath, FileMode::Create, FileAccess::Write, flags ) )
+    {
+        error = dst.GetError();
+        return false;
+    }
+
+    // Keep the destination in as few extents as possible
+    const ssize_t srcSize = src.Size();
+    if( srcSize > 0 )
+        dst.Reserve( srcSize );
+
+    const size_t blockSize = _directIO ? dst.BlockSize() : 1;
+    ASSERT( MOVE_BUFFER_SIZE % blockSize == 0 );
+
+    byte* buffer = bbvirtalloc<byte>( MOVE_BUFFER_SIZE );
+    bool  success = true;
+
+    for( bool eof = false; success && !eof; )
+    {
+        // Fill the whole buffer, so that only the tail of the file may be padded
+        size_t sizeRead = 0;
+
+        while( sizeRead < MOVE_BUFFER_SIZE )
+        {
+            const ssize_t r = src.Read( buffer + sizeRead, MOVE_BUFFER_SIZE - sizeRead );
+
+            if( r < 0 )
+            {
+                error   = src.GetError();
+                success = false;
+                break;
+            }
+
+            if( r == 0 )
+            {
+                eof = true;
+                break;
+            }
+
+            sizeRead += (size_t)r;
+        }
+
+        if( !success || sizeRead == 0 )
+            break;
+
+        // Staged plots written with direct I/O already end on a block boundary. Pad the tail
+        // with zeroes if the destination has a larger block size, like the plot writer does.
+        const size_t writeSize = RoundUpToNextBoundaryT( sizeRead, blockSize );
+        if( writeSize > sizeRead )
+            memset( buffer + sizeRead, 0, writeSize - sizeRead );
+
+        success = IOJob::WriteToFile( dst, buffer, writeSize, nullptr, blockSize, error );
+    }
+
+    bbvirtfree( buffer );
+    return success;
+}
+
+//-----------------------------------------------------------
+bool CopyManifest( const std::string& srcPath, const std::string& dstPath )
+{
+    FileStream src;
+    if( !src.Open( srcPath.c_str(), FileMode::Open, FileAccess::Read ) )
+        return false;   // The plot has no manifest
+
+    byte buffer[MAX_MANIFEST_SIZE];
+    const ssize_t size = src.Read( buffer, sizeof( buffer ) );
+    src.Close();
+
+    FileStream dst;
+    if( size <= 0 || !dst.Open( dstPath.c_str(), FileMode::Create, FileAccess::Write ) || dst.Write( buffer, (size_t)size ) != size )
+    {
+        Log::Line( "[PlotMover] Warning: Failed to copy plot manifest %s to %s. It was left in the staging directory.",
+            srcPath.c_str(), dstPath.c_str() );
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <mutex>
+#include <condition_variable>
+#include <string>
+#include <deque>
+#include <vector>
+
+class Thread;
+
+/**
+ * Moves finished plots from a fast staging directory (--stage-dir) to their final output directory, in the background.
+ * Each destination directory has a single mover thread, so that a destination disk only ever sees one sequential
+ * stream of large (direct I/O) writes. Plots are deleted from the staging directory as soon as they have landed.
+ */
+class PlotMover
+{
+public:
+    PlotMover( bool useDirectIO );
+
+    // Waits for all queued plots to be moved
+    ~PlotMover();
+
+    // Queues a finished plot in the staging directory to be moved to destDir
+    void Move( const char* stagedPlotPath, const char* destDir );
+
+    // Blocks until all queued plots have been moved
+    void WaitForMoves();
+
+    // Number of plots queued or being moved to destDir
+    uint32 GetPendingCount( const char* destDir );
+
+private:
+    struct Destination
+    {
+        PlotMover*              mover  = nullptr;
+        Thread*                 thread = nullptr;
+        std::string             dir;
+        std::deque<std::string> plots;              // Staged plot paths, in submission order
+        uint32                  pending = 0;        // Queued plots + the one being moved
+    };
+
+    static void MoverThreadEntry( Destination* dest );
+    void MoverThreadMain( Destination& dest );
+
+    bool MovePlot( const std::string& stagedPath, const std::string& destDir );
+    bool CopyPlot( const char* srcPath, const char* dstPath, int32& error );
+
+private:
+    std::mutex                _lock;
+    std::condition_variable   _signal;
+    std::vector<Destination*> _destinations;
+    bool                      _directIO;
+    bool                      _exit = false;
+};
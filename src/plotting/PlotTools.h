@@ -1,25 +1,14 @@
 #pragma once
 #include "ChiaConsts.h"
 #include "util/KeyTools.h"
-#include "util/BitView.h"
-
-#define PROOF_X_COUNT       64
-#define MAX_K_SIZE          50
-#define MAX_META_MULTIPLIER 4
-#define MAX_Y_BIT_SIZE      ( MAX_K_SIZE + kExtraBits )
-#define MAX_META_BIT_SIZE   ( MAX_K_SIZE * MAX_META_MULTIPLIER )
-#define MAX_FX_BIT_SIZE     ( MAX_Y_BIT_SIZE + MAX_META_BIT_SIZE + MAX_META_BIT_SIZE )
-
-typedef Bits<MAX_Y_BIT_SIZE>    YBits;
-typedef Bits<MAX_META_BIT_SIZE> MetaBits;
-typedef Bits<MAX_FX_BIT_SIZE>   FxBits;
+#include "plotting/ProofBits.h"
 
 typedef unsigned FSE_CTable;
 typedef unsigned FSE_DTable;
 
 struct PlotTools
 {
-    static void GenPlotFileName( const byte plotId[BB_PLOT_ID_LEN], char outPlotFileName[BB_COMPRESSED_PLOT_FILE_LEN_TMP], uint32 compressionLevel );
+    static void GenPlotFileName( const byte plotId[BB_PLOT_ID_LEN], char outPlotFileName[BB_COMPRESSED_PLOT_FILE_LEN_TMP], uint32 compressionLevel, uint32 k = 32 );
     static void PlotIdToString( const byte plotId[BB_PLOT_ID_LEN], char plotIdString[BB_PLOT_ID_HEX_LEN+1] );
 
     static bool PlotStringToId( const char plotIdString[BB_PLOT_ID_HEX_LEN+1], byte plotId[BB_PLOT_ID_LEN] );
@@ -2,4 +2,268 @@
 
 #include "pos/chacha8.h"
 #include "b3/blake3.h"
+#include <memory>
 
+// Proofs validated at once. Bounds the per-thread buffers to a few hundred KiB.
+static constexpr uint32 VALIDATION_BATCH_SIZE = 16;
+static constexpr uint32 BATCH_X_COUNT         = VALIDATION_BATCH_SIZE * PROOF_X_COUNT;
+static constexpr uint32 FX_INPUT_STRIDE       = 64;
+
+struct ProofBatchBuffers
+{
+    uint64   blockPositions[BATCH_X_COUNT * 2];         // A y may span 2 ChaCha blocks
+    byte     blocks        [BATCH_X_COUNT * 2 * kF1BlockSize];
+    uint64   fx            [BATCH_X_COUNT];
+    MetaBits meta          [BATCH_X_COUNT];
+    byte     hashInputs    [BATCH_X_COUNT / 2 * FX_INPUT_STRIDE];
+    byte     hashes        [BATCH_X_COUNT / 2 * BLAKE3_OUT_LEN];
+};
+
+/// Serializes the input of an Fx hash into inputBytes and returns its size.
+/// Tables 2 and 3 pass their metadata through, which is written to outMeta.
+//-----------------------------------------------------------
+inline static size_t FxInput( const TableId table, const uint32 k,
+                              const uint64 y, const MetaBits& metaL, const MetaBits& metaR,
+                              byte inputBytes[FX_INPUT_STRIDE], MetaBits& outMeta )
+{
+    FxBits input( y, k + kExtraBits );
+
+    if( table < TableId::Table4 )
+    {
+        outMeta = metaL + metaR;
+        input += outMeta;
+    }
+    else
+    {
+        input += metaL;
+        input += metaR;
+    }
+
+    input.ToBytes( inputBytes );
+    return input.LengthBytes();
+}
+
+/// Extracts the y, and from tables 4 to 6 the metadata, from an Fx hash
+//-----------------------------------------------------------
+inline static void FxOutput( const TableId table, const uint32 k, const byte hashBytes[BLAKE3_OUT_LEN],
+                             uint64& outY, MetaBits& outMeta )
+{
+    outY = BytesToUInt64( hashBytes ) >> ( 64 - (k + kExtraBits) );
+
+    if( table >= TableId::Table4 && table < TableId::Table7 )
+    {
+        size_t multiplier = 0;
+        switch( table )
+        {
+            case TableId::Table4: multiplier = TableMetaOut<TableId::Table4>::Multiplier; break;
+            case TableId::Table5: multiplier = TableMetaOut<TableId::Table5>::Multiplier; break;
+            case TableId::Table6: multiplier = TableMetaOut<TableId::Table6>::Multiplier; break;
+            default:
+                ASSERT( 0 );
+                break;
+        }
+
+        const uint32 metaBits  = (uint32)( k * multiplier );
+        const uint32 yBits     = k + kExtraBits;
+        const uint32 startByte = yBits / 8 ;
+        const uint32 startBit  = yBits - startByte * 8;
+
+        outMeta = MetaBits( hashBytes + startByte, metaBits, startBit );
+    }
+}
+
+//-----------------------------------------------------------
+bool ValidateFullProof( const uint32 k, const byte plotId[BB_PLOT_ID_LEN], uint64 fullProofXs[PROOF_X_COUNT], uint64& outF7 )
+{
+    bool valid = false;
+    PlotValidation::ValidateFullProofs( k, plotId, 1, fullProofXs, &outF7, &valid );
+
+    return valid;
+}
+
+//-----------------------------------------------------------
+void PlotValidation::ValidateFullProofs( const uint32 k, const byte plotId[BB_PLOT_ID_LEN], const uint32 proofCount,
+                                         const uint64* proofXs, uint64* outF7s, bool* outValid )
+{
+    LoadLTargets();
+
+    thread_local std::unique_ptr<ProofBatchBuffers> buffers;
+    if( !buffers )
+        buffers = std::make_unique<ProofBatchBuffers>();
+
+    uint64*   fx   = buffers->fx;
+    MetaBits* meta = buffers->meta;
+
+    // Prepare ChaCha key
+    byte key[32] = { 1 };
+    memcpy( key + 1, plotId, 31 );
+
+    chacha8_ctx chacha;
+    chacha8_keysetup( &chacha, key, 256, NULL );
+
+    const uint32 xShift = k - kExtraBits;
+
+    for( uint32 batchStart = 0; batchStart < proofCount; batchStart += VALIDATION_BATCH_SIZE )
+    {
+        const uint32  batchCount = std::min( proofCount - batchStart, VALIDATION_BATCH_SIZE );
+        const uint32  xCount     = batchCount * PROOF_X_COUNT;
+        const uint64* xs         = proofXs + (uint64)batchStart * PROOF_X_COUNT;
+
+        // Convert the x's to f1 values, generating the ChaCha blocks of all of them at once
+        for( uint32 i = 0; i < xCount; i++ )
+        {
+            const uint64 blockIdx = xs[i] * k / kF1BlockSizeBits;
+
+            buffers->blockPositions[i*2+0] = blockIdx;
+            buffers->blockPositions[i*2+1] = blockIdx + 1;
+        }
+
+        chacha8_get_keystream_blocks( &chacha, buffers->blockPositions, xCount * 2, buffers->blocks );
+
+        for( uint32 i = 0; i < xCount; i++ )
+        {
+            const uint64 x        = xs[i];
+            const uint64 bitStart = x * k - buffers->blockPositions[i*2] * kF1BlockSizeBits;
+
+            CPBitReader hashBits( buffers->blocks + (size_t)i * kF1BlockSize * 2, kF1BlockSize * 2 * 8 );
+            hashBits.Seek( bitStart );
+
+            const uint64 y = hashBits.Read64( k );
+
+            fx  [i] = ( y << kExtraBits ) | ( x >> xShift );
+            meta[i] = MetaBits( x, k );
+        }
+
+        // Proofs that are still valid, as indices into the batch
+        uint32 active[VALIDATION_BATCH_SIZE];
+        uint32 activeCount = batchCount;
+
+        for( uint32 p = 0; p < batchCount; p++ )
+        {
+            active[p]                = p;
+            outValid[batchStart + p] = false;
+        }
+
+        // Forward propagate f1 values to get the final f7, hashing a whole table level across proofs at once
+        uint32 iterCount = PROOF_X_COUNT;
+        for( TableId table = TableId::Table2; table <= TableId::Table7 && activeCount > 0; table++, iterCount >>= 1 )
+        {
+            const uint32 pairCount   = iterCount / 2;
+            uint32       inputCount  = 0;
+            uint32       matchCount  = 0;
+            size_t       inputLength = 0;
+
+            for( uint32 a = 0; a < activeCount; a++ )
+            {
+                const uint32 proofStart = active[a] * PROOF_X_COUNT;
+                const uint32 firstInput = inputCount;
+                bool         matched    = true;
+
+                for( uint32 i = 0, dst = proofStart; i < iterCount; i += 2, dst++ )
+                {
+                    uint64 y0 = fx[proofStart+i+0];
+                    uint64 y1 = fx[proofStart+i+1];
+
+                    const MetaBits* lMeta = &meta[proofStart+i+0];
+                    const MetaBits* rMeta = &meta[proofStart+i+1];
+
+                    if( y0 > y1 )
+                    {
+                        std::swap( y0, y1 );
+                        std::swap( lMeta, rMeta );
+                    }
+
+                    // Must be on the same group
+                    if( !FxMatch( y0, y1 ) )
+                    {
+                        matched = false;
+                        break;
+                    }
+
+                    // The entries written here have already been read, since dst trails i
+                    inputLength = FxInput( table, k, y0, *lMeta, *rMeta,
+                                           buffers->hashInputs + (size_t)inputCount * FX_INPUT_STRIDE, meta[dst] );
+                    inputCount++;
+                }
+
+                if( matched )
+                    active[matchCount++] = active[a];
+                else
+                    inputCount = firstInput;
+            }
+
+            activeCount = matchCount;
+            ASSERT( inputCount == activeCount * pairCount );
+
+            if( inputCount == 0 )
+                break;
+
+            blake3_hash_short_many( buffers->hashInputs, FX_INPUT_STRIDE, inputLength, inputCount, buffers->hashes );
+
+            for( uint32 a = 0, h = 0; a < activeCount; a++ )
+            {
+                const uint32 proofStart = active[a] * PROOF_X_COUNT;
+
+                for( uint32 dst = proofStart; dst < proofStart + pairCount; dst++, h++ )
+                    FxOutput( table, k, buffers->hashes + (size_t)h * BLAKE3_OUT_LEN, fx[dst], meta[dst] );
+            }
+        }
+
+        for( uint32 a = 0; a < activeCount; a++ )
+        {
+            const uint32 p = active[a];
+
+            outF7s  [batchStart + p] = fx[p * PROOF_X_COUNT] >> kExtraBits;
+            outValid[batchStart + p] = true;
+        }
+    }
+}
+
+//-----------------------------------------------------------
+bool PlotValidation::FxMatch( uint64 yL, uint64 yR )
+{
+    LoadLTargets();
+
+    const uint64 groupL = yL / kBC;
+    const uint64 groupR = yR / kBC;
+
+    if( groupR - groupL != 1 )
+        return false;
+
+    // Groups are adjacent, check if the y values actually match
+    const uint16 parity = groupL & 1;
+
+    const uint64 groupLRangeStart = groupL * kBC;
+    const uint64 groupRRangeStart = groupR * kBC;
+
+    const uint64 localLY = yL - groupLRangeStart;
+    const uint64 localRY = yR - groupRRangeStart;
+
+    for( int iK = 0; iK < kExtraBitsPow; iK++ )
+    {
+        const uint64 targetR = L_targets[parity][localLY][iK];
+
+        if( targetR == localRY )
+            return true;
+    }
+
+    return false;
+}
+
+//-----------------------------------------------------------
+void PlotValidation::FxGen( const TableId table, const uint32 k,
+                            const uint64 y, const MetaBits& metaL, const MetaBits& metaR,
+                            uint64& outY, MetaBits& outMeta )
+{
+    byte inputBytes[FX_INPUT_STRIDE];
+    byte hashBytes [BLAKE3_OUT_LEN];
+
+    const size_t inputLength = FxInput( table, k, y, metaL, metaR, inputBytes, outMeta );
+
+    blake3_hasher hasher;
+    blake3_hasher_init    ( &hasher );
+    blake3_hasher_update  ( &hasher, inputBytes, inputLength );
+    blake3_hasher_finalize( &hasher, hashBytes, sizeof( hashBytes ) );
+
+    FxOutput( table, k, hashBytes, outY, outMeta );
+}
@@ -1,8 +1,8 @@
 #pragma once
 
-#include "plotting/PlotTools.h"
+#include "plotting/ProofBits.h"
+#include "plotting/Tables.h"
 
-// #NOTE: For now it is implemented in PlotValidator.cpp
 bool ValidateFullProof( const uint32 k, const byte plotId[BB_PLOT_ID_LEN], uint64 fullProofXs[PROOF_X_COUNT], uint64& outF7 );
 
 namespace PlotValidation
@@ -11,13 +11,17 @@ namespace PlotValidation
     {
         return ::ValidateFullProof( k, plotId, fullProofXs, outF7 );
     }
-    
-    static uint64 BytesToUInt64( const byte bytes[8] );
-    static uint64 SliceUInt64FromBits( const byte* bytes, uint32 bitOffset, uint32 bitCount );
 
-    static bool FxMatch( uint64 yL, uint64 yR );
+    // Validates proofCount full proofs from the same plot together.
+    // proofXs holds PROOF_X_COUNT x's per proof. F1 is generated for all of the x's at once,
+    // and each table's Fx hashes are computed across all proofs still valid, in SIMD lanes.
+    // outValid[i] is set if proof i is valid, in which case outF7s[i] holds its f7.
+    void ValidateFullProofs( uint32 k, const byte plotId[BB_PLOT_ID_LEN], uint32 proofCount,
+                             const uint64* proofXs, uint64* outF7s, bool* outValid );
 
-    static void FxGen( const TableId table, const uint32 k, 
-                       const uint64 y, const MetaBits& metaL, const MetaBits& metaR,
-                       uint64& outY, MetaBits& outMeta );
-};
\ No newline at end of file
+    bool FxMatch( uint64 yL, uint64 yR );
+
+    void FxGen( const TableId table, const uint32 k, 
+                const uint64 y, const MetaBits& metaL, const MetaBits& metaR,
+                uint64& outY, MetaBits& outMeta );
+};
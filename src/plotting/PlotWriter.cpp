@@ -3,6 +3,140 @@
 #include "plotdisk/jobs/IOJob.h"
 #include "plotdisk/DiskBufferQueue.h"
 #include "harvesting/GreenReaper.h"
+#include "plotting/Compression.h"
+#include "PlotMover.h"
+#include "threading/ThreadAffinity.h"
+#include "util/Trace.h"
+#include <vector>
+
+// Number of plots currently being written, per output directory
+static std::mutex                                   _activeDirsLock;
+static std::vector<std::pair<std::string, uint32>>  _activeDirs;
+
+static void AddActivePlotDir( const std::string& dir, int32 delta );
+static void FinishPlotFile( const std::string& tmpPath, const std::string& manifest, const std::string& activePlotDir, bool rename );
+static void WriteManifest( const std::string& plotPath, const std::string& manifest );
+
+// Set with --stage-dir. Plots are written here first, then moved to their output directory.
+static std::string _stageDir;
+static PlotMover*  _plotMover = nullptr;
+
+// Set with --manifest
+static bool _writeManifests = false;
+
+// Set with --plot-write-depth
+static uint32 _writeQueueDepth = 1;
+
+static constexpr size_t ALIGN_BUFFER_SIZE = 4 MiB;
+
+static const byte _zeroPage[BB_PLOT_PAGE_SIZE] = {};
+
+// Size of the parks of a table, or 0 if it is not made of parks
+static size_t GetTableParkSize( PlotTable table, uint32 k, uint32 compressionLevel );
+
+//-----------------------------------------------------------
+PlotWriteStaging::PlotWriteStaging( const size_t budget )
+    : _budget( budget )
+{}
+
+//-----------------------------------------------------------
+byte* PlotWriteStaging::Stage( const void* data, const size_t size )
+{
+    ASSERT( size );
+    {
+        std::unique_lock lock( _lock );
+
+        // Always allow at least one staged buffer, so that a buffer larger than the budget can't deadlock
+        _releasedSignal.wait( lock, [&]() {
+            return _stagedSize == 0 || _stagedSize + size <= _budget;
+        });
+
+        _stagedSize += size;
+    }
+
+    byte* buffer = (byte*)malloc( size );
+    FatalIf( !buffer, "Failed to allocate %llu bytes of plot staging memory.", (llu)size );
+
+    memcpy( buffer, data, size );
+    return buffer;
+}
+
+//-----------------------------------------------------------
+void PlotWriteStaging::Release( byte* buffer, const size_t size )
+{
+    free( buffer );
+
+    {
+        std::unique_lock lock( _lock );
+        ASSERT( _stagedSize >= size );
+        _stagedSize -= size;
+    }
+
+    _releasedSignal.notify_all();
+}
+
+//-----------------------------------------------------------
+uint32 PlotWriter::GetActivePlotCount( const char* plotFileDir )
+{
+    std::unique_lock lock( _activeDirsLock );
+
+    const uint32 movingCount = _plotMover ? _plotMover->GetPendingCount( plotFileDir ) : 0;
+
+    for( auto& dir : _activeDirs )
+    {
+        if( dir.first == plotFileDir )
+            return dir.second + movingCount;
+    }
+
+    return movingCount;
+}
+
+//-----------------------------------------------------------
+void PlotWriter::EnableStageDir( const char* stageDir, const bool useDirectIO )
+{
+    ASSERT( stageDir && *stageDir );
+    ASSERT( !_plotMover );
+
+    _stageDir  = stageDir;
+    _plotMover = new PlotMover( useDirectIO );
+}
+
+//-----------------------------------------------------------
+void PlotWriter::WaitForPlotMoves()
+{
+    if( _plotMover )
+        _plotMover->WaitForMoves();
+}
+
+//-----------------------------------------------------------
+void PlotWriter::EnableManifests()
+{
+    _writeManifests = true;
+}
+
+//-----------------------------------------------------------
+void PlotWriter::SetWriteQueueDepth( const uint32 depth )
+{
+    _writeQueueDepth = std::max( 1u, std::min( depth, MAX_WRITE_QUEUE_DEPTH ) );
+}
+
+//-----------------------------------------------------------
+void AddActivePlotDir( const std::string& dir, const int32 delta )
+{
+    std::unique_lock lock( _activeDirsLock );
+
+    for( auto& d : _activeDirs )
+    {
+        if( d.first == dir )
+        {
+            d.second = (uint32)( (int32)d.second + delta );
+            return;
+        }
+    }
+
+    ASSERT( delta > 0 );
+    _activeDirs.push_back( { dir, (uint32)delta } );
+}
 
 //-----------------------------------------------------------
 PlotWriter::PlotWriter() : PlotWriter( true ) {}
@@ -41,25 +175,45 @@ PlotWriter::~PlotWriter()
         free( _plotFinalPathName );
     if( _writeBuffer.Ptr() )
         bbvirtfree( _writeBuffer.Ptr() );
+    if( _alignBuffer.Ptr() )
+        bbvirtfree_span( _alignBuffer );
 }
 
 //-----------------------------------------------------------
-void PlotWriter::EnablePlotChecking( PlotChecker& checker )
+void PlotWriter::EnablePlotChecking( PlotChecker& checker, PlotCheckQueue* checkQueue )
 {
     _plotChecker = &checker;
+    _checkQueue  = checkQueue;
+}
+
+//-----------------------------------------------------------
+void PlotWriter::EnableStaging( PlotWriteStaging& staging )
+{
+    ASSERT( !_plotActive );
+    _staging = &staging;
 }
 
 //-----------------------------------------------------------
 bool PlotWriter::BeginPlot( PlotVersion version, 
     const char* plotFileDir, const char* plotFileName, const byte plotId[32],
-    const byte* plotMemo, const uint16 plotMemoSize, const uint32 compressionLevel )
+    const byte* plotMemo, const uint16 plotMemoSize, const uint32 compressionLevel, const PlotFlags extraFlags, const uint32 k )
 {
     _readyToPlotSignal.Wait();
 
-    const bool r = BeginPlotInternal( version, plotFileDir, plotFileName, plotId, plotMemo, plotMemoSize, compressionLevel );
+    // When staging, the plot is written to the stage directory and moved to plotFileDir once completed.
+    // Plots streamed to a receiver are never staged.
+    const char* writeDir = _plotMover && plotFileDir && !NetStream::IsNetPath( plotFileDir ) ? _stageDir.c_str() : plotFileDir;
+
+    const bool r = BeginPlotInternal( version, writeDir, plotFileName, plotId, plotMemo, plotMemoSize, compressionLevel, extraFlags, k );
 
     if( !r )
         _readyToPlotSignal.Signal();
+    else if( !_dummyMode )
+    {
+        _activePlotDir = plotFileDir;
+        AddActivePlotDir( _activePlotDir, 1 );
+        _plotActive.store( true, std::memory_order_release );
+    }
 
     return r;
 }
@@ -79,14 +233,14 @@ bool PlotWriter::BeginPlot( PlotVersion version,
 bool PlotWriter::BeginPlotInternal( PlotVersion version,
         const char* plotFileDir, const char* plotFileName, const byte plotId[32],
         const byte* plotMemo, const uint16 plotMemoSize,
-        int32 compressionLevel )
+        int32 compressionLevel, const PlotFlags extraFlags, const uint32 k )
 {
     if( _dummyMode ) return true;
 
-    ASSERT( !_stream.IsOpen() );
+    ASSERT( !IsStreamOpen() );
 
     // Ensure we don't start a 
-    if( _stream.IsOpen() )
+    if( IsStreamOpen() )
         return false;
 
     if( !plotFileDir || !*plotFileDir || !plotFileDir || !*plotFileName )
@@ -96,42 +250,38 @@ bool PlotWriter::BeginPlotInternal( PlotVersion version,
         return false;
 
     ASSERT( compressionLevel >= 0 && compressionLevel <= 9 );
+    ASSERT( k >= BB_CHIA_K_MIN_VALUE && k <= 32 );
+    ASSERT( k == 32 || compressionLevel == 0 );
 
-    if( compressionLevel > 0 && version < PlotVersion::v2_0 )
+    if( ( compressionLevel > 0 || extraFlags != PlotFlags::None ) && version < PlotVersion::v2_0 )
         return false;
 
     /// Copy plot file path
-    {
-        const size_t dirLength   = strlen( plotFileDir  );
-        const size_t nameLength  = strlen( plotFileName );
-        const size_t nameBufSize = dirLength + nameLength + 2;
-
-        if( _plotPathBuffer.length < nameBufSize )
-        {
-            _plotPathBuffer.values = (char*)realloc( _plotPathBuffer.values, nameBufSize );
-            _plotPathBuffer.length = nameBufSize;
-        }
+    SetPlotPath( plotFileDir, plotFileName );
 
-        auto plotFilePath = _plotPathBuffer;
+    /// Open the plot file
+    //  #NOTE: We need to read access because we allow seeking, but in order to
+    //         remain block-aligned, we might have to read data from the seek location.
+    const bool isNetPlot = NetStream::IsNetPath( plotFileDir );
 
-        memcpy( plotFilePath.Ptr(), plotFileDir, dirLength );
-        plotFilePath = plotFilePath.Slice( dirLength );
-        if( plotFileDir[dirLength-1] != '/' && plotFileDir[dirLength-1] != '\\' )
+    if( isNetPlot )
+    {
+        if( !_netStream.Open( plotFileDir, plotFileName ) )
         {
-            *plotFilePath.values = '/';
-            plotFilePath = plotFilePath.Slice( 1 );
+            Log::Line( "[PlotWriter] Error: Failed to open plot %s on the receiver with error: %d.", _plotPathBuffer.Ptr(), _netStream.GetError() );
+            return false;
         }
 
-        memcpy( plotFilePath.Ptr(), plotFileName, nameLength );
-        plotFilePath[nameLength] = 0;
+        _out = &_netStream;
     }
+    else
+    {
+        const FileFlags flags = FileFlags::LargeFile | ( _directIO ? FileFlags::NoBuffering : FileFlags::None );
+        if( !_stream.Open( _plotPathBuffer.Ptr(), FileMode::Create, FileAccess::ReadWrite, flags ) )
+            return false;
 
-    /// Open the plot file
-    //  #NOTE: We need to read access because we allow seeking, but in order to
-    //         remain block-aligned, we might have to read data from the seek location.
-    const FileFlags flags = FileFlags::LargeFile | ( _directIO ? FileFlags::NoBuffering : FileFlags::None );
-    if( !_stream.Open( _plotPathBuffer.Ptr(), FileMode::Create, FileAccess::ReadWrite, flags ) )
-        return false;
+        _out = &_stream;
+    }
 
     /// Make the header
     size_t headerSize = 0;
@@ -165,20 +315,14 @@ bool PlotWriter::BeginPlotInternal( PlotVersion version,
 
         if( compressionLevel > 0 )
             headerSize += 1;
+
+        if( IsFlagSet( extraFlags, PlotFlags::TunedDeltas ) )
+            headerSize += sizeof( _deltaRValues );
     }
     else
         return false;
 
-    if( _writeBuffer.Ptr() == nullptr )
-    {
-        const size_t allocSize = RoundUpToNextBoundaryT( BUFFER_ALLOC_SIZE, _stream.BlockSize() );
-
-        if( _writeBuffer.Ptr() && allocSize > _writeBuffer.Length() )
-            bbvirtfree_span( _writeBuffer );
-
-        _writeBuffer.values = bbvirtalloc<byte>( allocSize );
-        _writeBuffer.length = allocSize;
-    }
+    AllocWriteBuffer();
 
     _headerSize = headerSize;
 
@@ -195,7 +339,7 @@ bool PlotWriter::BeginPlotInternal( PlotVersion version,
         headerWriter += 32;
 
         // K
-        *headerWriter++ = (byte)_K;
+        *headerWriter++ = (byte)k;
 
         // Format description
         *((uint16*)headerWriter) = Swap16( (uint16)(sizeof( kFormatDescription ) - 1) );
@@ -227,7 +371,7 @@ bool PlotWriter::BeginPlotInternal( PlotVersion version,
         headerWriter += 32;
 
         // K
-        *headerWriter++ = (byte)_K;
+        *headerWriter++ = (byte)k;
 
         // Memo
         *((uint16*)headerWriter) = Swap16( plotMemoSize );
@@ -236,7 +380,7 @@ bool PlotWriter::BeginPlotInternal( PlotVersion version,
         headerWriter += plotMemoSize;
 
         // Flags
-        PlotFlags flags = PlotFlags::None;
+        PlotFlags flags = extraFlags;
         static_assert( sizeof( flags ) == 4 );
 
         if( compressionLevel > 0 )
@@ -247,6 +391,10 @@ bool PlotWriter::BeginPlotInternal( PlotVersion version,
         if( compressionLevel > 0 )
             *headerWriter++ = (byte)compressionLevel;
 
+        // Delta R values, written with the table pointers
+        if( IsFlagSet( flags, PlotFlags::TunedDeltas ) )
+            headerWriter += sizeof( _deltaRValues );
+
         // Empty tables pointer and sizes
         headerWriter += sizeof( _tablePointers ) * 2;
 
@@ -254,9 +402,14 @@ bool PlotWriter::BeginPlotInternal( PlotVersion version,
     }
 
     // Write header, block-aligned, tables will start at the aligned position
-    const ssize_t headerWriteSize = (ssize_t)RoundUpToNextBoundaryT( _headerSize, _stream.BlockSize() );
-    FatalIf( headerWriteSize != _stream.Write( _writeBuffer.Ptr(), (size_t)headerWriteSize ),
-        "Failed to write plot header with error: %d.", _stream.GetError() );
+    const ssize_t headerWriteSize = (ssize_t)RoundUpToNextBoundaryT( _headerSize, _out->BlockSize() );
+
+    // Preallocate the expected plot size, so that the file is laid out in as few extents as possible,
+    // even when several plots are written to the same disk. The unused space is released by EndPlot.
+    _preallocated = !isNetPlot && _stream.Reserve( headerWriteSize + (ssize_t)CalculatePlotSizeBytes( k, (uint32)compressionLevel ) );
+
+    FatalIf( headerWriteSize != _out->Write( _writeBuffer.Ptr(), (size_t)headerWriteSize ),
+        "Failed to write plot header with error: %d.", _out->GetError() );
 
     // Reset state
     _plotVersion        = version;
@@ -264,6 +417,7 @@ bool PlotWriter::BeginPlotInternal( PlotVersion version,
     _haveTable          = false;
     _currentTable       = PlotTable::Table1;
     _position           = headerWriteSize;
+    _submitPosition     = (size_t)headerWriteSize;
     // _tablesBeginAddress = headerWriteSize;
     _tableStart         = 0;
     _unalignedFileSize  = headerWriteSize;
@@ -271,16 +425,205 @@ bool PlotWriter::BeginPlotInternal( PlotVersion version,
 
     memset( _tablePointers, 0, sizeof( _tablePointers ) );
     memset( _tableSizes   , 0, sizeof( _tablePointers ) );
+    memset( _deltaRValues , 0, sizeof( _deltaRValues  ) );
+
+    _alignedParks     = IsFlagSet( extraFlags, PlotFlags::AlignedParks );
+    _tunedDeltas      = IsFlagSet( extraFlags, PlotFlags::TunedDeltas );
+    _compressionLevel = (uint32)compressionLevel;
+    _k                = k;
+    _parkLayout       = {};
+
+    if( _alignedParks && !_alignBuffer.Ptr() )
+        _alignBuffer = Span<byte>( bbvirtalloc<byte>( ALIGN_BUFFER_SIZE ), ALIGN_BUFFER_SIZE );
+
+    // The manifest is written next to the plot, which is not on this machine when streamed
+    _hashTables = _writeManifests && !isNetPlot;
+    if( _writeManifests && isNetPlot )
+        Log::Line( "[PlotWriter] Warning: No manifest will be written for streamed plot %s.", _plotPathBuffer.Ptr() );
+
+    if( _hashTables )
+    {
+        for( auto& hasher : _tableHashers )
+            blake3_hasher_init( &hasher );
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------
+void PlotWriter::SetPlotPath( const char* plotFileDir, const char* plotFileName )
+{
+    const size_t dirLength   = strlen( plotFileDir  );
+    const size_t nameLength  = strlen( plotFileName );
+    const size_t nameBufSize = dirLength + nameLength + 2;
+
+    if( _plotPathBuffer.length < nameBufSize )
+    {
+        _plotPathBuffer.values = (char*)realloc( _plotPathBuffer.values, nameBufSize );
+        _plotPathBuffer.length = nameBufSize;
+    }
+
+    auto plotFilePath = _plotPathBuffer;
+
+    memcpy( plotFilePath.Ptr(), plotFileDir, dirLength );
+    plotFilePath = plotFilePath.Slice( dirLength );
+    if( plotFileDir[dirLength-1] != '/' && plotFileDir[dirLength-1] != '\\' )
+    {
+        *plotFilePath.values = '/';
+        plotFilePath = plotFilePath.Slice( 1 );
+    }
+
+    memcpy( plotFilePath.Ptr(), plotFileName, nameLength );
+    plotFilePath[nameLength] = 0;
+}
+
+//-----------------------------------------------------------
+void PlotWriter::AllocWriteBuffer()
+{
+    if( _writeBuffer.Ptr() == nullptr )
+    {
+        const size_t allocSize = RoundUpToNextBoundaryT( BUFFER_ALLOC_SIZE, _out->BlockSize() ) * _writeQueueDepth;
+
+        if( _writeBuffer.Ptr() && allocSize > _writeBuffer.Length() )
+            bbvirtfree_span( _writeBuffer );
+
+        _writeBuffer.values = bbvirtalloc<byte>( allocSize );
+        _writeBuffer.length = allocSize;
+    }
+}
+
+//-----------------------------------------------------------
+bool PlotWriter::ResumePlot( const char* plotFileDir, const char* plotFileName, const PlotWriterState& state )
+{
+    _readyToPlotSignal.Wait();
+
+    const char* writeDir = _plotMover && plotFileDir ? _stageDir.c_str() : plotFileDir;
+
+    const bool r = ResumePlotInternal( writeDir, plotFileName, state );
+
+    if( !r )
+        _readyToPlotSignal.Signal();
+    else if( !_dummyMode )
+    {
+        _activePlotDir = plotFileDir;
+        AddActivePlotDir( _activePlotDir, 1 );
+        _plotActive.store( true, std::memory_order_release );
+    }
+
+    return r;
+}
+
+//-----------------------------------------------------------
+bool PlotWriter::ResumePlotInternal( const char* plotFileDir, const char* plotFileName, const PlotWriterState& state )
+{
+    if( _dummyMode ) return true;
+
+    ASSERT( !IsStreamOpen() );
+    if( IsStreamOpen() )
+        return false;
+
+    if( !plotFileDir || !*plotFileDir || !plotFileName || !*plotFileName )
+        return false;
+
+    if( NetStream::IsNetPath( plotFileDir ) )
+    {
+        Log::Line( "[PlotWriter] Error: Plots streamed to a receiver can't be resumed." );
+        return false;
+    }
+
+    if( state.headerSize == 0 || state.position < state.headerSize || state.fileSize < state.position )
+        return false;
+
+    SetPlotPath( plotFileDir, plotFileName );
+
+    const FileFlags flags = FileFlags::LargeFile | ( _directIO ? FileFlags::NoBuffering : FileFlags::None );
+    if( !_stream.Open( _plotPathBuffer.Ptr(), FileMode::Open, FileAccess::ReadWrite, flags ) )
+        return false;
+
+    _out = &_stream;
+
+    AllocWriteBuffer();
+
+    const size_t blockSize = _out->BlockSize();
+
+    _plotVersion        = state.version;
+    _headerSize         = state.headerSize;
+    _bufferBytes        = 0;
+    _haveTable          = false;
+    _currentTable       = PlotTable::Table1;
+    _tableStart         = 0;
+    _position           = state.position;
+    _submitPosition     = state.position;
+    _unalignedFileSize  = state.fileSize;
+    _alignedFileSize    = CDivT( (size_t)state.fileSize, blockSize ) * blockSize;  // SaveState wrote out the last block
+
+    memcpy( _tablePointers, state.tablePointers, sizeof( _tablePointers ) );
+    memcpy( _tableSizes   , state.tableSizes   , sizeof( _tableSizes    ) );
+
+    _alignedParks     = state.alignedParks != 0;
+    _tunedDeltas      = false;  // Only diskplot, which does not tune its deltas, resumes plots
+    _compressionLevel = state.compressionLevel;
+    _k                = _K;     // Only diskplot, which is k32-only, resumes plots
+    _parkLayout       = {};
+
+    if( _alignedParks && !_alignBuffer.Ptr() )
+        _alignBuffer = Span<byte>( bbvirtalloc<byte>( ALIGN_BUFFER_SIZE ), ALIGN_BUFFER_SIZE );
+
+    // We don't know whether the space was reserved, but truncating to what we wrote is harmless either way
+    _preallocated = true;
+
+    _hashTables = false;
+    if( _writeManifests )
+        Log::Line( "[PlotWriter] Warning: No manifest will be written for resumed plot %s.", _plotPathBuffer.Ptr() );
+
+    // Load the partial block at the write position
+    SeekToLocation( _position );
 
     return true;
 }
 
+//-----------------------------------------------------------
+void PlotWriter::SaveState( PlotWriterState& outState, Fence& fence )
+{
+    ASSERT( !_staging );
+
+    if( _dummyMode )
+    {
+        outState = {};
+        fence.Signal();
+        return;
+    }
+
+    CallBack( [this, &outState, &fence]() {
+
+        ASSERT( !_haveTable );
+
+        // Write out the block we retain, and re-load it, so that the file holds everything written so far
+        SeekToLocation( _position );
+
+        if( !_out->Flush() )
+            Log::Line( "[PlotWriter] Warning: Failed to sync plot file with error: %d", _out->GetError() );
+
+        outState.version          = _plotVersion;
+        outState.compressionLevel = _compressionLevel;
+        outState.alignedParks     = _alignedParks ? 1 : 0;
+        outState.headerSize       = _headerSize;
+        outState.position         = _position;
+        outState.fileSize         = _unalignedFileSize;
+
+        memcpy( outState.tablePointers, _tablePointers, sizeof( _tablePointers ) );
+        memcpy( outState.tableSizes   , _tableSizes   , sizeof( _tableSizes    ) );
+
+        fence.Signal();
+    });
+}
+
 //-----------------------------------------------------------
 void PlotWriter::EndPlot( const bool rename )
 {
     if( _dummyMode ) return;
 
-    ASSERT( _stream.IsOpen() );
+    ASSERT( IsStreamOpen() );
 
     // auto& cmd = GetCommand( CommandType::EndPlot );
     // cmd.endPlot.fence    = &_completedFence;
@@ -320,7 +663,7 @@ void PlotWriter::WaitForPlotToComplete()
     _completedFence.Wait();
 
     _headerSize = 0;
-    ASSERT( !_stream.IsOpen() );
+    ASSERT( !IsStreamOpen() );
 }
 
 //-----------------------------------------------------------
@@ -359,6 +702,9 @@ void PlotWriter::BeginTable( const PlotTable table )
 {
     if( _dummyMode ) return;
 
+    if( _alignedParks )
+        _submitPosition = RoundUpToNextBoundaryT( _submitPosition.load( std::memory_order_relaxed ), (size_t)BB_PLOT_PAGE_SIZE );
+
     SubmitCommand({
         .type = CommandType::BeginTable,
         .beginTable{ .table = table }
@@ -379,6 +725,12 @@ void PlotWriter::ReserveTableSize( const PlotTable table, const size_t size )
     // cmd.reserveTable.size  = size;
     // SubmitCommands();
 
+    _stagedReservedSizes[(int)table] = size;
+
+    if( _alignedParks )
+        _submitPosition = RoundUpToNextBoundaryT( _submitPosition.load( std::memory_order_relaxed ), (size_t)BB_PLOT_PAGE_SIZE );
+    _submitPosition += size;
+
      SubmitCommand({
         .type = CommandType::ReserveTable,
         .reserveTable { 
@@ -398,6 +750,16 @@ void PlotWriter::EndTable()
     SubmitCommand({ .type = CommandType::EndTable });
 }
 
+//-----------------------------------------------------------
+void PlotWriter::SetDeltaRValue( const PlotTable table, const double rValue )
+{
+    ASSERT( _tunedDeltas );
+    ASSERT( table <= PlotTable::Table6 );
+
+    // Read by the writer thread on EndPlot, which is submitted after this
+    _deltaRValues[(int)table] = EncodeDeltaRValue( rValue );
+}
+
 //-----------------------------------------------------------
 void PlotWriter::WriteTableData( const void* data, const size_t size )
 {
@@ -408,13 +770,27 @@ void PlotWriter::WriteTableData( const void* data, const size_t size )
     // cmd.writeTable.size   = size;
     // SubmitCommands();
 
+    const bool staged = _staging != nullptr && size > 0;
+
+    _submitPosition += size;
+
     SubmitCommand({ .type = CommandType::WriteTable,
-        .writeTable{ .buffer = (byte*)data,
+        .writeTable{ .buffer = staged ? _staging->Stage( data, size ) : (byte*)data,
                      .size   = size,
+                     .staged = staged
         }
     });
 }
 
+//-----------------------------------------------------------
+size_t PlotWriter::NextWriteBlockOffset() const
+{
+    if( _dummyMode )
+        return 0;
+
+    return _submitPosition.load( std::memory_order_relaxed ) % _out->BlockSize();
+}
+
 //-----------------------------------------------------------
 void PlotWriter::WriteReservedTable( const PlotTable table, const void* data )
 {
@@ -425,10 +801,14 @@ void PlotWriter::WriteReservedTable( const PlotTable table, const void* data )
     // cmd.writeReservedTable.buffer = (byte*)data;
     // SubmitCommands();
 
+    const size_t reservedSize = _stagedReservedSizes[(int)table];
+    const bool   staged       = _staging != nullptr && reservedSize > 0;
+
     SubmitCommand({ .type = CommandType::WriteReservedTable,
         .writeReservedTable{ 
             .table  = table,
-            .buffer = (byte*)data
+            .buffer = staged ? _staging->Stage( data, reservedSize ) : (byte*)data,
+            .staged = staged
         }
     });
 }
@@ -436,7 +816,8 @@ void PlotWriter::WriteReservedTable( const PlotTable table, const void* data )
 //-----------------------------------------------------------
 void PlotWriter::SignalFence( Fence& fence )
 {
-    if( _dummyMode ) 
+    // When staging, the caller's buffers have already been copied
+    if( _dummyMode || _staging ) 
     {
         fence.Signal();
         return;
@@ -457,7 +838,7 @@ void PlotWriter::SignalFence( Fence& fence )
 //-----------------------------------------------------------
 void PlotWriter::SignalFence( Fence& fence, uint32 sequence )
 {
-    if( _dummyMode )
+    if( _dummyMode || _staging )
     {
         fence.Signal( sequence );
         return;
@@ -478,7 +859,7 @@ void PlotWriter::SignalFence( Fence& fence, uint32 sequence )
 //-----------------------------------------------------------
 void PlotWriter::CallBack( std::function<void()> func )
 {
-    if( _dummyMode )
+    if( _dummyMode || _staging )
     {
         func();
         return;
@@ -576,6 +957,8 @@ void PlotWriter::SubmitCommands()
 //-----------------------------------------------------------
 void PlotWriter::WriterThreadEntry( PlotWriter* self )
 {
+    ThreadAffinity::PinCurrentIOThread();
+    BB_TRACE_THREAD_NAME( "Plot writer" );
     self->WriterThreadMain();
 }
 
@@ -650,6 +1033,8 @@ void PlotWriter::WriterThreadMain()
 //-----------------------------------------------------------
 void PlotWriter::ExecuteCommand( const Command& cmd )
 {
+    BB_TRACE_SCOPE( "PlotWriter::ExecuteCommand" );
+
     switch( cmd.type )
     {
         default: return;
@@ -679,7 +1064,7 @@ void PlotWriter::SeekToLocation( const size_t location )
     // - The seeked-to block is NOT the current block AND
     // - The seeked-to block already existed
 
-    const size_t blockSize              = _stream.BlockSize();
+    const size_t blockSize              = _out->BlockSize();
     // const size_t currentAlignedLocation = _position / blockSize * blockSize;
     const size_t alignedLocation        = location / blockSize * blockSize;
 
@@ -688,25 +1073,25 @@ void PlotWriter::SeekToLocation( const size_t location )
         FlushRetainedBytes();
         
         // Seek back to the location
-        FatalIf( !_stream.Seek( -(int64)blockSize, SeekOrigin::Current ),
-            "Plot file seek failed with error: %d", _stream.GetError() );
+        FatalIf( !_out->Seek( -(int64)blockSize, SeekOrigin::Current ),
+            "Plot file seek failed with error: %d", _out->GetError() );
     }
     ASSERT( _bufferBytes == 0 );
     
 
-    FatalIf( !_stream.Seek( (int64)alignedLocation, SeekOrigin::Begin ),
-        "Plot file seek failed with error: %d", _stream.GetError() );
+    FatalIf( !_out->Seek( (int64)alignedLocation, SeekOrigin::Begin ),
+        "Plot file seek failed with error: %d", _out->GetError() );
     
     // Read the block we just seeked-to,
     // unless it is at the unaligned end, and the end is block-aligned (start of a block)
     if( alignedLocation < _unalignedFileSize )
     {
-        FatalIf( (ssize_t)blockSize != _stream.Read( _writeBuffer.Ptr(), blockSize ),
-            "Plot file read failed with error: %d", _stream.GetError() );
+        FatalIf( (ssize_t)blockSize != _out->Read( _writeBuffer.Ptr(), blockSize ),
+            "Plot file read failed with error: %d", _out->GetError() );
 
         // Seek back to the location
-        FatalIf( !_stream.Seek( -(int64)blockSize, SeekOrigin::Current ),
-            "Plot file seek failed with error: %d", _stream.GetError() );
+        FatalIf( !_out->Seek( -(int64)blockSize, SeekOrigin::Current ),
+            "Plot file seek failed with error: %d", _out->GetError() );
     }
 
     _bufferBytes = location - alignedLocation;
@@ -718,7 +1103,7 @@ void PlotWriter::SeekToLocation( const size_t location )
 //-----------------------------------------------------------
 size_t PlotWriter::BlockAlign( const size_t size ) const
 {
-    return RoundUpToNextBoundaryT( size, _stream.BlockSize() );
+    return RoundUpToNextBoundaryT( size, _out->BlockSize() );
 }
 
 //-----------------------------------------------------------
@@ -726,7 +1111,7 @@ void PlotWriter::FlushRetainedBytes()
 {
     if( _bufferBytes > 0 )
     {
-        const size_t blockSize = _stream.BlockSize();
+        const size_t blockSize = _out->BlockSize();
         ASSERT( RoundUpToNextBoundaryT( _bufferBytes, blockSize ) == blockSize )
 
         int32 err;
@@ -741,11 +1126,9 @@ void PlotWriter::FlushRetainedBytes()
 //-----------------------------------------------------------
 void PlotWriter::WriteData( const byte* src, const size_t size )
 {
-    // #TODO: If the input data is aligned, and our position is aligned, bypass this.
-
     // Determine how many blocks will be written
     const size_t capacity    = _writeBuffer.Length();
-    const size_t blockSize   = _stream.BlockSize();
+    const size_t blockSize   = _out->BlockSize();
     ASSERT( _bufferBytes < blockSize );
 
     const size_t startBlock  = _position / blockSize;
@@ -754,7 +1137,6 @@ void PlotWriter::WriteData( const byte* src, const size_t size )
 
 
     byte* writeBuffer = _writeBuffer.Ptr();
-    int32 err         = 0;
 
     size_t sizeRemaining = _bufferBytes + size;                    // Data that we will keep in the temporary buffer for later writing
     size_t sizeToWrite   = sizeRemaining / blockSize * blockSize;  // Block-aligned data we can write
@@ -763,6 +1145,51 @@ void PlotWriter::WriteData( const byte* src, const size_t size )
     // will be written, we only need to copy over the size (no blocks filled)
     sizeRemaining = std::min( sizeRemaining - sizeToWrite, size );
 
+#if BB_HAS_FILE_IO_BATCH
+    bool queueWrites = sizeToWrite > 0 && _writeQueueDepth > 1 && _out == &_stream && !_writeBatchFailed;
+
+    if( queueWrites && !_writeBatch.IsInitialized() )
+    {
+        if( _writeBatch.Init( _writeQueueDepth ) )
+            _writeBatch.RegisterBuffer( _writeBuffer.Ptr(), _writeBuffer.Length() );
+        else
+        {
+            Log::Line( "Warning: Asynchronous plot writes are not available on this system. Writing one buffer at a time." );
+            _writeBatchFailed = true;
+            queueWrites       = false;
+        }
+    }
+
+    if( queueWrites )
+    {
+        src         = WriteBlocksQueued( src, sizeToWrite );
+        sizeToWrite = 0;
+    }
+#endif
+
+    // Data aligned in memory like it is in the file is written straight from src,
+    // once the block in progress in the write buffer has been completed with its first bytes.
+    if( sizeToWrite > 0 && ( (uintptr_t)src - _position ) % blockSize == 0 )
+    {
+        if( _bufferBytes > 0 )
+        {
+            const size_t headSize = blockSize - _bufferBytes;
+            memcpy( writeBuffer + _bufferBytes, src, headSize );
+
+            WriteBlocks( writeBuffer, blockSize );
+
+            src         += headSize;
+            sizeToWrite -= blockSize;
+            _bufferBytes = 0;
+        }
+
+        if( sizeToWrite > 0 )
+            WriteBlocks( src, sizeToWrite );
+
+        src         += sizeToWrite;
+        sizeToWrite  = 0;
+    }
+
     // Write as much block-aligned data as we can
     while( sizeToWrite )
     {
@@ -777,45 +1204,7 @@ void PlotWriter::WriteData( const byte* src, const size_t size )
         src         += copySize;
         _bufferBytes = 0;
 
-        ASSERT( writeSize / blockSize * blockSize == writeSize );
-
-
-        size_t totalSizeWritten = 0;
-        size_t sizeWritten      = 0;
-        while( !IOJob::WriteToFile( _stream, writeBuffer, writeSize, nullptr, blockSize, err, &sizeWritten ) )
-        {
-            ASSERT( writeSize / blockSize * blockSize == writeSize );
-
-            bool isOutOfSpace = false;
-
-            #if !defined( _WIN32 )
-                isOutOfSpace = err == ENOSPC;
-            #else
-                // #TODO: Add out of space error check for windows
-            #endif
-
-            // Wait indefinitely until there's more space
-            if( isOutOfSpace )
-            {
-                const long SLEEP_TIME = 10 * (long)1000;
-
-                Log::Line( "No space left in plot output directory for plot '%s'. Waiting %.1lf seconds before trying again...",
-                            this->_plotPathBuffer.Ptr(), (double)SLEEP_TIME/1000.0 );
-                Thread::Sleep( SLEEP_TIME );
-            }
-            else
-                Log::Line( "Error %d encountered when writing to plot '%s.", err, this->_plotPathBuffer.Ptr() );
-
-            totalSizeWritten += sizeWritten;
-            if( totalSizeWritten >= writeSize )
-                break;
-
-            ASSERT( sizeWritten >= writeSize );
-
-            writeBuffer += sizeWritten;
-            writeSize   -= sizeWritten;
-            sizeWritten = 0;
-        }
+        WriteBlocks( writeBuffer, writeSize );
     }
 
 
@@ -825,12 +1214,12 @@ void PlotWriter::WriteData( const byte* src, const size_t size )
     if( maxBlockWritten >= endBlock && endBlock > startBlock )
     {
         ASSERT( _bufferBytes == 0 );
-        PanicIf( _stream.Read( _writeBuffer.Ptr(), blockSize ) != (ssize_t)blockSize, 
-            "Plot file read failed: %d", _stream.GetError() );
+        PanicIf( _out->Read( _writeBuffer.Ptr(), blockSize ) != (ssize_t)blockSize, 
+            "Plot file read failed: %d", _out->GetError() );
         
         // Seek back to the last block
-        PanicIf( !_stream.Seek( -(int64)blockSize, SeekOrigin::Current ),
-            "Plot file seek failed: %d", _stream.GetError() );
+        PanicIf( !_out->Seek( -(int64)blockSize, SeekOrigin::Current ),
+            "Plot file seek failed: %d", _out->GetError() );
     }
 
     if( sizeRemaining > 0 )
@@ -846,6 +1235,248 @@ void PlotWriter::WriteData( const byte* src, const size_t size )
     _alignedFileSize   = std::max( _alignedFileSize, _unalignedFileSize / blockSize * blockSize );
 }
 
+//-----------------------------------------------------------
+void PlotWriter::WriteBlocks( const byte* data, size_t size )
+{
+    const size_t blockSize = _out->BlockSize();
+    ASSERT( size / blockSize * blockSize == size );
+
+    int32  err              = 0;
+    size_t totalSizeWritten = 0;
+    size_t sizeWritten      = 0;
+
+    while( !IOJob::WriteToFile( _stream, data, size, nullptr, blockSize, err, &sizeWritten ) )
+    {
+        ASSERT( size / blockSize * blockSize == size );
+
+        bool isOutOfSpace = false;
+
+        #if !defined( _WIN32 )
+            isOutOfSpace = err == ENOSPC;
+        #else
+            // #TODO: Add out of space error check for windows
+        #endif
+
+        // Wait indefinitely until there's more space
+        if( isOutOfSpace )
+        {
+            const long SLEEP_TIME = 10 * (long)1000;
+
+            Log::Line( "No space left in plot output directory for plot '%s'. Waiting %.1lf seconds before trying again...",
+                        this->_plotPathBuffer.Ptr(), (double)SLEEP_TIME/1000.0 );
+            Thread::Sleep( SLEEP_TIME );
+        }
+        else
+            Log::Line( "Error %d encountered when writing to plot '%s.", err, this->_plotPathBuffer.Ptr() );
+
+        totalSizeWritten += sizeWritten;
+        if( totalSizeWritten >= size )
+            break;
+
+        ASSERT( sizeWritten >= size );
+
+        data += sizeWritten;
+        size -= sizeWritten;
+        sizeWritten = 0;
+    }
+}
+
+#if BB_HAS_FILE_IO_BATCH
+
+//-----------------------------------------------------------
+const byte* PlotWriter::WriteBlocksQueued( const byte* src, size_t sizeToWrite )
+{
+    const size_t blockSize = _out->BlockSize();
+    const size_t slotSize  = _writeBuffer.Length() / _writeQueueDepth;
+    ASSERT( sizeToWrite / blockSize * blockSize == sizeToWrite );
+    ASSERT( _queuedWriteCount == 0 );
+
+    // The buffered bytes, if any, make up the start of the first write, in the first slot
+    byte*  slot      = _writeBuffer.Ptr();
+    size_t slotBytes = _bufferBytes;
+    uint64 offset    = (uint64)( _position - _bufferBytes );
+
+    _bufferBytes = 0;
+
+    while( sizeToWrite )
+    {
+        const byte* buffer;
+        size_t      size;
+
+        if( slotBytes == 0 && (uintptr_t)src % blockSize == 0 )
+        {
+            // Aligned data is written from where it was submitted
+            buffer = src;
+            size   = std::min( slotSize, sizeToWrite );
+            src   += size;
+        }
+        else
+        {
+            // If src is aligned like the file, only complete the block in progress, and write the rest in place
+            const bool   inPlaceNext = slotBytes > 0 && ( (uintptr_t)src + blockSize - slotBytes ) % blockSize == 0;
+            const size_t copySize    = inPlaceNext ? blockSize - slotBytes : std::min( slotSize, sizeToWrite ) - slotBytes;
+            memcpy( slot + slotBytes, src, copySize );
+
+            buffer    = slot;
+            size      = slotBytes + copySize;
+            src      += copySize;
+            slot     += slotSize;
+            slotBytes = 0;
+        }
+
+        _queuedWrites[_queuedWriteCount++] = { buffer, size, offset };
+        _writeBatch.Write( _stream, buffer, size );
+
+        offset      += size;
+        sizeToWrite -= size;
+
+        // Every slot may be in use, wait for the writes before re-using them
+        if( _queuedWriteCount == _writeQueueDepth )
+        {
+            FlushWriteQueue();
+            slot = _writeBuffer.Ptr();
+        }
+    }
+
+    FlushWriteQueue();
+    return src;
+}
+
+//-----------------------------------------------------------
+void PlotWriter::FlushWriteQueue()
+{
+    if( _queuedWriteCount == 0 )
+        return;
+
+    int err = 0;
+    if( !_writeBatch.Submit( err ) )
+    {
+        // Write the remainder of each failed request one at a time,
+        // so that a full disk is waited on, as with regular writes.
+        Log::Line( "Error %d encountered when writing to plot '%s'. Retrying the failed writes.", err, _plotPathBuffer.Ptr() );
+
+        for( uint32 i = 0; i < _queuedWriteCount; i++ )
+        {
+            const QueuedWrite& w          = _queuedWrites[i];
+            const size_t       transferred = _writeBatch.BytesTransferred( i );
+
+            if( transferred >= w.size )
+                continue;
+
+            PanicIf( !_stream.Seek( (int64)( w.offset + transferred ), SeekOrigin::Begin ),
+                "Plot file seek failed: %d", _stream.GetError() );
+
+            WriteBlocks( w.buffer + transferred, w.size - transferred );
+        }
+
+        const QueuedWrite& last = _queuedWrites[_queuedWriteCount-1];
+        PanicIf( !_stream.Seek( (int64)( last.offset + last.size ), SeekOrigin::Begin ),
+            "Plot file seek failed: %d", _stream.GetError() );
+    }
+
+    _queuedWriteCount = 0;
+}
+
+#endif // BB_HAS_FILE_IO_BATCH
+
+//-----------------------------------------------------------
+void PlotWriter::PadToPage()
+{
+    const size_t padding = RoundUpToNextBoundaryT( _position, BB_PLOT_PAGE_SIZE ) - _position;
+
+    if( padding > 0 )
+        WriteData( _zeroPage, padding );
+}
+
+//-----------------------------------------------------------
+void PlotWriter::WriteAlignedParks( const byte* src, size_t size )
+{
+    const PlotParkLayout& layout  = _parkLayout;
+    const size_t          padding = (size_t)layout.GroupPadding();
+
+    byte* buffer = _alignBuffer.Ptr();
+    byte* dst    = buffer;
+    byte* end    = buffer + _alignBuffer.Length();
+
+    // Manifests hash the tables as they are laid out in the file, padding included
+    auto flush = [&]() {
+
+        const size_t writeSize = (size_t)( dst - buffer );
+        if( writeSize == 0 )
+            return;
+
+        if( _hashTables )
+            blake3_hasher_update( &_tableHashers[(int)_currentTable], buffer, writeSize );
+
+        WriteData( buffer, writeSize );
+        dst = buffer;
+    };
+
+    while( size > 0 )
+    {
+        // Copy up to the end of the current park
+        const size_t copySize = std::min( { size, (size_t)layout.parkSize - _parkBytes, (size_t)( end - dst ) } );
+
+        memcpy( dst, src, copySize );
+        dst        += copySize;
+        src        += copySize;
+        size       -= copySize;
+        _parkBytes += copySize;
+
+        if( _parkBytes == layout.parkSize )
+        {
+            _parkBytes = 0;
+
+            if( ++_groupParkIndex == layout.groupParks )
+            {
+                _groupParkIndex = 0;
+
+                if( (size_t)( end - dst ) < padding )
+                    flush();
+
+                memset( dst, 0, padding );
+                dst += padding;
+            }
+        }
+
+        if( dst == end )
+            flush();
+    }
+
+    flush();
+}
+
+//-----------------------------------------------------------
+size_t GetTableParkSize( const PlotTable table, const uint32 k, const uint32 compressionLevel )
+{
+    switch( table )
+    {
+        case PlotTable::C1:
+        case PlotTable::C2:
+            return 0;
+
+        case PlotTable::C3:
+            return CalculateC3Size();
+
+        case PlotTable::Table7:
+            return CalculatePark7Size( k );
+
+        default:
+            break;
+    }
+
+    // Dropped tables are empty, and the lowest stored table holds the compressed x's
+    const uint32 droppedTables = compressionLevel == 0 ? 0 : compressionLevel >= 9 ? 2 : 1;
+
+    if( (uint32)table < droppedTables )
+        return 0;
+
+    if( compressionLevel > 0 && (uint32)table == droppedTables )
+        return GetCompressionInfoForLevel( compressionLevel ).tableParkSize;
+
+    return CalculateParkSize( (TableId)table, k );
+}
+
 ///
 /// Commands
 ///
@@ -859,6 +1490,15 @@ void PlotWriter::CmdBeginTable( const Command& cmd )
 
     const PlotTable table = cmd.beginTable.table;
 
+    if( _alignedParks )
+    {
+        PadToPage();
+
+        _parkLayout     = PlotParkLayout::Create( GetTableParkSize( table, _k, _compressionLevel ), true );
+        _parkBytes      = 0;
+        _groupParkIndex = 0;
+    }
+
     _currentTable = table;
     _haveTable    = true;
     
@@ -886,8 +1526,22 @@ void PlotWriter::CmdWriteTable( const Command& cmd )
 
     auto& c = cmd.writeTable;
     ASSERT( c.size );
-    
-    WriteData( c.buffer, c.size );
+
+    if( _alignedParks && _parkLayout.GroupPadding() > 0 )
+        WriteAlignedParks( c.buffer, c.size );
+    else
+    {
+        if( _hashTables )
+        {
+            ASSERT( _haveTable );
+            blake3_hasher_update( &_tableHashers[(int)_currentTable], c.buffer, c.size );
+        }
+        
+        WriteData( c.buffer, c.size );
+    }
+
+    if( c.staged )
+        _staging->Release( (byte*)c.buffer, c.size );
 }
 
 //-----------------------------------------------------------
@@ -901,6 +1555,9 @@ void PlotWriter::CmdReserveTable( const Command& cmd )
     auto& c = cmd.reserveTable;
     ASSERT( _tablePointers[(int)c.table] == 0 );
 
+    if( _alignedParks )
+        PadToPage();
+
     _tablePointers[(int)c.table] = _position;
     _tableSizes   [(int)c.table] = c.size;
 
@@ -922,9 +1579,15 @@ void PlotWriter::CmdWriteReservedTable( const Command& cmd )
     ASSERT( tableSize );
     ASSERT( tableLocation != 0 );
 
+    if( _hashTables )
+        blake3_hasher_update( &_tableHashers[(int)c.table], c.buffer, tableSize );
+
     SeekToLocation( tableLocation );
     WriteData( c.buffer, tableSize );
     SeekToLocation( currentLocation );
+
+    if( c.staged )
+        _staging->Release( (byte*)c.buffer, tableSize );
 }
 
 //-----------------------------------------------------------
@@ -942,25 +1605,35 @@ void PlotWriter::CmdSignalFence( const Command& cmd )
 void PlotWriter::CmdEndPlot( const Command& cmd )
 {
     ASSERT( cmd.type == CommandType::EndPlot );
-    ASSERT( _stream.IsOpen() );
+    ASSERT( IsStreamOpen() );
     ASSERT( !_haveTable );
 
     // Write table sizes
-    size_t tablePointersLoc;
+    size_t tablePointersLoc = 0;
     if( _plotVersion == PlotVersion::v1_0 )
         tablePointersLoc = _headerSize - 80;
     else if( _plotVersion == PlotVersion::v2_0 )
         tablePointersLoc = _headerSize - 160;
     else
-    {
-        ASSERT( 0 );
-    }
+        Panic( "Invalid plot version %u.", (uint32)_plotVersion );
 
     uint64 tablePointersBE[10];
     for( uint32 i = 0; i < 10; i++ )
         tablePointersBE[i] = Swap64( _tablePointers[i] );
 
-    SeekToLocation( tablePointersLoc );
+    // The delta R values come right before the table pointers
+    if( _tunedDeltas )
+    {
+        uint16 deltaRValuesBE[6];
+        for( uint32 i = 0; i < 6; i++ )
+            deltaRValuesBE[i] = Swap16( _deltaRValues[i] );
+
+        SeekToLocation( tablePointersLoc - sizeof( deltaRValuesBE ) );
+        WriteData( (byte*)deltaRValuesBE, sizeof( deltaRValuesBE ) );
+    }
+    else
+        SeekToLocation( tablePointersLoc );
+
     WriteData( (byte*)tablePointersBE, sizeof( tablePointersBE ) );
 
     if( _plotVersion == PlotVersion::v2_0 )
@@ -969,34 +1642,86 @@ void PlotWriter::CmdEndPlot( const Command& cmd )
     ASSERT( _position == _headerSize );
 
     FlushRetainedBytes();
-    _stream.Close();
 
-    bool renamePlot = cmd.endPlot.rename;
-    if( _plotChecker )
+    // Release any preallocated space we did not use
+    if( _preallocated )
     {
-        renamePlot = CheckPlot();
+        const size_t blockSize = _out->BlockSize();
+        const size_t fileSize  = CDivT( _unalignedFileSize, blockSize ) * blockSize;
+
+        if( !_out->Truncate( (ssize_t)fileSize ) )
+            Log::Line( "[PlotWriter] Warning: Failed to truncate preallocated plot file with error: %d", _out->GetError() );
     }
 
+    const bool isNetPlot = _out == &_netStream;
+
+    if( !isNetPlot )
+        _stream.Close();
+
+    const char*  tmpName = _plotPathBuffer.Ptr();
+    const size_t pathLen = strlen( tmpName );
+
+    _plotFinalPathName = (char*)realloc( _plotFinalPathName, pathLen + 1 );
+    memcpy( _plotFinalPathName, tmpName, pathLen );
+    _plotFinalPathName[pathLen-4] = '\0';
+
+    const std::string manifest = _hashTables ? BuildManifest() : std::string();
+
+    if( isNetPlot )
+    {
+        // The final control message has the receiver close and rename the plot.
+        // The plot is not on this machine, so it is not checked.
+        if( !_netStream.Finish( cmd.endPlot.rename ) )
+            Log::Line( "[PlotWriter] Error: The receiver failed to complete plot %s with error: %d.", tmpName, _netStream.GetError() );
+        else if( cmd.endPlot.rename )
+            Log::Line( "%s -> %s", tmpName, _plotFinalPathName );
+
+        _out = &_stream;
+        AddActivePlotDir( _activePlotDir, -1 );
+    }
+    else if( _plotChecker && _checkQueue && !_dummyMode )
+    {
+        // The plot is finished once the check completes, on the check thread.
+        // This writer is free for the next plot, while the plot's directory stays active until then.
+        _checkQueue->Submit( tmpName, [tmpPath = std::string( tmpName ), manifest, activePlotDir = _activePlotDir]( const bool passed ) {
+            FinishPlotFile( tmpPath, manifest, activePlotDir, passed );
+        });
+    }
+    else
+    {
+        bool renamePlot = cmd.endPlot.rename;
+        if( _plotChecker )
+        {
+            renamePlot = CheckPlot();
+        }
+
+        FinishPlotFile( tmpName, manifest, _activePlotDir, renamePlot );
+    }
+
+    _plotActive.store( false, std::memory_order_release );
+
+    _readyToPlotSignal.Signal();
+    cmd.endPlot.fence->Signal();
+}
+
+//-----------------------------------------------------------
+void FinishPlotFile( const std::string& tmpPath, const std::string& manifest, const std::string& activePlotDir, const bool rename )
+{
     // Now rename to its final non-temp name
-    if( renamePlot )
+    const std::string finalPath = tmpPath.substr( 0, tmpPath.size() - 4 );
+
+    if( rename )
     {
         const uint32 RETRY_COUNT  = 10;
         const long   MS_WAIT_TIME = 1000;
 
-        const char* tmpName = _plotPathBuffer.Ptr();
-        const size_t pathLen = strlen( tmpName );
-
-        _plotFinalPathName = (char*)realloc( _plotFinalPathName, pathLen + 1 );
-        memcpy( _plotFinalPathName, tmpName, pathLen );
-        _plotFinalPathName[pathLen-4] = '\0';
-
-        Log::Line( "%s -> %s", tmpName, _plotFinalPathName );
+        Log::Line( "%s -> %s", tmpPath.c_str(), finalPath.c_str() );
 
         int32 error = 0;
 
         for( uint32 i = 0; i < RETRY_COUNT; i++ )
         {
-            const bool success = FileStream::Move( tmpName, _plotFinalPathName, &error );
+            const bool success = FileStream::Move( tmpPath.c_str(), finalPath.c_str(), &error );
 
             if( success )
                 break;
@@ -1014,8 +1739,54 @@ void PlotWriter::CmdEndPlot( const Command& cmd )
         }
     }
 
-    _readyToPlotSignal.Signal();
-    cmd.endPlot.fence->Signal();
+    if( !manifest.empty() )
+        WriteManifest( rename ? finalPath : tmpPath, manifest );
+
+    // Queue the move first, so that the destination never appears idle in between
+    if( rename && _plotMover )
+        _plotMover->Move( finalPath.c_str(), activePlotDir.c_str() );
+
+    AddActivePlotDir( activePlotDir, -1 );
+}
+
+//-----------------------------------------------------------
+std::string PlotWriter::BuildManifest()
+{
+    // One line per non-empty table: <table index> <offset> <size> <blake3 digest>
+    std::string manifest = "bladebit-manifest 1\n";
+
+    for( uint32 i = 0; i < 10; i++ )
+    {
+        if( _tableSizes[i] == 0 )
+            continue;
+
+        byte digest[BLAKE3_OUT_LEN];
+        blake3_hasher_finalize( &_tableHashers[i], digest, sizeof( digest ) );
+
+        char   digestStr[BLAKE3_OUT_LEN*2+1];
+        size_t numEncoded;
+        BytesToHexStr( digest, sizeof( digest ), digestStr, sizeof( digestStr ), numEncoded );
+        digestStr[BLAKE3_OUT_LEN*2] = 0;
+
+        char line[128];
+        snprintf( line, sizeof( line ), "%u %llu %llu %s\n", i, (llu)_tablePointers[i], (llu)_tableSizes[i], digestStr );
+        manifest += line;
+    }
+
+    return manifest;
+}
+
+//-----------------------------------------------------------
+void WriteManifest( const std::string& plotPath, const std::string& manifest )
+{
+    const std::string manifestPath = plotPath + ".b3";
+
+    FileStream file;
+    if( !file.Open( manifestPath.c_str(), FileMode::Create, FileAccess::Write ) ||
+        file.Write( manifest.data(), manifest.size() ) != (ssize_t)manifest.size() )
+    {
+        Log::Line( "[PlotWriter] Warning: Failed to write plot manifest %s with error: %d", manifestPath.c_str(), file.GetError() );
+    }
 }
 
 //-----------------------------------------------------------
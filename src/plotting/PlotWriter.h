@@ -5,12 +5,17 @@
 #include "plotting/PlotHeader.h"
 #include "tools/PlotChecker.h"
 #include "io/FileStream.h"
+#include "io/NetStream.h"
 #include "threading/Thread.h"
 #include "threading/AutoResetSignal.h"
 #include "threading/Fence.h"
+#include "plotting/PlotCheckQueue.h"
+#include "b3/blake3.h"
 #include <functional>
 #include <mutex>
+#include <condition_variable>
 #include <queue>
+#include <string>
 
 /**
  * Handles writing the final plot data to disk asynchronously.
@@ -57,6 +62,8 @@
  *   - plot flags ([Plot_Flags])        : 4 bytes
  *   - (if compression flag is set)
  *    - compression level (1-9)         : 1 byte
+ *   - (if tuned deltas flag is set)
+ *    - delta R values                  : 12 bytes (2 * 6)
  *   - table pointers                   : 80 bytes (8 * 10)
  *   - table sizes                      : 80 bytes (8 * 10)
  * 
@@ -65,6 +72,15 @@
  * table pointers of the missing tables should be set to the 
  * start of the next available table, and their sizes set ot 0.
  * 
+ * If the [AlignedParks] flag is set, every table starts on a 4 KiB page, and the parks of a table
+ * are laid out as described by PlotParkLayout: Parks are packed in groups padded to whole pages,
+ * so that no park spans more pages than its size requires. Padding is zeroed. The table sizes
+ * exclude the padding at the end of a table, but include the padding in between its parks.
+ * 
+ * If the [TunedDeltas] flag is set, the deltas of the parks of LP tables 1-6 are coded with tables
+ * generated from the R value of that table (little-endian, in hundredths), instead of its default one.
+ * An R value of 0 means the table uses its default one.
+ * 
  */
 
 class FileStream;
@@ -72,6 +88,47 @@ class Fence;
 class Thread;
 class DiskBufferQueue;
 
+/**
+ * Where a plot file's writer stood in between two tables.
+ * Saved along with a plotter's checkpoint, so that an interrupted plot can be re-opened and completed.
+ */
+struct PlotWriterState
+{
+    PlotVersion version;
+    uint32      compressionLevel;
+    uint32      alignedParks;
+    uint64      headerSize;
+    uint64      position;
+    uint64      fileSize;           // Unaligned file size
+    uint64      tablePointers[10];
+    uint64      tableSizes   [10];
+};
+
+/**
+ * Bounded host memory, shared between plot writers, that plot data is copied to when it is submitted.
+ * A writer using it does not reference the caller's buffers after a write call returns,
+ * so a plot can keep writing to its destination while the next plot re-uses those buffers.
+ */
+class PlotWriteStaging
+{
+public:
+    PlotWriteStaging( size_t budget );
+
+    // Copies the data to a staging buffer. Blocks while the budget is exhausted,
+    // unless nothing is staged, so that writes larger than the budget still go through.
+    byte* Stage( const void* data, size_t size );
+
+    void Release( byte* buffer, size_t size );
+
+    inline size_t Budget() const { return _budget; }
+
+private:
+    std::mutex              _lock;
+    std::condition_variable _releasedSignal;
+    size_t                  _budget;
+    size_t                  _stagedSize = 0;
+};
+
 class PlotWriter
 {
     friend class DiskBufferQueue;
@@ -80,6 +137,7 @@ class PlotWriter
     enum class CommandType : uint32;
 
     static constexpr size_t BUFFER_ALLOC_SIZE = 32 MiB;
+    static constexpr uint32 MAX_WRITE_QUEUE_DEPTH = 64;
 public:
 
     PlotWriter();
@@ -87,12 +145,51 @@ public:
     PlotWriter( DiskBufferQueue& ownerQueue );
     virtual ~PlotWriter();
     
-    void EnablePlotChecking( PlotChecker& checker );
+    // Check each plot once it is written, and delete it instead of renaming it if it fails.
+    // With a checkQueue, the check runs on the queue's thread and the plot completes without waiting for it;
+    // the rename, manifest and move then happen once the check has passed.
+    void EnablePlotChecking( PlotChecker& checker, PlotCheckQueue* checkQueue = nullptr );
+
+    // Copy all submitted data to the staging memory. Must be set before BeginPlot.
+    // Fences and callbacks are then completed as soon as they are submitted.
+    void EnableStaging( PlotWriteStaging& staging );
+
+    // Number of plots currently being written (or moved, see EnableStageDir) to the given directory, across all writers
+    static uint32 GetActivePlotCount( const char* plotFileDir );
+
+    inline bool IsPlotComplete() const { return !_plotActive.load( std::memory_order_acquire ); }
+
+    // Write all plots to stageDir first, then move them to their output directory in the background
+    // (see PlotMover). Must be called before any plot is started.
+    static void EnableStageDir( const char* stageDir, bool useDirectIO );
+
+    // Blocks until all staged plots have been moved to their output directory
+    static void WaitForPlotMoves();
+
+    // Write a <plot>.b3 manifest next to each finished plot, with the BLAKE3 digest of each of its tables.
+    // Tables are hashed by the writer thread as their data is written, so the plot is never read back.
+    // Must be called before any plot is started.
+    static void EnableManifests();
+
+    // Keep up to depth writes of BUFFER_ALLOC_SIZE in flight to the plot file (through FileIOBatch), instead of one at a time.
+    // Block-aligned table data is then written straight from the submitted buffer, without being copied to the write buffer.
+    // Must be called before any plot is started. Has no effect on platforms without FileIOBatch.
+    static void SetWriteQueueDepth( uint32 depth );
 
     // Begins writing a new plot. Any previous plot must have finished before calling this
     bool BeginPlot( PlotVersion version, 
         const char* plotFileDir, const char* plotFileName, const byte plotId[32],
-        const byte* plotMemo, const uint16 plotMemoSize, uint32 compressionLevel = 0 );
+        const byte* plotMemo, const uint16 plotMemoSize, uint32 compressionLevel = 0,
+        PlotFlags extraFlags = PlotFlags::None, uint32 k = _K );
+
+    // Re-opens a plot that was interrupted after SaveState() and continues writing it from that state.
+    // As with BeginPlot, any previous plot must have finished before calling this.
+    // No manifest is written for a resumed plot, since the tables written before the interruption were not hashed.
+    bool ResumePlot( const char* plotFileDir, const char* plotFileName, const PlotWriterState& state );
+
+    // Writes out all data submitted so far, syncs the plot file and then captures the writer's state.
+    // The fence is signalled once outState is set. Must be called in between tables.
+    void SaveState( PlotWriterState& outState, Fence& fence );
 
     // bool BeginCompressedPlot( PlotVersion version, 
     //     const char* plotFileDir, const char* plotFileName, const byte plotId[32],
@@ -114,9 +211,21 @@ public:
     // to the offset that would be written
     void ReserveTableSize( const PlotTable table, const size_t size );
 
-    // Write data to the currently active table
+    // Set the R value with which a table's LP park deltas were coded. Only for plots begun with PlotFlags::TunedDeltas.
+    // May be called at any time before EndPlot.
+    void SetDeltaRValue( const PlotTable table, const double rValue );
+
+    // Write data to the currently active table.
+    // Unless staging, the data is read from the caller's buffer by the writer thread, so it must remain valid
+    // until the writer has gone past it (see SignalFence and CallBack).
     void WriteTableData( const void* data, const size_t size );
 
+    // Offset within a block of the file position that the next table data submitted will be written at.
+    // Table data whose address has the same offset within a block is written to the file straight from its buffer,
+    // instead of being copied to the write buffer first, so producers can lay out their buffers to match.
+    // With aligned parks, only exact right after BeginTable, since the padding in between parks is not accounted for.
+    size_t NextWriteBlockOffset() const;
+
     // Write all data to a reserved table.
     // The whole buffer must be specified
     void WriteReservedTable( const PlotTable table, const void* data );
@@ -129,9 +238,9 @@ public:
     
     void CompleteTable();
 
-    inline int32 GetError() { return _stream.GetError(); }
+    inline int32 GetError() { return _out->GetError(); }
 
-    inline size_t BlockSize() const { return _stream.BlockSize(); }
+    inline size_t BlockSize() const { return _out->BlockSize(); }
 
     inline const uint64* GetTablePointers() const { return _tablePointers; }
 
@@ -147,6 +256,20 @@ public:
         return (T*)(uintptr_t)BlockAlign( (size_t)(uintptr_t)ptr );
     }
 
+    // First address at or after ptr with the given offset within a block (see NextWriteBlockOffset).
+    // Needs up to BlockSize()-1 bytes past ptr.
+    template<typename T>
+    inline T* AlignToBlockOffset( void* ptr, const size_t blockOffset ) const
+    {
+        if( _dummyMode )
+            return (T*)ptr;
+
+        const size_t blockSize = _out->BlockSize();
+        const size_t address   = (size_t)(uintptr_t)ptr;
+
+        return (T*)(uintptr_t)( address + ( blockOffset % blockSize + blockSize - address % blockSize ) % blockSize );
+    }
+
     inline void EnableDummyMode()
     {
         ASSERT( !_haveTable );
@@ -160,10 +283,20 @@ private:
     bool BeginPlotInternal( PlotVersion version,
         const char* plotFileDir, const char* plotFileName, const byte plotId[32],
         const byte* plotMemo, const uint16 plotMemoSize,
-        int32 compressionLevel );
+        int32 compressionLevel, PlotFlags extraFlags, uint32 k );
+
+    bool ResumePlotInternal( const char* plotFileDir, const char* plotFileName, const PlotWriterState& state );
+
+    void SetPlotPath( const char* plotFileDir, const char* plotFileName );
+
+    inline bool IsStreamOpen() const { return _stream.IsOpen() || _netStream.IsOpen(); }
+
+    void AllocWriteBuffer();
 
     bool CheckPlot();
 
+    std::string BuildManifest();
+
     Command& GetCommand( CommandType type );
     void SubmitCommands();
     void SubmitCommand( const Command cmd );
@@ -179,6 +312,20 @@ private:
 
     void WriteData( const byte* data, size_t size );
 
+    // Writes block-aligned data at the current position, waiting for space to become available if the disk is full
+    void WriteBlocks( const byte* data, size_t size );
+
+    // Writes the sizeToWrite block-aligned bytes made of the buffered bytes followed by src,
+    // with up to the write queue depth in flight. Returns src past the bytes consumed.
+    const byte* WriteBlocksQueued( const byte* src, size_t sizeToWrite );
+    void FlushWriteQueue();
+
+    // Zero-pads the file up to the next page, so that the next table starts on it
+    void PadToPage();
+
+    // Writes table data made of parks, padding them as given by the current table's layout
+    void WriteAlignedParks( const byte* data, size_t size );
+
 
 private:
     void CmdBeginTable( const Command& cmd );
@@ -226,12 +373,14 @@ private:
             {
                 const byte* buffer;
                 size_t      size;
+                bool        staged;
             } writeTable;
 
             struct 
             {
                 PlotTable   table;
                 const byte* buffer;
+                bool        staged;
             } writeReservedTable;
 
             struct
@@ -265,6 +414,8 @@ private:
                                                             // dispatch our ocmmands in its own threads.
 
     FileStream             _stream;
+    NetStream              _netStream;                  // Used instead of _stream for tcp:// output directories
+    IStream*               _out                 = &_stream;
     bool                   _directIO;
     bool                   _dummyMode           = false;    // In this mode we don't actually write anything
     PlotVersion            _plotVersion         = PlotVersion::v2_0;
@@ -275,12 +426,14 @@ private:
     AutoResetSignal        _cmdReadySignal;
     AutoResetSignal        _cmdConsumedSignal;
     AutoResetSignal        _readyToPlotSignal;          // Set when the writer is ready to start the next plot.
-    Span<byte>             _writeBuffer         = {};
+    Span<byte>             _writeBuffer         = {};   // Write queue depth slots of BUFFER_ALLOC_SIZE
     size_t                 _bufferBytes         = 0;    // Current number of bytes in the buffer
     size_t                 _headerSize          = 0;
     bool                   _haveTable           = false;
+    bool                   _preallocated        = false;    // The expected plot size was reserved when the file was opened
     PlotTable              _currentTable        = PlotTable::Table1;
     size_t                 _position            = 0;    // Current read/write location, relative to the start of the file
+    std::atomic<size_t>    _submitPosition      = 0;    // Location the table data submitted so far ends at, as seen by the submitting threads
     size_t                 _unalignedFileSize   = 0;    // Current total file size, including headers, but excluding any extra alignment bytes
     size_t                 _alignedFileSize     = 0;    // Current actual size of data we've written to disk.
                                                         //  This is different than _unalignedFileSize because the latter might 
@@ -298,5 +451,40 @@ private:
     // std::mutex              _pushLock;
 
     PlotChecker* _plotChecker              = nullptr;    // User responsible for ownership of checker. Must live until this PlotWriter's lifetime neds.
+    PlotCheckQueue*         _checkQueue             = nullptr;    // Same, and must outlive any checks submitted to it
+
+    PlotWriteStaging*       _staging                = nullptr;
+    size_t                  _stagedReservedSizes[10] = {};  // Reserved table sizes, as seen by the submitting thread
+    std::string             _activePlotDir;                 // Output directory of the plot being written
+    std::atomic<bool>       _plotActive             = false;
+
+    bool                    _hashTables             = false;    // Set when writing manifests
+    blake3_hasher           _tableHashers[10];
+
+    // PlotFlags::AlignedParks layout
+    bool                    _alignedParks           = false;
+    uint32                  _compressionLevel       = 0;
+    uint32                  _k                      = _K;
+    bool                    _tunedDeltas            = false;    // PlotFlags::TunedDeltas
+    uint16                  _deltaRValues[6]        = {};
+    PlotParkLayout          _parkLayout             = {};       // Layout of the current table's parks
+    size_t                  _parkBytes              = 0;        // Bytes written of the current park
+    uint64                  _groupParkIndex         = 0;        // Index of the current park in its group
+    Span<byte>              _alignBuffer            = {};       // Parks are padded here before being written
+
+    // Write queue (see SetWriteQueueDepth)
+#if BB_HAS_FILE_IO_BATCH
+    struct QueuedWrite
+    {
+        const byte* buffer;
+        size_t      size;
+        uint64      offset;
+    };
+
+    FileIOBatch             _writeBatch;
+    bool                    _writeBatchFailed       = false;    // FileIOBatch is not available, write one buffer at a time
+    QueuedWrite             _queuedWrites[MAX_WRITE_QUEUE_DEPTH];
+    uint32                  _queuedWriteCount       = 0;
+#endif
 };
 
@@ -0,0 +1,111 @@
+#pragma once
+
+///
+/// Interleaved rANS coding of park deltas, used by plots with PlotFlags::RANSDeltas.
+/// Symbol i is coded by state i % RANSLaneCount, so that a group of RANSLaneCount consecutive symbols
+/// is decoded with independent states, in SIMD lanes (see RANSDecode in ParkCoding.h).
+/// States are 32 bits, kept in [RANSStateLow, 2^32) and renormalized one 16-bit word at a time.
+/// Frequencies use the same 14-bit quanta as the FSE tables' normalized counts.
+///
+/// Layout, all little-endian:
+///     uint16 symbol count
+///     uint32 final encoder state of each lane used, min( count, RANSLaneCount ) of them
+///     uint16 renormalization words, in decoding order
+///
+/// Flushing the states costs about 3 bytes per lane, so a park's rANS stream may not fit in
+/// the space chiapos sized for FSE. Such parks set RANSFSEFallback in the count instead,
+/// and hold a single FSE stream after it.
+///
+/// The encoder is shared with the CUDA plotter, so it's kept header-only.
+///
+
+#if defined( __CUDACC__ )
+    #define RANS_FUNC __host__ __device__ inline
+#else
+    #define RANS_FUNC inline
+#endif
+
+static constexpr uint32 RANSLaneCount   = 32;
+static constexpr uint32 RANSScaleBits   = 14;
+static constexpr uint32 RANSStateLow    = 1u << 16;
+static constexpr uint32 RANSMaxSymbols  = 256;
+static constexpr uint32 RANSFSEFallback = 0x8000;
+
+// Largest encoded size of count symbols
+#define RANS_ENCODE_BOUND( count ) ( 2 + RANSLaneCount * 4 + (count) * 2 )
+
+struct RANSEncTable
+{
+    uint32 symbolCount;                         // Symbols >= symbolCount can't be encoded
+    uint32 freq [RANSMaxSymbols];
+    uint32 start[RANSMaxSymbols];               // Cumulative frequency of the preceding symbols
+};
+
+struct RANSDecTable
+{
+    uint32 slots  [1u << RANSScaleBits];        // freq << 16 | ( slot - start ) of the slot's symbol
+    byte   symbols[( 1u << RANSScaleBits ) + 4];  // Padded so that each slot can be gathered as 32 bits
+};
+
+// Encodes count symbols. words must have room for count entries, the words are staged in it
+// as they are emitted in reverse.
+// Returns the size written to dst, at most RANS_ENCODE_BOUND( count ),
+// or 0 if a symbol is not in the table, in which case they must be stored raw.
+//-----------------------------------------------------------
+RANS_FUNC size_t RANSEncode( byte* dst, const byte* symbols, const uint32 count, const RANSEncTable& table, uint16* words )
+{
+    uint32 states[RANSLaneCount];
+
+    const uint32 laneCount = count < RANSLaneCount ? count : RANSLaneCount;
+
+    for( uint32 i = 0; i < laneCount; i++ )
+        states[i] = RANSStateLow;
+
+    // Encode backwards, so that the decoder reads forward
+    uint16* wordWriter = words + count;
+
+    for( uint32 i = count; i-- > 0; )
+    {
+        const uint32 sym = symbols[i];
+        if( sym >= table.symbolCount )
+            return 0;
+
+        const uint32 freq = table.freq[sym];
+        uint32       x    = states[i % RANSLaneCount];
+
+        // Renormalize so that the encoded state remains < 2^32
+        if( (uint64)x >= ( (uint64)( RANSStateLow >> RANSScaleBits ) << 16 ) * freq )
+        {
+            *--wordWriter = (uint16)x;
+            x >>= 16;
+        }
+
+        states[i % RANSLaneCount] = ( ( x / freq ) << RANSScaleBits ) + ( x % freq ) + table.start[sym];
+    }
+
+    byte* writer = dst;
+
+    writer[0] = (byte)( count );
+    writer[1] = (byte)( count >> 8 );
+    writer += 2;
+
+    for( uint32 i = 0; i < laneCount; i++ )
+    {
+        const uint32 x = states[i];
+
+        writer[0] = (byte)( x );
+        writer[1] = (byte)( x >> 8 );
+        writer[2] = (byte)( x >> 16 );
+        writer[3] = (byte)( x >> 24 );
+        writer += 4;
+    }
+
+    for( const uint16* w = wordWriter; w < words + count; w++ )
+    {
+        writer[0] = (byte)( *w );
+        writer[1] = (byte)( *w >> 8 );
+        writer += 2;
+    }
+
+    return (size_t)( writer - dst );
+}
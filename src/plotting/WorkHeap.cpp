@@ -27,6 +27,9 @@ WorkHeap::~WorkHeap()
 //-----------------------------------------------------------
 void WorkHeap::ResetHeap( const size_t heapSize, void* heapBuffer )
 {
+    CompletePendingReleases();
+    FlushSizeClasses();
+
     ASSERT( _allocationTable.Length() == 0 );
     ASSERT( _heapTable.Length()       == 1 );
 
@@ -46,12 +49,19 @@ byte* WorkHeap::Alloc( size_t size, size_t alignment, bool blockUntilFreeBuffer,
 
     // If we have such a buffer available, grab it, if not, we will
     // have to wait for enough deallocations in order to continue
+    _stats.allocCount++;
+
     for( ;; )
     {
         // First, add any pending released buffers back to the heap
         CompletePendingReleases();
 
-        byte* buffer = nullptr;
+        byte* buffer = AllocFromSizeClass( size, alignment );
+        if( buffer )
+        {
+            _stats.classHitCount++;
+            return buffer;
+        }
 
         for( size_t i = 0; i < _heapTable.Length(); i++ )
         {
@@ -115,6 +125,10 @@ byte* WorkHeap::Alloc( size_t size, size_t alignment, bool blockUntilFreeBuffer,
         if( buffer )
             return buffer;
 
+        // Cached buffers may be what is keeping the heap from having a large enough free region
+        if( FlushSizeClasses() )
+            continue;
+
         if( !blockUntilFreeBuffer )
             return nullptr;
 
@@ -123,9 +137,13 @@ byte* WorkHeap::Alloc( size_t size, size_t alignment, bool blockUntilFreeBuffer,
         auto timer = TimerBegin();
         _releaseSignal.Wait();
 
+        const Duration elapsed = TimerEndTicks( timer );
+        _stats.waitCount++;
+        _stats.waitTime += elapsed;
+
         if( accumulator )
         {
-            (*accumulator) += TimerEndTicks( timer );
+            (*accumulator) += elapsed;
         }
 
 
@@ -152,6 +170,14 @@ bool WorkHeap::CanAllocate( size_t size, size_t alignment  ) const
 {
     size = alignment * CDivT( size, alignment );
 
+    for( uint32 i = 0; i < _sizeClassCount; i++ )
+    {
+        const SizeClass& sizeClass = _sizeClasses[i];
+
+        if( sizeClass.size == size && sizeClass.count > 0 )
+            return true;
+    }
+
     for( size_t i = 0; i < _heapTable.Length(); i++ )
     {
         HeapEntry& entry = _heapTable[i];
@@ -192,76 +218,214 @@ void WorkHeap::CompletePendingReleases()
                         foundAllocation = true;
                     #endif
 
-                    HeapEntry allocation = _allocationTable[j];
-                    _allocationTable.UnorderedRemove( j );
+                    if( !CacheInSizeClass( buffer, _allocationTable[j].size ) )
+                        FreeAllocation( j );
 
-                    _usedHeapSize -= allocation.size;
-                    
-                    Log::Debug( "- Free %p : %llu", buffer, allocation.size );
+                    break;
+                }
+            }
 
-                    size_t insertIndex = 0;
+            #if _DEBUG
+                FatalIf( !foundAllocation, "Failed to find released buffer." );
+            #endif
+                
+        }
+    }
+}
 
-                    // Find where to place the allocation back into the 
-                    for( ; insertIndex < _heapTable.Length(); insertIndex++ )
-                    {
-                        if( _heapTable[insertIndex].address > buffer )
-                            break;
-                    }
+//-----------------------------------------------------------
+void WorkHeap::FreeAllocation( const size_t allocationIndex )
+{
+    const HeapEntry allocation = _allocationTable[allocationIndex];
+    _allocationTable.UnorderedRemove( allocationIndex );
 
-                    // When adding the released buffer (entry) back to the heap table,
-                    // one of 4 scenarios can happen:
-                    // 1: Entry can be merged with the left entry, don't create a new entry, simply extend it.
-                    // 2: Entry can be merged with the right entry, don't create a new entry, 
-                    //      change the start address of the right entry and extend size.
-                    // 3: Entry can be merged with both left and right entry, 
-                    //      extend the left entry to cover the released entry and the right entry,
-                    //      then remove the right entry.
-                    // 4: Entry cannot be merged with the left or the right entry, create a new entry
+    byte* buffer = allocation.address;
 
+    _usedHeapSize -= allocation.size;
+    
+    Log::Debug( "- Free %p : %llu", buffer, allocation.size );
 
-                    // Case 1? Can we merge with the left entry?
-                    if( insertIndex > 0 && _heapTable[insertIndex - 1].EndAddress() == buffer )
-                    {
-                        // Extend size to the released entry
-                        HeapEntry& entry = _heapTable[insertIndex - 1];
-                        entry.size += allocation.size;
-                        ASSERT( entry.size );
+    size_t insertIndex = 0;
 
-                        // Case 3? See if we also need to merge with the right entry (fills a hole between 2 entries).
-                        if( insertIndex < _heapTable.Length() && allocation.EndAddress() == _heapTable[insertIndex].address )
-                        {
-                            // Extend size to the right entry
-                            entry.size += _heapTable[insertIndex].size;
-                            _heapTable.Remove( insertIndex );
-                            ASSERT( entry.size );
-                        }
-                    }
-                    // Case 2? Can we merge with the right entry
-                    else if( insertIndex < _heapTable.Length() && allocation.EndAddress() == _heapTable[insertIndex].address )
-                    {
-                        // Don't create a new allocation, merge with the right entry
-                        _heapTable[insertIndex].address = allocation.address;
-                        _heapTable[insertIndex].size   += allocation.size;
-                        ASSERT( _heapTable[insertIndex].size );
-                    }
-                    // Case 4: Insert a new entry, no merges
-                    else
-                    {
-                        // We need to insert a new entry
-                        _heapTable.Insert( allocation, insertIndex );
-                        ASSERT( _heapTable[insertIndex].size );
-                    }
+    // Find where to place the allocation back into the 
+    for( ; insertIndex < _heapTable.Length(); insertIndex++ )
+    {
+        if( _heapTable[insertIndex].address > buffer )
+            break;
+    }
+
+    // When adding the released buffer (entry) back to the heap table,
+    // one of 4 scenarios can happen:
+    // 1: Entry can be merged with the left entry, don't create a new entry, simply extend it.
+    // 2: Entry can be merged with the right entry, don't create a new entry, 
+    //      change the start address of the right entry and extend size.
+    // 3: Entry can be merged with both left and right entry, 
+    //      extend the left entry to cover the released entry and the right entry,
+    //      then remove the right entry.
+    // 4: Entry cannot be merged with the left or the right entry, create a new entry
+
+
+    // Case 1? Can we merge with the left entry?
+    if( insertIndex > 0 && _heapTable[insertIndex - 1].EndAddress() == buffer )
+    {
+        // Extend size to the released entry
+        HeapEntry& entry = _heapTable[insertIndex - 1];
+        entry.size += allocation.size;
+        ASSERT( entry.size );
+
+        // Case 3? See if we also need to merge with the right entry (fills a hole between 2 entries).
+        if( insertIndex < _heapTable.Length() && allocation.EndAddress() == _heapTable[insertIndex].address )
+        {
+            // Extend size to the right entry
+            entry.size += _heapTable[insertIndex].size;
+            _heapTable.Remove( insertIndex );
+            ASSERT( entry.size );
+        }
+    }
+    // Case 2? Can we merge with the right entry
+    else if( insertIndex < _heapTable.Length() && allocation.EndAddress() == _heapTable[insertIndex].address )
+    {
+        // Don't create a new allocation, merge with the right entry
+        _heapTable[insertIndex].address = allocation.address;
+        _heapTable[insertIndex].size   += allocation.size;
+        ASSERT( _heapTable[insertIndex].size );
+    }
+    // Case 4: Insert a new entry, no merges
+    else
+    {
+        // We need to insert a new entry
+        _heapTable.Insert( allocation, insertIndex );
+        ASSERT( _heapTable[insertIndex].size );
+    }
+}
+
+//-----------------------------------------------------------
+byte* WorkHeap::AllocFromSizeClass( const size_t size, const size_t alignment )
+{
+    for( uint32 i = 0; i < _sizeClassCount; i++ )
+    {
+        SizeClass& sizeClass = _sizeClasses[i];
+
+        if( sizeClass.size != size )
+            continue;
+
+        // Prefer the most recently released buffer that satisfies the alignment
+        for( uint32 j = sizeClass.count; j > 0; j-- )
+        {
+            byte* buffer = sizeClass.buffers[j-1];
+
+            if( (uintptr_t)buffer % alignment == 0 )
+            {
+                sizeClass.buffers[j-1] = sizeClass.buffers[--sizeClass.count];
+                Log::Debug( "+ Allocated @ 0x%p : %llu (size class)", buffer, size );
+                return buffer;
+            }
+        }
+
+        break;
+    }
+
+    return nullptr;
+}
+
+//-----------------------------------------------------------
+bool WorkHeap::CacheInSizeClass( byte* buffer, const size_t size )
+{
+    SizeClass* sizeClass = nullptr;
+
+    for( uint32 i = 0; i < _sizeClassCount; i++ )
+    {
+        if( _sizeClasses[i].size == size )
+        {
+            sizeClass = &_sizeClasses[i];
+            break;
+        }
+    }
+
+    if( !sizeClass )
+    {
+        // Re-use a class that holds no buffers before giving up on caching
+        for( uint32 i = 0; i < _sizeClassCount && !sizeClass; i++ )
+        {
+            if( _sizeClasses[i].count == 0 )
+                sizeClass = &_sizeClasses[i];
+        }
+
+        if( !sizeClass )
+        {
+            if( _sizeClassCount >= MAX_SIZE_CLASSES )
+                return false;
+
+            sizeClass = &_sizeClasses[_sizeClassCount++];
+        }
+
+        sizeClass->size  = size;
+        sizeClass->count = 0;
+    }
+
+    if( sizeClass->count >= MAX_CLASS_BUFFERS )
+        return false;
+
+    sizeClass->buffers[sizeClass->count++] = buffer;
+    return true;
+}
+
+//-----------------------------------------------------------
+bool WorkHeap::FlushSizeClasses()
+{
+    bool flushed = false;
+
+    for( uint32 i = 0; i < _sizeClassCount; i++ )
+    {
+        SizeClass& sizeClass = _sizeClasses[i];
 
+        for( uint32 j = 0; j < sizeClass.count; j++ )
+        {
+            byte* buffer = sizeClass.buffers[j];
+
+            for( size_t k = 0; k < _allocationTable.Length(); k++ )
+            {
+                if( _allocationTable[k].address == buffer )
+                {
+                    FreeAllocation( k );
                     break;
                 }
             }
-
-            #if _DEBUG
-                FatalIf( !foundAllocation, "Failed to find released buffer." );
-            #endif
-                
         }
+
+        flushed = flushed || sizeClass.count > 0;
+        sizeClass.count = 0;
     }
+
+    return flushed;
 }
 
+//-----------------------------------------------------------
+WorkHeap::Stats WorkHeap::GetStats() const
+{
+    Stats stats = _stats;
+
+    stats.freeSize        = 0;
+    stats.cachedSize      = 0;
+    stats.largestFreeSize = 0;
+    stats.freeEntryCount  = _heapTable.Length();
+
+    for( size_t i = 0; i < _heapTable.Length(); i++ )
+    {
+        stats.freeSize        += _heapTable[i].size;
+        stats.largestFreeSize  = std::max( stats.largestFreeSize, _heapTable[i].size );
+    }
 
+    for( uint32 i = 0; i < _sizeClassCount; i++ )
+        stats.cachedSize += _sizeClasses[i].size * _sizeClasses[i].count;
+
+    stats.fragmentation = stats.freeSize > 0 ? 1.0 - (double)stats.largestFreeSize / (double)stats.freeSize : 0.0;
+
+    return stats;
+}
+
+//-----------------------------------------------------------
+void WorkHeap::ResetStats()
+{
+    _stats = {};
+}
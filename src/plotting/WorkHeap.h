@@ -8,9 +8,39 @@
 // for doing plotting work in memory and I/O operations.
 // It is meant to have a very small amount of allocations, therefore
 // allocations are tracked in a small table that is searched linearly.
+// Released buffers are kept in small per-size free lists (size classes) in front of the heap,
+// so that the fixed-size buffers that are allocated repeatedly are handed back out
+// without searching and re-merging the heap table. Cached buffers are returned
+// to the heap whenever an allocation would otherwise have to block.
 class WorkHeap
 {
+public:
+    struct Stats
+    {
+        uint64   allocCount;        // Total allocations
+        uint64   classHitCount;     // Allocations served from a size class free list
+        uint64   waitCount;         // Allocations that had to block for buffers to be released
+        Duration waitTime;          // Total time allocations were blocked
+        size_t   freeSize;          // Unallocated heap space, not counting cached size class buffers
+        size_t   cachedSize;        // Space held in size class free lists
+        size_t   largestFreeSize;   // Largest contiguous unallocated heap space
+        size_t   freeEntryCount;    // Number of unallocated heap regions
+        double   fragmentation;     // 1 - largestFreeSize / freeSize
+    };
+
 private:
+    static constexpr uint32 MAX_SIZE_CLASSES  = 8;
+    static constexpr uint32 MAX_CLASS_BUFFERS = 32;
+
+    // Released buffers of a single allocation size.
+    // They are still tracked as allocated in the allocation table.
+    struct SizeClass
+    {
+        size_t size;
+        uint32 count;
+        byte*  buffers[MAX_CLASS_BUFFERS];
+    };
+
     // Represents a portion of unallocated space in our heap/work buffer
     struct HeapEntry
     {
@@ -58,7 +88,15 @@ public:
     // Makes pending released allocations available to the heap for allocation again.
     void CompletePendingReleases();
 
+    // These must be called from the allocating thread.
+    Stats GetStats() const;
+    void  ResetStats();
+
 private:
+    byte* AllocFromSizeClass( size_t size, size_t alignment );
+    bool  CacheInSizeClass( byte* buffer, size_t size );
+    bool  FlushSizeClasses();
+    void  FreeAllocation( size_t allocationIndex );
 
 private:
     byte*                _heap;
@@ -72,6 +110,10 @@ private:
     SPCQueue<byte*, BB_DISK_QUEUE_MAX_CMDS> _pendingReleases;      // Released buffers waiting to be re-added to the heap table
     AutoResetSignal      _releaseSignal;        // Used to signal that there's pending released buffers
 
+    SizeClass            _sizeClasses[MAX_SIZE_CLASSES];
+    uint32               _sizeClassCount = 0;
+    Stats                _stats          = {};
+
     // std::atomic<size_t>  _freeHeapSize = 0;     // Current free heap size from the perspective of the consumer thread (the allocating thread)
     // std::atomic<size_t>  _waitingSize  = 0;     // Required size for the next allocation. If the next release
                                                 // does not add up to this size, then it won't signal it
@@ -1,6 +1,398 @@
 #include "GroupScan.h"
 #include "ChiaConsts.h"
 #include "threading/MonoJob.h"
+#include "plotting/PlotTypes.h"
+#include "SysHost.h"
+
+///
+/// The group scan and the matching have AVX2, AVX-512 and NEON kernels.
+/// The x86 kernels are compiled with function-level target attributes,
+/// and are only called after checking CPU support at runtime.
+///
+/// The scan computes y / kBC as a double. y is far below 2^52, so it converts exactly,
+/// and the quotient can't round across an integer, as it is at least 1/kBC away from the next one.
+///
+/// Matching finds which of the kExtraBitsPow targets of an L entry are present in the R group
+/// through a bitmap of the R group's local y values, probed with gathers.
+/// NEON has no gathers, so it matches with the scalar loop.
+///
+
+#if defined( __x86_64__ ) || defined( _M_X64 )
+    #define GROUPSCAN_X86 1
+    #include <immintrin.h>
+
+    #if defined( _MSC_VER ) && !defined( __clang__ )
+        #include <intrin.h>
+        #define GROUPSCAN_TARGET( x )
+    #else
+        #define GROUPSCAN_TARGET( x ) __attribute__((target( x )))
+    #endif
+#elif defined( __aarch64__ ) || defined( _M_ARM64 )
+    #define GROUPSCAN_NEON 1
+    #include <arm_neon.h>
+#endif
+
+enum class GroupScanSimd
+{
+    None = 0,
+    AVX2,
+    AVX512
+};
+
+//-----------------------------------------------------------
+static GroupScanSimd GetGroupScanSimd()
+{
+#if GROUPSCAN_X86
+    if( SysHost::HasCpuFeatures( CpuFeatures::AVX512F ) )
+        return GroupScanSimd::AVX512;
+    if( SysHost::HasCpuFeatures( CpuFeatures::AVX2 ) )
+        return GroupScanSimd::AVX2;
+#endif
+    return GroupScanSimd::None;
+}
+
+//-----------------------------------------------------------
+inline static uint32 LowestBit( const uint64 mask )
+{
+#if defined( _MSC_VER ) && !defined( __clang__ )
+    unsigned long idx;
+    _BitScanForward64( &idx, mask );
+    return (uint32)idx;
+#else
+    return (uint32)__builtin_ctzll( mask );
+#endif
+}
+
+// Adds the boundaries found in a vector's mask. Returns false once maxGroups is reached.
+//-----------------------------------------------------------
+inline static bool AddGroupBoundaries( uint64 mask, const uint64 index, uint32* groupIndices, uint64& groupCount, const uint64 maxGroups )
+{
+    while( mask )
+    {
+        groupIndices[groupCount++] = (uint32)( index + LowestBit( mask ) );
+        mask &= mask - 1;
+
+        if( groupCount == maxGroups )
+            return false;
+    }
+
+    return true;
+}
+
+#if GROUPSCAN_X86
+
+/// Each kernel scans whole vectors starting at i, and returns the index at which the scalar loop resumes.
+//-----------------------------------------------------------
+GROUPSCAN_TARGET( "avx2" )
+static uint64 ScanBCGroupAVX2( const uint64* yBuffer, uint64 i, const uint64 end, uint32* groupIndices, uint64& groupCount, const uint64 maxGroups )
+{
+    const __m256d bias = _mm256_set1_pd( 4503599627370496.0 );  // 2^52
+    const __m256d kbc  = _mm256_set1_pd( (double)kBC );
+
+    // Lane 0 holds the group of the entry before the vector
+    __m256d prev = _mm256_set1_pd( (double)( yBuffer[i-1] / kBC ) );
+
+    for( ; i + 4 <= end; i += 4 )
+    {
+        const __m256i y  = _mm256_loadu_si256( (const __m256i*)( yBuffer + i ) );
+        const __m256d yd = _mm256_sub_pd( _mm256_castsi256_pd( _mm256_or_si256( y, _mm256_castpd_si256( bias ) ) ), bias );
+        const __m256d g  = _mm256_floor_pd( _mm256_div_pd( yd, kbc ) );
+
+        const __m256d rotated = _mm256_permute4x64_pd( g, _MM_SHUFFLE( 2, 1, 0, 3 ) );
+        const __m256d before  = _mm256_blend_pd( rotated, prev, 1 );
+        prev = rotated;
+
+        const uint64 mask = (uint64)_mm256_movemask_pd( _mm256_cmp_pd( g, before, _CMP_NEQ_OQ ) );
+        if( mask && !AddGroupBoundaries( mask, i, groupIndices, groupCount, maxGroups ) )
+            return end;
+    }
+
+    return i;
+}
+
+//-----------------------------------------------------------
+GROUPSCAN_TARGET( "avx512f" )
+static uint64 ScanBCGroupAVX512( const uint64* yBuffer, uint64 i, const uint64 end, uint32* groupIndices, uint64& groupCount, const uint64 maxGroups )
+{
+    const __m512d bias      = _mm512_set1_pd( 4503599627370496.0 );  // 2^52
+    const __m512d kbc       = _mm512_set1_pd( (double)kBC );
+    const __m512i rotateIdx = _mm512_set_epi64( 6, 5, 4, 3, 2, 1, 0, 7 );
+
+    __m512d prev = _mm512_set1_pd( (double)( yBuffer[i-1] / kBC ) );
+
+    for( ; i + 8 <= end; i += 8 )
+    {
+        const __m512i y  = _mm512_loadu_si512( yBuffer + i );
+        const __m512d yd = _mm512_sub_pd( _mm512_castsi512_pd( _mm512_or_si512( y, _mm512_castpd_si512( bias ) ) ), bias );
+        const __m512d g  = _mm512_roundscale_pd( _mm512_div_pd( yd, kbc ), _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC );
+
+        const __m512d rotated = _mm512_permutexvar_pd( rotateIdx, g );
+        const __m512d before  = _mm512_mask_blend_pd( 1, rotated, prev );
+        prev = rotated;
+
+        const uint64 mask = (uint64)_mm512_cmp_pd_mask( g, before, _CMP_NEQ_OQ );
+        if( mask && !AddGroupBoundaries( mask, i, groupIndices, groupCount, maxGroups ) )
+            return end;
+    }
+
+    return i;
+}
+
+#elif GROUPSCAN_NEON
+
+//-----------------------------------------------------------
+static uint64 ScanBCGroupNEON( const uint64* yBuffer, uint64 i, const uint64 end, uint32* groupIndices, uint64& groupCount, const uint64 maxGroups )
+{
+    const float64x2_t kbc = vdupq_n_f64( (double)kBC );
+
+    uint64x2_t prev = vdupq_n_u64( yBuffer[i-1] / kBC );
+
+    for( ; i + 2 <= end; i += 2 )
+    {
+        // Converting back to an integer truncates, which is the floor here
+        const uint64x2_t g      = vcvtq_u64_f64( vdivq_f64( vcvtq_f64_u64( vld1q_u64( yBuffer + i ) ), kbc ) );
+        const uint64x2_t before = vextq_u64( prev, g, 1 );
+        prev = g;
+
+        const uint64x2_t eq   = vceqq_u64( g, before );
+        const uint64     mask = ( vgetq_lane_u64( eq, 0 ) ? 0 : 1 ) | ( vgetq_lane_u64( eq, 1 ) ? 0 : 2 );
+
+        if( mask && !AddGroupBoundaries( mask, i, groupIndices, groupCount, maxGroups ) )
+            return end;
+    }
+
+    return i;
+}
+
+#endif
+
+#if GROUPSCAN_X86
+
+/// Map of the local y values present in an R group.
+/// Only the bitmap needs clearing between groups, the counts and
+/// indices are only ever read for the y values set in it.
+//-----------------------------------------------------------
+struct RGroupMap
+{
+    static constexpr uint32 Words = ( kBC + 31 ) / 32;
+
+    alignas( 64 ) uint32 bits[Words];
+    uint8                counts [kBC];
+    uint16               indices[kBC];
+};
+
+//-----------------------------------------------------------
+inline static void BuildRGroupMap( RGroupMap& map, const uint64* yR, const uint32 rCount, const uint64 rRangeStart )
+{
+    memset( map.bits, 0, sizeof( map.bits ) );
+
+    for( uint32 iR = 0; iR < rCount; iR++ )
+    {
+        const uint32 localR = (uint32)( yR[iR] - rRangeStart );
+        const uint32 bit    = 1u << ( localR & 31 );
+
+        ASSERT( localR < kBC );
+
+        if( !( map.bits[localR >> 5] & bit ) )
+        {
+            map.bits[localR >> 5] |= bit;
+            map.counts [localR] = 0;
+            map.indices[localR] = (uint16)iR;
+        }
+
+        map.counts[localR]++;
+    }
+}
+
+// Emits the pairs for each target whose bit is set in hits, in target order.
+// Returns false once maxPairs is reached.
+//-----------------------------------------------------------
+inline static bool EmitTargetPairs( const RGroupMap& map, const uint16* targets, uint64 hits, const uint32 iL,
+                                    const uint32 lOffset, const uint32 rOffset, Pair* pairs, uint32& pairCount, const uint32 maxPairs )
+{
+    while( hits )
+    {
+        const uint16 targetR = targets[LowestBit( hits )];
+        hits &= hits - 1;
+
+        const uint32 rIdx  = map.indices[targetR];
+        const uint32 count = map.counts [targetR];
+
+        for( uint32 j = 0; j < count; j++ )
+        {
+            if( pairCount == maxPairs )
+                return false;
+
+            Pair& pair = pairs[pairCount++];
+            pair.left  = lOffset + iL;
+            pair.right = rOffset + rIdx + j;
+        }
+    }
+
+    return true;
+}
+
+#endif // GROUPSCAN_X86
+
+// Without gathers, probing every target through the bitmap is slower than the count map's branches
+//-----------------------------------------------------------
+static uint32 MatchBCGroupPairScalar( const uint64* yL, const uint32 lCount, const uint64* yR, const uint32 rCount, const uint64 groupL,
+                                      const uint32 lOffset, const uint32 rOffset, Pair* pairs, const uint32 maxPairs )
+{
+    const uint64 lRangeStart = groupL * kBC;
+    const uint64 rRangeStart = lRangeStart + kBC;
+    const uint32 parity      = (uint32)( groupL & 1 );
+
+    uint8  rMapCounts [kBC];
+    uint16 rMapIndices[kBC];
+
+    // #NOTE: memset(0) works faster on average than keeping a separate a clearing buffer
+    memset( rMapCounts, 0, sizeof( rMapCounts ) );
+
+    for( uint32 iR = 0; iR < rCount; iR++ )
+    {
+        const uint64 localRY = yR[iR] - rRangeStart;
+        ASSERT( localRY < kBC );
+
+        if( rMapCounts[localRY] == 0 )
+            rMapIndices[localRY] = (uint16)iR;
+
+        rMapCounts[localRY]++;
+    }
+
+    uint32 pairCount = 0;
+
+    for( uint32 iL = 0; iL < lCount; iL++ )
+    {
+        const uint16* targets = L_targets[parity][yL[iL] - lRangeStart];
+
+        for( uint32 iK = 0; iK < kExtraBitsPow; iK++ )
+        {
+            const uint16 targetR = targets[iK];
+
+            for( uint32 j = 0; j < rMapCounts[targetR]; j++ )
+            {
+                if( pairCount == maxPairs )
+                    return pairCount;
+
+                Pair& pair = pairs[pairCount++];
+                pair.left  = lOffset + iL;
+                pair.right = rOffset + rMapIndices[targetR] + j;
+            }
+        }
+    }
+
+    return pairCount;
+}
+
+#if GROUPSCAN_X86
+
+//-----------------------------------------------------------
+GROUPSCAN_TARGET( "avx2" )
+static uint32 MatchBCGroupPairAVX2( const uint64* yL, const uint32 lCount, const uint64* yR, const uint32 rCount, const uint64 groupL,
+                                    const uint32 lOffset, const uint32 rOffset, Pair* pairs, const uint32 maxPairs )
+{
+    static_assert( kExtraBitsPow == 64 );
+
+    const uint64  lRangeStart = groupL * kBC;
+    const uint32  parity      = (uint32)( groupL & 1 );
+    const __m256i lowBits     = _mm256_set1_epi32( 31 );
+
+    RGroupMap map;
+    BuildRGroupMap( map, yR, rCount, lRangeStart + kBC );
+
+    uint32 pairCount = 0;
+
+    for( uint32 iL = 0; iL < lCount; iL++ )
+    {
+        const uint16* targets = L_targets[parity][yL[iL] - lRangeStart];
+
+        uint64 hits = 0;
+        for( uint32 v = 0; v < 4; v++ )
+        {
+            const __m256i t16 = _mm256_loadu_si256( (const __m256i*)( targets + v * 16 ) );
+
+            for( uint32 h = 0; h < 2; h++ )
+            {
+                const __m256i t     = _mm256_cvtepu16_epi32( h == 0 ? _mm256_castsi256_si128( t16 ) : _mm256_extracti128_si256( t16, 1 ) );
+                const __m256i words = _mm256_i32gather_epi32( (const int*)map.bits, _mm256_srli_epi32( t, 5 ), 4 );
+                const __m256i bits  = _mm256_slli_epi32( _mm256_srlv_epi32( words, _mm256_and_si256( t, lowBits ) ), 31 );
+
+                hits |= (uint64)(uint32)_mm256_movemask_ps( _mm256_castsi256_ps( bits ) ) << ( v * 16 + h * 8 );
+            }
+        }
+
+        if( hits && !EmitTargetPairs( map, targets, hits, iL, lOffset, rOffset, pairs, pairCount, maxPairs ) )
+            break;
+    }
+
+    return pairCount;
+}
+
+//-----------------------------------------------------------
+GROUPSCAN_TARGET( "avx512f" )
+static uint32 MatchBCGroupPairAVX512( const uint64* yL, const uint32 lCount, const uint64* yR, const uint32 rCount, const uint64 groupL,
+                                      const uint32 lOffset, const uint32 rOffset, Pair* pairs, const uint32 maxPairs )
+{
+    static_assert( kExtraBitsPow == 64 );
+
+    const uint64  lRangeStart = groupL * kBC;
+    const uint32  parity      = (uint32)( groupL & 1 );
+    const __m512i lowBits     = _mm512_set1_epi32( 31 );
+    const __m512i one         = _mm512_set1_epi32( 1 );
+
+    RGroupMap map;
+    BuildRGroupMap( map, yR, rCount, lRangeStart + kBC );
+
+    uint32 pairCount = 0;
+
+    for( uint32 iL = 0; iL < lCount; iL++ )
+    {
+        const uint16* targets = L_targets[parity][yL[iL] - lRangeStart];
+
+        uint64 hits = 0;
+        for( uint32 v = 0; v < 4; v++ )
+        {
+            const __m512i t     = _mm512_cvtepu16_epi32( _mm256_loadu_si256( (const __m256i*)( targets + v * 16 ) ) );
+            const __m512i words = _mm512_i32gather_epi32( _mm512_srli_epi32( t, 5 ), map.bits, 4 );
+            const __m512i bits  = _mm512_srlv_epi32( words, _mm512_and_si512( t, lowBits ) );
+
+            hits |= (uint64)_mm512_test_epi32_mask( bits, one ) << ( v * 16 );
+        }
+
+        if( hits && !EmitTargetPairs( map, targets, hits, iL, lOffset, rOffset, pairs, pairCount, maxPairs ) )
+            break;
+    }
+
+    return pairCount;
+}
+
+#endif // GROUPSCAN_X86
+
+//-----------------------------------------------------------
+uint32 MatchBCGroupPair(
+    const uint64* yL,
+    const uint32  lCount,
+    const uint64* yR,
+    const uint32  rCount,
+    const uint64  groupL,
+    const uint32  lOffset,
+    const uint32  rOffset,
+    Pair*         pairs,
+    const uint32  maxPairs )
+{
+#if GROUPSCAN_X86
+    static const GroupScanSimd simd = GetGroupScanSimd();
+
+    if( simd == GroupScanSimd::AVX512 )
+        return MatchBCGroupPairAVX512( yL, lCount, yR, rCount, groupL, lOffset, rOffset, pairs, maxPairs );
+    if( simd == GroupScanSimd::AVX2 )
+        return MatchBCGroupPairAVX2( yL, lCount, yR, rCount, groupL, lOffset, rOffset, pairs, maxPairs );
+#endif
+
+    // NEON has no gathers, so it uses the scalar matching
+    return MatchBCGroupPairScalar( yL, lCount, yR, rCount, groupL, lOffset, rOffset, pairs, maxPairs );
+}
 
 struct ScanJob : MTJob<ScanJob>
 {
@@ -37,9 +429,22 @@ uint64 ScanBCGroupThread32(
     }
 
     uint64 groupCount = 0;
-    uint64 prevGroup  = yBuffer[scanStart] / kBC;
+    uint64 i          = scanStart + 1;
+
+#if GROUPSCAN_X86
+    static const GroupScanSimd simd = GetGroupScanSimd();
+
+    if( simd == GroupScanSimd::AVX512 )
+        i = ScanBCGroupAVX512( yBuffer, i, scanEnd, groupIndices, groupCount, maxGroups );
+    else if( simd == GroupScanSimd::AVX2 )
+        i = ScanBCGroupAVX2( yBuffer, i, scanEnd, groupIndices, groupCount, maxGroups );
+#elif GROUPSCAN_NEON
+    i = ScanBCGroupNEON( yBuffer, i, scanEnd, groupIndices, groupCount, maxGroups );
+#endif
+
+    uint64 prevGroup = yBuffer[i-1] / kBC;
 
-    for( uint64 i = scanStart + 1; i < scanEnd; i++ )
+    for( ; i < scanEnd; i++ )
     {
         const uint64 group = yBuffer[i] / kBC;
         if( group == prevGroup )
@@ -2,6 +2,8 @@
 
 #include "threading/ThreadPool.h"
 
+struct Pair;
+
 // Returns: Group count found, minus the last 2 ghost groups.
 uint64 ScanBCGroupThread32(
     const uint64* yBuffer,
@@ -20,4 +22,19 @@ uint64 ScanBCGroupMT32(
           uint32* tmpGroupIndices,
           uint32* outGroupIndices,
     const uint32  maxGroups
-);
\ No newline at end of file
+);
+
+// Matches the entries of the kBC group groupL against the ones in the adjacent group, groupL+1.
+// Both groups must be sorted on y. Each pair is written as the index of its entries in their group,
+// plus lOffset and rOffset, respectively, in the same order as the scalar matching loops.
+// Returns the number of pairs written, which is never more than maxPairs.
+uint32 MatchBCGroupPair(
+    const uint64* yL,
+    uint32        lCount,
+    const uint64* yR,
+    uint32        rCount,
+    uint64        groupL,
+    uint32        lOffset,
+    uint32        rOffset,
+    Pair*         pairs,
+    uint32        maxPairs );
@@ -1,4 +1,5 @@
-#include "chacha8.h"
+#include "chacha8_impl.h"
+#include "SysHost.h"
 
 #define U32TO32_LITTLE(v) (v)
 #define U8TO32_LITTLE(p) (*(const uint32_t *)(p))
@@ -54,7 +55,7 @@ void chacha8_keysetup(struct chacha8_ctx *x, const uint8_t *k, uint32_t kbits, c
     }
 }
 
-void chacha8_get_keystream(const struct chacha8_ctx *x, uint64_t pos, uint32_t n_blocks, uint8_t *c)
+void chacha8_get_keystream_portable(const struct chacha8_ctx *x, uint64_t pos, uint32_t n_blocks, uint8_t *c)
 {
     uint32_t x0, x1, x2, x3, x4, x5, x6, x7, x8, x9, x10, x11, x12, x13, x14, x15;
     uint32_t j0, j1, j2, j3, j4, j5, j6, j7, j8, j9, j10, j11, j12, j13, j14, j15;
@@ -147,3 +148,100 @@ void chacha8_get_keystream(const struct chacha8_ctx *x, uint64_t pos, uint32_t n
         c += 64;
     }
 }
+
+#if CHACHA8_X86
+
+enum chacha8_cpu_feature {
+    CHACHA8_AVX2    = 1 << 0,
+    CHACHA8_AVX512F = 1 << 1,
+};
+
+//-----------------------------------------------------------
+static uint32_t chacha8_detect_cpu_features()
+{
+    uint32_t features = 0;
+
+    if( SysHost::HasCpuFeatures( CpuFeatures::AVX2 ) )
+        features |= CHACHA8_AVX2;
+    if( SysHost::HasCpuFeatures( CpuFeatures::AVX512F ) )
+        features |= CHACHA8_AVX512F;
+
+    return features;
+}
+
+#endif // CHACHA8_X86
+
+//-----------------------------------------------------------
+// Runs as many blocks as possible through the widest kernel the CPU supports,
+// then finishes the tail with the portable implementation.
+// If positions is not null, block i is at positions[i] instead of pos + i.
+//-----------------------------------------------------------
+static void chacha8_get_keystream_dispatch(const struct chacha8_ctx *x, uint64_t pos, const uint64_t *positions, uint32_t n_blocks, uint8_t *c)
+{
+#if CHACHA8_X86
+    static const uint32_t features = chacha8_detect_cpu_features();
+
+    if( (features & CHACHA8_AVX512F) && n_blocks >= CHACHA8_AVX512_BLOCKS )
+    {
+        const uint32_t count = n_blocks - n_blocks % CHACHA8_AVX512_BLOCKS;
+        chacha8_get_keystream_avx512( x, pos, positions, count, c );
+
+        pos      += count;
+        n_blocks -= count;
+        c        += (uint64_t)count * 64;
+
+        if( positions )
+            positions += count;
+    }
+
+    if( (features & CHACHA8_AVX2) && n_blocks >= CHACHA8_AVX2_BLOCKS )
+    {
+        const uint32_t count = n_blocks - n_blocks % CHACHA8_AVX2_BLOCKS;
+        chacha8_get_keystream_avx2( x, pos, positions, count, c );
+
+        pos      += count;
+        n_blocks -= count;
+        c        += (uint64_t)count * 64;
+
+        if( positions )
+            positions += count;
+    }
+#elif CHACHA8_NEON
+    if( n_blocks >= CHACHA8_NEON_BLOCKS )
+    {
+        const uint32_t count = n_blocks - n_blocks % CHACHA8_NEON_BLOCKS;
+        chacha8_get_keystream_neon( x, pos, positions, count, c );
+
+        pos      += count;
+        n_blocks -= count;
+        c        += (uint64_t)count * 64;
+
+        if( positions )
+            positions += count;
+    }
+#endif
+
+    if( !n_blocks )
+        return;
+
+    if( !positions )
+    {
+        chacha8_get_keystream_portable( x, pos, n_blocks, c );
+        return;
+    }
+
+    for( uint32_t i = 0; i < n_blocks; i++ )
+        chacha8_get_keystream_portable( x, positions[i], 1, c + (uint64_t)i * 64 );
+}
+
+//-----------------------------------------------------------
+void chacha8_get_keystream(const struct chacha8_ctx *x, uint64_t pos, uint32_t n_blocks, uint8_t *c)
+{
+    chacha8_get_keystream_dispatch( x, pos, nullptr, n_blocks, c );
+}
+
+//-----------------------------------------------------------
+void chacha8_get_keystream_blocks(const struct chacha8_ctx *x, const uint64_t *positions, uint32_t n_blocks, uint8_t *c)
+{
+    chacha8_get_keystream_dispatch( x, 0, positions, n_blocks, c );
+}
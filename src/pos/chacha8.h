@@ -18,6 +18,13 @@ void chacha8_get_keystream(
     uint32_t n_blocks,
     uint8_t *c);
 
+// Same as chacha8_get_keystream, for blocks at arbitrary positions.
+// Block i is generated at positions[i] and written at c + i * 64.
+void chacha8_get_keystream_blocks(
+    const struct chacha8_ctx *x,
+    const uint64_t *positions,
+    uint32_t n_blocks,
+    uint8_t *c);
 
 void chacha8_get_keystream_cuda(
     const uint32_t* input,
@@ -0,0 +1,37 @@
+#ifndef SRC_CHACHA8_IMPL_H_
+#define SRC_CHACHA8_IMPL_H_
+
+#include "chacha8.h"
+
+#if defined( __x86_64__ ) || defined( _M_X64 )
+    #define CHACHA8_X86 1
+#elif defined( __aarch64__ ) || defined( _M_ARM64 )
+    #define CHACHA8_NEON 1
+#endif
+
+// The minimum number of blocks each wide kernel processes per iteration.
+#define CHACHA8_AVX512_BLOCKS 16
+#define CHACHA8_AVX2_BLOCKS   8
+#define CHACHA8_NEON_BLOCKS   4
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Scalar, one block at a time. Handles any block count.
+void chacha8_get_keystream_portable( const struct chacha8_ctx *x, uint64_t pos, uint32_t n_blocks, uint8_t *c );
+
+// Wide kernels. n_blocks must be a multiple of the kernel's block width.
+// If positions is not null, block i is generated at positions[i] instead of pos + i.
+#if CHACHA8_X86
+void chacha8_get_keystream_avx2  ( const struct chacha8_ctx *x, uint64_t pos, const uint64_t *positions, uint32_t n_blocks, uint8_t *c );
+void chacha8_get_keystream_avx512( const struct chacha8_ctx *x, uint64_t pos, const uint64_t *positions, uint32_t n_blocks, uint8_t *c );
+#elif CHACHA8_NEON
+void chacha8_get_keystream_neon  ( const struct chacha8_ctx *x, uint64_t pos, const uint64_t *positions, uint32_t n_blocks, uint8_t *c );
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // SRC_CHACHA8_IMPL_H_
@@ -0,0 +1,318 @@
+#include "chacha8_impl.h"
+
+///
+/// Multi-block ChaCha8 keystream kernels.
+/// Each kernel runs N independent blocks, one per vector lane, and then
+/// transposes the state so the output matches the layout chacha8_get_keystream_portable produces.
+/// The blocks are at consecutive positions starting at pos, or at positions[i] if positions is not null.
+/// The kernels are compiled with function-level target attributes so that no
+/// per-file ISA flags are required. Callers must check CPU support first (see chacha8.cpp).
+///
+
+#if defined( _MSC_VER ) && !defined( __clang__ )
+    #define CHACHA8_TARGET( x )
+#else
+    #define CHACHA8_TARGET( x ) __attribute__((target( x )))
+#endif
+
+#if CHACHA8_X86
+    #include <immintrin.h>
+#elif CHACHA8_NEON
+    #include <arm_neon.h>
+#endif
+
+#if CHACHA8_X86
+
+///
+/// AVX2
+///
+#define CHACHA8_AVX2_FN static inline CHACHA8_TARGET( "avx2" )
+
+//-----------------------------------------------------------
+CHACHA8_AVX2_FN __m256i rot16_256( const __m256i v )
+{
+    return _mm256_shuffle_epi8( v, _mm256_set_epi8( 13,12,15,14,  9, 8,11,10,  5, 4, 7, 6,  1, 0, 3, 2,
+                                                    13,12,15,14,  9, 8,11,10,  5, 4, 7, 6,  1, 0, 3, 2 ) );
+}
+
+//-----------------------------------------------------------
+CHACHA8_AVX2_FN __m256i rot8_256( const __m256i v )
+{
+    return _mm256_shuffle_epi8( v, _mm256_set_epi8( 14,13,12,15, 10, 9, 8,11,  6, 5, 4, 7,  2, 1, 0, 3,
+                                                    14,13,12,15, 10, 9, 8,11,  6, 5, 4, 7,  2, 1, 0, 3 ) );
+}
+
+#define ROTL_256( v, n ) _mm256_or_si256( _mm256_slli_epi32( v, n ), _mm256_srli_epi32( v, 32 - (n) ) )
+
+#define QUARTERROUND_256( a, b, c, d )                                              \
+    a = _mm256_add_epi32( a, b ); d = rot16_256( _mm256_xor_si256( d, a ) );        \
+    c = _mm256_add_epi32( c, d ); b = ROTL_256( _mm256_xor_si256( b, c ), 12 );     \
+    a = _mm256_add_epi32( a, b ); d = rot8_256( _mm256_xor_si256( d, a ) );         \
+    c = _mm256_add_epi32( c, d ); b = ROTL_256( _mm256_xor_si256( b, c ), 7 )
+
+//-----------------------------------------------------------
+// Runs the 8 rounds over a 16-word state and adds the input back in.
+//-----------------------------------------------------------
+CHACHA8_AVX2_FN void chacha8_rounds_256( __m256i x[16] )
+{
+    __m256i j[16];
+    for( int i = 0; i < 16; i++ )
+        j[i] = x[i];
+
+    for( int i = 8; i > 0; i -= 2 )
+    {
+        QUARTERROUND_256( x[0], x[4], x[ 8], x[12] );
+        QUARTERROUND_256( x[1], x[5], x[ 9], x[13] );
+        QUARTERROUND_256( x[2], x[6], x[10], x[14] );
+        QUARTERROUND_256( x[3], x[7], x[11], x[15] );
+        QUARTERROUND_256( x[0], x[5], x[10], x[15] );
+        QUARTERROUND_256( x[1], x[6], x[11], x[12] );
+        QUARTERROUND_256( x[2], x[7], x[ 8], x[13] );
+        QUARTERROUND_256( x[3], x[4], x[ 9], x[14] );
+    }
+
+    for( int i = 0; i < 16; i++ )
+        x[i] = _mm256_add_epi32( x[i], j[i] );
+}
+
+//-----------------------------------------------------------
+// Transposes 8 words x 8 blocks and writes each block's 8 words at c + block * 64.
+//-----------------------------------------------------------
+CHACHA8_AVX2_FN void chacha8_store_8x8( const __m256i a[8], uint8_t *c )
+{
+    const __m256i t0 = _mm256_unpacklo_epi32( a[0], a[1] );
+    const __m256i t1 = _mm256_unpackhi_epi32( a[0], a[1] );
+    const __m256i t2 = _mm256_unpacklo_epi32( a[2], a[3] );
+    const __m256i t3 = _mm256_unpackhi_epi32( a[2], a[3] );
+    const __m256i t4 = _mm256_unpacklo_epi32( a[4], a[5] );
+    const __m256i t5 = _mm256_unpackhi_epi32( a[4], a[5] );
+    const __m256i t6 = _mm256_unpacklo_epi32( a[6], a[7] );
+    const __m256i t7 = _mm256_unpackhi_epi32( a[6], a[7] );
+
+    const __m256i u0 = _mm256_unpacklo_epi64( t0, t2 );
+    const __m256i u1 = _mm256_unpackhi_epi64( t0, t2 );
+    const __m256i u2 = _mm256_unpacklo_epi64( t1, t3 );
+    const __m256i u3 = _mm256_unpackhi_epi64( t1, t3 );
+    const __m256i u4 = _mm256_unpacklo_epi64( t4, t6 );
+    const __m256i u5 = _mm256_unpackhi_epi64( t4, t6 );
+    const __m256i u6 = _mm256_unpacklo_epi64( t5, t7 );
+    const __m256i u7 = _mm256_unpackhi_epi64( t5, t7 );
+
+    _mm256_storeu_si256( (__m256i*)(c + 0 * 64), _mm256_permute2x128_si256( u0, u4, 0x20 ) );
+    _mm256_storeu_si256( (__m256i*)(c + 1 * 64), _mm256_permute2x128_si256( u1, u5, 0x20 ) );
+    _mm256_storeu_si256( (__m256i*)(c + 2 * 64), _mm256_permute2x128_si256( u2, u6, 0x20 ) );
+    _mm256_storeu_si256( (__m256i*)(c + 3 * 64), _mm256_permute2x128_si256( u3, u7, 0x20 ) );
+    _mm256_storeu_si256( (__m256i*)(c + 4 * 64), _mm256_permute2x128_si256( u0, u4, 0x31 ) );
+    _mm256_storeu_si256( (__m256i*)(c + 5 * 64), _mm256_permute2x128_si256( u1, u5, 0x31 ) );
+    _mm256_storeu_si256( (__m256i*)(c + 6 * 64), _mm256_permute2x128_si256( u2, u6, 0x31 ) );
+    _mm256_storeu_si256( (__m256i*)(c + 7 * 64), _mm256_permute2x128_si256( u3, u7, 0x31 ) );
+}
+
+//-----------------------------------------------------------
+CHACHA8_TARGET( "avx2" )
+void chacha8_get_keystream_avx2( const struct chacha8_ctx *ctx, uint64_t pos, const uint64_t *positions, uint32_t n_blocks, uint8_t *c )
+{
+    __m256i input[16];
+    for( int i = 0; i < 16; i++ )
+        input[i] = _mm256_set1_epi32( (int)ctx->input[i] );
+
+    for( ; n_blocks >= CHACHA8_AVX2_BLOCKS; n_blocks -= CHACHA8_AVX2_BLOCKS )
+    {
+        // The 64-bit block counter lives in words 12 and 13
+        alignas( 32 ) uint32_t lo[CHACHA8_AVX2_BLOCKS], hi[CHACHA8_AVX2_BLOCKS];
+        for( int i = 0; i < CHACHA8_AVX2_BLOCKS; i++ )
+        {
+            const uint64_t p = positions ? positions[i] : pos + (uint64_t)i;
+            lo[i] = (uint32_t)p;
+            hi[i] = (uint32_t)(p >> 32);
+        }
+
+        __m256i x[16];
+        for( int i = 0; i < 16; i++ )
+            x[i] = input[i];
+
+        x[12] = _mm256_load_si256( (const __m256i*)lo );
+        x[13] = _mm256_load_si256( (const __m256i*)hi );
+
+        chacha8_rounds_256( x );
+
+        chacha8_store_8x8( x + 0, c + 0  );
+        chacha8_store_8x8( x + 8, c + 32 );
+
+        pos += CHACHA8_AVX2_BLOCKS;
+        c   += CHACHA8_AVX2_BLOCKS * 64;
+
+        if( positions )
+            positions += CHACHA8_AVX2_BLOCKS;
+    }
+}
+
+///
+/// AVX-512
+///
+#define CHACHA8_AVX512_FN static inline CHACHA8_TARGET( "avx512f" )
+
+// The zero-masked intrinsic forms avoid GCC's spurious maybe-uninitialized warnings
+#define ROTL_512( v, n ) _mm512_maskz_rol_epi32( (__mmask16)0xFFFF, v, n )
+
+#define QUARTERROUND_512( a, b, c, d )                                              \
+    a = _mm512_add_epi32( a, b ); d = ROTL_512( _mm512_xor_si512( d, a ), 16 );     \
+    c = _mm512_add_epi32( c, d ); b = ROTL_512( _mm512_xor_si512( b, c ), 12 );     \
+    a = _mm512_add_epi32( a, b ); d = ROTL_512( _mm512_xor_si512( d, a ), 8  );     \
+    c = _mm512_add_epi32( c, d ); b = ROTL_512( _mm512_xor_si512( b, c ), 7  )
+
+//-----------------------------------------------------------
+CHACHA8_AVX512_FN void chacha8_rounds_512( __m512i x[16] )
+{
+    __m512i j[16];
+    for( int i = 0; i < 16; i++ )
+        j[i] = x[i];
+
+    for( int i = 8; i > 0; i -= 2 )
+    {
+        QUARTERROUND_512( x[0], x[4], x[ 8], x[12] );
+        QUARTERROUND_512( x[1], x[5], x[ 9], x[13] );
+        QUARTERROUND_512( x[2], x[6], x[10], x[14] );
+        QUARTERROUND_512( x[3], x[7], x[11], x[15] );
+        QUARTERROUND_512( x[0], x[5], x[10], x[15] );
+        QUARTERROUND_512( x[1], x[6], x[11], x[12] );
+        QUARTERROUND_512( x[2], x[7], x[ 8], x[13] );
+        QUARTERROUND_512( x[3], x[4], x[ 9], x[14] );
+    }
+
+    for( int i = 0; i < 16; i++ )
+        x[i] = _mm512_add_epi32( x[i], j[i] );
+}
+
+//-----------------------------------------------------------
+CHACHA8_TARGET( "avx512f" )
+void chacha8_get_keystream_avx512( const struct chacha8_ctx *ctx, uint64_t pos, const uint64_t *positions, uint32_t n_blocks, uint8_t *c )
+{
+    __m512i input[16];
+    for( int i = 0; i < 16; i++ )
+        input[i] = _mm512_set1_epi32( (int)ctx->input[i] );
+
+    for( ; n_blocks >= CHACHA8_AVX512_BLOCKS; n_blocks -= CHACHA8_AVX512_BLOCKS )
+    {
+        alignas( 64 ) uint32_t lo[CHACHA8_AVX512_BLOCKS], hi[CHACHA8_AVX512_BLOCKS];
+        for( int i = 0; i < CHACHA8_AVX512_BLOCKS; i++ )
+        {
+            const uint64_t p = positions ? positions[i] : pos + (uint64_t)i;
+            lo[i] = (uint32_t)p;
+            hi[i] = (uint32_t)(p >> 32);
+        }
+
+        __m512i x[16];
+        for( int i = 0; i < 16; i++ )
+            x[i] = input[i];
+
+        x[12] = _mm512_load_si512( lo );
+        x[13] = _mm512_load_si512( hi );
+
+        chacha8_rounds_512( x );
+
+        // Split into blocks [0,8) and [8,16) and reuse the 8x8 transpose
+        __m256i a[16], b[16];
+        for( int i = 0; i < 16; i++ )
+        {
+            a[i] = _mm512_maskz_extracti64x4_epi64( (__mmask8)0xFF, x[i], 0 );
+            b[i] = _mm512_maskz_extracti64x4_epi64( (__mmask8)0xFF, x[i], 1 );
+        }
+
+        chacha8_store_8x8( a + 0, c + 0  );
+        chacha8_store_8x8( a + 8, c + 32 );
+        chacha8_store_8x8( b + 0, c + 8 * 64 + 0  );
+        chacha8_store_8x8( b + 8, c + 8 * 64 + 32 );
+
+        pos += CHACHA8_AVX512_BLOCKS;
+        c   += CHACHA8_AVX512_BLOCKS * 64;
+
+        if( positions )
+            positions += CHACHA8_AVX512_BLOCKS;
+    }
+}
+
+#elif CHACHA8_NEON
+
+///
+/// NEON
+///
+#define ROTL_128( v, n ) vorrq_u32( vshlq_n_u32( v, n ), vshrq_n_u32( v, 32 - (n) ) )
+#define ROT16_128( v )   vreinterpretq_u32_u16( vrev32q_u16( vreinterpretq_u16_u32( v ) ) )
+
+#define QUARTERROUND_128( a, b, c, d )                                  \
+    a = vaddq_u32( a, b ); d = ROT16_128( veorq_u32( d, a ) );          \
+    c = vaddq_u32( c, d ); b = ROTL_128( veorq_u32( b, c ), 12 );       \
+    a = vaddq_u32( a, b ); d = ROTL_128( veorq_u32( d, a ), 8 );        \
+    c = vaddq_u32( c, d ); b = ROTL_128( veorq_u32( b, c ), 7 )
+
+//-----------------------------------------------------------
+// Transposes 4 words x 4 blocks and writes each block's 4 words at c + block * 64.
+//-----------------------------------------------------------
+static inline void chacha8_store_4x4( const uint32x4_t a[4], uint8_t *c )
+{
+    const uint32x4x2_t t01 = vtrnq_u32( a[0], a[1] );
+    const uint32x4x2_t t23 = vtrnq_u32( a[2], a[3] );
+
+    vst1q_u8( c + 0 * 64, vreinterpretq_u8_u32( vcombine_u32( vget_low_u32 ( t01.val[0] ), vget_low_u32 ( t23.val[0] ) ) ) );
+    vst1q_u8( c + 1 * 64, vreinterpretq_u8_u32( vcombine_u32( vget_low_u32 ( t01.val[1] ), vget_low_u32 ( t23.val[1] ) ) ) );
+    vst1q_u8( c + 2 * 64, vreinterpretq_u8_u32( vcombine_u32( vget_high_u32( t01.val[0] ), vget_high_u32( t23.val[0] ) ) ) );
+    vst1q_u8( c + 3 * 64, vreinterpretq_u8_u32( vcombine_u32( vget_high_u32( t01.val[1] ), vget_high_u32( t23.val[1] ) ) ) );
+}
+
+//-----------------------------------------------------------
+void chacha8_get_keystream_neon( const struct chacha8_ctx *ctx, uint64_t pos, const uint64_t *positions, uint32_t n_blocks, uint8_t *c )
+{
+    uint32x4_t input[16];
+    for( int i = 0; i < 16; i++ )
+        input[i] = vdupq_n_u32( ctx->input[i] );
+
+    for( ; n_blocks >= CHACHA8_NEON_BLOCKS; n_blocks -= CHACHA8_NEON_BLOCKS )
+    {
+        uint32_t lo[CHACHA8_NEON_BLOCKS], hi[CHACHA8_NEON_BLOCKS];
+        for( int i = 0; i < CHACHA8_NEON_BLOCKS; i++ )
+        {
+            const uint64_t p = positions ? positions[i] : pos + (uint64_t)i;
+            lo[i] = (uint32_t)p;
+            hi[i] = (uint32_t)(p >> 32);
+        }
+
+        uint32x4_t x[16], j[16];
+        for( int i = 0; i < 16; i++ )
+            x[i] = input[i];
+
+        x[12] = vld1q_u32( lo );
+        x[13] = vld1q_u32( hi );
+
+        for( int i = 0; i < 16; i++ )
+            j[i] = x[i];
+
+        for( int i = 8; i > 0; i -= 2 )
+        {
+            QUARTERROUND_128( x[0], x[4], x[ 8], x[12] );
+            QUARTERROUND_128( x[1], x[5], x[ 9], x[13] );
+            QUARTERROUND_128( x[2], x[6], x[10], x[14] );
+            QUARTERROUND_128( x[3], x[7], x[11], x[15] );
+            QUARTERROUND_128( x[0], x[5], x[10], x[15] );
+            QUARTERROUND_128( x[1], x[6], x[11], x[12] );
+            QUARTERROUND_128( x[2], x[7], x[ 8], x[13] );
+            QUARTERROUND_128( x[3], x[4], x[ 9], x[14] );
+        }
+
+        for( int i = 0; i < 16; i++ )
+            x[i] = vaddq_u32( x[i], j[i] );
+
+        chacha8_store_4x4( x + 0 , c + 0  );
+        chacha8_store_4x4( x + 4 , c + 16 );
+        chacha8_store_4x4( x + 8 , c + 32 );
+        chacha8_store_4x4( x + 12, c + 48 );
+
+        pos += CHACHA8_NEON_BLOCKS;
+        c   += CHACHA8_NEON_BLOCKS * 64;
+
+        if( positions )
+            positions += CHACHA8_NEON_BLOCKS;
+    }
+}
+
+#endif // CHACHA8_NEON
@@ -0,0 +1,94 @@
+#include "AddressWait.h"
+#include "util/Util.h"
+
+#if PLATFORM_IS_LINUX
+    #include <linux/futex.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#elif PLATFORM_IS_WINDOWS
+    #include <Windows.h>
+    #pragma comment( lib, "Synchronization.lib" )
+#elif PLATFORM_IS_APPLE
+    // Private, but stable since macOS 10.12. libc++ builds std::atomic::wait() on it.
+    extern "C" int __ulock_wait( uint32_t operation, void* addr, uint64_t value, uint32_t timeout_us );
+    extern "C" int __ulock_wake( uint32_t operation, void* addr, uint64_t wake_value );
+
+    #define BB_UL_COMPARE_AND_WAIT  1
+    #define BB_ULF_WAKE_ALL         0x00000100
+    #define BB_ULF_NO_ERRNO         0x01000000
+#endif
+
+static_assert( sizeof( std::atomic<uint32> ) == sizeof( uint32 ) );
+
+//-----------------------------------------------------------
+bool AddressWait::Wait( std::atomic<uint32>& value, const uint32 expected, const int32 timeoutMS )
+{
+#if PLATFORM_IS_LINUX
+    struct timespec  timeout;
+    struct timespec* pTimeout = nullptr;
+
+    if( timeoutMS != WaitInfinite )
+    {
+        timeout.tv_sec  = (time_t)( timeoutMS / 1000 );
+        timeout.tv_nsec = (long)( timeoutMS % 1000 ) * 1000000;
+        pTimeout = &timeout;
+    }
+
+    const long r = syscall( SYS_futex, (uint32*)&value, FUTEX_WAIT_PRIVATE, expected, pTimeout, nullptr, 0 );
+
+    if( r == 0 )
+        return true;
+
+    // EAGAIN: The value had already changed. EINTR: Spurious wake up, the caller checks again.
+    PanicIf( errno != EAGAIN && errno != EINTR && errno != ETIMEDOUT, "futex wait failed with error %d.", errno );
+    return errno != ETIMEDOUT;
+
+#elif PLATFORM_IS_WINDOWS
+    uint32 cmp = expected;
+
+    if( ::WaitOnAddress( (volatile VOID*)&value, &cmp, sizeof( uint32 ), timeoutMS == WaitInfinite ? INFINITE : (DWORD)timeoutMS ) )
+        return true;
+
+    const DWORD err = ::GetLastError();
+    PanicIf( err != ERROR_TIMEOUT, "WaitOnAddress() failed with error %d.", (int32)err );
+    return false;
+
+#elif PLATFORM_IS_APPLE
+    // A zero timeout means forever
+    const uint32 timeoutUS = timeoutMS == WaitInfinite ? 0 : (uint32)std::max( (int64)timeoutMS * 1000, (int64)1 );
+
+    const int r = __ulock_wait( BB_UL_COMPARE_AND_WAIT | BB_ULF_NO_ERRNO, (void*)&value, expected, timeoutUS );
+
+    if( r >= 0 )
+        return true;
+
+    PanicIf( r != -EINTR && r != -EFAULT && r != -ETIMEDOUT, "__ulock_wait failed with error %d.", -r );
+    return r != -ETIMEDOUT;
+#else
+    #error Unsupported platform
+#endif
+}
+
+//-----------------------------------------------------------
+void AddressWait::WakeOne( std::atomic<uint32>& value )
+{
+#if PLATFORM_IS_LINUX
+    syscall( SYS_futex, (uint32*)&value, FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0 );
+#elif PLATFORM_IS_WINDOWS
+    ::WakeByAddressSingle( (PVOID)&value );
+#elif PLATFORM_IS_APPLE
+    __ulock_wake( BB_UL_COMPARE_AND_WAIT | BB_ULF_NO_ERRNO, (void*)&value, 0 );
+#endif
+}
+
+//-----------------------------------------------------------
+void AddressWait::WakeAll( std::atomic<uint32>& value )
+{
+#if PLATFORM_IS_LINUX
+    syscall( SYS_futex, (uint32*)&value, FUTEX_WAKE_PRIVATE, INT32_MAX, nullptr, nullptr, 0 );
+#elif PLATFORM_IS_WINDOWS
+    ::WakeByAddressAll( (PVOID)&value );
+#elif PLATFORM_IS_APPLE
+    __ulock_wake( BB_UL_COMPARE_AND_WAIT | BB_ULF_WAKE_ALL | BB_ULF_NO_ERRNO, (void*)&value, 0 );
+#endif
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include "Platform.h"
+#include <atomic>
+
+#if defined( _M_X64 ) || defined( __x86_64__ ) || defined( __i386__ )
+    #include <immintrin.h>
+#endif
+
+/// Process-private wait on the value of a 32-bit word:
+/// futex on Linux, WaitOnAddress on Windows and __ulock_wait on macOS.
+/// This is what AutoResetSignal, Fence and Semaphore park on after spinning,
+/// so that a hand-off between two threads which are both awake never enters the kernel.
+namespace AddressWait
+{
+    enum
+    {
+        WaitInfinite = -1
+    };
+
+    /// Blocks while value == expected, until woken or timeoutMS elapses.
+    /// It may return spuriously, so callers re-check their condition.
+    /// Returns false if it timed out.
+    bool Wait( std::atomic<uint32>& value, uint32 expected, int32 timeoutMS = WaitInfinite );
+
+    void WakeOne( std::atomic<uint32>& value );
+    void WakeAll( std::atomic<uint32>& value );
+
+    //-----------------------------------------------------------
+    inline void SpinPause()
+    {
+    #if defined( _M_X64 ) || defined( __x86_64__ ) || defined( __i386__ )
+        _mm_pause();
+    #elif defined( __aarch64__ ) || defined( _M_ARM64 )
+        #if PLATFORM_IS_WINDOWS
+            __yield();
+        #else
+            __asm__ __volatile__( "yield" );
+        #endif
+    #endif
+    }
+
+    /// Spins up to spinCount iterations while value == expected.
+    /// Returns true if the value changed.
+    //-----------------------------------------------------------
+    inline bool SpinWhile( const std::atomic<uint32>& value, const uint32 expected, const uint32 spinCount )
+    {
+        for( uint32 i = 0; i < spinCount; i++ )
+        {
+            if( value.load( std::memory_order_acquire ) != expected )
+                return true;
+
+            SpinPause();
+        }
+
+        return value.load( std::memory_order_acquire ) != expected;
+    }
+
+    /// Spin budget that grows when spinning pays off and shrinks when the waiter ends up parking anyway,
+    /// so that waits that are always long stop burning CPU.
+    class AdaptiveSpin
+    {
+    public:
+        static constexpr uint32 MinSpin = 16;
+        static constexpr uint32 MaxSpin = 4096;
+
+        inline uint32 Count() const { return _count.load( std::memory_order_relaxed ); }
+
+        inline void OnSpinSucceeded()
+        {
+            const uint32 c = Count();
+            if( c < MaxSpin )
+                _count.store( c * 2, std::memory_order_relaxed );
+        }
+
+        inline void OnSpinFailed()
+        {
+            const uint32 c = Count();
+            if( c > MinSpin )
+                _count.store( c / 2, std::memory_order_relaxed );
+        }
+
+    private:
+        std::atomic<uint32> _count = 256;
+    };
+}
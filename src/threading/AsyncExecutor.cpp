@@ -0,0 +1,57 @@
+#include "AsyncExecutor.h"
+
+//-----------------------------------------------------------
+void AsyncSignal::Reset( AsyncExecutor& executor )
+{
+    ASSERT( _state.load( std::memory_order_relaxed ) == nullptr || IsSignaled() );
+
+    _executor = &executor;
+    _state.store( nullptr, std::memory_order_release );
+}
+
+//-----------------------------------------------------------
+void AsyncSignal::Signal()
+{
+    // The awaiter may destroy us as soon as it resumes, so grab the executor first
+    AsyncExecutor* executor = _executor;
+    ASSERT( executor );
+
+    void* awaiter = _state.exchange( SignaledState(), std::memory_order_acq_rel );
+    ASSERT( awaiter != SignaledState() );
+
+    if( awaiter )
+        executor->Post( std::coroutine_handle<>::from_address( awaiter ) );
+}
+
+//-----------------------------------------------------------
+void AsyncExecutor::Post( std::coroutine_handle<> handle )
+{
+    {
+        std::lock_guard<std::mutex> lock( _lock );
+        _ready.push_back( handle );
+    }
+
+    _readySignal.Signal();
+}
+
+//-----------------------------------------------------------
+void AsyncExecutor::ResumeReady( Duration& waitTime )
+{
+    {
+        std::lock_guard<std::mutex> lock( _lock );
+        std::swap( _ready, _resuming );
+    }
+
+    if( _resuming.empty() )
+    {
+        const auto startTime = TimerBegin();
+        _readySignal.Wait();
+        waitTime += TimerEndTicks( startTime );
+        return;
+    }
+
+    for( std::coroutine_handle<> handle : _resuming )
+        handle.resume();
+
+    _resuming.clear();
+}
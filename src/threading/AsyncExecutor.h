@@ -0,0 +1,84 @@
+#pragma once
+#include "threading/Task.h"
+#include "threading/AutoResetSignal.h"
+#include "util/Util.h"
+#include <mutex>
+#include <vector>
+
+class AsyncExecutor;
+
+///
+/// One-shot event a single coroutine can co_await without blocking its executor's thread.
+/// It may be signalled from any thread, typically an I/O thread, see DiskBufferQueue::SignalAsync.
+///
+class AsyncSignal
+{
+public:
+    // Re-arms the signal, and binds it to the executor that will resume its awaiter.
+    // Must not be called while it is still pending or awaited.
+    void Reset( AsyncExecutor& executor );
+
+    void Signal();
+
+    //-----------------------------------------------------------
+    inline bool IsSignaled() const { return _state.load( std::memory_order_acquire ) == SignaledState(); }
+
+    //-----------------------------------------------------------
+    inline bool await_ready() const noexcept { return IsSignaled(); }
+
+    //-----------------------------------------------------------
+    inline bool await_suspend( std::coroutine_handle<> handle ) noexcept
+    {
+        void* expected = nullptr;
+
+        // If it was signalled in the meantime, don't suspend
+        return _state.compare_exchange_strong( expected, handle.address(), std::memory_order_acq_rel );
+    }
+
+    //-----------------------------------------------------------
+    inline void await_resume() const noexcept {}
+
+private:
+    inline static void* SignaledState() { return (void*)(uintptr_t)1; }
+
+private:
+    std::atomic<void*> _state    = nullptr;     // nullptr, the awaiting coroutine, or SignaledState()
+    AsyncExecutor*     _executor = nullptr;
+};
+
+///
+/// Resumes coroutines on the thread that calls Run().
+/// Coroutines that co_await an AsyncSignal are posted back to it when the signal is set,
+/// while the work they fan out still runs on the ThreadPool (ex. through AnonMTJob).
+///
+class AsyncExecutor
+{
+public:
+    // Queues a suspended coroutine to be resumed on the executor's thread. Thread-safe.
+    void Post( std::coroutine_handle<> handle );
+
+    // Runs the task and any coroutine posted to us until the task completes.
+    // The time spent with nothing ready to run is added to waitTime.
+    //-----------------------------------------------------------
+    template<typename T>
+    inline T Run( Task<T>& task, Duration& waitTime )
+    {
+        ASSERT( !task.Done() );
+
+        task.Handle().resume();
+
+        while( !task.Done() )
+            ResumeReady( waitTime );
+
+        return task.Result();
+    }
+
+private:
+    void ResumeReady( Duration& waitTime );
+
+private:
+    std::mutex                           _lock;
+    std::vector<std::coroutine_handle<>> _ready;
+    std::vector<std::coroutine_handle<>> _resuming;
+    AutoResetSignal                      _readySignal;
+};
@@ -1,161 +1,84 @@
 #include "AutoResetSignal.h"
 #include "util/Util.h"
-#include "util/Log.h"
-
-#if PLATFORM_IS_WINDOWS
-    #include <Windows.h>
-#endif
 
 //-----------------------------------------------------------
 AutoResetSignal::AutoResetSignal()
 {
-#if PLATFORM_IS_WINDOWS
-    _object = CreateEvent( NULL, FALSE, FALSE, NULL );
-    PanicIf( !_object, "AutoResetSignal::AutoResetSignal() CreateEvent() failed with error: %d.", (int32)::GetLastError() );
-#else
-    ZeroMem( &_object );
-
-    int r;
-    r = pthread_mutex_init( &_object.mutex, 0 );
-    PanicIf( r, "AutoResetSignal::AutoResetSignal() pthread_mutex_init failed with error %d.", r );
-
-    r = pthread_cond_init(  &_object.cond , 0 );
-    PanicIf( r, "AutoResetSignal::AutoResetSignal() pthread_cond_init failed with error %d.", r );
-#endif
 }
 
-
 //-----------------------------------------------------------
 AutoResetSignal::~AutoResetSignal()
 {
-#if PLATFORM_IS_WINDOWS
-    const BOOL r = ::CloseHandle( _object );
-    PanicIf( !r, "AutoResetSignal::~AutoResetSignal() CloseHandle() failed with error: %d.", (int32)::GetLastError() );
-#else
-    // #TODO: Log error
-    int r;
-    r = pthread_mutex_destroy( &_object.mutex );
-    if( r )
-        Log::Error( "AutoResetSignal::~AutoResetSignal() pthread_mutex_destroy() failed." );
-
-    r = pthread_cond_destroy ( &_object.cond  );
-    if( r )
-        Log::Error( "AutoResetSignal::~AutoResetSignal() pthread_cond_destroy() failed." );
-#endif
 }
+
 //-----------------------------------------------------------
 void AutoResetSignal::Reset()
 {
-#if PLATFORM_IS_WINDOWS
-    const BOOL r = ::ResetEvent( _object );
-    PanicIf( !r, "AutoResetSignal::Reset ResetEvent() failed with error: %d.", (int32)GetLastError() );
-#else
-    int r;
-
-    r = pthread_mutex_lock( &_object.mutex );
-    PanicIf( r, "AutoResetSignal::Signal pthread_mutex_lock() failed with error %d.", r );
-
-    _object.signaled = false;
-
-    r = pthread_mutex_unlock( &_object.mutex );
-    PanicIf( r, "AutoResetSignal::Signal pthread_mutex_unlock() failed with error %d.", r );
-#endif
+    // Only clear a pending signal, waiters that are parked must stay marked
+    uint32 expected = Signaled;
+    _state.compare_exchange_strong( expected, Unsignaled, std::memory_order_acq_rel );
 }
 
 //-----------------------------------------------------------
 void AutoResetSignal::Signal()
 {
-#if PLATFORM_IS_WINDOWS
-    const BOOL r = SetEvent( _object );
-    PanicIf( !r, "AutoResetSignal::Signal() SetEvent() failed with error: %d.", (int32)::GetLastError() );
-#else
-    int r;
-
-    r = pthread_mutex_lock( &_object.mutex );
-    PanicIf( r, "AutoResetSignal::Signal pthread_mutex_lock() failed with error %d.", r );
-
-    _object.signaled = true;
-
-    r = pthread_cond_signal( &_object.cond  );
-    PanicIf( r, "AutoResetSignal::Signal pthread_cond_signal() failed with error %d.", r );
-
-    r = pthread_mutex_unlock( &_object.mutex );
-    PanicIf( r, "AutoResetSignal::Signal pthread_mutex_unlock() failed with error %d.", r );
-#endif
+    if( _state.exchange( Signaled, std::memory_order_acq_rel ) == Contended )
+        AddressWait::WakeOne( _state );
 }
 
 //-----------------------------------------------------------
 AutoResetSignal::WaitResult AutoResetSignal::Wait( int32 timeoutMS )
 {
-#if PLATFORM_IS_WINDOWS
-    if( timeoutMS == WaitInfinite )
-        timeoutMS = INFINITE;
-    
-    const DWORD r = WaitForSingleObject( _object, (DWORD)timeoutMS );
-
-    switch( r )
+    // Spin first, the producer is often just about to signal
     {
-        case WAIT_OBJECT_0:
+        uint32 expected = Signaled;
+        if( _state.compare_exchange_strong( expected, Unsignaled, std::memory_order_acquire ) )
             return WaitResultOK;
 
-        case WAIT_TIMEOUT:
-            return WaitResultTimeOut;
-
-        default:
-            // We never really handle this case, so just panic out
-            Panic( "AutoResetSignal::Wait WaitForSingleObject() failed with error: %d.", (int32)::GetLastError() );
-            return WaitResultError;
+        if( expected == Unsignaled && AddressWait::SpinWhile( _state, Unsignaled, _spin.Count() ) )
+        {
+            expected = Signaled;
+            if( _state.compare_exchange_strong( expected, Unsignaled, std::memory_order_acquire ) )
+            {
+                _spin.OnSpinSucceeded();
+                return WaitResultOK;
+            }
+        }
+
+        _spin.OnSpinFailed();
     }
-    
-#else
-
-    int r;
-    int rc = 0;
-
-    if( timeoutMS == WaitInfinite )
-    {
-        r = pthread_mutex_lock( &_object.mutex );
-        PanicIf( r, "AutoResetSignal::Wait pthread_mutex_lock() failed with error %d.", r );
 
-        while( !_object.signaled )
-            rc = pthread_cond_wait( &_object.cond, &_object.mutex );
+    const auto startTime = TimerBegin();
+    bool       parked    = false;
 
-        _object.signaled = false;
-
-        r = pthread_mutex_unlock( &_object.mutex );
-        PanicIf( r, "AutoResetSignal::Wait pthread_mutex_unlock() failed with error %d.", r );
-    }
-    else
+    for( ;; )
     {
-        struct timespec t;
-
-        r = pthread_mutex_lock( &_object.mutex );
-        PanicIf( r, "AutoResetSignal::Wait pthread_mutex_lock() failed with error %d.", r );
+        uint32 state = _state.load( std::memory_order_acquire );
 
-        clock_gettime( CLOCK_REALTIME, &t );
-        timeoutMS += ( t.tv_sec * 1000 ) + ( t.tv_nsec / 1000000 );
+        if( state == Signaled )
+        {
+            // Once we have parked, other waiters may be parked as well,
+            // so leave the state contended for the next Signal() to wake them.
+            if( _state.compare_exchange_weak( state, parked ? Contended : Unsignaled, std::memory_order_acquire ) )
+                return WaitResultOK;
 
-        t.tv_sec  = (time_t)( timeoutMS / 1000 );
-        t.tv_nsec = (long)( timeoutMS - (t.tv_sec * 1000) ) * 1000000;
+            continue;
+        }
 
-        while( !_object.signaled && rc == 0 )
-            rc = pthread_cond_timedwait( &_object.cond, &_object.mutex, &t );
+        if( state == Unsignaled && !_state.compare_exchange_weak( state, Contended, std::memory_order_acquire ) )
+            continue;
 
-        _object.signaled = false;
+        int32 remainingMS = WaitInfinite;
 
-        r = pthread_mutex_unlock( &_object.mutex );
-        PanicIf( r, "AutoResetSignal::Wait pthread_mutex_unlock() failed with error %d.", r );
-    }
+        if( timeoutMS != WaitInfinite )
+        {
+            remainingMS = timeoutMS - (int32)( TimerEnd( startTime ) * 1000.0 );
+            if( remainingMS <= 0 )
+                return WaitResultTimeOut;
+        }
 
-    switch( rc )
-    {
-        case 0:
-            return WaitResultOK;
-        case ETIMEDOUT:
+        parked = true;
+        if( !AddressWait::Wait( _state, Contended, remainingMS ) && _state.load( std::memory_order_acquire ) != Signaled )
             return WaitResultTimeOut;
-        default:
-            Panic( "AutoResetSignal::Wait Unexpected return code for pthread_cond_timedwait(): %d.", rc );
-            return WaitResultError;
     }
-#endif
 }
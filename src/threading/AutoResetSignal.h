@@ -1,6 +1,9 @@
 #pragma once
 #include "Platform.h"
+#include "threading/AddressWait.h"
 
+/// Wakes a single waiter per Signal(). A Signal() with no waiters is kept until the next Wait().
+/// Waiters spin for a while before parking on the state word, see AddressWait.
 class AutoResetSignal
 {
 public:
@@ -25,18 +28,13 @@ public:
     WaitResult Wait( int32 timeoutMS = WaitInfinite );
 
 private:
-
-#if PLATFORM_IS_WINDOWS
-    HANDLE _object = NULL;
-#elif PLATFORM_IS_UNIX
-    struct AutoResetObject
+    enum State : uint32
     {
-        pthread_mutex_t mutex;
-        pthread_cond_t  cond;
-        bool            signaled;
+        Unsignaled = 0,
+        Signaled   = 1,
+        Contended  = 2,     // Unsignaled, and there may be waiters parked on _state
     };
-    AutoResetObject _object;
-#else
-    #error Unsupported platform
-#endif
-};
\ No newline at end of file
+
+    std::atomic<uint32>       _state = Unsignaled;
+    AddressWait::AdaptiveSpin _spin;
+};
@@ -17,6 +17,7 @@ void Fence::Signal()
 {
     _value ++;
     _signal.Signal();
+    WakeValueWaiters();
 }
 
 //-----------------------------------------------------------
@@ -25,6 +26,7 @@ void Fence::Signal( uint32 value )
     // _value.store( value, std::memory_order_release );
     _value = value;
     _signal.Signal();
+    WakeValueWaiters();
 }
 
 //-----------------------------------------------------------
@@ -52,20 +54,42 @@ void Fence::Wait( Duration& accumulator )
 //-----------------------------------------------------------
 void Fence::Wait( uint32 value )
 {
-    // while( _value.load( std::memory_order_relaxed ) < value )
-    while( _value < value )
-        _signal.Wait();
+    // Waiting on the value itself, rather than on _signal, lets any number of threads wait on the fence
+    // and wakes them only once it reaches the value they need.
+    for( uint32 current = _value; current < value; current = _value )
+    {
+        if( AddressWait::SpinWhile( _value, current, _spin.Count() ) )
+        {
+            _spin.OnSpinSucceeded();
+            continue;
+        }
+
+        _spin.OnSpinFailed();
+
+        // Signal() stores the value before checking for waiters, and the wait
+        // only parks if the value is still unchanged, so no wake up is missed.
+        _valueWaiters++;
+        AddressWait::Wait( _value, current );
+        _valueWaiters--;
+    }
 }
 
 //-----------------------------------------------------------
 void Fence::Wait( uint32 value, Duration& accumulator )
 {
-    while( _value < value )
-    {
-        const auto startTime = TimerBegin();
-        _signal.Wait();
-        accumulator += TimerEndTicks( startTime );
-    }
+    if( _value >= value )
+        return;
+
+    const auto startTime = TimerBegin();
+    Wait( value );
+    accumulator += TimerEndTicks( startTime );
+}
+
+//-----------------------------------------------------------
+void Fence::WakeValueWaiters()
+{
+    if( _valueWaiters > 0 )
+        AddressWait::WakeAll( _value );
 }
 
 //-----------------------------------------------------------
@@ -36,10 +36,13 @@ public:
     void SpinWait( uint32 value );
 
 private:
-     std::atomic<uint32> _value;
-    // #NOTE: Don't think we need atomic, since memory ordering ought to be enforced by the mutex.
-    //volatile uint32     _value = 0;
-    AutoResetSignal     _signal;
+    void WakeValueWaiters();
+
+private:
+    std::atomic<uint32>       _value;
+    std::atomic<uint32>       _valueWaiters = 0;    // Threads parked on _value by Wait( value )
+    AutoResetSignal           _signal;              // For Wait() on any value
+    AddressWait::AdaptiveSpin _spin;
 
 };
 
@@ -2,13 +2,18 @@
 
 #include "Config.h"
 #include "threading/ThreadPool.h"
+#include "threading/TreeBarrier.h"
+#include "threading/WorkStealingRanges.h"
 #include "util/Util.h"
+#include "util/Trace.h"
+#include "util/PerfCounters.h"
 #include <cstring>
 #if _DEBUG
     #include "util/Log.h"
 #endif
 
 #include <functional>
+#include <typeinfo>
 
 template<typename TJob, uint MaxJobs>
 struct MTJobRunner;
@@ -18,6 +23,7 @@ struct MTJobSyncT
 {
     std::atomic<uint>* _finishedCount;
     std::atomic<uint>* _releaseLock;
+    TreeBarrier*       _barrier;        // Used instead of the counters above at high thread counts
     uint               _jobId;
     uint               _jobCount;
     TJob*              _jobs;
@@ -172,6 +178,30 @@ struct AnonMTJob : public MTJob<AnonMTJob>
     {
         Run( pool, pool.ThreadCount(), func );
     }
+
+    // Run a loop over [0, totalCount) in chunks, with work stealing between the threads.
+    // Use it in place of GetThreadOffsets() when items are independent of each other.
+    // func is called as func( self, offset, count ) for each chunk a thread acquires.
+    template<typename F,
+        std::enable_if_t<
+        std::is_invocable_r_v<void, F, AnonMTJob*, uint64, uint64>>* = nullptr>
+    inline static void RunRanges( ThreadPool& pool, const uint32 threadCount, const uint64 totalCount, const uint64 grainSize, F&& func )
+    {
+        WorkStealingRanges ranges( threadCount, totalCount, grainSize );
+
+        Run( pool, threadCount, [&]( AnonMTJob* self ) {
+
+            uint64 offset, count;
+            while( ranges.Next( self->JobId(), offset, count ) )
+                func( self, offset, count );
+        });
+    }
+
+    template<typename F>
+    inline static void RunRanges( ThreadPool& pool, const uint32 threadCount, const uint64 totalCount, F&& func )
+    {
+        RunRanges( pool, threadCount, totalCount, WorkStealingRanges::DefaultGrainSize( threadCount, totalCount ), func );
+    }
 };
 
 
@@ -195,6 +225,9 @@ inline double MTJobRunner<TJob, MaxJobs>::Run( uint32 threadCount )
 
     std::atomic<uint> finishedCount = 0;
     std::atomic<uint> releaseLock   = 0;
+
+    TreeBarrier barrier;
+    barrier.Init( _pool, threadCount );
     
     for( uint i = 0; i < threadCount; i++ )
     {
@@ -202,16 +235,26 @@ inline double MTJobRunner<TJob, MaxJobs>::Run( uint32 threadCount )
 
         job._finishedCount = &finishedCount;
         job._releaseLock   = &releaseLock;
+        job._barrier       = &barrier;
         job._jobId         = i;
         job._jobCount      = threadCount;
         job._jobs          = _jobs;
     }
 
+    // Counted per job type with --perf-counters
+    const bool        countPerf = PerfCounters::IsEnabled();
+    PerfCounterValues perfStart;
+    if( countPerf )
+        perfStart = PerfCounters::Read();
+
     // Run the job
     const auto timer = TimerBegin();
     _pool.RunJob( RunJobWrapper, _jobs, threadCount );
     const double elapsed = TimerEnd( timer );
 
+    if( countPerf )
+        PerfCounters::RecordJobRun( typeid( TJob ).name(), PerfCounters::Read() - perfStart );
+
     return elapsed;
 }
 
@@ -219,6 +262,7 @@ template<typename TJob, uint MaxJobs>
 inline void MTJobRunner<TJob, MaxJobs>::RunJobWrapper( TJob* job )
 {
     //job->Run();
+    BB_TRACE_SCOPE( "MTJob::Run" );
     static_cast<MTJob<TJob>*>( job )->Run();
 }
 
@@ -270,6 +314,14 @@ inline bool MTJobSyncT<TJob>::LockThreads()
     {
         ASSERT( _jobId == 0 );
 
+        BB_TRACE_SCOPE( "MTJob::LockThreads" );
+
+        if( this->_barrier && this->_barrier->IsActive( this->_jobCount ) )
+        {
+            this->_barrier->WaitForArrivals();
+            return true;
+        }
+
         auto& finishedCount        = *this->_finishedCount;
         const uint threadThreshold = this->_jobCount - 1;
 
@@ -288,6 +340,12 @@ inline void MTJobSyncT<TJob>::ReleaseThreads()
 {
     ASSERT( _jobId == 0 );
 
+    if( this->_barrier && this->_barrier->IsActive( this->_jobCount ) )
+    {
+        this->_barrier->Release();
+        return;
+    }
+
     auto& finishedCount        = *this->_finishedCount;
     auto& releaseLock          = *this->_releaseLock;
     
@@ -302,6 +360,13 @@ template<typename TJob>
 inline void MTJobSyncT<TJob>::WaitForRelease()
 {
     ASSERT( _jobId != 0 );
+    BB_TRACE_SCOPE( "MTJob::WaitForRelease" );
+
+    if( this->_barrier && this->_barrier->IsActive( this->_jobCount ) )
+    {
+        this->_barrier->ArriveAndWait( this->_jobId );
+        return;
+    }
 
     auto& finishedCount        = *this->_finishedCount;
     auto& releaseLock          = *this->_releaseLock;
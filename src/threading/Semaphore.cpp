@@ -1,169 +1,91 @@
 #include "Semaphore.h"
 #include "util/Util.h"
 
-#if PLATFORM_IS_WINDOWS
-    #include <Windows.h>
-#endif
-
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
-
 //-----------------------------------------------------------
 Semaphore::Semaphore( int initialCount )
-    #if PLATFORM_IS_WINDOWS || PLATFORM_IS_APPLE
-    : _count( initialCount )
-    #endif
+    : _count( (uint32)initialCount )
 {
     ASSERT( initialCount >= 0 );
-
-    #if PLATFORM_IS_LINUX
-        int r = sem_init( &_id, 0, initialCount );
-        if( r != 0 )
-            Panic( "sem_init() failed with error: %d.", errno );
-    #elif PLATFORM_IS_WINDOWS
-        _id = CreateSemaphore( NULL,(LONG)initialCount, std::numeric_limits<LONG>::max(), NULL );
-        if( _id == NULL )
-        {
-            Panic( "CreateSemaphore() failed with error: %d.", (int32)::GetLastError() );
-        }
-    #elif PLATFORM_IS_APPLE
-        _id = dispatch_semaphore_create( (intptr_t)initialCount );
-        PanicIf( !_id, "dispatch_semaphore_create failed." );
-    #else
-        #error Unimplemented
-    #endif
 }
 
 //-----------------------------------------------------------
 Semaphore::~Semaphore()
 {
-    #if PLATFORM_IS_LINUX
-        int r = sem_destroy( &_id );
-        if( r != 0 )
-            Panic( "sem_destroy() failed with error: %d.", errno );
-    #elif PLATFORM_IS_WINDOWS
-        if( !CloseHandle( _id ) )
-            Panic( "CloseHandle( semaphore ) failed with error: %d.", (int32)::GetLastError() );
-    #elif PLATFORM_IS_APPLE
-        dispatch_release( _id );
-    #else
-        #error Unimplemented
-    #endif
+    ASSERT( _waiters == 0 );
+}
+
+//-----------------------------------------------------------
+bool Semaphore::TryAcquire()
+{
+    uint32 count = _count.load( std::memory_order_relaxed );
+
+    while( count > 0 )
+    {
+        if( _count.compare_exchange_weak( count, count - 1, std::memory_order_acquire, std::memory_order_relaxed ) )
+            return true;
+    }
+
+    return false;
 }
 
 //-----------------------------------------------------------
 void Semaphore::Wait()
 {
-    #if PLATFORM_IS_LINUX
-        const int r = sem_wait( &_id );
-        if( r != 0 )
-            Panic( "sem_wait() failed." );
-    #elif PLATFORM_IS_WINDOWS
-        const DWORD r = WaitForSingleObject( _id, INFINITE );
-        if( r != WAIT_OBJECT_0 )
-            Panic( "Semaphore::Wait - WaitForSingleObject() failed with error: %d.", (int32)::GetLastError() );
-    #elif PLATFORM_IS_APPLE
-        intptr_t r = dispatch_semaphore_wait( _id, DISPATCH_TIME_FOREVER );
-        PanicIf( r != 0, "dispatch_semaphore_wait() failed." );
-    #else
-        #error Unimplemented
-    #endif
+    Wait( 0 );
 }
 
 //-----------------------------------------------------------
 bool Semaphore::Wait( long milliseconds )
 {
-    ASSERT( milliseconds > 0 );
+    ASSERT( milliseconds >= 0 );
+
+    if( TryAcquire() )
+        return true;
 
-    if( milliseconds < 1 )
+    // Spin first, the releasing thread is often just about to post
+    if( AddressWait::SpinWhile( _count, 0, _spin.Count() ) && TryAcquire() )
     {
-        Wait();
+        _spin.OnSpinSucceeded();
         return true;
     }
 
-    #if PLATFORM_IS_LINUX
+    _spin.OnSpinFailed();
+
+    const auto startTime = TimerBegin();
 
-        long seconds = milliseconds / 1000;
-        milliseconds -= seconds * 1000;
+    for( ;; )
+    {
+        if( TryAcquire() )
+            return true;
 
-        struct timespec abstime;
+        int32 remainingMS = AddressWait::WaitInfinite;
 
-        if( clock_gettime( CLOCK_REALTIME, &abstime ) == -1 )
+        if( milliseconds > 0 )
         {
-            ASSERT( 0 );
-            return false;
+            remainingMS = (int32)( milliseconds - (long)( TimerEnd( startTime ) * 1000.0 ) );
+            if( remainingMS <= 0 )
+                return false;
         }
 
-        int r = sem_timedwait( &_id, &abstime );
-
-        if( r != 0 && r != ETIMEDOUT )
-            Panic( "sem_wait() failed." );
-
-        return r == 0;
-
-    #elif PLATFORM_IS_WINDOWS
-        const DWORD r = WaitForSingleObject( _id, (DWORD)milliseconds );
-
-        if( r != WAIT_OBJECT_0 && r != WAIT_TIMEOUT )
-            Panic( "Semaphore::Wait - WaitForSingleObject() failed with error: %d", (int32)GetLastError() );
-
-        return r == WAIT_OBJECT_0;
-    #elif PLATFORM_IS_APPLE
-        const int64_t         nanoseconds = (int64_t)milliseconds * 1000000ll;
-        const dispatch_time_t timeout     = dispatch_time( DISPATCH_TIME_NOW, nanoseconds );
-
-        const intptr_t r = dispatch_semaphore_wait( _id, timeout );
-
-        return r == 0;  // Non-zero = timed-out
-    #else
-        #error Unimplemented
-    #endif
+        // Release() increments the count before checking for waiters, and the wait
+        // only parks if the count is still 0, so no wake up is missed.
+        _waiters++;
+        AddressWait::Wait( _count, 0, remainingMS );
+        _waiters--;
+    }
 }
 
 //-----------------------------------------------------------
 int Semaphore::GetCount()
 {
-    #if PLATFORM_IS_LINUX
-        
-        int value = 0;
-        int r = sem_getvalue( &_id, &value );
-        
-        if( r != 0 )
-            Panic( "sem_getvalue() failed." );
-
-        return value;
-    #elif PLATFORM_IS_WINDOWS || PLATFORM_IS_APPLE
-        return _count.load( std::memory_order_release );
-    #else
-        #error Unimplemented
-    #endif
+    return (int)_count.load( std::memory_order_acquire );
 }
 
 //-----------------------------------------------------------
 void Semaphore::Release()
 {
-    #if PLATFORM_IS_LINUX
-        int r = sem_post( &_id );
-        if( r != 0 )
-            Panic( "sem_post() failed." );
-    #elif PLATFORM_IS_WINDOWS
-        LONG prevCount;
-        BOOL r = ::ReleaseSemaphore( _id, 1, &prevCount );
-        
-        if( !r )
-            Panic( "ReleaseSemaphore() failed with error: %d.", (int32)::GetLastError() );
-
-        _count++;
-    #elif PLATFORM_IS_APPLE
-        // #TODO: Return value? Apple doesn't say what it does:
-        //  #See: https://developer.apple.com/documentation/dispatch/1452919-dispatch_semaphore_signal
-        dispatch_semaphore_signal( _id );
-
-        _count++;
-    #else
-        #error Unimplemented
-    #endif
-}
-
-#pragma GCC diagnostic pop
+    _count++;
 
+    if( _waiters > 0 )
+        AddressWait::WakeOne( _count );
+}
@@ -1,9 +1,11 @@
 #pragma once
 #include "Platform.h"
+#include "threading/AddressWait.h"
 #include <atomic>
 
 /// These are lightweight single-process semaphores.
 /// (As opposed to system-wide "named" semaphores)
+/// Waiters spin for a while before parking on the count, see AddressWait.
 class Semaphore
 {
 public:
@@ -18,9 +20,10 @@ public:
     int GetCount();
 
 private:
-    SemaphoreId _id;
+    bool TryAcquire();
 
-#if PLATFORM_IS_WINDOWS || PLATFORM_IS_APPLE
-    std::atomic<int> _count;
-#endif
-};
\ No newline at end of file
+private:
+    std::atomic<uint32>       _count;
+    std::atomic<uint32>       _waiters = 0;     // Threads parked on _count
+    AddressWait::AdaptiveSpin _spin;
+};
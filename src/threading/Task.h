@@ -0,0 +1,148 @@
+#pragma once
+#include <coroutine>
+#include <exception>
+#include <utility>
+
+///
+/// Lazily-started coroutine returning T.
+/// It starts running when it is co_awaited, or when it is given to AsyncExecutor::Run,
+/// and it resumes its awaiter directly once it completes.
+///
+template<typename T = void>
+class Task;
+
+namespace TaskDetail
+{
+    //-----------------------------------------------------------
+    struct FinalAwaiter
+    {
+        inline bool await_ready() const noexcept { return false; }
+        inline void await_resume() const noexcept {}
+
+        template<typename TPromise>
+        inline std::coroutine_handle<> await_suspend( std::coroutine_handle<TPromise> handle ) noexcept
+        {
+            // Symmetric transfer, so that chains of tasks don't grow the stack
+            return handle.promise().continuation;
+        }
+    };
+
+    //-----------------------------------------------------------
+    struct PromiseBase
+    {
+        std::coroutine_handle<> continuation = std::noop_coroutine();
+
+        inline std::suspend_always initial_suspend() const noexcept { return {}; }
+        inline FinalAwaiter        final_suspend()   const noexcept { return {}; }
+
+        // We don't use exceptions: Fatal() and Panic() exit the process
+        inline void unhandled_exception() const noexcept { std::terminate(); }
+    };
+
+    //-----------------------------------------------------------
+    template<typename T>
+    struct Promise : PromiseBase
+    {
+        T value = {};
+
+        inline Task<T> get_return_object() noexcept;
+
+        inline void return_value( T v ) { value = std::move( v ); }
+
+        inline T Result() { return std::move( value ); }
+    };
+
+    //-----------------------------------------------------------
+    template<>
+    struct Promise<void> : PromiseBase
+    {
+        inline Task<void> get_return_object() noexcept;
+
+        inline void return_void() const noexcept {}
+
+        inline void Result() const noexcept {}
+    };
+}
+
+template<typename T>
+class Task
+{
+public:
+    using promise_type = TaskDetail::Promise<T>;
+
+    //-----------------------------------------------------------
+    inline Task() {}
+
+    //-----------------------------------------------------------
+    inline explicit Task( std::coroutine_handle<promise_type> handle ) : _handle( handle ) {}
+
+    //-----------------------------------------------------------
+    inline Task( Task&& other ) noexcept : _handle( std::exchange( other._handle, nullptr ) ) {}
+
+    //-----------------------------------------------------------
+    inline Task& operator=( Task&& other ) noexcept
+    {
+        if( this != &other )
+        {
+            if( _handle )
+                _handle.destroy();
+
+            _handle = std::exchange( other._handle, nullptr );
+        }
+
+        return *this;
+    }
+
+    Task( const Task& ) = delete;
+    Task& operator=( const Task& ) = delete;
+
+    //-----------------------------------------------------------
+    inline ~Task()
+    {
+        if( _handle )
+            _handle.destroy();
+    }
+
+    //-----------------------------------------------------------
+    inline bool Done() const { return !_handle || _handle.done(); }
+
+    //-----------------------------------------------------------
+    inline std::coroutine_handle<promise_type> Handle() const { return _handle; }
+
+    //-----------------------------------------------------------
+    inline T Result()
+    {
+        ASSERT( _handle && _handle.done() );
+        return _handle.promise().Result();
+    }
+
+    // co_await'ing a task starts it and suspends the awaiter until it completes
+    //-----------------------------------------------------------
+    inline bool await_ready() const noexcept { return Done(); }
+
+    //-----------------------------------------------------------
+    inline std::coroutine_handle<> await_suspend( std::coroutine_handle<> awaiter ) noexcept
+    {
+        _handle.promise().continuation = awaiter;
+        return _handle;
+    }
+
+    //-----------------------------------------------------------
+    inline T await_resume() { return Result(); }
+
+private:
+    std::coroutine_handle<promise_type> _handle = nullptr;
+};
+
+//-----------------------------------------------------------
+template<typename T>
+inline Task<T> TaskDetail::Promise<T>::get_return_object() noexcept
+{
+    return Task<T>( std::coroutine_handle<Promise<T>>::from_promise( *this ) );
+}
+
+//-----------------------------------------------------------
+inline Task<void> TaskDetail::Promise<void>::get_return_object() noexcept
+{
+    return Task<void>( std::coroutine_handle<Promise<void>>::from_promise( *this ) );
+}
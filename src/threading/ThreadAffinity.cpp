@@ -0,0 +1,113 @@
+#include "ThreadAffinity.h"
+#include "SysHost.h"
+#include <algorithm>
+#include <atomic>
+
+struct AffinityState
+{
+    std::vector<uint32> computeOrder;   // CPU ids, in the order compute threads are assigned to them
+    std::vector<uint32> ioCpus;
+    std::atomic<uint32> nextIOCpu = 0;
+};
+
+//-----------------------------------------------------------
+static AffinityState& GetState()
+{
+    static AffinityState* state = []() {
+
+        const CpuTopology& topology = SysHost::GetCpuTopology();
+
+        std::vector<CpuInfo> cpus( topology.cpus.Ptr(), topology.cpus.Ptr() + topology.cpus.Length() );
+
+        // One thread per core, L3 domain by L3 domain, then the next SMT sibling of each core
+        std::sort( cpus.begin(), cpus.end(), []( const CpuInfo& a, const CpuInfo& b ) {
+            if( a.smt  != b.smt  ) return a.smt  < b.smt;
+            if( a.l3   != b.l3   ) return a.l3   < b.l3;
+            if( a.core != b.core ) return a.core < b.core;
+            return a.id < b.id;
+        });
+
+        auto* s = new AffinityState();
+        for( const CpuInfo& cpu : cpus )
+            s->computeOrder.push_back( cpu.id );
+
+        return s;
+    }();
+
+    return *state;
+}
+
+//-----------------------------------------------------------
+uint32 ThreadAffinity::ReserveIOCores( uint32 coreCount )
+{
+    AffinityState&     state    = GetState();
+    const CpuTopology& topology = SysHost::GetCpuTopology();
+
+    ASSERT( state.ioCpus.empty() );
+
+    coreCount = std::min( coreCount, topology.coreCount - 1 );
+    if( coreCount == 0 )
+        return 0;
+
+    // Take the last cores of the last L3 domains, the ones compute pools would reach last anyway
+    std::vector<CpuInfo> firstThreads;
+    for( size_t i = 0; i < topology.cpus.Length(); i++ )
+    {
+        if( topology.cpus[i].smt == 0 )
+            firstThreads.push_back( topology.cpus[i] );
+    }
+
+    std::sort( firstThreads.begin(), firstThreads.end(), []( const CpuInfo& a, const CpuInfo& b ) {
+        if( a.l3 != b.l3 ) return a.l3 > b.l3;
+        return a.core > b.core;
+    });
+
+    std::vector<uint32> ioCores;
+    for( uint32 i = 0; i < coreCount && i < (uint32)firstThreads.size(); i++ )
+        ioCores.push_back( firstThreads[i].core );
+
+    auto isIOCpu = [&]( const uint32 cpuId ) {
+        for( size_t i = 0; i < topology.cpus.Length(); i++ )
+        {
+            if( topology.cpus[i].id == cpuId )
+                return std::find( ioCores.begin(), ioCores.end(), topology.cpus[i].core ) != ioCores.end();
+        }
+        return false;
+    };
+
+    // Move the reserved CPUs to the end of the compute order, keeping both parts in order
+    auto ioStart = std::stable_partition( state.computeOrder.begin(), state.computeOrder.end(),
+                                          [&]( const uint32 cpuId ) { return !isIOCpu( cpuId ); } );
+
+    state.ioCpus.assign( ioStart, state.computeOrder.end() );
+    return (uint32)state.ioCpus.size();
+}
+
+//-----------------------------------------------------------
+uint32 ThreadAffinity::IOCpuCount()
+{
+    return (uint32)GetState().ioCpus.size();
+}
+
+//-----------------------------------------------------------
+uint32 ThreadAffinity::ComputeCpuId( const uint32 index )
+{
+    const AffinityState& state = GetState();
+
+    if( state.computeOrder.empty() )
+        return index % SysHost::GetLogicalCPUCount();
+
+    return state.computeOrder[index % state.computeOrder.size()];
+}
+
+//-----------------------------------------------------------
+void ThreadAffinity::PinCurrentIOThread()
+{
+    AffinityState& state = GetState();
+
+    if( state.ioCpus.empty() )
+        return;
+
+    const uint32 i = state.nextIOCpu.fetch_add( 1, std::memory_order_relaxed );
+    SysHost::SetCurrentThreadAffinityCpuId( state.ioCpus[i % state.ioCpus.size()] );
+}
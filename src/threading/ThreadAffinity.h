@@ -0,0 +1,30 @@
+#pragma once
+
+/// Decides which CPU each class of thread is pinned to, based on SysHost::GetCpuTopology().
+///
+/// Compute threads take one hardware thread per core, filling an L3 domain (a CCX on Zen parts)
+/// before moving to the next one, and only then the SMT siblings. That way a pool that is smaller
+/// than the machine shares as few L3 caches as possible, and never doubles up on a core while
+/// there are idle ones.
+///
+/// Whole cores can also be reserved for the I/O, plot writer and GPU feeder threads (--io-cores).
+/// Reserved cores are moved to the end of the compute order, so compute pools that are no larger
+/// than the remaining CPUs never run on them.
+class ThreadAffinity
+{
+public:
+    /// Reserve coreCount cores, taken from the last L3 domain, for I/O threads.
+    /// Must be called before any thread pool is created. At least one core is always left for compute.
+    /// Returns the number of logical CPUs reserved.
+    static uint32 ReserveIOCores( uint32 coreCount );
+
+    /// Logical CPUs reserved for I/O threads
+    static uint32 IOCpuCount();
+
+    /// The CPU that the compute thread at index should be pinned to. Wraps around.
+    static uint32 ComputeCpuId( uint32 index );
+
+    /// Pins the calling I/O thread to one of the reserved I/O CPUs, round-robin.
+    /// Does nothing if no cores were reserved.
+    static void PinCurrentIOThread();
+};
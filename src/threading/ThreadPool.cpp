@@ -2,6 +2,11 @@
 #include "util/Util.h"
 #include "util/Log.h"
 #include "SysHost.h"
+#include "ThreadAffinity.h"
+#include "util/Trace.h"
+#include "util/PerfCounters.h"
+#include "plotting/HarvestYield.h"
+#include "AddressWait.h"
 
 
 //-----------------------------------------------------------
@@ -12,20 +17,38 @@ ThreadPool::ThreadPool( uint threadCount, Mode mode, bool disableAffinity, uint3
     , _jobSignal      ( 0 )
     , _poolSignal     ( 0 )
 {
+    StartThreads( nullptr, cpuOffset );
+}
+
+//-----------------------------------------------------------
+ThreadPool::ThreadPool( uint threadCount, const uint* cpuIds, Mode mode )
+    : _threadCount    ( threadCount )
+    , _mode           ( mode )
+    , _disableAffinity( false )
+    , _jobSignal      ( 0 )
+    , _poolSignal     ( 0 )
+{
+    ASSERT( cpuIds );
+    StartThreads( cpuIds, 0 );
+}
+
+//-----------------------------------------------------------
+void ThreadPool::StartThreads( const uint* cpuIds, const uint32 cpuOffset )
+{
+    const uint threadCount = _threadCount;
+
     if( threadCount < 1 )
         Fatal( "threadCount must be greater than 0." );
     
     _threads    = new Thread    [threadCount];
     _threadData = new ThreadData[threadCount];
 
-    auto threadRunner = mode == Mode::Fixed ? FixedThreadRunner : GreedyThreadRunner;
-
-    const uint32 maxCpus = SysHost::GetLogicalCPUCount();
+    auto threadRunner = _mode == Mode::Fixed ? FixedThreadRunner : GreedyThreadRunner;
 
     for( uint i = 0; i < threadCount; i++ )
     {
         _threadData[i].index = (int)i;
-        _threadData[i].cpuId = (cpuOffset + i) % maxCpus;
+        _threadData[i].cpuId = cpuIds ? cpuIds[i] : ThreadAffinity::ComputeCpuId( cpuOffset + i );
         _threadData[i].pool  = this;
         
         Thread& t = _threads[i];
@@ -70,12 +93,33 @@ void ThreadPool::RunJob( JobFunc func, void* data, uint count, size_t dataSize )
     ASSERT( data     );
     ASSERT( dataSize );
 
+    BB_TRACE_SCOPE( "ThreadPool::RunJob" );
+
+    // With --yield-to-harvest, hold off on new jobs while a harvester on this machine is busy
+    HarvestYield::Yield();
+
     // #TODO: Should lock here to prevent re-entrancy and wait
     //        until current jobs are finished, but that is not the intended usage.
+    //        Only pools with shared submission do so.
+    uint32 ticket = 0;
+    if( _sharedSubmission )
+    {
+        ticket = _nextTicket.fetch_add( 1, std::memory_order_relaxed );
+
+        for( uint32 serving; ( serving = _servingTicket.load( std::memory_order_acquire ) ) != ticket; )
+            AddressWait::Wait( _servingTicket, serving );
+    }
+
     if( _mode == Mode::Fixed )
         DispatchFixed( func, (byte*)data, count, dataSize );
     else
         DispatchGreedy( func, (byte*)data, count, dataSize );
+
+    if( _sharedSubmission )
+    {
+        _servingTicket.store( ticket + 1, std::memory_order_release );
+        AddressWait::WakeAll( _servingTicket );
+    }
 }
 
 //-----------------------------------------------------------
@@ -151,6 +195,9 @@ void ThreadPool::FixedThreadRunner( void* tParam )
 
     const uint index = (uint)d.index;
 
+    BB_TRACE_THREAD_NAME( "Pool worker" );
+    PerfCounters::RegisterCurrentThread();
+
     std::atomic<bool>& exitSignal = pool._exitSignal;
     Semaphore&         poolSignal = pool._poolSignal;
     Semaphore&         jobSignal  = d.jobSignal;
@@ -168,7 +215,10 @@ void ThreadPool::FixedThreadRunner( void* tParam )
             break;
         
         // Run job
-        pool._jobFunc( pool._jobData + pool._jobDataSize * index );
+        {
+            BB_TRACE_SCOPE( "Job" );
+            pool._jobFunc( pool._jobData + pool._jobDataSize * index );
+        }
 
         // Finished job
         poolSignal.Release();
@@ -188,6 +238,9 @@ void ThreadPool::GreedyThreadRunner( void* tParam )
     if( !pool._disableAffinity )
         SysHost::SetCurrentThreadAffinityCpuId( d.cpuId );
 
+    BB_TRACE_THREAD_NAME( "Pool worker" );
+    PerfCounters::RegisterCurrentThread();
+
     for( ;; )
     {
         if( pool._exitSignal.load( std::memory_order_acquire ) )
@@ -214,6 +267,7 @@ void ThreadPool::GreedyThreadRunner( void* tParam )
                 ASSERT( pool._jobFunc );
 
                 // We acquired the job, run it
+                BB_TRACE_SCOPE( "Job" );
                 pool._jobFunc( pool._jobData + pool._jobDataSize * jobIndex );
             }
         }
@@ -21,6 +21,11 @@ public:
     };
 
     ThreadPool( uint threadCount, Mode mode = Mode::Fixed, bool disableAffinity = false, uint32 cpuOffset = 0);
+
+    // Create a pool where each thread i is pinned to cpuIds[i].
+    // Useful for creating pools local to a NUMA node, whose CPU ids may not be contiguous.
+    ThreadPool( uint threadCount, const uint* cpuIds, Mode mode = Mode::Fixed );
+
     ~ThreadPool();
 
     void RunJob( JobFunc func, void* data, uint count, size_t dataSize );
@@ -29,8 +34,17 @@ public:
     inline void RunJob( void (*TJobFunc)( T* ), T* data, uint count );
 
     inline uint ThreadCount() { return _threadCount; }
+
+    // Allow RunJob to be called from several threads at once.
+    // Callers then take turns, one job each, in the order they arrived.
+    inline void EnableSharedSubmission() { _sharedSubmission = true; }
+
+    // CPU the thread at index is, or would be, pinned to. In fixed mode, job i runs on thread i.
+    inline uint ThreadCpuId( uint index ) const { ASSERT( index < _threadCount ); return _threadData[index].cpuId; }
 private:
 
+    void StartThreads( const uint* cpuIds, uint32 cpuOffset );
+
     void DispatchFixed( JobFunc func, byte* data, uint count, size_t dataSize );
     void DispatchGreedy( JobFunc func, byte* data, uint count, size_t dataSize );
 
@@ -55,6 +69,10 @@ private:
     Semaphore         _poolSignal;          // Used to signal the pool that a thread has finished its job
     std::atomic<bool> _exitSignal = false;  // Used to signal threads to exit
 
+    bool                _sharedSubmission = false;
+    std::atomic<uint32> _nextTicket       = 0;  // Shared submission: ticket of the next caller to arrive
+    std::atomic<uint32> _servingTicket    = 0;  // Shared submission: ticket of the caller whose job is running
+
 
     // Current job group
     std::atomic<uint> _jobIndex    = 0;            // Next jobi index
@@ -0,0 +1,118 @@
+#include "TreeBarrier.h"
+#include "threading/ThreadPool.h"
+#include "SysHost.h"
+#include "util/Util.h"
+
+//-----------------------------------------------------------
+static uint32 GetNodeOfCpu( const uint32 cpuId )
+{
+    // Built once, the NUMA layout does not change while running
+    static const std::vector<uint32> cpuNodes = [](){
+
+        std::vector<uint32> nodes;
+
+        const NumaInfo* numa = SysHost::GetNUMAInfo();
+        if( !numa )
+            return nodes;
+
+        for( uint32 node = 0; node < numa->nodeCount; node++ )
+        {
+            const Span<uint>& cpus = numa->cpuIds[node];
+
+            for( size_t i = 0; i < cpus.Length(); i++ )
+            {
+                if( cpus[i] >= nodes.size() )
+                    nodes.resize( cpus[i] + 1, 0 );
+
+                nodes[cpus[i]] = node;
+            }
+        }
+
+        return nodes;
+    }();
+
+    return cpuId < cpuNodes.size() ? cpuNodes[cpuId] : 0;
+}
+
+//-----------------------------------------------------------
+void TreeBarrier::Init( ThreadPool& pool, const uint32 threadCount )
+{
+    _threadCount = 0;
+    _allArrived.store( 0, std::memory_order_relaxed );
+
+    if( threadCount < MinThreads )
+        return;
+
+    const uint32 NoNode = 0xFFFFFFFF;   // NUMA node of tree nodes that span several of them
+
+    std::vector<uint32> expected;
+    std::vector<uint32> parents;
+    std::vector<uint32> numaNodes;
+    std::vector<uint32> level;
+
+    const auto addNode = [&]( const uint32 numaNode ) -> uint32 {
+        expected .push_back( 0 );
+        parents  .push_back( NoParent );
+        numaNodes.push_back( numaNode );
+        return (uint32)expected.size() - 1;
+    };
+
+    // Leaves hold consecutive jobs of the same NUMA node. The control thread does not arrive.
+    _leafOfJob.assign( threadCount, NoParent );
+
+    for( uint32 job = 1; job < threadCount; job++ )
+    {
+        const uint32 numaNode = job < pool.ThreadCount() ? GetNodeOfCpu( pool.ThreadCpuId( job ) ) : 0;
+
+        if( level.empty() || expected[level.back()] == FanIn || numaNodes[level.back()] != numaNode )
+            level.push_back( addNode( numaNode ) );
+
+        expected[level.back()]++;
+        _leafOfJob[job] = level.back();
+    }
+
+    // Combine each level into the next one, within NUMA nodes first
+    for( bool sameNumaOnly = true; level.size() > 1; )
+    {
+        std::vector<uint32> next;
+
+        for( const uint32 child : level )
+        {
+            const uint32 numaNode = sameNumaOnly ? numaNodes[child] : NoNode;
+
+            if( next.empty() || expected[next.back()] == FanIn || numaNodes[next.back()] != numaNode )
+                next.push_back( addNode( numaNode ) );
+
+            expected[next.back()]++;
+            parents[child] = next.back();
+        }
+
+        // Once every node holds a whole NUMA node, merge across them
+        if( next.size() == level.size() )
+        {
+            expected .resize( expected .size() - next.size() );
+            parents  .resize( parents  .size() - next.size() );
+            numaNodes.resize( numaNodes.size() - next.size() );
+
+            for( const uint32 child : level )
+                parents[child] = NoParent;
+
+            sameNumaOnly = false;
+            continue;
+        }
+
+        level.swap( next );
+    }
+
+    const size_t nodeCount = expected.size();
+    _nodes.reset( new Node[nodeCount] );
+
+    for( size_t i = 0; i < nodeCount; i++ )
+    {
+        _nodes[i].count.store( 0, std::memory_order_relaxed );
+        _nodes[i].expected = expected[i];
+        _nodes[i].parent   = parents[i];
+    }
+
+    _threadCount = threadCount;
+}
@@ -0,0 +1,102 @@
+#pragma once
+#include "threading/AddressWait.h"
+#include <atomic>
+#include <memory>
+#include <vector>
+
+class ThreadPool;
+
+///
+/// Combining-tree barrier used by MTJob and the y sort to synchronize large thread counts.
+/// Threads arrive at a leaf shared by at most FanIn threads of the same NUMA node,
+/// and only the last arrival of each node moves up the tree, so that no single
+/// cache line is written to by every thread. Thread 0, the control thread,
+/// is released from the root and releases the others through a shared generation counter,
+/// which they only read.
+///
+class TreeBarrier
+{
+public:
+    static constexpr uint32 FanIn      = 8;
+    static constexpr uint32 MinThreads = 32;     // Below this, a single counter is as fast
+
+    // Builds the tree for threadCount jobs running on pool, where job i runs on thread i.
+    // Does nothing if threadCount is below MinThreads.
+    void Init( ThreadPool& pool, uint32 threadCount );
+
+    // The tree only applies to the thread count it was built for.
+    // Jobs that have reduced their thread count fall back to their own counters.
+    inline bool IsActive( const uint32 threadCount ) const { return _threadCount > 0 && threadCount == _threadCount; }
+
+    // Non-control threads: signal arrival and wait until the control thread releases everyone.
+    inline void ArriveAndWait( uint32 jobId );
+
+    // Control thread: wait until all other threads have arrived.
+    inline void WaitForArrivals();
+
+    // Control thread: release all threads waiting in ArriveAndWait().
+    inline void Release();
+
+private:
+    struct alignas( 64 ) Node
+    {
+        std::atomic<uint32> count;
+        uint32              expected;
+        uint32              parent;
+    };
+
+    static constexpr uint32 NoParent = 0xFFFFFFFF;
+
+    uint32                  _threadCount = 0;
+    std::unique_ptr<Node[]> _nodes;
+    std::vector<uint32>     _leafOfJob;
+
+    alignas( 64 ) std::atomic<uint32> _allArrived = 0;
+    alignas( 64 ) std::atomic<uint32> _generation = 0;
+};
+
+//-----------------------------------------------------------
+inline void TreeBarrier::ArriveAndWait( const uint32 jobId )
+{
+    ASSERT( jobId > 0 && jobId < _threadCount );
+
+    // Read the generation before arriving, as the release may follow right after
+    const uint32 generation = _generation.load( std::memory_order_acquire );
+
+    for( uint32 nodeIdx = _leafOfJob[jobId]; ; )
+    {
+        Node& node = _nodes[nodeIdx];
+
+        if( node.count.fetch_add( 1, std::memory_order_acq_rel ) + 1 != node.expected )
+            break;
+
+        // Last one here, nobody else touches this node until the next release
+        node.count.store( 0, std::memory_order_relaxed );
+
+        if( node.parent == NoParent )
+        {
+            _allArrived.store( 1, std::memory_order_release );
+            break;
+        }
+
+        nodeIdx = node.parent;
+    }
+
+    while( _generation.load( std::memory_order_acquire ) == generation )
+        AddressWait::SpinPause();
+}
+
+//-----------------------------------------------------------
+inline void TreeBarrier::WaitForArrivals()
+{
+    while( _allArrived.load( std::memory_order_acquire ) == 0 )
+        AddressWait::SpinPause();
+
+    _allArrived.store( 0, std::memory_order_relaxed );
+}
+
+//-----------------------------------------------------------
+inline void TreeBarrier::Release()
+{
+    _generation.fetch_add( 1, std::memory_order_release );
+}
@@ -0,0 +1,132 @@
+#include "WorkStealingRanges.h"
+
+//-----------------------------------------------------------
+WorkStealingRanges::WorkStealingRanges( const uint32 threadCount, const uint64 totalCount, const uint64 grainSize )
+    : _threadCount( threadCount )
+    , _grainSize  ( std::max( grainSize, (uint64)1 ) )
+{
+    ASSERT( threadCount > 0 );
+
+    _ranges = new Range[threadCount];
+
+    const uint64 countPerThread = totalCount / threadCount;
+    const uint64 remainder      = totalCount - countPerThread * threadCount;
+
+    for( uint32 i = 0; i < threadCount; i++ )
+    {
+        const uint64 offset = countPerThread * i;
+        const uint64 count  = countPerThread + ( i == threadCount-1 ? remainder : 0 );
+
+        _ranges[i].begin.store( offset,         std::memory_order_relaxed );
+        _ranges[i].end  .store( offset + count, std::memory_order_relaxed );
+    }
+
+    std::atomic_thread_fence( std::memory_order_release );
+}
+
+//-----------------------------------------------------------
+WorkStealingRanges::~WorkStealingRanges()
+{
+    delete[] _ranges;
+}
+
+//-----------------------------------------------------------
+uint64 WorkStealingRanges::DefaultGrainSize( const uint32 threadCount, const uint64 totalCount, const uint64 minGrain )
+{
+    return std::max( totalCount / ( (uint64)threadCount * 32 ), std::max( minGrain, (uint64)1 ) );
+}
+
+//-----------------------------------------------------------
+bool WorkStealingRanges::Next( const uint32 threadId, uint64& outOffset, uint64& outCount )
+{
+    ASSERT( threadId < _threadCount );
+    Range& range = _ranges[threadId];
+
+    for( ;; )
+    {
+        range.Lock();
+        {
+            const uint64 begin = range.begin.load( std::memory_order_relaxed );
+            const uint64 end   = range.end  .load( std::memory_order_relaxed );
+
+            if( begin < end )
+            {
+                const uint64 count = std::min( _grainSize, end - begin );
+                range.begin.store( begin + count, std::memory_order_relaxed );
+                range.Unlock();
+
+                outOffset = begin;
+                outCount  = count;
+                return true;
+            }
+        }
+        range.Unlock();
+
+        if( !Steal( threadId ) )
+            return false;
+    }
+}
+
+//-----------------------------------------------------------
+bool WorkStealingRanges::Steal( const uint32 threadId )
+{
+    for( ;; )
+    {
+        // Pick the victim with the most remaining work. The loads are only a hint, the
+        // actual split is done under the victim's lock.
+        uint32 victim    = threadId;
+        uint64 maxRemain = 0;
+
+        for( uint32 i = 1; i < _threadCount; i++ )
+        {
+            const uint32 t      = (threadId + i) % _threadCount;
+            const uint64 begin  = _ranges[t].begin.load( std::memory_order_relaxed );
+            const uint64 end    = _ranges[t].end  .load( std::memory_order_relaxed );
+            const uint64 remain = end > begin ? end - begin : 0;
+
+            if( remain > maxRemain )
+            {
+                maxRemain = remain;
+                victim    = t;
+            }
+        }
+
+        // Nothing left anywhere. Work held by other threads is theirs to finish.
+        if( maxRemain == 0 )
+            return false;
+
+        Range& v = _ranges[victim];
+
+        uint64 stolenBegin = 0, stolenEnd = 0;
+
+        v.Lock();
+        {
+            const uint64 begin = v.begin.load( std::memory_order_relaxed );
+            const uint64 end   = v.end  .load( std::memory_order_relaxed );
+
+            if( begin < end )
+            {
+                // Take the back half, leaving the victim at least one grain to continue with
+                const uint64 remain = end - begin;
+                const uint64 steal  = remain <= _grainSize ? remain : remain / 2;
+
+                stolenBegin = end - steal;
+                stolenEnd   = end;
+                v.end.store( stolenBegin, std::memory_order_relaxed );
+            }
+        }
+        v.Unlock();
+
+        // Someone else got to it first, try again
+        if( stolenBegin == stolenEnd )
+            continue;
+
+        Range& own = _ranges[threadId];
+        own.Lock();
+        own.begin.store( stolenBegin, std::memory_order_relaxed );
+        own.end  .store( stolenEnd  , std::memory_order_relaxed );
+        own.Unlock();
+
+        return true;
+    }
+}
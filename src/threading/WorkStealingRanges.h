@@ -0,0 +1,43 @@
+#pragma once
+#include "util/Util.h"
+#include <atomic>
+
+///
+/// Splits [0, totalCount) across threads for range-based parallel loops, with work stealing.
+/// Each thread starts with the same static partition GetThreadOffsets() would give it
+/// and takes grainSize-sized chunks from the front of its own range.
+/// When a thread runs out of work, it steals the back half of whichever thread has
+/// the most work left. A slow or NUMA-remote thread therefore no longer delays the
+/// barrier at the end of the phase.
+///
+class WorkStealingRanges
+{
+public:
+    WorkStealingRanges( uint32 threadCount, uint64 totalCount, uint64 grainSize );
+    ~WorkStealingRanges();
+
+    // Get the next chunk of work for the given thread.
+    // Returns false once no work is left in any thread's range.
+    bool Next( uint32 threadId, uint64& outOffset, uint64& outCount );
+
+    // Grain size that gives each thread ~32 chunks, but no fewer than minGrain items per chunk.
+    static uint64 DefaultGrainSize( uint32 threadCount, uint64 totalCount, uint64 minGrain = 1024 );
+
+private:
+    bool Steal( uint32 threadId );
+
+    struct alignas( 64 ) Range
+    {
+        std::atomic<uint64> begin;          // Only written while holding lock, but can be read speculatively
+        std::atomic<uint64> end;
+        std::atomic<bool>   lock = false;
+
+        inline void Lock()   { while( lock.exchange( true, std::memory_order_acquire ) ) {} }
+        inline void Unlock() { lock.store( false, std::memory_order_release ); }
+    };
+
+private:
+    Range* _ranges      = nullptr;
+    uint32 _threadCount = 0;
+    uint64 _grainSize   = 1;
+};
@@ -0,0 +1,40 @@
+#pragma once
+#include <string>
+
+///
+/// Short synthetic runs of the CUDA plotter's k32 kernels, used by 'cudacheck --bench'
+/// to compare devices without running full plots.
+///
+struct GpuBenchResult
+{
+    double f1;              // Entries/s
+    double sort;            // Entries/s, y sort with x as values
+    double match;           // Entries/s of the sorted input table
+    double fx;              // Matches/s, table 2
+    double park;            // Line points/s compressed into table 1 parks
+    double h2d;             // Bytes/s, pinned host buffers
+    double d2h;             // Bytes/s, pinned host buffers
+    double plotSeconds;     // Estimated k32 in-memory plot time
+};
+
+/// Fastest block sizes found by 'cudacheck --tune'
+struct GpuTuneResult
+{
+    uint32      f1Threads;
+    uint32      fxThreads;
+    uint32      parkThreads;
+    std::string profilePath;
+    bool        saved;          // The profile was written to profilePath
+};
+
+class GpuBenchmark
+{
+public:
+    /// Runs the kernels on the given device. Returns false if CUDA
+    /// is not available or the device failed to run them.
+    static bool Run( int deviceIndex, GpuBenchResult& outResult );
+
+    /// Times the block size candidates of the tunable kernels on the given device,
+    /// and saves the fastest ones as the device's launch profile.
+    static bool Tune( int deviceIndex, GpuTuneResult& outResult );
+};
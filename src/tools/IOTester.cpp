@@ -5,6 +5,14 @@
 #include "plotdisk/jobs/IOJob.h"
 #include "plotting/GlobalPlotConfig.h"
 #include "util/jobs/MemJobs.h"
+#include "util/StackAllocator.h"
+#include "util/VirtualAllocator.h"
+#include "threading/Fence.h"
+#include "plotdisk/DiskBufferQueue.h"
+#include "plotdisk/DiskPlotConfig.h"
+#include "plotting/DiskQueue.h"
+#include "plotting/DiskBuffer.h"
+#include "plotting/DiskBucketBuffer.h"
 
 void IOTestPrintUsage();
 
@@ -13,6 +21,28 @@ static const size_t FILE_NAME_SIZE = 32;
 static void GetTmpFileName( char fileName[FILE_NAME_SIZE] );
 static void InitPages( ThreadPool& pool, const uint32 threadCount, void* mem, const size_t size );
 
+// Temp file access patterns of the plotters, replayed without any of their compute
+enum class IOPattern
+{
+    None = 0,
+    DiskPlot,   // diskplot's bounded k32 Phase 1 and the back pointer reads of Phases 2 and 3
+    Cuda128,    // cudaplot --disk-128
+    Cuda16,     // cudaplot --disk-16
+};
+
+struct IOPatternConfig
+{
+    IOPattern   pattern     = IOPattern::None;
+    const char* tmp1        = nullptr;
+    const char* tmp2        = nullptr;
+    uint32      bucketCount = 256;
+    uint64      entryCount  = 0;        // Entries per table
+    bool        directIO    = true;
+};
+
+static void ReplayDiskPlot  ( const IOPatternConfig& cfg );
+static void ReplayCudaHybrid( const IOPatternConfig& cfg );
+
 
 //-----------------------------------------------------------
 void IOTestMain( GlobalPlotConfig& gCfg, CliParser& cli )
@@ -23,6 +53,9 @@ void IOTestMain( GlobalPlotConfig& gCfg, CliParser& cli )
     uint32      passCount    = 1;
     size_t      memReserve   = 0;
     double      passDelaySec = 0.0;
+    const char* patternName  = nullptr;
+    const char* tmp2Dir      = nullptr;
+    uint32      bucketCount  = 256;
 
     while( cli.HasArgs() )
     {
@@ -30,6 +63,12 @@ void IOTestMain( GlobalPlotConfig& gCfg, CliParser& cli )
         {
             FatalIf( writeSize < 1, "Write size must be > 0." );
         }
+        else if( cli.ReadStr( patternName, "--pattern" ) )
+            continue;
+        else if( cli.ReadStr( tmp2Dir, "--tmp2" ) )
+            continue;
+        else if( cli.ReadU32( bucketCount, "-b", "--buckets" ) )
+            continue;
         else if( cli.ReadSwitch( noDirectIO, "-d", "--no-direct-io" ) )
             continue;
         else if( cli.ReadSize( memReserve, "-m", "--memory" ) )
@@ -63,6 +102,39 @@ void IOTestMain( GlobalPlotConfig& gCfg, CliParser& cli )
     FatalIf( testDir == nullptr || testDir[0] == 0, 
         "Expected an output directory as the last argument." );
 
+    if( patternName )
+    {
+        IOPatternConfig pcfg;
+        pcfg.tmp1        = testDir;
+        pcfg.tmp2        = tmp2Dir ? tmp2Dir : testDir;
+        pcfg.bucketCount = bucketCount;
+        pcfg.directIO    = !noDirectIO;
+
+        // Each table entry moves around 32 bytes through the temp files (y, index, metadata,
+        // back pointers and map), so the size scales the number of entries replayed per table.
+        pcfg.entryCount = std::max( (uint64)writeSize / 32, (uint64)1 );
+
+        if( strcmp( patternName, "diskplot" ) == 0 )
+            pcfg.pattern = IOPattern::DiskPlot;
+        else if( strcmp( patternName, "cuda128" ) == 0 )
+            pcfg.pattern = IOPattern::Cuda128;
+        else if( strcmp( patternName, "cuda16" ) == 0 )
+            pcfg.pattern = IOPattern::Cuda16;
+        else
+            Fatal( "Unknown I/O pattern '%s'. Expected diskplot, cuda128 or cuda16.", patternName );
+
+        FatalIf( pcfg.pattern == IOPattern::DiskPlot && 
+                 ( bucketCount < BB_DP_MIN_BUCKET_COUNT || bucketCount > BB_DP_MAX_BUCKET_COUNT || !IsPowerOf2( bucketCount ) ),
+                 "Bucket count must be a power of 2 between %u and %u.", BB_DP_MIN_BUCKET_COUNT, BB_DP_MAX_BUCKET_COUNT );
+
+        if( pcfg.pattern == IOPattern::DiskPlot )
+            ReplayDiskPlot( pcfg );
+        else
+            ReplayCudaHybrid( pcfg );
+
+        return;
+    }
+
 
     char* filePath    = nullptr;
     char* fileNamePtr = nullptr;
@@ -250,6 +322,552 @@ void IOTestMain( GlobalPlotConfig& gCfg, CliParser& cli )
     remove( filePath );
 }
 
+//-----------------------------------------------------------
+static void LogPhaseTime( const char* name, const double elapsed, const double k32Scale )
+{
+    Log::Line( " %-8s: %8.2lf seconds ( ~%.2lf seconds at k32 )", name, elapsed, elapsed * k32Scale );
+}
+
+//-----------------------------------------------------------
+static void LogReplayScale( const IOPatternConfig& cfg, const uint32 bucketCount, const uint64 sliceEntries )
+{
+    const uint64 tableEntries = sliceEntries * bucketCount * bucketCount;
+
+    Log::Line( "Temp1        : %s", cfg.tmp1 );
+    Log::Line( "Temp2        : %s", cfg.tmp2 );
+    Log::Line( "Buckets      : %u", bucketCount );
+    Log::Line( "Slice entries: %llu", (llu)sliceEntries );
+    Log::Line( "Table entries: %llu ( %.2lf%% of k32 )", (llu)tableEntries, tableEntries * 100.0 / (double)( 1ull << 32 ) );
+    Log::Line( "Direct I/O   : %s", cfg.directIO ? "enabled" : "disabled" );
+    Log::Line( "" );
+}
+
+//-----------------------------------------------------------
+static void GetReplayFilePrefix( char prefix[FILE_NAME_SIZE] )
+{
+    // iotest_<8 random hex chars>_
+    GetTmpFileName( prefix );
+    memcpy( prefix, "iotest_", 7 );
+    prefix[15] = '_';
+    prefix[16] = 0;
+}
+
+/// Replays the temp file I/O of a bounded k32 diskplot through a DiskBufferQueue, bucket by bucket:
+/// Phase 1 reads each table's y, index and metadata buckets while writing the next table's ones interleaved,
+/// along with its back pointers and map. Phases 2 and 3 read the back pointers and maps back.
+/// Nothing is computed, so the times are those of the I/O alone, with one bucket read ahead and
+/// one written behind, like the plotter does.
+//-----------------------------------------------------------
+void ReplayDiskPlot( const IOPatternConfig& cfg )
+{
+    const uint32 bucketCount = cfg.bucketCount;
+
+    char prefix[FILE_NAME_SIZE];
+    GetReplayFilePrefix( prefix );
+
+    // The queue's heap is only used for block buffers, the replay brings its own I/O buffers
+    const size_t heapSize = 64ull MB;
+    byte*        heap     = bbvirtalloc<byte>( heapSize );
+
+    auto* ioQueue = new DiskBufferQueue( cfg.tmp1, cfg.tmp2, cfg.tmp1, heap, heapSize, 1, -1, prefix );
+
+    const FileSetOptions tmp1Opts = cfg.directIO ? FileSetOptions::DirectIO : FileSetOptions::None;
+    const FileSetOptions tmp2Opts = FileSetOptions::Interleaved | FileSetOptions::UseTemp2 | tmp1Opts;
+
+    ioQueue->InitFileSet( FileId::FX0   , "y0"    , bucketCount, tmp2Opts, nullptr );
+    ioQueue->InitFileSet( FileId::FX1   , "y1"    , bucketCount, tmp2Opts, nullptr );
+    ioQueue->InitFileSet( FileId::INDEX0, "index0", bucketCount, tmp2Opts, nullptr );
+    ioQueue->InitFileSet( FileId::INDEX1, "index1", bucketCount, tmp2Opts, nullptr );
+    ioQueue->InitFileSet( FileId::META0 , "meta0" , bucketCount, tmp2Opts, nullptr );
+    ioQueue->InitFileSet( FileId::META1 , "meta1" , bucketCount, tmp2Opts, nullptr );
+
+    char name[8];
+    for( int32 i = 0; i < 7; i++ )
+    {
+        sprintf( name, "t%d", i+1 );
+        ioQueue->InitFileSet( FileId::T1 + (FileId)i, name, 1, tmp1Opts, nullptr );
+    }
+
+    for( int32 i = 0; i < 6; i++ )
+    {
+        sprintf( name, "map%d", i+2 );
+        ioQueue->InitFileSet( FileId::MAP2 + (FileId)i, name, bucketCount, tmp1Opts, nullptr );
+    }
+
+    const size_t blockSize = std::max( ioQueue->BlockSize( FileId::FX0 ), ioQueue->BlockSize( FileId::T1 ) );
+    FatalIf( blockSize < 4 || blockSize % 4 != 0, "Unsupported file system block size of %llu.", (llu)blockSize );
+
+    // Slices must be block-aligned for every element size (4, 8, 12 and 16 bytes),
+    // just like the plotter's block-aligned slice counts.
+    const uint64 sliceEntries  = RoundUpToNextBoundaryT<uint64>( CDiv( cfg.entryCount, (uint64)bucketCount * bucketCount ), blockSize / 4 );
+    const uint64 bucketEntries = sliceEntries * bucketCount;
+    const size_t pairsSize     = RoundUpToNextBoundaryT<size_t>( bucketEntries * 5, blockSize );   // Back pointers pack to ~40 bits
+    const double k32Scale      = (double)( 1ull << 32 ) / (double)( bucketEntries * bucketCount );
+
+    LogReplayScale( cfg, bucketCount, sliceEntries );
+
+    // Bytes per entry of the metadata written by tables 1 through 7
+    const size_t metaSizes[7] = { 4, 8, 16, 16, 12, 8, 0 };
+
+    const size_t bufferCapacity = bucketEntries * ( 4 + 4 + 16 ) * 2    // Input y, index and meta
+                                + bucketEntries * ( 4 + 4 + 16 + 8 ) * 2 // Output y, index, meta and map
+                                + pairsSize * 2 + blockSize * 32;
+
+    byte* bufferMem = bbvirtalloc<byte>( bufferCapacity );
+    StackAllocator allocator( bufferMem, bufferCapacity );
+
+    Span<byte> yIn[2], idxIn[2], metaIn[2];
+    byte*      yOut[2], *idxOut[2], *metaOut[2], *mapOut[2], *pairsOut[2];
+
+    for( uint32 i = 0; i < 2; i++ )
+    {
+        yIn     [i] = allocator.CAllocSpan<byte>( bucketEntries * 4 , blockSize );
+        idxIn   [i] = allocator.CAllocSpan<byte>( bucketEntries * 4 , blockSize );
+        metaIn  [i] = allocator.CAllocSpan<byte>( bucketEntries * 16, blockSize );
+        yOut    [i] = allocator.CAlloc<byte>( bucketEntries * 4 , blockSize );
+        idxOut  [i] = allocator.CAlloc<byte>( bucketEntries * 4 , blockSize );
+        metaOut [i] = allocator.CAlloc<byte>( bucketEntries * 16, blockSize );
+        mapOut  [i] = allocator.CAlloc<byte>( bucketEntries * 8 , blockSize );
+        pairsOut[i] = allocator.CAlloc<byte>( pairsSize         , blockSize );
+    }
+
+    std::vector<uint32> sliceCounts  ( bucketCount, (uint32)sliceEntries );
+    std::vector<uint32> mapSliceSizes( bucketCount, (uint32)( sliceEntries * 8 ) );
+
+    Fence readFence, writeFence;
+
+    // Phase 1
+    Log::Line( "Replaying Phase 1..." );
+    const auto p1Timer = TimerBegin();
+
+    for( uint32 table = 0; table < 7; table++ )
+    {
+        const auto   tableTimer   = TimerBegin();
+        const FileId yId[2]       = { FileId::FX0    + (FileId)( ( table + 1 ) & 1 ), FileId::FX0    + (FileId)( table & 1 ) };
+        const FileId idxId[2]     = { FileId::INDEX0 + (FileId)( ( table + 1 ) & 1 ), FileId::INDEX0 + (FileId)( table & 1 ) };
+        const FileId metaId[2]    = { FileId::META0  + (FileId)( ( table + 1 ) & 1 ), FileId::META0  + (FileId)( table & 1 ) };
+        const size_t metaInSize   = table > 0 ? metaSizes[table-1] : 0;
+        const size_t metaOutSize  = metaSizes[table];
+
+        for( uint32 i = 0; i < 2; i++ )
+        {
+            ioQueue->SeekBucket( yId   [i], 0, SeekOrigin::Begin );
+            ioQueue->SeekBucket( idxId [i], 0, SeekOrigin::Begin );
+            ioQueue->SeekBucket( metaId[i], 0, SeekOrigin::Begin );
+        }
+        ioQueue->CommitCommands();
+
+        readFence .Reset( 0 );
+        writeFence.Reset( 0 );
+
+        auto readBucket = [&]( const uint32 bucket ) {
+
+            const uint32 i = bucket & 1;
+
+            yIn[i] = Span<byte>( yIn[i].Ptr(), bucketEntries );
+            ioQueue->ReadBucketElements( yId[0], false, yIn[i], 4 );
+
+            if( table > 1 )
+            {
+                idxIn[i] = Span<byte>( idxIn[i].Ptr(), bucketEntries );
+                ioQueue->ReadBucketElements( idxId[0], false, idxIn[i], 4 );
+            }
+
+            if( metaInSize )
+            {
+                metaIn[i] = Span<byte>( metaIn[i].Ptr(), bucketEntries );
+                ioQueue->ReadBucketElements( metaId[0], false, metaIn[i], metaInSize );
+            }
+
+            ioQueue->SignalFence( readFence, bucket + 1 );
+            ioQueue->CommitCommands();
+        };
+
+        if( table > 0 )
+            readBucket( 0 );
+
+        for( uint32 bucket = 0; bucket < bucketCount; bucket++ )
+        {
+            const uint32 i = bucket & 1;
+
+            if( table > 0 )
+            {
+                if( bucket + 1 < bucketCount )
+                    readBucket( bucket + 1 );
+
+                readFence.Wait( bucket + 1 );
+            }
+
+            // Wait for the write buffers to be released by bucket - 2
+            if( bucket > 1 )
+                writeFence.Wait( bucket - 1 );
+
+            ioQueue->WriteBucketElements( yId[1], true, yOut[i], 4, sliceCounts.data(), sliceCounts.data() );
+
+            if( table > 0 )
+                ioQueue->WriteBucketElements( idxId[1], true, idxOut[i], 4, sliceCounts.data(), sliceCounts.data() );
+
+            if( metaOutSize )
+                ioQueue->WriteBucketElements( metaId[1], true, metaOut[i], metaOutSize, sliceCounts.data(), sliceCounts.data() );
+
+            // Table 1 writes x, the others their back pointers and the map of their sorted entries
+            ioQueue->WriteFile( FileId::T1 + (FileId)table, 0, pairsOut[i], table > 0 ? pairsSize : bucketEntries * 4 );
+
+            // Map slices are appended to the file of their bucket
+            if( table > 0 )
+                ioQueue->WriteBuckets( FileId::MAP2 + (FileId)(table-1), mapOut[i], mapSliceSizes.data() );
+
+            ioQueue->SignalFence( writeFence, bucket + 1 );
+            ioQueue->CommitCommands();
+        }
+
+        writeFence.Wait( bucketCount );
+        Log::Line( " Table %u: %.2lf seconds", table+1, TimerEnd( tableTimer ) );
+    }
+
+    ioQueue->DeleteBucket( FileId::FX0    );
+    ioQueue->DeleteBucket( FileId::FX1    );
+    ioQueue->DeleteBucket( FileId::INDEX0 );
+    ioQueue->DeleteBucket( FileId::INDEX1 );
+    ioQueue->DeleteBucket( FileId::META0  );
+    ioQueue->DeleteBucket( FileId::META1  );
+    ioQueue->CommitCommands();
+
+    const double p1Elapsed = TimerEnd( p1Timer );
+
+    // Phase 2 walks the back pointers from table 7 down to table 2 to mark the entries in use
+    Log::Line( "Replaying Phase 2..." );
+    const auto p2Timer = TimerBegin();
+
+    for( uint32 table = 6; table > 0; table-- )
+    {
+        const FileId id = FileId::T1 + (FileId)table;
+
+        readFence.Reset( 0 );
+        ioQueue->SeekFile( id, 0, 0, SeekOrigin::Begin );
+
+        // Nothing consumes the back pointers, so the reads are issued back-to-back
+        for( uint32 bucket = 0; bucket < bucketCount; bucket++ )
+            ioQueue->ReadFile( id, 0, pairsOut[bucket & 1], pairsSize );
+
+        ioQueue->SignalFence( readFence, 1 );
+        ioQueue->CommitCommands();
+        readFence.Wait( 1 );
+    }
+
+    const double p2Elapsed = TimerEnd( p2Timer );
+
+    // Phase 3 reads the back pointers again, now along with the map of their left table
+    Log::Line( "Replaying Phase 3..." );
+    const auto p3Timer = TimerBegin();
+
+    for( uint32 table = 1; table < 7; table++ )
+    {
+        const FileId id    = FileId::T1   + (FileId)table;
+        const FileId mapId = FileId::MAP2 + (FileId)(table-2);
+
+        readFence.Reset( 0 );
+
+        ioQueue->SeekFile( id, 0, 0, SeekOrigin::Begin );
+
+        // Table 2's left table is x, read in bucket order. The others read a whole
+        // map bucket file, along with the next chunk of back pointers.
+        if( table > 1 )
+            ioQueue->SeekBucket( mapId, 0, SeekOrigin::Begin );
+        else
+            ioQueue->SeekFile( FileId::T1, 0, 0, SeekOrigin::Begin );
+
+        for( uint32 bucket = 0; bucket < bucketCount; bucket++ )
+        {
+            ioQueue->ReadFile( id, 0, pairsOut[bucket & 1], pairsSize );
+
+            if( table > 1 )
+                ioQueue->ReadFile( mapId, bucket, mapOut[bucket & 1], bucketEntries * 8 );
+            else
+                ioQueue->ReadFile( FileId::T1, 0, mapOut[bucket & 1], bucketEntries * 4 );
+        }
+
+        ioQueue->SignalFence( readFence, 1 );
+        ioQueue->CommitCommands();
+        readFence.Wait( 1 );
+    }
+
+    const double p3Elapsed = TimerEnd( p3Timer );
+
+    for( int32 i = 0; i < 7; i++ )
+        ioQueue->DeleteBucket( FileId::T1 + (FileId)i );
+    for( int32 i = 0; i < 6; i++ )
+        ioQueue->DeleteBucket( FileId::MAP2 + (FileId)i );
+
+    ioQueue->CommitCommands();
+    ioQueue->WaitForPendingDeletes();
+
+    Log::Line( "" );
+    Log::Line( "Replayed diskplot temp I/O:" );
+    LogPhaseTime( "Phase 1", p1Elapsed, k32Scale );
+    LogPhaseTime( "Phase 2", p2Elapsed, k32Scale );
+    LogPhaseTime( "Phase 3", p3Elapsed, k32Scale );
+    LogPhaseTime( "Total"  , p1Elapsed + p2Elapsed + p3Elapsed, k32Scale );
+    Log::Line( "k32 estimates assume the measured throughput holds at k32 sizes." );
+
+    // The queue owns threads and is never torn down by the plotter either
+    bbvirtfree( bufferMem );
+}
+
+/// Runs one pass over all the buckets of a set of disk buffers, reading each bucket one ahead
+/// of its use and submitting the written ones, in the order the CUDA plotter does.
+/// Null buffers are skipped.
+//-----------------------------------------------------------
+static void ReplayBufferPass( const uint32 bucketCount,
+                              std::initializer_list<DiskBufferBase*> reads,
+                              std::initializer_list<std::pair<DiskBucketBuffer*, size_t>> bucketWrites,
+                              std::initializer_list<std::pair<DiskBuffer*, size_t>> writes = {} )
+{
+    for( auto* buf : reads )
+        if( buf ) buf->ReadNextBucket();
+
+    for( uint32 bucket = 0; bucket < bucketCount; bucket++ )
+    {
+        for( auto* buf : reads )
+        {
+            if( !buf ) continue;
+            buf->TryReadNextBucket();
+            buf->GetNextReadBuffer();
+        }
+
+        for( auto& w : bucketWrites )
+        {
+            if( !w.first ) continue;
+            w.first->GetNextWriteBuffer();
+            w.first->Submit( w.second );
+        }
+
+        for( auto& w : writes )
+        {
+            if( !w.first ) continue;
+            w.first->GetNextWriteBuffer();
+            w.first->Submit( w.second );
+        }
+    }
+}
+
+/// Replays the temp file I/O of cudaplot's disk hybrid modes through DiskQueues and disk buffers.
+/// Both modes write each table's back pointers to temp1 and run Phase 3 through temp2 bucket buffers.
+/// The 16GiB mode also streams every table's y and metadata through temp2.
+/// Nothing is computed, so the times are those of the I/O alone.
+//-----------------------------------------------------------
+void ReplayCudaHybrid( const IOPatternConfig& cfg )
+{
+    const uint32 bucketCount = 128;  // BBCU_BUCKET_COUNT, which lives in the CUDA sources
+    const bool   hybrid16    = cfg.pattern == IOPattern::Cuda16;
+
+    char prefix[FILE_NAME_SIZE];
+    GetReplayFilePrefix( prefix );
+
+    DiskQueue* tmp1Queue = new DiskQueue( cfg.tmp1 );
+    DiskQueue* tmp2Queue = strcmp( cfg.tmp1, cfg.tmp2 ) == 0 ? tmp1Queue : new DiskQueue( cfg.tmp2 );
+
+    const FileFlags flags     = cfg.directIO ? FileFlags::NoBuffering | FileFlags::LargeFile : FileFlags::LargeFile;
+    const size_t    blockSize = std::max( tmp1Queue->BlockSize(), tmp2Queue->BlockSize() );
+    FatalIf( blockSize < 4 || blockSize % 4 != 0, "Unsupported file system block size of %llu.", (llu)blockSize );
+
+    const uint64 sliceEntries  = RoundUpToNextBoundaryT<uint64>( CDiv( cfg.entryCount, (uint64)bucketCount * bucketCount ), blockSize / 4 );
+    const uint64 bucketEntries = sliceEntries * bucketCount;
+    const double k32Scale      = (double)( 1ull << 32 ) / (double)( bucketEntries * bucketCount );
+
+    LogReplayScale( cfg, bucketCount, sliceEntries );
+
+    // Bytes per entry of the metadata written by tables 1 through 7
+    const size_t metaSizes[7] = { 4, 8, 16, 16, 12, 8, 0 };
+
+    std::string name;
+    auto fileName = [&]( const char* suffix ) -> const char* {
+        name = std::string( prefix ) + suffix;
+        return name.c_str();
+    };
+
+    auto createBucketBuffer = [&]( DiskQueue& queue, const char* suffix, const size_t sliceSize ) {
+        DiskBucketBuffer* buf = DiskBucketBuffer::Create( queue, fileName( suffix ), bucketCount, sliceSize,
+                                                          FileMode::Create, FileAccess::ReadWrite, flags );
+        FatalIf( !buf, "Failed to create disk buffer '%s' in '%s'.", name.c_str(), queue.Path() );
+        return buf;
+    };
+
+    auto createBuffer = [&]( const char* suffix, const size_t bufferSize ) {
+        DiskBuffer* buf = DiskBuffer::Create( *tmp1Queue, fileName( suffix ), bucketCount, bufferSize,
+                                              FileMode::Create, FileAccess::ReadWrite, flags );
+        FatalIf( !buf, "Failed to create disk buffer '%s' in '%s'.", name.c_str(), tmp1Queue->Path() );
+        return buf;
+    };
+
+    VirtualAllocator allocator;
+
+    // Back pointers of tables 2 through 7. Table 2 stores whole pairs in its L buffer.
+    // Only one table is in use at a time, so they all share the I/O buffers of the largest ones.
+    DiskBuffer* tablesL[7] = {};
+    DiskBuffer* tablesR[7] = {};
+
+    for( uint32 table = 1; table < 7; table++ )
+    {
+        char suffix[16];
+        sprintf( suffix, "table_l_%u.tmp", table+1 );
+        tablesL[table] = createBuffer( suffix, bucketEntries * ( table == 1 ? 8 : 4 ) );
+
+        if( table > 1 )
+        {
+            sprintf( suffix, "table_r_%u.tmp", table+1 );
+            tablesR[table] = createBuffer( suffix, bucketEntries * 2 );
+        }
+    }
+
+    tablesL[1]->ReserveBuffers( allocator );
+    tablesR[2]->ReserveBuffers( allocator );
+
+    for( uint32 table = 2; table < 7; table++ )
+        tablesL[table]->ShareBuffers( *tablesL[1] );
+    for( uint32 table = 3; table < 7; table++ )
+        tablesR[table]->ShareBuffers( *tablesR[2] );
+
+    DiskBucketBuffer* yBuffer    = nullptr;
+    DiskBucketBuffer* metaBuffer = nullptr;
+
+    if( hybrid16 )
+    {
+        yBuffer    = createBucketBuffer( *tmp2Queue, "y.tmp"   , sliceEntries * 4  );
+        metaBuffer = createBucketBuffer( *tmp2Queue, "meta.tmp", sliceEntries * 16 );
+        yBuffer   ->ReserveBuffers( allocator );
+        metaBuffer->ReserveBuffers( allocator );
+    }
+
+    DiskBucketBuffer* rMapBuffer      = createBucketBuffer( *tmp2Queue, "p3_rmap.tmp"     , sliceEntries * 8 );
+    DiskBucketBuffer* indexBuffer     = createBucketBuffer( *tmp2Queue, "p3_index.tmp"    , sliceEntries * 4 );
+    DiskBucketBuffer* lpAndLMapBuffer = createBucketBuffer( *tmp2Queue, "p3_lp_lmap.tmp"  , sliceEntries * 8 );
+    rMapBuffer     ->ReserveBuffers( allocator );
+    indexBuffer    ->ReserveBuffers( allocator );
+    lpAndLMapBuffer->ReserveBuffers( allocator );
+
+    // Phase 1
+    Log::Line( "Replaying Phase 1..." );
+    const auto p1Timer = TimerBegin();
+
+    const size_t ySliceSize     = sliceEntries * 4;
+    const size_t indexSliceSize = sliceEntries * 4;
+    const size_t mapSliceSize   = sliceEntries * 8;
+
+    // F1 writes table 1's y and x
+    if( hybrid16 )
+    {
+        ReplayBufferPass( bucketCount, {}, { { yBuffer, ySliceSize }, { metaBuffer, sliceEntries * metaSizes[0] } } );
+        yBuffer   ->Swap();
+        metaBuffer->Swap();
+    }
+
+    for( uint32 table = 1; table < 7; table++ )
+    {
+        const auto tableTimer = TimerBegin();
+
+        DiskBuffer* lBuf = tablesL[table];
+        DiskBuffer* rBuf = tablesR[table];
+
+        // Table 2 writes whole pairs to its L buffer
+        const std::pair<DiskBuffer*, size_t> lWrite = { lBuf, bucketEntries * ( rBuf ? 4 : 8 ) };
+        const std::pair<DiskBuffer*, size_t> rWrite = { rBuf, bucketEntries * 2 };
+
+        if( hybrid16 )
+        {
+            // y and metadata are read back and written out in the same pass, except
+            // for table 7, which has no metadata and keeps its y for the plot's C tables.
+            if( table < 6 )
+                ReplayBufferPass( bucketCount, { yBuffer, metaBuffer },
+                                  { { yBuffer, ySliceSize }, { metaBuffer, sliceEntries * metaSizes[table] } }, { lWrite, rWrite } );
+            else
+                ReplayBufferPass( bucketCount, { yBuffer, metaBuffer }, {}, { lWrite, rWrite } );
+
+            yBuffer   ->Swap();
+            metaBuffer->Swap();
+        }
+        else
+            ReplayBufferPass( bucketCount, {}, {}, { lWrite, rWrite } );
+
+        lBuf->Swap();
+        if( rBuf )
+            rBuf->Swap();
+
+        Log::Line( " Table %u: %.2lf seconds", table+1, TimerEnd( tableTimer ) );
+    }
+
+    const double p1Elapsed = TimerEnd( p1Timer );
+
+    // Phase 2 walks the back pointers from table 7 down to table 3 to mark the entries in use
+    Log::Line( "Replaying Phase 2..." );
+    const auto p2Timer = TimerBegin();
+
+    for( uint32 table = 6; table > 1; table-- )
+    {
+        ReplayBufferPass( bucketCount, { tablesL[table], tablesR[table] }, {} );
+        tablesL[table]->Swap();
+        tablesR[table]->Swap();
+    }
+
+    const double p2Elapsed = TimerEnd( p2Timer );
+
+    // Phase 3 converts each table's back pointers to line points in three steps, through temp2
+    Log::Line( "Replaying Phase 3..." );
+    const auto p3Timer = TimerBegin();
+
+    for( uint32 table = 1; table < 7; table++ )
+    {
+        DiskBuffer* lBuf = tablesL[table];
+        DiskBuffer* rBuf = tablesR[table];
+
+        // Step 1: Back pointers to the R map
+        ReplayBufferPass( bucketCount, { lBuf, rBuf }, { { rMapBuffer, mapSliceSize } } );
+
+        lBuf->Swap();
+        if( rBuf )
+            rBuf->Swap();
+        rMapBuffer->Swap();
+
+        // Step 2: R map and the L table's map to line points and their indices.
+        // Table 2's x are inlined into its back pointers, so it has no L map.
+        ReplayBufferPass( bucketCount, { rMapBuffer, table > 1 ? lpAndLMapBuffer : nullptr },
+                          { { lpAndLMapBuffer, mapSliceSize }, { indexBuffer, indexSliceSize } } );
+
+        rMapBuffer     ->Swap();
+        lpAndLMapBuffer->Swap();
+        indexBuffer    ->Swap();
+
+        // Step 3: Line points sorted on their index, which also writes out the map of the next table
+        ReplayBufferPass( bucketCount, { lpAndLMapBuffer, indexBuffer }, { { table < 6 ? lpAndLMapBuffer : nullptr, mapSliceSize } } );
+
+        lpAndLMapBuffer->Swap();
+        indexBuffer    ->Swap();
+    }
+
+    const double p3Elapsed = TimerEnd( p3Timer );
+
+    // Deleting the buffers removes their files
+    for( uint32 table = 1; table < 7; table++ )
+    {
+        delete tablesL[table];
+        delete tablesR[table];
+    }
+
+    delete yBuffer;
+    delete metaBuffer;
+    delete rMapBuffer;
+    delete indexBuffer;
+    delete lpAndLMapBuffer;
+
+    Log::Line( "" );
+    Log::Line( "Replayed cudaplot --%s temp I/O:", hybrid16 ? "disk-16" : "disk-128" );
+    LogPhaseTime( "Phase 1", p1Elapsed, k32Scale );
+    LogPhaseTime( "Phase 2", p2Elapsed, k32Scale );
+    LogPhaseTime( "Phase 3", p3Elapsed, k32Scale );
+    LogPhaseTime( "Total"  , p1Elapsed + p2Elapsed + p3Elapsed, k32Scale );
+    Log::Line( "k32 estimates assume the measured throughput holds at k32 sizes." );
+}
+
 //-----------------------------------------------------------
 void GetTmpFileName( char fileName[FILE_NAME_SIZE] )
 {
@@ -287,7 +905,24 @@ Performs read/write test on the specified disk path.
  
  --delay <secs>     : Time (in seconds) to wait between passes.
 
+ --pattern <name>   : Instead of a sequential test, replay the temp file I/O of a plotter,
+                      without its compute, and report the time each phase spent on I/O.
+                      The size sets the scale of the replay, about 32 bytes per table entry,
+                      and the times are also extrapolated to k32.
+                      -m and -p do not apply. <name> is one of:
+                        diskplot: diskplot (bounded k32) through its DiskBufferQueue.
+                        cuda128 : cudaplot --disk-128 through DiskQueues.
+                        cuda16  : cudaplot --disk-16 through DiskQueues.
+
+ --tmp2 <dir>       : With --pattern, the temp2 directory. Defaults to <test_dir>,
+                      which is used as temp1.
+
+ -b, --buckets <n>  : With --pattern diskplot, the bucket count. Default is 256.
+
  -h, --help         : Print this help message and exit.
+
+Example:
+ bladebit iotest -s 16GB --pattern diskplot --tmp2 /mnt/ram /mnt/ssd
 )";
 
 //-----------------------------------------------------------
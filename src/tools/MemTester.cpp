@@ -8,23 +8,44 @@
 
 void MemTestPrintUsage();
 
+struct MemNodeResult
+{
+    double copyGBs;     // GiB/s
+    double readGBs;     // GiB/s
+    double latencyNs;   // Dependent random load latency
+};
+
+static void   RunNumaTest( GlobalPlotConfig& gCfg, size_t memSize );
+static void   RunScalingTest( GlobalPlotConfig& gCfg, size_t memSize, uint32& outPeakThreads );
+static double ReadBandwidth( ThreadPool& pool, uint32 threadCount, const byte* src, size_t size );
+static void   InitRandomChase( uint64* lines, uint64 lineCount );
+static double RandomChaseLatency( ThreadPool& pool, const uint64* lines, uint64 loadCount );
+
 //-----------------------------------------------------------
 void MemTestMain( GlobalPlotConfig& gCfg, CliParser& cli )
 {
-    size_t memSize  = 16ull MB;
+    size_t memSize   = 16ull MB;
     uint32 passCount = 1;
+    bool   sizeSet   = false;
+    bool   numaTest  = false;
+    bool   scaling   = false;
 
     while( cli.HasArgs() )
     {
         if( cli.ReadSize( memSize, "-s", "--size" ) )
         {
             FatalIf( memSize < 1, "Memory size must be > 0." );
+            sizeSet = true;
         }
         else if( cli.ReadU32( passCount, "-p", "--passes" ) )
         {
             if( passCount < 1 ) passCount = 1;
             continue;
         }
+        else if( cli.ReadSwitch( numaTest, "--numa" ) )
+            continue;
+        else if( cli.ReadSwitch( scaling, "--scaling" ) )
+            continue;
         else if( cli.ArgConsume( "-h", "--help" ) )
         {
             MemTestPrintUsage();
@@ -36,6 +57,30 @@ void MemTestMain( GlobalPlotConfig& gCfg, CliParser& cli )
         }
     }
 
+    if( numaTest || scaling )
+    {
+        // Buffers that fit in the caches would not tell us anything about the memory
+        if( !sizeSet )
+            memSize = 1ull GB;
+
+        uint32 peakThreads = 0;
+
+        if( scaling )
+            RunScalingTest( gCfg, memSize, peakThreads );
+
+        if( numaTest )
+            RunNumaTest( gCfg, memSize );
+
+        if( scaling )
+        {
+            Log::Line( "Recommended ramplot threads: -t %u", peakThreads );
+            Log::Line( " Copy bandwidth peaks at %u threads. The compute-bound parts of ramplot can", peakThreads );
+            Log::Line( " still gain from more threads, but its memory-bound sorts and copies will not." );
+        }
+
+        exit( 0 );
+    }
+
     const uint32 maxThreads  = SysHost::GetLogicalCPUCount();
     const uint32 threadCount = gCfg.threadCount == 0 ? 1 : std::min( gCfg.threadCount, maxThreads );
 
@@ -77,6 +122,271 @@ void MemTestMain( GlobalPlotConfig& gCfg, CliParser& cli )
     exit( 0 );
 }
 
+/// Measures copy and read bandwidth and random access latency of the memory of each
+/// NUMA node from the CPUs of each node, with the threads pinned to the CPUs of that node.
+//-----------------------------------------------------------
+void RunNumaTest( GlobalPlotConfig& gCfg, const size_t memSize )
+{
+    const NumaInfo* numa = gCfg.disableNuma ? nullptr : SysHost::GetNUMAInfo();
+
+    if( !numa || numa->nodeCount < 2 )
+    {
+        Log::Line( "NUMA test: This is not a NUMA system or NUMA is disabled. Skipping." );
+        Log::Line( " Interleave settings do not apply, ramplot does not need --numa-local." );
+        Log::Line( "" );
+        return;
+    }
+
+    const uint32 nodeCount = numa->nodeCount;
+    const uint64 lineCount = memSize / 64;
+    FatalIf( lineCount < 2, "Memory size is too small for the NUMA test." );
+
+    // Enough dependent loads to amortize the timer, but bounded so that large buffers don't take forever
+    const uint64 loadCount = std::min( lineCount * 4, (uint64)16 * 1024 * 1024 );
+
+    std::vector<MemNodeResult> results( (size_t)nodeCount * nodeCount );
+
+    Log::Line( "NUMA test: %u nodes, %.2lf MiB per node", nodeCount, (double)memSize BtoMB );
+
+    for( uint32 memNode = 0; memNode < nodeCount; memNode++ )
+    {
+        // Bind the pages to the node before they are faulted in
+        byte* src = bbvirtalloc<byte>( memSize );
+        byte* dst = bbvirtalloc<byte>( memSize );
+        SysHost::NumaAssignPages( src, memSize, memNode );
+        SysHost::NumaAssignPages( dst, memSize, memNode );
+
+        for( uint32 cpuNode = 0; cpuNode < nodeCount; cpuNode++ )
+        {
+            const Span<uint>& cpuIds      = numa->cpuIds[cpuNode];
+            const uint32      threadCount = gCfg.threadCount == 0 ? (uint32)cpuIds.Length() :
+                                            std::min( gCfg.threadCount, (uint32)cpuIds.Length() );
+
+            ThreadPool pool( threadCount, cpuIds.Ptr() );
+
+            if( cpuNode == 0 )
+            {
+                FaultMemoryPages::RunJob( pool, threadCount, src, memSize );
+                FaultMemoryPages::RunJob( pool, threadCount, dst, memSize );
+            }
+
+            MemNodeResult& r = results[cpuNode * nodeCount + memNode];
+
+            auto timer = TimerBegin();
+            MemCpyMT::Copy( dst, src, memSize, pool, threadCount );
+            r.copyGBs = memSize / TimerEnd( timer ) BtoGB;
+
+            r.readGBs = ReadBandwidth( pool, threadCount, src, memSize );
+
+            // The copy and read tests are done with the contents of src, reuse it for the chase
+            if( cpuNode == 0 )
+                InitRandomChase( (uint64*)src, lineCount );
+
+            r.latencyNs = RandomChaseLatency( pool, (const uint64*)src, loadCount );
+
+            Log::Line( " CPU node %u -> memory node %u: copy %6.2lf GiB/s, read %6.2lf GiB/s, latency %6.1lf ns ( %u threads )",
+                       cpuNode, memNode, r.copyGBs, r.readGBs, r.latencyNs, threadCount );
+        }
+
+        bbvirtfree( src );
+        bbvirtfree( dst );
+    }
+
+    auto printMatrix = [&]( const char* title, const char* fmt, double MemNodeResult::* field ) {
+
+        Log::Line( "" );
+        Log::Line( "%s (rows: CPU node, columns: memory node)", title );
+        Log::Write( "      " );
+        for( uint32 m = 0; m < nodeCount; m++ )
+            Log::Write( "%9u", m );
+        Log::Line( "" );
+
+        for( uint32 c = 0; c < nodeCount; c++ )
+        {
+            Log::Write( " %4u ", c );
+            for( uint32 m = 0; m < nodeCount; m++ )
+                Log::Write( fmt, results[c * nodeCount + m].*field );
+            Log::Line( "" );
+        }
+    };
+
+    printMatrix( "Copy bandwidth (GiB/s)", "%9.2lf", &MemNodeResult::copyGBs   );
+    printMatrix( "Read bandwidth (GiB/s)", "%9.2lf", &MemNodeResult::readGBs   );
+    printMatrix( "Latency (ns)"          , "%9.1lf", &MemNodeResult::latencyNs );
+
+    // Compare node-local with remote accesses
+    double local = 0, remote = 0;
+    for( uint32 c = 0; c < nodeCount; c++ )
+    {
+        for( uint32 m = 0; m < nodeCount; m++ )
+        {
+            if( c == m )
+                local  += results[c * nodeCount + m].copyGBs;
+            else
+                remote += results[c * nodeCount + m].copyGBs;
+        }
+    }
+
+    local  /= nodeCount;
+    remote /= (double)nodeCount * ( nodeCount - 1 );
+
+    const double remoteRatio = remote / local;
+
+    Log::Line( "" );
+    Log::Line( "Remote copy bandwidth is %.0lf%% of node-local bandwidth.", remoteRatio * 100.0 );
+
+    if( remoteRatio < 0.8 )
+    {
+        Log::Line( "Recommended: ramplot --numa-local, with a thread count that is a multiple of the node count (%u)", nodeCount );
+        Log::Line( " so that each thread mostly accesses memory of its own node." );
+    }
+    else
+    {
+        Log::Line( "Recommended: ramplot's default interleaved NUMA binding. Remote accesses are cheap enough" );
+        Log::Line( " that spreading the pages over all nodes balances bandwidth better than --numa-local." );
+    }
+    Log::Line( "" );
+}
+
+/// Copy bandwidth as threads are added, to find where the memory saturates.
+//-----------------------------------------------------------
+void RunScalingTest( GlobalPlotConfig& gCfg, const size_t memSize, uint32& outPeakThreads )
+{
+    const uint32 maxThreads = gCfg.threadCount == 0 ? SysHost::GetLogicalCPUCount() :
+                              std::min( gCfg.threadCount, SysHost::GetLogicalCPUCount() );
+
+    ThreadPool pool( maxThreads, ThreadPool::Mode::Fixed, gCfg.disableCpuAffinity );
+
+    byte* src = bbvirtalloc<byte>( memSize );
+    byte* dst = bbvirtalloc<byte>( memSize );
+    FaultMemoryPages::RunJob( pool, maxThreads, src, memSize );
+    FaultMemoryPages::RunJob( pool, maxThreads, dst, memSize );
+
+    Log::Line( "Thread scaling: %.2lf MiB, up to %u threads", (double)memSize BtoMB, maxThreads );
+    Log::Line( " Threads   Copy GiB/s  Per thread   Read GiB/s" );
+
+    double peak = 0;
+    outPeakThreads = 1;
+
+    for( uint32 threads = 1; ; threads = std::min( threads * 2, maxThreads ) )
+    {
+        auto timer = TimerBegin();
+        MemCpyMT::Copy( dst, src, memSize, pool, threads );
+        const double copyGBs = memSize / TimerEnd( timer ) BtoGB;
+        const double readGBs = ReadBandwidth( pool, threads, src, memSize );
+
+        Log::Line( " %7u %12.2lf %11.2lf %12.2lf", threads, copyGBs, copyGBs / threads, readGBs );
+
+        // Adding threads must gain at least 5% to count
+        if( copyGBs > peak * 1.05 )
+        {
+            peak           = copyGBs;
+            outPeakThreads = threads;
+        }
+
+        if( threads == maxThreads )
+            break;
+    }
+
+    Log::Line( "" );
+
+    bbvirtfree( src );
+    bbvirtfree( dst );
+}
+
+//-----------------------------------------------------------
+double ReadBandwidth( ThreadPool& pool, const uint32 threadCount, const byte* src, const size_t size )
+{
+    const uint64  wordCount = size / sizeof( uint64 );
+    const uint64* words     = (const uint64*)src;
+
+    std::atomic<uint64> sink( 0 );
+
+    const auto timer = TimerBegin();
+
+    AnonMTJob::RunRanges( pool, threadCount, wordCount, [&]( AnonMTJob* self, const uint64 offset, const uint64 count ) {
+
+        // Independent accumulators to keep the loads in flight
+        uint64 a = 0, b = 0, c = 0, d = 0;
+
+        const uint64* p   = words + offset;
+        const uint64* end = p + count / 4 * 4;
+
+        for( ; p < end; p += 4 )
+        {
+            a += p[0];
+            b += p[1];
+            c += p[2];
+            d += p[3];
+        }
+
+        sink += a ^ b ^ c ^ d;
+    });
+
+    const double elapsed = TimerEnd( timer );
+
+    // Keep the loads from being optimized out
+    if( sink.load() == 1 )
+        Log::Line( "" );
+
+    return wordCount * sizeof( uint64 ) / elapsed BtoGB;
+}
+
+/// Links all the cache lines of the buffer into a single random cycle,
+/// so that each load depends on the previous one and can't be prefetched.
+//-----------------------------------------------------------
+void InitRandomChase( uint64* lines, const uint64 lineCount )
+{
+    const uint64 stride = 64 / sizeof( uint64 );
+
+    for( uint64 i = 0; i < lineCount; i++ )
+        lines[i * stride] = i;
+
+    // Sattolo's algorithm shuffles the lines into a single cycle
+    uint64 seed = 0x9E3779B97F4A7C15ull;
+
+    for( uint64 i = lineCount - 1; i > 0; i-- )
+    {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+
+        const uint64 j = seed % i;
+        std::swap( lines[i * stride], lines[j * stride] );
+    }
+
+    // Entries hold the next line's index, turn them into word offsets
+    for( uint64 i = 0; i < lineCount; i++ )
+        lines[i * stride] *= stride;
+}
+
+//-----------------------------------------------------------
+double RandomChaseLatency( ThreadPool& pool, const uint64* lines, const uint64 loadCount )
+{
+    double elapsed = 0;
+    uint64 last    = 0;
+
+    // Run on the first thread of the pool, which is pinned to the CPU node we are measuring
+    AnonMTJob::Run( pool, 1, [&]( AnonMTJob* self ) {
+
+        uint64 next = 0;
+
+        const auto timer = TimerBegin();
+
+        for( uint64 i = 0; i < loadCount; i++ )
+            next = lines[next];
+
+        elapsed = TimerEnd( timer );
+        last    = next;
+    });
+
+    // Keep the loads from being optimized out
+    if( last == ~0ull )
+        Log::Line( "" );
+
+    return elapsed * 1e9 / (double)loadCount;
+}
+
 //-----------------------------------------------------------
 static const char* USAGE = R"(memtest [OPTIONS]
 
@@ -89,6 +399,20 @@ Specify -t <n> in the global options to set the thread count.
 
  -p, --passes <n>   : The number of passes to perform. By default it is 1.
 
+ --numa             : Measure copy and read bandwidth, and random access latency,
+                      from the CPUs of each NUMA node to the memory of each node.
+                      Threads are pinned to the CPUs of the node being measured.
+                      Prints a node-to-node matrix of each, and recommends a NUMA
+                      setting for ramplot. Uses -t threads per node if given,
+                      otherwise all of a node's CPUs.
+
+ --scaling          : Measure copy and read bandwidth from 1 up to -t threads
+                      (all logical CPUs by default), doubling the thread count each
+                      step, and recommend a ramplot thread count.
+
+                      With --numa or --scaling the size defaults to 1GB,
+                      and -p does not apply.
+
  -h, --help         : Print this help message and exit.
 )";
 
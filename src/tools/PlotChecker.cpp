@@ -3,6 +3,8 @@
 #include "plotting/PlotValidation.h"
 #include "harvesting/GreenReaper.h"
 #include "plotting/f1/F1Gen.h"
+#include <algorithm>
+#include <vector>
 
 class PlotCheckerImpl : public PlotChecker
 {
@@ -91,7 +93,10 @@ public:
     //-----------------------------------------------------------
     void PerformPlotCheck( const char* plotPath, PlotCheckResult& result )
     {
-        FilePlot plot;
+        FilePlot   filePlot;
+        MmapPlot   mmapPlot;
+        IPlotFile& plot = _cfg.useMmap ? (IPlotFile&)mmapPlot : (IPlotFile&)filePlot;
+
         if( !plot.Open( plotPath ) )
         {
             std::stringstream err; err << "Failed to open plot file at '" << plotPath << "' with error " << plot.GetError() << ".";
@@ -99,7 +104,7 @@ public:
             return;
         }
 
-        const uint32 threadCount = _cfg.threadCount == 0 ? SysHost::GetLogicalCPUCount() :
+        const uint32 threadCount = _cfg.threadCount == 0 ? SysHost::GetUsableCPUCount() :
                                         std::min( (uint32)MAX_THREADS, std::min( _cfg.threadCount, SysHost::GetLogicalCPUCount() ) );
 
         const bool useGpu = plot.CompressionLevel() > 0 && !_cfg.noGpu;
@@ -107,12 +112,17 @@ public:
         PlotReader reader( plot );
 
         if( _cfg.grContext )
-            reader.AssignDecompressionContext( _cfg.grContext );
+            reader.AssignDecompressionContext( _cfg.grContext, _cfg.grContextLock );
         else
             reader.ConfigDecompressor( threadCount, _cfg.disableCpuAffinity, 0, useGpu, (int)_cfg.gpuIndex );
 
         const uint32 k = plot.K();
 
+        result.k                = k;
+        result.compressionLevel = plot.CompressionLevel();
+        result.usedGpu          = plot.CompressionLevel() > 0 && reader.GetDecompressorContext() &&
+                                    (bool)grHasGpuDecompressor( reader.GetDecompressorContext() );
+
         byte AlignAs(8) seed[BB_PLOT_ID_LEN] = {};
 
         if( !_cfg.hasSeed )
@@ -140,18 +150,31 @@ public:
 
         const uint64 f7Mask = (1ull << k) - 1;
 
-        uint64 prevF7     = 0;
-        uint64 proofCount = 0;
-
-        uint64 proofXs[BB_PLOT_PROOF_X_COUNT];
-
-        uint64 nextPercentage = 10;
+        // Generate the whole challenge set up front, and resolve it in ascending f7 order.
+        // The C3 parks, and then the P7 entries, are then read in a single sweep across the file.
+        std::vector<uint64> f7s( _cfg.proofCount );
 
+        uint64 prevF7 = 0;
         for( uint64 i = 0; i < _cfg.proofCount; i++ )
         {
             const uint64 f7 = F1GenSingleForK( k, seed, prevF7 ) & f7Mask;
             prevF7 = f7;
+            f7s[i] = f7;
+        }
+
+        std::sort( f7s.begin(), f7s.end() );
 
+        struct ProofRef
+        {
+            uint64 t6Index;
+            uint64 f7;
+        };
+
+        std::vector<ProofRef> proofRefs;
+        proofRefs.reserve( f7s.size() );
+
+        for( const uint64 f7 : f7s )
+        {
             uint64 startP7Idx = 0;
             const uint64 nF7Proofs = reader.GetP7IndicesForF7( f7, startP7Idx );
 
@@ -164,28 +187,51 @@ public:
                     continue;
                 }
 
-                const auto r = reader.FetchProof( p7Entry, proofXs );
-                if( r == ProofFetchResult::OK )
+                proofRefs.push_back( { p7Entry, f7 } );
+            }
+        }
+
+        // Fetch the proofs sorted by their table 6 line point, so that the parks
+        // are visited in file order, and proofs sharing a park read it only once.
+        std::sort( proofRefs.begin(), proofRefs.end(), []( const ProofRef& a, const ProofRef& b ) {
+            return a.t6Index < b.t6Index;
+        });
+
+        uint64 proofCount = 0;
+
+        uint64 proofXs[BB_PLOT_PROOF_X_COUNT];
+
+        uint64 nextPercentage = 10;
+
+        for( uint64 i = 0; i < proofRefs.size(); i++ )
+        {
+            const uint64 p7Entry = proofRefs[i].t6Index;
+            const uint64 f7      = proofRefs[i].f7;
+
+            const auto fetchTimer = TimerBegin();
+            const ProofFetchResult r = reader.FetchProof( p7Entry, proofXs );
+            result.proofTimes.Record( (uint64)TicksToNanoSeconds( TimerEndTicks( fetchTimer ) ) );
+
+            if( r == ProofFetchResult::OK )
+            {
+                // Convert to 
+                uint64 outF7 = 0;
+                if( PlotValidation::ValidateFullProof( k, plot.PlotId(), proofXs, outF7 ) && outF7 == f7 )
                 {
-                    // Convert to 
-                    uint64 outF7 = 0;
-                    if( PlotValidation::ValidateFullProof( k, plot.PlotId(), proofXs, outF7 ) && outF7 == f7 )
-                    {
-                        proofCount++;
-                    }
-                    else
-                    {
-                        result.proofValidationFailCount++;
-                    }
+                    proofCount++;
                 }
                 else
                 {
-                    if( r != ProofFetchResult::NoProof )
-                        result.proofFetchFailCount ++;
+                    result.proofValidationFailCount++;
                 }
             }
+            else
+            {
+                if( r != ProofFetchResult::NoProof )
+                    result.proofFetchFailCount ++;
+            }
 
-            const double percent = i / (double)_cfg.proofCount * 100.0;
+            const double percent = i / (double)proofRefs.size() * 100.0;
             if( (uint64)percent == nextPercentage )
             {
                 if( !_cfg.silent )
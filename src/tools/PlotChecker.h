@@ -1,6 +1,8 @@
 #pragma once
 #include "ChiaConsts.h"
+#include "util/LatencyHistogram.h"
 #include <string>
+#include <mutex>
 
 struct PlotCheckerConfig
 {
@@ -10,13 +12,16 @@ struct PlotCheckerConfig
     uint32      threadCount        = 0;
     bool        disableCpuAffinity = false;
     bool        silent             = false;
+    bool        useMmap            = false;    // Map plots into memory instead of reading them
     bool        hasSeed            = false;
     byte        seed[BB_PLOT_ID_LEN]{};
 
     bool        deletePlots     = false;    // If true, plots that fail to fetch proofs, or are below a threshold, will be deleted
     double      deleteThreshold = 0.0;      // If proofs received to proof request ratio is below this, the plot will be deleted
 
-    struct GreenReaperContext* grContext = nullptr;
+    struct GreenReaperContext* grContext     = nullptr;
+    std::mutex*                grContextLock = nullptr;    // If set, held around each call into grContext,
+                                                           // so that a single-device context can be shared across checkers
 };
 
 struct PlotCheckResult
@@ -28,6 +33,11 @@ struct PlotCheckResult
     byte        seedUsed[BB_PLOT_ID_LEN];
     std::string error;
     bool        deleted;
+
+    uint32           k;
+    uint32           compressionLevel;
+    bool             usedGpu;           // Proofs were decompressed on a GPU
+    LatencyHistogram proofTimes;        // Time taken to fetch each proof
 };
 
 class PlotChecker
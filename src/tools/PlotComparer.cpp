@@ -1,4 +1,5 @@
 #include "io/FileStream.h"
+#include "io/PrefetchStream.h"
 #include "ChiaConsts.h"
 #include "tools/PlotReader.h"
 #include "util/Util.h"
@@ -9,14 +10,17 @@
 #include "plotting/GlobalPlotConfig.h"
 #include "plotdisk/jobs/IOJob.h"
 #include "threading/ThreadPool.h"
+#include "threading/MTJob.h"
 #include <vector>
 #include <algorithm>
+#include <mutex>
 
+struct PlotCompareOptions;
+struct TableCompareResult;
 
 void DumpPlotHeader( FilePlot& plot );
-void TestTable( TableId table, FilePlot& ref, FilePlot& tgt );
-void TestC3Table( FilePlot& ref, FilePlot& tgt );
-void TestTable( FilePlot& ref, FilePlot& tgt, TableId table );
+TableCompareResult TestC3Table( FilePlot& ref, FilePlot& tgt, const PlotCompareOptions& opts );
+TableCompareResult TestTable( FilePlot& ref, FilePlot& tgt, TableId table, const PlotCompareOptions& opts );
 
 void UnpackPark7( uint32 k, const byte* srcBits, uint64* dstEntries );
 
@@ -25,19 +29,23 @@ void DumpP7( FilePlot& plot, const char* path );
 Span<uint> ReadC1Table( FilePlot& plot );
 
 //-----------------------------------------------------------
-const char USAGE[] = R"(plotcmp <plot_a_path> <plot_b_path>
+const char USAGE[] = R"(plotcmp [OPTIONS] <plot_a_path> <plot_b_path>
 
 Compares 2 plots for matching tables.
+Tables are compared in park ranges across the threads set with the global '-t' option.
 
 [ARGUMENTS]
 <plot_*_path> : Path to the plot files to be compared.
+
+[OPTIONS]
+ --first-diff : Stop at the first mismatching park and report its location.
  -h, --help   : Print this help message and exit.
 )";
 
 //-----------------------------------------------------------
 void PlotCompareMainPrintUsage()
 {
-    Log::Line( "" );
+    Log::Line( USAGE );
     Log::Flush();
 }
 
@@ -46,10 +54,29 @@ void PlotCompareMainPrintUsage()
 //-----------------------------------------------------------
 struct PlotCompareOptions
 {
-    const char* plotAPath = "";
-    const char* plotBPath = "";
+    const char* plotAPath   = "";
+    const char* plotBPath   = "";
+    bool        firstDiff   = false;    // Stop at the first mismatching park
+    uint32      threadCount = 0;
+    ThreadPool* pool        = nullptr;
+};
+
+struct TableCompareResult
+{
+    uint64 parkCount = 0;
+    uint64 failCount = 0;
+    uint64 firstFail = std::numeric_limits<uint64>::max();  // Lowest mismatching park index
+    size_t parkSize  = 0;
 };
 
+// Parks per thread are read this many bytes at a time
+static constexpr size_t CMP_CHUNK_SIZE = 8 MiB;
+
+// Chunks each thread keeps reading in the background while it compares
+static constexpr uint32 CMP_READ_AHEAD = 2;
+
+static std::mutex _cmpLogLock;
+
 //-----------------------------------------------------------
 void PlotCompareMain( GlobalPlotConfig& gCfg, CliParser& cli )
 {
@@ -62,6 +89,8 @@ void PlotCompareMain( GlobalPlotConfig& gCfg, CliParser& cli )
             PlotCompareMainPrintUsage();
             exit( 0 );
         }
+        else if( cli.ReadSwitch( opts.firstDiff, "--first-diff" ) )
+            continue;
         else
             break;
     }
@@ -105,12 +134,55 @@ void PlotCompareMain( GlobalPlotConfig& gCfg, CliParser& cli )
     // TestTable( refPlot, tgtPlot, TableId::Table7 );
     // TestTable( refPlot, tgtPlot, TableId::Table3 );
 
-    TestC3Table( refPlot, tgtPlot );
+    const uint32 maxThreads = SysHost::GetLogicalCPUCount();
+    opts.threadCount = gCfg.threadCount == 0 ? maxThreads : std::min( maxThreads, gCfg.threadCount );
+
+    ThreadPool pool( opts.threadCount );
+    opts.pool = &pool;
+
+    const auto timer = TimerBegin();
+
+    uint64 failedTables = 0;
+
+    auto Report = [&]( const char* tableName, const PlotTable table, const TableCompareResult& r ) {
+
+        if( r.failCount == 0 )
+            return true;
+
+        failedTables++;
+
+        if( !opts.firstDiff )
+            return true;
+
+        Log::Line( "First difference: %s park %llu @ target plot offset 0x%016llx.", tableName, (llu)r.firstFail,
+            (llu)( tgtPlot.TableAddress( table ) + r.firstFail * r.parkSize ) );
+        return false;
+    };
+
+    {
+        const TableCompareResult r = TestC3Table( refPlot, tgtPlot, opts );
+        if( !Report( "C3", PlotTable::C3, r ) )
+            Exit( 1 );
+    }
 
     for( TableId table = TableId::Table1; table <= TableId::Table7; table++ )
-        TestTable( refPlot, tgtPlot, table );
+    {
+        const TableCompareResult r = TestTable( refPlot, tgtPlot, table, opts );
+
+        char tableName[8];
+        snprintf( tableName, sizeof( tableName ), "Table %u", (uint32)table+1 );
+
+        if( !Report( tableName, (PlotTable)table, r ) )
+            Exit( 1 );
+    }
+
+    Log::Line( "Compared plots in %.2lf seconds.", TimerEnd( timer ) );
 
-    // TestC3Table( refPlot, tgtPlot );
+    if( failedTables )
+    {
+        Log::Line( "%llu tables mismatched.", (llu)failedTables );
+        Exit( 1 );
+    }
 }
 
 //-----------------------------------------------------------
@@ -168,8 +240,251 @@ Span<uint> ReadC2Table( FilePlot& plot )
     return Span<uint>( c2, entryCount );
 }
 
+/// Compares a single P7 park. Entries with the same f7 may be in a different order
+/// in each plot, and can spill into the next park, if present after the given one.
+//-----------------------------------------------------------
+bool CompareP7Park( const uint32 k, const byte* p7RefBytes, const byte* p7TgtBytes, const bool hasNextPark )
+{
+    // Unpack the next park along with this one, so that we can compare entries across parks
+    uint64 ref[kEntriesPerPark*2];
+    uint64 tgt[kEntriesPerPark*2];
+
+    uint64 refMatch[kEntriesPerPark*2];
+    uint64 tgtMatch[kEntriesPerPark*2];
+
+    const size_t parkSize = CalculatePark7Size( k );
+
+    UnpackPark7( k, p7RefBytes, ref );
+    UnpackPark7( k, p7TgtBytes, tgt );
+
+    if( hasNextPark )
+    {
+        UnpackPark7( k, p7RefBytes + parkSize, ref + kEntriesPerPark );
+        UnpackPark7( k, p7TgtBytes + parkSize, tgt + kEntriesPerPark );
+    }
+
+    const int64 entriesEnd = hasNextPark ? kEntriesPerPark * 2 : kEntriesPerPark;
+
+    for( int64 i = 0; i < kEntriesPerPark; i++ )
+    {
+        if( ref[i] == tgt[i] )
+            continue;
+
+        // Potential out-of-order entries
+        // Try sorting and matching entry pairs until we run out of entries
+        int64 j = i + 1;
+
+        bool matched = false;
+        for( ; j < entriesEnd; j++ )
+        {
+            const size_t matchCount = (size_t)( j - i ) + 1;
+
+            bbmemcpy_t( refMatch, ref+i, matchCount );
+            bbmemcpy_t( tgtMatch, tgt+i, matchCount );
+            
+            std::sort( refMatch, refMatch+matchCount );
+            std::sort( tgtMatch, tgtMatch+matchCount );
+
+            if( memcmp( refMatch, tgtMatch, matchCount * sizeof( uint64 ) ) == 0 )
+            {
+                matched = true;
+                break;
+            }
+        }
+
+        if( !matched )
+            return false;
+    
+        i = j;
+    }
+
+    return true;
+}
+
+/// Number of parks of a table that both plots have
+//-----------------------------------------------------------
+uint64 GetComparableParkCount( FilePlot& ref, FilePlot& tgt, const PlotTable table, const size_t parkSize )
+{
+    const uint64 refParks = PlotParkLayout::Create( parkSize, ref.HasAlignedParks() ).ParkCount( ref.TableSize( table ) );
+    const uint64 tgtParks = PlotParkLayout::Create( parkSize, tgt.HasAlignedParks() ).ParkCount( tgt.TableSize( table ) );
+
+    return std::min( refParks, tgtParks );
+}
+
+/// Compares the parks of a table on all threads, each reading its own contiguous park range
+/// in chunks of CMP_CHUNK_SIZE, so the tables are never loaded whole.
+/// The chunks are read ahead of the comparison through a PrefetchStream.
+/// lookAheadParks are read after each chunk for comparisons that span parks.
+/// Parks are located through each plot's PlotParkLayout, so plots with aligned parks can be compared
+/// with each other and with packed ones. The padding between park groups is dropped as the parks are read.
+/// compare is called as compare( refPark, tgtPark, hasNextPark ) and returns false on a mismatch.
+//-----------------------------------------------------------
+template<typename TCompare>
+TableCompareResult CompareTableParks( FilePlot& ref, FilePlot& tgt, const PlotTable table, const size_t parkSize,
+                                      const uint64 parkCount, const uint64 lookAheadParks, const PlotCompareOptions& opts,
+                                      TCompare compare )
+{
+    TableCompareResult result;
+    result.parkCount = parkCount;
+    result.parkSize  = parkSize;
+
+    if( parkCount == 0 )
+        return result;
+
+    const uint32 threadCount = (uint32)std::min( (uint64)opts.threadCount, parkCount );
+    const uint64 chunkParks  = std::max( (uint64)1, (uint64)( CMP_CHUNK_SIZE / parkSize ) );
+    const size_t bufferSize  = (size_t)( chunkParks + lookAheadParks ) * parkSize;
+
+    const uint64 refAddress = ref.TableAddress( table );
+    const uint64 tgtAddress = tgt.TableAddress( table );
+
+    const PlotParkLayout refLayout = PlotParkLayout::Create( parkSize, ref.HasAlignedParks() );
+    const PlotParkLayout tgtLayout = PlotParkLayout::Create( parkSize, tgt.HasAlignedParks() );
+
+    // Parks of aligned plots are read with their padding into a separate buffer first
+    const bool   hasPadding    = refLayout.GroupPadding() > 0 || tgtLayout.GroupPadding() > 0;
+    const size_t rawBufferSize = (size_t)( ( chunkParks + lookAheadParks ) * std::max( refLayout.MaxBytesPerPark(), tgtLayout.MaxBytesPerPark() ) +
+                                           std::max( refLayout.GroupPadding(), tgtLayout.GroupPadding() ) );
+
+    std::atomic<uint64> failCount = 0;
+    std::atomic<uint64> firstFail = std::numeric_limits<uint64>::max();
+
+    // Each thread reads from its own file handles
+    std::vector<FilePlot> refPlots;
+    std::vector<FilePlot> tgtPlots;
+    std::vector<byte*>    refBufs( threadCount );
+    std::vector<byte*>    tgtBufs( threadCount );
+    std::vector<byte*>    rawBufs( threadCount, nullptr );
+    refPlots.reserve( threadCount );
+    tgtPlots.reserve( threadCount );
+
+    for( uint32 i = 0; i < threadCount; i++ )
+    {
+        refPlots.emplace_back( ref );
+        tgtPlots.emplace_back( tgt );
+        refBufs[i] = bbvirtalloc<byte>( bufferSize );
+        tgtBufs[i] = bbvirtalloc<byte>( bufferSize );
+
+        if( hasPadding )
+            rawBufs[i] = bbvirtalloc<byte>( rawBufferSize );
+
+        FatalIf( !refPlots[i].IsOpen() || !tgtPlots[i].IsOpen(), "Failed to open plot files." );
+    }
+
+    AnonMTJob::Run( *opts.pool, threadCount, [&]( AnonMTJob* self ) {
+
+        uint64 parkOffset, parkEnd, threadParks;
+        GetThreadOffsets( self, parkCount, threadParks, parkOffset, parkEnd );
+
+        const uint32 id     = self->JobId();
+        byte*        refBuf = refBufs[id];
+        byte*        tgtBuf = tgtBufs[id];
+        byte*        rawBuf = rawBufs[id];
+
+        // The look-ahead parks of the last chunk are read too
+        const uint64 regionEnd = std::min( parkEnd + lookAheadParks, parkCount );
+
+        // Table offset up to which each stream has been read
+        uint64 refReadOffset = refLayout.ParkOffset( parkOffset );
+        uint64 tgtReadOffset = tgtLayout.ParkOffset( parkOffset );
+
+        PrefetchStream refStream( refPlots[id].Stream(), CMP_READ_AHEAD, CMP_CHUNK_SIZE );
+        PrefetchStream tgtStream( tgtPlots[id].Stream(), CMP_READ_AHEAD, CMP_CHUNK_SIZE );
+        refStream.Start( refAddress + refReadOffset, refLayout.ParkOffset( regionEnd - 1 ) + parkSize - refReadOffset );
+        tgtStream.Start( tgtAddress + tgtReadOffset, tgtLayout.ParkOffset( regionEnd - 1 ) + parkSize - tgtReadOffset );
+
+        // Reads parks [first, end) one after the other into dst
+        auto readParkRange = [&]( PrefetchStream& stream, const PlotParkLayout& layout, uint64& readOffset,
+                              byte* dst, const uint64 first, const uint64 end ) {
+
+            const uint64 readEnd  = layout.ParkOffset( end - 1 ) + parkSize;
+            const size_t readSize = (size_t)( readEnd - readOffset );
+
+            if( layout.GroupPadding() == 0 )
+            {
+                readOffset = readEnd;
+                return (ssize_t)readSize == stream.Read( dst, readSize );
+            }
+
+            ASSERT( readSize <= rawBufferSize );
+            if( (ssize_t)readSize != stream.Read( rawBuf, readSize ) )
+                return false;
+
+            for( uint64 p = first; p < end; p++ )
+                memcpy( dst + ( p - first ) * parkSize, rawBuf + ( layout.ParkOffset( p ) - readOffset ), parkSize );
+
+            readOffset = readEnd;
+            return true;
+        };
+
+        uint64 bufferedParks = 0;   // Parks at the start of the buffers, read as look-ahead of the previous chunk
+
+        for( uint64 offset = parkOffset; offset < parkEnd; offset += chunkParks )
+        {
+            // Parks past a known difference don't need to be compared
+            if( opts.firstDiff && offset >= firstFail.load( std::memory_order_relaxed ) )
+                break;
+
+            const uint64 count     = std::min( chunkParks, parkEnd - offset );
+            const uint64 readParks = std::min( count + lookAheadParks, parkCount - offset );
+            const size_t readStart = (size_t)bufferedParks * parkSize;
+
+            if( bufferedParks < readParks )
+            {
+                FatalIf( !readParkRange( refStream, refLayout, refReadOffset, refBuf + readStart, offset + bufferedParks, offset + readParks ),
+                         "Failed to read parks %llu..%llu of reference table %u.", (llu)offset, (llu)( offset + count ), (uint32)table+1 );
+                FatalIf( !readParkRange( tgtStream, tgtLayout, tgtReadOffset, tgtBuf + readStart, offset + bufferedParks, offset + readParks ),
+                         "Failed to read parks %llu..%llu of target table %u.", (llu)offset, (llu)( offset + count ), (uint32)table+1 );
+            }
+
+            for( uint64 i = 0; i < count; i++ )
+            {
+                const uint64 park = offset + i;
+
+                if( opts.firstDiff && park >= firstFail.load( std::memory_order_relaxed ) )
+                    break;
+
+                if( compare( refBuf + i * parkSize, tgtBuf + i * parkSize, i + 1 < readParks ) )
+                    continue;
+
+                failCount++;
+
+                uint64 first = firstFail.load( std::memory_order_relaxed );
+                while( park < first && !firstFail.compare_exchange_weak( first, park, std::memory_order_relaxed ) );
+
+                if( !opts.firstDiff )
+                {
+                    std::lock_guard<std::mutex> lock( _cmpLogLock );
+                    Log::Line( " Table %u park %llu failed.", (uint32)table+1, (llu)park );
+                }
+            }
+
+            // The look-ahead parks start the next chunk
+            bufferedParks = readParks - count;
+            if( bufferedParks )
+            {
+                memmove( refBuf, refBuf + count * parkSize, (size_t)bufferedParks * parkSize );
+                memmove( tgtBuf, tgtBuf + count * parkSize, (size_t)bufferedParks * parkSize );
+            }
+        }
+    });
+
+    for( uint32 i = 0; i < threadCount; i++ )
+    {
+        bbvirtfree( refBufs[i] );
+        bbvirtfree( tgtBufs[i] );
+
+        if( rawBufs[i] )
+            bbvirtfree( rawBufs[i] );
+    }
+
+    result.failCount = failCount;
+    result.firstFail = firstFail;
+    return result;
+}
+
 //-----------------------------------------------------------
-void TestC3Table( FilePlot& ref, FilePlot& tgt )
+TableCompareResult TestC3Table( FilePlot& ref, FilePlot& tgt, const PlotCompareOptions& opts )
 {
     Log::Line( "Reading C tables..." );
 
@@ -229,159 +544,39 @@ void TestC3Table( FilePlot& ref, FilePlot& tgt )
     Log::Line( "F7 Count: ~%llu", f7Count );
 
     Log::Line( "Validating C3 table..." );
-    {
-        const size_t refC3Size = ref.TableSize( PlotTable::C3 );
-        const size_t tgtC3Size = tgt.TableSize( PlotTable::C3 );
-
-        byte* refC3 = bbvirtalloc<byte>( refC3Size );
-        byte* tgtC3 = bbvirtalloc<byte>( tgtC3Size );
-
-        FatalIf( !ref.SeekToTable( PlotTable::C3 ), "Failed to seek ref plot to C3 table." );
-        FatalIf( !tgt.SeekToTable( PlotTable::C3 ), "Failed to seek tgt plot to C3 table." );
-
-        FatalIf( (ssize_t)refC3Size != ref.Read( refC3Size, refC3 ), "Failed to read ref C3 table." );
-        FatalIf( (ssize_t)tgtC3Size != tgt.Read( tgtC3Size, tgtC3 ), "Failed to read tgt C3 table." );
-
-        // const size_t c3Size = std::min( refC3Size, tgtC3Size );
 
-        const int64  parkCount  = (int64)(c1Length - 1);
-        const size_t c3ParkSize = CalculateC3Size();
+    const int64        parkCount = (int64)std::min( (uint64)std::max( (int64)c1Length - 1, (int64)0 ),
+                                                    GetComparableParkCount( ref, tgt, PlotTable::C3, CalculateC3Size() ) );
+    TableCompareResult result    = CompareTableParks( ref, tgt, PlotTable::C3, CalculateC3Size(), (uint64)parkCount, 0, opts,
+        []( const byte* refPark, const byte* tgtPark, bool ) {
 
-        const byte* refC3Reader = refC3;
-        const byte* tgtC3Reader = tgtC3;
+            const uint16 refSize = Swap16( *(uint16*)refPark );
+            const uint16 tgtSize = Swap16( *(uint16*)tgtPark );
 
-        std::vector<int64> failures;
+            return refSize == tgtSize && MemCmp( refPark, tgtPark, tgtSize );
+        });
 
-        for( int64 i = 0; i < parkCount; i++ )
-        {
-            const uint16 refSize = Swap16( *(uint16*)refC3Reader );
-            const uint16 tgtSize = Swap16( *(uint16*)tgtC3Reader );
-
-            if( refSize != tgtSize || !MemCmp( refC3Reader, tgtC3Reader, tgtSize ) )
-            {
-                Log::Line( " C3 park %lld failed.", i );
-                failures.push_back( i );
-            }
-            // FatalIf( !MemCmp( refC3Reader, tgtC3Reader, c3ParkSize ), 
-            //     "C3 park mismatch @ park %lld / %lld", i, parkCount );
-
-            refC3Reader += c3ParkSize;
-            tgtC3Reader += c3ParkSize;
-        }
-
-        if( failures.size() < 1 )
-            Log::Line( "Success!" );
-        else
-            Log::Line( "%llu / %lld C3 parks failed!", failures.size(), parkCount );
-        
-        SysHost::VirtualFree( refC3 );
-        SysHost::VirtualFree( tgtC3 );
-    }
+    if( result.failCount < 1 )
+        Log::Line( "Success!" );
+    else
+        Log::Line( "%llu / %lld C3 parks failed!", (llu)result.failCount, parkCount );
 
     SysHost::VirtualFree( refC2.values );
     SysHost::VirtualFree( tgtC2.values );
     SysHost::VirtualFree( refC1.values );
     SysHost::VirtualFree( tgtC1.values );
-}
-
-//-----------------------------------------------------------
-uint64 CompareP7( FilePlot& ref, FilePlot& tgt, const byte* p7RefBytes, const byte* p7TgtBytes, const int64 parkCount )
-{
-    // Double-buffer parks at a time so that we can compare entries across parks
-    uint64 refParks[2][kEntriesPerPark];
-    uint64 tgtParks[2][kEntriesPerPark];
-
-    uint64 refMatch[kEntriesPerPark];
-    uint64 tgtMatch[kEntriesPerPark];
-
-    // Unpack first park
-    ASSERT( parkCount );
 
-    const size_t parkSize = CalculatePark7Size( ref.K() );
-
-    UnpackPark7( ref.K(), p7RefBytes, refParks[0] );
-    UnpackPark7( tgt.K(), p7TgtBytes, tgtParks[0] );
-    p7RefBytes += parkSize;
-    p7TgtBytes += parkSize;
-
-    uint64 parkFailCount = 0;
-
-    for( int64 p = 0; p < parkCount; p++ )
-    {
-        const bool isLastPark = p + 1 == parkCount;
-
-        // Load the next park, if we can
-        if( !isLastPark )
-        {
-            UnpackPark7( ref.K(), p7RefBytes, refParks[1] );
-            UnpackPark7( tgt.K(), p7TgtBytes, tgtParks[1] );
-            p7RefBytes += parkSize;
-            p7TgtBytes += parkSize;
-        }
-
-        const uint64* ref = refParks[0];
-        const uint64* tgt = tgtParks[0];
-
-        const int64 entriesEnd = isLastPark ? kEntriesPerPark : kEntriesPerPark * 2;
-
-        for( int64 i = 0; i < kEntriesPerPark; i++ )
-        {
-            if( ref[i] == tgt[i] )
-                continue;
-
-            // Potential out-of-order entries
-            // Try sorting and matching entry pairs until we run out of entries
-            int64 j = i + 1;
-
-            bool matched = false;
-            for( ; j < entriesEnd; j++ )
-            {
-                const size_t matchCount = (size_t)( j - i ) + 1;
-
-                bbmemcpy_t( refMatch, ref+i, matchCount );
-                bbmemcpy_t( tgtMatch, tgt+i, matchCount );
-                
-                std::sort( refMatch, refMatch+matchCount );
-                std::sort( tgtMatch, tgtMatch+matchCount );
-
-                if( memcmp( refMatch, tgtMatch, matchCount * sizeof( uint64 ) ) == 0 )
-                {
-                    matched = true;
-                    break;
-                }
-                else
-                    continue;
-            }
-
-            if( !matched )
-            {
-                Log::Line( "T7 park %lld failed. First entry failed at index %lld", p, i );
-                parkFailCount++;
-            }
-        
-            i = j;
-        }
-
-        // Set next park as current park
-        memcpy( refParks[0], refParks[1], sizeof( uint64 ) * kEntriesPerPark );
-        memcpy( tgtParks[0], tgtParks[1], sizeof( uint64 ) * kEntriesPerPark );
-    }
-    
-    return parkFailCount;
+    return result;
 }
 
 //-----------------------------------------------------------
-void TestTable( FilePlot& ref, FilePlot& tgt, TableId table )
+TableCompareResult TestTable( FilePlot& ref, FilePlot& tgt, TableId table, const PlotCompareOptions& opts )
 {
     if( table == TableId::Table1 && tgt.CompressionLevel() > 0 )
-        return;
+        return {};
 
     if( table == TableId::Table2 && tgt.CompressionLevel() >= 9 )
-        return;
-
-    // if( table == TableId::Table7 ) return;
-
-    Log::Line( "Reading Table %u...", table+1 );
+        return {};
 
     const uint32 numTablesDropped = tgt.CompressionLevel() >= 9 ? 2 :
                                     tgt.CompressionLevel() >= 1 ? 1 : 0;
@@ -391,29 +586,8 @@ void TestTable( FilePlot& ref, FilePlot& tgt, TableId table )
                                     GetCompressionInfoForLevel( tgt.CompressionLevel() ).tableParkSize : CalculateParkSize( table ) :
                                 CalculatePark7Size( ref.K() );
 
-    const size_t sizeRef = ref.TableSize( (PlotTable)table );
-    const size_t sizeTgt = tgt.TableSize( (PlotTable)table );
+    const uint64 parkCount = GetComparableParkCount( ref, tgt, (PlotTable)table, parkSize );
 
-    byte* tableParksRef = bbvirtalloc<byte>( sizeRef );
-    byte* tableParksTgt = bbvirtalloc<byte>( sizeTgt );
-
-    const size_t tableSize = std::min( sizeRef, sizeTgt );
-    const int64  parkCount = (int64)( tableSize / parkSize );
-
-    FatalIf( !ref.SeekToTable( (PlotTable)table ), "Failed to seek to table %u on reference plot.", (uint32)table+1 );
-    FatalIf( !tgt.SeekToTable( (PlotTable)table ), "Failed to seek to table %u on target plot.", (uint32)table+1 );
-
-    {
-        const ssize_t refRead = ref.Read( tableSize, tableParksRef );
-        FatalIf( (ssize_t)tableSize != refRead, "Failed to read reference table %u.", (uint32)table+1 );
-        
-        const ssize_t tgtRead = tgt.Read( tableSize, tableParksTgt );
-        FatalIf( (ssize_t)tableSize != tgtRead, "Failed to read target table %u.", (uint32)table+1 );
-
-    }
-
-    const byte* parkRef = tableParksRef;
-    const byte* parkTgt = tableParksTgt;
     Log::Line( "Validating Table %u...", table+1 );
 
     uint64 stubBitSize = (ref.K() - kStubMinusBits);
@@ -425,8 +599,8 @@ void TestTable( FilePlot& ref, FilePlot& tgt, TableId table )
 
     const size_t stubSectionBytes = CDiv( (kEntriesPerPark - 1) * stubBitSize, 8 );
 
+    TableCompareResult result;
 
-    uint64 failureCount = 0;
     if( table == TableId::Table7 )
     {
         // Because entries can be found in different orders in P7,
@@ -435,69 +609,36 @@ void TestTable( FilePlot& ref, FilePlot& tgt, TableId table )
         //  and if there's multiple entries with the same value
         //  there's no guarantee an implementation will sort it
         //  into the same index as another )
-        failureCount = CompareP7( ref, tgt, tableParksRef, tableParksTgt, parkCount );
+        const uint32 k = ref.K();
+
+        result = CompareTableParks( ref, tgt, (PlotTable)table, parkSize, parkCount, 1, opts,
+            [=]( const byte* refPark, const byte* tgtPark, const bool hasNextPark ) {
+                return CompareP7Park( k, refPark, tgtPark, hasNextPark );
+            });
     }
     else
     {
-        for( int64 i = 0; i < parkCount; i++ )
-        {
-            // Ignore buffer zone
-            const uint16 pRefCSize = *(uint16*)(parkRef + stubSectionBytes + sizeof( uint64 ) );
-            const uint16 pTgtCSize = *(uint16*)(parkTgt + stubSectionBytes + sizeof( uint64 ) );
+        result = CompareTableParks( ref, tgt, (PlotTable)table, parkSize, parkCount, 0, opts,
+            [=]( const byte* parkRef, const byte* parkTgt, bool ) {
 
-            bool failed = pRefCSize != pTgtCSize;
+                // Ignore buffer zone
+                const uint16 pRefCSize = *(uint16*)(parkRef + stubSectionBytes + sizeof( uint64 ) );
+                const uint16 pTgtCSize = *(uint16*)(parkTgt + stubSectionBytes + sizeof( uint64 ) );
 
-            if( !failed )
-            {
-                const size_t realParkSize = sizeof( uint64 ) + stubSectionBytes + pRefCSize;
-                failed = !MemCmp( parkRef, parkTgt, realParkSize );
-            }
-            // if( pRefCSize != pTgtCSize || !MemCmp( parkRef, parkTgt, parkSize ) )
+                if( pRefCSize != pTgtCSize )
+                    return false;
 
-            {
-                // bool failed     = true;
-
-                if( failed )
-                {
-                    // bool stubsEqual = MemCmp( parkRef, parkTgt, stubSectionBytes + sizeof( uint64 ) );
-                    Log::Line( " T%u park %lld failed.", table+1, i );
-                    failureCount++;
-                }
-
-                // {
-                //     const byte* refBytes = parkRef;
-                //     const byte* tgtBytes = parkTgt;
-
-                //     // if( table != TableId::Table7 )
-                //     // {
-                //     //     refBytes += 8;
-                //     // }
-
-                //     for( uint64 b = 0; b < parkSize; b++ )
-                //     {
-                //         if( refBytes[b] != tgtBytes[b] )
-                //         {
-                //             Log::Line( "Byte mismatch @ byte %llu: 0x%02x (%3d) != 0x%02x (%3d)", b,
-                //              (int)refBytes[b], (int)refBytes[b], (int)tgtBytes[b], (int)tgtBytes[b] );
-                //             break;
-                //         }
-                //     }
-                // }
-            }
-
-            parkRef += parkSize;
-            parkTgt += parkSize;
-        }
+                const size_t realParkSize = sizeof( uint64 ) + stubSectionBytes + pRefCSize;
+                return MemCmp( parkRef, parkTgt, realParkSize );
+            });
     }
 
-
-    if( failureCount < 1 )
+    if( result.failCount < 1 )
         Log::Line( "Success!" );
     else
-        Log::Line( "%llu / %lld Table %u parks failed.", failureCount, parkCount, table+1 );
+        Log::Line( "%llu / %llu Table %u parks failed.", (llu)result.failCount, (llu)parkCount, table+1 );
 
-    SysHost::VirtualFree( tableParksRef );
-    SysHost::VirtualFree( tableParksTgt );
+    return result;
 }
 
 // Unpack a single park 7,
@@ -509,9 +650,7 @@ void UnpackPark7( const uint32 k, const byte* srcBits, uint64* dstEntries )
 
     const uint32 bitsPerEntry = k + 1;
     CPBitReader reader( srcBits, CalculatePark7Size( k ) * 8, 0  );
-
-    for( int32 i = 0; i < kEntriesPerPark; i++ )
-        dstEntries[i] = reader.Read64Aligned( bitsPerEntry );
+    reader.ReadN( bitsPerEntry, kEntriesPerPark, dstEntries );
 }
 
 //-----------------------------------------------------------
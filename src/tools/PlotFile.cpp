@@ -139,6 +139,19 @@ bool IPlotFile::ReadHeader( int& error )
                 return false;
             }
         }
+
+        // Tuned delta R values
+        if( IsFlagSet( _header.flags, PlotFlags::TunedDeltas ) )
+        {
+            if( Read( sizeof( _header.deltaRValues ), _header.deltaRValues ) != sizeof( _header.deltaRValues ) )
+            {
+                error = GetError();
+                return false;
+            }
+
+            for( int i = 0; i < 6; i++ )
+                _header.deltaRValues[i] = Swap16( _header.deltaRValues[i] );
+        }
     }
 
     // Table pointers
@@ -165,4 +178,16 @@ bool IPlotFile::ReadHeader( int& error )
     return true;
 }
 
+//-----------------------------------------------------------
+bool IPlotFile::ReadBatch( const PlotReadRequest* requests, const uint32 count )
+{
+    for( uint32 i = 0; i < count; i++ )
+    {
+        const PlotReadRequest& r = requests[i];
+
+        if( !Seek( SeekOrigin::Begin, (int64)r.offset ) || Read( r.size, r.buffer ) != (ssize_t)r.size )
+            return false;
+    }
 
+    return true;
+}
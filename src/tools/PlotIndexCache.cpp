@@ -0,0 +1,352 @@
+#include "PlotIndexCache.h"
+#include "PlotReader.h"
+#include "util/BitView.h"
+#include "util/Log.h"
+#include <unordered_map>
+#include <bit>
+
+#if defined( __x86_64__ ) || defined( _M_X64 )
+    #define INDEX_SEARCH_SSE2 1
+    #include <emmintrin.h>
+#elif defined( __aarch64__ ) || defined( _M_ARM64 )
+    #define INDEX_SEARCH_NEON 1
+    #include <arm_neon.h>
+#endif
+
+///
+/// Plot Index
+///
+//-----------------------------------------------------------
+PlotIndex::~PlotIndex()
+{
+    bbvirtfreebounded( _c1 );
+    bbvirtfreebounded( _hotParkBuffer );
+}
+
+//-----------------------------------------------------------
+size_t PlotIndex::MemorySize() const
+{
+    return ( _c1Count + SEARCH_BLOCK ) * sizeof( uint32 ) +
+           _hotParks.size() * ( kCheckpoint1Interval * sizeof( uint64 ) + sizeof( HotC3Park ) );
+}
+
+/// Counts how many of SEARCH_BLOCK entries are < f7
+//-----------------------------------------------------------
+inline static uint32 CountLessThan( const uint32* entries, const uint32 f7 )
+{
+    static_assert( PlotIndex::SEARCH_BLOCK == 16 );
+
+#if INDEX_SEARCH_SSE2
+    // SSE2 only has signed compares, so flip the sign bit on both sides
+    const __m128i bias = _mm_set1_epi32( (int)0x80000000 );
+    const __m128i key  = _mm_xor_si128( _mm_set1_epi32( (int)f7 ), bias );
+
+    uint32 count = 0;
+    for( uint32 i = 0; i < 16; i += 4 )
+    {
+        const __m128i v  = _mm_xor_si128( _mm_loadu_si128( (const __m128i*)( entries + i ) ), bias );
+        const int     lt = _mm_movemask_ps( _mm_castsi128_ps( _mm_cmplt_epi32( v, key ) ) );
+
+        count += (uint32)std::popcount( (uint32)lt );
+    }
+    return count;
+#elif INDEX_SEARCH_NEON
+    const uint32x4_t key = vdupq_n_u32( f7 );
+
+    // Each lane that is less than the key is all 1s, so subtracting them counts them
+    uint32x4_t counts = vdupq_n_u32( 0 );
+    for( uint32 i = 0; i < 16; i += 4 )
+        counts = vsubq_u32( counts, vcltq_u32( vld1q_u32( entries + i ), key ) );
+
+    return vaddvq_u32( counts );
+#else
+    uint32 count = 0;
+    for( uint32 i = 0; i < 16; i++ )
+        count += entries[i] < f7 ? 1 : 0;
+    return count;
+#endif
+}
+
+//-----------------------------------------------------------
+uint64 PlotIndex::LowerBound( const uint32 f7 ) const
+{
+    // Branchless binary search, down to a block that is compared all at once.
+    // Everything before base is < f7, and everything at or after base + length is >= f7.
+    const uint32* base   = _c1;
+          uint64  length = _c1Count;
+
+    while( length > SEARCH_BLOCK )
+    {
+        const uint64 half = length / 2;
+        const bool   less = base[half] < f7;
+
+        base   = less ? base + half : base;
+        length = less ? length - half : half;
+    }
+
+    // Entries past the end of the block are either >= f7, or the sentinels, so they're not counted
+    return (uint64)( base - _c1 ) + CountLessThan( base, f7 );
+}
+
+//-----------------------------------------------------------
+uint64 PlotIndex::FindC3Park( const uint64 f7, uint32& outParkCount ) const
+{
+    outParkCount = 1;
+
+    ASSERT( _c1Count > 0 );
+
+    // f7s are at most k bits, the index only holds k <= 32
+    const uint64 lb = LowerBound( (uint32)std::min( f7, (uint64)0xFFFFFFFF ) );
+
+    if( lb == 0 )
+        return 0;
+
+    if( lb < _c1Count && _c1[lb] == f7 )
+        outParkCount = 2;
+
+    return lb - 1;
+}
+
+//-----------------------------------------------------------
+int64 PlotIndex::GetHotC3Park( const uint64 parkIndex, uint64* f7Buffer )
+{
+    if( _hotParks.empty() )
+        return -1;
+
+    std::lock_guard<std::mutex> lock( _hotLock );
+
+    for( size_t i = 0; i < _hotParks.size(); i++ )
+    {
+        auto& park = _hotParks[i];
+
+        if( park.count && park.parkIndex == parkIndex )
+        {
+            park.lastUse = ++_hotTick;
+            memcpy( f7Buffer, _hotParkBuffer + i * kCheckpoint1Interval, park.count * sizeof( uint64 ) );
+            return (int64)park.count;
+        }
+    }
+
+    return -1;
+}
+
+//-----------------------------------------------------------
+void PlotIndex::PutHotC3Park( const uint64 parkIndex, const uint64* f7s, const uint64 count )
+{
+    if( _hotParks.empty() || count == 0 || count > kCheckpoint1Interval )
+        return;
+
+    std::lock_guard<std::mutex> lock( _hotLock );
+
+    // Evict the least recently used park
+    size_t slot = 0;
+    for( size_t i = 0; i < _hotParks.size(); i++ )
+    {
+        if( _hotParks[i].count && _hotParks[i].parkIndex == parkIndex )
+            return;
+
+        if( _hotParks[i].lastUse < _hotParks[slot].lastUse )
+            slot = i;
+    }
+
+    auto& park = _hotParks[slot];
+    park.parkIndex = parkIndex;
+    park.count     = count;
+    park.lastUse   = ++_hotTick;
+
+    memcpy( _hotParkBuffer + slot * kCheckpoint1Interval, f7s, count * sizeof( uint64 ) );
+}
+
+
+///
+/// Plot Index Cache
+///
+namespace {
+
+    struct PlotIdHash
+    {
+        inline size_t operator()( const std::string& id ) const
+        {
+            // Plot ids are hashes already
+            size_t h = 0;
+            memcpy( &h, id.data(), std::min( sizeof( h ), id.size() ) );
+            return h;
+        }
+    };
+
+    struct CacheEntry
+    {
+        std::shared_ptr<PlotIndex> index;
+        uint64                     lastUse = 0;
+    };
+
+    std::mutex                                              _cacheLock;
+    std::unordered_map<std::string, CacheEntry, PlotIdHash> _cache;
+    size_t                                                  _cacheMaxBytes  = 0;
+    size_t                                                  _cacheUsedBytes = 0;
+    uint32                                                  _cacheHotParks  = 0;
+    uint64                                                  _cacheTick      = 0;
+
+    //-----------------------------------------------------------
+    void EvictToFit( const size_t maxBytes )
+    {
+        // Indices still in use by a reader stay alive until it releases them
+        while( _cacheUsedBytes > maxBytes && !_cache.empty() )
+        {
+            auto oldest = _cache.begin();
+            for( auto it = _cache.begin(); it != _cache.end(); ++it )
+            {
+                if( it->second.lastUse < oldest->second.lastUse )
+                    oldest = it;
+            }
+
+            _cacheUsedBytes -= oldest->second.index->MemorySize();
+            _cache.erase( oldest );
+        }
+    }
+}
+
+//-----------------------------------------------------------
+void PlotIndexCache::Configure( const size_t maxBytes, const uint32 hotC3Parks )
+{
+    std::lock_guard<std::mutex> lock( _cacheLock );
+
+    _cacheMaxBytes = maxBytes;
+    _cacheHotParks = hotC3Parks;
+
+    EvictToFit( maxBytes );
+}
+
+//-----------------------------------------------------------
+bool PlotIndexCache::IsEnabled()
+{
+    std::lock_guard<std::mutex> lock( _cacheLock );
+    return _cacheMaxBytes > 0;
+}
+
+//-----------------------------------------------------------
+void PlotIndexCache::Clear()
+{
+    std::lock_guard<std::mutex> lock( _cacheLock );
+    EvictToFit( 0 );
+}
+
+//-----------------------------------------------------------
+std::shared_ptr<PlotIndex> PlotIndexCache::Get( IPlotFile& plot )
+{
+    if( plot.K() > 32 )
+        return nullptr;
+
+    const std::string id( (const char*)plot.PlotId(), BB_PLOT_ID_LEN );
+    uint32 hotC3Parks;
+
+    {
+        std::lock_guard<std::mutex> lock( _cacheLock );
+
+        if( _cacheMaxBytes == 0 )
+            return nullptr;
+
+        auto it = _cache.find( id );
+        if( it != _cache.end() )
+        {
+            it->second.lastUse = ++_cacheTick;
+            return it->second.index;
+        }
+
+        hotC3Parks = _cacheHotParks;
+    }
+
+    // Load without holding the lock, so that lookups on other plots are not blocked on the disk.
+    // If another reader loads the same plot concurrently, the first one to finish is kept.
+    auto index = Load( plot, hotC3Parks );
+    if( !index )
+        return nullptr;
+
+    std::lock_guard<std::mutex> lock( _cacheLock );
+
+    auto it = _cache.find( id );
+    if( it != _cache.end() )
+    {
+        it->second.lastUse = ++_cacheTick;
+        return it->second.index;
+    }
+
+    const size_t indexSize = index->MemorySize();
+    if( indexSize > _cacheMaxBytes )
+        return nullptr;
+
+    EvictToFit( _cacheMaxBytes - indexSize );
+
+    _cache[id] = CacheEntry{ index, ++_cacheTick };
+    _cacheUsedBytes += indexSize;
+
+    return index;
+}
+
+//-----------------------------------------------------------
+std::shared_ptr<PlotIndex> PlotIndexCache::Load( IPlotFile& plot, const uint32 hotC3Parks )
+{
+    const uint32 k           = plot.K();
+    const size_t f7SizeBytes = CDiv( k, 8 );
+    const size_t c1Size      = plot.TableSize( PlotTable::C1 );
+    const uint64 c1MaxCount  = c1Size / f7SizeBytes;
+
+    if( c1MaxCount < 1 )
+        return nullptr;
+
+    // Read C1 as a whole, unless the plot is already in memory
+    const byte* c1Bytes  = nullptr;
+    byte*       c1Buffer = nullptr;
+
+    if( plot.MappedData() )
+        c1Bytes = plot.MappedData() + plot.TableAddress( PlotTable::C1 );
+    else
+    {
+        c1Buffer = bbvirtallocbounded<byte>( c1Size );
+
+        if( !plot.Seek( SeekOrigin::Begin, (int64)plot.TableAddress( PlotTable::C1 ) ) ||
+             plot.Read( c1Size, c1Buffer ) != (ssize_t)c1Size )
+        {
+            bbvirtfreebounded( c1Buffer );
+            return nullptr;
+        }
+
+        c1Bytes = c1Buffer;
+    }
+
+    auto index = std::make_shared<PlotIndex>();
+    index->_c1 = bbcvirtallocbounded<uint32>( c1MaxCount + PlotIndex::SEARCH_BLOCK );
+
+    CPBitReader reader( c1Bytes, c1Size * 8 );
+
+    // Stop at the first out-of-order entry, which is the trailing empty one for a well-formed plot
+    uint64 prevF7 = 0;
+    uint64 count  = 0;
+    for( ; count < c1MaxCount; count++ )
+    {
+        const uint64 f7 = reader.Read64( (uint32)f7SizeBytes * 8 );
+        if( f7 < prevF7 )
+            break;
+
+        index->_c1[count] = (uint32)f7;
+        prevF7 = f7;
+    }
+
+    bbvirtfreebounded( c1Buffer );
+
+    if( count < 1 )
+        return nullptr;
+
+    index->_c1Count = count;
+
+    for( uint32 i = 0; i < PlotIndex::SEARCH_BLOCK; i++ )
+        index->_c1[count + i] = 0xFFFFFFFF;
+
+    if( hotC3Parks > 0 )
+    {
+        index->_hotParks.resize( hotC3Parks );
+        index->_hotParkBuffer = bbcvirtallocbounded<uint64>( (size_t)hotC3Parks * kCheckpoint1Interval );
+    }
+
+    return index;
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include "ChiaConsts.h"
+#include "util/Util.h"
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class IPlotFile;
+
+///
+/// Decoded C1 checkpoints of a single plot.
+/// With all of C1 in memory, a lookup can go straight to the C3 park,
+/// so neither C2 nor C1 have to be read from the plot anymore.
+///
+class PlotIndex
+{
+    friend class PlotIndexCache;
+
+public:
+    static constexpr uint32 SEARCH_BLOCK = 16;  // Entries compared at once at the end of a search
+
+    ~PlotIndex();
+
+    // Returns the index of the C3 park that may hold the given f7.
+    // If the next park's C1 entry is the f7 itself, duplicates of it may be
+    // at the end of the returned park and the start of next one, in which case
+    // outParkCount is 2.
+    uint64 FindC3Park( uint64 f7, uint32& outParkCount ) const;
+
+    inline uint64 C1Count() const { return _c1Count; }
+
+    size_t MemorySize() const;
+
+    // Copies a cached, decoded C3 park into f7Buffer.
+    // Returns the entry count, or -1 if the park isn't cached.
+    int64 GetHotC3Park( uint64 parkIndex, uint64* f7Buffer );
+    void  PutHotC3Park( uint64 parkIndex, const uint64* f7s, uint64 count );
+
+    inline bool HasHotC3Parks() const { return !_hotParks.empty(); }
+
+private:
+    // Index of the first C1 entry >= f7
+    uint64 LowerBound( uint32 f7 ) const;
+
+private:
+    struct HotC3Park
+    {
+        uint64 parkIndex = 0;
+        uint64 lastUse   = 0;
+        uint64 count     = 0;       // 0 if empty
+    };
+
+    uint32*                _c1      = nullptr;  // Page-aligned, followed by a block of UINT32_MAX sentinels
+    uint64                 _c1Count = 0;
+
+    std::mutex             _hotLock;
+    std::vector<HotC3Park> _hotParks;
+    uint64*                _hotParkBuffer = nullptr;    // kCheckpoint1Interval entries per hot park
+    uint64                 _hotTick       = 0;
+};
+
+///
+/// Process-wide cache of plot indices, keyed by plot id and shared by all readers.
+/// It's disabled by default, in which case readers look up C2 and C1 in the plot itself.
+/// Only plots with k <= 32 are cached, since their f7s fit in 32 bits.
+///
+class PlotIndexCache
+{
+public:
+    // Sets the maximum memory used by cached indices, 0 disables the cache.
+    // hotC3Parks is how many decoded C3 parks to keep per plot, so that a
+    // full proof request following a quality lookup won't read its park again.
+    // Only applies to indices loaded after this call.
+    static void Configure( size_t maxBytes, uint32 hotC3Parks = 0 );
+
+    static bool IsEnabled();
+
+    // Returns the index for the plot, loading it if it is not cached yet.
+    // Returns null if the cache is disabled or the index can't be loaded.
+    static std::shared_ptr<PlotIndex> Get( IPlotFile& plot );
+
+    static void Clear();
+
+private:
+    static std::shared_ptr<PlotIndex> Load( IPlotFile& plot, uint32 hotC3Parks );
+};
@@ -0,0 +1,246 @@
+#include "PlotReadScheduler.h"
+#include "PlotReader.h"
+#include "plotting/PlotHeader.h"
+#include "util/Log.h"
+#include <unordered_map>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+// Reads are not merged past this size, so that a merged read never costs more than the seek it saves
+static constexpr size_t MAX_MERGED_READ_SIZE = 1 MiB;
+
+///
+/// Scheduler registry
+///
+namespace {
+
+    std::mutex                                                   _schedulersLock;
+    std::unordered_map<uint64, std::weak_ptr<PlotReadScheduler>> _schedulers;
+    uint32                                                       _schedulerWindowUS = 0;
+}
+
+//-----------------------------------------------------------
+void PlotReadScheduler::Configure( const uint32 windowMicroseconds )
+{
+    std::lock_guard<std::mutex> lock( _schedulersLock );
+
+    // Plots already open keep their device's scheduler, new ones get a scheduler with the new window
+    _schedulerWindowUS = windowMicroseconds;
+    _schedulers.clear();
+}
+
+//-----------------------------------------------------------
+bool PlotReadScheduler::IsEnabled()
+{
+    std::lock_guard<std::mutex> lock( _schedulersLock );
+    return _schedulerWindowUS > 0;
+}
+
+//-----------------------------------------------------------
+std::shared_ptr<PlotReadScheduler> PlotReadScheduler::ForPath( const char* path )
+{
+    std::lock_guard<std::mutex> lock( _schedulersLock );
+
+    if( _schedulerWindowUS == 0 )
+        return nullptr;
+
+    uint64 deviceId = 0;
+    if( !FileStream::GetDeviceIdForPath( path, deviceId ) )
+        return nullptr;
+
+    auto scheduler = _schedulers[deviceId].lock();
+    if( !scheduler )
+    {
+        scheduler = std::make_shared<PlotReadScheduler>( _schedulerWindowUS );
+        _schedulers[deviceId] = scheduler;
+    }
+
+    return scheduler;
+}
+
+
+///
+/// Scheduler
+///
+//-----------------------------------------------------------
+PlotReadScheduler::PlotReadScheduler( const uint32 windowMicroseconds )
+    : _windowUS( windowMicroseconds )
+{}
+
+//-----------------------------------------------------------
+PlotReadScheduler::~PlotReadScheduler()
+{
+    if( _buffer.Ptr() )
+        bbvirtfree_span( _buffer );
+}
+
+//-----------------------------------------------------------
+bool PlotReadScheduler::Read( FileStream& file, const PlotReadRequest* requests, const uint32 count )
+{
+    if( count < 1 )
+        return true;
+
+    Submission submission = { &file, requests, count, false, false };
+
+    std::unique_lock<std::mutex> lock( _lock );
+    _pending.push_back( &submission );
+
+    // Someone else is gathering the reads already, they'll run ours with theirs
+    if( _collecting )
+    {
+        _batchDone.wait( lock, [&]() { return submission.done; } );
+        return submission.ok;
+    }
+
+    // Wait out the window for reads from other plots. If a batch is still
+    // in flight after that, keep gathering reads until it completes.
+    _collecting = true;
+    lock.unlock();
+
+    std::this_thread::sleep_for( std::chrono::microseconds( _windowUS ) );
+
+    std::lock_guard<std::mutex> ioLock( _ioLock );
+
+    std::vector<Submission*> batch;
+    lock.lock();
+    batch.swap( _pending );
+    _collecting = false;
+    lock.unlock();
+
+    RunBatch( batch );
+
+    lock.lock();
+    for( Submission* s : batch )
+        s->done = true;
+
+    _batchDone.notify_all();
+
+    return submission.ok;
+}
+
+//-----------------------------------------------------------
+void PlotReadScheduler::RunBatch( const std::vector<Submission*>& batch )
+{
+    _reads .clear();
+    _merged.clear();
+
+    for( Submission* s : batch )
+    {
+        s->ok = true;
+
+        for( uint32 i = 0; i < s->count; i++ )
+            _reads.push_back( { s, i } );
+    }
+
+    auto getRequest = []( const PendingRead& r ) -> const PlotReadRequest& { return r.owner->requests[r.request]; };
+
+    // Order the reads as they are laid out on the disk, as far as we can tell. Plot files are mostly contiguous,
+    // so reads are grouped by file and ordered by offset within each.
+    std::sort( _reads.begin(), _reads.end(), [&]( const PendingRead& a, const PendingRead& b ) {
+        if( a.owner->file != b.owner->file )
+            return a.owner->file->Id() < b.owner->file->Id();
+
+        return getRequest( a ).offset < getRequest( b ).offset;
+    });
+
+    // Merge reads touching the same or adjacent pages of a file.
+    // Merged reads are aligned to the file's block size as well, so they also work with direct I/O.
+    size_t bufferSize = 0;
+
+    for( const PendingRead& r : _reads )
+    {
+        FileStream&            file  = *r.owner->file;
+        const PlotReadRequest& req   = getRequest( r );
+        const uint64           align = std::max( (uint64)BB_PLOT_PAGE_SIZE, (uint64)file.BlockSize() );
+        const uint64           start = req.offset / align * align;
+        const uint64           end   = RoundUpToNextBoundaryT( req.offset + req.size, align );
+
+        if( !_merged.empty() )
+        {
+            MergedRead& last = _merged.back();
+
+            if( last.file == &file && start <= last.offset + last.size && end - last.offset <= MAX_MERGED_READ_SIZE )
+            {
+                const size_t size = (size_t)( std::max( end, last.offset + last.size ) - last.offset );
+
+                bufferSize += size - last.size;
+                last.size   = size;
+                continue;
+            }
+        }
+
+        bufferSize = RoundUpToNextBoundaryT( bufferSize, (size_t)align );
+        _merged.push_back( { &file, start, (size_t)( end - start ), bufferSize, 0 } );
+        bufferSize += (size_t)( end - start );
+    }
+
+    if( bufferSize > _buffer.Length() )
+    {
+        if( _buffer.Ptr() )
+            bbvirtfree_span( _buffer );
+
+        const size_t allocSize = RoundUpToNextBoundaryT( std::max( bufferSize, (size_t)( 1 MiB ) ), (size_t)( 64 KiB ) );
+        _buffer = Span<byte>( bbvirtalloc<byte>( allocSize ), allocSize );
+    }
+
+    // Reads near the end of a file may come back short, which only
+    // fails the requests that are not within the part that was read.
+    bool issued = false;
+
+#if BB_HAS_FILE_IO_BATCH
+    if( _merged.size() > 1 && !_ioBatch.IsInitialized() && !_ioBatchFailed )
+        _ioBatchFailed = !_ioBatch.Init( BB_PLOT_PROOF_X_COUNT );
+
+    if( _merged.size() > 1 && _ioBatch.IsInitialized() )
+    {
+        for( const MergedRead& m : _merged )
+            _ioBatch.Read( *m.file, _buffer.Ptr() + m.bufferOffset, m.size, m.offset );
+
+        int error = 0;
+        if( _ioBatch.Submit( error ) )
+        {
+            for( size_t i = 0; i < _merged.size(); i++ )
+                _merged[i].sizeRead = _ioBatch.BytesTransferred( (uint32)i );
+        }
+        else
+            Log::Error( "Failed to read from plots with error %d", error );
+
+        issued = true;
+    }
+#endif
+
+    if( !issued )
+    {
+        for( MergedRead& m : _merged )
+        {
+            if( !m.file->Seek( (int64)m.offset, SeekOrigin::Begin ) )
+                continue;
+
+            const ssize_t sizeRead = m.file->Read( _buffer.Ptr() + m.bufferOffset, m.size );
+            m.sizeRead = sizeRead > 0 ? (size_t)sizeRead : 0;
+        }
+    }
+
+    // Dispatch the data back to each request, in the same order the reads were merged in
+    size_t mergedIdx = 0;
+
+    for( const PendingRead& r : _reads )
+    {
+        const PlotReadRequest& req = getRequest( r );
+
+        while( _merged[mergedIdx].file != r.owner->file || req.offset + req.size > _merged[mergedIdx].offset + _merged[mergedIdx].size )
+            mergedIdx++;
+
+        const MergedRead& m = _merged[mergedIdx];
+        ASSERT( req.offset >= m.offset );
+
+        if( req.offset + req.size > m.offset + m.sizeRead )
+        {
+            r.owner->ok = false;
+            continue;
+        }
+
+        memcpy( req.buffer, _buffer.Ptr() + m.bufferOffset + ( req.offset - m.offset ), req.size );
+    }
+}
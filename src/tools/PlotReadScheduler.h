@@ -0,0 +1,84 @@
+#pragma once
+#include "io/FileStream.h"
+#include "util/Span.h"
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+struct PlotReadRequest;
+
+///
+/// Gathers the reads that lookups on different plots of the same disk make concurrently,
+/// so that the disk sees them as one ordered batch instead of interleaved random reads.
+/// A read waits up to a short window for reads from other plots on the device. All the reads gathered
+/// are then sorted by file and offset, those touching the same or adjacent pages are merged into one,
+/// and they are submitted together. Each caller blocks until its own reads are complete.
+/// Only one batch per device is in flight at a time, reads submitted meanwhile are gathered for the next one.
+///
+class PlotReadScheduler
+{
+public:
+    // Sets how long a read waits for reads of other plots on the same device, in microseconds.
+    // 0 disables scheduling, which is the default. Only applies to plots opened after this call.
+    static void Configure( uint32 windowMicroseconds );
+
+    static bool IsEnabled();
+
+    // Returns the scheduler shared by all plots on the device holding the file at path,
+    // or null if scheduling is disabled or the device can't be determined.
+    static std::shared_ptr<PlotReadScheduler> ForPath( const char* path );
+
+    PlotReadScheduler( uint32 windowMicroseconds );
+    ~PlotReadScheduler();
+
+    // Reads the requests from file along with the reads pending on the device from other plots.
+    // Returns false if any of them could not be read whole.
+    bool Read( FileStream& file, const PlotReadRequest* requests, uint32 count );
+
+private:
+    struct Submission
+    {
+        FileStream*            file;
+        const PlotReadRequest* requests;
+        uint32                 count;
+        bool                   done;
+        bool                   ok;
+    };
+
+    // Reads a whole batch, setting the result of each submission. Called with _ioLock held.
+    void RunBatch( const std::vector<Submission*>& batch );
+
+private:
+    struct PendingRead
+    {
+        Submission* owner;
+        uint32      request;
+    };
+
+    struct MergedRead
+    {
+        FileStream* file;
+        uint64      offset;
+        size_t      size;
+        size_t      bufferOffset;
+        size_t      sizeRead;
+    };
+
+    const uint32             _windowUS;
+
+    std::mutex               _lock;
+    std::condition_variable  _batchDone;
+    std::vector<Submission*> _pending;
+    bool                     _collecting = false;   // A submitter is waiting out the window to run the pending reads
+
+    // Only used while a batch is in flight
+    std::mutex               _ioLock;
+    std::vector<PendingRead> _reads;
+    std::vector<MergedRead>  _merged;
+    Span<byte>               _buffer = {};
+#if BB_HAS_FILE_IO_BATCH
+    FileIOBatch              _ioBatch;
+    bool                     _ioBatchFailed = false;
+#endif
+};
@@ -1,14 +1,26 @@
 #include "PlotReader.h"
 #include "ChiaConsts.h"
 #include "util/BitView.h"
-#include "plotting/PlotTools.h"
 #include "plotting/CTables.h"
 #include "plotting/DTables.h"
 #include "plotmem/LPGen.h"
 #include "plotting/Compression.h"
+#include "plotting/ParkCoding.h"
+#include "plotting/GpuParkDecoder.h"
 #include "harvesting/GreenReaper.h"
-#include "BLS.h"
+#if !defined( BB_IS_HARVESTER )
+    #include "BLS.h"
+#endif
 #include "plotdisk/jobs/IOJob.h"
+#include "PlotIndexCache.h"
+#include "PlotReadScheduler.h"
+#include <algorithm>
+
+#if PLATFORM_IS_WINDOWS
+    #include <Windows.h>
+#else
+    #include <sys/mman.h>
+#endif
 
 ///
 /// Plot Reader
@@ -18,11 +30,15 @@
 PlotReader::PlotReader( IPlotFile& plot )
     : _plot( plot )
 {
-    const size_t largestParkSize           = RoundUpToNextBoundaryT( CalculateParkSize( TableId::Table1, plot.K() ), sizeof( uint64 ) * 2 );
+    const size_t largestParkSize           = RoundUpToNextBoundaryT( 
+                                                std::max( CalculateParkSize( TableId::Table1, plot.K() ), GetLargestCompressedParkSize() ), 
+                                                sizeof( uint64 ) * 2 );
     const size_t maxDecompressedDeltasSize = RoundUpToNextBoundaryT( (size_t)0x7FFF, sizeof( uint64 ) );
 
     _parkBuffer   = bbmalloc<uint64>( largestParkSize );
     _deltasBuffer = bbmalloc<byte>  ( maxDecompressedDeltasSize );
+    _pairDeltasBuffer = bbmalloc<byte>( maxDecompressedDeltasSize );
+    _lpParkStride = RoundUpToNextBoundaryT( largestParkSize, (size_t)64 );
 }
 
 //-----------------------------------------------------------
@@ -30,6 +46,7 @@ PlotReader::~PlotReader()
 {
     free( _parkBuffer );    _parkBuffer = nullptr;
     free( _deltasBuffer );  _deltasBuffer = nullptr;
+    free( _pairDeltasBuffer ); _pairDeltasBuffer = nullptr;
 
     bbvirtfreebounded( _c1Buffer );
 
@@ -39,6 +56,9 @@ PlotReader::~PlotReader()
 
     bbvirtfreebounded_span( _c3Buffer );
 
+    free( _lpParkCache );   _lpParkCache = nullptr;
+    free( _lpRunBuffer );   _lpRunBuffer = nullptr;
+
     if( _grContext && _ownsGrContext )
         grDestroyContext( _grContext );
     _grContext = nullptr;
@@ -89,7 +109,7 @@ size_t PlotReader::GetTableParkCount( const PlotTable table ) const
         case PlotTable::Table4:
         case PlotTable::Table5:
         case PlotTable::Table6:
-            return _plot.TableSize( table ) / GetParkSizeForTable( (TableId)table );
+            return GetParkLayout( GetParkSizeForTable( (TableId)table ) ).ParkCount( _plot.TableSize( table ) );
 
         default:
             return 0;
@@ -150,7 +170,7 @@ bool PlotReader::GetActualC1EntryCount( uint64& outC1Count )
 }
 
 //-----------------------------------------------------------
-int64 PlotReader::ReadC3Park( uint64 parkIndex, uint64* f7Buffer )
+int32 PlotReader::LoadC3Park( uint64 parkIndex, uint64& outC1 )
 {
     const uint32 k              = _plot.K();
     const size_t f7SizeBytes    = CDiv( k, 8 );
@@ -160,52 +180,62 @@ int64 PlotReader::ReadC3Park( uint64 parkIndex, uint64* f7Buffer )
     const size_t c1TableSize    = _plot.TableSize( PlotTable::C1 );
     const size_t c3TableSize    = _plot.TableSize( PlotTable::C3 );
     const uint64 c1EntryAddress = c1Address + parkIndex * f7SizeBytes;
-    const uint64 parkAddress    = c3Address + parkIndex * c3ParkSize;
+    const uint64 parkAddress    = c3Address + GetParkLayout( c3ParkSize ).ParkOffset( parkIndex );
 
 
     // Ensure the C1 address is within the C1 table bounds.
     if( c1EntryAddress >= c1Address + c1TableSize - f7SizeBytes ) // - f7SizeBytes because the last C1 entry is an empty/dummy one
         return -1;
 
-    // First we need to read the root F7 entry for the park,  which is in the C1 table.
-    if( !_plot.Seek( SeekOrigin::Begin, (int64)c1EntryAddress ) )
-        return -1;
+    // If the park is not present, it means the C1 entry is the only entry in the park
+    const bool hasPark = parkAddress < c3Address + c3TableSize;
 
+    // Read the root F7 entry for the park, which is in the C1 table, in the same batch as the park.
+    // The whole park is read at once, so that it can go through direct I/O.
     uint64 c1 = 0;
-    if( _plot.Read( f7SizeBytes, &c1 ) != (ssize_t)f7SizeBytes )
-        return -1;
+    const PlotReadRequest reads[2] = {
+        { c1EntryAddress, f7SizeBytes, &c1 },
+        { parkAddress   , c3ParkSize , _parkBuffer }
+    };
 
-    c1 = Swap64( c1 ) >> ( 64 - k );
+    if( !_plot.ReadBatch( reads, hasPark ? 2 : 1 ) )
+        return -1;
 
-    // Ensure we can read this park. If it's not present, it means
-    // the C1 entry is the only entry in the park, so just return it.
-    // Read the park into our buffer
-    if( parkAddress >= c3Address + c3TableSize )
-    {
-        f7Buffer[0] = c1;
-        return 1;
-    }
+    outC1 = Swap64( c1 ) >> ( 64 - k );
 
-    if( !_plot.Seek( SeekOrigin::Begin, (int64)parkAddress ) )
-        return -1;
+    if( !hasPark )
+        return 0;
 
     // Read the size of the compressed C3 deltas
     uint16 compressedSize = 0;
-    if( _plot.Read( sizeof( uint16 ), &compressedSize ) != (ssize_t)sizeof( uint16 ) )
-        return -1;
+    memcpy( &compressedSize, _parkBuffer, sizeof( uint16 ) );
 
     compressedSize = Swap16( compressedSize );
-    if( compressedSize > c3ParkSize )
+    if( compressedSize == 0 || compressedSize > c3ParkSize - sizeof( uint16 ) )
         return -1;
 
-    // memset( _parkBuffer, 0, _parkBufferSize );
-    if( _plot.Read( c3ParkSize - sizeof( uint16 ), _parkBuffer ) != c3ParkSize - sizeof( uint16 ) )
+    return (int32)compressedSize;
+}
+
+//-----------------------------------------------------------
+int64 PlotReader::ReadC3Park( uint64 parkIndex, uint64* f7Buffer )
+{
+    uint64 c1 = 0;
+
+    const int32 compressedSize = LoadC3Park( parkIndex, c1 );
+    if( compressedSize < 0 )
         return -1;
 
+    if( compressedSize == 0 )
+    {
+        f7Buffer[0] = c1;
+        return 1;
+    }
+
     // Now we can read the f7 deltas from the C3 park
     const size_t deltaCount = FSE_decompress_usingDTable( 
                                 _deltasBuffer, kCheckpoint1Interval, 
-                                _parkBuffer, compressedSize, 
+                                (byte*)_parkBuffer + sizeof( uint16 ), (size_t)compressedSize, 
                                 (const FSE_DTable*)DTable_C3 );
 
     if( FSE_isError( deltaCount ) )
@@ -229,6 +259,34 @@ int64 PlotReader::ReadC3Park( uint64 parkIndex, uint64* f7Buffer )
     return (int64)deltaCount+1;
 }
 
+//-----------------------------------------------------------
+int64 PlotReader::FindF7sInC3Park( const uint64 parkIndex, const uint64* f7s, const uint32 count, uint64* outFirst, uint64* outCounts )
+{
+    uint64 c1 = 0;
+
+    const int32 compressedSize = LoadC3Park( parkIndex, c1 );
+    if( compressedSize < 0 )
+        return -1;
+
+    if( compressedSize == 0 )
+    {
+        for( uint32 i = 0; i < count; i++ )
+        {
+            outFirst [i] = 0;
+            outCounts[i] = f7s[i] == c1 ? 1 : 0;
+        }
+
+        return 1;
+    }
+
+    const size_t visited = FindC3ParkF7s( (const FSE_DTable*)DTable_C3, (byte*)_parkBuffer + sizeof( uint16 ), (size_t)compressedSize,
+                                          c1, f7s, count, outFirst, outCounts );
+    if( FSE_isError( visited ) )
+        return -1;
+
+    return (int64)visited;
+}
+
 //-----------------------------------------------------------
 bool PlotReader::ReadP7Entries( uint64 parkIndex, uint64 p7ParkEntries[kEntriesPerPark] )
 {
@@ -268,37 +326,29 @@ bool PlotReader::LoadP7Park( uint64 parkIndex )
     const uint64 p7TableAddress = _plot.TableAddress( PlotTable::Table7 );
     const size_t p7TableMaxSize = _plot.TableSize( PlotTable::Table7 );
     const size_t parkSizeBytes  = CalculatePark7Size( k );
+    const auto   layout         = GetParkLayout( parkSizeBytes );
 
-    const uint64 maxParks       = p7TableMaxSize / parkSizeBytes;
+    const uint64 maxParks       = layout.ParkCount( p7TableMaxSize );
 
     // Park must be in the range of the maximum table parks encoded
     if( parkIndex >= maxParks )
         return false;
 
-    const uint64 parkAddress = p7TableAddress + parkIndex * parkSizeBytes;
-
-    if( !_plot.Seek( SeekOrigin::Begin, (int64)parkAddress ) )
-        return false;
+    const PlotReadRequest parkRead = { p7TableAddress + layout.ParkOffset( parkIndex ), parkSizeBytes, _parkBuffer };
 
-    if( _plot.Read( parkSizeBytes, _parkBuffer ) != (ssize_t)parkSizeBytes )
+    if( !_plot.ReadBatch( &parkRead, 1 ) )
         return false;
 
     CPBitReader parkReader( (byte*)_parkBuffer, parkSizeBytes * 8 );
-
-    for( uint32 i = 0; i < kEntriesPerPark; i++ )
-        _park7Entries[i] = parkReader.Read64( p7EntrySize );
+    parkReader.ReadN( p7EntrySize, kEntriesPerPark, _park7Entries );
 
     _park7Index = (int64)parkIndex;
     return true;
 }
 
 //-----------------------------------------------------------
-bool PlotReader::ReadLPParkComponents( TableId table, uint64 parkIndex, 
-                                       CPBitReader& outStubs, byte*& outDeltas, 
-                                       uint128& outBaseLinePoint, uint64& outDeltaCounts )
+bool PlotReader::GetLPParkSections( TableId table, uint64 parkIndex, LPParkSections& outSections )
 {
-    outDeltaCounts = 0;
-
     ASSERT( table < TableId::Table7 );
     if( table >= TableId::Table7 )
         return false;
@@ -306,25 +356,22 @@ bool PlotReader::ReadLPParkComponents( TableId table, uint64 parkIndex,
     const uint32 k                = _plot.K();
     const size_t lpSizeBytes      = LinePointSizeBytes( k );
     const size_t tableMaxSize     = _plot.TableSize( (PlotTable)table );
-    const size_t tableAddress     = _plot.TableAddress( (PlotTable)table );
     const size_t parkSize         = GetParkSizeForTable( table );
 
-    const uint64 maxParks       = tableMaxSize / parkSize;
+    const uint64 maxParks       = GetParkLayout( parkSize ).ParkCount( tableMaxSize );
     if( parkIndex >= maxParks )
         return false;
     
-    const size_t parkAddress    = tableAddress + parkIndex * parkSize;
-    
-    if( !_plot.Seek( SeekOrigin::Begin, (int64)parkAddress ) )
+    // The whole park is read at once, then its sections are parsed from memory
+    const byte* park = GetLPPark( table, parkIndex );
+    if( !park )
         return false;
 
     // Read base full line point
     uint128 baseLinePoint;
     {
         uint64 baseLPBytes[CDiv(LinePointSizeBytes( 50 ), sizeof(uint64))] = { 0 };
-
-        if( _plot.Read( lpSizeBytes, baseLPBytes ) != (ssize_t)lpSizeBytes )
-            return false;
+        memcpy( baseLPBytes, park, lpSizeBytes );
 
         const size_t lpSizeBits = (uint32)LinePointSizeBits( k );
 
@@ -332,28 +379,20 @@ bool PlotReader::ReadLPParkComponents( TableId table, uint64 parkIndex,
         baseLinePoint = lpReader.Read128Aligned( (uint32)lpSizeBits );
     }
 
-    // Read stubs
+    // Stubs are unpacked in-place
     const size_t stubsSizeBytes = GetLPStubByteSize( table );
-    uint64* stubsBuffer = _parkBuffer;
 
-    if( _plot.Read( stubsSizeBytes, stubsBuffer ) != (ssize_t)stubsSizeBytes )
+    if( lpSizeBytes + stubsSizeBytes + 2 > parkSize )
         return false;
 
     // Read deltas
-    const size_t maxDeltasSizeBytes = GetParkDeltasSectionMaxSize( (TableId)table );
-    byte* compressedDeltaBuffer = ((byte*)_parkBuffer) + RoundUpToNextBoundary( stubsSizeBytes, sizeof( uint64 ) );
-    byte* deltaBuffer           = _deltasBuffer;
-
     uint16 compressedDeltasSize = 0;
-    if( _plot.Read( 2, &compressedDeltasSize ) != 2 )
-        return false;
+    memcpy( &compressedDeltasSize, park + lpSizeBytes + stubsSizeBytes, 2 );
 
     // Don't support uncompressed deltas
     if( compressedDeltasSize & 0x8000 )
         return false;
 
-    size_t deltaCount = 0;
-
     // #TODO: Investigate this, but we should not support uncompressed deltas
     // if( compressedDeltasSize & 0x8000 ) 
     // {
@@ -364,26 +403,39 @@ bool PlotReader::ReadLPParkComponents( TableId table, uint64 parkIndex,
 
     //     deltaCount = compressedDeltasSize;
     // }
-    // else
-    {
-        // Compressed deltas
-        if( _plot.Read( compressedDeltasSize, compressedDeltaBuffer ) != compressedDeltasSize )
-            return false;
 
-        // Decompress deltas
-        const FSE_DTable* dTable = GetDTableForTable( table );
+    if( lpSizeBytes + stubsSizeBytes + 2 + compressedDeltasSize > parkSize )
+        return false;
 
-        deltaCount = FSE_decompress_usingDTable( 
-                        deltaBuffer, kEntriesPerPark - 1, 
-                        compressedDeltaBuffer, compressedDeltasSize, 
-                        dTable );
+    outSections.baseLinePoint = baseLinePoint;
+    outSections.stubs         = park + lpSizeBytes;
+    outSections.deltas        = park + lpSizeBytes + stubsSizeBytes + 2;
+    outSections.deltasSize    = compressedDeltasSize;
 
-        if( FSE_isError( deltaCount ) )
-            return false;
-    }
-    
-    outStubs         = CPBitReader( (byte*)stubsBuffer, RoundUpToNextBoundary( stubsSizeBytes * 8, 64 ) );
-    outBaseLinePoint = baseLinePoint;
+    return true;
+}
+
+//-----------------------------------------------------------
+bool PlotReader::ReadLPParkComponents( TableId table, uint64 parkIndex, 
+                                       const byte*& outStubs, byte*& outDeltas, 
+                                       uint128& outBaseLinePoint, uint64& outDeltaCounts )
+{
+    outDeltaCounts = 0;
+
+    LPParkSections park;
+    if( !GetLPParkSections( table, parkIndex, park ) )
+        return false;
+
+    // Decompress deltas
+    byte* deltaBuffer = _deltasBuffer;
+
+    const size_t deltaCount = DecompressLPDeltas( table, park, deltaBuffer );
+
+    if( FSE_isError( deltaCount ) )
+        return false;
+
+    outStubs         = park.stubs;
+    outBaseLinePoint = park.baseLinePoint;
     outDeltas        = deltaBuffer;
     outDeltaCounts   = deltaCount;
 
@@ -391,215 +443,679 @@ bool PlotReader::ReadLPParkComponents( TableId table, uint64 parkIndex,
 }
 
 //-----------------------------------------------------------
-const FSE_DTable* PlotReader::GetDTableForTable( TableId table ) const
+size_t PlotReader::DecompressLPDeltas( const TableId table, const LPParkSections& park, byte* dst )
 {
-    if( !IsCompressedXTable( table ) )
-        return DTables[(int)table];
+    const ParkDeltaCoding coding = GetParkDeltaCoding( _plot.Flags() );
 
-    return CreateCompressionDTable( _plot.CompressionLevel() );
+    return DecompressParkDeltas( coding, dst, kEntriesPerPark - 1, park.deltas, park.deltasSize,
+                                 GetDTableForTable( table ),
+                                 coding == ParkDeltaCoding::RANS ? GetRANSDTableForTable( table ) : nullptr );
 }
 
 //-----------------------------------------------------------
-bool PlotReader::ReadLPPark( TableId table, uint64 parkIndex, uint128 linePoints[kEntriesPerPark], uint64& outEntryCount )
+const byte* PlotReader::FindCachedLPPark( const TableId table, const uint64 parkIndex )
 {
-    outEntryCount = 0;
-
-    CPBitReader stubReader;
-    byte*       deltaBuffer   = nullptr;
-    uint128     baseLinePoint = 0;
-    uint64      deltaCount    = 0;
-
-    if( !ReadLPParkComponents( table, parkIndex, stubReader, deltaBuffer, baseLinePoint, deltaCount ) )
-        return false;
+    if( !_lpParkCache )
+        return nullptr;
 
-    // Decode line points from stubs and deltas
-    linePoints[0] = baseLinePoint;
-    if( deltaCount > 0 )
+    for( uint32 i = 0; i < LP_PARK_CACHE_SIZE; i++ )
     {
-        const uint32 stubBitSize = GetLPStubBitSize( table );
-        
-        for( uint64 i = 1; i <= deltaCount; i++ )
-        {
-            // Since these entries are still deltafied, we can fit them in 64-bits
-            const uint64 stub = stubReader.Read64( stubBitSize );
-            const uint64 lp   = stub | (((uint64)deltaBuffer[i-1]) << stubBitSize );
+        auto& e = _lpParkCacheEntries[i];
 
-            // Get absolute LP from delta
-            linePoints[i] = linePoints[i-1] + (uint128)lp;
+        if( e.table == table && e.parkIndex == parkIndex )
+        {
+            e.lastUse = ++_lpParkCacheTick;
+            return _lpParkCache + i * _lpParkStride;
         }
     }
 
-    outEntryCount = deltaCount + 1;
-    return true;
+    return nullptr;
 }
 
 //-----------------------------------------------------------
-TableId PlotReader::GetLowestStoredTable() const
+const byte* PlotReader::GetLPPark( const TableId table, const uint64 parkIndex )
 {
-    const uint32 compressionLevel = _plot.CompressionLevel();
+    // Mapped plots are accessed in-place, the caller has already bounds-checked the park
+    const byte* mapped = _plot.MappedData();
+    if( mapped )
+        return mapped + _plot.TableAddress( (PlotTable)table ) + GetParkLayout( GetParkSizeForTable( table ) ).ParkOffset( parkIndex );
 
-    const uint32 numDroppedTables = compressionLevel == 0 ? 0 :
-                                    compressionLevel >= 9 ? 2 : 1;
+    const byte* park = FindCachedLPPark( table, parkIndex );
+    if( park )
+        return park;
 
-    return TableId::Table1 + numDroppedTables;
+    PrefetchLPParks( table, &parkIndex, 1 );
+    return FindCachedLPPark( table, parkIndex );
 }
 
 //-----------------------------------------------------------
-bool PlotReader::IsCompressedXTable( const TableId table ) const
+byte* PlotReader::InsertLPPark( const TableId table, const uint64 parkIndex )
 {
-    return _plot.CompressionLevel() > 0 && table == GetLowestStoredTable();
+    // Evict the least recently used park
+    uint32 slot = 0;
+    for( uint32 i = 1; i < LP_PARK_CACHE_SIZE; i++ )
+    {
+        if( _lpParkCacheEntries[i].lastUse < _lpParkCacheEntries[slot].lastUse )
+            slot = i;
+    }
+
+    auto& e = _lpParkCacheEntries[slot];
+    e.table     = table;
+    e.parkIndex = parkIndex;
+    e.lastUse   = ++_lpParkCacheTick;
+
+    return _lpParkCache + slot * _lpParkStride;
 }
 
 //-----------------------------------------------------------
-size_t PlotReader::GetParkSizeForTable( TableId table ) const
+void PlotReader::PrefetchLPParks( const TableId table, const uint64* parkIndices, const uint32 count )
 {
-    if( IsCompressedXTable( table ) )
-        return GetCompressionInfoForLevel( _plot.CompressionLevel() ).tableParkSize;
+    ASSERT( count <= BB_PLOT_PROOF_X_COUNT );
 
-    if( table < GetLowestStoredTable() )
+    if( _plot.MappedData() )
+        return;
+
+    if( !_lpParkCache )
     {
-        ASSERT(0);
-        return 0;
+        // Runs of aligned parks include the padding between them
+        const size_t runParkStride = _plot.HasAlignedParks() ? _lpParkStride + BB_PLOT_PAGE_SIZE : _lpParkStride;
+
+        _lpParkCache = bbmalloc<byte>( LP_PARK_CACHE_SIZE * _lpParkStride );
+        _lpRunBuffer = bbmalloc<byte>( LP_PARK_BATCH_SIZE * runParkStride );
     }
 
-    return CalculateParkSize( table, _plot.K() );
+    const size_t parkSize     = GetParkSizeForTable( table );
+    const auto   layout       = GetParkLayout( parkSize );
+    const uint64 tableAddress = _plot.TableAddress( (PlotTable)table );
+    const uint64 maxParks     = layout.ParkCount( _plot.TableSize( (PlotTable)table ) );
+
+    // Gather the parks not cached yet, sorted by offset.
+    // Looking up the cached ones also marks them as used, so they're not evicted below.
+    uint64 parks[BB_PLOT_PROOF_X_COUNT];
+    uint32 parkCount = 0;
+
+    for( uint32 i = 0; i < count; i++ )
+    {
+        if( parkIndices[i] < maxParks && !FindCachedLPPark( table, parkIndices[i] ) )
+            parks[parkCount++] = parkIndices[i];
+    }
+
+    std::sort( parks, parks + parkCount );
+    parkCount = (uint32)( std::unique( parks, parks + parkCount ) - parks );
+
+    // Coalesce nearby parks into runs, and read the runs together in batches.
+    // Reading a few unneeded parks is much cheaper than an extra seek on a spinning disk.
+    PlotReadRequest runs     [LP_PARK_BATCH_SIZE];
+    uint64          runStarts[LP_PARK_BATCH_SIZE];
+    uint64          runEnds  [LP_PARK_BATCH_SIZE];
+    uint32          runCount   = 0;
+    uint64          batchParks = 0;
+
+    auto flushBatch = [&]() {
+
+        // If the batch fails, its parks are missing from the cache, which the reader reports as a failure
+        if( runCount > 0 && _plot.ReadBatch( runs, runCount ) )
+        {
+            for( uint32 r = 0; r < runCount; r++ )
+            {
+                const uint64 runOffset = layout.ParkOffset( runStarts[r] );
+
+                for( uint64 park = runStarts[r]; park < runEnds[r]; park++ )
+                    memcpy( InsertLPPark( table, park ), (byte*)runs[r].buffer + ( layout.ParkOffset( park ) - runOffset ), parkSize );
+            }
+        }
+
+        runCount   = 0;
+        batchParks = 0;
+    };
+
+    for( uint32 i = 0; i < parkCount; )
+    {
+        const uint64 runStart = parks[i];
+              uint64 runEnd   = runStart + 1;
+
+        while( ++i < parkCount && parks[i] - runEnd <= LP_PARK_MAX_GAP && parks[i] + 1 - runStart <= LP_PARK_MAX_RUN )
+            runEnd = parks[i] + 1;
+
+        const uint64 runParks = runEnd - runStart;
+
+        if( batchParks + runParks > LP_PARK_BATCH_SIZE )
+            flushBatch();
+
+        const uint64 runOffset = layout.ParkOffset( runStart );
+
+        runs[runCount].offset = tableAddress + runOffset;
+        runs[runCount].size   = (size_t)( layout.ParkOffset( runEnd - 1 ) + parkSize - runOffset );
+        runs[runCount].buffer = _lpRunBuffer + batchParks * layout.MaxBytesPerPark();
+        runStarts[runCount]   = runStart;
+        runEnds  [runCount]   = runEnd;
+
+        runCount++;
+        batchParks += runParks;
+    }
+
+    flushBatch();
 }
 
 //-----------------------------------------------------------
-uint32 PlotReader::GetLPStubBitSize( TableId table ) const
+const RANSDecTable* PlotReader::GetRANSDTableForTable( TableId table ) const
 {
-    FatalIf( table < GetLowestStoredTable(), "Getting stub bit size for invalid table." );
+    const double tunedRValue = _plot.TunedDeltaRValue( (PlotTable)table );
+    if( tunedRValue > 0 )
+        return CreateRANSDecTable( tunedRValue );
 
     if( !IsCompressedXTable( table ) )
-        return _plot.K() - kStubMinusBits;
+        return CreateRANSDecTable( kRValues[(int)table] );
 
-    auto info = GetCompressionInfoForLevel( _plot.CompressionLevel() );
-    return info.stubSizeBits;
+    return CreateRANSDecTable( GetCompressionInfoForLevel( _plot.CompressionLevel() ).ansRValue );
 }
 
 //-----------------------------------------------------------
-uint32 PlotReader::GetLPStubByteSize( const TableId table ) const
+const FSE_DTable* PlotReader::GetDTableForTable( TableId table ) const
 {
-    return CDiv( ( kEntriesPerPark - 1 ) * GetLPStubBitSize( table ), 8 );
+    const double tunedRValue = _plot.TunedDeltaRValue( (PlotTable)table );
+    if( tunedRValue > 0 )
+        return CreateTunedDTable( tunedRValue );
+
+    if( !IsCompressedXTable( table ) )
+        return DTables[(int)table];
+
+    return CreateCompressionDTable( _plot.CompressionLevel() );
 }
 
+///
+/// Line point decoding.
+/// A line point delta is its stub, the low stubBitSize bits, below its small delta.
+/// Each compression level has its own stub width, and uncompressed k32 tables use k - kStubMinusBits,
+/// so those widths get their own instantiations, where the stubs are read with constant shifts
+/// and added as they are unpacked. Plots of other k go through UnpackStubs.
+///
+
+// Adds the first count entries of a park, made of their stubs and small deltas, to its base line point
 //-----------------------------------------------------------
-size_t PlotReader::GetParkDeltasSectionMaxSize( const TableId table ) const
+static uint128 AddLPDeltas( const uint128 baseLinePoint, const byte* stubBytes, const byte* deltas, const uint64 count, const uint32 stubBitSize )
 {
-    if( !IsCompressedXTable( table ) )
-        return CalculateMaxDeltasSize( table );
+    uint64 stubs[kEntriesPerPark-1];
+    UnpackStubs( stubBytes, count, stubBitSize, stubs );
 
-    auto info = GetCompressionInfoForLevel( _plot.CompressionLevel() );
+    // Stubs are below 2^stubBitSize, so the small deltas above them can be added separately
+    uint64 stubSum  = 0;
+    uint64 deltaSum = 0;
 
-    const uint32 lpSize       = CDiv( _K * 2u, 8 );
-    const uint32 stubByteSize = GetLPStubByteSize( table );
-    
-    return info.tableParkSize - ( lpSize + stubByteSize );
+    for( uint64 i = 0; i < count; i++ )
+    {
+        stubSum  += stubs[i];
+        deltaSum += deltas[i];
+    }
+
+    return baseLinePoint + (uint128)stubSum + ( (uint128)deltaSum << stubBitSize );
 }
 
-// #TODO: Add 64-bit outLinePoint (templatize)
+// Writes a park's line points, made of its base line point followed by deltaCount stubs and small deltas
 //-----------------------------------------------------------
-bool PlotReader::ReadLP( TableId table, uint64 index, uint128& outLinePoint )
+static void DecodeLinePoints( const uint128 baseLinePoint, const byte* stubBytes, const byte* deltas, const uint64 deltaCount,
+                              const uint32 stubBitSize, uint128 linePoints[kEntriesPerPark] )
 {
-    outLinePoint = 0;
+    linePoints[0] = baseLinePoint;
+    if( deltaCount == 0 )
+        return;
 
-    CPBitReader stubReader;
-    byte*       deltaBuffer   = nullptr;
-    uint128     baseLinePoint = 0;
-    uint64      deltaCount    = 0;
+    uint64 stubs[kEntriesPerPark-1];
+    UnpackStubs( stubBytes, deltaCount, stubBitSize, stubs );
 
-    const uint64 parkIndex  = index / kEntriesPerPark;
+    for( uint64 i = 1; i <= deltaCount; i++ )
+    {
+        // Since these entries are still deltafied, we can fit them in 64-bits
+        const uint64 lp = stubs[i-1] | (((uint64)deltas[i-1]) << stubBitSize );
 
-    if( !ReadLPParkComponents( table, parkIndex, stubReader, deltaBuffer, baseLinePoint, deltaCount ) )
-        return false;
+        // Get absolute LP from delta
+        linePoints[i] = linePoints[i-1] + (uint128)lp;
+    }
+}
 
-    const uint64 lpLocalIdx = index - parkIndex * kEntriesPerPark;
+/// Reads the stubs of count entries, MSB-first, like UnpackStubs.
+//-----------------------------------------------------------
+template<uint32 StubBits>
+struct StubReader
+{
+    static_assert( StubBits > 0 && StubBits <= 57 );
 
-    if( lpLocalIdx > 0 )
+    const byte*  src;
+    const uint64 byteCount;
+
+    inline StubReader( const byte* src, const uint64 count ) : src( src ), byteCount( CDiv( count * StubBits, 8 ) ) {}
+
+    //-----------------------------------------------------------
+    inline uint64 operator[]( const uint64 i ) const
     {
-        if( lpLocalIdx-1 >= deltaCount )
-            return false;
+        const uint64 bit    = i * StubBits;
+        const uint64 offset = bit >> 3;
 
-        const uint64 maxIter     = std::min( lpLocalIdx, deltaCount );
-        const uint32 stubBitSize = GetLPStubBitSize( table );
+        uint64 field = 0;
 
-        for( uint64 i = 0; i < maxIter; i++ )
-        {
-            // Since these entries are still deltafied, we can fit them in 64-bits
-            const uint64 stub    = stubReader.Read64( stubBitSize );
-            const uint64 lpDelta = stub | (((uint64)deltaBuffer[i]) << stubBitSize );
+        if( offset + 8 <= byteCount )
+            memcpy( &field, src + offset, 8 );
+        else
+            memcpy( &field, src + offset, (size_t)( byteCount - offset ) );    // The last stubs are read without going past the end of src
 
-            // Get absolute LP from delta
-            baseLinePoint += (uint128)lpDelta;
-        }
+        return ( Swap64( field ) << ( bit & 7 ) ) >> ( 64 - StubBits );
     }
+};
 
-    outLinePoint = baseLinePoint;
-    return true;
+//-----------------------------------------------------------
+template<uint32 StubBits>
+static uint128 AddLPDeltasT( const uint128 baseLinePoint, const byte* stubBytes, const byte* deltas, const uint64 count, const uint32 )
+{
+    const StubReader<StubBits> stubs( stubBytes, count );
+
+    uint64 stubSum  = 0;
+    uint64 deltaSum = 0;
+
+    for( uint64 i = 0; i < count; i++ )
+    {
+        stubSum  += stubs[i];
+        deltaSum += deltas[i];
+    }
+
+    return baseLinePoint + (uint128)stubSum + ( (uint128)deltaSum << StubBits );
 }
 
 //-----------------------------------------------------------
-bool PlotReader::FetchProofFromP7Entry( uint64 p7Entry, uint64 proof[32] )
+template<uint32 StubBits>
+static void DecodeLinePointsT( const uint128 baseLinePoint, const byte* stubBytes, const byte* deltas, const uint64 deltaCount,
+                               const uint32, uint128 linePoints[kEntriesPerPark] )
 {
-    // #TODO: Implement me
-    ASSERT( 0 );
-    return false;
+    const StubReader<StubBits> stubs( stubBytes, deltaCount );
+
+    uint128 lp = baseLinePoint;
+    linePoints[0] = lp;
+
+    for( uint64 i = 0; i < deltaCount; i++ )
+    {
+        lp += (uint128)( stubs[i] | ( (uint64)deltas[i] << StubBits ) );
+        linePoints[i+1] = lp;
+    }
 }
 
 //-----------------------------------------------------------
-uint64 PlotReader::GetP7IndicesForF7( const uint64 f7, uint64& outStartT6Index )
+template<uint32... StubBits>
+struct LPDecoderTable
 {
-    if( !LoadC2Entries() )
-        return 0;
+    static constexpr uint32 stubBits[] = { StubBits... };
+    static constexpr uint32 count      = sizeof...( StubBits );
+
+    static constexpr decltype( &AddLPDeltas      ) addDeltas[] = { AddLPDeltasT<StubBits>...      };
+    static constexpr decltype( &DecodeLinePoints ) decode   [] = { DecodeLinePointsT<StubBits>... };
+};
+
+// The stub widths of uncompressed k32 tables and of each compression level (C1-C9)
+using LPDecoders = LPDecoderTable<
+    32 - kStubMinusBits,
+    CompressionLevelInfo<1>::STUB_BIT_SIZE,
+    CompressionLevelInfo<2>::STUB_BIT_SIZE,
+    CompressionLevelInfo<3>::STUB_BIT_SIZE,
+    CompressionLevelInfo<4>::STUB_BIT_SIZE,
+    CompressionLevelInfo<5>::STUB_BIT_SIZE,
+    CompressionLevelInfo<6>::STUB_BIT_SIZE,
+    CompressionLevelInfo<7>::STUB_BIT_SIZE,
+    CompressionLevelInfo<8>::STUB_BIT_SIZE,
+    CompressionLevelInfo<9>::STUB_BIT_SIZE>;
 
-    uint64 c2Index = 0;
+//-----------------------------------------------------------
+const PlotReader::LPDecoder& PlotReader::GetLPDecoder( const TableId table )
+{
+    static const LPDecoder generic = { AddLPDeltas, DecodeLinePoints };
+    static const auto specialized = []() {
 
-    for( uint64 i = 0; ; )
+        std::array<LPDecoder, LPDecoders::count> decoders;
+
+        for( uint32 i = 0; i < LPDecoders::count; i++ )
+            decoders[i] = { LPDecoders::addDeltas[i], LPDecoders::decode[i] };
+
+        return decoders;
+    }();
+
+    const LPDecoder*& decoder = _lpDecoders[(int)table];
+
+    if( !decoder )
     {
-        const uint64 c2 = _c2Entries[i];
+        const uint32 stubBitSize = GetLPStubBitSize( table );
 
-        if( c2 > f7 || ++i >= _c2Entries.Length() )
+        decoder = &generic;
+        for( uint32 i = 0; i < LPDecoders::count; i++ )
         {
-            if( c2Index > 0 ) c2Index--;
-            break;
+            if( LPDecoders::stubBits[i] == stubBitSize )
+            {
+                decoder = &specialized[i];
+                break;
+            }
         }
-
-        c2Index++;
     }
 
-    const uint64 c1StartIndex = c2Index * kCheckpoint2Interval;
+    return *decoder;
+}
 
-    const uint32 k              = _plot.K();
-    const size_t f7SizeBytes    = CDiv( k, 8 );
-    const size_t f7BitCount     = f7SizeBytes * 8;
-    const uint64 c1TableAddress = _plot.TableAddress( PlotTable::C1 );
-    const size_t c1TableSize    = _plot.TableSize( PlotTable::C1 );
-    const uint64 c1TableEnd     = c1TableAddress + c1TableSize;
-    const uint64 c1EntryAddress = c1TableAddress + c1StartIndex * f7SizeBytes;
+//-----------------------------------------------------------
+bool PlotReader::ReadLPPark( TableId table, uint64 parkIndex, uint128 linePoints[kEntriesPerPark], uint64& outEntryCount )
+{
+    outEntryCount = 0;
 
+    const byte* stubBytes     = nullptr;
+    byte*       deltaBuffer   = nullptr;
+    uint128     baseLinePoint = 0;
+    uint64      deltaCount    = 0;
 
-    const uint64 c1EndAddress = std::min( c1EntryAddress + ( kCheckpoint1Interval * f7SizeBytes ), c1TableEnd );
+    if( !ReadLPParkComponents( table, parkIndex, stubBytes, deltaBuffer, baseLinePoint, deltaCount ) )
+        return false;
 
-    const size_t readSize     = c1EndAddress - c1EntryAddress;
-    const uint64 c1EntryCount = readSize / f7SizeBytes;
+    GetLPDecoder( table ).decode( baseLinePoint, stubBytes, deltaBuffer, deltaCount, GetLPStubBitSize( table ), linePoints );
 
-    if( c1EntryCount < 1 )
-        return {};
+    outEntryCount = deltaCount + 1;
+    return true;
+}
 
-    if( !_plot.Seek( SeekOrigin::Begin, (int64)c1EntryAddress ) )
-    {
-        Log::Error( "Seek to C1 address failed: %d", _plot.GetError() );
-        return {};
-    }
+//-----------------------------------------------------------
+bool PlotReader::ReadLPParks( const TableId table, const uint64 firstPark, const uint32 parkCount, IGpuParkDecoder& decoder,
+                              uint128* linePoints, uint64* outEntryCounts )
+{
+    ASSERT( parkCount <= decoder.MaxParks() );
 
-    // Read C1 entries until we find one equal or larger than the f7 we're looking for
+    // Only single FSE streams are decoded on the device
+    if( GetParkDeltaCoding( _plot.Flags() ) != ParkDeltaCoding::FSE )
+    {
+        for( uint32 i = 0; i < parkCount; i++ )
+        {
+            if( !ReadLPPark( table, firstPark + i, linePoints + (uint64)i * kEntriesPerPark, outEntryCounts[i] ) )
+                outEntryCounts[i] = 0;
+        }
+
+        return true;
+    }
+
+    // A batch doesn't fit in the park cache, so each park's sections are copied out as soon as it is read
+    const uint32 sectionStride = decoder.MaxSectionSize();
+    const size_t stubsStride   = GetLPStubByteSize( table );
+
+    byte*   sections     = decoder.Sections();
+    uint16* sectionSizes = decoder.SectionSizes();
+
+    std::vector<byte> stubs( (size_t)parkCount * stubsStride );
+
+    for( uint32 i = 0; i < parkCount; i++ )
+    {
+        LPParkSections park;
+
+        outEntryCounts[i] = 0;
+        sectionSizes  [i] = 0;
+
+        if( !GetLPParkSections( table, firstPark + i, park ) || park.deltasSize > sectionStride )
+            continue;
+
+        memcpy( sections + (size_t)i * sectionStride, park.deltas, park.deltasSize );
+        memcpy( stubs.data() + i * stubsStride, park.stubs, stubsStride );
+
+        sectionSizes[i]                        = park.deltasSize;
+        linePoints[(uint64)i * kEntriesPerPark] = park.baseLinePoint;
+        outEntryCounts[i]                       = 1;     // Read, pending its deltas
+    }
+
+    if( !decoder.Decode( GetDTableForTable( table ), parkCount ) )
+        return false;
+
+    const uint32     stubBitSize = GetLPStubBitSize( table );
+    const LPDecoder& lpDecoder   = GetLPDecoder( table );
+    const byte*      deltas      = decoder.Deltas();
+    const uint64* deltaCounts = decoder.DeltaCounts();
+
+    for( uint32 i = 0; i < parkCount; i++ )
+    {
+        const size_t deltaCount = (size_t)deltaCounts[i];
+
+        if( outEntryCounts[i] == 0 || FSE_isError( deltaCount ) )
+        {
+            outEntryCounts[i] = 0;
+            continue;
+        }
+
+        lpDecoder.decode( linePoints[(uint64)i * kEntriesPerPark], stubs.data() + i * stubsStride,
+                          deltas + (size_t)i * IGpuParkDecoder::MaxDeltasPerPark, deltaCount, stubBitSize,
+                          linePoints + (uint64)i * kEntriesPerPark );
+
+        outEntryCounts[i] = deltaCount + 1;
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------
+TableId PlotReader::GetLowestStoredTable() const
+{
+    const uint32 compressionLevel = _plot.CompressionLevel();
+
+    const uint32 numDroppedTables = compressionLevel == 0 ? 0 :
+                                    compressionLevel >= 9 ? 2 : 1;
+
+    return TableId::Table1 + numDroppedTables;
+}
+
+//-----------------------------------------------------------
+bool PlotReader::IsCompressedXTable( const TableId table ) const
+{
+    return _plot.CompressionLevel() > 0 && table == GetLowestStoredTable();
+}
+
+//-----------------------------------------------------------
+size_t PlotReader::GetParkSizeForTable( TableId table ) const
+{
+    if( IsCompressedXTable( table ) )
+        return GetCompressionInfoForLevel( _plot.CompressionLevel() ).tableParkSize;
+
+    if( table < GetLowestStoredTable() )
+    {
+        ASSERT(0);
+        return 0;
+    }
+
+    return CalculateParkSize( table, _plot.K() );
+}
+
+//-----------------------------------------------------------
+PlotParkLayout PlotReader::GetParkLayout( const size_t parkSize ) const
+{
+    return PlotParkLayout::Create( parkSize, _plot.HasAlignedParks() );
+}
+
+//-----------------------------------------------------------
+uint32 PlotReader::GetLPStubBitSize( TableId table ) const
+{
+    FatalIf( table < GetLowestStoredTable(), "Getting stub bit size for invalid table." );
+
+    if( !IsCompressedXTable( table ) )
+        return _plot.K() - kStubMinusBits;
+
+    auto info = GetCompressionInfoForLevel( _plot.CompressionLevel() );
+    return info.stubSizeBits;
+}
+
+//-----------------------------------------------------------
+uint32 PlotReader::GetLPStubByteSize( const TableId table ) const
+{
+    return CDiv( ( kEntriesPerPark - 1 ) * GetLPStubBitSize( table ), 8 );
+}
+
+//-----------------------------------------------------------
+size_t PlotReader::GetParkDeltasSectionMaxSize( const TableId table ) const
+{
+    if( !IsCompressedXTable( table ) )
+        return CalculateMaxDeltasSize( table );
+
+    auto info = GetCompressionInfoForLevel( _plot.CompressionLevel() );
+
+    const uint32 lpSize       = CDiv( _plot.K() * 2u, 8 );
+    const uint32 stubByteSize = GetLPStubByteSize( table );
+    
+    return info.tableParkSize - ( lpSize + stubByteSize );
+}
+
+// #TODO: Add 64-bit outLinePoint (templatize)
+//-----------------------------------------------------------
+bool PlotReader::ReadLP( TableId table, uint64 index, uint128& outLinePoint )
+{
+    outLinePoint = 0;
+
+    const byte* stubBytes     = nullptr;
+    byte*       deltaBuffer   = nullptr;
+    uint128     baseLinePoint = 0;
+    uint64      deltaCount    = 0;
+
+    const uint64 parkIndex  = index / kEntriesPerPark;
+
+    if( !ReadLPParkComponents( table, parkIndex, stubBytes, deltaBuffer, baseLinePoint, deltaCount ) )
+        return false;
+
+    const uint64 lpLocalIdx = index - parkIndex * kEntriesPerPark;
+
+    if( lpLocalIdx > 0 )
+    {
+        if( lpLocalIdx-1 >= deltaCount )
+            return false;
+
+        baseLinePoint = GetLPDecoder( table ).addDeltas( baseLinePoint, stubBytes, deltaBuffer, std::min( lpLocalIdx, deltaCount ), GetLPStubBitSize( table ) );
+    }
+
+    outLinePoint = baseLinePoint;
+    return true;
+}
+
+//-----------------------------------------------------------
+bool PlotReader::ReadLPPair( TableId table, const uint64 indices[2], uint128 outLinePoints[2] )
+{
+    LPParkSections parks[2];
+    uint64         parkIndices[2];
+
+    // Both parks remain in the park cache, as the one read first is the most recently used
+    for( uint32 i = 0; i < 2; i++ )
+    {
+        parkIndices[i] = indices[i] / kEntriesPerPark;
+
+        if( !GetLPParkSections( table, parkIndices[i], parks[i] ) )
+            return false;
+    }
+
+    byte* const  deltaBuffers[2] = { _deltasBuffer, _pairDeltasBuffer };
+    const size_t deltaCapacity[2] = { kEntriesPerPark - 1, kEntriesPerPark - 1 };
+    const byte*  compressed[2]    = { parks[0].deltas, parks[1].deltas };
+    const size_t compressedSize[2] = { parks[0].deltasSize, parks[1].deltasSize };
+    size_t       deltaCounts[2];
+
+    // Interleaved and rANS parks have enough streams to overlap their lookups on their own
+    if( GetParkDeltaCoding( _plot.Flags() ) != ParkDeltaCoding::FSE )
+    {
+        for( uint32 i = 0; i < 2; i++ )
+            deltaCounts[i] = DecompressLPDeltas( table, parks[i], deltaBuffers[i] );
+    }
+    else
+        FSEDecompressX2( GetDTableForTable( table ), deltaBuffers, deltaCapacity, compressed, compressedSize, deltaCounts );
+
+    const uint32     stubBitSize = GetLPStubBitSize( table );
+    const LPDecoder& lpDecoder   = GetLPDecoder( table );
+
+    for( uint32 i = 0; i < 2; i++ )
+    {
+        if( FSE_isError( deltaCounts[i] ) )
+            return false;
+
+        const uint64 lpLocalIdx = indices[i] - parkIndices[i] * kEntriesPerPark;
+
+        outLinePoints[i] = parks[i].baseLinePoint;
+
+        if( lpLocalIdx > 0 )
+        {
+            if( lpLocalIdx-1 >= deltaCounts[i] )
+                return false;
+
+            outLinePoints[i] = lpDecoder.addDeltas( parks[i].baseLinePoint, parks[i].stubs, deltaBuffers[i], lpLocalIdx, stubBitSize );
+        }
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------
+bool PlotReader::FetchProofFromP7Entry( uint64 p7Entry, uint64 proof[32] )
+{
+    // #TODO: Implement me
+    ASSERT( 0 );
+    return false;
+}
+
+//-----------------------------------------------------------
+int64 PlotReader::ReadC3ParkCached( const uint64 parkIndex, uint64* f7Buffer )
+{
+    if( _index )
+    {
+        const int64 count = _index->GetHotC3Park( parkIndex, f7Buffer );
+        if( count >= 0 )
+            return count;
+    }
+
+    const int64 count = ReadC3Park( parkIndex, f7Buffer );
+
+    if( count > 0 && _index )
+        _index->PutHotC3Park( parkIndex, f7Buffer, (uint64)count );
+
+    return count;
+}
+
+//-----------------------------------------------------------
+bool PlotReader::FindC3ParkForF7( const uint64 f7, uint64& outC3Park, uint32& outParkCount )
+{
+    if( !LoadC2Entries() )
+        return false;
+
+    uint64 c2Index = 0;
+
+    for( uint64 i = 0; ; )
+    {
+        const uint64 c2 = _c2Entries[i];
+
+        if( c2 > f7 || ++i >= _c2Entries.Length() )
+        {
+            if( c2Index > 0 ) c2Index--;
+            break;
+        }
+
+        c2Index++;
+    }
+
+    const uint64 c1StartIndex = c2Index * kCheckpoint2Interval;
+
+    const uint32 k              = _plot.K();
+    const size_t f7SizeBytes    = CDiv( k, 8 );
+    const size_t f7BitCount     = f7SizeBytes * 8;
+    const uint64 c1TableAddress = _plot.TableAddress( PlotTable::C1 );
+    const size_t c1TableSize    = _plot.TableSize( PlotTable::C1 );
+    const uint64 c1TableEnd     = c1TableAddress + c1TableSize;
+    const uint64 c1EntryAddress = c1TableAddress + c1StartIndex * f7SizeBytes;
+
+
+    const uint64 c1EndAddress = std::min( c1EntryAddress + ( kCheckpoint1Interval * f7SizeBytes ), c1TableEnd );
+
+    const size_t readSize     = c1EndAddress - c1EntryAddress;
+    const uint64 c1EntryCount = readSize / f7SizeBytes;
+
+    if( c1EntryCount < 1 )
+        return false;
+
+    // Read C1 entries until we find one equal or larger than the f7 we're looking for
     if( !_c1Buffer )
         _c1Buffer = bbcvirtallocbounded<byte>( kCheckpoint1Interval * f7SizeBytes );
-    
-    if( _plot.Read( readSize, _c1Buffer ) != (ssize_t)readSize )
+
+    const PlotReadRequest c1Read = { c1EntryAddress, readSize, _c1Buffer };
+    if( !_plot.ReadBatch( &c1Read, 1 ) )
     {
         Log::Error( "Failed to read C1 entries: %d", _plot.GetError() );
-        return {};
+        return false;
     }
 
     CPBitReader reader( _c1Buffer, readSize * 8 );
@@ -619,24 +1135,72 @@ uint64 PlotReader::GetP7IndicesForF7( const uint64 f7, uint64& outStartT6Index )
         c3Park++;
     }
 
-    const uint64 parkCount = c1 == f7 && c3Park > 0 ? 2 : 1; // If we got the same c1 as f7, then the previous
-                                                             // needs to be read as well because we may have duplicate f7s
-                                                             // in the previous park's last entries.
-        
+    outParkCount = c1 == f7 && c3Park > 0 ? 2 : 1; // If we got the same c1 as f7, then the previous
+                                                   // needs to be read as well because we may have duplicate f7s
+                                                   // in the previous park's last entries.
+    outC3Park = c3Park;
+    return true;
+}
+
+//-----------------------------------------------------------
+uint64 PlotReader::GetP7IndicesForF7( const uint64 f7, uint64& outStartT6Index )
+{
+    if( !_indexLoaded )
+    {
+        _index       = PlotIndexCache::Get( _plot );
+        _indexLoaded = true;
+    }
+
+    uint64 c3Park    = 0;
+    uint32 parkCount = 1;
+
+    if( _index )
+        c3Park = _index->FindC3Park( f7, parkCount );
+    else if( !FindC3ParkForF7( f7, c3Park, parkCount ) )
+        return 0;
+
+    // Hot parks are kept whole, so only decode the park up to the f7 when there are none to fill
+    if( !_index || !_index->HasHotC3Parks() )
+    {
+        uint64 first = 0, matchCount = 0;
+
+        const int64 visited = FindF7sInC3Park( c3Park, &f7, 1, &first, &matchCount );
+        if( visited < 0 )
+            return 0;
+
+        outStartT6Index = c3Park * kCheckpoint1Interval + first;
+
+        // Duplicates of the f7 may go on at the start of the next park
+        if( parkCount > 1 && ( matchCount == 0 || first + matchCount == (uint64)visited ) )
+        {
+            uint64 nextFirst = 0, nextCount = 0;
+
+            if( FindF7sInC3Park( c3Park+1, &f7, 1, &nextFirst, &nextCount ) < 0 )
+                return 0;
+
+            if( matchCount == 0 )
+                outStartT6Index = ( c3Park+1 ) * kCheckpoint1Interval + nextFirst;
+
+            matchCount += nextCount;
+        }
+
+        return matchCount;
+    }
+
     if( _c3Buffer.Ptr() == nullptr )
     {
         _c3Buffer.values = bbcvirtallocbounded<uint64>( kCheckpoint1Interval * 2 );
         _c3Buffer.length = kCheckpoint1Interval * 2;
     }
 
-    int64 c3Count = ReadC3Park( c3Park, _c3Buffer.Ptr() );
+    int64 c3Count = ReadC3ParkCached( c3Park, _c3Buffer.Ptr() );
     if( c3Count < 0)
         return {};
 
     if( parkCount > 1 )
     {
         ASSERT( parkCount == 2 );
-        const int64 secondParkC3Count = ReadC3Park( c3Park+1, _c3Buffer.Ptr() + c3Count );
+        const int64 secondParkC3Count = ReadC3ParkCached( c3Park+1, _c3Buffer.Ptr() + c3Count );
         if( secondParkC3Count < 0 )
             return {};
 
@@ -687,25 +1251,36 @@ ProofFetchResult PlotReader::FetchProof( const uint64 t6LPIndex, uint64 fullProo
 
         const bool use64BitLP = table < TableId::Table6 && _plot.K() <= 32;
 
-        for( uint32 i = 0, dst = 0; i < lookupCount; i++, dst += 2 )
+        // Every index at this level is known up front, so read all of their parks at once
+        uint64 parkIndices[BB_PLOT_PROOF_X_COUNT];
+        for( uint32 i = 0; i < lookupCount; i++ )
+            parkIndices[i] = lpIdxSrc[i] / kEntriesPerPark;
+
+        PrefetchLPParks( table, parkIndices, lookupCount );
+
+        // Line points are read two at a time, decoding the deltas of both parks at once
+        for( uint32 i = 0; i < lookupCount; i += 2 )
         {
-            const uint64 idx = lpIdxSrc[i];
+            uint128      lps[2]  = {};
+            const uint32 lpCount = std::min( 2u, lookupCount - i );
 
-            uint128 lp = 0;
-            if( !ReadLP( table, idx, lp ) )
+            if( lpCount == 2 ? !ReadLPPair( table, lpIdxSrc + i, lps ) : !ReadLP( table, lpIdxSrc[i], lps[0] ) )
                 return ProofFetchResult::Error;
 
-            const BackPtr ptr = use64BitLP ? LinePointToSquare64( (uint64)lp ) : LinePointToSquare( lp );
+            for( uint32 j = 0; j < lpCount; j++ )
+            {
+                const BackPtr ptr = use64BitLP ? LinePointToSquare64( (uint64)lps[j] ) : LinePointToSquare( lps[j] );
 
-            ASSERT( ptr.x > ptr.y );
-            lpIdxDst[dst+0] = ptr.y;
-            lpIdxDst[dst+1] = ptr.x;
+                ASSERT( ptr.x > ptr.y );
+                lpIdxDst[(i+j)*2+0] = ptr.y;
+                lpIdxDst[(i+j)*2+1] = ptr.x;
+            }
         }
 
         lookupCount <<= 1;
 
         std::swap( lpIdxSrc, lpIdxDst );
-        // memset( lpIdxDst, 0, sizeof( uint64 ) * PROOF_X_COUNT );
+        // memset( lpIdxDst, 0, sizeof( uint64 ) * BB_PLOT_PROOF_X_COUNT );
     }
 
     const uint32  finalIndex = ((uint32)(endTable - TableId::Table1)) % 2;
@@ -732,12 +1307,16 @@ ProofFetchResult PlotReader::DecompressProof( const uint64 compressedProof[BB_PL
     req.plotId           = _plot.PlotId();
     req.compressionLevel = compressionLevel;
 
-    const uint32 compressedProofCount = compressionLevel < 9 ? PROOF_X_COUNT / 2 : PROOF_X_COUNT / 4;
+    const uint32 compressedProofCount = compressionLevel < 9 ? BB_PLOT_PROOF_X_COUNT / 2 : BB_PLOT_PROOF_X_COUNT / 4;
 
     for( uint32 i = 0; i < compressedProofCount; i++ )
         req.compressedProof[i] = compressedProof[i];
 
-    const GRResult r = grFetchProofForChallenge( gr, &req );
+    GRResult r;
+    {
+        auto lock = LockGRContext();
+        r = grFetchProofForChallenge( gr, &req );
+    }
 
     if( r == GRResult_OK )
     {
@@ -754,65 +1333,174 @@ ProofFetchResult PlotReader::FetchQualityXsForP7Entry(
     const byte    challenge[BB_CHIA_CHALLENGE_SIZE], 
           uint64& outX1, uint64& outX2 )
 {
-    const bool    isCompressed = _plot.CompressionLevel() > 0;
-    const TableId endTable     = GetLowestStoredTable();
+    ProofFetchResult r;
+    FetchQualityXsForP7Entries( &t6Index, 1, challenge, &outX1, &outX2, &r );
 
-    GreenReaperContext* gr = nullptr;
-    if( isCompressed )
+    return r;
+}
+
+//-----------------------------------------------------------
+void PlotReader::FetchQualityXsForP7Entries( 
+    const uint64*           t6Indices,
+    const uint32            count,
+    const byte              challenge[BB_CHIA_CHALLENGE_SIZE],
+          uint64*           outX1,
+          uint64*           outX2,
+          ProofFetchResult* outResults )
+{
+    for( uint32 offset = 0; offset < count; offset += QUALITY_BATCH_SIZE )
     {
-        gr = GetGRContext();
-        if( !gr )
-            return ProofFetchResult::Error;
-    }
+        const uint32 batchCount = std::min( count - offset, QUALITY_BATCH_SIZE );
+
+        FetchQualityXsBatch( t6Indices + offset, batchCount, challenge, outX1 + offset, outX2 + offset, outResults + offset );
+    }
+}
+
+//-----------------------------------------------------------
+void PlotReader::FetchQualityXsBatch( 
+    const uint64*           t6Indices,
+    const uint32            count,
+    const byte              challenge[BB_CHIA_CHALLENGE_SIZE],
+          uint64*           outX1,
+          uint64*           outX2,
+          ProofFetchResult* outResults )
+{
+    ASSERT( count <= QUALITY_BATCH_SIZE );
+
+    const bool    isCompressed = _plot.CompressionLevel() > 0;
+    const TableId endTable     = GetLowestStoredTable();
+
+    GreenReaperContext* gr = nullptr;
+    if( isCompressed )
+    {
+        gr = GetGRContext();
+        if( !gr )
+        {
+            for( uint32 i = 0; i < count; i++ )
+                outResults[i] = ProofFetchResult::Error;
+            return;
+        }
+    }
 
     const uint32 last5Bits = (uint32)challenge[31] & 0x1f;
 
-    uint64 lpIndex  = t6Index; 
-    uint64 altIndex = 0;
+    uint64 lpIndices [QUALITY_BATCH_SIZE];
+    uint64 altIndices[QUALITY_BATCH_SIZE] = {};
+    uint64 parks     [QUALITY_BATCH_SIZE*2];
 
-    for( TableId table = TableId::Table6; table > endTable; table-- )
+    for( uint32 i = 0; i < count; i++ )
     {
-        // Read line point
-        uint128 lp;
-        if( !ReadLP( table, lpIndex, lp ) )
-            return ProofFetchResult::Error;
+        lpIndices [i] = t6Indices[i];
+        outResults[i] = ProofFetchResult::OK;
+    }
 
+    // All entries walk down the tables together, so that
+    // the parks each table needs are read in a single batch
+    for( TableId table = TableId::Table6; table > endTable; table-- )
+    {
+        uint32 parkCount = 0;
+        for( uint32 i = 0; i < count; i++ )
+        {
+            if( outResults[i] == ProofFetchResult::OK )
+                parks[parkCount++] = lpIndices[i] / kEntriesPerPark;
+        }
 
-        const bool    use64BitLP = table < TableId::Table6 && _plot.K() <= 32;
-        const BackPtr ptr        = use64BitLP ? LinePointToSquare64( (uint64)lp ) : LinePointToSquare( lp );
-        ASSERT( ptr.x >= ptr.y );
+        PrefetchLPParks( table, parks, parkCount );
 
+        const bool use64BitLP    = table < TableId::Table6 && _plot.K() <= 32;
         const bool isTableBitSet = ((last5Bits >> ((uint32)table-1)) & 1) == 1;
 
-        if( !isTableBitSet )
+        for( uint32 i = 0; i < count; i++ )
+        {
+            if( outResults[i] != ProofFetchResult::OK )
+                continue;
+
+            // Read line point
+            uint128 lp;
+            if( !ReadLP( table, lpIndices[i], lp ) )
+            {
+                outResults[i] = ProofFetchResult::Error;
+                continue;
+            }
+
+            const BackPtr ptr = use64BitLP ? LinePointToSquare64( (uint64)lp ) : LinePointToSquare( lp );
+            ASSERT( ptr.x >= ptr.y );
+
+            if( !isTableBitSet )
+            {
+                lpIndices [i] = ptr.y;
+                altIndices[i] = ptr.x;
+            }
+            else
+            {
+                lpIndices [i] = ptr.x;
+                altIndices[i] = ptr.y;
+            }
+        }
+    }
+
+    // Read both back pointers, depending on compression level
+    const bool needBothLeaves = isCompressed && _plot.CompressionLevel() >= 6;
+
+    {
+        uint32 parkCount = 0;
+        for( uint32 i = 0; i < count; i++ )
         {
-            lpIndex  = ptr.y;
-            altIndex = ptr.x;
+            if( outResults[i] != ProofFetchResult::OK )
+                continue;
+
+            parks[parkCount++] = lpIndices[i] / kEntriesPerPark;
+
+            if( needBothLeaves )
+                parks[parkCount++] = altIndices[i] / kEntriesPerPark;
         }
-        else
+
+        PrefetchLPParks( endTable, parks, parkCount );
+    }
+
+    if( !isCompressed )
+    {
+        for( uint32 i = 0; i < count; i++ )
         {
-            lpIndex  = ptr.x;
-            altIndex = ptr.y;
+            if( outResults[i] != ProofFetchResult::OK )
+                continue;
+
+            uint128 lp;
+            if( !ReadLP( endTable, lpIndices[i], lp ) )
+            {
+                outResults[i] = ProofFetchResult::Error;
+                continue;
+            }
+
+            const BackPtr ptr = _plot.K() <= 32 ? LinePointToSquare64( (uint64)lp ) : LinePointToSquare( lp );
+            outX1[i] = ptr.x;
+            outX2[i] = ptr.y;
         }
+
+        return;
     }
 
-    if( isCompressed )
+    GRCompressedQualitiesRequest reqs      [QUALITY_BATCH_SIZE];
+    GRResult                     reqResults[QUALITY_BATCH_SIZE];
+    uint32                       reqEntries[QUALITY_BATCH_SIZE];
+    uint32                       reqCount = 0;
+
+    for( uint32 i = 0; i < count; i++ )
     {
-        const bool needBothLeaves = _plot.CompressionLevel() >= 6;
+        if( outResults[i] != ProofFetchResult::OK )
+            continue;
 
-        // Read both back pointers, depending on compression level
         uint128 xLP0, xLP1;
-        if( !ReadLP( endTable, lpIndex, xLP0 ) )
-            return ProofFetchResult::Error;
-
-        if( needBothLeaves )
+        if( !ReadLP( endTable, lpIndices[i], xLP0 ) ||
+            ( needBothLeaves && !ReadLP( endTable, altIndices[i], xLP1 ) ) )
         {
-            if( !ReadLP( endTable, altIndex, xLP1 ) )
-                return ProofFetchResult::Error;
+            outResults[i] = ProofFetchResult::Error;
+            continue;
         }
 
         // Now decompress the X's
-        GRCompressedQualitiesRequest req = {};
+        GRCompressedQualitiesRequest& req = reqs[reqCount];
+        req = {};
         req.plotId                = _plot.PlotId();
         req.compressionLevel      = _plot.CompressionLevel();
         req.challenge             = challenge;
@@ -825,27 +1513,43 @@ ProofFetchResult PlotReader::FetchQualityXsForP7Entry(
             req.xLinePoints[1].lo = (uint64)xLP1;
         }
 
-        const auto r = grGetFetchQualitiesXPair( gr, &req );
-        if( r != GRResult_OK )
-            return r == GRResult_NoProof ? ProofFetchResult::NoProof : ProofFetchResult::CompressionError;
-
-        outX1 = req.x1;
-        outX2 = req.x2;
+        reqEntries[reqCount++] = i;
     }
-    else
+
+    if( reqCount > 0 )
     {
-        uint128 lp;
-        if( !ReadLP( endTable, lpIndex, lp ) )
-            return ProofFetchResult::Error;
+        auto lock = LockGRContext();
 
-        const BackPtr ptr = _plot.K() <= 32 ? LinePointToSquare64( (uint64)lp ) : LinePointToSquare( lp );
-        outX1 = ptr.x;
-        outX2 = ptr.y;
+        if( reqCount == 1 )
+            reqResults[0] = grGetFetchQualitiesXPair( gr, &reqs[0] );
+        else
+        {
+            const GRResult r = grFetchQualitiesXPairBatch( gr, reqs, reqResults, reqCount );
+            if( r != GRResult_OK )
+            {
+                for( uint32 i = 0; i < reqCount; i++ )
+                    reqResults[i] = r;
+            }
+        }
     }
 
-    return ProofFetchResult::OK;
+    for( uint32 i = 0; i < reqCount; i++ )
+    {
+        const uint32   entry = reqEntries[i];
+        const GRResult r     = reqResults[i];
+
+        if( r != GRResult_OK )
+        {
+            outResults[entry] = r == GRResult_NoProof ? ProofFetchResult::NoProof : ProofFetchResult::CompressionError;
+            continue;
+        }
+
+        outX1[entry] = reqs[i].x1;
+        outX2[entry] = reqs[i].x2;
+    }
 }
 
+#if !defined( BB_IS_HARVESTER )
 //-----------------------------------------------------------
 ProofFetchResult PlotReader::FetchQualityForP7Entry( 
     const uint64 t6Index, 
@@ -875,6 +1579,7 @@ ProofFetchResult PlotReader::FetchQualityForP7Entry(
 
     return r;
 }
+#endif
 
 //-----------------------------------------------------------
 bool PlotReader::LoadC2Entries()
@@ -898,134 +1603,564 @@ bool PlotReader::LoadC2Entries()
    
     byte* buffer = bbvirtallocbounded<byte>( c2Size );
 
-    if( _plot.Read( c2Size, buffer ) != (ssize_t)c2Size )
+    if( _plot.Read( c2Size, buffer ) != (ssize_t)c2Size )
+    {
+        bbvirtfreebounded( buffer );
+        return false;
+    }
+
+    _c2Entries = Span<uint64>( new uint64[c2MaxEntries], c2MaxEntries );
+
+    const size_t f7BitCount = f7ByteSize * 8;
+    CPBitReader reader( buffer, c2Size * 8 );
+    reader.ReadN( (uint32)f7BitCount, c2MaxEntries, _c2Entries.Ptr() );
+
+    // Stop at the first unsorted/out-of-order c2 entry
+    uint64 i = 1;
+    while( i < c2MaxEntries && _c2Entries[i] >= _c2Entries[i-1] )
+        i++;
+
+    _c2Entries.length = i;
+
+    bbvirtfreebounded( buffer );
+    return true;
+}
+
+//-----------------------------------------------------------
+void PlotReader::AssignDecompressionContext( struct GreenReaperContext* context, std::mutex* contextLock )
+{
+    ASSERT( context );
+    if( !context)
+        return;
+
+    if( _grContext && _ownsGrContext )
+        grDestroyContext( _grContext );
+    
+    _grContext     = context;
+    _ownsGrContext = false;
+    _grContextLock = contextLock;
+}
+
+//-----------------------------------------------------------
+void PlotReader::ConfigDecompressor( const uint32 threadCount, const bool disableCPUAffinity, const uint32 cpuOffset, bool useGpu, int gpuIndex )
+{
+    if( _grContext && _ownsGrContext )
+        grDestroyContext( _grContext );
+
+    _grContext     = nullptr;
+    _ownsGrContext = true;
+    _grContextLock = nullptr;
+
+    GreenReaperConfig cfg = {};
+    cfg.apiVersion         = GR_API_VERSION;
+    cfg.threadCount        = bbclamp( threadCount, 1u, SysHost::GetLogicalCPUCount() );
+    cfg.cpuOffset          = cpuOffset;
+    cfg.disableCpuAffinity = disableCPUAffinity ? GR_TRUE : GR_FALSE;
+    cfg.gpuRequest         = !useGpu ? GRGpuRequestKind_None : 
+                                gpuIndex >= 0 ? GRGpuRequestKind_ExactDevice : GRGpuRequestKind_FirstAvailable;
+    cfg.gpuDeviceIndex     = gpuIndex < 0 ? 0 : gpuIndex;
+
+    auto result = grCreateContext( &_grContext, &cfg, sizeof( GreenReaperConfig ) );
+    ASSERT( result == GRResult_OK );
+}
+
+//-----------------------------------------------------------
+GreenReaperContext* PlotReader::GetGRContext()
+{
+    if( _grContext == nullptr )
+    {
+        GreenReaperConfig cfg = {};
+        cfg.apiVersion  = GR_API_VERSION;
+        cfg.threadCount = std::min( 8u, SysHost::GetLogicalCPUCount() );
+
+        auto result = grCreateContext( &_grContext, &cfg, sizeof( GreenReaperConfig ) );
+        ASSERT( result == GRResult_OK );
+
+        _ownsGrContext = true;
+    }
+
+    return _grContext;
+}
+
+///
+/// Memory Plot
+///
+//-----------------------------------------------------------
+MemoryPlot::MemoryPlot()
+    : _bytes( nullptr, 0 )
+{}
+
+//-----------------------------------------------------------
+MemoryPlot::MemoryPlot( const MemoryPlot& plotFile )
+    : _bytes( nullptr, 0 )
+{
+    _err      = 0;
+    _position = 0;
+
+    if( !plotFile.IsOpen() )
+        return;
+
+    _file  = plotFile._file;
+    _bytes = plotFile._bytes;
+
+    int headerError = 0;
+    if( !ReadHeader( headerError ) )
+    {
+        if( headerError )
+            _err = headerError;
+
+        if( _err == 0 )
+            _err = -1; // #TODO: Set generic plot header read error
+
+        _file.reset();
+        _bytes = Span<byte>( nullptr, 0 );
+        return;
+    }
+
+    _position = 0;
+    _plotPath = plotFile._plotPath;
+}
+
+//-----------------------------------------------------------
+MemoryPlot::~MemoryPlot()
+{
+    // The mapping is released along with its last plot
+    _file.reset();
+    _bytes = Span<byte>( nullptr, 0 );
+}
+
+//-----------------------------------------------------------
+bool MemoryPlot::Open( const char* path )
+{
+    ASSERT( path );
+    if( !path )
+        return false;
+
+    if( IsOpen() )
+        return false;
+
+    auto file = std::make_shared<MappedFileStream>();
+    if( !file->Open( path ) )
+    {
+        _err = file->GetError();
+        return false;
+    }
+
+    _file     = file;
+    _bytes    = Span<byte>( (byte*)file->Data(), (size_t)file->Size() );
+    _position = 0;
+
+    // Read the header
+    int headerError = 0;
+    if( !ReadHeader( headerError ) )
+    {
+        if( headerError )
+            _err = headerError;
+
+        if( _err == 0 )
+            _err = -1; // #TODO: Set generic plot header read error
+
+        _file.reset();
+        _bytes = Span<byte>( nullptr, 0 );
+        return false;
+    }
+
+    // Save data, good to go
+    _plotPath = path;
+
+    return true;
+}
+
+//-----------------------------------------------------------
+bool MemoryPlot::Prefetch( ThreadPool& pool, const uint32 threadCount )
+{
+    if( !IsOpen() )
+        return false;
+
+    if( !_file->Prefetch( pool, threadCount ) )
+    {
+        _err = _file->GetError();
+        return false;
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------
+bool MemoryPlot::IsOpen() const
+{
+    return _bytes.values != nullptr;
+}
+
+//-----------------------------------------------------------
+size_t MemoryPlot::PlotSize() const
+{
+    return _bytes.length;
+}
+
+//-----------------------------------------------------------
+bool MemoryPlot::Seek( SeekOrigin origin, int64 offset )
+{
+    ssize_t absPosition = 0;
+
+    switch( origin )
+    {
+        case SeekOrigin::Begin:
+            absPosition = offset;
+            break;
+
+        case SeekOrigin::Current:
+            absPosition = _position + offset;
+            break;
+
+        case SeekOrigin::End:
+            absPosition = (ssize_t)_bytes.length + offset;
+            break;
+    
+        default:
+            _err =  -1;     // #TODO: Set proper user error.
+            return false;
+    }
+
+    if( absPosition < 0 || absPosition > (ssize_t)_bytes.length )
+    {
+        _err =  -1;     // #TODO: Set proper user error.
+        return false;
+    }
+
+    _position = absPosition;
+    return true;
+}
+
+//-----------------------------------------------------------
+ssize_t MemoryPlot::Read( size_t size, void* buffer )
+{
+    if( size < 1 || !buffer )
+        return 0;
+
+    ASSERT( buffer );
+
+    const size_t endPos = (size_t)_position + size;
+
+    if( endPos > _bytes.length )
+    {
+        _err = -1; // #TODO: Set proper user error
+        return false;
+    }
+
+    memcpy( buffer, _bytes.values + _position, size );
+    _position   = (ssize_t)endPos;
+    _bytesRead += size;
+
+    return (ssize_t)size;
+}
+
+//-----------------------------------------------------------
+int MemoryPlot::GetError() 
+{
+    return _err;
+}
+
+//-----------------------------------------------------------
+const byte* MemoryPlot::MappedData() const
+{
+    return _bytes.values;
+}
+
+
+
+///
+/// FilePlot
+///
+//-----------------------------------------------------------
+FilePlot::FilePlot()
+{
+
+}
+
+//-----------------------------------------------------------
+FilePlot::FilePlot( const FilePlot& file )
+{
+    if( file.IsOpen() )
+        Open( file._plotPath.c_str() ); // #TODO: Seek to same location
+    else
+        _plotPath = "";
+}
+
+//-----------------------------------------------------------
+FilePlot::~FilePlot()
+{
+    if( _directBuffer.Ptr() )
+        bbvirtfree_span( _directBuffer );
+}
+
+//-----------------------------------------------------------
+bool FilePlot::Open( const char* path )
+{
+    if( !_file.Open( path, FileMode::Open, FileAccess::Read, FileFlags::None ) )
+        return false;
+
+    // Read the header
+    int headerError = 0;
+    if( !ReadHeader( headerError ) )
+    {
+        // if( headerError )
+        //     _err = headerError; // #TODO: Set local error
+
+        // if( _err == 0 )
+        //     _err = -1; // #TODO: Set generic plot header read error
+        _file.Close();
+        return false;
+    }
+
+    // Parks span no more pages than they need, so they can be read directly without read amplification.
+    // Not all file systems support direct I/O, in which case parks are read through the page cache.
+    _directFile.Close();
+    if( HasAlignedParks() )
+        _directFile.Open( path, FileMode::Open, FileAccess::Read, FileFlags::NoBuffering );
+
+    _readScheduler = PlotReadScheduler::ForPath( path );
+
+    _plotPath = path;
+    return true;
+}
+
+//-----------------------------------------------------------
+bool FilePlot::IsOpen() const
+{
+    return _file.IsOpen();
+}
+
+//-----------------------------------------------------------
+size_t FilePlot::PlotSize() const
+{
+    const ssize_t sz = ((FileStream*)&_file)->Size();
+    if( sz < 0 )
+        return 0;
+
+    return (size_t)sz;
+}
+
+//-----------------------------------------------------------
+ssize_t FilePlot::Read( size_t size, void* buffer )
+{
+    if( size > (size_t)std::numeric_limits<ssize_t>::max() )
+        size = (size_t)std::numeric_limits<ssize_t>::max();
+
+    int error = 0;
+    if( !IOJob::ReadFromFileUnaligned( _file, buffer, size, error ) )
+    {
+        size = 0;
+        (void)error;
+        Log::Error( "Failed to read from plot with error %d", error );
+    }
+
+    _bytesRead += size;
+    return (ssize_t)size;
+}
+
+//-----------------------------------------------------------
+bool FilePlot::Seek( SeekOrigin origin, int64 offset )
+{
+    return _file.Seek( offset, origin );
+}
+
+//-----------------------------------------------------------
+int FilePlot::GetError()
+{
+    return _file.GetError();
+}
+
+//-----------------------------------------------------------
+bool FilePlot::ReadBatch( const PlotReadRequest* requests, const uint32 count )
+{
+    if( _readScheduler )
+    {
+        if( !_readScheduler->Read( _directFile.IsOpen() ? _directFile : _file, requests, count ) )
+            return false;
+
+        for( uint32 i = 0; i < count; i++ )
+            _bytesRead += requests[i].size;
+
+        return true;
+    }
+
+    if( _directFile.IsOpen() )
+        return ReadBatchDirect( requests, count );
+
+#if BB_HAS_FILE_IO_BATCH
+    if( count > 1 && !_ioBatch && !_ioBatchFailed )
+    {
+        _ioBatch = std::make_unique<FileIOBatch>();
+
+        if( !_ioBatch->Init( BB_PLOT_PROOF_X_COUNT ) )
+        {
+            _ioBatch.reset();
+            _ioBatchFailed = true;
+        }
+    }
+
+    if( count > 1 && _ioBatch )
+    {
+        size_t totalSize = 0;
+        for( uint32 i = 0; i < count; i++ )
+        {
+            _ioBatch->Read( _file, requests[i].buffer, requests[i].size, requests[i].offset );
+            totalSize += requests[i].size;
+        }
+
+        int error = 0;
+        if( !_ioBatch->Submit( error ) )
+        {
+            Log::Error( "Failed to read from plot with error %d", error );
+            return false;
+        }
+
+        // Reads that reached the end of the file come back short
+        for( uint32 i = 0; i < count; i++ )
+        {
+            if( _ioBatch->BytesTransferred( i ) != requests[i].size )
+                return false;
+        }
+
+        _bytesRead += totalSize;
+        return true;
+    }
+#endif
+
+    return IPlotFile::ReadBatch( requests, count );
+}
+
+//-----------------------------------------------------------
+bool FilePlot::ReadBatchDirect( const PlotReadRequest* requests, const uint32 count )
+{
+    const size_t blockSize = _directFile.BlockSize();
+
+    // Each request is read whole blocks at a time into the bounce buffer, then copied out
+    size_t bufferSize = 0;
+    for( uint32 i = 0; i < count; i++ )
     {
-        bbvirtfreebounded( buffer );
-        return false;
+        const uint64 start = requests[i].offset / blockSize * blockSize;
+        bufferSize += RoundUpToNextBoundaryT( (size_t)( requests[i].offset + requests[i].size - start ), blockSize );
     }
 
-    _c2Entries = Span<uint64>( new uint64[c2MaxEntries], c2MaxEntries );
-
-    const size_t f7BitCount = f7ByteSize * 8;
-    CPBitReader reader( buffer, c2Size * 8 );
-
-    uint64 prevF7 = 0;
-    uint64 i;
-    for( i = 0; i < c2MaxEntries; i++ )
+    if( bufferSize > _directBuffer.Length() )
     {
-        const uint64 f7 = reader.Read64( (uint32)f7BitCount );
-        
-        // Short circuit if we encounter an unsorted/out-of-order c2 entry
-        if( f7 < prevF7 )
-            break;
+        if( _directBuffer.Ptr() )
+            bbvirtfree_span( _directBuffer );
 
-        _c2Entries[i] = f7;
-        prevF7 = f7;
+        const size_t allocSize = RoundUpToNextBoundaryT( std::max( bufferSize, (size_t)( 64 KiB ) ), blockSize );
+        _directBuffer = Span<byte>( bbvirtalloc<byte>( allocSize ), allocSize );
     }
 
-    _c2Entries.length = i;
+    // The end of the file might not be block-aligned, so reads of the last block may come back short.
+    // They only fail if they don't reach the end of the request.
+    auto readDirect = [&]( const uint32 i, byte* dst, const uint64 start, const size_t size ) {
 
-    bbvirtfreebounded( buffer );
-    return true;
-}
+        if( !_directFile.Seek( (int64)start, SeekOrigin::Begin ) )
+            return false;
 
-//-----------------------------------------------------------
-void PlotReader::AssignDecompressionContext( struct GreenReaperContext* context )
-{
-    ASSERT( context );
-    if( !context)
-        return;
+        const ssize_t sizeRead = _directFile.Read( dst, size );
+        return sizeRead >= 0 && start + (uint64)sizeRead >= requests[i].offset + requests[i].size;
+    };
 
-    if( _grContext && _ownsGrContext )
-        grDestroyContext( _grContext );
-    
-    _grContext     = context;
-    _ownsGrContext = false;
-}
+    byte* dst = _directBuffer.Ptr();
+    bool  ok  = true;
 
-//-----------------------------------------------------------
-void PlotReader::ConfigDecompressor( const uint32 threadCount, const bool disableCPUAffinity, const uint32 cpuOffset, bool useGpu, int gpuIndex )
-{
-    if( _grContext && _ownsGrContext )
-        grDestroyContext( _grContext );
+#if BB_HAS_FILE_IO_BATCH
+    if( count > 1 && !_ioBatch && !_ioBatchFailed )
+    {
+        _ioBatch = std::make_unique<FileIOBatch>();
 
-    _grContext     = nullptr;
-    _ownsGrContext = true;
+        if( !_ioBatch->Init( BB_PLOT_PROOF_X_COUNT ) )
+        {
+            _ioBatch.reset();
+            _ioBatchFailed = true;
+        }
+    }
 
-    GreenReaperConfig cfg = {};
-    cfg.apiVersion         = GR_API_VERSION;
-    cfg.threadCount        = bbclamp( threadCount, 1u, SysHost::GetLogicalCPUCount() );
-    cfg.cpuOffset          = cpuOffset;
-    cfg.disableCpuAffinity = disableCPUAffinity ? GR_TRUE : GR_FALSE;
-    cfg.gpuRequest         = !useGpu ? GRGpuRequestKind_None : 
-                                gpuIndex >= 0 ? GRGpuRequestKind_ExactDevice : GRGpuRequestKind_FirstAvailable;
-    cfg.gpuDeviceIndex     = gpuIndex < 0 ? 0 : gpuIndex;
+    if( count > 1 && _ioBatch )
+    {
+        for( uint32 i = 0; i < count; i++ )
+        {
+            const uint64 start = requests[i].offset / blockSize * blockSize;
+            const size_t size  = RoundUpToNextBoundaryT( (size_t)( requests[i].offset + requests[i].size - start ), blockSize );
 
-    auto result = grCreateContext( &_grContext, &cfg, sizeof( GreenReaperConfig ) );
-    ASSERT( result == GRResult_OK );
-}
+            _ioBatch->Read( _directFile, dst, size, start );
+            dst += size;
+        }
 
-//-----------------------------------------------------------
-GreenReaperContext* PlotReader::GetGRContext()
-{
-    if( _grContext == nullptr )
+        int error = 0;
+        if( !_ioBatch->Submit( error ) )
+        {
+            Log::Error( "Failed to read from plot with error %d", error );
+            return false;
+        }
+
+        for( uint32 i = 0; i < count && ok; i++ )
+        {
+            const uint64 start = requests[i].offset / blockSize * blockSize;
+            ok = start + _ioBatch->BytesTransferred( i ) >= requests[i].offset + requests[i].size;
+        }
+    }
+    else
+#endif
     {
-        GreenReaperConfig cfg = {};
-        cfg.apiVersion  = GR_API_VERSION;
-        cfg.threadCount = std::min( 8u, SysHost::GetLogicalCPUCount() );
+        for( uint32 i = 0; i < count && ok; i++ )
+        {
+            const uint64 start = requests[i].offset / blockSize * blockSize;
+            const size_t size  = RoundUpToNextBoundaryT( (size_t)( requests[i].offset + requests[i].size - start ), blockSize );
 
-        auto result = grCreateContext( &_grContext, &cfg, sizeof( GreenReaperConfig ) );
-        ASSERT( result == GRResult_OK );
+            ok   = readDirect( i, dst, start, size );
+            dst += size;
+        }
+    }
 
-        _ownsGrContext = true;
+    if( !ok )
+        return false;
+
+    // Copy the requested ranges out of the blocks
+    dst = _directBuffer.Ptr();
+    for( uint32 i = 0; i < count; i++ )
+    {
+        const uint64 start = requests[i].offset / blockSize * blockSize;
+
+        memcpy( requests[i].buffer, dst + ( requests[i].offset - start ), requests[i].size );
+        dst += RoundUpToNextBoundaryT( (size_t)( requests[i].offset + requests[i].size - start ), blockSize );
+
+        _bytesRead += requests[i].size;
     }
 
-    return _grContext;
+    return true;
 }
 
+
 ///
-/// Memory Plot
+/// MmapPlot
 ///
 //-----------------------------------------------------------
-MemoryPlot::MemoryPlot()
+MmapPlot::MmapPlot()
     : _bytes( nullptr, 0 )
 {}
 
 //-----------------------------------------------------------
-MemoryPlot::MemoryPlot( const MemoryPlot& plotFile )
+MmapPlot::MmapPlot( const MmapPlot& plotFile )
+    : _bytes( nullptr, 0 )
 {
-    _bytes    = plotFile._bytes;
-    _err      = 0;
-    _position = 0;
-
-    int headerError = 0;
-    if( !ReadHeader( headerError ) )
-    {
-        if( headerError )
-            _err = headerError;
-
-        if( _err == 0 )
-            _err = -1; // #TODO: Set generic plot header read error
-
-        _bytes.values = nullptr;
-        return;
-    }
-
-    _plotPath = plotFile._plotPath;
+    // Map the file again instead of sharing the mapping, so that each copy owns its own.
+    // The pages themselves are still shared through the OS cache.
+    if( plotFile.IsOpen() )
+        Open( plotFile._plotPath.c_str() );
 }
 
 //-----------------------------------------------------------
-MemoryPlot::~MemoryPlot()
+MmapPlot::~MmapPlot()
 {
-    // #TODO: Don't destroy bytes unless we own them. Use a shared ptr here.
-    if( _bytes.values )
-        SysHost::VirtualFree( _bytes.values );
-
-    _bytes = Span<byte>( nullptr, 0 );
+    Close();
 }
 
 //-----------------------------------------------------------
-bool MemoryPlot::Open( const char* path )
+bool MmapPlot::Open( const char* path )
 {
     ASSERT( path );
     if( !path )
@@ -1034,8 +2169,8 @@ bool MemoryPlot::Open( const char* path )
     if( IsOpen() )
         return false;
 
-    FileStream file;    // #TODO: Enable no buffering again, for now when testing disable to take advantage of caching.
-    if( !file.Open( path, FileMode::Open, FileAccess::Read ) )//, FileFlags::LargeFile | FileFlags::NoBuffering ) )
+    FileStream file;
+    if( !file.Open( path, FileMode::Open, FileAccess::Read ) )
     {
         _err = file.GetError();
         return false;
@@ -1051,101 +2186,135 @@ bool MemoryPlot::Open( const char* path )
         return false;
     }
 
-    // Add an extra block at the end to be able to do an aligned read there if
-    // we have any remainder that does not align to a block
-    const size_t allocSize = RoundUpToNextBoundary( (size_t)plotSize, (int)file.BlockSize() ) + file.BlockSize();
+    // The mapping stays valid after the file is closed
+    #if PLATFORM_IS_WINDOWS
+        HANDLE mapping = CreateFileMappingW( (HANDLE)file.Id(), nullptr, PAGE_READONLY, 0, 0, nullptr );
+        if( !mapping )
+        {
+            _err = (int)GetLastError();
+            return false;
+        }
+
+        void* bytes = MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+        if( !bytes )
+            _err = (int)GetLastError();
+
+        CloseHandle( mapping );
+
+        if( !bytes )
+            return false;
+    #else
+        void* bytes = mmap( nullptr, (size_t)plotSize, PROT_READ, MAP_SHARED, (int)file.Id(), 0 );
+        if( bytes == MAP_FAILED )
+        {
+            _err = errno;
+            return false;
+        }
+
+        // Proof lookups jump all over the plot, read-ahead would only waste disk bandwidth.
+        // This is only a hint, so errors are ignored.
+        madvise( bytes, (size_t)plotSize, MADV_RANDOM );
+    #endif
+
+    _bytes    = Span<byte>( (byte*)bytes, (size_t)plotSize );
+    _position = 0;
 
-    byte* bytes = (byte*)SysHost::VirtualAlloc( allocSize );
-    if( !bytes )
+    int headerError = 0;
+    if( !ReadHeader( headerError ) )
     {
-        _err = -1;      // #TODO: Assign an actual user error.
+        _err = headerError ? headerError : -1; // #TODO: Set generic plot header read error
+        Close();
         return false;
     }
 
-    // Read the whole thing to memory
-    size_t readSize      = RoundUpToNextBoundary( plotSize, (int)file.BlockSize() );/// file.BlockSize() * file.BlockSize();
-    // size_t readRemainder = plotSize - readSize;
-    const size_t readEnd = readSize - plotSize;
-    byte*  reader        = bytes;
-    
-    // Read blocks
-    while( readSize > readEnd )
+    // C1 and C2 are each read on every lookup, so ask for them ahead of time
+    #if !PLATFORM_IS_WINDOWS
     {
-        const ssize_t read = file.Read( reader, readSize );
-        ASSERT( read );
+        const uint64 indexStart = TableAddress( PlotTable::C1 );
+        const uint64 indexEnd   = std::min( (uint64)plotSize, TableAddress( PlotTable::C2 ) + TableSize( PlotTable::C2 ) );
 
-        if( read < 0 )
+        if( indexStart < indexEnd )
         {
-            _err = file.GetError();
-            SysHost::VirtualFree( bytes );
-
-            return false;
+            // madvise requires a page-aligned address
+            const uint64 pageStart = indexStart & ~(uint64)( SysHost::GetPageSize() - 1 );
+            madvise( _bytes.values + pageStart, (size_t)( indexEnd - pageStart ), MADV_WILLNEED );
         }
-
-        readSize -= (size_t)read;
-        reader   += read;
     }
+    #endif
 
-    // if( readRemainder )
-    // {
-    //     byte* block = (byte*)RoundUpToNextBoundary( (uintptr_t)reader, (int)file.BlockSize() );
-
-    //     const ssize_t read = file.Read( block, (size_t)file.BlockSize() );
-    //     ASSERT( read );
-    //     ASSERT( read >= readRemainder );
+    _plotPath = path;
+    return true;
+}
 
-    //     if( read < 0 )
-    //     {
-    //         _err = file.GetError();
-    //         SysHost::VirtualFree( bytes );
+//-----------------------------------------------------------
+void MmapPlot::Close()
+{
+    if( !_bytes.values )
+        return;
 
-    //         return false;
-    //     }
+    #if PLATFORM_IS_WINDOWS
+        UnmapViewOfFile( _bytes.values );
+    #else
+        // Unmapping also releases any locked pages
+        munmap( _bytes.values, _bytes.length );
+    #endif
 
-    //     if( reader != block )
-    //         memmove( reader, block, readRemainder );
-    // }
+    _bytes       = Span<byte>( nullptr, 0 );
+    _position    = 0;
+    _indexLocked = false;
+}
 
-    _bytes = Span<byte>( bytes, (size_t)plotSize );
+//-----------------------------------------------------------
+bool MmapPlot::LockIndexTables()
+{
+    if( !IsOpen() )
+        return false;
 
-    // Read the header
-    int headerError = 0;
-    if( !ReadHeader( headerError ) )
-    {
-        if( headerError )
-            _err = headerError;
+    if( _indexLocked )
+        return true;
 
-        if( _err == 0 )
-            _err = -1; // #TODO: Set generic plot header read error
+    const uint64 indexStart = TableAddress( PlotTable::C1 );
+    const uint64 indexEnd   = std::min( (uint64)_bytes.length, TableAddress( PlotTable::C2 ) + TableSize( PlotTable::C2 ) );
 
-        _bytes.values = nullptr;
-        SysHost::VirtualFree( bytes );
+    if( indexStart >= indexEnd )
         return false;
-    }
 
-    // Lock the plot memory into read-only mode
-    SysHost::VirtualProtect( bytes, allocSize, VProtect::Read );
+    const uint64 pageStart = indexStart & ~(uint64)( SysHost::GetPageSize() - 1 );
+    void*        lockStart = _bytes.values + pageStart;
+    const size_t lockSize  = (size_t)( indexEnd - pageStart );
 
-    // Save data, good to go
-    _plotPath = path;
+    #if PLATFORM_IS_WINDOWS
+        if( !VirtualLock( lockStart, lockSize ) )
+        {
+            _err = (int)GetLastError();
+            return false;
+        }
+    #else
+        if( mlock( lockStart, lockSize ) != 0 )
+        {
+            _err = errno;
+            return false;
+        }
+    #endif
 
+    _indexLocked = true;
     return true;
 }
 
 //-----------------------------------------------------------
-bool MemoryPlot::IsOpen() const
+bool MmapPlot::IsOpen() const
 {
     return _bytes.values != nullptr;
 }
 
 //-----------------------------------------------------------
-size_t MemoryPlot::PlotSize() const
+size_t MmapPlot::PlotSize() const
 {
     return _bytes.length;
 }
 
 //-----------------------------------------------------------
-bool MemoryPlot::Seek( SeekOrigin origin, int64 offset )
+bool MmapPlot::Seek( SeekOrigin origin, int64 offset )
 {
     ssize_t absPosition = 0;
 
@@ -1179,124 +2348,34 @@ bool MemoryPlot::Seek( SeekOrigin origin, int64 offset )
 }
 
 //-----------------------------------------------------------
-ssize_t MemoryPlot::Read( size_t size, void* buffer )
+ssize_t MmapPlot::Read( size_t size, void* buffer )
 {
     if( size < 1 || !buffer )
         return 0;
 
-    ASSERT( buffer );
-
     const size_t endPos = (size_t)_position + size;
 
     if( endPos > _bytes.length )
     {
         _err = -1; // #TODO: Set proper user error
-        return false;
+        return 0;
     }
 
     memcpy( buffer, _bytes.values + _position, size );
-    _position = (ssize_t)endPos;
+    _position   = (ssize_t)endPos;
+    _bytesRead += size;
 
     return (ssize_t)size;
 }
 
 //-----------------------------------------------------------
-int MemoryPlot::GetError() 
+int MmapPlot::GetError()
 {
     return _err;
 }
 
-
-
-///
-/// FilePlot
-///
-//-----------------------------------------------------------
-FilePlot::FilePlot()
-{
-
-}
-
-//-----------------------------------------------------------
-FilePlot::FilePlot( const FilePlot& file )
-{
-    if( file.IsOpen() )
-        Open( file._plotPath.c_str() ); // #TODO: Seek to same location
-    else
-        _plotPath = "";
-}
-
-//-----------------------------------------------------------
-FilePlot::~FilePlot()
-{
-
-}
-
-//-----------------------------------------------------------
-bool FilePlot::Open( const char* path )
-{
-    if( !_file.Open( path, FileMode::Open, FileAccess::Read, FileFlags::None ) )
-        return false;
-
-    // Read the header
-    int headerError = 0;
-    if( !ReadHeader( headerError ) )
-    {
-        // if( headerError )
-        //     _err = headerError; // #TODO: Set local error
-
-        // if( _err == 0 )
-        //     _err = -1; // #TODO: Set generic plot header read error
-        _file.Close();
-        return false;
-    }
-    
-    _plotPath = path;
-    return true;
-}
-
-//-----------------------------------------------------------
-bool FilePlot::IsOpen() const
-{
-    return _file.IsOpen();
-}
-
-//-----------------------------------------------------------
-size_t FilePlot::PlotSize() const
-{
-    const ssize_t sz = ((FileStream*)&_file)->Size();
-    if( sz < 0 )
-        return 0;
-
-    return (size_t)sz;
-}
-
-//-----------------------------------------------------------
-ssize_t FilePlot::Read( size_t size, void* buffer )
-{
-    if( size > (size_t)std::numeric_limits<ssize_t>::max() )
-        size = (size_t)std::numeric_limits<ssize_t>::max();
-
-    int error = 0;
-    if( !IOJob::ReadFromFileUnaligned( _file, buffer, size, error ) )
-    {
-        size = 0;
-        (void)error;
-        Log::Error( "Failed to read from plot with error %d", error );
-    }
-
-    return (ssize_t)size;
-}
-
-//-----------------------------------------------------------
-bool FilePlot::Seek( SeekOrigin origin, int64 offset )
-{
-    return _file.Seek( offset, origin );
-}
-
 //-----------------------------------------------------------
-int FilePlot::GetError()
+const byte* MmapPlot::MappedData() const
 {
-    return _file.GetError();
+    return _bytes.values;
 }
-
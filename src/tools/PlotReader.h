@@ -4,10 +4,15 @@
 #include "plotting/PlotTypes.h"
 #include "plotting/PlotHeader.h"
 #include "io/FileStream.h"
+#include "io/MappedFileStream.h"
 #include "util/Util.h"
 #include <vector>
+#include <memory>
+#include <mutex>
 
-class CPBitReader;
+struct RANSDecTable;
+class IGpuParkDecoder;
+class PlotReadScheduler;
 
 enum class ProofFetchResult
 {
@@ -17,10 +22,19 @@ enum class ProofFetchResult
     CompressionError
 };
 
+struct PlotReadRequest
+{
+    uint64 offset;
+    size_t size;
+    void*  buffer;
+};
+
 // Base Abstract class for read-only plot files
 class IPlotFile
 {
 public:
+    virtual ~IPlotFile() = default;
+
     inline uint K() const { return _header.k; }
 
     inline PlotFlags Flags() const 
@@ -39,6 +53,17 @@ public:
         return _header.compressionLevel;
     }
 
+    inline bool HasAlignedParks() const { return IsFlagSet( Flags(), PlotFlags::AlignedParks ); }
+
+    // The R value with which an LP table's park deltas were coded, if not its default one, otherwise 0
+    inline double TunedDeltaRValue( PlotTable table ) const
+    {
+        if( !IsFlagSet( Flags(), PlotFlags::TunedDeltas ) || table > PlotTable::Table6 )
+            return 0;
+
+        return DecodeDeltaRValue( _header.deltaRValues[(int)table] );
+    }
+
     inline const byte* PlotId() const { return _header.id; }
 
     inline uint PlotMemoSize() const { return _header.memoLength; }
@@ -55,6 +80,10 @@ public:
     {
         ASSERT( table >= PlotTable::Table1 && table <= PlotTable::C3 );
 
+        // Aligned tables are followed by padding, so their exact sizes are taken from the header
+        if( HasAlignedParks() )
+            return (size_t)_header.tableSizes[(int)table];
+
         const uint64 address    = _header.tablePtrs[(int)table];
         uint64       endAddress = PlotSize();
 
@@ -97,6 +126,10 @@ public:
 
     inline Span<uint64> TableSizes() { return Span<uint64>( _header.tableSizes, 10 ); }
 
+    // Total bytes read through Read() on this instance.
+    // Tables accessed in-place through MappedData() are not counted.
+    inline uint64 BytesRead() const { return _bytesRead; }
+
     // Abstract Interface
 public:
     virtual bool Open( const char* path ) = 0;
@@ -115,6 +148,14 @@ public:
     // Get last error ocurred
     virtual int GetError() = 0;
 
+    // Returns the whole plot if it is resident or mapped in memory, otherwise null.
+    // Readers can use this to access tables and parks without copying them.
+    virtual const byte* MappedData() const { return nullptr; }
+
+    // Read several regions of the plot. Implementations may have them in flight at once.
+    // The default implementation reads them one after the other.
+    virtual bool ReadBatch( const PlotReadRequest* requests, uint32 count );
+
 protected:
 
     // Implementors can call this to load the header
@@ -123,8 +164,12 @@ protected:
 protected:
     PlotFileHeaderV2 _header;
     PlotVersion      _version;
+    uint64           _bytesRead = 0;
 };
 
+// Keeps the whole plot in memory. The plot is mapped read-only rather than read into
+// a heap buffer, so opening it costs nothing until its pages are touched or prefetched.
+// Copies share the mapping of the plot they were copied from.
 class MemoryPlot : public IPlotFile
 {
 public:
@@ -135,6 +180,9 @@ public:
     bool Open( const char* path ) override;
     bool IsOpen() const override;
 
+    // Loads the whole plot into memory ahead of use, with threadCount threads faulting its pages in.
+    bool Prefetch( ThreadPool& pool, uint32 threadCount );
+
     size_t PlotSize() const override;
     
     ssize_t Read( size_t size, void* buffer ) override;
@@ -143,7 +191,10 @@ public:
 
     int GetError() override;
 
+    const byte* MappedData() const override;
+
 private:
+    std::shared_ptr<MappedFileStream> _file;
     Span<byte>  _bytes;  // Plot bytes
     int         _err      = 0;
     ssize_t     _position = 0;
@@ -168,9 +219,68 @@ public:
 
     int GetError() override;
 
+    // Submits the reads together through io_uring, or overlapped I/O on Windows, where available.
+    // Plots with aligned parks are read with direct I/O, bypassing the page cache.
+    // With PlotReadScheduler enabled, the reads go through the scheduler of the plot's device instead.
+    bool ReadBatch( const PlotReadRequest* requests, uint32 count ) override;
+
+    // The plot file itself, for wrapping it in other streams (ex. a PrefetchStream).
+    // Reads made through it are not counted by BytesRead().
+    inline IStream& Stream() { return _file; }
+
+private:
+    bool ReadBatchDirect( const PlotReadRequest* requests, uint32 count );
+
 private:
     FileStream  _file;
+    FileStream  _directFile;                // Only open for plots with aligned parks
+    Span<byte>  _directBuffer   = {};       // Block-aligned destination of direct reads
     std::string _plotPath = "";
+
+    std::shared_ptr<PlotReadScheduler> _readScheduler;     // Set if lookups on the plot's device are scheduled together
+
+#if BB_HAS_FILE_IO_BATCH
+    std::unique_ptr<FileIOBatch> _ioBatch;
+    bool                         _ioBatchFailed = false;   // Batched I/O is not available, don't try again
+#endif
+};
+
+// Maps the plot file into memory instead of reading it.
+// Pages are loaded by the OS on demand and shared with any other process
+// that has the same plot open, so opening copies of it is cheap.
+class MmapPlot : public IPlotFile
+{
+public:
+    MmapPlot();
+    MmapPlot( const MmapPlot& plotFile );
+    ~MmapPlot();
+
+    bool Open( const char* path ) override;
+    bool IsOpen() const override;
+
+    size_t PlotSize() const override;
+
+    ssize_t Read( size_t size, void* buffer ) override;
+
+    bool Seek( SeekOrigin origin, int64 offset ) override;
+
+    int GetError() override;
+
+    const byte* MappedData() const override;
+
+    // Locks the C1 and C2 tables in memory, so that lookups never have to wait on the disk.
+    // This may fail if the process is over its locked memory limit.
+    bool LockIndexTables();
+
+private:
+    void Close();
+
+private:
+    Span<byte>  _bytes;
+    int         _err         = 0;
+    ssize_t     _position    = 0;
+    bool        _indexLocked = false;
+    std::string _plotPath    = "";
 };
 
 class PlotReader
@@ -208,6 +318,10 @@ public:
     // If the return value is negative, there was an error reading the park.
     int64 ReadC3Park( uint64 parkIndex, uint64* f7Buffer );
 
+    // Looks up sorted, unique f7s in a C3 park without decoding all of it, see FindC3ParkF7s in ParkCoding.h.
+    // Returns the number of f7s visited in the park, or -1 if the park could not be read or decoded.
+    int64 FindF7sInC3Park( uint64 parkIndex, const uint64* f7s, uint32 count, uint64* outFirst, uint64* outCounts );
+
     bool ReadP7Entries( uint64 parkIndex, uint64 p7ParkEntries[kEntriesPerPark] );
 
     bool ReadP7Entry( uint64 p7Index, uint64& outP7Entry );
@@ -219,6 +333,14 @@ public:
     // void   FindF7ParkIndices( uintt64 f7, std::vector<uint64> indices );
     bool ReadLPPark( TableId table, uint64 parkIndex, uint128 linePoints[kEntriesPerPark], uint64& outEntryCount );
 
+    // Same as ReadLPPark for parkCount consecutive parks, up to decoder.MaxParks(), with their deltas
+    // decoded in a single batch on a GPU. The line points of park i are written at linePoints + i * kEntriesPerPark.
+    // outEntryCounts[i] is 0 for parks that could not be read or decoded.
+    // Plots whose deltas are not a single FSE stream are decoded on the CPU.
+    // Returns false on a device error.
+    bool ReadLPParks( TableId table, uint64 firstPark, uint32 parkCount, IGpuParkDecoder& decoder,
+                      uint128* linePoints, uint64* outEntryCounts );
+
     bool ReadLP( TableId table, uint64 index, uint128& outLinePoint );
 
     bool FetchProofFromP7Entry( uint64 p7Entry, uint64 proof[32] );
@@ -229,18 +351,31 @@ public:
     uint64 GetP7IndicesForF7( const uint64 f7, uint64& outStartT6Index );
 
     ProofFetchResult FetchQualityXsForP7Entry( uint64 t6Index,const byte challenge[BB_CHIA_CHALLENGE_SIZE], uint64& outX1, uint64& outX2 );
+
+    // Not available in the harvester library, which leaves hashing the quality to the caller
+#if !defined( BB_IS_HARVESTER )
     ProofFetchResult FetchQualityForP7Entry( uint64 t6Index, const byte challenge[BB_CHIA_CHALLENGE_SIZE], byte outQuality[BB_CHIA_QUALITY_SIZE] );
+#endif
+
+    // Same as FetchQualityXsForP7Entry for all the entries matching a challenge.
+    // The entries walk down the tables together, so that each table's parks are read in one batch,
+    // and the x's of compressed plots are decompressed with a single GreenReaper batch request.
+    void FetchQualityXsForP7Entries( const uint64* t6Indices, uint32 count, const byte challenge[BB_CHIA_CHALLENGE_SIZE],
+                                     uint64* outX1, uint64* outX2, ProofFetchResult* outResults );
 
     TableId           GetLowestStoredTable() const;
     bool              IsCompressedXTable( TableId table ) const;
     size_t            GetParkSizeForTable( TableId table ) const;
+    PlotParkLayout    GetParkLayout( size_t parkSize ) const;
     uint32            GetLPStubBitSize( TableId table ) const;
     uint32            GetLPStubByteSize( TableId table ) const;
     size_t            GetParkDeltasSectionMaxSize( TableId table ) const;
     const FSE_DTable* GetDTableForTable( TableId table ) const;
+    const RANSDecTable* GetRANSDTableForTable( TableId table ) const;
 
-    // Takes ownership of a decompression context
-    void AssignDecompressionContext( struct GreenReaperContext* context );
+    // Takes ownership of a decompression context.
+    // If contextLock is given, it is held around each call into the context, so that it can be shared between readers.
+    void AssignDecompressionContext( struct GreenReaperContext* context, std::mutex* contextLock = nullptr );
 
     void ConfigDecompressor( uint32 threadCount, bool disableCPUAffinity, uint32 cpuOffset = 0, bool useGpu = false, int gpuIndex = -1 );
 
@@ -254,14 +389,78 @@ public:
 private:
     ProofFetchResult DecompressProof( const uint64 compressedProof[BB_PLOT_PROOF_X_COUNT], uint64 fullProofXs[BB_PLOT_PROOF_X_COUNT] );
 
+    // Holds the context lock, if one was assigned, for the lifetime of the returned object
+    inline std::unique_lock<std::mutex> LockGRContext()
+    {
+        return _grContextLock ? std::unique_lock<std::mutex>( *_grContextLock ) : std::unique_lock<std::mutex>();
+    }
+
+    struct LPParkSections
+    {
+        uint128     baseLinePoint;
+        const byte* stubs;              // Packed stubs, within the park
+        const byte* deltas;             // Compressed deltas, within the park
+        uint16      deltasSize;
+    };
+
+    // Locates the sections of an LP park, which point into the park cache or the plot's mapping
+    bool GetLPParkSections( TableId table, uint64 parkIndex, LPParkSections& outSections );
+
+    // Decompresses a park's deltas in the plot's delta format.
+    // Returns the delta count or an FSE error code.
+    size_t DecompressLPDeltas( TableId table, const LPParkSections& park, byte* dst );
+
+    // outStubs points to the park's packed stubs
     bool ReadLPParkComponents( TableId table, uint64 parkIndex, 
-                               CPBitReader& outStubs, byte*& outDeltas, 
+                               const byte*& outStubs, byte*& outDeltas, 
                                uint128& outBaseLinePoint, uint64& outDeltaCounts );
 
+    // Same as calling ReadLP for both indices, decoding the deltas of both parks at once
+    bool ReadLPPair( TableId table, const uint64 indices[2], uint128 outLinePoints[2] );
+
     bool LoadP7Park( uint64 parkIndex );
 
+    // Line point decoding routines for a table's stub width, see PlotReader.cpp
+    struct LPDecoder
+    {
+        using AddDeltasFn = uint128 (*)( uint128 baseLinePoint, const byte* stubBytes, const byte* deltas, uint64 count, uint32 stubBitSize );
+        using DecodeFn    = void    (*)( uint128 baseLinePoint, const byte* stubBytes, const byte* deltas, uint64 deltaCount,
+                                         uint32 stubBitSize, uint128 linePoints[kEntriesPerPark] );
+
+        AddDeltasFn addDeltas;     // Adds the first count entries of a park to its base line point
+        DecodeFn    decode;        // Writes a park's line points
+    };
+
+    // Resolved once per table, the first time its line points are decoded
+    const LPDecoder& GetLPDecoder( TableId table );
+
+    // Returns the raw bytes of an LP park, reading it if it is not cached
+    const byte* GetLPPark( TableId table, uint64 parkIndex );
+    const byte* FindCachedLPPark( TableId table, uint64 parkIndex );
+    byte*       InsertLPPark( TableId table, uint64 parkIndex );
+
+    // Reads all of the given parks that are not cached yet.
+    // Reads are sorted by offset and nearby parks are coalesced into a single read.
+    void PrefetchLPParks( TableId table, const uint64* parkIndices, uint32 count );
+
     bool LoadC2Entries();
 
+    static constexpr uint32 QUALITY_BATCH_SIZE = BB_PLOT_PROOF_X_COUNT / 2;    // So that both leaves of each entry can be prefetched at once
+
+    void FetchQualityXsBatch( const uint64* t6Indices, uint32 count, const byte challenge[BB_CHIA_CHALLENGE_SIZE],
+                              uint64* outX1, uint64* outX2, ProofFetchResult* outResults );
+
+    // Finds the C3 park holding an f7 through the plot's C2 and C1 tables,
+    // used when the plot's index is not resident in the PlotIndexCache.
+    bool FindC3ParkForF7( uint64 f7, uint64& outC3Park, uint32& outParkCount );
+
+    // Reads a C3 park's C1 entry, and the park itself into _parkBuffer, returning the size of its compressed deltas.
+    // Returns -1 on error, or 0 if the park is not present, in which case the C1 entry is the only f7 in it.
+    int32 LoadC3Park( uint64 parkIndex, uint64& outC1 );
+
+    // Same as ReadC3Park, but goes through the index's hot parks first, if any
+    int64 ReadC3ParkCached( uint64 parkIndex, uint64* f7Buffer );
+
     struct GreenReaperContext* GetGRContext();
 
 private:
@@ -271,15 +470,42 @@ private:
     // size_t  _parkBufferSize;
     uint64*      _parkBuffer;           // Buffer for loading compressed park data.
     byte*        _deltasBuffer;         // Buffer for decompressing deltas in parks that have delta. 
+    byte*        _pairDeltasBuffer;     // Deltas of the second park read by ReadLPPair
 
     byte*        _c1Buffer = nullptr;
     Span<uint64> _c2Entries;
     Span<uint64> _c3Buffer;
 
+    std::shared_ptr<class PlotIndex> _index;                // Resident C1 index, if the cache is enabled
+    bool                             _indexLoaded = false;
+
     struct GreenReaperContext* _grContext     = nullptr;    // Used for decompressing
     bool                       _ownsGrContext = true;
+    std::mutex*                _grContextLock = nullptr;    // Held around calls into a shared _grContext
 
     int64  _park7Index = -1;
     uint64 _park7Entries[kEntriesPerPark];
+
+    const LPDecoder* _lpDecoders[(int)TableId::_Count] = {};
+
+    // LRU cache of raw LP parks. A proof fetch following a quality fetch for
+    // the same entry, or proofs that share parks, won't read them again.
+    static constexpr uint32 LP_PARK_CACHE_SIZE = 64;
+    static constexpr uint32 LP_PARK_MAX_RUN    = 8;     // Maximum number of parks read at once
+    static constexpr uint32 LP_PARK_MAX_GAP    = 1;     // Unneeded parks that may be read to coalesce two reads
+    static constexpr uint32 LP_PARK_BATCH_SIZE = 32;    // Maximum number of parks read in a single batch of runs
+
+    struct LPParkCacheEntry
+    {
+        TableId table     = TableId::_Count;            // _Count if the entry is empty
+        uint64  parkIndex = 0;
+        uint64  lastUse   = 0;
+    };
+
+    byte*            _lpParkCache     = nullptr;        // LP_PARK_CACHE_SIZE parks, _lpParkStride bytes apart
+    byte*            _lpRunBuffer     = nullptr;        // Holds a batch of runs, LP_PARK_BATCH_SIZE parks
+    size_t           _lpParkStride    = 0;
+    uint64           _lpParkCacheTick = 0;
+    LPParkCacheEntry _lpParkCacheEntries[LP_PARK_CACHE_SIZE];
 };
 
@@ -11,8 +11,14 @@
 #include "b3/blake3.h"
 #include "threading/MTJob.h"
 #include "util/CliParser.h"
+#include "util/LatencyHistogram.h"
 #include "plotting/GlobalPlotConfig.h"
+#include "plotting/GpuParkDecoder.h"
+#include "plotting/GpuProofValidator.h"
 #include "harvesting/GreenReaper.h"
+#include "ValidationJournal.h"
+#include <filesystem>
+#include <algorithm>
 #include <mutex>
 
 #pragma GCC diagnostic push
@@ -29,11 +35,16 @@ struct ValidatePlotOptions
     struct GlobalPlotConfig* gCfg;
 
     std::string plotPath    = "";
+    std::string journalPath = "";    // If set, validation progress is recorded here and resumed from it
     bool        inRAM       = false;
+    bool        mmap        = false; // Map the plot into memory instead of reading it
+    bool        lockIndex   = false; // Lock the mapped C1 and C2 tables in memory
     bool        unpacked    = false;
     uint32      threadCount = 0;
     float       startOffset = 0.0f;  // Offset percent at which to start
     bool        useCuda     = false; // Use a cuda device when decompressing
+    bool        useGpu      = false; // Validate the fetched proofs on a cuda device
+    bool        json        = false; // Output results as json instead of text
 
     int64       f7          = -1;
 };
@@ -55,7 +66,7 @@ struct ValidatePlotOptions
 // #TODO: Add C1 & C2 table validation
 
 //-----------------------------------------------------------
-const char USAGE[] = R"(validate [OPTIONS] <plot_path>
+const char USAGE[] = R"(validate [OPTIONS] <plot_path> [<plot_path> ...]
 
 Validates all of a plot's values to ensure they all contain valid proofs.
 
@@ -63,11 +74,17 @@ Validates all of a plot's values to ensure they all contain valid proofs.
 You can specify the thread count in the bladebit global option '-t'.
 
 [ARGUMENTS]
-<plot_path>      : Path to the plot file to be validated.
+<plot_path>      : Path to the plot file to be validated. Several plots, or directories
+                   of plots, can be given when validating whole plots.
 
 [OPTIOINS]
  -m, --in-ram    : Loads the whole plot file into memory before validating.
 
+ --mmap          : Map the plot file into memory instead of reading it.
+                   Pages are loaded on demand and shared with other processes.
+
+ --mlock-index   : With --mmap, lock the C1 and C2 tables in memory.
+
  -o, --offset    : Percentage offset at which to start validating.
                    Ex (start at 50%): bladebit validate -o 50 /path/to/my/plot
 
@@ -83,6 +100,18 @@ You can specify the thread count in the bladebit global option '-t'.
  --quality <f7>  : Fetch quality string for f7.
 
  --cuda          : Use a CUDA device when decompressing.
+                   With --unpack, the line point parks are also decoded on the device, in batches.
+
+ --gpu           : Validate the proofs of whole C3 parks at once on a CUDA device,
+                   instead of in small batches on the CPU. Proofs are still fetched by the CPU.
+                   This is only supported for plots with k=32.
+
+ --json          : Output the results in json, along with a latency histogram
+                   of proof (or quality) fetches. Not supported with --unpack.
+
+ --journal <path> : Record validation progress in a journal file. Plots that were
+                   fully validated are skipped, and interrupted ones are resumed,
+                   unless their file size or modification time changed.
 
  -h, --help      : Print this help message and exit.
 )";
@@ -112,7 +141,8 @@ struct UnpackedK32Plot
         return tables[(int)table];
     }
     
-    static UnpackedK32Plot Load( IPlotFile** plotFile, ThreadPool& pool, uint32 threadCount );
+    // With useGpu, the line point parks are decoded on a CUDA device when possible
+    static UnpackedK32Plot Load( IPlotFile** plotFile, ThreadPool& pool, uint32 threadCount, bool useGpu = false );
     bool FetchProof( const  uint64 index, uint64 fullProofXs[PROOF_X_COUNT] );
 };
 
@@ -131,28 +161,36 @@ static bool DecompressProof( const byte plotId[BB_PLOT_ID_LEN], const uint32 com
 
 static uint64 SliceUInt64FromBits( const byte* bytes, uint32 bitOffset, uint32 bitCount );
 
-static bool FxMatch( uint64 yL, uint64 yR );
+using PlotValidation::FxGen;
 
-static void FxGen( const TableId table, const uint32 k, 
-                   const uint64 y, const MetaBits& metaL, const MetaBits& metaR,
-                   uint64& outY, MetaBits& outMeta );
-
-static bool ValidatePlot( const ValidatePlotOptions& options );
+static bool ValidatePlot( const ValidatePlotOptions& options, ValidationJournal* journal );
 static void ValidatePark( IPlotFile& file, const uint64 parkIndex );
 
 static uint64 ValidateInMemory( UnpackedK32Plot& plot, ThreadPool& pool );
 
 // Thread-safe log
-static std::mutex _logLock;
+static bool       _logSilent = false;    // Set when outputting json, so that progress is not interleaved with it
 static void TVLog( const uint32 id, const char* msg, va_list args );
 // static void TLog( const uint32 id, const char* msg, ... );
 
 struct ValidateJob : MTJob<ValidateJob>
 {
-    IPlotFile*       plotFile;
-    UnpackedK32Plot* unpackedPlot;  // If set, this will be used instead
-    uint64           failCount;
-    float            startOffset;
+    IPlotFile*          plotFile;
+    UnpackedK32Plot*    unpackedPlot;   // If set, this will be used instead
+    bool                useGpu;         // Validate proofs with a per-job IGpuProofValidator
+    uint64              failCount;
+    LatencyHistogram    proofTimes;     // Time taken to fetch each proof
+
+    // C3 parks are handed out in park ranges, so threads that finish early take over
+    // the remaining parks of slower ones, and memory use stays at a park per thread.
+    WorkStealingRanges* parkRanges;
+    uint64              parkStart;      // First park validated, offsets from parkRanges are relative to it
+    uint64              parkCount;
+    std::atomic<uint64>* parksDone;     // Shared by all jobs, for progress reporting
+
+    ValidationJournal*       journal;       // If set, validated parks are recorded here
+    ValidationJournalEntry*  journalEntry;
+    const std::vector<bool>* parksToSkip;   // Parks validated on a previous run
 
     void Run() override;
     void Log( const char* msg, ... );
@@ -170,10 +208,16 @@ void PlotValidatorMain( GlobalPlotConfig& gCfg, CliParser& cli )
     const char* plotIdStr = nullptr;
     bool        quality   = false;
 
+    std::vector<std::string> plotPaths;
+
     while( cli.HasArgs() )
     {
         if( cli.ReadSwitch( opts.inRAM, "-m", "--in-ram" ) )
             continue;
+        else if( cli.ReadSwitch( opts.mmap, "--mmap" ) )
+            continue;
+        else if( cli.ReadSwitch( opts.lockIndex, "--mlock-index" ) )
+            continue;
         else if( cli.ReadSwitch( opts.unpacked, "-u", "--unpack" ) )
             continue;
         else if( cli.ReadF32( opts.startOffset, "-o", "--offset" ) )
@@ -187,6 +231,8 @@ void PlotValidatorMain( GlobalPlotConfig& gCfg, CliParser& cli )
             quality = true;
             continue;
         }
+        else if( cli.ReadSwitch( opts.json, "--json" ) )
+            continue;
         else if( cli.ReadSwitch( opts.useCuda, "--cuda" ) )
         {
             #if !BB_CUDA_ENABLED
@@ -195,6 +241,14 @@ void PlotValidatorMain( GlobalPlotConfig& gCfg, CliParser& cli )
 
             continue;
         }
+        else if( cli.ReadSwitch( opts.useGpu, "--gpu" ) )
+        {
+            #if !BB_CUDA_ENABLED
+                Fatal( "--gpu is only available in the bladebit_cuda variant." );
+            #endif
+
+            continue;
+        }
         else if( cli.ReadStr( fullProof, "--verify" ) )
         {
             challenge = cli.ArgConsume();
@@ -206,9 +260,11 @@ void PlotValidatorMain( GlobalPlotConfig& gCfg, CliParser& cli )
             PlotValidatorPrintUsage();
             exit( 0 );
         }
-        else if( cli.IsLastArg() )
+        else if( cli.ReadStr( opts.journalPath, "--journal" ) )
+            continue;
+        else if( cli.IsLastArg() || cli.Arg()[0] != '-' )
         {
-            opts.plotPath = cli.ArgConsume();
+            plotPaths.push_back( cli.ArgConsume() );
         }
         else
         {
@@ -216,6 +272,13 @@ void PlotValidatorMain( GlobalPlotConfig& gCfg, CliParser& cli )
         }
     }
 
+    // Proof lookups and verification work on a single plot
+    if( !plotPaths.empty() )
+        opts.plotPath = plotPaths[0];
+
+    FatalIf( plotPaths.size() > 1 && ( challenge || fullProof || opts.f7 >= 0 ),
+        "Only a single plot can be given when fetching or verifying proofs." );
+
     // Check for f7
     // if( challenge )
     // {
@@ -233,6 +296,12 @@ void PlotValidatorMain( GlobalPlotConfig& gCfg, CliParser& cli )
 
     const uint32 maxThreads = SysHost::GetLogicalCPUCount();
 
+    FatalIf( opts.json && opts.unpacked, "--json is not supported with --unpack." );
+    FatalIf( opts.mmap && opts.inRAM, "--mmap and --in-ram can't be used together." );
+    FatalIf( opts.lockIndex && !opts.mmap, "--mlock-index requires --mmap." );
+    FatalIf( opts.useGpu && opts.unpacked, "--gpu is not supported with --unpack, use --cuda instead." );
+    _logSilent = opts.json;
+
     // Check for full proof verification
     if( fullProof != nullptr )
     {
@@ -252,13 +321,60 @@ void PlotValidatorMain( GlobalPlotConfig& gCfg, CliParser& cli )
     opts.threadCount = gCfg.threadCount == 0 ? maxThreads : std::min( maxThreads, gCfg.threadCount );
     opts.startOffset = std::max( std::min( opts.startOffset / 100.f, 100.f ), 0.f );
 
-    ValidatePlot( opts );
+    // Directories are expanded to the plots they contain
+    {
+        std::vector<std::string> expanded;
+
+        for( auto& path : plotPaths )
+        {
+            std::error_code err;
+            if( !std::filesystem::is_directory( path, err ) )
+            {
+                expanded.push_back( path );
+                continue;
+            }
+
+            std::vector<std::string> dirPlots;
+            for( auto& entry : std::filesystem::directory_iterator( path, err ) )
+            {
+                if( entry.is_regular_file() && entry.path().extension() == ".plot" )
+                    dirPlots.push_back( entry.path().string() );
+            }
+
+            FatalIf( err, "Failed to list plots in directory '%s'.", path.c_str() );
+
+            std::sort( dirPlots.begin(), dirPlots.end() );
+            expanded.insert( expanded.end(), dirPlots.begin(), dirPlots.end() );
+        }
+
+        plotPaths = std::move( expanded );
+    }
+
+    FatalIf( plotPaths.empty(), "Expected a path to a plot file." );
+    FatalIf( plotPaths.size() > 1 && opts.unpacked, "--unpack only supports validating a single plot." );
+
+    ValidationJournal journal;
+    if( !opts.journalPath.empty() )
+        FatalIf( !journal.Open( opts.journalPath.c_str() ), "Failed to read validation journal '%s'.", opts.journalPath.c_str() );
+
+    uint64 failedPlots = 0;
+
+    for( auto& path : plotPaths )
+    {
+        opts.plotPath = path;
+
+        if( !ValidatePlot( opts, opts.journalPath.empty() ? nullptr : &journal ) )
+            failedPlots++;
+    }
+
+    if( plotPaths.size() > 1 && !opts.json )
+        Log::Line( "Validated %llu plots, %llu failed.", (llu)plotPaths.size(), (llu)failedPlots );
 
-    exit( 0 );
+    exit( failedPlots == 0 ? 0 : 1 );
 }
 
 //-----------------------------------------------------------
-bool ValidatePlot( const ValidatePlotOptions& options )
+bool ValidatePlot( const ValidatePlotOptions& options, ValidationJournal* journal )
 {
     LoadLTargets();
 
@@ -267,18 +383,40 @@ bool ValidatePlot( const ValidatePlotOptions& options )
     IPlotFile*  plotFile  = nullptr;
     IPlotFile** plotFiles = new IPlotFile*[threadCount];
 
+    ThreadPool pool( threadCount );
+
     if( options.inRAM && !options.unpacked )
     {
         auto* memPlot = new MemoryPlot();
         plotFile = memPlot;
 
-        Log::Line( "Reading plot file into memory..." );
-        if( memPlot->Open( options.plotPath.c_str() ) )
+        if( !options.json )
+            Log::Line( "Reading plot file into memory..." );
+
+        // The plot is mapped, so its pages are loaded by all threads in parallel instead of copied in one by one
+        if( memPlot->Open( options.plotPath.c_str() ) && !memPlot->Prefetch( pool, threadCount ) )
+            Log::Error( "Warning: Failed to load the plot into memory with error %d. Pages will be loaded as they are read.", memPlot->GetError() );
+
+        if( memPlot->IsOpen() )
         {
             for( uint32 i = 0; i < threadCount; i++ )
                 plotFiles[i] = new MemoryPlot( *memPlot );
         }
     }
+    else if( options.mmap )
+    {
+        auto* mmapPlot = new MmapPlot();
+        plotFile = mmapPlot;
+
+        if( mmapPlot->Open( options.plotPath.c_str() ) )
+        {
+            if( options.lockIndex && !mmapPlot->LockIndexTables() )
+                Log::Error( "Warning: Failed to lock the plot's C1 and C2 tables with error %d.", mmapPlot->GetError() );
+
+            for( uint32 i = 0; i < threadCount; i++ )
+                plotFiles[i] = new MmapPlot( *mmapPlot );
+        }
+    }
     else
     {
         auto* filePlot = new FilePlot();
@@ -291,25 +429,87 @@ bool ValidatePlot( const ValidatePlotOptions& options )
         }
     }
 
-    FatalIf( !plotFile->IsOpen(), "Failed to open plot at path '%s'.", options.plotPath.c_str() );
-    FatalIf( options.unpacked && plotFile->K() != 32, "Unpacked plots are only supported for k=32 plots." );
+    auto FreePlots = [&]() {
+        if( plotFile->IsOpen() )
+        {
+            for( uint32 i = 0; i < threadCount; i++ )
+                delete plotFiles[i];
+        }
+
+        delete[] plotFiles;
+        delete plotFile;
+    };
+
+    if( !plotFile->IsOpen() )
+    {
+        Log::Error( "Failed to open plot at path '%s'.", options.plotPath.c_str() );
+        FreePlots();
+        return false;
+    }
 
-    Log::Line( "Validating plot %s", options.plotPath.c_str() );
-    Log::Line( "K               : %u", plotFile->K() );
-    Log::Line( "Unpacked        : %s", options.unpacked? "true" : "false" );;
+    FatalIf( options.unpacked && plotFile->K() != 32, "Unpacked plots are only supported for k=32 plots." );
+    FatalIf( options.useGpu && plotFile->K() != 32, "GPU validation is only supported for k=32 plots." );
 
     const uint64 plotC3ParkCount = plotFile->TableSize( PlotTable::C1 ) / sizeof( uint32 ) - 1;
-    Log::Line( "Maximum C3 Parks: %llu", plotC3ParkCount );
-    Log::Line( "" );
 
+    // Resume from the journal, unless the file changed since it was recorded
+    ValidationJournalEntry* journalEntry = nullptr;
+    std::vector<bool>       parksToSkip;
+
+    if( journal && !options.unpacked )
+    {
+        uint64 fileSize  = 0;
+        int64  fileMTime = 0;
+
+        if( !ValidationJournal::GetFileInfo( options.plotPath.c_str(), fileSize, fileMTime ) )
+        {
+            Log::Error( "Failed to get file info for plot '%s'.", options.plotPath.c_str() );
+            FreePlots();
+            return false;
+        }
+
+        journalEntry = &journal->BeginPlot( BytesToHexStdString( plotFile->PlotId(), BB_PLOT_ID_LEN ),
+                                            fileSize, fileMTime, plotC3ParkCount );
+
+        if( journalEntry->IsComplete() )
+        {
+            const uint64 failCount = journalEntry->failCount;
+
+            if( options.json )
+            {
+                Log::Write( R"({"plot": )" );
+                LogWriteJsonStr( options.plotPath.c_str() );
+                Log::Line( R"(, "skipped": true, "proofs_failed": %llu})", (llu)failCount );
+            }
+            else
+                Log::Line( "Plot %s was already validated with %llu invalid proofs, skipping.", options.plotPath.c_str(), (llu)failCount );
+
+            FreePlots();
+            return failCount == 0;
+        }
+
+        // Jobs read a snapshot, since the journal is updated while they run
+        parksToSkip = journalEntry->parksDone;
+    }
+
+    if( !options.json )
+    {
+        Log::Line( "Validating plot %s", options.plotPath.c_str() );
+        Log::Line( "K               : %u", plotFile->K() );
+        Log::Line( "Unpacked        : %s", options.unpacked? "true" : "false" );;
+        Log::Line( "Maximum C3 Parks: %llu", plotC3ParkCount );
+
+        if( journalEntry && journalEntry->DoneCount() > 0 )
+            Log::Line( "Resuming        : %llu parks already validated", (llu)journalEntry->DoneCount() );
+
+        Log::Line( "" );
+    }
 
-    // Duplicate the plot file,     
-    ThreadPool pool( threadCount );
 
     UnpackedK32Plot unpackedPlot;
     if( options.unpacked )
     {
-        unpackedPlot      = UnpackedK32Plot::Load( plotFiles, pool, threadCount );
+        unpackedPlot      = UnpackedK32Plot::Load( plotFiles, pool, threadCount, options.useCuda );
         unpackedPlot.plot = plotFile;
 
         const auto timer = TimerBegin();
@@ -331,6 +531,14 @@ bool ValidatePlot( const ValidatePlotOptions& options )
         exit( failedCount == 0 ? 0 : 1 );
     }
 
+    // Each thread starts on its own contiguous park range and reads through it,
+    // so IO for one thread overlaps with proof validation on the others.
+    const uint64 parkStart = std::min( plotC3ParkCount, (uint64)( plotC3ParkCount * (double)options.startOffset ) );
+    const uint64 parkCount = plotC3ParkCount - parkStart;
+
+    WorkStealingRanges  parkRanges( threadCount, parkCount, 1 );
+    std::atomic<uint64> parksDone = 0;
+
     MTJobRunner<ValidateJob> jobs( pool );
 
     for( uint32 i = 0; i < threadCount; i++ )
@@ -339,21 +547,72 @@ bool ValidatePlot( const ValidatePlotOptions& options )
 
         job.plotFile     = plotFiles[i];
         job.unpackedPlot = options.unpacked ? &unpackedPlot : nullptr;
-        job.startOffset  = options.startOffset;
+        job.useGpu       = options.useGpu;
         job.failCount    = 0;
+        job.parkRanges   = &parkRanges;
+        job.parkStart    = parkStart;
+        job.parkCount    = parkCount;
+        job.parksDone    = &parksDone;
+        job.journal      = journal;
+        job.journalEntry = journalEntry;
+        job.parksToSkip  = journalEntry ? &parksToSkip : nullptr;
     }
 
+    const auto validateTimer = TimerBegin();
     jobs.Run( threadCount );
+    const double validateElapsed = TimerEnd( validateTimer );
 
     uint64 proofFailCount = 0;
+    uint64 proofCount     = 0;
+    uint64 bytesRead      = 0;
     for( uint32 i = 0; i < threadCount; i++ )
+    {
         proofFailCount += jobs[i].failCount;
+        proofCount     += jobs[i].proofTimes.Count();
+        bytesRead      += jobs[i].plotFile->BytesRead();
+    }
+
+    // Include failures found on previous runs
+    if( journalEntry )
+    {
+        journal->Save();
+        proofFailCount = journalEntry->failCount;
+    }
+
+    // In-RAM plots were read before the validation started
+    const double readGBps     = options.inRAM ? 0.0 : (double)bytesRead / validateElapsed / 1e9;
+    const double proofsPerSec = (double)proofCount / validateElapsed;
+
+    if( options.json )
+    {
+        LatencyHistogram proofTimes;
+        for( uint32 i = 0; i < threadCount; i++ )
+            proofTimes.Merge( jobs[i].proofTimes );
+
+        Log::Write( R"({"plot": )" );
+        LogWriteJsonStr( options.plotPath.c_str() );
+        Log::Write( R"(, "k": %u, "compression_level": %u, "device": "%s", "elapsed_seconds": %.3lf, )",
+            plotFile->K(), plotFile->CompressionLevel(), options.useGpu ? "cuda" : "cpu", validateElapsed );
+        Log::Write( R"("proofs_checked": %llu, "proofs_failed": %llu, "proofs_per_second": %.2lf, "bytes_read": %llu, "read_gbps": %.3lf, "proofs": )",
+            (llu)proofTimes.Count(), (llu)proofFailCount, proofsPerSec, (llu)bytesRead, readGBps );
+        proofTimes.WriteJson();
+        Log::Line( "}" );
+
+        return proofFailCount == 0;
+    }
+
+    Log::Line( "" );
+    Log::Line( "Validated %llu proofs in %.2lf seconds ( %.2lf proofs/s ).", (llu)proofCount, validateElapsed, proofsPerSec );
+
+    if( !options.inRAM )
+        Log::Line( "Read %.2lf GiB from the plot ( %.3lf GB/s ).", (double)bytesRead BtoGB, readGBps );
 
     if( proofFailCount )
-        Log::Line( "Plot has %llu invalid proofs." );
+        Log::Line( "Plot has %llu invalid proofs.", (llu)proofFailCount );
     else
         Log::Line( "Perfect plot! All proofs are valid." );
 
+    FreePlots();
     return proofFailCount == 0;
 }
 
@@ -536,35 +795,6 @@ void ValidateJob::Run()
     
     const uint32 k = plotFile->K();
 
-    uint64 c3ParkCount = 0;
-    uint64 c3ParkEnd   = 0;
-    
-    const uint32 threadCount     = this->JobCount();
-    const uint64 plotC3ParkCount = plotFile->TableSize( PlotTable::C1 ) / sizeof( uint32 ) - 1;
-    
-    c3ParkCount = plotC3ParkCount / threadCount;
-
-    uint64 startC3Park = this->JobId() * c3ParkCount;
-
-    {
-        uint64 trailingParks = plotC3ParkCount - c3ParkCount * threadCount;
-        
-        if( this->JobId() < trailingParks )
-            c3ParkCount ++;
-
-        startC3Park += std::min( trailingParks, (uint64)this->JobId() );
-    }
-
-    c3ParkEnd = startC3Park + c3ParkCount;
-
-    if( startOffset > 0.0f )
-    {
-        startC3Park += std::min( c3ParkCount, (uint64)( c3ParkCount * startOffset ) );
-        c3ParkCount = c3ParkEnd - startC3Park;
-    }
-
-    Log( "Park range: %10llu..%-10llu  Park count: %llu", startC3Park, c3ParkEnd, c3ParkCount );
-
     ///
     /// Start validating C3 parks
     ///
@@ -572,85 +802,149 @@ void ValidateJob::Run()
     memset( f7Entries, 0, kCheckpoint1Interval * sizeof( uint64 ) );
 
     uint64* p7Entries = bbcalloc<uint64>( kEntriesPerPark );
-    memset( p7Entries, 0, sizeof( kEntriesPerPark ) * sizeof( uint64 ) );
-
+    memset( p7Entries, 0, kEntriesPerPark * sizeof( uint64 ) );
 
-    uint64 curPark7 = 0;
-    if( JobId() == 0 )
-        FatalIf( !plot.ReadP7Entries( 0, p7Entries ), "Failed to read P7 0." );
-    
+    int64  curPark7       = -1;
     uint64 proofFailCount = 0;
-    uint64 fullProofXs[PROOF_X_COUNT];
 
-    for( uint64 c3ParkIdx = startC3Park; c3ParkIdx < c3ParkEnd; c3ParkIdx++ )
+    // Fetched proofs are validated in batches. On the GPU, a batch holds a whole C3 park.
+    static constexpr uint32 PROOF_BATCH_SIZE = 64;
+
+    IGpuProofValidator* gpuValidator = nullptr;
+    if( useGpu )
     {
-        const auto timer = TimerBegin();
+        gpuValidator = CudaProofValidatorFactory::Create( 0, kCheckpoint1Interval );
+        FatalIf( !gpuValidator, "Failed to create a GPU proof validator." );
+    }
 
-        const int64 f7EntryCount = plot.ReadC3Park( c3ParkIdx, f7Entries );
+    const uint32 batchSize = gpuValidator ? gpuValidator->MaxProofs() : PROOF_BATCH_SIZE;
 
-        FatalIf( f7EntryCount < 0, "Could not read C3 park %llu.", c3ParkIdx );
-        ASSERT( f7EntryCount <= kCheckpoint1Interval );
+    uint64* batchXs     = gpuValidator ? gpuValidator->ProofXs() : bbcalloc<uint64>( PROOF_BATCH_SIZE * PROOF_X_COUNT );
+    uint64* batchF7s    = bbcalloc<uint64>( batchSize );
+    uint64* batchOutF7s = bbcalloc<uint64>( PROOF_BATCH_SIZE );
+    bool*   batchValid  = bbcalloc<bool>( PROOF_BATCH_SIZE );
+    uint32  batchCount  = 0;
 
-        const uint64 f7IdxBase = c3ParkIdx * kCheckpoint1Interval;
+    auto validateBatch = [&]() {
 
-        for( uint32 e = 0; e < (uint32)f7EntryCount; e++ )
-        {
-            const uint64 f7Idx       = f7IdxBase + e;
-            const uint64 p7ParkIndex = f7Idx / kEntriesPerPark;
-            const uint64 f7          = f7Entries[e];
+        const uint64* outF7s = batchOutF7s;
+        const bool*   valid  = batchValid;
 
-            if( p7ParkIndex != curPark7 )
-            {
-                // ASSERT( p7ParkIndex == curPark7+1 );
-                curPark7 = p7ParkIndex;
+        if( gpuValidator )
+        {
+            FatalIf( !gpuValidator->Validate( plot.PlotFile().PlotId(), batchCount ), "Failed to validate proofs on the GPU." );
+            outF7s = gpuValidator->F7s();
+            valid  = gpuValidator->Valid();
+        }
+        else
+            PlotValidation::ValidateFullProofs( k, plot.PlotFile().PlotId(), batchCount, batchXs, batchOutF7s, batchValid );
 
-                FatalIf( !plot.ReadP7Entries( p7ParkIndex, p7Entries ), "Failed to read P7 %llu.", p7ParkIndex );
-            }
+        for( uint32 i = 0; i < batchCount; i++ )
+        {
+            if( !valid[i] || outF7s[i] != batchF7s[i] )
+                proofFailCount++;
+        }
 
-            const uint64 p7LocalIdx = f7Idx - p7ParkIndex * kEntriesPerPark;
-            const uint64 t6Index    = p7Entries[p7LocalIdx];
+        batchCount = 0;
+    };
 
-            bool success = true;
+    uint64 rangeOffset, rangeCount;
+    while( parkRanges->Next( JobId(), rangeOffset, rangeCount ) )
+    {
+        const uint64 rangeStart = parkStart + rangeOffset;
+        const uint64 rangeEnd   = rangeStart + rangeCount;
 
-            if( k <= 32 )
+        for( uint64 c3ParkIdx = rangeStart; c3ParkIdx < rangeEnd; c3ParkIdx++ )
+        {
+            if( parksToSkip && (*parksToSkip)[c3ParkIdx] )
             {
-                success = FetchProof<true>( plot, t6Index, fullProofXs );
+                parksDone->fetch_add( 1, std::memory_order_relaxed );
+                continue;
             }
-            else
-                success = FetchProof<false>( plot, t6Index, fullProofXs );
 
-            if( success )
+            const auto   timer          = TimerBegin();
+            const uint64 parkFailsStart = proofFailCount;
+
+            const int64 f7EntryCount = plot.ReadC3Park( c3ParkIdx, f7Entries );
+
+            FatalIf( f7EntryCount < 0, "Could not read C3 park %llu.", c3ParkIdx );
+            ASSERT( f7EntryCount <= kCheckpoint1Interval );
+
+            const uint64 f7IdxBase = c3ParkIdx * kCheckpoint1Interval;
+
+            for( uint32 e = 0; e < (uint32)f7EntryCount; e++ )
             {
-                // ReorderProof( plot, fullProofXs );   // <-- No need for this for validation
-                
-                // Now we can validate the proof
-                uint64 outF7;
+                const uint64 f7Idx       = f7IdxBase + e;
+                const uint64 p7ParkIndex = f7Idx / kEntriesPerPark;
+                const uint64 f7          = f7Entries[e];
+
+                if( (int64)p7ParkIndex != curPark7 )
+                {
+                    curPark7 = (int64)p7ParkIndex;
+
+                    FatalIf( !plot.ReadP7Entries( p7ParkIndex, p7Entries ), "Failed to read P7 %llu.", p7ParkIndex );
+                }
+
+                const uint64 p7LocalIdx = f7Idx - p7ParkIndex * kEntriesPerPark;
+                const uint64 t6Index    = p7Entries[p7LocalIdx];
+
+                uint64* fullProofXs = batchXs + (size_t)batchCount * PROOF_X_COUNT;
+                bool    success     = true;
 
-                if( ValidateFullProof( k, plot.PlotFile().PlotId(), fullProofXs, outF7 ) )
-                    success = f7 == outF7;
+                const auto fetchTimer = TimerBegin();
+
+                if( k <= 32 )
+                {
+                    success = FetchProof<true>( plot, t6Index, fullProofXs );
+                }
                 else
-                    success = false;
-            }
-            else
-            {
-                success = false;
-                Log( "Park %llu proof fetch failed for f7[%llu] local(%llu) = %llu ( 0x%016llx ) ", 
-                   c3ParkIdx, f7Idx, e, f7, f7 );
-            }
+                    success = FetchProof<false>( plot, t6Index, fullProofXs );
 
-            if( !success )
-            {
-                proofFailCount++;
+                proofTimes.Record( (uint64)TicksToNanoSeconds( TimerEndTicks( fetchTimer ) ) );
+
+                if( success )
+                {
+                    // ReorderProof( plot, fullProofXs );   // <-- No need for this for validation
+
+                    // The proof is validated along with the rest of its batch
+                    batchF7s[batchCount++] = f7;
+
+                    if( batchCount == batchSize )
+                        validateBatch();
+                }
+                else
+                {
+                    proofFailCount++;
+                    Log( "Park %llu proof fetch failed for f7[%llu] local(%llu) = %llu ( 0x%016llx ) ", 
+                       c3ParkIdx, f7Idx, e, f7, f7 );
+                }
             }
-        }
 
-        const double elapsed = TimerEnd( timer );
-        Log( "%10llu..%-10llu ( %3.2lf%% ) C3 Park Validated in %2.2lf seconds | Proofs Failed: %llu", 
-                c3ParkIdx, c3ParkEnd-1, 
-                (double)(c3ParkIdx-startC3Park) / c3ParkCount * 100, elapsed,
-                proofFailCount );
+            // Validate the rest of the park's proofs, so that its failures are journaled with it
+            validateBatch();
+
+            if( journal )
+                journal->MarkPark( *journalEntry, c3ParkIdx, proofFailCount - parkFailsStart );
+
+            const uint64 done    = parksDone->fetch_add( 1, std::memory_order_relaxed ) + 1;
+            const double elapsed = TimerEnd( timer );
+
+            Log( "%10llu ( %3.2lf%% ) C3 Park Validated in %2.2lf seconds | Proofs Failed: %llu", 
+                    c3ParkIdx, (double)done / parkCount * 100, elapsed, proofFailCount );
+        }
     }
 
+    free( f7Entries );
+    free( p7Entries );
+    free( batchF7s );
+    free( batchOutF7s );
+    free( batchValid );
+
+    if( gpuValidator )
+        delete gpuValidator;
+    else
+        free( batchXs );
+
     // All done
     this->failCount = proofFailCount;
 }
@@ -725,9 +1019,16 @@ void GetProofForChallenge( const ValidatePlotOptions& opts, const char* challeng
     uint64 challenge[4] = {};
     HexStrToBytes( challengeHex, lenChallenge, (byte*)challenge, 32 );
 
-    FilePlot plot;
+    FilePlot   filePlot;
+    MmapPlot   mmapPlot;
+    IPlotFile& plot = opts.mmap ? (IPlotFile&)mmapPlot : (IPlotFile&)filePlot;
+
     FatalIf( !plot.Open( opts.plotPath.c_str() ), "Failed to open plot at %s.", opts.plotPath.c_str() );
-    FatalIf( plot.K() != 32, "Only k32 plots are supported." );
+    FatalIf( plot.K() > 32, "Only plots up to k32 are supported." );
+    FatalIf( plot.K() != 32 && plot.CompressionLevel() > 0, "Only k32 compressed plots are supported." );
+
+    if( opts.lockIndex && !mmapPlot.LockIndexTables() )
+        Log::Error( "Warning: Failed to lock the plot's C1 and C2 tables with error %d.", mmapPlot.GetError() );
 
     const uint32 k = plot.K();
 
@@ -755,7 +1056,10 @@ void GetProofForChallenge( const ValidatePlotOptions& opts, const char* challeng
     const uint64 matchCount = reader.GetP7IndicesForF7( f7, p7BaseIndex );
     if(  matchCount == 0 )
     {
-        Log::Line( "Could not find f7 %llu in plot.", (llu)f7 );
+        if( opts.json )
+            Log::Line( R"({"f7": %llu, "error": "Could not find f7 in plot."})", (llu)f7 );
+        else
+            Log::Line( "Could not find f7 %llu in plot.", (llu)f7 );
         Exit( 1 );
     }
 
@@ -781,11 +1085,17 @@ void GetProofForChallenge( const ValidatePlotOptions& opts, const char* challeng
         FatalIf( result != GRResult_OK, "Failed to created decompression context with error %d.", (int)result );
 
         if( opts.useCuda && !(bool)grHasGpuDecompressor( gr ) )
-            Log::Line( "Warning: No GPU device selected. Falling back to CPU-based validation." );
+        {
+            if( !opts.json )
+                Log::Line( "Warning: No GPU device selected. Falling back to CPU-based validation." );
+        }
         else
             reader.AssignDecompressionContext( gr );
     }
 
+    LatencyHistogram         fetchTimes;
+    std::vector<std::string> jsonResults;
+
     for( uint64 i = 0; i < matchCount; i++ )
     {
         const uint64 p7Index = p7BaseIndex + i;
@@ -814,7 +1124,9 @@ void GetProofForChallenge( const ValidatePlotOptions& opts, const char* challeng
 
         auto const elapsed  = TimerEndTicks( timer );
 
-        if( opts.gCfg->verbose )
+        fetchTimes.Record( (uint64)TicksToNanoSeconds( elapsed ) );
+
+        if( opts.gCfg->verbose && !opts.json )
         {
             Log::Line( "%s fetch time: %02.2lf seconds ( %02.2lf ms ).", qualityOnly ? "Quality" : "Proof",
                 TicksToSeconds( elapsed ), TicksToNanoSeconds( elapsed ) * 0.000001 );
@@ -839,20 +1151,41 @@ void GetProofForChallenge( const ValidatePlotOptions& opts, const char* challeng
             size_t encoded;
             BytesToHexStr( (byte*)proof, sizeof( proof ), proofStr, sizeof( proofStr ), encoded );
             // Log::Line( "[%llu] : %s", i, proofStr );
-            Log::Line( proofStr );
+            if( opts.json )
+                jsonResults.push_back( proofStr );
+            else
+                Log::Line( proofStr );
         }
         else if( qResult == ProofFetchResult::OK )
         {
             size_t encoded;
             BytesToHexStr( (byte*)quality, sizeof( quality ), proofStr, sizeof( proofStr ), encoded );
             // Log::Write( "0x" );
-            Log::Line( proofStr );
+            if( opts.json )
+                jsonResults.push_back( proofStr );
+            else
+                Log::Line( proofStr );
         }
     }
+
+    if( opts.json )
+    {
+        const bool usedGpu = gr && (bool)grHasGpuDecompressor( gr );
+
+        Log::Write( R"({"f7": %llu, "compression_level": %u, "device": "%s", "%s": [)",
+            (llu)f7, plot.CompressionLevel(), usedGpu ? "cuda" : "cpu", qualityOnly ? "qualities" : "proofs" );
+
+        for( size_t i = 0; i < jsonResults.size(); i++ )
+            Log::Write( i == 0 ? "\"%s\"" : ", \"%s\"", jsonResults[i].c_str() );
+
+        Log::Write( R"(], "latency": )" );
+        fetchTimes.WriteJson();
+        Log::Line( "}" );
+    }
 }
 
 //-----------------------------------------------------------
-UnpackedK32Plot UnpackedK32Plot::Load( IPlotFile** plotFile, ThreadPool& pool, uint32 threadCount )
+UnpackedK32Plot UnpackedK32Plot::Load( IPlotFile** plotFile, ThreadPool& pool, uint32 threadCount, const bool useGpu )
 {
     ASSERT( plotFile );
     const uint32 k = plotFile[0]->K();
@@ -963,6 +1296,30 @@ UnpackedK32Plot UnpackedK32Plot::Load( IPlotFile** plotFile, ThreadPool& pool, u
         });
     }
 
+    // Decode the line point parks in batches on the GPU, if requested
+    static constexpr uint32 GpuParkBatchSize = 2048;
+
+    IGpuParkDecoder* parkDecoder    = nullptr;
+    uint128*         gpuLinePoints  = nullptr;
+    uint64*          gpuEntryCounts = nullptr;
+
+    if( useGpu )
+    {
+        uint32 maxSectionSize = 0;
+        for( TableId table = TableId::Table1; table <= TableId::Table6; table++ )
+            maxSectionSize = std::max( maxSectionSize, (uint32)plotReader.GetParkDeltasSectionMaxSize( table ) );
+
+        parkDecoder = CudaParkDecoderFactory::Create( 0, GpuParkBatchSize, maxSectionSize );
+
+        if( parkDecoder )
+        {
+            gpuLinePoints  = bbcvirtallocboundednuma<uint128>( (size_t)GpuParkBatchSize * kEntriesPerPark );
+            gpuEntryCounts = bbcalloc<uint64>( GpuParkBatchSize );
+        }
+        else
+            Log::Line( "Warning: Failed to create a GPU park decoder, parks will be decoded on the CPU." );
+    }
+
     auto LoadBackPtrTable = [&]( const TableId table ) {
 
         Log::Line( "Loading table %u", table+1 );
@@ -973,6 +1330,65 @@ UnpackedK32Plot UnpackedK32Plot::Load( IPlotFile** plotFile, ThreadPool& pool, u
         uint64     missingParks   = 0;
         uint64     missingEntries = 0;
 
+        if( parkDecoder )
+        {
+            Pair* tableWriter = backPointers.Ptr();
+
+            for( uint64 batchStart = 0; batchStart < plotParkCount; batchStart += GpuParkBatchSize )
+            {
+                const uint32 parkCount = (uint32)std::min( (uint64)GpuParkBatchSize, plotParkCount - batchStart );
+
+                FatalIf( !plotReader.ReadLPParks( table, batchStart, parkCount, *parkDecoder, gpuLinePoints, gpuEntryCounts ),
+                    "Failed to decode table %u parks on the GPU.", table+1 );
+
+                // There may be empty space after the actual parks end, so we stop at the first park that fails
+                uint32 readCount = 0;
+                while( readCount < parkCount && gpuEntryCounts[readCount] > 0 )
+                    readCount++;
+
+                for( uint32 i = 0; i < readCount; i++ )
+                {
+                    if( gpuEntryCounts[i] < kEntriesPerPark )
+                    {
+                        // We only allow incomplete parks at the end
+                        FatalIf( i + 1 != readCount || ( readCount == parkCount && batchStart + parkCount != plotParkCount ),
+                            "Encountered a non-full park for table %u at index %llu. These are unsupported", table+1, batchStart + i );
+
+                        missingEntries = kEntriesPerPark - gpuEntryCounts[i];
+                    }
+                }
+
+                AnonMTJob::Run( pool, threadCount, [&]( AnonMTJob* self ) {
+
+                    uint64 count, offset, end;
+                    GetThreadOffsets( self, (uint64)readCount, count, offset, end );
+
+                    for( uint64 i = offset; i < end; i++ )
+                    {
+                        const uint128* linePoints = gpuLinePoints + i * kEntriesPerPark;
+                              Pair*    writer     = tableWriter   + i * kEntriesPerPark;
+
+                        for( uint64 e = 0; e < gpuEntryCounts[i]; e++ )
+                        {
+                            const BackPtr bp = LinePointToSquare64( (uint64)linePoints[e] );
+                            writer[e].left  = (uint32)bp.x;
+                            writer[e].right = (uint32)bp.y;
+                        }
+                    }
+                });
+
+                if( readCount < parkCount || missingEntries )
+                {
+                    missingParks = plotParkCount - ( batchStart + readCount );
+                    break;
+                }
+
+                tableWriter += (uint64)parkCount * kEntriesPerPark;
+            }
+
+            const uint64 tableEntryCount = ( plotParkCount * kEntriesPerPark ) - ( missingParks * kEntriesPerPark + missingEntries );
+            return backPointers.Slice( 0, tableEntryCount );
+        }
 
         AnonMTJob::Run( pool, threadCount, [&]( AnonMTJob* self ) {
         
@@ -1061,6 +1477,13 @@ UnpackedK32Plot UnpackedK32Plot::Load( IPlotFile** plotFile, ThreadPool& pool, u
     plot.tables[(int)TableId::Table3] = LoadBackPtrTable( TableId::Table3 );
     plot.tables[(int)TableId::Table2] = LoadBackPtrTable( TableId::Table2 );
     plot.tables[(int)TableId::Table1] = LoadBackPtrTable( TableId::Table1 );
+
+    if( parkDecoder )
+    {
+        delete parkDecoder;
+        bbvirtfreebounded( gpuLinePoints );
+        free( gpuEntryCounts );
+    }
     
     Log::Line( "Decompressed plot into memory." );
     return plot;
@@ -1213,86 +1636,6 @@ bool FetchProof( PlotReader& plot, uint64 t6LPIndex, uint64 fullProofXs[PROOF_X_
     return true;
 }
 
-//-----------------------------------------------------------
-bool ValidateFullProof( const uint32 k, const byte plotId[BB_PLOT_ID_LEN], uint64 fullProofXs[PROOF_X_COUNT], uint64& outF7 )
-{
-    uint64   fx  [PROOF_X_COUNT];
-    MetaBits meta[PROOF_X_COUNT];
-
-    // Convert these x's to f1 values
-    {
-        const uint32 xShift = k - kExtraBits;
-
-        // Prepare ChaCha key
-        byte key[32] = { 1 };
-        memcpy( key + 1, plotId, 31 );
-
-        chacha8_ctx chacha;
-        chacha8_keysetup( &chacha, key, 256, NULL );
-
-        // Enough to hold 2 cha-cha blocks since a value my span over 2 blocks
-        byte blocks[kF1BlockSize*2];
-
-        for( uint32 i = 0; i < PROOF_X_COUNT; i++ )
-        {
-            const uint64 x        = fullProofXs[i];
-            const uint64 blockIdx = x * k / kF1BlockSizeBits; 
-
-            chacha8_get_keystream( &chacha, blockIdx, 2, blocks );
-
-            // Get the starting and end locations of y in bits relative to our block
-            const uint64 bitStart = x * k - blockIdx * kF1BlockSizeBits;
-
-            CPBitReader hashBits( blocks, sizeof( blocks ) * 8 );
-            hashBits.Seek( bitStart );
-
-            // uint64 y = SliceUInt64FromBits( blocks, bitStart, k ); // #TODO: Figure out what's wrong with this method.
-            uint64 y = hashBits.Read64( k );
-            y = ( y << kExtraBits ) | ( x >> xShift );
-
-            fx  [i] = y;
-            meta[i] = MetaBits( x, k );
-        }
-    }
-
-    // Forward propagate f1 values to get the final f7
-    uint32 iterCount = PROOF_X_COUNT;
-    for( TableId table = TableId::Table2; table <= TableId::Table7; table++, iterCount >>= 1)
-    {
-        for( uint32 i = 0, dst = 0; i < iterCount; i+= 2, dst++ )
-        {
-            uint64 y0 = fx[i+0];
-            uint64 y1 = fx[i+1];
-
-            const MetaBits* lMeta = &meta[i+0];
-            const MetaBits* rMeta = &meta[i+1];
-
-            if( y0 > y1 ) 
-            {
-                std::swap( y0, y1 );
-                std::swap( lMeta, rMeta );
-            }
-
-            // Must be on the same group
-            if( !FxMatch( y0, y1 ) )
-                return false;
-
-            // FxGen
-            uint64 outY;
-            MetaBits outMeta;
-            FxGen( table, k, y0, *lMeta, *rMeta, outY, outMeta );
-
-            fx  [dst] = outY;
-            meta[dst] = outMeta;
-        }
-    }
-
-    outF7 = fx[0] >> kExtraBits;
-
-    return true;
-}
-
-
 // #TODO: Avoid code duplication here? At least for f1
 //-----------------------------------------------------------
 void ReorderProof( PlotReader& plot, uint64 fullProofXs[PROOF_X_COUNT] )
@@ -1382,89 +1725,6 @@ void GetProofF1( uint32 k, const byte plotId[BB_PLOT_ID_LEN], uint64 fullProofXs
     }
 }
 
-//-----------------------------------------------------------
-bool FxMatch( uint64 yL, uint64 yR )
-{
-    LoadLTargets();
-
-    const uint64 groupL = yL / kBC;
-    const uint64 groupR = yR / kBC;
-
-    if( groupR - groupL != 1 )
-        return false;
-
-    // Groups are adjacent, check if the y values actually match
-    const uint16 parity = groupL & 1;
-
-    const uint64 groupLRangeStart = groupL * kBC;
-    const uint64 groupRRangeStart = groupR * kBC;
-
-    const uint64 localLY = yL - groupLRangeStart;
-    const uint64 localRY = yR - groupRRangeStart;
-    
-    for( int iK = 0; iK < kExtraBitsPow; iK++ )
-    {
-        const uint64 targetR = L_targets[parity][localLY][iK];
-        
-        if( targetR == localRY )
-            return true;
-    } 
-
-    return false;
-}
-
-//-----------------------------------------------------------
-void FxGen( const TableId table, const uint32 k, 
-            const uint64 y, const MetaBits& metaL, const MetaBits& metaR,
-            uint64& outY, MetaBits& outMeta )
-{
-    FxBits input( y, k + kExtraBits );
-
-    if( table < TableId::Table4 )
-    {
-        outMeta = metaL + metaR;
-        input += outMeta;
-    }
-    else
-    {
-        input += metaL;
-        input += metaR;
-    }
-
-    byte inputBytes[64];
-    byte hashBytes [32];
-
-    input.ToBytes( inputBytes );
-
-    blake3_hasher hasher;
-    blake3_hasher_init    ( &hasher );
-    blake3_hasher_update  ( &hasher, inputBytes, input.LengthBytes() );
-    blake3_hasher_finalize( &hasher, hashBytes, sizeof( hashBytes ) );
-
-    outY = BytesToUInt64( hashBytes ) >> ( 64 - (k + kExtraBits) );
-
-    if( table >= TableId::Table4 && table < TableId::Table7 )
-    {
-        size_t multiplier = 0;
-        switch( table )
-        {
-            case TableId::Table4: multiplier = TableMetaOut<TableId::Table4>::Multiplier; break;
-            case TableId::Table5: multiplier = TableMetaOut<TableId::Table5>::Multiplier; break;
-            case TableId::Table6: multiplier = TableMetaOut<TableId::Table6>::Multiplier; break;
-            default: 
-                ASSERT( 0 );
-                break;
-        }
-
-        const uint32 metaBits  = (uint32)( k * multiplier );
-        const uint32 yBits     = k + kExtraBits;
-        const uint32 startByte = yBits / 8 ;
-        const uint32 startBit  = yBits - startByte * 8;
-
-        outMeta = MetaBits( hashBytes + startByte, metaBits, startBit );
-    }
-}
-
 //-----------------------------------------------------------
 // Treats bytes as a set of 64-bit big-endian fields,
 // from which it will extract a whole 64-bit value
@@ -1502,11 +1762,14 @@ inline uint64 SliceUInt64FromBits( const byte* bytes, uint32 bitOffset, uint32 b
 //-----------------------------------------------------------
 void TVLog( const uint32 id, const char* msg, va_list args )
 {
-    _logLock.lock();
-    fprintf( stdout, "[%3u] ", id );
-    vfprintf( stdout, msg, args );
-    putc( '\n', stdout );
-    _logLock.unlock();
+    if( _logSilent )
+        return;
+
+    // Format here, so that the line is written as a whole, without taking a lock
+    char line[1024];
+    vsnprintf( line, sizeof( line ), msg, args );
+
+    Log::Line( "[%3u] %s", id, line );
 }
 
 //-----------------------------------------------------------
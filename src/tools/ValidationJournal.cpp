@@ -0,0 +1,210 @@
+#include "ValidationJournal.h"
+#include "util/Log.h"
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+//-----------------------------------------------------------
+static void WriteParkRanges( std::ostream& out, const std::vector<bool>& parks )
+{
+    bool any = false;
+
+    for( size_t i = 0; i < parks.size(); )
+    {
+        if( !parks[i] )
+        {
+            i++;
+            continue;
+        }
+
+        size_t end = i + 1;
+        while( end < parks.size() && parks[end] )
+            end++;
+
+        out << ( any ? "," : "" ) << i << "-" << end;
+        any = true;
+        i   = end;
+    }
+
+    if( !any )
+        out << "-";
+}
+
+//-----------------------------------------------------------
+static bool ReadParkRanges( const std::string& str, std::vector<bool>& parks )
+{
+    if( str == "-" )
+        return true;
+
+    std::istringstream in( str );
+    std::string range;
+
+    while( std::getline( in, range, ',' ) )
+    {
+        unsigned long long start = 0, end = 0;
+        if( sscanf( range.c_str(), "%llu-%llu", &start, &end ) != 2 || start > end || end > parks.size() )
+            return false;
+
+        for( uint64 i = start; i < end; i++ )
+            parks[i] = true;
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------
+bool ValidationJournal::Open( const char* path )
+{
+    _path     = path;
+    _lastSave = std::chrono::steady_clock::now();
+
+    std::error_code err;
+    if( !fs::exists( path, err ) )
+        return true;
+
+    std::ifstream file( path );
+    if( !file )
+        return false;
+
+    std::string line;
+    while( std::getline( file, line ) )
+    {
+        if( line.empty() || line[0] == '#' )
+            continue;
+
+        std::istringstream in( line );
+
+        std::string            plotId, done, failed;
+        ValidationJournalEntry entry;
+
+        if( !( in >> plotId >> entry.fileSize >> entry.fileMTime >> entry.parkCount >> entry.failCount >> done >> failed ) )
+        {
+            Log::Error( "Warning: Ignoring malformed validation journal line: %s", line.c_str() );
+            continue;
+        }
+
+        entry.parksDone  .assign( entry.parkCount, false );
+        entry.parksFailed.assign( entry.parkCount, false );
+
+        if( !ReadParkRanges( done, entry.parksDone ) || !ReadParkRanges( failed, entry.parksFailed ) )
+        {
+            Log::Error( "Warning: Ignoring malformed validation journal line: %s", line.c_str() );
+            continue;
+        }
+
+        _entries[plotId] = std::move( entry );
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------
+bool ValidationJournal::Save()
+{
+    std::lock_guard<std::mutex> lock( _lock );
+    return SaveLocked();
+}
+
+//-----------------------------------------------------------
+bool ValidationJournal::SaveLocked()
+{
+    _lastSave = std::chrono::steady_clock::now();
+
+    // Write to a temporary file first, so that an interrupted save never loses the journal
+    const std::string tmpPath = _path + ".tmp";
+    {
+        std::ofstream file( tmpPath, std::ios::trunc );
+        if( !file )
+        {
+            Log::Error( "Failed to write validation journal '%s'.", tmpPath.c_str() );
+            return false;
+        }
+
+        file << "# bladebit validation journal\n";
+        file << "# plot_id file_size mtime c3_parks failed_proofs validated_parks failed_parks\n";
+
+        for( auto& it : _entries )
+        {
+            const auto& e = it.second;
+
+            file << it.first << " " << e.fileSize << " " << e.fileMTime << " " << e.parkCount << " " << e.failCount << " ";
+            WriteParkRanges( file, e.parksDone );
+            file << " ";
+            WriteParkRanges( file, e.parksFailed );
+            file << "\n";
+        }
+
+        if( !file.flush() )
+        {
+            Log::Error( "Failed to write validation journal '%s'.", tmpPath.c_str() );
+            return false;
+        }
+    }
+
+    std::error_code err;
+    fs::rename( tmpPath, _path, err );
+    if( err )
+    {
+        Log::Error( "Failed to replace validation journal '%s': %s", _path.c_str(), err.message().c_str() );
+        return false;
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------
+ValidationJournalEntry& ValidationJournal::BeginPlot( const std::string& plotIdHex, const uint64 fileSize, const int64 fileMTime, const uint64 parkCount )
+{
+    std::lock_guard<std::mutex> lock( _lock );
+
+    auto& entry = _entries[plotIdHex];
+
+    if( entry.fileSize != fileSize || entry.fileMTime != fileMTime || entry.parkCount != parkCount )
+    {
+        entry = {};
+        entry.fileSize  = fileSize;
+        entry.fileMTime = fileMTime;
+        entry.parkCount = parkCount;
+        entry.parksDone  .assign( parkCount, false );
+        entry.parksFailed.assign( parkCount, false );
+    }
+
+    return entry;
+}
+
+//-----------------------------------------------------------
+void ValidationJournal::MarkPark( ValidationJournalEntry& entry, const uint64 parkIndex, const uint64 failedProofs )
+{
+    std::lock_guard<std::mutex> lock( _lock );
+
+    ASSERT( parkIndex < entry.parkCount );
+    if( parkIndex >= entry.parkCount || entry.parksDone[parkIndex] )
+        return;
+
+    entry.parksDone[parkIndex]   = true;
+    entry.parksFailed[parkIndex] = failedProofs > 0;
+    entry.failCount             += failedProofs;
+
+    const double sinceSave = std::chrono::duration<double>( std::chrono::steady_clock::now() - _lastSave ).count();
+    if( sinceSave >= saveInterval )
+        SaveLocked();
+}
+
+//-----------------------------------------------------------
+bool ValidationJournal::GetFileInfo( const char* path, uint64& outSize, int64& outMTime )
+{
+    std::error_code err;
+
+    outSize = (uint64)fs::file_size( path, err );
+    if( err )
+        return false;
+
+    const auto mtime = fs::last_write_time( path, err );
+    if( err )
+        return false;
+
+    outMTime = (int64)mtime.time_since_epoch().count();
+    return true;
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include "util/Util.h"
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <chrono>
+
+///
+/// Persistent record of plot validation progress, so that sweeping a large
+/// farm can be interrupted and resumed, and plots that were already validated
+/// are skipped unless their file changed.
+///
+/// The journal is a text file with one line per plot:
+///  <plot_id_hex> <file_size> <mtime> <c3_park_count> <failed_proofs> <validated_parks> <failed_parks>
+/// Park lists are comma-separated half-open ranges (ex: 0-1000,2000-2100), or '-' if empty.
+///
+struct ValidationJournalEntry
+{
+    uint64              fileSize   = 0;
+    int64               fileMTime  = 0;
+    uint64              parkCount  = 0;
+    uint64              failCount  = 0;     // Failed proofs in the validated parks
+    std::vector<bool>   parksDone;          // Indexed by C3 park
+    std::vector<bool>   parksFailed;        // Parks with at least one failed proof
+
+    inline bool IsComplete() const
+    {
+        for( size_t i = 0; i < parksDone.size(); i++ )
+            if( !parksDone[i] )
+                return false;
+
+        return parkCount > 0;
+    }
+
+    inline uint64 DoneCount() const
+    {
+        uint64 count = 0;
+        for( size_t i = 0; i < parksDone.size(); i++ )
+            count += parksDone[i] ? 1 : 0;
+
+        return count;
+    }
+};
+
+class ValidationJournal
+{
+public:
+    // Loads the journal at path, if it exists.
+    // Returns false if the file exists but could not be read.
+    bool Open( const char* path );
+
+    // Atomically replaces the journal file with the current entries
+    bool Save();
+
+    // Returns the entry for the plot, reset if the plot file's size or mtime changed
+    // or the park count differs, so that the plot is validated from scratch.
+    ValidationJournalEntry& BeginPlot( const std::string& plotIdHex, uint64 fileSize, int64 fileMTime, uint64 parkCount );
+
+    // Records a validated park. Saves the journal if saveInterval seconds went by since the last save.
+    // Thread-safe.
+    void MarkPark( ValidationJournalEntry& entry, uint64 parkIndex, uint64 failedProofs );
+
+    // Gets the size and modification time of a plot file
+    static bool GetFileInfo( const char* path, uint64& outSize, int64& outMTime );
+
+public:
+    double saveInterval = 30.0;
+
+private:
+    bool SaveLocked();
+
+private:
+    std::string                                             _path;
+    std::unordered_map<std::string, ValidationJournalEntry> _entries;
+    std::mutex                                              _lock;
+    std::chrono::steady_clock::time_point                   _lastSave;
+};
@@ -0,0 +1,475 @@
+#include "BitUnpack.h"
+#include "util/BitView.h"
+#include "util/Util.h"
+#include "SysHost.h"
+
+///
+/// Each entry is read from the 2 fields that may hold it, and funnel-shifted into place,
+/// so that no entry depends on the one before it, and there is no branch on whether it crosses a field.
+/// Entries whose second field lies past the last field of the stream are read with BitReader instead.
+///
+/// The AVX2 and AVX-512 kernels gather 4 or 8 entries at a time. They are compiled with
+/// function-level target attributes, and are only called after checking CPU support at runtime.
+/// The AVX-512 map kernel also scatters the values to their destination with a single instruction.
+///
+/// Chiapos-compatible (big-endian) streams are read with an unaligned 8-byte load at the entry's first byte,
+/// byte-swapped, so that any entry of up to 57 bits is a single load and 2 shifts.
+/// The AVX2 kernel gathers those loads 4 at a time and byte-swaps them with a shuffle.
+///
+
+#if defined( __x86_64__ ) || defined( _M_X64 )
+    #define BITUNPACK_X86 1
+    #include <immintrin.h>
+
+    #if defined( _MSC_VER ) && !defined( __clang__ )
+        #include <intrin.h>
+        #define BITUNPACK_TARGET( x )
+    #else
+        #define BITUNPACK_TARGET( x ) __attribute__((target( x )))
+    #endif
+#endif
+
+enum class BitUnpackSimd
+{
+    None = 0,
+    AVX2,
+    AVX512
+};
+
+//-----------------------------------------------------------
+static BitUnpackSimd GetBitUnpackSimd()
+{
+#if BITUNPACK_X86
+    if( SysHost::HasCpuFeatures( CpuFeatures::AVX512F ) )
+        return BitUnpackSimd::AVX512;
+    if( SysHost::HasCpuFeatures( CpuFeatures::AVX2 ) )
+        return BitUnpackSimd::AVX2;
+#endif
+    return BitUnpackSimd::None;
+}
+
+//-----------------------------------------------------------
+inline static BitUnpackSimd BitUnpackSimdLevel()
+{
+    static const BitUnpackSimd simd = GetBitUnpackSimd();
+    return simd;
+}
+
+//-----------------------------------------------------------
+inline static uint64 BitMask( const uint32 bitCount )
+{
+    ASSERT( bitCount > 0 && bitCount <= 64 );
+    return 0xFFFFFFFFFFFFFFFFull >> ( 64 - bitCount );
+}
+
+/// Returns how many of the first count entries, of entryBits bits, have the field at fieldOffset bits into them
+/// followed by another field of the stream, so that they can be read without checking whether they cross it.
+//-----------------------------------------------------------
+inline static uint64 GetUncheckedCount( const uint64 bitOffset, const uint64 count, const uint32 entryBits, const uint32 fieldOffset )
+{
+    if( count == 0 )
+        return 0;
+
+    const uint64 lastField = ( bitOffset + count * entryBits - 1 ) >> 6;
+    const uint64 start     = bitOffset + fieldOffset;
+    const uint64 end       = lastField * 64;
+
+    if( end <= start )
+        return 0;
+
+    return std::min( count, CDiv( end - start, (uint64)entryBits ) );
+}
+
+//-----------------------------------------------------------
+inline static uint64 ReadFieldUnchecked( const uint64* fields, const uint64 position, const uint64 mask )
+{
+    const uint64 i = position >> 6;
+    const uint32 s = (uint32)position & 63;
+
+    // Shifting the high field twice keeps the shift below 64 when s == 0
+    return ( ( fields[i] >> s ) | ( ( fields[i+1] << 1 ) << ( 63 - s ) ) ) & mask;
+}
+
+/// Returns how many of the first count entries of a big-endian stream of sizeBits bits
+/// have the 8 bytes starting at their first byte in the stream.
+//-----------------------------------------------------------
+inline static uint64 GetUncheckedCountBE( const uint64 bitOffset, const uint64 count, const uint32 entryBits, const size_t sizeBits )
+{
+    const uint64 byteCount = CDiv( (uint64)sizeBits, 8 );
+
+    // Entries wider than 57 bits may span 9 bytes
+    if( count == 0 || entryBits > 57 || byteCount < 8 )
+        return 0;
+
+    const uint64 lastBit = ( byteCount - 8 ) * 8 + 7;     // Last bit at which an 8-byte load may start
+    if( bitOffset > lastBit )
+        return 0;
+
+    return std::min( count, ( lastBit - bitOffset ) / entryBits + 1 );
+}
+
+//-----------------------------------------------------------
+inline static uint64 ReadFieldBEUnchecked( const byte* bytes, const uint64 position, const uint32 bitCount )
+{
+    uint64 field;
+    memcpy( &field, bytes + ( position >> 3 ), sizeof( field ) );
+
+    return ( Swap64( field ) << ( position & 7 ) ) >> ( 64 - bitCount );
+}
+
+#if BITUNPACK_X86
+
+//-----------------------------------------------------------
+BITUNPACK_TARGET( "avx2" )
+inline static __m256i ReadFieldsAVX2( const uint64* fields, const __m256i bit, const __m256i mask )
+{
+    const __m256i index = _mm256_srli_epi64( bit, 6 );
+    const __m256i shift = _mm256_and_si256( bit, _mm256_set1_epi64x( 63 ) );
+
+    const __m256i lo = _mm256_i64gather_epi64( (const long long*)fields,       index, 8 );
+    const __m256i hi = _mm256_i64gather_epi64( (const long long*)( fields+1 ), index, 8 );
+
+    // Shifts of 64 produce 0, so no special case for entries starting at a field boundary
+    const __m256i v = _mm256_or_si256( _mm256_srlv_epi64( lo, shift ),
+                                       _mm256_sllv_epi64( hi, _mm256_sub_epi64( _mm256_set1_epi64x( 64 ), shift ) ) );
+    return _mm256_and_si256( v, mask );
+}
+
+//-----------------------------------------------------------
+BITUNPACK_TARGET( "avx512f" )
+inline static __m512i ReadFieldsAVX512( const uint64* fields, const __m512i bit, const __m512i mask )
+{
+    const __m512i index = _mm512_srli_epi64( bit, 6 );
+    const __m512i shift = _mm512_and_si512( bit, _mm512_set1_epi64( 63 ) );
+
+    const __m512i lo = _mm512_i64gather_epi64( index, (const void*)fields,       8 );
+    const __m512i hi = _mm512_i64gather_epi64( index, (const void*)( fields+1 ), 8 );
+
+    const __m512i v = _mm512_or_si512( _mm512_srlv_epi64( lo, shift ),
+                                       _mm512_sllv_epi64( hi, _mm512_sub_epi64( _mm512_set1_epi64( 64 ), shift ) ) );
+    return _mm512_and_si512( v, mask );
+}
+
+//-----------------------------------------------------------
+BITUNPACK_TARGET( "avx2" )
+inline static __m256i FirstBitsAVX2( const uint64 bitOffset, const uint32 entryBits )
+{
+    const int64 o = (int64)bitOffset, w = entryBits;
+    return _mm256_setr_epi64x( o, o + w, o + w * 2, o + w * 3 );
+}
+
+//-----------------------------------------------------------
+BITUNPACK_TARGET( "avx512f" )
+inline static __m512i FirstBitsAVX512( const uint64 bitOffset, const uint32 entryBits )
+{
+    const int64 o = (int64)bitOffset, w = entryBits;
+    return _mm512_set_epi64( o + w * 7, o + w * 6, o + w * 5, o + w * 4, o + w * 3, o + w * 2, o + w, o );
+}
+
+//-----------------------------------------------------------
+BITUNPACK_TARGET( "avx2" )
+static uint64 UnpackBitsAVX2( const uint64* fields, const uint64 bitOffset, const uint64 simdCount, const uint32 bitSize, uint64* outEntries )
+{
+    const __m256i mask = _mm256_set1_epi64x( (int64)BitMask( bitSize ) );
+    const __m256i step = _mm256_set1_epi64x( (int64)bitSize * 4 );
+
+    __m256i bit = FirstBitsAVX2( bitOffset, bitSize );
+
+    for( uint64 i = 0; i < simdCount; i += 4, bit = _mm256_add_epi64( bit, step ) )
+        _mm256_storeu_si256( (__m256i*)( outEntries + i ), ReadFieldsAVX2( fields, bit, mask ) );
+
+    return simdCount;
+}
+
+//-----------------------------------------------------------
+BITUNPACK_TARGET( "avx2" )
+static uint64 UnpackBitsBEAVX2( const byte* bytes, const uint64 bitOffset, const uint64 simdCount, const uint32 bitSize, uint64* outEntries )
+{
+    const __m256i swap     = _mm256_setr_epi8( 7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+                                               7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8 );
+    const __m256i seven    = _mm256_set1_epi64x( 7 );
+    const __m256i topShift = _mm256_set1_epi64x( 64 - bitSize );
+    const __m256i step     = _mm256_set1_epi64x( (int64)bitSize * 4 );
+
+    __m256i bit = FirstBitsAVX2( bitOffset, bitSize );
+
+    for( uint64 i = 0; i < simdCount; i += 4, bit = _mm256_add_epi64( bit, step ) )
+    {
+        const __m256i index = _mm256_srli_epi64( bit, 3 );
+
+        __m256i v = _mm256_i64gather_epi64( (const long long*)bytes, index, 1 );
+        v = _mm256_shuffle_epi8( v, swap );
+        v = _mm256_srlv_epi64( _mm256_sllv_epi64( v, _mm256_and_si256( bit, seven ) ), topShift );
+
+        _mm256_storeu_si256( (__m256i*)( outEntries + i ), v );
+    }
+
+    return simdCount;
+}
+
+//-----------------------------------------------------------
+BITUNPACK_TARGET( "avx512f" )
+static uint64 UnpackBitsAVX512( const uint64* fields, const uint64 bitOffset, const uint64 simdCount, const uint32 bitSize, uint64* outEntries )
+{
+    const __m512i mask = _mm512_set1_epi64( (int64)BitMask( bitSize ) );
+    const __m512i step = _mm512_set1_epi64( (int64)bitSize * 8 );
+
+    __m512i bit = FirstBitsAVX512( bitOffset, bitSize );
+
+    for( uint64 i = 0; i < simdCount; i += 8, bit = _mm512_add_epi64( bit, step ) )
+        _mm512_storeu_si512( (void*)( outEntries + i ), ReadFieldsAVX512( fields, bit, mask ) );
+
+    return simdCount;
+}
+
+//-----------------------------------------------------------
+BITUNPACK_TARGET( "avx2" )
+static uint64 UnpackBitPairsAVX2( const uint64* fields, const uint64 bitOffset, const uint64 simdCount,
+                                  const uint32 loBits, const uint32 hiBits, const uint64 loPrefix, uint64* outLo, uint64* outHi )
+{
+    const uint32  entryBits = loBits + hiBits;
+    const __m256i loMask    = _mm256_set1_epi64x( (int64)BitMask( loBits ) );
+    const __m256i hiMask    = _mm256_set1_epi64x( (int64)BitMask( hiBits ) );
+    const __m256i prefix    = _mm256_set1_epi64x( (int64)loPrefix );
+    const __m256i hiOffset  = _mm256_set1_epi64x( (int64)loBits );
+    const __m256i step      = _mm256_set1_epi64x( (int64)entryBits * 4 );
+
+    __m256i bit = FirstBitsAVX2( bitOffset, entryBits );
+
+    for( uint64 i = 0; i < simdCount; i += 4, bit = _mm256_add_epi64( bit, step ) )
+    {
+        const __m256i lo = ReadFieldsAVX2( fields, bit, loMask );
+        const __m256i hi = ReadFieldsAVX2( fields, _mm256_add_epi64( bit, hiOffset ), hiMask );
+
+        _mm256_storeu_si256( (__m256i*)( outLo + i ), _mm256_or_si256( lo, prefix ) );
+        _mm256_storeu_si256( (__m256i*)( outHi + i ), hi );
+    }
+
+    return simdCount;
+}
+
+//-----------------------------------------------------------
+BITUNPACK_TARGET( "avx512f" )
+static uint64 UnpackBitPairsAVX512( const uint64* fields, const uint64 bitOffset, const uint64 simdCount,
+                                    const uint32 loBits, const uint32 hiBits, const uint64 loPrefix, uint64* outLo, uint64* outHi )
+{
+    const uint32  entryBits = loBits + hiBits;
+    const __m512i loMask    = _mm512_set1_epi64( (int64)BitMask( loBits ) );
+    const __m512i hiMask    = _mm512_set1_epi64( (int64)BitMask( hiBits ) );
+    const __m512i prefix    = _mm512_set1_epi64( (int64)loPrefix );
+    const __m512i hiOffset  = _mm512_set1_epi64( (int64)loBits );
+    const __m512i step      = _mm512_set1_epi64( (int64)entryBits * 8 );
+
+    __m512i bit = FirstBitsAVX512( bitOffset, entryBits );
+
+    for( uint64 i = 0; i < simdCount; i += 8, bit = _mm512_add_epi64( bit, step ) )
+    {
+        const __m512i lo = ReadFieldsAVX512( fields, bit, loMask );
+        const __m512i hi = ReadFieldsAVX512( fields, _mm512_add_epi64( bit, hiOffset ), hiMask );
+
+        _mm512_storeu_si512( (void*)( outLo + i ), _mm512_or_si512( lo, prefix ) );
+        _mm512_storeu_si512( (void*)( outHi + i ), hi );
+    }
+
+    return simdCount;
+}
+
+//-----------------------------------------------------------
+template<typename T>
+BITUNPACK_TARGET( "avx2" )
+static uint64 UnpackMapScatterAVX2( const uint64* fields, const uint64 bitOffset, const uint64 simdCount,
+                                    const uint32 bitSize, const uint32 valueBits, T* dst )
+{
+    const __m256i mask      = _mm256_set1_epi64x( (int64)BitMask( bitSize ) );
+    const __m256i valueMask = _mm256_set1_epi64x( (int64)BitMask( valueBits ) );
+    const __m128i idxShift  = _mm_cvtsi32_si128( (int)valueBits );
+    const __m256i step      = _mm256_set1_epi64x( (int64)bitSize * 4 );
+
+    __m256i bit = FirstBitsAVX2( bitOffset, bitSize );
+
+    alignas( 32 ) uint64 indices[4];
+    alignas( 32 ) uint64 values [4];
+
+    for( uint64 i = 0; i < simdCount; i += 4, bit = _mm256_add_epi64( bit, step ) )
+    {
+        const __m256i v = ReadFieldsAVX2( fields, bit, mask );
+
+        _mm256_store_si256( (__m256i*)indices, _mm256_srl_epi64( v, idxShift ) );
+        _mm256_store_si256( (__m256i*)values,  _mm256_and_si256( v, valueMask ) );
+
+        // No scatter in AVX2
+        dst[indices[0]] = (T)values[0];
+        dst[indices[1]] = (T)values[1];
+        dst[indices[2]] = (T)values[2];
+        dst[indices[3]] = (T)values[3];
+    }
+
+    return simdCount;
+}
+
+//-----------------------------------------------------------
+template<typename T>
+BITUNPACK_TARGET( "avx512f" )
+static uint64 UnpackMapScatterAVX512( const uint64* fields, const uint64 bitOffset, const uint64 simdCount,
+                                      const uint32 bitSize, const uint32 valueBits, T* dst )
+{
+    const __m512i mask      = _mm512_set1_epi64( (int64)BitMask( bitSize ) );
+    const __m512i valueMask = _mm512_set1_epi64( (int64)BitMask( valueBits ) );
+    const __m128i idxShift  = _mm_cvtsi32_si128( (int)valueBits );
+    const __m512i step      = _mm512_set1_epi64( (int64)bitSize * 8 );
+
+    __m512i bit = FirstBitsAVX512( bitOffset, bitSize );
+
+    for( uint64 i = 0; i < simdCount; i += 8, bit = _mm512_add_epi64( bit, step ) )
+    {
+        const __m512i v     = ReadFieldsAVX512( fields, bit, mask );
+        const __m512i index = _mm512_srl_epi64( v, idxShift );
+        const __m512i value = _mm512_and_si512( v, valueMask );
+
+        if constexpr ( sizeof( T ) == sizeof( uint32 ) )
+            _mm512_i64scatter_epi32( (void*)dst, index, _mm512_cvtepi64_epi32( value ), 4 );
+        else
+            _mm512_i64scatter_epi64( (void*)dst, index, value, 8 );
+    }
+
+    return simdCount;
+}
+
+#endif // BITUNPACK_X86
+
+//-----------------------------------------------------------
+void UnpackBits( const uint64* fields, const uint64 bitOffset, const uint64 count, const uint32 bitSize, uint64* outEntries )
+{
+    ASSERT( bitSize > 0 && bitSize <= 64 );
+
+    const uint64 uncheckedCount = GetUncheckedCount( bitOffset, count, bitSize, 0 );
+    const uint64 mask           = BitMask( bitSize );
+
+    uint64 i = 0;
+
+#if BITUNPACK_X86
+    switch( BitUnpackSimdLevel() )
+    {
+        case BitUnpackSimd::AVX512: i = UnpackBitsAVX512( fields, bitOffset, uncheckedCount / 8 * 8, bitSize, outEntries ); break;
+        case BitUnpackSimd::AVX2  : i = UnpackBitsAVX2  ( fields, bitOffset, uncheckedCount / 4 * 4, bitSize, outEntries ); break;
+        default: break;
+    }
+#endif
+
+    for( ; i < uncheckedCount; i++ )
+        outEntries[i] = ReadFieldUnchecked( fields, bitOffset + i * bitSize, mask );
+
+    for( ; i < count; i++ )
+        outEntries[i] = BitReader::ReadBits64( bitSize, fields, bitOffset + i * bitSize );
+}
+
+//-----------------------------------------------------------
+void UnpackBitsBE( const byte* bytesBE, const size_t sizeBits, const uint64 bitOffset, const uint64 count, const uint32 bitSize, uint64* outEntries )
+{
+    ASSERT( bitSize > 0 && bitSize <= 64 );
+    ASSERT( bitOffset + count * bitSize <= sizeBits );
+
+    const uint64 uncheckedCount = GetUncheckedCountBE( bitOffset, count, bitSize, sizeBits );
+
+    uint64 i = 0;
+
+#if BITUNPACK_X86
+    // Byte-granular gathers don't need the AVX-512 kernel's wider registers to be worth it
+    if( BitUnpackSimdLevel() != BitUnpackSimd::None )
+        i = UnpackBitsBEAVX2( bytesBE, bitOffset, uncheckedCount / 4 * 4, bitSize, outEntries );
+#endif
+
+    for( ; i < uncheckedCount; i++ )
+        outEntries[i] = ReadFieldBEUnchecked( bytesBE, bitOffset + i * bitSize, bitSize );
+
+    for( ; i < count; i++ )
+        outEntries[i] = CPBitReader::Read64( bitSize, bytesBE, bitOffset + i * bitSize, sizeBits );
+}
+
+//-----------------------------------------------------------
+void UnpackBitPairs( const uint64* fields, const uint64 bitOffset, const uint64 count, const uint32 loBits, const uint32 hiBits,
+                     const uint64 loPrefix, uint64* outLo, uint64* outHi )
+{
+    ASSERT( loBits > 0 && loBits <= 64 );
+    ASSERT( hiBits > 0 && hiBits <= 64 );
+
+    const uint32 entryBits      = loBits + hiBits;
+    const uint64 uncheckedCount = GetUncheckedCount( bitOffset, count, entryBits, loBits );
+    const uint64 loMask         = BitMask( loBits );
+    const uint64 hiMask         = BitMask( hiBits );
+
+    uint64 i = 0;
+
+#if BITUNPACK_X86
+    switch( BitUnpackSimdLevel() )
+    {
+        case BitUnpackSimd::AVX512: i = UnpackBitPairsAVX512( fields, bitOffset, uncheckedCount / 8 * 8, loBits, hiBits, loPrefix, outLo, outHi ); break;
+        case BitUnpackSimd::AVX2  : i = UnpackBitPairsAVX2  ( fields, bitOffset, uncheckedCount / 4 * 4, loBits, hiBits, loPrefix, outLo, outHi ); break;
+        default: break;
+    }
+#endif
+
+    for( ; i < uncheckedCount; i++ )
+    {
+        const uint64 position = bitOffset + i * entryBits;
+
+        outLo[i] = ReadFieldUnchecked( fields, position, loMask ) | loPrefix;
+        outHi[i] = ReadFieldUnchecked( fields, position + loBits, hiMask );
+    }
+
+    for( ; i < count; i++ )
+    {
+        const uint64 position = bitOffset + i * entryBits;
+
+        outLo[i] = BitReader::ReadBits64( loBits, fields, position ) | loPrefix;
+        outHi[i] = BitReader::ReadBits64( hiBits, fields, position + loBits );
+    }
+}
+
+//-----------------------------------------------------------
+template<typename T>
+static void UnpackMapScatterT( const uint64* fields, const uint64 bitOffset, const uint64 count,
+                               const uint32 bitSize, const uint32 valueBits, T* dst )
+{
+    ASSERT( bitSize > 0 && bitSize <= 64 );
+    ASSERT( valueBits > 0 && valueBits < bitSize );
+
+    const uint64 uncheckedCount = GetUncheckedCount( bitOffset, count, bitSize, 0 );
+    const uint64 mask           = BitMask( bitSize );
+    const uint64 valueMask      = BitMask( valueBits );
+
+    uint64 i = 0;
+
+#if BITUNPACK_X86
+    switch( BitUnpackSimdLevel() )
+    {
+        case BitUnpackSimd::AVX512: i = UnpackMapScatterAVX512<T>( fields, bitOffset, uncheckedCount / 8 * 8, bitSize, valueBits, dst ); break;
+        case BitUnpackSimd::AVX2  : i = UnpackMapScatterAVX2<T>  ( fields, bitOffset, uncheckedCount / 4 * 4, bitSize, valueBits, dst ); break;
+        default: break;
+    }
+#endif
+
+    for( ; i < uncheckedCount; i++ )
+    {
+        const uint64 packed = ReadFieldUnchecked( fields, bitOffset + i * bitSize, mask );
+        dst[packed >> valueBits] = (T)( packed & valueMask );
+    }
+
+    for( ; i < count; i++ )
+    {
+        const uint64 packed = BitReader::ReadBits64( bitSize, fields, bitOffset + i * bitSize );
+        dst[packed >> valueBits] = (T)( packed & valueMask );
+    }
+}
+
+//-----------------------------------------------------------
+void UnpackMapScatter( const uint64* fields, const uint64 bitOffset, const uint64 count, const uint32 bitSize, const uint32 valueBits, uint32* dst )
+{
+    UnpackMapScatterT( fields, bitOffset, count, bitSize, valueBits, dst );
+}
+
+//-----------------------------------------------------------
+void UnpackMapScatter( const uint64* fields, const uint64 bitOffset, const uint64 count, const uint32 bitSize, const uint32 valueBits, uint64* dst )
+{
+    UnpackMapScatterT( fields, bitOffset, count, bitSize, valueBits, dst );
+}
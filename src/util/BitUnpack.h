@@ -0,0 +1,26 @@
+#pragma once
+
+///
+/// Bulk unpacking of fixed-width entries from BitReader/BitWriter bit streams
+/// (LSB-first, in little-endian 64-bit fields), and from CPBitReader streams, for the hot loops
+/// that would otherwise call BitReader::ReadBits64 or CPBitReader::Read64 once per entry.
+/// Entries may be up to 64 bits wide, and only the fields holding the entries are read.
+///
+
+// Unpacks count entries of bitSize bits, starting at bit bitOffset of fields.
+void UnpackBits( const uint64* fields, uint64 bitOffset, uint64 count, uint32 bitSize, uint64* outEntries );
+
+// Unpacks count entries of bitSize bits from a chiapos-compatible stream of sizeBits bits (see CPBitReader),
+// starting at bit bitOffset. The stream does not need to be aligned, nor padded past its last byte.
+void UnpackBitsBE( const byte* bytesBE, size_t sizeBits, uint64 bitOffset, uint64 count, uint32 bitSize, uint64* outEntries );
+
+// Unpacks count entries of loBits + hiBits bits, each made up of a loBits-wide field followed by a hiBits-wide field.
+// loPrefix is OR'ed into each lo field.
+void UnpackBitPairs( const uint64* fields, uint64 bitOffset, uint64 count, uint32 loBits, uint32 hiBits,
+                     uint64 loPrefix, uint64* outLo, uint64* outHi );
+
+// Unpacks count map entries of bitSize bits, each holding a destination index above a valueBits-wide value,
+// and writes each value to dst[index] directly, without unpacking them to a buffer first.
+// The value is truncated to the width of dst's type.
+void UnpackMapScatter( const uint64* fields, uint64 bitOffset, uint64 count, uint32 bitSize, uint32 valueBits, uint32* dst );
+void UnpackMapScatter( const uint64* fields, uint64 bitOffset, uint64 count, uint32 bitSize, uint32 valueBits, uint64* dst );
@@ -1,5 +1,6 @@
 #pragma once
 #include "util/Util.h"
+#include "util/BitUnpack.h"
 
 // Chiapos-compatible bitreader
 class CPBitReader
@@ -62,6 +63,15 @@ public:
         return value;
     }
 
+    // Read count entries of bitCount bits at once
+    //-----------------------------------------------------------
+    inline void ReadN( const uint32 bitCount, const uint64 count, uint64* outValues )
+    {
+        ASSERT( _position + count * bitCount <= _sizeBits );
+        UnpackBitsBE( _fields, _sizeBits, _position, count, bitCount, outValues );
+        _position += count * bitCount;
+    }
+
      //-----------------------------------------------------------
     inline bool Read64Safe( const uint32 bitCount, uint64& outValue )
     {
@@ -265,6 +275,14 @@ public:
         return value;
     }
 
+    // Read count entries of bitCount bits at once
+    //-----------------------------------------------------------
+    inline void ReadN( const uint32 bitCount, const uint64 count, uint64* outValues )
+    {
+        UnpackBits( _fields, _position, count, bitCount, outValues );
+        _position += count * bitCount;
+    }
+
     // Read 128 bits or less
     //-----------------------------------------------------------
     inline uint128 ReadBits128( const uint32 bitCount )
@@ -575,7 +593,7 @@ public:
         ASSERT( sizeBits <= BitSize );
 
         const uint64 startField = bitOffset >> 6; // div 64
-        const uint64 endField   = ( startField * 64 + sizeBits ) >> 6; // div 64
+        const uint64 endField   = ( bitOffset + sizeBits - 1 ) >> 6; // div 64
         const uint64 fieldCount = ( endField - startField ) + 1;
 
         bytesBE += startField * sizeof( uint64 );
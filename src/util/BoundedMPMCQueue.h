@@ -0,0 +1,168 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/// Lock-free, bounded multi-producer, multi-consumer ring queue (D. Vyukov's algorithm)
+/// Every cell carries a sequence number that tells producers whether the cell is free
+/// and consumers whether it holds an item, so an operation only contends on a single CAS
+/// of the enqueue or dequeue position. The positions are kept on separate cache lines.
+/// Batches claim a run of consecutive cells with a single CAS. TryEnqueueAll claims the whole batch
+/// at once, which keeps it contiguous. TryEnqueue claims whatever cells are free, so when the queue
+/// is nearly full a batch is enqueued in parts, which other producers' items may be interleaved with.
+template<typename T, size_t _Capacity = 1024>
+class BoundedMPMCQueue
+{
+    static_assert( _Capacity >= 2 && ( _Capacity & ( _Capacity - 1 ) ) == 0, "Capacity must be a power of 2." );
+
+    static constexpr size_t CACHE_LINE_SIZE = 64;
+    static constexpr size_t INDEX_MASK      = _Capacity - 1;
+
+public:
+    inline BoundedMPMCQueue()
+    {
+        for( size_t i = 0; i < _Capacity; i++ )
+            _cells[i].sequence.store( i, std::memory_order_relaxed );
+    }
+
+    BoundedMPMCQueue( const BoundedMPMCQueue& ) = delete;
+    BoundedMPMCQueue& operator=( const BoundedMPMCQueue& ) = delete;
+
+    static constexpr size_t Capacity() { return _Capacity; }
+
+    /// Enqueues as many of the items as there are free cells for, in order.
+    /// Returns the number of items enqueued, which is 0 if the queue is full.
+    size_t TryEnqueue( const T* items, const size_t count )
+    {
+        size_t enqueued = 0;
+
+        while( enqueued < count )
+        {
+            size_t pos;
+            const size_t claimed = Claim( _enqueuePos, 0, 1, count - enqueued, pos );
+
+            if( claimed == 0 )
+                break;
+
+            Publish( pos, items + enqueued, claimed );
+            enqueued += claimed;
+        }
+
+        return enqueued;
+    }
+
+    /// Enqueues all of the items in consecutive cells, or none of them if there aren't enough free cells.
+    /// count must not exceed the capacity.
+    bool TryEnqueueAll( const T* items, const size_t count )
+    {
+        ASSERT( count > 0 && count <= _Capacity );
+
+        size_t pos;
+        if( Claim( _enqueuePos, 0, count, count, pos ) == 0 )
+            return false;
+
+        Publish( pos, items, count );
+        return true;
+    }
+
+    inline bool TryEnqueue( const T& item )
+    {
+        return TryEnqueue( &item, 1 ) == 1;
+    }
+
+    /// Dequeues up to maxDequeue items, in order.
+    /// Returns the number of items dequeued, which is 0 if the queue is empty.
+    size_t Dequeue( T* outItems, const size_t maxDequeue )
+    {
+        size_t dequeued = 0;
+
+        while( dequeued < maxDequeue )
+        {
+            size_t pos;
+            const size_t claimed = Claim( _dequeuePos, 1, 1, maxDequeue - dequeued, pos );
+
+            if( claimed == 0 )
+                break;
+
+            for( size_t i = 0; i < claimed; i++ )
+            {
+                Cell& cell = _cells[(pos + i) & INDEX_MASK];
+
+                outItems[dequeued + i] = cell.item;
+                cell.sequence.store( pos + i + _Capacity, std::memory_order_release );
+            }
+
+            dequeued += claimed;
+        }
+
+        return dequeued;
+    }
+
+    inline bool Dequeue( T* outItem )
+    {
+        return Dequeue( outItem, 1 ) == 1;
+    }
+
+private:
+    /// Claims between minCount and maxCount consecutive cells starting at position, whose sequence is position + seqOffset.
+    /// (seqOffset is 0 for free cells and 1 for cells holding an item.) Returns 0 if fewer than minCount are ready.
+    size_t Claim( std::atomic<size_t>& position, const size_t seqOffset, const size_t minCount, const size_t maxCount, size_t& outPos )
+    {
+        size_t pos = position.load( std::memory_order_relaxed );
+
+        for( ;; )
+        {
+            size_t ready = 0;
+
+            while( ready < maxCount && ready < _Capacity )
+            {
+                const size_t seq = _cells[(pos + ready) & INDEX_MASK].sequence.load( std::memory_order_acquire );
+
+                if( seq != pos + ready + seqOffset )
+                    break;
+
+                ready++;
+            }
+
+            if( ready < minCount )
+            {
+                // Unless another thread moved the position meanwhile, the cells just aren't ready yet
+                const size_t current = position.load( std::memory_order_relaxed );
+                if( current == pos )
+                    return 0;
+
+                pos = current;
+                continue;
+            }
+
+            if( position.compare_exchange_weak( pos, pos + ready, std::memory_order_relaxed, std::memory_order_relaxed ) )
+            {
+                outPos = pos;
+                return ready;
+            }
+        }
+    }
+
+    /// Stores count items into the claimed cells starting at pos, and hands them to the consumers
+    inline void Publish( const size_t pos, const T* items, const size_t count )
+    {
+        for( size_t i = 0; i < count; i++ )
+        {
+            Cell& cell = _cells[(pos + i) & INDEX_MASK];
+
+            cell.item = items[i];
+            cell.sequence.store( pos + i + 1, std::memory_order_release );
+        }
+    }
+
+private:
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        T                   item;
+    };
+
+    alignas( CACHE_LINE_SIZE ) std::atomic<size_t> _enqueuePos = 0;
+    alignas( CACHE_LINE_SIZE ) std::atomic<size_t> _dequeuePos = 0;
+    alignas( CACHE_LINE_SIZE ) Cell                _cells[_Capacity];
+};
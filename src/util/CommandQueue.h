@@ -1,15 +1,18 @@
 #pragma once
-#include "MPMCQueue.h"
+#include "BoundedMPMCQueue.h"
 #include "threading/Thread.h"
 #include "threading/AutoResetSignal.h"
+#include "threading/ThreadAffinity.h"
 #include "util/Span.h"
 #include "util/Util.h"
+#include <thread>
 
 /// Multi-producer command queue base class
-template<typename TCommand, uint32 _MaxDequeue = 32>
+/// Commands go through a lock-free bounded queue. Producers wait for the consumer when it is full.
+template<typename TCommand, uint32 _MaxDequeue = 32, size_t _Capacity = 1024>
 class MPCommandQueue
 {
-    using TSelf = MPCommandQueue<TCommand, _MaxDequeue>;
+    using TSelf = MPCommandQueue<TCommand, _MaxDequeue, _Capacity>;
 
     enum State : uint32
     {
@@ -54,8 +57,34 @@ public:
         ASSERT( commands );
         ASSERT( count > 0 );
 
-        _queue.Enqueue( commands, (size_t)count );
-        _consumerSignal.Signal();
+        // Keep the batch contiguous, so that other producers' commands aren't interleaved with it
+        if( (size_t)count <= _Capacity )
+        {
+            while( !_queue.TryEnqueueAll( commands, (size_t)count ) )
+            {
+                // Full, let the consumer catch up
+                _consumerSignal.Signal();
+                std::this_thread::yield();
+            }
+
+            _consumerSignal.Signal();
+            return;
+        }
+
+        // Larger than the queue, it can only be enqueued in parts
+        size_t submitted = 0;
+
+        for( ;; )
+        {
+            submitted += _queue.TryEnqueue( commands + submitted, (size_t)count - submitted );
+            _consumerSignal.Signal();
+
+            if( submitted == (size_t)count )
+                break;
+
+            // Full, let the consumer catch up
+            std::this_thread::yield();
+        }
     }
 
 protected:
@@ -65,6 +94,7 @@ protected:
     /// Command thread
     static void ConsumerThreadMain( TSelf* self )
     {
+        ThreadAffinity::PinCurrentIOThread();
         self->ConsumerThread();
     }
 
@@ -79,15 +109,21 @@ protected:
             if( _state.load( std::memory_order_relaxed ) == Exiting )
                 break;
 
-            const size_t itemCount = _queue.Dequeue( items, _MaxDequeue );
+            // Drain the queue, as producers only signal once per submission
+            for( ;; )
+            {
+                const size_t itemCount = _queue.Dequeue( items, _MaxDequeue );
+
+                if( itemCount < 1 )
+                    break;
 
-            if( itemCount > 0 )
                 this->ProcessCommands( Span<TCommand>( items, itemCount ) );
+            }
         }
     }
 
 private:
-    MPMCQueue<TCommand> _queue;
+    BoundedMPMCQueue<TCommand, _Capacity> _queue;
     Thread              _consumerThread;
     AutoResetSignal     _consumerSignal;
     std::atomic<State>  _state = Default;
@@ -0,0 +1,139 @@
+#pragma once
+#include "util/Util.h"
+#include "util/Log.h"
+#include <bit>
+#include <limits>
+
+///
+/// HDR-style latency histogram.
+/// Values are bucketed by their power of 2 magnitude, and each magnitude is split
+/// into SUB_BUCKETS linear sub-buckets, so any recorded value is off by at most 1/SUB_BUCKETS.
+/// Not thread-safe: Record per thread, then Merge into a shared histogram.
+///
+class LatencyHistogram
+{
+public:
+    static constexpr uint32 SUB_BUCKET_BITS = 4;
+    static constexpr uint32 SUB_BUCKETS     = 1u << SUB_BUCKET_BITS;
+    static constexpr uint32 BUCKET_COUNT    = SUB_BUCKETS + ( 64 - SUB_BUCKET_BITS ) * SUB_BUCKETS;
+
+    //-----------------------------------------------------------
+    inline void Record( const uint64 value )
+    {
+        _buckets[BucketIndex( value )]++;
+        _count++;
+        _sum += value;
+        _min  = std::min( _min, value );
+        _max  = std::max( _max, value );
+    }
+
+    //-----------------------------------------------------------
+    inline void Merge( const LatencyHistogram& other )
+    {
+        for( uint32 i = 0; i < BUCKET_COUNT; i++ )
+            _buckets[i] += other._buckets[i];
+
+        _count += other._count;
+        _sum   += other._sum;
+        _min    = std::min( _min, other._min );
+        _max    = std::max( _max, other._max );
+    }
+
+    inline uint64 Count() const { return _count; }
+    inline uint64 Min()   const { return _count ? _min : 0; }
+    inline uint64 Max()   const { return _max; }
+    inline uint64 Mean()  const { return _count ? _sum / _count : 0; }
+
+    /// Lowest value of the bucket holding the given percentile [0-100].
+    //-----------------------------------------------------------
+    inline uint64 ValueAtPercentile( const double percentile ) const
+    {
+        if( _count == 0 )
+            return 0;
+
+        const uint64 target = std::max( (uint64)1, (uint64)( percentile / 100.0 * _count + 0.5 ) );
+
+        uint64 seen = 0;
+        for( uint32 i = 0; i < BUCKET_COUNT; i++ )
+        {
+            seen += _buckets[i];
+            if( seen >= target )
+                return bbclamp( BucketLowerBound( i ), Min(), _max );
+        }
+
+        return _max;
+    }
+
+    /// Writes the histogram as a json object, with values in nanoseconds.
+    /// Only non-empty buckets are written, as [lower_bound, count] pairs.
+    //-----------------------------------------------------------
+    inline void WriteJson() const
+    {
+        Log::Write( R"({"count": %llu, "min_ns": %llu, "max_ns": %llu, "mean_ns": %llu, )",
+            (llu)_count, (llu)Min(), (llu)_max, (llu)Mean() );
+        Log::Write( R"("p50_ns": %llu, "p90_ns": %llu, "p99_ns": %llu, "p999_ns": %llu, "buckets": [)",
+            (llu)ValueAtPercentile( 50 ), (llu)ValueAtPercentile( 90 ), (llu)ValueAtPercentile( 99 ), (llu)ValueAtPercentile( 99.9 ) );
+
+        bool first = true;
+        for( uint32 i = 0; i < BUCKET_COUNT; i++ )
+        {
+            if( !_buckets[i] )
+                continue;
+
+            Log::Write( first ? "[%llu, %llu]" : ", [%llu, %llu]", (llu)BucketLowerBound( i ), (llu)_buckets[i] );
+            first = false;
+        }
+
+        Log::Write( "]}" );
+    }
+
+    //-----------------------------------------------------------
+    inline static uint32 BucketIndex( const uint64 value )
+    {
+        if( value < SUB_BUCKETS )
+            return (uint32)value;
+
+        const uint32 shift = (uint32)std::bit_width( value ) - 1 - SUB_BUCKET_BITS;
+        return SUB_BUCKETS + shift * SUB_BUCKETS + (uint32)( ( value >> shift ) - SUB_BUCKETS );
+    }
+
+    //-----------------------------------------------------------
+    inline static uint64 BucketLowerBound( const uint32 index )
+    {
+        if( index < SUB_BUCKETS )
+            return index;
+
+        const uint32 shift = ( index - SUB_BUCKETS ) / SUB_BUCKETS;
+        const uint64 sub   = ( index - SUB_BUCKETS ) % SUB_BUCKETS;
+
+        return ( SUB_BUCKETS + sub ) << shift;
+    }
+
+private:
+    uint64 _buckets[BUCKET_COUNT] = {};
+    uint64 _count = 0;
+    uint64 _sum   = 0;
+    uint64 _min   = std::numeric_limits<uint64>::max();
+    uint64 _max   = 0;
+};
+
+/// Writes a string as a quoted json string
+//-----------------------------------------------------------
+inline void LogWriteJsonStr( const char* str )
+{
+    Log::Write( "\"" );
+
+    for( ; *str; str++ )
+    {
+        const char c = *str;
+
+        if( c == '"' || c == '\\' )
+            Log::Write( "\\%c", c );
+        else if( (unsigned char)c < 0x20 )
+            Log::Write( "\\u%04x", (unsigned)c );
+        else
+            Log::Write( "%c", c );
+    }
+
+    Log::Write( "\"" );
+}
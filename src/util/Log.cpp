@@ -1,4 +1,7 @@
 #include "Log.h"
+#include "threading/Thread.h"
+#include "util/BoundedMPMCQueue.h"
+#include <mutex>
 
 #if _DEBUG && defined( _WIN32 )
     #include <Windows.h>
@@ -14,6 +17,21 @@ bool Log::_verbose = false;
     std::atomic<int> _dbglock = 0;
 // #endif
 
+static constexpr long ASYNC_FLUSH_INTERVAL_MS = 10;
+
+struct AsyncLogEntry
+{
+    char*  text;
+    uint32 length;
+    bool   isError;
+};
+
+static BoundedMPMCQueue<AsyncLogEntry, 4096> _asyncQueue;
+static std::mutex                           _asyncDrainLock;   // Only taken by the writers of the queued messages
+static std::atomic<bool>                    _asyncEnabled = false;
+static std::atomic<bool>                    _asyncExit    = false;
+static Thread*                              _asyncThread  = nullptr;
+
 //-----------------------------------------------------------
 inline FILE* Log::GetOutStream()
 {
@@ -71,9 +89,131 @@ void Log::Line( const char* msg, ... )
     va_end( args );
 }
 
+//-----------------------------------------------------------
+void Log::EnableAsync()
+{
+    ASSERT( !_asyncThread );
+
+    // Grab the streams before any message is queued
+    GetOutStream();
+    GetErrStream();
+
+    _asyncThread = new Thread( 256 * 1024 );
+    _asyncThread->Run( AsyncThreadMain, nullptr );
+    _asyncEnabled.store( true, std::memory_order_release );
+
+    atexit( []() {
+        _asyncEnabled.store( false, std::memory_order_release );
+        _asyncExit   .store( true , std::memory_order_release );
+        _asyncThread->WaitForExit();
+        DrainQueue();
+    });
+}
+
+//-----------------------------------------------------------
+void Log::AsyncThreadMain( void* )
+{
+    while( !_asyncExit.load( std::memory_order_acquire ) )
+    {
+        Thread::Sleep( ASYNC_FLUSH_INTERVAL_MS );
+        DrainQueue();
+    }
+}
+
+//-----------------------------------------------------------
+bool Log::Enqueue( const bool isError, const bool newLine, const char* msg, va_list args )
+{
+    if( !_asyncEnabled.load( std::memory_order_acquire ) )
+        return false;
+
+    // Most messages fit on the stack, so they are only formatted once
+    char    stackBuffer[1024];
+    va_list argsCopy;
+    va_copy( argsCopy, args );
+    const int length = vsnprintf( stackBuffer, sizeof( stackBuffer ), msg, argsCopy );
+    va_end( argsCopy );
+
+    if( length < 0 )
+        return true;
+
+    const uint32 size = (uint32)length + ( newLine ? 1 : 0 );
+    char*        text = (char*)malloc( (size_t)length + 2 );
+
+    if( (size_t)length < sizeof( stackBuffer ) )
+        memcpy( text, stackBuffer, (size_t)length );
+    else
+        vsnprintf( text, (size_t)length + 1, msg, args );
+
+    if( newLine )
+        text[length] = '\n';
+
+    const AsyncLogEntry entry = { text, size, isError };
+
+    // Write out the queue ourselves when the background thread can't keep up
+    while( !_asyncQueue.TryEnqueue( entry ) )
+        DrainQueue();
+
+    return true;
+}
+
+//-----------------------------------------------------------
+void Log::DrainQueue()
+{
+    static constexpr size_t MAX_ENTRIES = 64;
+
+    std::lock_guard lock( _asyncDrainLock );
+
+    AsyncLogEntry entries[MAX_ENTRIES];
+    size_t        count;
+
+    while( ( count = _asyncQueue.Dequeue( entries, MAX_ENTRIES ) ) > 0 )
+    {
+        // Write consecutive messages to the same stream at once
+        for( size_t i = 0; i < count; )
+        {
+            const bool isError = entries[i].isError;
+            size_t     end     = i;
+            size_t     size    = 0;
+
+            while( end < count && entries[end].isError == isError )
+                size += entries[end++].length;
+
+            char* batch = (char*)malloc( size );
+            char* dst   = batch;
+
+            for( ; i < end; i++ )
+            {
+                memcpy( dst, entries[i].text, entries[i].length );
+                dst += entries[i].length;
+                free( entries[i].text );
+            }
+
+            fwrite( batch, 1, size, isError ? _errStream : _outStream );
+            free( batch );
+        }
+    }
+}
+
+//-----------------------------------------------------------
+void Log::FlushOnCrash()
+{
+    if( !_asyncThread )
+        return;
+
+    // The crashed thread may be the one writing
+    if( !_asyncDrainLock.try_lock() )
+        return;
+
+    _asyncDrainLock.unlock();
+    DrainQueue();
+}
+
 //-----------------------------------------------------------
 void Log::Write( const char* msg, va_list args )
 {
+    if( Enqueue( false, false, msg, args ) )
+        return;
+
     vfprintf( GetOutStream(), msg, args );
 
 #if _DEBUG && defined( _WIN32 )
@@ -84,6 +224,9 @@ void Log::Write( const char* msg, va_list args )
 //-----------------------------------------------------------
 void Log::WriteLine( const char* msg, va_list args )
 {
+    if( Enqueue( false, true, msg, args ) )
+        return;
+
     FILE* stream = GetOutStream();
     vfprintf( stream, msg, args );
     fputc( '\n', stream );
@@ -114,6 +257,9 @@ void Log::WriteError( const char* msg, ... )
 //-----------------------------------------------------------
 void Log::Error( const char* msg, va_list args )
 {
+    if( Enqueue( true, true, msg, args ) )
+        return;
+
     WriteError( msg, args );
     fputc( '\n', GetErrStream() );
 }
@@ -121,6 +267,9 @@ void Log::Error( const char* msg, va_list args )
 //-----------------------------------------------------------
 void Log::WriteError( const char* msg, va_list args )
 {
+    if( Enqueue( true, false, msg, args ) )
+        return;
+
     vfprintf( GetErrStream(), msg, args );
     
 #if _DEBUG && defined( _WIN32 )
@@ -137,9 +286,12 @@ void Log::Verbose( const char* msg, ...  )
     va_list args;
     va_start( args, msg );
     
-    FILE* stream = GetErrStream();
-    vfprintf( stream, msg, args );
-    fputc( '\n', stream );
+    if( !Enqueue( true, true, msg, args ) )
+    {
+        FILE* stream = GetErrStream();
+        vfprintf( stream, msg, args );
+        fputc( '\n', stream );
+    }
 
     va_end( args );
 }
@@ -153,7 +305,8 @@ void Log::VerboseWrite( const char* msg, ...  )
     va_list args;
     va_start( args, msg );
     
-    vfprintf( GetErrStream(), msg, args );
+    if( !Enqueue( true, false, msg, args ) )
+        vfprintf( GetErrStream(), msg, args );
 
     va_end( args );
 }
@@ -162,6 +315,9 @@ void Log::VerboseWrite( const char* msg, ...  )
 //-----------------------------------------------------------
 void Log::Flush()
 {
+    if( _asyncThread )
+        DrainQueue();
+
     fflush( GetOutStream() );
 }
 
@@ -169,6 +325,9 @@ void Log::Flush()
 //-----------------------------------------------------------
 void Log::FlushError()
 {
+    if( _asyncThread )
+        DrainQueue();
+
     fflush( GetErrStream() );
 }
 
@@ -39,11 +39,24 @@ public:
 
     static void SafeWrite( const char* msg, size_t size );
 
+    // Format messages on the calling thread, but write them to the output streams from a background thread,
+    // so that logging threads never block on the streams. Messages keep their order, across stdout and stderr.
+    // Flush() and FlushError() wait until everything logged before them is written. Call once, at start up.
+    static void EnableAsync();
+
+    // Best-effort write of the queued messages, for crash handlers
+    static void FlushOnCrash();
+
 private:
 
     static FILE* GetOutStream();
     static FILE* GetErrStream();
 
+    // Returns false if async logging is disabled, in which case the caller writes the message itself
+    static bool Enqueue( bool isError, bool newLine, const char* msg, va_list args );
+    static void DrainQueue();
+    static void AsyncThreadMain( void* );
+
 private:
     static FILE* _outStream;
     static FILE* _errStream;
@@ -0,0 +1,121 @@
+#include "PageWarmer.h"
+#include "threading/Thread.h"
+#include "util/Log.h"
+#include "SysHost.h"
+
+#if PLATFORM_IS_LINUX
+    #include <sys/mman.h>
+    #include <sys/resource.h>
+
+    // Populates (write-faults) pages without modifying them. Linux 5.14+.
+    #ifndef MADV_POPULATE_WRITE
+        #define MADV_POPULATE_WRITE 23
+    #endif
+#elif PLATFORM_IS_WINDOWS
+    #include <Windows.h>
+#endif
+
+//-----------------------------------------------------------
+PageWarmer::PageWarmer()
+{}
+
+//-----------------------------------------------------------
+PageWarmer::~PageWarmer()
+{
+    WaitForCompletion();
+
+    for( Thread* thread : _threads )
+        delete thread;
+}
+
+//-----------------------------------------------------------
+void PageWarmer::Add( void* buffer, const size_t size )
+{
+    ASSERT( _threads.empty() );
+
+    if( !buffer || size == 0 )
+        return;
+
+    _ranges.push_back( { (byte*)buffer, size, _chunkCount } );
+    _chunkCount += CDiv( size, (int)CHUNK_SIZE );
+}
+
+//-----------------------------------------------------------
+void PageWarmer::Start( uint32 threadCount )
+{
+    ASSERT( _threads.empty() );
+
+    if( _chunkCount == 0 )
+        return;
+
+    if( threadCount == 0 )
+        threadCount = std::max( 1u, SysHost::GetUsableCPUCount() / 4 );
+
+    threadCount = (uint32)std::min( (uint64)threadCount, _chunkCount );
+
+    _startTime = TimerBegin();
+
+    for( uint32 i = 0; i < threadCount; i++ )
+        _threads.push_back( new Thread( 64 KiB ) );
+
+    for( Thread* thread : _threads )
+        thread->Run( ThreadMain, this );
+}
+
+//-----------------------------------------------------------
+void PageWarmer::WaitForCompletion()
+{
+    for( Thread* thread : _threads )
+        thread->WaitForExit();
+}
+
+//-----------------------------------------------------------
+void PageWarmer::ThreadMain( PageWarmer* self )
+{
+    // Only use the CPU time the plotter leaves over
+    #if PLATFORM_IS_LINUX
+        setpriority( PRIO_PROCESS, 0, 19 );     // Nice values are per-thread on Linux
+    #elif PLATFORM_IS_WINDOWS
+        SetThreadPriority( GetCurrentThread(), THREAD_PRIORITY_LOWEST );
+    #endif
+
+    for( ;; )
+    {
+        const uint64 chunk = self->_nextChunk.fetch_add( 1, std::memory_order_relaxed );
+        if( chunk >= self->_chunkCount )
+            break;
+
+        self->WarmChunk( chunk );
+    }
+
+    if( self->_completedThreads.fetch_add( 1, std::memory_order_acq_rel ) + 1 == self->_threads.size() )
+        Log::Line( "Warm start: Memory initialized in %.2lf seconds.", TimerEnd( self->_startTime ) );
+}
+
+//-----------------------------------------------------------
+void PageWarmer::WarmChunk( const uint64 chunk )
+{
+    // Find the buffer holding the chunk
+    size_t rangeIdx = _ranges.size() - 1;
+    while( _ranges[rangeIdx].firstChunk > chunk )
+        rangeIdx--;
+
+    const Range& range  = _ranges[rangeIdx];
+    const size_t offset = (size_t)( chunk - range.firstChunk ) * CHUNK_SIZE;
+    const size_t size   = std::min( CHUNK_SIZE, range.size - offset );
+
+    const size_t pageSize = SysHost::GetPageSize();
+
+    // Start on the page holding the first byte, it belongs to the buffer's allocation
+    byte*       page = (byte*)( (uintptr_t)( range.buffer + offset ) / pageSize * pageSize );
+    const byte* end  = range.buffer + offset + size;
+
+    #if PLATFORM_IS_LINUX
+        if( madvise( page, (size_t)( end - page ), MADV_POPULATE_WRITE ) == 0 )
+            return;
+    #endif
+
+    // An atomic no-op write faults the page in for writing, and can't lose a concurrent write by the plotter
+    for( ; page < end; page += pageSize )
+        std::atomic_ref<byte>( *page ).fetch_or( 0, std::memory_order_relaxed );
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include "util/Util.h"
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+class Thread;
+
+///
+/// --warm-start: Faults in the pages of the plotting buffers from low priority background threads,
+/// while the plot is already running, instead of before it starts.
+/// Buffers are warmed in the order they were added, which should be the order in which the plotter
+/// first touches them. Pages are faulted in without changing their contents, so the plotter may
+/// write to them at any time. A page that the plotter reaches first is simply faulted by the plotter,
+/// nothing ever waits on the warmer.
+///
+class PageWarmer
+{
+public:
+    static constexpr size_t CHUNK_SIZE = 64 MiB;   // Unit of work handed out to the threads, in order
+
+    PageWarmer();
+
+    // Waits for the threads to finish, the buffers must outlive the warmer
+    ~PageWarmer();
+
+    // Must be called before Start()
+    void Add( void* buffer, size_t size );
+
+    // Starts faulting the pages of all buffers added, with threadCount threads.
+    // With threadCount 0, a quarter of the logical CPUs are used.
+    void Start( uint32 threadCount = 0 );
+
+    void WaitForCompletion();
+
+    inline bool IsComplete() const { return _completedThreads.load( std::memory_order_acquire ) == _threads.size(); }
+
+private:
+    struct Range
+    {
+        byte*  buffer;
+        size_t size;
+        uint64 firstChunk;  // Index of the buffer's first chunk across all buffers
+    };
+
+    static void ThreadMain( PageWarmer* self );
+
+    void WarmChunk( uint64 chunk );
+
+private:
+    std::vector<Range>   _ranges;
+    std::vector<Thread*> _threads;
+    uint64               _chunkCount       = 0;
+    std::atomic<uint64>  _nextChunk        = 0;
+    std::atomic<size_t>  _completedThreads = 0;
+    std::chrono::steady_clock::time_point _startTime;
+};
@@ -0,0 +1,510 @@
+#include "PerfCounters.h"
+#include "util/Util.h"
+#include "util/Log.h"
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <string>
+#include <algorithm>
+
+#if PLATFORM_IS_LINUX
+    #include <linux/perf_event.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+    #include <dirent.h>
+#endif
+
+#if defined( __GNUC__ )
+    #include <cxxabi.h>
+#endif
+
+//-----------------------------------------------------------
+PerfCounterValues PerfCounterValues::operator-( const PerfCounterValues& rhs ) const
+{
+    PerfCounterValues v;
+    v.cycles       = cycles       - rhs.cycles;
+    v.instructions = instructions - rhs.instructions;
+    v.llcMisses    = llcMisses    - rhs.llcMisses;
+    v.branchMisses = branchMisses - rhs.branchMisses;
+    v.dramRead     = dramRead     - rhs.dramRead;
+    v.dramWrite    = dramWrite    - rhs.dramWrite;
+    return v;
+}
+
+//-----------------------------------------------------------
+PerfCounterValues& PerfCounterValues::operator+=( const PerfCounterValues& rhs )
+{
+    cycles       += rhs.cycles;
+    instructions += rhs.instructions;
+    llcMisses    += rhs.llcMisses;
+    branchMisses += rhs.branchMisses;
+    dramRead     += rhs.dramRead;
+    dramWrite    += rhs.dramWrite;
+    return *this;
+}
+
+namespace
+{
+    enum CounterId : uint32
+    {
+        Cycles = 0,
+        Instructions,
+        LLCMisses,
+        BranchMisses,
+
+        CounterCount
+    };
+
+    struct ThreadCounters
+    {
+        int32  tid     = 0;
+        int    groupFd = -1;
+        uint32 count   = 0;                 // Counters opened in the group
+        uint32 ids[CounterCount] = {};      // CounterId of each value in the group, in read order
+    };
+
+    // System-wide memory controller counter
+    struct DramCounter
+    {
+        int     fd        = -1;
+        bool    isWrite   = false;
+        float64 byteScale = 64.0;       // Bytes per count
+    };
+
+    struct JobRunCounts
+    {
+        const char*       name = nullptr;   // From typeid(), lives for the whole process
+        PerfCounterValues values;
+        uint64            runs = 0;
+    };
+}
+
+static std::mutex                  _lock;
+static std::atomic<bool>           _enabled = false;
+static std::vector<ThreadCounters> _threads;
+static std::vector<DramCounter>    _dram;
+static std::vector<JobRunCounts>   _jobRuns;
+static PerfCounterValues           _phaseStart;     // Only used by the plotter's main thread
+static PerfCounterValues           _tableStart;
+
+static void OpenThreadCounters( ThreadCounters& t );
+static void OpenDramCounters();
+static PerfCounterValues ReadLocked();
+static void LogCounters( const char* label, const PerfCounterValues& v, double elapsed );
+
+//-----------------------------------------------------------
+bool PerfCounters::Enable()
+{
+    #if PLATFORM_IS_LINUX
+    {
+        std::lock_guard<std::mutex> lock( _lock );
+
+        if( _enabled )
+            return true;
+
+        // The calling thread is the plotter's main thread
+        ThreadCounters self;
+        self.tid = (int32)syscall( SYS_gettid );
+
+        auto it = std::find_if( _threads.begin(), _threads.end(), [&]( const ThreadCounters& t ) { return t.tid == self.tid; } );
+        if( it == _threads.end() )
+        {
+            _threads.push_back( self );
+            it = _threads.end() - 1;
+        }
+
+        for( ThreadCounters& t : _threads )
+            OpenThreadCounters( t );
+
+        // Threads that already exited can't be counted, but we always have our own
+        if( it->groupFd < 0 )
+        {
+            Log::Error( "Warning: Hardware performance counters are not available (perf_event_open failed with error %d). "
+                        "Check /proc/sys/kernel/perf_event_paranoid.", errno );
+            return false;
+        }
+
+        OpenDramCounters();
+
+        if( _dram.empty() )
+            Log::Line( "DRAM bandwidth counters are not available, only per-thread counters will be reported." );
+
+        _phaseStart = ReadLocked();
+        _tableStart = _phaseStart;
+        _enabled.store( true, std::memory_order_release );
+        return true;
+    }
+    #else
+        Log::Line( "Warning: --perf-counters is only supported on Linux." );
+        return false;
+    #endif
+}
+
+//-----------------------------------------------------------
+bool PerfCounters::IsEnabled()
+{
+    return _enabled.load( std::memory_order_relaxed );
+}
+
+//-----------------------------------------------------------
+void PerfCounters::RegisterCurrentThread()
+{
+    #if PLATFORM_IS_LINUX
+        std::lock_guard<std::mutex> lock( _lock );
+
+        ThreadCounters t;
+        t.tid = (int32)syscall( SYS_gettid );
+
+        if( _enabled )
+            OpenThreadCounters( t );
+
+        _threads.push_back( t );
+    #endif
+}
+
+//-----------------------------------------------------------
+PerfCounterValues PerfCounters::Read()
+{
+    if( !_enabled.load( std::memory_order_acquire ) )
+        return {};
+
+    std::lock_guard<std::mutex> lock( _lock );
+    return ReadLocked();
+}
+
+//-----------------------------------------------------------
+void PerfCounters::RecordPhase( const uint32 phase, const double elapsed )
+{
+    if( !_enabled )
+        return;
+
+    const PerfCounterValues now = Read();
+
+    char label[32];
+    snprintf( label, sizeof( label ), "Phase %u", phase );
+    LogCounters( label, now - _phaseStart, elapsed );
+
+    _phaseStart = now;
+    _tableStart = now;
+}
+
+//-----------------------------------------------------------
+void PerfCounters::RecordTable( const uint32 phase, const TableId table, const double elapsed )
+{
+    if( !_enabled )
+        return;
+
+    const PerfCounterValues now = Read();
+
+    char label[32];
+    snprintf( label, sizeof( label ), "  P%u table %u", phase, (uint32)table+1 );
+    LogCounters( label, now - _tableStart, elapsed );
+
+    _tableStart = now;
+}
+
+//-----------------------------------------------------------
+void PerfCounters::RecordJobRun( const char* jobTypeName, const PerfCounterValues& delta )
+{
+    std::lock_guard<std::mutex> lock( _lock );
+
+    for( JobRunCounts& job : _jobRuns )
+    {
+        if( job.name == jobTypeName || strcmp( job.name, jobTypeName ) == 0 )
+        {
+            job.values += delta;
+            job.runs++;
+            return;
+        }
+    }
+
+    _jobRuns.push_back( { jobTypeName, delta, 1 } );
+}
+
+//-----------------------------------------------------------
+void PerfCounters::LogJobRuns()
+{
+    if( !_enabled )
+        return;
+
+    std::vector<JobRunCounts> jobs;
+    {
+        std::lock_guard<std::mutex> lock( _lock );
+        std::swap( jobs, _jobRuns );
+    }
+
+    std::sort( jobs.begin(), jobs.end(), []( const JobRunCounts& a, const JobRunCounts& b ) {
+        return a.values.cycles > b.values.cycles;
+    });
+
+    // The rest are noise
+    static constexpr size_t MAX_JOBS_LOGGED = 12;
+
+    Log::Line( "Hardware counters by job type:" );
+    for( size_t i = 0; i < std::min( jobs.size(), MAX_JOBS_LOGGED ); i++ )
+    {
+        const JobRunCounts& job = jobs[i];
+
+        std::string name = job.name;
+        #if defined( __GNUC__ )
+            int   status    = 0;
+            char* demangled = abi::__cxa_demangle( job.name, nullptr, nullptr, &status );
+            if( demangled )
+            {
+                name = demangled;
+                free( demangled );
+            }
+        #endif
+
+        char label[256];
+        snprintf( label, sizeof( label ), "  %s (%llu runs)", name.c_str(), (llu)job.runs );
+        LogCounters( label, job.values, 0 );
+    }
+}
+
+//-----------------------------------------------------------
+void LogCounters( const char* label, const PerfCounterValues& v, const double elapsed )
+{
+    const double instructions = (double)std::max( v.instructions, (uint64)1 );
+    const double ipc          = (double)v.instructions / (double)std::max( v.cycles, (uint64)1 );
+
+    char dram[128] = "";
+    if( !_dram.empty() )
+    {
+        const double readGiB  = (double)v.dramRead  / (double)( 1 GiB );
+        const double writeGiB = (double)v.dramWrite / (double)( 1 GiB );
+
+        if( elapsed > 0 )
+            snprintf( dram, sizeof( dram ), ", DRAM %.1lf GiB read %.1lf GiB written (%.2lf GiB/s)",
+                      readGiB, writeGiB, ( readGiB + writeGiB ) / elapsed );
+        else
+            snprintf( dram, sizeof( dram ), ", DRAM %.1lf GiB read %.1lf GiB written", readGiB, writeGiB );
+    }
+
+    Log::Line( "%s: %.2lf IPC, %.1lfG cycles, %.1lfG instructions, LLC misses %.1lfM (%.2lf/kinstr), branch misses %.1lfM (%.2lf/kinstr)%s",
+               label, ipc, (double)v.cycles / 1e9, (double)v.instructions / 1e9,
+               (double)v.llcMisses    / 1e6, (double)v.llcMisses    * 1000.0 / instructions,
+               (double)v.branchMisses / 1e6, (double)v.branchMisses * 1000.0 / instructions,
+               dram );
+}
+
+#if PLATFORM_IS_LINUX
+
+//-----------------------------------------------------------
+static int PerfEventOpen( perf_event_attr& attr, const int32 pid, const int cpu, const int groupFd )
+{
+    return (int)syscall( SYS_perf_event_open, &attr, pid, cpu, groupFd, 0ul );
+}
+
+//-----------------------------------------------------------
+void OpenThreadCounters( ThreadCounters& t )
+{
+    if( t.groupFd >= 0 )
+        return;
+
+    static constexpr uint64 configs[CounterCount] = {
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES,
+        PERF_COUNT_HW_BRANCH_MISSES
+    };
+
+    for( uint32 i = 0; i < CounterCount; i++ )
+    {
+        perf_event_attr attr = {};
+        attr.size           = sizeof( attr );
+        attr.type           = PERF_TYPE_HARDWARE;
+        attr.config         = configs[i];
+        attr.read_format    = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        attr.exclude_kernel = 1;    // Allowed with the default perf_event_paranoid
+        attr.exclude_hv     = 1;
+
+        const int fd = PerfEventOpen( attr, t.tid, -1, t.groupFd );
+        if( fd < 0 )
+        {
+            // Without the leader there's nothing to count. Missing members (ex. in VMs) are left out.
+            if( i == 0 )
+                return;
+
+            continue;
+        }
+
+        if( i == 0 )
+            t.groupFd = fd;
+
+        t.ids[t.count++] = i;
+    }
+}
+
+//-----------------------------------------------------------
+static bool ReadSysFile( const std::string& path, std::string& outContent )
+{
+    FILE* file = fopen( path.c_str(), "r" );
+    if( !file )
+        return false;
+
+    char buffer[256];
+    const size_t size = fread( buffer, 1, sizeof( buffer ) - 1, file );
+    fclose( file );
+
+    buffer[size] = 0;
+    outContent = buffer;
+
+    while( !outContent.empty() && isspace( (unsigned char)outContent.back() ) )
+        outContent.pop_back();
+
+    return true;
+}
+
+// Builds the perf_event_attr config of a PMU event described as 'event=0x04,umask=0x03',
+// with the bit ranges of its fields taken from the PMU's format directory (ex. 'config:0-7').
+//-----------------------------------------------------------
+static bool ParsePmuEvent( const std::string& pmuPath, const std::string& event, uint64& outConfig )
+{
+    outConfig = 0;
+
+    size_t start = 0;
+    while( start < event.size() )
+    {
+        size_t end = event.find( ',', start );
+        if( end == std::string::npos )
+            end = event.size();
+
+        const std::string term  = event.substr( start, end - start );
+        const size_t      eq    = term.find( '=' );
+        const std::string field = term.substr( 0, eq );
+        const uint64      value = eq == std::string::npos ? 1 : strtoull( term.c_str() + eq + 1, nullptr, 0 );
+
+        std::string format;
+        if( !ReadSysFile( pmuPath + "/format/" + field, format ) )
+            return false;
+
+        uint32 lo = 0, hi = 0;
+        const int matched = sscanf( format.c_str(), "config:%u-%u", &lo, &hi );
+        if( matched < 1 || lo > 63 )
+            return false;
+        if( matched == 1 )
+            hi = lo;
+
+        const uint32 bits = hi - lo + 1;
+        const uint64 mask = bits >= 64 ? ~0ull : ( ( 1ull << bits ) - 1 );
+        outConfig |= ( value & mask ) << lo;
+
+        start = end + 1;
+    }
+
+    return true;
+}
+
+// Memory controller CAS counts of Intel uncore IMCs. These count for the whole system,
+// so they need perf_event_paranoid <= 0 or CAP_PERFMON.
+//-----------------------------------------------------------
+void OpenDramCounters()
+{
+    static const char PMU_ROOT[] = "/sys/bus/event_source/devices";
+
+    DIR* dir = opendir( PMU_ROOT );
+    if( !dir )
+        return;
+
+    while( dirent* entry = readdir( dir ) )
+    {
+        if( strncmp( entry->d_name, "uncore_imc", 10 ) != 0 )
+            continue;
+
+        const std::string pmuPath = std::string( PMU_ROOT ) + "/" + entry->d_name;
+
+        std::string typeStr, cpuMask;
+        if( !ReadSysFile( pmuPath + "/type", typeStr ) || !ReadSysFile( pmuPath + "/cpumask", cpuMask ) )
+            continue;
+
+        const uint32 type = (uint32)strtoul( typeStr.c_str(), nullptr, 10 );
+        const int    cpu  = atoi( cpuMask.c_str() );    // Counted from the first cpu of its mask
+
+        for( const bool isWrite : { false, true } )
+        {
+            const std::string eventPath = pmuPath + ( isWrite ? "/events/cas_count_write" : "/events/cas_count_read" );
+
+            std::string event, scale;
+            uint64      config = 0;
+            if( !ReadSysFile( eventPath, event ) || !ParsePmuEvent( pmuPath, event, config ) )
+                continue;
+
+            DramCounter counter;
+            counter.isWrite = isWrite;
+
+            // The scale converts counts to MiB
+            if( ReadSysFile( eventPath + ".scale", scale ) )
+                counter.byteScale = strtod( scale.c_str(), nullptr ) * (double)( 1 MiB );
+
+            perf_event_attr attr = {};
+            attr.size   = sizeof( attr );
+            attr.type   = type;
+            attr.config = config;
+
+            counter.fd = PerfEventOpen( attr, -1, cpu, -1 );
+            if( counter.fd >= 0 )
+                _dram.push_back( counter );
+        }
+    }
+
+    closedir( dir );
+}
+
+//-----------------------------------------------------------
+PerfCounterValues ReadLocked()
+{
+    PerfCounterValues v;
+
+    for( const ThreadCounters& t : _threads )
+    {
+        if( t.groupFd < 0 )
+            continue;
+
+        uint64 data[3 + CounterCount] = {};     // nr, time enabled, time running, values
+        if( read( t.groupFd, data, sizeof( data ) ) <= 0 || data[0] != t.count )
+            continue;
+
+        // Scale counts up if the counters were multiplexed with other events
+        const double scale = data[2] > 0 ? (double)data[1] / (double)data[2] : 1.0;
+
+        for( uint32 i = 0; i < t.count; i++ )
+        {
+            const uint64 count = (uint64)( (double)data[3+i] * scale );
+
+            switch( t.ids[i] )
+            {
+                case Cycles      : v.cycles       += count; break;
+                case Instructions: v.instructions += count; break;
+                case LLCMisses   : v.llcMisses    += count; break;
+                case BranchMisses: v.branchMisses += count; break;
+                default: break;
+            }
+        }
+    }
+
+    for( const DramCounter& d : _dram )
+    {
+        uint64 count = 0;
+        if( read( d.fd, &count, sizeof( count ) ) != sizeof( count ) )
+            continue;
+
+        const uint64 bytes = (uint64)( (double)count * d.byteScale );
+        ( d.isWrite ? v.dramWrite : v.dramRead ) += bytes;
+    }
+
+    return v;
+}
+
+#else
+
+//-----------------------------------------------------------
+void OpenThreadCounters( ThreadCounters& t ) { (void)t; }
+
+//-----------------------------------------------------------
+void OpenDramCounters() {}
+
+//-----------------------------------------------------------
+PerfCounterValues ReadLocked() { return {}; }
+
+#endif
@@ -0,0 +1,49 @@
+#pragma once
+#include "plotting/Tables.h"
+
+///
+/// --perf-counters: Hardware performance counters of the plotting threads, per phase, per table and per job type.
+/// On Linux, cycles, instructions, last level cache misses and branch misses are counted with perf_event_open
+/// on every thread pool worker and the main thread, and memory controller (DRAM) traffic system-wide
+/// where the uncore counters are exposed and allowed (perf_event_paranoid <= 0 or CAP_PERFMON).
+/// The counts are logged alongside the phase and table timings. Elsewhere, or if the counters
+/// can't be opened, everything here does nothing.
+///
+struct PerfCounterValues
+{
+    uint64 cycles       = 0;
+    uint64 instructions = 0;
+    uint64 llcMisses    = 0;
+    uint64 branchMisses = 0;
+    uint64 dramRead     = 0;    // Bytes
+    uint64 dramWrite    = 0;    // Bytes
+
+    PerfCounterValues  operator-( const PerfCounterValues& rhs ) const;
+    PerfCounterValues& operator+=( const PerfCounterValues& rhs );
+};
+
+class PerfCounters
+{
+public:
+    // Opens the counters of the threads registered so far, and of any registered from then on.
+    // Returns false if the counters are not available.
+    static bool Enable();
+
+    static bool IsEnabled();
+
+    // Thread pool workers register themselves when they start, whether the counters are enabled or not.
+    static void RegisterCurrentThread();
+
+    // Sum of all registered threads
+    static PerfCounterValues Read();
+
+    // Log the counts since the last phase and since the last table. Same contract as PlotBenchmark's.
+    static void RecordPhase( uint32 phase, double elapsed );
+    static void RecordTable( uint32 phase, TableId table, double elapsed );
+
+    // Counts accumulated by MTJobRunner runs, grouped by job type.
+    static void RecordJobRun( const char* jobTypeName, const PerfCounterValues& delta );
+
+    // Logs the job types with the most cycles since the last call, then resets them.
+    static void LogJobRuns();
+};
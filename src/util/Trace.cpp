@@ -0,0 +1,89 @@
+#include "Trace.h"
+
+#if BB_TRACE_ON
+
+#include "util/Log.h"
+#include <mutex>
+#include <vector>
+
+static std::mutex                          _bufferLock;     // Only held when a thread records its first event
+static std::vector<Tracer::ThreadBuffer*>  _buffers;
+static const auto                          _traceStart = std::chrono::steady_clock::now();
+
+//-----------------------------------------------------------
+uint64 Tracer::Now()
+{
+    return (uint64)std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now() - _traceStart ).count();
+}
+
+//-----------------------------------------------------------
+Tracer::ThreadBuffer& Tracer::GetThreadBuffer()
+{
+    thread_local ThreadBuffer* buffer = nullptr;
+
+    if( !buffer )
+    {
+        // Never freed, so that the events of exited threads are still written out
+        buffer = new ThreadBuffer();
+
+        std::lock_guard lock( _bufferLock );
+        buffer->tid = (uint32)_buffers.size();
+        _buffers.push_back( buffer );
+    }
+
+    return *buffer;
+}
+
+//-----------------------------------------------------------
+void Tracer::SetThreadName( const char* name )
+{
+    ThreadBuffer& buffer = GetThreadBuffer();
+
+    strncpy( buffer.name, name, sizeof( buffer.name ) - 1 );
+}
+
+//-----------------------------------------------------------
+bool Tracer::WriteJson( const char* path )
+{
+    FILE* file = fopen( path, "w" );
+    if( !file )
+    {
+        Log::Error( "Failed to open trace file %s.", path );
+        return false;
+    }
+
+    std::lock_guard lock( _bufferLock );
+
+    fprintf( file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n" );
+
+    bool first = true;
+    for( const ThreadBuffer* buffer : _buffers )
+    {
+        if( buffer->name[0] )
+        {
+            fprintf( file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                first ? "" : ",\n", buffer->tid, buffer->name );
+            first = false;
+        }
+
+        const uint64 head  = buffer->head.load( std::memory_order_acquire );
+        const uint64 start = head > EVENTS_PER_THREAD ? head - EVENTS_PER_THREAD : 0;
+
+        for( uint64 i = start; i < head; i++ )
+        {
+            const Event& e = buffer->events[i & ( EVENTS_PER_THREAD - 1 )];
+
+            // Timestamps are in microseconds
+            fprintf( file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3lf,\"dur\":%.3lf}",
+                first ? "" : ",\n", e.name, buffer->tid, (double)e.startNs / 1000.0, (double)e.durationNs / 1000.0 );
+            first = false;
+        }
+    }
+
+    fprintf( file, "\n]}\n" );
+    fclose( file );
+
+    return true;
+}
+
+#endif
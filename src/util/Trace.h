@@ -0,0 +1,87 @@
+#pragma once
+
+///
+/// Timeline tracing of hot paths, compiled in with -DENABLE_TRACE=ON (BB_TRACE_ON).
+/// Scoped zones are recorded to per-thread ring buffers without locking, and written out
+/// as a Chrome trace event json file (chrome://tracing or ui.perfetto.dev) with --trace <file>.
+/// When tracing is not compiled in, the macros expand to nothing.
+///
+/// Zone names must be string literals, or otherwise outlive the trace.
+///
+#if BB_TRACE_ON
+
+#include <atomic>
+
+class Tracer
+{
+public:
+    // Events kept per thread. Older events are overwritten.
+    static constexpr uint32 EVENTS_PER_THREAD = 1u << 16;
+
+    struct Event
+    {
+        const char* name;
+        uint64      startNs;
+        uint64      durationNs;
+    };
+
+    struct ThreadBuffer
+    {
+        std::atomic<uint64> head = 0;       // Total events recorded
+        uint32              tid  = 0;
+        char                name[32] = {};
+        Event               events[EVENTS_PER_THREAD];
+    };
+
+    // Nanoseconds since the process started tracing
+    static uint64 Now();
+
+    inline static void Record( const char* name, const uint64 startNs, const uint64 endNs )
+    {
+        ThreadBuffer& buffer = GetThreadBuffer();
+
+        const uint64 head = buffer.head.load( std::memory_order_relaxed );
+        buffer.events[head & ( EVENTS_PER_THREAD - 1 )] = { name, startNs, endNs - startNs };
+        buffer.head.store( head + 1, std::memory_order_release );
+    }
+
+    // Shown as the calling thread's name in the trace viewer
+    static void SetThreadName( const char* name );
+
+    // Write every thread's events to path. Zones still being recorded by other threads may be missing.
+    static bool WriteJson( const char* path );
+
+private:
+    static ThreadBuffer& GetThreadBuffer();
+};
+
+class TraceScope
+{
+public:
+    inline TraceScope( const char* name )
+        : _name ( name )
+        , _start( Tracer::Now() )
+    {}
+
+    inline ~TraceScope()
+    {
+        Tracer::Record( _name, _start, Tracer::Now() );
+    }
+
+private:
+    const char* _name;
+    uint64      _start;
+};
+
+#define BB_TRACE_CONCAT_( a, b ) a##b
+#define BB_TRACE_CONCAT( a, b ) BB_TRACE_CONCAT_( a, b )
+
+#define BB_TRACE_SCOPE( name )          TraceScope BB_TRACE_CONCAT( _bbTraceScope, __LINE__ )( name )
+#define BB_TRACE_THREAD_NAME( name )    Tracer::SetThreadName( name )
+
+#else
+
+#define BB_TRACE_SCOPE( name )
+#define BB_TRACE_THREAD_NAME( name )
+
+#endif
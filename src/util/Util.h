@@ -109,6 +109,21 @@ constexpr inline int64 bbconst_ceil( const double x )
 }
 
 
+//-----------------------------------------------------------
+constexpr inline uint64 bbconst_isqrt( const uint64 x )
+{
+    uint64 lo = 0, hi = 1ull << 32;
+    while( lo + 1 < hi )
+    {
+        const uint64 mid = ( lo + hi ) / 2;
+        if( mid * mid <= x )
+            lo = mid;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
 // Divide a by b and apply ceiling if needed.
 //-----------------------------------------------------------
 template <typename T>
@@ -139,6 +154,13 @@ constexpr inline T RoundUpToNextBoundaryT( T value, T boundary )
     return value + ( boundary - ( value % boundary ) ) % boundary;
 }
 
+//-----------------------------------------------------------
+template<typename T>
+constexpr inline bool IsPowerOf2( T value )
+{
+    return value > 0 && ( value & ( value - 1 ) ) == 0;
+}
+
 //-----------------------------------------------------------
 inline bool MemCmp( const void* a, const void* b, size_t size )
 {
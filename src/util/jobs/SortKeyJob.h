@@ -1,6 +1,7 @@
 #pragma once
 
 #include "threading/MonoJob.h"
+#include "algorithm/KeyGather.h"
 
 struct SortKeyJob
 {
@@ -61,8 +62,7 @@ public:
             TKey count, offset, end;
             GetThreadOffsets( self, (TKey)entriesIn.Length(), count, offset, end );
 
-            for( TKey i = offset; i < end; i++ )
-                entriesOut[i] = entriesIn[key[i]];
+            KeyGather::Gather( key.Ptr() + offset, entriesIn.Ptr(), entriesOut.Ptr() + offset, (uint64)count );
         });
     }
 
@@ -0,0 +1,51 @@
+#include "TestUtil.h"
+#include "b3/blake3.h"
+#include <random>
+#include <vector>
+
+static void CheckHashShortMany( std::mt19937_64& rng, size_t inputLen, size_t stride, size_t count );
+
+//-----------------------------------------------------------
+TEST_CASE( "blake3-short-many", "[unit-core]" )
+{
+    std::mt19937_64 rng( 0xa54ff53a5f1d36f1ull );
+
+    // Every length hashed in a single block, which includes all of the Fx input sizes (13 to 37 bytes).
+    // The counts leave tails after the 16-lane and 8-lane kernels.
+    for( size_t len = 0; len <= BLAKE3_BLOCK_LEN; len++ )
+    {
+        const size_t packedStride = RoundUpToNextBoundaryT( len, (size_t)4 );
+
+        for( const size_t count : { 1, 7, 8, 15, 16, 17, 24, 31, 64, 71 } )
+        {
+            CheckHashShortMany( rng, len, packedStride, count );
+            CheckHashShortMany( rng, len, packedStride + 20, count );
+        }
+    }
+}
+
+/// Hashes random messages with blake3_hash_short_many and compares them with the regular hasher
+//-----------------------------------------------------------
+void CheckHashShortMany( std::mt19937_64& rng, const size_t inputLen, const size_t stride, const size_t count )
+{
+    // Messages are read in 4-byte words, so the last one may be read up to 3 bytes past its end
+    std::vector<byte> inputs( stride * count + 4 );
+    for( byte& b : inputs )
+        b = (byte)rng();
+
+    std::vector<byte> out( count * BLAKE3_OUT_LEN, 0 );
+    blake3_hash_short_many( inputs.data(), stride, inputLen, count, out.data() );
+
+    for( size_t i = 0; i < count; i++ )
+    {
+        byte ref[BLAKE3_OUT_LEN];
+
+        blake3_hasher hasher;
+        blake3_hasher_init( &hasher );
+        blake3_hasher_update( &hasher, inputs.data() + i * stride, inputLen );
+        blake3_hasher_finalize( &hasher, ref, sizeof( ref ) );
+
+        INFO( "length " << inputLen << " stride " << stride << " count " << count << " message " << i );
+        ENSURE( memcmp( ref, out.data() + i * BLAKE3_OUT_LEN, BLAKE3_OUT_LEN ) == 0 );
+    }
+}
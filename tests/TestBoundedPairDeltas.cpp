@@ -0,0 +1,139 @@
+#include "TestUtil.h"
+#include "plotdisk/BoundedPairDeltas.h"
+#include <random>
+#include <vector>
+
+static constexpr uint32 PairRightBits = 9;  // Same as bounded k32's max right - left delta of 512
+
+static void RoundTripPairs( const std::vector<Pair>& pairs, uint32 writerCount, uint32 readerCount );
+
+//-----------------------------------------------------------
+TEST_CASE( "bounded-pair-deltas", "[unit-core]" )
+{
+    std::mt19937_64 rng( 0x6a09e667f3bcc908ull );
+
+    SECTION( "random" )
+    {
+        for( uint32 run = 0; run < 16; run++ )
+        {
+            // Sorted lefts with small gaps, as matches are in a bucket
+            std::vector<Pair> pairs( 1 + rng() % 100000 );
+
+            uint32 left = (uint32)( rng() % ( 1u << 20 ) );
+            for( Pair& p : pairs )
+            {
+                left   += (uint32)( rng() % 8 );
+                p.left  = left;
+                p.right = left + 1 + (uint32)( rng() % ( ( 1u << PairRightBits ) - 1 ) );
+            }
+
+            RoundTripPairs( pairs, 1  + (uint32)( rng() % 32 ), 1 + (uint32)( rng() % 32 ) );
+        }
+    }
+
+    SECTION( "skewed" )
+    {
+        // Runs of pairs sharing a left (zero deltas) broken by rare very large gaps
+        std::vector<Pair> pairs( 50000 );
+
+        uint32 left = 0;
+        for( Pair& p : pairs )
+        {
+            if( rng() % 1000 == 0 )
+                left += (uint32)( rng() % ( 1u << 24 ) );
+
+            p.left  = left;
+            p.right = left + (uint32)( rng() % ( 1u << PairRightBits ) );
+        }
+
+        RoundTripPairs( pairs, 7, 13 );
+        RoundTripPairs( pairs, 13, 7 );
+    }
+
+    SECTION( "edge" )
+    {
+        // All lefts equal, the left deltas then take a single bit
+        RoundTripPairs( std::vector<Pair>( 1000, Pair{ 0, 1 } ), 4, 3 );
+
+        // A single pair, whose delta is relative to 0
+        RoundTripPairs( { Pair{ 0xFFFFFE00u, 0xFFFFFFFFu } }, 1, 1 );
+
+        // More threads than pairs
+        RoundTripPairs( { Pair{ 5, 6 }, Pair{ 5, 9 }, Pair{ 70, 70 } }, 8, 8 );
+    }
+}
+
+/// Packs the pairs as FxBounded does, each writer thread chaining its first delta to the previous thread's
+/// last pair, then decodes them as DiskPairReader does, with possibly a different thread count.
+//-----------------------------------------------------------
+void RoundTripPairs( const std::vector<Pair>& pairs, const uint32 writerCount, const uint32 readerCount )
+{
+    const size_t count = pairs.size();
+
+    auto sliceOffset = []( size_t count, uint32 threadCount, uint32 thread ) {
+        return count / threadCount * thread + std::min( (size_t)thread, count % threadCount );
+    };
+
+    // Bit size of the left deltas
+    uint32 maxLeftDelta = 0;
+    for( uint32 i = 0; i < writerCount; i++ )
+    {
+        const size_t offset   = sliceOffset( count, writerCount, i );
+        const size_t end      = sliceOffset( count, writerCount, i+1 );
+        const uint32 prevLeft = offset > 0 ? pairs[offset-1].left : 0;
+
+        maxLeftDelta = std::max( maxLeftDelta, BoundedPairDeltas::GetMaxLeftDelta( pairs.data() + offset, end - offset, prevLeft ) );
+    }
+
+    const uint32 leftBits = BoundedPairDeltas::GetLeftBits( maxLeftDelta );
+    const uint32 pairBits = leftBits + PairRightBits;
+    ENSURE( leftBits <= 32 );
+    ENSURE( ( leftBits == 32 ) || ( maxLeftDelta >> leftBits ) == 0 );
+
+    // Pack
+    std::vector<uint64> bits( CDiv( count * pairBits, 64 ) + 1, 0 );
+
+    for( uint32 i = 0; i < writerCount; i++ )
+    {
+        const size_t offset   = sliceOffset( count, writerCount, i );
+        const size_t end      = sliceOffset( count, writerCount, i+1 );
+        const uint32 prevLeft = offset > 0 ? pairs[offset-1].left : 0;
+
+        BitWriter writer( bits.data(), bits.size() * 64, offset * pairBits );
+        BoundedPairDeltas::Pack( writer, pairs.data() + offset, end - offset, prevLeft, leftBits, PairRightBits );
+    }
+
+    // Unpack
+    std::vector<Pair>   decoded( count );
+    std::vector<uint32> lefts( readerCount );
+
+    for( uint32 i = 0; i < readerCount; i++ )
+    {
+        const size_t offset = sliceOffset( count, readerCount, i );
+        const size_t end    = sliceOffset( count, readerCount, i+1 );
+
+        BitReader reader( bits.data(), count * pairBits, offset * pairBits );
+        lefts[i] = BoundedPairDeltas::Unpack( reader, decoded.data() + offset, end - offset, leftBits, PairRightBits );
+    }
+
+    uint32 leftBase = 0;
+    for( uint32 i = 0; i < readerCount; i++ )
+    {
+        const size_t offset = sliceOffset( count, readerCount, i );
+        const size_t end    = sliceOffset( count, readerCount, i+1 );
+
+        for( size_t j = offset; j < end; j++ )
+        {
+            decoded[j].left  += leftBase;
+            decoded[j].right += leftBase;
+        }
+
+        leftBase += lefts[i];
+    }
+
+    for( size_t i = 0; i < count; i++ )
+    {
+        ENSURE( decoded[i].left  == pairs[i].left  );
+        ENSURE( decoded[i].right == pairs[i].right );
+    }
+}
@@ -0,0 +1,151 @@
+#include "TestUtil.h"
+#include "pos/chacha8_impl.h"
+#include "SysHost.h"
+#include <random>
+#include <vector>
+
+typedef void (*ChaCha8Kernel)( const struct chacha8_ctx* x, uint64_t pos, const uint64_t* positions, uint32_t n_blocks, uint8_t* c );
+
+struct ChaCha8KernelInfo
+{
+    const char*   name;
+    ChaCha8Kernel kernel;
+    uint32        blockWidth;
+    bool          supported;
+};
+
+static std::vector<ChaCha8KernelInfo> GetChaCha8Kernels();
+static void CheckKernel( const ChaCha8KernelInfo& k, const chacha8_ctx& ctx, std::mt19937_64& rng );
+static void CheckDispatch( const chacha8_ctx& ctx, std::mt19937_64& rng );
+
+// Starting block positions, including counter carries from the low 32 bits into the high ones
+static const uint64 TestPositions[] = { 0, 1, 7, 1000, 0xFFFFFFFFull - 2, 0xFFFFFFFFull, 0x1FFFFFFF0ull };
+
+//-----------------------------------------------------------
+TEST_CASE( "chacha8-simd", "[unit-core]" )
+{
+    std::mt19937_64 rng( 0x3c6ef372fe94f82bull );
+
+    const auto kernels = GetChaCha8Kernels();
+
+    for( uint32 keyIdx = 0; keyIdx < 4; keyIdx++ )
+    {
+        byte key[32];
+        for( byte& b : key )
+            b = (byte)rng();
+
+        // The first key is the one F1 gets from an all-zero plot id
+        if( keyIdx == 0 )
+        {
+            memset( key, 0, sizeof( key ) );
+            key[0] = 1;
+        }
+
+        chacha8_ctx ctx;
+        chacha8_keysetup( &ctx, key, 256, nullptr );
+
+        for( const ChaCha8KernelInfo& k : kernels )
+        {
+            if( !k.supported )
+            {
+                Log::Line( "Skipping %s ChaCha8: Not supported by this CPU.", k.name );
+                continue;
+            }
+
+            CheckKernel( k, ctx, rng );
+        }
+
+        CheckDispatch( ctx, rng );
+    }
+}
+
+//-----------------------------------------------------------
+std::vector<ChaCha8KernelInfo> GetChaCha8Kernels()
+{
+    std::vector<ChaCha8KernelInfo> kernels;
+
+#if CHACHA8_X86
+    kernels.push_back( { "AVX2"   , chacha8_get_keystream_avx2  , CHACHA8_AVX2_BLOCKS  , SysHost::HasCpuFeatures( CpuFeatures::AVX2    ) } );
+    kernels.push_back( { "AVX-512", chacha8_get_keystream_avx512, CHACHA8_AVX512_BLOCKS, SysHost::HasCpuFeatures( CpuFeatures::AVX512F ) } );
+#elif CHACHA8_NEON
+    kernels.push_back( { "NEON"   , chacha8_get_keystream_neon  , CHACHA8_NEON_BLOCKS  , true } );
+#endif
+
+    return kernels;
+}
+
+/// Compares a wide kernel with the scalar generator, with consecutive and scattered block positions
+//-----------------------------------------------------------
+void CheckKernel( const ChaCha8KernelInfo& k, const chacha8_ctx& ctx, std::mt19937_64& rng )
+{
+    const uint32 maxBlocks = k.blockWidth * 4;
+
+    std::vector<byte>   ref( (size_t)maxBlocks * 64 );
+    std::vector<byte>   out( (size_t)maxBlocks * 64 );
+    std::vector<uint64> positions( maxBlocks );
+
+    for( const uint64 pos : TestPositions )
+    {
+        for( uint32 blocks = k.blockWidth; blocks <= maxBlocks; blocks += k.blockWidth )
+        {
+            chacha8_get_keystream_portable( &ctx, pos, blocks, ref.data() );
+
+            memset( out.data(), 0xCC, out.size() );
+            k.kernel( &ctx, pos, nullptr, blocks, out.data() );
+            INFO( k.name << " pos " << pos << " blocks " << blocks );
+            ENSURE( memcmp( ref.data(), out.data(), (size_t)blocks * 64 ) == 0 );
+
+            // Nothing past the requested blocks may be written
+            if( blocks < maxBlocks )
+                ENSURE( out[(size_t)blocks * 64] == 0xCC );
+        }
+    }
+
+    for( uint32 run = 0; run < 8; run++ )
+    {
+        for( uint64& p : positions )
+            p = rng() % ( 1ull << 36 );
+
+        for( uint32 i = 0; i < maxBlocks; i++ )
+            chacha8_get_keystream_portable( &ctx, positions[i], 1, ref.data() + (size_t)i * 64 );
+
+        k.kernel( &ctx, 0, positions.data(), maxBlocks, out.data() );
+        ENSURE( memcmp( ref.data(), out.data(), ref.size() ) == 0 );
+    }
+}
+
+/// Compares the public entry points, which split the blocks between the widest kernel and the scalar code,
+/// with block counts that leave tails for each narrower kernel and for the scalar code
+//-----------------------------------------------------------
+void CheckDispatch( const chacha8_ctx& ctx, std::mt19937_64& rng )
+{
+    const uint32 maxBlocks = CHACHA8_AVX512_BLOCKS * 3 + CHACHA8_AVX2_BLOCKS + CHACHA8_NEON_BLOCKS + 3;
+
+    std::vector<byte>   ref( (size_t)maxBlocks * 64 );
+    std::vector<byte>   out( (size_t)maxBlocks * 64 );
+    std::vector<uint64> positions( maxBlocks );
+
+    for( const uint64 pos : TestPositions )
+    {
+        for( uint32 blocks = 1; blocks <= maxBlocks; blocks++ )
+        {
+            chacha8_get_keystream_portable( &ctx, pos, blocks, ref.data() );
+            chacha8_get_keystream( &ctx, pos, blocks, out.data() );
+
+            INFO( "pos " << pos << " blocks " << blocks );
+            ENSURE( memcmp( ref.data(), out.data(), (size_t)blocks * 64 ) == 0 );
+        }
+    }
+
+    for( uint32 blocks = 1; blocks <= maxBlocks; blocks++ )
+    {
+        for( uint32 i = 0; i < blocks; i++ )
+        {
+            positions[i] = rng() % ( 1ull << 36 );
+            chacha8_get_keystream_portable( &ctx, positions[i], 1, ref.data() + (size_t)i * 64 );
+        }
+
+        chacha8_get_keystream_blocks( &ctx, positions.data(), blocks, out.data() );
+        ENSURE( memcmp( ref.data(), out.data(), (size_t)blocks * 64 ) == 0 );
+    }
+}
@@ -0,0 +1,165 @@
+#include "TestUtil.h"
+#include "harvesting/GreenReaper.h"
+#include "plotmem/LPGen.h"
+#include <random>
+
+// The version 1 structs, as a caller built against the version 1 header has them
+struct GreenReaperConfigV1
+{
+    uint32_t           apiVersion;
+    uint32_t           threadCount;
+    uint32_t           cpuOffset;
+    GRBool             disableCpuAffinity;
+    GRGpuRequestKind_t gpuRequest;
+    uint32_t           gpuDeviceIndex;
+
+    uint32_t           _reserved[16];
+};
+
+struct GRCompressedQualitiesRequestV1
+{
+    const uint8_t*  plotId;
+    const uint8_t*  challenge;
+    uint32_t        compressionLevel;
+    GRLinePoint     xLinePoints[2];
+
+    uint64_t        x1, x2;
+};
+
+struct GRCompressedProofRequestV1
+{
+    union {
+        uint64_t compressedProof[GR_POST_PROOF_CMP_X_COUNT];
+        uint64_t fullProof      [GR_POST_PROOF_X_COUNT];
+    };
+
+          uint32_t  compressionLevel;
+    const uint8_t*  plotId;
+};
+
+// Whatever follows the caller's request in memory. Must not be read or written by the library.
+static const byte GuardValue = 0xCC;
+
+template<typename TRequest>
+struct GuardedRequest
+{
+    TRequest req;
+    byte     guard[64];
+};
+
+template<typename TRequest>
+static bool GuardIsIntact( const GuardedRequest<TRequest>& r )
+{
+    for( const byte b : r.guard )
+        if( b != GuardValue )
+            return false;
+
+    return true;
+}
+
+//-----------------------------------------------------------
+TEST_CASE( "green-reaper-v1-api", "[unit-core]" )
+{
+    std::mt19937_64 rng( 0x1f83d9abfb41bd6bull );
+
+    GRApiV1 api = {};
+    ENSURE( grPopulateApi( (GRApi*)&api, sizeof( api ), 1 ) == GRResult_OK );
+
+    // A version 1 API struct can't be filled as the current version, and vice versa
+    ENSURE( grPopulateApi( (GRApi*)&api, sizeof( api ), GR_API_VERSION ) == GRResult_WrongVersion );
+
+    GreenReaperConfigV1 cfg = {};
+    cfg.apiVersion  = 1;
+    cfg.threadCount = std::min( 4u, SysHost::GetLogicalCPUCount() );
+    cfg.gpuRequest  = GRGpuRequestKind_None;
+
+    // Garbage where the version 2 options would be
+    memset( cfg._reserved, 0xCC, sizeof( cfg._reserved ) );
+
+    GreenReaperContext* cx = nullptr;
+    ENSURE( api.CreateContext( &cx, (GreenReaperConfig*)&cfg, sizeof( cfg ) ) == GRResult_OK );
+    ENSURE( cx );
+
+    byte plotId[32];
+    byte challenge[32];
+
+    for( byte& b : plotId    ) b = (byte)rng();
+    for( byte& b : challenge ) b = (byte)rng();
+
+    // Compression level 1 keeps 16 bits of each x
+    auto randomXPair = [&]() {
+        return SquareToLinePoint( rng() & 0xFFFF, rng() & 0xFFFF );
+    };
+
+    auto randomXQuad = [&]() {
+        const uint128 lp = SquareToLinePoint128( randomXPair(), randomXPair() );
+        return GRLinePoint{ (uint64)( lp >> 64 ), (uint64)lp };
+    };
+
+    SECTION( "qualities" )
+    {
+        for( uint32 i = 0; i < 4; i++ )
+        {
+            GuardedRequest<GRCompressedQualitiesRequestV1> r;
+            memset( &r, GuardValue, sizeof( r ) );
+
+            r.req.plotId           = plotId;
+            r.req.challenge        = challenge;
+            r.req.compressionLevel = 1;
+            r.req.xLinePoints[0]   = randomXQuad();
+            r.req.xLinePoints[1]   = randomXQuad();
+
+            // Random x's rarely form a valid proof, so the request usually fails. What matters
+            // is that it gets as far as the decompression, which is where outTimings was accessed.
+            const GRResult result = api.GetFetchQualitiesXPair( cx, (GRCompressedQualitiesRequest*)&r.req );
+            ENSURE( result != GRResult_WrongVersion );
+            ENSURE( GuardIsIntact( r ) );
+
+            // Must match the same request made with the current version's struct
+            GRCompressedQualitiesRequest req = {};
+            req.plotId           = plotId;
+            req.challenge        = challenge;
+            req.compressionLevel = 1;
+            req.xLinePoints[0]   = r.req.xLinePoints[0];
+            req.xLinePoints[1]   = r.req.xLinePoints[1];
+
+            ENSURE( grGetFetchQualitiesXPair( cx, &req ) == result );
+
+            if( result == GRResult_OK )
+            {
+                ENSURE( req.x1 == r.req.x1 );
+                ENSURE( req.x2 == r.req.x2 );
+            }
+        }
+    }
+
+    SECTION( "proof" )
+    {
+        GuardedRequest<GRCompressedProofRequestV1> r;
+        memset( &r, GuardValue, sizeof( r ) );
+
+        uint64 compressedProof[GR_POST_PROOF_CMP_X_COUNT];
+        for( uint64& lp : compressedProof )
+            lp = randomXPair();
+
+        memcpy( r.req.compressedProof, compressedProof, sizeof( compressedProof ) );
+
+        r.req.compressionLevel = 1;
+        r.req.plotId           = plotId;
+
+        const GRResult result = api.FetchProofForChallenge( cx, (GRCompressedProofRequest*)&r.req );
+        ENSURE( GuardIsIntact( r ) );
+
+        GRCompressedProofRequest req = {};
+        memcpy( req.compressedProof, compressedProof, sizeof( compressedProof ) );
+        req.compressionLevel = 1;
+        req.plotId           = plotId;
+
+        ENSURE( grFetchProofForChallenge( cx, &req ) == result );
+
+        if( result == GRResult_OK )
+            ENSURE( memcmp( req.fullProof, r.req.fullProof, sizeof( req.fullProof ) ) == 0 );
+    }
+
+    api.DestroyContext( cx );
+}
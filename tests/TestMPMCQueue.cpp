@@ -0,0 +1,197 @@
+#include "TestUtil.h"
+#include "util/BoundedMPMCQueue.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+template<size_t _Capacity>
+static void StressQueue( uint32 producerCount, uint32 consumerCount, uint64 itemsPerProducer, uint32 maxBatch, bool wholeBatches = false );
+
+//-----------------------------------------------------------
+TEST_CASE( "bounded-mpmc-queue", "[unit-core]" )
+{
+    SECTION( "single-thread" )
+    {
+        BoundedMPMCQueue<uint64, 8> queue;
+
+        uint64 items[10] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+        ENSURE( queue.TryEnqueue( items, 10 ) == 8 );
+        ENSURE( !queue.TryEnqueue( items[8] ) );
+
+        uint64 out[10] = {};
+        ENSURE( queue.Dequeue( out, 3 ) == 3 );
+        ENSURE( queue.TryEnqueue( items + 8, 2 ) == 2 );
+        ENSURE( queue.Dequeue( out + 3, 10 ) == 7 );
+        ENSURE( !queue.Dequeue( out ) );
+
+        // FIFO, including across the wrap around
+        for( uint64 i = 0; i < 10; i++ )
+            ENSURE( out[i] == i );
+    }
+
+    SECTION( "whole-batch" )
+    {
+        BoundedMPMCQueue<uint64, 8> queue;
+
+        uint64 items[8] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+        ENSURE( queue.TryEnqueueAll( items, 5 ) );
+
+        // Only 3 free cells, nothing is enqueued
+        ENSURE( !queue.TryEnqueueAll( items + 5, 4 ) );
+        ENSURE( queue.TryEnqueueAll( items + 5, 3 ) );
+        ENSURE( !queue.TryEnqueueAll( items, 1 ) );
+
+        uint64 out[8] = {};
+        ENSURE( queue.Dequeue( out, 2 ) == 2 );
+        ENSURE( !queue.TryEnqueueAll( items, 3 ) );
+        ENSURE( queue.Dequeue( out + 2, 8 ) == 6 );
+        ENSURE( !queue.Dequeue( out ) );
+
+        for( uint64 i = 0; i < 8; i++ )
+            ENSURE( out[i] == i );
+
+        // Wrapping around
+        ENSURE( queue.TryEnqueueAll( items, 8 ) );
+        ENSURE( queue.Dequeue( out, 8 ) == 8 );
+    }
+
+    SECTION( "stress" )
+    {
+        // Small capacities keep the queue full or empty most of the time, and wrap it around constantly
+        StressQueue<4>   ( 4, 4, 100000, 1 );
+        StressQueue<16>  ( 8, 2, 50000 , 5 );
+        StressQueue<16>  ( 2, 8, 100000, 7 );
+        StressQueue<1024>( 6, 6, 200000, 64 );
+    }
+
+    SECTION( "stress-whole-batches" )
+    {
+        // A single consumer sees every batch as one run of items
+        StressQueue<16>  ( 8, 1, 50000 , 16, true );
+        StressQueue<1024>( 6, 1, 200000, 64, true );
+        StressQueue<16>  ( 4, 4, 50000 , 9 , true );
+    }
+}
+
+/// Producers enqueue unique items in batches of up to maxBatch, consumers dequeue them in batches
+/// until all are consumed. Every item must be dequeued exactly once, and each producer's items in the order they were enqueued.
+/// With wholeBatches, batches are enqueued with TryEnqueueAll, and a single consumer must not see them interleaved.
+//-----------------------------------------------------------
+template<size_t _Capacity>
+void StressQueue( const uint32 producerCount, const uint32 consumerCount, const uint64 itemsPerProducer, const uint32 maxBatch, const bool wholeBatches )
+{
+    BoundedMPMCQueue<uint64, _Capacity> queue;
+
+    const uint64 totalItems = itemsPerProducer * producerCount;
+
+    std::vector<std::atomic<uint8>> hits( totalItems );
+    std::atomic<uint64>             consumed   = 0;
+    std::atomic<bool>               outOfOrder = false;
+    std::atomic<bool>               split      = false;
+
+    // Set for the first item of each batch. Written before the batch is enqueued.
+    std::vector<uint8> batchStart( totalItems );
+
+    std::vector<std::thread> threads;
+
+    for( uint32 p = 0; p < producerCount; p++ )
+    {
+        threads.emplace_back( [&, p]() {
+            std::vector<uint64> batch( maxBatch );
+            uint64 next = 0;
+            uint32 size = 1;
+
+            while( next < itemsPerProducer )
+            {
+                // Item ids are producer * itemsPerProducer + sequence
+                const uint32 count = (uint32)std::min( (uint64)size, itemsPerProducer - next );
+                for( uint32 i = 0; i < count; i++ )
+                    batch[i] = p * itemsPerProducer + next + i;
+
+                batchStart[batch[0]] = 1;
+
+                if( wholeBatches )
+                {
+                    while( !queue.TryEnqueueAll( batch.data(), count ) )
+                        std::this_thread::yield();
+
+                    next += count;
+                    size  = size % maxBatch + 1;
+                    continue;
+                }
+
+                uint32 enqueued = 0;
+                while( enqueued < count )
+                {
+                    const size_t n = queue.TryEnqueue( batch.data() + enqueued, count - enqueued );
+                    if( n == 0 )
+                        std::this_thread::yield();
+
+                    enqueued += (uint32)n;
+                }
+
+                next += count;
+                size  = size % maxBatch + 1;
+            }
+        });
+    }
+
+    for( uint32 c = 0; c < consumerCount; c++ )
+    {
+        threads.emplace_back( [&]() {
+            std::vector<uint64> batch( maxBatch );
+            std::vector<uint64> lastSeen( producerCount, std::numeric_limits<uint64>::max() );
+            uint64              lastItem = std::numeric_limits<uint64>::max();
+
+            while( consumed.load( std::memory_order_relaxed ) < totalItems )
+            {
+                const size_t n = queue.Dequeue( batch.data(), maxBatch );
+                if( n == 0 )
+                {
+                    std::this_thread::yield();
+                    continue;
+                }
+
+                for( size_t i = 0; i < n; i++ )
+                {
+                    const uint64 item     = batch[i];
+                    const uint64 producer = item / itemsPerProducer;
+                    const uint64 seq      = item % itemsPerProducer;
+
+                    if( item >= totalItems )
+                    {
+                        outOfOrder = true;
+                        continue;
+                    }
+
+                    // Each consumer must see a producer's items in increasing order
+                    if( lastSeen[producer] != std::numeric_limits<uint64>::max() && seq <= lastSeen[producer] )
+                        outOfOrder = true;
+
+                    // Within a batch, an item must directly follow the previous one
+                    if( wholeBatches && consumerCount == 1 && !batchStart[item] && item != lastItem + 1 )
+                        split = true;
+
+                    lastSeen[producer] = seq;
+                    lastItem           = item;
+                    hits[item].fetch_add( 1, std::memory_order_relaxed );
+                }
+
+                consumed += n;
+            }
+        });
+    }
+
+    for( auto& t : threads )
+        t.join();
+
+    ENSURE( !outOfOrder );
+    ENSURE( !split );
+    ENSURE( consumed.load() == totalItems );
+
+    for( uint64 i = 0; i < totalItems; i++ )
+        ENSURE( hits[i].load( std::memory_order_relaxed ) == 1 );
+
+    uint64 leftOver;
+    ENSURE( !queue.Dequeue( &leftOver ) );
+}
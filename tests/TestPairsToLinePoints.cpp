@@ -0,0 +1,78 @@
+#include "TestUtil.h"
+#include "plotmem/LPGen.h"
+#include <random>
+#include <vector>
+
+static void CheckPairsToLinePoints( const std::vector<Pair>& pairs, const std::vector<uint32>& lTable );
+
+//-----------------------------------------------------------
+TEST_CASE( "pairs-to-line-points", "[unit-core]" )
+{
+    std::mt19937_64 rng( 0x9b05688c2b3e6c1full );
+
+    std::vector<uint32> lTable( 1u << 16 );
+    for( uint32& x : lTable )
+        x = (uint32)rng();
+
+    // Values at the edges of the 32-bit range, where x * (x-1) needs all of 64 bits
+    const uint32 edges[] = { 0, 1, 2, 3, 0x7FFFFFFF, 0x80000000, 0xFFFFFFFE, 0xFFFFFFFF };
+    for( uint32 i = 0; i < sizeof( edges ) / sizeof( edges[0] ); i++ )
+        lTable[i] = edges[i];
+
+    auto randomPairs = [&]( const uint64 count, const uint32 indexRange ) {
+        std::vector<Pair> pairs( count );
+        for( Pair& p : pairs )
+        {
+            p.left  = (uint32)( rng() % indexRange );
+            p.right = (uint32)( rng() % indexRange );
+        }
+        return pairs;
+    };
+
+    SECTION( "random" )
+    {
+        CheckPairsToLinePoints( randomPairs( 100003, (uint32)lTable.size() ), lTable );
+    }
+
+    SECTION( "skewed" )
+    {
+        // Most pairs point to the few edge entries, both ways around, and to the same entry twice
+        CheckPairsToLinePoints( randomPairs( 4099, 8 ), lTable );
+    }
+
+    SECTION( "small" )
+    {
+        // Counts below and around the 4-pair SIMD width, so the scalar tail does all or part of the work
+        for( uint64 count = 0; count <= 13; count++ )
+            CheckPairsToLinePoints( randomPairs( count, (uint32)lTable.size() ), lTable );
+    }
+}
+
+/// Compares PairsToLinePoints with the scalar SquareToLinePoint, to a separate buffer and in place
+//-----------------------------------------------------------
+void CheckPairsToLinePoints( const std::vector<Pair>& pairs, const std::vector<uint32>& lTable )
+{
+    const uint64 count = pairs.size();
+
+    std::vector<uint64> expected( count );
+    for( uint64 i = 0; i < count; i++ )
+        expected[i] = SquareToLinePoint( lTable[pairs[i].left], lTable[pairs[i].right] );
+
+    std::vector<uint64> out( count + 1, 0xCCCCCCCCCCCCCCCCull );
+    PairsToLinePoints( pairs.data(), lTable.data(), out.data(), count );
+
+    for( uint64 i = 0; i < count; i++ )
+        ENSURE( out[i] == expected[i] );
+
+    ENSURE( out[count] == 0xCCCCCCCCCCCCCCCCull );
+
+    // Phase 3 converts in place, with the line points overwriting the pairs
+    static_assert( sizeof( Pair ) == sizeof( uint64 ) );
+    std::vector<uint64> inPlace( count );
+    memcpy( inPlace.data(), pairs.data(), count * sizeof( Pair ) );
+
+    PairsToLinePoints( (const Pair*)inPlace.data(), lTable.data(), inPlace.data(), count );
+
+    for( uint64 i = 0; i < count; i++ )
+        ENSURE( inPlace[i] == expected[i] );
+}
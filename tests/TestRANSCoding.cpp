@@ -0,0 +1,86 @@
+#include "TestUtil.h"
+#include "plotting/ParkCoding.h"
+#include "plotting/Compression.h"
+#include <random>
+#include <vector>
+
+static void RoundTripSymbols( const std::vector<byte>& symbols, const RANSEncTable& encTable, const RANSDecTable& decTable );
+
+//-----------------------------------------------------------
+TEST_CASE( "rans-coding", "[unit-core]" )
+{
+    std::mt19937_64 rng( 0xbb67ae8584caa73bull );
+
+    const uint32 counts[] = { 1, 5, RANSLaneCount - 1, RANSLaneCount, RANSLaneCount + 1,
+                              RANSLaneCount * 3 + 7, 1000, kEntriesPerPark - 1 };
+
+    for( const double rValue : { 1.0, 4.5, 8.0 } )
+    {
+        const RANSEncTable* encTable = CreateRANSEncTable( rValue );
+        const RANSDecTable* decTable = CreateRANSDecTable( rValue );
+        ENSURE( encTable && decTable );
+
+        for( const uint32 count : counts )
+        {
+            std::vector<byte> symbols( count );
+
+            // Deltas drawn from the table's own distribution, as park deltas are
+            for( byte& s : symbols )
+            {
+                const uint32 slot = (uint32)( rng() % ( 1u << RANSScaleBits ) );
+                uint32 sym = 0;
+                while( encTable->start[sym] + encTable->freq[sym] <= slot )
+                    sym++;
+
+                s = (byte)sym;
+            }
+            RoundTripSymbols( symbols, *encTable, *decTable );
+
+            // Uniformly random deltas, so rare symbols renormalize often
+            for( byte& s : symbols )
+                s = (byte)( rng() % encTable->symbolCount );
+            RoundTripSymbols( symbols, *encTable, *decTable );
+
+            // Skewed to the rarest symbol the table has
+            for( byte& s : symbols )
+                s = (byte)( rng() % 4 == 0 ? 0 : encTable->symbolCount - 1 );
+            RoundTripSymbols( symbols, *encTable, *decTable );
+        }
+    }
+
+    SetParkCodingMaxSimd( 2 );
+}
+
+/// Encodes the symbols, then decodes them with the scalar, AVX2 and AVX-512 decoders.
+/// Levels the CPU lacks decode with the best one it has.
+//-----------------------------------------------------------
+void RoundTripSymbols( const std::vector<byte>& symbols, const RANSEncTable& encTable, const RANSDecTable& decTable )
+{
+    const uint32 count = (uint32)symbols.size();
+
+    std::vector<byte>   encoded( RANS_ENCODE_BOUND( count ) );
+    std::vector<uint16> words( count );
+
+    const size_t encodedSize = RANSEncode( encoded.data(), symbols.data(), count, encTable, words.data() );
+    ENSURE( encodedSize > 0 );
+    ENSURE( encodedSize <= encoded.size() );
+
+    for( uint32 level = 0; level <= 2; level++ )
+    {
+        SetParkCodingMaxSimd( level );
+
+        std::vector<byte> decoded( count, 0xFF );
+        const size_t r = RANSDecode( decoded.data(), decoded.size(), encoded.data(), encodedSize, decTable );
+
+        ENSURE( !FSE_isError( r ) );
+        ENSURE( r == count );
+        ENSURE( decoded == symbols );
+
+        // A truncated stream must be caught rather than decoded
+        if( encodedSize > 2 + RANSLaneCount * 4 + 2 )
+        {
+            const size_t t = RANSDecode( decoded.data(), decoded.size(), encoded.data(), encodedSize - 2, decTable );
+            ENSURE( FSE_isError( t ) );
+        }
+    }
+}
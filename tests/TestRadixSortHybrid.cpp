@@ -0,0 +1,154 @@
+#include "TestUtil.h"
+#include "algorithm/RadixSort.h"
+#include "threading/ThreadPool.h"
+#include <algorithm>
+#include <random>
+#include <vector>
+
+static constexpr uint32 MaxTestThreads = 8;
+
+// Sizes around the hybrid cut-off, none a multiple of the tested thread counts
+static const uint64 TestLengths[] = { 1, 2, 255, 1001, 100003, RadixSort256::HybridMinLength - 1, RadixSort256::HybridMinLength + 12347 };
+static const uint32 TestThreads[] = { 1, 3, 7 };
+
+template<int MaxIter>
+static void CheckHybridSorts( ThreadPool& pool, uint32 threadCount, const std::vector<uint64>& keys );
+
+template<int MaxIter, typename TGen>
+static void RunHybridSorts( ThreadPool& pool, TGen&& genKey );
+
+//-----------------------------------------------------------
+TEST_CASE( "radix-sort-hybrid", "[unit-core]" )
+{
+    ThreadPool pool( MaxTestThreads );
+    std::mt19937_64 rng( 0x9b05688c2b3e6c1full );
+
+    SECTION( "random" )
+    {
+        // Odd and even pass counts land on different buffers
+        RunHybridSorts<5>( pool, [&]() { return rng() & ( ( 1ull << 40 ) - 1 ); } );
+        RunHybridSorts<4>( pool, [&]() { return rng() & 0xFFFFFFFFull; } );
+        RunHybridSorts<8>( pool, [&]() { return rng(); } );
+
+        // The most bits above 32 that the narrow sort's MSD digit can cover
+        RunHybridSorts<6>( pool, [&]() { return rng() & ( ( 1ull << 48 ) - 1 ); } );
+    }
+
+    SECTION( "all-equal" )
+    {
+        RunHybridSorts<5>( pool, []() { return 0x12345678ABull; } );
+        RunHybridSorts<5>( pool, []() { return 0ull; } );
+    }
+
+    SECTION( "few-bits" )
+    {
+        // Fewer significant bits than the MSD digit would take
+        RunHybridSorts<5>( pool, [&]() { return rng() & 0xF; } );
+        RunHybridSorts<4>( pool, [&]() { return rng() & 1; } );
+
+        // Just above 32 bits, with many duplicates
+        RunHybridSorts<5>( pool, [&]() { return ( rng() & ( 1ull << 32 ) ) | ( rng() & 0xFF ); } );
+    }
+}
+
+//-----------------------------------------------------------
+template<int MaxIter, typename TGen>
+void RunHybridSorts( ThreadPool& pool, TGen&& genKey )
+{
+    uint32 run = 0;
+    for( const uint64 length : TestLengths )
+    {
+        std::vector<uint64> keys( length );
+        for( uint64& k : keys )
+            k = genKey();
+
+        CheckHybridSorts<MaxIter>( pool, TestThreads[run++ % std::size( TestThreads )], keys );
+    }
+}
+
+//-----------------------------------------------------------
+template<int MaxIter>
+void CheckHybridSorts( ThreadPool& pool, const uint32 threadCount, const std::vector<uint64>& keys )
+{
+    const uint64 length = keys.size();
+    INFO( "MaxIter: " << MaxIter << ", length: " << length << ", threads: " << threadCount );
+
+    // The stable order of the original indices is the expected payload order
+    std::vector<uint32> refOrder( length );
+    for( uint64 i = 0; i < length; i++ )
+        refOrder[i] = (uint32)i;
+
+    std::stable_sort( refOrder.begin(), refOrder.end(), [&]( uint32 a, uint32 b ) { return keys[a] < keys[b]; } );
+
+    std::vector<uint64> refKeys( length );
+    for( uint64 i = 0; i < length; i++ )
+        refKeys[i] = keys[refOrder[i]];
+
+    auto payload2 = []( uint32 idx ) { return ~(uint64)idx * 0x9e3779b97f4a7c15ull; };
+
+    // Results land on input for an even number of passes, on tmp otherwise
+    const bool inInput = ( MaxIter & 1 ) == 0;
+
+    std::vector<uint64> input, tmp( length );
+    std::vector<uint32> p1Input( length ), p1Tmp( length );
+    std::vector<uint64> p2Input( length ), p2Tmp( length );
+
+    auto resetInputs = [&]() {
+        input = keys;
+        for( uint64 i = 0; i < length; i++ )
+        {
+            p1Input[i] = (uint32)i;
+            p2Input[i] = payload2( (uint32)i );
+        }
+    };
+
+    auto payload2Matches = [&]( const std::vector<uint64>& p2 ) {
+        for( uint64 i = 0; i < length; i++ )
+            if( p2[i] != payload2( refOrder[i] ) )
+                return false;
+        return true;
+    };
+
+    // SortHybrid
+    {
+        resetInputs();
+        RadixSort256::SortHybrid<MaxTestThreads, uint64, MaxIter>( pool, threadCount, input.data(), tmp.data(), length );
+
+        ENSURE( ( inInput ? input : tmp ) == refKeys );
+    }
+
+    // SortWithKeyHybrid
+    {
+        resetInputs();
+        RadixSort256::SortWithKeyHybrid<MaxTestThreads, uint64, uint32, MaxIter>( pool, threadCount, input.data(), tmp.data(),
+                                                                                 p1Input.data(), p1Tmp.data(), length );
+
+        ENSURE( ( inInput ? input   : tmp   ) == refKeys  );
+        ENSURE( ( inInput ? p1Input : p1Tmp ) == refOrder );
+    }
+
+    // SortWithPayloadsHybrid
+    {
+        resetInputs();
+        RadixSort256::SortWithPayloadsHybrid<MaxTestThreads, uint64, uint32, uint64, MaxIter>( pool, threadCount, input.data(), tmp.data(),
+                                                                                              p1Input.data(), p1Tmp.data(),
+                                                                                              p2Input.data(), p2Tmp.data(), length );
+
+        ENSURE( ( inInput ? input   : tmp   ) == refKeys  );
+        ENSURE( ( inInput ? p1Input : p1Tmp ) == refOrder );
+        ENSURE( payload2Matches( inInput ? p2Input : p2Tmp ) );
+    }
+
+    // SortWithPayloadsNarrow, whose values always land on input
+    if constexpr ( MaxIter <= 6 )
+    {
+        resetInputs();
+        RadixSort256::SortWithPayloadsNarrow<MaxTestThreads, uint64, uint32, uint64, MaxIter>( pool, threadCount, input.data(), tmp.data(),
+                                                                                              p1Input.data(), p1Tmp.data(),
+                                                                                              p2Input.data(), p2Tmp.data(), length );
+
+        ENSURE( input == refKeys );
+        ENSURE( ( inInput ? p1Input : p1Tmp ) == refOrder );
+        ENSURE( payload2Matches( inInput ? p2Input : p2Tmp ) );
+    }
+}
@@ -0,0 +1,44 @@
+#include "TestUtil.h"
+#include "io/NetStream.h"
+
+//-----------------------------------------------------------
+TEST_CASE( "remote-plot-path", "[unit-core]" )
+{
+    using namespace std::string_literals;
+
+    SECTION( "valid" )
+    {
+        ENSURE( NetStream::IsValidRemotePath( "plot-k32.plot.tmp" ) );
+        ENSURE( NetStream::IsValidRemotePath( "disk1/plot-k32.plot.tmp" ) );
+        ENSURE( NetStream::IsValidRemotePath( "disk1\\plots/plot-k32.plot.tmp" ) );
+        ENSURE( NetStream::IsValidRemotePath( "a/..b/plot.tmp" ) );
+    }
+
+    SECTION( "outside-root" )
+    {
+        ENSURE( !NetStream::IsValidRemotePath( "" ) );
+        ENSURE( !NetStream::IsValidRemotePath( "/etc/plot.tmp" ) );
+        ENSURE( !NetStream::IsValidRemotePath( "\\plot.tmp" ) );
+        ENSURE( !NetStream::IsValidRemotePath( "C:/plot.tmp" ) );
+        ENSURE( !NetStream::IsValidRemotePath( "../plot.tmp" ) );
+        ENSURE( !NetStream::IsValidRemotePath( "disk1/../../plot.tmp" ) );
+        ENSURE( !NetStream::IsValidRemotePath( "disk1\\..\\plot.tmp" ) );
+    }
+
+    SECTION( "not-tmp" )
+    {
+        ENSURE( !NetStream::IsValidRemotePath( ".tmp" ) );
+        ENSURE( !NetStream::IsValidRemotePath( "disk1/plot-k32.plot" ) );
+        ENSURE( !NetStream::IsValidRemotePath( "disk1/plot.tmp/x.plot" ) );
+    }
+
+    SECTION( "control-characters" )
+    {
+        // The file is opened as a C string, which would end at the NUL, and truncate the finished plot
+        ENSURE( !NetStream::IsValidRemotePath( "disk1/x.plot\0.tmp"s ) );
+        ENSURE( !NetStream::IsValidRemotePath( "\0/etc/passwd.tmp"s ) );
+        ENSURE( !NetStream::IsValidRemotePath( "disk1/x\n.plot.tmp" ) );
+        ENSURE( !NetStream::IsValidRemotePath( "disk1/x\x1b.plot.tmp" ) );
+        ENSURE( !NetStream::IsValidRemotePath( "disk1/x\x7f.plot.tmp" ) );
+    }
+}
@@ -0,0 +1,103 @@
+#include "TestUtil.h"
+#include "threading/WorkStealingRanges.h"
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+
+static void RunStealingRanges( uint32 threadCount, uint64 totalCount, uint64 grainSize, bool slowThread );
+
+//-----------------------------------------------------------
+TEST_CASE( "work-stealing-ranges", "[unit-core]" )
+{
+    const uint32 maxThreads = std::max( 2u, std::min( 32u, SysHost::GetLogicalCPUCount() * 2 ) );
+
+    SECTION( "exactly-once" )
+    {
+        std::mt19937_64 rng( 0x510e527fade682d1ull );
+
+        for( uint32 run = 0; run < 200; run++ )
+        {
+            const uint32 threadCount = 1 + (uint32)( rng() % maxThreads );
+            const uint64 totalCount  = rng() % 4 == 0 ? rng() % 64 : rng() % ( 1ull << 18 );
+            const uint64 grainSize   = 1 + rng() % 2048;
+
+            RunStealingRanges( threadCount, totalCount, grainSize, false );
+        }
+    }
+
+    SECTION( "stealing" )
+    {
+        // One thread stalls on each of its chunks, so the others have to take its range
+        RunStealingRanges( maxThreads, 1ull << 16, 64, true );
+        RunStealingRanges( maxThreads, 1ull << 16, 1 , true );
+    }
+
+    SECTION( "run-ranges" )
+    {
+        ThreadPool pool( maxThreads );
+
+        const uint64 totalCount = ( 1ull << 20 ) + 13;
+        std::vector<std::atomic<uint8>> hits( totalCount );
+
+        AnonMTJob::RunRanges( pool, maxThreads, totalCount, [&]( AnonMTJob*, const uint64 offset, const uint64 count ) {
+            for( uint64 i = offset; i < offset + count; i++ )
+                hits[i].fetch_add( 1, std::memory_order_relaxed );
+        });
+
+        for( uint64 i = 0; i < totalCount; i++ )
+            ENSURE( hits[i].load( std::memory_order_relaxed ) == 1 );
+    }
+}
+
+/// Each thread takes chunks until none is left, every index must be handed out exactly once
+//-----------------------------------------------------------
+void RunStealingRanges( const uint32 threadCount, const uint64 totalCount, const uint64 grainSize, const bool slowThread )
+{
+    WorkStealingRanges ranges( threadCount, totalCount, grainSize );
+
+    std::vector<std::atomic<uint8>>  hits( totalCount );
+    std::vector<std::atomic<uint64>> threadItems( threadCount );
+    std::atomic<bool>                badChunk = false;
+    std::atomic<uint32>              started  = 0;
+
+    std::vector<std::thread> threads;
+    for( uint32 t = 0; t < threadCount; t++ )
+    {
+        threads.emplace_back( [&, t]() {
+
+            // Start together, so that threads run out of work and steal from each other
+            started++;
+            while( started.load() < threadCount )
+                std::this_thread::yield();
+
+            uint64 offset, count;
+            while( ranges.Next( t, offset, count ) )
+            {
+                if( count == 0 || count > grainSize || offset + count > totalCount )
+                    badChunk = true;
+
+                for( uint64 i = offset; i < std::min( offset + count, totalCount ); i++ )
+                    hits[i].fetch_add( 1, std::memory_order_relaxed );
+
+                threadItems[t] += count;
+
+                if( slowThread && t == 0 )
+                    std::this_thread::sleep_for( std::chrono::microseconds( 200 ) );
+            }
+        });
+    }
+
+    for( auto& t : threads )
+        t.join();
+
+    ENSURE( !badChunk );
+
+    for( uint64 i = 0; i < totalCount; i++ )
+        ENSURE( hits[i].load( std::memory_order_relaxed ) == 1 );
+
+    // The stalled thread must have lost most of its static share to the others
+    if( slowThread && threadCount > 1 )
+        ENSURE( threadItems[0].load() < totalCount / threadCount );
+}